@@ -26,12 +26,16 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/poll.h>
 #include <time.h>
 #include <unistd.h>
 #include <zlib.h>
 
+#include <atomic>
 #include <fstream>
 #include <memory>
+#include <thread>
+#include <vector>
 
 #include <binder/IBinder.h>
 #include <binder/IServiceManager.h>
@@ -235,6 +239,7 @@ static const char* g_outputFile = nullptr;
 /* Global state */
 static bool g_tracePdx = false;
 static bool g_traceAborted = false;
+static std::atomic<bool> g_rawStreamStopped(false);
 static bool g_categoryEnables[arraysize(k_categories)] = {};
 static std::string g_traceFolder;
 
@@ -287,6 +292,9 @@ static const char* k_traceStreamPath =
 static const char* k_traceMarkerPath =
     "trace_marker";
 
+static const char* k_tracePipeRawPath =
+    "per_cpu/cpu%d/trace_pipe_raw";
+
 // Check whether a file exists.
 static bool fileExists(const char* filename) {
     return access((g_traceFolder + filename).c_str(), F_OK) != -1;
@@ -940,6 +948,159 @@ static void streamTrace()
     }
 }
 
+// Compress and write data to a file, or write out what's buffered in zs when
+// flush is Z_FINISH.
+static bool deflateToFd(z_stream* zs, const void* data, size_t size, int flush,
+        int outFd)
+{
+    uint8_t out[64*1024];
+    zs->next_in = reinterpret_cast<Bytef*>(const_cast<void*>(data));
+    zs->avail_in = size;
+    do {
+        zs->next_out = reinterpret_cast<Bytef*>(out);
+        zs->avail_out = sizeof(out);
+        int result = deflate(zs, flush);
+        if (result != Z_OK && result != Z_STREAM_END && result != Z_BUF_ERROR) {
+            fprintf(stderr, "error deflating trace: %s\n", zs->msg);
+            return false;
+        }
+        size_t bytes = sizeof(out) - zs->avail_out;
+        if (!android::base::WriteFully(outFd, out, bytes)) {
+            fprintf(stderr, "error writing deflated trace: %s (%d)\n",
+                    strerror(errno), errno);
+            return false;
+        }
+    } while (zs->avail_out == 0);
+    return true;
+}
+
+// Copy the ring buffer pages of one CPU to a file until streaming is stopped,
+// and then whatever is left in them.  Full pages are spliced through a pipe
+// into the file without being copied, unless the trace is compressed.
+static void streamRawCpuTrace(int cpu, int outFd)
+{
+    std::string path = g_traceFolder + android::base::StringPrintf(k_tracePipeRawPath, cpu);
+    int traceFD = open(path.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (traceFD == -1) {
+        fprintf(stderr, "error opening %s: %s (%d)\n", path.c_str(),
+                strerror(errno), errno);
+        return;
+    }
+
+    const size_t pageSize = sysconf(_SC_PAGESIZE);
+    const size_t chunkSize = 16 * pageSize;
+    std::unique_ptr<uint8_t[]> page(new uint8_t[pageSize]);
+    int pipeFds[2] = {-1, -1};
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    bool ok = true;
+    if (g_compress) {
+        int result = deflateInit(&zs, Z_DEFAULT_COMPRESSION);
+        if (result != Z_OK) {
+            fprintf(stderr, "error initializing zlib: %d\n", result);
+            ok = false;
+        }
+    } else if (pipe2(pipeFds, O_CLOEXEC) == -1) {
+        fprintf(stderr, "error creating pipe: %s (%d)\n", strerror(errno), errno);
+        ok = false;
+    }
+
+    while (ok && !g_rawStreamStopped) {
+        struct pollfd pfd = {traceFD, POLLIN, 0};
+        int rc = TEMP_FAILURE_RETRY(poll(&pfd, 1, 100));
+        if (rc <= 0) {
+            continue;
+        }
+        ssize_t bytes;
+        if (g_compress) {
+            bytes = read(traceFD, page.get(), pageSize);
+            if (bytes > 0) {
+                ok = deflateToFd(&zs, page.get(), bytes, Z_NO_FLUSH, outFd);
+            }
+        } else {
+            bytes = splice(traceFD, NULL, pipeFds[1], NULL, chunkSize,
+                    SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+            while (bytes > 0 && ok) {
+                ssize_t written = splice(pipeFds[0], NULL, outFd, NULL, bytes,
+                        SPLICE_F_MOVE);
+                if (written <= 0) {
+                    fprintf(stderr, "error writing trace of cpu %d: %s (%d)\n",
+                            cpu, strerror(errno), errno);
+                    ok = false;
+                }
+                bytes -= written;
+            }
+        }
+        if (bytes == -1 && errno != EAGAIN && errno != EINTR) {
+            fprintf(stderr, "error reading trace of cpu %d: %s (%d)\n",
+                    cpu, strerror(errno), errno);
+            ok = false;
+        } else if (bytes == -1 && errno == EAGAIN) {
+            // Only full pages can be spliced; wait for the next one.
+            usleep(100000);
+        }
+    }
+
+    // Tracing is off by now, so drain the last partial pages with read.
+    ssize_t bytes;
+    while (ok && (bytes = TEMP_FAILURE_RETRY(read(traceFD, page.get(), pageSize))) > 0) {
+        ok = g_compress ? deflateToFd(&zs, page.get(), bytes, Z_NO_FLUSH, outFd)
+                : android::base::WriteFully(outFd, page.get(), bytes);
+    }
+    if (g_compress) {
+        if (ok) {
+            deflateToFd(&zs, nullptr, 0, Z_FINISH, outFd);
+        }
+        deflateEnd(&zs);
+    }
+    if (pipeFds[0] != -1) {
+        close(pipeFds[0]);
+        close(pipeFds[1]);
+    }
+    close(traceFD);
+}
+
+// Stream the binary ring buffer of each CPU into its own file next to
+// g_outputFile until tracing is aborted.  Unlike streamTrace, nothing is
+// formatted, so this keeps up with long traces without a big trace buffer.
+static bool streamRawTrace()
+{
+    long cpuCount = sysconf(_SC_NPROCESSORS_CONF);
+    std::vector<int> outFds;
+    for (int cpu = 0; cpu < cpuCount; cpu++) {
+        std::string path = android::base::StringPrintf("%s.cpu%d", g_outputFile, cpu);
+        int outFd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (outFd == -1) {
+            fprintf(stderr, "error opening %s: %s (%d)\n", path.c_str(),
+                    strerror(errno), errno);
+            break;
+        }
+        outFds.push_back(outFd);
+    }
+
+    bool ok = (outFds.size() == static_cast<size_t>(cpuCount));
+    std::vector<std::thread> threads;
+    if (ok) {
+        for (int cpu = 0; cpu < cpuCount; cpu++) {
+            threads.emplace_back(streamRawCpuTrace, cpu, outFds[cpu]);
+        }
+        while (!g_traceAborted) {
+            usleep(100000);
+        }
+    }
+
+    // Stop tracing first so that the threads can drain everything left.
+    stopTrace();
+    g_rawStreamStopped = true;
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    for (int outFd : outFds) {
+        close(outFd);
+    }
+    return ok;
+}
+
 // Read the current kernel trace and write it to stdout.
 static void dumpTrace(int outFd)
 {
@@ -1097,6 +1258,9 @@ static void showHelp(const char *cmd)
                     "                    Note: this can take significant CPU time, and is best\n"
                     "                    used for measuring things that are not affected by\n"
                     "                    CPU performance, like pagecache usage.\n"
+                    "  --stream_raw    stream the binary trace buffer of each cpu to\n"
+                    "                    FILENAME.cpuN (see -o) until interrupted; -z\n"
+                    "                    compresses each file\n"
                     "  --list_categories\n"
                     "                  list the available tracing categories\n"
                     " -o filename      write the trace to the specified file instead\n"
@@ -1134,6 +1298,7 @@ int main(int argc, char **argv)
     bool traceStop = true;
     bool traceDump = true;
     bool traceStream = false;
+    bool traceStreamRaw = false;
     bool onlyUserspace = false;
 
     if (argc == 2 && 0 == strcmp(argv[1], "--help")) {
@@ -1156,6 +1321,7 @@ int main(int argc, char **argv)
             {"only_userspace",    no_argument, 0,  0 },
             {"list_categories",   no_argument, 0,  0 },
             {"stream",            no_argument, 0,  0 },
+            {"stream_raw",        no_argument, 0,  0 },
             {           0,                  0, 0,  0 }
         };
 
@@ -1231,6 +1397,9 @@ int main(int argc, char **argv)
                 } else if (!strcmp(long_options[option_index].name, "stream")) {
                     traceStream = true;
                     traceDump = false;
+                } else if (!strcmp(long_options[option_index].name, "stream_raw")) {
+                    traceStreamRaw = true;
+                    traceDump = false;
                 } else if (!strcmp(long_options[option_index].name, "list_categories")) {
                     listSupportedCategories();
                     exit(0);
@@ -1253,6 +1422,11 @@ int main(int argc, char **argv)
         }
     }
 
+    if (traceStreamRaw && (g_outputFile == nullptr || async || onlyUserspace)) {
+        fprintf(stderr, "--stream_raw needs -o and can't be used with --async_*\n");
+        exit(1);
+    }
+
     registerSigHandler();
 
     if (g_initialSleepSecs > 0) {
@@ -1272,7 +1446,7 @@ int main(int argc, char **argv)
 
     if (ok && traceStart) {
 
-        if (!traceStream && !onlyUserspace) {
+        if (!traceStream && !traceStreamRaw && !onlyUserspace) {
             printf("capturing trace...");
             fflush(stdout);
         }
@@ -1288,7 +1462,7 @@ int main(int argc, char **argv)
         if (!onlyUserspace)
             writeClockSyncMarker();
 
-        if (ok && !async && !traceStream) {
+        if (ok && !async && !traceStream && !traceStreamRaw) {
             // Sleep to allow the trace to be captured.
             struct timespec timeLeft;
             timeLeft.tv_sec = g_traceDurationSeconds;
@@ -1303,6 +1477,10 @@ int main(int argc, char **argv)
         if (traceStream) {
             streamTrace();
         }
+
+        if (ok && traceStreamRaw) {
+            ok = streamRawTrace();
+        }
     }
 
     // Stop the trace and restore the default settings.
@@ -24,6 +24,7 @@
 #include <sys/wait.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <vector>
 
 #include <android-base/file.h>
@@ -43,6 +44,9 @@ namespace {
 
 static constexpr const char* kSuPath = "/system/xbin/su";
 
+// How long to wait for SIGCHLD before checking on a child again.
+static constexpr uint64_t WAIT_SLICE_MS = 50;
+
 static bool waitpid_with_timeout(pid_t pid, int timeout_ms, int* status) {
     sigset_t child_mask, old_mask;
     sigemptyset(&child_mask);
@@ -53,10 +57,31 @@ static bool waitpid_with_timeout(pid_t pid, int timeout_ms, int* status) {
         return false;
     }
 
-    timespec ts;
-    ts.tv_sec = MSEC_TO_SEC(timeout_ms);
-    ts.tv_nsec = (timeout_ms % 1000) * 1000000;
-    int ret = TEMP_FAILURE_RETRY(sigtimedwait(&child_mask, NULL, &ts));
+    // When sections run in parallel, the SIGCHLD of our child may be taken by another thread,
+    // so don't rely on getting it: check on the child at least every WAIT_SLICE_MS.
+    uint64_t deadline = Nanotime() + static_cast<uint64_t>(timeout_ms) * 1000000;
+    int ret = 0;
+    pid_t child_pid = 0;
+    while (true) {
+        child_pid = waitpid(pid, status, WNOHANG);
+        if (child_pid != 0) {
+            break;
+        }
+        uint64_t now = Nanotime();
+        if (now >= deadline) {
+            ret = -1;
+            errno = EAGAIN;
+            break;
+        }
+        uint64_t wait_ns = std::min(deadline - now, WAIT_SLICE_MS * 1000000);
+        timespec ts;
+        ts.tv_sec = wait_ns / 1000000000;
+        ts.tv_nsec = wait_ns % 1000000000;
+        if (TEMP_FAILURE_RETRY(sigtimedwait(&child_mask, NULL, &ts)) == -1 && errno != EAGAIN) {
+            ret = -1;
+            break;
+        }
+    }
     int saved_errno = errno;
 
     // Set the signals back the way they were.
@@ -76,13 +101,8 @@ static bool waitpid_with_timeout(pid_t pid, int timeout_ms, int* status) {
         return false;
     }
 
-    pid_t child_pid = waitpid(pid, status, WNOHANG);
     if (child_pid != pid) {
-        if (child_pid != -1) {
-            printf("*** Waiting for pid %d, got pid %d instead\n", pid, child_pid);
-        } else {
-            printf("*** waitpid failed: %s\n", strerror(errno));
-        }
+        printf("*** waitpid failed: %s\n", strerror(saved_errno));
         return false;
     }
     return true;
@@ -273,8 +293,16 @@ int RunCommandToFd(int fd, const std::string& title, const std::vector<std::stri
 
     const char* path = args[0];
 
+    // Commands that keep dumpstate's privileges need only a few system calls between the fork and
+    // the exec, so they are started with vfork() instead of copying dumpstate's large address
+    // space. The vfork() child shares that memory with dumpstate, so it must not allocate or log:
+    // the exec error message is prepared here.
+    const bool drop_root = options.PrivilegeMode() == DROP_ROOT;
+    const std::string exec_error =
+        android::base::StringPrintf("execvp on command '%s' failed (error: ", command);
+
     uint64_t start = Nanotime();
-    pid_t pid = fork();
+    pid_t pid = drop_root ? fork() : vfork();
 
     /* handle error case */
     if (pid < 0) {
@@ -285,7 +313,7 @@ int RunCommandToFd(int fd, const std::string& title, const std::vector<std::stri
 
     /* handle child case */
     if (pid == 0) {
-        if (options.PrivilegeMode() == DROP_ROOT && !DropRootUser()) {
+        if (drop_root && !DropRootUser()) {
             if (!silent) {
                 dprintf(fd, "*** failed to drop root before running %s: %s\n", command,
                         strerror(errno));
@@ -315,7 +343,10 @@ int RunCommandToFd(int fd, const std::string& title, const std::vector<std::stri
         execvp(path, (char**)args.data());
         // execvp's result will be handled after waitpid_with_timeout() below, but
         // if it failed, it's safer to exit dumpstate.
-        MYLOGD("execvp on command '%s' failed (error: %s)\n", command, strerror(errno));
+        const char* error = strerror(errno);
+        TEMP_FAILURE_RETRY(write(STDERR_FILENO, exec_error.data(), exec_error.size()));
+        TEMP_FAILURE_RETRY(write(STDERR_FILENO, error, strlen(error)));
+        TEMP_FAILURE_RETRY(write(STDERR_FILENO, ")\n", 2));
         // Must call _exit (instead of exit), otherwise it will corrupt the zip
         // file.
         _exit(EXIT_FAILURE);
@@ -40,6 +40,7 @@
 #include <regex>
 #include <set>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -729,6 +730,43 @@ static const std::set<std::string> PROBLEMATIC_FILE_EXTENSIONS = {
       ".shb", ".sys", ".vb",  ".vbe", ".vbs", ".vxd", ".wsc", ".wsf", ".wsh"
 };
 
+// Entries queued for the zip thread before AddZipEntry() blocks, which bounds the open fds.
+static const size_t kMaxQueuedZipEntries = 16;
+
+void Dumpstate::QueueZipEntry(ZipEntryRequest request) {
+    std::unique_lock<std::mutex> lock(zip_queue_lock_);
+    zip_queue_changed_.wait(lock, [this] { return zip_queue_.size() < kMaxQueuedZipEntries; });
+    zip_queue_.push_back(std::move(request));
+    if (!zip_queue_running_) {
+        zip_queue_running_ = true;
+        std::thread(&Dumpstate::RunZipQueue, this).detach();
+    }
+}
+
+void Dumpstate::RunZipQueue() {
+    std::unique_lock<std::mutex> lock(zip_queue_lock_);
+    while (!zip_queue_.empty()) {
+        ZipEntryRequest request = std::move(zip_queue_.front());
+        zip_queue_.pop_front();
+        zip_queue_changed_.notify_all();
+        lock.unlock();
+        if (request.fd == -1) {
+            WriteTextZipEntry(request.name, request.content);
+        } else if (WriteZipEntryFromFd(request.name, request.fd.get(), 0ms) != OK) {
+            MYLOGE("Unable to add %s to zip file\n", request.name.c_str());
+        }
+        request.fd.reset();
+        lock.lock();
+    }
+    zip_queue_running_ = false;
+    zip_queue_changed_.notify_all();
+}
+
+void Dumpstate::WaitForZipEntries() {
+    std::unique_lock<std::mutex> lock(zip_queue_lock_);
+    zip_queue_changed_.wait(lock, [this] { return !zip_queue_running_; });
+}
+
 status_t Dumpstate::AddZipEntryFromFd(const std::string& entry_name, int fd,
                                       std::chrono::milliseconds timeout = 0ms) {
     if (!IsZipping()) {
@@ -736,6 +774,13 @@ status_t Dumpstate::AddZipEntryFromFd(const std::string& entry_name, int fd,
                entry_name.c_str());
         return INVALID_OPERATION;
     }
+    // The fd belongs to the caller, so the entry is written right away.
+    WaitForZipEntries();
+    return WriteZipEntryFromFd(entry_name, fd, timeout);
+}
+
+status_t Dumpstate::WriteZipEntryFromFd(const std::string& entry_name, int fd,
+                                        std::chrono::milliseconds timeout) {
     std::string valid_name = entry_name;
 
     // Rename extension if necessary.
@@ -807,6 +852,15 @@ status_t Dumpstate::AddZipEntryFromFd(const std::string& entry_name, int fd,
     return OK;
 }
 
+/*
+ * Only regular files with a known size are compressed in the background: the contents of files
+ * such as the ones in /proc are generated as they are read, and could be gone by then.
+ */
+static bool can_queue_zip_entry(int fd) {
+    struct stat st;
+    return fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0;
+}
+
 bool Dumpstate::AddZipEntry(const std::string& entry_name, const std::string& entry_path) {
     android::base::unique_fd fd(
         TEMP_FAILURE_RETRY(open(entry_path.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC)));
@@ -815,11 +869,25 @@ bool Dumpstate::AddZipEntry(const std::string& entry_name, const std::string& en
         return false;
     }
 
+    return AddZipEntryFromOwnedFd(entry_name, std::move(fd));
+}
+
+bool Dumpstate::AddZipEntryFromOwnedFd(const std::string& entry_name,
+                                       android::base::unique_fd fd) {
+    if (IsZipping() && can_queue_zip_entry(fd.get())) {
+        QueueZipEntry({entry_name, std::move(fd), ""});
+        return true;
+    }
     return (AddZipEntryFromFd(entry_name, fd.get()) == OK);
 }
 
 /* adds a file to the existing zipped bugreport */
 static int _add_file_from_fd(const char* title __attribute__((unused)), const char* path, int fd) {
+    // dump_files() closes its fd once this returns.
+    android::base::unique_fd copy(fcntl(fd, F_DUPFD_CLOEXEC, 0));
+    if (copy != -1) {
+        return ds.AddZipEntryFromOwnedFd(ZIP_ROOT_DIR + path, std::move(copy)) ? 0 : 1;
+    }
     return (ds.AddZipEntryFromFd(ZIP_ROOT_DIR + path, fd) == OK) ? 0 : 1;
 }
 
@@ -839,6 +907,11 @@ bool Dumpstate::AddTextZipEntry(const std::string& entry_name, const std::string
                entry_name.c_str());
         return false;
     }
+    QueueZipEntry({entry_name, android::base::unique_fd(), content});
+    return true;
+}
+
+bool Dumpstate::WriteTextZipEntry(const std::string& entry_name, const std::string& content) {
     MYLOGD("Adding zip text entry %s\n", entry_name.c_str());
     int32_t err = zip_writer_->StartEntryWithTime(entry_name.c_str(), ZipWriter::kCompress, ds.now_);
     if (err != 0) {
@@ -1296,22 +1369,24 @@ static void dumpstate() {
     DumpFile("MEMORY INFO", "/proc/meminfo");
     RunCommand("CPU INFO", {"top", "-b", "-n", "1", "-H", "-s", "6", "-o",
                             "pid,tid,user,pr,ni,%cpu,s,virt,res,pcy,cmd,name"});
-    RunCommand("PROCRANK", {"procrank"}, AS_ROOT_20);
-    DumpFile("VIRTUAL MEMORY STATS", "/proc/vmstat");
-    DumpFile("VMALLOC INFO", "/proc/vmallocinfo");
-    DumpFile("SLAB INFO", "/proc/slabinfo");
-    DumpFile("ZONEINFO", "/proc/zoneinfo");
-    DumpFile("PAGETYPEINFO", "/proc/pagetypeinfo");
-    DumpFile("BUDDYINFO", "/proc/buddyinfo");
-    DumpFile("FRAGMENTATION INFO", "/d/extfrag/unusable_index");
-
-    DumpFile("KERNEL WAKE SOURCES", "/d/wakeup_sources");
-    DumpFile("KERNEL CPUFREQ", "/sys/devices/system/cpu/cpu0/cpufreq/stats/time_in_state");
-    DumpFile("KERNEL SYNC", "/d/sync");
-
-    RunCommand("PROCESSES AND THREADS",
-               {"ps", "-A", "-T", "-Z", "-O", "pri,nice,rtprio,sched,pcy,time"});
-    RunCommand("LIBRANK", {"librank"}, CommandOptions::AS_ROOT);
+    // None of these depend on each other, and procrank and librank take a while.
+    ds.RunSectionsInParallel({
+        Dumpstate::CommandSection("PROCRANK", {"procrank"}, AS_ROOT_20),
+        Dumpstate::FileSection("VIRTUAL MEMORY STATS", "/proc/vmstat"),
+        Dumpstate::FileSection("VMALLOC INFO", "/proc/vmallocinfo"),
+        Dumpstate::FileSection("SLAB INFO", "/proc/slabinfo"),
+        Dumpstate::FileSection("ZONEINFO", "/proc/zoneinfo"),
+        Dumpstate::FileSection("PAGETYPEINFO", "/proc/pagetypeinfo"),
+        Dumpstate::FileSection("BUDDYINFO", "/proc/buddyinfo"),
+        Dumpstate::FileSection("FRAGMENTATION INFO", "/d/extfrag/unusable_index"),
+        Dumpstate::FileSection("KERNEL WAKE SOURCES", "/d/wakeup_sources"),
+        Dumpstate::FileSection("KERNEL CPUFREQ",
+                               "/sys/devices/system/cpu/cpu0/cpufreq/stats/time_in_state"),
+        Dumpstate::FileSection("KERNEL SYNC", "/d/sync"),
+        Dumpstate::CommandSection("PROCESSES AND THREADS",
+                                  {"ps", "-A", "-T", "-Z", "-O", "pri,nice,rtprio,sched,pcy,time"}),
+        Dumpstate::CommandSection("LIBRANK", {"librank"}, CommandOptions::AS_ROOT),
+    });
 
     if (ds.IsZipping()) {
         RunCommand("HARDWARE HALS", {"lshal"}, CommandOptions::WithTimeout(2).AsRootIfAvailable().Build());
@@ -1369,19 +1444,20 @@ static void dumpstate() {
 
     dump_route_tables();
 
-    RunCommand("ARP CACHE", {"ip", "-4", "neigh", "show"});
-    RunCommand("IPv6 ND CACHE", {"ip", "-6", "neigh", "show"});
-    RunCommand("MULTICAST ADDRESSES", {"ip", "maddr"});
+    ds.RunSectionsInParallel({
+        Dumpstate::CommandSection("ARP CACHE", {"ip", "-4", "neigh", "show"}),
+        Dumpstate::CommandSection("IPv6 ND CACHE", {"ip", "-6", "neigh", "show"}),
+        Dumpstate::CommandSection("MULTICAST ADDRESSES", {"ip", "maddr"}),
+    });
 
     RunDumpsysHigh();
 
-    RunCommand("SYSTEM PROPERTIES", {"getprop"});
-
-    RunCommand("STORAGED IO INFO", {"storaged", "-u", "-p"});
-
-    RunCommand("FILESYSTEMS & FREE SPACE", {"df"});
-
-    RunCommand("LAST RADIO LOG", {"parse_radio_log", "/proc/last_radio_log"});
+    ds.RunSectionsInParallel({
+        Dumpstate::CommandSection("SYSTEM PROPERTIES", {"getprop"}),
+        Dumpstate::CommandSection("STORAGED IO INFO", {"storaged", "-u", "-p"}),
+        Dumpstate::CommandSection("FILESYSTEMS & FREE SPACE", {"df"}),
+        Dumpstate::CommandSection("LAST RADIO LOG", {"parse_radio_log", "/proc/last_radio_log"}),
+    });
 
     /* Binder state is expensive to look at as it uses a lot of memory. */
     DumpFile("BINDER FAILED TRANSACTION LOG", "/sys/kernel/debug/binder/failed_transaction_log");
@@ -1733,6 +1809,7 @@ bool Dumpstate::FinishZipFile() {
         MYLOGE("Failed to add dumpstate log to .zip file\n");
         return false;
     }
+    WaitForZipEntries();
     // ... and re-opens it for further logging.
     redirect_to_existing_file(stderr, const_cast<char*>(ds.log_path_.c_str()));
     fprintf(stderr, "\n");
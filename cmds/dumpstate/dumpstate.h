@@ -22,6 +22,10 @@
 #include <stdbool.h>
 #include <stdio.h>
 
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -228,8 +232,38 @@ class Dumpstate {
      */
     int DumpFile(const std::string& title, const std::string& path);
 
+    /*
+     * A section that doesn't depend on any other, as used by RunSectionsInParallel().
+     */
+    struct Section {
+        std::string title;
+        // Dumps the section on the given fd, returning its status.
+        std::function<int(int fd)> dump;
+        // Weight of the section in the overall progress.
+        int32_t weight;
+    };
+
+    /* Creates a section that runs a command like RunCommand() does. */
+    static Section CommandSection(const std::string& title,
+                                  const std::vector<std::string>& full_command,
+                                  const android::os::dumpstate::CommandOptions& options =
+                                      android::os::dumpstate::CommandOptions::DEFAULT);
+
+    /* Creates a section that prints a file like DumpFile() does. */
+    static Section FileSection(const std::string& title, const std::string& path);
+
+    /*
+     * Dumps independent sections on a few threads at once. The output of each section is
+     * buffered and then printed on `stdout` in the given order, so the report reads as if they
+     * ran one after another. The duration of each section is reported to the listener.
+     */
+    void RunSectionsInParallel(const std::vector<Section>& sections);
+
     /*
      * Adds a new entry to the existing zip file.
+     *
+     * Regular files are compressed in the background while the caller goes on with the next
+     * section, so failures past opening the file are only logged.
      * */
     bool AddZipEntry(const std::string& entry_name, const std::string& entry_path);
 
@@ -245,10 +279,22 @@ class Dumpstate {
                                         std::chrono::milliseconds timeout);
 
     /*
-     * Adds a text entry entry to the existing zip file.
+     * Adds a new entry to the existing zip file from a file whose fd the zip file takes over, so
+     * that it can be compressed in the background like in AddZipEntry().
+     */
+    bool AddZipEntryFromOwnedFd(const std::string& entry_name, android::base::unique_fd fd);
+
+    /*
+     * Adds a text entry entry to the existing zip file. The entry is compressed in the
+     * background.
      */
     bool AddTextZipEntry(const std::string& entry_name, const std::string& content);
 
+    /*
+     * Waits until the entries queued by AddZipEntry() and AddTextZipEntry() are written.
+     */
+    void WaitForZipEntries();
+
     /*
      * Adds all files from a directory to the zipped bugreport file.
      */
@@ -372,9 +418,33 @@ class Dumpstate {
     std::vector<DumpData> anr_data_;
 
   private:
+    // An entry waiting to be written by the zip thread; text entries have no fd.
+    struct ZipEntryRequest {
+        std::string name;
+        android::base::unique_fd fd;
+        std::string content;
+    };
+
     // Used by GetInstance() only.
     Dumpstate(const std::string& version = VERSION_CURRENT);
 
+    // Queues an entry for the zip thread, starting it if needed.
+    void QueueZipEntry(ZipEntryRequest request);
+
+    // Writes queued entries until there are none left.
+    void RunZipQueue();
+
+    android::status_t WriteZipEntryFromFd(const std::string& entry_name, int fd,
+                                          std::chrono::milliseconds timeout);
+    bool WriteTextZipEntry(const std::string& entry_name, const std::string& content);
+
+    // Entries not written yet, and whether the zip thread is running. zip_writer_ is only used
+    // by the zip thread while it runs.
+    std::mutex zip_queue_lock_;
+    std::condition_variable zip_queue_changed_;
+    std::deque<ZipEntryRequest> zip_queue_;
+    bool zip_queue_running_ = false;
+
     DISALLOW_COPY_AND_ASSIGN(Dumpstate);
 };
 
@@ -38,9 +38,14 @@
 #include <time.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
 #include <memory>
+#include <mutex>
 #include <set>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include <android-base/file.h>
@@ -56,10 +61,12 @@
 #include <private/android_filesystem_config.h>
 
 #include "DumpstateInternal.h"
+#include "DumpstateSectionReporter.h"
 
 // TODO: remove once moved to namespace
 using android::os::dumpstate::CommandOptions;
 using android::os::dumpstate::DumpFileToFd;
+using android::os::dumpstate::DumpstateSectionReporter;
 using android::os::dumpstate::PropertiesHelper;
 
 // Keep in sync with
@@ -698,6 +705,88 @@ void Dumpstate::RunDumpsys(const std::string& title, const std::vector<std::stri
     RunCommand(title, dumpsys, options);
 }
 
+/* Sections dumped at the same time by RunSectionsInParallel(). */
+static const size_t kMaxParallelSections = 4;
+
+Dumpstate::Section Dumpstate::CommandSection(const std::string& title,
+                                             const std::vector<std::string>& full_command,
+                                             const CommandOptions& options) {
+    return {title,
+            [title, full_command, options](int fd) {
+                return RunCommandToFd(fd, title, full_command, options);
+            },
+            static_cast<int32_t>(options.Timeout())};
+}
+
+Dumpstate::Section Dumpstate::FileSection(const std::string& title, const std::string& path) {
+    return {title, [title, path](int fd) { return DumpFileToFd(fd, title, path); },
+            WEIGHT_FILE};
+}
+
+void Dumpstate::RunSectionsInParallel(const std::vector<Section>& sections) {
+    // Each section is buffered in an unnamed file next to the bugreport.
+    std::vector<android::base::unique_fd> fds;
+    for (size_t i = 0; i < sections.size() && !bugreport_dir_.empty(); i++) {
+        android::base::unique_fd fd(TEMP_FAILURE_RETRY(
+            open(bugreport_dir_.c_str(), O_TMPFILE | O_RDWR | O_CLOEXEC, S_IRUSR | S_IWUSR)));
+        if (fd == -1) {
+            MYLOGE("Could not buffer sections in %s: %s\n", bugreport_dir_.c_str(),
+                   strerror(errno));
+            break;
+        }
+        fds.push_back(std::move(fd));
+    }
+    if (fds.size() != sections.size()) {
+        for (const Section& section : sections) {
+            DurationReporter duration_reporter(section.title);
+            section.dump(STDOUT_FILENO);
+            UpdateProgress(section.weight);
+        }
+        return;
+    }
+
+    std::mutex lock;
+    std::condition_variable done_condition;
+    std::vector<bool> done(sections.size(), false);
+    std::atomic<size_t> next(0);
+    auto worker = [&]() {
+        for (size_t i = next++; i < sections.size(); i = next++) {
+            const Section& section = sections[i];
+            {
+                DumpstateSectionReporter section_reporter(section.title, listener_,
+                                                          report_section_);
+                uint64_t start = Nanotime();
+                int status = section.dump(fds[i].get());
+                section_reporter.setStatus(status == 0 ? android::OK : android::UNKNOWN_ERROR);
+                dprintf(fds[i].get(), "------ %.3fs was the duration of '%s' ------\n",
+                        (float)(Nanotime() - start) / NANOS_PER_SEC, section.title.c_str());
+            }
+            std::lock_guard<std::mutex> guard(lock);
+            done[i] = true;
+            done_condition.notify_all();
+        }
+    };
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < std::min(kMaxParallelSections, sections.size()); i++) {
+        workers.emplace_back(worker);
+    }
+
+    // Print sections as soon as they and all the ones before them are done.
+    for (size_t i = 0; i < sections.size(); i++) {
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            done_condition.wait(guard, [&done, i] { return done[i]; });
+        }
+        lseek(fds[i].get(), 0, SEEK_SET);
+        DumpFileFromFdToFd("", "", fds[i].get(), STDOUT_FILENO, /* dry_run */ false);
+        fds[i].reset();
+        UpdateProgress(sections[i].weight);
+    }
+    for (std::thread& thread : workers) {
+        thread.join();
+    }
+}
+
 int open_socket(const char *service) {
     int s = android_get_control_socket(service);
     if (s < 0) {
@@ -15,8 +15,11 @@
  */
 
 #include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
 #include <iomanip>
+#include <mutex>
 #include <thread>
 
 #include <android-base/file.h>
@@ -59,17 +62,21 @@ static void usage() {
             "usage: dumpsys\n"
             "         To dump all services.\n"
             "or:\n"
-            "       dumpsys [-t TIMEOUT] [--priority LEVEL] [--help | -l | --skip SERVICES | "
-            "SERVICE [ARGS]]\n"
+            "       dumpsys [-t TIMEOUT] [--priority LEVEL] [--parallel N] [--help | -l | "
+            "--skip SERVICES | SERVICE [ARGS]]\n"
             "         --help: shows this help\n"
             "         -l: only list services, do not dump them\n"
             "         -t TIMEOUT_SEC: TIMEOUT to use in seconds instead of default 10 seconds\n"
             "         -T TIMEOUT_MS: TIMEOUT to use in milliseconds instead of default 10 seconds\n"
+            "         --parallel N: dumps up to N services at once; output stays in order\n"
             "         --proto: filter services that support dumping data in proto format. Dumps"
             "               will be in proto format.\n"
             "         --priority LEVEL: filter services based on specified priority\n"
             "               LEVEL must be one of CRITICAL | HIGH | NORMAL\n"
             "         --skip SERVICES: dumps all services but SERVICES (comma-separated list)\n"
+            "         --binder-stats ACTION: instead of dumping, controls the binder transaction\n"
+            "               statistics of the services' processes. ACTION must be one of\n"
+            "               enable | disable | reset | dump\n"
             "         SERVICE [ARGS]: dumps only service SERVICE, optionally passing ARGS to it\n");
 }
 
@@ -98,6 +105,26 @@ static bool ConvertPriorityTypeToBitmask(const String16& type, int& bitmask) {
     return false;
 }
 
+static bool ConvertTransactionStatsAction(const char* action, int32_t& op) {
+    if (!strcmp(action, "dump")) {
+        op = IBinder::TRANSACTION_STATS_DUMP;
+        return true;
+    }
+    if (!strcmp(action, "enable")) {
+        op = IBinder::TRANSACTION_STATS_ENABLE;
+        return true;
+    }
+    if (!strcmp(action, "disable")) {
+        op = IBinder::TRANSACTION_STATS_DISABLE;
+        return true;
+    }
+    if (!strcmp(action, "reset")) {
+        op = IBinder::TRANSACTION_STATS_RESET;
+        return true;
+    }
+    return false;
+}
+
 String16 ConvertBitmaskToPriorityType(int bitmask) {
     if (bitmask == IServiceManager::DUMP_FLAG_PRIORITY_CRITICAL) {
         return String16(PriorityDumper::PRIORITY_ARG_CRITICAL);
@@ -120,12 +147,17 @@ int Dumpsys::main(int argc, char* const argv[]) {
     bool showListOnly = false;
     bool skipServices = false;
     bool asProto = false;
+    bool controlTransactionStats = false;
+    int32_t transactionStatsOp = IBinder::TRANSACTION_STATS_DUMP;
     int timeoutArgMs = 10000;
+    int parallelism = 1;
     int priorityFlags = IServiceManager::DUMP_FLAG_PRIORITY_ALL;
     static struct option longOptions[] = {{"priority", required_argument, 0, 0},
                                           {"proto", no_argument, 0, 0},
                                           {"skip", no_argument, 0, 0},
                                           {"help", no_argument, 0, 0},
+                                          {"binder-stats", required_argument, 0, 0},
+                                          {"parallel", required_argument, 0, 0},
                                           {0, 0, 0, 0}};
 
     // Must reset optind, otherwise subsequent calls will fail (wouldn't happen on main.cpp, but
@@ -157,6 +189,20 @@ int Dumpsys::main(int argc, char* const argv[]) {
                     usage();
                     return -1;
                 }
+            } else if (!strcmp(longOptions[optionIndex].name, "binder-stats")) {
+                controlTransactionStats = true;
+                if (!ConvertTransactionStatsAction(optarg, transactionStatsOp)) {
+                    fprintf(stderr, "\n");
+                    usage();
+                    return -1;
+                }
+            } else if (!strcmp(longOptions[optionIndex].name, "parallel")) {
+                char* endptr;
+                parallelism = strtol(optarg, &endptr, 10);
+                if (*endptr != '\0' || parallelism <= 0) {
+                    fprintf(stderr, "Error: invalid number of parallel dumps: '%s'\n", optarg);
+                    return -1;
+                }
             }
             break;
 
@@ -236,6 +282,36 @@ int Dumpsys::main(int argc, char* const argv[]) {
         return 0;
     }
 
+    if (controlTransactionStats) {
+        for (size_t i = 0; i < N; i++) {
+            if (IsSkipped(skippedServices, services[i])) continue;
+            transactionStats(STDOUT_FILENO, services[i], transactionStatsOp);
+        }
+        return 0;
+    }
+
+    if (parallelism > 1) {
+        Vector<String16> dumpedServices;
+        for (const auto& serviceName : services) {
+            if (!IsSkipped(skippedServices, serviceName)) {
+                dumpedServices.add(serviceName);
+            }
+        }
+        std::vector<ServiceDump> dumps =
+            dumpServices(STDOUT_FILENO, dumpedServices, args, priorityFlags, N > 1,
+                         std::chrono::milliseconds(timeoutArgMs), asProto, parallelism);
+        if (N > 1 && !asProto) {
+            std::string msg("--------- dumpsys durations:\n");
+            for (const auto& dump : dumps) {
+                StringAppendF(&msg, "  %s: %.3fs, %zu bytes%s\n",
+                              String8(dump.serviceName).c_str(), dump.elapsedDuration.count(),
+                              dump.bytesWritten, dump.status == TIMED_OUT ? " (timed out)" : "");
+            }
+            WriteStringToFd(msg, STDOUT_FILENO);
+        }
+        return 0;
+    }
+
     for (size_t i = 0; i < N; i++) {
         const String16& serviceName = services[i];
         if (IsSkipped(skippedServices, serviceName)) continue;
@@ -307,6 +383,33 @@ void Dumpsys::setServiceArgs(Vector<String16>& args, bool asProto, int priorityF
     }
 }
 
+status_t Dumpsys::transactionStats(int fd, const String16& serviceName, int32_t op) const {
+    sp<IBinder> service = sm_->checkService(serviceName);
+    if (service == nullptr) {
+        aerr << "Can't find service: " << serviceName << endl;
+        return NAME_NOT_FOUND;
+    }
+
+    Parcel data;
+    Parcel reply;
+    data.writeInt32(op);
+    status_t err = service->transact(IBinder::TRANSACTION_STATS_TRANSACTION, data, &reply);
+    if (err != OK) {
+        aerr << "Error " << err << " controlling binder stats of " << serviceName << endl;
+        return err;
+    }
+
+    if (op == IBinder::TRANSACTION_STATS_DUMP) {
+        std::string header = StringPrintf("--------- binder stats of %s\n",
+                                          String8(serviceName).c_str());
+        std::string stats = String8(reply.readString16()).c_str();
+        if (!WriteStringToFd(header, fd) || !WriteStringToFd(stats, fd)) {
+            return -errno;
+        }
+    }
+    return OK;
+}
+
 status_t Dumpsys::startDumpThread(const String16& serviceName, const Vector<String16>& args) {
     sp<IBinder> service = sm_->checkService(serviceName);
     if (service == nullptr) {
@@ -353,7 +456,85 @@ void Dumpsys::stopDumpThread(bool dumpComplete) {
     redirectFd_.reset();
 }
 
+std::vector<Dumpsys::ServiceDump> Dumpsys::dumpServices(int fd, const Vector<String16>& services,
+                                                      const Vector<String16>& args,
+                                                      int priorityFlags, bool addSeparator,
+                                                      std::chrono::milliseconds timeout,
+                                                      bool asProto, size_t parallelism) const {
+    struct Buffer {
+        std::string output;
+        bool dumped = false;
+        bool done = false;
+        ServiceDump result;
+    };
+    std::vector<Buffer> buffers(services.size());
+    std::mutex lock;
+    std::condition_variable doneCondition;
+    std::atomic<size_t> next(0);
+
+    auto worker = [&]() {
+        for (size_t i = next++; i < services.size(); i = next++) {
+            // Each dump needs its own thread and pipe.
+            Dumpsys dumper(sm_);
+            Buffer& buffer = buffers[i];
+            buffer.result = {services[i], OK, std::chrono::duration<double>(0), 0};
+            buffer.result.status = dumper.startDumpThread(services[i], args);
+            if (buffer.result.status == OK) {
+                buffer.dumped = true;
+                if (addSeparator) {
+                    buffer.output = getDumpHeader(services[i], priorityFlags);
+                }
+                auto append = [&buffer](const char* data, size_t size) {
+                    buffer.output.append(data, size);
+                    return true;
+                };
+                buffer.result.status =
+                    dumper.copyDump(append, services[i], timeout, asProto,
+                                    buffer.result.elapsedDuration, buffer.result.bytesWritten);
+                if (addSeparator) {
+                    buffer.output += getDumpFooter(services[i], buffer.result.elapsedDuration);
+                }
+                dumper.stopDumpThread(buffer.result.status == OK);
+            }
+
+            std::lock_guard<std::mutex> guard(lock);
+            buffer.done = true;
+            doneCondition.notify_all();
+        }
+    };
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < std::min(std::max(parallelism, (size_t) 1), services.size()); i++) {
+        workers.emplace_back(worker);
+    }
+
+    // Write each dump as soon as it and all the ones before it are done.
+    std::vector<ServiceDump> results;
+    for (size_t i = 0; i < buffers.size(); i++) {
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            doneCondition.wait(guard, [&buffers, i] { return buffers[i].done; });
+        }
+        if (!buffers[i].dumped) {
+            continue;
+        }
+        if (!WriteStringToFd(buffers[i].output, fd)) {
+            aerr << "Failed to write dump of service " << services[i] << ": " << strerror(errno)
+                 << endl;
+        }
+        std::string().swap(buffers[i].output);
+        results.push_back(buffers[i].result);
+    }
+    for (auto& thread : workers) {
+        thread.join();
+    }
+    return results;
+}
+
 void Dumpsys::writeDumpHeader(int fd, const String16& serviceName, int priorityFlags) const {
+    WriteStringToFd(getDumpHeader(serviceName, priorityFlags), fd);
+}
+
+std::string Dumpsys::getDumpHeader(const String16& serviceName, int priorityFlags) const {
     std::string msg(
         "----------------------------------------"
         "---------------------------------------\n");
@@ -366,12 +547,20 @@ void Dumpsys::writeDumpHeader(int fd, const String16& serviceName, int priorityF
         StringAppendF(&msg, "DUMP OF SERVICE %s %s:\n", String8(priorityType).c_str(),
                       String8(serviceName).c_str());
     }
-    WriteStringToFd(msg, fd);
+    return msg;
 }
 
 status_t Dumpsys::writeDump(int fd, const String16& serviceName, std::chrono::milliseconds timeout,
                             bool asProto, std::chrono::duration<double>& elapsedDuration,
                             size_t& bytesWritten) const {
+    auto writeOutput = [fd](const char* data, size_t size) { return WriteFully(fd, data, size); };
+    return copyDump(writeOutput, serviceName, timeout, asProto, elapsedDuration, bytesWritten);
+}
+
+status_t Dumpsys::copyDump(const std::function<bool(const char* data, size_t size)>& writeOutput,
+                           const String16& serviceName, std::chrono::milliseconds timeout,
+                           bool asProto, std::chrono::duration<double>& elapsedDuration,
+                           size_t& bytesWritten) const {
     status_t status = OK;
     size_t totalBytes = 0;
     auto start = std::chrono::steady_clock::now();
@@ -415,7 +604,7 @@ status_t Dumpsys::writeDump(int fd, const String16& serviceName, std::chrono::mi
             break;
         }
 
-        if (!WriteFully(fd, buf, rc)) {
+        if (!writeOutput(buf, rc)) {
             aerr << "Failed to write while dumping service " << serviceName << ": "
                  << strerror(errno) << endl;
             status = -errno;
@@ -427,7 +616,7 @@ status_t Dumpsys::writeDump(int fd, const String16& serviceName, std::chrono::mi
     if ((status == TIMED_OUT) && (!asProto)) {
         std::string msg = StringPrintf("\n*** SERVICE '%s' DUMP TIMEOUT (%llums) EXPIRED ***\n\n",
                                        String8(serviceName).string(), timeout.count());
-        WriteStringToFd(msg, fd);
+        writeOutput(msg.c_str(), msg.size());
     }
 
     elapsedDuration = std::chrono::steady_clock::now() - start;
@@ -437,6 +626,11 @@ status_t Dumpsys::writeDump(int fd, const String16& serviceName, std::chrono::mi
 
 void Dumpsys::writeDumpFooter(int fd, const String16& serviceName,
                               const std::chrono::duration<double>& elapsedDuration) const {
+    WriteStringToFd(getDumpFooter(serviceName, elapsedDuration), fd);
+}
+
+std::string Dumpsys::getDumpFooter(const String16& serviceName,
+                                   const std::chrono::duration<double>& elapsedDuration) const {
     using std::chrono::system_clock;
     const auto finish = system_clock::to_time_t(system_clock::now());
     std::tm finish_tm;
@@ -446,5 +640,5 @@ void Dumpsys::writeDumpFooter(int fd, const String16& serviceName,
     std::string msg =
         StringPrintf("--------- %.3fs was the duration of dumpsys %s, ending at: %s\n",
                      elapsedDuration.count(), String8(serviceName).string(), oss.str().c_str());
-    WriteStringToFd(msg, fd);
+    return msg;
 }
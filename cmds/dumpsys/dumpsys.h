@@ -17,7 +17,10 @@
 #ifndef FRAMEWORK_NATIVE_CMD_DUMPSYS_H_
 #define FRAMEWORK_NATIVE_CMD_DUMPSYS_H_
 
+#include <functional>
+#include <string>
 #include <thread>
+#include <vector>
 
 #include <android-base/unique_fd.h>
 #include <binder/IServiceManager.h>
@@ -91,6 +94,35 @@ class Dumpsys {
                        bool asProto, std::chrono::duration<double>& elapsedDuration,
                        size_t& bytesWritten) const;
 
+    /**
+     * Outcome of dumping one service with {@code dumpServices}.
+     */
+    struct ServiceDump {
+        String16 serviceName;
+        status_t status;
+        std::chrono::duration<double> elapsedDuration;
+        size_t bytesWritten;
+    };
+
+    /**
+     * Dumps services on up to {@code parallelism} threads at once, each into its own buffer in
+     * memory, and writes them to a file descriptor in the given order, with a header and a
+     * footer for each of them if {@code addSeparator} is set. Services that aren't running
+     * are skipped.
+     * @param fd file descriptor to write data
+     * @param services services to dump
+     * @param args list of arguments to pass to service dump method.
+     * @param priorityFlags dump priority specified
+     * @param timeout timeout to terminate each dump if not completed
+     * @param asProto used to supresses additional output to the fd such as timeout
+     * error messages
+     * @return the outcome of each dump, in the order of {@code services}
+     */
+    std::vector<ServiceDump> dumpServices(int fd, const Vector<String16>& services,
+                                          const Vector<String16>& args, int priorityFlags,
+                                          bool addSeparator, std::chrono::milliseconds timeout,
+                                          bool asProto, size_t parallelism) const;
+
     /**
      * Writes a section footer to a file descriptor with duration info.
      * @param fd file descriptor to write data
@@ -107,6 +139,18 @@ class Dumpsys {
      */
     void stopDumpThread(bool dumpComplete);
 
+    /**
+     * Sends a IBinder::TRANSACTION_STATS_TRANSACTION to a service, and writes the statistics
+     * to a file descriptor if {@code op} is {@code IBinder::TRANSACTION_STATS_DUMP}.
+     * @param fd file descriptor to write data
+     * @param serviceName
+     * @param op one of the IBinder::TRANSACTION_STATS_* operations
+     * @return {@code OK} if successful
+     *         {@code NAME_NOT_FOUND} service could not be found.
+     *         {@code != OK} error
+     */
+    status_t transactionStats(int fd, const String16& serviceName, int32_t op) const;
+
     /**
      * Returns file descriptor of the pipe used to dump service data. This assumes
      * {@code startDumpThread} was called successfully.
@@ -116,6 +160,16 @@ class Dumpsys {
     }
 
   private:
+    std::string getDumpHeader(const String16& serviceName, int priorityFlags) const;
+    std::string getDumpFooter(const String16& serviceName,
+                              const std::chrono::duration<double>& elapsedDuration) const;
+
+    // Same as writeDump, but hands the output to a function that returns false on error.
+    status_t copyDump(const std::function<bool(const char* data, size_t size)>& writeOutput,
+                      const String16& serviceName, std::chrono::milliseconds timeout,
+                      bool asProto, std::chrono::duration<double>& elapsedDuration,
+                      size_t& bytesWritten) const;
+
     android::IServiceManager* sm_;
     std::thread activeThread_;
     mutable android::base::unique_fd redirectFd_;
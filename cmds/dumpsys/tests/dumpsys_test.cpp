@@ -35,6 +35,7 @@ using ::testing::ActionInterface;
 using ::testing::DoAll;
 using ::testing::Eq;
 using ::testing::HasSubstr;
+using ::testing::Lt;
 using ::testing::MakeAction;
 using ::testing::Mock;
 using ::testing::Not;
@@ -236,6 +237,10 @@ class DumpsysTest : public Test {
         EXPECT_THAT(stdout_, HasSubstr("was the duration of dumpsys " + service + ", ending at: "));
     }
 
+    void AssertDumpedBefore(const std::string& first, const std::string& second) {
+        EXPECT_THAT(stdout_.find(first), Lt(stdout_.find(second)));
+    }
+
     void AssertNotDumped(const std::string& dump) {
         EXPECT_THAT(stdout_, Not(HasSubstr(dump)));
     }
@@ -425,6 +430,24 @@ TEST_F(DumpsysTest, DumpMultipleServices) {
     AssertDumped("running3", "dump3");
 }
 
+// Tests 'dumpsys --parallel 2', which should keep the order of the services
+TEST_F(DumpsysTest, DumpMultipleServicesInParallel) {
+    ExpectListServices({"running1", "stopped2", "running3"});
+    ExpectDumpAndHang("running1", 1, "dump1");
+    ExpectCheckService("stopped2", false);
+    ExpectDump("running3", "dump3");
+
+    CallMain({"--parallel", "2"});
+
+    AssertRunningServices({"running1", "running3"});
+    AssertDumped("running1", "dump1");
+    AssertStopped("stopped2");
+    AssertDumped("running3", "dump3");
+    AssertDumpedBefore("dump1", "dump3");
+    AssertOutputContains("--------- dumpsys durations:\n  running1: ");
+    AssertOutputContains("s, 5 bytes\n  running3: ");
+}
+
 // Tests 'dumpsys --skip skipped3 skipped5', which should skip these services
 TEST_F(DumpsysTest, DumpWithSkip) {
     ExpectListServices({"running1", "stopped2", "skipped3", "running4", "skipped5"});
@@ -539,6 +562,22 @@ TEST_F(DumpsysTest, DumpWithPriorityHighAndProto) {
     AssertDumpedWithPriority("runninghigh2", "dump2", PriorityDumper::PRIORITY_ARG_HIGH);
 }
 
+// Tests 'dumpsys --binder-stats enable|dump|disable service'
+TEST_F(DumpsysTest, ControlTransactionStats) {
+    ExpectCheckService("Locksmith");
+
+    CallMain({"--binder-stats", "enable", "Locksmith"});
+    AssertOutput("");
+
+    CallMain({"--binder-stats", "dump", "Locksmith"});
+    AssertOutputContains("--------- binder stats of Locksmith\n");
+    AssertOutputContains("(enabled)");
+
+    CallMain({"--binder-stats", "disable", "Locksmith"});
+    CallMain({"--binder-stats", "dump", "Locksmith"});
+    AssertOutputContains("(disabled)");
+}
+
 TEST_F(DumpsysTest, GetBytesWritten) {
     const char* serviceName = "service2";
     const char* dumpContents = "dump1";
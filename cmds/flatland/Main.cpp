@@ -36,6 +36,7 @@ using namespace ::android;
 
 static uint32_t g_SleepBetweenSamplesMs = 0;
 static bool     g_PresentToWindow       = false;
+static bool     g_CsvOutput             = false;
 static size_t   g_BenchmarkNameLen      = 0;
 
 struct BenchmarkDesc {
@@ -457,13 +458,19 @@ public:
         }
     }
 
-    nsecs_t run(uint32_t warmUpFrames, uint32_t totalFrames) {
+    // Returns the GPU time of the timed frames, and the CPU time this process
+    // (including its driver threads) spent per frame in cpuTimePerFrame.
+    nsecs_t run(uint32_t warmUpFrames, uint32_t totalFrames,
+            double* cpuTimePerFrame) {
         ATRACE_CALL();
 
         bool result;
 
         resetColorGenerator();
 
+        nsecs_t startCpuTime = systemTime(SYSTEM_TIME_PROCESS);
+        uint32_t frames = totalFrames;
+
         // Do the warm-up frames.
         for (uint32_t i = 0; i < warmUpFrames; i++) {
             result = doFrame(mSurface);
@@ -492,8 +499,12 @@ public:
             if (!result) {
                 return -1;
             }
+            frames++;
         }
 
+        *cpuTimePerFrame = double(systemTime(SYSTEM_TIME_PROCESS) - startCpuTime) /
+                double(frames);
+
         // Compute the time delta.
         nsecs_t startTime = startFence->getSignalTime();
         nsecs_t endTime = endFence->getSignalTime();
@@ -591,12 +602,17 @@ static bool runTest(const BenchmarkDesc b, size_t run) {
     bool success = true;
     double prevResult = 0.0, result = 0.0;
     Vector<double> samples;
+    double cpuTimePerFrame = 0.0, cpuTimeTotal = 0.0;
+    size_t cpuSamples = 0;
+    const char* status = NULL;
 
     uint32_t runHeight = b.runHeights[run];
     uint32_t runWidth = b.width * runHeight / b.height;
-    printf(" %-*s | %4d x %4d | ", static_cast<int>(g_BenchmarkNameLen), b.name,
-            runWidth, runHeight);
-    fflush(stdout);
+    if (!g_CsvOutput) {
+        printf(" %-*s | %4d x %4d | ", static_cast<int>(g_BenchmarkNameLen), b.name,
+                runWidth, runHeight);
+        fflush(stdout);
+    }
 
     BenchmarkRunner r(b, run);
     if (!r.setUp()) {
@@ -615,7 +631,7 @@ static bool runTest(const BenchmarkDesc b, size_t run) {
     // Find the number of frames needed to run for over 100ms.
     double runTime = 0.0;
     while (true) {
-        runTime = double(r.run(warmUpFrames, totalFrames));
+        runTime = double(r.run(warmUpFrames, totalFrames, &cpuTimePerFrame));
         if (runTime < 50e6) {
             warmUpFrames *= 2;
             totalFrames *= 2;
@@ -627,11 +643,11 @@ static bool runTest(const BenchmarkDesc b, size_t run) {
 
     if (totalFrames - warmUpFrames > 16) {
         // The test runs too fast to get a stable result.  Skip it.
-        printf("  fast");
+        status = "fast";
         goto done;
     } else if (totalFrames == 5 && runTime > 200e6) {
         // The test runs too slow to be very useful.  Skip it.
-        printf("  slow");
+        status = "slow";
         goto done;
     }
 
@@ -642,12 +658,14 @@ static bool runTest(const BenchmarkDesc b, size_t run) {
         }
 
         if (newSamples > 512) {
-            printf("varies");
+            status = "varies";
             goto done;
         }
 
         for (size_t i = 0; i < newSamples; i++) {
-            double sample = double(r.run(warmUpFrames, totalFrames));
+            double sample = double(r.run(warmUpFrames, totalFrames, &cpuTimePerFrame));
+            cpuTimeTotal += cpuTimePerFrame;
+            cpuSamples++;
 
             if (g_SleepBetweenSamplesMs > 0) {
                 usleep(g_SleepBetweenSamplesMs  * 1000);
@@ -668,11 +686,26 @@ static bool runTest(const BenchmarkDesc b, size_t run) {
         result = (samples[elem-1] + samples[elem]) * 0.5;
     } while (fabs(result - prevResult) > threshold * result);
 
-    printf("%6.3f", result / double(totalFrames - warmUpFrames) / 1e6);
+    status = "ok";
+    result /= double(totalFrames - warmUpFrames);
 
 done:
 
-    printf("\n");
+    if (g_CsvOutput) {
+        if (status != NULL && strcmp(status, "ok") == 0) {
+            printf("%s,%u,%u,%s,%.3f,%.3f\n", b.name, runWidth, runHeight, status,
+                    result / 1e6, cpuTimeTotal / double(cpuSamples) / 1e6);
+        } else if (status != NULL) {
+            printf("%s,%u,%u,%s,,\n", b.name, runWidth, runHeight, status);
+        }
+    } else {
+        if (status != NULL && strcmp(status, "ok") == 0) {
+            printf("%6.3f", result / 1e6);
+        } else if (status != NULL) {
+            printf("%6s", status);
+        }
+        printf("\n");
+    }
     fflush(stdout);
     r.tearDown();
 
@@ -691,7 +724,11 @@ static void printResultsTableHeader() {
 
 // Run ALL the benchmarks!
 static bool runTests() {
-    printResultsTableHeader();
+    if (g_CsvOutput) {
+        printf("scenario,width,height,status,frame_ms,cpu_ms\n");
+    } else {
+        printResultsTableHeader();
+    }
 
     for (size_t i = 0; i < NELEMS(benchmarks); i++) {
         const BenchmarkDesc& b = benchmarks[i];
@@ -723,6 +760,7 @@ static void showHelp(const char *cmd) {
     fprintf(stderr, "options include:\n"
                     "  -s N            sleep for N ms between samples\n"
                     "  -d              display the test frame to a window\n"
+                    "  -c              print the results as CSV, with the CPU time per frame\n"
                     "  --help          print this helpful message and exit\n"
             );
 }
@@ -741,7 +779,7 @@ int main(int argc, char** argv) {
             {     0,               0, 0,  0 }
         };
 
-        ret = getopt_long(argc, argv, "ds:",
+        ret = getopt_long(argc, argv, "cds:",
                           long_options, &option_index);
 
         if (ret < 0) {
@@ -749,6 +787,10 @@ int main(int argc, char** argv) {
         }
 
         switch(ret) {
+            case 'c':
+                g_CsvOutput = true;
+            break;
+
             case 'd':
                 g_PresentToWindow = true;
             break;
@@ -772,11 +814,13 @@ int main(int argc, char** argv) {
 
     g_BenchmarkNameLen = maxBenchmarkNameLen();
 
-    printf(" cmdline:");
-    for (int i = 0; i < argc; i++) {
-        printf(" %s", argv[i]);
+    if (!g_CsvOutput) {
+        printf(" cmdline:");
+        for (int i = 0; i < argc; i++) {
+            printf(" %s", argv[i]);
+        }
+        printf("\n");
     }
-    printf("\n");
 
     if (!runTests()) {
         fprintf(stderr, "exiting due to error.\n");
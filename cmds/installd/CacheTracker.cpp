@@ -33,9 +33,22 @@ using android::base::StringPrintf;
 namespace android {
 namespace installd {
 
-CacheTracker::CacheTracker(userid_t userId, appid_t appId, const std::string& quotaDevice) :
+bool CacheSnapshot::isCurrent() const {
+    struct stat s;
+    for (const auto& dir : directories) {
+        if (lstat(dir.path.c_str(), &s) != 0 || s.st_ino != dir.ino
+                || s.st_ctim.tv_sec != dir.ctime.tv_sec
+                || s.st_ctim.tv_nsec != dir.ctime.tv_nsec) {
+            return false;
+        }
+    }
+    return true;
+}
+
+CacheTracker::CacheTracker(userid_t userId, appid_t appId, const std::string& quotaDevice,
+        CacheSnapshotMap* snapshots) :
         cacheUsed(0), cacheQuota(0), mUserId(userId), mAppId(appId), mQuotaDevice(quotaDevice),
-        mItemsLoaded(false) {
+        mItemsLoaded(false), mSnapshots(snapshots) {
 }
 
 CacheTracker::~CacheTracker() {
@@ -99,7 +112,42 @@ bool CacheTracker::loadQuotaStats() {
     }
 }
 
+/**
+ * Remembers the directories seen while loading, so we can later tell whether
+ * the snapshot is still current. Returns false for entries we failed to read,
+ * after which the snapshot can't be trusted.
+ */
+static bool addSnapshotEntry(CacheSnapshot* snapshot, FTSENT* p) {
+    switch (p->fts_info) {
+    case FTS_D:
+        snapshot->directories.push_back(
+                { p->fts_path, p->fts_statp->st_ino, p->fts_statp->st_ctim });
+        return true;
+    case FTS_DNR:
+    case FTS_ERR:
+    case FTS_NS:
+        return false;
+    default:
+        return true;
+    }
+}
+
 void CacheTracker::loadItemsFrom(const std::string& path) {
+    // Reuse what we loaded last time when nothing has changed since; file
+    // sizes may have drifted, but freeCache() checks free space as it goes
+    mItemPaths.push_back(path);
+    if (mSnapshots) {
+        auto search = mSnapshots->find(path);
+        if (search != mSnapshots->end()) {
+            if (search->second->isCurrent()) {
+                const auto& cached = search->second->items;
+                items.insert(items.end(), cached.begin(), cached.end());
+                return;
+            }
+            mSnapshots->erase(search);
+        }
+    }
+
     FTS *fts;
     FTSENT *p;
     char *argv[] = { (char*) path.c_str(), nullptr };
@@ -107,7 +155,10 @@ void CacheTracker::loadItemsFrom(const std::string& path) {
         PLOG(WARNING) << "Failed to fts_open " << path;
         return;
     }
+    auto snapshot = std::make_shared<CacheSnapshot>();
+    bool complete = true;
     while ((p = fts_read(fts)) != nullptr) {
+        complete &= addSnapshotEntry(snapshot.get(), p);
         if (p->fts_level == 0) continue;
 
         // Create tracking nodes for everything we encounter
@@ -119,7 +170,7 @@ void CacheTracker::loadItemsFrom(const std::string& path) {
         case FTS_SLNONE: {
             auto item = std::shared_ptr<CacheItem>(new CacheItem(p));
             p->fts_pointer = static_cast<void*>(item.get());
-            items.push_back(item);
+            snapshot->items.push_back(item);
         }
         }
 
@@ -133,6 +184,7 @@ void CacheTracker::loadItemsFrom(const std::string& path) {
             if (item->group) {
                 while ((p = fts_read(fts)) != nullptr) {
                     if (p->fts_info == FTS_DP && p->fts_level == item->level) break;
+                    complete &= addSnapshotEntry(snapshot.get(), p);
                     switch (p->fts_info) {
                     case FTS_D:
                     case FTS_DEFAULT:
@@ -164,10 +216,16 @@ void CacheTracker::loadItemsFrom(const std::string& path) {
         }
     }
     fts_close(fts);
+
+    items.insert(items.end(), snapshot->items.begin(), snapshot->items.end());
+    if (mSnapshots && complete) {
+        (*mSnapshots)[path] = snapshot;
+    }
 }
 
 void CacheTracker::loadItems() {
     items.clear();
+    mItemPaths.clear();
 
     ATRACE_BEGIN("loadItems");
     for (const auto& path : mDataPaths) {
@@ -192,6 +250,14 @@ void CacheTracker::loadItems() {
     ATRACE_END();
 }
 
+void CacheTracker::invalidateItems() {
+    if (mSnapshots) {
+        for (const auto& path : mItemPaths) {
+            mSnapshots->erase(path);
+        }
+    }
+}
+
 void CacheTracker::ensureItems() {
     if (mItemsLoaded) {
         return;
@@ -20,6 +20,8 @@
 #include <memory>
 #include <string>
 #include <queue>
+#include <unordered_map>
+#include <vector>
 
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -32,6 +34,27 @@
 namespace android {
 namespace installd {
 
+/**
+ * Items loaded from a single cache directory. They stay valid for as long as
+ * no directory in the tree has changed since, which catches files being
+ * created, removed, renamed or marked with the group and tombstone xattrs.
+ */
+struct CacheSnapshot {
+    struct Directory {
+        std::string path;
+        ino_t ino;
+        struct timespec ctime;
+    };
+
+    std::vector<std::shared_ptr<CacheItem>> items;
+    std::vector<Directory> directories;
+
+    bool isCurrent() const;
+};
+
+/* Map from cache directory path to the snapshot last loaded from it */
+typedef std::unordered_map<std::string, std::shared_ptr<CacheSnapshot>> CacheSnapshotMap;
+
 /**
  * Cache tracker for a single UID. Each tracker is used in two modes: first
  * for loading lightweight "stats", and then by loading detailed "items"
@@ -39,7 +62,8 @@ namespace installd {
  */
 class CacheTracker {
 public:
-    CacheTracker(userid_t userId, appid_t appId, const std::string& quotaDevice);
+    CacheTracker(userid_t userId, appid_t appId, const std::string& quotaDevice,
+            CacheSnapshotMap* snapshots = nullptr);
     ~CacheTracker();
 
     std::string toString();
@@ -50,6 +74,8 @@ public:
     void loadItems();
 
     void ensureItems();
+    /* Forgets the snapshots our items came from, such as after purging them */
+    void invalidateItems();
 
     int getCacheRatio();
 
@@ -63,8 +89,10 @@ private:
     appid_t mAppId;
     std::string mQuotaDevice;
     bool mItemsLoaded;
+    CacheSnapshotMap* mSnapshots;
 
     std::vector<std::string> mDataPaths;
+    std::vector<std::string> mItemPaths;
 
     bool loadQuotaStats();
     void loadItemsFrom(const std::string& path);
@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "DexoptScheduler.h"
+
+#include <algorithm>
+#include <vector>
+
+#include <android-base/logging.h>
+
+namespace android {
+namespace installd {
+
+struct DexoptScheduler::Ticket::Job {
+    std::string key;
+    int priority;
+    int threads;
+    int64_t memory;
+    bool admitted;
+    bool cancelled;
+};
+
+DexoptScheduler::Ticket::Ticket(DexoptScheduler* scheduler, std::shared_ptr<Job> job) :
+        mScheduler(scheduler), mJob(std::move(job)) {
+}
+
+DexoptScheduler::Ticket::~Ticket() {
+    mScheduler->leave(mJob);
+}
+
+DexoptScheduler::DexoptScheduler(int threadBudget, int64_t memoryBudget) :
+        mThreadBudget(std::max(threadBudget, 1)), mMemoryBudget(std::max(memoryBudget,
+        (int64_t) 0)), mThreadsUsed(0), mMemoryUsed(0) {
+}
+
+DexoptScheduler::~DexoptScheduler() {
+    CHECK(mWaiting.empty() && mRunning.empty());
+}
+
+std::unique_ptr<DexoptScheduler::Ticket> DexoptScheduler::enter(const std::string& key,
+        int priority, int threads, int64_t memory) {
+    std::unique_lock<std::mutex> lock(mLock);
+
+    // Clamp the cost so that every job fits once it runs alone
+    auto job = std::make_shared<Ticket::Job>();
+    job->key = key;
+    job->priority = priority;
+    job->threads = std::min(std::max(threads, 1), mThreadBudget);
+    job->memory = std::min(std::max(memory, (int64_t) 0), mMemoryBudget);
+    job->admitted = false;
+    job->cancelled = false;
+
+    // Older jobs still waiting for the same key are obsolete; take over the
+    // most urgent priority among them so their callers aren't pushed back
+    bool cancelled = false;
+    for (auto it = mWaiting.begin(); it != mWaiting.end();) {
+        if ((*it)->key == key) {
+            LOG(DEBUG) << "Cancelling obsolete dexopt of " << key;
+            job->priority = std::max(job->priority, (*it)->priority);
+            (*it)->cancelled = true;
+            it = mWaiting.erase(it);
+            cancelled = true;
+        } else {
+            ++it;
+        }
+    }
+    if (cancelled) {
+        mChanged.notify_all();
+    }
+
+    mWaiting.push_back(job);
+    admitLocked();
+    mChanged.wait(lock, [&job] { return job->admitted || job->cancelled; });
+    if (job->cancelled) {
+        return nullptr;
+    }
+    return std::unique_ptr<Ticket>(new Ticket(this, job));
+}
+
+void DexoptScheduler::leave(const std::shared_ptr<Ticket::Job>& job) {
+    std::lock_guard<std::mutex> lock(mLock);
+    mRunning.erase(job->key);
+    mThreadsUsed -= job->threads;
+    mMemoryUsed -= job->memory;
+    admitLocked();
+}
+
+void DexoptScheduler::admitLocked() {
+    std::vector<std::shared_ptr<Ticket::Job>> candidates(mWaiting.begin(), mWaiting.end());
+    std::stable_sort(candidates.begin(), candidates.end(),
+            [](const std::shared_ptr<Ticket::Job>& left,
+                    const std::shared_ptr<Ticket::Job>& right) {
+        return left->priority > right->priority;
+    });
+
+    bool changed = false;
+    for (const auto& job : candidates) {
+        // Never compile the same file twice at once; the job behind it waits
+        if (mRunning.count(job->key)) {
+            continue;
+        }
+        // Stop at the first job that doesn't fit so that it isn't starved by
+        // smaller jobs behind it
+        if (!mRunning.empty() && (mThreadsUsed + job->threads > mThreadBudget
+                || mMemoryUsed + job->memory > mMemoryBudget)) {
+            break;
+        }
+        mRunning.insert(job->key);
+        mThreadsUsed += job->threads;
+        mMemoryUsed += job->memory;
+        job->admitted = true;
+        mWaiting.remove(job);
+        changed = true;
+    }
+    if (changed) {
+        mChanged.notify_all();
+    }
+}
+
+}  // namespace installd
+}  // namespace android
@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_INSTALLD_DEXOPT_SCHEDULER_H
+#define ANDROID_INSTALLD_DEXOPT_SCHEDULER_H
+
+#include <condition_variable>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+
+#include <android-base/macros.h>
+
+namespace android {
+namespace installd {
+
+/**
+ * Admits dexopt jobs so that several of them can compile at once within the
+ * CPU and memory budget of the device. Waiting jobs are admitted in priority
+ * order, and a job still waiting when a newer one arrives for the same key is
+ * cancelled, since the newer one would redo its work anyway.
+ */
+class DexoptScheduler {
+public:
+    enum {
+        PRIORITY_BACKGROUND = 0,
+        PRIORITY_FOREGROUND = 1,
+    };
+
+    /**
+     * Admission of a single job, which keeps its share of the budget until
+     * destroyed.
+     */
+    class Ticket {
+    public:
+        ~Ticket();
+
+    private:
+        friend class DexoptScheduler;
+        struct Job;
+
+        Ticket(DexoptScheduler* scheduler, std::shared_ptr<Job> job);
+
+        DexoptScheduler* mScheduler;
+        std::shared_ptr<Job> mJob;
+
+        DISALLOW_COPY_AND_ASSIGN(Ticket);
+    };
+
+    DexoptScheduler(int threadBudget, int64_t memoryBudget);
+    ~DexoptScheduler();
+
+    /**
+     * Blocks until a job using the given threads and memory may run. Returns
+     * nullptr if a newer job with the same key cancelled it while waiting.
+     */
+    std::unique_ptr<Ticket> enter(const std::string& key, int priority, int threads,
+            int64_t memory);
+
+    int getThreadBudget() const { return mThreadBudget; }
+
+private:
+    const int mThreadBudget;
+    const int64_t mMemoryBudget;
+
+    std::mutex mLock;
+    std::condition_variable mChanged;
+    /* Jobs waiting to be admitted, oldest first */
+    std::list<std::shared_ptr<Ticket::Job>> mWaiting;
+    /* Keys of the jobs currently running */
+    std::unordered_set<std::string> mRunning;
+    int mThreadsUsed;
+    int64_t mMemoryUsed;
+
+    void leave(const std::shared_ptr<Ticket::Job>& job);
+    void admitLocked();
+
+    DISALLOW_COPY_AND_ASSIGN(DexoptScheduler);
+};
+
+}  // namespace installd
+}  // namespace android
+
+#endif  // ANDROID_INSTALLD_DEXOPT_SCHEDULER_H
@@ -19,6 +19,8 @@
 #define ATRACE_TAG ATRACE_TAG_PACKAGE_MANAGER
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <errno.h>
 #include <fstream>
 #include <fts.h>
@@ -38,7 +40,9 @@
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <sys/xattr.h>
+#include <thread>
 #include <unistd.h>
+#include <unordered_set>
 
 #include <android-base/logging.h>
 #include <android-base/properties.h>
@@ -75,7 +79,6 @@ using std::endl;
 namespace android {
 namespace installd {
 
-static constexpr const char* kCpPath = "/system/bin/cp";
 static constexpr const char* kXattrDefault = "user.default";
 static constexpr const char* kPropHasReserved = "vold.has_reserved";
 
@@ -236,8 +239,28 @@ binder::Status checkArgumentPath(const std::unique_ptr<std::string>& path) {
     }                                                       \
 }
 
+/**
+ * Parses a heap size as given to dex2oat, such as "512m".
+ */
+static int64_t parse_heap_size(const std::string& value) {
+    char* end;
+    int64_t size = strtoll(value.c_str(), &end, 10);
+    switch (*end) {
+        case 'k': case 'K': return size * 1024;
+        case 'm': case 'M': return size * 1024 * 1024;
+        case 'g': case 'G': return size * 1024 * 1024 * 1024;
+        default: return size;
+    }
+}
+
 }  // namespace
 
+InstalldNativeService::InstalldNativeService() :
+        // Let running dex2oat heaps take up to a quarter of memory
+        mDexoptScheduler(sysconf(_SC_NPROCESSORS_ONLN),
+                static_cast<int64_t>(sysconf(_SC_PHYS_PAGES)) * sysconf(_SC_PAGESIZE) / 4) {
+}
+
 status_t InstalldNativeService::start() {
     IPCThreadState::self()->disableBackgroundScheduling(true);
     status_t ret = BinderService<InstalldNativeService>::publish();
@@ -701,6 +724,105 @@ static gid_t get_cache_gid(uid_t uid) {
     return (gid != -1) ? gid : uid;
 }
 
+/**
+ * Fixes up the GIDs under a single app data directory, moving its cache
+ * directories to the cache GID of the app.
+ */
+static void fixup_package_dir(const std::string& path, int32_t flags) {
+    FTS* fts;
+    FTSENT* p;
+    char *argv[] = { (char*) path.c_str(), nullptr };
+    if (!(fts = fts_open(argv, FTS_PHYSICAL | FTS_NOCHDIR | FTS_XDEV, NULL))) {
+        PLOG(WARNING) << "Failed to fts_open " << path;
+        return;
+    }
+    while ((p = fts_read(fts)) != nullptr) {
+        if (p->fts_info == FTS_D && p->fts_level == 0) {
+            // Track down inodes of cache directories
+            uint64_t raw = 0;
+            ino_t inode_cache = 0;
+            ino_t inode_code_cache = 0;
+            if (getxattr(p->fts_path, kXattrInodeCache, &raw, sizeof(raw)) == sizeof(raw)) {
+                inode_cache = raw;
+            }
+            if (getxattr(p->fts_path, kXattrInodeCodeCache, &raw, sizeof(raw)) == sizeof(raw)) {
+                inode_code_cache = raw;
+            }
+
+            // Figure out expected GID of each child
+            FTSENT* child = fts_children(fts, 0);
+            while (child != nullptr) {
+                if ((child->fts_statp->st_ino == inode_cache)
+                        || (child->fts_statp->st_ino == inode_code_cache)
+                        || !strcmp(child->fts_name, "cache")
+                        || !strcmp(child->fts_name, "code_cache")) {
+                    child->fts_number = get_cache_gid(p->fts_statp->st_uid);
+                } else {
+                    child->fts_number = p->fts_statp->st_uid;
+                }
+                child = child->fts_link;
+            }
+        } else if (p->fts_level >= 1) {
+            if (p->fts_level > 1) {
+                // Inherit GID from parent once we're deeper into tree
+                p->fts_number = p->fts_parent->fts_number;
+            }
+
+            uid_t uid = p->fts_parent->fts_statp->st_uid;
+            gid_t cache_gid = get_cache_gid(uid);
+            gid_t expected = p->fts_number;
+            gid_t actual = p->fts_statp->st_gid;
+            if (actual == expected) {
+#if FIXUP_DEBUG
+                LOG(DEBUG) << "Ignoring " << p->fts_path << " with expected GID " << expected;
+#endif
+                if (!(flags & FLAG_FORCE)) {
+                    fts_set(fts, p, FTS_SKIP);
+                }
+            } else if ((actual == uid) || (actual == cache_gid)) {
+                // Only consider fixing up when current GID belongs to app
+                if (p->fts_info != FTS_D) {
+                    LOG(INFO) << "Fixing " << p->fts_path << " with unexpected GID " << actual
+                            << " instead of " << expected;
+                }
+                switch (p->fts_info) {
+                case FTS_DP:
+                    // If we're moving towards cache GID, we need to set S_ISGID
+                    if (expected == cache_gid) {
+                        if (chmod(p->fts_path, 02771) != 0) {
+                            PLOG(WARNING) << "Failed to chmod " << p->fts_path;
+                        }
+                    }
+                    // Intentional fall through to also set GID
+                case FTS_F:
+                    if (chown(p->fts_path, -1, expected) != 0) {
+                        PLOG(WARNING) << "Failed to chown " << p->fts_path;
+                    }
+                    break;
+                case FTS_SL:
+                case FTS_SLNONE:
+                    if (lchown(p->fts_path, -1, expected) != 0) {
+                        PLOG(WARNING) << "Failed to chown " << p->fts_path;
+                    }
+                    break;
+                }
+            } else {
+                // Ignore all other GID transitions, since they're kinda shady
+                LOG(WARNING) << "Ignoring " << p->fts_path << " with unexpected GID " << actual
+                        << " instead of " << expected;
+                if (!(flags & FLAG_FORCE)) {
+                    fts_set(fts, p, FTS_SKIP);
+                }
+            }
+        }
+    }
+    fts_close(fts);
+}
+
+// Package directories are fixed up on this many threads at most; every one of
+// them is busy with syscalls on its own tree.
+static constexpr size_t kMaxFixupThreads = 4;
+
 binder::Status InstalldNativeService::fixupAppData(const std::unique_ptr<std::string>& uuid,
         int32_t flags) {
     ENFORCE_UID(AID_SYSTEM);
@@ -710,95 +832,44 @@ binder::Status InstalldNativeService::fixupAppData(const std::unique_ptr<std::st
     const char* uuid_ = uuid ? uuid->c_str() : nullptr;
     for (auto user : get_known_users(uuid_)) {
         ATRACE_BEGIN("fixup user");
-        FTS* fts;
-        FTSENT* p;
-        auto ce_path = create_data_user_ce_path(uuid_, user);
-        auto de_path = create_data_user_de_path(uuid_, user);
-        char *argv[] = { (char*) ce_path.c_str(), (char*) de_path.c_str(), nullptr };
-        if (!(fts = fts_open(argv, FTS_PHYSICAL | FTS_NOCHDIR | FTS_XDEV, NULL))) {
-            return error("Failed to fts_open");
-        }
-        while ((p = fts_read(fts)) != nullptr) {
-            if (p->fts_info == FTS_D && p->fts_level == 1) {
-                // Track down inodes of cache directories
-                uint64_t raw = 0;
-                ino_t inode_cache = 0;
-                ino_t inode_code_cache = 0;
-                if (getxattr(p->fts_path, kXattrInodeCache, &raw, sizeof(raw)) == sizeof(raw)) {
-                    inode_cache = raw;
+        std::vector<std::string> packageDirs;
+        for (const auto& userPath : { create_data_user_ce_path(uuid_, user),
+                create_data_user_de_path(uuid_, user) }) {
+            DIR* dir = opendir(userPath.c_str());
+            if (dir == nullptr) {
+                if (errno != ENOENT) {
+                    PLOG(WARNING) << "Failed to opendir " << userPath;
                 }
-                if (getxattr(p->fts_path, kXattrInodeCodeCache, &raw, sizeof(raw)) == sizeof(raw)) {
-                    inode_code_cache = raw;
-                }
-
-                // Figure out expected GID of each child
-                FTSENT* child = fts_children(fts, 0);
-                while (child != nullptr) {
-                    if ((child->fts_statp->st_ino == inode_cache)
-                            || (child->fts_statp->st_ino == inode_code_cache)
-                            || !strcmp(child->fts_name, "cache")
-                            || !strcmp(child->fts_name, "code_cache")) {
-                        child->fts_number = get_cache_gid(p->fts_statp->st_uid);
-                    } else {
-                        child->fts_number = p->fts_statp->st_uid;
-                    }
-                    child = child->fts_link;
-                }
-            } else if (p->fts_level >= 2) {
-                if (p->fts_level > 2) {
-                    // Inherit GID from parent once we're deeper into tree
-                    p->fts_number = p->fts_parent->fts_number;
+                continue;
+            }
+            struct dirent* de;
+            while ((de = readdir(dir))) {
+                if ((de->d_type == DT_DIR || de->d_type == DT_UNKNOWN)
+                        && strcmp(de->d_name, ".") && strcmp(de->d_name, "..")) {
+                    packageDirs.push_back(userPath + "/" + de->d_name);
                 }
+            }
+            closedir(dir);
+        }
 
-                uid_t uid = p->fts_parent->fts_statp->st_uid;
-                gid_t cache_gid = get_cache_gid(uid);
-                gid_t expected = p->fts_number;
-                gid_t actual = p->fts_statp->st_gid;
-                if (actual == expected) {
-#if FIXUP_DEBUG
-                    LOG(DEBUG) << "Ignoring " << p->fts_path << " with expected GID " << expected;
-#endif
-                    if (!(flags & FLAG_FORCE)) {
-                        fts_set(fts, p, FTS_SKIP);
-                    }
-                } else if ((actual == uid) || (actual == cache_gid)) {
-                    // Only consider fixing up when current GID belongs to app
-                    if (p->fts_info != FTS_D) {
-                        LOG(INFO) << "Fixing " << p->fts_path << " with unexpected GID " << actual
-                                << " instead of " << expected;
-                    }
-                    switch (p->fts_info) {
-                    case FTS_DP:
-                        // If we're moving towards cache GID, we need to set S_ISGID
-                        if (expected == cache_gid) {
-                            if (chmod(p->fts_path, 02771) != 0) {
-                                PLOG(WARNING) << "Failed to chmod " << p->fts_path;
-                            }
-                        }
-                        // Intentional fall through to also set GID
-                    case FTS_F:
-                        if (chown(p->fts_path, -1, expected) != 0) {
-                            PLOG(WARNING) << "Failed to chown " << p->fts_path;
-                        }
-                        break;
-                    case FTS_SL:
-                    case FTS_SLNONE:
-                        if (lchown(p->fts_path, -1, expected) != 0) {
-                            PLOG(WARNING) << "Failed to chown " << p->fts_path;
-                        }
-                        break;
-                    }
-                } else {
-                    // Ignore all other GID transitions, since they're kinda shady
-                    LOG(WARNING) << "Ignoring " << p->fts_path << " with unexpected GID " << actual
-                            << " instead of " << expected;
-                    if (!(flags & FLAG_FORCE)) {
-                        fts_set(fts, p, FTS_SKIP);
-                    }
-                }
+        // Workers only touch their own package trees and take no locks; we
+        // keep holding mLock until they're all done
+        std::atomic<size_t> next(0);
+        auto worker = [&]() {
+            for (size_t i = next++; i < packageDirs.size(); i = next++) {
+                fixup_package_dir(packageDirs[i], flags);
             }
+        };
+        size_t threadCount = std::min({ kMaxFixupThreads, packageDirs.size(),
+                static_cast<size_t>(std::max(sysconf(_SC_NPROCESSORS_ONLN), 1L)) });
+        std::vector<std::thread> threads;
+        for (size_t i = 1; i < threadCount; i++) {
+            threads.emplace_back(worker);
+        }
+        worker();
+        for (auto& thread : threads) {
+            thread.join();
         }
-        fts_close(fts);
         ATRACE_END();
     }
     return ok();
@@ -821,28 +892,17 @@ binder::Status InstalldNativeService::moveCompleteApp(const std::unique_ptr<std:
 
     binder::Status res = ok();
     std::vector<userid_t> users = get_known_users(from_uuid);
+    int64_t bytes = 0;
+    auto start = std::chrono::steady_clock::now();
 
     // Copy app
     {
         auto from = create_data_app_package_path(from_uuid, data_app_name);
         auto to = create_data_app_package_path(to_uuid, data_app_name);
-        auto to_parent = create_data_app_path(to_uuid);
-
-        char *argv[] = {
-            (char*) kCpPath,
-            (char*) "-F", /* delete any existing destination file first (--remove-destination) */
-            (char*) "-p", /* preserve timestamps, ownership, and permissions */
-            (char*) "-R", /* recurse into subdirectories (DEST must be a directory) */
-            (char*) "-P", /* Do not follow symlinks [default] */
-            (char*) "-d", /* don't dereference symlinks */
-            (char*) from.c_str(),
-            (char*) to_parent.c_str()
-        };
 
         LOG(DEBUG) << "Copying " << from << " to " << to;
-        int rc = android_fork_execvp(ARRAY_SIZE(argv), argv, NULL, false, true);
-        if (rc != 0) {
-            res = error(rc, "Failed copying " + from + " to " + to);
+        if (copy_tree(from, to, &bytes) != 0) {
+            res = error("Failed copying " + from + " to " + to);
             goto fail;
         }
 
@@ -868,40 +928,23 @@ binder::Status InstalldNativeService::moveCompleteApp(const std::unique_ptr<std:
             goto fail;
         }
 
-        char *argv[] = {
-            (char*) kCpPath,
-            (char*) "-F", /* delete any existing destination file first (--remove-destination) */
-            (char*) "-p", /* preserve timestamps, ownership, and permissions */
-            (char*) "-R", /* recurse into subdirectories (DEST must be a directory) */
-            (char*) "-P", /* Do not follow symlinks [default] */
-            (char*) "-d", /* don't dereference symlinks */
-            nullptr,
-            nullptr
-        };
-
         {
             auto from = create_data_user_de_package_path(from_uuid, user, package_name);
-            auto to = create_data_user_de_path(to_uuid, user);
-            argv[6] = (char*) from.c_str();
-            argv[7] = (char*) to.c_str();
+            auto to = create_data_user_de_package_path(to_uuid, user, package_name);
 
             LOG(DEBUG) << "Copying " << from << " to " << to;
-            int rc = android_fork_execvp(ARRAY_SIZE(argv), argv, NULL, false, true);
-            if (rc != 0) {
-                res = error(rc, "Failed copying " + from + " to " + to);
+            if (copy_tree(from, to, &bytes) != 0) {
+                res = error("Failed copying " + from + " to " + to);
                 goto fail;
             }
         }
         {
             auto from = create_data_user_ce_package_path(from_uuid, user, package_name);
-            auto to = create_data_user_ce_path(to_uuid, user);
-            argv[6] = (char*) from.c_str();
-            argv[7] = (char*) to.c_str();
+            auto to = create_data_user_ce_package_path(to_uuid, user, package_name);
 
             LOG(DEBUG) << "Copying " << from << " to " << to;
-            int rc = android_fork_execvp(ARRAY_SIZE(argv), argv, NULL, false, true);
-            if (rc != 0) {
-                res = error(rc, "Failed copying " + from + " to " + to);
+            if (copy_tree(from, to, &bytes) != 0) {
+                res = error("Failed copying " + from + " to " + to);
                 goto fail;
             }
         }
@@ -913,6 +956,13 @@ binder::Status InstalldNativeService::moveCompleteApp(const std::unique_ptr<std:
         }
     }
 
+    {
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - start).count();
+        LOG(INFO) << "Moved " << packageName << ": " << bytes / 1024 << " KiB in " << elapsed
+                << " ms (" << (elapsed > 0 ? bytes / 1024 * 1000 / elapsed : 0) << " KiB/s)";
+    }
+
     // We let the framework scan the new location and persist that before
     // deleting the data in the old location; this ordering ensures that
     // we can recover from things like battery pulls.
@@ -1037,6 +1087,8 @@ binder::Status InstalldNativeService::freeCache(const std::unique_ptr<std::strin
         // 1. Create trackers for every known UID
         ATRACE_BEGIN("create");
         std::unordered_map<uid_t, std::shared_ptr<CacheTracker>> trackers;
+        std::unordered_set<std::string> dataPaths;
+        auto& snapshots = mCacheSnapshots[data_path];
         for (auto user : get_known_users(uuid_)) {
             FTS *fts;
             FTSENT *p;
@@ -1055,12 +1107,14 @@ binder::Status InstalldNativeService::freeCache(const std::unique_ptr<std::strin
                         uid = (multiuser_get_app_id(p->fts_statp->st_gid) - AID_EXT_GID_START)
                                 + AID_APP_START;
                     }
+                    dataPaths.insert(p->fts_path);
                     auto search = trackers.find(uid);
                     if (search != trackers.end()) {
                         search->second->addDataPath(p->fts_path);
                     } else {
                         auto tracker = std::shared_ptr<CacheTracker>(new CacheTracker(
-                                multiuser_get_user_id(uid), multiuser_get_app_id(uid), device));
+                                multiuser_get_user_id(uid), multiuser_get_app_id(uid), device,
+                                &snapshots));
                         tracker->addDataPath(p->fts_path);
                         {
                             std::lock_guard<std::recursive_mutex> lock(mQuotasLock);
@@ -1079,6 +1133,15 @@ binder::Status InstalldNativeService::freeCache(const std::unique_ptr<std::strin
             }
             fts_close(fts);
         }
+
+        // Forget snapshots of cache directories whose app is gone
+        for (auto it = snapshots.begin(); it != snapshots.end();) {
+            if (dataPaths.count(it->first.substr(0, it->first.rfind('/')))) {
+                ++it;
+            } else {
+                it = snapshots.erase(it);
+            }
+        }
         ATRACE_END();
 
         // 2. Populate tracker stats and insert into priority queue
@@ -1141,6 +1204,7 @@ binder::Status InstalldNativeService::freeCache(const std::unique_ptr<std::strin
                 LOG(DEBUG) << "Purging " << item->toString() << " from " << active->toString();
                 if (!noop) {
                     item->purge();
+                    active->invalidateItems();
                 }
                 active->cacheUsed -= item->size;
                 needed -= item->size;
@@ -1959,7 +2023,23 @@ binder::Status InstalldNativeService::dexopt(const std::string& apkPath, int32_t
     }
     CHECK_ARGUMENT_PATH(outputPath);
     CHECK_ARGUMENT_PATH(dexMetadataPath);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+
+    // Rather than holding mLock, compile alongside other dexopt calls for as
+    // long as the threads and heaps of every running dex2oat fit the device;
+    // without a thread count dex2oat uses every core. Callers already hold
+    // the package manager install lock around anything else touching the
+    // same artifacts.
+    bool boot_complete = (dexFlags & DEXOPT_BOOTCOMPLETE) != 0;
+    int threads = android::base::GetIntProperty(boot_complete ? "dalvik.vm.dex2oat-threads"
+            : "dalvik.vm.boot-dex2oat-threads", mDexoptScheduler.getThreadBudget());
+    int64_t memory = parse_heap_size(android::base::GetProperty("dalvik.vm.dex2oat-Xmx", ""));
+    int priority = (dexFlags & DEXOPT_IDLE_BACKGROUND_JOB)
+            ? DexoptScheduler::PRIORITY_BACKGROUND : DexoptScheduler::PRIORITY_FOREGROUND;
+    auto ticket = mDexoptScheduler.enter(apkPath + ":" + instructionSet, priority, threads,
+            memory);
+    if (!ticket) {
+        return error("Superseded by a newer dexopt of " + apkPath);
+    }
 
     const char* apk_path = apkPath.c_str();
     const char* pkgname = getCStr(packageName, "*");
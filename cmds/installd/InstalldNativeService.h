@@ -29,6 +29,8 @@
 #include <cutils/multiuser.h>
 
 #include "android/os/BnInstalld.h"
+#include "CacheTracker.h"
+#include "DexoptScheduler.h"
 #include "installd_constants.h"
 
 namespace android {
@@ -36,6 +38,8 @@ namespace installd {
 
 class InstalldNativeService : public BinderService<InstalldNativeService>, public os::BnInstalld {
 public:
+    InstalldNativeService();
+
     static status_t start();
     static char const* getServiceName() { return "installd"; }
     virtual status_t dump(int fd, const Vector<String16> &args) override;
@@ -156,6 +160,12 @@ private:
     /* Map from UID to cache quota size */
     std::unordered_map<uid_t, int64_t> mCacheQuotas;
 
+    /* Map from volume data path to cache items loaded by freeCache */
+    std::unordered_map<std::string, CacheSnapshotMap> mCacheSnapshots;
+
+    /* Admits dexopt jobs in place of mLock */
+    DexoptScheduler mDexoptScheduler;
+
     std::string findDataMediaPath(const std::unique_ptr<std::string>& uuid, userid_t userid);
     std::string findQuotaDeviceForUuid(const std::unique_ptr<std::string>& uuid);
 };
@@ -17,10 +17,12 @@
 
 #include <array>
 #include <fcntl.h>
+#include <signal.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/capability.h>
 #include <sys/file.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/time.h>
 #include <sys/types.h>
@@ -29,6 +31,8 @@
 #include <unistd.h>
 
 #include <iomanip>
+#include <mutex>
+#include <unordered_map>
 
 #include <android-base/file.h>
 #include <android-base/logging.h>
@@ -823,6 +827,33 @@ static void run_profman_copy_and_update(unique_fd&& profile_fd,
             /*copy_and_update*/true);
 }
 
+// The identity, size and modification time of a profile file.
+struct ProfileStamp {
+    ino_t ino;
+    off_t size;
+    struct timespec mtime;
+
+    bool operator==(const ProfileStamp& other) const {
+        return ino == other.ino && size == other.size && mtime.tv_sec == other.mtime.tv_sec
+                && mtime.tv_nsec == other.mtime.tv_nsec;
+    }
+};
+
+// Profiles, keyed by reference profile path, that profman last found not worth compiling.
+// profman would come to the same conclusion for as long as none of them change.
+static std::mutex unchanged_profiles_lock;
+static std::unordered_map<std::string, std::vector<ProfileStamp>> unchanged_profiles;
+
+static bool stamp_profile(const unique_fd& fd, /*out*/ std::vector<ProfileStamp>* stamps) {
+    struct stat st;
+    if (fstat(fd.get(), &st) != 0) {
+        PLOG(WARNING) << "Failed to fstat profile";
+        return false;
+    }
+    stamps->push_back({ st.st_ino, st.st_size, st.st_mtim });
+    return true;
+}
+
 // Decides if profile guided compilation is needed or not based on existing profiles.
 // The location is the package name for primary apks or the dex path for secondary dex files.
 // Returns true if there is enough information in the current profiles that makes it
@@ -841,6 +872,32 @@ static bool analyze_profiles(uid_t uid, const std::string& package_name,
         return false;
     }
 
+    // Avoid forking profman when there is nothing new to merge: either every current profile
+    // is empty, as they are after the merge that led to the last compilation, or none of the
+    // profiles changed since profman last decided compiling wasn't worth it.
+    std::vector<ProfileStamp> stamps;
+    bool stamped = stamp_profile(reference_profile_fd, &stamps);
+    bool all_empty = true;
+    for (const unique_fd& profile_fd : profiles_fd) {
+        stamped = stamped && stamp_profile(profile_fd, &stamps);
+        all_empty = all_empty && stamped && stamps.back().size == 0;
+    }
+    if (stamped && all_empty) {
+        return false;
+    }
+    std::string reference_profile_path = create_reference_profile_path(package_name, location,
+            is_secondary_dex);
+    {
+        std::lock_guard<std::mutex> lock(unchanged_profiles_lock);
+        auto search = unchanged_profiles.find(reference_profile_path);
+        if (search != unchanged_profiles.end()) {
+            if (stamped && search->second == stamps) {
+                return false;
+            }
+            unchanged_profiles.erase(search);
+        }
+    }
+
     pid_t pid = fork();
     if (pid == 0) {
         /* child -- drop privileges before continuing */
@@ -866,6 +923,10 @@ static bool analyze_profiles(uid_t uid, const std::string& package_name,
                 need_to_compile = false;
                 should_clear_current_profiles = false;
                 should_clear_reference_profile = false;
+                if (stamped) {
+                    std::lock_guard<std::mutex> lock(unchanged_profiles_lock);
+                    unchanged_profiles[reference_profile_path] = stamps;
+                }
                 break;
             case PROFMAN_BIN_RETURN_CODE_BAD_PROFILES:
                 LOG(WARNING) << "Bad profiles for location " << location;
@@ -1051,14 +1112,8 @@ bool copy_system_profile(const std::string& system_profile,
         }
 
         // Copy over data.
-        static constexpr size_t kBufferSize = 4 * 1024;
-        char buffer[kBufferSize];
-        while (true) {
-            ssize_t bytes = read(in_fd.get(), buffer, kBufferSize);
-            if (bytes == 0) {
-                break;
-            }
-            write(out_fd.get(), buffer, bytes);
+        if (copy_file_contents(in_fd.get(), out_fd.get()) < 0) {
+            PLOG(WARNING) << "Could not copy profile " << system_profile;
         }
         if (flock(out_fd.get(), LOCK_UN) != 0) {
             PLOG(WARNING) << "Error unlocking profile " << package_name;
@@ -2331,6 +2386,25 @@ bool hash_secondary_dex_file(const std::string& dex_path, const std::string& pkg
         SHA256_CTX ctx;
         SHA256_Init(&ctx);
 
+        // Hash the file where it is mapped, sparing a copy of each page. BoringSSL picks the
+        // SHA-256 instructions of the CPU on its own.
+        struct stat st;
+        if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+            void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data != MAP_FAILED) {
+                // The app may truncate the file under us.
+                signal(SIGBUS, [](int) { _exit(DexoptReturnCodes::kHashReadDex); });
+                madvise(data, st.st_size, MADV_SEQUENTIAL);
+                SHA256_Update(&ctx, data, st.st_size);
+                munmap(data, st.st_size);
+                if (TEMP_FAILURE_RETRY(lseek(fd, st.st_size, SEEK_SET)) < 0) {
+                    PLOG(ERROR) << "Failed to seek secondary dex " << dex_path;
+                    _exit(DexoptReturnCodes::kHashReadDex);
+                }
+            }
+        }
+
+        // Whatever wasn't mapped, or was appended since.
         std::vector<uint8_t> buffer(65536);
         while (true) {
             ssize_t bytes_read = TEMP_FAILURE_RETRY(read(fd, buffer.data(), buffer.size()));
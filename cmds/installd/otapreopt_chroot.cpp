@@ -15,11 +15,16 @@
  */
 
 #include <fcntl.h>
+#include <string.h>
 #include <linux/unistd.h>
 #include <sys/mount.h>
 #include <sys/wait.h>
 
+#include <iostream>
+#include <iterator>
 #include <sstream>
+#include <string>
+#include <vector>
 
 #include <android-base/logging.h>
 #include <android-base/macros.h>
@@ -54,10 +59,55 @@ static void CloseDescriptor(const char* descriptor_string) {
     }
 }
 
+static constexpr const char* kBatchArg = "--batch";
+
+// Reads one otapreopt command line, such as "dexopt [dexopt-params]", from each line of stdin.
+static std::vector<std::vector<std::string>> ReadBatch() {
+    std::vector<std::vector<std::string>> batch;
+    std::string line;
+    while (std::getline(std::cin, line)) {
+        std::istringstream stream(line);
+        std::vector<std::string> args((std::istream_iterator<std::string>(stream)),
+                std::istream_iterator<std::string>());
+        if (!args.empty()) {
+            batch.push_back(std::move(args));
+        }
+    }
+    return batch;
+}
+
+// Runs otapreopt in the chroot with the given target slot and command, returning its exit code.
+static int RunOtapreopt(const char* target_slot, const std::vector<std::string>& args) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        std::vector<const char*> argv;
+        argv.push_back("/system/bin/otapreopt");
+        argv.push_back(target_slot);
+        for (const std::string& arg : args) {
+            argv.push_back(arg.c_str());
+        }
+        argv.push_back(nullptr);
+        execv(argv[0], const_cast<char* const*>(argv.data()));
+        _exit(99);
+    }
+    if (pid < 0) {
+        return 99;
+    }
+    int status;
+    if (TEMP_FAILURE_RETRY(waitpid(pid, &status, 0)) != pid || !WIFEXITED(status)) {
+        return 99;
+    }
+    return WEXITSTATUS(status);
+}
+
 // Entry for otapreopt_chroot. Expected parameters are:
 //   [cmd] [status-fd] [target-slot] "dexopt" [dexopt-params]
 // The file descriptor denoted by status-fd will be closed. The rest of the parameters will
 // be passed on to otapreopt in the chroot.
+//
+// Alternatively, to set up the chroot only once for many packages:
+//   [cmd] [status-fd] [target-slot] "--batch"
+// reads one otapreopt command per line from stdin, and runs them one after the other.
 static int otapreopt_chroot(const int argc, char **arg) {
     // Validate arguments
     // We need the command, status channel and target slot, at a minimum.
@@ -65,6 +115,12 @@ static int otapreopt_chroot(const int argc, char **arg) {
         PLOG(ERROR) << "Not enough arguments.";
         exit(208);
     }
+    bool batch_mode = (argc == 4 && strcmp(arg[3], kBatchArg) == 0);
+    std::vector<std::vector<std::string>> batch;
+    if (batch_mode) {
+        // Read everything before stdin is closed below.
+        batch = ReadBatch();
+    }
     // Close all file descriptors. They are coming from the caller, we do not want to pass them
     // on across our fork/exec into a different domain.
     // 1) Default descriptors.
@@ -157,6 +213,17 @@ static int otapreopt_chroot(const int argc, char **arg) {
 
     // Now go on and run otapreopt.
 
+    if (batch_mode) {
+        int result = 0;
+        for (const std::vector<std::string>& args : batch) {
+            int command_result = RunOtapreopt(arg[2], args);
+            if (result == 0) {
+                result = command_result;
+            }
+        }
+        exit(result);
+    }
+
     // Incoming:  cmd + status-fd + target-slot + cmd... + null      | Incoming | = argc + 1
     // Outgoing:  cmd             + target-slot + cmd... + null      | Outgoing | = argc
     const char** argv = new const char*[argc];
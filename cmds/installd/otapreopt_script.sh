@@ -24,6 +24,10 @@ STATUS_FD="$2"
 # Maximum number of packages/steps.
 MAXIMUM_PACKAGES=1000
 
+# Number of packages dexopted by a single otapreopt_chroot invocation. Commands
+# taken by an interrupted batch are not handed out again.
+BATCH_SIZE=8
+
 # First ensure the system is booted. This is to work around issues when cmd would
 # infinitely loop trying to get a service manager (which will never come up in that
 # mode). b/30797145
@@ -58,11 +62,26 @@ PREPARE=$(cmd otadexopt prepare)
 PROGRESS=$(cmd otadexopt progress)
 print -u${STATUS_FD} "global_progress $PROGRESS"
 
+START_TIME=$(date +%s)
 i=0
 while ((i<MAXIMUM_PACKAGES)) ; do
-  DEXOPT_PARAMS=$(cmd otadexopt next)
+  BATCH=""
+  j=0
+  while ((j<BATCH_SIZE && i<MAXIMUM_PACKAGES)) ; do
+    DEXOPT_PARAMS=$(cmd otadexopt next)
+    BATCH="$BATCH$DEXOPT_PARAMS
+"
+    i=$((i+1))
+    j=$((j+1))
+
+    DONE=$(cmd otadexopt done)
+    if [ "$DONE" != "OTA incomplete." ] ; then
+      break
+    fi
+  done
 
-  /system/bin/otapreopt_chroot $STATUS_FD $TARGET_SLOT_SUFFIX $DEXOPT_PARAMS >&- 2>&-
+  print -rn -- "$BATCH" | \
+      /system/bin/otapreopt_chroot $STATUS_FD $TARGET_SLOT_SUFFIX --batch >&- 2>&-
 
   PROGRESS=$(cmd otadexopt progress)
   print -u${STATUS_FD} "global_progress $PROGRESS"
@@ -70,12 +89,13 @@ while ((i<MAXIMUM_PACKAGES)) ; do
   DONE=$(cmd otadexopt done)
   if [ "$DONE" = "OTA incomplete." ] ; then
     sleep 1
-    i=$((i+1))
     continue
   fi
   break
 done
 
+echo "Dexopted $i packages in $(($(date +%s) - START_TIME)) seconds."
+
 DONE=$(cmd otadexopt done)
 if [ "$DONE" = "OTA incomplete." ] ; then
   echo "Incomplete."
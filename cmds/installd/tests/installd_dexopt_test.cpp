@@ -885,6 +885,18 @@ TEST_F(ProfileTest, ProfileMergeOkNoReference) {
     mergePackageProfiles(package_name_, "primary.prof", /*expected_result*/ true);
 }
 
+TEST_F(ProfileTest, ProfileMergeOkAgainAfterChange) {
+    LOG(INFO) << "ProfileMergeOkAgainAfterChange";
+
+    SetupProfiles(/*setup_ref*/ true);
+    mergePackageProfiles(package_name_, "primary.prof", /*expected_result*/ true);
+
+    // Nothing new to merge until the current profile gets new data.
+    mergePackageProfiles(package_name_, "primary.prof", /*expected_result*/ false);
+    SetupProfile(cur_profile_, kTestAppUid, kTestAppGid, 0600, 3);
+    mergePackageProfiles(package_name_, "primary.prof", /*expected_result*/ true);
+}
+
 TEST_F(ProfileTest, ProfileMergeFailWrongPackage) {
     LOG(INFO) << "ProfileMergeFailWrongPackage";
 
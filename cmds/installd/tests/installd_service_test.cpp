@@ -14,17 +14,20 @@
  * limitations under the License.
  */
 
+#include <atomic>
 #include <sstream>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/statvfs.h>
 #include <sys/xattr.h>
+#include <thread>
 
 #include <android-base/logging.h>
 #include <android-base/stringprintf.h>
 #include <cutils/properties.h>
 #include <gtest/gtest.h>
 
+#include "DexoptScheduler.h"
 #include "InstalldNativeService.h"
 #include "dexopt.h"
 #include "globals.h"
@@ -240,5 +243,47 @@ TEST_F(ServiceTest, CalculateCache) {
     EXPECT_EQ("/data/dalvik-cache/isa/path@to@file.apk@classes.dex", std::string(buf));
 }
 
+TEST(DexoptSchedulerTest, RunsWithinBudget) {
+    DexoptScheduler scheduler(4, 0);
+    auto first = scheduler.enter("first", DexoptScheduler::PRIORITY_FOREGROUND, 2, 0);
+    auto second = scheduler.enter("second", DexoptScheduler::PRIORITY_FOREGROUND, 2, 0);
+    EXPECT_NE(nullptr, first);
+    EXPECT_NE(nullptr, second);
+
+    std::atomic<bool> admitted(false);
+    std::thread third([&] {
+        auto ticket = scheduler.enter("third", DexoptScheduler::PRIORITY_FOREGROUND, 2, 0);
+        admitted = (ticket != nullptr);
+    });
+    usleep(100 * 1000);
+    EXPECT_FALSE(admitted);
+
+    first.reset();
+    third.join();
+    EXPECT_TRUE(admitted);
+}
+
+TEST(DexoptSchedulerTest, CancelsObsoleteJobs) {
+    DexoptScheduler scheduler(1, 0);
+    auto running = scheduler.enter("running", DexoptScheduler::PRIORITY_FOREGROUND, 1, 0);
+
+    std::atomic<bool> older(true);
+    std::thread olderThread([&] {
+        older = (scheduler.enter("apk", DexoptScheduler::PRIORITY_BACKGROUND, 1, 0) != nullptr);
+    });
+    usleep(100 * 1000);
+
+    std::atomic<bool> newer(false);
+    std::thread newerThread([&] {
+        newer = (scheduler.enter("apk", DexoptScheduler::PRIORITY_BACKGROUND, 1, 0) != nullptr);
+    });
+    olderThread.join();
+    EXPECT_FALSE(older);
+
+    running.reset();
+    newerThread.join();
+    EXPECT_TRUE(newer);
+}
+
 }  // namespace installd
 }  // namespace android
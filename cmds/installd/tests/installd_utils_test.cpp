@@ -14,10 +14,15 @@
  * limitations under the License.
  */
 
+#include <ftw.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
+#include <android-base/file.h>
 #include <android-base/logging.h>
+#include <android-base/stringprintf.h>
 #include <gtest/gtest.h>
 
 #include "InstalldNativeService.h"
@@ -40,6 +45,8 @@
 
 #define TEST_PROFILE_DIR "/data/misc/profiles"
 
+using android::base::StringPrintf;
+
 namespace android {
 namespace installd {
 
@@ -529,5 +536,81 @@ TEST_F(UtilsTest, ValidateApkPathSubdirs) {
     EXPECT_NE(0, validate_apk_path_subdirs("/data/app/com.example/dir/dir/dir//file"));
 }
 
+static int64_t sTreeSize;
+
+static int add_tree_node_size(const char*, const struct stat* st, int, struct FTW*) {
+    sTreeSize += st->st_blocks * 512;
+    return 0;
+}
+
+TEST_F(UtilsTest, CalculateTreeSize) {
+    // Enough directories that the walk brings in helper threads.
+    const std::string root = "/data/local/tmp/installd_utils_test_tree";
+    ASSERT_EQ(0, system(("rm -rf " + root).c_str()));
+    ASSERT_EQ(0, mkdir(root.c_str(), 0700));
+    for (int i = 0; i < 64; i++) {
+        std::string dir = StringPrintf("%s/%d", root.c_str(), i);
+        ASSERT_EQ(0, mkdir(dir.c_str(), 0700));
+        for (int j = 0; j < 8; j++) {
+            std::string subdir = StringPrintf("%s/%d", dir.c_str(), j);
+            ASSERT_EQ(0, mkdir(subdir.c_str(), 0700));
+            std::string file = subdir + "/file";
+            ASSERT_TRUE(android::base::WriteStringToFile(std::string(4096 * (i % 3 + 1), 'x'),
+                    file));
+        }
+    }
+
+    sTreeSize = 0;
+    ASSERT_EQ(0, nftw(root.c_str(), add_tree_node_size, 16, FTW_PHYS | FTW_MOUNT));
+
+    int64_t size = 1;
+    EXPECT_EQ(0, calculate_tree_size(root, &size));
+    EXPECT_EQ(sTreeSize + 1, size);
+
+    size = 0;
+    EXPECT_EQ(-1, calculate_tree_size(root + "/missing", &size));
+    EXPECT_EQ(0, size);
+
+    ASSERT_EQ(0, system(("rm -rf " + root).c_str()));
+}
+
+TEST_F(UtilsTest, CopyTree) {
+    const std::string root = "/data/local/tmp/installd_utils_test_copy";
+    const std::string from = root + "/from";
+    const std::string to = root + "/to";
+    ASSERT_EQ(0, system(("rm -rf " + root).c_str()));
+    ASSERT_EQ(0, mkdir(root.c_str(), 0700));
+    ASSERT_EQ(0, mkdir(from.c_str(), 0750));
+    ASSERT_EQ(0, mkdir((from + "/dir").c_str(), 0700));
+    const std::string contents(100000, 'x');
+    ASSERT_TRUE(android::base::WriteStringToFile(contents, from + "/dir/file"));
+    ASSERT_EQ(0, chmod((from + "/dir/file").c_str(), 0640));
+    ASSERT_EQ(0, symlink("dir/file", (from + "/link").c_str()));
+
+    // What is in the way is replaced, existing directories are merged into.
+    ASSERT_EQ(0, mkdir(to.c_str(), 0700));
+    ASSERT_TRUE(android::base::WriteStringToFile("old", to + "/link"));
+
+    int64_t bytes = 0;
+    EXPECT_EQ(0, copy_tree(from, to, &bytes));
+    EXPECT_EQ(static_cast<int64_t>(contents.size()), bytes);
+
+    std::string copied;
+    ASSERT_TRUE(android::base::ReadFileToString(to + "/dir/file", &copied));
+    EXPECT_EQ(contents, copied);
+    struct stat st;
+    ASSERT_EQ(0, stat((to + "/dir/file").c_str(), &st));
+    EXPECT_EQ(0640u, st.st_mode & 07777);
+    ASSERT_EQ(0, stat(to.c_str(), &st));
+    EXPECT_EQ(0750u, st.st_mode & 07777);
+    std::string target;
+    ASSERT_TRUE(android::base::Readlink(to + "/link", &target));
+    EXPECT_EQ("dir/file", target);
+
+    EXPECT_EQ(-1, copy_tree(root + "/missing", to, &bytes));
+
+    ASSERT_EQ(0, system(("rm -rf " + root).c_str()));
+}
+
 }  // namespace installd
 }  // namespace android
@@ -19,12 +19,22 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <fts.h>
+#include <linux/fs.h>
 #include <stdlib.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <sys/wait.h>
 #include <sys/xattr.h>
 #include <sys/statvfs.h>
 
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include <android-base/file.h>
 #include <android-base/logging.h>
 #include <android-base/strings.h>
 #include <android-base/stringprintf.h>
@@ -334,47 +344,138 @@ std::vector<userid_t> get_known_users(const char* volume_uuid) {
     return users;
 }
 
+// Trees are measured by the calling thread, which brings in helpers from a
+// small process-wide budget once a tree turns out to have more directories
+// waiting than one thread keeps up with. Small trees never start a thread,
+// and concurrent binder calls can't together take more than the budget.
+static constexpr size_t kMaxTreeWalkHelpers = 3;
+static constexpr size_t kTreeWalkPendingPerHelper = 16;
+static std::atomic<size_t> gTreeWalkHelpers(0);
+
+namespace {
+
+struct TreeWalk {
+    int32_t include_gid;
+    int32_t exclude_gid;
+    bool exclude_apps;
+    dev_t device;
+
+    std::atomic<int64_t> matchedSize{0};
+
+    std::mutex lock;
+    std::condition_variable cond;
+    // Guarded by lock: directories waiting to be read, and how many are being
+    // read right now.
+    std::vector<std::string> pending;
+    size_t active = 0;
+    std::vector<std::thread> helpers;
+};
+
+}  // namespace
+
+// Returns true if the node described by st should be descended into.
+static bool measure_tree_node(TreeWalk* walk, const struct stat& st) {
+    int32_t uid = st.st_uid;
+    int32_t gid = st.st_gid;
+    int32_t user_uid = multiuser_get_app_id(uid);
+    int32_t user_gid = multiuser_get_app_id(gid);
+    if (walk->exclude_apps && ((user_uid >= AID_APP_START && user_uid <= AID_APP_END)
+            || (user_gid >= AID_CACHE_GID_START && user_gid <= AID_CACHE_GID_END)
+            || (user_gid >= AID_SHARED_GID_START && user_gid <= AID_SHARED_GID_END))) {
+        // Don't traverse inside or measure
+        return false;
+    }
+    if ((walk->include_gid == -1 || gid == walk->include_gid)
+            && (walk->exclude_gid == -1 || gid != walk->exclude_gid)) {
+        walk->matchedSize += (st.st_blocks * 512);
+    }
+    // Like FTS_XDEV, count mount points but don't cross them
+    return S_ISDIR(st.st_mode) && st.st_dev == walk->device;
+}
+
+static void read_tree_dir(TreeWalk* walk, const std::string& path,
+        std::vector<std::string>* subdirs) {
+    DIR* d = opendir(path.c_str());
+    if (d == nullptr) {
+        return;
+    }
+    int dfd = dirfd(d);
+    struct dirent* de;
+    struct stat st;
+    while ((de = readdir(d))) {
+        const char* name = de->d_name;
+        if (!strcmp(name, ".") || !strcmp(name, "..")) {
+            continue;
+        }
+        if (fstatat(dfd, name, &st, AT_SYMLINK_NOFOLLOW) != 0) {
+            continue;
+        }
+        if (measure_tree_node(walk, st)) {
+            subdirs->push_back(path + "/" + name);
+        }
+    }
+    closedir(d);
+}
+
+static void walk_tree(TreeWalk* walk) {
+    std::vector<std::string> subdirs;
+    std::unique_lock<std::mutex> lock(walk->lock);
+    while (true) {
+        walk->cond.wait(lock, [walk] { return !walk->pending.empty() || walk->active == 0; });
+        if (walk->pending.empty()) {
+            // Nothing waiting and nothing being read that could add more
+            break;
+        }
+        std::string dir = std::move(walk->pending.back());
+        walk->pending.pop_back();
+        walk->active++;
+        lock.unlock();
+
+        subdirs.clear();
+        read_tree_dir(walk, dir, &subdirs);
+
+        lock.lock();
+        walk->active--;
+        for (auto& subdir : subdirs) {
+            walk->pending.push_back(std::move(subdir));
+        }
+        while (walk->pending.size() > (walk->helpers.size() + 1) * kTreeWalkPendingPerHelper) {
+            size_t helpers = gTreeWalkHelpers.load();
+            if (helpers >= kMaxTreeWalkHelpers
+                    || !gTreeWalkHelpers.compare_exchange_weak(helpers, helpers + 1)) {
+                break;
+            }
+            walk->helpers.emplace_back(walk_tree, walk);
+        }
+        walk->cond.notify_all();
+    }
+}
+
 int calculate_tree_size(const std::string& path, int64_t* size,
         int32_t include_gid, int32_t exclude_gid, bool exclude_apps) {
-    FTS *fts;
-    FTSENT *p;
-    int64_t matchedSize = 0;
-    char *argv[] = { (char*) path.c_str(), nullptr };
-    if (!(fts = fts_open(argv, FTS_PHYSICAL | FTS_NOCHDIR | FTS_XDEV, NULL))) {
+    struct stat st;
+    if (lstat(path.c_str(), &st) != 0) {
         if (errno != ENOENT) {
-            PLOG(ERROR) << "Failed to fts_open " << path;
+            PLOG(ERROR) << "Failed to stat " << path;
         }
         return -1;
     }
-    while ((p = fts_read(fts)) != NULL) {
-        switch (p->fts_info) {
-        case FTS_D:
-        case FTS_DEFAULT:
-        case FTS_F:
-        case FTS_SL:
-        case FTS_SLNONE:
-            int32_t uid = p->fts_statp->st_uid;
-            int32_t gid = p->fts_statp->st_gid;
-            int32_t user_uid = multiuser_get_app_id(uid);
-            int32_t user_gid = multiuser_get_app_id(gid);
-            if (exclude_apps && ((user_uid >= AID_APP_START && user_uid <= AID_APP_END)
-                    || (user_gid >= AID_CACHE_GID_START && user_gid <= AID_CACHE_GID_END)
-                    || (user_gid >= AID_SHARED_GID_START && user_gid <= AID_SHARED_GID_END))) {
-                // Don't traverse inside or measure
-                fts_set(fts, p, FTS_SKIP);
-                break;
-            }
-            if (include_gid != -1 && gid != include_gid) {
-                break;
-            }
-            if (exclude_gid != -1 && gid == exclude_gid) {
-                break;
-            }
-            matchedSize += (p->fts_statp->st_blocks * 512);
-            break;
+
+    TreeWalk walk;
+    walk.include_gid = include_gid;
+    walk.exclude_gid = exclude_gid;
+    walk.exclude_apps = exclude_apps;
+    walk.device = st.st_dev;
+    if (measure_tree_node(&walk, st)) {
+        walk.pending.push_back(path);
+        walk_tree(&walk);
+        for (auto& helper : walk.helpers) {
+            helper.join();
         }
+        gTreeWalkHelpers -= walk.helpers.size();
     }
-    fts_close(fts);
+
+    int64_t matchedSize = walk.matchedSize;
 #if MEASURE_DEBUG
     if ((include_gid == -1) && (exclude_gid == -1)) {
         LOG(DEBUG) << "Measured " << path << " size " << matchedSize;
@@ -596,12 +697,7 @@ static int _copy_dir_files(int sdfd, int ddfd, uid_t owner, gid_t group)
                 ALOGE("Failed to change file owner\n");
             }
 
-            char buf[8192];
-            ssize_t size;
-            while ((size = read(fsfd, buf, sizeof(buf))) > 0) {
-                write(fdfd, buf, size);
-            }
-            if (size < 0) {
+            if (copy_file_contents(fsfd, fdfd) < 0) {
                 ALOGW("Couldn't copy %s: %s\n", name, strerror(errno));
                 result = -1;
             }
@@ -613,6 +709,181 @@ static int _copy_dir_files(int sdfd, int ddfd, uid_t owner, gid_t group)
     return result;
 }
 
+int64_t copy_file_contents(int in_fd, int out_fd) {
+#ifdef FICLONE
+    // Sharing the blocks copies nothing at all, where the file system can.
+    struct stat st;
+    if (ioctl(out_fd, FICLONE, in_fd) == 0 && fstat(out_fd, &st) == 0) {
+        return st.st_size;
+    }
+#endif
+
+    int64_t total = 0;
+    bool in_kernel = true;
+    static constexpr size_t kChunkSize = 1 << 30;
+#ifdef __NR_copy_file_range
+    while (true) {
+        ssize_t bytes = syscall(__NR_copy_file_range, in_fd, nullptr, out_fd, nullptr,
+                kChunkSize, 0);
+        if (bytes < 0 && errno == EINTR) {
+            continue;
+        }
+        if (bytes < 0) {
+            // Not supported, or not between these file systems.
+            if (total > 0 || (errno != ENOSYS && errno != EXDEV && errno != EINVAL &&
+                    errno != EOPNOTSUPP)) {
+                return -1;
+            }
+            break;
+        }
+        if (bytes == 0) {
+            return total;
+        }
+        total += bytes;
+    }
+#endif
+    while (in_kernel) {
+        ssize_t bytes = TEMP_FAILURE_RETRY(sendfile(out_fd, in_fd, nullptr, kChunkSize));
+        if (bytes < 0) {
+            if (total > 0 || (errno != ENOSYS && errno != EINVAL)) {
+                return -1;
+            }
+            in_kernel = false;
+        } else if (bytes == 0) {
+            return total;
+        } else {
+            total += bytes;
+        }
+    }
+
+    char buf[8192];
+    while (true) {
+        ssize_t bytes = TEMP_FAILURE_RETRY(read(in_fd, buf, sizeof(buf)));
+        if (bytes < 0) {
+            return -1;
+        }
+        if (bytes == 0) {
+            return total;
+        }
+        for (ssize_t written = 0; written < bytes; ) {
+            ssize_t n = TEMP_FAILURE_RETRY(write(out_fd, buf + written, bytes - written));
+            if (n < 0) {
+                return -1;
+            }
+            written += n;
+        }
+        total += bytes;
+    }
+}
+
+static bool copy_attributes_at(int dirfd, const char* name, const struct stat& st) {
+    const struct timespec times[2] = { st.st_atim, st.st_mtim };
+    bool ok = true;
+    if (fchownat(dirfd, name, st.st_uid, st.st_gid, AT_SYMLINK_NOFOLLOW) != 0) {
+        PLOG(WARNING) << "Failed to chown " << name;
+        ok = false;
+    }
+    // Symlinks have no mode of their own.
+    if (!S_ISLNK(st.st_mode) && fchmodat(dirfd, name, st.st_mode & 07777, 0) != 0) {
+        PLOG(WARNING) << "Failed to chmod " << name;
+        ok = false;
+    }
+    if (utimensat(dirfd, name, times, AT_SYMLINK_NOFOLLOW) != 0) {
+        PLOG(WARNING) << "Failed to set times of " << name;
+        ok = false;
+    }
+    return ok;
+}
+
+static int copy_tree_at(int src_dirfd, const char* src_name, int dst_dirfd, const char* dst_name,
+        int64_t* bytes) {
+    struct stat st;
+    if (fstatat(src_dirfd, src_name, &st, AT_SYMLINK_NOFOLLOW) != 0) {
+        PLOG(WARNING) << "Failed to stat " << src_name;
+        return -1;
+    }
+
+    int res = 0;
+    if (S_ISDIR(st.st_mode)) {
+        // Directories that already exist are merged into.
+        if (mkdirat(dst_dirfd, dst_name, 0700) != 0 && errno != EEXIST) {
+            PLOG(WARNING) << "Failed to mkdir " << dst_name;
+            return -1;
+        }
+        unique_fd dst_fd(openat(dst_dirfd, dst_name,
+                O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC));
+        int src_fd = openat(src_dirfd, src_name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+        DIR* dir = src_fd < 0 ? nullptr : fdopendir(src_fd);
+        if (dst_fd < 0 || dir == nullptr) {
+            PLOG(WARNING) << "Failed to open " << src_name << " or " << dst_name;
+            if (src_fd >= 0) close(src_fd);
+            return -1;
+        }
+        struct dirent* de;
+        while ((de = readdir(dir)) != nullptr) {
+            const char* name = de->d_name;
+            if (!strcmp(name, ".") || !strcmp(name, "..")) {
+                continue;
+            }
+            if (copy_tree_at(src_fd, name, dst_fd, name, bytes) != 0) {
+                res = -1;
+            }
+        }
+        closedir(dir);
+    } else {
+        // Like cp -F, remove what is in the way first.
+        if (unlinkat(dst_dirfd, dst_name, 0) != 0 && errno != ENOENT) {
+            PLOG(WARNING) << "Failed to remove " << dst_name;
+            return -1;
+        }
+        if (S_ISREG(st.st_mode)) {
+            unique_fd in_fd(openat(src_dirfd, src_name, O_RDONLY | O_NOFOLLOW | O_CLOEXEC));
+            unique_fd out_fd(openat(dst_dirfd, dst_name,
+                    O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC, 0600));
+            int64_t copied;
+            if (in_fd < 0 || out_fd < 0 || (copied = copy_file_contents(in_fd, out_fd)) < 0) {
+                PLOG(WARNING) << "Failed to copy " << src_name;
+                return -1;
+            }
+            *bytes += copied;
+        } else if (S_ISLNK(st.st_mode)) {
+            std::string target(PATH_MAX, '\0');
+            ssize_t len = readlinkat(src_dirfd, src_name, &target[0], target.size());
+            if (len < 0 || static_cast<size_t>(len) >= target.size()) {
+                PLOG(WARNING) << "Failed to read link " << src_name;
+                return -1;
+            }
+            target.resize(len);
+            if (symlinkat(target.c_str(), dst_dirfd, dst_name) != 0) {
+                PLOG(WARNING) << "Failed to symlink " << dst_name;
+                return -1;
+            }
+        } else if (mknodat(dst_dirfd, dst_name, st.st_mode, st.st_rdev) != 0) {
+            PLOG(WARNING) << "Failed to mknod " << dst_name;
+            return -1;
+        }
+    }
+
+    // Set last, so that filling a directory doesn't change its times.
+    if (!copy_attributes_at(dst_dirfd, dst_name, st)) {
+        res = -1;
+    }
+    return res;
+}
+
+int copy_tree(const std::string& from, const std::string& to, int64_t* bytes) {
+    unique_fd src_dirfd(open(android::base::Dirname(from).c_str(),
+            O_RDONLY | O_DIRECTORY | O_CLOEXEC));
+    unique_fd dst_dirfd(open(android::base::Dirname(to).c_str(),
+            O_RDONLY | O_DIRECTORY | O_CLOEXEC));
+    if (src_dirfd < 0 || dst_dirfd < 0) {
+        PLOG(WARNING) << "Failed to open the parents of " << from << " or " << to;
+        return -1;
+    }
+    return copy_tree_at(src_dirfd, android::base::Basename(from).c_str(), dst_dirfd,
+            android::base::Basename(to).c_str(), bytes);
+}
+
 int copy_dir_files(const char *srcname,
                    const char *dstname,
                    uid_t owner,
@@ -114,6 +114,17 @@ int delete_dir_contents_fd(int dfd, const char *name);
 
 int copy_dir_files(const char *srcname, const char *dstname, uid_t owner, gid_t group);
 
+// Copies in_fd into out_fd, which is empty, both at offset 0. Shares the blocks where the file
+// system can, then copies within the kernel, then with reads and writes. Returns the number of
+// bytes copied, or -1 with errno set.
+int64_t copy_file_contents(int in_fd, int out_fd);
+
+// Copies the file or tree at from to to like `cp -F -p -R -P -d`: files in the way are replaced,
+// existing directories merged into, symlinks copied as they are, and modes, owners and times
+// kept. Carries on past errors, returning -1 if there were any. Adds the bytes of file data
+// copied to *bytes.
+int copy_tree(const std::string& from, const std::string& to, int64_t* bytes);
+
 int64_t data_disk_free(const std::string& data_path);
 
 int get_path_inode(const std::string& path, ino_t *inode);
@@ -18,12 +18,15 @@
 
 #include <getopt.h>
 
+#include <atomic>
+#include <chrono>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
 #include <map>
 #include <sstream>
 #include <regex>
+#include <thread>
 
 #include <android-base/file.h>
 #include <android-base/parseint.h>
@@ -212,6 +215,8 @@ bool ListCommand::getPidInfo(
 }
 
 const PidInfo* ListCommand::getPidInfoCached(pid_t serverPid) {
+    // Held while parsing so that several services of a process parse it only once.
+    std::lock_guard<std::mutex> lock(mCachedPidInfosLock);
     auto pair = mCachedPidInfos.insert({serverPid, PidInfo{}});
     if (pair.second /* did insertion take place? */) {
         if (!getPidInfo(serverPid, &pair.first->second)) {
@@ -555,7 +560,11 @@ Status ListCommand::fetchPassthrough(const sp<IServiceManager> &manager) {
     return OK;
 }
 
-Status ListCommand::fetchBinderized(const sp<IServiceManager> &manager) {
+// Services whose debug information is fetched at once; most of the time goes to waiting
+// for IPCs to the HAL processes.
+static constexpr size_t kMaxFetchThreads = 8;
+
+Status ListCommand::fetchBinderized(const sp<IServiceManager> &manager, std::ostream &errors) {
     const std::string mode = "hwbinder";
 
     hidl_vec<hidl_string> fqInstanceNames;
@@ -564,20 +573,44 @@ Status ListCommand::fetchBinderized(const sp<IServiceManager> &manager) {
         fqInstanceNames = names;
     });
     if (!listRet.isOk()) {
-        err() << "Error: Failed to list services for " << mode << ": "
+        errors << "Error: Failed to list services for " << mode << ": "
              << listRet.description() << std::endl;
         return DUMP_BINDERIZED_ERROR;
     }
 
     Status status = OK;
     std::map<std::string, TableEntry> allTableEntries;
+    std::vector<TableEntry*> entries;
     for (const auto &fqInstanceName : fqInstanceNames) {
         // create entry and default assign all fields.
         TableEntry& entry = allTableEntries[fqInstanceName];
+        if (entry.interfaceName.empty()) {
+            entries.push_back(&entry);
+        }
         entry.interfaceName = fqInstanceName;
         entry.transport = mode;
+    }
 
-        status |= fetchBinderizedEntry(manager, &entry);
+    // Errors of each entry are kept apart and reported in order.
+    std::vector<std::stringstream> entryErrors(entries.size());
+    std::vector<Status> entryStatuses(entries.size(), OK);
+    std::atomic<size_t> next(0);
+    auto worker = [&]() {
+        for (size_t i = next++; i < entries.size(); i = next++) {
+            entryStatuses[i] = fetchBinderizedEntry(manager, entries[i], entryErrors[i]);
+        }
+    };
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < std::min(kMaxFetchThreads, entries.size()); i++) {
+        workers.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : workers) {
+        thread.join();
+    }
+    for (size_t i = 0; i < entries.size(); i++) {
+        status |= entryStatuses[i];
+        errors << entryErrors[i].str();
     }
 
     for (auto& pair : allTableEntries) {
@@ -587,10 +620,10 @@ Status ListCommand::fetchBinderized(const sp<IServiceManager> &manager) {
 }
 
 Status ListCommand::fetchBinderizedEntry(const sp<IServiceManager> &manager,
-                                         TableEntry *entry) {
+                                         TableEntry *entry, std::ostream &errors) {
     Status status = OK;
     const auto handleError = [&](Status additionalError, const std::string& msg) {
-        err() << "Warning: Skipping \"" << entry->interfaceName << "\": " << msg << std::endl;
+        errors << "Warning: Skipping \"" << entry->interfaceName << "\": " << msg << std::endl;
         status |= DUMP_BINDERIZED_ERROR | additionalError;
     };
 
@@ -685,15 +718,36 @@ Status ListCommand::fetchBinderizedEntry(const sp<IServiceManager> &manager,
 }
 
 Status ListCommand::fetch() {
+    using std::chrono::steady_clock;
+    const auto toMs = [](steady_clock::duration duration) {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(duration).count();
+    };
+
+    // The sources don't depend on each other, so binderized services, which take the longest,
+    // are fetched in the background while the passthrough ones are.
     Status status = OK;
+    Status binderizedStatus = OK;
+    std::stringstream binderizedErrors;
+    steady_clock::duration binderizedDuration{};
+    std::thread binderizedThread;
     auto bManager = mLshal.serviceManager();
     if (bManager == nullptr) {
         err() << "Failed to get defaultServiceManager()!" << std::endl;
         status |= NO_BINDERIZED_MANAGER;
     } else {
-        status |= fetchBinderized(bManager);
+        binderizedThread = std::thread([&] {
+            auto start = steady_clock::now();
+            binderizedStatus = fetchBinderized(bManager, binderizedErrors);
+            binderizedDuration = steady_clock::now() - start;
+        });
+
+        auto start = steady_clock::now();
         // Passthrough PIDs are registered to the binderized manager as well.
         status |= fetchPassthrough(bManager);
+        if (mReportTiming) {
+            err() << "Fetched passthrough clients in " << toMs(steady_clock::now() - start)
+                  << "ms" << std::endl;
+        }
     }
 
     auto pManager = mLshal.passthroughManager();
@@ -701,7 +755,22 @@ Status ListCommand::fetch() {
         err() << "Failed to get getPassthroughServiceManager()!" << std::endl;
         status |= NO_PASSTHROUGH_MANAGER;
     } else {
+        auto start = steady_clock::now();
         status |= fetchAllLibraries(pManager);
+        if (mReportTiming) {
+            err() << "Fetched passthrough libraries in " << toMs(steady_clock::now() - start)
+                  << "ms" << std::endl;
+        }
+    }
+
+    if (binderizedThread.joinable()) {
+        binderizedThread.join();
+        err() << binderizedErrors.str();
+        status |= binderizedStatus;
+        if (mReportTiming) {
+            err() << "Fetched " << mServicesTable.size() << " binderized services in "
+                  << toMs(binderizedDuration) << "ms" << std::endl;
+        }
     }
     return status;
 }
@@ -791,6 +860,10 @@ void ListCommand::registerAllOptions() {
         thiz->mNeat = true;
         return OK;
     }, "output is machine parsable (no explanatory text).\nCannot be used with --debug."});
+    mOptions.push_back({'\0', "timing", no_argument, v++, [](ListCommand* thiz, const char*) {
+        thiz->mReportTiming = true;
+        return OK;
+    }, "report how long fetching each kind of HAL took\nto stderr."});
 }
 
 // Create 'longopts' argument to getopt_long. Caller is responsible for maintaining
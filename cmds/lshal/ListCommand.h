@@ -21,6 +21,8 @@
 #include <stdint.h>
 
 #include <fstream>
+#include <mutex>
+#include <sstream>
 #include <string>
 #include <vector>
 
@@ -85,16 +87,19 @@ protected:
     Status dump();
     void putEntry(TableEntrySource source, TableEntry &&entry);
     Status fetchPassthrough(const sp<::android::hidl::manager::V1_0::IServiceManager> &manager);
-    Status fetchBinderized(const sp<::android::hidl::manager::V1_0::IServiceManager> &manager);
+    // Writes errors to the given stream so that it can run while other sources are fetched.
+    Status fetchBinderized(const sp<::android::hidl::manager::V1_0::IServiceManager> &manager,
+                           std::ostream &errors);
     Status fetchAllLibraries(const sp<::android::hidl::manager::V1_0::IServiceManager> &manager);
 
+    // Thread-safe, so that several entries can be fetched at once.
     Status fetchBinderizedEntry(const sp<::android::hidl::manager::V1_0::IServiceManager> &manager,
-                                TableEntry *entry);
+                                TableEntry *entry, std::ostream &errors);
 
     // Get relevant information for a PID by parsing files under /d/binder.
     // It is a virtual member function so that it can be mocked.
     virtual bool getPidInfo(pid_t serverPid, PidInfo *info) const;
-    // Retrieve from mCachedPidInfos and call getPidInfo if necessary.
+    // Retrieve from mCachedPidInfos and call getPidInfo if necessary. Thread-safe.
     const PidInfo* getPidInfoCached(pid_t serverPid);
 
     void dumpTable(const NullableOStream<std::ostream>& out) const;
@@ -139,6 +144,9 @@ protected:
     // If true, explanatory text are not emitted.
     bool mNeat = false;
 
+    // If true, report how long fetching from each source took.
+    bool mReportTiming = false;
+
     // If an entry does not exist, need to ask /proc/{pid}/cmdline to get it.
     // If an entry exist but is an empty string, process might have died.
     // If an entry exist and not empty, it contains the cached content of /proc/{pid}/cmdline.
@@ -146,6 +154,7 @@ protected:
 
     // Cache for getPidInfo.
     std::map<pid_t, PidInfo> mCachedPidInfos;
+    std::mutex mCachedPidInfosLock;
 
     // Cache for getPartition.
     std::map<pid_t, Partition> mPartitions;
@@ -594,6 +594,14 @@ TEST_F(ListTest, DumpNeat) {
     EXPECT_EQ("", err.str());
 }
 
+TEST_F(ListTest, ReportTiming) {
+    optind = 1; // mimic Lshal::parseArg()
+    EXPECT_EQ(0u, mockList->main(createArg({"lshal", "--neat", "--timing"})));
+    EXPECT_THAT(err.str(), HasSubstr("Fetched passthrough clients in "));
+    EXPECT_THAT(err.str(), HasSubstr("Fetched passthrough libraries in "));
+    EXPECT_THAT(err.str(), HasSubstr("Fetched 2 binderized services in "));
+}
+
 class HelpTest : public ::testing::Test {
 public:
     void SetUp() override {
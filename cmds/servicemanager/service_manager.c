@@ -135,6 +135,7 @@ static int svc_can_find(const uint16_t *name, size_t name_len, pid_t spid, uid_t
 struct svcinfo
 {
     struct svcinfo *next;
+    struct svcinfo *hash_next;
     uint32_t handle;
     struct binder_death death;
     int allow_isolated;
@@ -143,19 +144,103 @@ struct svcinfo
     uint16_t name[0];
 };
 
+/*
+ * Services are kept on svclist in registration order, which is the order
+ * SVC_MGR_LIST_SERVICES reports them in, and in a hash table keyed by name
+ * for lookups. Services are never removed, only their handle cleared when
+ * they die.
+ */
 struct svcinfo *svclist = NULL;
 
+#define SVC_HASH_BUCKETS 512
+static struct svcinfo *svchash[SVC_HASH_BUCKETS];
+
+/* Lookup statistics, logged every SVC_STATS_LOG_INTERVAL lookups. */
+#define SVC_STATS_LOG_INTERVAL 4096
+static struct {
+    uint32_t services;
+    uint64_t lookups;
+    uint64_t misses;
+    uint64_t probes;
+    uint32_t max_probes;
+} svcstats;
+
+static uint32_t svc_hash(const uint16_t *s16, size_t len)
+{
+    /* FNV-1a over the UTF-16 code units */
+    uint32_t hash = 2166136261u;
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        hash = (hash ^ s16[i]) * 16777619u;
+    }
+    return hash & (SVC_HASH_BUCKETS - 1);
+}
+
+static void svc_log_stats(void)
+{
+    uint32_t longest = 0;
+    uint32_t used = 0;
+    size_t i;
+
+    for (i = 0; i < SVC_HASH_BUCKETS; i++) {
+        uint32_t length = 0;
+        struct svcinfo *si;
+        for (si = svchash[i]; si; si = si->hash_next) {
+            length++;
+        }
+        if (length) {
+            used++;
+        }
+        if (length > longest) {
+            longest = length;
+        }
+    }
+
+    ALOGI("lookup stats: %u services in %u/%u buckets (longest chain %u), "
+          "%" PRIu64 " lookups, %" PRIu64 " misses, %.2f probes per lookup (max %u)\n",
+          svcstats.services, used, SVC_HASH_BUCKETS, longest,
+          svcstats.lookups, svcstats.misses,
+          svcstats.lookups ? (double) svcstats.probes / svcstats.lookups : 0.0,
+          svcstats.max_probes);
+}
+
 struct svcinfo *find_svc(const uint16_t *s16, size_t len)
 {
     struct svcinfo *si;
+    uint32_t probes = 0;
 
-    for (si = svclist; si; si = si->next) {
+    for (si = svchash[svc_hash(s16, len)]; si; si = si->hash_next) {
+        probes++;
         if ((len == si->len) &&
             !memcmp(s16, si->name, len * sizeof(uint16_t))) {
-            return si;
+            break;
         }
     }
-    return NULL;
+
+    svcstats.lookups++;
+    svcstats.probes += probes;
+    if (probes > svcstats.max_probes) {
+        svcstats.max_probes = probes;
+    }
+    if (!si) {
+        svcstats.misses++;
+    }
+    if ((svcstats.lookups % SVC_STATS_LOG_INTERVAL) == 0) {
+        svc_log_stats();
+    }
+    return si;
+}
+
+static void add_svc(struct svcinfo *si)
+{
+    uint32_t bucket = svc_hash(si->name, si->len);
+
+    si->next = svclist;
+    svclist = si;
+    si->hash_next = svchash[bucket];
+    svchash[bucket] = si;
+    svcstats.services++;
 }
 
 void svcinfo_death(struct binder_state *bs, void *ptr)
@@ -238,8 +323,7 @@ int do_add_service(struct binder_state *bs, const uint16_t *s, size_t len, uint3
         si->death.ptr = si;
         si->allow_isolated = allow_isolated;
         si->dumpsys_priority = dumpsys_priority;
-        si->next = svclist;
-        svclist = si;
+        add_svc(si);
     }
 
     binder_acquire(bs, handle);
@@ -0,0 +1,55 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_SURFACEREPLAYER_TRACECOMPACTION_H
+#define ANDROID_SURFACEREPLAYER_TRACECOMPACTION_H
+
+#include <frameworks/native/cmds/surfacereplayer/proto/src/trace.pb.h>
+
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+
+namespace android {
+
+/*
+ * Turns Traces into their compact form. A long trace can be compacted one batch of increments
+ * at a time, as long as the batches are compacted in order by the same TraceCompactor and then
+ * concatenated, since each batch continues the timestamps, names and surface state of the
+ * ones before it.
+ */
+class TraceCompactor {
+  public:
+    // Compacts trace in place. Traces that are already compact are left alone.
+    void compact(Trace* trace);
+
+  private:
+    void compactIncrement(Trace* trace, Increment* increment);
+    void compactTransaction(Transaction* transaction);
+    uint32_t internName(Trace* trace, const std::string& name);
+
+    int64_t mLastTimeStamp = 0;
+    std::unordered_map<std::string, uint32_t> mNameIndices;
+    // Last serialized change of each kind, per layer
+    std::unordered_map<int32_t, std::unordered_map<int, std::string>> mSurfaceState;
+};
+
+// Turns a compact trace back into the regular form in place. Returns false if the trace refers
+// to a name it does not hold.
+bool expandTrace(Trace* trace);
+
+}  // namespace android
+#endif
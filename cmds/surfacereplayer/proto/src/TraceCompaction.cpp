@@ -0,0 +1,122 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <surfacereplayer/TraceCompaction.h>
+
+namespace android {
+
+void TraceCompactor::compact(Trace* trace) {
+    if (trace->compact()) {
+        return;
+    }
+    trace->set_compact(true);
+    for (auto& increment : *trace->mutable_increment()) {
+        compactIncrement(trace, &increment);
+    }
+}
+
+void TraceCompactor::compactIncrement(Trace* trace, Increment* increment) {
+    const int64_t timeStamp = increment->time_stamp();
+    increment->set_time_stamp(timeStamp - mLastTimeStamp);
+    mLastTimeStamp = timeStamp;
+
+    switch (increment->increment_case()) {
+        case Increment::kTransaction:
+            compactTransaction(increment->mutable_transaction());
+            break;
+        case Increment::kSurfaceCreation: {
+            SurfaceCreation* creation = increment->mutable_surface_creation();
+            creation->set_name_index(internName(trace, creation->name()));
+            creation->set_name(std::string());
+            mSurfaceState.erase(creation->id());
+        } break;
+        case Increment::kSurfaceDeletion:
+            mSurfaceState.erase(increment->surface_deletion().id());
+            break;
+        case Increment::kDisplayCreation: {
+            DisplayCreation* creation = increment->mutable_display_creation();
+            creation->set_name_index(internName(trace, creation->name()));
+            creation->set_name(std::string());
+        } break;
+        default:
+            break;
+    }
+}
+
+void TraceCompactor::compactTransaction(Transaction* transaction) {
+    auto* changes = transaction->mutable_surface_change();
+    int kept = 0;
+    for (int i = 0; i < changes->size(); i++) {
+        const SurfaceChange& change = changes->Get(i);
+        // Deferring a transaction again is not a no-op, unlike setting a property again
+        if (change.SurfaceChange_case() != SurfaceChange::kDeferredTransaction) {
+            std::string value = change.SerializeAsString();
+            std::string& last = mSurfaceState[change.id()][change.SurfaceChange_case()];
+            if (value == last) {
+                continue;
+            }
+            last = std::move(value);
+        }
+        changes->SwapElements(i, kept++);
+    }
+    changes->DeleteSubrange(kept, changes->size() - kept);
+}
+
+uint32_t TraceCompactor::internName(Trace* trace, const std::string& name) {
+    auto it = mNameIndices.find(name);
+    if (it != mNameIndices.end()) {
+        return it->second;
+    }
+
+    const uint32_t index = mNameIndices.size();
+    mNameIndices.emplace(name, index);
+    trace->add_name(name);
+    return index;
+}
+
+bool expandTrace(Trace* trace) {
+    if (!trace->compact()) {
+        return true;
+    }
+
+    int64_t timeStamp = 0;
+    for (auto& increment : *trace->mutable_increment()) {
+        timeStamp += increment.time_stamp();
+        increment.set_time_stamp(timeStamp);
+
+        if (increment.has_surface_creation()) {
+            SurfaceCreation* creation = increment.mutable_surface_creation();
+            if (creation->name_index() >= static_cast<uint32_t>(trace->name_size())) {
+                return false;
+            }
+            creation->set_name(trace->name(creation->name_index()));
+            creation->clear_name_index();
+        } else if (increment.has_display_creation()) {
+            DisplayCreation* creation = increment.mutable_display_creation();
+            if (creation->name_index() >= static_cast<uint32_t>(trace->name_size())) {
+                return false;
+            }
+            creation->set_name(trace->name(creation->name_index()));
+            creation->clear_name_index();
+        }
+    }
+
+    trace->clear_compact();
+    trace->clear_name();
+    return true;
+}
+
+}  // namespace android
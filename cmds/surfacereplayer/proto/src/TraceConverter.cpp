@@ -0,0 +1,98 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Converts SurfaceInterceptor traces between the regular and the compact form, so that traces
+ * captured before the interceptor compacted its output take less space, and compact traces can
+ * be read by tools that only understand the regular form.
+ */
+
+#include <surfacereplayer/TraceCompaction.h>
+
+#include <android-base/file.h>
+
+#include <iostream>
+#include <string>
+#include <unistd.h>
+
+using namespace android;
+
+void printHelpMenu() {
+    std::cout << "Usage: surfacetraceconverter [OPTIONS...] <INPUT TRACE> <OUTPUT TRACE>\n";
+    std::cout << "  Compacts the input trace unless told otherwise\n\n";
+    std::cout << "  -x  Expand a compact trace into the regular form\n";
+    std::cout << "  -h  Display help menu\n";
+    std::cout << std::endl;
+}
+
+int main(int argc, char** argv) {
+    bool expand = false;
+
+    int opt = 0;
+    while ((opt = getopt(argc, argv, "xh?")) != -1) {
+        switch (opt) {
+            case 'x':
+                expand = true;
+                break;
+            case 'h':
+            case '?':
+                printHelpMenu();
+                return 0;
+            default:
+                printHelpMenu();
+                return 1;
+        }
+    }
+
+    if (argc - optind != 2) {
+        printHelpMenu();
+        return 1;
+    }
+    const std::string inputFile(argv[optind]);
+    const std::string outputFile(argv[optind + 1]);
+
+    std::string input;
+    if (!android::base::ReadFileToString(inputFile, &input, true)) {
+        std::cerr << "Could not read " << inputFile << std::endl;
+        return 1;
+    }
+
+    Trace trace;
+    if (!trace.ParseFromString(input)) {
+        std::cerr << inputFile << " is not a trace" << std::endl;
+        return 1;
+    }
+
+    if (expand) {
+        if (!expandTrace(&trace)) {
+            std::cerr << inputFile << " refers to names it does not hold" << std::endl;
+            return 1;
+        }
+    } else {
+        TraceCompactor().compact(&trace);
+    }
+
+    std::string output;
+    if (!trace.SerializeToString(&output) ||
+            !android::base::WriteStringToFile(output, outputFile)) {
+        std::cerr << "Could not write " << outputFile << std::endl;
+        return 1;
+    }
+
+    std::cout << inputFile << ": " << input.size() << " bytes, " << outputFile << ": "
+              << output.size() << " bytes" << std::endl;
+    return 0;
+}
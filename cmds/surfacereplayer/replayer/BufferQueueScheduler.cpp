@@ -18,6 +18,7 @@
 #include "BufferQueueScheduler.h"
 
 #include <android/native_window.h>
+#include <gui/FrameTimestamps.h>
 #include <gui/Surface.h>
 
 using namespace android;
@@ -72,6 +73,60 @@ void BufferQueueScheduler::setSurfaceControl(
     mCondition.notify_one();
 }
 
+void BufferQueueScheduler::enableLatencyTracking() {
+    mTrackLatency = true;
+}
+
+std::vector<FrameLatency> BufferQueueScheduler::getFrameLatencies() {
+    sp<SurfaceControl> surfaceControl;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        surfaceControl = mSurfaceControl;
+    }
+    if (surfaceControl != nullptr) {
+        updateFrameLatencies(surfaceControl->getSurface());
+    }
+
+    std::lock_guard<std::mutex> lock(mLatencyMutex);
+    return mFrameLatencies;
+}
+
+void BufferQueueScheduler::updateFrameLatencies(const sp<Surface>& surface) {
+    std::lock_guard<std::mutex> lock(mLatencyMutex);
+    bool resolvedSoFar = true;
+    for (size_t i = mFirstUnresolvedFrame; i < mFrameLatencies.size(); i++) {
+        FrameLatency& frame = mFrameLatencies[i];
+        bool resolved = frame.latchTime != -1;
+        if (!resolved) {
+            nsecs_t latchTime = FrameEvents::TIMESTAMP_PENDING;
+            nsecs_t presentTime = FrameEvents::TIMESTAMP_PENDING;
+            status_t status = surface->getFrameTimestamps(frame.frameNumber, nullptr, nullptr,
+                    &latchTime, nullptr, nullptr, nullptr, &presentTime, nullptr, nullptr);
+            if (status == BAD_VALUE) {
+                // The display doesn't report present fences; latching is all there is
+                presentTime = -1;
+                status = surface->getFrameTimestamps(frame.frameNumber, nullptr, nullptr,
+                        &latchTime, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr);
+            }
+            if (status != NO_ERROR) {
+                // Dropped out of the history before it was composited, or dropped
+                // by SurfaceFlinger altogether; it will never resolve
+                resolved = true;
+            } else if (latchTime != FrameEvents::TIMESTAMP_PENDING &&
+                    presentTime != FrameEvents::TIMESTAMP_PENDING) {
+                frame.latchTime = latchTime;
+                frame.presentTime = presentTime;
+                resolved = true;
+            }
+        }
+
+        resolvedSoFar = resolvedSoFar && resolved;
+        if (resolvedSoFar) {
+            mFirstUnresolvedFrame = i + 1;
+        }
+    }
+}
+
 void BufferQueueScheduler::bufferUpdate(const Dimensions& dimensions) {
     sp<Surface> s = mSurfaceControl->getSurface();
     s->setBuffersDimensions(dimensions.width, dimensions.height);
@@ -81,6 +136,10 @@ void BufferQueueScheduler::fillSurface(const std::shared_ptr<Event>& event) {
     ANativeWindow_Buffer outBuffer;
     sp<Surface> s = mSurfaceControl->getSurface();
 
+    if (mTrackLatency) {
+        s->enableFrameTimestamps(true);
+    }
+
     status_t status = s->lock(&outBuffer, nullptr);
 
     if (status != NO_ERROR) {
@@ -103,7 +162,19 @@ void BufferQueueScheduler::fillSurface(const std::shared_ptr<Event>& event) {
 
     event->readyToExecute();
 
+    FrameLatency frame;
+    frame.frameNumber = s->getNextFrameNumber();
+    frame.postTime = systemTime();
+
     status = s->unlockAndPost();
 
     ALOGE_IF(status != NO_ERROR, "fillSurface: failed to unlock and post buffer, (%d)", status);
+
+    if (mTrackLatency && status == NO_ERROR) {
+        {
+            std::lock_guard<std::mutex> lock(mLatencyMutex);
+            mFrameLatencies.push_back(frame);
+        }
+        updateFrameLatencies(s);
+    }
 }
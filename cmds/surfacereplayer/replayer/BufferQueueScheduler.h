@@ -23,12 +23,14 @@
 #include <gui/SurfaceControl.h>
 
 #include <utils/StrongPointer.h>
+#include <utils/Timers.h>
 
 #include <atomic>
 #include <condition_variable>
 #include <mutex>
 #include <queue>
 #include <utility>
+#include <vector>
 
 namespace android {
 
@@ -50,6 +52,14 @@ struct BufferEvent {
     Dimensions dimensions;
 };
 
+// Compositor timestamps of a posted buffer. Times SurfaceFlinger never reported are -1.
+struct FrameLatency {
+    uint64_t frameNumber = 0;
+    nsecs_t postTime = -1;
+    nsecs_t latchTime = -1;
+    nsecs_t presentTime = -1;
+};
+
 class BufferQueueScheduler {
   public:
     BufferQueueScheduler(const sp<SurfaceControl>& surfaceControl, const HSV& color, int id);
@@ -60,9 +70,18 @@ class BufferQueueScheduler {
 
     void setSurfaceControl(const sp<SurfaceControl>& surfaceControl, const HSV& color);
 
+    // Record the compositor timestamps of every posted buffer. Must be called before
+    // startScheduling.
+    void enableLatencyTracking();
+    std::vector<FrameLatency> getFrameLatencies();
+
   private:
     void bufferUpdate(const Dimensions& dimensions);
 
+    // The surface only keeps the timestamps of its last few frames, so resolve them
+    // after every post rather than at the end of the replay.
+    void updateFrameLatencies(const sp<Surface>& surface);
+
     // Lock and fill the surface, block until the event is signaled by the main loop,
     // then unlock and post the buffer.
     void fillSurface(const std::shared_ptr<Event>& event);
@@ -76,6 +95,11 @@ class BufferQueueScheduler {
     std::queue<BufferEvent> mBufferEvents;
     std::mutex mMutex;
     std::condition_variable mCondition;
+
+    bool mTrackLatency = false;
+    std::mutex mLatencyMutex;
+    std::vector<FrameLatency> mFrameLatencies;
+    size_t mFirstUnresolvedFrame = 0;
 };
 
 }  // namespace android
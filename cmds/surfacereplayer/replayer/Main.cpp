@@ -49,6 +49,8 @@ void printHelpMenu() {
 
     std::cout << "  -n  Ignore timestamps and run through trace as fast as possible\n";
 
+    std::cout << "  -r  Report the compositor latency of every replayed frame\n";
+
     std::cout << "  -l  Indefinitely loop the replayer\n";
 
     std::cout << "  -h  Display help menu\n";
@@ -61,11 +63,12 @@ int main(int argc, char** argv) {
     bool loop = false;
     bool wait = true;
     bool pauseBeginning = false;
+    bool reportLatency = false;
     int numThreads = DEFAULT_THREADS;
     long stopHere = -1;
 
     int opt = 0;
-    while ((opt = getopt(argc, argv, "mt:s:nlh?")) != -1) {
+    while ((opt = getopt(argc, argv, "mt:s:nrlh?")) != -1) {
         switch (opt) {
             case 'm':
                 pauseBeginning = true;
@@ -79,6 +82,9 @@ int main(int argc, char** argv) {
             case 'n':
                 wait = false;
                 break;
+            case 'r':
+                reportLatency = true;
+                break;
             case 'l':
                 loop = true;
                 break;
@@ -102,7 +108,7 @@ int main(int argc, char** argv) {
 
     status_t status = NO_ERROR;
     do {
-        android::Replayer r(filename, pauseBeginning, numThreads, wait, stopHere);
+        android::Replayer r(filename, pauseBeginning, numThreads, wait, stopHere, reportLatency);
         status = r.replay();
     } while(loop);
 
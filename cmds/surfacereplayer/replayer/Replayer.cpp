@@ -18,9 +18,12 @@
 
 #include "Replayer.h"
 
+#include <surfacereplayer/TraceCompaction.h>
+
 #include <android/native_window.h>
 
 #include <android-base/file.h>
+#include <android-base/stringprintf.h>
 
 #include <gui/BufferQueue.h>
 #include <gui/ISurfaceComposer.h>
@@ -33,6 +36,7 @@
 #include <utils/String8.h>
 #include <utils/Trace.h>
 
+#include <algorithm>
 #include <chrono>
 #include <cmath>
 #include <condition_variable>
@@ -48,17 +52,24 @@
 
 using namespace android;
 
+// Increments dispatched this long after their recorded time count as late
+static constexpr nsecs_t LATE_THRESHOLD = ms2ns(1);
+
+// Time for SurfaceFlinger to composite the last frames once vsync injection stops
+static constexpr auto LATENCY_DRAIN_TIME = std::chrono::milliseconds(100);
+
 std::atomic_bool Replayer::sReplayingManually(false);
 
 Replayer::Replayer(const std::string& filename, bool replayManually, int numThreads, bool wait,
-        nsecs_t stopHere)
+        nsecs_t stopHere, bool reportLatency)
       : mTrace(),
         mLoaded(false),
         mIncrementIndex(0),
         mCurrentTime(0),
         mNumThreads(numThreads),
         mWaitForTimeStamps(wait),
-        mStopTimeStamp(stopHere) {
+        mStopTimeStamp(stopHere),
+        mReportLatency(reportLatency) {
     srand(RAND_COLOR_SEED);
 
     std::string input;
@@ -67,13 +78,14 @@ Replayer::Replayer(const std::string& filename, bool replayManually, int numThre
         abort();
     }
 
-    mLoaded = mTrace.ParseFromString(input);
+    mLoaded = mTrace.ParseFromString(input) && expandTrace(&mTrace);
     if (!mLoaded) {
         std::cerr << "Trace did not load." << std::endl;
         abort();
     }
 
     mCurrentTime = mTrace.increment(0).time_stamp();
+    buildTimeline();
 
     sReplayingManually.store(replayManually);
 
@@ -82,16 +94,23 @@ Replayer::Replayer(const std::string& filename, bool replayManually, int numThre
     }
 }
 
-Replayer::Replayer(const Trace& t, bool replayManually, int numThreads, bool wait, nsecs_t stopHere)
+Replayer::Replayer(const Trace& t, bool replayManually, int numThreads, bool wait,
+        nsecs_t stopHere, bool reportLatency)
       : mTrace(t),
-        mLoaded(true),
+        mLoaded(expandTrace(&mTrace)),
         mIncrementIndex(0),
         mCurrentTime(0),
         mNumThreads(numThreads),
         mWaitForTimeStamps(wait),
-        mStopTimeStamp(stopHere) {
+        mStopTimeStamp(stopHere),
+        mReportLatency(reportLatency) {
     srand(RAND_COLOR_SEED);
+    if (!mLoaded) {
+        std::cerr << "Trace did not load." << std::endl;
+        abort();
+    }
     mCurrentTime = mTrace.increment(0).time_stamp();
+    buildTimeline();
 
     sReplayingManually.store(replayManually);
 
@@ -117,18 +136,23 @@ status_t Replayer::replay() {
     initReplay();
 
     ALOGV("Starting actual Replay!");
+    mReplayStartTime = systemTime();
     while (!mPendingIncrements.empty()) {
-        mCurrentIncrement = mTrace.increment(mIncrementIndex);
+        const Increment& currentIncrement = mTrace.increment(mIncrementIndex);
 
-        if (mHasStopped == false && mCurrentIncrement.time_stamp() >= mStopTimeStamp) {
+        if (mHasStopped == false && currentIncrement.time_stamp() >= mStopTimeStamp) {
             mHasStopped = true;
             sReplayingManually.store(true);
         }
 
-        waitForConsoleCommmand();
+        if (waitForConsoleCommmand()) {
+            // Pick the recorded timing back up from where the replay was paused
+            mReplayStartTime = systemTime() - mTimeline[mIncrementIndex];
+        }
 
+        const nsecs_t deadline = mReplayStartTime + mTimeline[mIncrementIndex];
         if (mWaitForTimeStamps) {
-            waitUntilTimestamp(mCurrentIncrement.time_stamp());
+            waitUntilDeadline(deadline);
         }
 
         auto event = mPendingIncrements.front();
@@ -136,6 +160,14 @@ status_t Replayer::replay() {
 
         event->complete();
 
+        if (mWaitForTimeStamps) {
+            const nsecs_t lateness = systemTime() - deadline;
+            if (lateness > LATE_THRESHOLD) {
+                mLateIncrements++;
+            }
+            mMaxLateness = std::max(mMaxLateness, lateness);
+        }
+
         if (event->getIncrementType() == Increment::kVsyncEvent) {
             mWaitingForNextVSync = false;
         }
@@ -150,11 +182,16 @@ status_t Replayer::replay() {
         }
 
         mIncrementIndex++;
-        mCurrentTime = mCurrentIncrement.time_stamp();
+        mCurrentTime = currentIncrement.time_stamp();
     }
 
     SurfaceComposerClient::enableVSyncInjections(false);
 
+    if (mReportLatency) {
+        std::this_thread::sleep_for(LATENCY_DRAIN_TIME);
+        printLatencyReport();
+    }
+
     return status;
 }
 
@@ -171,6 +208,14 @@ status_t Replayer::initReplay() {
     return NO_ERROR;
 }
 
+void Replayer::buildTimeline() {
+    const int64_t start = mTrace.increment(0).time_stamp();
+    mTimeline.reserve(mTrace.increment_size());
+    for (const auto& increment : mTrace.increment()) {
+        mTimeline.push_back(increment.time_stamp() - start);
+    }
+}
+
 void Replayer::stopAutoReplayHandler(int /*signal*/) {
     if (sReplayingManually) {
         SurfaceComposerClient::enableVSyncInjections(false);
@@ -195,9 +240,9 @@ bool isNumber(const std::string& s) {
            std::find_if(s.begin(), s.end(), [](char c) { return !std::isdigit(c); }) == s.end();
 }
 
-void Replayer::waitForConsoleCommmand() {
+bool Replayer::waitForConsoleCommmand() {
     if (!sReplayingManually || mWaitingForNextVSync) {
-        return;
+        return false;
     }
 
     while (true) {
@@ -248,7 +293,7 @@ void Replayer::waitForConsoleCommmand() {
             mHasStopped = false;
             break;
         } else if (inputs[0] == "l") {  // list
-            std::cout << "Time stamp: " << mCurrentIncrement.time_stamp() << "\n";
+            std::cout << "Time stamp: " << mTrace.increment(mIncrementIndex).time_stamp() << "\n";
             continue;
         } else if (inputs[0] == "q") {  // quit
             SurfaceComposerClient::enableVSyncInjections(false);
@@ -270,10 +315,12 @@ void Replayer::waitForConsoleCommmand() {
 
         std::cout << "Invalid Command" << std::endl;
     }
+
+    return true;
 }
 
 status_t Replayer::dispatchEvent(int index) {
-    auto increment = mTrace.increment(index);
+    const Increment& increment = mTrace.increment(index);
     std::shared_ptr<Event> event = std::make_shared<Event>(increment.increment_case());
     mPendingIncrements.push(event);
 
@@ -301,6 +348,9 @@ status_t Replayer::dispatchEvent(int index) {
             if (mBufferQueueSchedulers.count(layerId) == 0) {
                 mBufferQueueSchedulers[layerId] = std::make_shared<BufferQueueScheduler>(
                         mLayers[layerId], mColors[layerId], layerId);
+                if (mReportLatency) {
+                    mBufferQueueSchedulers[layerId]->enableLatencyTracking();
+                }
                 mBufferQueueSchedulers[layerId]->addEvent(bufferEvent);
 
                 std::thread(&BufferQueueScheduler::startScheduling,
@@ -658,6 +708,9 @@ void Replayer::doDeleteSurfaceControls() {
     std::lock_guard<std::mutex> lock2(mLayerLock);
     if (!mLayersPendingRemoval.empty()) {
         for (int id : mLayersPendingRemoval) {
+            if (mReportLatency && mBufferQueueSchedulers.count(id) != 0) {
+                collectFrameLatencies(id, *mBufferQueueSchedulers[id]);
+            }
             mLayers.erase(id);
             mColors.erase(id);
             mBufferQueueSchedulers.erase(id);
@@ -708,9 +761,68 @@ void Replayer::updatePowerMode(const PowerModeUpdate& pmu, const std::shared_ptr
     SurfaceComposerClient::setDisplayPowerMode(mDisplays[pmu.id()], pmu.mode());
 }
 
-void Replayer::waitUntilTimestamp(int64_t timestamp) {
-    ALOGV("Waiting for %lld nanoseconds...", static_cast<int64_t>(timestamp - mCurrentTime));
-    std::this_thread::sleep_for(std::chrono::nanoseconds(timestamp - mCurrentTime));
+void Replayer::waitUntilDeadline(nsecs_t deadline) {
+    const nsecs_t delay = deadline - systemTime();
+    if (delay <= 0) {
+        return;
+    }
+    ALOGV("Waiting for %lld nanoseconds...", static_cast<int64_t>(delay));
+    std::this_thread::sleep_for(std::chrono::nanoseconds(delay));
+}
+
+void Replayer::collectFrameLatencies(layer_id id, BufferQueueScheduler& bqs) {
+    auto frames = bqs.getFrameLatencies();
+    auto& collected = mFrameLatencies[id];
+    collected.insert(collected.end(), frames.begin(), frames.end());
+}
+
+void Replayer::printLatencyReport() {
+    std::lock_guard<std::mutex> lock1(mPendingLayersLock);
+    {
+        std::lock_guard<std::mutex> lock2(mBufferQueueSchedulerLock);
+        for (const auto& bqs : mBufferQueueSchedulers) {
+            collectFrameLatencies(bqs.first, *bqs.second);
+        }
+    }
+
+    auto formatLatency = [](nsecs_t from, nsecs_t to) {
+        return to < 0 ? std::string("-") : base::StringPrintf("%.3f", ns2us(to - from) / 1000.0);
+    };
+
+    size_t frameCount = 0;
+    size_t presentCount = 0;
+    nsecs_t totalPresentLatency = 0;
+    nsecs_t maxPresentLatency = 0;
+    std::cout << "layer,frame,latch_ms,present_ms\n";
+    for (const auto& layer : mFrameLatencies) {
+        for (const FrameLatency& frame : layer.second) {
+            std::cout << layer.first << "," << frame.frameNumber << ","
+                      << formatLatency(frame.postTime, frame.latchTime) << ","
+                      << formatLatency(frame.postTime, frame.presentTime) << "\n";
+            frameCount++;
+            if (frame.presentTime >= 0) {
+                const nsecs_t latency = frame.presentTime - frame.postTime;
+                presentCount++;
+                totalPresentLatency += latency;
+                maxPresentLatency = std::max(maxPresentLatency, latency);
+            }
+        }
+    }
+
+    std::cout << "Replayed " << frameCount << " frames, " << presentCount << " presented";
+    if (presentCount > 0) {
+        std::cout << base::StringPrintf(", present latency avg %.3f ms, max %.3f ms",
+                ns2us(totalPresentLatency / presentCount) / 1000.0,
+                ns2us(maxPresentLatency) / 1000.0);
+    }
+    std::cout << "\n";
+    if (mWaitForTimeStamps) {
+        std::cout << mLateIncrements << " of " << mTrace.increment_size()
+                  << base::StringPrintf(" increments late, by up to %.3f ms",
+                          ns2us(mMaxLateness) / 1000.0);
+        std::cout << "\n";
+    }
+    std::cout << std::flush;
 }
 
 void Replayer::waitUntilDeferredTransactionLayerExists(
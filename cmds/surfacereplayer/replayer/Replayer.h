@@ -28,15 +28,18 @@
 
 #include <utils/Errors.h>
 #include <utils/StrongPointer.h>
+#include <utils/Timers.h>
 
 #include <stdatomic.h>
 #include <condition_variable>
+#include <map>
 #include <memory>
 #include <mutex>
 #include <queue>
 #include <thread>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
 namespace android {
 
@@ -53,16 +56,19 @@ typedef google::protobuf::RepeatedPtrField<DisplayChange> DisplayChanges;
 class Replayer {
   public:
     Replayer(const std::string& filename, bool replayManually = false,
-            int numThreads = DEFAULT_THREADS, bool wait = true, nsecs_t stopHere = -1);
+            int numThreads = DEFAULT_THREADS, bool wait = true, nsecs_t stopHere = -1,
+            bool reportLatency = false);
     Replayer(const Trace& trace, bool replayManually = false, int numThreads = DEFAULT_THREADS,
-            bool wait = true, nsecs_t stopHere = -1);
+            bool wait = true, nsecs_t stopHere = -1, bool reportLatency = false);
 
     status_t replay();
 
   private:
     status_t initReplay();
+    void buildTimeline();
 
-    void waitForConsoleCommmand();
+    // Returns whether the replay was paused for a command
+    bool waitForConsoleCommmand();
     static void stopAutoReplayHandler(int signal);
 
     status_t dispatchEvent(int index);
@@ -121,7 +127,9 @@ class Replayer {
             display_id id, const ProjectionChange& pc);
 
     void doDeleteSurfaceControls();
-    void waitUntilTimestamp(int64_t timestamp);
+    void waitUntilDeadline(nsecs_t deadline);
+    void collectFrameLatencies(layer_id id, BufferQueueScheduler& bqs);
+    void printLatencyReport();
     void waitUntilDeferredTransactionLayerExists(
             const DeferredTransactionChange& dtc, std::unique_lock<std::mutex>& lock);
     status_t loadSurfaceComposerClient();
@@ -132,7 +140,11 @@ class Replayer {
     int64_t mCurrentTime = 0;
     int32_t mNumThreads = DEFAULT_THREADS;
 
-    Increment mCurrentIncrement;
+    // Offset of every increment from the start of the trace, computed before playback so
+    // that each one is scheduled against the start of the replay rather than the one
+    // before it, which lets delays add up
+    std::vector<nsecs_t> mTimeline;
+    nsecs_t mReplayStartTime = 0;
 
     std::string mLastInput;
 
@@ -142,6 +154,10 @@ class Replayer {
     nsecs_t mStopTimeStamp;
     bool mHasStopped;
 
+    bool mReportLatency;
+    int mLateIncrements = 0;
+    nsecs_t mMaxLateness = 0;
+
     std::mutex mLayerLock;
     std::condition_variable mLayerCond;
     std::unordered_map<layer_id, sp<SurfaceControl>> mLayers;
@@ -152,6 +168,8 @@ class Replayer {
 
     std::mutex mBufferQueueSchedulerLock;
     std::unordered_map<layer_id, std::shared_ptr<BufferQueueScheduler>> mBufferQueueSchedulers;
+    // Frames of the layers deleted during the replay, kept for the latency report
+    std::map<layer_id, std::vector<FrameLatency>> mFrameLatencies;
 
     std::mutex mDisplayLock;
     std::condition_variable mDisplayCond;
@@ -23,8 +23,19 @@
 __BEGIN_DECLS
 
 int64_t stat_size(struct stat *s);
+
+/*
+ * Returns the size of what is in the directory dfd, which is closed, not
+ * following symlinks.
+ */
 int64_t calculate_dir_size(int dfd);
 
+/*
+ * Same as calculate_dir_size(), with the subdirectories of dfd shared out
+ * across up to threads threads, the calling one included.
+ */
+int64_t calculate_dir_size_parallel(int dfd, int threads);
+
 __END_DECLS
 
 #endif /* __LIBDISKUSAGE_DIRSIZE_H */
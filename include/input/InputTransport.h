@@ -47,6 +47,10 @@ struct InputMessage {
         TYPE_KEY = 1,
         TYPE_MOTION = 2,
         TYPE_FINISHED = 3,
+        // Carries a shared memory ring in its ancillary data; carries no body.
+        TYPE_ATTACH_RING = 4,
+        // Tells a consumer that was waiting that the ring has messages; carries no body.
+        TYPE_RING_DOORBELL = 5,
     };
 
     struct Header {
@@ -134,6 +138,12 @@ struct InputMessage {
  *
  * Each endpoint has its own InputChannel object that specifies its file descriptor.
  *
+ * Optionally, the messages the server sends can go through a ring in shared memory
+ * instead, so that a burst of events costs one syscall on each end rather than one per
+ * message.  The socket still carries the client's messages, and a doorbell message
+ * whenever the client had found the ring empty, so the client keeps polling the
+ * socket's fd as usual.
+ *
  * The input channel is closed when all references to it are released.
  */
 class InputChannel : public RefBase {
@@ -178,12 +188,35 @@ public:
      */
     status_t receiveMessage(InputMessage* msg);
 
-    /* Returns a new object that has a duplicate of this channel's fd. */
+    /* Returns a new object that has a duplicate of this channel's fd.
+     *
+     * The duplicate doesn't share the shared memory ring, so duplicate client channels
+     * before they receive any messages.
+     */
     sp<InputChannel> dup() const;
 
+    /* Makes the messages this end sends go through a shared memory ring.
+     *
+     * Only the server end may do this.  The ring is handed to the other end over the
+     * socket, after whatever was sent before.
+     *
+     * Returns OK on success, in which case the socket stays in use as the fallback.
+     */
+    status_t enableSharedMemoryTransport();
+
+    /* Returns true if messages to or from the other end go through a shared memory ring. */
+    inline bool isUsingSharedMemoryTransport() const { return mRing != NULL; }
+
 private:
+    struct Ring;
+
     std::string mName;
     int mFd;
+    Ring* mRing;
+
+    status_t sendSocketMessage(const InputMessage* msg, int fd);
+    status_t receiveSocketMessage(InputMessage* msg, int* outFd);
+    status_t attachRing(int fd);
 };
 
 /*
@@ -346,12 +379,46 @@ public:
      */
     bool hasPendingBatch() const;
 
+    // How touch positions are resampled to the frame time.
+    enum ResampleStrategy {
+        // Interpolates or extrapolates from the two most recent samples, a few
+        // milliseconds behind the frame time to hide mispredictions.
+        RESAMPLE_STRATEGY_LINEAR,
+
+        // Predicts all the way to the frame time from a least squares fit of each
+        // pointer's velocity over its recent history.  Lower latency for apps that
+        // draw under the finger, at the cost of occasionally overshooting.
+        RESAMPLE_STRATEGY_PREDICT,
+    };
+
+    /* Selects the resampling strategy for this consumer.  The default is
+     * RESAMPLE_STRATEGY_LINEAR unless overridden with debug.input.resample_strategy.
+     */
+    void setResampleStrategy(ResampleStrategy strategy);
+    inline ResampleStrategy getResampleStrategy() const { return mResampleStrategy; }
+
+    // How far extrapolated touch positions were from where the pointer actually
+    // turned out to be at that time, in pixels.
+    struct PredictionStats {
+        size_t count;
+        float meanError;
+        float maxError;
+    };
+    PredictionStats getPredictionStats() const;
+
 private:
     int mTouchMoveCounter = 0;
 
     // True if touch resampling is enabled.
     const bool mResampleTouch;
 
+    ResampleStrategy mResampleStrategy;
+
+    // Errors of the extrapolated samples that have been scored so far.
+    size_t mPredictionCount;
+    float mPredictionErrorSum;
+    float mPredictionErrorMax;
+
     // The input channel.
     sp<InputChannel> mChannel;
 
@@ -407,12 +474,17 @@ private:
         }
     };
     struct TouchState {
+        // Enough samples for a least squares fit, the most recent first.
+        enum { MAX_HISTORY = 4 };
+
         int32_t deviceId;
         int32_t source;
         size_t historyCurrent;
         size_t historySize;
-        History history[2];
+        History history[MAX_HISTORY];
         History lastResample;
+        // True if lastResample was extrapolated, and not yet scored against the real samples.
+        bool lastResamplePredicted;
 
         void initialize(int32_t deviceId, int32_t source) {
             this->deviceId = deviceId;
@@ -421,20 +493,25 @@ private:
             historySize = 0;
             lastResample.eventTime = 0;
             lastResample.idBits.clear();
+            lastResamplePredicted = false;
         }
 
         void addHistory(const InputMessage& msg) {
-            historyCurrent ^= 1;
-            if (historySize < 2) {
+            historyCurrent = (historyCurrent + 1) % MAX_HISTORY;
+            if (historySize < MAX_HISTORY) {
                 historySize += 1;
             }
             history[historyCurrent].initializeFrom(msg);
         }
 
         const History* getHistory(size_t index) const {
-            return &history[(historyCurrent + index) & 1];
+            return &history[(historyCurrent + MAX_HISTORY - index) % MAX_HISTORY];
         }
 
+        // Extrapolates the pointer to the given time along the velocity that best
+        // fits its recent history.  Returns false if there is too little history.
+        bool predictPointer(uint32_t id, nsecs_t time, float* outX, float* outY) const;
+
         bool recentCoordinatesAreIdentical(uint32_t id) const {
             // Return true if the two most recently received "raw" coordinates are identical
             if (historySize < 2) {
@@ -476,6 +553,8 @@ private:
             int32_t* displayId);
 
     void updateTouchState(InputMessage& msg);
+    void scorePrediction(TouchState& state, const InputMessage& msg);
+    nsecs_t getResampleLatency() const;
     void resampleTouchState(nsecs_t frameTime, MotionEvent* event,
             const InputMessage *next);
 
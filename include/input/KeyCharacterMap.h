@@ -24,6 +24,7 @@
 #endif
 
 #include <input/Input.h>
+#include <input/KeyMapCache.h>
 #include <utils/Errors.h>
 #include <utils/KeyedVector.h>
 #include <utils/Tokenizer.h>
@@ -31,6 +32,8 @@
 #include <utils/Unicode.h>
 #include <utils/RefBase.h>
 
+#include <vector>
+
 // Maximum number of keys supported by KeyCharacterMaps
 #define MAX_KEYS 8192
 
@@ -183,6 +186,35 @@ private:
         Behavior* firstBehavior;
     };
 
+    /* What the lookups use: each key's behaviors in one array, in the same
+     * order as the list in Key, and keys reached by key code without a search. */
+    struct FlatBehavior {
+        int32_t metaState;
+        int32_t fallbackKeyCode;
+        int32_t replacementKeyCode;
+        char16_t character;
+    };
+
+    struct FlatKey {
+        enum {
+            FLAG_HAS_FALLBACK = 1 << 0,
+            FLAG_HAS_REPLACEMENT = 1 << 1,
+        };
+
+        char16_t label;
+        char16_t number;
+        uint32_t flags;
+        uint32_t firstBehavior;
+        uint32_t behaviorCount;
+    };
+
+    /* The key and meta state that getEvents() uses to type a character. */
+    struct CharacterKey {
+        char16_t character;
+        int32_t keyCode;
+        int32_t metaState;
+    };
+
     class Parser {
         enum State {
             STATE_TOP = 0,
@@ -233,18 +265,31 @@ private:
     KeyedVector<int32_t, int32_t> mKeysByScanCode;
     KeyedVector<int32_t, int32_t> mKeysByUsageCode;
 
+    // Built from mKeys by buildLookupTables() once the map is complete.
+    // mFlatKeys matches mKeys index for index, and mKeyIndex maps the key codes
+    // below MAX_KEYS to those indices, or -1.
+    std::vector<int32_t> mKeyIndex;
+    std::vector<FlatKey> mFlatKeys;
+    std::vector<FlatBehavior> mFlatBehaviors;
+    std::vector<CharacterKey> mCharacterKeys; // sorted by character
+
     KeyCharacterMap();
     KeyCharacterMap(const KeyCharacterMap& other);
 
-    bool getKey(int32_t keyCode, const Key** outKey) const;
+    void buildLookupTables();
+
+    bool getKey(int32_t keyCode, const FlatKey** outKey) const;
     bool getKeyBehavior(int32_t keyCode, int32_t metaState,
-            const Key** outKey, const Behavior** outBehavior) const;
+            const FlatKey** outKey, const FlatBehavior** outBehavior) const;
     static bool matchesMetaState(int32_t eventMetaState, int32_t behaviorMetaState);
 
     bool findKey(char16_t ch, int32_t* outKeyCode, int32_t* outMetaState) const;
 
     static status_t load(Tokenizer* tokenizer, Format format, sp<KeyCharacterMap>* outMap);
 
+    void writeToCache(KeyMapCache::Writer& writer) const;
+    status_t readFromCache(KeyMapCache::Reader& reader);
+
     static void addKey(Vector<KeyEvent>& outEvents,
             int32_t deviceId, int32_t keyCode, int32_t metaState, bool down, nsecs_t time);
     static void addMetaKeys(Vector<KeyEvent>& outEvents,
@@ -18,6 +18,7 @@
 #define _LIBINPUT_KEY_LAYOUT_MAP_H
 
 #include <stdint.h>
+#include <input/KeyMapCache.h>
 #include <utils/Errors.h>
 #include <utils/KeyedVector.h>
 #include <utils/Tokenizer.h>
@@ -94,8 +95,13 @@ private:
 
     KeyLayoutMap();
 
+    static status_t load(Tokenizer* tokenizer, sp<KeyLayoutMap>* outMap);
+
     const Key* getKey(int32_t scanCode, int32_t usageCode) const;
 
+    void writeToCache(KeyMapCache::Writer& writer) const;
+    status_t readFromCache(KeyMapCache::Reader& reader);
+
     class Parser {
         KeyLayoutMap* mMap;
         Tokenizer* mTokenizer;
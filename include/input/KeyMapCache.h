@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _LIBINPUT_KEY_MAP_CACHE_H
+#define _LIBINPUT_KEY_MAP_CACHE_H
+
+#include <stdint.h>
+#include <utils/Errors.h>
+#include <utils/String8.h>
+
+#include <functional>
+#include <vector>
+
+namespace android {
+
+/*
+ * An on-disk cache of compiled key layout and key character maps.
+ *
+ * Entries are named after a hash of the source file's contents, so editing a
+ * file never picks up a stale entry.  Each entry is a header followed by a flat
+ * array of native-endian 32-bit words that is validated and decoded straight out
+ * of a read-only mapping, which is much cheaper than tokenizing the text again.
+ *
+ * The cache is off until a process gives it a directory it may write to.
+ */
+class KeyMapCache {
+public:
+    enum Kind {
+        KIND_KEY_LAYOUT_MAP = 1,
+        KIND_KEY_CHARACTER_MAP = 2,
+    };
+
+    /* Accumulates a compiled map. */
+    class Writer {
+    public:
+        void writeInt32(int32_t value) { mData.push_back(value); }
+        const std::vector<int32_t>& data() const { return mData; }
+
+    private:
+        std::vector<int32_t> mData;
+    };
+
+    /* Reads a compiled map back.  Reads past the end return 0 and set an error. */
+    class Reader {
+    public:
+        Reader(const int32_t* data, size_t size) : mData(data), mSize(size), mPos(0),
+                mError(false) { }
+
+        int32_t readInt32();
+
+        /* Reads a count of records that are recordSize words each, failing if
+         * the rest of the data cannot hold that many. */
+        size_t readCount(size_t recordSize);
+
+        bool hasError() const { return mError; }
+        bool isDone() const { return mPos == mSize; }
+
+    private:
+        const int32_t* mData;
+        size_t mSize;
+        size_t mPos;
+        bool mError;
+    };
+
+    /* Sets the cache directory, or disables the cache if it is empty. */
+    static void setDirectory(const String8& directory);
+    static bool isEnabled();
+
+    static uint64_t hashContents(const char* contents, size_t length);
+
+    /* Decodes the entry for a source file's contents.  'variant' tells apart
+     * entries compiled from the same contents with different options.
+     * Returns NAME_NOT_FOUND if there is no entry, or BAD_VALUE if it is invalid
+     * or decode() fails. */
+    static status_t read(Kind kind, uint32_t variant, uint64_t contentsHash,
+            const std::function<status_t(Reader&)>& decode);
+
+    /* Saves an entry.  Failures only cost the next load a parse. */
+    static void write(Kind kind, uint32_t variant, uint64_t contentsHash,
+            const Writer& writer);
+
+private:
+    KeyMapCache() { }
+};
+
+} // namespace android
+
+#endif // _LIBINPUT_KEY_MAP_CACHE_H
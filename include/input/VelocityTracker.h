@@ -95,6 +95,11 @@ public:
     // about the pointer.
     bool getEstimator(uint32_t id, Estimator* outEstimator) const;
 
+    // Gets estimators for several pointers at once, solving all of them in one pass.
+    // outEstimators receives idBits.count() estimators in order by increasing id.
+    // Returns the ids there is information about; the estimators of the others are cleared.
+    BitSet32 getEstimators(BitSet32 idBits, Estimator* outEstimators) const;
+
     // Gets the active pointer id, or -1 if none.
     inline int32_t getActivePointerId() const { return mActivePointerId; }
 
@@ -109,6 +114,12 @@ private:
     int32_t mActivePointerId;
     VelocityTrackerStrategy* mStrategy;
 
+    // Estimators solved since the last change to the movements, by pointer id, since
+    // apps ask for the velocity of each pointer several times per frame.
+    mutable BitSet32 mCachedIdBits;
+    mutable BitSet32 mCachedValidIdBits;
+    mutable Estimator mCachedEstimators[MAX_POINTER_ID + 1];
+
     bool configureStrategy(const char* strategy);
 
     static VelocityTrackerStrategy* createStrategy(const char* strategy);
@@ -130,6 +141,11 @@ public:
     virtual void addMovement(nsecs_t eventTime, BitSet32 idBits,
             const VelocityTracker::Position* positions) = 0;
     virtual bool getEstimator(uint32_t id, VelocityTracker::Estimator* outEstimator) const = 0;
+
+    // Gets the estimators of several pointers, in order by increasing id, and returns the
+    // ids there is information about.  By default solves each pointer on its own.
+    virtual BitSet32 getEstimators(BitSet32 idBits,
+            VelocityTracker::Estimator* outEstimators) const;
 };
 
 
@@ -162,6 +178,8 @@ public:
     virtual void addMovement(nsecs_t eventTime, BitSet32 idBits,
             const VelocityTracker::Position* positions);
     virtual bool getEstimator(uint32_t id, VelocityTracker::Estimator* outEstimator) const;
+    virtual BitSet32 getEstimators(BitSet32 idBits,
+            VelocityTracker::Estimator* outEstimators) const;
 
 private:
     // Sample horizon.
@@ -183,6 +201,8 @@ private:
     };
 
     float chooseWeight(uint32_t index) const;
+    bool fitEstimator(const float* time, const float* x, const float* y, const float* w,
+            uint32_t m, nsecs_t eventTime, VelocityTracker::Estimator* outEstimator) const;
 
     const uint32_t mDegree;
     const Weighting mWeighting;
@@ -20,11 +20,16 @@
 #include <utils/misc.h>
 #include <binder/BpBinder.h>
 #include <binder/IInterface.h>
+#include <binder/IPCThreadState.h>
+#include <binder/ProcessState.h>
 #include <binder/IResultReceiver.h>
 #include <binder/IShellCallback.h>
 #include <binder/Parcel.h>
+#include <private/android_filesystem_config.h>
+#include <utils/String8.h>
 
 #include <stdio.h>
+#include <unistd.h>
 
 namespace android {
 
@@ -115,6 +120,39 @@ const String16& BBinder::getInterfaceDescriptor() const
     return sEmptyDescriptor;
 }
 
+// Handled here rather than in onTransact() so that it works for every
+// service, including the ones that don't forward unknown codes to BBinder.
+static status_t handleTransactionStats(const Parcel& data, Parcel* reply)
+{
+    const uid_t uid = IPCThreadState::self()->getCallingUid();
+    if (uid != AID_ROOT && uid != AID_SHELL && uid != AID_SYSTEM && uid != getuid()) {
+        return PERMISSION_DENIED;
+    }
+
+    switch (data.readInt32()) {
+        case IBinder::TRANSACTION_STATS_DUMP: {
+            String8 result;
+            IPCThreadState::dumpTransactionStats(result);
+            ProcessState::self()->dumpThreadPoolStats(result);
+            if (reply != NULL) {
+                reply->writeString16(String16(result));
+            }
+            return NO_ERROR;
+        }
+        case IBinder::TRANSACTION_STATS_ENABLE:
+            IPCThreadState::setTransactionStatsEnabled(true);
+            return NO_ERROR;
+        case IBinder::TRANSACTION_STATS_DISABLE:
+            IPCThreadState::setTransactionStatsEnabled(false);
+            return NO_ERROR;
+        case IBinder::TRANSACTION_STATS_RESET:
+            IPCThreadState::resetTransactionStats();
+            return NO_ERROR;
+        default:
+            return BAD_VALUE;
+    }
+}
+
 status_t BBinder::transact(
     uint32_t code, const Parcel& data, Parcel* reply, uint32_t flags)
 {
@@ -125,6 +163,9 @@ status_t BBinder::transact(
         case PING_TRANSACTION:
             reply->writeInt32(pingBinder());
             break;
+        case TRANSACTION_STATS_TRANSACTION:
+            err = handleTransactionStats(data, reply);
+            break;
         default:
             err = onTransact(code, data, reply, flags);
             break;
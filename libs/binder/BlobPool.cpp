@@ -0,0 +1,223 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "BlobPool"
+
+#include <binder/BlobPool.h>
+
+#include <cutils/ashmem.h>
+#include <utils/Log.h>
+#include <utils/Mutex.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <vector>
+
+namespace android {
+
+// ---------------------------------------------------------------------------
+
+namespace {
+
+// The region starts with this header and one state word per slot, followed
+// by the slots themselves at slotsOffset().
+struct Header {
+    uint32_t magic;
+    uint32_t slotSize;
+    uint32_t slotCount;
+    uint32_t reserved;
+};
+
+constexpr uint32_t BLOB_POOL_MAGIC = 0x42504c31; // 'BPL1'
+constexpr size_t SLOTS_ALIGNMENT = 64;
+
+// Readers keep the last few pools they saw mapped.
+constexpr size_t MAX_CACHED_POOLS = 8;
+
+enum : uint32_t {
+    SLOT_FREE = 0,
+    SLOT_USED = 1,
+};
+
+uint64_t slotsOffset(uint64_t slotCount) {
+    const uint64_t end = sizeof(Header) + slotCount * sizeof(std::atomic<uint32_t>);
+    return (end + SLOTS_ALIGNMENT - 1) & ~uint64_t(SLOTS_ALIGNMENT - 1);
+}
+
+std::atomic<uint32_t>* slotStates(void* base) {
+    return reinterpret_cast<std::atomic<uint32_t>*>(static_cast<uint8_t*>(base) + sizeof(Header));
+}
+
+struct CachedPool {
+    dev_t dev;
+    ino_t ino;
+    sp<BlobPool> pool;
+};
+
+// Never destroyed, so that blobs released by static destructors still find it.
+struct PoolCache {
+    Mutex lock;
+    std::vector<CachedPool> pools; // least recently used first
+};
+
+PoolCache& poolCache() {
+    static PoolCache* sCache = new PoolCache();
+    return *sCache;
+}
+
+} // namespace
+
+// ---------------------------------------------------------------------------
+
+BlobPool::BlobPool(int fd, void* base, size_t size, uint32_t slotSize, uint32_t slotCount)
+    : mFd(fd), mBase(base), mSize(size), mSlotSize(slotSize), mSlotCount(slotCount)
+{
+}
+
+BlobPool::~BlobPool()
+{
+    ::munmap(mBase, mSize);
+    ::close(mFd);
+}
+
+sp<BlobPool> BlobPool::create(size_t slotSize, size_t slotCount)
+{
+    if (slotSize == 0 || slotSize > INT32_MAX || slotCount == 0 || slotCount > INT32_MAX) {
+        return NULL;
+    }
+    const uint64_t size = slotsOffset(slotCount) + uint64_t(slotSize) * slotCount;
+    if (size > INT32_MAX) {
+        return NULL;
+    }
+
+    int fd = ashmem_create_region("Parcel BlobPool", size);
+    if (fd < 0) {
+        ALOGE("error creating ashmem region: %s", strerror(errno));
+        return NULL;
+    }
+    void* base = ::mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) {
+        ALOGE("error mapping blob pool: %s", strerror(errno));
+        ::close(fd);
+        return NULL;
+    }
+
+    // ashmem regions start zeroed, so all slots are free
+    Header* header = static_cast<Header*>(base);
+    header->magic = BLOB_POOL_MAGIC;
+    header->slotSize = uint32_t(slotSize);
+    header->slotCount = uint32_t(slotCount);
+    return new BlobPool(fd, base, size, uint32_t(slotSize), uint32_t(slotCount));
+}
+
+sp<BlobPool> BlobPool::fromFd(int fd)
+{
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        return NULL;
+    }
+
+    PoolCache& cache = poolCache();
+    AutoMutex _l(cache.lock);
+    for (size_t i = 0; i < cache.pools.size(); i++) {
+        if (cache.pools[i].dev == st.st_dev && cache.pools[i].ino == st.st_ino) {
+            CachedPool entry = cache.pools[i];
+            cache.pools.erase(cache.pools.begin() + i);
+            cache.pools.push_back(entry);
+            return entry.pool;
+        }
+    }
+
+    // The writer is not trusted: the layout is only read once, here, and
+    // checked against the size of the region.
+    const int size = ashmem_get_size_region(fd);
+    if (size < int(sizeof(Header))) {
+        return NULL;
+    }
+    void* base = ::mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) {
+        return NULL;
+    }
+    Header header;
+    memcpy(&header, base, sizeof(header));
+    if (header.magic != BLOB_POOL_MAGIC || header.slotSize == 0 || header.slotCount == 0 ||
+            slotsOffset(header.slotCount) + uint64_t(header.slotSize) * header.slotCount >
+                    uint64_t(size)) {
+        ALOGE("fd %d is not a valid blob pool", fd);
+        ::munmap(base, size);
+        return NULL;
+    }
+    const int poolFd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+    if (poolFd < 0) {
+        ::munmap(base, size);
+        return NULL;
+    }
+
+    sp<BlobPool> pool = new BlobPool(poolFd, base, size, header.slotSize, header.slotCount);
+    if (cache.pools.size() == MAX_CACHED_POOLS) {
+        cache.pools.erase(cache.pools.begin());
+    }
+    cache.pools.push_back(CachedPool{st.st_dev, st.st_ino, pool});
+    return pool;
+}
+
+size_t BlobPool::availableSlots() const
+{
+    const std::atomic<uint32_t>* states = slotStates(mBase);
+    size_t available = 0;
+    for (uint32_t i = 0; i < mSlotCount; i++) {
+        if (states[i].load(std::memory_order_relaxed) == SLOT_FREE) {
+            available++;
+        }
+    }
+    return available;
+}
+
+void* BlobPool::acquireSlot(int32_t* outSlot)
+{
+    std::atomic<uint32_t>* states = slotStates(mBase);
+    for (uint32_t i = 0; i < mSlotCount; i++) {
+        uint32_t expected = SLOT_FREE;
+        if (states[i].compare_exchange_strong(expected, SLOT_USED, std::memory_order_acquire)) {
+            *outSlot = int32_t(i);
+            return slotData(int32_t(i));
+        }
+    }
+    return NULL;
+}
+
+void* BlobPool::slotData(int32_t slot) const
+{
+    if (slot < 0 || uint32_t(slot) >= mSlotCount) {
+        return NULL;
+    }
+    return static_cast<uint8_t*>(mBase) + slotsOffset(mSlotCount) + uint64_t(mSlotSize) * slot;
+}
+
+void BlobPool::releaseSlot(int32_t slot)
+{
+    if (slot >= 0 && uint32_t(slot) < mSlotCount) {
+        slotStates(mBase)[slot].store(SLOT_FREE, std::memory_order_release);
+    }
+}
+
+}; // namespace android
@@ -29,9 +29,12 @@
 
 #include <private/binder/binder_module.h>
 #include <private/binder/Static.h>
+#include <private/binder/TransactionStats.h>
 
 #include <errno.h>
 #include <inttypes.h>
+#include <limits.h>
+#include <poll.h>
 #include <pthread.h>
 #include <sched.h>
 #include <signal.h>
@@ -40,6 +43,8 @@
 #include <sys/resource.h>
 #include <unistd.h>
 
+#include <algorithm>
+
 #if LOG_NDEBUG
 
 #define IF_LOG_TRANSACTIONS() if (false)
@@ -343,6 +348,21 @@ bool IPCThreadState::backgroundSchedulingDisabled()
     return gDisableBackgroundScheduling;
 }
 
+void IPCThreadState::setTransactionStatsEnabled(bool enabled)
+{
+    TransactionStats::setEnabled(enabled);
+}
+
+void IPCThreadState::resetTransactionStats()
+{
+    TransactionStats::reset();
+}
+
+void IPCThreadState::dumpTransactionStats(String8& result)
+{
+    TransactionStats::dump(result);
+}
+
 sp<ProcessState> IPCThreadState::process()
 {
     return mProcess;
@@ -408,6 +428,7 @@ void IPCThreadState::flushCommands()
 {
     if (mProcess->mDriverFD <= 0)
         return;
+    flushOnewayBatch();
     talkWithDriver(false);
     // The flush could have caused post-write refcount decrements to have
     // been executed, which in turn could result in BC_RELEASE/BC_DECREFS
@@ -449,9 +470,14 @@ status_t IPCThreadState::getAndExecuteCommand()
 
         pthread_mutex_lock(&mProcess->mThreadCountLock);
         mProcess->mExecutingThreadsCount++;
-        if (mProcess->mExecutingThreadsCount > mProcess->mMaxThreads &&
-                mProcess->mStarvationStartTimeMs == 0) {
-            mProcess->mStarvationStartTimeMs = uptimeMillis();
+        mProcess->mPeakExecutingThreadsCount = std::max(mProcess->mPeakExecutingThreadsCount,
+                mProcess->mExecutingThreadsCount);
+        if (mProcess->mExecutingThreadsCount > mProcess->mMaxThreads) {
+            if (mProcess->mStarvationStartTimeMs == 0) {
+                mProcess->mStarvationStartTimeMs = uptimeMillis();
+            } else {
+                mProcess->growThreadPoolLocked(uptimeMillis());
+            }
         }
         pthread_mutex_unlock(&mProcess->mThreadCountLock);
 
@@ -461,11 +487,15 @@ status_t IPCThreadState::getAndExecuteCommand()
         mProcess->mExecutingThreadsCount--;
         if (mProcess->mExecutingThreadsCount <= mProcess->mMaxThreads &&
                 mProcess->mStarvationStartTimeMs != 0) {
-            int64_t starvationTimeMs = uptimeMillis() - mProcess->mStarvationStartTimeMs;
+            const int64_t nowMs = uptimeMillis();
+            int64_t starvationTimeMs = nowMs - mProcess->mStarvationStartTimeMs;
             if (starvationTimeMs > 100) {
                 ALOGE("binder thread pool (%zu threads) starved for %" PRId64 " ms",
                       mProcess->mMaxThreads, starvationTimeMs);
             }
+            mProcess->mStarvationCount++;
+            mProcess->mStarvationTotalTimeMs += starvationTimeMs;
+            mProcess->growThreadPoolLocked(nowMs);
             mProcess->mStarvationStartTimeMs = 0;
         }
         pthread_cond_broadcast(&mProcess->mThreadCountDecrement);
@@ -530,10 +560,21 @@ void IPCThreadState::joinThreadPool(bool isMain)
     LOG_THREADPOOL("**** THREAD %p (PID %d) IS JOINING THE THREAD POOL\n", (void*)pthread_self(), getpid());
 
     mOut.writeInt32(isMain ? BC_ENTER_LOOPER : BC_REGISTER_LOOPER);
+    mProcess->threadPoolEntered();
 
     status_t result;
+    bool retired = false;
     do {
         processPendingDerefs();
+
+        // Leave the pool if this thread has been idle for long enough and
+        // the pool can spare it.
+        if (!isMain && !waitForPooledWork()) {
+            retired = true;
+            result = TIMED_OUT;
+            break;
+        }
+
         // now get the next command to be processed, waiting if necessary
         result = getAndExecuteCommand();
 
@@ -553,10 +594,43 @@ void IPCThreadState::joinThreadPool(bool isMain)
     LOG_THREADPOOL("**** THREAD %p (PID %d) IS LEAVING THE THREAD POOL err=%d\n",
         (void*)pthread_self(), getpid(), result);
 
+    if (!retired) {
+        mProcess->threadPoolExited();
+    }
+
     mOut.writeInt32(BC_EXIT_LOOPER);
     talkWithDriver(false);
 }
 
+// Waits until the driver has work for this pooled thread, for at most the
+// idle timeout of the adaptive thread pool policy. Returns false if the
+// thread timed out and ProcessState let it retire.
+bool IPCThreadState::waitForPooledWork()
+{
+    pthread_mutex_lock(&mProcess->mThreadCountLock);
+    const int64_t idleTimeoutMs = mProcess->mIdleTimeoutMs;
+    pthread_mutex_unlock(&mProcess->mThreadCountLock);
+
+    if (idleTimeoutMs <= 0 || mIn.dataPosition() < mIn.dataSize()) {
+        return true;
+    }
+
+    // The driver must have seen everything we wrote, BC_REGISTER_LOOPER and
+    // replies included, before we sit in poll().
+    flushCommands();
+
+    struct pollfd pfd;
+    pfd.fd = mProcess->mDriverFD;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    int ret;
+    do {
+        ret = poll(&pfd, 1, static_cast<int>(std::min(idleTimeoutMs, int64_t(INT_MAX))));
+    } while (ret < 0 && errno == EINTR);
+
+    return ret != 0 || !mProcess->retireIdleThread();
+}
+
 int IPCThreadState::setupPolling(int* fd)
 {
     if (mProcess->mDriverFD <= 0) {
@@ -608,6 +682,17 @@ status_t IPCThreadState::transact(int32_t handle,
 
     LOG_ONEWAY(">>>> SEND from pid %d uid %d %s", getpid(), getuid(),
         (flags & TF_ONE_WAY) == 0 ? "READ REPLY" : "ONE WAY");
+    const bool recordStats = TransactionStats::isEnabled();
+    const nsecs_t startTime = recordStats ? systemTime(SYSTEM_TIME_MONOTONIC) : 0;
+    if ((flags & TF_ONE_WAY) != 0 && queueOnewayTransaction(handle, code, data, flags)) {
+        if (recordStats) {
+            TransactionStats::record(false, code, data,
+                    systemTime(SYSTEM_TIME_MONOTONIC) - startTime);
+        }
+        return NO_ERROR;
+    }
+    // don't let this overtake oneway transactions queued before it
+    flushOnewayBatch();
     err = writeTransactionData(BC_TRANSACTION, flags, handle, code, data, NULL);
 
     if (err != NO_ERROR) {
@@ -648,9 +733,123 @@ status_t IPCThreadState::transact(int32_t handle,
         err = waitForResponse(NULL, NULL);
     }
 
+    if (recordStats) {
+        TransactionStats::record(false, code, data,
+                systemTime(SYSTEM_TIME_MONOTONIC) - startTime);
+    }
+
     return err;
 }
 
+void IPCThreadState::beginOnewayBatch(size_t maxBytes, nsecs_t maxDelay)
+{
+    if (mOnewayBatchDepth++ == 0) {
+        mOnewayBatchMaxBytes = maxBytes;
+        mOnewayBatchMaxDelay = maxDelay;
+        mOnewayBatchError = NO_ERROR;
+    }
+}
+
+status_t IPCThreadState::endOnewayBatch()
+{
+    LOG_ALWAYS_FATAL_IF(mOnewayBatchDepth <= 0, "endOnewayBatch() without beginOnewayBatch()");
+    if (--mOnewayBatchDepth > 0) {
+        return NO_ERROR;
+    }
+    flushOnewayBatch();
+    const status_t err = mOnewayBatchError;
+    mOnewayBatchError = NO_ERROR;
+    return err;
+}
+
+// Queues a oneway transaction for the current batch if there is one and the
+// transaction can be sent later: it must not carry objects, whose references
+// the driver has to take while data still holds them.
+bool IPCThreadState::queueOnewayTransaction(int32_t handle, uint32_t code,
+        const Parcel& data, uint32_t flags)
+{
+    if (mOnewayBatchDepth == 0 || mFlushingOnewayBatch ||
+            data.errorCheck() != NO_ERROR || data.ipcObjectsCount() != 0 ||
+            data.ipcDataSize() > mOnewayBatchMaxBytes) {
+        return false;
+    }
+
+    const nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+    if (!mOnewayBatch.isEmpty() &&
+            (mOnewayBatchData.dataSize() + data.ipcDataSize() > mOnewayBatchMaxBytes ||
+             now - mOnewayBatchStart >= mOnewayBatchMaxDelay)) {
+        flushOnewayBatch();
+    }
+    if (mOnewayBatch.isEmpty()) {
+        mOnewayBatchStart = now;
+    }
+
+    BatchedTransaction transaction;
+    transaction.handle = handle;
+    transaction.code = code;
+    transaction.flags = flags;
+    transaction.offset = mOnewayBatchData.dataSize();
+    transaction.size = data.ipcDataSize();
+    if (mOnewayBatchData.write(data.data(), transaction.size) != NO_ERROR) {
+        return false;
+    }
+    mOnewayBatch.push(transaction);
+    return true;
+}
+
+status_t IPCThreadState::flushOnewayBatch()
+{
+    if (mOnewayBatch.isEmpty() || mFlushingOnewayBatch) {
+        return NO_ERROR;
+    }
+    mFlushingOnewayBatch = true;
+
+    const uintptr_t base = mOnewayBatchData.ipcData();
+    for (size_t i = 0; i < mOnewayBatch.size(); i++) {
+        const BatchedTransaction& transaction = mOnewayBatch[i];
+        binder_transaction_data tr;
+        tr.target.ptr = 0;
+        tr.target.handle = transaction.handle;
+        tr.code = transaction.code;
+        tr.flags = transaction.flags;
+        tr.cookie = 0;
+        tr.sender_pid = 0;
+        tr.sender_euid = 0;
+        tr.data_size = transaction.size;
+        tr.data.ptr.buffer = base + transaction.offset;
+        tr.offsets_size = 0;
+        tr.data.ptr.offsets = 0;
+        mOut.writeInt32(BC_TRANSACTION);
+        mOut.write(&tr, sizeof(tr));
+    }
+
+    // The first round trip writes all of them; every transaction then gets
+    // exactly one BR_TRANSACTION_COMPLETE, BR_DEAD_REPLY or BR_FAILED_REPLY.
+    status_t result = NO_ERROR;
+    for (size_t i = 0; i < mOnewayBatch.size(); i++) {
+        const status_t err = waitForResponse(NULL, NULL);
+        if (err != NO_ERROR && result == NO_ERROR) {
+            result = err;
+        }
+    }
+    if (mOut.dataSize() > 0) {
+        // Only if the driver went away. What's left may point at the queued
+        // data, which is about to go.
+        ALOGE("dropping %zu bytes of commands after failing to flush oneway transactions",
+                mOut.dataSize());
+        mOut.setDataSize(0);
+    }
+
+    mOnewayBatch.clear();
+    mOnewayBatchData.setDataSize(0);
+    mOnewayBatchData.setDataPosition(0);
+    if (result != NO_ERROR && mOnewayBatchError == NO_ERROR) {
+        mOnewayBatchError = result;
+    }
+    mFlushingOnewayBatch = false;
+    return result;
+}
+
 void IPCThreadState::incStrongHandle(int32_t handle, BpBinder *proxy)
 {
     LOG_REMOTEREFS("IPCThreadState::incStrongHandle(%d)\n", handle);
@@ -736,7 +935,13 @@ status_t IPCThreadState::clearDeathNotification(int32_t handle, BpBinder* proxy)
 IPCThreadState::IPCThreadState()
     : mProcess(ProcessState::self()),
       mStrictModePolicy(0),
-      mLastTransactionBinderFlags(0)
+      mLastTransactionBinderFlags(0),
+      mOnewayBatchDepth(0),
+      mFlushingOnewayBatch(false),
+      mOnewayBatchMaxBytes(0),
+      mOnewayBatchMaxDelay(0),
+      mOnewayBatchStart(0),
+      mOnewayBatchError(NO_ERROR)
 {
     pthread_setspecific(gTLS, this);
     clearCaller();
@@ -1113,6 +1318,8 @@ status_t IPCThreadState::executeCommand(int32_t cmd)
                     << ", offsets addr="
                     << reinterpret_cast<const size_t*>(tr.data.ptr.offsets) << endl;
             }
+            const bool recordStats = TransactionStats::isEnabled();
+            const nsecs_t startTime = recordStats ? systemTime(SYSTEM_TIME_MONOTONIC) : 0;
             if (tr.target.ptr) {
                 // We only have a weak reference on the target object, so we must first try to
                 // safely acquire a strong reference before doing anything else with it.
@@ -1129,6 +1336,11 @@ status_t IPCThreadState::executeCommand(int32_t cmd)
                 error = the_context_object->transact(tr.code, buffer, &reply, tr.flags);
             }
 
+            if (recordStats) {
+                TransactionStats::record(true, tr.code, buffer,
+                        systemTime(SYSTEM_TIME_MONOTONIC) - startTime);
+            }
+
             //ALOGI("<<<< TRANSACT from pid %d restore pid %d uid %d\n",
             //     mCallingPid, origPid, origUid);
 
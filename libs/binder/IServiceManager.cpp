@@ -33,6 +33,8 @@
 
 #include <unistd.h>
 
+#include <map>
+
 namespace android {
 
 sp<IServiceManager> defaultServiceManager()
@@ -133,6 +135,75 @@ bool checkPermission(const String16& permission, pid_t pid, uid_t uid)
 
 // ----------------------------------------------------------------------
 
+namespace {
+
+// Remote services this process has already resolved, shared by every
+// BpServiceManager. Entries are dropped when their binder dies, so a
+// restarted service is looked up again. Local binders are never cached:
+// holding on to them would keep them alive after their owner lets go.
+class ServiceCache : public IBinder::DeathRecipient
+{
+public:
+    sp<IBinder> get(const String16& name)
+    {
+        AutoMutex _l(mLock);
+        auto it = mServices.find(name);
+        if (it == mServices.end()) {
+            return NULL;
+        }
+        return it->second;
+    }
+
+    void put(const String16& name, const sp<IBinder>& service)
+    {
+        if (service == NULL || service->remoteBinder() == NULL) {
+            return;
+        }
+        {
+            AutoMutex _l(mLock);
+            sp<IBinder>& entry = mServices[name];
+            if (entry == service) {
+                return;
+            }
+            entry = service;
+        }
+        if (service->linkToDeath(this) != NO_ERROR) {
+            // Already dead; don't keep it around.
+            binderDied(service);
+        }
+    }
+
+    void remove(const String16& name)
+    {
+        AutoMutex _l(mLock);
+        mServices.erase(name);
+    }
+
+    virtual void binderDied(const wp<IBinder>& who)
+    {
+        AutoMutex _l(mLock);
+        for (auto it = mServices.begin(); it != mServices.end();) {
+            if (it->second.get() == who.unsafe_get()) {
+                it = mServices.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+private:
+    Mutex mLock;
+    std::map<String16, sp<IBinder>> mServices;
+};
+
+ServiceCache& serviceCache()
+{
+    static sp<ServiceCache>* sCache = new sp<ServiceCache>(new ServiceCache());
+    return **sCache;
+}
+
+} // namespace
+
 class BpServiceManager : public BpInterface<IServiceManager>
 {
 public:
@@ -183,11 +254,17 @@ public:
 
     virtual sp<IBinder> checkService( const String16& name) const
     {
+        ServiceCache& cache = serviceCache();
+        sp<IBinder> svc = cache.get(name);
+        if (svc != NULL) return svc;
+
         Parcel data, reply;
         data.writeInterfaceToken(IServiceManager::getInterfaceDescriptor());
         data.writeString16(name);
         remote()->transact(CHECK_SERVICE_TRANSACTION, data, &reply);
-        return reply.readStrongBinder();
+        svc = reply.readStrongBinder();
+        cache.put(name, svc);
+        return svc;
     }
 
     virtual status_t addService(const String16& name, const sp<IBinder>& service,
@@ -199,6 +276,8 @@ public:
         data.writeInt32(allowIsolated ? 1 : 0);
         data.writeInt32(dumpsysPriority);
         status_t err = remote()->transact(ADD_SERVICE_TRANSACTION, data, &reply);
+        // Whatever was cached under this name has just been replaced.
+        serviceCache().remove(name);
         return err == NO_ERROR ? reply.readExceptionCode() : err;
     }
 
@@ -38,6 +38,8 @@
 #include <sys/mman.h>
 #include <sys/file.h>
 
+#include <unordered_map>
+
 namespace android {
 // ----------------------------------------------------------------------------
 
@@ -120,6 +122,14 @@ private:
 
 // ----------------------------------------------------------------------------
 
+/*
+ * A two-level segregated fit allocator: free chunks are kept in lists by
+ * size class, a power of two split into kSecondLevelCount steps, and a
+ * bitmap per level tells which lists hold any, so that allocate and free
+ * take constant time however fragmented the heap is. Chunks also stay in
+ * a list in address order, through which freed chunks merge with their
+ * free neighbours.
+ */
 class SimpleBestFitAllocator
 {
     enum {
@@ -141,24 +151,45 @@ private:
 
     struct chunk_t {
         chunk_t(size_t start, size_t size)
-        : start(start), size(size), free(1), prev(0), next(0) {
+        : start(start), size(size), free(1), prev(0), next(0),
+          prevFree(0), nextFree(0) {
         }
         size_t              start;
         size_t              size : 28;
         int                 free : 4;
+        // neighbours in address order
         mutable chunk_t*    prev;
         mutable chunk_t*    next;
+        // neighbours in the free list of its size class
+        chunk_t*            prevFree;
+        chunk_t*            nextFree;
     };
 
+    // sizes below kSecondLevelCount units all go to the first level
+    static const int    kSecondLevelLog2 = 4;
+    static const int    kSecondLevelCount = 1 << kSecondLevelLog2;
+    static const int    kFirstLevelCount = 32 - kSecondLevelLog2 + 1;
+
     ssize_t  alloc(size_t size, uint32_t flags);
     chunk_t* dealloc(size_t start);
     void     dump_l(const char* what) const;
     void     dump_l(String8& res, const char* what) const;
 
+    static void mapping(size_t size, int* fl, int* sl);
+    chunk_t* findFree(size_t size);
+    void     insertFree(chunk_t* chunk);
+    void     removeFree(chunk_t* chunk);
+    chunk_t* split(chunk_t* chunk, size_t size);
+
     static const int    kMemoryAlign;
     mutable Mutex       mLock;
     LinkedList<chunk_t> mList;
     size_t              mHeapSize;
+    uint32_t            mFirstLevelMap;
+    uint32_t            mSecondLevelMap[kFirstLevelCount];
+    chunk_t*            mFree[kFirstLevelCount][kSecondLevelCount];
+    // allocated chunks by start, in units of kMemoryAlign
+    std::unordered_map<size_t, chunk_t*> mAllocated;
 };
 
 // ----------------------------------------------------------------------------
@@ -278,12 +309,17 @@ size_t MemoryDealer::getAllocationAlignment()
 const int SimpleBestFitAllocator::kMemoryAlign = 32;
 
 SimpleBestFitAllocator::SimpleBestFitAllocator(size_t size)
+    : mFirstLevelMap(0)
 {
     size_t pagesize = getpagesize();
     mHeapSize = ((size + pagesize-1) & ~(pagesize-1));
 
+    memset(mSecondLevelMap, 0, sizeof(mSecondLevelMap));
+    memset(mFree, 0, sizeof(mFree));
+
     chunk_t* node = new chunk_t(0, mHeapSize / kMemoryAlign);
     mList.insertHead(node);
+    insertFree(node);
 }
 
 SimpleBestFitAllocator::~SimpleBestFitAllocator()
@@ -323,102 +359,159 @@ status_t SimpleBestFitAllocator::deallocate(size_t offset)
     return NAME_NOT_FOUND;
 }
 
+void SimpleBestFitAllocator::mapping(size_t size, int* fl, int* sl)
+{
+    if (size < size_t(kSecondLevelCount)) {
+        *fl = 0;
+        *sl = int(size);
+    } else {
+        const int log2 = 31 - __builtin_clz(uint32_t(size));
+        *fl = log2 - kSecondLevelLog2 + 1;
+        *sl = int(size >> (log2 - kSecondLevelLog2)) - kSecondLevelCount;
+    }
+}
+
+SimpleBestFitAllocator::chunk_t* SimpleBestFitAllocator::findFree(size_t size)
+{
+    // Round up to the next size class, all of whose chunks are large enough,
+    // so that the first chunk of the first non-empty list will do.
+    size_t target = size;
+    if (size >= size_t(kSecondLevelCount)) {
+        const int log2 = 31 - __builtin_clz(uint32_t(size));
+        target += (size_t(1) << (log2 - kSecondLevelLog2)) - 1;
+    }
+    int fl, sl;
+    mapping(target, &fl, &sl);
+
+    uint32_t slMap = mSecondLevelMap[fl] & (~0u << sl);
+    if (!slMap) {
+        const uint32_t flMap = mFirstLevelMap & (~0u << (fl + 1));
+        if (flMap) {
+            fl = __builtin_ctz(flMap);
+            slMap = mSecondLevelMap[fl];
+        }
+    }
+    if (slMap) {
+        return mFree[fl][__builtin_ctz(slMap)];
+    }
+
+    // The rounding skipped the class of the size itself, which may still
+    // hold a chunk that fits, such as the whole heap.
+    mapping(size, &fl, &sl);
+    for (chunk_t* cur = mFree[fl][sl] ; cur ; cur = cur->nextFree) {
+        if (cur->size >= size) {
+            return cur;
+        }
+    }
+    return 0;
+}
+
+void SimpleBestFitAllocator::insertFree(chunk_t* chunk)
+{
+    int fl, sl;
+    mapping(chunk->size, &fl, &sl);
+    chunk->prevFree = 0;
+    chunk->nextFree = mFree[fl][sl];
+    if (chunk->nextFree) {
+        chunk->nextFree->prevFree = chunk;
+    }
+    mFree[fl][sl] = chunk;
+    mSecondLevelMap[fl] |= 1u << sl;
+    mFirstLevelMap |= 1u << fl;
+}
+
+void SimpleBestFitAllocator::removeFree(chunk_t* chunk)
+{
+    int fl, sl;
+    mapping(chunk->size, &fl, &sl);
+    if (chunk->prevFree)    chunk->prevFree->nextFree = chunk->nextFree;
+    else                    mFree[fl][sl] = chunk->nextFree;
+    if (chunk->nextFree)    chunk->nextFree->prevFree = chunk->prevFree;
+    chunk->prevFree = chunk->nextFree = 0;
+    if (!mFree[fl][sl]) {
+        mSecondLevelMap[fl] &= ~(1u << sl);
+        if (!mSecondLevelMap[fl]) {
+            mFirstLevelMap &= ~(1u << fl);
+        }
+    }
+}
+
+SimpleBestFitAllocator::chunk_t* SimpleBestFitAllocator::split(
+        chunk_t* chunk, size_t size)
+{
+    // free chunks never touch, so the tail can't merge with the next one
+    if (chunk->size > size) {
+        chunk_t* tail = new chunk_t(chunk->start + size, chunk->size - size);
+        chunk->size = size;
+        mList.insertAfter(chunk, tail);
+        insertFree(tail);
+    }
+    return chunk;
+}
+
 ssize_t SimpleBestFitAllocator::alloc(size_t size, uint32_t flags)
 {
     if (size == 0) {
         return 0;
     }
     size = (size + kMemoryAlign-1) / kMemoryAlign;
-    chunk_t* free_chunk = 0;
-    chunk_t* cur = mList.head();
-
-    size_t pagesize = getpagesize();
-    while (cur) {
-        int extra = 0;
-        if (flags & PAGE_ALIGNED)
-            extra = ( -cur->start & ((pagesize/kMemoryAlign)-1) ) ;
-
-        // best fit
-        if (cur->free && (cur->size >= (size+extra))) {
-            if ((!free_chunk) || (cur->size < free_chunk->size)) {
-                free_chunk = cur;
-            }
-            if (cur->size == size) {
-                break;
-            }
-        }
-        cur = cur->next;
+    if (size > mHeapSize / kMemoryAlign) {
+        return NO_MEMORY;
     }
 
-    if (free_chunk) {
-        const size_t free_size = free_chunk->size;
-        free_chunk->free = 0;
-        free_chunk->size = size;
-        if (free_size > size) {
-            int extra = 0;
-            if (flags & PAGE_ALIGNED)
-                extra = ( -free_chunk->start & ((pagesize/kMemoryAlign)-1) ) ;
-            if (extra) {
-                chunk_t* split = new chunk_t(free_chunk->start, extra);
-                free_chunk->start += extra;
-                mList.insertBefore(free_chunk, split);
-            }
-
-            ALOGE_IF((flags&PAGE_ALIGNED) && 
-                    ((free_chunk->start*kMemoryAlign)&(pagesize-1)),
-                    "PAGE_ALIGNED requested, but page is not aligned!!!");
+    const size_t pageUnits = getpagesize() / kMemoryAlign;
+    const size_t maxExtra = (flags & PAGE_ALIGNED) ? pageUnits-1 : 0;
+    chunk_t* free_chunk = findFree(size + maxExtra);
+    if (!free_chunk) {
+        return NO_MEMORY;
+    }
 
-            const ssize_t tail_free = free_size - (size+extra);
-            if (tail_free > 0) {
-                chunk_t* split = new chunk_t(
-                        free_chunk->start + free_chunk->size, tail_free);
-                mList.insertAfter(free_chunk, split);
-            }
+    removeFree(free_chunk);
+    free_chunk->free = 0;
+    if (flags & PAGE_ALIGNED) {
+        const size_t extra = -free_chunk->start & (pageUnits-1);
+        if (extra) {
+            chunk_t* head = new chunk_t(free_chunk->start, extra);
+            free_chunk->start += extra;
+            free_chunk->size -= extra;
+            mList.insertBefore(free_chunk, head);
+            insertFree(head);
         }
-        return (free_chunk->start)*kMemoryAlign;
     }
-    return NO_MEMORY;
+    split(free_chunk, size);
+    mAllocated[free_chunk->start] = free_chunk;
+    return (free_chunk->start)*kMemoryAlign;
 }
 
 SimpleBestFitAllocator::chunk_t* SimpleBestFitAllocator::dealloc(size_t start)
 {
     start = start / kMemoryAlign;
-    chunk_t* cur = mList.head();
-    while (cur) {
-        if (cur->start == start) {
-            LOG_FATAL_IF(cur->free,
-                "block at offset 0x%08lX of size 0x%08lX already freed",
-                cur->start*kMemoryAlign, cur->size*kMemoryAlign);
-
-            // merge freed blocks together
-            chunk_t* freed = cur;
-            cur->free = 1;
-            do {
-                chunk_t* const p = cur->prev;
-                chunk_t* const n = cur->next;
-                if (p && (p->free || !cur->size)) {
-                    freed = p;
-                    p->size += cur->size;
-                    mList.remove(cur);
-                    delete cur;
-                }
-                cur = n;
-            } while (cur && cur->free);
-
-            #ifndef NDEBUG
-                if (!freed->free) {
-                    dump_l("dealloc (!freed->free)");
-                }
-            #endif
-            LOG_FATAL_IF(!freed->free,
-                "freed block at offset 0x%08lX of size 0x%08lX is not free!",
-                freed->start * kMemoryAlign, freed->size * kMemoryAlign);
-
-            return freed;
-        }
-        cur = cur->next;
+    auto allocated = mAllocated.find(start);
+    if (allocated == mAllocated.end()) {
+        return 0;
     }
-    return 0;
+    chunk_t* freed = allocated->second;
+    mAllocated.erase(allocated);
+
+    // merge freed blocks together
+    freed->free = 1;
+    chunk_t* const p = freed->prev;
+    if (p && p->free) {
+        removeFree(p);
+        p->size += freed->size;
+        mList.remove(freed);
+        delete freed;
+        freed = p;
+    }
+    chunk_t* const n = freed->next;
+    if (n && n->free) {
+        removeFree(n);
+        freed->size += n->size;
+        mList.remove(n);
+        delete n;
+    }
+    insertFree(freed);
+    return freed;
 }
 
 void SimpleBestFitAllocator::dump(const char* what) const
@@ -445,6 +538,9 @@ void SimpleBestFitAllocator::dump_l(String8& result,
         const char* what) const
 {
     size_t size = 0;
+    size_t freeSize = 0;
+    size_t largestFree = 0;
+    int32_t freeCount = 0;
     int32_t i = 0;
     chunk_t const* cur = mList.head();
     
@@ -469,14 +565,28 @@ void SimpleBestFitAllocator::dump_l(String8& result,
         
         result.append(buffer);
 
-        if (!cur->free)
+        if (!cur->free) {
             size += cur->size*kMemoryAlign;
+        } else if (cur->size) {
+            freeSize += cur->size*kMemoryAlign;
+            if (cur->size*kMemoryAlign > largestFree)
+                largestFree = cur->size*kMemoryAlign;
+            freeCount++;
+        }
 
         i++;
         cur = cur->next;
     }
     snprintf(buffer, SIZE,
-            "  size allocated: %u (%u KB)\n", int(size), int(size/1024));
+            "  size allocated: %u (%u KB) in %u chunks\n", int(size), int(size/1024),
+            (unsigned int)mAllocated.size());
+    result.append(buffer);
+    // the share of the free memory that the largest request can't use
+    snprintf(buffer, SIZE,
+            "  size free: %u (%u KB) in %d chunks, largest %u (%u KB), "
+            "fragmentation %d%%\n", int(freeSize), int(freeSize/1024), freeCount,
+            int(largestFree), int(largestFree/1024),
+            freeSize ? int(100 - largestFree*100/freeSize) : 0);
     result.append(buffer);
 }
 
@@ -30,6 +30,9 @@
 #include <sys/resource.h>
 #include <unistd.h>
 
+#include <limits>
+#include <type_traits>
+
 #include <binder/Binder.h>
 #include <binder/BpBinder.h>
 #include <binder/IPCThreadState.h>
@@ -99,6 +102,7 @@ enum {
     BLOB_INPLACE = 0,
     BLOB_ASHMEM_IMMUTABLE = 1,
     BLOB_ASHMEM_MUTABLE = 2,
+    BLOB_POOL = 3,
 };
 
 void acquire_object(const sp<ProcessState>& proc,
@@ -352,6 +356,8 @@ status_t unflatten_binder(const sp<ProcessState>& proc,
 // ---------------------------------------------------------------------------
 
 Parcel::Parcel()
+    : mFixedData(mInlineData)
+    , mFixedDataCapacity(INLINE_DATA_CAPACITY)
 {
     LOG_ALLOC("Parcel %p: constructing", this);
     initState();
@@ -524,8 +530,7 @@ status_t Parcel::appendFrom(const Parcel *parcel, size_t offset, size_t len)
         if (mObjectsCapacity < mObjectsSize + numObjects) {
             size_t newSize = ((mObjectsSize + numObjects)*3)/2;
             if (newSize*sizeof(binder_size_t) < mObjectsSize) return NO_MEMORY;   // overflow
-            binder_size_t *objects =
-                (binder_size_t*)realloc(mObjects, newSize*sizeof(binder_size_t));
+            binder_size_t *objects = reallocObjects(newSize, &newSize);
             if (objects == (binder_size_t*)0) {
                 return NO_MEMORY;
             }
@@ -796,11 +801,17 @@ status_t Parcel::writeUtf8AsUtf16(const std::unique_ptr<std::string>& str) {
 
 namespace {
 
+// Vectors of bytes and of 4 or 8 byte primitives are laid out in the parcel
+// after their int32 size exactly as in memory (padded to 4 bytes), the same
+// as writing the elements one by one would, so they are copied in one go.
 template<typename T>
-status_t writeByteVectorInternal(Parcel* parcel, const std::vector<T>& val)
+status_t writePrimitiveVectorInternal(Parcel* parcel, const std::vector<T>& val)
 {
+    static_assert(std::is_trivially_copyable<T>::value &&
+                  (sizeof(T) == 1 || sizeof(T) % 4 == 0),
+                  "elements must be memcpy-able and keep the parcel's layout");
     status_t status;
-    if (val.size() > std::numeric_limits<int32_t>::max()) {
+    if (val.size() > std::numeric_limits<int32_t>::max() / sizeof(T)) {
         status = BAD_VALUE;
         return status;
     }
@@ -810,85 +821,85 @@ status_t writeByteVectorInternal(Parcel* parcel, const std::vector<T>& val)
         return status;
     }
 
-    void* data = parcel->writeInplace(val.size());
+    void* data = parcel->writeInplace(val.size() * sizeof(T));
     if (!data) {
         status = BAD_VALUE;
         return status;
     }
 
-    memcpy(data, val.data(), val.size());
+    memcpy(data, val.data(), val.size() * sizeof(T));
     return status;
 }
 
 template<typename T>
-status_t writeByteVectorInternalPtr(Parcel* parcel,
+status_t writePrimitiveVectorInternalPtr(Parcel* parcel,
                                     const std::unique_ptr<std::vector<T>>& val)
 {
     if (!val) {
         return parcel->writeInt32(-1);
     }
 
-    return writeByteVectorInternal(parcel, *val);
+    return writePrimitiveVectorInternal(parcel, *val);
 }
 
 }  // namespace
 
 status_t Parcel::writeByteVector(const std::vector<int8_t>& val) {
-    return writeByteVectorInternal(this, val);
+    return writePrimitiveVectorInternal(this, val);
 }
 
 status_t Parcel::writeByteVector(const std::unique_ptr<std::vector<int8_t>>& val)
 {
-    return writeByteVectorInternalPtr(this, val);
+    return writePrimitiveVectorInternalPtr(this, val);
 }
 
 status_t Parcel::writeByteVector(const std::vector<uint8_t>& val) {
-    return writeByteVectorInternal(this, val);
+    return writePrimitiveVectorInternal(this, val);
 }
 
 status_t Parcel::writeByteVector(const std::unique_ptr<std::vector<uint8_t>>& val)
 {
-    return writeByteVectorInternalPtr(this, val);
+    return writePrimitiveVectorInternalPtr(this, val);
 }
 
 status_t Parcel::writeInt32Vector(const std::vector<int32_t>& val)
 {
-    return writeTypedVector(val, &Parcel::writeInt32);
+    return writePrimitiveVectorInternal(this, val);
 }
 
 status_t Parcel::writeInt32Vector(const std::unique_ptr<std::vector<int32_t>>& val)
 {
-    return writeNullableTypedVector(val, &Parcel::writeInt32);
+    return writePrimitiveVectorInternalPtr(this, val);
 }
 
 status_t Parcel::writeInt64Vector(const std::vector<int64_t>& val)
 {
-    return writeTypedVector(val, &Parcel::writeInt64);
+    return writePrimitiveVectorInternal(this, val);
 }
 
 status_t Parcel::writeInt64Vector(const std::unique_ptr<std::vector<int64_t>>& val)
 {
-    return writeNullableTypedVector(val, &Parcel::writeInt64);
+    return writePrimitiveVectorInternalPtr(this, val);
 }
 
 status_t Parcel::writeFloatVector(const std::vector<float>& val)
 {
-    return writeTypedVector(val, &Parcel::writeFloat);
+    return writePrimitiveVectorInternal(this, val);
 }
 
 status_t Parcel::writeFloatVector(const std::unique_ptr<std::vector<float>>& val)
 {
-    return writeNullableTypedVector(val, &Parcel::writeFloat);
+    return writePrimitiveVectorInternalPtr(this, val);
 }
 
 status_t Parcel::writeDoubleVector(const std::vector<double>& val)
 {
-    return writeTypedVector(val, &Parcel::writeDouble);
+    return writePrimitiveVectorInternal(this, val);
 }
 
 status_t Parcel::writeDoubleVector(const std::unique_ptr<std::vector<double>>& val)
 {
-    return writeNullableTypedVector(val, &Parcel::writeDouble);
+    return writePrimitiveVectorInternalPtr(this, val);
 }
 
 status_t Parcel::writeBoolVector(const std::vector<bool>& val)
@@ -1247,6 +1258,37 @@ status_t Parcel::writeBlob(size_t len, bool mutableCopy, WritableBlob* outBlob)
     return status;
 }
 
+status_t Parcel::writeBlob(size_t len, const sp<BlobPool>& pool, WritableBlob* outBlob)
+{
+    if (pool == NULL || !mAllowFds || len <= BLOB_INPLACE_LIMIT || len > pool->slotSize()) {
+        return writeBlob(len, false, outBlob);
+    }
+
+    int32_t slot;
+    void* ptr = pool->acquireSlot(&slot);
+    if (!ptr) {
+        ALOGV("writeBlob: blob pool %p is full", pool.get());
+        return writeBlob(len, false, outBlob);
+    }
+
+    ALOGV("writeBlob: write to blob pool");
+    status_t status = writeInt32(BLOB_POOL);
+    if (!status) {
+        status = writeFileDescriptor(pool->getFd(), false /*takeOwnership*/);
+    }
+    if (!status) {
+        status = writeInt32(slot);
+    }
+    if (status) {
+        pool->releaseSlot(slot);
+        return status;
+    }
+
+    // the reader gives the slot back
+    outBlob->init(-1, ptr, len, false);
+    return NO_ERROR;
+}
+
 status_t Parcel::writeDupImmutableBlobFileDescriptor(int fd)
 {
     // Must match up with what's done in writeBlob.
@@ -1336,7 +1378,7 @@ restart_write:
     if (!enoughObjects) {
         size_t newSize = ((mObjectsSize+2)*3)/2;
         if (newSize*sizeof(binder_size_t) < mObjectsSize) return NO_MEMORY;   // overflow
-        binder_size_t* objects = (binder_size_t*)realloc(mObjects, newSize*sizeof(binder_size_t));
+        binder_size_t* objects = reallocObjects(newSize, &newSize);
         if (objects == NULL) return NO_MEMORY;
         mObjects = objects;
         mObjectsCapacity = newSize;
@@ -1629,7 +1671,7 @@ restart_write:
 namespace {
 
 template<typename T>
-status_t readByteVectorInternal(const Parcel* parcel,
+status_t readPrimitiveVectorInternal(const Parcel* parcel,
                                 std::vector<T>* val) {
     val->clear();
 
@@ -1644,24 +1686,25 @@ status_t readByteVectorInternal(const Parcel* parcel,
         status = UNEXPECTED_NULL;
         return status;
     }
-    if (size_t(size) > parcel->dataAvail()) {
+    if (size_t(size) > parcel->dataAvail() / sizeof(T)) {
         status = BAD_VALUE;
         return status;
     }
 
-    T* data = const_cast<T*>(reinterpret_cast<const T*>(parcel->readInplace(size)));
+    const void* data = parcel->readInplace(size * sizeof(T));
     if (!data) {
         status = BAD_VALUE;
         return status;
     }
-    val->reserve(size);
-    val->insert(val->end(), data, data + size);
+    // data is only 4-byte aligned
+    val->resize(size);
+    memcpy(val->data(), data, size * sizeof(T));
 
     return status;
 }
 
 template<typename T>
-status_t readByteVectorInternalPtr(
+status_t readPrimitiveVectorInternalPtr(
         const Parcel* parcel,
         std::unique_ptr<std::vector<T>>* val) {
     const int32_t start = parcel->dataPosition();
@@ -1676,7 +1719,7 @@ status_t readByteVectorInternalPtr(
     parcel->setDataPosition(start);
     val->reset(new (std::nothrow) std::vector<T>());
 
-    status = readByteVectorInternal(parcel, val->get());
+    status = readPrimitiveVectorInternal(parcel, val->get());
 
     if (status != OK) {
         val->reset();
@@ -1688,51 +1731,51 @@ status_t readByteVectorInternalPtr(
 }  // namespace
 
 status_t Parcel::readByteVector(std::vector<int8_t>* val) const {
-    return readByteVectorInternal(this, val);
+    return readPrimitiveVectorInternal(this, val);
 }
 
 status_t Parcel::readByteVector(std::vector<uint8_t>* val) const {
-    return readByteVectorInternal(this, val);
+    return readPrimitiveVectorInternal(this, val);
 }
 
 status_t Parcel::readByteVector(std::unique_ptr<std::vector<int8_t>>* val) const {
-    return readByteVectorInternalPtr(this, val);
+    return readPrimitiveVectorInternalPtr(this, val);
 }
 
 status_t Parcel::readByteVector(std::unique_ptr<std::vector<uint8_t>>* val) const {
-    return readByteVectorInternalPtr(this, val);
+    return readPrimitiveVectorInternalPtr(this, val);
 }
 
 status_t Parcel::readInt32Vector(std::unique_ptr<std::vector<int32_t>>* val) const {
-    return readNullableTypedVector(val, &Parcel::readInt32);
+    return readPrimitiveVectorInternalPtr(this, val);
 }
 
 status_t Parcel::readInt32Vector(std::vector<int32_t>* val) const {
-    return readTypedVector(val, &Parcel::readInt32);
+    return readPrimitiveVectorInternal(this, val);
 }
 
 status_t Parcel::readInt64Vector(std::unique_ptr<std::vector<int64_t>>* val) const {
-    return readNullableTypedVector(val, &Parcel::readInt64);
+    return readPrimitiveVectorInternalPtr(this, val);
 }
 
 status_t Parcel::readInt64Vector(std::vector<int64_t>* val) const {
-    return readTypedVector(val, &Parcel::readInt64);
+    return readPrimitiveVectorInternal(this, val);
 }
 
 status_t Parcel::readFloatVector(std::unique_ptr<std::vector<float>>* val) const {
-    return readNullableTypedVector(val, &Parcel::readFloat);
+    return readPrimitiveVectorInternalPtr(this, val);
 }
 
 status_t Parcel::readFloatVector(std::vector<float>* val) const {
-    return readTypedVector(val, &Parcel::readFloat);
+    return readPrimitiveVectorInternal(this, val);
 }
 
 status_t Parcel::readDoubleVector(std::unique_ptr<std::vector<double>>* val) const {
-    return readNullableTypedVector(val, &Parcel::readDouble);
+    return readPrimitiveVectorInternalPtr(this, val);
 }
 
 status_t Parcel::readDoubleVector(std::vector<double>* val) const {
-    return readTypedVector(val, &Parcel::readDouble);
+    return readPrimitiveVectorInternal(this, val);
 }
 
 status_t Parcel::readBoolVector(std::unique_ptr<std::vector<bool>>* val) const {
@@ -2273,6 +2316,23 @@ status_t Parcel::readBlob(size_t len, ReadableBlob* outBlob) const
         return NO_ERROR;
     }
 
+    if (blobType == BLOB_POOL) {
+        ALOGV("readBlob: read from blob pool");
+        int fd = readFileDescriptor();
+        if (fd == int(BAD_TYPE)) return BAD_VALUE;
+        int32_t slot;
+        status = readInt32(&slot);
+        if (status) return status;
+
+        sp<BlobPool> pool = BlobPool::fromFd(fd);
+        if (pool == NULL || len > pool->slotSize()) return BAD_VALUE;
+        void* ptr = pool->slotData(slot);
+        if (!ptr) return BAD_VALUE;
+
+        outBlob->initFromPool(pool, slot, ptr, len);
+        return NO_ERROR;
+    }
+
     ALOGV("readBlob: read from ashmem");
     bool isMutable = (blobType == BLOB_ASHMEM_MUTABLE);
     int fd = readFileDescriptor();
@@ -2533,21 +2593,74 @@ void Parcel::freeDataNoInit()
     } else {
         LOG_ALLOC("Parcel %p: freeing allocated data", this);
         releaseObjects();
-        if (mData) {
-            LOG_ALLOC("Parcel %p: freeing with %zu capacity", this, mDataCapacity);
-            pthread_mutex_lock(&gParcelGlobalAllocSizeLock);
-            if (mDataCapacity <= gParcelGlobalAllocSize) {
-              gParcelGlobalAllocSize = gParcelGlobalAllocSize - mDataCapacity;
-            } else {
-              gParcelGlobalAllocSize = 0;
-            }
-            if (gParcelGlobalAllocCount > 0) {
-              gParcelGlobalAllocCount--;
-            }
-            pthread_mutex_unlock(&gParcelGlobalAllocSizeLock);
-            free(mData);
-        }
-        if (mObjects) free(mObjects);
+        releaseData(mData, mDataCapacity);
+        releaseObjectsArray(mObjects);
+    }
+}
+
+// Returns room for desired bytes of data: the inline buffer or arena when it
+// is big enough, heap memory otherwise.
+uint8_t* Parcel::allocData(size_t desired, size_t* outCapacity)
+{
+    if (desired <= mFixedDataCapacity) {
+        *outCapacity = mFixedDataCapacity;
+        return mFixedData;
+    }
+    uint8_t* data = (uint8_t*)malloc(desired);
+    if (data) {
+        LOG_ALLOC("Parcel %p: allocating with %zu capacity", this, desired);
+        pthread_mutex_lock(&gParcelGlobalAllocSizeLock);
+        gParcelGlobalAllocSize += desired;
+        gParcelGlobalAllocCount++;
+        pthread_mutex_unlock(&gParcelGlobalAllocSizeLock);
+        *outCapacity = desired;
+    }
+    return data;
+}
+
+void Parcel::releaseData(uint8_t* data, size_t capacity)
+{
+    if (data == NULL || data == mFixedData) {
+        return;
+    }
+    LOG_ALLOC("Parcel %p: freeing with %zu capacity", this, capacity);
+    pthread_mutex_lock(&gParcelGlobalAllocSizeLock);
+    if (capacity <= gParcelGlobalAllocSize) {
+      gParcelGlobalAllocSize = gParcelGlobalAllocSize - capacity;
+    } else {
+      gParcelGlobalAllocSize = 0;
+    }
+    if (gParcelGlobalAllocCount > 0) {
+      gParcelGlobalAllocCount--;
+    }
+    pthread_mutex_unlock(&gParcelGlobalAllocSizeLock);
+    free(data);
+}
+
+// Resizes mObjects, which we own, to hold count offsets. The first entries
+// live in mInlineObjects.
+binder_size_t* Parcel::reallocObjects(size_t count, size_t* outCapacity)
+{
+    if (mObjects != NULL && mObjects != mInlineObjects) {
+        *outCapacity = count;
+        return (binder_size_t*)realloc(mObjects, count*sizeof(binder_size_t));
+    }
+    if (count <= INLINE_OBJECTS_CAPACITY) {
+        *outCapacity = INLINE_OBJECTS_CAPACITY;
+        return mInlineObjects;
+    }
+    binder_size_t* objects = (binder_size_t*)malloc(count*sizeof(binder_size_t));
+    if (objects && mObjects) {
+        memcpy(objects, mObjects, mObjectsSize*sizeof(binder_size_t));
+    }
+    *outCapacity = count;
+    return objects;
+}
+
+void Parcel::releaseObjectsArray(binder_size_t* objects)
+{
+    if (objects != mInlineObjects) {
+        free(objects);
     }
 }
 
@@ -2578,7 +2691,15 @@ status_t Parcel::restartWrite(size_t desired)
         return continueWrite(desired);
     }
 
-    uint8_t* data = (uint8_t*)realloc(mData, desired);
+    // Stay on the heap only if the inline buffer or arena is too small.
+    const bool heapData = mData != NULL && mData != mFixedData;
+    size_t capacity = desired;
+    uint8_t* data;
+    if (heapData && desired > mFixedDataCapacity) {
+        data = (uint8_t*)realloc(mData, desired);
+    } else {
+        data = allocData(desired, &capacity);
+    }
     if (!data && desired > mDataCapacity) {
         mError = NO_MEMORY;
         return NO_MEMORY;
@@ -2587,23 +2708,24 @@ status_t Parcel::restartWrite(size_t desired)
     releaseObjects();
 
     if (data) {
-        LOG_ALLOC("Parcel %p: restart from %zu to %zu capacity", this, mDataCapacity, desired);
-        pthread_mutex_lock(&gParcelGlobalAllocSizeLock);
-        gParcelGlobalAllocSize += desired;
-        gParcelGlobalAllocSize -= mDataCapacity;
-        if (!mData) {
-            gParcelGlobalAllocCount++;
+        LOG_ALLOC("Parcel %p: restart from %zu to %zu capacity", this, mDataCapacity, capacity);
+        if (heapData && data != mFixedData) {
+            pthread_mutex_lock(&gParcelGlobalAllocSizeLock);
+            gParcelGlobalAllocSize += desired;
+            gParcelGlobalAllocSize -= mDataCapacity;
+            pthread_mutex_unlock(&gParcelGlobalAllocSizeLock);
+        } else {
+            releaseData(mData, mDataCapacity);
         }
-        pthread_mutex_unlock(&gParcelGlobalAllocSizeLock);
         mData = data;
-        mDataCapacity = desired;
+        mDataCapacity = capacity;
     }
 
     mDataSize = mDataPos = 0;
     ALOGV("restartWrite Setting data size of %p to %zu", this, mDataSize);
     ALOGV("restartWrite Setting data pos of %p to %zu", this, mDataPos);
 
-    free(mObjects);
+    releaseObjectsArray(mObjects);
     mObjects = NULL;
     mObjectsSize = mObjectsCapacity = 0;
     mNextObjectHint = 0;
@@ -2647,7 +2769,8 @@ status_t Parcel::continueWrite(size_t desired)
 
         // If there is a different owner, we need to take
         // posession.
-        uint8_t* data = (uint8_t*)malloc(desired);
+        size_t capacity;
+        uint8_t* data = allocData(desired, &capacity);
         if (!data) {
             mError = NO_MEMORY;
             return NO_MEMORY;
@@ -2655,9 +2778,11 @@ status_t Parcel::continueWrite(size_t desired)
         binder_size_t* objects = NULL;
 
         if (objectsSize) {
-            objects = (binder_size_t*)calloc(objectsSize, sizeof(binder_size_t));
+            objects = objectsSize <= INLINE_OBJECTS_CAPACITY
+                    ? mInlineObjects
+                    : (binder_size_t*)calloc(objectsSize, sizeof(binder_size_t));
             if (!objects) {
-                free(data);
+                releaseData(data, capacity);
 
                 mError = NO_MEMORY;
                 return NO_MEMORY;
@@ -2681,18 +2806,16 @@ status_t Parcel::continueWrite(size_t desired)
         mOwner(this, mData, mDataSize, mObjects, mObjectsSize, mOwnerCookie);
         mOwner = NULL;
 
-        LOG_ALLOC("Parcel %p: taking ownership of %zu capacity", this, desired);
-        pthread_mutex_lock(&gParcelGlobalAllocSizeLock);
-        gParcelGlobalAllocSize += desired;
-        gParcelGlobalAllocCount++;
-        pthread_mutex_unlock(&gParcelGlobalAllocSizeLock);
+        LOG_ALLOC("Parcel %p: taking ownership of %zu capacity", this, capacity);
 
         mData = data;
         mObjects = objects;
         mDataSize = (mDataSize < desired) ? mDataSize : desired;
         ALOGV("continueWrite Setting data size of %p to %zu", this, mDataSize);
-        mDataCapacity = desired;
-        mObjectsSize = mObjectsCapacity = objectsSize;
+        mDataCapacity = capacity;
+        mObjectsSize = objectsSize;
+        mObjectsCapacity = objects == mInlineObjects ? size_t(INLINE_OBJECTS_CAPACITY)
+                                                     : objectsSize;
         mNextObjectHint = 0;
         mObjectsSorted = false;
 
@@ -2709,18 +2832,31 @@ status_t Parcel::continueWrite(size_t desired)
                 }
                 release_object(proc, *flat, this, &mOpenAshmemSize);
             }
-            binder_size_t* objects =
-                (binder_size_t*)realloc(mObjects, objectsSize*sizeof(binder_size_t));
+            size_t objectsCapacity;
+            binder_size_t* objects = reallocObjects(objectsSize, &objectsCapacity);
             if (objects) {
                 mObjects = objects;
+                mObjectsCapacity = objectsCapacity;
             }
             mObjectsSize = objectsSize;
             mNextObjectHint = 0;
             mObjectsSorted = false;
         }
 
-        // We own the data, so we can just do a realloc().
-        if (desired > mDataCapacity) {
+        // We own the data, so we can just do a realloc(), or move it out
+        // of the inline buffer or arena it has outgrown.
+        if (desired > mDataCapacity && mData == mFixedData) {
+            size_t capacity;
+            uint8_t* data = allocData(desired, &capacity);
+            if (data) {
+                memcpy(data, mData, mDataSize);
+                mData = data;
+                mDataCapacity = capacity;
+            } else {
+                mError = NO_MEMORY;
+                return NO_MEMORY;
+            }
+        } else if (desired > mDataCapacity) {
             uint8_t* data = (uint8_t*)realloc(mData, desired);
             if (data) {
                 LOG_ALLOC("Parcel %p: continue from %zu to %zu capacity", this, mDataCapacity,
@@ -2748,7 +2884,8 @@ status_t Parcel::continueWrite(size_t desired)
 
     } else {
         // This is the first data.  Easy!
-        uint8_t* data = (uint8_t*)malloc(desired);
+        size_t capacity;
+        uint8_t* data = allocData(desired, &capacity);
         if (!data) {
             mError = NO_MEMORY;
             return NO_MEMORY;
@@ -2759,22 +2896,30 @@ status_t Parcel::continueWrite(size_t desired)
             ALOGE("continueWrite: %zu/%p/%zu/%zu", mDataCapacity, mObjects, mObjectsCapacity, desired);
         }
 
-        LOG_ALLOC("Parcel %p: allocating with %zu capacity", this, desired);
-        pthread_mutex_lock(&gParcelGlobalAllocSizeLock);
-        gParcelGlobalAllocSize += desired;
-        gParcelGlobalAllocCount++;
-        pthread_mutex_unlock(&gParcelGlobalAllocSizeLock);
-
         mData = data;
         mDataSize = mDataPos = 0;
         ALOGV("continueWrite Setting data size of %p to %zu", this, mDataSize);
         ALOGV("continueWrite Setting data pos of %p to %zu", this, mDataPos);
-        mDataCapacity = desired;
+        mDataCapacity = capacity;
     }
 
     return NO_ERROR;
 }
 
+status_t Parcel::useArena(void* buffer, size_t capacity)
+{
+    if (mOwner || mDataSize > 0 || mObjectsSize > 0) {
+        return INVALID_OPERATION;
+    }
+    if ((reinterpret_cast<uintptr_t>(buffer) & 7) != 0) {
+        return BAD_VALUE;
+    }
+    freeData();
+    mFixedData = buffer ? static_cast<uint8_t*>(buffer) : mInlineData;
+    mFixedDataCapacity = buffer ? capacity : size_t(INLINE_DATA_CAPACITY);
+    return NO_ERROR;
+}
+
 void Parcel::initState()
 {
     LOG_ALLOC("Parcel %p: initState", this);
@@ -2840,7 +2985,7 @@ size_t Parcel::getOpenAshmemSize() const
 // --- Parcel::Blob ---
 
 Parcel::Blob::Blob() :
-        mFd(-1), mData(NULL), mSize(0), mMutable(false) {
+        mFd(-1), mData(NULL), mSize(0), mMutable(false), mPoolSlot(-1) {
 }
 
 Parcel::Blob::~Blob() {
@@ -2851,6 +2996,9 @@ void Parcel::Blob::release() {
     if (mFd != -1 && mData) {
         ::munmap(mData, mSize);
     }
+    if (mPool != NULL) {
+        mPool->releaseSlot(mPoolSlot);
+    }
     clear();
 }
 
@@ -2861,11 +3009,20 @@ void Parcel::Blob::init(int fd, void* data, size_t size, bool isMutable) {
     mMutable = isMutable;
 }
 
+void Parcel::Blob::initFromPool(const sp<BlobPool>& pool, int32_t slot, void* data,
+        size_t size) {
+    init(-1, data, size, false);
+    mPool = pool;
+    mPoolSlot = slot;
+}
+
 void Parcel::Blob::clear() {
     mFd = -1;
     mData = NULL;
     mSize = 0;
     mMutable = false;
+    mPool.clear();
+    mPoolSlot = -1;
 }
 
 }; // namespace android
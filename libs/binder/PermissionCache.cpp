@@ -31,47 +31,154 @@ ANDROID_SINGLETON_STATIC_INSTANCE(PermissionCache) ;
 
 // ----------------------------------------------------------------------------
 
+namespace {
+
+// A cached result is packed into one word: the uid in the upper half, the
+// index of the permission name plus one and the result in the lower half.
+// EMPTY ends a probe sequence, REMOVED doesn't.
+constexpr uint64_t EMPTY = 0;
+constexpr uint64_t REMOVED = 1;
+
+uint64_t entryKey(uid_t uid, size_t nameIndex) {
+    return (uint64_t(uid) << 32) | (uint64_t(nameIndex + 1) << 1);
+}
+
+uint32_t hashName(const String16& name) {
+    uint32_t hash = 2166136261u;
+    const char16_t* p = name.string();
+    for (size_t i = 0; i < name.size(); i++) {
+        hash = (hash ^ p[i]) * 16777619u;
+    }
+    return hash;
+}
+
+uint32_t hashEntry(uint64_t key) {
+    return uint32_t((key * 0x9e3779b97f4a7c15ull) >> 32);
+}
+
+} // namespace
+
 PermissionCache::PermissionCache() {
+    for (auto& name : mNames) {
+        name.store(NULL, std::memory_order_relaxed);
+    }
+    for (Shard& shard : mShards) {
+        for (auto& slot : shard.slots) {
+            slot.store(EMPTY, std::memory_order_relaxed);
+        }
+    }
+}
+
+// Returns the index of permission in the name pool, adding it if asked to
+// and there is room, or -1.
+ssize_t PermissionCache::findName(const String16& permission, bool add) {
+    const uint32_t hash = hashName(permission);
+    for (size_t i = 0; i < NAME_CAPACITY; i++) {
+        const size_t index = (hash + i) % NAME_CAPACITY;
+        const String16* name = mNames[index].load(std::memory_order_acquire);
+        if (name == NULL) {
+            if (!add) {
+                return -1;
+            }
+            Mutex::Autolock _l(mNamesLock);
+            // someone may have added a name here in the meantime
+            name = mNames[index].load(std::memory_order_relaxed);
+            if (name == NULL) {
+                mNames[index].store(new String16(permission), std::memory_order_release);
+                return index;
+            }
+        }
+        if (*name == permission) {
+            return index;
+        }
+    }
+    return -1;
 }
 
 status_t PermissionCache::check(bool* granted,
-        const String16& permission, uid_t uid) const {
-    Mutex::Autolock _l(mLock);
-    Entry e;
-    e.name = permission;
-    e.uid  = uid;
-    ssize_t index = mCache.indexOf(e);
-    if (index >= 0) {
-        *granted = mCache.itemAt(index).granted;
-        return NO_ERROR;
+        const String16& permission, uid_t uid) {
+    const ssize_t nameIndex = findName(permission, false);
+    if (nameIndex < 0) {
+        return NAME_NOT_FOUND;
+    }
+    const uint64_t key = entryKey(uid, nameIndex);
+    const Shard& shard = mShards[uid % SHARD_COUNT];
+    const uint32_t hash = hashEntry(key);
+    for (size_t i = 0; i < SHARD_CAPACITY; i++) {
+        const uint64_t entry =
+                shard.slots[(hash + i) % SHARD_CAPACITY].load(std::memory_order_relaxed);
+        if (entry == EMPTY) {
+            break;
+        }
+        if ((entry & ~uint64_t(1)) == key) {
+            *granted = entry & 1;
+            return NO_ERROR;
+        }
     }
     return NAME_NOT_FOUND;
 }
 
 void PermissionCache::cache(const String16& permission,
         uid_t uid, bool granted) {
-    Mutex::Autolock _l(mLock);
-    Entry e;
-    ssize_t index = mPermissionNamesPool.indexOf(permission);
-    if (index > 0) {
-        e.name = mPermissionNamesPool.itemAt(index);
-    } else {
-        mPermissionNamesPool.add(permission);
-        e.name = permission;
+    const ssize_t nameIndex = findName(permission, true);
+    if (nameIndex < 0) {
+        return;
     }
     // note, we don't need to store the pid, which is not actually used in
     // permission checks
-    e.uid  = uid;
-    e.granted = granted;
-    index = mCache.indexOf(e);
-    if (index < 0) {
-        mCache.add(e);
+    const uint64_t key = entryKey(uid, nameIndex);
+    const uint64_t entry = key | (granted ? 1 : 0);
+    Shard& shard = mShards[uid % SHARD_COUNT];
+    const uint32_t hash = hashEntry(key);
+
+    Mutex::Autolock _l(shard.lock);
+    ssize_t freeSlot = -1;
+    for (size_t i = 0; i < SHARD_CAPACITY; i++) {
+        const size_t slot = (hash + i) % SHARD_CAPACITY;
+        const uint64_t current = shard.slots[slot].load(std::memory_order_relaxed);
+        if ((current & ~uint64_t(1)) == key) {
+            shard.slots[slot].store(entry, std::memory_order_relaxed);
+            return;
+        }
+        if (current == REMOVED && freeSlot < 0) {
+            freeSlot = slot;
+        }
+        if (current == EMPTY) {
+            if (freeSlot < 0) {
+                freeSlot = slot;
+            }
+            break;
+        }
+    }
+    if (freeSlot < 0) {
+        // the shard is full, start over
+        for (auto& slot : shard.slots) {
+            slot.store(EMPTY, std::memory_order_relaxed);
+        }
+        freeSlot = hash % SHARD_CAPACITY;
     }
+    shard.slots[freeSlot].store(entry, std::memory_order_relaxed);
 }
 
 void PermissionCache::purge() {
-    Mutex::Autolock _l(mLock);
-    mCache.clear();
+    for (Shard& shard : mShards) {
+        Mutex::Autolock _l(shard.lock);
+        for (auto& slot : shard.slots) {
+            slot.store(EMPTY, std::memory_order_relaxed);
+        }
+    }
+}
+
+void PermissionCache::purge(uid_t uid) {
+    Shard& shard = mShards[uid % SHARD_COUNT];
+    Mutex::Autolock _l(shard.lock);
+    for (auto& slot : shard.slots) {
+        const uint64_t entry = slot.load(std::memory_order_relaxed);
+        if (entry != EMPTY && entry != REMOVED && uid_t(entry >> 32) == uid) {
+            // other entries may have probed past this one
+            slot.store(REMOVED, std::memory_order_relaxed);
+        }
+    }
 }
 
 bool PermissionCache::checkCallingPermission(const String16& permission) {
@@ -109,5 +216,9 @@ bool PermissionCache::checkPermission(
     return granted;
 }
 
+void PermissionCache::purgeUid(uid_t uid) {
+    PermissionCache::getInstance().purge(uid);
+}
+
 // ---------------------------------------------------------------------------
 }; // namespace android
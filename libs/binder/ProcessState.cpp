@@ -32,6 +32,7 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -40,6 +41,8 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 
+#include <algorithm>
+
 #define BINDER_VM_SIZE ((1 * 1024 * 1024) - sysconf(_SC_PAGE_SIZE) * 2)
 #define DEFAULT_MAX_BINDER_THREADS 15
 
@@ -360,8 +363,18 @@ void ProcessState::spawnPooledThread(bool isMain)
 }
 
 status_t ProcessState::setThreadPoolMaxThreadCount(size_t maxThreads) {
+    pthread_mutex_lock(&mThreadCountLock);
+    status_t result = setDriverMaxThreadsLocked(maxThreads);
+    pthread_mutex_unlock(&mThreadCountLock);
+    return result;
+}
+
+status_t ProcessState::setDriverMaxThreadsLocked(size_t maxThreads) {
+    // The driver counts every thread it ever asked us to spawn against its
+    // limit, including the ones that have since retired.
+    size_t driverMaxThreads = maxThreads + mRetiredThreadsCount;
     status_t result = NO_ERROR;
-    if (ioctl(mDriverFD, BINDER_SET_MAX_THREADS, &maxThreads) != -1) {
+    if (ioctl(mDriverFD, BINDER_SET_MAX_THREADS, &driverMaxThreads) != -1) {
         mMaxThreads = maxThreads;
     } else {
         result = -errno;
@@ -370,6 +383,90 @@ status_t ProcessState::setThreadPoolMaxThreadCount(size_t maxThreads) {
     return result;
 }
 
+status_t ProcessState::setAdaptiveThreadPool(size_t maxThreads, size_t minThreads,
+                                             int64_t growAfterMs, int64_t idleTimeoutMs) {
+    if (maxThreads > 0 && (minThreads > maxThreads || growAfterMs < 0)) {
+        return BAD_VALUE;
+    }
+    pthread_mutex_lock(&mThreadCountLock);
+    mAdaptiveMaxThreads = maxThreads;
+    mAdaptiveMinThreads = minThreads;
+    mGrowAfterMs = growAfterMs;
+    mIdleTimeoutMs = maxThreads > 0 ? idleTimeoutMs : 0;
+    pthread_mutex_unlock(&mThreadCountLock);
+    return NO_ERROR;
+}
+
+void ProcessState::growThreadPoolLocked(int64_t nowMs) {
+    if (mMaxThreads >= mAdaptiveMaxThreads || mStarvationStartTimeMs == 0) {
+        return;
+    }
+    // Grow by a quarter at a time, and give the new threads a chance to
+    // catch up before growing again.
+    if (nowMs - std::max(mStarvationStartTimeMs, mLastGrowTimeMs) < mGrowAfterMs) {
+        return;
+    }
+    const size_t maxThreads = std::min(mAdaptiveMaxThreads,
+            mMaxThreads + std::max(mMaxThreads / 4, size_t(1)));
+    if (setDriverMaxThreadsLocked(maxThreads) == NO_ERROR) {
+        ALOGI("binder thread pool starved for %" PRId64 " ms, raising limit to %zu threads",
+              nowMs - mStarvationStartTimeMs, maxThreads);
+        mGrowCount++;
+    }
+    mLastGrowTimeMs = nowMs;
+}
+
+void ProcessState::threadPoolEntered() {
+    pthread_mutex_lock(&mThreadCountLock);
+    mPoolThreadsCount++;
+    pthread_mutex_unlock(&mThreadCountLock);
+}
+
+bool ProcessState::retireIdleThread() {
+    bool retire = false;
+    pthread_mutex_lock(&mThreadCountLock);
+    if (mIdleTimeoutMs > 0 && mPoolThreadsCount > mAdaptiveMinThreads) {
+        mPoolThreadsCount--;
+        mRetiredThreadsCount++;
+        // let the driver spawn a replacement when it needs one
+        setDriverMaxThreadsLocked(mMaxThreads);
+        retire = true;
+    }
+    pthread_mutex_unlock(&mThreadCountLock);
+    return retire;
+}
+
+void ProcessState::threadPoolExited() {
+    pthread_mutex_lock(&mThreadCountLock);
+    mPoolThreadsCount--;
+    pthread_mutex_unlock(&mThreadCountLock);
+}
+
+ProcessState::ThreadPoolStats ProcessState::getThreadPoolStats() {
+    ThreadPoolStats stats;
+    pthread_mutex_lock(&mThreadCountLock);
+    stats.maxThreads = mMaxThreads;
+    stats.threads = mPoolThreadsCount;
+    stats.executingThreads = mExecutingThreadsCount;
+    stats.peakExecutingThreads = mPeakExecutingThreadsCount;
+    stats.starvations = mStarvationCount;
+    stats.starvationTimeMs = mStarvationTotalTimeMs;
+    stats.grows = mGrowCount;
+    stats.retiredThreads = mRetiredThreadsCount;
+    pthread_mutex_unlock(&mThreadCountLock);
+    return stats;
+}
+
+void ProcessState::dumpThreadPoolStats(String8& result) {
+    const ThreadPoolStats stats = getThreadPoolStats();
+    result.appendFormat("Binder thread pool: %zu threads (limit %zu), %zu executing "
+            "(peak %zu), starved %zu times for %" PRId64 " ms, limit raised %zu times, "
+            "%zu idle threads retired\n",
+            stats.threads, stats.maxThreads, stats.executingThreads,
+            stats.peakExecutingThreads, stats.starvations, stats.starvationTimeMs,
+            stats.grows, stats.retiredThreads);
+}
+
 void ProcessState::giveThreadPoolName() {
     androidSetThreadName( makeBinderThreadName().string() );
 }
@@ -415,6 +512,17 @@ ProcessState::ProcessState(const char *driver)
     , mExecutingThreadsCount(0)
     , mMaxThreads(DEFAULT_MAX_BINDER_THREADS)
     , mStarvationStartTimeMs(0)
+    , mAdaptiveMaxThreads(0)
+    , mAdaptiveMinThreads(0)
+    , mGrowAfterMs(0)
+    , mIdleTimeoutMs(0)
+    , mLastGrowTimeMs(0)
+    , mPoolThreadsCount(0)
+    , mPeakExecutingThreadsCount(0)
+    , mStarvationCount(0)
+    , mStarvationTotalTimeMs(0)
+    , mGrowCount(0)
+    , mRetiredThreadsCount(0)
     , mManagesContexts(false)
     , mBinderContextCheckFunc(NULL)
     , mBinderContextUserData(NULL)
@@ -0,0 +1,265 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "TransactionStats"
+
+#include <private/binder/TransactionStats.h>
+
+#include <binder/IBinder.h>
+#include <binder/Parcel.h>
+#include <utils/Mutex.h>
+#include <utils/String16.h>
+#include <utils/String8.h>
+
+#include <inttypes.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <map>
+#include <vector>
+
+namespace android {
+
+// ---------------------------------------------------------------------------
+
+namespace {
+
+// Histograms have power of two buckets: bucket 0 counts values below the
+// histogram's base, bucket i values in [base << (i - 1), base << i), and the
+// last bucket everything above.
+constexpr size_t HISTOGRAM_BUCKETS = 16;
+constexpr uint64_t SIZE_HISTOGRAM_BASE = 64;        // bytes
+constexpr uint64_t TIME_HISTOGRAM_BASE = 16;        // microseconds
+
+struct Histogram {
+    uint64_t counts[HISTOGRAM_BUCKETS] = {};
+
+    void add(uint64_t value, uint64_t base) {
+        size_t bucket = 0;
+        while (bucket < HISTOGRAM_BUCKETS - 1 && value >= (base << bucket)) {
+            bucket++;
+        }
+        counts[bucket]++;
+    }
+
+    void merge(const Histogram& rhs) {
+        for (size_t i = 0; i < HISTOGRAM_BUCKETS; i++) {
+            counts[i] += rhs.counts[i];
+        }
+    }
+
+    void dump(String8& result, const char* name, uint64_t base) const {
+        result.appendFormat("      %s:", name);
+        for (size_t i = 0; i < HISTOGRAM_BUCKETS; i++) {
+            if (counts[i] == 0) {
+                continue;
+            }
+            if (i == HISTOGRAM_BUCKETS - 1) {
+                result.appendFormat(" >=%" PRIu64 ":%" PRIu64, base << (i - 1), counts[i]);
+            } else {
+                result.appendFormat(" <%" PRIu64 ":%" PRIu64, base << i, counts[i]);
+            }
+        }
+        result.append("\n");
+    }
+};
+
+struct Entry {
+    uint64_t calls = 0;
+    uint64_t totalBytes = 0;
+    nsecs_t totalTime = 0;
+    nsecs_t maxTime = 0;
+    Histogram sizes;
+    Histogram times;
+
+    void merge(const Entry& rhs) {
+        calls += rhs.calls;
+        totalBytes += rhs.totalBytes;
+        totalTime += rhs.totalTime;
+        maxTime = std::max(maxTime, rhs.maxTime);
+        sizes.merge(rhs.sizes);
+        times.merge(rhs.times);
+    }
+};
+
+struct Key {
+    String16 descriptor;
+    uint32_t code;
+    bool incoming;
+
+    bool operator<(const Key& rhs) const {
+        if (incoming != rhs.incoming) return incoming;
+        const int order = descriptor.compare(rhs.descriptor);
+        if (order != 0) return order < 0;
+        return code < rhs.code;
+    }
+};
+
+typedef std::map<Key, Entry> Table;
+
+void mergeTable(Table& into, const Table& from) {
+    for (const auto& item : from) {
+        into[item.first].merge(item.second);
+    }
+}
+
+// The table of one thread. Its lock is only ever contended by a dump or a
+// reset.
+struct ThreadTable {
+    Mutex lock;
+    Table table;
+};
+
+// Tables of live threads, plus what threads that have exited recorded. This
+// is never destroyed so that threads exiting after static destructors have
+// run can still retire their tables.
+struct Globals {
+    Mutex lock;
+    std::vector<ThreadTable*> threads;
+    Table retired;
+};
+
+Globals& globals() {
+    static Globals* sGlobals = new Globals();
+    return *sGlobals;
+}
+
+class ThreadTableHolder {
+public:
+    ~ThreadTableHolder() {
+        if (mTable == nullptr) {
+            return;
+        }
+        Globals& g = globals();
+        AutoMutex _l(g.lock);
+        g.threads.erase(std::remove(g.threads.begin(), g.threads.end(), mTable),
+                        g.threads.end());
+        mergeTable(g.retired, mTable->table);
+        delete mTable;
+    }
+
+    ThreadTable* get() {
+        if (mTable == nullptr) {
+            mTable = new ThreadTable();
+            Globals& g = globals();
+            AutoMutex _l(g.lock);
+            g.threads.push_back(mTable);
+        }
+        return mTable;
+    }
+
+private:
+    ThreadTable* mTable = nullptr;
+};
+
+thread_local ThreadTableHolder sThreadTable;
+
+// Interface tokens (see Parcel::writeInterfaceToken) are only written for
+// the user range of transaction codes. Anything that doesn't look like one
+// is reported without a descriptor.
+String16 readDescriptor(uint32_t code, const Parcel& data) {
+    if (code < IBinder::FIRST_CALL_TRANSACTION || code > IBinder::LAST_CALL_TRANSACTION) {
+        return String16();
+    }
+    const size_t position = data.dataPosition();
+    data.setDataPosition(0);
+    data.readInt32();
+    size_t length = 0;
+    const char16_t* token = data.readString16Inplace(&length);
+    data.setDataPosition(position);
+    if (token == nullptr) {
+        return String16();
+    }
+    for (size_t i = 0; i < length; i++) {
+        if (token[i] < 0x20 || token[i] > 0x7e) {
+            return String16();
+        }
+    }
+    return String16(token, length);
+}
+
+} // namespace
+
+// ---------------------------------------------------------------------------
+
+std::atomic<bool> TransactionStats::sEnabled(false);
+
+void TransactionStats::setEnabled(bool enabled)
+{
+    sEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+void TransactionStats::record(bool incoming, uint32_t code, const Parcel& data,
+        nsecs_t duration)
+{
+    const Key key{readDescriptor(code, data), code, incoming};
+    const uint64_t bytes = data.dataSize();
+    const nsecs_t time = std::max(duration, nsecs_t(0));
+
+    ThreadTable* threadTable = sThreadTable.get();
+    AutoMutex _l(threadTable->lock);
+    Entry& entry = threadTable->table[key];
+    entry.calls++;
+    entry.totalBytes += bytes;
+    entry.totalTime += time;
+    entry.maxTime = std::max(entry.maxTime, time);
+    entry.sizes.add(bytes, SIZE_HISTOGRAM_BASE);
+    entry.times.add(ns2us(time), TIME_HISTOGRAM_BASE);
+}
+
+void TransactionStats::reset()
+{
+    Globals& g = globals();
+    AutoMutex _l(g.lock);
+    g.retired.clear();
+    for (ThreadTable* threadTable : g.threads) {
+        AutoMutex _tl(threadTable->lock);
+        threadTable->table.clear();
+    }
+}
+
+void TransactionStats::dump(String8& result)
+{
+    Table merged;
+    {
+        Globals& g = globals();
+        AutoMutex _l(g.lock);
+        merged = g.retired;
+        for (ThreadTable* threadTable : g.threads) {
+            AutoMutex _tl(threadTable->lock);
+            mergeTable(merged, threadTable->table);
+        }
+    }
+
+    result.appendFormat("Binder transaction stats for pid %d (%s):\n", getpid(),
+            isEnabled() ? "enabled" : "disabled");
+    for (const auto& item : merged) {
+        const Key& key = item.first;
+        const Entry& entry = item.second;
+        const String8 descriptor(key.descriptor);
+        result.appendFormat("  %s %s code %" PRIu32 ": %" PRIu64 " calls, %" PRIu64
+                " bytes, %s mean %" PRId64 "us, max %" PRId64 "us\n",
+                key.incoming ? "incoming" : "outgoing",
+                descriptor.isEmpty() ? "<unknown>" : descriptor.string(), key.code,
+                entry.calls, entry.totalBytes,
+                key.incoming ? "execution" : "round-trip",
+                ns2us(entry.totalTime / nsecs_t(entry.calls)), ns2us(entry.maxTime));
+        entry.sizes.dump(result, "bytes", SIZE_HISTOGRAM_BASE);
+        entry.times.dump(result, "us", TIME_HISTOGRAM_BASE);
+    }
+}
+
+}; // namespace android
@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_BLOB_POOL_H
+#define ANDROID_BLOB_POOL_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <utils/RefBase.h>
+
+// ---------------------------------------------------------------------------
+namespace android {
+
+/*
+ * A shared memory region, split in fixed size slots, that Parcel::writeBlob()
+ * can put large blobs in instead of creating, mapping and unmapping a new
+ * ashmem region for each of them.
+ *
+ * The writer keeps the pool mapped for its whole lifetime, and readers map it
+ * the first time they see it and keep it mapped for the next transactions,
+ * so transferring a blob only costs passing the pool's file descriptor and
+ * a slot index. Use one pool per peer: every reader of the pool can see
+ * every blob written to it.
+ *
+ * A slot is returned to the pool when the reader releases its
+ * Parcel::ReadableBlob, so blobs written to a pool must be read.
+ */
+class BlobPool : public virtual RefBase
+{
+public:
+    // Creates a pool of slotCount blobs of up to slotSize bytes each, or
+    // returns NULL if the shared memory can't be allocated.
+    static  sp<BlobPool>    create(size_t slotSize, size_t slotCount);
+
+            size_t          slotSize() const { return mSlotSize; }
+            size_t          slotCount() const { return mSlotCount; }
+            size_t          availableSlots() const;
+
+protected:
+    virtual                 ~BlobPool();
+
+private:
+    friend class Parcel;
+
+                            BlobPool(int fd, void* base, size_t size,
+                                     uint32_t slotSize, uint32_t slotCount);
+
+    // Returns the pool a received file descriptor refers to, mapping it
+    // only the first time.
+    static  sp<BlobPool>    fromFd(int fd);
+
+            int             getFd() const { return mFd; }
+            void*           acquireSlot(int32_t* outSlot);
+            void*           slotData(int32_t slot) const;
+            void            releaseSlot(int32_t slot);
+
+    const   int             mFd;
+            void* const     mBase;
+    const   size_t          mSize;
+    const   uint32_t        mSlotSize;
+    const   uint32_t        mSlotCount;
+};
+
+}; // namespace android
+
+// ---------------------------------------------------------------------------
+
+#endif // ANDROID_BLOB_POOL_H
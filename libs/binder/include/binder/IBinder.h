@@ -59,6 +59,15 @@ public:
         SHELL_COMMAND_TRANSACTION = B_PACK_CHARS('_','C','M','D'),
         INTERFACE_TRANSACTION   = B_PACK_CHARS('_', 'N', 'T', 'F'),
         SYSPROPS_TRANSACTION    = B_PACK_CHARS('_', 'S', 'P', 'R'),
+        TRANSACTION_STATS_TRANSACTION = B_PACK_CHARS('_', 'T', 'S', 'T'),
+
+        // Operations of TRANSACTION_STATS_TRANSACTION, sent as its only
+        // int32 argument. DUMP replies with the statistics, followed by
+        // the ProcessState thread pool statistics, as a String16.
+        TRANSACTION_STATS_DUMP    = 0,
+        TRANSACTION_STATS_ENABLE  = 1,
+        TRANSACTION_STATS_DISABLE = 2,
+        TRANSACTION_STATS_RESET   = 3,
 
         // Corresponds to TF_ONE_WAY -- an asynchronous call.
         FLAG_ONEWAY             = 0x00000001
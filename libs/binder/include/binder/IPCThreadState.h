@@ -20,6 +20,7 @@
 #include <utils/Errors.h>
 #include <binder/Parcel.h>
 #include <binder/ProcessState.h>
+#include <utils/Timers.h>
 #include <utils/Vector.h>
 
 #if defined(_WIN32)
@@ -89,6 +90,27 @@ public:
             // the maximum number of binder threads threads allowed for this process.
             void                blockUntilThreadAvailable();
 
+            // Between these two calls, oneway transactions this thread sends
+            // are queued locally and written to the driver together, once
+            // maxBytes of them are pending, when the oldest one is maxDelay
+            // old as another one is sent, when a synchronous transaction is
+            // sent or by flushCommands(). endOnewayBatch() writes what is
+            // left and returns the first error any of the queued
+            // transactions got. Transactions carrying binders or file
+            // descriptors are never queued. Calls nest.
+            void                beginOnewayBatch(size_t maxBytes = 16 * 1024,
+                                                 nsecs_t maxDelay = 2000000);
+            status_t            endOnewayBatch();
+
+    // Per-interface statistics (call counts, payload sizes, round-trip and
+    // execution times) about the transactions this process sends and
+    // receives. Collection is off by default and costs nothing until it is
+    // enabled. The statistics can also be controlled from another process
+    // with IBinder::TRANSACTION_STATS_TRANSACTION, see "dumpsys --binder-stats".
+    static  void                setTransactionStatsEnabled(bool enabled);
+    static  void                resetTransactionStats();
+    static  void                dumpTransactionStats(String8& result);
+
 private:
                                 IPCThreadState();
                                 ~IPCThreadState();
@@ -103,7 +125,13 @@ private:
                                                      uint32_t code,
                                                      const Parcel& data,
                                                      status_t* statusBuffer);
+            bool                queueOnewayTransaction(int32_t handle,
+                                                       uint32_t code,
+                                                       const Parcel& data,
+                                                       uint32_t flags);
+            status_t            flushOnewayBatch();
             status_t            getAndExecuteCommand();
+            bool                waitForPooledWork();
             status_t            executeCommand(int32_t command);
             void                processPendingDerefs();
             void                processPostWriteDerefs();
@@ -128,6 +156,39 @@ private:
             uid_t               mCallingUid;
             int32_t             mStrictModePolicy;
             int32_t             mLastTransactionBinderFlags;
+
+            struct BatchedTransaction {
+                int32_t         handle;
+                uint32_t        code;
+                uint32_t        flags;
+                size_t          offset;
+                size_t          size;
+            };
+            int32_t             mOnewayBatchDepth;
+            bool                mFlushingOnewayBatch;
+            size_t              mOnewayBatchMaxBytes;
+            nsecs_t             mOnewayBatchMaxDelay;
+            nsecs_t             mOnewayBatchStart;
+            status_t            mOnewayBatchError;
+            Vector<BatchedTransaction> mOnewayBatch;
+            // the queued transactions' data, which must stay where it is
+            // until the driver has copied it
+            Parcel              mOnewayBatchData;
+};
+
+// Sends the oneway transactions of its scope in batches, see
+// IPCThreadState::beginOnewayBatch().
+class ScopedOnewayBatch
+{
+public:
+    explicit ScopedOnewayBatch(size_t maxBytes = 16 * 1024, nsecs_t maxDelay = 2000000)
+        : mState(IPCThreadState::self()) {
+        mState->beginOnewayBatch(maxBytes, maxDelay);
+    }
+    ~ScopedOnewayBatch() { mState->endOnewayBatch(); }
+
+private:
+    IPCThreadState* const mState;
 };
 
 }; // namespace android
@@ -29,6 +29,7 @@
 #include <utils/Flattenable.h>
 #include <linux/android/binder.h>
 
+#include <binder/BlobPool.h>
 #include <binder/IInterface.h>
 #include <binder/Parcelable.h>
 #include <binder/Map.h>
@@ -96,6 +97,21 @@ public:
 
     void                freeData();
 
+    // Small Parcels keep their data in an inline buffer of
+    // INLINE_DATA_CAPACITY bytes and their object offsets in an inline array
+    // of INLINE_OBJECTS_CAPACITY entries, and only go to the heap when they
+    // outgrow them.
+    enum {
+        INLINE_DATA_CAPACITY    = 256,
+        INLINE_OBJECTS_CAPACITY = 4,
+    };
+
+    // Makes the Parcel keep its data in the caller's buffer, instead of the
+    // inline one, for as long as it fits in capacity bytes. The buffer must
+    // be 8-byte aligned and outlive the Parcel, or the next useArena() call.
+    // Passing NULL goes back to the inline buffer. The Parcel must be empty.
+    status_t            useArena(void* buffer, size_t capacity);
+
 private:
     const binder_size_t* objects() const;
 
@@ -226,6 +242,13 @@ public:
     // The caller should call release() on the blob after writing its contents.
     status_t            writeBlob(size_t len, bool mutableCopy, WritableBlob* outBlob);
 
+    // Writes a blob to the parcel, putting it in a free slot of pool when it
+    // is too large to be stored in-place and fits in one. Otherwise, or if
+    // the pool has no free slot, this behaves like writeBlob() above with an
+    // immutable copy. The reader sees a read-only blob either way.
+    status_t            writeBlob(size_t len, const sp<BlobPool>& pool,
+                                  WritableBlob* outBlob);
+
     // Write an existing immutable blob file descriptor to the parcel.
     // This allows the client to send the same blob to multiple processes
     // as long as it keeps a dup of the blob file descriptor handy for later.
@@ -416,6 +439,10 @@ private:
     uintptr_t           readPointer() const;
     void                freeDataNoInit();
     void                initState();
+    uint8_t*            allocData(size_t desired, size_t* outCapacity);
+    void                releaseData(uint8_t* data, size_t capacity);
+    binder_size_t*      reallocObjects(size_t count, size_t* outCapacity);
+    void                releaseObjectsArray(binder_size_t* objects);
     void                scanForFds() const;
     status_t            validateReadData(size_t len) const;
                         
@@ -486,11 +513,15 @@ private:
 
     protected:
         void init(int fd, void* data, size_t size, bool isMutable);
+        void initFromPool(const sp<BlobPool>& pool, int32_t slot, void* data, size_t size);
 
         int mFd; // owned by parcel so not closed when released
         void* mData;
         size_t mSize;
         bool mMutable;
+        // for blobs read from a BlobPool, the slot to give back on release()
+        sp<BlobPool> mPool;
+        int32_t mPoolSlot;
     };
 
     #if defined(__clang__)
@@ -559,6 +590,13 @@ public:
 private:
     size_t mOpenAshmemSize;
 
+    // The non-heap storage for mData: mInlineData, or the buffer passed to
+    // useArena().
+    uint8_t*            mFixedData;
+    size_t              mFixedDataCapacity;
+    alignas(8) uint8_t  mInlineData[INLINE_DATA_CAPACITY];
+    binder_size_t       mInlineObjects[INLINE_OBJECTS_CAPACITY];
+
 public:
     // TODO: Remove once ABI can be changed.
     size_t getBlobAshmemSize() const;
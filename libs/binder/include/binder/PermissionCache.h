@@ -22,9 +22,11 @@
 #include <stdint.h>
 #include <unistd.h>
 
+#include <atomic>
+
+#include <utils/Mutex.h>
 #include <utils/String16.h>
 #include <utils/Singleton.h>
-#include <utils/SortedVector.h>
 
 namespace android {
 // ---------------------------------------------------------------------------
@@ -32,35 +34,47 @@ namespace android {
 /*
  * PermissionCache caches permission checks for a given uid.
  *
- * Currently the cache is not updated when there is a permission change,
- * for instance when an application is uninstalled.
+ * The cache is not updated by itself when there is a permission change,
+ * for instance when an application is uninstalled; whoever learns about
+ * such a change can call purgeUid().
  *
  * IMPORTANT: for the reason stated above, only system permissions are safe
  * to cache. This restriction may be lifted at a later time.
  *
+ * Lookups take no lock: every cached result is a single atomic word in an
+ * open-addressed table, so readers either see a whole entry or none.
+ * Writers, which only run after a cache miss, serialize per shard.
  */
 
 class PermissionCache : Singleton<PermissionCache> {
-    struct Entry {
-        String16    name;
-        uid_t       uid;
-        bool        granted;
-        inline bool operator < (const Entry& e) const {
-            return (uid == e.uid) ? (name < e.name) : (uid < e.uid);
-        }
+    enum {
+        // entries are spread over the shards by uid
+        SHARD_COUNT = 16,
+        SHARD_CAPACITY = 256,
+        // distinct permission names that can be cached
+        NAME_CAPACITY = 512,
+    };
+    struct Shard {
+        Mutex lock;
+        std::atomic<uint64_t> slots[SHARD_CAPACITY];
     };
-    mutable Mutex mLock;
+
     // we pool all the permission names we see, as many permissions checks
-    // will have identical names
-    SortedVector< String16 > mPermissionNamesPool;
-    // this is our cache per say. it stores pooled names.
-    SortedVector< Entry > mCache;
+    // will have identical names. Names are never freed, so that lookups can
+    // compare against them without a lock.
+    Mutex mNamesLock;
+    std::atomic<const String16*> mNames[NAME_CAPACITY];
+    // this is our cache per say. its entries refer to pooled names by index.
+    Shard mShards[SHARD_COUNT];
+
+    ssize_t findName(const String16& permission, bool add);
 
     // free the whole cache, but keep the permission name pool
     void purge();
+    void purge(uid_t uid);
 
     status_t check(bool* granted,
-            const String16& permission, uid_t uid) const;
+            const String16& permission, uid_t uid);
 
     void cache(const String16& permission, uid_t uid, bool granted);
 
@@ -74,6 +88,9 @@ public:
 
     static bool checkPermission(const String16& permission,
             pid_t pid, uid_t uid);
+
+    // forget all cached results for uid, e.g. after its packages changed
+    static void purgeUid(uid_t uid);
 };
 
 // ---------------------------------------------------------------------------
@@ -70,6 +70,29 @@ public:
             status_t            setThreadPoolMaxThreadCount(size_t maxThreads);
             void                giveThreadPoolName();
 
+            // Lets the thread pool adapt to its load. Whenever all of its
+            // threads stay busy for longer than growAfterMs, the maximum set
+            // with setThreadPoolMaxThreadCount() is raised, up to maxThreads.
+            // Pooled threads that have been idle for idleTimeoutMs leave the
+            // pool, as long as at least minThreads threads remain in it.
+            // A maxThreads of 0 turns the adaptive policy off.
+            status_t            setAdaptiveThreadPool(size_t maxThreads, size_t minThreads,
+                                                      int64_t growAfterMs,
+                                                      int64_t idleTimeoutMs);
+
+            struct ThreadPoolStats {
+                size_t          maxThreads;         // current limit
+                size_t          threads;            // threads in the pool
+                size_t          executingThreads;
+                size_t          peakExecutingThreads;
+                size_t          starvations;        // times all threads were busy
+                int64_t         starvationTimeMs;   // total time spent starved
+                size_t          grows;              // times the limit was raised
+                size_t          retiredThreads;     // idle threads that left the pool
+            };
+            ThreadPoolStats     getThreadPoolStats();
+            void                dumpThreadPoolStats(String8& result);
+
             String8             getDriverName();
 
             ssize_t             getKernelReferences(size_t count, uintptr_t* buf);
@@ -91,6 +114,17 @@ private:
 
             handle_entry*       lookupHandleLocked(int32_t handle);
 
+            // Called with mThreadCountLock held.
+            status_t            setDriverMaxThreadsLocked(size_t maxThreads);
+            void                growThreadPoolLocked(int64_t nowMs);
+
+            // Called by pooled threads as they join the pool, and when they
+            // have been idle for mIdleTimeoutMs; returns true if the thread
+            // should leave the pool.
+            void                threadPoolEntered();
+            bool                retireIdleThread();
+            void                threadPoolExited();
+
             String8             mDriverName;
             int                 mDriverFD;
             void*               mVMStart;
@@ -104,6 +138,19 @@ private:
             size_t              mMaxThreads;
             // Time when thread pool was emptied
             int64_t             mStarvationStartTimeMs;
+            // Adaptive policy, see setAdaptiveThreadPool().
+            size_t              mAdaptiveMaxThreads;
+            size_t              mAdaptiveMinThreads;
+            int64_t             mGrowAfterMs;
+            int64_t             mIdleTimeoutMs;
+            int64_t             mLastGrowTimeMs;
+            // Thread pool occupancy, see getThreadPoolStats().
+            size_t              mPoolThreadsCount;
+            size_t              mPeakExecutingThreadsCount;
+            size_t              mStarvationCount;
+            int64_t             mStarvationTotalTimeMs;
+            size_t              mGrowCount;
+            size_t              mRetiredThreadsCount;
 
     mutable Mutex               mLock;  // protects everything below.
 
@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_PRIVATE_BINDER_TRANSACTION_STATS_H
+#define ANDROID_PRIVATE_BINDER_TRANSACTION_STATS_H
+
+#include <stdint.h>
+
+#include <atomic>
+
+#include <utils/Timers.h>
+
+namespace android {
+
+class Parcel;
+class String8;
+
+/*
+ * Per-process statistics about binder transactions, keyed by interface
+ * descriptor, transaction code and direction. Each thread records into its
+ * own table, and the tables are only merged when the statistics are dumped,
+ * so recording never contends with other threads.
+ *
+ * Recording is off by default; see IPCThreadState::setTransactionStatsEnabled().
+ */
+class TransactionStats
+{
+public:
+    static  bool        isEnabled() {
+                            return sEnabled.load(std::memory_order_relaxed);
+                        }
+    static  void        setEnabled(bool enabled);
+
+            // Records one transaction. For outgoing transactions duration is
+            // the client round-trip time, for incoming ones the time spent
+            // executing it.
+    static  void        record(bool incoming, uint32_t code, const Parcel& data,
+                               nsecs_t duration);
+
+    static  void        reset();
+    static  void        dump(String8& result);
+
+private:
+    static  std::atomic<bool> sEnabled;
+};
+
+}; // namespace android
+
+#endif // ANDROID_PRIVATE_BINDER_TRANSACTION_STATS_H
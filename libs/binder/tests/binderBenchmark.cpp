@@ -0,0 +1,306 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * End to end binder benchmarks against a server in another process: round
+ * trips with growing payloads, file descriptor passing, oneway floods,
+ * nested calls and death notifications.
+ *
+ * Run with --benchmark_format=json (or --benchmark_out=FILE) to get results
+ * that can be compared between builds.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <binder/Binder.h>
+#include <binder/IBinder.h>
+#include <binder/IPCThreadState.h>
+#include <binder/IServiceManager.h>
+#include <binder/Parcel.h>
+#include <binder/ProcessState.h>
+#include <utils/Condition.h>
+#include <utils/Mutex.h>
+#include <utils/String16.h>
+#include <utils/String8.h>
+#include <utils/Timers.h>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <vector>
+
+namespace android {
+namespace {
+
+enum {
+    BENCHMARK_NOP = IBinder::FIRST_CALL_TRANSACTION,
+    BENCHMARK_ECHO,
+    BENCHMARK_FDS,
+    BENCHMARK_NESTED,
+    BENCHMARK_ONEWAY,
+    BENCHMARK_WAIT_ONEWAY,
+};
+
+const char* const kServeArg = "--serve";
+
+class BenchmarkService : public BBinder
+{
+public:
+    virtual status_t onTransact(uint32_t code, const Parcel& data, Parcel* reply,
+            uint32_t flags = 0) {
+        switch (code) {
+        case BENCHMARK_NOP:
+            return NO_ERROR;
+        case BENCHMARK_ECHO:
+            return reply->write(data.data(), data.dataSize());
+        case BENCHMARK_FDS: {
+            const int32_t count = data.readInt32();
+            int32_t valid = 0;
+            for (int32_t i = 0; i < count; i++) {
+                if (data.readFileDescriptor() >= 0) {
+                    valid++;
+                }
+            }
+            return reply->writeInt32(valid);
+        }
+        case BENCHMARK_NESTED: {
+            // bounce the call back and forth between the two sides
+            const sp<IBinder> peer = data.readStrongBinder();
+            const int32_t depth = data.readInt32();
+            if (peer == NULL || depth <= 0) {
+                return NO_ERROR;
+            }
+            Parcel nested, nestedReply;
+            nested.writeStrongBinder(this);
+            nested.writeInt32(depth - 1);
+            return peer->transact(BENCHMARK_NESTED, nested, &nestedReply);
+        }
+        case BENCHMARK_ONEWAY:
+            mOnewayCount.fetch_add(1, std::memory_order_relaxed);
+            return NO_ERROR;
+        case BENCHMARK_WAIT_ONEWAY: {
+            // oneway calls are queued per node, so wait for them to drain
+            const int64_t expected = data.readInt64();
+            while (mOnewayCount.load(std::memory_order_relaxed) < expected) {
+                usleep(10);
+            }
+            return NO_ERROR;
+        }
+        default:
+            return BBinder::onTransact(code, data, reply, flags);
+        }
+    }
+
+private:
+    std::atomic<int64_t> mOnewayCount{0};
+};
+
+class DeathWaiter : public IBinder::DeathRecipient
+{
+public:
+    virtual void binderDied(const wp<IBinder>&) {
+        AutoMutex _l(mLock);
+        mDiedAt = systemTime(SYSTEM_TIME_MONOTONIC);
+        mCondition.signal();
+    }
+
+    nsecs_t waitForDeath() {
+        AutoMutex _l(mLock);
+        while (mDiedAt == 0) {
+            if (mCondition.waitRelative(mLock, seconds_to_nanoseconds(5)) != NO_ERROR) {
+                return 0;
+            }
+        }
+        return mDiedAt;
+    }
+
+private:
+    Mutex mLock;
+    Condition mCondition;
+    nsecs_t mDiedAt = 0;
+};
+
+sp<IBinder> gServer;
+
+String16 serviceName(pid_t pid) {
+    return String16(String8::format("binderBenchmark-%d", pid));
+}
+
+int serve() {
+    sp<BenchmarkService> service = new BenchmarkService();
+    if (defaultServiceManager()->addService(serviceName(getpid()), service) != NO_ERROR) {
+        fprintf(stderr, "failed to register the benchmark service\n");
+        return EXIT_FAILURE;
+    }
+    ProcessState::self()->startThreadPool();
+    IPCThreadState::self()->joinThreadPool();
+    return EXIT_SUCCESS;
+}
+
+// Starts a server in a fresh process and returns its pid, or -1.
+pid_t startServer() {
+    const pid_t pid = fork();
+    if (pid == 0) {
+        execl("/proc/self/exe", "binderBenchmark", kServeArg, (char*)NULL);
+        _exit(EXIT_FAILURE);
+    }
+    return pid;
+}
+
+void stopServer(pid_t pid) {
+    kill(pid, SIGKILL);
+    waitpid(pid, NULL, 0);
+}
+
+// ---------------------------------------------------------------------------
+
+void BM_Nop(benchmark::State& state) {
+    for (auto _ : state) {
+        Parcel data, reply;
+        gServer->transact(BENCHMARK_NOP, data, &reply);
+    }
+}
+BENCHMARK(BM_Nop);
+
+void BM_Echo(benchmark::State& state) {
+    const std::vector<uint8_t> payload(state.range(0), 0x5a);
+    for (auto _ : state) {
+        Parcel data, reply;
+        data.write(payload.data(), payload.size());
+        gServer->transact(BENCHMARK_ECHO, data, &reply);
+    }
+    state.SetBytesProcessed(int64_t(state.iterations()) * state.range(0) * 2);
+}
+BENCHMARK(BM_Echo)->RangeMultiplier(4)->Range(8, 256 << 10);
+
+void BM_PassFds(benchmark::State& state) {
+    const int fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        state.SkipWithError("cannot open /dev/null");
+        return;
+    }
+    for (auto _ : state) {
+        Parcel data, reply;
+        data.writeInt32(state.range(0));
+        for (int64_t i = 0; i < state.range(0); i++) {
+            data.writeFileDescriptor(fd);
+        }
+        gServer->transact(BENCHMARK_FDS, data, &reply);
+    }
+    close(fd);
+    state.SetItemsProcessed(int64_t(state.iterations()) * state.range(0));
+}
+BENCHMARK(BM_PassFds)->RangeMultiplier(4)->Range(1, 64);
+
+// batches of oneway calls, timed until the server has handled all of them
+void BM_OnewayFlood(benchmark::State& state) {
+    int64_t sent = 0;
+    for (auto _ : state) {
+        for (int64_t i = 0; i < state.range(0); i++) {
+            Parcel data;
+            gServer->transact(BENCHMARK_ONEWAY, data, NULL, IBinder::FLAG_ONEWAY);
+        }
+        sent += state.range(0);
+        Parcel data, reply;
+        data.writeInt64(sent);
+        gServer->transact(BENCHMARK_WAIT_ONEWAY, data, &reply);
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()) * state.range(0));
+}
+BENCHMARK(BM_OnewayFlood)->RangeMultiplier(4)->Range(1, 256);
+
+// range is the number of calls back and forth, past the first one
+void BM_Nested(benchmark::State& state) {
+    sp<BenchmarkService> local = new BenchmarkService();
+    for (auto _ : state) {
+        Parcel data, reply;
+        data.writeStrongBinder(local);
+        data.writeInt32(state.range(0));
+        gServer->transact(BENCHMARK_NESTED, data, &reply);
+    }
+}
+BENCHMARK(BM_Nested)->DenseRange(0, 8, 2);
+
+void BM_LinkUnlinkToDeath(benchmark::State& state) {
+    sp<DeathWaiter> waiter = new DeathWaiter();
+    for (auto _ : state) {
+        gServer->linkToDeath(waiter);
+        gServer->unlinkToDeath(waiter);
+    }
+}
+BENCHMARK(BM_LinkUnlinkToDeath);
+
+// from killing a server to its death notification
+void BM_DeathNotification(benchmark::State& state) {
+    for (auto _ : state) {
+        const pid_t pid = startServer();
+        sp<IBinder> binder = pid > 0 ? defaultServiceManager()->getService(serviceName(pid))
+                : NULL;
+        sp<DeathWaiter> waiter = new DeathWaiter();
+        if (binder == NULL || binder->linkToDeath(waiter) != NO_ERROR) {
+            if (pid > 0) stopServer(pid);
+            state.SkipWithError("cannot start a server");
+            return;
+        }
+        const nsecs_t killedAt = systemTime(SYSTEM_TIME_MONOTONIC);
+        kill(pid, SIGKILL);
+        const nsecs_t diedAt = waiter->waitForDeath();
+        waitpid(pid, NULL, 0);
+        if (diedAt == 0) {
+            state.SkipWithError("no death notification");
+            return;
+        }
+        state.SetIterationTime(double(diedAt - killedAt) / 1e9);
+    }
+}
+BENCHMARK(BM_DeathNotification)->UseManualTime()->Iterations(50);
+
+} // namespace
+} // namespace android
+
+int main(int argc, char** argv) {
+    using namespace android;
+
+    if (argc == 2 && strcmp(argv[1], kServeArg) == 0) {
+        return serve();
+    }
+
+    const pid_t server = startServer();
+    if (server < 0) {
+        fprintf(stderr, "failed to start the benchmark server\n");
+        return EXIT_FAILURE;
+    }
+    gServer = defaultServiceManager()->getService(serviceName(server));
+    if (gServer == NULL) {
+        fprintf(stderr, "benchmark server didn't register\n");
+        stopServer(server);
+        return EXIT_FAILURE;
+    }
+    // death notifications arrive on pool threads
+    ProcessState::self()->startThreadPool();
+
+    benchmark::Initialize(&argc, argv);
+    benchmark::RunSpecifiedBenchmarks();
+
+    gServer.clear();
+    stopServer(server);
+    return EXIT_SUCCESS;
+}
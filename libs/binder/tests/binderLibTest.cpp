@@ -20,6 +20,7 @@
 #include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <gtest/gtest.h>
 
@@ -763,6 +764,40 @@ TEST_F(BinderLibTest, PassFile) {
     close(pipefd[0]);
 }
 
+TEST_F(BinderLibTest, ThreadPoolStats) {
+    status_t ret;
+    Parcel data, reply;
+    data.writeInt32(IBinder::TRANSACTION_STATS_DUMP);
+    ret = m_server->transact(IBinder::TRANSACTION_STATS_TRANSACTION, data, &reply);
+    EXPECT_EQ(NO_ERROR, ret);
+    String8 stats(reply.readString16());
+    EXPECT_TRUE(strstr(stats.string(), "Binder thread pool: ") != NULL) << stats.string();
+
+    ProcessState::ThreadPoolStats local = ProcessState::self()->getThreadPoolStats();
+    EXPECT_GE(local.peakExecutingThreads, local.executingThreads);
+}
+
+TEST_F(BinderLibTest, AdaptiveThreadPoolRejectsBadLimits) {
+    EXPECT_EQ(BAD_VALUE, ProcessState::self()->setAdaptiveThreadPool(2, 3, 10, 1000));
+    EXPECT_EQ(BAD_VALUE, ProcessState::self()->setAdaptiveThreadPool(4, 1, -1, 1000));
+    EXPECT_EQ(NO_ERROR, ProcessState::self()->setAdaptiveThreadPool(0, 0, 0, 0));
+}
+
+TEST_F(BinderLibTest, OnewayBatch) {
+    IPCThreadState* state = IPCThreadState::self();
+    state->beginOnewayBatch(256, seconds_to_nanoseconds(10));
+    for (int i = 0; i < 32; i++) {
+        Parcel data, reply;
+        data.writeInt32(i);
+        EXPECT_EQ(NO_ERROR, m_server->transact(BINDER_LIB_TEST_NOP_TRANSACTION, data, &reply,
+                                               TF_ONE_WAY));
+    }
+    EXPECT_EQ(NO_ERROR, state->endOnewayBatch());
+
+    Parcel data, reply;
+    EXPECT_EQ(NO_ERROR, m_server->transact(BINDER_LIB_TEST_NOP_TRANSACTION, data, &reply));
+}
+
 TEST_F(BinderLibTest, PromoteLocal) {
     sp<IBinder> strong = new BBinder();
     wp<IBinder> weak = strong;
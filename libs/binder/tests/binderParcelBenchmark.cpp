@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <binder/Parcel.h>
+
+#include <vector>
+
+namespace android {
+namespace {
+
+// Element by element, the way the vector methods used to work
+void BM_WriteInt32Elements(benchmark::State& state) {
+    const std::vector<int32_t> values(state.range(0), 42);
+    Parcel parcel;
+    for (auto _ : state) {
+        parcel.setDataSize(0);
+        parcel.setDataPosition(0);
+        parcel.writeInt32(values.size());
+        for (int32_t value : values) {
+            parcel.writeInt32(value);
+        }
+    }
+    state.SetBytesProcessed(int64_t(state.iterations()) * state.range(0) * sizeof(int32_t));
+}
+BENCHMARK(BM_WriteInt32Elements)->Range(16, 16 << 10);
+
+void BM_WriteInt32Vector(benchmark::State& state) {
+    const std::vector<int32_t> values(state.range(0), 42);
+    Parcel parcel;
+    for (auto _ : state) {
+        parcel.setDataSize(0);
+        parcel.setDataPosition(0);
+        parcel.writeInt32Vector(values);
+    }
+    state.SetBytesProcessed(int64_t(state.iterations()) * state.range(0) * sizeof(int32_t));
+}
+BENCHMARK(BM_WriteInt32Vector)->Range(16, 16 << 10);
+
+void BM_ReadInt32Vector(benchmark::State& state) {
+    Parcel parcel;
+    parcel.writeInt32Vector(std::vector<int32_t>(state.range(0), 42));
+    std::vector<int32_t> values;
+    for (auto _ : state) {
+        parcel.setDataPosition(0);
+        parcel.readInt32Vector(&values);
+        benchmark::DoNotOptimize(values.data());
+    }
+    state.SetBytesProcessed(int64_t(state.iterations()) * state.range(0) * sizeof(int32_t));
+}
+BENCHMARK(BM_ReadInt32Vector)->Range(16, 16 << 10);
+
+void BM_WriteReadInt64Vector(benchmark::State& state) {
+    const std::vector<int64_t> values(state.range(0), 42);
+    std::vector<int64_t> read;
+    Parcel parcel;
+    for (auto _ : state) {
+        parcel.setDataSize(0);
+        parcel.setDataPosition(0);
+        parcel.writeInt64Vector(values);
+        parcel.setDataPosition(0);
+        parcel.readInt64Vector(&read);
+        benchmark::DoNotOptimize(read.data());
+    }
+    state.SetBytesProcessed(int64_t(state.iterations()) * state.range(0) * sizeof(int64_t));
+}
+BENCHMARK(BM_WriteReadInt64Vector)->Range(16, 16 << 10);
+
+void BM_WriteReadDoubleVector(benchmark::State& state) {
+    const std::vector<double> values(state.range(0), 0.5);
+    std::vector<double> read;
+    Parcel parcel;
+    for (auto _ : state) {
+        parcel.setDataSize(0);
+        parcel.setDataPosition(0);
+        parcel.writeDoubleVector(values);
+        parcel.setDataPosition(0);
+        parcel.readDoubleVector(&read);
+        benchmark::DoNotOptimize(read.data());
+    }
+    state.SetBytesProcessed(int64_t(state.iterations()) * state.range(0) * sizeof(double));
+}
+BENCHMARK(BM_WriteReadDoubleVector)->Range(16, 16 << 10);
+
+} // namespace
+} // namespace android
+
+BENCHMARK_MAIN();
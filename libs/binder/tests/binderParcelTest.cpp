@@ -0,0 +1,223 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include <memory>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <binder/Binder.h>
+#include <binder/BlobPool.h>
+#include <binder/Parcel.h>
+#include <utils/String16.h>
+
+using ::android::BBinder;
+using ::android::IBinder;
+using ::android::Parcel;
+using ::android::sp;
+using ::android::String16;
+
+namespace {
+
+const size_t kCount = 1000;
+
+void writeValues(Parcel& parcel, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        ASSERT_EQ(android::NO_ERROR, parcel.writeInt32(static_cast<int32_t>(i * 7)));
+    }
+}
+
+void expectValues(const Parcel& parcel, size_t count) {
+    parcel.setDataPosition(0);
+    for (size_t i = 0; i < count; i++) {
+        EXPECT_EQ(static_cast<int32_t>(i * 7), parcel.readInt32());
+    }
+}
+
+} // namespace
+
+TEST(ParcelStorage, SmallParcelsStayInline) {
+    const size_t heapParcels = Parcel::getGlobalAllocCount();
+    Parcel parcel;
+    writeValues(parcel, 8);
+    EXPECT_EQ(size_t(Parcel::INLINE_DATA_CAPACITY), parcel.dataCapacity());
+    expectValues(parcel, 8);
+    EXPECT_EQ(heapParcels, Parcel::getGlobalAllocCount());
+}
+
+TEST(ParcelStorage, GrowsOutOfTheInlineBuffer) {
+    Parcel parcel;
+    writeValues(parcel, kCount);
+    EXPECT_GE(parcel.dataCapacity(), kCount * sizeof(int32_t));
+    expectValues(parcel, kCount);
+
+    // back to the inline buffer once the data fits again
+    parcel.freeData();
+    writeValues(parcel, 4);
+    EXPECT_EQ(size_t(Parcel::INLINE_DATA_CAPACITY), parcel.dataCapacity());
+    expectValues(parcel, 4);
+}
+
+TEST(ParcelStorage, KeepsObjectsPastTheInlineArray) {
+    Parcel parcel;
+    const size_t binders = Parcel::INLINE_OBJECTS_CAPACITY * 3;
+    sp<IBinder> binder = new BBinder();
+    for (size_t i = 0; i < binders; i++) {
+        ASSERT_EQ(android::NO_ERROR, parcel.writeStrongBinder(binder));
+    }
+    EXPECT_EQ(binders, parcel.objectsCount());
+    parcel.setDataPosition(0);
+    for (size_t i = 0; i < binders; i++) {
+        EXPECT_EQ(binder, parcel.readStrongBinder());
+    }
+}
+
+TEST(ParcelStorage, WritesIntoArena) {
+    alignas(8) uint8_t arena[1024];
+    Parcel parcel;
+    ASSERT_EQ(android::NO_ERROR, parcel.useArena(arena, sizeof(arena)));
+    writeValues(parcel, 128);
+    EXPECT_EQ(static_cast<const void*>(arena), static_cast<const void*>(parcel.data()));
+    expectValues(parcel, 128);
+
+    // outgrowing the arena moves the data to the heap
+    writeValues(parcel, kCount);
+    EXPECT_NE(static_cast<const void*>(arena), static_cast<const void*>(parcel.data()));
+    expectValues(parcel, 128);
+
+    EXPECT_EQ(android::INVALID_OPERATION, parcel.useArena(NULL, 0));
+    parcel.freeData();
+    EXPECT_EQ(android::NO_ERROR, parcel.useArena(NULL, 0));
+    EXPECT_EQ(android::BAD_VALUE, parcel.useArena(arena + 1, sizeof(arena) - 1));
+}
+
+namespace {
+
+template <typename T>
+std::vector<T> ramp(size_t count) {
+    std::vector<T> values(count);
+    for (size_t i = 0; i < count; i++) {
+        values[i] = static_cast<T>(i) * static_cast<T>(3) - static_cast<T>(100);
+    }
+    return values;
+}
+
+} // namespace
+
+TEST(ParcelVectors, BulkMatchesElementLayout) {
+    const std::vector<int32_t> ints = ramp<int32_t>(kCount);
+    const std::vector<int64_t> longs = ramp<int64_t>(kCount);
+    const std::vector<float> floats = ramp<float>(kCount);
+    const std::vector<double> doubles = ramp<double>(kCount);
+
+    Parcel parcel;
+    // start the 8-byte elements off an 8-byte boundary
+    parcel.writeInt32(7);
+    ASSERT_EQ(android::NO_ERROR, parcel.writeInt32Vector(ints));
+    ASSERT_EQ(android::NO_ERROR, parcel.writeInt64Vector(longs));
+    ASSERT_EQ(android::NO_ERROR, parcel.writeFloatVector(floats));
+    ASSERT_EQ(android::NO_ERROR, parcel.writeDoubleVector(doubles));
+
+    parcel.setDataPosition(0);
+    EXPECT_EQ(7, parcel.readInt32());
+    ASSERT_EQ(static_cast<int32_t>(kCount), parcel.readInt32());
+    for (int32_t value : ints) EXPECT_EQ(value, parcel.readInt32());
+    ASSERT_EQ(static_cast<int32_t>(kCount), parcel.readInt32());
+    for (int64_t value : longs) EXPECT_EQ(value, parcel.readInt64());
+    ASSERT_EQ(static_cast<int32_t>(kCount), parcel.readInt32());
+    for (float value : floats) EXPECT_EQ(value, parcel.readFloat());
+    ASSERT_EQ(static_cast<int32_t>(kCount), parcel.readInt32());
+    for (double value : doubles) EXPECT_EQ(value, parcel.readDouble());
+
+    parcel.setDataPosition(0);
+    std::vector<int32_t> readInts;
+    std::vector<int64_t> readLongs;
+    std::vector<float> readFloats;
+    std::unique_ptr<std::vector<double>> readDoubles;
+    parcel.readInt32();
+    ASSERT_EQ(android::NO_ERROR, parcel.readInt32Vector(&readInts));
+    ASSERT_EQ(android::NO_ERROR, parcel.readInt64Vector(&readLongs));
+    ASSERT_EQ(android::NO_ERROR, parcel.readFloatVector(&readFloats));
+    ASSERT_EQ(android::NO_ERROR, parcel.readDoubleVector(&readDoubles));
+    EXPECT_EQ(ints, readInts);
+    EXPECT_EQ(longs, readLongs);
+    EXPECT_EQ(floats, readFloats);
+    ASSERT_TRUE(readDoubles != nullptr);
+    EXPECT_EQ(doubles, *readDoubles);
+}
+
+TEST(ParcelVectors, RejectsTruncatedVectors) {
+    Parcel parcel;
+    parcel.writeInt32(100);
+    parcel.writeInt64(1);
+    parcel.setDataPosition(0);
+    std::vector<int64_t> values;
+    EXPECT_NE(android::NO_ERROR, parcel.readInt64Vector(&values));
+
+    Parcel null;
+    null.writeInt64Vector(std::unique_ptr<std::vector<int64_t>>());
+    null.setDataPosition(0);
+    std::unique_ptr<std::vector<int64_t>> nullValues(new std::vector<int64_t>());
+    EXPECT_EQ(android::NO_ERROR, null.readInt64Vector(&nullValues));
+    EXPECT_TRUE(nullValues == nullptr);
+}
+
+TEST(ParcelBlobs, LargeBlobsGoThroughThePool) {
+    const size_t blobSize = 64 * 1024;
+    sp<android::BlobPool> pool = android::BlobPool::create(blobSize, 2);
+    ASSERT_TRUE(pool != nullptr);
+    EXPECT_EQ(size_t(2), pool->availableSlots());
+
+    Parcel parcel;
+    Parcel::WritableBlob writable;
+    ASSERT_EQ(android::NO_ERROR, parcel.writeBlob(blobSize, pool, &writable));
+    EXPECT_EQ(size_t(1), pool->availableSlots());
+    memset(writable.data(), 0x5a, blobSize);
+    writable.release();
+
+    parcel.setDataPosition(0);
+    Parcel::ReadableBlob readable;
+    ASSERT_EQ(android::NO_ERROR, parcel.readBlob(blobSize, &readable));
+    const uint8_t* data = static_cast<const uint8_t*>(readable.data());
+    ASSERT_TRUE(data != nullptr);
+    EXPECT_EQ(0x5a, data[0]);
+    EXPECT_EQ(0x5a, data[blobSize - 1]);
+    EXPECT_FALSE(readable.isMutable());
+
+    readable.release();
+    EXPECT_EQ(size_t(2), pool->availableSlots());
+}
+
+TEST(ParcelBlobs, FallsBackWhenThePoolCannotHoldTheBlob) {
+    sp<android::BlobPool> pool = android::BlobPool::create(32 * 1024, 1);
+    ASSERT_TRUE(pool != nullptr);
+
+    Parcel parcel;
+    Parcel::WritableBlob tooLarge;
+    ASSERT_EQ(android::NO_ERROR, parcel.writeBlob(64 * 1024, pool, &tooLarge));
+    EXPECT_NE(-1, tooLarge.fd());
+    EXPECT_EQ(size_t(1), pool->availableSlots());
+
+    Parcel::WritableBlob pooled;
+    Parcel::WritableBlob overflow;
+    ASSERT_EQ(android::NO_ERROR, parcel.writeBlob(20 * 1024, pool, &pooled));
+    EXPECT_EQ(size_t(0), pool->availableSlots());
+    ASSERT_EQ(android::NO_ERROR, parcel.writeBlob(20 * 1024, pool, &overflow));
+    EXPECT_NE(-1, overflow.fd());
+}
@@ -17,55 +17,249 @@
 
 #include <dirent.h>
 #include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <unistd.h>
 
 #include <diskusage/dirsize.h>
 
+/* Entries as getdents64(2) returns them */
+struct dirsize_dirent {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+/* Large enough for a few hundred entries per getdents64(2) call */
+#define DIRENT_BUFFER_SIZE 16384
+
+/* A directory being read, and how far */
+struct dir_frame {
+    int fd;
+    int pos;
+    int len;
+    char buf[DIRENT_BUFFER_SIZE];
+};
+
+struct dir_stack {
+    struct dir_frame **frames;
+    int depth;
+    int allocated;  /* frames are kept for reuse once popped */
+    int capacity;
+};
+
 int64_t stat_size(struct stat *s)
 {
     return s->st_blocks * 512;
 }
 
+static int is_dot_or_dotdot(const char *name)
+{
+    return name[0] == '.' && (name[1] == 0 || (name[1] == '.' && name[2] == 0));
+}
+
+static int push_dir(struct dir_stack *stack, int fd)
+{
+    if (stack->depth == stack->allocated) {
+        if (stack->allocated == stack->capacity) {
+            int capacity = stack->capacity ? stack->capacity * 2 : 8;
+            struct dir_frame **frames =
+                    realloc(stack->frames, capacity * sizeof(struct dir_frame *));
+            if (frames == NULL)
+                return -1;
+            stack->frames = frames;
+            stack->capacity = capacity;
+        }
+        stack->frames[stack->allocated] = malloc(sizeof(struct dir_frame));
+        if (stack->frames[stack->allocated] == NULL)
+            return -1;
+        stack->allocated++;
+    }
+    struct dir_frame *frame = stack->frames[stack->depth++];
+    frame->fd = fd;
+    frame->pos = 0;
+    frame->len = 0;
+    return 0;
+}
+
+/* Returns the next entry of the innermost directory, popping the ones read to the end */
+static struct dirsize_dirent *next_entry(struct dir_stack *stack, int *outDirFd)
+{
+    while (stack->depth > 0) {
+        struct dir_frame *frame = stack->frames[stack->depth - 1];
+        if (frame->pos >= frame->len) {
+            long n = syscall(SYS_getdents64, frame->fd, frame->buf, sizeof(frame->buf));
+            if (n <= 0) {
+                close(frame->fd);
+                stack->depth--;
+                continue;
+            }
+            frame->pos = 0;
+            frame->len = n;
+        }
+        struct dirsize_dirent *de = (struct dirsize_dirent *)(frame->buf + frame->pos);
+        frame->pos += de->d_reclen;
+        *outDirFd = frame->fd;
+        return de;
+    }
+    return NULL;
+}
+
+/*
+ * Walks the tree with an explicit stack of the directories being read, so
+ * that deep trees need neither deep recursion nor more than one open file
+ * descriptor per level.
+ */
 int64_t calculate_dir_size(int dfd)
 {
     int64_t size = 0;
     struct stat s;
-    DIR *d;
-    struct dirent *de;
+    struct dir_stack stack = { NULL, 0, 0, 0 };
+    struct dirsize_dirent *de;
+    int fd;
 
-    d = fdopendir(dfd);
-    if (d == NULL) {
+    if (push_dir(&stack, dfd) < 0) {
         close(dfd);
-        return 0;
+        stack.depth = 0;
     }
 
-    while ((de = readdir(d))) {
+    while ((de = next_entry(&stack, &fd))) {
         const char *name = de->d_name;
         if (de->d_type == DT_DIR) {
             int subfd;
 
             /* always skip "." and ".." */
-            if (name[0] == '.') {
-                if (name[1] == 0)
-                    continue;
-                if ((name[1] == '.') && (name[2] == 0))
-                    continue;
-            }
+            if (is_dot_or_dotdot(name))
+                continue;
 
-            if (fstatat(dfd, name, &s, AT_SYMLINK_NOFOLLOW) == 0) {
+            if (fstatat(fd, name, &s, AT_SYMLINK_NOFOLLOW) == 0) {
                 size += stat_size(&s);
             }
-            subfd = openat(dfd, name, O_RDONLY | O_DIRECTORY);
-            if (subfd >= 0) {
-                size += calculate_dir_size(subfd);
+            subfd = openat(fd, name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+            if (subfd >= 0 && push_dir(&stack, subfd) < 0) {
+                close(subfd);
             }
         } else {
+            if (fstatat(fd, name, &s, AT_SYMLINK_NOFOLLOW) == 0) {
+                size += stat_size(&s);
+            }
+        }
+    }
+
+    for (int i = 0; i < stack.allocated; i++) {
+        free(stack.frames[i]);
+    }
+    free(stack.frames);
+    return size;
+}
+
+struct parallel_walk {
+    int dfd;
+    char **names;
+    int count;
+    int next;
+};
+
+struct parallel_worker {
+    pthread_t thread;
+    struct parallel_walk *walk;
+    int64_t size;
+};
+
+static void *parallel_worker_main(void *arg)
+{
+    struct parallel_worker *worker = arg;
+    struct parallel_walk *walk = worker->walk;
+    int i;
+
+    while ((i = __atomic_fetch_add(&walk->next, 1, __ATOMIC_RELAXED)) < walk->count) {
+        int subfd = openat(walk->dfd, walk->names[i], O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (subfd >= 0) {
+            worker->size += calculate_dir_size(subfd);
+        }
+    }
+    return NULL;
+}
+
+int64_t calculate_dir_size_parallel(int dfd, int threads)
+{
+    int64_t size = 0;
+    struct stat s;
+    struct parallel_walk walk = { dfd, NULL, 0, 0 };
+    struct parallel_worker *workers = NULL;
+    int capacity = 0;
+    int started = 0;
+    char *buf;
+    long n;
+
+    if (threads <= 1)
+        return calculate_dir_size(dfd);
+    buf = malloc(DIRENT_BUFFER_SIZE);
+    if (buf == NULL)
+        return calculate_dir_size(dfd);
+
+    /* The top level is stat'ed here, its subdirectories are shared out */
+    while ((n = syscall(SYS_getdents64, dfd, buf, DIRENT_BUFFER_SIZE)) > 0) {
+        for (long pos = 0; pos < n; ) {
+            struct dirsize_dirent *de = (struct dirsize_dirent *)(buf + pos);
+            const char *name = de->d_name;
+            pos += de->d_reclen;
+            if (de->d_type == DT_DIR && is_dot_or_dotdot(name))
+                continue;
             if (fstatat(dfd, name, &s, AT_SYMLINK_NOFOLLOW) == 0) {
                 size += stat_size(&s);
             }
+            if (de->d_type != DT_DIR)
+                continue;
+            if (walk.count == capacity) {
+                int newCapacity = capacity ? capacity * 2 : 16;
+                char **names = realloc(walk.names, newCapacity * sizeof(char *));
+                if (names == NULL)
+                    continue;
+                walk.names = names;
+                capacity = newCapacity;
+            }
+            if ((walk.names[walk.count] = strdup(name)) != NULL)
+                walk.count++;
         }
     }
-    closedir(d);
+    free(buf);
+
+    if (threads > walk.count)
+        threads = walk.count;
+    if (threads > 1)
+        workers = calloc(threads, sizeof(struct parallel_worker));
+    if (workers != NULL) {
+        /* this thread is the first worker */
+        for (started = 1; started < threads; started++) {
+            workers[started].walk = &walk;
+            if (pthread_create(&workers[started].thread, NULL, parallel_worker_main,
+                    &workers[started]) != 0)
+                break;
+        }
+        workers[0].walk = &walk;
+        parallel_worker_main(&workers[0]);
+        size += workers[0].size;
+        for (int i = 1; i < started; i++) {
+            pthread_join(workers[i].thread, NULL);
+            size += workers[i].size;
+        }
+        free(workers);
+    } else {
+        struct parallel_worker worker = { .walk = &walk, .size = 0 };
+        parallel_worker_main(&worker);
+        size += worker.size;
+    }
+
+    for (int i = 0; i < walk.count; i++) {
+        free(walk.names[i]);
+    }
+    free(walk.names);
+    close(dfd);
     return size;
 }
@@ -18,9 +18,15 @@
 #define LOG_TAG "GraphicsEnv"
 #include <graphicsenv/GraphicsEnv.h>
 
+#include <dlfcn.h>
+#include <limits.h>
+#include <stdio.h>
+
 #include <mutex>
+#include <thread>
 
 #include <android/dlext.h>
+#include <cutils/properties.h>
 #include <log/log.h>
 
 // TODO(b/37049319) Get this from a header once one exists
@@ -54,6 +60,9 @@ void GraphicsEnv::setDriverPath(const std::string path) {
     }
     ALOGV("setting driver path to '%s'", path.c_str());
     mDriverPath = path;
+    if (property_get_bool("ro.gfx.driver.preload", false)) {
+        preloadDriver();
+    }
 }
 
 void GraphicsEnv::setLayerPaths(android_namespace_t* appNamespace, const std::string layerPaths) {
@@ -102,6 +111,51 @@ android_namespace_t* GraphicsEnv::getDriverNamespace() {
     return mDriverNamespace;
 }
 
+void GraphicsEnv::preloadDriver() {
+    if (mDriverPath.empty()) return;
+    std::call_once(mPreloadOnce, [this]() {
+        // The names the EGL loader and the Vulkan loader look up, in the order they do. The
+        // EGL loader only looks for the split libraries when there is no combined one.
+        static const struct {
+            const char* property;
+            const char* format;
+            bool splitGles;
+        } kLibraries[] = {
+                {"ro.hardware.egl", "libGLES_%s.so", false},
+                {"ro.hardware.egl", "libEGL_%s.so", true},
+                {"ro.hardware.egl", "libGLESv1_CM_%s.so", true},
+                {"ro.hardware.egl", "libGLESv2_%s.so", true},
+                {"ro.hardware.vulkan", "vulkan.%s.so", false},
+        };
+        std::thread([this]() {
+            android_namespace_t* ns = getDriverNamespace();
+            if (!ns) return;
+            const android_dlextinfo dlextinfo = {
+                    .flags = ANDROID_DLEXT_USE_NAMESPACE,
+                    .library_namespace = ns,
+            };
+            bool hasCombinedGles = false;
+            for (const auto& library : kLibraries) {
+                if (library.splitGles && hasCombinedGles) continue;
+                // Like the loaders, fall back to the board name.
+                for (const char* key : {library.property, "ro.board.platform"}) {
+                    char prop[PROPERTY_VALUE_MAX];
+                    if (property_get(key, prop, nullptr) <= 0) continue;
+                    char name[PATH_MAX];
+                    snprintf(name, sizeof(name), library.format, prop);
+                    void* so = android_dlopen_ext(name, RTLD_LOCAL | RTLD_NOW, &dlextinfo);
+                    if (so) {
+                        ALOGV("preloaded %s", name);
+                        mPreloadedLibraries.push_back(so);
+                        hasCombinedGles |= (&library == &kLibraries[0]);
+                        break;
+                    }
+                }
+            }
+        }).detach();
+    });
+}
+
 } // namespace android
 
 extern "C" android_namespace_t* android_getDriverNamespace() {
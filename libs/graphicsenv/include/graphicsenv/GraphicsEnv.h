@@ -17,7 +17,9 @@
 #ifndef ANDROID_UI_GRAPHICS_ENV_H
 #define ANDROID_UI_GRAPHICS_ENV_H 1
 
+#include <mutex>
 #include <string>
+#include <vector>
 
 struct android_namespace_t;
 
@@ -35,6 +37,13 @@ public:
     void setDriverPath(const std::string path);
     android_namespace_t* getDriverNamespace();
 
+    // Loads the EGL, GLES and Vulkan libraries of the driver set with
+    // setDriverPath() into its namespace on a background thread, so that the
+    // first EGL or Vulkan call finds them loaded instead of searching the
+    // driver path. setDriverPath() does this itself when ro.gfx.driver.preload
+    // is set. Does nothing without a driver path, or when called again.
+    void preloadDriver();
+
     void setLayerPaths(android_namespace_t* appNamespace, const std::string layerPaths);
     android_namespace_t* getAppNamespace();
     const std::string getLayerPaths();
@@ -49,6 +58,10 @@ private:
     std::string mLayerPaths;
     android_namespace_t* mDriverNamespace = nullptr;
     android_namespace_t* mAppNamespace = nullptr;
+
+    std::once_flag mPreloadOnce;
+    // Kept open for the life of the process, as the loaders keep the driver
+    std::vector<void*> mPreloadedLibraries;
 };
 
 } // namespace android
@@ -142,11 +142,27 @@ status_t BufferHubConsumer::getOccupancyHistory(
     return INVALID_OPERATION;
 }
 
+status_t BufferHubConsumer::getLatencyStats(bool /*reset*/,
+                                           LatencyTracker::Stats* /*outStats*/) {
+    ALOGE("BufferHubConsumer::getLatencyStats: not implemented.");
+    return INVALID_OPERATION;
+}
+
 status_t BufferHubConsumer::discardFreeBuffers() {
     ALOGE("BufferHubConsumer::discardFreeBuffers: not implemented.");
     return INVALID_OPERATION;
 }
 
+status_t BufferHubConsumer::setAdaptiveBufferCount(bool /*enabled*/) {
+    ALOGE("BufferHubConsumer::setAdaptiveBufferCount: not implemented.");
+    return INVALID_OPERATION;
+}
+
+status_t BufferHubConsumer::setBufferPreallocation(bool /*enabled*/) {
+    ALOGE("BufferHubConsumer::setBufferPreallocation: not implemented.");
+    return INVALID_OPERATION;
+}
+
 status_t BufferHubConsumer::dumpState(const String8& /*prefix*/, String8* /*outResult*/) const {
     ALOGE("BufferHubConsumer::dumpState: not implemented.");
     return INVALID_OPERATION;
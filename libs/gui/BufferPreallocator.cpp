@@ -0,0 +1,72 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "BufferPreallocator"
+
+#include <pthread.h>
+
+#include <gui/BufferQueueCore.h>
+#include <private/gui/BufferPreallocator.h>
+
+#include <utils/Log.h>
+
+namespace android {
+
+ANDROID_SINGLETON_STATIC_INSTANCE(BufferPreallocator);
+
+BufferPreallocator::~BufferPreallocator() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mDone = true;
+    }
+    mCondition.notify_all();
+    if (mThread.joinable()) {
+        mThread.join();
+    }
+}
+
+void BufferPreallocator::schedule(const wp<BufferQueueCore>& core) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (!mThread.joinable()) {
+        mThread = std::thread(&BufferPreallocator::threadMain, this);
+        pthread_setname_np(mThread.native_handle(), "BufferPrealloc");
+    }
+    mPending.push_back(core);
+    mCondition.notify_one();
+}
+
+void BufferPreallocator::threadMain() {
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (!mDone) {
+        if (mPending.empty()) {
+            mCondition.wait(lock);
+            continue;
+        }
+        wp<BufferQueueCore> weakCore = mPending.front();
+        mPending.pop_front();
+
+        // Allocating can take a while, so don't hold up schedule() meanwhile
+        lock.unlock();
+        sp<BufferQueueCore> core = weakCore.promote();
+        if (core != nullptr) {
+            core->preallocateBuffers();
+        }
+        core.clear();
+        lock.lock();
+    }
+}
+
+} // namespace android
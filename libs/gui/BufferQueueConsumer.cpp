@@ -171,7 +171,7 @@ status_t BufferQueueConsumer::acquireBuffer(BufferItem* outBuffer,
                     ++numDroppedBuffers;
                 }
 
-                mCore->mQueue.erase(front);
+                mCore->mQueue.pop_front();
                 front = mCore->mQueue.begin();
             }
 
@@ -239,6 +239,7 @@ status_t BufferQueueConsumer::acquireBuffer(BufferItem* outBuffer,
                 slot, outBuffer->mFrameNumber, outBuffer->mGraphicBuffer->handle);
 
         if (!outBuffer->mIsStale) {
+            const nsecs_t now = systemTime();
             mSlots[slot].mAcquireCalled = true;
             // Don't decrease the queue count if the BufferItem wasn't
             // previously in the queue. This happens in shared buffer mode when
@@ -247,8 +248,10 @@ status_t BufferQueueConsumer::acquireBuffer(BufferItem* outBuffer,
                 mSlots[slot].mBufferState.acquireNotInQueue();
             } else {
                 mSlots[slot].mBufferState.acquire();
+                mCore->mLatencyTracker.registerQueueResidency(now - mSlots[slot].mQueueTime);
             }
             mSlots[slot].mFence = Fence::NO_FENCE;
+            mSlots[slot].mAcquireTime = now;
         }
 
         // If the buffer has previously been acquired by the consumer, set
@@ -258,7 +261,9 @@ status_t BufferQueueConsumer::acquireBuffer(BufferItem* outBuffer,
             outBuffer->mGraphicBuffer = NULL;
         }
 
-        mCore->mQueue.erase(front);
+        if (!mCore->mQueue.empty()) {
+            mCore->mQueue.pop_front();
+        }
 
         // We might have freed a slot while dropping old buffers, or the producer
         // may be blocked waiting for the number of buffers in the queue to
@@ -361,9 +366,8 @@ status_t BufferQueueConsumer::attachBuffer(int* outSlot,
     // Find a free slot to put the buffer into
     int found = BufferQueueCore::INVALID_BUFFER_SLOT;
     if (!mCore->mFreeSlots.empty()) {
-        auto slot = mCore->mFreeSlots.begin();
-        found = *slot;
-        mCore->mFreeSlots.erase(slot);
+        found = mCore->mFreeSlots.first();
+        mCore->mFreeSlots.erase(found);
     } else if (!mCore->mFreeBuffers.empty()) {
         found = mCore->mFreeBuffers.front();
         mCore->mFreeBuffers.remove(found);
@@ -444,6 +448,7 @@ status_t BufferQueueConsumer::releaseBuffer(int slot, uint64_t frameNumber,
         mSlots[slot].mEglFence = eglFence;
         mSlots[slot].mFence = releaseFence;
         mSlots[slot].mBufferState.release();
+        mCore->mLatencyTracker.registerAcquireToRelease(systemTime() - mSlots[slot].mAcquireTime);
 
         // After leaving shared buffer mode, the shared buffer will
         // still be around. Mark it as no longer shared if this
@@ -569,8 +574,11 @@ status_t BufferQueueConsumer::setDefaultBufferSize(uint32_t width,
     BQ_LOGV("setDefaultBufferSize: width=%u height=%u", width, height);
 
     Mutex::Autolock lock(mCore->mMutex);
-    mCore->mDefaultWidth = width;
-    mCore->mDefaultHeight = height;
+    if (width != mCore->mDefaultWidth || height != mCore->mDefaultHeight) {
+        mCore->mDefaultWidth = width;
+        mCore->mDefaultHeight = height;
+        mCore->scheduleBufferPreallocationLocked();
+    }
     return NO_ERROR;
 }
 
@@ -743,12 +751,40 @@ status_t BufferQueueConsumer::getOccupancyHistory(bool forceFlush,
     return NO_ERROR;
 }
 
+status_t BufferQueueConsumer::getLatencyStats(bool reset, LatencyTracker::Stats* outStats) {
+    Mutex::Autolock lock(mCore->mMutex);
+    *outStats = mCore->mLatencyTracker.getStats(reset);
+    return NO_ERROR;
+}
+
 status_t BufferQueueConsumer::discardFreeBuffers() {
     Mutex::Autolock lock(mCore->mMutex);
     mCore->discardFreeBuffersLocked();
     return NO_ERROR;
 }
 
+status_t BufferQueueConsumer::setAdaptiveBufferCount(bool enabled) {
+    ATRACE_CALL();
+    BQ_LOGV("setAdaptiveBufferCount: %d", enabled);
+    Mutex::Autolock lock(mCore->mMutex);
+    if (enabled == mCore->mAdaptiveBufferCount) {
+        return NO_ERROR;
+    }
+    mCore->mAdaptiveBufferCount = enabled;
+    mCore->resetAdaptiveBufferCountLocked();
+    // Lifting the limit may let a blocked producer allocate
+    mCore->mDequeueCondition.broadcast();
+    return NO_ERROR;
+}
+
+status_t BufferQueueConsumer::setBufferPreallocation(bool enabled) {
+    ATRACE_CALL();
+    BQ_LOGV("setBufferPreallocation: %d", enabled);
+    Mutex::Autolock lock(mCore->mMutex);
+    mCore->mBufferPreallocation = enabled;
+    return NO_ERROR;
+}
+
 status_t BufferQueueConsumer::dumpState(const String8& prefix, String8* outResult) const {
     struct passwd* pwd = getpwnam("shell");
     uid_t shellUid = pwd ? pwd->pw_uid : 0;
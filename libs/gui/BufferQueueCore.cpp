@@ -36,12 +36,15 @@
 #include <gui/IConsumerListener.h>
 #include <gui/IProducerListener.h>
 #include <gui/ISurfaceComposer.h>
+#include <private/gui/BufferPreallocator.h>
 #include <private/gui/ComposerService.h>
 
 #include <system/window.h>
 
 namespace android {
 
+static constexpr uint32_t BQ_LAYER_COUNT = 1;
+
 static String8 getUniqueName() {
     static volatile int32_t counter = 0;
     return String8::format("unnamed-%d-%d", getpid(),
@@ -95,8 +98,22 @@ BufferQueueCore::BufferQueueCore() :
     mSharedBufferCache(Rect::INVALID_RECT, 0, NATIVE_WINDOW_SCALING_MODE_FREEZE,
             HAL_DATASPACE_UNKNOWN),
     mLastQueuedSlot(INVALID_BUFFER_SLOT),
+    mAdaptiveBufferCount(false),
+    mAdaptiveBufferLimit(0),
+    mAdaptiveBlockCount(0),
+    mAdaptiveBlockWindowStart(0),
+    mBufferPreallocation(false),
+    mBufferPreallocationPending(false),
+    mLastDequeueFormat(PIXEL_FORMAT_UNKNOWN),
+    mLastDequeueUsage(0),
+    mLastDequeueUsedDefaultSize(false),
+    mFrameEventsRequested(false),
     mUniqueId(getUniqueId())
 {
+    // Reserving the slot lists up front keeps them from ever allocating
+    mFreeBuffers.reserve(BufferQueueDefs::NUM_BUFFER_SLOTS);
+    mUnusedSlots.reserve(BufferQueueDefs::NUM_BUFFER_SLOTS);
+
     int numStartingBuffers = getMaxBufferCountLocked();
     for (int s = 0; s < numStartingBuffers; s++) {
         mFreeSlots.insert(s);
@@ -117,6 +134,11 @@ void BufferQueueCore::dumpState(const String8& prefix, String8* outResult) const
                             mMaxAcquiredBufferCount, mMaxDequeuedBufferCount);
     outResult->appendFormat("%s  mDequeueBufferCannotBlock=%d mAsyncMode=%d\n", prefix.string(),
                             mDequeueBufferCannotBlock, mAsyncMode);
+    if (isAdaptiveBufferCountActiveLocked()) {
+        outResult->appendFormat("%s  adaptive-buffer-limit=%d allocated=%d\n", prefix.string(),
+                                getAdaptiveBufferLimitLocked(), getAllocatedBufferCountLocked());
+    }
+    mLatencyTracker.dump(prefix, outResult);
     outResult->appendFormat("%s  default-size=[%dx%d] default-format=%d ", prefix.string(),
                             mDefaultWidth, mDefaultHeight, mDefaultBufferFormat);
     outResult->appendFormat("transform-hint=%02x frame-counter=%" PRIu64, mTransformHint,
@@ -288,9 +310,9 @@ bool BufferQueueCore::adjustAvailableSlotsLocked(int delta) {
         }
         while (delta < 0) {
             if (!mFreeSlots.empty()) {
-                auto slot = mFreeSlots.begin();
-                clearBufferSlotLocked(*slot);
-                mUnusedSlots.push_back(*slot);
+                int slot = mFreeSlots.first();
+                clearBufferSlotLocked(slot);
+                mUnusedSlots.push_back(slot);
                 mFreeSlots.erase(slot);
             } else if (!mFreeBuffers.empty()) {
                 int slot = mFreeBuffers.back();
@@ -313,19 +335,246 @@ void BufferQueueCore::waitWhileAllocatingLocked() const {
     }
 }
 
+bool BufferQueueCore::isAdaptiveBufferCountActiveLocked() const {
+    return mAdaptiveBufferCount && !mAsyncMode && !mDequeueBufferCannotBlock &&
+            !mSharedBufferMode;
+}
+
+int BufferQueueCore::getAdaptiveBufferLimitLocked() const {
+    const int maxBufferCount = getMaxBufferCountLocked();
+    const int minBufferCount = std::min(mMaxAcquiredBufferCount + 1, maxBufferCount);
+    return std::max(minBufferCount, std::min(mAdaptiveBufferLimit, maxBufferCount));
+}
+
+int BufferQueueCore::getAllocatedBufferCountLocked() const {
+    return static_cast<int>(mActiveBuffers.size() + mFreeBuffers.size());
+}
+
+bool BufferQueueCore::onAdaptiveBufferLimitBlockedLocked(int dequeuedCount) {
+    // If the producer's own buffers leave no room besides what the consumer
+    // may hold, waiting could last forever
+    if (dequeuedCount + mMaxAcquiredBufferCount >= getAdaptiveBufferLimitLocked()) {
+        growAdaptiveBufferLimitLocked();
+        return true;
+    }
+
+    nsecs_t now = systemTime();
+    if (now - mAdaptiveBlockWindowStart > kAdaptiveGrowWindow) {
+        mAdaptiveBlockWindowStart = now;
+        mAdaptiveBlockCount = 0;
+    }
+    if (++mAdaptiveBlockCount >= kAdaptiveGrowBlocks) {
+        growAdaptiveBufferLimitLocked();
+        return true;
+    }
+    return false;
+}
+
+void BufferQueueCore::growAdaptiveBufferLimitLocked() {
+    mAdaptiveBufferLimit = getAdaptiveBufferLimitLocked() + 1;
+    mAdaptiveBlockCount = 0;
+    mOccupancyTracker.resetFramesWithoutThirdBuffer();
+    BQ_LOGV("growAdaptiveBufferLimitLocked: limit is now %d", getAdaptiveBufferLimitLocked());
+}
+
+void BufferQueueCore::onBuffersInUseLocked(int inUse) {
+    if (inUse > mMaxAcquiredBufferCount + 1) {
+        mOccupancyTracker.resetFramesWithoutThirdBuffer();
+    }
+}
+
+bool BufferQueueCore::updateAdaptiveBufferLimitLocked() {
+    if (!isAdaptiveBufferCountActiveLocked()) {
+        return false;
+    }
+
+    if (mOccupancyTracker.getFramesWithoutThirdBuffer() >= kAdaptiveShrinkFrames) {
+        mOccupancyTracker.resetFramesWithoutThirdBuffer();
+        mAdaptiveBufferLimit = getAdaptiveBufferLimitLocked() - 1;
+        BQ_LOGV("updateAdaptiveBufferLimitLocked: limit is now %d",
+                getAdaptiveBufferLimitLocked());
+    }
+
+    bool freed = false;
+    while (getAllocatedBufferCountLocked() > getAdaptiveBufferLimitLocked() &&
+            !mFreeBuffers.empty()) {
+        int slot = mFreeBuffers.back();
+        mFreeBuffers.pop_back();
+        clearBufferSlotLocked(slot);
+        mFreeSlots.insert(slot);
+        freed = true;
+    }
+    if (freed) {
+        VALIDATE_CONSISTENCY();
+    }
+    return freed;
+}
+
+void BufferQueueCore::resetAdaptiveBufferCountLocked() {
+    mAdaptiveBufferLimit = mMaxAcquiredBufferCount + 1;
+    mAdaptiveBlockCount = 0;
+    mAdaptiveBlockWindowStart = 0;
+    mOccupancyTracker.resetFramesWithoutThirdBuffer();
+}
+
+void BufferQueueCore::allocateBuffers(uint32_t width, uint32_t height,
+        PixelFormat format, uint64_t usage) {
+    ATRACE_CALL();
+    while (true) {
+        uint32_t allocWidth = 0;
+        uint32_t allocHeight = 0;
+        PixelFormat allocFormat = PIXEL_FORMAT_UNKNOWN;
+        uint64_t allocUsage = 0;
+        std::string allocName;
+        { // Autolock scope
+            Mutex::Autolock lock(mMutex);
+            waitWhileAllocatingLocked();
+
+            if (!mAllowAllocation) {
+                BQ_LOGE("allocateBuffers: allocation is not allowed for this "
+                        "BufferQueue");
+                return;
+            }
+
+            allocWidth = width > 0 ? width : mDefaultWidth;
+            allocHeight = height > 0 ? height : mDefaultHeight;
+            allocFormat = format != 0 ? format : mDefaultBufferFormat;
+            allocUsage = usage | mConsumerUsageBits;
+            allocName.assign(mConsumerName.string(), mConsumerName.size());
+
+            // Only allocate one buffer at a time to reduce risks of
+            // overlapping an allocation from both allocateBuffers and
+            // dequeueBuffer.
+            const bool canFillSlot = !mFreeSlots.empty() &&
+                    (!isAdaptiveBufferCountActiveLocked() ||
+                     getAllocatedBufferCountLocked() < getAdaptiveBufferLimitLocked());
+            if (!canFillSlot && getStaleFreeBufferLocked(allocWidth, allocHeight,
+                    allocFormat, allocUsage) == INVALID_BUFFER_SLOT) {
+                return;
+            }
+
+            mIsAllocating = true;
+        } // Autolock scope
+
+        sp<GraphicBuffer> graphicBuffer = new GraphicBuffer(
+                allocWidth, allocHeight, allocFormat, BQ_LAYER_COUNT,
+                allocUsage, allocName);
+
+        status_t result = graphicBuffer->initCheck();
+
+        if (result != NO_ERROR) {
+            BQ_LOGE("allocateBuffers: failed to allocate buffer (%u x %u, format"
+                    " %u, usage %#" PRIx64 ")", width, height, format, usage);
+            Mutex::Autolock lock(mMutex);
+            mIsAllocating = false;
+            mIsAllocatingCondition.broadcast();
+            return;
+        }
+
+        { // Autolock scope
+            Mutex::Autolock lock(mMutex);
+            uint32_t checkWidth = width > 0 ? width : mDefaultWidth;
+            uint32_t checkHeight = height > 0 ? height : mDefaultHeight;
+            PixelFormat checkFormat = format != 0 ?
+                    format : mDefaultBufferFormat;
+            uint64_t checkUsage = usage | mConsumerUsageBits;
+            if (checkWidth != allocWidth || checkHeight != allocHeight ||
+                checkFormat != allocFormat || checkUsage != allocUsage) {
+                // Something changed while we released the lock. Retry.
+                BQ_LOGV("allocateBuffers: size/format/usage changed while allocating. Retrying.");
+                mIsAllocating = false;
+                mIsAllocatingCondition.broadcast();
+                continue;
+            }
+
+            // Replacing a stale buffer keeps the number of allocated buffers
+            // the same, so prefer it over filling an empty slot
+            int slot = getStaleFreeBufferLocked(allocWidth, allocHeight,
+                    allocFormat, allocUsage);
+            if (slot != INVALID_BUFFER_SLOT) {
+                mFreeBuffers.remove(slot);
+                mFreeSlots.insert(slot);
+            } else if (!mFreeSlots.empty()) {
+                slot = mFreeSlots.first();
+            }
+
+            if (slot == INVALID_BUFFER_SLOT) {
+                BQ_LOGV("allocateBuffers: a slot was occupied while "
+                        "allocating. Dropping allocated buffer.");
+            } else {
+                clearBufferSlotLocked(slot); // Clean up the slot first
+                mSlots[slot].mGraphicBuffer = graphicBuffer;
+                mSlots[slot].mFence = Fence::NO_FENCE;
+
+                // clearBufferSlotLocked leaves this slot in the free slots
+                // list. Since we then attached a buffer, move the slot to the
+                // free buffer list.
+                mFreeBuffers.push_front(slot);
+
+                BQ_LOGV("allocateBuffers: allocated a new buffer in slot %d",
+                        slot);
+
+                mFreeSlots.erase(slot);
+            }
+
+            mIsAllocating = false;
+            mIsAllocatingCondition.broadcast();
+            VALIDATE_CONSISTENCY();
+        } // Autolock scope
+    }
+}
+
+int BufferQueueCore::getStaleFreeBufferLocked(uint32_t width, uint32_t height,
+        PixelFormat format, uint64_t usage) const {
+    for (int slot : mFreeBuffers) {
+        if (slot == mSharedBufferSlot) {
+            continue;
+        }
+        const sp<GraphicBuffer>& buffer(mSlots[slot].mGraphicBuffer);
+        if (buffer->needsReallocation(width, height, format, BQ_LAYER_COUNT, usage)) {
+            return slot;
+        }
+    }
+    return INVALID_BUFFER_SLOT;
+}
+
+void BufferQueueCore::scheduleBufferPreallocationLocked() {
+    if (!mBufferPreallocation || mBufferPreallocationPending || mIsAbandoned ||
+            mConnectedApi == NO_CONNECTED_API || !mLastDequeueUsedDefaultSize ||
+            mSharedBufferMode) {
+        return;
+    }
+    mBufferPreallocationPending = true;
+    BufferPreallocator::getInstance().schedule(this);
+}
+
+void BufferQueueCore::preallocateBuffers() {
+    ATRACE_CALL();
+    PixelFormat format = PIXEL_FORMAT_UNKNOWN;
+    uint64_t usage = 0;
+    { // Autolock scope
+        Mutex::Autolock lock(mMutex);
+        mBufferPreallocationPending = false;
+        if (mIsAbandoned || mConnectedApi == NO_CONNECTED_API ||
+                !mLastDequeueUsedDefaultSize) {
+            return;
+        }
+        format = mLastDequeueFormat;
+        usage = mLastDequeueUsage;
+    } // Autolock scope
+
+    allocateBuffers(0, 0, format, usage);
+}
+
 #if DEBUG_ONLY_CODE
 void BufferQueueCore::validateConsistencyLocked() const {
     static const useconds_t PAUSE_TIME = 0;
     int allocatedSlots = 0;
     for (int slot = 0; slot < BufferQueueDefs::NUM_BUFFER_SLOTS; ++slot) {
         bool isInFreeSlots = mFreeSlots.count(slot) != 0;
-        bool isInFreeBuffers =
-                std::find(mFreeBuffers.cbegin(), mFreeBuffers.cend(), slot) !=
-                mFreeBuffers.cend();
+        bool isInFreeBuffers = mFreeBuffers.contains(slot);
         bool isInActiveBuffers = mActiveBuffers.count(slot) != 0;
-        bool isInUnusedSlots =
-                std::find(mUnusedSlots.cbegin(), mUnusedSlots.cend(), slot) !=
-                mUnusedSlots.cend();
+        bool isInUnusedSlots = mUnusedSlots.contains(slot);
 
         if (isInFreeSlots || isInFreeBuffers || isInActiveBuffers) {
             allocatedSlots++;
@@ -240,7 +240,7 @@ int BufferQueueProducer::getFreeSlotLocked() const {
     if (mCore->mFreeSlots.empty()) {
         return BufferQueueCore::INVALID_BUFFER_SLOT;
     }
-    int slot = *(mCore->mFreeSlots.begin());
+    int slot = mCore->mFreeSlots.first();
     mCore->mFreeSlots.erase(slot);
     return slot;
 }
@@ -250,6 +250,7 @@ status_t BufferQueueProducer::waitForFreeSlotThenRelock(FreeSlotCaller caller,
     auto callerString = (caller == FreeSlotCaller::Dequeue) ?
             "dequeueBuffer" : "attachBuffer";
     bool tryAgain = true;
+    bool countedAdaptiveBlock = false;
     while (tryAgain) {
         if (mCore->mIsAbandoned) {
             BQ_LOGE("%s: BufferQueue has been abandoned", callerString);
@@ -278,6 +279,7 @@ status_t BufferQueueProducer::waitForFreeSlotThenRelock(FreeSlotCaller caller,
         }
 
         *found = BufferQueueCore::INVALID_BUFFER_SLOT;
+        bool blockedByAdaptiveLimit = false;
 
         // If we disconnect and reconnect quickly, we can be in a state where
         // our slots are empty but we have many buffers in the queue. This can
@@ -302,7 +304,15 @@ status_t BufferQueueProducer::waitForFreeSlotThenRelock(FreeSlotCaller caller,
                     if (slot != BufferQueueCore::INVALID_BUFFER_SLOT) {
                         *found = slot;
                     } else if (mCore->mAllowAllocation) {
-                        *found = getFreeSlotLocked();
+                        // Only allocate past the adaptive buffer count
+                        // once it has grown to allow it
+                        if (mCore->isAdaptiveBufferCountActiveLocked() &&
+                                mCore->getAllocatedBufferCountLocked() >=
+                                        mCore->getAdaptiveBufferLimitLocked()) {
+                            blockedByAdaptiveLimit = true;
+                        } else {
+                            *found = getFreeSlotLocked();
+                        }
                     }
                 } else {
                     // If we're calling this from attach, prefer free slots
@@ -321,6 +331,16 @@ status_t BufferQueueProducer::waitForFreeSlotThenRelock(FreeSlotCaller caller,
         // max buffer count to change.
         tryAgain = (*found == BufferQueueCore::INVALID_BUFFER_SLOT) ||
                    tooManyBuffers;
+        if (!tryAgain && mCore->isAdaptiveBufferCountActiveLocked()) {
+            mCore->onBuffersInUseLocked(dequeuedCount + acquiredCount +
+                    static_cast<int>(mCore->mQueue.size()) + 1);
+        }
+        if (tryAgain && blockedByAdaptiveLimit && !countedAdaptiveBlock) {
+            countedAdaptiveBlock = true;
+            if (mCore->onAdaptiveBufferLimitBlockedLocked(dequeuedCount)) {
+                continue;
+            }
+        }
         if (tryAgain) {
             // Return an error if we're in non-blocking mode (producer and
             // consumer are controlled by the application).
@@ -332,7 +352,22 @@ status_t BufferQueueProducer::waitForFreeSlotThenRelock(FreeSlotCaller caller,
                     (acquiredCount <= mCore->mMaxAcquiredBufferCount)) {
                 return WOULD_BLOCK;
             }
-            if (mDequeueTimeout >= 0) {
+            if (blockedByAdaptiveLimit) {
+                // A release wakes us up as usual, but rather than let the
+                // adaptive buffer count stall the producer, grow it
+                nsecs_t timeout = BufferQueueCore::kAdaptiveMaxBlockTime;
+                if (mDequeueTimeout >= 0 && mDequeueTimeout < timeout) {
+                    timeout = mDequeueTimeout;
+                }
+                status_t result = mCore->mDequeueCondition.waitRelative(
+                        mCore->mMutex, timeout);
+                if (result == TIMED_OUT) {
+                    mCore->growAdaptiveBufferLimitLocked();
+                    if (timeout == mDequeueTimeout) {
+                        return result;
+                    }
+                }
+            } else if (mDequeueTimeout >= 0) {
                 status_t result = mCore->mDequeueCondition.waitRelative(
                         mCore->mMutex, mDequeueTimeout);
                 if (result == TIMED_OUT) {
@@ -395,11 +430,19 @@ status_t BufferQueueProducer::dequeueBuffer(int* outSlot, sp<android::Fence>* ou
             height = mCore->mDefaultHeight;
         }
 
+        // Remembered so that buffers preallocated after a resize match what
+        // this producer asks for
+        mCore->mLastDequeueFormat = format;
+        mCore->mLastDequeueUsage = usage;
+        mCore->mLastDequeueUsedDefaultSize = useDefaultSize;
+
+        const nsecs_t waitStartTime = systemTime();
         int found = BufferItem::INVALID_BUFFER_SLOT;
         while (found == BufferItem::INVALID_BUFFER_SLOT) {
             status_t status = waitForFreeSlotThenRelock(FreeSlotCaller::Dequeue,
                     &found);
             if (status != NO_ERROR) {
+                mCore->mLatencyTracker.registerDequeueWait(systemTime() - waitStartTime);
                 return status;
             }
 
@@ -428,6 +471,7 @@ status_t BufferQueueProducer::dequeueBuffer(int* outSlot, sp<android::Fence>* ou
                 }
             }
         }
+        mCore->mLatencyTracker.registerDequeueWait(systemTime() - waitStartTime);
 
         const sp<GraphicBuffer>& buffer(mSlots[found].mGraphicBuffer);
         if (mCore->mSharedBufferSlot == found &&
@@ -785,9 +829,11 @@ status_t BufferQueueProducer::queueBuffer(int slot,
     }
 
     sp<IConsumerListener> frameAvailableListener;
+    sp<IConsumerListener> buffersReleasedListener;
     sp<IConsumerListener> frameReplacedListener;
     int callbackTicket = 0;
     uint64_t currentFrameNumber = 0;
+    bool recordFrameEvents = false;
     BufferItem item;
     { // Autolock scope
         Mutex::Autolock lock(mCore->mMutex);
@@ -848,11 +894,16 @@ status_t BufferQueueProducer::queueBuffer(int slot,
 
         mSlots[slot].mFence = acquireFence;
         mSlots[slot].mBufferState.queue();
+        mSlots[slot].mQueueTime = systemTime();
 
         // Increment the frame counter and store a local version of it
         // for use outside the lock on mCore->mMutex.
         ++mCore->mFrameCounter;
         currentFrameNumber = mCore->mFrameCounter;
+        if (getFrameTimestamps) {
+            mCore->mFrameEventsRequested = true;
+        }
+        recordFrameEvents = mCore->mFrameEventsRequested;
         mSlots[slot].mFrameNumber = currentFrameNumber;
 
         item.mAcquireCalled = mSlots[slot].mAcquireCalled;
@@ -899,8 +950,7 @@ status_t BufferQueueProducer::queueBuffer(int slot,
         } else {
             // When the queue is not empty, we need to look at the last buffer
             // in the queue to see if we need to replace it
-            const BufferItem& last = mCore->mQueue.itemAt(
-                    mCore->mQueue.size() - 1);
+            const BufferItem& last = mCore->mQueue.back();
             if (last.mIsDroppable) {
 
                 if (!last.mIsStale) {
@@ -922,7 +972,7 @@ status_t BufferQueueProducer::queueBuffer(int slot,
                 }
 
                 // Overwrite the droppable buffer with the incoming one
-                mCore->mQueue.editItemAt(mCore->mQueue.size() - 1) = item;
+                mCore->mQueue.back() = item;
                 frameReplacedListener = mCore->mConsumerListener;
             } else {
                 mCore->mQueue.push_back(item);
@@ -943,6 +993,9 @@ status_t BufferQueueProducer::queueBuffer(int slot,
         ATRACE_INT(mCore->mConsumerName.string(),
                 static_cast<int32_t>(mCore->mQueue.size()));
         mCore->mOccupancyTracker.registerOccupancyChange(mCore->mQueue.size());
+        if (mCore->updateAdaptiveBufferLimitLocked()) {
+            buffersReleasedListener = mCore->mConsumerListener;
+        }
 
         // Take a ticket for the callback functions
         callbackTicket = mNextCallbackTicket++;
@@ -989,6 +1042,11 @@ status_t BufferQueueProducer::queueBuffer(int slot,
         mCallbackCondition.broadcast();
     }
 
+    // Tell the consumer to drop the buffers freed by the adaptive buffer count
+    if (buffersReleasedListener != NULL) {
+        buffersReleasedListener->onBuffersReleased();
+    }
+
     // Wait without lock held
     if (connectedApi == NATIVE_WINDOW_API_EGL) {
         // Waiting here allows for two full buffers to be queued but not a
@@ -997,16 +1055,20 @@ status_t BufferQueueProducer::queueBuffer(int slot,
         lastQueuedFence->waitForever("Throttling EGL Production");
     }
 
-    // Update and get FrameEventHistory.
-    nsecs_t postedTime = systemTime(SYSTEM_TIME_MONOTONIC);
-    NewFrameEventsEntry newFrameEventsEntry = {
-        currentFrameNumber,
-        postedTime,
-        requestedPresentTimestamp,
-        std::move(acquireFenceTime)
-    };
-    addAndGetFrameTimestamps(&newFrameEventsEntry,
-            getFrameTimestamps ? &output->frameTimestamps : nullptr);
+    // Update and get FrameEventHistory. Frame events are only tracked once
+    // the producer asks for them, so producers that never enable frame
+    // timestamps don't pay for the consumer side bookkeeping.
+    if (recordFrameEvents) {
+        nsecs_t postedTime = systemTime(SYSTEM_TIME_MONOTONIC);
+        NewFrameEventsEntry newFrameEventsEntry = {
+            currentFrameNumber,
+            postedTime,
+            requestedPresentTimestamp,
+            std::move(acquireFenceTime)
+        };
+        addAndGetFrameTimestamps(&newFrameEventsEntry,
+                getFrameTimestamps ? &output->frameTimestamps : nullptr);
+    }
 
     return NO_ERROR;
 }
@@ -1283,6 +1345,8 @@ status_t BufferQueueProducer::disconnect(int api, DisconnectMode mode) {
                     mCore->mConnectedApi = BufferQueueCore::NO_CONNECTED_API;
                     mCore->mConnectedPid = -1;
                     mCore->mSidebandStream.clear();
+                    mCore->mLastDequeueUsedDefaultSize = false;
+                    mCore->mFrameEventsRequested = false;
                     mCore->mDequeueCondition.broadcast();
                     listener = mCore->mConsumerListener;
                 } else if (mCore->mConnectedApi == BufferQueueCore::NO_CONNECTED_API) {
@@ -1326,103 +1390,7 @@ status_t BufferQueueProducer::setSidebandStream(const sp<NativeHandle>& stream)
 
 void BufferQueueProducer::allocateBuffers(uint32_t width, uint32_t height,
         PixelFormat format, uint64_t usage) {
-    ATRACE_CALL();
-    while (true) {
-        size_t newBufferCount = 0;
-        uint32_t allocWidth = 0;
-        uint32_t allocHeight = 0;
-        PixelFormat allocFormat = PIXEL_FORMAT_UNKNOWN;
-        uint64_t allocUsage = 0;
-        std::string allocName;
-        { // Autolock scope
-            Mutex::Autolock lock(mCore->mMutex);
-            mCore->waitWhileAllocatingLocked();
-
-            if (!mCore->mAllowAllocation) {
-                BQ_LOGE("allocateBuffers: allocation is not allowed for this "
-                        "BufferQueue");
-                return;
-            }
-
-            // Only allocate one buffer at a time to reduce risks of overlapping an allocation from
-            // both allocateBuffers and dequeueBuffer.
-            newBufferCount = mCore->mFreeSlots.empty() ? 0 : 1;
-            if (newBufferCount == 0) {
-                return;
-            }
-
-            allocWidth = width > 0 ? width : mCore->mDefaultWidth;
-            allocHeight = height > 0 ? height : mCore->mDefaultHeight;
-            allocFormat = format != 0 ? format : mCore->mDefaultBufferFormat;
-            allocUsage = usage | mCore->mConsumerUsageBits;
-            allocName.assign(mCore->mConsumerName.string(), mCore->mConsumerName.size());
-
-            mCore->mIsAllocating = true;
-        } // Autolock scope
-
-        Vector<sp<GraphicBuffer>> buffers;
-        for (size_t i = 0; i < newBufferCount; ++i) {
-            sp<GraphicBuffer> graphicBuffer = new GraphicBuffer(
-                    allocWidth, allocHeight, allocFormat, BQ_LAYER_COUNT,
-                    allocUsage, allocName);
-
-            status_t result = graphicBuffer->initCheck();
-
-            if (result != NO_ERROR) {
-                BQ_LOGE("allocateBuffers: failed to allocate buffer (%u x %u, format"
-                        " %u, usage %#" PRIx64 ")", width, height, format, usage);
-                Mutex::Autolock lock(mCore->mMutex);
-                mCore->mIsAllocating = false;
-                mCore->mIsAllocatingCondition.broadcast();
-                return;
-            }
-            buffers.push_back(graphicBuffer);
-        }
-
-        { // Autolock scope
-            Mutex::Autolock lock(mCore->mMutex);
-            uint32_t checkWidth = width > 0 ? width : mCore->mDefaultWidth;
-            uint32_t checkHeight = height > 0 ? height : mCore->mDefaultHeight;
-            PixelFormat checkFormat = format != 0 ?
-                    format : mCore->mDefaultBufferFormat;
-            uint64_t checkUsage = usage | mCore->mConsumerUsageBits;
-            if (checkWidth != allocWidth || checkHeight != allocHeight ||
-                checkFormat != allocFormat || checkUsage != allocUsage) {
-                // Something changed while we released the lock. Retry.
-                BQ_LOGV("allocateBuffers: size/format/usage changed while allocating. Retrying.");
-                mCore->mIsAllocating = false;
-                mCore->mIsAllocatingCondition.broadcast();
-                continue;
-            }
-
-            for (size_t i = 0; i < newBufferCount; ++i) {
-                if (mCore->mFreeSlots.empty()) {
-                    BQ_LOGV("allocateBuffers: a slot was occupied while "
-                            "allocating. Dropping allocated buffer.");
-                    continue;
-                }
-                auto slot = mCore->mFreeSlots.begin();
-                mCore->clearBufferSlotLocked(*slot); // Clean up the slot first
-                mSlots[*slot].mGraphicBuffer = buffers[i];
-                mSlots[*slot].mFence = Fence::NO_FENCE;
-
-                // freeBufferLocked puts this slot on the free slots list. Since
-                // we then attached a buffer, move the slot to free buffer list.
-                mCore->mFreeBuffers.push_front(*slot);
-
-                BQ_LOGV("allocateBuffers: allocated a new buffer in slot %d",
-                        *slot);
-
-                // Make sure the erase is done after all uses of the slot
-                // iterator since it will be invalid after this point.
-                mCore->mFreeSlots.erase(slot);
-            }
-
-            mCore->mIsAllocating = false;
-            mCore->mIsAllocatingCondition.broadcast();
-            VALIDATE_CONSISTENCY();
-        } // Autolock scope
-    }
+    mCore->allocateBuffers(width, height, format, usage);
 }
 
 status_t BufferQueueProducer::allowAllocation(bool allow) {
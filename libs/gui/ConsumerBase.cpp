@@ -301,6 +301,15 @@ status_t ConsumerBase::getOccupancyHistory(bool forceFlush,
     return mConsumer->getOccupancyHistory(forceFlush, outHistory);
 }
 
+status_t ConsumerBase::getLatencyStats(bool reset, LatencyTracker::Stats* outStats) {
+    Mutex::Autolock _l(mMutex);
+    if (mAbandoned) {
+        CB_LOGE("getLatencyStats: ConsumerBase is abandoned!");
+        return NO_INIT;
+    }
+    return mConsumer->getLatencyStats(reset, outStats);
+}
+
 status_t ConsumerBase::discardFreeBuffers() {
     Mutex::Autolock _l(mMutex);
     if (mAbandoned) {
@@ -35,7 +35,8 @@ CpuConsumer::CpuConsumer(const sp<IGraphicBufferConsumer>& bq,
         size_t maxLockedBuffers, bool controlledByApp) :
     ConsumerBase(bq, controlledByApp),
     mMaxLockedBuffers(maxLockedBuffers),
-    mCurrentLockedBuffers(0)
+    mCurrentLockedBuffers(0),
+    mPersistentMapping(false)
 {
     // Create tracking entries for locked buffers
     mAcquiredBuffers.insertAt(0, maxLockedBuffers);
@@ -59,6 +60,16 @@ static uintptr_t getLockedBufferId(const CpuConsumer::LockedBuffer& buffer) {
     return reinterpret_cast<uintptr_t>(buffer.data);
 }
 
+// Fills in the fields of outBuffer that can change with every frame
+static void setFrameMetadata(const BufferItem& item, CpuConsumer::LockedBuffer* outBuffer) {
+    outBuffer->crop = item.mCrop;
+    outBuffer->transform = item.mTransform;
+    outBuffer->scalingMode = item.mScalingMode;
+    outBuffer->timestamp = item.mTimestamp;
+    outBuffer->dataSpace = item.mDataSpace;
+    outBuffer->frameNumber = item.mFrameNumber;
+}
+
 static bool isPossiblyYUV(PixelFormat format) {
     switch (static_cast<int>(format)) {
         case HAL_PIXEL_FORMAT_RGBA_8888:
@@ -138,13 +149,80 @@ status_t CpuConsumer::lockBufferItem(const BufferItem& item, LockedBuffer* outBu
     outBuffer->format = format;
     outBuffer->flexFormat = flexFormat;
 
-    outBuffer->crop = item.mCrop;
-    outBuffer->transform = item.mTransform;
-    outBuffer->scalingMode = item.mScalingMode;
-    outBuffer->timestamp = item.mTimestamp;
-    outBuffer->dataSpace = item.mDataSpace;
-    outBuffer->frameNumber = item.mFrameNumber;
+    setFrameMetadata(item, outBuffer);
+
+    return OK;
+}
+
+status_t CpuConsumer::lockPersistentBufferLocked(const BufferItem& item,
+        LockedBuffer* outBuffer) {
+    MappedBuffer& mapped = mMappedBuffers[item.mSlot];
+    if (mapped.mGraphicBuffer != item.mGraphicBuffer) {
+        unmapBufferLocked(item.mSlot);
+
+        // Later frames may use a different crop, so map the whole buffer
+        BufferItem mapItem(item);
+        mapItem.mCrop = item.mGraphicBuffer->getBounds();
+        status_t err = lockBufferItem(mapItem, &mapped.mLockedBuffer);
+        if (err != OK) {
+            mapped.mLockedBuffer = LockedBuffer();
+            return err;
+        }
+        mapped.mGraphicBuffer = item.mGraphicBuffer;
+        CC_LOGV("persistently mapped buffer in slot %d", item.mSlot);
+    } else if (item.mFence.get() && item.mFence->isValid()) {
+        // Nothing else waits for the producer to be done with the buffer
+        status_t err = item.mFence->waitForever("CpuConsumer::lockNextBuffer");
+        if (err != OK) {
+            CC_LOGE("Failed to wait for acquire fence: %s (%d)", strerror(-err), err);
+            return err;
+        }
+    }
 
+    *outBuffer = mapped.mLockedBuffer;
+    setFrameMetadata(item, outBuffer);
+    return OK;
+}
+
+void CpuConsumer::unmapBufferLocked(int slot) {
+    MappedBuffer& mapped = mMappedBuffers[slot];
+    if (mapped.mGraphicBuffer == nullptr) {
+        return;
+    }
+
+    size_t lockedIdx = findAcquiredBufferLocked(getLockedBufferId(mapped.mLockedBuffer));
+    if (lockedIdx < mMaxLockedBuffers) {
+        // The user is still reading it; unlockBuffer will unlock it
+        mAcquiredBuffers.editItemAt(lockedIdx).mUnlockOnRelease = true;
+    } else {
+        status_t err = mapped.mGraphicBuffer->unlock();
+        if (err != OK) {
+            CC_LOGE("%s: Unable to unlock graphic buffer in slot %d", __FUNCTION__, slot);
+        }
+    }
+
+    mapped.mGraphicBuffer.clear();
+    mapped.mLockedBuffer = LockedBuffer();
+}
+
+void CpuConsumer::freeBufferLocked(int slotIndex) {
+    unmapBufferLocked(slotIndex);
+    ConsumerBase::freeBufferLocked(slotIndex);
+}
+
+status_t CpuConsumer::setPersistentMapping(bool enabled) {
+    Mutex::Autolock _l(mMutex);
+
+    if (mCurrentLockedBuffers > 0) {
+        CC_LOGE("%s: Can't change the mapping mode while buffers are locked", __FUNCTION__);
+        return INVALID_OPERATION;
+    }
+    if (!enabled) {
+        for (int slot = 0; slot < BufferQueue::NUM_BUFFER_SLOTS; slot++) {
+            unmapBufferLocked(slot);
+        }
+    }
+    mPersistentMapping = enabled;
     return OK;
 }
 
@@ -176,7 +254,8 @@ status_t CpuConsumer::lockNextBuffer(LockedBuffer *nativeBuffer) {
         b.mGraphicBuffer = mSlots[b.mSlot].mGraphicBuffer;
     }
 
-    err = lockBufferItem(b, nativeBuffer);
+    err = mPersistentMapping ? lockPersistentBufferLocked(b, nativeBuffer)
+                             : lockBufferItem(b, nativeBuffer);
     if (err != OK) {
         return err;
     }
@@ -208,12 +287,16 @@ status_t CpuConsumer::unlockBuffer(const LockedBuffer &nativeBuffer) {
 
     AcquiredBuffer& ab = mAcquiredBuffers.editItemAt(lockedIdx);
 
+    // A persistently mapped buffer stays locked, and the CPU is done reading
+    // it by now, so there is no release fence
     int fenceFd = -1;
-    status_t err = ab.mGraphicBuffer->unlockAsync(&fenceFd);
-    if (err != OK) {
-        CC_LOGE("%s: Unable to unlock graphic buffer %zd", __FUNCTION__,
-                lockedIdx);
-        return err;
+    if (!mPersistentMapping || ab.mUnlockOnRelease) {
+        status_t err = ab.mGraphicBuffer->unlockAsync(&fenceFd);
+        if (err != OK) {
+            CC_LOGE("%s: Unable to unlock graphic buffer %zd", __FUNCTION__,
+                    lockedIdx);
+            return err;
+        }
     }
 
     sp<Fence> fence(fenceFd >= 0 ? new Fence(fenceFd) : Fence::NO_FENCE);
@@ -78,6 +78,16 @@ status_t DisplayEventReceiver::requestNextVsync() {
     return NO_INIT;
 }
 
+status_t DisplayEventReceiver::setVsyncSchedule(nsecs_t interval, nsecs_t phase) {
+    if (interval < 0)
+        return BAD_VALUE;
+
+    if (mEventConnection != NULL) {
+        return mEventConnection->setVsyncSchedule(interval, phase);
+    }
+    return NO_INIT;
+}
+
 
 ssize_t DisplayEventReceiver::getEvents(DisplayEventReceiver::Event* events,
         size_t count) {
@@ -90,6 +100,45 @@ ssize_t DisplayEventReceiver::getEvents(gui::BitTube* dataChannel,
     return gui::BitTube::recvObjects(dataChannel, events, count);
 }
 
+ssize_t DisplayEventReceiver::getLatestVsync(DisplayEventReceiver::Event* events,
+        size_t count, uint32_t* outDropped) {
+    return DisplayEventReceiver::getLatestVsync(mDataChannel.get(), events, count, outDropped);
+}
+
+ssize_t DisplayEventReceiver::getLatestVsync(gui::BitTube* dataChannel,
+        Event* events, size_t count, uint32_t* outDropped)
+{
+    // The tube is a SOCK_SEQPACKET socket, which returns one packet per read
+    // however large the buffer, and the EventThread sends one event per packet.
+    size_t n = 0;
+    ssize_t vsyncIndex = -1;
+    while (n < count) {
+        ssize_t result = gui::BitTube::recvObjects(dataChannel, events + n, 1);
+        if (result <= 0) {
+            if (n == 0) {
+                return result;
+            }
+            break;
+        }
+        if (events[n].header.type == DISPLAY_EVENT_VSYNC) {
+            if (vsyncIndex >= 0) {
+                // drop the older vsync, keeping the others in order
+                Event latest = events[n];
+                memmove(events + vsyncIndex, events + vsyncIndex + 1,
+                        (n - vsyncIndex - 1) * sizeof(Event));
+                n--;
+                events[n] = latest;
+                if (outDropped) {
+                    (*outDropped)++;
+                }
+            }
+            vsyncIndex = n;
+        }
+        n++;
+    }
+    return n;
+}
+
 ssize_t DisplayEventReceiver::sendEvents(gui::BitTube* dataChannel,
         Event const* events, size_t count)
 {
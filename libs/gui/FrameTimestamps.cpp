@@ -24,7 +24,6 @@
 #include <utils/String8.h>
 
 #include <algorithm>
-#include <limits>
 #include <numeric>
 
 namespace android {
@@ -482,6 +481,61 @@ void ConsumerFrameEventHistory::getAndResetDelta(
 // FrameEventsDelta
 // ============================================================================
 
+namespace {
+
+constexpr uint8_t DELTA_INDEX_MASK = 0x0f;
+constexpr uint8_t DELTA_POST_COMPOSITE_CALLED = 1u << 4;
+constexpr uint8_t DELTA_RELEASE_CALLED = 1u << 5;
+
+// Maps small negative and positive values to small unsigned values so they
+// stay short as varints.
+uint64_t zigzagEncode(int64_t value) {
+    return (static_cast<uint64_t>(value) << 1) ^
+            static_cast<uint64_t>(value >> 63);
+}
+
+int64_t zigzagDecode(uint64_t value) {
+    return static_cast<int64_t>(value >> 1) ^
+            -static_cast<int64_t>(value & 1);
+}
+
+size_t varintSize(uint64_t value) {
+    size_t bytes = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        bytes++;
+    }
+    return bytes;
+}
+
+void writeVarint(void*& buffer, size_t& size, uint64_t value) {
+    while (value >= 0x80) {
+        FlattenableUtils::write(buffer, size,
+                static_cast<uint8_t>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    FlattenableUtils::write(buffer, size, static_cast<uint8_t>(value));
+}
+
+bool readVarint(void const*& buffer, size_t& size, uint64_t* outValue) {
+    uint64_t value = 0;
+    for (uint32_t shift = 0; shift < 64; shift += 7) {
+        if (size < sizeof(uint8_t)) {
+            return false;
+        }
+        uint8_t byte = 0;
+        FlattenableUtils::read(buffer, size, byte);
+        value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            *outValue = value;
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
 FrameEventsDelta::FrameEventsDelta(
         size_t index,
         const FrameEvents& frameTimestamps,
@@ -510,22 +564,27 @@ FrameEventsDelta::FrameEventsDelta(
 }
 
 constexpr size_t FrameEventsDelta::minFlattenedSize() {
-    return sizeof(FrameEventsDelta::mFrameNumber) +
-            sizeof(uint16_t) + // mIndex
-            sizeof(uint8_t) + // mAddPostCompositeCalled
-            sizeof(uint8_t) + // mAddReleaseCalled
-            sizeof(FrameEventsDelta::mPostedTime) +
-            sizeof(FrameEventsDelta::mRequestedPresentTime) +
-            sizeof(FrameEventsDelta::mLatchTime) +
-            sizeof(FrameEventsDelta::mFirstRefreshStartTime) +
-            sizeof(FrameEventsDelta::mLastRefreshStartTime) +
-            sizeof(FrameEventsDelta::mDequeueReadyTime);
+    return sizeof(uint8_t) + // mIndex and the add*Called flags
+            sizeof(uint8_t) + // Mask of the valid timestamps
+            sizeof(uint8_t); // Smallest mFrameNumber varint
+}
+
+size_t FrameEventsDelta::getScalarsFlattenedSize() const {
+    size_t size = sizeof(uint8_t) + sizeof(uint8_t) + varintSize(mFrameNumber);
+    nsecs_t base = FrameEvents::isValidTimestamp(mPostedTime) ? mPostedTime : 0;
+    for (auto time : allTimes(this)) {
+        if (FrameEvents::isValidTimestamp(*time)) {
+            size += varintSize(zigzagEncode(
+                    time == &mPostedTime ? *time : *time - base));
+        }
+    }
+    return size;
 }
 
 // Flattenable implementation
 size_t FrameEventsDelta::getFlattenedSize() const {
     auto fences = allFences(this);
-    return minFlattenedSize() +
+    return getScalarsFlattenedSize() +
             std::accumulate(fences.begin(), fences.end(), size_t(0),
                     [](size_t a, const FenceTime::Snapshot* fence) {
                             return a + fence->getFlattenedSize();
@@ -547,25 +606,39 @@ status_t FrameEventsDelta::flatten(void*& buffer, size_t& size, int*& fds,
     }
 
     if (mIndex >= FrameEventHistory::MAX_FRAME_HISTORY ||
-            mIndex > std::numeric_limits<uint16_t>::max()) {
+            mIndex > DELTA_INDEX_MASK) {
         return BAD_VALUE;
     }
 
-    FlattenableUtils::write(buffer, size, mFrameNumber);
+    // Deltas go out with every queue, so the scalars are packed: the index
+    // and flags share a byte, pending timestamps are left out entirely and
+    // the rest are varints relative to the posted time.
+    uint8_t header = static_cast<uint8_t>(mIndex);
+    if (mAddPostCompositeCalled) {
+        header = static_cast<uint8_t>(header | DELTA_POST_COMPOSITE_CALLED);
+    }
+    if (mAddReleaseCalled) {
+        header = static_cast<uint8_t>(header | DELTA_RELEASE_CALLED);
+    }
+    FlattenableUtils::write(buffer, size, header);
 
-    // These are static_cast to uint16_t/uint8_t for alignment.
-    FlattenableUtils::write(buffer, size, static_cast<uint16_t>(mIndex));
-    FlattenableUtils::write(
-            buffer, size, static_cast<uint8_t>(mAddPostCompositeCalled));
-    FlattenableUtils::write(
-            buffer, size, static_cast<uint8_t>(mAddReleaseCalled));
+    auto times = allTimes(this);
+    uint8_t validTimes = 0;
+    for (size_t i = 0; i < times.size(); i++) {
+        if (FrameEvents::isValidTimestamp(*times[i])) {
+            validTimes = static_cast<uint8_t>(validTimes | (1u << i));
+        }
+    }
+    FlattenableUtils::write(buffer, size, validTimes);
 
-    FlattenableUtils::write(buffer, size, mPostedTime);
-    FlattenableUtils::write(buffer, size, mRequestedPresentTime);
-    FlattenableUtils::write(buffer, size, mLatchTime);
-    FlattenableUtils::write(buffer, size, mFirstRefreshStartTime);
-    FlattenableUtils::write(buffer, size, mLastRefreshStartTime);
-    FlattenableUtils::write(buffer, size, mDequeueReadyTime);
+    writeVarint(buffer, size, mFrameNumber);
+    nsecs_t base = FrameEvents::isValidTimestamp(mPostedTime) ? mPostedTime : 0;
+    for (auto time : times) {
+        if (FrameEvents::isValidTimestamp(*time)) {
+            writeVarint(buffer, size, zigzagEncode(
+                    time == &mPostedTime ? *time : *time - base));
+        }
+    }
 
     // Fences
     for (auto fence : allFences(this)) {
@@ -583,27 +656,40 @@ status_t FrameEventsDelta::unflatten(void const*& buffer, size_t& size,
         return NO_MEMORY;
     }
 
-    FlattenableUtils::read(buffer, size, mFrameNumber);
-
-    // These were written as uint16_t/uint8_t for alignment.
-    uint16_t temp16 = 0;
-    FlattenableUtils::read(buffer, size, temp16);
-    mIndex = temp16;
+    uint8_t header = 0;
+    FlattenableUtils::read(buffer, size, header);
+    mIndex = static_cast<size_t>(header & DELTA_INDEX_MASK);
     if (mIndex >= FrameEventHistory::MAX_FRAME_HISTORY) {
         return BAD_VALUE;
     }
-    uint8_t temp8 = 0;
-    FlattenableUtils::read(buffer, size, temp8);
-    mAddPostCompositeCalled = static_cast<bool>(temp8);
-    FlattenableUtils::read(buffer, size, temp8);
-    mAddReleaseCalled = static_cast<bool>(temp8);
-
-    FlattenableUtils::read(buffer, size, mPostedTime);
-    FlattenableUtils::read(buffer, size, mRequestedPresentTime);
-    FlattenableUtils::read(buffer, size, mLatchTime);
-    FlattenableUtils::read(buffer, size, mFirstRefreshStartTime);
-    FlattenableUtils::read(buffer, size, mLastRefreshStartTime);
-    FlattenableUtils::read(buffer, size, mDequeueReadyTime);
+    mAddPostCompositeCalled = (header & DELTA_POST_COMPOSITE_CALLED) != 0;
+    mAddReleaseCalled = (header & DELTA_RELEASE_CALLED) != 0;
+
+    uint8_t validTimes = 0;
+    FlattenableUtils::read(buffer, size, validTimes);
+
+    if (!readVarint(buffer, size, &mFrameNumber)) {
+        return NO_MEMORY;
+    }
+    auto times = allTimes(this);
+    for (size_t i = 0; i < times.size(); i++) {
+        *times[i] = FrameEvents::TIMESTAMP_PENDING;
+        if ((validTimes & (1u << i)) == 0) {
+            continue;
+        }
+        uint64_t encoded = 0;
+        if (!readVarint(buffer, size, &encoded)) {
+            return NO_MEMORY;
+        }
+        *times[i] = zigzagDecode(encoded);
+    }
+    if (FrameEvents::isValidTimestamp(mPostedTime)) {
+        for (size_t i = 1; i < times.size(); i++) {
+            if (FrameEvents::isValidTimestamp(*times[i])) {
+                *times[i] += mPostedTime;
+            }
+        }
+    }
 
     // Fences
     for (auto fence : allFences(this)) {
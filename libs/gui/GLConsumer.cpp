@@ -655,6 +655,8 @@ status_t GLConsumer::attachToContext(uint32_t tex) {
     mTexName = tex;
     mAttached = true;
 
+    createSlotImagesLocked();
+
     if (mCurrentTextureImage != NULL) {
         // This may wait for a buffer a second time. This is likely required if
         // this is a different context, since otherwise the wait could be skipped
@@ -669,6 +671,17 @@ status_t GLConsumer::attachToContext(uint32_t tex) {
     return OK;
 }
 
+void GLConsumer::createSlotImagesLocked() {
+    ATRACE_CALL();
+    for (int i = 0; i < BufferQueueDefs::NUM_BUFFER_SLOTS; i++) {
+        const sp<EglImage>& image = mEglSlots[i].mEglImage;
+        if (image != NULL && image->createIfNeeded(mEglDisplay) != NO_ERROR) {
+            // updateAndReleaseLocked tries again when the buffer is acquired
+            GLC_LOGW("createSlotImagesLocked: can't create image on "
+                    "display=%p slot=%d", mEglDisplay, i);
+        }
+    }
+}
 
 status_t GLConsumer::syncForReleaseLocked(EGLDisplay dpy) {
     GLC_LOGV("syncForReleaseLocked");
@@ -1079,10 +1092,17 @@ GLConsumer::EglImage::~EglImage() {
 status_t GLConsumer::EglImage::createIfNeeded(EGLDisplay eglDisplay,
                                               const Rect& cropRect,
                                               bool forceCreation) {
+    // Crops EGL can't apply are left to the texture transform, so changing
+    // one of them doesn't need a new image.
+    Rect imageCropRect = Rect::INVALID_RECT;
+    if (cropRect.isValid() && isEglImageCroppable(cropRect)) {
+        imageCropRect = cropRect;
+    }
+
     // If there's an image and it's no longer valid, destroy it.
     bool haveImage = mEglImage != EGL_NO_IMAGE_KHR;
     bool displayInvalid = mEglDisplay != eglDisplay;
-    bool cropInvalid = hasEglAndroidImageCrop() && mCropRect != cropRect;
+    bool cropInvalid = mCropRect != imageCropRect;
     if (haveImage && (displayInvalid || cropInvalid || forceCreation)) {
         if (!eglDestroyImageKHR(mEglDisplay, mEglImage)) {
            ALOGE("createIfNeeded: eglDestroyImageKHR failed");
@@ -1095,7 +1115,7 @@ status_t GLConsumer::EglImage::createIfNeeded(EGLDisplay eglDisplay,
     // If there's no image, create one.
     if (mEglImage == EGL_NO_IMAGE_KHR) {
         mEglDisplay = eglDisplay;
-        mCropRect = cropRect;
+        mCropRect = imageCropRect;
         mEglImage = createImage(mEglDisplay, mGraphicBuffer, mCropRect);
     }
 
@@ -26,7 +26,8 @@ enum class Tag : uint32_t {
     STEAL_RECEIVE_CHANNEL = IBinder::FIRST_CALL_TRANSACTION,
     SET_VSYNC_RATE,
     REQUEST_NEXT_VSYNC,
-    LAST = REQUEST_NEXT_VSYNC,
+    SET_VSYNC_SCHEDULE,
+    LAST = SET_VSYNC_SCHEDULE,
 };
 
 } // Anonymous namespace
@@ -53,6 +54,12 @@ public:
         callRemoteAsync<decltype(&IDisplayEventConnection::requestNextVsync)>(
                 Tag::REQUEST_NEXT_VSYNC);
     }
+
+    status_t setVsyncSchedule(nsecs_t interval, nsecs_t phase) override {
+        return callRemote<decltype(
+                &IDisplayEventConnection::setVsyncSchedule)>(Tag::SET_VSYNC_SCHEDULE, interval,
+                                                             phase);
+    }
 };
 
 // Out-of-line virtual method definition to trigger vtable emission in this translation unit (see
@@ -74,6 +81,8 @@ status_t BnDisplayEventConnection::onTransact(uint32_t code, const Parcel& data,
             return callLocal(data, reply, &IDisplayEventConnection::setVsyncRate);
         case Tag::REQUEST_NEXT_VSYNC:
             return callLocalAsync(data, reply, &IDisplayEventConnection::requestNextVsync);
+        case Tag::SET_VSYNC_SCHEDULE:
+            return callLocal(data, reply, &IDisplayEventConnection::setVsyncSchedule);
     }
 }
 
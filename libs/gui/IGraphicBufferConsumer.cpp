@@ -52,7 +52,10 @@ enum class Tag : uint32_t {
     GET_OCCUPANCY_HISTORY,
     DISCARD_FREE_BUFFERS,
     DUMP_STATE,
-    LAST = DUMP_STATE,
+    SET_ADAPTIVE_BUFFER_COUNT,
+    SET_BUFFER_PREALLOCATION,
+    GET_LATENCY_STATS,
+    LAST = GET_LATENCY_STATS,
 };
 
 } // Anonymous namespace
@@ -167,6 +170,21 @@ public:
         using Signature = status_t (IGraphicBufferConsumer::*)(const String8&, String8*) const;
         return callRemote<Signature>(Tag::DUMP_STATE, prefix, outResult);
     }
+
+    status_t setAdaptiveBufferCount(bool enabled) override {
+        using Signature = decltype(&IGraphicBufferConsumer::setAdaptiveBufferCount);
+        return callRemote<Signature>(Tag::SET_ADAPTIVE_BUFFER_COUNT, enabled);
+    }
+
+    status_t setBufferPreallocation(bool enabled) override {
+        using Signature = decltype(&IGraphicBufferConsumer::setBufferPreallocation);
+        return callRemote<Signature>(Tag::SET_BUFFER_PREALLOCATION, enabled);
+    }
+
+    status_t getLatencyStats(bool reset, LatencyTracker::Stats* outStats) override {
+        using Signature = decltype(&IGraphicBufferConsumer::getLatencyStats);
+        return callRemote<Signature>(Tag::GET_LATENCY_STATS, reset, outStats);
+    }
 };
 
 // Out-of-line virtual method definition to trigger vtable emission in this translation unit
@@ -224,6 +242,12 @@ status_t BnGraphicBufferConsumer::onTransact(uint32_t code, const Parcel& data,
             using Signature = status_t (IGraphicBufferConsumer::*)(const String8&, String8*) const;
             return callLocal<Signature>(data, reply, &IGraphicBufferConsumer::dumpState);
         }
+        case Tag::SET_ADAPTIVE_BUFFER_COUNT:
+            return callLocal(data, reply, &IGraphicBufferConsumer::setAdaptiveBufferCount);
+        case Tag::SET_BUFFER_PREALLOCATION:
+            return callLocal(data, reply, &IGraphicBufferConsumer::setBufferPreallocation);
+        case Tag::GET_LATENCY_STATS:
+            return callLocal(data, reply, &IGraphicBufferConsumer::getLatencyStats);
     }
 }
 
@@ -67,6 +67,8 @@ enum {
     GET_FRAME_TIMESTAMPS,
     GET_UNIQUE_ID,
     GET_CONSUMER_USAGE,
+    DEQUEUE_BUFFERS,
+    QUEUE_BUFFERS,
 };
 
 class BpGraphicBufferProducer : public BpInterface<IGraphicBufferProducer>
@@ -527,6 +529,111 @@ public:
         }
         return actualResult;
     }
+
+    virtual status_t dequeueBuffers(const std::vector<DequeueBufferInput>& inputs,
+                                    std::vector<DequeueBufferOutput>* outputs) {
+        if (inputs.size() > static_cast<size_t>(BufferQueueDefs::NUM_BUFFER_SLOTS)) {
+            return BAD_VALUE;
+        }
+        Parcel data, reply;
+        data.writeInterfaceToken(IGraphicBufferProducer::getInterfaceDescriptor());
+        data.writeUint32(static_cast<uint32_t>(inputs.size()));
+        for (const auto& input : inputs) {
+            data.writeUint32(input.width);
+            data.writeUint32(input.height);
+            data.writeInt32(static_cast<int32_t>(input.format));
+            data.writeUint64(input.usage);
+            data.writeBool(input.getTimestamps);
+        }
+
+        status_t result = remote()->transact(DEQUEUE_BUFFERS, data, &reply);
+        if (result != NO_ERROR) {
+            return result;
+        }
+
+        uint32_t count = 0;
+        result = reply.readUint32(&count);
+        if (result != NO_ERROR) {
+            return result;
+        }
+        if (count > inputs.size()) {
+            ALOGE("IGBP::dequeueBuffers returned %u outputs for %zu inputs", count,
+                  inputs.size());
+            return UNKNOWN_ERROR;
+        }
+        outputs->clear();
+        outputs->resize(count);
+        for (uint32_t i = 0; i < count; i++) {
+            DequeueBufferOutput& output = (*outputs)[i];
+            output.slot = reply.readInt32();
+            output.fence = new Fence();
+            result = reply.read(*output.fence);
+            if (result != NO_ERROR) {
+                outputs->clear();
+                return result;
+            }
+            result = reply.readUint64(&output.bufferAge);
+            if (result != NO_ERROR) {
+                ALOGE("IGBP::dequeueBuffers failed to read buffer age: %d", result);
+                outputs->clear();
+                return result;
+            }
+            if (inputs[i].getTimestamps) {
+                result = reply.read(output.timestamps);
+                if (result != NO_ERROR) {
+                    ALOGE("IGBP::dequeueBuffers failed to read timestamps: %d", result);
+                    outputs->clear();
+                    return result;
+                }
+            }
+            output.result = reply.readInt32();
+        }
+        return reply.readInt32();
+    }
+
+    virtual status_t queueBuffers(const std::vector<QueuedBuffer>& buffers,
+                                  std::vector<QueueBufferOutput>* outputs,
+                                  std::vector<status_t>* results) {
+        if (buffers.size() > static_cast<size_t>(BufferQueueDefs::NUM_BUFFER_SLOTS)) {
+            return BAD_VALUE;
+        }
+        Parcel data, reply;
+        data.writeInterfaceToken(IGraphicBufferProducer::getInterfaceDescriptor());
+        data.writeUint32(static_cast<uint32_t>(buffers.size()));
+        for (const auto& buffer : buffers) {
+            data.writeInt32(buffer.slot);
+            data.write(buffer.input);
+        }
+
+        status_t result = remote()->transact(QUEUE_BUFFERS, data, &reply);
+        if (result != NO_ERROR) {
+            return result;
+        }
+
+        uint32_t count = 0;
+        result = reply.readUint32(&count);
+        if (result != NO_ERROR) {
+            return result;
+        }
+        if (count != buffers.size()) {
+            ALOGE("IGBP::queueBuffers returned %u outputs for %zu buffers", count,
+                  buffers.size());
+            return UNKNOWN_ERROR;
+        }
+        outputs->clear();
+        outputs->resize(count);
+        results->assign(count, NO_ERROR);
+        for (uint32_t i = 0; i < count; i++) {
+            result = reply.read((*outputs)[i]);
+            if (result != NO_ERROR) {
+                outputs->clear();
+                results->clear();
+                return result;
+            }
+            (*results)[i] = reply.readInt32();
+        }
+        return reply.readInt32();
+    }
 };
 
 // Out-of-line virtual method definition to trigger vtable emission in this
@@ -649,6 +756,17 @@ public:
     status_t getConsumerUsage(uint64_t* outUsage) const override {
         return mBase->getConsumerUsage(outUsage);
     }
+
+    status_t dequeueBuffers(const std::vector<DequeueBufferInput>& inputs,
+                            std::vector<DequeueBufferOutput>* outputs) override {
+        return mBase->dequeueBuffers(inputs, outputs);
+    }
+
+    status_t queueBuffers(const std::vector<QueuedBuffer>& buffers,
+                          std::vector<QueueBufferOutput>* outputs,
+                          std::vector<status_t>* results) override {
+        return mBase->queueBuffers(buffers, outputs, results);
+    }
 };
 
 IMPLEMENT_HYBRID_META_INTERFACE(GraphicBufferProducer, HGraphicBufferProducer,
@@ -656,6 +774,35 @@ IMPLEMENT_HYBRID_META_INTERFACE(GraphicBufferProducer, HGraphicBufferProducer,
 
 // ----------------------------------------------------------------------
 
+status_t IGraphicBufferProducer::dequeueBuffers(const std::vector<DequeueBufferInput>& inputs,
+                                                std::vector<DequeueBufferOutput>* outputs) {
+    outputs->clear();
+    outputs->reserve(inputs.size());
+    for (const auto& input : inputs) {
+        outputs->emplace_back();
+        DequeueBufferOutput& output = outputs->back();
+        output.result = dequeueBuffer(&output.slot, &output.fence, input.width, input.height,
+                                      input.format, input.usage, &output.bufferAge,
+                                      input.getTimestamps ? &output.timestamps : nullptr);
+        if (output.result < 0) {
+            break;
+        }
+    }
+    return NO_ERROR;
+}
+
+status_t IGraphicBufferProducer::queueBuffers(const std::vector<QueuedBuffer>& buffers,
+                                              std::vector<QueueBufferOutput>* outputs,
+                                              std::vector<status_t>* results) {
+    outputs->clear();
+    outputs->resize(buffers.size());
+    results->assign(buffers.size(), NO_ERROR);
+    for (size_t i = 0; i < buffers.size(); i++) {
+        (*results)[i] = queueBuffer(buffers[i].slot, buffers[i].input, &(*outputs)[i]);
+    }
+    return NO_ERROR;
+}
+
 status_t IGraphicBufferProducer::exportToParcel(Parcel* parcel) {
     status_t res = OK;
     res = parcel->writeUint32(USE_BUFFER_QUEUE);
@@ -1003,6 +1150,67 @@ status_t BnGraphicBufferProducer::onTransact(
             }
             return NO_ERROR;
         }
+        case DEQUEUE_BUFFERS: {
+            CHECK_INTERFACE(IGraphicBufferProducer, data, reply);
+            uint32_t count = data.readUint32();
+            if (count > static_cast<uint32_t>(BufferQueueDefs::NUM_BUFFER_SLOTS)) {
+                reply->writeUint32(0);
+                reply->writeInt32(BAD_VALUE);
+                return NO_ERROR;
+            }
+            std::vector<DequeueBufferInput> inputs(count);
+            for (auto& input : inputs) {
+                input.width = data.readUint32();
+                input.height = data.readUint32();
+                input.format = static_cast<PixelFormat>(data.readInt32());
+                input.usage = data.readUint64();
+                input.getTimestamps = data.readBool();
+            }
+
+            std::vector<DequeueBufferOutput> outputs;
+            status_t result = dequeueBuffers(inputs, &outputs);
+
+            reply->writeUint32(static_cast<uint32_t>(outputs.size()));
+            for (size_t i = 0; i < outputs.size(); i++) {
+                const DequeueBufferOutput& output = outputs[i];
+                reply->writeInt32(output.slot);
+                reply->write(*output.fence);
+                reply->writeUint64(output.bufferAge);
+                if (inputs[i].getTimestamps) {
+                    reply->write(output.timestamps);
+                }
+                reply->writeInt32(output.result);
+            }
+            reply->writeInt32(result);
+            return NO_ERROR;
+        }
+        case QUEUE_BUFFERS: {
+            CHECK_INTERFACE(IGraphicBufferProducer, data, reply);
+            uint32_t count = data.readUint32();
+            if (count > static_cast<uint32_t>(BufferQueueDefs::NUM_BUFFER_SLOTS)) {
+                reply->writeUint32(0);
+                reply->writeInt32(BAD_VALUE);
+                return NO_ERROR;
+            }
+            std::vector<QueuedBuffer> buffers;
+            buffers.reserve(count);
+            for (uint32_t i = 0; i < count; i++) {
+                int slot = data.readInt32();
+                buffers.push_back({slot, QueueBufferInput(data)});
+            }
+
+            std::vector<QueueBufferOutput> outputs;
+            std::vector<status_t> results;
+            status_t result = queueBuffers(buffers, &outputs, &results);
+
+            reply->writeUint32(static_cast<uint32_t>(outputs.size()));
+            for (size_t i = 0; i < outputs.size(); i++) {
+                reply->write(outputs[i]);
+                reply->writeInt32(results[i]);
+            }
+            reply->writeInt32(result);
+            return NO_ERROR;
+        }
     }
     return BBinder::onTransact(code, data, reply, flags);
 }
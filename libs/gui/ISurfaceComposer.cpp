@@ -116,6 +116,7 @@ public:
         data.writeInt32(maxLayerZ);
         data.writeInt32(static_cast<int32_t>(useIdentityTransform));
         data.writeInt32(static_cast<int32_t>(rotation));
+        writeCaptureBuffer(data, *outBuffer);
         status_t err = remote()->transact(BnSurfaceComposer::CAPTURE_SCREEN, data, &reply);
 
         if (err != NO_ERROR) {
@@ -127,8 +128,7 @@ public:
             return err;
         }
 
-        *outBuffer = new GraphicBuffer();
-        reply.read(**outBuffer);
+        readCaptureBuffer(reply, outBuffer);
         return err;
     }
 
@@ -141,6 +141,7 @@ public:
         data.write(sourceCrop);
         data.writeFloat(frameScale);
         data.writeBool(childrenOnly);
+        writeCaptureBuffer(data, *outBuffer);
         status_t err = remote()->transact(BnSurfaceComposer::CAPTURE_LAYERS, data, &reply);
 
         if (err != NO_ERROR) {
@@ -152,12 +153,26 @@ public:
             return err;
         }
 
-        *outBuffer = new GraphicBuffer();
-        reply.read(**outBuffer);
-
+        readCaptureBuffer(reply, outBuffer);
         return err;
     }
 
+    // Sends the buffer the caller wants the capture rendered into, if any
+    static void writeCaptureBuffer(Parcel& data, const sp<GraphicBuffer>& buffer) {
+        data.writeBool(buffer != nullptr);
+        if (buffer != nullptr) {
+            data.write(*buffer);
+        }
+    }
+
+    // Keeps the caller's buffer if the capture was rendered into it
+    static void readCaptureBuffer(const Parcel& reply, sp<GraphicBuffer>* outBuffer) {
+        if (!reply.readBool()) {
+            *outBuffer = new GraphicBuffer();
+            reply.read(**outBuffer);
+        }
+    }
+
     virtual bool authenticateSurfaceTexture(
             const sp<IGraphicBufferProducer>& bufferProducer) const
     {
@@ -573,6 +588,28 @@ IMPLEMENT_META_INTERFACE(SurfaceComposer, "android.ui.ISurfaceComposer");
 
 // ----------------------------------------------------------------------
 
+static sp<GraphicBuffer> readClientCaptureBuffer(const Parcel& data) {
+    if (!data.readBool()) {
+        return nullptr;
+    }
+    sp<GraphicBuffer> buffer = new GraphicBuffer();
+    if (data.read(*buffer) != NO_ERROR) {
+        // let SurfaceFlinger allocate one instead
+        return nullptr;
+    }
+    return buffer;
+}
+
+static void writeCaptureResult(Parcel* reply, const sp<GraphicBuffer>& inBuffer,
+                               const sp<GraphicBuffer>& outBuffer) {
+    // the client already has the buffer it provided, don't send it back
+    const bool rendered = inBuffer != nullptr && outBuffer == inBuffer;
+    reply->writeBool(rendered);
+    if (!rendered) {
+        reply->write(*outBuffer);
+    }
+}
+
 status_t BnSurfaceComposer::onTransact(
     uint32_t code, const Parcel& data, Parcel* reply, uint32_t flags)
 {
@@ -643,13 +680,15 @@ status_t BnSurfaceComposer::onTransact(
             int32_t maxLayerZ = data.readInt32();
             bool useIdentityTransform = static_cast<bool>(data.readInt32());
             int32_t rotation = data.readInt32();
+            const sp<GraphicBuffer> inBuffer = readClientCaptureBuffer(data);
+            outBuffer = inBuffer;
 
             status_t res = captureScreen(display, &outBuffer, sourceCrop, reqWidth, reqHeight,
                                          minLayerZ, maxLayerZ, useIdentityTransform,
                                          static_cast<ISurfaceComposer::Rotation>(rotation));
             reply->writeInt32(res);
             if (res == NO_ERROR) {
-                reply->write(*outBuffer);
+                writeCaptureResult(reply, inBuffer, outBuffer);
             }
             return NO_ERROR;
         }
@@ -661,12 +700,14 @@ status_t BnSurfaceComposer::onTransact(
             data.read(sourceCrop);
             float frameScale = data.readFloat();
             bool childrenOnly = data.readBool();
+            const sp<GraphicBuffer> inBuffer = readClientCaptureBuffer(data);
+            outBuffer = inBuffer;
 
             status_t res = captureLayers(layerHandleBinder, &outBuffer, sourceCrop, frameScale,
                                          childrenOnly);
             reply->writeInt32(res);
             if (res == NO_ERROR) {
-                reply->write(*outBuffer);
+                writeCaptureResult(reply, inBuffer, outBuffer);
             }
             return NO_ERROR;
         }
@@ -25,6 +25,8 @@
 
 #include <ui/FrameStats.h>
 
+#include <utils/NativeHandle.h>
+
 namespace android {
 
 namespace { // Anonymous
@@ -34,7 +36,9 @@ enum class Tag : uint32_t {
     DESTROY_SURFACE,
     CLEAR_LAYER_FRAME_STATS,
     GET_LAYER_FRAME_STATS,
-    LAST = GET_LAYER_FRAME_STATS,
+    CREATE_TRANSACTION_CHANNEL,
+    GET_LAYER_CHANNEL_ID,
+    LAST = GET_LAYER_CHANNEL_ID,
 };
 
 } // Anonymous namespace
@@ -73,6 +77,17 @@ public:
                 &ISurfaceComposerClient::getLayerFrameStats)>(Tag::GET_LAYER_FRAME_STATS, handle,
                                                               outStats);
     }
+
+    status_t createTransactionChannel(sp<NativeHandle>* outHandle) override {
+        return callRemote<decltype(&ISurfaceComposerClient::createTransactionChannel)>(
+                Tag::CREATE_TRANSACTION_CHANNEL, outHandle);
+    }
+
+    status_t getLayerChannelId(const sp<IBinder>& handle, int32_t* outId) const override {
+        return callRemote<decltype(
+                &ISurfaceComposerClient::getLayerChannelId)>(Tag::GET_LAYER_CHANNEL_ID, handle,
+                                                             outId);
+    }
 };
 
 // Out-of-line virtual method definition to trigger vtable emission in this
@@ -98,6 +113,10 @@ status_t BnSurfaceComposerClient::onTransact(uint32_t code, const Parcel& data,
             return callLocal(data, reply, &ISurfaceComposerClient::clearLayerFrameStats);
         case Tag::GET_LAYER_FRAME_STATS:
             return callLocal(data, reply, &ISurfaceComposerClient::getLayerFrameStats);
+        case Tag::CREATE_TRANSACTION_CHANNEL:
+            return callLocal(data, reply, &ISurfaceComposerClient::createTransactionChannel);
+        case Tag::GET_LAYER_CHANNEL_ID:
+            return callLocal(data, reply, &ISurfaceComposerClient::getLayerChannelId);
     }
 }
 
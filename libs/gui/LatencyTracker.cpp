@@ -0,0 +1,105 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#undef LOG_TAG
+#define LOG_TAG "LatencyTracker"
+
+#include <gui/LatencyTracker.h>
+#include <binder/Parcel.h>
+#include <utils/String8.h>
+
+#include <inttypes.h>
+
+#include <algorithm>
+
+namespace android {
+
+static status_t writeStat(Parcel* parcel, const LatencyTracker::Stat& stat) {
+    status_t result = parcel->writeUint64(stat.count);
+    if (result != OK) {
+        return result;
+    }
+    result = parcel->writeInt64(stat.totalTime);
+    if (result != OK) {
+        return result;
+    }
+    return parcel->writeInt64(stat.maxTime);
+}
+
+static status_t readStat(const Parcel* parcel, LatencyTracker::Stat* stat) {
+    status_t result = parcel->readUint64(&stat->count);
+    if (result != OK) {
+        return result;
+    }
+    result = parcel->readInt64(&stat->totalTime);
+    if (result != OK) {
+        return result;
+    }
+    return parcel->readInt64(&stat->maxTime);
+}
+
+static void dumpStat(const char* name, const LatencyTracker::Stat& stat, String8* outResult) {
+    outResult->appendFormat(" %s=[count=%" PRIu64 " avg=%.3fms max=%.3fms]", name, stat.count,
+                            stat.averageTime() / 1e6, stat.maxTime / 1e6);
+}
+
+void LatencyTracker::Stat::add(nsecs_t duration) {
+    count++;
+    totalTime += duration;
+    maxTime = std::max(maxTime, duration);
+}
+
+status_t LatencyTracker::Stats::writeToParcel(Parcel* parcel) const {
+    status_t result = writeStat(parcel, dequeueWait);
+    if (result != OK) {
+        return result;
+    }
+    result = writeStat(parcel, queueResidency);
+    if (result != OK) {
+        return result;
+    }
+    return writeStat(parcel, acquireToRelease);
+}
+
+status_t LatencyTracker::Stats::readFromParcel(const Parcel* parcel) {
+    status_t result = readStat(parcel, &dequeueWait);
+    if (result != OK) {
+        return result;
+    }
+    result = readStat(parcel, &queueResidency);
+    if (result != OK) {
+        return result;
+    }
+    return readStat(parcel, &acquireToRelease);
+}
+
+LatencyTracker::Stats LatencyTracker::getStats(bool reset) {
+    Stats stats = mStats;
+    if (reset) {
+        mStats = Stats();
+    }
+    return stats;
+}
+
+void LatencyTracker::dump(const String8& prefix, String8* outResult) const {
+    outResult->appendFormat("%s  latency:", prefix.string());
+    dumpStat("dequeue-wait", mStats.dequeueWait, outResult);
+    dumpStat("queued", mStats.queueResidency, outResult);
+    dumpStat("acquired", mStats.acquireToRelease, outResult);
+    outResult->append("\n");
+}
+
+} // namespace android
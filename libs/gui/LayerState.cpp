@@ -22,34 +22,68 @@
 
 namespace android {
 
+// Only the fields flagged in what are parceled, since most transactions change just a few of
+// them. read() must consume them in the same order.
 status_t layer_state_t::write(Parcel& output) const
 {
     output.writeStrongBinder(surface);
     output.writeUint32(what);
-    output.writeFloat(x);
-    output.writeFloat(y);
-    output.writeInt32(z);
-    output.writeUint32(w);
-    output.writeUint32(h);
-    output.writeUint32(layerStack);
-    output.writeFloat(alpha);
-    output.writeUint32(flags);
-    output.writeUint32(mask);
-    *reinterpret_cast<layer_state_t::matrix22_t *>(
-            output.writeInplace(sizeof(layer_state_t::matrix22_t))) = matrix;
-    output.write(crop);
-    output.write(finalCrop);
-    output.writeStrongBinder(barrierHandle);
-    output.writeStrongBinder(reparentHandle);
-    output.writeUint64(frameNumber);
-    output.writeInt32(overrideScalingMode);
-    output.writeStrongBinder(IInterface::asBinder(barrierGbp));
-    output.writeStrongBinder(relativeLayerHandle);
-    output.writeStrongBinder(parentHandleForChild);
-    output.writeFloat(color.r);
-    output.writeFloat(color.g);
-    output.writeFloat(color.b);
-    output.write(transparentRegion);
+    if (what & ePositionChanged) {
+        output.writeFloat(x);
+        output.writeFloat(y);
+    }
+    if (what & (eLayerChanged | eRelativeLayerChanged)) {
+        output.writeInt32(z);
+    }
+    if (what & eSizeChanged) {
+        output.writeUint32(w);
+        output.writeUint32(h);
+    }
+    if (what & eLayerStackChanged) {
+        output.writeUint32(layerStack);
+    }
+    if (what & eAlphaChanged) {
+        output.writeFloat(alpha);
+    }
+    if (what & eFlagsChanged) {
+        output.writeUint32(flags);
+        output.writeUint32(mask);
+    }
+    if (what & eMatrixChanged) {
+        *reinterpret_cast<layer_state_t::matrix22_t *>(
+                output.writeInplace(sizeof(layer_state_t::matrix22_t))) = matrix;
+    }
+    if (what & eCropChanged) {
+        output.write(crop);
+    }
+    if (what & eFinalCropChanged) {
+        output.write(finalCrop);
+    }
+    if (what & eDeferTransaction) {
+        output.writeStrongBinder(barrierHandle);
+        output.writeStrongBinder(IInterface::asBinder(barrierGbp));
+        output.writeUint64(frameNumber);
+    }
+    if (what & eReparentChildren) {
+        output.writeStrongBinder(reparentHandle);
+    }
+    if (what & eOverrideScalingModeChanged) {
+        output.writeInt32(overrideScalingMode);
+    }
+    if (what & eRelativeLayerChanged) {
+        output.writeStrongBinder(relativeLayerHandle);
+    }
+    if (what & eReparent) {
+        output.writeStrongBinder(parentHandleForChild);
+    }
+    if (what & eColorChanged) {
+        output.writeFloat(color.r);
+        output.writeFloat(color.g);
+        output.writeFloat(color.b);
+    }
+    if (what & eTransparentRegionChanged) {
+        output.write(transparentRegion);
+    }
     return NO_ERROR;
 }
 
@@ -57,35 +91,67 @@ status_t layer_state_t::read(const Parcel& input)
 {
     surface = input.readStrongBinder();
     what = input.readUint32();
-    x = input.readFloat();
-    y = input.readFloat();
-    z = input.readInt32();
-    w = input.readUint32();
-    h = input.readUint32();
-    layerStack = input.readUint32();
-    alpha = input.readFloat();
-    flags = static_cast<uint8_t>(input.readUint32());
-    mask = static_cast<uint8_t>(input.readUint32());
-    const void* matrix_data = input.readInplace(sizeof(layer_state_t::matrix22_t));
-    if (matrix_data) {
-        matrix = *reinterpret_cast<layer_state_t::matrix22_t const *>(matrix_data);
-    } else {
-        return BAD_VALUE;
-    }
-    input.read(crop);
-    input.read(finalCrop);
-    barrierHandle = input.readStrongBinder();
-    reparentHandle = input.readStrongBinder();
-    frameNumber = input.readUint64();
-    overrideScalingMode = input.readInt32();
-    barrierGbp =
-        interface_cast<IGraphicBufferProducer>(input.readStrongBinder());
-    relativeLayerHandle = input.readStrongBinder();
-    parentHandleForChild = input.readStrongBinder();
-    color.r = input.readFloat();
-    color.g = input.readFloat();
-    color.b = input.readFloat();
-    input.read(transparentRegion);
+    if (what & ePositionChanged) {
+        x = input.readFloat();
+        y = input.readFloat();
+    }
+    if (what & (eLayerChanged | eRelativeLayerChanged)) {
+        z = input.readInt32();
+    }
+    if (what & eSizeChanged) {
+        w = input.readUint32();
+        h = input.readUint32();
+    }
+    if (what & eLayerStackChanged) {
+        layerStack = input.readUint32();
+    }
+    if (what & eAlphaChanged) {
+        alpha = input.readFloat();
+    }
+    if (what & eFlagsChanged) {
+        flags = static_cast<uint8_t>(input.readUint32());
+        mask = static_cast<uint8_t>(input.readUint32());
+    }
+    if (what & eMatrixChanged) {
+        const void* matrix_data = input.readInplace(sizeof(layer_state_t::matrix22_t));
+        if (matrix_data) {
+            matrix = *reinterpret_cast<layer_state_t::matrix22_t const *>(matrix_data);
+        } else {
+            return BAD_VALUE;
+        }
+    }
+    if (what & eCropChanged) {
+        input.read(crop);
+    }
+    if (what & eFinalCropChanged) {
+        input.read(finalCrop);
+    }
+    if (what & eDeferTransaction) {
+        barrierHandle = input.readStrongBinder();
+        barrierGbp =
+            interface_cast<IGraphicBufferProducer>(input.readStrongBinder());
+        frameNumber = input.readUint64();
+    }
+    if (what & eReparentChildren) {
+        reparentHandle = input.readStrongBinder();
+    }
+    if (what & eOverrideScalingModeChanged) {
+        overrideScalingMode = input.readInt32();
+    }
+    if (what & eRelativeLayerChanged) {
+        relativeLayerHandle = input.readStrongBinder();
+    }
+    if (what & eReparent) {
+        parentHandleForChild = input.readStrongBinder();
+    }
+    if (what & eColorChanged) {
+        color.r = input.readFloat();
+        color.g = input.readFloat();
+        color.b = input.readFloat();
+    }
+    if (what & eTransparentRegionChanged) {
+        input.read(transparentRegion);
+    }
     return NO_ERROR;
 }
 
@@ -231,6 +297,10 @@ void layer_state_t::merge(const layer_state_t& other) {
         what |= eReparent;
         parentHandleForChild = other.parentHandleForChild;
     }
+    if (other.what & eColorChanged) {
+        what |= eColorChanged;
+        color = other.color;
+    }
     if (other.what & eDestroySurface) {
         what |= eDestroySurface;
     }
@@ -76,6 +76,10 @@ void OccupancyTracker::registerOccupancyChange(size_t occupancy) {
     }
     if (occupancy > mLastOccupancy) {
         ++mPendingSegment.numFrames;
+        ++mFramesWithoutThirdBuffer;
+    }
+    if (occupancy > 1) {
+        mFramesWithoutThirdBuffer = 0;
     }
     mLastOccupancyChangeTime = now;
     mLastOccupancy = occupancy;
@@ -33,6 +33,8 @@
 
 #include <system/window.h>
 
+#include <algorithm>
+
 namespace android {
 
 status_t StreamSplitter::createSplitter(
@@ -58,13 +60,13 @@ status_t StreamSplitter::createSplitter(
 
 StreamSplitter::StreamSplitter(const sp<IGraphicBufferConsumer>& inputQueue)
       : mIsAbandoned(false), mMutex(), mReleaseCondition(),
-        mOutstandingBuffers(0), mInput(inputQueue), mOutputs(), mBuffers() {}
+        mOutstandingBuffers(0), mInput(inputQueue), mOutputs(),
+        mMaxOutstandingBuffers(MAX_OUTSTANDING_BUFFERS), mBuffers() {}
 
 StreamSplitter::~StreamSplitter() {
     mInput->consumerDisconnect();
-    Vector<sp<IGraphicBufferProducer> >::iterator output = mOutputs.begin();
-    for (; output != mOutputs.end(); ++output) {
-        (*output)->disconnect(NATIVE_WINDOW_API_CPU);
+    for (const Output& output : mOutputs) {
+        output.producer->disconnect(NATIVE_WINDOW_API_CPU);
     }
 
     if (mBuffers.size() > 0) {
@@ -74,13 +76,32 @@ StreamSplitter::~StreamSplitter() {
 
 status_t StreamSplitter::addOutput(
         const sp<IGraphicBufferProducer>& outputQueue) {
+    return addOutput(outputQueue, SlowOutputPolicy::THROTTLE,
+            MAX_OUTSTANDING_BUFFERS);
+}
+
+status_t StreamSplitter::addOutput(
+        const sp<IGraphicBufferProducer>& outputQueue,
+        SlowOutputPolicy policy, size_t maxQueueDepth) {
     if (outputQueue == NULL) {
         ALOGE("addOutput: outputQueue must not be NULL");
         return BAD_VALUE;
     }
+    if (maxQueueDepth < 1) {
+        ALOGE("addOutput: maxQueueDepth must be at least 1");
+        return BAD_VALUE;
+    }
 
     Mutex::Autolock lock(mMutex);
 
+    if (policy == SlowOutputPolicy::DROP_FRAMES) {
+        status_t status = outputQueue->setAsyncMode(true);
+        if (status != NO_ERROR) {
+            ALOGE("addOutput: failed to set async mode (%d)", status);
+            return status;
+        }
+    }
+
     IGraphicBufferProducer::QueueBufferOutput queueBufferOutput;
     sp<OutputListener> listener(new OutputListener(this, outputQueue));
     IInterface::asBinder(outputQueue)->linkToDeath(listener);
@@ -91,7 +112,20 @@ status_t StreamSplitter::addOutput(
         return status;
     }
 
-    mOutputs.push_back(outputQueue);
+    mOutputs.push_back(Output{outputQueue, policy, maxQueueDepth, 0});
+
+    // Outputs that drop frames each hold their own buffers on top of those
+    // shared by the throttling outputs
+    size_t maxThrottleDepth = 0;
+    size_t dropFramesDepth = 0;
+    for (const Output& output : mOutputs) {
+        if (output.policy == SlowOutputPolicy::THROTTLE) {
+            maxThrottleDepth = std::max(maxThrottleDepth, output.maxQueueDepth);
+        } else {
+            dropFramesDepth += output.maxQueueDepth;
+        }
+    }
+    mMaxOutstandingBuffers = maxThrottleDepth + dropFramesDepth;
 
     return NO_ERROR;
 }
@@ -105,14 +139,15 @@ void StreamSplitter::onFrameAvailable(const BufferItem& /* item */) {
     ATRACE_CALL();
     Mutex::Autolock lock(mMutex);
 
-    // The current policy is that if any one consumer is consuming buffers too
+    // If any output using SlowOutputPolicy::THROTTLE is consuming buffers too
     // slowly, the splitter will stall the rest of the outputs by not acquiring
     // any more buffers from the input. This will cause back pressure on the
-    // input queue, slowing down its producer.
+    // input queue, slowing down its producer. Outputs using
+    // SlowOutputPolicy::DROP_FRAMES never cause this.
 
     // If there are too many outstanding buffers, we block until a buffer is
-    // released back to the input in onBufferReleased
-    while (mOutstandingBuffers >= MAX_OUTSTANDING_BUFFERS) {
+    // released in onBufferReleased
+    while (isThrottledLocked()) {
         mReleaseCondition.wait(mMutex);
 
         // If the splitter is abandoned while we are waiting, the release
@@ -139,8 +174,8 @@ void StreamSplitter::onFrameAvailable(const BufferItem& /* item */) {
             "detaching buffer from input failed (%d)", status);
 
     // Initialize our reference count for this buffer
-    mBuffers.add(bufferItem.mGraphicBuffer->getId(),
-            new BufferTracker(bufferItem.mGraphicBuffer));
+    sp<BufferTracker> tracker(new BufferTracker(bufferItem.mGraphicBuffer));
+    mBuffers.add(bufferItem.mGraphicBuffer->getId(), tracker);
 
     IGraphicBufferProducer::QueueBufferInput queueInput(
             bufferItem.mTimestamp, bufferItem.mIsAutoTimestamp,
@@ -149,17 +184,25 @@ void StreamSplitter::onFrameAvailable(const BufferItem& /* item */) {
             bufferItem.mTransform, bufferItem.mFence);
 
     // Attach and queue the buffer to each of the outputs
-    Vector<sp<IGraphicBufferProducer> >::iterator output = mOutputs.begin();
-    for (; output != mOutputs.end(); ++output) {
+    for (size_t i = 0; i < mOutputs.size(); ++i) {
+        Output& output = mOutputs.editItemAt(i);
+        if (output.policy == SlowOutputPolicy::DROP_FRAMES &&
+                output.queueDepth >= output.maxQueueDepth) {
+            // This output is behind, so it doesn't get this buffer at all
+            ALOGV("dropped buffer %#" PRIx64 " for output %p",
+                    bufferItem.mGraphicBuffer->getId(), output.producer.get());
+            onOutputDoneLocked(tracker);
+            continue;
+        }
+
         int slot;
-        status = (*output)->attachBuffer(&slot, bufferItem.mGraphicBuffer);
+        status = output.producer->attachBuffer(&slot, bufferItem.mGraphicBuffer);
         if (status == NO_INIT) {
             // If we just discovered that this output has been abandoned, note
-            // that, increment the release count so that we still release this
-            // buffer eventually, and move on to the next output
+            // that, count it as done with the buffer so that we still release
+            // it eventually, and move on to the next output
             onAbandonedLocked();
-            mBuffers.editValueFor(bufferItem.mGraphicBuffer->getId())->
-                    incrementReleaseCountLocked();
+            onOutputDoneLocked(tracker);
             continue;
         } else {
             LOG_ALWAYS_FATAL_IF(status != NO_ERROR,
@@ -167,22 +210,38 @@ void StreamSplitter::onFrameAvailable(const BufferItem& /* item */) {
         }
 
         IGraphicBufferProducer::QueueBufferOutput queueOutput;
-        status = (*output)->queueBuffer(slot, queueInput, &queueOutput);
+        status = output.producer->queueBuffer(slot, queueInput, &queueOutput);
         if (status == NO_INIT) {
             // If we just discovered that this output has been abandoned, note
-            // that, increment the release count so that we still release this
-            // buffer eventually, and move on to the next output
+            // that, count it as done with the buffer so that we still release
+            // it eventually, and move on to the next output
             onAbandonedLocked();
-            mBuffers.editValueFor(bufferItem.mGraphicBuffer->getId())->
-                    incrementReleaseCountLocked();
+            onOutputDoneLocked(tracker);
             continue;
         } else {
             LOG_ALWAYS_FATAL_IF(status != NO_ERROR,
                     "queueing buffer to output failed (%d)", status);
         }
+        ++output.queueDepth;
 
         ALOGV("queued buffer %#" PRIx64 " to output %p",
-                bufferItem.mGraphicBuffer->getId(), output->get());
+                bufferItem.mGraphicBuffer->getId(), output.producer.get());
+
+        // In async mode, a buffer the output's consumer had not acquired yet
+        // was just replaced. It won't be released through onBufferReleased,
+        // so take it back now.
+        if (queueOutput.bufferReplaced) {
+            sp<GraphicBuffer> buffer;
+            sp<Fence> fence;
+            status = output.producer->detachNextBuffer(&buffer, &fence);
+            if (status == NO_INIT) {
+                onAbandonedLocked();
+                continue;
+            }
+            LOG_ALWAYS_FATAL_IF(status != NO_ERROR,
+                    "detaching replaced buffer from output failed (%d)", status);
+            onBufferDetachedLocked(i, buffer, fence);
+        }
     }
 }
 
@@ -191,6 +250,14 @@ void StreamSplitter::onBufferReleasedByOutput(
     ATRACE_CALL();
     Mutex::Autolock lock(mMutex);
 
+    size_t outputIndex = 0;
+    while (outputIndex < mOutputs.size() &&
+            mOutputs[outputIndex].producer != from) {
+        ++outputIndex;
+    }
+    LOG_ALWAYS_FATAL_IF(outputIndex == mOutputs.size(),
+            "buffer released by unknown output %p", from.get());
+
     sp<GraphicBuffer> buffer;
     sp<Fence> fence;
     status_t status = from->detachNextBuffer(&buffer, &fence);
@@ -207,15 +274,34 @@ void StreamSplitter::onBufferReleasedByOutput(
     ALOGV("detached buffer %#" PRIx64 " from output %p",
           buffer->getId(), from.get());
 
-    const sp<BufferTracker>& tracker = mBuffers.editValueFor(buffer->getId());
+    onBufferDetachedLocked(outputIndex, buffer, fence);
+}
+
+void StreamSplitter::onBufferDetachedLocked(size_t outputIndex,
+        const sp<GraphicBuffer>& buffer, const sp<Fence>& fence) {
+    Output& output = mOutputs.editItemAt(outputIndex);
+    if (output.queueDepth > 0) {
+        --output.queueDepth;
+    }
 
-    // Merge the release fence of the incoming buffer so that the fence we send
+    // Hold a reference, since onOutputDoneLocked may stop tracking the buffer
+    sp<BufferTracker> tracker = mBuffers.editValueFor(buffer->getId());
+
+    // Keep the release fence of the incoming buffer so that the fence we send
     // back to the input includes all of the outputs' fences
-    tracker->mergeFence(fence);
+    tracker->addReleaseFence(fence);
+    onOutputDoneLocked(tracker);
+
+    // A throttling output may have dropped below its queue depth
+    mReleaseCondition.signal();
+}
+
+void StreamSplitter::onOutputDoneLocked(const sp<BufferTracker>& tracker) {
+    const uint64_t bufferId = tracker->getBuffer()->getId();
 
     // Check to see if this is the last outstanding reference to this buffer
     size_t releaseCount = tracker->incrementReleaseCountLocked();
-    ALOGV("buffer %#" PRIx64 " reference count %zu (of %zu)", buffer->getId(),
+    ALOGV("buffer %#" PRIx64 " reference count %zu (of %zu)", bufferId,
             releaseCount, mOutputs.size());
     if (releaseCount < mOutputs.size()) {
         return;
@@ -224,13 +310,13 @@ void StreamSplitter::onBufferReleasedByOutput(
     // If we've been abandoned, we can't return the buffer to the input, so just
     // stop tracking it and move on
     if (mIsAbandoned) {
-        mBuffers.removeItem(buffer->getId());
+        mBuffers.removeItem(bufferId);
         return;
     }
 
     // Attach and release the buffer back to the input
     int consumerSlot;
-    status = mInput->attachBuffer(&consumerSlot, tracker->getBuffer());
+    status_t status = mInput->attachBuffer(&consumerSlot, tracker->getBuffer());
     LOG_ALWAYS_FATAL_IF(status != NO_ERROR,
             "attaching buffer to input failed (%d)", status);
 
@@ -239,17 +325,30 @@ void StreamSplitter::onBufferReleasedByOutput(
     LOG_ALWAYS_FATAL_IF(status != NO_ERROR,
             "releasing buffer to input failed (%d)", status);
 
-    ALOGV("released buffer %#" PRIx64 " to input", buffer->getId());
+    ALOGV("released buffer %#" PRIx64 " to input", bufferId);
 
     // We no longer need to track the buffer once it has been returned to the
     // input
-    mBuffers.removeItem(buffer->getId());
+    mBuffers.removeItem(bufferId);
 
     // Notify any waiting onFrameAvailable calls
     --mOutstandingBuffers;
     mReleaseCondition.signal();
 }
 
+bool StreamSplitter::isThrottledLocked() const {
+    if (mOutstandingBuffers >= mMaxOutstandingBuffers) {
+        return true;
+    }
+    for (const Output& output : mOutputs) {
+        if (output.policy == SlowOutputPolicy::THROTTLE &&
+                output.queueDepth >= output.maxQueueDepth) {
+            return true;
+        }
+    }
+    return false;
+}
+
 void StreamSplitter::onAbandonedLocked() {
     ALOGE("one of my outputs has abandoned me");
     if (!mIsAbandoned) {
@@ -276,12 +375,20 @@ void StreamSplitter::OutputListener::binderDied(const wp<IBinder>& /* who */) {
 }
 
 StreamSplitter::BufferTracker::BufferTracker(const sp<GraphicBuffer>& buffer)
-      : mBuffer(buffer), mMergedFence(Fence::NO_FENCE), mReleaseCount(0) {}
+      : mBuffer(buffer), mReleaseFences(), mReleaseCount(0) {}
 
 StreamSplitter::BufferTracker::~BufferTracker() {}
 
-void StreamSplitter::BufferTracker::mergeFence(const sp<Fence>& with) {
-    mMergedFence = Fence::merge(String8("StreamSplitter"), mMergedFence, with);
+void StreamSplitter::BufferTracker::addReleaseFence(const sp<Fence>& fence) {
+    if (fence != NULL && fence->isValid() &&
+            fence->getSignalTime() == Fence::SIGNAL_TIME_PENDING) {
+        mReleaseFences.push_back(fence);
+    }
+}
+
+sp<Fence> StreamSplitter::BufferTracker::getMergedFence() const {
+    return Fence::mergeAll("StreamSplitter", std::vector<sp<Fence>>(
+            mReleaseFences.begin(), mReleaseFences.end()));
 }
 
 } // namespace android
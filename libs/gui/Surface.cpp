@@ -478,25 +478,14 @@ int Surface::dequeueBuffer(android_native_buffer_t** buffer, int* fenceFd) {
     ATRACE_CALL();
     ALOGV("Surface::dequeueBuffer");
 
-    uint32_t reqWidth;
-    uint32_t reqHeight;
-    PixelFormat reqFormat;
-    uint64_t reqUsage;
-    bool enableFrameTimestamps;
-
+    IGraphicBufferProducer::DequeueBufferInput dqInput;
     {
         Mutex::Autolock lock(mMutex);
         if (mReportRemovedBuffers) {
             mRemovedBuffers.clear();
         }
 
-        reqWidth = mReqWidth ? mReqWidth : mUserWidth;
-        reqHeight = mReqHeight ? mReqHeight : mUserHeight;
-
-        reqFormat = mReqFormat;
-        reqUsage = mReqUsage;
-
-        enableFrameTimestamps = mEnableFrameTimestamps;
+        getDequeueBufferInputLocked(&dqInput);
 
         if (mSharedBufferMode && mAutoRefresh && mSharedBufferSlot !=
                 BufferItem::INVALID_BUFFER_SLOT) {
@@ -514,16 +503,17 @@ int Surface::dequeueBuffer(android_native_buffer_t** buffer, int* fenceFd) {
     nsecs_t startTime = systemTime();
 
     FrameEventHistoryDelta frameTimestamps;
-    status_t result = mGraphicBufferProducer->dequeueBuffer(&buf, &fence, reqWidth, reqHeight,
-                                                            reqFormat, reqUsage, &mBufferAge,
-                                                            enableFrameTimestamps ? &frameTimestamps
-                                                                                  : nullptr);
+    status_t result = mGraphicBufferProducer->dequeueBuffer(&buf, &fence, dqInput.width,
+                                                            dqInput.height, dqInput.format,
+                                                            dqInput.usage, &mBufferAge,
+                                                            dqInput.getTimestamps ?
+                                                                    &frameTimestamps : nullptr);
     mLastDequeueDuration = systemTime() - startTime;
 
     if (result < 0) {
         ALOGV("dequeueBuffer: IGraphicBufferProducer::dequeueBuffer"
                 "(%d, %d, %d, %#" PRIx64 ") failed: %d",
-                reqWidth, reqHeight, reqFormat, reqUsage, result);
+                dqInput.width, dqInput.height, dqInput.format, dqInput.usage, result);
         return result;
     }
 
@@ -547,11 +537,12 @@ int Surface::dequeueBuffer(android_native_buffer_t** buffer, int* fenceFd) {
         freeAllBuffers();
     }
 
-    if (enableFrameTimestamps) {
+    if (dqInput.getTimestamps) {
          mFrameEventHistory->applyDelta(frameTimestamps);
     }
 
     if ((result & IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION) || gbuf == nullptr) {
+        invalidateQueryCacheLocked();
         if (mReportRemovedBuffers && (gbuf != nullptr)) {
             mRemovedBuffers.push_back(gbuf);
         }
@@ -588,6 +579,135 @@ int Surface::dequeueBuffer(android_native_buffer_t** buffer, int* fenceFd) {
     return OK;
 }
 
+void Surface::getDequeueBufferInputLocked(
+        IGraphicBufferProducer::DequeueBufferInput* dequeueInput) {
+    dequeueInput->width = mReqWidth ? mReqWidth : mUserWidth;
+    dequeueInput->height = mReqHeight ? mReqHeight : mUserHeight;
+
+    dequeueInput->format = mReqFormat;
+    dequeueInput->usage = mReqUsage;
+
+    dequeueInput->getTimestamps = mEnableFrameTimestamps;
+}
+
+int Surface::dequeueBuffers(std::vector<BatchBuffer>* buffers) {
+    ATRACE_CALL();
+    ALOGV("Surface::dequeueBuffers");
+
+    if (buffers->empty()) {
+        return OK;
+    }
+
+    std::vector<IGraphicBufferProducer::DequeueBufferInput> dequeueInput;
+    {
+        Mutex::Autolock lock(mMutex);
+        if (mSharedBufferMode) {
+            ALOGE("dequeueBuffers: batched dequeue is not supported in shared buffer mode");
+            return INVALID_OPERATION;
+        }
+        if (mReportRemovedBuffers) {
+            mRemovedBuffers.clear();
+        }
+
+        IGraphicBufferProducer::DequeueBufferInput input;
+        getDequeueBufferInputLocked(&input);
+        dequeueInput.assign(buffers->size(), input);
+    } // Drop the lock so that we can still touch the Surface while blocking in IGBP::dequeueBuffers
+
+    std::vector<IGraphicBufferProducer::DequeueBufferOutput> dequeueOutput;
+    nsecs_t startTime = systemTime();
+    status_t result = mGraphicBufferProducer->dequeueBuffers(dequeueInput, &dequeueOutput);
+    mLastDequeueDuration = systemTime() - startTime;
+
+    if (result != NO_ERROR) {
+        ALOGE("dequeueBuffers: IGraphicBufferProducer::dequeueBuffers failed: %d", result);
+        return result;
+    }
+
+    if (dequeueOutput.empty()) {
+        ALOGE("dequeueBuffers: IGraphicBufferProducer::dequeueBuffers returned no buffers");
+        return FAILED_TRANSACTION;
+    }
+
+    Mutex::Autolock lock(mMutex);
+
+    // Write this while holding the mutex
+    mLastDequeueStartTime = startTime;
+
+    for (const auto& output : dequeueOutput) {
+        if (output.result >= 0 && (output.slot < 0 || output.slot >= NUM_BUFFER_SLOTS)) {
+            ALOGE("dequeueBuffers: IGraphicBufferProducer returned invalid slot number %d",
+                    output.slot);
+            android_errorWriteLog(0x534e4554, "36991414"); // SafetyNet logging
+            return FAILED_TRANSACTION;
+        }
+    }
+
+    // The batch is all or nothing: if any buffer could not be dequeued or
+    // requested, the ones that were are cancelled again.
+    status_t err = OK;
+    if (dequeueOutput.back().result < 0) {
+        err = dequeueOutput.back().result;
+    } else if (dequeueOutput.size() != buffers->size()) {
+        err = FAILED_TRANSACTION;
+    }
+    for (const auto& output : dequeueOutput) {
+        if (output.result < 0) {
+            ALOGV("dequeueBuffers: IGraphicBufferProducer::dequeueBuffer failed: %d",
+                    output.result);
+            break;
+        }
+
+        if (output.result & IGraphicBufferProducer::RELEASE_ALL_BUFFERS) {
+            freeAllBuffers();
+        }
+
+        if (dequeueInput.front().getTimestamps) {
+            mFrameEventHistory->applyDelta(output.timestamps);
+        }
+
+        sp<GraphicBuffer>& gbuf(mSlots[output.slot].buffer);
+        if (err == OK && ((output.result & IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION) ||
+                gbuf == nullptr)) {
+            invalidateQueryCacheLocked();
+            if (mReportRemovedBuffers && (gbuf != nullptr)) {
+                mRemovedBuffers.push_back(gbuf);
+            }
+            err = mGraphicBufferProducer->requestBuffer(output.slot, &gbuf);
+            if (err != NO_ERROR) {
+                ALOGE("dequeueBuffers: IGraphicBufferProducer::requestBuffer failed: %d", err);
+            }
+        }
+    }
+
+    if (err != OK) {
+        for (const auto& output : dequeueOutput) {
+            if (output.result >= 0) {
+                mGraphicBufferProducer->cancelBuffer(output.slot, output.fence);
+            }
+        }
+        return err;
+    }
+
+    mBufferAge = dequeueOutput.back().bufferAge;
+    for (size_t i = 0; i < dequeueOutput.size(); i++) {
+        const auto& output = dequeueOutput[i];
+        BatchBuffer& batchBuffer = (*buffers)[i];
+        batchBuffer.buffer = mSlots[output.slot].buffer.get();
+        batchBuffer.fenceFd = output.fence->isValid() ? output.fence->dup() : -1;
+        if (output.fence->isValid() && batchBuffer.fenceFd == -1) {
+            ALOGE("dequeueBuffers: error duping fence: %d", errno);
+            // dup() should never fail; see dequeueBuffer.
+        }
+        if (mSharedBufferSlot == output.slot) {
+            mSharedBufferSlot = BufferItem::INVALID_BUFFER_SLOT;
+            mSharedBufferHasBeenQueued = false;
+        }
+    }
+
+    return OK;
+}
+
 int Surface::cancelBuffer(android_native_buffer_t* buffer,
         int fenceFd) {
     ATRACE_CALL();
@@ -634,42 +754,24 @@ int Surface::lockBuffer_DEPRECATED(android_native_buffer_t* buffer __attribute__
     return OK;
 }
 
-int Surface::queueBuffer(android_native_buffer_t* buffer, int fenceFd) {
-    ATRACE_CALL();
-    ALOGV("Surface::queueBuffer");
-    Mutex::Autolock lock(mMutex);
+IGraphicBufferProducer::QueueBufferInput Surface::getQueueBufferInputLocked(
+        android_native_buffer_t* buffer, const sp<Fence>& fence, int64_t requestedTimestamp) {
     int64_t timestamp;
     bool isAutoTimestamp = false;
 
-    if (mTimestamp == NATIVE_WINDOW_TIMESTAMP_AUTO) {
+    if (requestedTimestamp == NATIVE_WINDOW_TIMESTAMP_AUTO) {
         timestamp = systemTime(SYSTEM_TIME_MONOTONIC);
         isAutoTimestamp = true;
         ALOGV("Surface::queueBuffer making up timestamp: %.2f ms",
             timestamp / 1000000.0);
     } else {
-        timestamp = mTimestamp;
-    }
-    int i = getSlotFromBufferLocked(buffer);
-    if (i < 0) {
-        if (fenceFd >= 0) {
-            close(fenceFd);
-        }
-        return i;
-    }
-    if (mSharedBufferSlot == i && mSharedBufferHasBeenQueued) {
-        if (fenceFd >= 0) {
-            close(fenceFd);
-        }
-        return OK;
+        timestamp = requestedTimestamp;
     }
 
-
     // Make sure the crop rectangle is entirely inside the buffer.
     Rect crop(Rect::EMPTY_RECT);
     mCrop.intersect(Rect(buffer->width, buffer->height), &crop);
 
-    sp<Fence> fence(fenceFd >= 0 ? new Fence(fenceFd) : Fence::NO_FENCE);
-    IGraphicBufferProducer::QueueBufferOutput output;
     IGraphicBufferProducer::QueueBufferInput input(timestamp, isAutoTimestamp,
             static_cast<android_dataspace>(mDataSpace), crop, mScalingMode,
             mTransform ^ mStickyTransform, fence, mStickyTransform,
@@ -741,13 +843,11 @@ int Surface::queueBuffer(android_native_buffer_t* buffer, int fenceFd) {
         input.setSurfaceDamage(flippedRegion);
     }
 
-    nsecs_t now = systemTime();
-    status_t err = mGraphicBufferProducer->queueBuffer(i, input, &output);
-    mLastQueueDuration = systemTime() - now;
-    if (err != OK)  {
-        ALOGE("queueBuffer: error queuing buffer to SurfaceTexture, %d", err);
-    }
+    return input;
+}
 
+void Surface::onBufferQueuedLocked(int slot, sp<Fence> fence,
+        const IGraphicBufferProducer::QueueBufferOutput& output) {
     if (mEnableFrameTimestamps) {
         mFrameEventHistory->applyDelta(output.frameTimestamps);
         // Update timestamps with the local acquire fence.
@@ -779,10 +879,108 @@ int Surface::queueBuffer(android_native_buffer_t* buffer, int fenceFd) {
         mDirtyRegion = Region::INVALID_REGION;
     }
 
-    if (mSharedBufferMode && mAutoRefresh && mSharedBufferSlot == i) {
+    if (mSharedBufferMode && mAutoRefresh && mSharedBufferSlot == slot) {
         mSharedBufferHasBeenQueued = true;
     }
 
+}
+
+int Surface::queueBuffer(android_native_buffer_t* buffer, int fenceFd) {
+    ATRACE_CALL();
+    ALOGV("Surface::queueBuffer");
+    Mutex::Autolock lock(mMutex);
+
+    int i = getSlotFromBufferLocked(buffer);
+    if (i < 0) {
+        if (fenceFd >= 0) {
+            close(fenceFd);
+        }
+        return i;
+    }
+    if (mSharedBufferSlot == i && mSharedBufferHasBeenQueued) {
+        if (fenceFd >= 0) {
+            close(fenceFd);
+        }
+        return OK;
+    }
+
+    sp<Fence> fence(fenceFd >= 0 ? new Fence(fenceFd) : Fence::NO_FENCE);
+    IGraphicBufferProducer::QueueBufferOutput output;
+    IGraphicBufferProducer::QueueBufferInput input =
+            getQueueBufferInputLocked(buffer, fence, mTimestamp);
+
+    nsecs_t now = systemTime();
+    status_t err = mGraphicBufferProducer->queueBuffer(i, input, &output);
+    mLastQueueDuration = systemTime() - now;
+    if (err != OK)  {
+        ALOGE("queueBuffer: error queuing buffer to SurfaceTexture, %d", err);
+    }
+
+    onBufferQueuedLocked(i, fence, output);
+
+    mQueueBufferCondition.broadcast();
+
+    return err;
+}
+
+int Surface::queueBuffers(const std::vector<BatchQueuedBuffer>& buffers) {
+    ATRACE_CALL();
+    ALOGV("Surface::queueBuffers");
+    Mutex::Autolock lock(mMutex);
+
+    if (mSharedBufferMode) {
+        ALOGE("queueBuffers: batched queue is not supported in shared buffer mode");
+        for (const auto& batchBuffer : buffers) {
+            if (batchBuffer.fenceFd >= 0) {
+                close(batchBuffer.fenceFd);
+            }
+        }
+        return INVALID_OPERATION;
+    }
+
+    std::vector<IGraphicBufferProducer::QueuedBuffer> queued;
+    std::vector<sp<Fence>> fences;
+    queued.reserve(buffers.size());
+    fences.reserve(buffers.size());
+    for (const auto& batchBuffer : buffers) {
+        int i = getSlotFromBufferLocked(batchBuffer.buffer);
+        if (i < 0) {
+            for (size_t j = fences.size(); j < buffers.size(); j++) {
+                if (buffers[j].fenceFd >= 0) {
+                    close(buffers[j].fenceFd);
+                }
+            }
+            return i;
+        }
+        fences.push_back(batchBuffer.fenceFd >= 0 ? new Fence(batchBuffer.fenceFd)
+                                                  : Fence::NO_FENCE);
+        queued.push_back({i, getQueueBufferInputLocked(batchBuffer.buffer, fences.back(),
+                                                       batchBuffer.timestamp)});
+    }
+
+    std::vector<IGraphicBufferProducer::QueueBufferOutput> outputs;
+    std::vector<status_t> results;
+    nsecs_t now = systemTime();
+    status_t err = mGraphicBufferProducer->queueBuffers(queued, &outputs, &results);
+    mLastQueueDuration = systemTime() - now;
+    if (err != OK) {
+        ALOGE("queueBuffers: error queuing buffers to SurfaceTexture, %d", err);
+        return err;
+    }
+    if (outputs.size() != queued.size() || results.size() != queued.size()) {
+        ALOGE("queueBuffers: IGraphicBufferProducer returned %zu results for %zu buffers",
+                results.size(), queued.size());
+        return FAILED_TRANSACTION;
+    }
+
+    for (size_t i = 0; i < queued.size(); i++) {
+        if (results[i] != OK) {
+            ALOGE("queueBuffers: error queuing buffer to SurfaceTexture, %d", results[i]);
+            err = results[i];
+        }
+        onBufferQueuedLocked(queued[i].slot, fences[i], outputs[i]);
+    }
+
     mQueueBufferCondition.broadcast();
 
     return err;
@@ -814,6 +1012,7 @@ void Surface::querySupportedTimestampsLocked() const {
 int Surface::query(int what, int* value) const {
     ATRACE_CALL();
     ALOGV("Surface::query");
+    uint32_t generation = 0;
     { // scope for the lock
         Mutex::Autolock lock(mMutex);
         switch (what) {
@@ -824,12 +1023,11 @@ int Surface::query(int what, int* value) const {
                 }
                 break;
             case NATIVE_WINDOW_QUEUES_TO_WINDOW_COMPOSER: {
-                if (composerService()->authenticateSurfaceTexture(
-                        mGraphicBufferProducer)) {
-                    *value = 1;
-                } else {
-                    *value = 0;
+                if (mQueuesToWindowComposer < 0) {
+                    mQueuesToWindowComposer = composerService()->authenticateSurfaceTexture(
+                            mGraphicBufferProducer) ? 1 : 0;
                 }
+                *value = mQueuesToWindowComposer;
                 return NO_ERROR;
             }
             case NATIVE_WINDOW_CONCRETE_TYPE:
@@ -894,8 +1092,41 @@ int Surface::query(int what, int* value) const {
                 return NO_ERROR;
             }
         }
+        if (!isCacheableQuery(what)) {
+            return mGraphicBufferProducer->query(what, value);
+        }
+        auto cached = mCachedQueries.find(what);
+        if (cached != mCachedQueries.end()) {
+            *value = cached->second;
+            return NO_ERROR;
+        }
+        generation = mQueryCacheGeneration;
     }
-    return mGraphicBufferProducer->query(what, value);
+    status_t err = mGraphicBufferProducer->query(what, value);
+    if (err == NO_ERROR) {
+        Mutex::Autolock lock(mMutex);
+        if (generation == mQueryCacheGeneration) {
+            mCachedQueries[what] = *value;
+        }
+    }
+    return err;
+}
+
+bool Surface::isCacheableQuery(int what) {
+    switch (what) {
+        case NATIVE_WINDOW_CONSUMER_USAGE_BITS:
+        case NATIVE_WINDOW_DEFAULT_DATASPACE:
+        case NATIVE_WINDOW_CONSUMER_IS_PROTECTED:
+            return true;
+        default:
+            return false;
+    }
+}
+
+void Surface::invalidateQueryCacheLocked() {
+    mCachedQueries.clear();
+    mHasCachedConsumerUsage = false;
+    mQueryCacheGeneration++;
 }
 
 int Surface::perform(int operation, va_list args)
@@ -1001,6 +1232,9 @@ int Surface::perform(int operation, va_list args)
     case NATIVE_WINDOW_GET_CONSUMER_USAGE64:
         res = dispatchGetConsumerUsage64(args);
         break;
+    case NATIVE_WINDOW_SET_BUFFERS_STATE:
+        res = dispatchSetBuffersState(args);
+        break;
     default:
         res = NAME_NOT_FOUND;
         break;
@@ -1195,6 +1429,14 @@ int Surface::dispatchGetConsumerUsage64(va_list args) {
     return getConsumerUsage(usage);
 }
 
+int Surface::dispatchSetBuffersState(va_list args) {
+    const native_window_buffers_state* state = va_arg(args, const native_window_buffers_state*);
+    if (state == nullptr) {
+        return BAD_VALUE;
+    }
+    return setBuffersState(*state);
+}
+
 int Surface::connect(int api) {
     static sp<IProducerListener> listener = new DummyProducerListener();
     return connect(api, listener);
@@ -1211,6 +1453,7 @@ int Surface::connect(
     Mutex::Autolock lock(mMutex);
     IGraphicBufferProducer::QueueBufferOutput output;
     mReportRemovedBuffers = reportBufferRemoval;
+    invalidateQueryCacheLocked();
     int err = mGraphicBufferProducer->connect(listener, api, mProducerControlledByApp, &output);
     if (err == NO_ERROR) {
         mDefaultWidth = output.width;
@@ -1228,6 +1471,7 @@ int Surface::connect(
         mConnectedToCpu = true;
         // Clear the dirty region in case we're switching from a non-CPU API
         mDirtyRegion.clear();
+        mPostedDamage.clear();
     } else if (!err) {
         // Initialize the dirty region for tracking surface damage
         mDirtyRegion = Region::INVALID_REGION;
@@ -1245,6 +1489,7 @@ int Surface::disconnect(int api, IGraphicBufferProducer::DisconnectMode mode) {
     mSharedBufferSlot = BufferItem::INVALID_BUFFER_SLOT;
     mSharedBufferHasBeenQueued = false;
     freeAllBuffers();
+    invalidateQueryCacheLocked();
     int err = mGraphicBufferProducer->disconnect(api, mode);
     if (!err) {
         mReqFormat = 0;
@@ -1536,6 +1781,48 @@ int Surface::setBuffersTimestamp(int64_t timestamp)
     return NO_ERROR;
 }
 
+int Surface::setBuffersState(const native_window_buffers_state& state)
+{
+    ATRACE_CALL();
+    ALOGV("Surface::setBuffersState(%#x)", state.changes);
+
+    if (state.changes & NATIVE_WINDOW_BUFFERS_STATE_SCALING_MODE) {
+        switch (state.scalingMode) {
+            case NATIVE_WINDOW_SCALING_MODE_FREEZE:
+            case NATIVE_WINDOW_SCALING_MODE_SCALE_TO_WINDOW:
+            case NATIVE_WINDOW_SCALING_MODE_SCALE_CROP:
+            case NATIVE_WINDOW_SCALING_MODE_NO_SCALE_CROP:
+                break;
+            default:
+                ALOGE("unknown scaling mode: %d", state.scalingMode);
+                return BAD_VALUE;
+        }
+    }
+
+    Mutex::Autolock lock(mMutex);
+    if (state.changes & NATIVE_WINDOW_BUFFERS_STATE_DATASPACE) {
+        mDataSpace = static_cast<Dataspace>(state.dataSpace);
+    }
+    if (state.changes & NATIVE_WINDOW_BUFFERS_STATE_CROP) {
+        const Rect& crop = reinterpret_cast<const Rect&>(state.crop);
+        if (crop.isEmpty()) {
+            mCrop.clear();
+        } else {
+            mCrop = crop;
+        }
+    }
+    if (state.changes & NATIVE_WINDOW_BUFFERS_STATE_TRANSFORM) {
+        mTransform = static_cast<uint32_t>(state.transform);
+    }
+    if (state.changes & NATIVE_WINDOW_BUFFERS_STATE_SCALING_MODE) {
+        mScalingMode = state.scalingMode;
+    }
+    if (state.changes & NATIVE_WINDOW_BUFFERS_STATE_TIMESTAMP) {
+        mTimestamp = state.timestamp;
+    }
+    return NO_ERROR;
+}
+
 int Surface::setBuffersDataSpace(Dataspace dataSpace)
 {
     ALOGV("Surface::setBuffersDataSpace");
@@ -1707,8 +1994,24 @@ status_t Surface::lock(
                 backBuffer->format == frontBuffer->format);
 
         if (canCopyBack) {
-            // copy the area that is invalid and not repainted this round
-            const Region copyback(mDirtyRegion.subtract(newDirtyRegion));
+            uint64_t bufferAge = 0;
+            {
+                Mutex::Autolock lock(mMutex);
+                bufferAge = mBufferAge;
+            }
+            Region copyback;
+            if (bufferAge > 0 && bufferAge <= mPostedDamage.size() + 1) {
+                // the back buffer already holds the frame posted bufferAge
+                // frames ago, so only what was repainted since then is stale
+                for (size_t i = 0; i + 1 < bufferAge; i++) {
+                    copyback.orSelf(mPostedDamage[i]);
+                }
+                copyback.andSelf(bounds);
+                copyback.subtractSelf(newDirtyRegion);
+            } else {
+                // copy the area that is invalid and not repainted this round
+                copyback = mDirtyRegion.subtract(newDirtyRegion);
+            }
             if (!copyback.isEmpty()) {
                 copyBlt(backBuffer, frontBuffer, copyback, &fenceFd);
             }
@@ -1772,10 +2075,29 @@ status_t Surface::unlockAndPost()
     status_t err = mLockedBuffer->unlockAsync(&fd);
     ALOGE_IF(err, "failed unlocking buffer (%p)", mLockedBuffer->handle);
 
+    Region damage;
+    { // scope for the lock
+        Mutex::Autolock lock(mMutex);
+        int slot = getSlotFromBufferLocked(mLockedBuffer.get());
+        if (slot >= 0) {
+            damage = mSlots[slot].dirtyRegion;
+        }
+    }
+
     err = queueBuffer(mLockedBuffer.get(), fd);
     ALOGE_IF(err, "queueBuffer (handle=%p) failed (%s)",
             mLockedBuffer->handle, strerror(-err));
 
+    if (err == NO_ERROR) {
+        mPostedDamage.push_front(damage);
+        if (mPostedDamage.size() > MAX_POSTED_DAMAGE) {
+            mPostedDamage.pop_back();
+        }
+    } else {
+        // the buffer ages no longer line up with the posted damage
+        mPostedDamage.clear();
+    }
+
     mPostedBuffer = mLockedBuffer;
     mLockedBuffer = 0;
     return err;
@@ -1796,7 +2118,15 @@ status_t Surface::getUniqueId(uint64_t* outId) const {
 
 int Surface::getConsumerUsage(uint64_t* outUsage) const {
     Mutex::Autolock lock(mMutex);
-    return mGraphicBufferProducer->getConsumerUsage(outUsage);
+    if (!mHasCachedConsumerUsage) {
+        status_t err = mGraphicBufferProducer->getConsumerUsage(&mCachedConsumerUsage);
+        if (err != NO_ERROR) {
+            return err;
+        }
+        mHasCachedConsumerUsage = true;
+    }
+    *outUsage = mCachedConsumerUsage;
+    return NO_ERROR;
 }
 
 nsecs_t Surface::getLastDequeueStartTime() const {
@@ -21,11 +21,13 @@
 
 #include <utils/Errors.h>
 #include <utils/Log.h>
+#include <utils/NativeHandle.h>
 #include <utils/SortedVector.h>
 #include <utils/String8.h>
 #include <utils/threads.h>
 
 #include <binder/IServiceManager.h>
+#include <binder/Parcel.h>
 
 #include <system/graphics.h>
 
@@ -41,6 +43,7 @@
 #include <gui/SurfaceComposerClient.h>
 
 #include <private/gui/ComposerService.h>
+#include <private/gui/TransactionChannel.h>
 
 namespace android {
 
@@ -143,15 +146,6 @@ status_t SurfaceComposerClient::Transaction::apply(bool synchronous) {
 
     mForceSynchronous |= synchronous;
 
-    for (auto const& kv : mComposerStates){
-        composerStates.add(kv.second);
-    }
-
-    mComposerStates.clear();
-
-    displayStates = mDisplayStates;
-    mDisplayStates.clear();
-
     if (mForceSynchronous) {
         flags |= ISurfaceComposer::eSynchronous;
     }
@@ -166,6 +160,25 @@ status_t SurfaceComposerClient::Transaction::apply(bool synchronous) {
     mAnimation = false;
     mEarlyWakeup = false;
 
+    // Plain layer transactions of a single client can skip the binder call
+    if (flags == 0 && mDisplayStates.isEmpty() && !mComposerStates.empty()) {
+        sp<SurfaceComposerClient> client = mComposerStates.begin()->first->getClient();
+        if (client != nullptr && client->writeToTransactionChannel(mComposerStates)) {
+            mComposerStates.clear();
+            mStatus = NO_ERROR;
+            return NO_ERROR;
+        }
+    }
+
+    for (auto const& kv : mComposerStates){
+        composerStates.add(kv.second);
+    }
+
+    mComposerStates.clear();
+
+    displayStates = mDisplayStates;
+    mDisplayStates.clear();
+
     sf->setTransactionState(composerStates, displayStates, flags);
     mStatus = NO_ERROR;
     return NO_ERROR;
@@ -613,6 +626,62 @@ void SurfaceComposerClient::dispose() {
     mStatus = NO_INIT;
 }
 
+bool SurfaceComposerClient::writeToTransactionChannel(
+        const std::unordered_map<sp<SurfaceControl>, ComposerState, SCHash>& states) {
+    if (mStatus != NO_ERROR) {
+        return false;
+    }
+
+    Parcel record;
+    record.writeUint32(static_cast<uint32_t>(states.size()));
+    for (auto const& kv : states) {
+        const layer_state_t& state = kv.second.state;
+        if (kv.first->getClient() != this || (state.what & TransactionChannel::BINDER_CHANGES)) {
+            return false;
+        }
+        const int32_t id = getChannelLayerId(kv.first);
+        if (id < 0) {
+            return false;
+        }
+        record.writeInt32(id);
+        layer_state_t channelState(state);
+        channelState.surface = nullptr;
+        channelState.write(record);
+    }
+    if (record.objectsCount() != 0) {
+        return false;
+    }
+
+    Mutex::Autolock _l(mChannelLock);
+    if (mTransactionChannel == nullptr) {
+        if (mTransactionChannelRefused) {
+            return false;
+        }
+        sp<NativeHandle> handle;
+        if (mClient->createTransactionChannel(&handle) != NO_ERROR) {
+            mTransactionChannelRefused = true;
+            return false;
+        }
+        mTransactionChannel = TransactionChannel::fromHandle(handle);
+        if (mTransactionChannel == nullptr) {
+            mTransactionChannelRefused = true;
+            return false;
+        }
+    }
+    return mTransactionChannel->write(record.data(), record.dataSize()) == NO_ERROR;
+}
+
+int32_t SurfaceComposerClient::getChannelLayerId(const sp<SurfaceControl>& control) const {
+    Mutex::Autolock _l(control->mLock);
+    if (control->mChannelLayerId < 0) {
+        int32_t id;
+        if (mClient->getLayerChannelId(control->mHandle, &id) == NO_ERROR) {
+            control->mChannelLayerId = id;
+        }
+    }
+    return control->mChannelLayerId;
+}
+
 sp<SurfaceControl> SurfaceComposerClient::createSurface(
         const String8& name,
         uint32_t w,
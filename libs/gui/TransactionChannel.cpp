@@ -0,0 +1,258 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "TransactionChannel"
+
+#include <private/gui/TransactionChannel.h>
+
+#include <errno.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+
+#include <cutils/ashmem.h>
+#include <cutils/native_handle.h>
+#include <utils/Log.h>
+
+namespace android {
+
+// Offsets run over twice the capacity, so that a full ring and an empty one differ.
+struct TransactionChannel::Control {
+    std::atomic<uint32_t> writeOffset;
+    std::atomic<uint32_t> readOffset;
+    // Set by the writer when it signals the eventfd, cleared by the reader
+    std::atomic<uint32_t> signaled;
+};
+
+// The records start on their own cache line.
+static constexpr size_t CONTROL_SIZE = 64;
+
+// Keeps twice the capacity within the offsets.
+static constexpr size_t MAX_CAPACITY = 1 << 24;
+
+// Each record is its size followed by its data, padded so the next size is aligned.
+static constexpr size_t HEADER_SIZE = sizeof(uint32_t);
+
+static size_t recordSize(size_t size) {
+    return HEADER_SIZE + ((size + 3) & ~size_t(3));
+}
+
+sp<TransactionChannel> TransactionChannel::create(size_t capacity) {
+    if (capacity == 0 || capacity > MAX_CAPACITY || capacity % HEADER_SIZE != 0) {
+        ALOGE("invalid capacity %zu", capacity);
+        return nullptr;
+    }
+    int memoryFd = ashmem_create_region("TransactionChannel", CONTROL_SIZE + capacity);
+    if (memoryFd < 0) {
+        ALOGE("can't create shared memory (%s)", strerror(errno));
+        return nullptr;
+    }
+    int eventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    sp<TransactionChannel> channel = new TransactionChannel(memoryFd, eventFd);
+    if (!channel->map()) {
+        return nullptr;
+    }
+    channel->mControl->writeOffset.store(0, std::memory_order_relaxed);
+    channel->mControl->readOffset.store(0, std::memory_order_relaxed);
+    channel->mControl->signaled.store(0, std::memory_order_relaxed);
+    return channel;
+}
+
+sp<TransactionChannel> TransactionChannel::fromHandle(const sp<NativeHandle>& handle) {
+    if (handle == nullptr || handle->handle() == nullptr || handle->handle()->numFds != 2) {
+        return nullptr;
+    }
+    sp<TransactionChannel> channel = new TransactionChannel(dup(handle->handle()->data[0]),
+                                                            dup(handle->handle()->data[1]));
+    if (!channel->map()) {
+        return nullptr;
+    }
+    return channel;
+}
+
+TransactionChannel::TransactionChannel(int memoryFd, int eventFd)
+      : mMemoryFd(memoryFd), mEventFd(eventFd) {}
+
+TransactionChannel::~TransactionChannel() {
+    if (mBase != nullptr) {
+        munmap(mBase, mSize);
+    }
+    if (mMemoryFd >= 0) {
+        close(mMemoryFd);
+    }
+    if (mEventFd >= 0) {
+        close(mEventFd);
+    }
+}
+
+bool TransactionChannel::map() {
+    static_assert(sizeof(Control) <= CONTROL_SIZE, "Control does not fit");
+    if (mMemoryFd < 0 || mEventFd < 0) {
+        ALOGE("missing file descriptor");
+        return false;
+    }
+
+    // The size of the region, not anything in it, decides how much may be touched.
+    const int size = ashmem_get_size_region(mMemoryFd);
+    if (size < 0 || static_cast<size_t>(size) <= CONTROL_SIZE ||
+        static_cast<size_t>(size) - CONTROL_SIZE > MAX_CAPACITY ||
+        (static_cast<size_t>(size) - CONTROL_SIZE) % HEADER_SIZE != 0) {
+        ALOGE("invalid shared memory size %d", size);
+        return false;
+    }
+    void* base = mmap(nullptr, static_cast<size_t>(size), PROT_READ | PROT_WRITE, MAP_SHARED,
+                      mMemoryFd, 0);
+    if (base == MAP_FAILED) {
+        ALOGE("can't map shared memory (%s)", strerror(errno));
+        return false;
+    }
+    mBase = base;
+    mSize = static_cast<size_t>(size);
+    mCapacity = mSize - CONTROL_SIZE;
+    mControl = static_cast<Control*>(base);
+    mData = static_cast<uint8_t*>(base) + CONTROL_SIZE;
+    return true;
+}
+
+sp<NativeHandle> TransactionChannel::getHandle() const {
+    native_handle_t* handle = native_handle_create(2, 0);
+    if (handle == nullptr) {
+        return nullptr;
+    }
+    handle->data[0] = dup(mMemoryFd);
+    handle->data[1] = dup(mEventFd);
+    if (handle->data[0] < 0 || handle->data[1] < 0) {
+        ALOGE("can't duplicate file descriptors (%s)", strerror(errno));
+        native_handle_close(handle);
+        native_handle_delete(handle);
+        return nullptr;
+    }
+    return NativeHandle::create(handle, true);
+}
+
+int TransactionChannel::getEventFd() const {
+    return mEventFd;
+}
+
+bool TransactionChannel::getDistance(uint32_t writeOffset, uint32_t readOffset,
+                                     size_t* outSize) const {
+    const size_t limit = mCapacity * 2;
+    if (writeOffset >= limit || readOffset >= limit) {
+        return false;
+    }
+    *outSize = writeOffset >= readOffset ? writeOffset - readOffset
+                                         : writeOffset + limit - readOffset;
+    return *outSize <= mCapacity;
+}
+
+uint32_t TransactionChannel::advance(uint32_t offset, size_t size) const {
+    size_t next = offset + size;
+    if (next >= mCapacity * 2) {
+        next -= mCapacity * 2;
+    }
+    return static_cast<uint32_t>(next);
+}
+
+void TransactionChannel::copyIn(uint32_t offset, const void* data, size_t size) {
+    const size_t position = offset >= mCapacity ? offset - mCapacity : offset;
+    const size_t first = std::min(size, mCapacity - position);
+    memcpy(mData + position, data, first);
+    memcpy(mData, static_cast<const uint8_t*>(data) + first, size - first);
+}
+
+void TransactionChannel::copyOut(uint32_t offset, void* data, size_t size) const {
+    const size_t position = offset >= mCapacity ? offset - mCapacity : offset;
+    const size_t first = std::min(size, mCapacity - position);
+    memcpy(data, mData + position, first);
+    memcpy(static_cast<uint8_t*>(data) + first, mData, size - first);
+}
+
+status_t TransactionChannel::write(const void* data, size_t size) {
+    if (mControl == nullptr || mBroken) {
+        return -EPIPE;
+    }
+    if (size == 0 || size > mCapacity - HEADER_SIZE) {
+        return -EAGAIN;
+    }
+
+    size_t used;
+    if (!getDistance(mWriteOffset, mControl->readOffset.load(std::memory_order_acquire), &used)) {
+        ALOGE("the reader moved to an invalid offset");
+        mBroken = true;
+        return -EPIPE;
+    }
+    const size_t total = recordSize(size);
+    if (total > mCapacity - used) {
+        return -EAGAIN;
+    }
+
+    const uint32_t header = static_cast<uint32_t>(size);
+    copyIn(mWriteOffset, &header, HEADER_SIZE);
+    copyIn(advance(mWriteOffset, HEADER_SIZE), data, size);
+    mWriteOffset = advance(mWriteOffset, total);
+
+    // Pairs with clearSignal(): either the reader sees this record after clearing the flag,
+    // or this write sees the flag cleared and signals.
+    mControl->writeOffset.store(mWriteOffset, std::memory_order_seq_cst);
+    if (mControl->signaled.exchange(1, std::memory_order_seq_cst) == 0) {
+        eventfd_write(mEventFd, 1);
+    }
+    return NO_ERROR;
+}
+
+void TransactionChannel::clearSignal() {
+    if (mControl != nullptr) {
+        mControl->signaled.store(0, std::memory_order_seq_cst);
+    }
+}
+
+status_t TransactionChannel::read(std::vector<uint8_t>* outRecord) {
+    if (mControl == nullptr || mBroken) {
+        return -EPIPE;
+    }
+
+    size_t used;
+    if (!getDistance(mControl->writeOffset.load(std::memory_order_seq_cst), mReadOffset, &used)) {
+        ALOGE("the writer moved to an invalid offset");
+        mBroken = true;
+        return -EPIPE;
+    }
+    if (used == 0) {
+        return NOT_ENOUGH_DATA;
+    }
+
+    uint32_t header = 0;
+    if (used >= HEADER_SIZE) {
+        copyOut(mReadOffset, &header, HEADER_SIZE);
+    }
+    if (header == 0 || header > used - HEADER_SIZE || recordSize(header) > used) {
+        ALOGE("the writer wrote an invalid record");
+        mBroken = true;
+        return -EPIPE;
+    }
+
+    outRecord->resize(header);
+    copyOut(advance(mReadOffset, HEADER_SIZE), outRecord->data(), header);
+    mReadOffset = advance(mReadOffset, recordSize(header));
+    mControl->readOffset.store(mReadOffset, std::memory_order_release);
+    return NO_ERROR;
+}
+
+}; // namespace android
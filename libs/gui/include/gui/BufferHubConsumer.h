@@ -90,9 +90,18 @@ public:
     status_t getOccupancyHistory(bool forceFlush,
                                  std::vector<OccupancyTracker::Segment>* outHistory) override;
 
+    // See |IGraphicBufferConsumer::getLatencyStats|
+    status_t getLatencyStats(bool reset, LatencyTracker::Stats* outStats) override;
+
     // See |IGraphicBufferConsumer::discardFreeBuffers|
     status_t discardFreeBuffers() override;
 
+    // See |IGraphicBufferConsumer::setAdaptiveBufferCount|
+    status_t setAdaptiveBufferCount(bool enabled) override;
+
+    // See |IGraphicBufferConsumer::setBufferPreallocation|
+    status_t setBufferPreallocation(bool enabled) override;
+
     // See |IGraphicBufferConsumer::dumpState|
     status_t dumpState(const String8& prefix, String8* outResult) const override;
 
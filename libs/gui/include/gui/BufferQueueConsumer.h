@@ -146,9 +146,18 @@ public:
     virtual status_t getOccupancyHistory(bool forceFlush,
             std::vector<OccupancyTracker::Segment>* outHistory) override;
 
+    // See IGraphicBufferConsumer::getLatencyStats
+    virtual status_t getLatencyStats(bool reset, LatencyTracker::Stats* outStats) override;
+
     // See IGraphicBufferConsumer::discardFreeBuffers
     virtual status_t discardFreeBuffers() override;
 
+    // See IGraphicBufferConsumer::setAdaptiveBufferCount
+    virtual status_t setAdaptiveBufferCount(bool enabled) override;
+
+    // See IGraphicBufferConsumer::setBufferPreallocation
+    virtual status_t setBufferPreallocation(bool enabled) override;
+
     // dump our state in a String
     status_t dumpState(const String8& prefix, String8* outResult) const override;
 
@@ -20,7 +20,10 @@
 #include <gui/BufferItem.h>
 #include <gui/BufferQueueDefs.h>
 #include <gui/BufferSlot.h>
+#include <gui/BufferSlotSet.h>
+#include <gui/LatencyTracker.h>
 #include <gui/OccupancyTracker.h>
+#include <gui/RingQueue.h>
 
 #include <utils/Condition.h>
 #include <utils/Mutex.h>
@@ -31,9 +34,6 @@
 #include <utils/Trace.h>
 #include <utils/Vector.h>
 
-#include <list>
-#include <set>
-
 #define BQ_LOGV(x, ...) ALOGV("[%s] " x, mConsumerName.string(), ##__VA_ARGS__)
 #define BQ_LOGD(x, ...) ALOGD("[%s] " x, mConsumerName.string(), ##__VA_ARGS__)
 #define BQ_LOGI(x, ...) ALOGI("[%s] " x, mConsumerName.string(), ##__VA_ARGS__)
@@ -55,6 +55,7 @@ class IProducerListener;
 
 class BufferQueueCore : public virtual RefBase {
 
+    friend class BufferPreallocator;
     friend class BufferQueueProducer;
     friend class BufferQueueConsumer;
 
@@ -75,7 +76,7 @@ public:
         NO_CONNECTED_API        = 0,
     };
 
-    typedef Vector<BufferItem> Fifo;
+    typedef RingQueue<BufferItem> Fifo;
 
     // BufferQueueCore manages a pool of gralloc memory slots to be used by
     // producers and consumers.
@@ -135,6 +136,75 @@ private:
     // waitWhileAllocatingLocked blocks until mIsAllocating is false.
     void waitWhileAllocatingLocked() const;
 
+    // The adaptive buffer count (see IGraphicBufferConsumer::
+    // setAdaptiveBufferCount) caps how many slots may hold a buffer: at
+    // double-buffering at first, growing by one each time the producer blocks
+    // on the cap kAdaptiveGrowBlocks times within kAdaptiveGrowWindow, and
+    // shrinking by one after kAdaptiveShrinkFrames frames in which no more
+    // than double-buffering was needed.
+    static constexpr int kAdaptiveGrowBlocks = 3;
+    static constexpr nsecs_t kAdaptiveGrowWindow = s2ns(1);
+    static constexpr size_t kAdaptiveShrinkFrames = 300;
+    // A producer never waits on the cap for longer than this; the cap grows
+    // instead.
+    static constexpr nsecs_t kAdaptiveMaxBlockTime = ms2ns(100);
+
+    // isAdaptiveBufferCountActiveLocked returns whether the adaptive buffer
+    // count currently limits allocation. It never does in async,
+    // non-blocking or shared buffer mode.
+    bool isAdaptiveBufferCountActiveLocked() const;
+
+    // getAdaptiveBufferLimitLocked returns how many slots may hold a buffer
+    // while the adaptive buffer count is active, which is always within
+    // [mMaxAcquiredBufferCount + 1, getMaxBufferCountLocked()].
+    int getAdaptiveBufferLimitLocked() const;
+
+    // getAllocatedBufferCountLocked returns how many slots hold, or are
+    // about to hold, a buffer.
+    int getAllocatedBufferCountLocked() const;
+
+    // onAdaptiveBufferLimitBlockedLocked records that the producer, holding
+    // dequeuedCount buffers, has to wait because of the adaptive cap. Returns
+    // true if the cap was raised instead, so the producer can try again.
+    bool onAdaptiveBufferLimitBlockedLocked(int dequeuedCount);
+
+    // growAdaptiveBufferLimitLocked raises the adaptive cap by one.
+    void growAdaptiveBufferLimitLocked();
+
+    // onBuffersInUseLocked records that inUse buffers are dequeued, queued
+    // or acquired at once, so that the cap is not lowered below that.
+    void onBuffersInUseLocked(int inUse);
+
+    // updateAdaptiveBufferLimitLocked lowers the adaptive cap when the
+    // producer has not needed more than double-buffering recently, and frees
+    // free buffers above the cap. Returns true if any buffer was freed.
+    bool updateAdaptiveBufferLimitLocked();
+
+    // resetAdaptiveBufferCountLocked restarts the adaptive buffer count from
+    // double-buffering.
+    void resetAdaptiveBufferCountLocked();
+
+    // allocateBuffers implements IGraphicBufferProducer::allocateBuffers. It
+    // allocates buffers outside of mMutex, one at a time, first replacing free
+    // buffers that do not match the requested attributes and then filling free
+    // slots, until no slot is left or the adaptive buffer count is reached.
+    void allocateBuffers(uint32_t width, uint32_t height, PixelFormat format,
+            uint64_t usage);
+
+    // getStaleFreeBufferLocked returns a free slot whose buffer would need to
+    // be reallocated for the given attributes, or INVALID_BUFFER_SLOT.
+    int getStaleFreeBufferLocked(uint32_t width, uint32_t height,
+            PixelFormat format, uint64_t usage) const;
+
+    // scheduleBufferPreallocationLocked asks BufferPreallocator to allocate
+    // buffers of the default size in the background, if the consumer enabled
+    // it and the producer dequeues default-sized buffers.
+    void scheduleBufferPreallocationLocked();
+
+    // preallocateBuffers is run by BufferPreallocator. It allocates buffers
+    // with the attributes of the producer's last dequeueBuffer call.
+    void preallocateBuffers();
+
 #if DEBUG_ONLY_CODE
     // validateConsistencyLocked ensures that the free lists are in sync with
     // the information stored in mSlots
@@ -203,18 +273,18 @@ private:
 
     // mFreeSlots contains all of the slots which are FREE and do not currently
     // have a buffer attached.
-    std::set<int> mFreeSlots;
+    BufferSlotSet mFreeSlots;
 
     // mFreeBuffers contains all of the slots which are FREE and currently have
     // a buffer attached.
-    std::list<int> mFreeBuffers;
+    RingQueue<int> mFreeBuffers;
 
     // mUnusedSlots contains all slots that are currently unused. They should be
     // free and not have a buffer attached.
-    std::list<int> mUnusedSlots;
+    RingQueue<int> mUnusedSlots;
 
     // mActiveBuffers contains all slots which have a non-FREE buffer attached.
-    std::set<int> mActiveBuffers;
+    BufferSlotSet mActiveBuffers;
 
     // mDequeueCondition is a condition variable used for dequeueBuffer in
     // synchronous mode.
@@ -334,6 +404,42 @@ private:
 
     OccupancyTracker mOccupancyTracker;
 
+    // mLatencyTracker aggregates dequeue wait, queue residency and
+    // acquire-to-release times. See IGraphicBufferConsumer::getLatencyStats.
+    LatencyTracker mLatencyTracker;
+
+    // mAdaptiveBufferCount is set by IGraphicBufferConsumer::
+    // setAdaptiveBufferCount.
+    bool mAdaptiveBufferCount;
+
+    // mAdaptiveBufferLimit is the adaptive cap on allocated slots before it is
+    // clamped by getAdaptiveBufferLimitLocked.
+    int mAdaptiveBufferLimit;
+
+    // The number of times the producer blocked on the adaptive cap since
+    // mAdaptiveBlockWindowStart.
+    int mAdaptiveBlockCount;
+    nsecs_t mAdaptiveBlockWindowStart;
+
+    // mBufferPreallocation is set by IGraphicBufferConsumer::
+    // setBufferPreallocation. mBufferPreallocationPending is true while a
+    // preallocation is scheduled but has not started running.
+    bool mBufferPreallocation;
+    bool mBufferPreallocationPending;
+
+    // The attributes of the last dequeueBuffer call, which
+    // preallocateBuffers allocates with. mLastDequeueUsedDefaultSize is
+    // false until the connected producer has dequeued a buffer of the
+    // default size.
+    PixelFormat mLastDequeueFormat;
+    uint64_t mLastDequeueUsage;
+    bool mLastDequeueUsedDefaultSize;
+
+    // mFrameEventsRequested is set once the connected producer queues a
+    // buffer asking for frame timestamps. Until then queueBuffer doesn't
+    // record frame events with the consumer at all.
+    bool mFrameEventsRequested;
+
     const uint64_t mUniqueId;
 
 }; // class BufferQueueCore
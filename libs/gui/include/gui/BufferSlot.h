@@ -182,7 +182,9 @@ struct BufferSlot {
       mEglFence(EGL_NO_SYNC_KHR),
       mFence(Fence::NO_FENCE),
       mAcquireCalled(false),
-      mNeedsReallocation(false) {
+      mNeedsReallocation(false),
+      mQueueTime(0),
+      mAcquireTime(0) {
     }
 
     // mGraphicBuffer points to the buffer allocated for this slot or is NULL
@@ -230,6 +232,11 @@ struct BufferSlot {
     // producer. If so, it needs to set the BUFFER_NEEDS_REALLOCATION flag when
     // dequeued to prevent the producer from using a stale cached buffer.
     bool mNeedsReallocation;
+
+    // mQueueTime and mAcquireTime are when the buffer was last queued and
+    // acquired, for the BufferQueue's LatencyTracker.
+    nsecs_t mQueueTime;
+    nsecs_t mAcquireTime;
 };
 
 } // namespace android
@@ -0,0 +1,70 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_GUI_BUFFERSLOTSET_H
+#define ANDROID_GUI_BUFFERSLOTSET_H
+
+#include <ui/BufferQueueDefs.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace android {
+
+// BufferSlotSet is a set of buffer slot indices kept as a bitmap, so it never
+// allocates. Like std::set<int>, it iterates in ascending order. Iterators walk
+// a copy of the bitmap, so the set may be modified while iterating over it.
+class BufferSlotSet {
+    static_assert(BufferQueueDefs::NUM_BUFFER_SLOTS <= 64, "slots must fit in the bitmap");
+
+public:
+    class const_iterator {
+    public:
+        int operator*() const { return __builtin_ctzll(mBits); }
+        const_iterator& operator++() {
+            mBits &= mBits - 1;
+            return *this;
+        }
+        bool operator==(const const_iterator& other) const { return mBits == other.mBits; }
+        bool operator!=(const const_iterator& other) const { return mBits != other.mBits; }
+
+    private:
+        friend class BufferSlotSet;
+        explicit const_iterator(uint64_t bits) : mBits(bits) {}
+        uint64_t mBits;
+    };
+
+    bool empty() const { return mBits == 0; }
+    size_t size() const { return static_cast<size_t>(__builtin_popcountll(mBits)); }
+    size_t count(int slot) const { return (mBits >> slot) & 1; }
+
+    // Returns the lowest slot in the set, which must not be empty
+    int first() const { return __builtin_ctzll(mBits); }
+
+    void insert(int slot) { mBits |= 1ULL << slot; }
+    void erase(int slot) { mBits &= ~(1ULL << slot); }
+    void clear() { mBits = 0; }
+
+    const_iterator begin() const { return const_iterator(mBits); }
+    const_iterator end() const { return const_iterator(0); }
+
+private:
+    uint64_t mBits = 0;
+};
+
+} // namespace android
+
+#endif
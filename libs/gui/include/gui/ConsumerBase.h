@@ -105,6 +105,9 @@ public:
     status_t getOccupancyHistory(bool forceFlush,
             std::vector<OccupancyTracker::Segment>* outHistory);
 
+    // See IGraphicBufferConsumer::getLatencyStats
+    status_t getLatencyStats(bool reset, LatencyTracker::Stats* outStats);
+
     // See IGraphicBufferConsumer::discardFreeBuffers
     status_t discardFreeBuffers();
 
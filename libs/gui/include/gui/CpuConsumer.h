@@ -111,6 +111,16 @@ class CpuConsumer : public ConsumerBase
     // lockNextBuffer.
     status_t unlockBuffer(const LockedBuffer &nativeBuffer);
 
+    // setPersistentMapping(true) keeps each buffer locked for CPU reading from
+    // the first time it is acquired until the BufferQueue frees it, instead of
+    // locking and unlocking it, with the cache maintenance that implies, for
+    // every frame. lockNextBuffer then only waits for the buffer's acquire
+    // fence and returns the pointers from the first lock. This suits consumers
+    // reading every frame of a producer whose writes are visible to the CPU
+    // without a new lock, such as a CPU producer or CPU-coherent gralloc
+    // memory. Returns INVALID_OPERATION if any buffer is currently locked.
+    status_t setPersistentMapping(bool enabled);
+
   private:
     // Maximum number of buffers that can be locked at a time
     const size_t mMaxLockedBuffers;
@@ -125,19 +135,37 @@ class CpuConsumer : public ConsumerBase
         int mSlot;
         sp<GraphicBuffer> mGraphicBuffer;
         uintptr_t mLockedBufferId;
+        // Set when the persistently mapped buffer's slot was freed while the
+        // user held it, so unlockBuffer has to unlock it
+        bool mUnlockOnRelease;
 
         AcquiredBuffer() :
                 mSlot(BufferQueue::INVALID_BUFFER_SLOT),
-                mLockedBufferId(kUnusedId) {
+                mLockedBufferId(kUnusedId),
+                mUnlockOnRelease(false) {
         }
 
         void reset() {
             mSlot = BufferQueue::INVALID_BUFFER_SLOT;
             mGraphicBuffer.clear();
             mLockedBufferId = kUnusedId;
+            mUnlockOnRelease = false;
         }
     };
 
+    // A buffer kept locked by setPersistentMapping, and what locking it
+    // returned
+    struct MappedBuffer {
+        sp<GraphicBuffer> mGraphicBuffer;
+        LockedBuffer mLockedBuffer;
+    };
+
+    // From ConsumerBase; unmaps the slot's buffer
+    void freeBufferLocked(int slotIndex) override;
+
+    status_t lockPersistentBufferLocked(const BufferItem& item, LockedBuffer* outBuffer);
+    void unmapBufferLocked(int slot);
+
     size_t findAcquiredBufferLocked(uintptr_t id) const;
 
     status_t lockBufferItem(const BufferItem& item, LockedBuffer* outBuffer) const;
@@ -146,6 +174,9 @@ class CpuConsumer : public ConsumerBase
 
     // Count of currently locked buffers
     size_t mCurrentLockedBuffers;
+
+    bool mPersistentMapping;
+    MappedBuffer mMappedBuffers[BufferQueue::NUM_BUFFER_SLOTS];
 };
 
 } // namespace android
@@ -115,6 +115,17 @@ public:
     ssize_t getEvents(Event* events, size_t count);
     static ssize_t getEvents(gui::BitTube* dataChannel, Event* events, size_t count);
 
+    /*
+     * getLatestVsync reads events like getEvents, but drains the queue and
+     * keeps only the newest Event::VSync, where it was read, so a receiver that fell behind doesn't handle stale vsyncs one by one.
+     * The number of older Event::VSync dropped in its favor is added to
+     * outDropped if it isn't null. Other events are kept in order; reading
+     * stops once count events are held, before any of them would be lost.
+     */
+    ssize_t getLatestVsync(Event* events, size_t count, uint32_t* outDropped);
+    static ssize_t getLatestVsync(gui::BitTube* dataChannel, Event* events, size_t count,
+            uint32_t* outDropped);
+
     /*
      * sendEvents write events to the queue and returns how many events were
      * written.
@@ -135,6 +146,13 @@ public:
      */
     status_t requestNextVsync();
 
+    /*
+     * setVsyncSchedule() only delivers the Event::VSync nearest to each
+     * phase + k * interval, e.g. every other one for a 30fps client on a
+     * 60Hz display. An interval of 0 delivers every Event::VSync again.
+     */
+    status_t setVsyncSchedule(nsecs_t interval, nsecs_t phase);
+
 private:
     sp<IDisplayEventConnection> mEventConnection;
     std::unique_ptr<gui::BitTube> mDataChannel;
@@ -267,6 +267,7 @@ public:
 
 private:
     static constexpr size_t minFlattenedSize();
+    size_t getScalarsFlattenedSize() const;
 
     size_t mIndex{0};
     uint64_t mFrameNumber{0};
@@ -295,6 +296,18 @@ private:
             &fed->mReleaseFence
         }};
     }
+
+    // The posted time comes first since the other timestamps are
+    // flattened relative to it.
+    template <typename ThisT>
+    static inline auto allTimes(ThisT fed) ->
+            std::array<decltype(&fed->mPostedTime), 6> {
+        return {{
+            &fed->mPostedTime, &fed->mRequestedPresentTime,
+            &fed->mLatchTime, &fed->mFirstRefreshStartTime,
+            &fed->mLastRefreshStartTime, &fed->mDequeueReadyTime
+        }};
+    }
 };
 
 
@@ -303,11 +303,18 @@ private:
         EglImage(sp<GraphicBuffer> graphicBuffer);
 
         // createIfNeeded creates an EGLImage if required (we haven't created
-        // one yet, or the EGLDisplay or crop-rect has changed).
+        // one yet, or the EGLDisplay or the part of the crop-rect EGL can
+        // apply has changed).
         status_t createIfNeeded(EGLDisplay display,
                                 const Rect& cropRect,
                                 bool forceCreate = false);
 
+        // createIfNeeded for a new EGLDisplay, keeping the crop-rect of the
+        // last image.
+        status_t createIfNeeded(EGLDisplay display) {
+            return createIfNeeded(display, mCropRect);
+        }
+
         // This calls glEGLImageTargetTexture2DOES to bind the image to the
         // texture in the specified texture target.
         void bindToTextureTarget(uint32_t texTarget);
@@ -340,10 +347,15 @@ private:
         EGLDisplay mEglDisplay;
 
         // mCropRect is the crop rectangle passed to EGL when mEglImage
-        // was created.
+        // was created, or an invalid rectangle if none was.
         Rect mCropRect;
     };
 
+    // createSlotImagesLocked creates the EGLImages of all the buffers the
+    // slots hold for the current EGLDisplay, so that attaching to a context
+    // on another display doesn't leave it to the next frame of each buffer.
+    void createSlotImagesLocked();
+
     // freeBufferLocked frees up the given buffer slot. If the slot has been
     // initialized this will release the reference to the GraphicBuffer in that
     // slot and destroy the EGLImage in that slot.  Otherwise it has no effect.
@@ -20,6 +20,7 @@
 #include <binder/SafeInterface.h>
 
 #include <utils/Errors.h>
+#include <utils/Timers.h>
 
 #include <cstdint>
 
@@ -47,6 +48,14 @@ public:
      */
     virtual status_t setVsyncRate(uint32_t count) = 0;
 
+    /*
+     * setVsyncSchedule() limits vsync events to the ones nearest to phase + k * interval (in
+     * CLOCK_MONOTONIC nanoseconds), so a client rendering below the display refresh rate is not
+     * woken up for frames it would skip. It applies to both the vsync rate and
+     * requestNextVsync(). An interval of 0 delivers every vsync again.
+     */
+    virtual status_t setVsyncSchedule(nsecs_t interval, nsecs_t phase) = 0;
+
     /*
      * requestNextVsync() schedules the next vsync event. It has no effect if the vsync rate is > 0.
      */
@@ -16,6 +16,7 @@
 
 #pragma once
 
+#include <gui/LatencyTracker.h>
 #include <gui/OccupancyTracker.h>
 
 #include <binder/IInterface.h>
@@ -264,6 +265,11 @@ public:
     virtual status_t getOccupancyHistory(bool forceFlush,
                                          std::vector<OccupancyTracker::Segment>* outHistory) = 0;
 
+    // Retrieves how long buffers have spent waiting to be dequeued, sitting in the queue and held
+    // by the consumer, aggregated since the BufferQueue was created or since the last call with
+    // reset set to true.
+    virtual status_t getLatencyStats(bool reset, LatencyTracker::Stats* outStats) = 0;
+
     // discardFreeBuffers releases all currently-free buffers held by the BufferQueue, in order to
     // reduce the memory consumption of the BufferQueue to the minimum possible without
     // discarding data.
@@ -271,6 +277,22 @@ public:
     // call to free up any of its locally cached buffers.
     virtual status_t discardFreeBuffers() = 0;
 
+    // setAdaptiveBufferCount lets the BufferQueue size its pool from the observed queue
+    // occupancy instead of always allocating as many buffers as the producer's maximum dequeued
+    // buffer count allows. While enabled, a producer that keeps up with the consumer is held to
+    // double-buffering, and the pool grows one buffer at a time, up to the full count, when the
+    // producer repeatedly blocks waiting for a buffer. It has no effect in async, non-blocking
+    // or shared buffer mode. When the pool shrinks, the consumer's listener is told through
+    // onBuffersReleased. The default is disabled.
+    virtual status_t setAdaptiveBufferCount(bool enabled) = 0;
+
+    // setBufferPreallocation makes the BufferQueue allocate buffers of the new default size on a
+    // background thread whenever setDefaultBufferSize changes it, so that a producer dequeuing
+    // default-sized buffers after a resize does not have to wait for the allocation itself. The
+    // buffers use the format and usage of the producer's last dequeueBuffer call, and replace
+    // free buffers of the old size. The default is disabled.
+    virtual status_t setBufferPreallocation(bool enabled) = 0;
+
     // dump state into a string
     virtual status_t dumpState(const String8& prefix, String8* outResult) const = 0;
 
@@ -20,6 +20,8 @@
 #include <stdint.h>
 #include <sys/types.h>
 
+#include <vector>
+
 #include <utils/Errors.h>
 #include <utils/RefBase.h>
 
@@ -613,6 +615,61 @@ public:
     // NATIVE_WINDOW_CONSUMER_USAGE_BITS attribute.
     virtual status_t getConsumerUsage(uint64_t* outUsage) const = 0;
 
+    // Arguments of a single dequeueBuffer call, see dequeueBuffers.
+    struct DequeueBufferInput {
+        uint32_t width{0};
+        uint32_t height{0};
+        PixelFormat format{0};
+        uint64_t usage{0};
+        bool getTimestamps{false};
+    };
+
+    // Results of a single dequeueBuffer call, see dequeueBuffers. timestamps
+    // is only filled in when the matching input set getTimestamps.
+    struct DequeueBufferOutput {
+        DequeueBufferOutput() = default;
+
+        // Moveable.
+        DequeueBufferOutput(DequeueBufferOutput&& src) = default;
+        DequeueBufferOutput& operator=(DequeueBufferOutput&& src) = default;
+        // Not copyable.
+        DequeueBufferOutput(const DequeueBufferOutput& src) = delete;
+        DequeueBufferOutput& operator=(const DequeueBufferOutput& src) = delete;
+
+        int slot{-1};
+        sp<Fence> fence{Fence::NO_FENCE};
+        uint64_t bufferAge{0};
+        FrameEventHistoryDelta timestamps;
+        status_t result{NO_ERROR};
+    };
+
+    // dequeueBuffers performs one dequeueBuffer per input, in order, within a
+    // single transaction. outputs receives the result of each call; it stops
+    // after the first call that returns an error, so it may be shorter than
+    // inputs, and its last element then holds that error. The default
+    // implementation simply calls dequeueBuffer in a loop.
+    //
+    // Returns NO_ERROR or the status of the Binder transaction.
+    virtual status_t dequeueBuffers(const std::vector<DequeueBufferInput>& inputs,
+                                    std::vector<DequeueBufferOutput>* outputs);
+
+    // A slot to queue together with its queueBuffer input, see queueBuffers.
+    struct QueuedBuffer {
+        int slot;
+        QueueBufferInput input;
+    };
+
+    // queueBuffers performs one queueBuffer per buffer, in order, within a
+    // single transaction. Unlike dequeueBuffers, a failure to queue one
+    // buffer does not stop the others: outputs and results always get one
+    // entry per buffer, holding what that queueBuffer call returned. The
+    // default implementation simply calls queueBuffer in a loop.
+    //
+    // Returns NO_ERROR or the status of the Binder transaction.
+    virtual status_t queueBuffers(const std::vector<QueuedBuffer>& buffers,
+                                  std::vector<QueueBufferOutput>* outputs,
+                                  std::vector<status_t>* results);
+
     // Static method exports any IGraphicBufferProducer object to a parcel. It
     // handles null producer as well.
     static status_t exportToParcel(const sp<IGraphicBufferProducer>& producer,
@@ -176,6 +176,10 @@ public:
 
     /* Capture the specified screen. requires READ_FRAME_BUFFER permission
      * This function will fail if there is a secure window on screen.
+     *
+     * If *outBuffer already holds an RGBA_8888 buffer of the requested size
+     * that can be rendered to, the capture is rendered into it and it is
+     * returned as is. Otherwise a new buffer is allocated.
      */
     virtual status_t captureScreen(const sp<IBinder>& display, sp<GraphicBuffer>* outBuffer,
                                    Rect sourceCrop, uint32_t reqWidth, uint32_t reqHeight,
@@ -184,6 +188,8 @@ public:
 
     /**
      * Capture a subtree of the layer hierarchy, potentially ignoring the root node.
+     * sourceCrop is rendered directly at frameScale. *outBuffer is reused as
+     * for captureScreen().
      */
     virtual status_t captureLayers(const sp<IBinder>& layerHandleBinder,
                                    sp<GraphicBuffer>* outBuffer, const Rect& sourceCrop,
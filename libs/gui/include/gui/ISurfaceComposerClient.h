@@ -24,6 +24,7 @@ namespace android {
 
 class FrameStats;
 class IGraphicBufferProducer;
+class NativeHandle;
 
 class ISurfaceComposerClient : public IInterface {
 public:
@@ -67,6 +68,23 @@ public:
      * Requires ACCESS_SURFACE_FLINGER permission
      */
     virtual status_t getLayerFrameStats(const sp<IBinder>& handle, FrameStats* outStats) const = 0;
+
+    /*
+     * Creates the shared memory ring through which this client may send transactions without
+     * a binder call, returned as a TransactionChannel handle. outHandle holds no file
+     * descriptors if SurfaceFlinger doesn't accept transactions that way.
+     *
+     * Requires ACCESS_SURFACE_FLINGER permission
+     */
+    virtual status_t createTransactionChannel(sp<NativeHandle>* outHandle) = 0;
+
+    /*
+     * Returns the id that stands for the layer behind handle in records written to the
+     * transaction channel.
+     *
+     * Requires ACCESS_SURFACE_FLINGER permission
+     */
+    virtual status_t getLayerChannelId(const sp<IBinder>& handle, int32_t* outId) const = 0;
 };
 
 class BnSurfaceComposerClient : public SafeBnInterface<ISurfaceComposerClient> {
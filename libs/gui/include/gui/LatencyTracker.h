@@ -0,0 +1,82 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_GUI_LATENCYTRACKER_H
+#define ANDROID_GUI_LATENCYTRACKER_H
+
+#include <binder/Parcelable.h>
+
+#include <utils/Timers.h>
+
+namespace android {
+
+class String8;
+
+// LatencyTracker aggregates how long buffers spend in each stage of a
+// BufferQueue, so that back-pressure can be located without a trace.
+class LatencyTracker
+{
+public:
+    // Count, total and maximum of one kind of interval.
+    struct Stat {
+        Stat() : count(0), totalTime(0), maxTime(0) {}
+
+        void add(nsecs_t duration);
+        nsecs_t averageTime() const {
+            return count > 0 ? totalTime / static_cast<nsecs_t>(count) : 0;
+        }
+
+        uint64_t count;
+        nsecs_t totalTime;
+        nsecs_t maxTime;
+    };
+
+    struct Stats : public Parcelable {
+        // Parcelable interface
+        virtual status_t writeToParcel(Parcel* parcel) const override;
+        virtual status_t readFromParcel(const Parcel* parcel) override;
+
+        // Time dequeueBuffer spent waiting for a free buffer. Every dequeue
+        // is counted, including the ones that did not have to wait.
+        Stat dequeueWait;
+
+        // Time buffers sat in the queue between queueBuffer and
+        // acquireBuffer. Buffers that were dropped or replaced before being
+        // acquired are not counted.
+        Stat queueResidency;
+
+        // Time the consumer held buffers between acquireBuffer and
+        // releaseBuffer.
+        Stat acquireToRelease;
+    };
+
+    void registerDequeueWait(nsecs_t duration) { mStats.dequeueWait.add(duration); }
+    void registerQueueResidency(nsecs_t duration) { mStats.queueResidency.add(duration); }
+    void registerAcquireToRelease(nsecs_t duration) { mStats.acquireToRelease.add(duration); }
+
+    // Returns the stats gathered so far, clearing them if reset is true.
+    Stats getStats(bool reset);
+
+    void dump(const String8& prefix, String8* outResult) const;
+
+private:
+    Stats mStats;
+
+}; // class LatencyTracker
+
+} // namespace android
+
+#endif
@@ -36,7 +36,8 @@ public:
       : mPendingSegment(),
         mSegmentHistory(),
         mLastOccupancy(0),
-        mLastOccupancyChangeTime(0) {}
+        mLastOccupancyChangeTime(0),
+        mFramesWithoutThirdBuffer(0) {}
 
     struct Segment : public Parcelable {
         Segment()
@@ -72,6 +73,12 @@ public:
     void registerOccupancyChange(size_t occupancy);
     std::vector<Segment> getSegmentHistory(bool forceFlush);
 
+    // Number of frames queued since the queue last held more than one buffer,
+    // or since resetFramesWithoutThirdBuffer was called. Unlike the segment
+    // history, this is not cleared by getSegmentHistory.
+    size_t getFramesWithoutThirdBuffer() const { return mFramesWithoutThirdBuffer; }
+    void resetFramesWithoutThirdBuffer() { mFramesWithoutThirdBuffer = 0; }
+
 private:
     static constexpr size_t MAX_HISTORY_SIZE = 10;
     static constexpr nsecs_t NEW_SEGMENT_DELAY = ms2ns(100);
@@ -96,6 +103,7 @@ private:
 
     size_t mLastOccupancy;
     nsecs_t mLastOccupancyChangeTime;
+    size_t mFramesWithoutThirdBuffer;
 
 }; // class OccupancyTracker
 
@@ -0,0 +1,160 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_GUI_RINGQUEUE_H
+#define ANDROID_GUI_RINGQUEUE_H
+
+#include <stddef.h>
+
+#include <utility>
+#include <vector>
+
+namespace android {
+
+// RingQueue is a double-ended queue stored in a ring of reused elements. It
+// only allocates when it grows past its largest size so far (or reserve()), so
+// once a queue has reached its working size, pushing and popping never
+// allocates. Popped elements are reset to T() so they don't keep references
+// alive.
+template <typename T>
+class RingQueue {
+    template <typename Queue, typename Value>
+    class Iterator {
+    public:
+        Value& operator*() const { return (*mQueue)[mIndex]; }
+        Value* operator->() const { return &(*mQueue)[mIndex]; }
+        Iterator& operator++() {
+            mIndex++;
+            return *this;
+        }
+        bool operator==(const Iterator& other) const { return mIndex == other.mIndex; }
+        bool operator!=(const Iterator& other) const { return mIndex != other.mIndex; }
+
+    private:
+        friend class RingQueue;
+        Iterator(Queue* queue, size_t index) : mQueue(queue), mIndex(index) {}
+        Queue* mQueue;
+        size_t mIndex;
+    };
+
+public:
+    typedef Iterator<RingQueue, T> iterator;
+    typedef Iterator<const RingQueue, const T> const_iterator;
+
+    void reserve(size_t capacity) {
+        if (capacity > mSlots.size()) {
+            regrow(capacity);
+        }
+    }
+
+    bool empty() const { return mSize == 0; }
+    size_t size() const { return mSize; }
+
+    // i-th element from the front
+    const T& operator[](size_t i) const { return mSlots[(mHead + i) % mSlots.size()]; }
+    T& operator[](size_t i) { return mSlots[(mHead + i) % mSlots.size()]; }
+
+    const T& front() const { return (*this)[0]; }
+    T& front() { return (*this)[0]; }
+    const T& back() const { return (*this)[mSize - 1]; }
+    T& back() { return (*this)[mSize - 1]; }
+
+    void push_back(const T& value) {
+        growIfFull();
+        mSize++;
+        back() = value;
+    }
+
+    void push_front(const T& value) {
+        growIfFull();
+        mHead = (mHead + mSlots.size() - 1) % mSlots.size();
+        mSize++;
+        front() = value;
+    }
+
+    void pop_front() {
+        front() = T();
+        mHead = (mHead + 1) % mSlots.size();
+        mSize--;
+    }
+
+    void pop_back() {
+        back() = T();
+        mSize--;
+    }
+
+    void clear() {
+        while (!empty()) {
+            pop_back();
+        }
+        mHead = 0;
+    }
+
+    bool contains(const T& value) const {
+        for (size_t i = 0; i < mSize; i++) {
+            if ((*this)[i] == value) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Removes all elements equal to value, keeping the others in order
+    void remove(const T& value) {
+        size_t kept = 0;
+        for (size_t i = 0; i < mSize; i++) {
+            if (!((*this)[i] == value)) {
+                if (kept != i) {
+                    (*this)[kept] = std::move((*this)[i]);
+                }
+                kept++;
+            }
+        }
+        while (mSize > kept) {
+            pop_back();
+        }
+    }
+
+    iterator begin() { return iterator(this, 0); }
+    iterator end() { return iterator(this, mSize); }
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, mSize); }
+
+private:
+    void growIfFull() {
+        if (mSize == mSlots.size()) {
+            regrow(mSlots.empty() ? 1 : mSlots.size() * 2);
+        }
+    }
+
+    void regrow(size_t capacity) {
+        // rotate the used elements to the start so the new ones follow them
+        std::vector<T> slots(capacity);
+        for (size_t i = 0; i < mSize; i++) {
+            slots[i] = std::move((*this)[i]);
+        }
+        mSlots.swap(slots);
+        mHead = 0;
+    }
+
+    std::vector<T> mSlots;
+    size_t mHead = 0;
+    size_t mSize = 0;
+};
+
+} // namespace android
+
+#endif
@@ -63,6 +63,29 @@ public:
     // of other error codes.
     status_t addOutput(const sp<IGraphicBufferProducer>& outputQueue);
 
+    // SlowOutputPolicy decides what happens to a new input frame when an
+    // output's consumer already holds as many of the splitter's buffers as its
+    // queue depth allows.
+    enum class SlowOutputPolicy {
+        // Wait for the output to release a buffer before acquiring more from
+        // the input, which slows down the input's producer and every other
+        // output. This is what addOutput(outputQueue) uses.
+        THROTTLE,
+        // Don't give the new frame to this output, so that it never holds back
+        // the others. The output queue is also put in async mode, so that a
+        // frame it has not acquired yet is replaced by the next one instead of
+        // going stale.
+        DROP_FRAMES,
+    };
+
+    // This addOutput variant lets each output have its own queue depth (the
+    // number of buffers queued to or acquired from it at once, which must be
+    // at least 1) and policy for when that depth is reached. With
+    // SlowOutputPolicy::DROP_FRAMES, the splitter runs at the rate of its
+    // fastest output instead of its slowest one.
+    status_t addOutput(const sp<IGraphicBufferProducer>& outputQueue,
+            SlowOutputPolicy policy, size_t maxQueueDepth);
+
     // setName sets the consumer name of the input queue
     void setName(const String8& name);
 
@@ -97,6 +120,25 @@ private:
     // onFrameAvailable call to proceed.
     void onBufferReleasedByOutput(const sp<IGraphicBufferProducer>& from);
 
+    class BufferTracker;
+
+    // onBufferDetachedLocked records that buffer, released with fence, has
+    // been detached from the output at outputIndex, and returns it to the
+    // input once every output is done with it. This must be called with mMutex
+    // locked.
+    void onBufferDetachedLocked(size_t outputIndex, const sp<GraphicBuffer>& buffer,
+            const sp<Fence>& fence);
+
+    // onOutputDoneLocked counts one output as done with the buffer tracked by
+    // tracker, and returns the buffer to the input if it was the last one.
+    // This must be called with mMutex locked.
+    void onOutputDoneLocked(const sp<BufferTracker>& tracker);
+
+    // isThrottledLocked returns whether a new input frame has to wait, either
+    // because the splitter holds too many buffers or because a throttling
+    // output is at its queue depth. This must be called with mMutex locked.
+    bool isThrottledLocked() const;
+
     // When this is called, the splitter disconnects from (i.e., abandons) its
     // input queue and signals any waiting onFrameAvailable calls to wake up.
     // It still processes callbacks from other outputs, but only detaches their
@@ -131,9 +173,12 @@ private:
         BufferTracker(const sp<GraphicBuffer>& buffer);
 
         const sp<GraphicBuffer>& getBuffer() const { return mBuffer; }
-        const sp<Fence>& getMergedFence() const { return mMergedFence; }
 
-        void mergeFence(const sp<Fence>& with);
+        // Release fences are collected as the outputs release the buffer and
+        // only merged once, when it is returned to the input. Fences that have
+        // already signaled are dropped instead of being merged.
+        void addReleaseFence(const sp<Fence>& fence);
+        sp<Fence> getMergedFence() const;
 
         // Returns the new value
         // Only called while mMutex is held
@@ -149,7 +194,7 @@ private:
         BufferTracker& operator=(const BufferTracker& other);
 
         sp<GraphicBuffer> mBuffer; // One instance that holds this native handle
-        sp<Fence> mMergedFence;
+        Vector<sp<Fence> > mReleaseFences;
         size_t mReleaseCount;
     };
 
@@ -159,7 +204,7 @@ private:
     // Must be accessed through RefBase
     virtual ~StreamSplitter();
 
-    static const int MAX_OUTSTANDING_BUFFERS = 2;
+    static const size_t MAX_OUTSTANDING_BUFFERS = 2;
 
     // mIsAbandoned is set to true when an output dies. Once the StreamSplitter
     // has been abandoned, it will continue to detach buffers from other
@@ -169,9 +214,21 @@ private:
 
     Mutex mMutex;
     Condition mReleaseCondition;
-    int mOutstandingBuffers;
+    size_t mOutstandingBuffers;
     sp<IGraphicBufferConsumer> mInput;
-    Vector<sp<IGraphicBufferProducer> > mOutputs;
+
+    struct Output {
+        sp<IGraphicBufferProducer> producer;
+        SlowOutputPolicy policy;
+        size_t maxQueueDepth;
+        // The number of buffers currently queued to or acquired from this
+        // output
+        size_t queueDepth;
+    };
+    Vector<Output> mOutputs;
+
+    // The most buffers the splitter may hold at once; see isThrottledLocked
+    size_t mMaxOutstandingBuffers;
 
     // Map of GraphicBuffer IDs (GraphicBuffer::getId()) to buffer tracking
     // objects (which are mostly for counting how many outputs have released the
@@ -31,6 +31,9 @@
 
 #include <system/window.h>
 
+#include <deque>
+#include <unordered_map>
+
 namespace android {
 
 class ISurfaceComposer;
@@ -229,6 +232,7 @@ private:
     int dispatchGetWideColorSupport(va_list args);
     int dispatchGetHdrSupport(va_list args);
     int dispatchGetConsumerUsage64(va_list args);
+    int dispatchSetBuffersState(va_list args);
 
 protected:
     virtual int dequeueBuffer(ANativeWindowBuffer** buffer, int* fenceFd);
@@ -250,6 +254,7 @@ protected:
     virtual int setBuffersSmpte2086Metadata(const android_smpte2086_metadata* metadata);
     virtual int setBuffersCta8613Metadata(const android_cta861_3_metadata* metadata);
     virtual int setCrop(Rect const* rect);
+    virtual int setBuffersState(const native_window_buffers_state& state);
     virtual int setUsage(uint64_t reqUsage);
     virtual void setSurfaceDamage(android_native_rect_t* rects, size_t numRects);
 
@@ -280,6 +285,28 @@ public:
             sp<Fence>* outFence);
     virtual int attachBuffer(ANativeWindowBuffer*);
 
+    // Batched versions of dequeueBuffer and queueBuffer for producers that
+    // handle several buffers at a time. They cost a single transaction with
+    // the IGraphicBufferProducer and one acquisition of the Surface lock for
+    // the whole batch. Neither is supported in shared buffer mode.
+    struct BatchBuffer {
+        ANativeWindowBuffer* buffer = nullptr;
+        int fenceFd = -1;
+    };
+    // Dequeues buffers->size() buffers. Either all of them are dequeued, or
+    // none are and an error is returned.
+    virtual int dequeueBuffers(std::vector<BatchBuffer>* buffers);
+
+    struct BatchQueuedBuffer {
+        ANativeWindowBuffer* buffer = nullptr;
+        int fenceFd = -1;
+        int64_t timestamp = NATIVE_WINDOW_TIMESTAMP_AUTO;
+    };
+    // Queues the buffers in order, using the current crop, transform, damage
+    // and other buffer state for each of them. The buffers that can be
+    // queued are, even if another one fails; the last error is returned.
+    virtual int queueBuffers(const std::vector<BatchQueuedBuffer>& buffers);
+
     // When client connects to Surface with reportBufferRemoval set to true, any buffers removed
     // from this Surface will be collected and returned here. Once this method returns, these
     // buffers will no longer be referenced by this Surface unless they are attached to this
@@ -297,9 +324,20 @@ protected:
 
     void querySupportedTimestampsLocked() const;
 
+    // Drops the cached consumer properties, see mCachedQueries.
+    void invalidateQueryCacheLocked();
+    static bool isCacheableQuery(int what);
+
     void freeAllBuffers();
     int getSlotFromBufferLocked(android_native_buffer_t* buffer) const;
 
+    void getDequeueBufferInputLocked(IGraphicBufferProducer::DequeueBufferInput* dequeueInput);
+    IGraphicBufferProducer::QueueBufferInput getQueueBufferInputLocked(
+            android_native_buffer_t* buffer, const sp<Fence>& fence,
+            int64_t requestedTimestamp);
+    void onBufferQueuedLocked(int slot, sp<Fence> fence,
+            const IGraphicBufferProducer::QueueBufferOutput& output);
+
     struct BufferSlot {
         sp<GraphicBuffer> buffer;
         Region dirtyRegion;
@@ -401,6 +439,20 @@ protected:
     // one buffer behind the producer.
     mutable bool mConsumerRunningBehind;
 
+    // Consumer properties the producer only learns over binder, which rarely
+    // change once a producer is connected. They are cached until a connect,
+    // a disconnect or a dequeue that reallocates a buffer, which is when a
+    // change in the consumer shows. query() reads them without the lock, so
+    // it only caches a value if mQueryCacheGeneration hasn't moved meanwhile.
+    mutable std::unordered_map<int, int> mCachedQueries;
+    mutable bool mHasCachedConsumerUsage = false;
+    mutable uint64_t mCachedConsumerUsage = 0;
+    uint32_t mQueryCacheGeneration = 0;
+
+    // Whether the producer queues to SurfaceFlinger, which never changes
+    // for a Surface; -1 until SurfaceFlinger was asked.
+    mutable int mQueuesToWindowComposer = -1;
+
     // mMutex is the mutex used to prevent concurrent access to the member
     // variables of Surface objects. It must be locked whenever the
     // member variables are accessed.
@@ -411,6 +463,12 @@ protected:
     sp<GraphicBuffer>           mPostedBuffer;
     bool                        mConnectedToCpu;
 
+    // The regions repainted by the most recently posted CPU frames, newest
+    // first. lock() combines these with the buffer age to copy back only
+    // the parts of the back buffer that are stale.
+    static constexpr size_t MAX_POSTED_DAMAGE = 4;
+    std::deque<Region>          mPostedDamage;
+
     // When a CPU producer is attached, this reflects the region that the
     // producer wished to update as well as whether the Surface was able to copy
     // the previous buffer back to allow a partial update.
@@ -46,6 +46,7 @@ class HdrCapabilities;
 class ISurfaceComposerClient;
 class IGraphicBufferProducer;
 class Region;
+class TransactionChannel;
 
 // ---------------------------------------------------------------------------
 
@@ -300,10 +301,21 @@ public:
 private:
     virtual void onFirstRef();
 
+    // Writes the layer states of a transaction to the transaction channel, returning false if
+    // they have to be sent over binder instead.
+    bool writeToTransactionChannel(
+            const std::unordered_map<sp<SurfaceControl>, ComposerState, SCHash>& states);
+    int32_t getChannelLayerId(const sp<SurfaceControl>& control) const;
+
     mutable     Mutex                       mLock;
                 status_t                    mStatus;
                 sp<ISurfaceComposerClient>  mClient;
                 wp<IGraphicBufferProducer>  mParent;
+
+    // serializes writes to the channel, which is created on first use
+                Mutex                       mChannelLock;
+                sp<TransactionChannel>      mTransactionChannel;
+                bool                        mTransactionChannelRefused = false;
 };
 
 // ---------------------------------------------------------------------------
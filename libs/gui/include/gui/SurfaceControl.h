@@ -102,6 +102,8 @@ private:
     mutable Mutex               mLock;
     mutable sp<Surface>         mSurfaceData;
     bool                        mOwned;
+    // id of the layer in transaction channel records, -1 until it was asked for
+    int32_t                     mChannelLayerId = -1;
 };
 
 }; // namespace android
@@ -0,0 +1,58 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_PRIVATE_GUI_BUFFER_PREALLOCATOR_H
+#define ANDROID_PRIVATE_GUI_BUFFER_PREALLOCATOR_H
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include <utils/RefBase.h>
+#include <utils/Singleton.h>
+
+namespace android {
+
+class BufferQueueCore;
+
+// BufferPreallocator allocates buffers for BufferQueues on a background thread,
+// so that a producer dequeuing after a resize finds buffers of the new size in
+// the free slots instead of allocating them itself. A single thread, started on
+// first use, serves every BufferQueue in the process.
+class BufferPreallocator : public Singleton<BufferPreallocator> {
+public:
+    // Runs core->preallocateBuffers() on the background thread, unless core
+    // is destroyed first.
+    void schedule(const wp<BufferQueueCore>& core);
+
+private:
+    friend class Singleton<BufferPreallocator>;
+    BufferPreallocator() = default;
+    ~BufferPreallocator();
+
+    void threadMain();
+
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+    std::deque<wp<BufferQueueCore>> mPending;
+    std::thread mThread;
+    bool mDone = false;
+};
+
+}; // namespace android
+
+#endif // ANDROID_PRIVATE_GUI_BUFFER_PREALLOCATOR_H
@@ -0,0 +1,110 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_PRIVATE_GUI_TRANSACTION_CHANNEL_H
+#define ANDROID_PRIVATE_GUI_TRANSACTION_CHANNEL_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <vector>
+
+#include <gui/LayerState.h>
+
+#include <utils/Errors.h>
+#include <utils/NativeHandle.h>
+#include <utils/RefBase.h>
+
+namespace android {
+
+// TransactionChannel is a ring of transaction records in memory shared between one
+// SurfaceComposerClient, which writes it, and SurfaceFlinger, which reads it. It lets a client
+// that sends small transactions every frame skip the binder call: SurfaceFlinger creates the
+// ring, hands it to the client through ISurfaceComposerClient, and drains it before applying
+// the transactions it receives over binder.
+//
+// The writer only signals the eventfd when the reader has drained the ring since the last
+// signal, so a client writing several transactions per frame wakes SurfaceFlinger once.
+//
+// The reader doesn't trust the offset the writer moves or the lengths it writes: anything out
+// of range breaks the ring, after which reads and writes fail with -EPIPE.
+//
+// Each record is a Parcel holding the number of layer states in the transaction followed by,
+// for each one, the layer's id from ISurfaceComposerClient::getLayerChannelId() and the
+// layer_state_t parceled without its surface. Records can't hold binders, so states with any
+// of BINDER_CHANGES go over binder.
+class TransactionChannel : public RefBase {
+public:
+    static constexpr uint32_t BINDER_CHANGES = layer_state_t::eDeferTransaction |
+            layer_state_t::eReparentChildren | layer_state_t::eRelativeLayerChanged |
+            layer_state_t::eReparent;
+
+    // Creates a ring with room for capacity bytes of records.
+    static sp<TransactionChannel> create(size_t capacity);
+
+    // Maps the ring passed in handle, as returned by getHandle().
+    static sp<TransactionChannel> fromHandle(const sp<NativeHandle>& handle);
+
+    ~TransactionChannel() override;
+
+    // Returns a handle holding duplicates of the ring's file descriptors.
+    sp<NativeHandle> getHandle() const;
+
+    // Readable once the writer signalled new records.
+    int getEventFd() const;
+
+    // --- writer ---
+
+    // Writes one record and wakes the reader if needed. Returns -EAGAIN if the record doesn't
+    // fit, in which case it should be sent some other way.
+    status_t write(const void* data, size_t size);
+
+    // --- reader ---
+
+    // Lets the next write signal the eventfd again. Call it before reading the records, so a
+    // record written after the last read is never left without a signal.
+    void clearSignal();
+
+    // Reads the oldest record into outRecord, returning NOT_ENOUGH_DATA if there are none.
+    status_t read(std::vector<uint8_t>* outRecord);
+
+private:
+    struct Control;
+
+    TransactionChannel(int memoryFd, int eventFd);
+    bool map();
+    bool getDistance(uint32_t writeOffset, uint32_t readOffset, size_t* outSize) const;
+    uint32_t advance(uint32_t offset, size_t size) const;
+    void copyIn(uint32_t offset, const void* data, size_t size);
+    void copyOut(uint32_t offset, void* data, size_t size) const;
+
+    int mMemoryFd;
+    int mEventFd;
+    void* mBase = nullptr;
+    size_t mSize = 0;
+    size_t mCapacity = 0;
+    Control* mControl = nullptr;
+    uint8_t* mData = nullptr;
+
+    // Each side's own offset, which the shared copy only mirrors
+    uint32_t mWriteOffset = 0;
+    uint32_t mReadOffset = 0;
+    bool mBroken = false;
+};
+
+}; // namespace android
+
+#endif // ANDROID_PRIVATE_GUI_TRANSACTION_CHANNEL_H
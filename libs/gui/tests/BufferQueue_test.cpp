@@ -998,6 +998,57 @@ TEST_F(BufferQueueTest, TestOccupancyHistory) {
     ASSERT_EQ(true, thirdSegment.usedThirdBuffer);
 }
 
+TEST_F(BufferQueueTest, TestLatencyStats) {
+    createBufferQueue();
+    sp<DummyConsumer> dc(new DummyConsumer);
+    ASSERT_EQ(OK, mConsumer->consumerConnect(dc, false));
+    IGraphicBufferProducer::QueueBufferOutput output;
+    ASSERT_EQ(OK, mProducer->connect(new DummyProducerListener,
+            NATIVE_WINDOW_API_CPU, false, &output));
+
+    int slot = BufferQueue::INVALID_BUFFER_SLOT;
+    sp<Fence> fence = Fence::NO_FENCE;
+    sp<GraphicBuffer> buffer = nullptr;
+    IGraphicBufferProducer::QueueBufferInput input(0ull, true,
+        HAL_DATASPACE_UNKNOWN, Rect::INVALID_RECT,
+        NATIVE_WINDOW_SCALING_MODE_FREEZE, 0, Fence::NO_FENCE);
+    BufferItem item{};
+
+    for (size_t i = 0; i < 3; ++i) {
+        status_t result = mProducer->dequeueBuffer(&slot, &fence, 0, 0, 0, 0, nullptr, nullptr);
+        ASSERT_TRUE(result == OK ||
+                result == IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION);
+        if (result == IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION) {
+            ASSERT_EQ(OK, mProducer->requestBuffer(slot, &buffer));
+        }
+        ASSERT_EQ(OK, mProducer->queueBuffer(slot, input, &output));
+        std::this_thread::sleep_for(2ms);
+        ASSERT_EQ(OK, mConsumer->acquireBuffer(&item, 0));
+        std::this_thread::sleep_for(4ms);
+        ASSERT_EQ(OK, mConsumer->releaseBuffer(item.mSlot, item.mFrameNumber,
+                EGL_NO_DISPLAY, EGL_NO_SYNC_KHR, Fence::NO_FENCE));
+    }
+
+    LatencyTracker::Stats stats;
+    ASSERT_EQ(OK, mConsumer->getLatencyStats(true, &stats));
+    EXPECT_EQ(3u, stats.dequeueWait.count);
+    EXPECT_EQ(3u, stats.queueResidency.count);
+    EXPECT_GE(stats.queueResidency.averageTime(), ms2ns(2));
+    EXPECT_EQ(3u, stats.acquireToRelease.count);
+    EXPECT_GE(stats.acquireToRelease.averageTime(), ms2ns(4));
+    EXPECT_GE(stats.acquireToRelease.maxTime, stats.acquireToRelease.averageTime());
+
+    String8 dumpString;
+    mConsumer->dumpState(String8{}, &dumpString);
+    EXPECT_NE(-1, dumpString.find("latency: dequeue-wait=[count=0"));
+
+    // The stats were reset by the previous call
+    ASSERT_EQ(OK, mConsumer->getLatencyStats(false, &stats));
+    EXPECT_EQ(0u, stats.dequeueWait.count);
+    EXPECT_EQ(0u, stats.queueResidency.count);
+    EXPECT_EQ(0u, stats.acquireToRelease.count);
+}
+
 TEST_F(BufferQueueTest, TestDiscardFreeBuffers) {
     createBufferQueue();
     sp<DummyConsumer> dc(new DummyConsumer);
@@ -1192,4 +1243,222 @@ TEST_F(BufferQueueTest, TestProducerConnectDisconnect) {
     ASSERT_EQ(NO_INIT, mProducer->disconnect(NATIVE_WINDOW_API_CPU));
 }
 
+TEST_F(BufferQueueTest, TestAdaptiveBufferCountGrowsWhenProducerBlocks) {
+    createBufferQueue();
+    sp<DummyConsumer> dc(new DummyConsumer);
+    ASSERT_EQ(OK, mConsumer->consumerConnect(dc, false));
+    ASSERT_EQ(OK, mConsumer->setAdaptiveBufferCount(true));
+    IGraphicBufferProducer::QueueBufferOutput output;
+    ASSERT_EQ(OK, mProducer->connect(new DummyProducerListener,
+            NATIVE_WINDOW_API_CPU, false, &output));
+    ASSERT_EQ(OK, mProducer->setMaxDequeuedBufferCount(2));
+    ASSERT_EQ(OK, mProducer->setDequeueTimeout(ms2ns(10)));
+
+    int slot = BufferQueue::INVALID_BUFFER_SLOT;
+    sp<Fence> fence = Fence::NO_FENCE;
+    sp<GraphicBuffer> buffer = nullptr;
+    IGraphicBufferProducer::QueueBufferInput input(0ull, true,
+        HAL_DATASPACE_UNKNOWN, Rect::INVALID_RECT,
+        NATIVE_WINDOW_SCALING_MODE_FREEZE, 0, Fence::NO_FENCE);
+    BufferItem item{};
+
+    // Hold one buffer in the consumer and queue another
+    ASSERT_EQ(IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION,
+            mProducer->dequeueBuffer(&slot, &fence, 0, 0, 0, 0, nullptr, nullptr));
+    ASSERT_EQ(OK, mProducer->requestBuffer(slot, &buffer));
+    ASSERT_EQ(OK, mProducer->queueBuffer(slot, input, &output));
+    ASSERT_EQ(OK, mConsumer->acquireBuffer(&item, 0));
+    ASSERT_EQ(IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION,
+            mProducer->dequeueBuffer(&slot, &fence, 0, 0, 0, 0, nullptr, nullptr));
+    ASSERT_EQ(OK, mProducer->requestBuffer(slot, &buffer));
+    ASSERT_EQ(OK, mProducer->queueBuffer(slot, input, &output));
+
+    // A third buffer is not allocated until the producer has waited for it...
+    ASSERT_EQ(TIMED_OUT,
+            mProducer->dequeueBuffer(&slot, &fence, 0, 0, 0, 0, nullptr, nullptr));
+
+    // ...after which the buffer count has grown to allow it
+    ASSERT_EQ(IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION,
+            mProducer->dequeueBuffer(&slot, &fence, 0, 0, 0, 0, nullptr, nullptr));
+}
+
+TEST_F(BufferQueueTest, TestAdaptiveBufferCountDisabledAllocatesThirdBuffer) {
+    createBufferQueue();
+    sp<DummyConsumer> dc(new DummyConsumer);
+    ASSERT_EQ(OK, mConsumer->consumerConnect(dc, false));
+    IGraphicBufferProducer::QueueBufferOutput output;
+    ASSERT_EQ(OK, mProducer->connect(new DummyProducerListener,
+            NATIVE_WINDOW_API_CPU, false, &output));
+    ASSERT_EQ(OK, mProducer->setMaxDequeuedBufferCount(2));
+    ASSERT_EQ(OK, mProducer->setDequeueTimeout(ms2ns(10)));
+
+    int slot = BufferQueue::INVALID_BUFFER_SLOT;
+    sp<Fence> fence = Fence::NO_FENCE;
+    sp<GraphicBuffer> buffer = nullptr;
+    IGraphicBufferProducer::QueueBufferInput input(0ull, true,
+        HAL_DATASPACE_UNKNOWN, Rect::INVALID_RECT,
+        NATIVE_WINDOW_SCALING_MODE_FREEZE, 0, Fence::NO_FENCE);
+    BufferItem item{};
+
+    ASSERT_EQ(IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION,
+            mProducer->dequeueBuffer(&slot, &fence, 0, 0, 0, 0, nullptr, nullptr));
+    ASSERT_EQ(OK, mProducer->requestBuffer(slot, &buffer));
+    ASSERT_EQ(OK, mProducer->queueBuffer(slot, input, &output));
+    ASSERT_EQ(OK, mConsumer->acquireBuffer(&item, 0));
+    ASSERT_EQ(IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION,
+            mProducer->dequeueBuffer(&slot, &fence, 0, 0, 0, 0, nullptr, nullptr));
+    ASSERT_EQ(OK, mProducer->requestBuffer(slot, &buffer));
+    ASSERT_EQ(OK, mProducer->queueBuffer(slot, input, &output));
+
+    ASSERT_EQ(IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION,
+            mProducer->dequeueBuffer(&slot, &fence, 0, 0, 0, 0, nullptr, nullptr));
+}
+
+TEST_F(BufferQueueTest, TestAdaptiveBufferCountShrinksForSteadyProducer) {
+    createBufferQueue();
+    sp<DummyConsumer> dc(new DummyConsumer);
+    ASSERT_EQ(OK, mConsumer->consumerConnect(dc, false));
+    ASSERT_EQ(OK, mConsumer->setAdaptiveBufferCount(true));
+    IGraphicBufferProducer::QueueBufferOutput output;
+    ASSERT_EQ(OK, mProducer->connect(new DummyProducerListener,
+            NATIVE_WINDOW_API_CPU, false, &output));
+    ASSERT_EQ(OK, mProducer->setMaxDequeuedBufferCount(2));
+
+    int slot = BufferQueue::INVALID_BUFFER_SLOT;
+    sp<Fence> fence = Fence::NO_FENCE;
+    sp<GraphicBuffer> buffer = nullptr;
+    IGraphicBufferProducer::QueueBufferInput input(0ull, true,
+        HAL_DATASPACE_UNKNOWN, Rect::INVALID_RECT,
+        NATIVE_WINDOW_SCALING_MODE_FREEZE, 0, Fence::NO_FENCE);
+
+    // Hold one buffer in the consumer; dequeuing two more at once grows the
+    // buffer count to three right away, since waiting could never succeed
+    ASSERT_EQ(IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION,
+            mProducer->dequeueBuffer(&slot, &fence, 0, 0, 0, 0, nullptr, nullptr));
+    ASSERT_EQ(OK, mProducer->requestBuffer(slot, &buffer));
+    ASSERT_EQ(OK, mProducer->queueBuffer(slot, input, &output));
+    BufferItem item{};
+    ASSERT_EQ(OK, mConsumer->acquireBuffer(&item, 0));
+    int slots[2] = {};
+    for (auto& s : slots) {
+        ASSERT_EQ(IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION,
+                mProducer->dequeueBuffer(&s, &fence, 0, 0, 0, 0, nullptr, nullptr));
+        ASSERT_EQ(OK, mProducer->requestBuffer(s, &buffer));
+    }
+    for (auto s : slots) {
+        ASSERT_EQ(OK, mProducer->queueBuffer(s, input, &output));
+    }
+    for (int i = 0; i < 2; i++) {
+        BufferItem next{};
+        ASSERT_EQ(OK, mConsumer->acquireBuffer(&next, 0));
+        ASSERT_EQ(OK, mConsumer->releaseBuffer(item.mSlot, item.mFrameNumber,
+                        EGL_NO_DISPLAY, EGL_NO_SYNC_KHR, Fence::NO_FENCE));
+        item = next;
+    }
+
+    // A producer that never needs more than double-buffering gives the third
+    // buffer back
+    for (int frame = 0; frame < 400; frame++) {
+        int result = mProducer->dequeueBuffer(&slot, &fence, 0, 0, 0, 0, nullptr, nullptr);
+        ASSERT_GE(result, 0);
+        if (result & IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION) {
+            ASSERT_EQ(OK, mProducer->requestBuffer(slot, &buffer));
+        }
+        ASSERT_EQ(OK, mProducer->queueBuffer(slot, input, &output));
+        BufferItem next{};
+        ASSERT_EQ(OK, mConsumer->acquireBuffer(&next, 0));
+        ASSERT_EQ(OK, mConsumer->releaseBuffer(item.mSlot, item.mFrameNumber,
+                        EGL_NO_DISPLAY, EGL_NO_SYNC_KHR, Fence::NO_FENCE));
+        item = next;
+    }
+
+    String8 dumpString;
+    mConsumer->dumpState(String8{}, &dumpString);
+    ASSERT_NE(-1, dumpString.find("adaptive-buffer-limit=2 allocated=2"));
+}
+
+TEST_F(BufferQueueTest, TestAllocateBuffersReplacesStaleFreeBuffers) {
+    createBufferQueue();
+    sp<DummyConsumer> dc(new DummyConsumer);
+    ASSERT_EQ(OK, mConsumer->consumerConnect(dc, false));
+    IGraphicBufferProducer::QueueBufferOutput output;
+    ASSERT_EQ(OK, mProducer->connect(new DummyProducerListener,
+            NATIVE_WINDOW_API_CPU, false, &output));
+
+    int slot = BufferQueue::INVALID_BUFFER_SLOT;
+    sp<Fence> fence = Fence::NO_FENCE;
+    sp<GraphicBuffer> buffer = nullptr;
+    IGraphicBufferProducer::QueueBufferInput input(0ull, true,
+        HAL_DATASPACE_UNKNOWN, Rect::INVALID_RECT,
+        NATIVE_WINDOW_SCALING_MODE_FREEZE, 0, Fence::NO_FENCE);
+    BufferItem item{};
+
+    // Leave a free buffer of the default 1x1 size behind
+    ASSERT_EQ(IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION,
+            mProducer->dequeueBuffer(&slot, &fence, 0, 0, 0,
+                    GRALLOC_USAGE_SW_READ_OFTEN, nullptr, nullptr));
+    ASSERT_EQ(OK, mProducer->requestBuffer(slot, &buffer));
+    ASSERT_EQ(OK, mProducer->queueBuffer(slot, input, &output));
+    ASSERT_EQ(OK, mConsumer->acquireBuffer(&item, 0));
+    ASSERT_EQ(OK, mConsumer->releaseBuffer(item.mSlot, item.mFrameNumber,
+                    EGL_NO_DISPLAY, EGL_NO_SYNC_KHR, Fence::NO_FENCE));
+
+    ASSERT_EQ(OK, mConsumer->setDefaultBufferSize(16, 8));
+    mProducer->allocateBuffers(0, 0, 0, GRALLOC_USAGE_SW_READ_OFTEN);
+
+    String8 dumpString;
+    mConsumer->dumpState(String8{}, &dumpString);
+    ASSERT_EQ(-1, dumpString.find("[   1x   1"));
+    ASSERT_NE(-1, dumpString.find("[  16x   8"));
+}
+
+TEST_F(BufferQueueTest, TestBufferPreallocationOnResize) {
+    createBufferQueue();
+    sp<DummyConsumer> dc(new DummyConsumer);
+    ASSERT_EQ(OK, mConsumer->consumerConnect(dc, false));
+    ASSERT_EQ(OK, mConsumer->setBufferPreallocation(true));
+    IGraphicBufferProducer::QueueBufferOutput output;
+    ASSERT_EQ(OK, mProducer->connect(new DummyProducerListener,
+            NATIVE_WINDOW_API_CPU, false, &output));
+
+    int slot = BufferQueue::INVALID_BUFFER_SLOT;
+    sp<Fence> fence = Fence::NO_FENCE;
+    sp<GraphicBuffer> buffer = nullptr;
+    IGraphicBufferProducer::QueueBufferInput input(0ull, true,
+        HAL_DATASPACE_UNKNOWN, Rect::INVALID_RECT,
+        NATIVE_WINDOW_SCALING_MODE_FREEZE, 0, Fence::NO_FENCE);
+    BufferItem item{};
+
+    ASSERT_EQ(IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION,
+            mProducer->dequeueBuffer(&slot, &fence, 0, 0, 0,
+                    GRALLOC_USAGE_SW_READ_OFTEN, nullptr, nullptr));
+    ASSERT_EQ(OK, mProducer->requestBuffer(slot, &buffer));
+    ASSERT_EQ(OK, mProducer->queueBuffer(slot, input, &output));
+    ASSERT_EQ(OK, mConsumer->acquireBuffer(&item, 0));
+    ASSERT_EQ(OK, mConsumer->releaseBuffer(item.mSlot, item.mFrameNumber,
+                    EGL_NO_DISPLAY, EGL_NO_SYNC_KHR, Fence::NO_FENCE));
+
+    // Resizing allocates buffers of the new size in the background
+    ASSERT_EQ(OK, mConsumer->setDefaultBufferSize(16, 8));
+    String8 dumpString;
+    for (int i = 0; i < 1000; i++) {
+        dumpString.clear();
+        mConsumer->dumpState(String8{}, &dumpString);
+        if (dumpString.find("[   1x   1") == -1) {
+            break;
+        }
+        std::this_thread::sleep_for(1ms);
+    }
+    ASSERT_EQ(-1, dumpString.find("[   1x   1"));
+    ASSERT_NE(-1, dumpString.find("[  16x   8"));
+
+    // The preallocated buffer is handed out like any new buffer
+    ASSERT_EQ(IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION,
+            mProducer->dequeueBuffer(&slot, &fence, 0, 0, 0,
+                    GRALLOC_USAGE_SW_READ_OFTEN, nullptr, nullptr));
+    ASSERT_EQ(OK, mProducer->requestBuffer(slot, &buffer));
+    ASSERT_EQ(16u, buffer->getWidth());
+    ASSERT_EQ(8u, buffer->getHeight());
+}
+
 } // namespace android
@@ -608,6 +608,55 @@ TEST_P(CpuConsumerTest, FromCpuManyInQueue) {
     }
 }
 
+// This test is disabled because the HAL_PIXEL_FORMAT_RAW16 format is not
+// supported on all devices.
+TEST_P(CpuConsumerTest, FromCpuManyInQueuePersistentMapping) {
+    status_t err;
+    CpuConsumerTestParams params = GetParam();
+
+    const int numInQueue = 5;
+    // Set up
+
+    ASSERT_EQ(OK, mCC->setPersistentMapping(true));
+    ASSERT_NO_FATAL_FAILURE(configureANW(mANW, params, numInQueue));
+
+    // Produce
+
+    const int64_t time[numInQueue] = { 1L, 2L, 3L, 4L, 5L};
+    uint32_t stride[numInQueue];
+
+    for (int i = 0; i < numInQueue; i++) {
+        ALOGV("Producing frame %d", i);
+        ASSERT_NO_FATAL_FAILURE(produceOneFrame(mANW, params, time[i],
+                        &stride[i]));
+    }
+
+    // Consume
+
+    for (int i = 0; i < numInQueue; i++) {
+        ALOGV("Consuming frame %d", i);
+        CpuConsumer::LockedBuffer b;
+        err = mCC->lockNextBuffer(&b);
+        ASSERT_NO_ERROR(err, "getNextBuffer error: ");
+
+        // The mapping mode can't change while a buffer is locked
+        EXPECT_EQ(INVALID_OPERATION, mCC->setPersistentMapping(false));
+
+        ASSERT_TRUE(b.data != NULL);
+        EXPECT_EQ(params.width,  b.width);
+        EXPECT_EQ(params.height, b.height);
+        EXPECT_EQ(params.format, b.format);
+        EXPECT_EQ(stride[i], b.stride);
+        EXPECT_EQ(time[i], b.timestamp);
+
+        checkAnyBuffer(b, GetParam().format);
+
+        mCC->unlockBuffer(b);
+    }
+
+    EXPECT_EQ(OK, mCC->setPersistentMapping(false));
+}
+
 // This test is disabled because the HAL_PIXEL_FORMAT_RAW16 format is not
 // supported on all devices.
 TEST_P(CpuConsumerTest, FromCpuLockMax) {
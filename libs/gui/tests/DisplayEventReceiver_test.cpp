@@ -0,0 +1,79 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "DisplayEventReceiver_test"
+
+#include <gui/DisplayEventReceiver.h>
+#include <private/gui/BitTube.h>
+
+#include <gtest/gtest.h>
+
+namespace android {
+
+using Event = DisplayEventReceiver::Event;
+
+static void sendVsync(gui::BitTube* tube, nsecs_t timestamp, uint32_t count) {
+    Event event = {};
+    event.header.type = DisplayEventReceiver::DISPLAY_EVENT_VSYNC;
+    event.header.timestamp = timestamp;
+    event.vsync.count = count;
+    ASSERT_EQ(1, DisplayEventReceiver::sendEvents(tube, &event, 1));
+}
+
+static void sendHotplug(gui::BitTube* tube, nsecs_t timestamp, bool connected) {
+    Event event = {};
+    event.header.type = DisplayEventReceiver::DISPLAY_EVENT_HOTPLUG;
+    event.header.timestamp = timestamp;
+    event.hotplug.connected = connected;
+    ASSERT_EQ(1, DisplayEventReceiver::sendEvents(tube, &event, 1));
+}
+
+TEST(DisplayEventReceiverTest, GetLatestVsyncKeepsNewestVsyncAndOtherEvents) {
+    gui::BitTube tube(gui::BitTube::DefaultSize);
+    sendVsync(&tube, 1, 1);
+    sendHotplug(&tube, 2, true);
+    sendVsync(&tube, 3, 2);
+    sendVsync(&tube, 4, 3);
+
+    Event events[8];
+    uint32_t dropped = 0;
+    ASSERT_EQ(2, DisplayEventReceiver::getLatestVsync(&tube, events, 8, &dropped));
+    EXPECT_EQ(2u, dropped);
+    EXPECT_EQ(uint32_t(DisplayEventReceiver::DISPLAY_EVENT_HOTPLUG), events[0].header.type);
+    EXPECT_TRUE(events[0].hotplug.connected);
+    EXPECT_EQ(uint32_t(DisplayEventReceiver::DISPLAY_EVENT_VSYNC), events[1].header.type);
+    EXPECT_EQ(4, events[1].header.timestamp);
+    EXPECT_EQ(3u, events[1].vsync.count);
+
+    EXPECT_GT(0, DisplayEventReceiver::getLatestVsync(&tube, events, 8, &dropped));
+}
+
+TEST(DisplayEventReceiverTest, GetLatestVsyncStopsWhenFull) {
+    gui::BitTube tube(gui::BitTube::DefaultSize);
+    sendHotplug(&tube, 1, true);
+    sendHotplug(&tube, 2, false);
+    sendVsync(&tube, 3, 1);
+
+    Event events[2];
+    ASSERT_EQ(2, DisplayEventReceiver::getLatestVsync(&tube, events, 2, nullptr));
+    EXPECT_EQ(1, events[0].header.timestamp);
+    EXPECT_EQ(2, events[1].header.timestamp);
+
+    ASSERT_EQ(1, DisplayEventReceiver::getLatestVsync(&tube, events, 2, nullptr));
+    EXPECT_EQ(3, events[0].header.timestamp);
+}
+
+} // namespace android
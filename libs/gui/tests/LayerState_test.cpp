@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "LayerState_test"
+
+#include <gtest/gtest.h>
+
+#include <binder/Parcel.h>
+#include <gui/LayerState.h>
+
+namespace android {
+
+static layer_state_t roundTrip(const layer_state_t& state, size_t* outSize = nullptr) {
+    Parcel parcel;
+    EXPECT_EQ(NO_ERROR, state.write(parcel));
+    if (outSize != nullptr) {
+        *outSize = parcel.dataSize();
+    }
+
+    parcel.setDataPosition(0);
+    layer_state_t result;
+    EXPECT_EQ(NO_ERROR, result.read(parcel));
+    EXPECT_EQ(parcel.dataSize(), parcel.dataPosition());
+    return result;
+}
+
+TEST(LayerStateTest, FlaggedFieldsRoundTrip) {
+    layer_state_t state;
+    state.what = layer_state_t::ePositionChanged | layer_state_t::eSizeChanged |
+            layer_state_t::eAlphaChanged | layer_state_t::eMatrixChanged |
+            layer_state_t::eFlagsChanged | layer_state_t::eCropChanged |
+            layer_state_t::eRelativeLayerChanged | layer_state_t::eColorChanged |
+            layer_state_t::eTransparentRegionChanged;
+    state.x = 12;
+    state.y = 34;
+    state.z = -5;
+    state.w = 100;
+    state.h = 200;
+    state.alpha = 0.5f;
+    state.matrix.dsdx = 2;
+    state.matrix.dtdy = 3;
+    state.flags = layer_state_t::eLayerHidden;
+    state.mask = layer_state_t::eLayerHidden | layer_state_t::eLayerOpaque;
+    state.crop = Rect(1, 2, 3, 4);
+    state.color = half3(0.25f, 0.5f, 0.75f);
+    state.transparentRegion = Region(Rect(5, 6, 7, 8));
+
+    layer_state_t result = roundTrip(state);
+    EXPECT_EQ(state.what, result.what);
+    EXPECT_EQ(state.x, result.x);
+    EXPECT_EQ(state.y, result.y);
+    EXPECT_EQ(state.z, result.z);
+    EXPECT_EQ(state.w, result.w);
+    EXPECT_EQ(state.h, result.h);
+    EXPECT_EQ(state.alpha, result.alpha);
+    EXPECT_EQ(state.matrix.dsdx, result.matrix.dsdx);
+    EXPECT_EQ(state.matrix.dtdy, result.matrix.dtdy);
+    EXPECT_EQ(state.flags, result.flags);
+    EXPECT_EQ(state.mask, result.mask);
+    EXPECT_EQ(state.crop, result.crop);
+    EXPECT_EQ(state.color, result.color);
+    EXPECT_TRUE(state.transparentRegion.subtract(result.transparentRegion).isEmpty());
+    EXPECT_TRUE(result.transparentRegion.subtract(state.transparentRegion).isEmpty());
+}
+
+TEST(LayerStateTest, UnflaggedFieldsAreNotParceled) {
+    layer_state_t state;
+    state.what = layer_state_t::ePositionChanged;
+    state.x = 12;
+    state.y = 34;
+    state.alpha = 0.5f;
+    state.crop = Rect(1, 2, 3, 4);
+    state.transparentRegion = Region(Rect(5, 6, 7, 8));
+
+    size_t positionOnlySize;
+    layer_state_t result = roundTrip(state, &positionOnlySize);
+    EXPECT_EQ(state.x, result.x);
+    EXPECT_EQ(state.y, result.y);
+    EXPECT_EQ(layer_state_t().alpha, result.alpha);
+    EXPECT_EQ(layer_state_t().crop, result.crop);
+    EXPECT_TRUE(result.transparentRegion.isEmpty());
+
+    state.what |= layer_state_t::eAlphaChanged | layer_state_t::eCropChanged |
+            layer_state_t::eTransparentRegionChanged;
+    size_t fullSize;
+    roundTrip(state, &fullSize);
+    EXPECT_LT(positionOnlySize, fullSize);
+}
+
+TEST(LayerStateTest, MergeKeepsColor) {
+    layer_state_t state;
+    layer_state_t other;
+    other.what = layer_state_t::eColorChanged;
+    other.color = half3(0.25f, 0.5f, 0.75f);
+
+    state.merge(other);
+    EXPECT_TRUE(state.what & layer_state_t::eColorChanged);
+    EXPECT_EQ(other.color, state.color);
+}
+
+} // namespace android
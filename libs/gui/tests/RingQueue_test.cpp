@@ -0,0 +1,119 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "RingQueue_test"
+
+#include <gui/BufferSlotSet.h>
+#include <gui/RingQueue.h>
+
+#include <utils/RefBase.h>
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+namespace android {
+
+TEST(RingQueueTest, PushesAndPopsAtBothEnds) {
+    RingQueue<int> queue;
+    queue.push_back(2);
+    queue.push_back(3);
+    queue.push_front(1);
+    ASSERT_EQ(3u, queue.size());
+    EXPECT_EQ(1, queue.front());
+    EXPECT_EQ(3, queue.back());
+
+    queue.pop_back();
+    queue.pop_front();
+    ASSERT_EQ(1u, queue.size());
+    EXPECT_EQ(2, queue.front());
+}
+
+TEST(RingQueueTest, KeepsOrderWhenGrowingAfterWrapping) {
+    RingQueue<int> queue;
+    for (int i = 0; i < 4; i++) {
+        queue.push_back(i);
+    }
+    queue.pop_front();
+    queue.pop_front();
+    for (int i = 4; i < 10; i++) {
+        queue.push_back(i);
+    }
+
+    std::vector<int> values;
+    for (int value : queue) {
+        values.push_back(value);
+    }
+    EXPECT_EQ((std::vector<int>{2, 3, 4, 5, 6, 7, 8, 9}), values);
+}
+
+TEST(RingQueueTest, RemoveKeepsOtherElementsInOrder) {
+    RingQueue<int> queue;
+    queue.push_back(1);
+    queue.push_back(2);
+    queue.push_back(3);
+    queue.push_back(2);
+    queue.remove(2);
+    ASSERT_EQ(2u, queue.size());
+    EXPECT_EQ(1, queue[0]);
+    EXPECT_EQ(3, queue[1]);
+    EXPECT_FALSE(queue.contains(2));
+    EXPECT_TRUE(queue.contains(3));
+}
+
+TEST(RingQueueTest, PoppedElementsReleaseReferences) {
+    sp<RefBase> object = new RefBase();
+    wp<RefBase> weak = object;
+    RingQueue<sp<RefBase>> queue;
+    queue.push_back(object);
+    object.clear();
+    ASSERT_NE(nullptr, weak.promote());
+
+    queue.pop_front();
+    EXPECT_EQ(nullptr, weak.promote());
+}
+
+TEST(BufferSlotSetTest, IteratesInAscendingOrder) {
+    BufferSlotSet set;
+    set.insert(63);
+    set.insert(5);
+    set.insert(0);
+    EXPECT_EQ(3u, set.size());
+    EXPECT_EQ(0, set.first());
+
+    std::vector<int> slots;
+    for (int slot : set) {
+        slots.push_back(slot);
+    }
+    EXPECT_EQ((std::vector<int>{0, 5, 63}), slots);
+
+    set.erase(0);
+    EXPECT_EQ(0u, set.count(0));
+    EXPECT_EQ(1u, set.count(5));
+    EXPECT_EQ(5, set.first());
+}
+
+TEST(BufferSlotSetTest, CanBeModifiedWhileIterating) {
+    BufferSlotSet set;
+    set.insert(1);
+    set.insert(2);
+    for (int slot : set) {
+        set.erase(slot);
+    }
+    EXPECT_TRUE(set.empty());
+}
+
+} // namespace android
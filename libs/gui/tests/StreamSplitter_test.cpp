@@ -236,4 +236,124 @@ TEST_F(StreamSplitterTest, OutputAbandonment) {
                                            nullptr, nullptr));
 }
 
+// Dequeues a buffer from producer, writes value into it and queues it
+static void queueFrame(const sp<IGraphicBufferProducer>& producer, uint32_t value) {
+    int slot;
+    sp<Fence> fence;
+    sp<GraphicBuffer> buffer;
+    status_t result = producer->dequeueBuffer(&slot, &fence, 0, 0, 0,
+            GRALLOC_USAGE_SW_WRITE_OFTEN, nullptr, nullptr);
+    ASSERT_GE(result, 0);
+    ASSERT_EQ(OK, producer->requestBuffer(slot, &buffer));
+
+    uint32_t* dataIn;
+    ASSERT_EQ(OK, buffer->lock(GraphicBuffer::USAGE_SW_WRITE_OFTEN,
+            reinterpret_cast<void**>(&dataIn)));
+    *dataIn = value;
+    ASSERT_EQ(OK, buffer->unlock());
+
+    IGraphicBufferProducer::QueueBufferInput qbInput(0, false,
+            HAL_DATASPACE_UNKNOWN, Rect(0, 0, 1, 1),
+            NATIVE_WINDOW_SCALING_MODE_FREEZE, 0, Fence::NO_FENCE);
+    IGraphicBufferProducer::QueueBufferOutput qbOutput;
+    ASSERT_EQ(OK, producer->queueBuffer(slot, qbInput, &qbOutput));
+}
+
+// Acquires a buffer from consumer and checks that it holds value
+static void acquireFrame(const sp<IGraphicBufferConsumer>& consumer, uint32_t value,
+        BufferItem* outItem) {
+    ASSERT_EQ(OK, consumer->acquireBuffer(outItem, 0));
+
+    uint32_t* dataOut;
+    ASSERT_EQ(OK, outItem->mGraphicBuffer->lock(GraphicBuffer::USAGE_SW_READ_OFTEN,
+            reinterpret_cast<void**>(&dataOut)));
+    ASSERT_EQ(value, *dataOut);
+    ASSERT_EQ(OK, outItem->mGraphicBuffer->unlock());
+}
+
+TEST_F(StreamSplitterTest, DropFramesOutputDoesNotThrottle) {
+    sp<IGraphicBufferProducer> inputProducer;
+    sp<IGraphicBufferConsumer> inputConsumer;
+    BufferQueue::createBufferQueue(&inputProducer, &inputConsumer);
+
+    sp<IGraphicBufferProducer> fastProducer;
+    sp<IGraphicBufferConsumer> fastConsumer;
+    BufferQueue::createBufferQueue(&fastProducer, &fastConsumer);
+    ASSERT_EQ(OK, fastConsumer->consumerConnect(new DummyListener, false));
+
+    sp<IGraphicBufferProducer> slowProducer;
+    sp<IGraphicBufferConsumer> slowConsumer;
+    BufferQueue::createBufferQueue(&slowProducer, &slowConsumer);
+    ASSERT_EQ(OK, slowConsumer->consumerConnect(new DummyListener, false));
+
+    sp<StreamSplitter> splitter;
+    status_t status = StreamSplitter::createSplitter(inputConsumer, &splitter);
+    ASSERT_EQ(OK, status);
+    ASSERT_EQ(OK, splitter->addOutput(fastProducer));
+    ASSERT_EQ(OK, splitter->addOutput(slowProducer,
+            StreamSplitter::SlowOutputPolicy::DROP_FRAMES, 1));
+
+    IGraphicBufferProducer::QueueBufferOutput qbOutput;
+    ASSERT_EQ(OK, inputProducer->connect(new DummyProducerListener,
+            NATIVE_WINDOW_API_CPU, false, &qbOutput));
+
+    // The slow output holds on to the first frame...
+    ASSERT_NO_FATAL_FAILURE(queueFrame(inputProducer, 1));
+    BufferItem slowItem;
+    ASSERT_NO_FATAL_FAILURE(acquireFrame(slowConsumer, 1, &slowItem));
+
+    // ...while the fast output keeps receiving every frame
+    for (uint32_t frame = 1; frame <= 5; ++frame) {
+        if (frame > 1) {
+            ASSERT_NO_FATAL_FAILURE(queueFrame(inputProducer, frame));
+        }
+        BufferItem item;
+        ASSERT_NO_FATAL_FAILURE(acquireFrame(fastConsumer, frame, &item));
+        ASSERT_EQ(OK, fastConsumer->releaseBuffer(item.mSlot, item.mFrameNumber,
+                EGL_NO_DISPLAY, EGL_NO_SYNC_KHR, Fence::NO_FENCE));
+    }
+
+    // The frames queued meanwhile were dropped for the slow output
+    BufferItem item;
+    ASSERT_EQ(IGraphicBufferConsumer::NO_BUFFER_AVAILABLE,
+            slowConsumer->acquireBuffer(&item, 0));
+
+    // Once it catches up, it receives new frames again
+    ASSERT_EQ(OK, slowConsumer->releaseBuffer(slowItem.mSlot, slowItem.mFrameNumber,
+            EGL_NO_DISPLAY, EGL_NO_SYNC_KHR, Fence::NO_FENCE));
+    ASSERT_NO_FATAL_FAILURE(queueFrame(inputProducer, 6));
+    ASSERT_NO_FATAL_FAILURE(acquireFrame(slowConsumer, 6, &slowItem));
+}
+
+TEST_F(StreamSplitterTest, DropFramesOutputReplacesStaleFrames) {
+    sp<IGraphicBufferProducer> inputProducer;
+    sp<IGraphicBufferConsumer> inputConsumer;
+    BufferQueue::createBufferQueue(&inputProducer, &inputConsumer);
+
+    sp<IGraphicBufferProducer> outputProducer;
+    sp<IGraphicBufferConsumer> outputConsumer;
+    BufferQueue::createBufferQueue(&outputProducer, &outputConsumer);
+    ASSERT_EQ(OK, outputConsumer->consumerConnect(new DummyListener, false));
+
+    sp<StreamSplitter> splitter;
+    status_t status = StreamSplitter::createSplitter(inputConsumer, &splitter);
+    ASSERT_EQ(OK, status);
+    ASSERT_EQ(OK, splitter->addOutput(outputProducer,
+            StreamSplitter::SlowOutputPolicy::DROP_FRAMES, 2));
+
+    IGraphicBufferProducer::QueueBufferOutput qbOutput;
+    ASSERT_EQ(OK, inputProducer->connect(new DummyProducerListener,
+            NATIVE_WINDOW_API_CPU, false, &qbOutput));
+
+    // Frames the output has not acquired yet are replaced by newer ones
+    for (uint32_t frame = 1; frame <= 4; ++frame) {
+        ASSERT_NO_FATAL_FAILURE(queueFrame(inputProducer, frame));
+    }
+
+    BufferItem item;
+    ASSERT_NO_FATAL_FAILURE(acquireFrame(outputConsumer, 4, &item));
+    ASSERT_EQ(IGraphicBufferConsumer::NO_BUFFER_AVAILABLE,
+            outputConsumer->acquireBuffer(&item, 0));
+}
+
 } // namespace android
@@ -24,6 +24,7 @@
 #include <cutils/properties.h>
 #include <inttypes.h>
 #include <gui/BufferItemConsumer.h>
+#include <gui/CpuConsumer.h>
 #include <gui/IDisplayEventConnection.h>
 #include <gui/IProducerListener.h>
 #include <gui/ISurfaceComposer.h>
@@ -209,7 +210,7 @@ TEST_F(SurfaceTest, QueryDefaultBuffersDataSpace) {
     sp<IGraphicBufferProducer> producer;
     sp<IGraphicBufferConsumer> consumer;
     BufferQueue::createBufferQueue(&producer, &consumer);
-    sp<CpuConsumer> cpuConsumer = new CpuConsumer(consumer, 1);
+    sp<CpuConsumer> cpuConsumer = new CpuConsumer(consumer, 2);
 
     cpuConsumer->setDefaultBufferDataSpace(TEST_DATASPACE);
 
@@ -226,6 +227,59 @@ TEST_F(SurfaceTest, QueryDefaultBuffersDataSpace) {
     ASSERT_EQ(TEST_DATASPACE, dataSpace);
 }
 
+TEST_F(SurfaceTest, CachedQueriesRefreshOnConnect) {
+    sp<IGraphicBufferProducer> producer;
+    sp<IGraphicBufferConsumer> consumer;
+    BufferQueue::createBufferQueue(&producer, &consumer);
+    sp<CpuConsumer> cpuConsumer = new CpuConsumer(consumer, 2);
+    cpuConsumer->setDefaultBufferDataSpace(HAL_DATASPACE_SRGB);
+
+    sp<Surface> s = new Surface(producer);
+    sp<ANativeWindow> anw(s);
+
+    int dataSpace = 0;
+    ASSERT_EQ(NO_ERROR, anw->query(anw.get(), NATIVE_WINDOW_DEFAULT_DATASPACE, &dataSpace));
+    EXPECT_EQ(HAL_DATASPACE_SRGB, dataSpace);
+
+    cpuConsumer->setDefaultBufferDataSpace(HAL_DATASPACE_DISPLAY_P3);
+    ASSERT_EQ(NO_ERROR, native_window_api_connect(anw.get(), NATIVE_WINDOW_API_CPU));
+    ASSERT_EQ(NO_ERROR, anw->query(anw.get(), NATIVE_WINDOW_DEFAULT_DATASPACE, &dataSpace));
+    EXPECT_EQ(HAL_DATASPACE_DISPLAY_P3, dataSpace);
+    ASSERT_EQ(NO_ERROR, native_window_api_disconnect(anw.get(), NATIVE_WINDOW_API_CPU));
+}
+
+TEST_F(SurfaceTest, SetBuffersState) {
+    sp<IGraphicBufferProducer> producer;
+    sp<IGraphicBufferConsumer> consumer;
+    BufferQueue::createBufferQueue(&producer, &consumer);
+    sp<CpuConsumer> cpuConsumer = new CpuConsumer(consumer, 2);
+
+    sp<Surface> s = new Surface(producer);
+    sp<ANativeWindow> anw(s);
+    ASSERT_EQ(NO_ERROR, native_window_api_connect(anw.get(), NATIVE_WINDOW_API_CPU));
+
+    native_window_buffers_state state = {};
+    state.changes = NATIVE_WINDOW_BUFFERS_STATE_DATASPACE |
+            NATIVE_WINDOW_BUFFERS_STATE_CROP | NATIVE_WINDOW_BUFFERS_STATE_SCALING_MODE;
+    state.dataSpace = HAL_DATASPACE_SRGB;
+    state.crop = {0, 0, 10, 10};
+    state.scalingMode = NATIVE_WINDOW_SCALING_MODE_SCALE_CROP;
+    ASSERT_EQ(NO_ERROR, native_window_set_buffers_state(anw.get(), &state));
+
+    int dataSpace = 0;
+    ASSERT_EQ(NO_ERROR, anw->query(anw.get(), NATIVE_WINDOW_DATASPACE, &dataSpace));
+    EXPECT_EQ(HAL_DATASPACE_SRGB, dataSpace);
+
+    // Nothing is set when a value is invalid.
+    state.dataSpace = HAL_DATASPACE_DISPLAY_P3;
+    state.scalingMode = -1;
+    EXPECT_EQ(BAD_VALUE, native_window_set_buffers_state(anw.get(), &state));
+    ASSERT_EQ(NO_ERROR, anw->query(anw.get(), NATIVE_WINDOW_DATASPACE, &dataSpace));
+    EXPECT_EQ(HAL_DATASPACE_SRGB, dataSpace);
+
+    ASSERT_EQ(NO_ERROR, native_window_api_disconnect(anw.get(), NATIVE_WINDOW_API_CPU));
+}
+
 TEST_F(SurfaceTest, SettingGenerationNumber) {
     sp<IGraphicBufferProducer> producer;
     sp<IGraphicBufferConsumer> consumer;
@@ -484,6 +538,156 @@ TEST_F(SurfaceTest, TestGetLastDequeueStartTime) {
     ASSERT_GE(after, lastDequeueTime);
 }
 
+TEST_F(SurfaceTest, BatchDequeueAndQueue) {
+    sp<IGraphicBufferProducer> producer;
+    sp<IGraphicBufferConsumer> consumer;
+    BufferQueue::createBufferQueue(&producer, &consumer);
+
+    sp<DummyConsumer> dummyConsumer(new DummyConsumer);
+    consumer->consumerConnect(dummyConsumer, false);
+    consumer->setConsumerName(String8("TestConsumer"));
+
+    sp<Surface> surface = new Surface(producer);
+    sp<ANativeWindow> window(surface);
+    ASSERT_EQ(NO_ERROR, native_window_api_connect(window.get(), NATIVE_WINDOW_API_CPU));
+    ASSERT_EQ(NO_ERROR, native_window_set_buffer_count(window.get(), 4));
+
+    std::vector<Surface::BatchBuffer> buffers(3);
+    ASSERT_EQ(NO_ERROR, surface->dequeueBuffers(&buffers));
+    for (size_t i = 0; i < buffers.size(); i++) {
+        ASSERT_NE(nullptr, buffers[i].buffer);
+        for (size_t j = 0; j < i; j++) {
+            EXPECT_NE(buffers[j].buffer->handle, buffers[i].buffer->handle);
+        }
+    }
+
+    std::vector<Surface::BatchQueuedBuffer> queued(buffers.size());
+    for (size_t i = 0; i < buffers.size(); i++) {
+        queued[i].buffer = buffers[i].buffer;
+        queued[i].fenceFd = buffers[i].fenceFd;
+        queued[i].timestamp = static_cast<int64_t>(i + 1);
+    }
+    ASSERT_EQ(NO_ERROR, surface->queueBuffers(queued));
+
+    // The consumer sees the buffers in the order they were queued
+    for (size_t i = 0; i < queued.size(); i++) {
+        BufferItem item;
+        ASSERT_EQ(NO_ERROR, consumer->acquireBuffer(&item, 0));
+        EXPECT_EQ(static_cast<int64_t>(i + 1), item.mTimestamp);
+        EXPECT_EQ(NO_ERROR,
+                consumer->releaseBuffer(item.mSlot, item.mFrameNumber, Fence::NO_FENCE));
+    }
+}
+
+TEST_F(SurfaceTest, BatchDequeueIsAllOrNothing) {
+    sp<IGraphicBufferProducer> producer;
+    sp<IGraphicBufferConsumer> consumer;
+    BufferQueue::createBufferQueue(&producer, &consumer);
+
+    sp<DummyConsumer> dummyConsumer(new DummyConsumer);
+    consumer->consumerConnect(dummyConsumer, false);
+    consumer->setConsumerName(String8("TestConsumer"));
+
+    sp<Surface> surface = new Surface(producer);
+    sp<ANativeWindow> window(surface);
+    ASSERT_EQ(NO_ERROR, native_window_api_connect(window.get(), NATIVE_WINDOW_API_CPU));
+    ASSERT_EQ(NO_ERROR, surface->setMaxDequeuedBufferCount(2));
+
+    // The dequeued buffer limit is only enforced once a buffer has been queued
+    ANativeWindowBuffer* buffer;
+    int fence;
+    ASSERT_EQ(NO_ERROR, window->dequeueBuffer(window.get(), &buffer, &fence));
+    ASSERT_EQ(NO_ERROR, window->queueBuffer(window.get(), buffer, fence));
+
+    std::vector<Surface::BatchBuffer> buffers(3);
+    ASSERT_EQ(INVALID_OPERATION, surface->dequeueBuffers(&buffers));
+
+    // Nothing from the failed batch is left dequeued
+    buffers.resize(2);
+    ASSERT_EQ(NO_ERROR, surface->dequeueBuffers(&buffers));
+    for (const auto& batchBuffer : buffers) {
+        ASSERT_EQ(NO_ERROR,
+                window->cancelBuffer(window.get(), batchBuffer.buffer, batchBuffer.fenceFd));
+    }
+}
+
+TEST_F(SurfaceTest, LockCopiesBackOnlyStaleRegions) {
+    sp<IGraphicBufferProducer> producer;
+    sp<IGraphicBufferConsumer> consumer;
+    BufferQueue::createBufferQueue(&producer, &consumer);
+    sp<CpuConsumer> cpuConsumer = new CpuConsumer(consumer, 1);
+    cpuConsumer->setName(String8("TestConsumer"));
+    cpuConsumer->setDefaultBufferSize(16, 16);
+    cpuConsumer->setDefaultBufferFormat(PIXEL_FORMAT_RGBA_8888);
+
+    sp<Surface> surface = new Surface(producer);
+
+    // The consumer holds on to each frame until the next one arrives, so the
+    // producer alternates between two buffers whose contents are always two
+    // frames old and only the previous frame's damage needs copying back.
+    CpuConsumer::LockedBuffer held;
+    bool holding = false;
+
+    // Paint the dirty rect with value, post it, and return what the consumer
+    // sees at each of the probe points.
+    auto drawFrame = [&](const Rect* dirty, uint32_t value,
+            const std::vector<Point>& probes, std::vector<uint32_t>* outPixels) {
+        ANativeWindow_Buffer buffer;
+        ARect dirtyBounds;
+        if (dirty) {
+            dirtyBounds = {dirty->left, dirty->top, dirty->right, dirty->bottom};
+        }
+        ASSERT_EQ(NO_ERROR, surface->lock(&buffer, dirty ? &dirtyBounds : nullptr));
+        uint32_t* bits = static_cast<uint32_t*>(buffer.bits);
+        Rect painted = dirty ? *dirty : Rect(buffer.width, buffer.height);
+        for (int32_t y = painted.top; y < painted.bottom; y++) {
+            for (int32_t x = painted.left; x < painted.right; x++) {
+                bits[y * buffer.stride + x] = value;
+            }
+        }
+        ASSERT_EQ(NO_ERROR, surface->unlockAndPost());
+
+        CpuConsumer::LockedBuffer locked;
+        ASSERT_EQ(NO_ERROR, cpuConsumer->lockNextBuffer(&locked));
+        const uint32_t* data = reinterpret_cast<const uint32_t*>(locked.data);
+        outPixels->clear();
+        for (const Point& p : probes) {
+            outPixels->push_back(data[static_cast<uint32_t>(p.y) * locked.stride +
+                    static_cast<uint32_t>(p.x)]);
+        }
+        if (holding) {
+            ASSERT_EQ(NO_ERROR, cpuConsumer->unlockBuffer(held));
+        }
+        held = locked;
+        holding = true;
+    };
+
+    const std::vector<Point> probes = {Point(1, 1), Point(3, 3), Point(9, 9), Point(14, 14)};
+    std::vector<uint32_t> pixels;
+
+    drawFrame(nullptr, 0x11111111, probes, &pixels);
+    EXPECT_EQ(std::vector<uint32_t>({0x11111111, 0x11111111, 0x11111111, 0x11111111}),
+              pixels);
+
+    const Rect first(0, 0, 4, 4);
+    drawFrame(&first, 0x22222222, probes, &pixels);
+    EXPECT_EQ(std::vector<uint32_t>({0x22222222, 0x22222222, 0x11111111, 0x11111111}),
+              pixels);
+
+    const Rect second(8, 8, 12, 12);
+    drawFrame(&second, 0x33333333, probes, &pixels);
+    EXPECT_EQ(std::vector<uint32_t>({0x22222222, 0x22222222, 0x33333333, 0x11111111}),
+              pixels);
+
+    const Rect third(0, 0, 2, 2);
+    drawFrame(&third, 0x44444444, probes, &pixels);
+    EXPECT_EQ(std::vector<uint32_t>({0x44444444, 0x22222222, 0x33333333, 0x11111111}),
+              pixels);
+
+    ASSERT_TRUE(holding);
+    EXPECT_EQ(NO_ERROR, cpuConsumer->unlockBuffer(held));
+}
+
 class FakeConsumer : public BnConsumerListener {
 public:
     void onFrameAvailable(const BufferItem& /*item*/) override {}
@@ -974,11 +1178,10 @@ TEST_F(GetFrameTimestampsTest, DefaultDisabled) {
     EXPECT_EQ(0, mFakeConsumer->mAddFrameTimestampsCount);
     EXPECT_EQ(0, mFakeConsumer->mGetFrameTimestampsCount);
 
-    // Verify the producer doesn't get frame timestamps piggybacked on queue.
-    // It is okay that frame timestamps are added in the consumer since it is
-    // still needed for SurfaceFlinger dumps.
+    // Verify the producer doesn't get frame timestamps piggybacked on queue,
+    // and that the consumer isn't asked to track frame events either.
     ASSERT_EQ(NO_ERROR, mWindow->queueBuffer(mWindow.get(), buffer, fence));
-    EXPECT_EQ(1, mFakeConsumer->mAddFrameTimestampsCount);
+    EXPECT_EQ(0, mFakeConsumer->mAddFrameTimestampsCount);
     EXPECT_EQ(0, mFakeConsumer->mGetFrameTimestampsCount);
 
     // Verify attempts to get frame timestamps fail.
@@ -1667,4 +1870,40 @@ TEST_F(GetFrameTimestampsTest, PresentUnsupportedNoSync) {
     EXPECT_EQ(-1, outDisplayPresentTime);
 }
 
+// This test verifies that frame event deltas survive being flattened into a
+// Parcel, including pending timestamps and ones earlier than the posted time.
+TEST_F(GetFrameTimestampsTest, DeltaFlattenRoundTrip) {
+    const uint64_t frameNumber = 1234567;
+    NewFrameEventsEntry entry;
+    entry.frameNumber = frameNumber;
+    entry.postedTime = mFrames[0].kPostedTime;
+    entry.requestedPresentTime = mFrames[0].kPostedTime - 1;
+    entry.acquireFence = FenceTime::NO_FENCE;
+    mCfeh->addQueue(entry);
+    mCfeh->addLatch(frameNumber, mFrames[0].kLatchTime);
+    mCfeh->addPreComposition(frameNumber, mFrames[0].mRefreshes[0].kStartTime);
+
+    FrameEventHistoryDelta delta;
+    mCfeh->getAndResetDelta(&delta);
+
+    Parcel parcel;
+    ASSERT_EQ(NO_ERROR, parcel.write(delta));
+    parcel.setDataPosition(0);
+    FrameEventHistoryDelta unflattened;
+    ASSERT_EQ(NO_ERROR, parcel.read(unflattened));
+
+    FakeProducerFrameEventHistory producerHistory(&mFenceMap);
+    producerHistory.applyDelta(unflattened);
+    android::FrameEvents* events = producerHistory.getFrame(frameNumber);
+    ASSERT_NE(nullptr, events);
+    EXPECT_EQ(mFrames[0].kPostedTime, events->postedTime);
+    EXPECT_EQ(mFrames[0].kPostedTime - 1, events->requestedPresentTime);
+    EXPECT_EQ(mFrames[0].kLatchTime, events->latchTime);
+    EXPECT_EQ(mFrames[0].mRefreshes[0].kStartTime,
+            events->firstRefreshStartTime);
+    EXPECT_EQ(mFrames[0].mRefreshes[0].kStartTime,
+            events->lastRefreshStartTime);
+    EXPECT_EQ(android::FrameEvents::TIMESTAMP_PENDING, events->dequeueReadyTime);
+}
+
 } // namespace android
@@ -0,0 +1,106 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "TransactionChannel_test"
+
+#include <private/gui/TransactionChannel.h>
+
+#include <gtest/gtest.h>
+
+#include <sys/eventfd.h>
+
+#include <vector>
+
+namespace android {
+
+class TransactionChannelTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        mReader = TransactionChannel::create(64);
+        ASSERT_NE(nullptr, mReader.get());
+        mWriter = TransactionChannel::fromHandle(mReader->getHandle());
+        ASSERT_NE(nullptr, mWriter.get());
+    }
+
+    bool consumeSignal() {
+        eventfd_t value;
+        return eventfd_read(mReader->getEventFd(), &value) == 0;
+    }
+
+    sp<TransactionChannel> mReader;
+    sp<TransactionChannel> mWriter;
+};
+
+TEST_F(TransactionChannelTest, ReadsRecordsInOrder) {
+    std::vector<uint8_t> record;
+    EXPECT_EQ(NOT_ENOUGH_DATA, mReader->read(&record));
+
+    const uint8_t first[] = {1, 2, 3};
+    const uint8_t second[] = {4, 5, 6, 7, 8};
+    ASSERT_EQ(NO_ERROR, mWriter->write(first, sizeof(first)));
+    ASSERT_EQ(NO_ERROR, mWriter->write(second, sizeof(second)));
+
+    ASSERT_EQ(NO_ERROR, mReader->read(&record));
+    EXPECT_EQ(std::vector<uint8_t>(first, first + sizeof(first)), record);
+    ASSERT_EQ(NO_ERROR, mReader->read(&record));
+    EXPECT_EQ(std::vector<uint8_t>(second, second + sizeof(second)), record);
+    EXPECT_EQ(NOT_ENOUGH_DATA, mReader->read(&record));
+}
+
+TEST_F(TransactionChannelTest, RefusesRecordsThatDontFit) {
+    const std::vector<uint8_t> data(28, 0xab);
+    ASSERT_EQ(NO_ERROR, mWriter->write(data.data(), data.size()));
+    ASSERT_EQ(NO_ERROR, mWriter->write(data.data(), data.size()));
+    EXPECT_EQ(-EAGAIN, mWriter->write(data.data(), data.size()));
+
+    // Reading makes room again
+    std::vector<uint8_t> record;
+    ASSERT_EQ(NO_ERROR, mReader->read(&record));
+    EXPECT_EQ(NO_ERROR, mWriter->write(data.data(), data.size()));
+}
+
+TEST_F(TransactionChannelTest, WrapsRecordsAroundTheEnd) {
+    const std::vector<uint8_t> small(20, 0xab);
+    const std::vector<uint8_t> large(28, 0xcd);
+    ASSERT_EQ(NO_ERROR, mWriter->write(small.data(), small.size()));
+    ASSERT_EQ(NO_ERROR, mWriter->write(large.data(), large.size()));
+
+    std::vector<uint8_t> record;
+    ASSERT_EQ(NO_ERROR, mReader->read(&record));
+    EXPECT_EQ(small, record);
+
+    // Starts 8 bytes before the end of the ring
+    const std::vector<uint8_t> wrapped = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
+    ASSERT_EQ(NO_ERROR, mWriter->write(wrapped.data(), wrapped.size()));
+    ASSERT_EQ(NO_ERROR, mReader->read(&record));
+    EXPECT_EQ(large, record);
+    ASSERT_EQ(NO_ERROR, mReader->read(&record));
+    EXPECT_EQ(wrapped, record);
+}
+
+TEST_F(TransactionChannelTest, SignalsOncePerClear) {
+    const uint8_t data[] = {1};
+    ASSERT_EQ(NO_ERROR, mWriter->write(data, sizeof(data)));
+    ASSERT_EQ(NO_ERROR, mWriter->write(data, sizeof(data)));
+    EXPECT_TRUE(consumeSignal());
+    EXPECT_FALSE(consumeSignal());
+
+    mReader->clearSignal();
+    ASSERT_EQ(NO_ERROR, mWriter->write(data, sizeof(data)));
+    EXPECT_TRUE(consumeSignal());
+}
+
+} // namespace android
@@ -20,6 +20,8 @@
 #include <math.h>
 #include <limits.h>
 
+#include <vector>
+
 #include <input/Input.h>
 #include <input/InputEventLabels.h>
 
@@ -385,6 +387,25 @@ static float transformAngle(const float matrix[9], float angleRadians,
     return result;
 }
 
+static void transformPoints(const float matrix[9], size_t count, float* xs, float* ys) {
+    if (matrix[6] != 0 || matrix[7] != 0 || matrix[8] != 1) {
+        for (size_t i = 0; i < count; i++) {
+            transformPoint(matrix, xs[i], ys[i], &xs[i], &ys[i]);
+        }
+        return;
+    }
+
+    // Affine, which is what the window manager uses.  No divide, so the loop vectorizes.
+    const float m0 = matrix[0], m1 = matrix[1], m2 = matrix[2];
+    const float m3 = matrix[3], m4 = matrix[4], m5 = matrix[5];
+    for (size_t i = 0; i < count; i++) {
+        const float x = xs[i];
+        const float y = ys[i];
+        xs[i] = m0 * x + m1 * y + m2;
+        ys[i] = m3 * x + m4 * y + m5;
+    }
+}
+
 void MotionEvent::transform(const float matrix[9]) {
     // The tricky part of this implementation is to preserve the value of
     // rawX and rawY.  So we apply the transformation to the first point
@@ -404,19 +425,33 @@ void MotionEvent::transform(const float matrix[9]) {
     float originX, originY;
     transformPoint(matrix, 0, 0, &originX, &originY);
 
-    // Apply the transformation to all samples.
+    // Gather the locations of all samples into dense arrays and transform them
+    // in one pass rather than looking each axis up in every PointerCoords twice.
     size_t numSamples = mSamplePointerCoords.size();
+    std::vector<float> xs(numSamples);
+    std::vector<float> ys(numSamples);
+    for (size_t i = 0; i < numSamples; i++) {
+        const PointerCoords& c = mSamplePointerCoords.itemAt(i);
+        xs[i] = c.getAxisValue(AMOTION_EVENT_AXIS_X) + oldXOffset;
+        ys[i] = c.getAxisValue(AMOTION_EVENT_AXIS_Y) + oldYOffset;
+    }
+    transformPoints(matrix, numSamples, xs.data(), ys.data());
+
+    // Orientation rarely changes between samples, so only call into the
+    // trigonometry when it does.
+    float orientation = 0;
+    float transformedOrientation = transformAngle(matrix, orientation, originX, originY);
     for (size_t i = 0; i < numSamples; i++) {
         PointerCoords& c = mSamplePointerCoords.editItemAt(i);
-        float x = c.getAxisValue(AMOTION_EVENT_AXIS_X) + oldXOffset;
-        float y = c.getAxisValue(AMOTION_EVENT_AXIS_Y) + oldYOffset;
-        transformPoint(matrix, x, y, &x, &y);
-        c.setAxisValue(AMOTION_EVENT_AXIS_X, x - mXOffset);
-        c.setAxisValue(AMOTION_EVENT_AXIS_Y, y - mYOffset);
-
-        float orientation = c.getAxisValue(AMOTION_EVENT_AXIS_ORIENTATION);
-        c.setAxisValue(AMOTION_EVENT_AXIS_ORIENTATION,
-                transformAngle(matrix, orientation, originX, originY));
+        c.setAxisValue(AMOTION_EVENT_AXIS_X, xs[i] - mXOffset);
+        c.setAxisValue(AMOTION_EVENT_AXIS_Y, ys[i] - mYOffset);
+
+        float sampleOrientation = c.getAxisValue(AMOTION_EVENT_AXIS_ORIENTATION);
+        if (sampleOrientation != orientation) {
+            orientation = sampleOrientation;
+            transformedOrientation = transformAngle(matrix, orientation, originX, originY);
+        }
+        c.setAxisValue(AMOTION_EVENT_AXIS_ORIENTATION, transformedOrientation);
     }
 }
 
@@ -23,10 +23,15 @@
 #include <fcntl.h>
 #include <inttypes.h>
 #include <math.h>
+#include <string.h>
+#include <sys/mman.h>
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <atomic>
+
+#include <cutils/ashmem.h>
 #include <cutils/properties.h>
 #include <log/log.h>
 
@@ -55,9 +60,59 @@ static const nsecs_t RESAMPLE_MIN_DELTA = 2 * NANOS_PER_MS;
 static const nsecs_t RESAMPLE_MAX_DELTA = 20 * NANOS_PER_MS;
 
 // Maximum time to predict forward from the last known state, to avoid predicting too
-// far into the future.  This time is further bounded by 50% of the last time delta.
+// far into the future.  When extrapolating linearly, this time is further bounded by 50%
+// of the last time delta.
 static const nsecs_t RESAMPLE_MAX_PREDICTION = 8 * NANOS_PER_MS;
 
+// Oldest sample, relative to the most recent one, that the predicting strategy fits.
+static const nsecs_t PREDICT_MAX_HISTORY_AGE = 3 * RESAMPLE_MAX_DELTA;
+
+// Size of the data area of a shared memory ring, a power of two.  Bigger than the
+// socket buffer, since messages aren't padded out by the socket layer.
+static const uint32_t RING_CAPACITY = 64 * 1024;
+
+static const uint32_t RING_MAGIC = 0x52494e47; // 'RING'
+
+// Each record in a ring is its length followed by the message, padded to 8 bytes.
+// A length of RING_WRAP means the rest of the data area is unused.
+static const uint32_t RING_RECORD_HEADER_SIZE = 8;
+static const uint32_t RING_WRAP = 0xffffffff;
+
+// Header of a shared memory ring; the data area follows it.  Positions are byte
+// counts modulo twice the capacity, so that a full ring differs from an empty one.
+// The two ends write to separate cache lines.
+struct RingHeader {
+    uint32_t magic;
+    uint32_t capacity;
+    uint32_t reserved0[14];
+    std::atomic<uint32_t> head; // written by the consumer
+    std::atomic<uint32_t> consumerWaiting; // 1 if the consumer wants a doorbell
+    uint32_t reserved1[14];
+    std::atomic<uint32_t> tail; // written by the producer
+    uint32_t reserved2[15];
+};
+
+static_assert(sizeof(RingHeader) == 192, "RingHeader must be the same on 32 and 64 bit");
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t),
+        "std::atomic<uint32_t> must be lock free to be shared between processes");
+
+static const size_t RING_REGION_SIZE = sizeof(RingHeader) + RING_CAPACITY;
+
+static uint32_t ringRecordSize(uint32_t length) {
+    return RING_RECORD_HEADER_SIZE + ((length + 7) & ~7u);
+}
+
+// Moves a valid position on by at most RING_CAPACITY bytes.
+static uint32_t ringAdvance(uint32_t position, uint32_t bytes) {
+    position += bytes;
+    return position >= 2 * RING_CAPACITY ? position - 2 * RING_CAPACITY : position;
+}
+
+// Returns how far to is ahead of from, for valid positions.
+static uint32_t ringDistance(uint32_t from, uint32_t to) {
+    return to >= from ? to - from : to + 2 * RING_CAPACITY - from;
+}
+
 template<typename T>
 inline static T min(const T& a, const T& b) {
     return a < b ? a : b;
@@ -78,6 +133,8 @@ bool InputMessage::isValid(size_t actualSize) const {
             return body.motion.pointerCount > 0
                     && body.motion.pointerCount <= MAX_POINTERS;
         case TYPE_FINISHED:
+        case TYPE_ATTACH_RING:
+        case TYPE_RING_DOORBELL:
             return true;
         }
     }
@@ -97,10 +154,101 @@ size_t InputMessage::size() const {
 }
 
 
+// --- InputChannel::Ring ---
+
+struct InputChannel::Ring {
+    Ring(void* base, bool producer) :
+            header(static_cast<RingHeader*>(base)),
+            data(static_cast<uint8_t*>(base) + sizeof(RingHeader)),
+            producer(producer), position(0) {
+    }
+
+    ~Ring() {
+        munmap(header, RING_REGION_SIZE);
+    }
+
+    status_t push(const InputMessage* msg, bool* outRingDoorbell);
+    status_t pop(InputMessage* msg);
+
+    RingHeader* const header;
+    uint8_t* const data;
+    const bool producer;
+    // The tail for the producer, the head for the consumer.  Kept here rather than
+    // read back from shared memory, which the other end can write to.
+    uint32_t position;
+};
+
+status_t InputChannel::Ring::push(const InputMessage* msg, bool* outRingDoorbell) {
+    const uint32_t length = msg->size();
+    const uint32_t recordSize = ringRecordSize(length);
+    uint32_t offset = position % RING_CAPACITY;
+    const uint32_t contiguous = RING_CAPACITY - offset;
+    const uint32_t needed = contiguous < recordSize ? contiguous + recordSize : recordSize;
+
+    const uint32_t head = header->head.load(std::memory_order_acquire);
+    if (head >= 2 * RING_CAPACITY || ringDistance(head, position) > RING_CAPACITY) {
+        return DEAD_OBJECT; // the consumer broke the ring
+    }
+    const uint32_t used = ringDistance(head, position);
+    if (RING_CAPACITY - used < needed) {
+        return WOULD_BLOCK;
+    }
+
+    if (contiguous < recordSize) {
+        memcpy(data + offset, &RING_WRAP, sizeof(RING_WRAP));
+        position = ringAdvance(position, contiguous);
+        offset = 0;
+    }
+    memcpy(data + offset, &length, sizeof(length));
+    memcpy(data + offset + RING_RECORD_HEADER_SIZE, msg, length);
+    position = ringAdvance(position, recordSize);
+    header->tail.store(position);
+
+    *outRingDoorbell = header->consumerWaiting.exchange(0) != 0;
+    return OK;
+}
+
+status_t InputChannel::Ring::pop(InputMessage* msg) {
+    for (;;) {
+        const uint32_t tail = header->tail.load();
+        if (tail == position) {
+            // Ask for a doorbell, then look again in case the producer just missed it.
+            header->consumerWaiting.store(1);
+            if (header->tail.load() == position) {
+                return WOULD_BLOCK;
+            }
+            header->consumerWaiting.store(0);
+            continue;
+        }
+        if (tail >= 2 * RING_CAPACITY || ringDistance(position, tail) > RING_CAPACITY) {
+            return BAD_VALUE;
+        }
+
+        const uint32_t offset = position % RING_CAPACITY;
+        uint32_t length;
+        memcpy(&length, data + offset, sizeof(length));
+        if (length == RING_WRAP) {
+            position = ringAdvance(position, RING_CAPACITY - offset);
+            header->head.store(position, std::memory_order_release);
+            continue;
+        }
+        if (length > sizeof(InputMessage)
+                || offset + ringRecordSize(length) > RING_CAPACITY) {
+            return BAD_VALUE;
+        }
+
+        memcpy(msg, data + offset + RING_RECORD_HEADER_SIZE, length);
+        position = ringAdvance(position, ringRecordSize(length));
+        header->head.store(position, std::memory_order_release);
+        return msg->isValid(length) ? OK : BAD_VALUE;
+    }
+}
+
+
 // --- InputChannel ---
 
 InputChannel::InputChannel(const std::string& name, int fd) :
-        mName(name), mFd(fd) {
+        mName(name), mFd(fd), mRing(NULL) {
 #if DEBUG_CHANNEL_LIFECYCLE
     ALOGD("Input channel constructed: name='%s', fd=%d",
             mName.c_str(), fd);
@@ -117,6 +265,7 @@ InputChannel::~InputChannel() {
             mName.c_str(), mFd);
 #endif
 
+    delete mRing;
     ::close(mFd);
 }
 
@@ -149,11 +298,61 @@ status_t InputChannel::openInputChannelPair(const std::string& name,
 }
 
 status_t InputChannel::sendMessage(const InputMessage* msg) {
+    if (mRing == NULL || !mRing->producer) {
+        return sendSocketMessage(msg, -1);
+    }
+
+    bool ringDoorbell = false;
+    status_t status = mRing->push(msg, &ringDoorbell);
+#if DEBUG_CHANNEL_MESSAGES
+    ALOGD("channel '%s' ~ pushed message of type %d to the ring, status=%d", mName.c_str(),
+            msg->header.type, status);
+#endif
+    if (status == OK && ringDoorbell) {
+        InputMessage doorbell;
+        doorbell.header.type = InputMessage::TYPE_RING_DOORBELL;
+        doorbell.header.padding = 0;
+        status_t result = sendSocketMessage(&doorbell, -1);
+        // If the socket is full the consumer has yet to read it, and will find the
+        // message in the ring then.
+        if (result != OK && result != WOULD_BLOCK) {
+            return result;
+        }
+    }
+    return status;
+}
+
+status_t InputChannel::sendSocketMessage(const InputMessage* msg, int fd) {
     size_t msgLength = msg->size();
     ssize_t nWrite;
-    do {
-        nWrite = ::send(mFd, msg, msgLength, MSG_DONTWAIT | MSG_NOSIGNAL);
-    } while (nWrite == -1 && errno == EINTR);
+    if (fd < 0) {
+        do {
+            nWrite = ::send(mFd, msg, msgLength, MSG_DONTWAIT | MSG_NOSIGNAL);
+        } while (nWrite == -1 && errno == EINTR);
+    } else {
+        struct iovec iov;
+        iov.iov_base = const_cast<InputMessage*>(msg);
+        iov.iov_len = msgLength;
+        union {
+            struct cmsghdr align;
+            char buffer[CMSG_SPACE(sizeof(int))];
+        } control;
+        memset(&control, 0, sizeof(control));
+        struct msghdr header;
+        memset(&header, 0, sizeof(header));
+        header.msg_iov = &iov;
+        header.msg_iovlen = 1;
+        header.msg_control = control.buffer;
+        header.msg_controllen = sizeof(control.buffer);
+        struct cmsghdr* cmsg = CMSG_FIRSTHDR(&header);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+        do {
+            nWrite = ::sendmsg(mFd, &header, MSG_DONTWAIT | MSG_NOSIGNAL);
+        } while (nWrite == -1 && errno == EINTR);
+    }
 
     if (nWrite < 0) {
         int error = errno;
@@ -185,9 +384,62 @@ status_t InputChannel::sendMessage(const InputMessage* msg) {
 }
 
 status_t InputChannel::receiveMessage(InputMessage* msg) {
+    for (;;) {
+        if (mRing != NULL && !mRing->producer) {
+            status_t status = mRing->pop(msg);
+            if (status != WOULD_BLOCK) {
+#if DEBUG_CHANNEL_MESSAGES
+                ALOGD("channel '%s' ~ popped message from the ring, status=%d", mName.c_str(),
+                        status);
+#endif
+                return status;
+            }
+        }
+
+        int fd = -1;
+        status_t status = receiveSocketMessage(msg, &fd);
+        if (status) {
+            return status;
+        }
+        switch (msg->header.type) {
+        case InputMessage::TYPE_RING_DOORBELL:
+            if (fd >= 0) {
+                ::close(fd);
+            }
+            continue;
+        case InputMessage::TYPE_ATTACH_RING:
+            status = attachRing(fd);
+            if (status) {
+                return status;
+            }
+            continue;
+        default:
+            if (fd >= 0) {
+                ::close(fd);
+            }
+            return OK;
+        }
+    }
+}
+
+status_t InputChannel::receiveSocketMessage(InputMessage* msg, int* outFd) {
+    struct iovec iov;
+    iov.iov_base = msg;
+    iov.iov_len = sizeof(InputMessage);
+    union {
+        struct cmsghdr align;
+        char buffer[CMSG_SPACE(sizeof(int))];
+    } control;
+    struct msghdr header;
+    memset(&header, 0, sizeof(header));
+    header.msg_iov = &iov;
+    header.msg_iovlen = 1;
+    header.msg_control = control.buffer;
+    header.msg_controllen = sizeof(control.buffer);
+
     ssize_t nRead;
     do {
-        nRead = ::recv(mFd, msg, sizeof(InputMessage), MSG_DONTWAIT);
+        nRead = ::recvmsg(mFd, &header, MSG_DONTWAIT | MSG_CMSG_CLOEXEC);
     } while (nRead == -1 && errno == EINTR);
 
     if (nRead < 0) {
@@ -211,12 +463,25 @@ status_t InputChannel::receiveMessage(InputMessage* msg) {
         return DEAD_OBJECT;
     }
 
+    int fd = -1;
+    for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&header); cmsg != NULL;
+            cmsg = CMSG_NXTHDR(&header, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS
+                && cmsg->cmsg_len == CMSG_LEN(sizeof(int))) {
+            memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+        }
+    }
+
     if (!msg->isValid(nRead)) {
 #if DEBUG_CHANNEL_MESSAGES
         ALOGD("channel '%s' ~ received invalid message", mName.c_str());
 #endif
+        if (fd >= 0) {
+            ::close(fd);
+        }
         return BAD_VALUE;
     }
+    *outFd = fd;
 
 #if DEBUG_CHANNEL_MESSAGES
     ALOGD("channel '%s' ~ received message of type %d", mName.c_str(), msg->header.type);
@@ -224,6 +489,83 @@ status_t InputChannel::receiveMessage(InputMessage* msg) {
     return OK;
 }
 
+status_t InputChannel::enableSharedMemoryTransport() {
+    if (mRing != NULL) {
+        return INVALID_OPERATION;
+    }
+
+    int fd = ashmem_create_region(mName.c_str(), RING_REGION_SIZE);
+    if (fd < 0) {
+        ALOGE("channel '%s' ~ Could not create a shared memory ring.  errno=%d",
+                mName.c_str(), errno);
+        return NO_MEMORY;
+    }
+    void* base = mmap(NULL, RING_REGION_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) {
+        ALOGE("channel '%s' ~ Could not map the shared memory ring.  errno=%d",
+                mName.c_str(), errno);
+        ::close(fd);
+        return NO_MEMORY;
+    }
+
+    // ashmem regions start zeroed.
+    RingHeader* header = static_cast<RingHeader*>(base);
+    header->magic = RING_MAGIC;
+    header->capacity = RING_CAPACITY;
+    header->consumerWaiting.store(1);
+
+    InputMessage msg;
+    msg.header.type = InputMessage::TYPE_ATTACH_RING;
+    msg.header.padding = 0;
+    status_t status = sendSocketMessage(&msg, fd);
+    ::close(fd);
+    if (status) {
+        ALOGE("channel '%s' ~ Could not hand the shared memory ring over, status=%d",
+                mName.c_str(), status);
+        munmap(base, RING_REGION_SIZE);
+        return status;
+    }
+
+    mRing = new Ring(base, true /*producer*/);
+    return OK;
+}
+
+status_t InputChannel::attachRing(int fd) {
+    if (fd < 0 || mRing != NULL || ashmem_get_size_region(fd) != int(RING_REGION_SIZE)) {
+        ALOGE("channel '%s' ~ Received an unusable shared memory ring", mName.c_str());
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        return BAD_VALUE;
+    }
+
+    void* base = mmap(NULL, RING_REGION_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (base == MAP_FAILED) {
+        ALOGE("channel '%s' ~ Could not map the shared memory ring.  errno=%d",
+                mName.c_str(), errno);
+        return NO_MEMORY;
+    }
+    const RingHeader* header = static_cast<const RingHeader*>(base);
+    if (header->magic != RING_MAGIC || header->capacity != RING_CAPACITY) {
+        ALOGE("channel '%s' ~ Received an unusable shared memory ring", mName.c_str());
+        munmap(base, RING_REGION_SIZE);
+        return BAD_VALUE;
+    }
+
+    mRing = new Ring(base, false /*producer*/);
+    mRing->position = header->head.load(std::memory_order_acquire);
+    if (mRing->position >= 2 * RING_CAPACITY) {
+        delete mRing;
+        mRing = NULL;
+        return BAD_VALUE;
+    }
+#if DEBUG_CHANNEL_MESSAGES
+    ALOGD("channel '%s' ~ attached the shared memory ring", mName.c_str());
+#endif
+    return OK;
+}
+
 sp<InputChannel> InputChannel::dup() const {
     int fd = ::dup(getFd());
     return fd >= 0 ? new InputChannel(getName(), fd) : NULL;
@@ -376,7 +718,20 @@ status_t InputPublisher::receiveFinishedSignal(uint32_t* outSeq, bool* outHandle
 
 InputConsumer::InputConsumer(const sp<InputChannel>& channel) :
         mResampleTouch(isTouchResamplingEnabled()),
+        mResampleStrategy(RESAMPLE_STRATEGY_LINEAR),
+        mPredictionCount(0), mPredictionErrorSum(0), mPredictionErrorMax(0),
         mChannel(channel), mMsgDeferred(false) {
+    // Allow the default strategy to be overridden using a system property for debugging.
+    char value[PROPERTY_VALUE_MAX];
+    int length = property_get("debug.input.resample_strategy", value, NULL);
+    if (length > 0) {
+        if (!strcmp("predict", value)) {
+            mResampleStrategy = RESAMPLE_STRATEGY_PREDICT;
+        } else if (strcmp("linear", value)) {
+            ALOGD("Unrecognized property value for 'debug.input.resample_strategy'.  "
+                    "Use 'linear' or 'predict'.");
+        }
+    }
 }
 
 InputConsumer::~InputConsumer() {
@@ -397,6 +752,23 @@ bool InputConsumer::isTouchResamplingEnabled() {
     return true;
 }
 
+void InputConsumer::setResampleStrategy(ResampleStrategy strategy) {
+    mResampleStrategy = strategy;
+}
+
+InputConsumer::PredictionStats InputConsumer::getPredictionStats() const {
+    PredictionStats stats;
+    stats.count = mPredictionCount;
+    stats.meanError = mPredictionCount ? mPredictionErrorSum / mPredictionCount : 0;
+    stats.maxError = mPredictionErrorMax;
+    return stats;
+}
+
+nsecs_t InputConsumer::getResampleLatency() const {
+    // Predicting aims for the frame time itself.
+    return mResampleStrategy == RESAMPLE_STRATEGY_PREDICT ? 0 : RESAMPLE_LATENCY;
+}
+
 status_t InputConsumer::consume(InputEventFactoryInterface* factory,
         bool consumeBatches, nsecs_t frameTime, uint32_t* outSeq, InputEvent** outEvent,
         int32_t* displayId) {
@@ -662,7 +1034,7 @@ status_t InputConsumer::consumeBatch(InputEventFactoryInterface* factory,
 
         nsecs_t sampleTime = frameTime;
         if (mResampleTouch) {
-            sampleTime -= RESAMPLE_LATENCY;
+            sampleTime -= getResampleLatency();
         }
         ssize_t split = findSampleNoLaterThan(batch, sampleTime);
         if (split < 0) {
@@ -702,7 +1074,7 @@ status_t InputConsumer::consumeBatch(InputEventFactoryInterface* factory,
 
         nsecs_t sampleTime = frameTime;
         if (mResampleTouch && (*touchMoveNumber != 1)) {
-            sampleTime -= RESAMPLE_LATENCY;
+            sampleTime -= getResampleLatency();
         }
         ssize_t split = findSampleNoLaterThan(batch, sampleTime);
         if (split < 0) {
@@ -783,6 +1155,7 @@ void InputConsumer::updateTouchState(InputMessage& msg) {
         ssize_t index = findTouchState(deviceId, source);
         if (index >= 0) {
             TouchState& touchState = mTouchStates.editItemAt(index);
+            scorePrediction(touchState, msg);
             touchState.addHistory(msg);
             rewriteMessage(touchState, msg);
         }
@@ -831,6 +1204,47 @@ void InputConsumer::updateTouchState(InputMessage& msg) {
     }
 }
 
+/**
+ * Once a sample at or past the time of an extrapolated lastResample arrives, compare the
+ * prediction with where the pointer actually was at that time, interpolated between the
+ * surrounding samples.
+ */
+void InputConsumer::scorePrediction(TouchState& state, const InputMessage& msg) {
+    const History& prediction = state.lastResample;
+    nsecs_t eventTime = msg.body.motion.eventTime;
+    if (!state.lastResamplePredicted || eventTime < prediction.eventTime) {
+        return;
+    }
+    state.lastResamplePredicted = false;
+
+    const History* previous = state.getHistory(0);
+    nsecs_t delta = eventTime - previous->eventTime;
+    if (delta <= 0 || prediction.eventTime < previous->eventTime) {
+        return;
+    }
+    float alpha = float(prediction.eventTime - previous->eventTime) / delta;
+    for (uint32_t i = 0; i < msg.body.motion.pointerCount; i++) {
+        uint32_t id = msg.body.motion.pointers[i].properties.id;
+        if (!prediction.hasPointerId(id) || !previous->hasPointerId(id)) {
+            continue;
+        }
+        const PointerCoords& predictedCoords = prediction.getPointerById(id);
+        const PointerCoords& previousCoords = previous->getPointerById(id);
+        const PointerCoords& nextCoords = msg.body.motion.pointers[i].coords;
+        float dx = lerp(previousCoords.getX(), nextCoords.getX(), alpha) - predictedCoords.getX();
+        float dy = lerp(previousCoords.getY(), nextCoords.getY(), alpha) - predictedCoords.getY();
+        float error = sqrtf(dx * dx + dy * dy);
+#if DEBUG_RESAMPLING
+        ALOGD("[%d] - prediction error %0.3f", id, error);
+#endif
+        mPredictionCount += 1;
+        mPredictionErrorSum += error;
+        if (error > mPredictionErrorMax) {
+            mPredictionErrorMax = error;
+        }
+    }
+}
+
 /**
  * Replace the coordinates in msg with the coordinates in lastResample, if necessary.
  *
@@ -906,6 +1320,7 @@ void InputConsumer::resampleTouchState(nsecs_t sampleTime, MotionEvent* event,
     const History* other;
     History future;
     float alpha;
+    bool predicted = false;
     if (next) {
         // Interpolate between current sample and future sample.
         // So current->eventTime <= sampleTime <= future.eventTime.
@@ -935,7 +1350,11 @@ void InputConsumer::resampleTouchState(nsecs_t sampleTime, MotionEvent* event,
 #endif
             return;
         }
-        nsecs_t maxPredict = current->eventTime + min(delta / 2, RESAMPLE_MAX_PREDICTION);
+        nsecs_t maxPredict = current->eventTime + RESAMPLE_MAX_PREDICTION;
+        if (mResampleStrategy == RESAMPLE_STRATEGY_LINEAR) {
+            // Two samples alone are too noisy to extrapolate from for long.
+            maxPredict = current->eventTime + min(delta / 2, RESAMPLE_MAX_PREDICTION);
+        }
         if (sampleTime > maxPredict) {
 #if DEBUG_RESAMPLING
             ALOGD("Sample time is too far in the future, adjusting prediction "
@@ -945,6 +1364,7 @@ void InputConsumer::resampleTouchState(nsecs_t sampleTime, MotionEvent* event,
             sampleTime = maxPredict;
         }
         alpha = float(current->eventTime - sampleTime) / delta;
+        predicted = true;
     } else {
 #if DEBUG_RESAMPLING
         ALOGD("Not resampled, insufficient data.");
@@ -957,6 +1377,7 @@ void InputConsumer::resampleTouchState(nsecs_t sampleTime, MotionEvent* event,
     oldLastResample.initializeFrom(touchState.lastResample);
     touchState.lastResample.eventTime = sampleTime;
     touchState.lastResample.idBits.clear();
+    touchState.lastResamplePredicted = predicted;
     for (size_t i = 0; i < pointerCount; i++) {
         uint32_t id = event->getPointerId(i);
         touchState.lastResample.idToIndex[id] = i;
@@ -979,10 +1400,14 @@ void InputConsumer::resampleTouchState(nsecs_t sampleTime, MotionEvent* event,
         if (other->idBits.hasBit(id)
                 && shouldResampleTool(event->getToolType(i))) {
             const PointerCoords& otherCoords = other->getPointerById(id);
-            resampledCoords.setAxisValue(AMOTION_EVENT_AXIS_X,
-                    lerp(currentCoords.getX(), otherCoords.getX(), alpha));
-            resampledCoords.setAxisValue(AMOTION_EVENT_AXIS_Y,
-                    lerp(currentCoords.getY(), otherCoords.getY(), alpha));
+            float x, y;
+            if (!predicted || mResampleStrategy != RESAMPLE_STRATEGY_PREDICT
+                    || !touchState.predictPointer(id, sampleTime, &x, &y)) {
+                x = lerp(currentCoords.getX(), otherCoords.getX(), alpha);
+                y = lerp(currentCoords.getY(), otherCoords.getY(), alpha);
+            }
+            resampledCoords.setAxisValue(AMOTION_EVENT_AXIS_X, x);
+            resampledCoords.setAxisValue(AMOTION_EVENT_AXIS_Y, y);
 #if DEBUG_RESAMPLING
             ALOGD("[%d] - out (%0.3f, %0.3f), cur (%0.3f, %0.3f), "
                     "other (%0.3f, %0.3f), alpha %0.3f",
@@ -1003,6 +1428,34 @@ void InputConsumer::resampleTouchState(nsecs_t sampleTime, MotionEvent* event,
     event->addSample(sampleTime, touchState.lastResample.pointers);
 }
 
+bool InputConsumer::TouchState::predictPointer(uint32_t id, nsecs_t time,
+        float* outX, float* outY) const {
+    // Fit a line through the most recent sample, so that the prediction starts from
+    // where the pointer was last seen rather than from the middle of the history.
+    const History* current = getHistory(0);
+    const PointerCoords& currentCoords = current->getPointerById(id);
+    float stt = 0, stx = 0, sty = 0;
+    for (size_t i = 1; i < historySize; i++) {
+        const History* past = getHistory(i);
+        if (!past->hasPointerId(id)
+                || current->eventTime - past->eventTime > PREDICT_MAX_HISTORY_AGE) {
+            break;
+        }
+        const PointerCoords& pastCoords = past->getPointerById(id);
+        float t = float(past->eventTime - current->eventTime) / NANOS_PER_MS;
+        stt += t * t;
+        stx += t * (pastCoords.getX() - currentCoords.getX());
+        sty += t * (pastCoords.getY() - currentCoords.getY());
+    }
+    if (stt == 0) {
+        return false;
+    }
+    float t = float(time - current->eventTime) / NANOS_PER_MS;
+    *outX = currentCoords.getX() + t * stx / stt;
+    *outY = currentCoords.getY() + t * sty / stt;
+    return true;
+}
+
 bool InputConsumer::shouldResampleTool(int32_t toolType) {
     return toolType == AMOTION_EVENT_TOOL_TYPE_FINGER
             || toolType == AMOTION_EVENT_TOOL_TYPE_UNKNOWN;
@@ -16,14 +16,18 @@
 
 #define LOG_TAG "KeyCharacterMap"
 
+#include <errno.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include <algorithm>
+
 #ifdef __ANDROID__
 #include <binder/Parcel.h>
 #endif
 
 #include <android/keycodes.h>
+#include <android-base/file.h>
 #include <input/InputEventLabels.h>
 #include <input/Keyboard.h>
 #include <input/KeyCharacterMap.h>
@@ -93,7 +97,9 @@ KeyCharacterMap::KeyCharacterMap() :
 
 KeyCharacterMap::KeyCharacterMap(const KeyCharacterMap& other) :
     RefBase(), mType(other.mType), mKeysByScanCode(other.mKeysByScanCode),
-    mKeysByUsageCode(other.mKeysByUsageCode) {
+    mKeysByUsageCode(other.mKeysByUsageCode), mKeyIndex(other.mKeyIndex),
+    mFlatKeys(other.mFlatKeys), mFlatBehaviors(other.mFlatBehaviors),
+    mCharacterKeys(other.mCharacterKeys) {
     for (size_t i = 0; i < other.mKeys.size(); i++) {
         mKeys.add(other.mKeys.keyAt(i), new Key(*other.mKeys.valueAt(i)));
     }
@@ -111,12 +117,46 @@ status_t KeyCharacterMap::load(const String8& filename,
     outMap->clear();
 
     Tokenizer* tokenizer;
-    status_t status = Tokenizer::open(filename, &tokenizer);
+    status_t status;
+    if (!KeyMapCache::isEnabled()) {
+        status = Tokenizer::open(filename, &tokenizer);
+        if (status) {
+            ALOGE("Error %d opening key character map file %s.", status, filename.string());
+        } else {
+            status = load(tokenizer, format, outMap);
+            delete tokenizer;
+        }
+        return status;
+    }
+
+    std::string contents;
+    if (!android::base::ReadFileToString(filename.string(), &contents)) {
+        status = -errno;
+        ALOGE("Error %d opening key character map file %s.", status, filename.string());
+        return status;
+    }
+
+    // The format decides which files parse at all, so entries are kept per format.
+    const uint64_t contentsHash = KeyMapCache::hashContents(contents.data(), contents.size());
+    sp<KeyCharacterMap> map = new KeyCharacterMap();
+    if (!KeyMapCache::read(KeyMapCache::KIND_KEY_CHARACTER_MAP, format, contentsHash,
+            [&map](KeyMapCache::Reader& reader) { return map->readFromCache(reader); })) {
+        map->buildLookupTables();
+        *outMap = map;
+        return OK;
+    }
+
+    status = Tokenizer::fromContents(filename, contents.c_str(), &tokenizer);
     if (status) {
         ALOGE("Error %d opening key character map file %s.", status, filename.string());
     } else {
         status = load(tokenizer, format, outMap);
         delete tokenizer;
+        if (!status) {
+            KeyMapCache::Writer writer;
+            (*outMap)->writeToCache(writer);
+            KeyMapCache::write(KeyMapCache::KIND_KEY_CHARACTER_MAP, format, contentsHash, writer);
+        }
     }
     return status;
 }
@@ -156,12 +196,88 @@ status_t KeyCharacterMap::load(Tokenizer* tokenizer,
                 elapsedTime / 1000000.0);
 #endif
         if (!status) {
+            map->buildLookupTables();
             *outMap = map;
         }
     }
     return status;
 }
 
+void KeyCharacterMap::writeToCache(KeyMapCache::Writer& writer) const {
+    writer.writeInt32(mType);
+
+    writer.writeInt32(int32_t(mKeys.size()));
+    for (size_t i = 0; i < mKeys.size(); i++) {
+        const Key* key = mKeys.valueAt(i);
+        int32_t behaviorCount = 0;
+        for (const Behavior* behavior = key->firstBehavior; behavior != NULL;
+                behavior = behavior->next) {
+            behaviorCount++;
+        }
+        writer.writeInt32(mKeys.keyAt(i));
+        writer.writeInt32(key->label);
+        writer.writeInt32(key->number);
+        writer.writeInt32(behaviorCount);
+        for (const Behavior* behavior = key->firstBehavior; behavior != NULL;
+                behavior = behavior->next) {
+            writer.writeInt32(behavior->metaState);
+            writer.writeInt32(behavior->character);
+            writer.writeInt32(behavior->fallbackKeyCode);
+            writer.writeInt32(behavior->replacementKeyCode);
+        }
+    }
+
+    const KeyedVector<int32_t, int32_t>* codeMaps[] = { &mKeysByScanCode, &mKeysByUsageCode };
+    for (const KeyedVector<int32_t, int32_t>* codes : codeMaps) {
+        writer.writeInt32(int32_t(codes->size()));
+        for (size_t i = 0; i < codes->size(); i++) {
+            writer.writeInt32(codes->keyAt(i));
+            writer.writeInt32(codes->valueAt(i));
+        }
+    }
+}
+
+status_t KeyCharacterMap::readFromCache(KeyMapCache::Reader& reader) {
+    mType = reader.readInt32();
+
+    // Entries were written in key order, so each add() appends.
+    const size_t numKeys = reader.readCount(4);
+    if (numKeys > MAX_KEYS) {
+        return BAD_VALUE;
+    }
+    mKeys.setCapacity(numKeys);
+    for (size_t i = 0; i < numKeys; i++) {
+        int32_t keyCode = reader.readInt32();
+        Key* key = new Key();
+        key->label = char16_t(reader.readInt32());
+        key->number = char16_t(reader.readInt32());
+        mKeys.add(keyCode, key);
+
+        const size_t numBehaviors = reader.readCount(4);
+        Behavior** nextBehavior = &key->firstBehavior;
+        for (size_t j = 0; j < numBehaviors; j++) {
+            Behavior* behavior = new Behavior();
+            behavior->metaState = reader.readInt32();
+            behavior->character = char16_t(reader.readInt32());
+            behavior->fallbackKeyCode = reader.readInt32();
+            behavior->replacementKeyCode = reader.readInt32();
+            *nextBehavior = behavior;
+            nextBehavior = &behavior->next;
+        }
+    }
+
+    KeyedVector<int32_t, int32_t>* codeMaps[] = { &mKeysByScanCode, &mKeysByUsageCode };
+    for (KeyedVector<int32_t, int32_t>* codes : codeMaps) {
+        const size_t count = reader.readCount(2);
+        codes->setCapacity(count);
+        for (size_t i = 0; i < count; i++) {
+            int32_t code = reader.readInt32();
+            codes->add(code, reader.readInt32());
+        }
+    }
+    return reader.hasError() ? BAD_VALUE : OK;
+}
+
 sp<KeyCharacterMap> KeyCharacterMap::combine(const sp<KeyCharacterMap>& base,
         const sp<KeyCharacterMap>& overlay) {
     if (overlay == NULL) {
@@ -193,9 +309,77 @@ sp<KeyCharacterMap> KeyCharacterMap::combine(const sp<KeyCharacterMap>& base,
         map->mKeysByUsageCode.replaceValueFor(overlay->mKeysByUsageCode.keyAt(i),
                 overlay->mKeysByUsageCode.valueAt(i));
     }
+    map->buildLookupTables();
     return map;
 }
 
+void KeyCharacterMap::buildLookupTables() {
+    mKeyIndex.clear();
+    mFlatKeys.clear();
+    mFlatBehaviors.clear();
+    mCharacterKeys.clear();
+
+    mFlatKeys.reserve(mKeys.size());
+    for (size_t i = 0; i < mKeys.size(); i++) {
+        const Key* key = mKeys.valueAt(i);
+        FlatKey flatKey;
+        flatKey.label = key->label;
+        flatKey.number = key->number;
+        flatKey.flags = 0;
+        flatKey.firstBehavior = uint32_t(mFlatBehaviors.size());
+        for (const Behavior* behavior = key->firstBehavior; behavior; behavior = behavior->next) {
+            FlatBehavior flatBehavior;
+            flatBehavior.metaState = behavior->metaState;
+            flatBehavior.fallbackKeyCode = behavior->fallbackKeyCode;
+            flatBehavior.replacementKeyCode = behavior->replacementKeyCode;
+            flatBehavior.character = behavior->character;
+            mFlatBehaviors.push_back(flatBehavior);
+            if (behavior->fallbackKeyCode) {
+                flatKey.flags |= FlatKey::FLAG_HAS_FALLBACK;
+            }
+            if (behavior->replacementKeyCode) {
+                flatKey.flags |= FlatKey::FLAG_HAS_REPLACEMENT;
+            }
+            if (behavior->character) {
+                mCharacterKeys.push_back({behavior->character, mKeys.keyAt(i),
+                        behavior->metaState});
+            }
+        }
+        flatKey.behaviorCount = uint32_t(mFlatBehaviors.size()) - flatKey.firstBehavior;
+        mFlatKeys.push_back(flatKey);
+
+        // mKeys is sorted, so the index only ever grows at the end.
+        const int32_t keyCode = mKeys.keyAt(i);
+        if (keyCode >= 0 && keyCode < MAX_KEYS) {
+            mKeyIndex.resize(size_t(keyCode) + 1, -1);
+            mKeyIndex[keyCode] = int32_t(i);
+        }
+    }
+
+    // A character is typed with the first key that generates it, using the most
+    // general of that key's behaviors, which comes last.  The sort keeps the
+    // entries for each character in key and behavior order.
+    std::stable_sort(mCharacterKeys.begin(), mCharacterKeys.end(),
+            [](const CharacterKey& a, const CharacterKey& b) {
+                return a.character < b.character;
+            });
+    size_t count = 0;
+    for (size_t i = 0; i < mCharacterKeys.size(); ) {
+        const CharacterKey first = mCharacterKeys[i];
+        size_t j = i + 1;
+        while (j < mCharacterKeys.size() && mCharacterKeys[j].character == first.character
+                && mCharacterKeys[j].keyCode == first.keyCode) {
+            j++;
+        }
+        mCharacterKeys[count++] = mCharacterKeys[j - 1];
+        while (j < mCharacterKeys.size() && mCharacterKeys[j].character == first.character) {
+            j++;
+        }
+        i = j;
+    }
+    mCharacterKeys.resize(count);
+}
+
 sp<KeyCharacterMap> KeyCharacterMap::empty() {
     return sEmpty;
 }
@@ -206,7 +390,7 @@ int32_t KeyCharacterMap::getKeyboardType() const {
 
 char16_t KeyCharacterMap::getDisplayLabel(int32_t keyCode) const {
     char16_t result = 0;
-    const Key* key;
+    const FlatKey* key;
     if (getKey(keyCode, &key)) {
         result = key->label;
     }
@@ -218,7 +402,7 @@ char16_t KeyCharacterMap::getDisplayLabel(int32_t keyCode) const {
 
 char16_t KeyCharacterMap::getNumber(int32_t keyCode) const {
     char16_t result = 0;
-    const Key* key;
+    const FlatKey* key;
     if (getKey(keyCode, &key)) {
         result = key->number;
     }
@@ -230,8 +414,8 @@ char16_t KeyCharacterMap::getNumber(int32_t keyCode) const {
 
 char16_t KeyCharacterMap::getCharacter(int32_t keyCode, int32_t metaState) const {
     char16_t result = 0;
-    const Key* key;
-    const Behavior* behavior;
+    const FlatKey* key;
+    const FlatBehavior* behavior;
     if (getKeyBehavior(keyCode, metaState, &key, &behavior)) {
         result = behavior->character;
     }
@@ -247,9 +431,11 @@ bool KeyCharacterMap::getFallbackAction(int32_t keyCode, int32_t metaState,
     outFallbackAction->metaState = 0;
 
     bool result = false;
-    const Key* key;
-    const Behavior* behavior;
-    if (getKeyBehavior(keyCode, metaState, &key, &behavior)) {
+    const FlatKey* key;
+    const FlatBehavior* behavior;
+    // Most keys have no fallbacks, so their behaviors need not be matched at all.
+    if (getKey(keyCode, &key) && (key->flags & FlatKey::FLAG_HAS_FALLBACK)
+            && getKeyBehavior(keyCode, metaState, &key, &behavior)) {
         if (behavior->fallbackKeyCode) {
             outFallbackAction->keyCode = behavior->fallbackKeyCode;
             outFallbackAction->metaState = metaState & ~behavior->metaState;
@@ -268,12 +454,14 @@ bool KeyCharacterMap::getFallbackAction(int32_t keyCode, int32_t metaState,
 char16_t KeyCharacterMap::getMatch(int32_t keyCode, const char16_t* chars, size_t numChars,
         int32_t metaState) const {
     char16_t result = 0;
-    const Key* key;
+    const FlatKey* key;
     if (getKey(keyCode, &key)) {
         // Try to find the most general behavior that maps to this character.
         // For example, the base key behavior will usually be last in the list.
         // However, if we find a perfect meta state match for one behavior then use that one.
-        for (const Behavior* behavior = key->firstBehavior; behavior; behavior = behavior->next) {
+        const FlatBehavior* behaviors = mFlatBehaviors.data() + key->firstBehavior;
+        for (uint32_t j = 0; j < key->behaviorCount; j++) {
+            const FlatBehavior* behavior = &behaviors[j];
             if (behavior->character) {
                 for (size_t i = 0; i < numChars; i++) {
                     if (behavior->character == chars[i]) {
@@ -364,9 +552,10 @@ void KeyCharacterMap::tryRemapKey(int32_t keyCode, int32_t metaState,
     *outKeyCode = keyCode;
     *outMetaState = metaState;
 
-    const Key* key;
-    const Behavior* behavior;
-    if (getKeyBehavior(keyCode, metaState, &key, &behavior)) {
+    const FlatKey* key;
+    const FlatBehavior* behavior;
+    if (getKey(keyCode, &key) && (key->flags & FlatKey::FLAG_HAS_REPLACEMENT)
+            && getKeyBehavior(keyCode, metaState, &key, &behavior)) {
         if (behavior->replacementKeyCode) {
             *outKeyCode = behavior->replacementKeyCode;
             int32_t newMetaState = metaState & ~behavior->metaState;
@@ -401,27 +590,31 @@ void KeyCharacterMap::tryRemapKey(int32_t keyCode, int32_t metaState,
 #endif
 }
 
-bool KeyCharacterMap::getKey(int32_t keyCode, const Key** outKey) const {
-    ssize_t index = mKeys.indexOfKey(keyCode);
+bool KeyCharacterMap::getKey(int32_t keyCode, const FlatKey** outKey) const {
+    ssize_t index;
+    if (keyCode >= 0 && keyCode < MAX_KEYS) {
+        index = size_t(keyCode) < mKeyIndex.size() ? mKeyIndex[keyCode] : -1;
+    } else {
+        index = mKeys.indexOfKey(keyCode);
+    }
     if (index >= 0) {
-        *outKey = mKeys.valueAt(index);
+        *outKey = &mFlatKeys[index];
         return true;
     }
     return false;
 }
 
 bool KeyCharacterMap::getKeyBehavior(int32_t keyCode, int32_t metaState,
-        const Key** outKey, const Behavior** outBehavior) const {
-    const Key* key;
+        const FlatKey** outKey, const FlatBehavior** outBehavior) const {
+    const FlatKey* key;
     if (getKey(keyCode, &key)) {
-        const Behavior* behavior = key->firstBehavior;
-        while (behavior) {
-            if (matchesMetaState(metaState, behavior->metaState)) {
+        const FlatBehavior* behaviors = mFlatBehaviors.data() + key->firstBehavior;
+        for (uint32_t i = 0; i < key->behaviorCount; i++) {
+            if (matchesMetaState(metaState, behaviors[i].metaState)) {
                 *outKey = key;
-                *outBehavior = behavior;
+                *outBehavior = &behaviors[i];
                 return true;
             }
-            behavior = behavior->next;
         }
     }
     return false;
@@ -463,22 +656,14 @@ bool KeyCharacterMap::findKey(char16_t ch, int32_t* outKeyCode, int32_t* outMeta
         return false;
     }
 
-    for (size_t i = 0; i < mKeys.size(); i++) {
-        const Key* key = mKeys.valueAt(i);
-
-        // Try to find the most general behavior that maps to this character.
-        // For example, the base key behavior will usually be last in the list.
-        const Behavior* found = NULL;
-        for (const Behavior* behavior = key->firstBehavior; behavior; behavior = behavior->next) {
-            if (behavior->character == ch) {
-                found = behavior;
-            }
-        }
-        if (found) {
-            *outKeyCode = mKeys.keyAt(i);
-            *outMetaState = found->metaState;
-            return true;
-        }
+    auto it = std::lower_bound(mCharacterKeys.begin(), mCharacterKeys.end(), ch,
+            [](const CharacterKey& characterKey, char16_t character) {
+                return characterKey.character < character;
+            });
+    if (it != mCharacterKeys.end() && it->character == ch) {
+        *outKeyCode = it->keyCode;
+        *outMetaState = it->metaState;
+        return true;
     }
     return false;
 }
@@ -652,6 +837,7 @@ sp<KeyCharacterMap> KeyCharacterMap::readFromParcel(Parcel* parcel) {
             return NULL;
         }
     }
+    map->buildLookupTables();
     return map;
 }
 
@@ -16,12 +16,15 @@
 
 #define LOG_TAG "KeyLayoutMap"
 
+#include <errno.h>
 #include <stdlib.h>
 
 #include <android/keycodes.h>
+#include <android-base/file.h>
 #include <input/InputEventLabels.h>
 #include <input/Keyboard.h>
 #include <input/KeyLayoutMap.h>
+#include <input/KeyMapCache.h>
 #include <utils/Log.h>
 #include <utils/Errors.h>
 #include <utils/Tokenizer.h>
@@ -53,35 +56,151 @@ status_t KeyLayoutMap::load(const String8& filename, sp<KeyLayoutMap>* outMap) {
     outMap->clear();
 
     Tokenizer* tokenizer;
-    status_t status = Tokenizer::open(filename, &tokenizer);
+    status_t status;
+    if (!KeyMapCache::isEnabled()) {
+        status = Tokenizer::open(filename, &tokenizer);
+        if (status) {
+            ALOGE("Error %d opening key layout map file %s.", status, filename.string());
+        } else {
+            status = load(tokenizer, outMap);
+            delete tokenizer;
+        }
+        return status;
+    }
+
+    std::string contents;
+    if (!android::base::ReadFileToString(filename.string(), &contents)) {
+        status = -errno;
+        ALOGE("Error %d opening key layout map file %s.", status, filename.string());
+        return status;
+    }
+
+    const uint64_t contentsHash = KeyMapCache::hashContents(contents.data(), contents.size());
+    sp<KeyLayoutMap> map = new KeyLayoutMap();
+    if (!KeyMapCache::read(KeyMapCache::KIND_KEY_LAYOUT_MAP, 0, contentsHash,
+            [&map](KeyMapCache::Reader& reader) { return map->readFromCache(reader); })) {
+        *outMap = map;
+        return NO_ERROR;
+    }
+
+    status = Tokenizer::fromContents(filename, contents.c_str(), &tokenizer);
     if (status) {
         ALOGE("Error %d opening key layout map file %s.", status, filename.string());
     } else {
-        sp<KeyLayoutMap> map = new KeyLayoutMap();
-        if (!map.get()) {
-            ALOGE("Error allocating key layout map.");
-            status = NO_MEMORY;
-        } else {
+        status = load(tokenizer, outMap);
+        delete tokenizer;
+        if (!status) {
+            KeyMapCache::Writer writer;
+            (*outMap)->writeToCache(writer);
+            KeyMapCache::write(KeyMapCache::KIND_KEY_LAYOUT_MAP, 0, contentsHash, writer);
+        }
+    }
+    return status;
+}
+
+status_t KeyLayoutMap::load(Tokenizer* tokenizer, sp<KeyLayoutMap>* outMap) {
+    status_t status = OK;
+    sp<KeyLayoutMap> map = new KeyLayoutMap();
+    if (!map.get()) {
+        ALOGE("Error allocating key layout map.");
+        status = NO_MEMORY;
+    } else {
 #if DEBUG_PARSER_PERFORMANCE
-            nsecs_t startTime = systemTime(SYSTEM_TIME_MONOTONIC);
+        nsecs_t startTime = systemTime(SYSTEM_TIME_MONOTONIC);
 #endif
-            Parser parser(map.get(), tokenizer);
-            status = parser.parse();
+        Parser parser(map.get(), tokenizer);
+        status = parser.parse();
 #if DEBUG_PARSER_PERFORMANCE
-            nsecs_t elapsedTime = systemTime(SYSTEM_TIME_MONOTONIC) - startTime;
-            ALOGD("Parsed key layout map file '%s' %d lines in %0.3fms.",
-                    tokenizer->getFilename().string(), tokenizer->getLineNumber(),
-                    elapsedTime / 1000000.0);
+        nsecs_t elapsedTime = systemTime(SYSTEM_TIME_MONOTONIC) - startTime;
+        ALOGD("Parsed key layout map file '%s' %d lines in %0.3fms.",
+                tokenizer->getFilename().string(), tokenizer->getLineNumber(),
+                elapsedTime / 1000000.0);
 #endif
-            if (!status) {
-                *outMap = map;
-            }
+        if (!status) {
+            *outMap = map;
         }
-        delete tokenizer;
     }
     return status;
 }
 
+void KeyLayoutMap::writeToCache(KeyMapCache::Writer& writer) const {
+    const KeyedVector<int32_t, Key>* keyMaps[] = { &mKeysByScanCode, &mKeysByUsageCode };
+    for (const KeyedVector<int32_t, Key>* keys : keyMaps) {
+        writer.writeInt32(int32_t(keys->size()));
+        for (size_t i = 0; i < keys->size(); i++) {
+            writer.writeInt32(keys->keyAt(i));
+            writer.writeInt32(keys->valueAt(i).keyCode);
+            writer.writeInt32(int32_t(keys->valueAt(i).flags));
+        }
+    }
+
+    writer.writeInt32(int32_t(mAxes.size()));
+    for (size_t i = 0; i < mAxes.size(); i++) {
+        const AxisInfo& axisInfo = mAxes.valueAt(i);
+        writer.writeInt32(mAxes.keyAt(i));
+        writer.writeInt32(axisInfo.mode);
+        writer.writeInt32(axisInfo.axis);
+        writer.writeInt32(axisInfo.highAxis);
+        writer.writeInt32(axisInfo.splitValue);
+        writer.writeInt32(axisInfo.flatOverride);
+    }
+
+    const KeyedVector<int32_t, Led>* ledMaps[] = { &mLedsByScanCode, &mLedsByUsageCode };
+    for (const KeyedVector<int32_t, Led>* leds : ledMaps) {
+        writer.writeInt32(int32_t(leds->size()));
+        for (size_t i = 0; i < leds->size(); i++) {
+            writer.writeInt32(leds->keyAt(i));
+            writer.writeInt32(leds->valueAt(i).ledCode);
+        }
+    }
+}
+
+status_t KeyLayoutMap::readFromCache(KeyMapCache::Reader& reader) {
+    // Entries were written in key order, so each add() appends.
+    KeyedVector<int32_t, Key>* keyMaps[] = { &mKeysByScanCode, &mKeysByUsageCode };
+    for (KeyedVector<int32_t, Key>* keys : keyMaps) {
+        const size_t count = reader.readCount(3);
+        keys->setCapacity(count);
+        for (size_t i = 0; i < count; i++) {
+            int32_t code = reader.readInt32();
+            Key key;
+            key.keyCode = reader.readInt32();
+            key.flags = uint32_t(reader.readInt32());
+            keys->add(code, key);
+        }
+    }
+
+    const size_t axisCount = reader.readCount(6);
+    mAxes.setCapacity(axisCount);
+    for (size_t i = 0; i < axisCount; i++) {
+        int32_t scanCode = reader.readInt32();
+        AxisInfo axisInfo;
+        int32_t mode = reader.readInt32();
+        if (mode < AxisInfo::MODE_NORMAL || mode > AxisInfo::MODE_SPLIT) {
+            return BAD_VALUE;
+        }
+        axisInfo.mode = AxisInfo::Mode(mode);
+        axisInfo.axis = reader.readInt32();
+        axisInfo.highAxis = reader.readInt32();
+        axisInfo.splitValue = reader.readInt32();
+        axisInfo.flatOverride = reader.readInt32();
+        mAxes.add(scanCode, axisInfo);
+    }
+
+    KeyedVector<int32_t, Led>* ledMaps[] = { &mLedsByScanCode, &mLedsByUsageCode };
+    for (KeyedVector<int32_t, Led>* leds : ledMaps) {
+        const size_t count = reader.readCount(2);
+        leds->setCapacity(count);
+        for (size_t i = 0; i < count; i++) {
+            int32_t code = reader.readInt32();
+            Led led;
+            led.ledCode = reader.readInt32();
+            leds->add(code, led);
+        }
+    }
+    return reader.hasError() ? BAD_VALUE : NO_ERROR;
+}
+
 status_t KeyLayoutMap::mapKey(int32_t scanCode, int32_t usageCode,
         int32_t* outKeyCode, uint32_t* outFlags) const {
     const Key* key = getKey(scanCode, usageCode);
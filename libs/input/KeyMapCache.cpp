@@ -0,0 +1,197 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "KeyMapCache"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <mutex>
+
+#include <android-base/file.h>
+#include <android-base/stringprintf.h>
+#include <input/KeyMapCache.h>
+#include <utils/Log.h>
+
+using android::base::StringPrintf;
+
+namespace android {
+
+// Bump whenever the header or the layout of either kind of map changes.
+static const uint32_t ENTRY_VERSION = 1;
+static const uint32_t ENTRY_MAGIC = 0x434d4b49; // 'IKMC'
+
+struct EntryHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t kind;
+    uint32_t variant;
+    uint64_t contentsHash;
+    uint64_t dataHash;
+    uint32_t wordCount;
+    uint32_t reserved;
+};
+
+static std::mutex gDirectoryLock;
+static String8 gDirectory;
+static std::atomic<uint32_t> gNextTempId(0);
+
+static String8 getDirectory() {
+    std::lock_guard<std::mutex> lock(gDirectoryLock);
+    return gDirectory;
+}
+
+static std::string getEntryPath(const String8& directory, KeyMapCache::Kind kind,
+        uint32_t variant, uint64_t contentsHash) {
+    return StringPrintf("%s/%s-%016" PRIx64 "-%u.bin", directory.string(),
+            kind == KeyMapCache::KIND_KEY_LAYOUT_MAP ? "kl" : "kcm", contentsHash, variant);
+}
+
+// --- KeyMapCache::Reader ---
+
+int32_t KeyMapCache::Reader::readInt32() {
+    if (mPos >= mSize) {
+        mError = true;
+        return 0;
+    }
+    return mData[mPos++];
+}
+
+size_t KeyMapCache::Reader::readCount(size_t recordSize) {
+    const int32_t count = readInt32();
+    if (count < 0 || size_t(count) > (mSize - mPos) / recordSize) {
+        mError = true;
+        return 0;
+    }
+    return size_t(count);
+}
+
+// --- KeyMapCache ---
+
+void KeyMapCache::setDirectory(const String8& directory) {
+    std::lock_guard<std::mutex> lock(gDirectoryLock);
+    gDirectory = directory;
+}
+
+bool KeyMapCache::isEnabled() {
+    std::lock_guard<std::mutex> lock(gDirectoryLock);
+    return !gDirectory.isEmpty();
+}
+
+uint64_t KeyMapCache::hashContents(const char* contents, size_t length) {
+    // 64-bit FNV-1a
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= uint8_t(contents[i]);
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+status_t KeyMapCache::read(Kind kind, uint32_t variant, uint64_t contentsHash,
+        const std::function<status_t(Reader&)>& decode) {
+    const String8 directory = getDirectory();
+    if (directory.isEmpty()) {
+        return NAME_NOT_FOUND;
+    }
+
+    const std::string path = getEntryPath(directory, kind, variant, contentsHash);
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return NAME_NOT_FOUND;
+    }
+
+    status_t status = BAD_VALUE;
+    struct stat st;
+    if (!fstat(fd, &st) && size_t(st.st_size) >= sizeof(EntryHeader)) {
+        const size_t size = size_t(st.st_size);
+        void* address = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (address != MAP_FAILED) {
+            const EntryHeader* header = static_cast<const EntryHeader*>(address);
+            const int32_t* data = reinterpret_cast<const int32_t*>(header + 1);
+            const size_t dataSize = size - sizeof(EntryHeader);
+            if (header->magic == ENTRY_MAGIC
+                    && header->version == ENTRY_VERSION
+                    && header->kind == uint32_t(kind)
+                    && header->variant == variant
+                    && header->contentsHash == contentsHash
+                    && dataSize % sizeof(int32_t) == 0
+                    && dataSize / sizeof(int32_t) == header->wordCount
+                    && header->dataHash == hashContents(reinterpret_cast<const char*>(data),
+                            dataSize)) {
+                Reader reader(data, header->wordCount);
+                status = decode(reader);
+                if (!status && (reader.hasError() || !reader.isDone())) {
+                    status = BAD_VALUE;
+                }
+            }
+            munmap(address, size);
+        }
+    }
+    close(fd);
+
+    if (status) {
+        ALOGW("Discarding invalid key map cache entry %s.", path.c_str());
+        unlink(path.c_str());
+        status = BAD_VALUE;
+    }
+    return status;
+}
+
+void KeyMapCache::write(Kind kind, uint32_t variant, uint64_t contentsHash,
+        const Writer& writer) {
+    const String8 directory = getDirectory();
+    if (directory.isEmpty()) {
+        return;
+    }
+
+    const std::vector<int32_t>& data = writer.data();
+    EntryHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = ENTRY_MAGIC;
+    header.version = ENTRY_VERSION;
+    header.kind = uint32_t(kind);
+    header.variant = variant;
+    header.contentsHash = contentsHash;
+    header.dataHash = hashContents(reinterpret_cast<const char*>(data.data()),
+            data.size() * sizeof(int32_t));
+    header.wordCount = uint32_t(data.size());
+
+    // Write a private file and rename it into place, so readers never see a partial entry.
+    const std::string path = getEntryPath(directory, kind, variant, contentsHash);
+    const std::string tempPath = StringPrintf("%s.%d.%u.tmp", path.c_str(), getpid(),
+            gNextTempId++);
+    int fd = open(tempPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        ALOGV("Could not create key map cache entry %s: %s", tempPath.c_str(), strerror(errno));
+        return;
+    }
+    bool written = android::base::WriteFully(fd, &header, sizeof(header))
+            && android::base::WriteFully(fd, data.data(), data.size() * sizeof(int32_t));
+    close(fd);
+    if (!written || rename(tempPath.c_str(), path.c_str())) {
+        ALOGW("Could not write key map cache entry %s: %s", path.c_str(), strerror(errno));
+        unlink(tempPath.c_str());
+    }
+}
+
+} // namespace android
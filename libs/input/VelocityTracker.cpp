@@ -210,6 +210,7 @@ VelocityTrackerStrategy* VelocityTracker::createStrategy(const char* strategy) {
 void VelocityTracker::clear() {
     mCurrentPointerIdBits.clear();
     mActivePointerId = -1;
+    mCachedIdBits.clear();
 
     mStrategy->clear();
 }
@@ -222,6 +223,7 @@ void VelocityTracker::clearPointers(BitSet32 idBits) {
         mActivePointerId = !remainingIdBits.isEmpty() ? remainingIdBits.firstMarkedBit() : -1;
     }
 
+    mCachedIdBits.clear();
     mStrategy->clearPointers(idBits);
 }
 
@@ -247,6 +249,7 @@ void VelocityTracker::addMovement(nsecs_t eventTime, BitSet32 idBits, const Posi
         mActivePointerId = idBits.isEmpty() ? -1 : idBits.firstMarkedBit();
     }
 
+    mCachedIdBits.clear();
     mStrategy->addMovement(eventTime, idBits, positions);
 
 #if DEBUG_VELOCITY
@@ -353,7 +356,49 @@ bool VelocityTracker::getVelocity(uint32_t id, float* outVx, float* outVy) const
 }
 
 bool VelocityTracker::getEstimator(uint32_t id, Estimator* outEstimator) const {
-    return mStrategy->getEstimator(id, outEstimator);
+    if (id > MAX_POINTER_ID) {
+        outEstimator->clear();
+        return false;
+    }
+    BitSet32 idBits;
+    idBits.markBit(id);
+    return getEstimators(idBits, outEstimator).hasBit(id);
+}
+
+BitSet32 VelocityTracker::getEstimators(BitSet32 idBits, Estimator* outEstimators) const {
+    BitSet32 missingIdBits(idBits.value & ~mCachedIdBits.value);
+    if (!missingIdBits.isEmpty()) {
+        Estimator estimators[MAX_POINTER_ID + 1];
+        BitSet32 validIdBits = mStrategy->getEstimators(missingIdBits, estimators);
+        for (BitSet32 iterBits(missingIdBits); !iterBits.isEmpty(); ) {
+            uint32_t id = iterBits.clearFirstMarkedBit();
+            mCachedEstimators[id] = estimators[missingIdBits.getIndexOfBit(id)];
+        }
+        mCachedValidIdBits.value = (mCachedValidIdBits.value & mCachedIdBits.value)
+                | validIdBits.value;
+        mCachedIdBits.value |= missingIdBits.value;
+    }
+
+    for (BitSet32 iterBits(idBits); !iterBits.isEmpty(); ) {
+        uint32_t id = iterBits.clearFirstMarkedBit();
+        outEstimators[idBits.getIndexOfBit(id)] = mCachedEstimators[id];
+    }
+    return BitSet32(idBits.value & mCachedValidIdBits.value);
+}
+
+
+// --- VelocityTrackerStrategy ---
+
+BitSet32 VelocityTrackerStrategy::getEstimators(BitSet32 idBits,
+        VelocityTracker::Estimator* outEstimators) const {
+    BitSet32 validIdBits;
+    for (BitSet32 iterBits(idBits); !iterBits.isEmpty(); ) {
+        uint32_t id = iterBits.clearFirstMarkedBit();
+        if (getEstimator(id, &outEstimators[idBits.getIndexOfBit(id)])) {
+            validIdBits.markBit(id);
+        }
+    }
+    return validIdBits;
 }
 
 
@@ -602,19 +647,29 @@ static float solveUnweightedLeastSquaresDeg2(const float* x, const float* y, siz
 
 bool LeastSquaresVelocityTrackerStrategy::getEstimator(uint32_t id,
         VelocityTracker::Estimator* outEstimator) const {
-    outEstimator->clear();
+    BitSet32 idBits;
+    idBits.markBit(id);
+    return getEstimators(idBits, outEstimator).hasBit(id);
+}
 
-    // Iterate over movement samples in reverse time order and collect samples.
-    float x[HISTORY_SIZE];
-    float y[HISTORY_SIZE];
+BitSet32 LeastSquaresVelocityTrackerStrategy::getEstimators(BitSet32 idBits,
+        VelocityTracker::Estimator* outEstimators) const {
+    // Iterate over movement samples in reverse time order and collect samples for all
+    // of the pointers at once.  A pointer's samples end at the first movement without it,
+    // so the times and weights of every pointer are a prefix of the same arrays.
+    float x[MAX_POINTER_ID + 1][HISTORY_SIZE];
+    float y[MAX_POINTER_ID + 1][HISTORY_SIZE];
+    uint32_t counts[MAX_POINTER_ID + 1] = {};
     float w[HISTORY_SIZE];
     float time[HISTORY_SIZE];
+    BitSet32 activeIdBits(idBits);
     uint32_t m = 0;
     uint32_t index = mIndex;
     const Movement& newestMovement = mMovements[mIndex];
     do {
         const Movement& movement = mMovements[index];
-        if (!movement.idBits.hasBit(id)) {
+        activeIdBits.value &= movement.idBits.value;
+        if (activeIdBits.isEmpty()) {
             break;
         }
 
@@ -623,14 +678,35 @@ bool LeastSquaresVelocityTrackerStrategy::getEstimator(uint32_t id,
             break;
         }
 
-        const VelocityTracker::Position& position = movement.getPosition(id);
-        x[m] = position.x;
-        y[m] = position.y;
+        for (BitSet32 iterBits(activeIdBits); !iterBits.isEmpty(); ) {
+            uint32_t id = iterBits.clearFirstMarkedBit();
+            uint32_t i = idBits.getIndexOfBit(id);
+            const VelocityTracker::Position& position = movement.getPosition(id);
+            x[i][m] = position.x;
+            y[i][m] = position.y;
+            counts[i] = m + 1;
+        }
         w[m] = chooseWeight(index);
         time[m] = -age * 0.000000001f;
         index = (index == 0 ? HISTORY_SIZE : index) - 1;
     } while (++m < HISTORY_SIZE);
 
+    BitSet32 validIdBits;
+    for (BitSet32 iterBits(idBits); !iterBits.isEmpty(); ) {
+        uint32_t id = iterBits.clearFirstMarkedBit();
+        uint32_t i = idBits.getIndexOfBit(id);
+        if (fitEstimator(time, x[i], y[i], w, counts[i], newestMovement.eventTime,
+                &outEstimators[i])) {
+            validIdBits.markBit(id);
+        }
+    }
+    return validIdBits;
+}
+
+bool LeastSquaresVelocityTrackerStrategy::fitEstimator(const float* time,
+        const float* x, const float* y, const float* w, uint32_t m, nsecs_t eventTime,
+        VelocityTracker::Estimator* outEstimator) const {
+    outEstimator->clear();
     if (m == 0) {
         return false; // no data
     }
@@ -642,7 +718,7 @@ bool LeastSquaresVelocityTrackerStrategy::getEstimator(uint32_t id,
     }
     if (degree >= 1) {
         if (degree == 2 && mWeighting == WEIGHTING_NONE) { // optimize unweighted, degree=2 fit
-            outEstimator->time = newestMovement.eventTime;
+            outEstimator->time = eventTime;
             outEstimator->degree = 2;
             outEstimator->confidence = 1;
             outEstimator->xCoeff[0] = 0; // only slope is calculated, set rest of coefficients = 0
@@ -658,7 +734,7 @@ bool LeastSquaresVelocityTrackerStrategy::getEstimator(uint32_t id,
         uint32_t n = degree + 1;
         if (solveLeastSquares(time, x, w, m, n, outEstimator->xCoeff, &xdet)
                 && solveLeastSquares(time, y, w, m, n, outEstimator->yCoeff, &ydet)) {
-            outEstimator->time = newestMovement.eventTime;
+            outEstimator->time = eventTime;
             outEstimator->degree = degree;
             outEstimator->confidence = xdet * ydet;
 #if DEBUG_STRATEGY
@@ -675,7 +751,7 @@ bool LeastSquaresVelocityTrackerStrategy::getEstimator(uint32_t id,
     // No velocity data available for this pointer, but we do have its current position.
     outEstimator->xCoeff[0] = x[0];
     outEstimator->yCoeff[0] = y[0];
-    outEstimator->time = newestMovement.eventTime;
+    outEstimator->time = eventTime;
     outEstimator->degree = 0;
     outEstimator->confidence = 1;
     return true;
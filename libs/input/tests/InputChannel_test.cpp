@@ -155,5 +155,74 @@ TEST_F(InputChannelTest, SendSignal_WhenPeerClosed_ReturnsAnError) {
             << "sendMessage should have returned DEAD_OBJECT";
 }
 
+TEST_F(InputChannelTest, SharedMemoryTransport_KeepsMessagesInOrder) {
+    sp<InputChannel> serverChannel, clientChannel;
+
+    status_t result = InputChannel::openInputChannelPair("channel name",
+            serverChannel, clientChannel);
+
+    ASSERT_EQ(OK, result)
+            << "should have successfully opened a channel pair";
+
+    // Sent before the ring, so it has to come out first.
+    InputMessage msg;
+    memset(&msg, 0, sizeof(InputMessage));
+    msg.header.type = InputMessage::TYPE_KEY;
+    msg.body.key.seq = 1;
+    EXPECT_EQ(OK, serverChannel->sendMessage(&msg));
+
+    ASSERT_EQ(OK, serverChannel->enableSharedMemoryTransport())
+            << "server channel should be able to use a shared memory ring";
+    EXPECT_TRUE(serverChannel->isUsingSharedMemoryTransport());
+    EXPECT_EQ(INVALID_OPERATION, serverChannel->enableSharedMemoryTransport());
+
+    const uint32_t count = 500; // enough to wrap around the ring
+    uint32_t sent = 1;
+    uint32_t received = 0;
+    while (received < count) {
+        while (sent < count) {
+            memset(&msg, 0, sizeof(InputMessage));
+            msg.header.type = InputMessage::TYPE_MOTION;
+            msg.body.motion.seq = sent + 1;
+            msg.body.motion.pointerCount = 1 + sent % MAX_POINTERS;
+            status_t status = serverChannel->sendMessage(&msg);
+            if (status == WOULD_BLOCK) {
+                break;
+            }
+            ASSERT_EQ(OK, status);
+            sent++;
+        }
+
+        InputMessage clientMsg;
+        status_t status;
+        while ((status = clientChannel->receiveMessage(&clientMsg)) == OK) {
+            received++;
+            if (received == 1) {
+                EXPECT_EQ(uint32_t(InputMessage::TYPE_KEY), clientMsg.header.type);
+                EXPECT_EQ(1U, clientMsg.body.key.seq);
+            } else {
+                ASSERT_EQ(uint32_t(InputMessage::TYPE_MOTION), clientMsg.header.type);
+                ASSERT_EQ(received, clientMsg.body.motion.seq);
+                ASSERT_EQ(1 + (received - 1) % MAX_POINTERS, clientMsg.body.motion.pointerCount);
+            }
+        }
+        ASSERT_EQ(WOULD_BLOCK, status);
+        EXPECT_TRUE(clientChannel->isUsingSharedMemoryTransport());
+    }
+
+    // Finished signals still go through the socket.
+    InputMessage reply;
+    memset(&reply, 0, sizeof(InputMessage));
+    reply.header.type = InputMessage::TYPE_FINISHED;
+    reply.body.finished.seq = 7;
+    EXPECT_EQ(OK, clientChannel->sendMessage(&reply));
+    InputMessage serverReply;
+    EXPECT_EQ(OK, serverChannel->receiveMessage(&serverReply));
+    EXPECT_EQ(7U, serverReply.body.finished.seq);
+
+    serverChannel.clear();
+    EXPECT_EQ(DEAD_OBJECT, clientChannel->receiveMessage(&msg));
+}
+
 
 } // namespace android
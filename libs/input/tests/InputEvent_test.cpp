@@ -591,4 +591,35 @@ TEST_F(MotionEventTest, Transform) {
     ASSERT_NEAR(originalRawY, event.getRawY(0), 0.001);
 }
 
+TEST_F(MotionEventTest, Transform_AppliesPerspectiveToHistory) {
+    PointerProperties pointerProperties[2];
+    PointerCoords pointerCoords[2];
+    for (size_t i = 0; i < 2; i++) {
+        pointerProperties[i].clear();
+        pointerProperties[i].id = i;
+        pointerCoords[i].clear();
+        pointerCoords[i].setAxisValue(AMOTION_EVENT_AXIS_X, 10 + i);
+        pointerCoords[i].setAxisValue(AMOTION_EVENT_AXIS_Y, 20 + i);
+    }
+    MotionEvent event;
+    event.initialize(0, 0, AMOTION_EVENT_ACTION_MOVE, 0, 0, 0, 0, 0,
+            0, 0, 0, 0, 0, 0, 2, pointerProperties, pointerCoords);
+    pointerCoords[1].setAxisValue(AMOTION_EVENT_AXIS_X, 30);
+    pointerCoords[1].setAxisValue(AMOTION_EVENT_AXIS_Y, 40);
+    event.addSample(1, pointerCoords);
+
+    // x' = (2x + 1) / (0.01x + 1), y' = (3y + 2) / (0.01x + 1)
+    const float matrix[9] = { 2, 0, 1, 0, 3, 2, 0.01f, 0, 1 };
+    event.transform(matrix);
+
+    ASSERT_EQ(1U, event.getHistorySize());
+    ASSERT_NEAR(21 / 1.1f, event.getHistoricalX(0, 0), 0.001);
+    ASSERT_NEAR(62 / 1.1f, event.getHistoricalY(0, 0), 0.001);
+    ASSERT_NEAR(23 / 1.11f, event.getHistoricalX(1, 0), 0.001);
+    ASSERT_NEAR(65 / 1.11f, event.getHistoricalY(1, 0), 0.001);
+    ASSERT_NEAR(21 / 1.1f, event.getX(0), 0.001);
+    ASSERT_NEAR(61 / 1.3f, event.getX(1), 0.001);
+    ASSERT_NEAR(122 / 1.3f, event.getY(1), 0.001);
+}
+
 } // namespace android
@@ -60,6 +60,7 @@ protected:
 
     void PublishAndConsumeKeyEvent();
     void PublishAndConsumeMotionEvent();
+    void PublishTouch(uint32_t seq, int32_t action, nsecs_t eventTime, float x);
 };
 
 TEST_F(InputPublisherAndConsumerTest, GetChannel_ReturnsTheChannel) {
@@ -307,4 +308,54 @@ TEST_F(InputPublisherAndConsumerTest, PublishMultipleEvents_EndToEnd) {
     ASSERT_NO_FATAL_FAILURE(PublishAndConsumeKeyEvent());
 }
 
+void InputPublisherAndConsumerTest::PublishTouch(uint32_t seq, int32_t action,
+        nsecs_t eventTime, float x) {
+    PointerProperties pointerProperties;
+    pointerProperties.clear();
+    pointerProperties.id = 0;
+    pointerProperties.toolType = AMOTION_EVENT_TOOL_TYPE_FINGER;
+    PointerCoords pointerCoords;
+    pointerCoords.clear();
+    pointerCoords.setAxisValue(AMOTION_EVENT_AXIS_X, x);
+    pointerCoords.setAxisValue(AMOTION_EVENT_AXIS_Y, 100);
+
+    status_t status = mPublisher->publishMotionEvent(seq, 1, AINPUT_SOURCE_TOUCHSCREEN, 0,
+            action, 0, 0, 0, 0, 0, 0, 0, 1, 1, 0, eventTime,
+            1, &pointerProperties, &pointerCoords);
+    ASSERT_EQ(OK, status)
+            << "publisher publishMotionEvent should return OK";
+}
+
+TEST_F(InputPublisherAndConsumerTest, ConsumeBatch_WhenPredicting_ExtrapolatesToFrameTime) {
+    const nsecs_t ms = 1000000;
+    mConsumer->setResampleStrategy(InputConsumer::RESAMPLE_STRATEGY_PREDICT);
+
+    uint32_t consumeSeq;
+    InputEvent* event;
+    int32_t displayId;
+    ASSERT_NO_FATAL_FAILURE(PublishTouch(1, AMOTION_EVENT_ACTION_DOWN, 0, 0));
+    ASSERT_EQ(OK, mConsumer->consume(&mEventFactory, true /*consumeBatches*/, 25 * ms,
+            &consumeSeq, &event, &displayId));
+
+    // Moving at 1px/ms, so the pointer should be expected at 25px by the frame.
+    ASSERT_NO_FATAL_FAILURE(PublishTouch(2, AMOTION_EVENT_ACTION_MOVE, 10 * ms, 10));
+    ASSERT_NO_FATAL_FAILURE(PublishTouch(3, AMOTION_EVENT_ACTION_MOVE, 20 * ms, 20));
+    ASSERT_EQ(OK, mConsumer->consume(&mEventFactory, true /*consumeBatches*/, 25 * ms,
+            &consumeSeq, &event, &displayId));
+    ASSERT_EQ(AINPUT_EVENT_TYPE_MOTION, event->getType());
+    MotionEvent* motionEvent = static_cast<MotionEvent*>(event);
+    EXPECT_EQ(25 * ms, motionEvent->getEventTime());
+    EXPECT_NEAR(25, motionEvent->getX(0), 0.001);
+    EXPECT_EQ(0U, mConsumer->getPredictionStats().count);
+
+    // Once the pointer carries on past the frame time the prediction is scored.
+    ASSERT_NO_FATAL_FAILURE(PublishTouch(4, AMOTION_EVENT_ACTION_MOVE, 30 * ms, 32));
+    ASSERT_EQ(OK, mConsumer->consume(&mEventFactory, true /*consumeBatches*/, 35 * ms,
+            &consumeSeq, &event, &displayId));
+    InputConsumer::PredictionStats stats = mConsumer->getPredictionStats();
+    EXPECT_EQ(1U, stats.count);
+    EXPECT_NEAR(1, stats.meanError, 0.001);
+    EXPECT_NEAR(1, stats.maxError, 0.001);
+}
+
 } // namespace android
@@ -0,0 +1,131 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <android/keycodes.h>
+#include <gtest/gtest.h>
+#include <input/Input.h>
+#include <input/KeyCharacterMap.h>
+
+namespace android {
+
+static const char* BASE_MAP =
+        "type FULL\n"
+        "key A {\n"
+        "    label: 'A'\n"
+        "    base: 'a'\n"
+        "    shift, capslock: 'A'\n"
+        "    ctrl: fallback ESCAPE\n"
+        "}\n"
+        "key B {\n"
+        "    label: 'B'\n"
+        "    base: 'b'\n"
+        "    shift: 'B'\n"
+        "    alt: 'a'\n"
+        "}\n"
+        "key DEL {\n"
+        "    base: none\n"
+        "    alt: replace FORWARD_DEL\n"
+        "}\n";
+
+static const char* OVERLAY_MAP =
+        "type OVERLAY\n"
+        "key A {\n"
+        "    label: 'Q'\n"
+        "    base: 'q'\n"
+        "}\n";
+
+static sp<KeyCharacterMap> loadMap(const char* contents, KeyCharacterMap::Format format) {
+    sp<KeyCharacterMap> map;
+    EXPECT_EQ(OK, KeyCharacterMap::loadContents(String8("test.kcm"), contents, format, &map));
+    return map;
+}
+
+TEST(KeyCharacterMapTest, LooksUpKeysAndBehaviors) {
+    sp<KeyCharacterMap> map = loadMap(BASE_MAP, KeyCharacterMap::FORMAT_BASE);
+    ASSERT_TRUE(map != NULL);
+
+    EXPECT_EQ(u'A', map->getDisplayLabel(AKEYCODE_A));
+    EXPECT_EQ(0, map->getDisplayLabel(AKEYCODE_C));
+    EXPECT_EQ(0, map->getDisplayLabel(-1));
+    EXPECT_EQ(0, map->getDisplayLabel(MAX_KEYS + 1));
+    EXPECT_EQ(u'a', map->getCharacter(AKEYCODE_A, 0));
+    EXPECT_EQ(u'A', map->getCharacter(AKEYCODE_A, AMETA_SHIFT_ON | AMETA_SHIFT_LEFT_ON));
+    EXPECT_EQ(u'a', map->getCharacter(AKEYCODE_B, AMETA_ALT_ON));
+
+    KeyCharacterMap::FallbackAction fallback;
+    EXPECT_TRUE(map->getFallbackAction(AKEYCODE_A, AMETA_CTRL_ON, &fallback));
+    EXPECT_EQ(AKEYCODE_ESCAPE, fallback.keyCode);
+    EXPECT_FALSE(map->getFallbackAction(AKEYCODE_A, 0, &fallback));
+    EXPECT_FALSE(map->getFallbackAction(AKEYCODE_B, AMETA_CTRL_ON, &fallback));
+
+    int32_t keyCode, metaState;
+    map->tryRemapKey(AKEYCODE_DEL, AMETA_ALT_ON | AMETA_ALT_LEFT_ON, &keyCode, &metaState);
+    EXPECT_EQ(AKEYCODE_FORWARD_DEL, keyCode);
+    EXPECT_EQ(0, metaState);
+    map->tryRemapKey(AKEYCODE_A, AMETA_ALT_ON, &keyCode, &metaState);
+    EXPECT_EQ(AKEYCODE_A, keyCode);
+    EXPECT_EQ(AMETA_ALT_ON, metaState);
+
+    const char16_t chars[] = { u'B', u'b' };
+    EXPECT_EQ(u'B', map->getMatch(AKEYCODE_B, chars, 2, AMETA_SHIFT_ON));
+    EXPECT_EQ(u'b', map->getMatch(AKEYCODE_B, chars, 2, 0));
+}
+
+TEST(KeyCharacterMapTest, GetEvents_TypesWithTheFirstKeyAndItsMostGeneralBehavior) {
+    sp<KeyCharacterMap> map = loadMap(BASE_MAP, KeyCharacterMap::FORMAT_BASE);
+    ASSERT_TRUE(map != NULL);
+
+    // 'a' comes from A's base behavior, not from alt+B.
+    const char16_t chars[] = { u'a', u'B' };
+    Vector<KeyEvent> events;
+    ASSERT_TRUE(map->getEvents(1, chars, 2, events));
+    ASSERT_EQ(6U, events.size());
+    EXPECT_EQ(AKEYCODE_A, events[0].getKeyCode());
+    EXPECT_EQ(AKEYCODE_A, events[1].getKeyCode());
+    EXPECT_EQ(AKEYCODE_SHIFT_LEFT, events[2].getKeyCode());
+    EXPECT_EQ(AKEYCODE_B, events[3].getKeyCode());
+    EXPECT_NE(0, events[3].getMetaState() & AMETA_SHIFT_ON);
+
+    const char16_t missing[] = { u'z' };
+    events.clear();
+    EXPECT_FALSE(map->getEvents(1, missing, 1, events));
+}
+
+TEST(KeyCharacterMapTest, Combine_RebuildsTheLookups) {
+    sp<KeyCharacterMap> base = loadMap(BASE_MAP, KeyCharacterMap::FORMAT_BASE);
+    sp<KeyCharacterMap> overlay = loadMap(OVERLAY_MAP, KeyCharacterMap::FORMAT_OVERLAY);
+    ASSERT_TRUE(base != NULL && overlay != NULL);
+    sp<KeyCharacterMap> map = KeyCharacterMap::combine(base, overlay);
+
+    EXPECT_EQ(u'Q', map->getDisplayLabel(AKEYCODE_A));
+    EXPECT_EQ(u'q', map->getCharacter(AKEYCODE_A, 0));
+    EXPECT_EQ(u'b', map->getCharacter(AKEYCODE_B, 0));
+    KeyCharacterMap::FallbackAction fallback;
+    EXPECT_FALSE(map->getFallbackAction(AKEYCODE_A, AMETA_CTRL_ON, &fallback));
+
+    // Now only alt+B types 'a'.
+    const char16_t chars[] = { u'a' };
+    Vector<KeyEvent> events;
+    ASSERT_TRUE(map->getEvents(1, chars, 1, events));
+    ASSERT_EQ(4U, events.size());
+    EXPECT_EQ(AKEYCODE_ALT_LEFT, events[0].getKeyCode());
+    EXPECT_EQ(AKEYCODE_B, events[1].getKeyCode());
+
+    // The base map is left alone.
+    EXPECT_EQ(u'A', base->getDisplayLabel(AKEYCODE_A));
+}
+
+} // namespace android
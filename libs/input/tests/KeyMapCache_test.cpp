@@ -0,0 +1,199 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <dirent.h>
+
+#include <string>
+#include <vector>
+
+#include <android-base/file.h>
+#include <android-base/test_utils.h>
+#include <android/keycodes.h>
+#include <gtest/gtest.h>
+#include <input/Input.h>
+#include <input/KeyCharacterMap.h>
+#include <input/KeyLayoutMap.h>
+#include <input/KeyMapCache.h>
+
+namespace android {
+
+static const char* KEY_LAYOUT =
+        "key 16 Q\n"
+        "key 158 BACK VIRTUAL\n"
+        "key usage 0x0c0067 WINDOW\n"
+        "axis 0x00 X\n"
+        "axis 0x01 invert Y\n"
+        "axis 0x02 split 0x7f LTRIGGER RTRIGGER flat 10\n"
+        "led 0x00 NUM_LOCK\n"
+        "led usage 0x080002 CAPS_LOCK\n";
+
+static const char* KEY_CHARACTERS =
+        "type FULL\n"
+        "map key 30 B\n"
+        "key A {\n"
+        "    label: 'A'\n"
+        "    base: 'a'\n"
+        "    shift, capslock: 'A'\n"
+        "    ctrl: fallback ESCAPE\n"
+        "}\n";
+
+class KeyMapCacheTest : public testing::Test {
+protected:
+    TemporaryDir mSourceDir;
+    TemporaryDir mCacheDir;
+
+    virtual void TearDown() {
+        KeyMapCache::setDirectory(String8());
+    }
+
+    String8 writeSource(const char* name, const char* contents) {
+        std::string path = std::string(mSourceDir.path) + "/" + name;
+        EXPECT_TRUE(android::base::WriteStringToFile(contents, path));
+        return String8(path.c_str());
+    }
+
+    std::vector<std::string> getCacheEntries() {
+        std::vector<std::string> entries;
+        DIR* dir = opendir(mCacheDir.path);
+        while (struct dirent* entry = readdir(dir)) {
+            if (entry->d_name[0] != '.') {
+                entries.push_back(std::string(mCacheDir.path) + "/" + entry->d_name);
+            }
+        }
+        closedir(dir);
+        return entries;
+    }
+
+    static void expectSameLayout(const sp<KeyLayoutMap>& expected, const sp<KeyLayoutMap>& map) {
+        const int32_t scanCodes[] = { 16, 158, 17 };
+        for (int32_t scanCode : scanCodes) {
+            int32_t expectedKeyCode, keyCode;
+            uint32_t expectedFlags, flags;
+            EXPECT_EQ(expected->mapKey(scanCode, 0, &expectedKeyCode, &expectedFlags),
+                    map->mapKey(scanCode, 0, &keyCode, &flags));
+            EXPECT_EQ(expectedKeyCode, keyCode);
+            EXPECT_EQ(expectedFlags, flags);
+        }
+        int32_t expectedKeyCode, keyCode;
+        uint32_t expectedFlags, flags;
+        ASSERT_EQ(OK, map->mapKey(0, 0x0c0067, &keyCode, &flags));
+        expected->mapKey(0, 0x0c0067, &expectedKeyCode, &expectedFlags);
+        EXPECT_EQ(expectedKeyCode, keyCode);
+
+        for (int32_t scanCode = 0; scanCode < 4; scanCode++) {
+            AxisInfo expectedAxis, axis;
+            EXPECT_EQ(expected->mapAxis(scanCode, &expectedAxis), map->mapAxis(scanCode, &axis));
+            EXPECT_EQ(expectedAxis.mode, axis.mode);
+            EXPECT_EQ(expectedAxis.axis, axis.axis);
+            EXPECT_EQ(expectedAxis.highAxis, axis.highAxis);
+            EXPECT_EQ(expectedAxis.splitValue, axis.splitValue);
+            EXPECT_EQ(expectedAxis.flatOverride, axis.flatOverride);
+        }
+
+        int32_t expectedCode, code;
+        ASSERT_EQ(OK, map->findScanCodeForLed(ALED_NUM_LOCK, &code));
+        expected->findScanCodeForLed(ALED_NUM_LOCK, &expectedCode);
+        EXPECT_EQ(expectedCode, code);
+        ASSERT_EQ(OK, map->findUsageCodeForLed(ALED_CAPS_LOCK, &code));
+        expected->findUsageCodeForLed(ALED_CAPS_LOCK, &expectedCode);
+        EXPECT_EQ(expectedCode, code);
+    }
+};
+
+TEST_F(KeyMapCacheTest, KeyLayoutMap_LoadsTheSameMapFromTheCache) {
+    const String8 path = writeSource("test.kl", KEY_LAYOUT);
+    sp<KeyLayoutMap> parsed;
+    ASSERT_EQ(OK, KeyLayoutMap::load(path, &parsed));
+    EXPECT_TRUE(getCacheEntries().empty());
+
+    KeyMapCache::setDirectory(String8(mCacheDir.path));
+    sp<KeyLayoutMap> written;
+    ASSERT_EQ(OK, KeyLayoutMap::load(path, &written));
+    ASSERT_EQ(1U, getCacheEntries().size());
+    expectSameLayout(parsed, written);
+
+    sp<KeyLayoutMap> cached;
+    ASSERT_EQ(OK, KeyLayoutMap::load(path, &cached));
+    expectSameLayout(parsed, cached);
+}
+
+TEST_F(KeyMapCacheTest, KeyLayoutMap_ReparsesWhenTheEntryIsCorrupt) {
+    const String8 path = writeSource("test.kl", KEY_LAYOUT);
+    sp<KeyLayoutMap> parsed;
+    ASSERT_EQ(OK, KeyLayoutMap::load(path, &parsed));
+
+    KeyMapCache::setDirectory(String8(mCacheDir.path));
+    sp<KeyLayoutMap> written;
+    ASSERT_EQ(OK, KeyLayoutMap::load(path, &written));
+    std::vector<std::string> entries = getCacheEntries();
+    ASSERT_EQ(1U, entries.size());
+
+    std::string entry;
+    ASSERT_TRUE(android::base::ReadFileToString(entries[0], &entry));
+    entry[entry.size() - 1] ^= 0x5a;
+    ASSERT_TRUE(android::base::WriteStringToFile(entry, entries[0]));
+
+    sp<KeyLayoutMap> reparsed;
+    ASSERT_EQ(OK, KeyLayoutMap::load(path, &reparsed));
+    expectSameLayout(parsed, reparsed);
+}
+
+TEST_F(KeyMapCacheTest, KeyLayoutMap_DoesNotUseEntriesOfEditedFiles) {
+    const String8 path = writeSource("test.kl", KEY_LAYOUT);
+    KeyMapCache::setDirectory(String8(mCacheDir.path));
+    sp<KeyLayoutMap> map;
+    ASSERT_EQ(OK, KeyLayoutMap::load(path, &map));
+
+    writeSource("test.kl", "key 16 W\n");
+    ASSERT_EQ(OK, KeyLayoutMap::load(path, &map));
+    int32_t keyCode;
+    uint32_t flags;
+    ASSERT_EQ(OK, map->mapKey(16, 0, &keyCode, &flags));
+    EXPECT_EQ(AKEYCODE_W, keyCode);
+    AxisInfo axis;
+    EXPECT_EQ(NAME_NOT_FOUND, map->mapAxis(0x00, &axis));
+    EXPECT_EQ(2U, getCacheEntries().size());
+}
+
+TEST_F(KeyMapCacheTest, KeyCharacterMap_LoadsTheSameMapFromTheCache) {
+    const String8 path = writeSource("test.kcm", KEY_CHARACTERS);
+    KeyMapCache::setDirectory(String8(mCacheDir.path));
+    sp<KeyCharacterMap> written;
+    ASSERT_EQ(OK, KeyCharacterMap::load(path, KeyCharacterMap::FORMAT_BASE, &written));
+    ASSERT_EQ(1U, getCacheEntries().size());
+
+    sp<KeyCharacterMap> cached;
+    ASSERT_EQ(OK, KeyCharacterMap::load(path, KeyCharacterMap::FORMAT_BASE, &cached));
+    ASSERT_EQ(1U, getCacheEntries().size());
+
+    EXPECT_EQ(written->getKeyboardType(), cached->getKeyboardType());
+    EXPECT_EQ(u'A', cached->getDisplayLabel(AKEYCODE_A));
+    EXPECT_EQ(u'a', cached->getCharacter(AKEYCODE_A, 0));
+    EXPECT_EQ(u'A', cached->getCharacter(AKEYCODE_A, AMETA_SHIFT_ON));
+    EXPECT_EQ(u'A', cached->getCharacter(AKEYCODE_A, AMETA_CAPS_LOCK_ON));
+    KeyCharacterMap::FallbackAction fallback;
+    ASSERT_TRUE(cached->getFallbackAction(AKEYCODE_A, AMETA_CTRL_ON, &fallback));
+    EXPECT_EQ(AKEYCODE_ESCAPE, fallback.keyCode);
+    int32_t keyCode;
+    ASSERT_EQ(OK, cached->mapKey(30, 0, &keyCode));
+    EXPECT_EQ(AKEYCODE_B, keyCode);
+
+    // The file is not a valid overlay, so its base entry must not be used for one.
+    sp<KeyCharacterMap> overlay;
+    EXPECT_NE(OK, KeyCharacterMap::load(path, KeyCharacterMap::FORMAT_OVERLAY, &overlay));
+}
+
+} // namespace android
@@ -0,0 +1,93 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <input/VelocityTracker.h>
+
+namespace android {
+namespace {
+
+const char* const STRATEGIES[] = {
+    "impulse", "lsq1", "lsq2", "lsq3", "wlsq2-delta", "wlsq2-central", "wlsq2-recent",
+    "int1", "int2", "legacy",
+};
+
+constexpr int STRATEGY_COUNT = sizeof(STRATEGIES) / sizeof(STRATEGIES[0]);
+
+constexpr uint32_t POINTER_COUNT = 3;
+constexpr nsecs_t SAMPLE_INTERVAL = 8 * 1000000LL; // 120Hz touch panel
+
+// Feeds the tracker a frame's worth of samples for a few fingers moving
+// apart, the way a pinch does.
+void addFrame(VelocityTracker& tracker, nsecs_t* eventTime) {
+    BitSet32 idBits;
+    for (uint32_t id = 0; id < POINTER_COUNT; id++) {
+        idBits.markBit(id);
+    }
+    for (int sample = 0; sample < 2; sample++) {
+        *eventTime += SAMPLE_INTERVAL;
+        const float t = *eventTime * 0.000000001f;
+        VelocityTracker::Position positions[POINTER_COUNT];
+        for (uint32_t i = 0; i < POINTER_COUNT; i++) {
+            positions[i].x = 500 + (i + 1) * 300 * t;
+            positions[i].y = 800 - (i + 1) * 200 * t * t;
+        }
+        tracker.addMovement(*eventTime, idBits, positions);
+    }
+}
+
+// A frame as apps spend it: a new batch of movements, then the velocity of
+// every pointer asked for a few times by different views.
+void BM_VelocityPerFrame(benchmark::State& state) {
+    const char* strategy = STRATEGIES[state.range(0)];
+    state.SetLabel(strategy);
+    VelocityTracker tracker(strategy);
+    nsecs_t eventTime = 0;
+    for (auto _ : state) {
+        addFrame(tracker, &eventTime);
+        for (int query = 0; query < 4; query++) {
+            for (uint32_t id = 0; id < POINTER_COUNT; id++) {
+                float vx, vy;
+                tracker.getVelocity(id, &vx, &vy);
+                benchmark::DoNotOptimize(vx);
+                benchmark::DoNotOptimize(vy);
+            }
+        }
+    }
+}
+BENCHMARK(BM_VelocityPerFrame)->DenseRange(0, STRATEGY_COUNT - 1);
+
+// The same frame with all pointers solved at once.
+void BM_EstimatorsPerFrame(benchmark::State& state) {
+    const char* strategy = STRATEGIES[state.range(0)];
+    state.SetLabel(strategy);
+    VelocityTracker tracker(strategy);
+    nsecs_t eventTime = 0;
+    VelocityTracker::Estimator estimators[POINTER_COUNT];
+    for (auto _ : state) {
+        addFrame(tracker, &eventTime);
+        benchmark::DoNotOptimize(
+                tracker.getEstimators(tracker.getCurrentPointerIdBits(), estimators));
+        benchmark::ClobberMemory();
+    }
+}
+BENCHMARK(BM_EstimatorsPerFrame)->DenseRange(0, STRATEGY_COUNT - 1);
+
+} // namespace
+} // namespace android
+
+BENCHMARK_MAIN();
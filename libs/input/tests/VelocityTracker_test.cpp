@@ -163,6 +163,71 @@ TEST_F(VelocityTrackerTest, ThreePointsLinearVelocityTest) {
 }
 
 
+TEST_F(VelocityTrackerTest, GetEstimators_MatchesEachPointerOnItsOwn) {
+    const char* strategies[] = { "lsq2", "wlsq2-recent", "int1", "impulse" };
+    for (const char* strategy : strategies) {
+        VelocityTracker vt(strategy);
+        BitSet32 idBits;
+        idBits.markBit(1);
+        idBits.markBit(4);
+        idBits.markBit(7);
+        for (nsecs_t i = 0; i < 10; i++) {
+            // Pointer 7 only shows up for the last few movements.
+            BitSet32 movementIdBits(idBits);
+            if (i < 6) {
+                movementIdBits.clearBit(7);
+            }
+            VelocityTracker::Position positions[3];
+            for (uint32_t j = 0; j < movementIdBits.count(); j++) {
+                positions[j].x = 10 * j + i * i * (j + 1);
+                positions[j].y = 100 - 3 * i * (j + 1);
+            }
+            vt.addMovement(i * 8000000, movementIdBits, positions);
+        }
+
+        BitSet32 queryIdBits(idBits);
+        queryIdBits.markBit(9); // never seen
+        VelocityTracker::Estimator estimators[4];
+        BitSet32 validIdBits = vt.getEstimators(queryIdBits, estimators);
+        EXPECT_EQ(idBits.value, validIdBits.value) << strategy;
+        for (BitSet32 iterBits(queryIdBits); !iterBits.isEmpty(); ) {
+            uint32_t id = iterBits.clearFirstMarkedBit();
+            const VelocityTracker::Estimator& batched =
+                    estimators[queryIdBits.getIndexOfBit(id)];
+            VelocityTracker::Estimator single;
+            EXPECT_EQ(idBits.hasBit(id), vt.getEstimator(id, &single)) << strategy;
+            EXPECT_EQ(single.time, batched.time) << strategy << " id " << id;
+            EXPECT_EQ(single.degree, batched.degree) << strategy << " id " << id;
+            EXPECT_EQ(single.xCoeff[1], batched.xCoeff[1]) << strategy << " id " << id;
+            EXPECT_EQ(single.yCoeff[1], batched.yCoeff[1]) << strategy << " id " << id;
+        }
+    }
+}
+
+TEST_F(VelocityTrackerTest, GetEstimator_SeesNewMovements) {
+    VelocityTracker vt("lsq2");
+    BitSet32 idBits;
+    idBits.markBit(DEFAULT_POINTER_ID);
+    VelocityTracker::Position position = { 0, 0 };
+    vt.addMovement(0, idBits, &position);
+    position.x = 10;
+    vt.addMovement(10000000, idBits, &position);
+
+    float vx, vy;
+    ASSERT_TRUE(vt.getVelocity(DEFAULT_POINTER_ID, &vx, &vy));
+    EXPECT_NEAR(1000, vx, 1);
+
+    // A solved estimator must not outlive the movements it was solved from.
+    position.x = 40;
+    vt.addMovement(20000000, idBits, &position);
+    ASSERT_TRUE(vt.getVelocity(DEFAULT_POINTER_ID, &vx, &vy));
+    EXPECT_GT(vx, 1500);
+
+    vt.clear();
+    EXPECT_FALSE(vt.getVelocity(DEFAULT_POINTER_ID, &vx, &vy));
+}
+
+
 /**
  * ================== VelocityTracker tests generated by recording real events =====================
  *
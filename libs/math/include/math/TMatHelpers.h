@@ -26,6 +26,7 @@
 #include <stdexcept>
 
 #include <math/quat.h>
+#include <math/TSimdHelpers.h>
 #include <math/TVecHelpers.h>
 
 #include  <utils/String8.h>
@@ -81,6 +82,12 @@ template<typename MATRIX>
 MATRIX PURE gaussJordanInverse(const MATRIX& src) {
     typedef typename MATRIX::value_type T;
     static constexpr unsigned int N = MATRIX::NUM_ROWS;
+    if (N == 4 && simd::useKernels<T, T>()) {
+        MATRIX inverted(MATRIX::NO_INIT);
+        simd::Kernels<T, T>::inverse(&inverted[0][0], src.asArray());
+        return inverted;
+    }
+
     MATRIX tmp(src);
     MATRIX inverted(1);
 
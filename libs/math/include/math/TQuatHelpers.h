@@ -23,6 +23,7 @@
 
 #include <iostream>
 
+#include <math/TSimdHelpers.h>
 #include <math/vec3.h>
 
 #define PURE __attribute__((pure))
@@ -96,7 +97,7 @@ public:
         //            q.w*r.w - dot(q.xyz, r.xyz),
         //            q.w*r.xyz + r.w*q.xyz + cross(q.xyz, r.xyz));
 
-        return QUATERNION<T>(
+        return simd::useKernels<T, RT>() ? simdProduct(q, r) : QUATERNION<T>(
                 q.w*r.w - q.x*r.x - q.y*r.y - q.z*r.z,
                 q.w*r.x + q.x*r.w + q.y*r.z - q.z*r.y,
                 q.w*r.y - q.x*r.z + q.y*r.w + q.z*r.x,
@@ -112,6 +113,16 @@ public:
         return imaginary(q * QUATERNION<T>(v, 0) * inverse(q));
     }
 
+private:
+    template<typename RT>
+    static QUATERNION<T> simdProduct(const QUATERNION<T>& q, const QUATERNION<RT>& r) {
+        QUATERNION<T> result(QUATERNION<T>::NO_INIT);
+        simd::Kernels<T, RT>::multiplyQuat(&result[0], &q[0], &r[0]);
+        return result;
+    }
+
+public:
+
 
     /* For quaternions, we use explicit "by a scalar" products because it's much faster
      * than going (implicitly) through the quaternion multiplication.
@@ -0,0 +1,229 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <math.h>
+#include <stddef.h>
+
+/*
+ * The SIMD kernels below are only used when the compiler can tell us whether
+ * we're being evaluated at compile time, so that mat4 and quat stay usable in
+ * constant expressions.
+ */
+#if defined(__has_builtin) && __cplusplus >= 201402L
+#if __has_builtin(__builtin_is_constant_evaluated)
+#if defined(__ARM_NEON__) || defined(__aarch64__)
+#include <arm_neon.h>
+#define MATH_USE_SIMD
+#define MATH_USE_NEON
+#elif defined(__SSE__)
+#include <xmmintrin.h>
+#define MATH_USE_SIMD
+#define MATH_USE_SSE
+#endif
+#endif
+#endif
+
+namespace android {
+namespace details {
+// -------------------------------------------------------------------------------------
+
+/*
+ * No user serviceable parts here.
+ *
+ * Don't use this file directly, instead include ui/mat4.h or ui/quat.h
+ */
+
+namespace simd {
+
+/*
+ * Kernels<T, U> says whether SIMD versions of the mat4 * vec4 and quat * quat
+ * products (and of the mat4 inverse) exist for elements of type T and U. Only
+ * float has them. mat4 * mat4 is computed one column at a time with the
+ * mat4 * vec4 kernel.
+ *
+ * Every kernel performs exactly the same multiplications and additions, in
+ * the same order, as the generic code it replaces, so both give bit-identical
+ * results. Matrices are column-major arrays of 16 values, vectors and
+ * quaternions arrays of 4 values (x, y, z, w).
+ */
+template <typename T, typename U>
+struct Kernels {
+    static constexpr bool AVAILABLE = false;
+
+    static void multiply(T*, const T*, const U*) {}
+    static void multiplyQuat(T*, const T*, const U*) {}
+    static void inverse(T*, const T*) {}
+};
+
+// true when the kernels for T and U can be used, i.e. when they exist and
+// we're not in a constant expression
+template <typename T, typename U>
+constexpr inline bool useKernels() {
+#ifdef MATH_USE_SIMD
+    return Kernels<T, U>::AVAILABLE && !__builtin_is_constant_evaluated();
+#else
+    return false;
+#endif
+}
+
+#ifdef MATH_USE_SIMD
+
+#if defined(MATH_USE_NEON)
+typedef float32x4_t float4_t;
+inline float4_t load(const float* p) { return vld1q_f32(p); }
+inline void store(float* p, float4_t v) { vst1q_f32(p, v); }
+inline float4_t splat(float v) { return vdupq_n_f32(v); }
+inline float4_t zero() { return vdupq_n_f32(0.0f); }
+inline float4_t add(float4_t a, float4_t b) { return vaddq_f32(a, b); }
+inline float4_t sub(float4_t a, float4_t b) { return vsubq_f32(a, b); }
+inline float4_t mul(float4_t a, float4_t b) { return vmulq_f32(a, b); }
+inline float4_t divide(float4_t a, float4_t b) {
+#if defined(__aarch64__)
+    return vdivq_f32(a, b);
+#else
+    // ARMv7 NEON has no exact division
+    float lhs[4];
+    float rhs[4];
+    vst1q_f32(lhs, a);
+    vst1q_f32(rhs, b);
+    for (size_t i = 0; i < 4; i++) {
+        lhs[i] /= rhs[i];
+    }
+    return vld1q_f32(lhs);
+#endif
+}
+// (w, z, y, x), (z, w, x, y) and (y, x, w, z)
+inline float4_t wzyx(float4_t v) {
+    const float32x4_t reversed = vrev64q_f32(v);
+    return vcombine_f32(vget_high_f32(reversed), vget_low_f32(reversed));
+}
+inline float4_t zwxy(float4_t v) { return vextq_f32(v, v, 2); }
+inline float4_t yxwz(float4_t v) { return vrev64q_f32(v); }
+inline float4_t withSigns(float4_t v, float x, float y, float z, float w) {
+    const float signs[4] = { x, y, z, w };
+    return vmulq_f32(v, vld1q_f32(signs));
+}
+#else
+typedef __m128 float4_t;
+inline float4_t load(const float* p) { return _mm_loadu_ps(p); }
+inline void store(float* p, float4_t v) { _mm_storeu_ps(p, v); }
+inline float4_t splat(float v) { return _mm_set1_ps(v); }
+inline float4_t zero() { return _mm_setzero_ps(); }
+inline float4_t add(float4_t a, float4_t b) { return _mm_add_ps(a, b); }
+inline float4_t sub(float4_t a, float4_t b) { return _mm_sub_ps(a, b); }
+inline float4_t mul(float4_t a, float4_t b) { return _mm_mul_ps(a, b); }
+inline float4_t divide(float4_t a, float4_t b) { return _mm_div_ps(a, b); }
+inline float4_t wzyx(float4_t v) { return _mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 1, 2, 3)); }
+inline float4_t zwxy(float4_t v) { return _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)); }
+inline float4_t yxwz(float4_t v) { return _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)); }
+inline float4_t withSigns(float4_t v, float x, float y, float z, float w) {
+    return _mm_mul_ps(v, _mm_setr_ps(x, y, z, w));
+}
+#endif
+
+// m * v, summing the columns scaled by v one after the other
+inline float4_t multiply(const float4_t m[4], const float* v) {
+    float4_t r = zero();
+    for (size_t col = 0; col < 4; col++) {
+        r = add(r, mul(m[col], splat(v[col])));
+    }
+    return r;
+}
+
+template <>
+struct Kernels<float, float> {
+    static constexpr bool AVAILABLE = true;
+
+    static void multiply(float* out, const float* m, const float* v) {
+        const float4_t columns[4] = { load(m), load(m + 4), load(m + 8), load(m + 12) };
+        store(out, simd::multiply(columns, v));
+    }
+
+    static void multiplyQuat(float* out, const float* q, const float* r) {
+        // the rows of the product in TQuatProductOperators, one term at a time
+        const float4_t v = load(r);
+        float4_t result = mul(splat(q[3]), v);
+        result = add(result, mul(splat(q[0]), withSigns(wzyx(v), 1, -1, 1, -1)));
+        result = add(result, mul(splat(q[1]), withSigns(zwxy(v), 1, 1, -1, -1)));
+        result = add(result, mul(splat(q[2]), withSigns(yxwz(v), -1, 1, 1, -1)));
+        store(out, result);
+    }
+
+    // gaussJordanInverse() with whole columns at a time
+    static void inverse(float* out, const float* m) {
+        float tmp[16];
+        float inverted[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+        for (size_t i = 0; i < 16; i++) {
+            tmp[i] = m[i];
+        }
+
+        for (size_t i = 0; i < 4; i++) {
+            // look for largest element in i'th column
+            size_t swap = i;
+            float t = fabsf(tmp[i * 4 + i]);
+            for (size_t j = i + 1; j < 4; j++) {
+                const float t2 = fabsf(tmp[j * 4 + i]);
+                if (t2 > t) {
+                    swap = j;
+                    t = t2;
+                }
+            }
+
+            if (swap != i) {
+                // swap columns.
+                const float4_t column = load(tmp + i * 4);
+                store(tmp + i * 4, load(tmp + swap * 4));
+                store(tmp + swap * 4, column);
+                const float4_t invertedColumn = load(inverted + i * 4);
+                store(inverted + i * 4, load(inverted + swap * 4));
+                store(inverted + swap * 4, invertedColumn);
+            }
+
+            const float4_t denom = splat(tmp[i * 4 + i]);
+            const float4_t pivot = divide(load(tmp + i * 4), denom);
+            const float4_t invertedPivot = divide(load(inverted + i * 4), denom);
+            store(tmp + i * 4, pivot);
+            store(inverted + i * 4, invertedPivot);
+
+            // Factor out the lower triangle
+            for (size_t j = 0; j < 4; j++) {
+                if (j != i) {
+                    const float4_t d = splat(tmp[j * 4 + i]);
+                    store(tmp + j * 4, sub(load(tmp + j * 4), mul(pivot, d)));
+                    store(inverted + j * 4, sub(load(inverted + j * 4), mul(invertedPivot, d)));
+                }
+            }
+        }
+
+        for (size_t i = 0; i < 16; i++) {
+            out[i] = inverted[i];
+        }
+    }
+};
+
+#endif // MATH_USE_SIMD
+
+}  // namespace simd
+
+// -------------------------------------------------------------------------------------
+}  // namespace details
+}  // namespace android
+
+#undef MATH_USE_SIMD
+#undef MATH_USE_NEON
+#undef MATH_USE_SSE
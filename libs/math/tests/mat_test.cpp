@@ -358,6 +358,55 @@ TEST_F(Mat2Test, MiscOps) {
     EXPECT_EQ(m1, m1*identity);
 }
 
+TEST_F(MatTest, MatchesScalarProducts) {
+    std::default_random_engine generator(171717);
+    std::uniform_real_distribution<float> distribution(-10.0f, 10.0f);
+    auto rand_gen = std::bind(distribution, generator);
+
+    for (size_t i = 0; i < 1024; ++i) {
+        mat4 a;
+        mat4 b;
+        vec4 v;
+        for (size_t col = 0; col < 4; ++col) {
+            for (size_t row = 0; row < 4; ++row) {
+                a[col][row] = rand_gen();
+                b[col][row] = rand_gen();
+            }
+            v[col] = rand_gen();
+        }
+
+        // same operations, in the same order, as the generic code
+        vec4 av(0);
+        for (size_t col = 0; col < 4; ++col) {
+            for (size_t row = 0; row < 4; ++row) {
+                const float product = a[col][row] * v[col];
+                av[row] = av[row] + product;
+            }
+        }
+        EXPECT_EQ(av, a * v);
+
+        mat4 ab(0);
+        for (size_t c = 0; c < 4; ++c) {
+            for (size_t col = 0; col < 4; ++col) {
+                for (size_t row = 0; row < 4; ++row) {
+                    const float product = a[col][row] * b[c][col];
+                    ab[c][row] = ab[c][row] + product;
+                }
+            }
+        }
+        EXPECT_EQ(ab, a * b);
+
+        const mat4d inverted(inverse(mat4d(a)));
+        const mat4 invertedf(inverse(a));
+        for (size_t col = 0; col < 4; ++col) {
+            for (size_t row = 0; row < 4; ++row) {
+                EXPECT_NEAR(inverted[col][row], invertedf[col][row],
+                        1e-3 * std::max(1.0, std::abs(inverted[col][row])));
+            }
+        }
+    }
+}
+
 //------------------------------------------------------------------------------
 // MORE MATRIX TESTS
 //------------------------------------------------------------------------------
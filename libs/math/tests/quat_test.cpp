@@ -298,4 +298,48 @@ TEST_F(QuatTest, MultiplicationExhaustive) {
     }
 }
 
+TEST_F(QuatTest, MultiplicationMatchesScalar) {
+    std::default_random_engine generator(171717);
+    std::uniform_real_distribution<float> distribution(-10.0f, 10.0f);
+    auto rand_gen = std::bind(distribution, generator);
+
+    for (size_t i = 0; i < 1024; ++i) {
+        const quat a(rand_gen(), rand_gen(), rand_gen(), rand_gen());
+        const quat b(rand_gen(), rand_gen(), rand_gen(), rand_gen());
+
+        // same operations, in the same order, as the generic code
+        const float4 lhs(a.w, a.x, a.y, a.z);
+        const float4 rhs[4] = {
+            { b.w, -b.x, -b.y, -b.z },
+            { b.x,  b.w,  b.z, -b.y },
+            { b.y, -b.z,  b.w,  b.x },
+            { b.z,  b.y, -b.x,  b.w },
+        };
+        float product[4];
+        for (size_t k = 0; k < 4; ++k) {
+            float sum = 0;
+            for (size_t j = 0; j < 4; ++j) {
+                const float term = lhs[j] * rhs[k][j];
+                sum = (j == 0) ? term : sum + term;
+            }
+            product[k] = sum;
+        }
+        const quat ab(product[0], product[1], product[2], product[3]);
+
+        EXPECT_EQ(ab, a * b);
+    }
+}
+
+TEST_F(QuatTest, ConstexprMultiplication) {
+    constexpr quat a(1, 2, 3, 4);
+    constexpr quat b(5, 6, 7, 8);
+    constexpr quat ab = a * b;
+    static_assert(ab.w == -60 && ab.x == 12 && ab.y == 30 && ab.z == 24,
+            "quaternion product must be usable in constant expressions");
+
+    volatile float w = 5;
+    const quat c(w, 6, 7, 8);
+    EXPECT_EQ(ab, a * c);
+}
+
 }; // namespace android
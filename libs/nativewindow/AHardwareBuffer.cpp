@@ -21,6 +21,8 @@
 #include <errno.h>
 #include <sys/socket.h>
 #include <memory>
+#include <mutex>
+#include <vector>
 
 #include <cutils/native_handle.h>
 #include <log/log.h>
@@ -274,6 +276,113 @@ int AHardwareBuffer_recvHandleFromUnixSocket(int socketFd, AHardwareBuffer** out
     return NO_ERROR;
 }
 
+struct AHardwareBuffer_Pool {
+    AHardwareBuffer_Desc desc;
+    uint32_t maxFreeCount;
+    mutable std::mutex lock;
+    std::vector<AHardwareBuffer*> freeBuffers;
+    uint32_t acquiredCount = 0;
+    uint64_t hitCount = 0;
+    uint64_t missCount = 0;
+};
+
+static bool matchesPool(const AHardwareBuffer_Pool* pool, const AHardwareBuffer* buffer) {
+    AHardwareBuffer_Desc desc;
+    AHardwareBuffer_describe(buffer, &desc);
+    return desc.width == pool->desc.width && desc.height == pool->desc.height &&
+            desc.layers == pool->desc.layers && desc.format == pool->desc.format &&
+            desc.usage == pool->desc.usage;
+}
+
+int AHardwareBuffer_Pool_create(const AHardwareBuffer_Desc* desc, uint32_t count,
+        AHardwareBuffer_Pool** outPool) {
+    if (!desc || !outPool || count == 0)
+        return BAD_VALUE;
+
+    std::unique_ptr<AHardwareBuffer_Pool> pool(new AHardwareBuffer_Pool);
+    pool->desc = *desc;
+    pool->maxFreeCount = count;
+    pool->freeBuffers.reserve(count);
+    for (uint32_t i = 0; i < count; i++) {
+        AHardwareBuffer* buffer = nullptr;
+        int err = AHardwareBuffer_allocate(desc, &buffer);
+        if (err != NO_ERROR) {
+            for (AHardwareBuffer* allocated : pool->freeBuffers) {
+                AHardwareBuffer_release(allocated);
+            }
+            return err;
+        }
+        pool->freeBuffers.push_back(buffer);
+    }
+
+    *outPool = pool.release();
+    return NO_ERROR;
+}
+
+int AHardwareBuffer_Pool_acquireBuffer(AHardwareBuffer_Pool* pool,
+        AHardwareBuffer** outBuffer) {
+    if (!pool || !outBuffer)
+        return BAD_VALUE;
+
+    {
+        std::lock_guard<std::mutex> lock(pool->lock);
+        if (!pool->freeBuffers.empty()) {
+            *outBuffer = pool->freeBuffers.back();
+            pool->freeBuffers.pop_back();
+            pool->acquiredCount++;
+            pool->hitCount++;
+            return NO_ERROR;
+        }
+        pool->missCount++;
+    }
+
+    // Allocate without holding the lock, so other threads keep cycling buffers meanwhile.
+    int err = AHardwareBuffer_allocate(&pool->desc, outBuffer);
+    if (err == NO_ERROR) {
+        std::lock_guard<std::mutex> lock(pool->lock);
+        pool->acquiredCount++;
+    }
+    return err;
+}
+
+void AHardwareBuffer_Pool_releaseBuffer(AHardwareBuffer_Pool* pool,
+        AHardwareBuffer* buffer) {
+    if (!pool || !buffer) return;
+
+    const bool matches = matchesPool(pool, buffer);
+    {
+        std::lock_guard<std::mutex> lock(pool->lock);
+        if (matches && pool->acquiredCount > 0) {
+            pool->acquiredCount--;
+        }
+        if (matches && pool->freeBuffers.size() < pool->maxFreeCount) {
+            pool->freeBuffers.push_back(buffer);
+            return;
+        }
+    }
+    AHardwareBuffer_release(buffer);
+}
+
+void AHardwareBuffer_Pool_getStats(const AHardwareBuffer_Pool* pool,
+        AHardwareBuffer_PoolStats* outStats) {
+    if (!pool || !outStats) return;
+
+    std::lock_guard<std::mutex> lock(pool->lock);
+    outStats->freeCount = static_cast<uint32_t>(pool->freeBuffers.size());
+    outStats->acquiredCount = pool->acquiredCount;
+    outStats->hitCount = pool->hitCount;
+    outStats->missCount = pool->missCount;
+}
+
+void AHardwareBuffer_Pool_destroy(AHardwareBuffer_Pool* pool) {
+    if (!pool) return;
+
+    for (AHardwareBuffer* buffer : pool->freeBuffers) {
+        AHardwareBuffer_release(buffer);
+    }
+    delete pool;
+}
+
 
 // ----------------------------------------------------------------------------
 // VNDK functions
@@ -302,6 +302,72 @@ int AHardwareBuffer_sendHandleToUnixSocket(const AHardwareBuffer* buffer, int so
  */
 int AHardwareBuffer_recvHandleFromUnixSocket(int socketFd, AHardwareBuffer** outBuffer);
 
+#if __ANDROID_API__ >= 29
+
+/**
+ * A pool of buffers sharing one AHardwareBuffer_Desc. Buffers released to the
+ * pool are handed out again instead of being freed, so that a pipeline
+ * cycling through many identical buffers doesn't reach the allocator for
+ * each of them.
+ */
+typedef struct AHardwareBuffer_Pool AHardwareBuffer_Pool;
+
+/**
+ * Counters returned by AHardwareBuffer_Pool_getStats().
+ */
+typedef struct AHardwareBuffer_PoolStats {
+    uint32_t    freeCount;      ///< Buffers held by the pool, ready to hand out.
+    uint32_t    acquiredCount;  ///< Buffers handed out and not released to the pool.
+    uint64_t    hitCount;       ///< Acquires served by a buffer held by the pool.
+    uint64_t    missCount;      ///< Acquires that had to allocate a buffer.
+} AHardwareBuffer_PoolStats;
+
+/**
+ * Creates a pool of buffers described by \a desc, allocating \a count of
+ * them up front. The pool holds at most \a count released buffers; any
+ * released beyond that are freed.
+ *
+ * \return 0 on success, -EINVAL if \a desc or \a outPool is NULL or \a count
+ * is 0, or an error number if a buffer can't be allocated, in which case no
+ * pool is created.
+ */
+int AHardwareBuffer_Pool_create(const AHardwareBuffer_Desc* desc, uint32_t count,
+        AHardwareBuffer_Pool** outPool);
+
+/**
+ * Hands out a buffer of the pool, allocating one if the pool holds none. The
+ * buffer keeps whatever contents it had when it was released.
+ *
+ * \return 0 on success, -EINVAL if \a pool or \a outBuffer is NULL, or an
+ * error number if the allocation fails. The returned buffer has a reference
+ * count of 1, which AHardwareBuffer_Pool_releaseBuffer() gives back.
+ */
+int AHardwareBuffer_Pool_acquireBuffer(AHardwareBuffer_Pool* pool,
+        AHardwareBuffer** outBuffer);
+
+/**
+ * Gives the reference the caller holds on \a buffer to the pool, which keeps
+ * it for a later AHardwareBuffer_Pool_acquireBuffer() if it has room and the
+ * buffer matches the pool's description, or releases it otherwise.
+ */
+void AHardwareBuffer_Pool_releaseBuffer(AHardwareBuffer_Pool* pool,
+        AHardwareBuffer* buffer);
+
+/**
+ * Fills \a outStats with the pool's counters.
+ */
+void AHardwareBuffer_Pool_getStats(const AHardwareBuffer_Pool* pool,
+        AHardwareBuffer_PoolStats* outStats);
+
+/**
+ * Releases the buffers held by the pool and destroys it. Buffers still
+ * acquired from it stay valid and must be released with
+ * AHardwareBuffer_release().
+ */
+void AHardwareBuffer_Pool_destroy(AHardwareBuffer_Pool* pool);
+
+#endif // __ANDROID_API__ >= 29
+
 __END_DECLS
 
 #endif // ANDROID_HARDWARE_BUFFER_H
@@ -237,6 +237,7 @@ enum {
     NATIVE_WINDOW_GET_CONSUMER_USAGE64          = 31,
     NATIVE_WINDOW_SET_BUFFERS_SMPTE2086_METADATA = 32,
     NATIVE_WINDOW_SET_BUFFERS_CTA861_3_METADATA = 33,
+    NATIVE_WINDOW_SET_BUFFERS_STATE             = 34,
 // clang-format on
 };
 
@@ -600,6 +601,72 @@ static inline int native_window_set_crop(
     return window->perform(window, NATIVE_WINDOW_SET_CROP, crop);
 }
 
+/* parameter for NATIVE_WINDOW_SET_BUFFERS_STATE */
+enum {
+    NATIVE_WINDOW_BUFFERS_STATE_DATASPACE       = 0x01,
+    NATIVE_WINDOW_BUFFERS_STATE_CROP            = 0x02,
+    NATIVE_WINDOW_BUFFERS_STATE_TRANSFORM       = 0x04,
+    NATIVE_WINDOW_BUFFERS_STATE_SCALING_MODE    = 0x08,
+    NATIVE_WINDOW_BUFFERS_STATE_TIMESTAMP       = 0x10,
+};
+
+struct native_window_buffers_state {
+    /* which of the fields below to set, NATIVE_WINDOW_BUFFERS_STATE_* */
+    uint32_t changes;
+    android_dataspace_t dataSpace;
+    /* an empty crop disables cropping */
+    android_native_rect_t crop;
+    int transform;
+    int scalingMode;
+    int64_t timestamp;
+};
+
+/*
+ * native_window_set_buffers_state(..., state)
+ * Sets the properties of the next queued buffers selected by state->changes,
+ * with the same effect as calling native_window_set_buffers_data_space,
+ * native_window_set_crop, native_window_set_buffers_transform,
+ * native_window_set_scaling_mode and native_window_set_buffers_timestamp, but
+ * in one call. Nothing is set if any of the values is invalid.
+ *
+ * Windows that don't implement NATIVE_WINDOW_SET_BUFFERS_STATE get the
+ * properties set one at a time.
+ */
+static inline int native_window_set_buffers_state(
+        struct ANativeWindow* window,
+        const struct native_window_buffers_state* state)
+{
+    int err = window->perform(window, NATIVE_WINDOW_SET_BUFFERS_STATE, state);
+    if (err != -ENOENT) {
+        return err;
+    }
+    err = 0;
+    if (state->changes & NATIVE_WINDOW_BUFFERS_STATE_SCALING_MODE) {
+        err = window->perform(window, NATIVE_WINDOW_SET_SCALING_MODE,
+                state->scalingMode);
+        if (err != 0) return err;
+    }
+    if (state->changes & NATIVE_WINDOW_BUFFERS_STATE_DATASPACE) {
+        err = window->perform(window, NATIVE_WINDOW_SET_BUFFERS_DATASPACE,
+                state->dataSpace);
+        if (err != 0) return err;
+    }
+    if (state->changes & NATIVE_WINDOW_BUFFERS_STATE_CROP) {
+        err = window->perform(window, NATIVE_WINDOW_SET_CROP, &state->crop);
+        if (err != 0) return err;
+    }
+    if (state->changes & NATIVE_WINDOW_BUFFERS_STATE_TRANSFORM) {
+        err = window->perform(window, NATIVE_WINDOW_SET_BUFFERS_TRANSFORM,
+                state->transform);
+        if (err != 0) return err;
+    }
+    if (state->changes & NATIVE_WINDOW_BUFFERS_STATE_TIMESTAMP) {
+        err = window->perform(window, NATIVE_WINDOW_SET_BUFFERS_TIMESTAMP,
+                state->timestamp);
+    }
+    return err;
+}
+
 /*
  * native_window_set_buffer_count(..., count)
  * Sets the number of buffers associated with this native window.
@@ -106,3 +106,80 @@ EXPECT_TRUE(TestUsageConversion(
         AHARDWAREBUFFER_USAGE_GPU_COLOR_OUTPUT | AHARDWAREBUFFER_USAGE_GPU_SAMPLED_IMAGE |
         AHARDWAREBUFFER_USAGE_VENDOR_1 | AHARDWAREBUFFER_USAGE_VENDOR_13));
 }
+
+TEST(AHardwareBufferTest, PoolRejectsInvalidArguments) {
+    AHardwareBuffer_Desc desc = {64, 64, 1, AHARDWAREBUFFER_FORMAT_R8G8B8A8_UNORM,
+            AHARDWAREBUFFER_USAGE_CPU_READ_OFTEN, 0, 0, 0};
+    AHardwareBuffer_Pool* pool = nullptr;
+    EXPECT_EQ(BAD_VALUE, AHardwareBuffer_Pool_create(nullptr, 1, &pool));
+    EXPECT_EQ(BAD_VALUE, AHardwareBuffer_Pool_create(&desc, 0, &pool));
+    EXPECT_EQ(BAD_VALUE, AHardwareBuffer_Pool_create(&desc, 1, nullptr));
+    EXPECT_EQ(nullptr, pool);
+
+    AHardwareBuffer* buffer = nullptr;
+    EXPECT_EQ(BAD_VALUE, AHardwareBuffer_Pool_acquireBuffer(nullptr, &buffer));
+}
+
+TEST(AHardwareBufferTest, PoolRecyclesReleasedBuffers) {
+    AHardwareBuffer_Desc desc = {64, 64, 1, AHARDWAREBUFFER_FORMAT_R8G8B8A8_UNORM,
+            AHARDWAREBUFFER_USAGE_CPU_READ_OFTEN, 0, 0, 0};
+    AHardwareBuffer_Pool* pool = nullptr;
+    ASSERT_EQ(NO_ERROR, AHardwareBuffer_Pool_create(&desc, 2, &pool));
+
+    AHardwareBuffer_PoolStats stats;
+    AHardwareBuffer_Pool_getStats(pool, &stats);
+    EXPECT_EQ(2u, stats.freeCount);
+    EXPECT_EQ(0u, stats.acquiredCount);
+
+    // Two buffers come from the pool, the third one is allocated.
+    AHardwareBuffer* buffers[3] = {};
+    for (AHardwareBuffer*& buffer : buffers) {
+        ASSERT_EQ(NO_ERROR, AHardwareBuffer_Pool_acquireBuffer(pool, &buffer));
+    }
+    AHardwareBuffer_Pool_getStats(pool, &stats);
+    EXPECT_EQ(0u, stats.freeCount);
+    EXPECT_EQ(3u, stats.acquiredCount);
+    EXPECT_EQ(2u, stats.hitCount);
+    EXPECT_EQ(1u, stats.missCount);
+
+    // The pool only holds as many buffers as it was created with.
+    for (AHardwareBuffer* buffer : buffers) {
+        AHardwareBuffer_Pool_releaseBuffer(pool, buffer);
+    }
+    AHardwareBuffer_Pool_getStats(pool, &stats);
+    EXPECT_EQ(2u, stats.freeCount);
+    EXPECT_EQ(0u, stats.acquiredCount);
+
+    // A released buffer is the next one handed out.
+    AHardwareBuffer* buffer = nullptr;
+    ASSERT_EQ(NO_ERROR, AHardwareBuffer_Pool_acquireBuffer(pool, &buffer));
+    AHardwareBuffer_Pool_releaseBuffer(pool, buffer);
+    AHardwareBuffer* again = nullptr;
+    ASSERT_EQ(NO_ERROR, AHardwareBuffer_Pool_acquireBuffer(pool, &again));
+    EXPECT_EQ(buffer, again);
+    AHardwareBuffer_Pool_releaseBuffer(pool, again);
+
+    AHardwareBuffer_Pool_destroy(pool);
+}
+
+TEST(AHardwareBufferTest, PoolDoesNotKeepForeignBuffers) {
+    AHardwareBuffer_Desc desc = {64, 64, 1, AHARDWAREBUFFER_FORMAT_R8G8B8A8_UNORM,
+            AHARDWAREBUFFER_USAGE_CPU_READ_OFTEN, 0, 0, 0};
+    AHardwareBuffer_Pool* pool = nullptr;
+    ASSERT_EQ(NO_ERROR, AHardwareBuffer_Pool_create(&desc, 1, &pool));
+    AHardwareBuffer* pooled = nullptr;
+    ASSERT_EQ(NO_ERROR, AHardwareBuffer_Pool_acquireBuffer(pool, &pooled));
+
+    AHardwareBuffer_Desc otherDesc = desc;
+    otherDesc.width = 32;
+    AHardwareBuffer* other = nullptr;
+    ASSERT_EQ(NO_ERROR, AHardwareBuffer_allocate(&otherDesc, &other));
+    AHardwareBuffer_Pool_releaseBuffer(pool, other);
+
+    AHardwareBuffer_PoolStats stats;
+    AHardwareBuffer_Pool_getStats(pool, &stats);
+    EXPECT_EQ(0u, stats.freeCount);
+
+    AHardwareBuffer_Pool_releaseBuffer(pool, pooled);
+    AHardwareBuffer_Pool_destroy(pool);
+}
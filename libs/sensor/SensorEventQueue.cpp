@@ -27,6 +27,7 @@
 #include <sensor/Sensor.h>
 #include <sensor/BitTube.h>
 #include <sensor/ISensorEventConnection.h>
+#include <sensor/SensorEventRing.h>
 
 #include <android/sensor.h>
 
@@ -37,8 +38,8 @@ namespace android {
 // ----------------------------------------------------------------------------
 
 SensorEventQueue::SensorEventQueue(const sp<ISensorEventConnection>& connection)
-    : mSensorEventConnection(connection), mRecBuffer(NULL), mAvailable(0), mConsumed(0),
-      mNumAcksToSend(0) {
+    : mSensorEventConnection(connection), mRecBuffer(NULL), mPeekedEvents(NULL),
+      mPeekedCount(0), mAvailable(0), mConsumed(0), mNumAcksToSend(0) {
     mRecBuffer = new ASensorEvent[MAX_RECEIVE_BUFFER_EVENT_COUNT];
 }
 
@@ -49,10 +50,14 @@ SensorEventQueue::~SensorEventQueue() {
 void SensorEventQueue::onFirstRef()
 {
     mSensorChannel = mSensorEventConnection->getSensorChannel();
+    mEventRing = mSensorEventConnection->getSensorEventRing();
 }
 
 int SensorEventQueue::getFd() const
 {
+    if (mEventRing != NULL) {
+        return mEventRing->getDataFd();
+    }
     return mSensorChannel->getFd();
 }
 
@@ -63,6 +68,16 @@ ssize_t SensorEventQueue::write(const sp<BitTube>& tube,
 }
 
 ssize_t SensorEventQueue::read(ASensorEvent* events, size_t numEvents) {
+    if (mEventRing != NULL) {
+        ssize_t count = mEventRing->read(events, numEvents);
+        if (count == 0) {
+            // Clear the wake-up before looking again, so that events written after the
+            // first look are either read now or signalled anew.
+            mEventRing->clearData();
+            count = mEventRing->read(events, numEvents);
+        }
+        return count == 0 ? -EAGAIN : count;
+    }
     if (mAvailable == 0) {
         ssize_t err = BitTube::recvObjects(mSensorChannel,
                 mRecBuffer, MAX_RECEIVE_BUFFER_EVENT_COUNT);
@@ -79,6 +94,50 @@ ssize_t SensorEventQueue::read(ASensorEvent* events, size_t numEvents) {
     return static_cast<ssize_t>(count);
 }
 
+ssize_t SensorEventQueue::peekEvents(ASensorEvent const** events) {
+    ssize_t count;
+    if (mEventRing != NULL) {
+        count = mEventRing->peek(events);
+        if (count == 0) {
+            mEventRing->clearData();
+            count = mEventRing->peek(events);
+        }
+        if (count == 0) {
+            count = -EAGAIN;
+        }
+    } else {
+        if (mAvailable == 0) {
+            ssize_t err = BitTube::recvObjects(mSensorChannel,
+                    mRecBuffer, MAX_RECEIVE_BUFFER_EVENT_COUNT);
+            if (err < 0) {
+                return err;
+            }
+            mAvailable = static_cast<size_t>(err);
+            mConsumed = 0;
+        }
+        *events = mRecBuffer + mConsumed;
+        count = static_cast<ssize_t>(mAvailable);
+    }
+    if (count > 0) {
+        mPeekedEvents = *events;
+        mPeekedCount = static_cast<size_t>(count);
+    }
+    return count;
+}
+
+void SensorEventQueue::consumeEvents(size_t count) {
+    count = min(count, mPeekedCount);
+    sendAck(mPeekedEvents, static_cast<int>(count));
+    if (mEventRing != NULL) {
+        mEventRing->consume(count);
+    } else {
+        mAvailable -= count;
+        mConsumed += count;
+    }
+    mPeekedEvents = NULL;
+    mPeekedCount = 0;
+}
+
 sp<Looper> SensorEventQueue::getLooper() const
 {
     Mutex::Autolock _l(mLock);
@@ -0,0 +1,326 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "Sensors"
+
+#include <sensor/SensorEventRing.h>
+
+#include <errno.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+
+#include <binder/Parcel.h>
+#include <cutils/ashmem.h>
+#include <log/log.h>
+
+#include <android/sensor.h>
+
+namespace android {
+// ----------------------------------------------------------------------------
+
+// Indices run over twice the capacity, so that a full ring and an empty one differ.
+struct SensorEventRing::Control {
+    std::atomic<uint32_t> writeIndex;
+    std::atomic<uint32_t> readIndex;
+    std::atomic<uint32_t> writerWaiting;
+};
+
+// The events start on their own cache line.
+static const size_t CONTROL_SIZE = 64;
+
+// Keeps twice the capacity within the indices.
+static const size_t MAX_CAPACITY = 1 << 20;
+
+SensorEventRing::SensorEventRing(size_t capacity)
+    : mMemoryFd(-1), mDataFd(-1), mSpaceFd(-1), mBase(NULL), mSize(0), mCapacity(0),
+      mControl(NULL), mEvents(NULL), mWriteIndex(0), mReadIndex(0), mBroken(false)
+{
+    if (capacity == 0 || capacity > MAX_CAPACITY) {
+        ALOGE("SensorEventRing: invalid capacity %zu", capacity);
+        return;
+    }
+    const size_t size = CONTROL_SIZE + capacity * sizeof(ASensorEvent);
+    int memoryFd = ashmem_create_region("SensorEventRing", size);
+    if (memoryFd < 0) {
+        ALOGE("SensorEventRing: can't create shared memory (%s)", strerror(errno));
+        return;
+    }
+    int dataFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    int spaceFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    init(memoryFd, dataFd, spaceFd);
+    if (mControl != NULL) {
+        mControl->writeIndex.store(0, std::memory_order_relaxed);
+        mControl->readIndex.store(0, std::memory_order_relaxed);
+        mControl->writerWaiting.store(0, std::memory_order_relaxed);
+    }
+}
+
+SensorEventRing::SensorEventRing(const Parcel& data)
+    : mMemoryFd(-1), mDataFd(-1), mSpaceFd(-1), mBase(NULL), mSize(0), mCapacity(0),
+      mControl(NULL), mEvents(NULL), mWriteIndex(0), mReadIndex(0), mBroken(false)
+{
+    int memoryFd = dup(data.readFileDescriptor());
+    int dataFd = dup(data.readFileDescriptor());
+    int spaceFd = dup(data.readFileDescriptor());
+    init(memoryFd, dataFd, spaceFd);
+}
+
+SensorEventRing::~SensorEventRing()
+{
+    if (mBase != NULL)
+        munmap(mBase, mSize);
+
+    if (mMemoryFd >= 0)
+        close(mMemoryFd);
+
+    if (mDataFd >= 0)
+        close(mDataFd);
+
+    if (mSpaceFd >= 0)
+        close(mSpaceFd);
+}
+
+void SensorEventRing::init(int memoryFd, int dataFd, int spaceFd) {
+    static_assert(sizeof(Control) <= CONTROL_SIZE, "Control does not fit");
+    mMemoryFd = memoryFd;
+    mDataFd = dataFd;
+    mSpaceFd = spaceFd;
+    if (memoryFd < 0 || dataFd < 0 || spaceFd < 0) {
+        ALOGE("SensorEventRing: missing file descriptor");
+        return;
+    }
+
+    // The size of the region, not anything in it, decides how much may be touched.
+    int size = ashmem_get_size_region(memoryFd);
+    if (size < 0 || static_cast<size_t>(size) <= CONTROL_SIZE
+            || (static_cast<size_t>(size) - CONTROL_SIZE) % sizeof(ASensorEvent) != 0
+            || (static_cast<size_t>(size) - CONTROL_SIZE) / sizeof(ASensorEvent) > MAX_CAPACITY) {
+        ALOGE("SensorEventRing: invalid shared memory size %d", size);
+        return;
+    }
+    void* base = mmap(NULL, static_cast<size_t>(size), PROT_READ | PROT_WRITE, MAP_SHARED,
+            memoryFd, 0);
+    if (base == MAP_FAILED) {
+        ALOGE("SensorEventRing: can't map shared memory (%s)", strerror(errno));
+        return;
+    }
+    mBase = base;
+    mSize = static_cast<size_t>(size);
+    mCapacity = (mSize - CONTROL_SIZE) / sizeof(ASensorEvent);
+    mControl = static_cast<Control*>(base);
+    mEvents = static_cast<ASensorEvent*>(static_cast<void*>(
+            static_cast<uint8_t*>(base) + CONTROL_SIZE));
+}
+
+status_t SensorEventRing::initCheck() const
+{
+    return mControl != NULL ? status_t(NO_ERROR) : status_t(NO_INIT);
+}
+
+status_t SensorEventRing::writeToParcel(Parcel* reply) const
+{
+    if (mControl == NULL)
+        return -EINVAL;
+
+    status_t result = reply->writeDupFileDescriptor(mMemoryFd);
+    if (result == NO_ERROR) {
+        result = reply->writeDupFileDescriptor(mDataFd);
+    }
+    if (result == NO_ERROR) {
+        result = reply->writeDupFileDescriptor(mSpaceFd);
+    }
+    return result;
+}
+
+size_t SensorEventRing::getCapacity() const
+{
+    return mCapacity;
+}
+
+size_t SensorEventRing::getPendingCount() const
+{
+    size_t count;
+    if (mControl == NULL || !getDistance(mControl->writeIndex.load(std::memory_order_acquire),
+            mControl->readIndex.load(std::memory_order_acquire), &count)) {
+        return 0;
+    }
+    return count;
+}
+
+bool SensorEventRing::getDistance(uint32_t writeIndex, uint32_t readIndex,
+        size_t* outCount) const
+{
+    const size_t limit = mCapacity * 2;
+    if (writeIndex >= limit || readIndex >= limit) {
+        return false;
+    }
+    *outCount = writeIndex >= readIndex
+            ? writeIndex - readIndex : writeIndex + limit - readIndex;
+    return *outCount <= mCapacity;
+}
+
+uint32_t SensorEventRing::advance(uint32_t index, size_t count) const
+{
+    size_t next = index + count;
+    if (next >= mCapacity * 2) {
+        next -= mCapacity * 2;
+    }
+    return static_cast<uint32_t>(next);
+}
+
+ASensorEvent* SensorEventRing::getSlot(uint32_t index) const
+{
+    return mEvents + (index >= mCapacity ? index - mCapacity : index);
+}
+
+ssize_t SensorEventRing::write(ASensorEvent const* events, size_t count)
+{
+    if (mControl == NULL || mBroken)
+        return -EPIPE;
+
+    size_t pending;
+    if (!getDistance(mWriteIndex, mControl->readIndex.load(std::memory_order_acquire),
+            &pending)) {
+        ALOGE("SensorEventRing: the reader moved to an invalid index");
+        mBroken = true;
+        return -EPIPE;
+    }
+    if (count > mCapacity - pending) {
+        // Ask to be told when there is room, then look again in case the reader
+        // made room before it could see the flag.
+        mControl->writerWaiting.store(1, std::memory_order_seq_cst);
+        if (!getDistance(mWriteIndex, mControl->readIndex.load(std::memory_order_seq_cst),
+                &pending)) {
+            mBroken = true;
+            return -EPIPE;
+        }
+        if (count > mCapacity - pending) {
+            return -EAGAIN;
+        }
+        mControl->writerWaiting.store(0, std::memory_order_relaxed);
+    }
+
+    const size_t slot = static_cast<size_t>(getSlot(mWriteIndex) - mEvents);
+    const size_t first = std::min(count, mCapacity - slot);
+    memcpy(mEvents + slot, events, first * sizeof(ASensorEvent));
+    memcpy(mEvents, events + first, (count - first) * sizeof(ASensorEvent));
+    mWriteIndex = advance(mWriteIndex, count);
+    mControl->writeIndex.store(mWriteIndex, std::memory_order_release);
+    return static_cast<ssize_t>(count);
+}
+
+void SensorEventRing::signalData() const
+{
+    eventfd_write(mDataFd, 1);
+}
+
+int SensorEventRing::getSpaceFd() const
+{
+    return mSpaceFd;
+}
+
+void SensorEventRing::clearSpace() const
+{
+    eventfd_t value;
+    eventfd_read(mSpaceFd, &value);
+}
+
+ssize_t SensorEventRing::read(ASensorEvent* events, size_t count)
+{
+    if (mControl == NULL || mBroken)
+        return -EPIPE;
+
+    size_t pending;
+    if (!getReadable(&pending)) {
+        return -EPIPE;
+    }
+    count = std::min(count, pending);
+    if (count == 0) {
+        return 0;
+    }
+
+    const size_t slot = static_cast<size_t>(getSlot(mReadIndex) - mEvents);
+    const size_t first = std::min(count, mCapacity - slot);
+    memcpy(events, mEvents + slot, first * sizeof(ASensorEvent));
+    memcpy(events + first, mEvents, (count - first) * sizeof(ASensorEvent));
+    advanceRead(count);
+    return static_cast<ssize_t>(count);
+}
+
+ssize_t SensorEventRing::peek(ASensorEvent const** events)
+{
+    if (mControl == NULL || mBroken)
+        return -EPIPE;
+
+    size_t pending;
+    if (!getReadable(&pending)) {
+        return -EPIPE;
+    }
+    const size_t slot = static_cast<size_t>(getSlot(mReadIndex) - mEvents);
+    *events = mEvents + slot;
+    return static_cast<ssize_t>(std::min(pending, mCapacity - slot));
+}
+
+void SensorEventRing::consume(size_t count)
+{
+    size_t pending;
+    if (mControl == NULL || mBroken || !getReadable(&pending))
+        return;
+
+    count = std::min(count, pending);
+    if (count != 0) {
+        advanceRead(count);
+    }
+}
+
+bool SensorEventRing::getReadable(size_t* outCount)
+{
+    if (!getDistance(mControl->writeIndex.load(std::memory_order_acquire), mReadIndex,
+            outCount)) {
+        ALOGE("SensorEventRing: the writer moved to an invalid index");
+        mBroken = true;
+        return false;
+    }
+    return true;
+}
+
+void SensorEventRing::advanceRead(size_t count)
+{
+    mReadIndex = advance(mReadIndex, count);
+    mControl->readIndex.store(mReadIndex, std::memory_order_seq_cst);
+    if (mControl->writerWaiting.exchange(0, std::memory_order_seq_cst)) {
+        eventfd_write(mSpaceFd, 1);
+    }
+}
+
+int SensorEventRing::getDataFd() const
+{
+    return mDataFd;
+}
+
+void SensorEventRing::clearData() const
+{
+    eventfd_t value;
+    eventfd_read(mDataFd, &value);
+}
+
+// ----------------------------------------------------------------------------
+}; // namespace android
@@ -42,6 +42,7 @@ namespace android {
 
 class ISensorEventConnection;
 class Sensor;
+class SensorEventRing;
 class Looper;
 
 // ----------------------------------------------------------------------------
@@ -75,6 +76,13 @@ public:
 
     ssize_t read(ASensorEvent* events, size_t numEvents);
 
+    // Points 'events' at received events where they lie, in the receive buffer or in the
+    // shared ring, and returns how many there are, or -EAGAIN like read() when there are none.
+    // They stay valid until consumeEvents(), which must come before the next peek or read.
+    ssize_t peekEvents(ASensorEvent const** events);
+    // Releases the first 'count' peeked events and acks the wake-up ones among them at once.
+    void consumeEvents(size_t count);
+
     status_t waitForEvent() const;
     status_t wake() const;
 
@@ -96,9 +104,13 @@ private:
     sp<Looper> getLooper() const;
     sp<ISensorEventConnection> mSensorEventConnection;
     sp<BitTube> mSensorChannel;
+    // Events arrive here instead of through mSensorChannel when the service provides it.
+    sp<SensorEventRing> mEventRing;
     mutable Mutex mLock;
     mutable sp<Looper> mLooper;
     ASensorEvent* mRecBuffer;
+    ASensorEvent const* mPeekedEvents;
+    size_t mPeekedCount;
     size_t mAvailable;
     size_t mConsumed;
     uint32_t mNumAcksToSend;
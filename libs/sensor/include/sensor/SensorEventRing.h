@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <utils/Errors.h>
+#include <utils/RefBase.h>
+
+struct ASensorEvent;
+
+namespace android {
+// ----------------------------------------------------------------------------
+class Parcel;
+
+/*
+ * A ring of sensor events in memory shared between SensorService, which writes it,
+ * and one SensorEventQueue, which reads it.
+ *
+ * Events are written in place instead of being copied through a socket, and the
+ * reader is only woken through the data eventfd when the writer decides it should
+ * be, so a client that batches isn't woken for every batch.  When the writer finds
+ * the ring full it raises a flag, and the reader signals the space eventfd once it
+ * has made room.
+ *
+ * Neither side trusts the index the other one moves: an index out of range breaks
+ * the ring, after which reads and writes fail with -EPIPE.
+ */
+class SensorEventRing : public RefBase
+{
+public:
+
+    // creates a ring with room for 'capacity' events
+    explicit SensorEventRing(size_t capacity);
+
+    explicit SensorEventRing(const Parcel& data);
+    virtual ~SensorEventRing();
+
+    // check state after construction
+    status_t initCheck() const;
+
+    // parcels this ring
+    status_t writeToParcel(Parcel* reply) const;
+
+    size_t getCapacity() const;
+
+    // The number of events written and not yet read.
+    size_t getPendingCount() const;
+
+    // --- writer ---
+
+    // Writes all of the events, or none of them and returns -EAGAIN if they don't fit.
+    ssize_t write(ASensorEvent const* events, size_t count);
+
+    // Wakes the reader.
+    void signalData() const;
+
+    // Readable once the reader made room after a write failed for lack of it.
+    int getSpaceFd() const;
+    void clearSpace() const;
+
+    // --- reader ---
+
+    // Reads up to 'count' events, returning 0 if there are none.
+    ssize_t read(ASensorEvent* events, size_t count);
+
+    // Points 'events' at the unread events that lie next to each other in the ring, returning
+    // their count or 0 if there are none. They stay in place until consume() lets the writer
+    // reuse them.
+    ssize_t peek(ASensorEvent const** events);
+    void consume(size_t count);
+
+    // Readable once the writer signalled data.
+    int getDataFd() const;
+    void clearData() const;
+
+private:
+    struct Control;
+
+    void init(int memoryFd, int dataFd, int spaceFd);
+    bool getDistance(uint32_t writeIndex, uint32_t readIndex, size_t* outCount) const;
+    uint32_t advance(uint32_t index, size_t count) const;
+    ASensorEvent* getSlot(uint32_t index) const;
+    bool getReadable(size_t* outCount);
+    void advanceRead(size_t count);
+
+    int mMemoryFd;
+    int mDataFd;
+    int mSpaceFd;
+    void* mBase;
+    size_t mSize;
+    size_t mCapacity;
+    Control* mControl;
+    ASensorEvent* mEvents;
+
+    // Each side's own index, which the shared copy only mirrors.
+    uint32_t mWriteIndex;
+    uint32_t mReadIndex;
+    bool mBroken;
+};
+
+// ----------------------------------------------------------------------------
+}; // namespace android
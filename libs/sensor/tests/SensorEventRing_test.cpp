@@ -0,0 +1,150 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "SensorEventRing_test"
+
+#include <poll.h>
+#include <string.h>
+
+#include <android/sensor.h>
+#include <binder/Parcel.h>
+#include <sensor/SensorEventRing.h>
+#include <utils/Errors.h>
+
+#include <gtest/gtest.h>
+
+namespace android {
+
+static bool isReadable(int fd) {
+    struct pollfd pfd = { fd, POLLIN, 0 };
+    return poll(&pfd, 1, 0) == 1;
+}
+
+static void fillEvents(ASensorEvent* events, size_t count, int64_t firstTimestamp) {
+    memset(events, 0, count * sizeof(ASensorEvent));
+    for (size_t i = 0; i < count; i++) {
+        events[i].timestamp = firstTimestamp + int64_t(i);
+    }
+}
+
+class SensorEventRingTest : public testing::Test {
+protected:
+    sp<SensorEventRing> mWriter;
+    sp<SensorEventRing> mReader;
+
+    void createRing(size_t capacity) {
+        mWriter = new SensorEventRing(capacity);
+        ASSERT_EQ(NO_ERROR, mWriter->initCheck());
+        Parcel parcel;
+        ASSERT_EQ(NO_ERROR, mWriter->writeToParcel(&parcel));
+        parcel.setDataPosition(0);
+        mReader = new SensorEventRing(parcel);
+        ASSERT_EQ(NO_ERROR, mReader->initCheck());
+        ASSERT_EQ(capacity, mReader->getCapacity());
+    }
+};
+
+TEST_F(SensorEventRingTest, ReadsEventsInOrderAcrossTheEnd) {
+    createRing(5);
+    ASensorEvent events[8], received[8];
+    fillEvents(events, 8, 0);
+    EXPECT_EQ(0, mReader->read(received, 8));
+
+    ASSERT_EQ(3, mWriter->write(events, 3));
+    ASSERT_EQ(2, mReader->read(received, 2));
+    EXPECT_EQ(0, received[0].timestamp);
+    EXPECT_EQ(1, received[1].timestamp);
+
+    ASSERT_EQ(4, mWriter->write(events + 3, 4));
+    EXPECT_EQ(5U, mWriter->getPendingCount());
+    ASSERT_EQ(5, mReader->read(received, 8));
+    for (int i = 0; i < 5; i++) {
+        EXPECT_EQ(2 + i, received[i].timestamp);
+    }
+    EXPECT_EQ(0U, mReader->getPendingCount());
+}
+
+TEST_F(SensorEventRingTest, WritesAllOrNothingAndSignalsSpace) {
+    createRing(4);
+    ASensorEvent events[4], received[4];
+    fillEvents(events, 4, 0);
+
+    ASSERT_EQ(3, mWriter->write(events, 3));
+    EXPECT_EQ(-EAGAIN, mWriter->write(events, 2));
+    EXPECT_EQ(3U, mWriter->getPendingCount());
+    EXPECT_FALSE(isReadable(mWriter->getSpaceFd()));
+
+    ASSERT_EQ(1, mReader->read(received, 1));
+    EXPECT_TRUE(isReadable(mWriter->getSpaceFd()));
+    mWriter->clearSpace();
+    EXPECT_FALSE(isReadable(mWriter->getSpaceFd()));
+    EXPECT_EQ(2, mWriter->write(events, 2));
+
+    // The reader only signals space when the writer asked for it.
+    ASSERT_EQ(1, mReader->read(received, 1));
+    EXPECT_FALSE(isReadable(mWriter->getSpaceFd()));
+}
+
+TEST_F(SensorEventRingTest, SignalsDataOnlyWhenAsked) {
+    createRing(4);
+    ASensorEvent events[1];
+    fillEvents(events, 1, 0);
+
+    ASSERT_EQ(1, mWriter->write(events, 1));
+    EXPECT_FALSE(isReadable(mReader->getDataFd()));
+    mWriter->signalData();
+    EXPECT_TRUE(isReadable(mReader->getDataFd()));
+    mReader->clearData();
+    EXPECT_FALSE(isReadable(mReader->getDataFd()));
+}
+
+TEST_F(SensorEventRingTest, PeeksEventsInPlaceUntilConsumed) {
+    createRing(4);
+    ASensorEvent events[4];
+    fillEvents(events, 4, 0);
+    ASensorEvent const* peeked;
+    EXPECT_EQ(0, mReader->peek(&peeked));
+
+    ASSERT_EQ(3, mWriter->write(events, 3));
+    ASSERT_EQ(3, mReader->peek(&peeked));
+    EXPECT_EQ(0, peeked[0].timestamp);
+    EXPECT_EQ(-EAGAIN, mWriter->write(events, 2));
+    mReader->consume(3);
+    EXPECT_TRUE(isReadable(mWriter->getSpaceFd()));
+
+    // Only the events before the end of the ring are peeked at once.
+    ASSERT_EQ(3, mWriter->write(events, 3));
+    ASSERT_EQ(1, mReader->peek(&peeked));
+    EXPECT_EQ(0, peeked[0].timestamp);
+    mReader->consume(1);
+    ASSERT_EQ(2, mReader->peek(&peeked));
+    EXPECT_EQ(1, peeked[0].timestamp);
+    EXPECT_EQ(2, peeked[1].timestamp);
+    mReader->consume(2);
+    EXPECT_EQ(0U, mReader->getPendingCount());
+}
+
+TEST_F(SensorEventRingTest, RejectsInvalidCapacities) {
+    sp<SensorEventRing> ring = new SensorEventRing(0);
+    EXPECT_NE(NO_ERROR, ring->initCheck());
+    ASensorEvent events[1];
+    EXPECT_EQ(-EPIPE, ring->write(events, 1));
+    EXPECT_EQ(-EPIPE, ring->read(events, 1));
+    ASensorEvent const* peeked;
+    EXPECT_EQ(-EPIPE, ring->peek(&peeked));
+}
+
+} // namespace android
@@ -16,6 +16,17 @@
 
 #include <ui/ColorSpace.h>
 
+#include <algorithm>
+#include <limits>
+
+#if defined(__ARM_NEON__) || defined(__aarch64__)
+#include <arm_neon.h>
+#define COLOR_SPACE_USE_NEON
+#elif defined(__SSE__)
+#include <xmmintrin.h>
+#define COLOR_SPACE_USE_SSE
+#endif
+
 using namespace std::placeholders;
 
 namespace android {
@@ -365,14 +376,179 @@ std::unique_ptr<float3> ColorSpace::createLUT(uint32_t size,
     for (uint32_t z = 0; z < size; z++) {
         for (int32_t y = int32_t(size - 1); y >= 0; y--) {
             for (uint32_t x = 0; x < size; x++) {
-                *data++ = connector.transform({x * m, y * m, z * m});
+                *data++ = {x * m, y * m, z * m};
             }
         }
     }
+    connector.transform(lut.get(), lut.get(), size * size * size);
+
+    return lut;
+}
+
+// ----------------------------------------------------------------------------
+// Batch conversions
+// ----------------------------------------------------------------------------
+
+// Number of entries in a tabulated transfer function
+static constexpr size_t TRANSFER_LUT_SIZE = 4096;
+
+// Widest range, in either direction, a transfer function is tabulated over
+static constexpr float MAX_TABULATED_RANGE = 16.0f;
+
+// Largest difference allowed between a table and the function it samples
+static constexpr float TRANSFER_LUT_TOLERANCE = 3e-5f;
+
+// Tables are indexed by sign(x) * |x|^(1/4) rather than x. Gamma curves are
+// steepest close to 0, and this puts more of the entries there.
+static inline float toTableDomain(float x) {
+    return std::copysign(std::sqrt(std::sqrt(std::abs(x))), x);
+}
+
+static inline float fromTableDomain(float t) {
+    const float t2 = t * t;
+    return std::copysign(t2 * t2, t);
+}
+
+struct ColorSpaceConnector::TransferLUT {
+    // Tabulates f over [lo, hi], with results clamped to [outLo, outHi].
+    // Returns null if interpolating the table does not reproduce f.
+    static std::shared_ptr<const TransferLUT> create(
+            const ColorSpace::transfer_function& f, float lo, float hi, float outLo, float outHi);
+
+    float operator()(float x) const noexcept {
+        const float p = (toTableDomain(clamp(x, lo, hi)) - tLo) * scale;
+        const size_t i = std::min(static_cast<size_t>(p), TRANSFER_LUT_SIZE - 2);
+        const float t = p - static_cast<float>(i);
+        return clamp(table[i] + t * (table[i + 1] - table[i]), outLo, outHi);
+    }
+
+    float lo;
+    float hi;
+    float outLo;
+    float outHi;
+    float tLo;
+    float scale;
+    std::array<float, TRANSFER_LUT_SIZE> table;
+};
+
+std::shared_ptr<const ColorSpaceConnector::TransferLUT> ColorSpaceConnector::TransferLUT::create(
+        const ColorSpace::transfer_function& f, float lo, float hi, float outLo, float outHi) {
+    if (!(lo < hi) || lo < -MAX_TABULATED_RANGE || hi > MAX_TABULATED_RANGE) {
+        return nullptr;
+    }
+
+    std::shared_ptr<TransferLUT> lut = std::make_shared<TransferLUT>();
+    lut->lo = lo;
+    lut->hi = hi;
+    lut->outLo = outLo;
+    lut->outHi = outHi;
+    lut->tLo = toTableDomain(lo);
+    const float step = (toTableDomain(hi) - lut->tLo) / float(TRANSFER_LUT_SIZE - 1);
+    lut->scale = 1.0f / step;
+    for (size_t i = 0; i < TRANSFER_LUT_SIZE; i++) {
+        lut->table[i] = f(fromTableDomain(lut->tLo + step * float(i)));
+    }
 
+    // Interpolation is least accurate halfway between entries
+    for (size_t i = 0; i < TRANSFER_LUT_SIZE - 1; i++) {
+        const float x = fromTableDomain(lut->tLo + step * (float(i) + 0.5f));
+        const float expected = clamp(f(x), outLo, outHi);
+        if (!(std::abs((*lut)(x) - expected) <= TRANSFER_LUT_TOLERANCE)) {
+            return nullptr;
+        }
+    }
     return lut;
 }
 
+// Returns the range clamper clamps values to, if it is a plain clamp.
+static bool getClampRange(const ColorSpace::clamping_function& clamper, float* lo, float* hi) {
+    *lo = clamper(std::numeric_limits<float>::lowest());
+    *hi = clamper(std::numeric_limits<float>::max());
+    if (!(*lo < *hi) || clamper(*hi) != *hi) {
+        return false;
+    }
+    for (int i = 0; i < 16; i++) {
+        const float x = *lo + (*hi - *lo) * float(i) / 16.0f;
+        if (clamper(x) != x) {
+            return false;
+        }
+    }
+    return true;
+}
+
+namespace {
+
+// Multiplies values by a fixed matrix, a whole column at a time on CPUs with
+// vector units.
+class MatrixKernel {
+public:
+    explicit MatrixKernel(const mat3& m) {
+#if defined(COLOR_SPACE_USE_NEON)
+        for (size_t i = 0; i < 3; i++) {
+            const float column[4] = { m[i].x, m[i].y, m[i].z, 0.0f };
+            mColumns[i] = vld1q_f32(column);
+        }
+#elif defined(COLOR_SPACE_USE_SSE)
+        for (size_t i = 0; i < 3; i++) {
+            mColumns[i] = _mm_setr_ps(m[i].x, m[i].y, m[i].z, 0.0f);
+        }
+#else
+        mMatrix = m;
+#endif
+    }
+
+    float3 operator()(const float3& v) const {
+#if defined(COLOR_SPACE_USE_NEON)
+        float32x4_t r = vmulq_n_f32(mColumns[0], v.x);
+        r = vmlaq_n_f32(r, mColumns[1], v.y);
+        r = vmlaq_n_f32(r, mColumns[2], v.z);
+        float out[4];
+        vst1q_f32(out, r);
+        return float3{out[0], out[1], out[2]};
+#elif defined(COLOR_SPACE_USE_SSE)
+        __m128 r = _mm_mul_ps(mColumns[0], _mm_set1_ps(v.x));
+        r = _mm_add_ps(r, _mm_mul_ps(mColumns[1], _mm_set1_ps(v.y)));
+        r = _mm_add_ps(r, _mm_mul_ps(mColumns[2], _mm_set1_ps(v.z)));
+        float out[4];
+        _mm_storeu_ps(out, r);
+        return float3{out[0], out[1], out[2]};
+#else
+        return mMatrix * v;
+#endif
+    }
+
+private:
+#if defined(COLOR_SPACE_USE_NEON)
+    float32x4_t mColumns[3];
+#elif defined(COLOR_SPACE_USE_SSE)
+    __m128 mColumns[3];
+#else
+    mat3 mMatrix;
+#endif
+};
+
+} // namespace
+
+void ColorSpaceConnector::transform(const float3* src, float3* dst, size_t count) const noexcept {
+    if (!mSourceEOTF || !mDestinationOETF) {
+        for (size_t i = 0; i < count; i++) {
+            dst[i] = transform(src[i]);
+        }
+        return;
+    }
+
+    // The source's clamp is folded into its table, and the destination's
+    // into its table and the table's output range
+    const TransferLUT& eotf(*mSourceEOTF);
+    const TransferLUT& oetf(*mDestinationOETF);
+    const MatrixKernel multiply(mTransform);
+    for (size_t i = 0; i < count; i++) {
+        const float3 v(src[i]);
+        const float3 linear(multiply(float3{eotf(v.x), eotf(v.y), eotf(v.z)}));
+        dst[i] = float3{oetf(linear.x), oetf(linear.y), oetf(linear.z)};
+    }
+}
+
 static const float2 ILLUMINANT_D50_XY = {0.34567f, 0.35850f};
 static const float3 ILLUMINANT_D50_XYZ = {0.964212f, 1.0f, 0.825188f};
 static const mat3 BRADFORD = mat3{
@@ -412,6 +588,24 @@ ColorSpaceConnector::ColorSpaceConnector(
 
         mTransform = xyzToRGB * rgbToXYZ;
     }
+
+    float srcLo, srcHi, dstLo, dstHi;
+    if (getClampRange(src.getClamper(), &srcLo, &srcHi) &&
+            getClampRange(dst.getClamper(), &dstLo, &dstHi)) {
+        const float infinity = std::numeric_limits<float>::infinity();
+        // Linear values beyond what the destination EOTF produces for its
+        // clamp range are clamped away after the OETF, assuming the two are
+        // inverses of each other, so the OETF table only needs that range
+        const ColorSpace::transfer_function& dstEOTF(dst.getEOTF());
+        const ColorSpace::transfer_function& dstOETF(dst.getOETF());
+        const float linearLo = dstEOTF(dstLo);
+        const float linearHi = dstEOTF(dstHi);
+        if (std::abs(dstOETF(linearLo) - dstLo) <= TRANSFER_LUT_TOLERANCE &&
+                std::abs(dstOETF(linearHi) - dstHi) <= TRANSFER_LUT_TOLERANCE) {
+            mSourceEOTF = TransferLUT::create(src.getEOTF(), srcLo, srcHi, -infinity, infinity);
+            mDestinationOETF = TransferLUT::create(dstOETF, linearLo, linearHi, dstLo, dstHi);
+        }
+    }
 }
 
 }; // namespace android
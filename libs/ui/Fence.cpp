@@ -29,6 +29,9 @@
 
 #include <sys/types.h>
 #include <unistd.h>
+
+#include <algorithm>
+
 #include <utils/Log.h>
 #include <utils/String8.h>
 #include <utils/Trace.h>
@@ -100,6 +103,34 @@ sp<Fence> Fence::merge(const String8& name, const sp<Fence>& f1,
     return merge(name.string(), f1, f2);
 }
 
+sp<Fence> Fence::mergeAll(const char* name, const std::vector<sp<Fence>>& fences) {
+    ATRACE_CALL();
+    std::vector<sp<Fence>> pending;
+    for (const sp<Fence>& fence : fences) {
+        if (fence == nullptr || !fence->isValid() || fence->wait(0) == NO_ERROR) {
+            continue;
+        }
+        if (std::find(pending.begin(), pending.end(), fence) == pending.end()) {
+            pending.push_back(fence);
+        }
+    }
+    if (pending.empty()) {
+        return NO_FENCE;
+    }
+
+    // Merge as a balanced tree so each intermediate fence stays small
+    while (pending.size() > 1) {
+        size_t merged = 0;
+        for (size_t i = 0; i < pending.size(); i += 2) {
+            pending[merged++] = (i + 1 < pending.size())
+                    ? merge(name, pending[i], pending[i + 1])
+                    : pending[i];
+        }
+        pending.resize(merged);
+    }
+    return pending[0];
+}
+
 int Fence::dup() const {
     return ::dup(mFenceFd);
 }
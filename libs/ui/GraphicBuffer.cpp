@@ -18,10 +18,29 @@
 
 #include <ui/GraphicBuffer.h>
 
+#include <errno.h>
+#include <inttypes.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <vector>
+
 #include <cutils/atomic.h>
 
 #include <grallocusage/GrallocUsageConversion.h>
 
+// We would eliminate the non-conforming zero-length array, but we can't since
+// this is effectively included from the Linux kernel
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wzero-length-array"
+#include <sync/sync.h>
+#pragma clang diagnostic pop
+
 #include <ui/DetachedBufferHandle.h>
 #include <ui/Gralloc2.h>
 #include <ui/GraphicBufferAllocator.h>
@@ -40,13 +59,181 @@ static uint64_t getUniqueId() {
     return id;
 }
 
+// ---------------------------------------------------------------------------
+// Imports shared between the GraphicBuffers unflattened from one buffer
+// ---------------------------------------------------------------------------
+
+// A buffer sent again to this process, as BufferQueue does on every
+// requestBuffer(), would otherwise be imported by the mapper each time. Its
+// id and generation are chosen by the sender though, so a new import only
+// reuses an old one whose fds refer to the same files. Files are told apart
+// by inode, which some kernels give all dma-bufs alike: an import can only
+// be reused if, when it was made, another one was alive and none of the
+// others shared the inode of its first fd.
+struct GraphicBuffer::SharedImport : public RefBase {
+    typedef std::pair<uint64_t, uint32_t> Key;   // id, generation
+
+    Key key;
+    // as in ANativeWindowBuffer
+    int width = 0;
+    int height = 0;
+    int stride = 0;
+    int format = 0;
+    uintptr_t layerCount = 0;
+    uint64_t usage = 0;
+    std::vector<int> ints;
+    std::vector<std::pair<dev_t, ino_t>> files;
+    std::atomic<bool> reusable{false};
+
+    buffer_handle_t handle = nullptr;
+    uint32_t transportNumFds = 0;
+    uint32_t transportNumInts = 0;
+
+    ~SharedImport() override;
+
+    static bool getFiles(const native_handle_t* rawHandle,
+                         std::vector<std::pair<dev_t, ino_t>>* outFiles);
+    bool matches(const GraphicBuffer& buffer, const native_handle_t* rawHandle,
+                 const std::vector<std::pair<dev_t, ino_t>>& rawFiles) const;
+
+    static std::mutex sLock;
+    static std::map<Key, wp<SharedImport>> sImports;
+};
+
+std::mutex GraphicBuffer::SharedImport::sLock;
+std::map<GraphicBuffer::SharedImport::Key, wp<GraphicBuffer::SharedImport>>
+        GraphicBuffer::SharedImport::sImports;
+
+GraphicBuffer::SharedImport::~SharedImport() {
+    {
+        std::lock_guard<std::mutex> lock(sLock);
+        auto entry = sImports.find(key);
+        if (entry != sImports.end() && entry->second.unsafe_get() == this) {
+            sImports.erase(entry);
+        }
+    }
+    GraphicBufferMapper::get().freeBuffer(handle);
+}
+
+bool GraphicBuffer::SharedImport::getFiles(const native_handle_t* rawHandle,
+                                           std::vector<std::pair<dev_t, ino_t>>* outFiles) {
+    outFiles->resize(static_cast<size_t>(rawHandle->numFds));
+    for (int i = 0; i < rawHandle->numFds; i++) {
+        struct stat st;
+        if (fstat(rawHandle->data[i], &st) != 0) {
+            return false;
+        }
+        (*outFiles)[static_cast<size_t>(i)] = std::make_pair(st.st_dev, st.st_ino);
+    }
+    return true;
+}
+
+bool GraphicBuffer::SharedImport::matches(const GraphicBuffer& buffer,
+        const native_handle_t* rawHandle,
+        const std::vector<std::pair<dev_t, ino_t>>& rawFiles) const {
+    return reusable && width == buffer.width && height == buffer.height &&
+            stride == buffer.stride && format == buffer.format &&
+            layerCount == buffer.layerCount && usage == buffer.usage &&
+            files == rawFiles && ints.size() == static_cast<size_t>(rawHandle->numInts) &&
+            std::equal(ints.begin(), ints.end(), rawHandle->data + rawHandle->numFds);
+}
+
+status_t GraphicBuffer::importShared(const native_handle_t* rawHandle) {
+    // Buffers the CPU maps aren't shared, so that each GraphicBuffer locks
+    // its own handle.
+    std::vector<std::pair<dev_t, ino_t>> files;
+    const bool shareable = rawHandle->numFds > 0 && (usage & USAGE_SOFTWARE_MASK) == 0 &&
+            SharedImport::getFiles(rawHandle, &files);
+    const SharedImport::Key key(mId, mGenerationNumber);
+
+    if (shareable) {
+        // Released out of the lock, which its destructor takes.
+        sp<SharedImport> import;
+        {
+            std::lock_guard<std::mutex> lock(SharedImport::sLock);
+            auto entry = SharedImport::sImports.find(key);
+            if (entry != SharedImport::sImports.end()) {
+                import = entry->second.promote();
+            }
+        }
+        if (import != nullptr && import->matches(*this, rawHandle, files)) {
+            mSharedImport = import;
+            handle = import->handle;
+            mTransportNumFds = import->transportNumFds;
+            mTransportNumInts = import->transportNumInts;
+            native_handle_close(rawHandle);
+            native_handle_delete(const_cast<native_handle_t*>(rawHandle));
+            return NO_ERROR;
+        }
+    }
+
+    buffer_handle_t importedHandle;
+    status_t err = mBufferMapper.importBuffer(rawHandle, uint32_t(width), uint32_t(height),
+            uint32_t(layerCount), format, usage, uint32_t(stride), &importedHandle);
+    if (err != NO_ERROR) {
+        return err;
+    }
+
+    uint32_t transportNumFds = 0;
+    uint32_t transportNumInts = 0;
+    mBufferMapper.getTransportSize(importedHandle, &transportNumFds, &transportNumInts);
+
+    if (shareable) {
+        sp<SharedImport> import = new SharedImport();
+        import->key = key;
+        import->width = width;
+        import->height = height;
+        import->stride = stride;
+        import->format = format;
+        import->layerCount = layerCount;
+        import->usage = usage;
+        import->ints.assign(rawHandle->data + rawHandle->numFds,
+                            rawHandle->data + rawHandle->numFds + rawHandle->numInts);
+        import->files = std::move(files);
+        import->handle = importedHandle;
+        import->transportNumFds = transportNumFds;
+        import->transportNumInts = transportNumInts;
+
+        // The entries no longer used are only dropped out of the lock.
+        std::vector<sp<SharedImport>> others;
+        {
+            std::lock_guard<std::mutex> lock(SharedImport::sLock);
+            bool alive = false;
+            bool collides = false;
+            for (auto& entry : SharedImport::sImports) {
+                sp<SharedImport> other = entry.second.promote();
+                if (other == nullptr) {
+                    continue;
+                }
+                alive = true;
+                if (other->files[0] == import->files[0]) {
+                    other->reusable = false;
+                    collides = true;
+                }
+                others.push_back(other);
+            }
+            import->reusable = alive && !collides;
+            SharedImport::sImports[key] = import;
+        }
+        mSharedImport = import;
+    }
+
+    native_handle_close(rawHandle);
+    native_handle_delete(const_cast<native_handle_t*>(rawHandle));
+    handle = importedHandle;
+    mTransportNumFds = transportNumFds;
+    mTransportNumInts = transportNumInts;
+    return NO_ERROR;
+}
+
 sp<GraphicBuffer> GraphicBuffer::from(ANativeWindowBuffer* anwb) {
     return static_cast<GraphicBuffer *>(anwb);
 }
 
 GraphicBuffer::GraphicBuffer()
     : BASE(), mOwner(ownData), mBufferMapper(GraphicBufferMapper::get()),
-      mInitCheck(NO_ERROR), mId(getUniqueId()), mGenerationNumber(0)
+      mInitCheck(NO_ERROR), mId(getUniqueId()), mPersistentMapping(false),
+      mPersistentVaddr(nullptr), mGenerationNumber(0)
 {
     width  =
     height =
@@ -103,8 +290,13 @@ GraphicBuffer::~GraphicBuffer()
 
 void GraphicBuffer::free_handle()
 {
+    unmapPersistent();
     if (mOwner == ownHandle) {
-        mBufferMapper.freeBuffer(handle);
+        if (mSharedImport != nullptr) {
+            mSharedImport.clear();
+        } else {
+            mBufferMapper.freeBuffer(handle);
+        }
     } else if (mOwner == ownData) {
         GraphicBufferAllocator& allocator(GraphicBufferAllocator::get());
         allocator.free(handle);
@@ -143,6 +335,7 @@ status_t GraphicBuffer::reallocate(uint32_t inWidth, uint32_t inHeight,
         return NO_ERROR;
 
     if (handle) {
+        unmapPersistent();
         GraphicBufferAllocator& allocator(GraphicBufferAllocator::get());
         allocator.free(handle);
         handle = 0;
@@ -240,6 +433,9 @@ status_t GraphicBuffer::lock(uint32_t inUsage, const Rect& rect, void** vaddr)
                 width, height);
         return BAD_VALUE;
     }
+    if (canLockPersistent(inUsage)) {
+        return lockPersistent(vaddr, -1);
+    }
     status_t res = getBufferMapper().lock(handle, inUsage, rect, vaddr);
     return res;
 }
@@ -261,12 +457,16 @@ status_t GraphicBuffer::lockYCbCr(uint32_t inUsage, const Rect& rect,
                 width, height);
         return BAD_VALUE;
     }
+    unmapPersistent();
     status_t res = getBufferMapper().lockYCbCr(handle, inUsage, rect, ycbcr);
     return res;
 }
 
 status_t GraphicBuffer::unlock()
 {
+    if (mPersistentVaddr != nullptr) {
+        return NO_ERROR;
+    }
     status_t res = getBufferMapper().unlock(handle);
     return res;
 }
@@ -294,6 +494,9 @@ status_t GraphicBuffer::lockAsync(uint64_t inProducerUsage,
                 width, height);
         return BAD_VALUE;
     }
+    if (canLockPersistent(inProducerUsage | inConsumerUsage)) {
+        return lockPersistent(vaddr, fenceFd);
+    }
     status_t res = getBufferMapper().lockAsync(handle, inProducerUsage,
             inConsumerUsage, rect, vaddr, fenceFd);
     return res;
@@ -317,16 +520,78 @@ status_t GraphicBuffer::lockAsyncYCbCr(uint32_t inUsage, const Rect& rect,
                 width, height);
         return BAD_VALUE;
     }
+    unmapPersistent();
     status_t res = getBufferMapper().lockAsyncYCbCr(handle, inUsage, rect, ycbcr, fenceFd);
     return res;
 }
 
 status_t GraphicBuffer::unlockAsync(int *fenceFd)
 {
+    if (mPersistentVaddr != nullptr) {
+        *fenceFd = -1;
+        return NO_ERROR;
+    }
     status_t res = getBufferMapper().unlockAsync(handle, fenceFd);
     return res;
 }
 
+status_t GraphicBuffer::setPersistentMapping(bool enabled)
+{
+    if (enabled &&
+            (usage & USAGE_SW_READ_MASK) != USAGE_SW_READ_OFTEN &&
+            (usage & USAGE_SW_WRITE_MASK) != USAGE_SW_WRITE_OFTEN) {
+        ALOGE("persistent mapping needs USAGE_SW_*_OFTEN (usage=%#" PRIx64 ")", usage);
+        return INVALID_OPERATION;
+    }
+    if (!enabled) {
+        unmapPersistent();
+    }
+    mPersistentMapping = enabled;
+    return NO_ERROR;
+}
+
+bool GraphicBuffer::canLockPersistent(uint64_t inUsage) const
+{
+    // the mapping covers every CPU access the buffer was allocated for
+    return mPersistentMapping && handle &&
+            (inUsage & USAGE_SOFTWARE_MASK & ~usage) == 0;
+}
+
+status_t GraphicBuffer::lockPersistent(void** vaddr, int fenceFd)
+{
+    if (mPersistentVaddr == nullptr) {
+        // Map all of the buffer, as later locks may ask for any part of it
+        const uint64_t mapUsage = usage & USAGE_SOFTWARE_MASK;
+        void* mapped = nullptr;
+        status_t res = getBufferMapper().lockAsync(handle, mapUsage, mapUsage,
+                getBounds(), &mapped, fenceFd);
+        if (res != NO_ERROR) {
+            return res;
+        }
+        mPersistentVaddr = mapped;
+    } else if (fenceFd >= 0) {
+        // the mapper would have waited for the fence and taken ownership of it
+        const int err = sync_wait(fenceFd, -1) < 0 ? errno : 0;
+        close(fenceFd);
+        if (err) {
+            ALOGE("failed to wait for the lock fence: %s (%d)", strerror(err), err);
+            return -err;
+        }
+    }
+    *vaddr = mPersistentVaddr;
+    return NO_ERROR;
+}
+
+void GraphicBuffer::unmapPersistent()
+{
+    if (mPersistentVaddr == nullptr) {
+        return;
+    }
+    status_t res = getBufferMapper().unlock(handle);
+    ALOGE_IF(res != NO_ERROR, "failed to unmap persistently mapped buffer: %d", res);
+    mPersistentVaddr = nullptr;
+}
+
 size_t GraphicBuffer::getFlattenedSize() const {
     return static_cast<size_t>(13 + (handle ? mTransportNumInts : 0)) * sizeof(int);
 }
@@ -465,9 +730,7 @@ status_t GraphicBuffer::unflatten(
     mOwner = ownHandle;
 
     if (handle != 0) {
-        buffer_handle_t importedHandle;
-        status_t err = mBufferMapper.importBuffer(handle, uint32_t(width), uint32_t(height),
-                uint32_t(layerCount), format, usage, uint32_t(stride), &importedHandle);
+        status_t err = importShared(handle);
         if (err != NO_ERROR) {
             width = height = stride = format = usage_deprecated = 0;
             layerCount = 0;
@@ -476,11 +739,6 @@ status_t GraphicBuffer::unflatten(
             ALOGE("unflatten: registerBuffer failed: %s (%d)", strerror(-err), err);
             return err;
         }
-
-        native_handle_close(handle);
-        native_handle_delete(const_cast<native_handle_t*>(handle));
-        handle = importedHandle;
-        mBufferMapper.getTransportSize(handle, &mTransportNumFds, &mTransportNumInts);
     }
 
     buffer = static_cast<void const*>(static_cast<uint8_t const*>(buffer) + sizeNeeded);
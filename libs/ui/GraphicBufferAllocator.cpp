@@ -22,6 +22,10 @@
 
 #include <stdio.h>
 
+#include <algorithm>
+#include <utility>
+#include <vector>
+
 #include <grallocusage/GrallocUsageConversion.h>
 
 #include <log/log.h>
@@ -30,6 +34,7 @@
 #include <utils/Trace.h>
 
 #include <ui/Gralloc2.h>
+#include <ui/GraphicBuffer.h>
 #include <ui/GraphicBufferMapper.h>
 
 namespace android {
@@ -37,9 +42,9 @@ namespace android {
 
 ANDROID_SINGLETON_STATIC_INSTANCE( GraphicBufferAllocator )
 
-Mutex GraphicBufferAllocator::sLock;
-KeyedVector<buffer_handle_t,
-    GraphicBufferAllocator::alloc_rec_t> GraphicBufferAllocator::sAllocList;
+constexpr size_t GraphicBufferAllocator::ALLOC_SHARD_COUNT;
+GraphicBufferAllocator::alloc_shard_t
+    GraphicBufferAllocator::sAllocShards[GraphicBufferAllocator::ALLOC_SHARD_COUNT];
 
 GraphicBufferAllocator::GraphicBufferAllocator()
   : mMapper(GraphicBufferMapper::getInstance()),
@@ -50,10 +55,27 @@ GraphicBufferAllocator::GraphicBufferAllocator()
 
 GraphicBufferAllocator::~GraphicBufferAllocator() {}
 
+GraphicBufferAllocator::alloc_shard_t& GraphicBufferAllocator::shardFor(buffer_handle_t handle)
+{
+    // handles are heap allocated, so the low bits carry no information
+    const uintptr_t key = reinterpret_cast<uintptr_t>(handle) >> 4;
+    return sAllocShards[(key ^ (key >> 7)) % ALLOC_SHARD_COUNT];
+}
+
 void GraphicBufferAllocator::dump(String8& result) const
 {
-    Mutex::Autolock _l(sLock);
-    KeyedVector<buffer_handle_t, alloc_rec_t>& list(sAllocList);
+    std::vector<std::pair<buffer_handle_t, alloc_rec_t>> list;
+    for (alloc_shard_t& shard : sAllocShards) {
+        Mutex::Autolock _l(shard.lock);
+        list.insert(list.end(), shard.records.begin(), shard.records.end());
+    }
+    // keep listing the buffers in handle order, independently of the shards
+    std::sort(list.begin(), list.end(),
+            [](const std::pair<buffer_handle_t, alloc_rec_t>& lhs,
+               const std::pair<buffer_handle_t, alloc_rec_t>& rhs) {
+                return lhs.first < rhs.first;
+            });
+
     size_t total = 0;
     const size_t SIZE = 4096;
     char buffer[SIZE];
@@ -61,17 +83,17 @@ void GraphicBufferAllocator::dump(String8& result) const
     result.append(buffer);
     const size_t c = list.size();
     for (size_t i=0 ; i<c ; i++) {
-        const alloc_rec_t& rec(list.valueAt(i));
+        const alloc_rec_t& rec(list[i].second);
         if (rec.size) {
             snprintf(buffer, SIZE, "%10p: %7.2f KiB | %4u (%4u) x %4u | %4u | %8X | 0x%" PRIx64
                     " | %s\n",
-                    list.keyAt(i), rec.size/1024.0,
+                    list[i].first, rec.size/1024.0,
                     rec.width, rec.stride, rec.height, rec.layerCount, rec.format,
                     rec.usage, rec.requestorName.c_str());
         } else {
             snprintf(buffer, SIZE, "%10p: unknown     | %4u (%4u) x %4u | %4u | %8X | 0x%" PRIx64
                     " | %s\n",
-                    list.keyAt(i),
+                    list[i].first,
                     rec.width, rec.stride, rec.height, rec.layerCount, rec.format,
                     rec.usage, rec.requestorName.c_str());
         }
@@ -81,6 +103,17 @@ void GraphicBufferAllocator::dump(String8& result) const
     snprintf(buffer, SIZE, "Total allocated (estimate): %.2f KB\n", total/1024.0);
     result.append(buffer);
 
+    {
+        Mutex::Autolock _l(mRecycleLock);
+        if (mRecycleMaxBytes) {
+            snprintf(buffer, SIZE, "Recycle pool: %zu buffers, %.2f KiB of %.2f KiB, "
+                    "max age %" PRId64 " ms, hits %" PRIu64 ", misses %" PRIu64 "\n",
+                    mRecycledBuffers.size(), mRecycledBytes/1024.0, mRecycleMaxBytes/1024.0,
+                    ns2ms(mRecycleMaxAge), mRecycleHits, mRecycleMisses);
+            result.append(buffer);
+        }
+    }
+
     std::string deviceDump = mAllocator->dumpDebugInfo();
     result.append(deviceDump.c_str(), deviceDump.size());
 }
@@ -108,17 +141,19 @@ status_t GraphicBufferAllocator::allocate(uint32_t width, uint32_t height,
     if (layerCount < 1)
         layerCount = 1;
 
-    Gralloc2::IMapper::BufferDescriptorInfo info = {};
-    info.width = width;
-    info.height = height;
-    info.layerCount = layerCount;
-    info.format = static_cast<Gralloc2::PixelFormat>(format);
-    info.usage = usage;
+    Gralloc2::Error error = Gralloc2::Error::NONE;
+    if (!takeRecycledBuffer(width, height, format, layerCount, usage, requestorName,
+            handle, stride)) {
+        Gralloc2::IMapper::BufferDescriptorInfo info = {};
+        info.width = width;
+        info.height = height;
+        info.layerCount = layerCount;
+        info.format = static_cast<Gralloc2::PixelFormat>(format);
+        info.usage = usage;
 
-    Gralloc2::Error error = mAllocator->allocate(info, stride, handle);
+        error = mAllocator->allocate(info, stride, handle);
+    }
     if (error == Gralloc2::Error::NONE) {
-        Mutex::Autolock _l(sLock);
-        KeyedVector<buffer_handle_t, alloc_rec_t>& list(sAllocList);
         uint32_t bpp = bytesPerPixel(format);
         alloc_rec_t rec;
         rec.width = width;
@@ -129,7 +164,10 @@ status_t GraphicBufferAllocator::allocate(uint32_t width, uint32_t height,
         rec.usage = usage;
         rec.size = static_cast<size_t>(height * (*stride) * bpp);
         rec.requestorName = std::move(requestorName);
-        list.add(*handle, rec);
+
+        alloc_shard_t& shard(shardFor(*handle));
+        Mutex::Autolock _l(shard.lock);
+        shard.records[*handle] = std::move(rec);
 
         return NO_ERROR;
     } else {
@@ -145,16 +183,122 @@ status_t GraphicBufferAllocator::free(buffer_handle_t handle)
 {
     ATRACE_CALL();
 
-    // We allocated a buffer from the allocator and imported it into the
-    // mapper to get the handle.  We just need to free the handle now.
-    mMapper.freeBuffer(handle);
+    alloc_rec_t rec;
+    bool known = false;
+    {
+        alloc_shard_t& shard(shardFor(handle));
+        Mutex::Autolock _l(shard.lock);
+        auto it = shard.records.find(handle);
+        if (it != shard.records.end()) {
+            rec = std::move(it->second);
+            shard.records.erase(it);
+            known = true;
+        }
+    }
 
-    Mutex::Autolock _l(sLock);
-    KeyedVector<buffer_handle_t, alloc_rec_t>& list(sAllocList);
-    list.removeItem(handle);
+    if (!known || !recycleBuffer(handle, rec)) {
+        // We allocated a buffer from the allocator and imported it into the
+        // mapper to get the handle.  We just need to free the handle now.
+        mMapper.freeBuffer(handle);
+    }
 
     return NO_ERROR;
 }
 
+void GraphicBufferAllocator::setRecyclePool(size_t maxBytes, nsecs_t maxAge)
+{
+    std::vector<buffer_handle_t> expired;
+    {
+        Mutex::Autolock _l(mRecycleLock);
+        mRecycleMaxBytes = maxBytes;
+        mRecycleMaxAge = maxAge;
+        trimRecyclePoolLocked(systemTime(), expired);
+    }
+    for (buffer_handle_t handle : expired) {
+        mMapper.freeBuffer(handle);
+    }
+}
+
+bool GraphicBufferAllocator::takeRecycledBuffer(uint32_t width, uint32_t height,
+        PixelFormat format, uint32_t layerCount, uint64_t usage,
+        const std::string& requestorName, buffer_handle_t* handle, uint32_t* stride)
+{
+    std::vector<buffer_handle_t> expired;
+    bool found = false;
+    {
+        Mutex::Autolock _l(mRecycleLock);
+        if (!mRecycleMaxBytes) {
+            return false;
+        }
+        trimRecyclePoolLocked(systemTime(), expired);
+
+        // prefer the most recently released buffer, which is likelier to
+        // still be resident
+        for (auto it = mRecycledBuffers.rbegin(); it != mRecycledBuffers.rend(); ++it) {
+            const alloc_rec_t& rec(it->rec);
+            if (rec.width == width && rec.height == height && rec.format == format &&
+                    rec.layerCount == layerCount && rec.usage == usage &&
+                    rec.requestorName == requestorName) {
+                *handle = it->handle;
+                *stride = rec.stride;
+                mRecycledBytes -= rec.size;
+                mRecycledBuffers.erase(std::next(it).base());
+                found = true;
+                break;
+            }
+        }
+        if (found) {
+            mRecycleHits++;
+        } else {
+            mRecycleMisses++;
+        }
+    }
+    for (buffer_handle_t expiredHandle : expired) {
+        mMapper.freeBuffer(expiredHandle);
+    }
+    return found;
+}
+
+bool GraphicBufferAllocator::recycleBuffer(buffer_handle_t handle, alloc_rec_t& rec)
+{
+    // Buffers are only ever handed back to the requestor that released them,
+    // so their contents never cross over to another client. Protected buffers
+    // and ones whose size is unknown are not recycled at all.
+    if (!rec.size || (rec.usage & GraphicBuffer::USAGE_PROTECTED) ||
+            rec.requestorName == "<Unknown>") {
+        return false;
+    }
+
+    std::vector<buffer_handle_t> expired;
+    {
+        Mutex::Autolock _l(mRecycleLock);
+        if (rec.size > mRecycleMaxBytes) {
+            return false;
+        }
+        const nsecs_t now = systemTime();
+        mRecycledBytes += rec.size;
+        mRecycledBuffers.push_back({handle, std::move(rec), now});
+        trimRecyclePoolLocked(now, expired);
+    }
+    for (buffer_handle_t expiredHandle : expired) {
+        mMapper.freeBuffer(expiredHandle);
+    }
+    return true;
+}
+
+void GraphicBufferAllocator::trimRecyclePoolLocked(nsecs_t now,
+        std::vector<buffer_handle_t>& expired)
+{
+    while (!mRecycledBuffers.empty()) {
+        const recycled_buffer_t& oldest(mRecycledBuffers.front());
+        if (mRecycledBytes <= mRecycleMaxBytes && now - oldest.releaseTime < mRecycleMaxAge) {
+            break;
+        }
+        expired.push_back(oldest.handle);
+        mRecycledBytes -= oldest.rec.size;
+        mRecycledBuffers.pop_front();
+    }
+}
+
 // ---------------------------------------------------------------------------
 }; // namespace android
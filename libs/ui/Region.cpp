@@ -19,6 +19,8 @@
 #include <inttypes.h>
 #include <limits.h>
 
+#include <algorithm>
+
 #include <utils/Log.h>
 #include <utils/String8.h>
 #include <utils/CallStack.h>
@@ -29,6 +31,14 @@
 
 #include <private/ui/RegionHelper.h>
 
+#if defined(__ARM_NEON__) || defined(__aarch64__)
+#include <arm_neon.h>
+#define REGION_USE_NEON         (true)
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define REGION_USE_SSE2         (true)
+#endif
+
 // ----------------------------------------------------------------------------
 #define VALIDATE_REGIONS        (false)
 #define VALIDATE_WITH_CORECG    (false)
@@ -57,6 +67,82 @@ const Region Region::INVALID_REGION(Rect::INVALID_RECT);
 
 // ----------------------------------------------------------------------------
 
+// The helpers below treat a Rect as a vector of four int32_t laid out as
+// {left, top, right, bottom}.
+static_assert(sizeof(Rect) == 4 * sizeof(int32_t), "Rect must be four packed int32_t");
+
+#if defined(REGION_USE_SSE2)
+// Rects are only 4-byte aligned, so these go through unaligned accesses.
+static inline __m128i loadRect(const Rect* rect)
+{
+    return _mm_loadu_si128(static_cast<const __m128i*>(static_cast<const void*>(rect)));
+}
+
+static inline void storeRect(Rect* rect, __m128i value)
+{
+    _mm_storeu_si128(static_cast<__m128i*>(static_cast<void*>(rect)), value);
+}
+#endif
+
+// Returns true if the spans p and q, both count Rects long, cover the same
+// columns, i.e. only their top and bottom edges differ.
+static inline bool spansHaveSameColumns(const Rect* p, const Rect* q, size_t count)
+{
+#if defined(REGION_USE_NEON)
+    const uint32x4_t columns = { ~0u, 0u, ~0u, 0u };
+    for (size_t i = 0; i < count; i++) {
+        const uint32x4_t diff = vandq_u32(columns, vreinterpretq_u32_s32(veorq_s32(
+                vld1q_s32(reinterpret_cast<const int32_t*>(p + i)),
+                vld1q_s32(reinterpret_cast<const int32_t*>(q + i)))));
+        const uint32x2_t folded = vorr_u32(vget_low_u32(diff), vget_high_u32(diff));
+        if (vget_lane_u32(folded, 0) | vget_lane_u32(folded, 1)) {
+            return false;
+        }
+    }
+    return true;
+#elif defined(REGION_USE_SSE2)
+    const __m128i columns = _mm_set_epi32(0, -1, 0, -1);
+    for (size_t i = 0; i < count; i++) {
+        const __m128i diff = _mm_and_si128(columns,
+                _mm_xor_si128(loadRect(p + i), loadRect(q + i)));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(diff, _mm_setzero_si128())) != 0xFFFF) {
+            return false;
+        }
+    }
+    return true;
+#else
+    for (size_t i = 0; i < count; i++) {
+        if ((p[i].left != q[i].left) || (p[i].right != q[i].right)) {
+            return false;
+        }
+    }
+    return true;
+#endif
+}
+
+// Offsets every Rect of the array by (dx, dy).
+static inline void offsetRects(Rect* rects, size_t count, int dx, int dy)
+{
+#if defined(REGION_USE_NEON)
+    const int32x4_t offset = { dx, dy, dx, dy };
+    int32_t* p = reinterpret_cast<int32_t*>(rects);
+    for (size_t i = 0; i < count; i++, p += 4) {
+        vst1q_s32(p, vaddq_s32(vld1q_s32(p), offset));
+    }
+#elif defined(REGION_USE_SSE2)
+    const __m128i offset = _mm_set_epi32(dy, dx, dy, dx);
+    for (size_t i = 0; i < count; i++) {
+        storeRect(rects + i, _mm_add_epi32(loadRect(rects + i), offset));
+    }
+#else
+    for (size_t i = 0; i < count; i++) {
+        rects[i].offsetBy(dx, dy);
+    }
+#endif
+}
+
+// ----------------------------------------------------------------------------
+
 Region::Region() {
     mStorage.add(Rect(0,0));
 }
@@ -92,7 +178,7 @@ Region::~Region()
  * above it, and subdivided to resolve any remaining T-junctions.
  */
 static void reverseRectsResolvingJunctions(const Rect* begin, const Rect* end,
-        Vector<Rect>& dst, int spanDirection) {
+        RegionStorage& dst, int spanDirection) {
     dst.clear();
 
     const Rect* current = end - 1;
@@ -192,7 +278,7 @@ Region Region::createTJunctionFreeRegion(const Region& r) {
     if (r.isEmpty()) return r;
     if (r.isRect()) return r;
 
-    Vector<Rect> reversed;
+    RegionStorage reversed;
     reverseRectsResolvingJunctions(r.begin(), r.end(), reversed, direction_RTL);
 
     Region outputRegion;
@@ -268,7 +354,7 @@ void Region::set(uint32_t w, uint32_t h)
 }
 
 bool Region::isTriviallyEqual(const Region& region) const {
-    return begin() == region.begin();
+    return mStorage.isTriviallyEqual(region.mStorage);
 }
 
 // ----------------------------------------------------------------------------
@@ -277,7 +363,7 @@ void Region::addRectUnchecked(int l, int t, int r, int b)
 {
     Rect rect(l,t,r,b);
     size_t where = mStorage.size() - 1;
-    mStorage.insertAt(rect, where, 1);
+    mStorage.insertAt(rect, where);
 }
 
 // ----------------------------------------------------------------------------
@@ -418,10 +504,10 @@ const Region Region::operation(const Region& rhs, int dx, int dy, uint32_t op) c
 class Region::rasterizer : public region_operator<Rect>::region_rasterizer
 {
     Rect bounds;
-    Vector<Rect>& storage;
+    RegionStorage& storage;
     Rect* head;
     Rect* tail;
-    Vector<Rect> span;
+    RegionStorage span;
     Rect* cur;
 public:
     explicit rasterizer(Region& reg)
@@ -480,18 +566,9 @@ void Region::rasterizer::flushSpan()
 {
     bool merge = false;
     if (tail-head == ssize_t(span.size())) {
-        Rect const* p = span.editArray();
-        Rect const* q = head;
-        if (p->top == q->bottom) {
-            merge = true;
-            while (q != tail) {
-                if ((p->left != q->left) || (p->right != q->right)) {
-                    merge = false;
-                    break;
-                }
-                p++;
-                q++;
-            }
+        Rect const* p = span.array();
+        if (p->top == head->bottom) {
+            merge = spansHaveSameColumns(p, head, span.size());
         }
     }
     if (merge) {
@@ -589,6 +666,115 @@ bool Region::validate(const Region& reg, const char* name, bool silent)
     return result;
 }
 
+// Computes dst = lhs op (rhs offset by dx, dy) without the sweep when the
+// result follows directly from the operands' bounds: an empty operand,
+// disjoint bounds, one operand containing the other, or two rects whose
+// result is still a single rect. Returns false if the sweep is needed.
+static bool trivial_operation(uint32_t op, Region& dst,
+        const Region& lhs, const Region& rhs, int dx, int dy)
+{
+    const Rect lb(lhs.getBounds());
+    const Rect rb(Rect(rhs.getBounds()).offsetBy(dx, dy));
+
+    if (lb.isEmpty() || rb.isEmpty()) {
+        if (op == op_and || rb.isEmpty() == lb.isEmpty() ||
+                (lb.isEmpty() && op == op_nand)) {
+            dst.clear();
+        } else if (rb.isEmpty()) {
+            dst = lhs;
+        } else {
+            dst = rhs;
+            dst.translateSelf(dx, dy);
+        }
+        return true;
+    }
+
+    Rect common;
+    if (!lb.intersect(rb, &common)) {
+        if (op == op_and) {
+            dst.clear();
+            return true;
+        }
+        if (op == op_nand) {
+            dst = lhs;
+            return true;
+        }
+        return false;
+    }
+
+    const bool lhsIsRect = lhs.isRect();
+    const bool rhsIsRect = rhs.isRect();
+    if (rhsIsRect && common == lb) {
+        // rhs covers all of lhs
+        if (op == op_and) {
+            dst = lhs;
+            return true;
+        }
+        if (op == op_nand) {
+            dst.clear();
+            return true;
+        }
+        if (op == op_or) {
+            dst.set(rb);
+            return true;
+        }
+    }
+    if (lhsIsRect && common == rb) {
+        // lhs covers all of rhs
+        if (op == op_and) {
+            dst = rhs;
+            dst.translateSelf(dx, dy);
+            return true;
+        }
+        if (op == op_or) {
+            dst = lhs;
+            return true;
+        }
+    }
+    if (!lhsIsRect || !rhsIsRect) {
+        return false;
+    }
+
+    if (op == op_and) {
+        dst.set(common);
+        return true;
+    }
+    const bool sameColumns = lb.left == rb.left && lb.right == rb.right;
+    const bool sameRows = lb.top == rb.top && lb.bottom == rb.bottom;
+    if (op == op_or && (sameColumns || sameRows)) {
+        // overlapping rects lined up on one axis merge into one
+        dst.set(Rect(std::min(lb.left, rb.left), std::min(lb.top, rb.top),
+                std::max(lb.right, rb.right), std::max(lb.bottom, rb.bottom)));
+        return true;
+    }
+    if (op == op_nand) {
+        // rhs cuts lhs along a whole edge, leaving a single rect behind
+        Rect rest(lb);
+        if (rb.left <= lb.left && rb.right >= lb.right) {
+            if (rb.top <= lb.top) {
+                rest.top = rb.bottom;
+            } else if (rb.bottom >= lb.bottom) {
+                rest.bottom = rb.top;
+            } else {
+                return false;
+            }
+        } else if (rb.top <= lb.top && rb.bottom >= lb.bottom) {
+            if (rb.left <= lb.left) {
+                rest.left = rb.right;
+            } else if (rb.right >= lb.right) {
+                rest.right = rb.left;
+            } else {
+                return false;
+            }
+        } else {
+            return false;
+        }
+        dst.set(rest);
+        return true;
+    }
+    return false;
+}
+
 void Region::boolean_operation(uint32_t op, Region& dst,
         const Region& lhs,
         const Region& rhs, int dx, int dy)
@@ -599,6 +785,10 @@ void Region::boolean_operation(uint32_t op, Region& dst,
     validate(dst, "boolean_operation (before): dst");
 #endif
 
+    if (trivial_operation(op, dst, lhs, rhs, dx, dy)) {
+        return;
+    }
+
     size_t lhs_count;
     Rect const * const lhs_rects = lhs.getArray(&lhs_count);
 
@@ -714,6 +904,10 @@ void Region::boolean_operation(uint32_t op, Region& dst,
 #if VALIDATE_WITH_CORECG || VALIDATE_REGIONS
     boolean_operation(op, dst, lhs, Region(rhs), dx, dy);
 #else
+    if (trivial_operation(op, dst, lhs, Region(rhs), dx, dy)) {
+        return;
+    }
+
     size_t lhs_count;
     Rect const * const lhs_rects = lhs.getArray(&lhs_count);
 
@@ -746,13 +940,7 @@ void Region::translate(Region& reg, int dx, int dy)
 #if VALIDATE_REGIONS
         validate(reg, "translate (before)");
 #endif
-        size_t count = reg.mStorage.size();
-        Rect* rects = reg.mStorage.editArray();
-        while (count) {
-            rects->offsetBy(dx, dy);
-            rects++;
-            count--;
-        }
+        offsetRects(reg.mStorage.editArray(), reg.mStorage.size(), dx, dy);
 #if VALIDATE_REGIONS
         validate(reg, "translate (after)");
 #endif
@@ -0,0 +1,268 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "RegionStorage"
+
+#include <stdlib.h>
+
+#include <utils/Log.h>
+
+#include <ui/RegionStorage.h>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <new>
+
+namespace android {
+// ----------------------------------------------------------------------------
+
+namespace {
+
+// Blocks come in power of two capacities starting at MIN_BLOCK_CAPACITY. The
+// first POOLED_SIZE_CLASSES of them (8 to 256 Rects) are recycled through a
+// per-thread pool that keeps up to MAX_POOLED_BLOCKS free blocks of each.
+constexpr size_t MIN_BLOCK_CAPACITY = 8;
+constexpr uint32_t POOLED_SIZE_CLASSES = 6;
+constexpr size_t MAX_POOLED_BLOCKS = 8;
+
+size_t blockCapacity(uint32_t sizeClass) {
+    return MIN_BLOCK_CAPACITY << sizeClass;
+}
+
+class BlockPool {
+public:
+    ~BlockPool() {
+        for (FreeList& freeList : mFreeLists) {
+            for (size_t i = 0; i < freeList.count; i++) {
+                free(freeList.blocks[i]);
+            }
+        }
+    }
+
+    void* get(uint32_t sizeClass) {
+        if (sizeClass >= POOLED_SIZE_CLASSES || mFreeLists[sizeClass].count == 0) {
+            return nullptr;
+        }
+        FreeList& freeList = mFreeLists[sizeClass];
+        return freeList.blocks[--freeList.count];
+    }
+
+    bool put(void* block, uint32_t sizeClass) {
+        if (sizeClass >= POOLED_SIZE_CLASSES ||
+                mFreeLists[sizeClass].count == MAX_POOLED_BLOCKS) {
+            return false;
+        }
+        FreeList& freeList = mFreeLists[sizeClass];
+        freeList.blocks[freeList.count++] = block;
+        return true;
+    }
+
+private:
+    struct FreeList {
+        void* blocks[MAX_POOLED_BLOCKS];
+        size_t count;
+    };
+    FreeList mFreeLists[POOLED_SIZE_CLASSES] = {};
+};
+
+thread_local BlockPool sBlockPool;
+
+} // namespace
+
+// ----------------------------------------------------------------------------
+
+struct RegionStorage::Block {
+    explicit Block(uint32_t sizeClass) : refs(1), sizeClass(sizeClass) {}
+
+    static Block* create(size_t minCapacity) {
+        uint32_t sizeClass = 0;
+        while (blockCapacity(sizeClass) < minCapacity) {
+            sizeClass++;
+        }
+        void* memory = sBlockPool.get(sizeClass);
+        if (memory == nullptr) {
+            memory = malloc(sizeof(Block) + blockCapacity(sizeClass) * sizeof(Rect));
+            LOG_ALWAYS_FATAL_IF(memory == nullptr,
+                    "failed to allocate storage for %zu rects", minCapacity);
+        }
+        return new (memory) Block(sizeClass);
+    }
+
+    void decRef() {
+        if (refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            const uint32_t blockSizeClass = sizeClass;
+            this->~Block();
+            if (!sBlockPool.put(this, blockSizeClass)) {
+                free(this);
+            }
+        }
+    }
+
+    bool isShared() const { return refs.load(std::memory_order_acquire) > 1; }
+    size_t capacity() const { return blockCapacity(sizeClass); }
+    Rect* rects() { return reinterpret_cast<Rect*>(this + 1); }
+
+    std::atomic<int32_t> refs;
+    const uint32_t sizeClass;
+};
+
+// ----------------------------------------------------------------------------
+
+RegionStorage::RegionStorage()
+    : mArray(mInline), mSize(0), mCapacity(INLINE_CAPACITY), mBlock(nullptr)
+{
+}
+
+RegionStorage::RegionStorage(const RegionStorage& rhs)
+    : mArray(mInline), mSize(0), mCapacity(INLINE_CAPACITY), mBlock(nullptr)
+{
+    adopt(rhs);
+}
+
+RegionStorage::~RegionStorage()
+{
+    release();
+}
+
+RegionStorage& RegionStorage::operator = (const RegionStorage& rhs)
+{
+    if (this != &rhs) {
+        release();
+        adopt(rhs);
+    }
+    return *this;
+}
+
+Rect* RegionStorage::editArray()
+{
+    makeRoomFor(0);
+    return mArray;
+}
+
+void RegionStorage::clear()
+{
+    if (mBlock && mBlock->isShared()) {
+        release();
+    } else {
+        mSize = 0;
+    }
+}
+
+void RegionStorage::add(const Rect& rect)
+{
+    // rect may live in this storage, which makeRoomFor can move
+    const Rect copy(rect);
+    new (makeRoomFor(1)) Rect(copy);
+    mSize++;
+}
+
+void RegionStorage::insertAt(const Rect& rect, size_t index)
+{
+    if (index >= mSize) {
+        add(rect);
+        return;
+    }
+    const Rect copy(rect);
+    Rect* const end = makeRoomFor(1);
+    new (end) Rect(mArray[mSize - 1]);
+    std::copy_backward(mArray + index, mArray + mSize - 1, end);
+    mArray[index] = copy;
+    mSize++;
+}
+
+void RegionStorage::appendVector(const RegionStorage& rhs)
+{
+    if (rhs.isEmpty()) {
+        return;
+    }
+    if (&rhs == this) {
+        const RegionStorage copy(rhs);
+        appendVector(copy);
+        return;
+    }
+    std::uninitialized_copy(rhs.begin(), rhs.end(), makeRoomFor(rhs.mSize));
+    mSize += rhs.mSize;
+}
+
+bool RegionStorage::isTriviallyEqual(const RegionStorage& rhs) const
+{
+    if (mSize != rhs.mSize) {
+        return false;
+    }
+    if (mBlock || rhs.mBlock) {
+        return mBlock == rhs.mBlock;
+    }
+    return std::equal(begin(), end(), rhs.begin());
+}
+
+// Makes sure the array is not shared with another RegionStorage and has room
+// for count more Rects, and returns where the first of them goes.
+Rect* RegionStorage::makeRoomFor(size_t count)
+{
+    const size_t needed = mSize + count;
+    const bool shared = mBlock && mBlock->isShared();
+    if (needed <= mCapacity && !shared) {
+        return mArray + mSize;
+    }
+
+    const size_t size = mSize;
+    if (shared && needed <= INLINE_CAPACITY) {
+        std::uninitialized_copy(mArray, mArray + size, mInline);
+        mBlock->decRef();
+        mBlock = nullptr;
+        mArray = mInline;
+        mCapacity = INLINE_CAPACITY;
+        return mArray + size;
+    }
+
+    Block* block = Block::create(std::max(needed, shared ? needed : mCapacity * 2));
+    std::uninitialized_copy(mArray, mArray + size, block->rects());
+    if (mBlock) {
+        mBlock->decRef();
+    }
+    mBlock = block;
+    mArray = block->rects();
+    mCapacity = block->capacity();
+    return mArray + size;
+}
+
+void RegionStorage::adopt(const RegionStorage& rhs)
+{
+    if (rhs.mBlock) {
+        rhs.mBlock->refs.fetch_add(1, std::memory_order_relaxed);
+        mBlock = rhs.mBlock;
+        mArray = rhs.mArray;
+        mCapacity = rhs.mCapacity;
+    } else {
+        std::uninitialized_copy(rhs.begin(), rhs.end(), mInline);
+    }
+    mSize = rhs.mSize;
+}
+
+void RegionStorage::release()
+{
+    if (mBlock) {
+        mBlock->decRef();
+        mBlock = nullptr;
+    }
+    mArray = mInline;
+    mSize = 0;
+    mCapacity = INLINE_CAPACITY;
+}
+
+// ----------------------------------------------------------------------------
+}; // namespace android
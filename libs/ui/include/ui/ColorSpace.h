@@ -294,10 +294,27 @@ public:
         return apply(mTransform * linear, mDestination.getClamper());
     }
 
+    /**
+     * Applies transform() to count values read from src and written
+     * to dst, which may be the same array. When both color spaces
+     * clamp to a small range, the transfer functions are evaluated
+     * through lookup tables built with the connector and the matrix
+     * is applied with NEON or SSE, which is much faster than calling
+     * transform() per value and matches it to within 1e-4.
+     */
+    void transform(const float3* src, float3* dst, size_t count) const noexcept;
+
 private:
+    struct TransferLUT;
+
     ColorSpace mSource;
     ColorSpace mDestination;
     mat3 mTransform;
+
+    // Tabulated source EOTF and destination OETF, null when the color
+    // spaces' ranges do not allow tabulating them
+    std::shared_ptr<const TransferLUT> mSourceEOTF;
+    std::shared_ptr<const TransferLUT> mDestinationOETF;
 };
 
 }; // namespace android
@@ -19,6 +19,8 @@
 
 #include <stdint.h>
 
+#include <vector>
+
 #include <android-base/unique_fd.h>
 #include <utils/Flattenable.h>
 #include <utils/RefBase.h>
@@ -94,6 +96,13 @@ public:
     static sp<Fence> merge(const String8& name, const sp<Fence>& f1,
             const sp<Fence>& f2);
 
+    // mergeAll combines any number of Fence objects into one that becomes
+    // signaled when all of them are. Invalid and already signaled fences are
+    // left out, so no new fence file descriptor is created when at most one
+    // fence is still pending: NO_FENCE or that fence is returned instead.
+    // The rest are merged pairwise, as sync_merge only takes two fences.
+    static sp<Fence> mergeAll(const char* name, const std::vector<sp<Fence>>& fences);
+
     // Return a duplicate of the fence file descriptor. The caller is
     // responsible for closing the returned file descriptor. On error, -1 will
     // be returned and errno will indicate the problem.
@@ -153,16 +153,25 @@ private:
 // if FenceTimeline did nothing. i.e. they should eventually call
 // Fence::getSignalTime(), not only Fence::getCachedSignalTime().
 //
+// Fences that come from the same sync timeline, e.g. the release fences of all
+// layers on a display, are best pushed to one shared FenceTimeline so that only
+// the oldest pending fence of the whole group is polled.  Such a timeline
+// should be created with room for more than MAX_ENTRIES.
+//
 // push() and updateSignalTimes() are safe to call simultaneously from
 // different threads.
 class FenceTimeline {
 public:
     static constexpr size_t MAX_ENTRIES = 64;
 
+    FenceTimeline() = default;
+    explicit FenceTimeline(size_t maxEntries) : mMaxEntries(maxEntries) {}
+
     void push(const std::shared_ptr<FenceTime>& fence);
     void updateSignalTimes();
 
 private:
+    const size_t mMaxEntries{MAX_ENTRIES};
     mutable std::mutex mMutex;
     std::queue<std::weak_ptr<FenceTime>> mQueue;
 };
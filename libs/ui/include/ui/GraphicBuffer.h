@@ -180,6 +180,16 @@ public:
             android_ycbcr *ycbcr, int fenceFd);
     status_t unlockAsync(int *fenceFd);
 
+    // Keeps the buffer mapped from its first lock until persistent mapping
+    // is disabled or the buffer is freed. Later lock calls only wait for
+    // their fence and return the same address, and unlock calls leave the
+    // mapping in place, so gralloc's per-lock work, including its cache
+    // maintenance, is skipped. This suits buffers only touched by the CPU or
+    // backed by CPU-coherent memory, and requires a USAGE_SW_*_OFTEN usage.
+    // YCbCr locks drop the persistent mapping before mapping the buffer.
+    status_t setPersistentMapping(bool enabled);
+    bool isPersistentlyMapped() const   { return mPersistentVaddr != nullptr; }
+
     ANativeWindowBuffer* getNativeBuffer() const;
 
     // for debugging
@@ -233,6 +243,17 @@ private:
 
     void free_handle();
 
+    // The import of a buffer unflattened by more than one GraphicBuffer of
+    // this process, see unflatten(). Frees the handle once the last of them
+    // lets go of it.
+    struct SharedImport;
+    status_t importShared(const native_handle_t* rawHandle);
+
+    // Returns the persistent mapping, making it on the first call.
+    status_t lockPersistent(void** vaddr, int fenceFd);
+    void unmapPersistent();
+    bool canLockPersistent(uint64_t inUsage) const;
+
     GraphicBufferMapper& mBufferMapper;
     ssize_t mInitCheck;
 
@@ -242,6 +263,14 @@ private:
 
     uint64_t mId;
 
+    // Set when handle belongs to a SharedImport rather than to this buffer.
+    sp<SharedImport> mSharedImport;
+
+    // Set by setPersistentMapping(); mPersistentVaddr is the address the
+    // buffer is persistently mapped at, or null while it is not mapped.
+    bool mPersistentMapping;
+    void* mPersistentVaddr;
+
     // Stores the generation number of this buffer. If this number does not
     // match the BufferQueue's internal generation number (set through
     // IGBP::setGenerationNumber), attempts to attach the buffer will fail.
@@ -20,17 +20,20 @@
 
 #include <stdint.h>
 
+#include <deque>
 #include <memory>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 #include <cutils/native_handle.h>
 
 #include <ui/PixelFormat.h>
 
 #include <utils/Errors.h>
-#include <utils/KeyedVector.h>
 #include <utils/Mutex.h>
 #include <utils/Singleton.h>
+#include <utils/Timers.h>
 
 namespace android {
 
@@ -53,6 +56,13 @@ public:
 
     status_t free(buffer_handle_t handle);
 
+    // Keeps buffers passed to free() around for up to maxAge, and up to
+    // maxBytes in total, so that a later allocate() with the same parameters
+    // and requestor name reuses one instead of calling into the allocator HAL.
+    // A recycled buffer keeps its previous contents. maxBytes of 0, the
+    // default, disables recycling and releases the buffers still held.
+    void setRecyclePool(size_t maxBytes, nsecs_t maxAge);
+
     void dump(String8& res) const;
     static void dumpToSystemLog();
 
@@ -68,15 +78,51 @@ private:
         std::string requestorName;
     };
 
-    static Mutex sLock;
-    static KeyedVector<buffer_handle_t, alloc_rec_t> sAllocList;
+    // Live allocations are spread over a few independently locked shards,
+    // picked from the handle, so that concurrent allocate() and free() calls
+    // rarely contend and each update is a single hash table operation.
+    struct alloc_shard_t {
+        Mutex lock;
+        std::unordered_map<buffer_handle_t, alloc_rec_t> records;
+    };
+
+    static constexpr size_t ALLOC_SHARD_COUNT = 8;
+    static alloc_shard_t sAllocShards[ALLOC_SHARD_COUNT];
+
+    static alloc_shard_t& shardFor(buffer_handle_t handle);
+
+    struct recycled_buffer_t {
+        buffer_handle_t handle;
+        alloc_rec_t rec;
+        nsecs_t releaseTime;
+    };
 
     friend class Singleton<GraphicBufferAllocator>;
     GraphicBufferAllocator();
     ~GraphicBufferAllocator();
 
+    // Removes a pooled buffer matching the request from the recycle pool.
+    bool takeRecycledBuffer(uint32_t width, uint32_t height, PixelFormat format,
+            uint32_t layerCount, uint64_t usage, const std::string& requestorName,
+            buffer_handle_t* handle, uint32_t* stride);
+
+    // Moves a buffer being freed into the recycle pool, if it may go there.
+    bool recycleBuffer(buffer_handle_t handle, alloc_rec_t& rec);
+
+    // Drops pooled buffers that are too old or exceed the size limit into
+    // expired, so they can be freed once mRecycleLock is released.
+    void trimRecyclePoolLocked(nsecs_t now, std::vector<buffer_handle_t>& expired);
+
     GraphicBufferMapper& mMapper;
     const std::unique_ptr<const Gralloc2::Allocator> mAllocator;
+
+    mutable Mutex mRecycleLock;
+    std::deque<recycled_buffer_t> mRecycledBuffers; // oldest first
+    size_t mRecycledBytes = 0;
+    size_t mRecycleMaxBytes = 0;
+    nsecs_t mRecycleMaxAge = 0;
+    uint64_t mRecycleHits = 0;
+    uint64_t mRecycleMisses = 0;
 };
 
 // ---------------------------------------------------------------------------
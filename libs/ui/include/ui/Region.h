@@ -23,6 +23,7 @@
 #include <utils/Vector.h>
 
 #include <ui/Rect.h>
+#include <ui/RegionStorage.h>
 #include <utils/Flattenable.h>
 
 namespace android {
@@ -113,7 +114,8 @@ public:
     inline  Region&     operator += (const Point& pt);
 
 
-    // returns true if the regions share the same underlying storage
+    // returns true if the regions are cheaply known to be equal: they share
+    // the same underlying storage, or both are small and hold the same rects
     bool isTriviallyEqual(const Region& region) const;
 
 
@@ -174,7 +176,8 @@ private:
     // with an extra Rect as the last element which is set to the
     // bounds of the region. However, if the region is
     // a simple Rect then mStorage contains only that rect.
-    Vector<Rect> mStorage;
+    // Small regions are stored inline, see RegionStorage.
+    RegionStorage mStorage;
 };
 
 
@@ -0,0 +1,89 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_UI_REGION_STORAGE_H
+#define ANDROID_UI_REGION_STORAGE_H
+
+#include <stddef.h>
+
+#include <ui/Rect.h>
+
+namespace android {
+// ---------------------------------------------------------------------------
+
+/*
+ * The array of Rects backing a Region.
+ *
+ * Up to INLINE_CAPACITY Rects are kept inside the object itself, which covers
+ * plain rectangles and most small regions without touching the heap. Larger
+ * arrays live in reference counted blocks that copies share until one of them
+ * is modified, like Vector's copy-on-write storage. Blocks are recycled
+ * through a small per-thread pool instead of being returned to malloc.
+ */
+class RegionStorage
+{
+public:
+    static constexpr size_t INLINE_CAPACITY = 4;
+
+                        RegionStorage();
+                        RegionStorage(const RegionStorage& rhs);
+                        ~RegionStorage();
+
+    RegionStorage&      operator = (const RegionStorage& rhs);
+
+    inline  size_t      size() const        { return mSize; }
+    inline  bool        isEmpty() const     { return mSize == 0; }
+
+    inline  const Rect* array() const       { return mArray; }
+            Rect*       editArray();
+
+    inline  const Rect& operator [] (size_t index) const { return mArray[index]; }
+    inline  const Rect& itemAt(size_t index) const       { return mArray[index]; }
+    inline  const Rect& top() const                      { return mArray[mSize - 1]; }
+
+    inline  const Rect* begin() const       { return mArray; }
+    inline  const Rect* end() const         { return mArray + mSize; }
+
+            void        clear();
+            void        add(const Rect& rect);
+    inline  void        push_back(const Rect& rect) { add(rect); }
+            void        insertAt(const Rect& rect, size_t index);
+            void        appendVector(const RegionStorage& rhs);
+
+            // true if both share the same heap block, or both are inline and
+            // hold the same Rects
+            bool        isTriviallyEqual(const RegionStorage& rhs) const;
+
+private:
+    struct Block;
+
+    Rect*   makeRoomFor(size_t count);
+    void    adopt(const RegionStorage& rhs);
+    void    release();
+
+    Rect*   mArray;
+    size_t  mSize;
+    size_t  mCapacity;
+    Block*  mBlock;
+    union {
+        Rect mInline[INLINE_CAPACITY];
+    };
+};
+
+// ---------------------------------------------------------------------------
+}; // namespace android
+
+#endif // ANDROID_UI_REGION_STORAGE_H
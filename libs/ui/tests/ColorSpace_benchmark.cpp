@@ -0,0 +1,73 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <ui/ColorSpace.h>
+
+#include <vector>
+
+namespace android {
+namespace {
+
+// One row of a 1080p screenshot worth of pixels, as a ramp
+std::vector<float3> pixelRow() {
+    std::vector<float3> pixels(1920);
+    for (size_t i = 0; i < pixels.size(); i++) {
+        const float v = float(i) / float(pixels.size() - 1);
+        pixels[i] = {v, 1.0f - v, 0.5f};
+    }
+    return pixels;
+}
+
+void BM_TransformScalar(benchmark::State& state) {
+    const ColorSpaceConnector connector(ColorSpace::DisplayP3(), ColorSpace::sRGB());
+    const std::vector<float3> pixels = pixelRow();
+    std::vector<float3> converted(pixels.size());
+    for (auto _ : state) {
+        for (size_t i = 0; i < pixels.size(); i++) {
+            converted[i] = connector.transform(pixels[i]);
+        }
+        benchmark::DoNotOptimize(converted.data());
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()) * int64_t(pixels.size()));
+}
+BENCHMARK(BM_TransformScalar);
+
+void BM_TransformBatch(benchmark::State& state) {
+    const ColorSpaceConnector connector(ColorSpace::DisplayP3(), ColorSpace::sRGB());
+    const std::vector<float3> pixels = pixelRow();
+    std::vector<float3> converted(pixels.size());
+    for (auto _ : state) {
+        connector.transform(pixels.data(), converted.data(), pixels.size());
+        benchmark::DoNotOptimize(converted.data());
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()) * int64_t(pixels.size()));
+}
+BENCHMARK(BM_TransformBatch);
+
+void BM_CreateLUT(benchmark::State& state) {
+    for (auto _ : state) {
+        auto lut = ColorSpace::createLUT(32, ColorSpace::sRGB(), ColorSpace::DisplayP3());
+        benchmark::DoNotOptimize(lut.get());
+    }
+}
+BENCHMARK(BM_CreateLUT);
+
+} // namespace
+} // namespace android
+
+BENCHMARK_MAIN();
@@ -61,4 +61,39 @@ TEST_F(GraphicBufferTest, DetachedBuffer) {
     EXPECT_FALSE(buffer->isDetachedBuffer());
 }
 
+TEST_F(GraphicBufferTest, PersistentMapping) {
+    sp<GraphicBuffer> buffer(
+            new GraphicBuffer(kTestWidth, kTestHeight, kTestFormat, kTestLayerCount, kTestUsage));
+    ASSERT_EQ(NO_ERROR, buffer->initCheck());
+    ASSERT_EQ(NO_ERROR, buffer->setPersistentMapping(true));
+    EXPECT_FALSE(buffer->isPersistentlyMapped());
+
+    void* first = nullptr;
+    ASSERT_EQ(NO_ERROR, buffer->lock(GraphicBuffer::USAGE_SW_WRITE_OFTEN, &first));
+    ASSERT_NE(nullptr, first);
+    static_cast<uint8_t*>(first)[0] = 0x5a;
+    ASSERT_EQ(NO_ERROR, buffer->unlock());
+    EXPECT_TRUE(buffer->isPersistentlyMapped());
+
+    // Later locks reuse the mapping, and see what was written through it
+    void* second = nullptr;
+    ASSERT_EQ(NO_ERROR, buffer->lock(GraphicBuffer::USAGE_SW_WRITE_OFTEN, &second));
+    EXPECT_EQ(first, second);
+    EXPECT_EQ(0x5a, static_cast<uint8_t*>(second)[0]);
+    int fenceFd = 0;
+    ASSERT_EQ(NO_ERROR, buffer->unlockAsync(&fenceFd));
+    EXPECT_EQ(-1, fenceFd);
+
+    ASSERT_EQ(NO_ERROR, buffer->setPersistentMapping(false));
+    EXPECT_FALSE(buffer->isPersistentlyMapped());
+}
+
+TEST_F(GraphicBufferTest, PersistentMappingNeedsFrequentCpuUsage) {
+    sp<GraphicBuffer> buffer(new GraphicBuffer(kTestWidth, kTestHeight, kTestFormat,
+                                               kTestLayerCount,
+                                               GraphicBuffer::USAGE_SW_WRITE_RARELY));
+    ASSERT_EQ(NO_ERROR, buffer->initCheck());
+    EXPECT_EQ(INVALID_OPERATION, buffer->setPersistentMapping(true));
+}
+
 } // namespace android
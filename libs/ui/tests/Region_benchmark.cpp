@@ -0,0 +1,91 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <ui/Rect.h>
+#include <ui/Region.h>
+
+#include <vector>
+
+namespace android {
+namespace {
+
+// Layer bounds for a typical frame: a full screen app window with status and
+// navigation bars on top, plus a few smaller overlapping layers.
+std::vector<Rect> frameLayers() {
+    return {
+        Rect(0, 0, 1080, 1920),
+        Rect(40, 300, 1040, 900),
+        Rect(600, 1200, 1000, 1500),
+        Rect(0, 0, 1080, 72),
+        Rect(0, 1794, 1080, 1920),
+    };
+}
+
+// Walks the layers top to bottom the way SurfaceFlinger's visible region
+// computation does, creating and discarding temporary regions as it goes.
+void computeVisibleRegions(const std::vector<Rect>& layers, Region* outDirty) {
+    Region aboveOpaqueLayers;
+    Region aboveCoveredLayers;
+    Region dirty;
+    for (auto layer = layers.rbegin(); layer != layers.rend(); ++layer) {
+        Region visibleRegion(*layer);
+        Region coveredRegion = aboveCoveredLayers.intersect(visibleRegion);
+        aboveCoveredLayers.orSelf(visibleRegion);
+        visibleRegion.subtractSelf(aboveOpaqueLayers);
+        const Region newExposed = visibleRegion - coveredRegion;
+        dirty.orSelf(newExposed);
+        aboveOpaqueLayers.orSelf(*layer);
+    }
+    *outDirty = dirty;
+}
+
+void BM_CopySingleRectRegion(benchmark::State& state) {
+    const Region region(Rect(0, 0, 1080, 1920));
+    for (auto _ : state) {
+        Region copy(region);
+        benchmark::DoNotOptimize(copy.begin());
+    }
+}
+BENCHMARK(BM_CopySingleRectRegion);
+
+void BM_OrRects(benchmark::State& state) {
+    const std::vector<Rect> layers = frameLayers();
+    for (auto _ : state) {
+        Region region;
+        for (const Rect& layer : layers) {
+            region.orSelf(layer);
+        }
+        benchmark::DoNotOptimize(region.begin());
+    }
+}
+BENCHMARK(BM_OrRects);
+
+void BM_ComputeVisibleRegions(benchmark::State& state) {
+    const std::vector<Rect> layers = frameLayers();
+    Region dirty;
+    for (auto _ : state) {
+        computeVisibleRegions(layers, &dirty);
+        benchmark::DoNotOptimize(dirty.begin());
+    }
+}
+BENCHMARK(BM_ComputeVisibleRegions);
+
+} // namespace
+} // namespace android
+
+BENCHMARK_MAIN();
@@ -131,6 +131,126 @@ TEST_F(RegionTest, Bigger_TJunction) {
     checkTJunctionFreeFromRegion(r, 16);
 }
 
+TEST_F(RegionTest, SmallRegionCopiesAreIndependent) {
+    Region r(Rect(0, 0, 10, 10));
+    r.orSelf(Rect(20, 0, 30, 10));
+
+    Region copy(r);
+    EXPECT_TRUE(copy.isTriviallyEqual(r));
+
+    copy.orSelf(Rect(0, 20, 10, 30));
+    EXPECT_FALSE(copy.isTriviallyEqual(r));
+    EXPECT_FALSE(r.contains(5, 25));
+    EXPECT_TRUE(copy.contains(5, 25));
+}
+
+TEST_F(RegionTest, LargeRegionCopiesShareStorageUntilModified) {
+    Region r;
+    for (int i = 0; i < 16; i++) {
+        r.orSelf(Rect(i * 2, i * 2, i * 2 + 1, i * 2 + 1));
+    }
+    ASSERT_EQ(16, r.end() - r.begin());
+
+    Region copy(r);
+    EXPECT_TRUE(copy.isTriviallyEqual(r));
+    EXPECT_EQ(r.begin(), copy.begin());
+
+    copy.translateSelf(1, 1);
+    EXPECT_FALSE(copy.isTriviallyEqual(r));
+    EXPECT_NE(r.begin(), copy.begin());
+    EXPECT_TRUE(r.contains(0, 0));
+    EXPECT_FALSE(copy.contains(0, 0));
+    EXPECT_TRUE(copy.contains(1, 1));
+
+    // Going back to a single rect leaves the shared storage alone
+    Region other(r);
+    other.makeBoundsSelf();
+    EXPECT_TRUE(other.isRect());
+    EXPECT_EQ(16, r.end() - r.begin());
+}
+
+TEST_F(RegionTest, MergesSpansWithSameColumns) {
+    // Two rows with matching columns collapse into a single span...
+    Region r;
+    r.orSelf(Rect(0, 0, 2, 1));
+    r.orSelf(Rect(4, 0, 6, 1));
+    r.orSelf(Rect(0, 1, 2, 2));
+    r.orSelf(Rect(4, 1, 6, 2));
+    ASSERT_EQ(2, r.end() - r.begin());
+    EXPECT_EQ(Rect(0, 0, 2, 2), r.begin()[0]);
+    EXPECT_EQ(Rect(4, 0, 6, 2), r.begin()[1]);
+
+    // ...but not when a single edge differs
+    r.orSelf(Rect(0, 2, 2, 3));
+    r.orSelf(Rect(4, 2, 7, 3));
+    ASSERT_EQ(4, r.end() - r.begin());
+    EXPECT_EQ(Rect(4, 2, 7, 3), r.begin()[3]);
+}
+
+TEST_F(RegionTest, TranslateOffsetsEveryRect) {
+    Region r;
+    for (int i = 0; i < 7; i++) {
+        r.orSelf(Rect(i * 3, i * 2, i * 3 + 2, i * 2 + 1));
+    }
+    const Region translated = r.translate(-5, 9);
+    ASSERT_EQ(r.end() - r.begin(), translated.end() - translated.begin());
+    for (const Rect *p = r.begin(), *q = translated.begin(); p != r.end(); p++, q++) {
+        EXPECT_EQ(Rect(p->left - 5, p->top + 9, p->right - 5, p->bottom + 9), *q);
+    }
+    EXPECT_EQ(r.getBounds().offsetBy(-5, 9), translated.getBounds());
+}
+
+TEST_F(RegionTest, RectOperationsStayRects) {
+    const Region r(Rect(0, 0, 10, 10));
+    EXPECT_EQ(Rect(5, 5, 10, 10), r.intersect(Rect(5, 5, 20, 20)).getBounds());
+    EXPECT_TRUE(r.intersect(Rect(5, 5, 20, 20)).isRect());
+    EXPECT_TRUE(r.intersect(Rect(10, 0, 20, 10)).isEmpty());
+
+    EXPECT_TRUE(r.merge(Rect(0, 5, 10, 20)).isRect());
+    EXPECT_EQ(Rect(0, 0, 10, 20), r.merge(Rect(0, 5, 10, 20)).getBounds());
+    EXPECT_EQ(Rect(0, 0, 10, 10), r.merge(Rect(2, 2, 4, 4)).getBounds());
+    EXPECT_EQ(Rect(-1, -1, 11, 11), r.merge(Rect(-1, -1, 11, 11)).getBounds());
+
+    EXPECT_TRUE(r.subtract(Rect(0, 0, 20, 20)).isEmpty());
+    EXPECT_EQ(Rect(0, 4, 10, 10), r.subtract(Rect(-5, -5, 15, 4)).getBounds());
+    EXPECT_TRUE(r.subtract(Rect(-5, -5, 15, 4)).isRect());
+    EXPECT_EQ(Rect(0, 0, 6, 10), r.subtract(Rect(6, -5, 15, 15)).getBounds());
+    EXPECT_EQ(Rect(0, 0, 10, 10), r.subtract(Rect(20, 20, 30, 30)).getBounds());
+}
+
+TEST_F(RegionTest, FastPathsMatchPixelCoverage) {
+    srandom(4321);
+    const auto randomRect = []() {
+        const int l = static_cast<int>(random() % 8);
+        const int t = static_cast<int>(random() % 8);
+        return Rect(l, t, l + static_cast<int>(random() % 5), t + static_cast<int>(random() % 5));
+    };
+
+    for (int iter = 0; iter < 500; iter++) {
+        Region lhs;
+        const int lhsRects = static_cast<int>(random() % 3);
+        for (int i = 0; i < lhsRects; i++) {
+            lhs.orSelf(randomRect());
+        }
+        const Rect rhs = randomRect();
+
+        const Region merged = lhs.merge(rhs);
+        const Region intersected = lhs.intersect(rhs);
+        const Region subtracted = lhs.subtract(rhs);
+        const Region exclusive = lhs.mergeExclusive(rhs);
+        for (int y = -1; y < 13; y++) {
+            for (int x = -1; x < 13; x++) {
+                const bool inLhs = lhs.contains(x, y);
+                const bool inRhs = x >= rhs.left && x < rhs.right && y >= rhs.top && y < rhs.bottom;
+                ASSERT_EQ(inLhs || inRhs, merged.contains(x, y));
+                ASSERT_EQ(inLhs && inRhs, intersected.contains(x, y));
+                ASSERT_EQ(inLhs && !inRhs, subtracted.contains(x, y));
+                ASSERT_EQ(inLhs != inRhs, exclusive.contains(x, y));
+            }
+        }
+    }
+}
+
 #define ITER_MAX 1000
 #define X_MAX 8
 #define Y_MAX 8
@@ -21,6 +21,8 @@
 
 #include <ui/ColorSpace.h>
 
+#include <vector>
+
 #include <gtest/gtest.h>
 
 namespace android {
@@ -180,4 +182,31 @@ TEST_F(ColorSpaceTest, LUT) {
 
 }
 
+TEST_F(ColorSpaceTest, BatchTransform) {
+    const ColorSpace spaces[] = {
+        ColorSpace::sRGB(), ColorSpace::extendedSRGB(), ColorSpace::linearExtendedSRGB(),
+        ColorSpace::AdobeRGB(), ColorSpace::DisplayP3(), ColorSpace::ProPhotoRGB(),
+        ColorSpace::BT2020(), ColorSpace::ACES(),
+    };
+
+    // include values outside of [0, 1] to exercise the clamping
+    std::vector<float3> values;
+    for (int i = -4; i <= 20; i++) {
+        const float v = i / 16.0f;
+        values.push_back({v, 1.0f - v, v * v});
+    }
+
+    for (const ColorSpace& src : spaces) {
+        for (const ColorSpace& dst : spaces) {
+            ColorSpaceConnector connector(src, dst);
+            std::vector<float3> converted(values.size());
+            connector.transform(values.data(), converted.data(), values.size());
+            for (size_t i = 0; i < values.size(); i++) {
+                EXPECT_TRUE(all(lessThan(abs(converted[i] - connector.transform(values[i])),
+                        float3{1e-4f}))) << src.getName() << " -> " << dst.getName();
+            }
+        }
+    }
+}
+
 }; // namespace android
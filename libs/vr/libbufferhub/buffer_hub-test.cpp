@@ -333,6 +333,114 @@ TEST_F(LibBufferHubTest, TestAsyncStateTransitions) {
   EXPECT_FALSE(invalid_fence.IsValid());
 }
 
+TEST_F(LibBufferHubTest, TestDirectStateTransitions) {
+  std::unique_ptr<BufferProducer> p = BufferProducer::Create(
+      kWidth, kHeight, kFormat, kUsage, sizeof(uint64_t));
+  ASSERT_TRUE(p.get() != nullptr);
+  std::unique_ptr<BufferConsumer> c1 =
+      BufferConsumer::Import(p->CreateConsumer());
+  ASSERT_TRUE(c1.get() != nullptr);
+  std::unique_ptr<BufferConsumer> c2 =
+      BufferConsumer::Import(p->CreateConsumer());
+  ASSERT_TRUE(c2.get() != nullptr);
+
+  DvrNativeBufferMetadata metadata;
+  LocalHandle invalid_fence;
+
+  // Nothing to wait for until the buffer is posted.
+  EXPECT_EQ(-ETIMEDOUT, c1->WaitForPost(0));
+  EXPECT_EQ(0, p->WaitForRelease(0));
+  EXPECT_EQ(-EBUSY, c1->AcquireDirect(&metadata, &invalid_fence));
+
+  EXPECT_EQ(0, p->PostDirect(&metadata, invalid_fence));
+  EXPECT_TRUE(IsBufferPosted(p->buffer_state()));
+  EXPECT_EQ(-EBUSY, p->PostDirect(&metadata, invalid_fence));
+
+  // bufferhubd is not told, so the consumers are not signalled.
+  EXPECT_EQ(0, RETRY_EINTR(c1->Poll(0)));
+  EXPECT_EQ(0, c1->WaitForPost(kPollTimeoutMs));
+  EXPECT_EQ(0, c2->WaitForPost(kPollTimeoutMs));
+  EXPECT_EQ(0, c1->AcquireDirect(&metadata, &invalid_fence));
+  EXPECT_EQ(0, c2->AcquireDirect(&metadata, &invalid_fence));
+  EXPECT_TRUE(IsBufferAcquired(p->buffer_state()));
+  EXPECT_EQ(-ETIMEDOUT, c1->WaitForPost(0));
+
+  // The buffer is released once both consumers are done.
+  EXPECT_EQ(0, c1->ReleaseDirect(&metadata, invalid_fence));
+  EXPECT_EQ(-ETIMEDOUT, p->WaitForRelease(0));
+  EXPECT_EQ(-EBUSY, p->GainDirect(&metadata, &invalid_fence));
+  EXPECT_EQ(0, c2->ReleaseDirect(&metadata, invalid_fence));
+  EXPECT_EQ(0, p->WaitForRelease(kPollTimeoutMs));
+  EXPECT_TRUE(IsBufferReleased(p->buffer_state()));
+
+  EXPECT_EQ(0, p->GainDirect(&metadata, &invalid_fence));
+  EXPECT_FALSE(invalid_fence.IsValid());
+  EXPECT_TRUE(IsBufferGained(p->buffer_state()));
+}
+
+TEST_F(LibBufferHubTest, TestDirectConsumerChanges) {
+  std::unique_ptr<BufferProducer> p = BufferProducer::Create(
+      kWidth, kHeight, kFormat, kUsage, sizeof(uint64_t));
+  ASSERT_TRUE(p.get() != nullptr);
+  std::unique_ptr<BufferConsumer> c1 =
+      BufferConsumer::Import(p->CreateConsumer());
+  ASSERT_TRUE(c1.get() != nullptr);
+  std::unique_ptr<BufferConsumer> c2 =
+      BufferConsumer::Import(p->CreateConsumer());
+  ASSERT_TRUE(c2.get() != nullptr);
+  ASSERT_EQ(0, c2->SetIgnore(true));
+
+  DvrNativeBufferMetadata metadata;
+  LocalHandle invalid_fence;
+
+  // Ignored consumers are not waited for.
+  EXPECT_EQ(0, p->PostDirect(&metadata, invalid_fence));
+  EXPECT_EQ(-EBUSY, c2->AcquireDirect(&metadata, &invalid_fence));
+  EXPECT_EQ(0, c1->AcquireDirect(&metadata, &invalid_fence));
+
+  // Consumers joining a posted buffer are waited for.
+  std::unique_ptr<BufferConsumer> c3 =
+      BufferConsumer::Import(p->CreateConsumer());
+  ASSERT_TRUE(c3.get() != nullptr);
+  EXPECT_EQ(0, c1->ReleaseDirect(&metadata, invalid_fence));
+  EXPECT_EQ(-ETIMEDOUT, p->WaitForRelease(0));
+  EXPECT_EQ(0, c3->WaitForPost(kPollTimeoutMs));
+
+  // Consumers going away release the buffer.
+  c3 = nullptr;
+  EXPECT_EQ(0, p->WaitForRelease(kPollTimeoutMs));
+  EXPECT_EQ(0, p->GainDirect(&metadata, &invalid_fence));
+}
+
+TEST_F(LibBufferHubTest, TestDirectWaitAcrossThreads) {
+  std::unique_ptr<BufferProducer> p = BufferProducer::Create(
+      kWidth, kHeight, kFormat, kUsage, sizeof(uint64_t));
+  ASSERT_TRUE(p.get() != nullptr);
+  std::unique_ptr<BufferConsumer> c =
+      BufferConsumer::Import(p->CreateConsumer());
+  ASSERT_TRUE(c.get() != nullptr);
+
+  const int kCycles = 100;
+  std::thread consumer_thread([&c] {
+    DvrNativeBufferMetadata metadata;
+    LocalHandle fence;
+    for (int i = 0; i < kCycles; ++i) {
+      ASSERT_EQ(0, c->WaitForPost(-1));
+      ASSERT_EQ(0, c->AcquireDirect(&metadata, &fence));
+      ASSERT_EQ(0, c->ReleaseDirect(&metadata, LocalHandle()));
+    }
+  });
+
+  DvrNativeBufferMetadata metadata;
+  LocalHandle fence;
+  for (int i = 0; i < kCycles; ++i) {
+    ASSERT_EQ(0, p->PostDirect(&metadata, LocalHandle()));
+    ASSERT_EQ(0, p->WaitForRelease(-1));
+    ASSERT_EQ(0, p->GainDirect(&metadata, &fence));
+  }
+  consumer_thread.join();
+}
+
 TEST_F(LibBufferHubTest, TestZeroConsumer) {
   std::unique_ptr<BufferProducer> p = BufferProducer::Create(
       kWidth, kHeight, kFormat, kUsage, sizeof(uint64_t));
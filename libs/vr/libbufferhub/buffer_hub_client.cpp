@@ -3,6 +3,7 @@
 #include <log/log.h>
 #include <poll.h>
 #include <sys/epoll.h>
+#include <time.h>
 #include <utils/Trace.h>
 
 #include <mutex>
@@ -21,6 +22,23 @@ using android::pdx::default_transport::ClientChannelFactory;
 namespace android {
 namespace dvr {
 
+namespace {
+
+constexpr int64_t kNanosPerSecond = 1000000000LL;
+
+int64_t GetMonotonicNs() {
+  timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * kNanosPerSecond + now.tv_nsec;
+}
+
+// Turns a poll() style timeout into a deadline, -1 meaning no deadline.
+int64_t GetDeadlineNs(int timeout_ms) {
+  return timeout_ms < 0 ? -1 : GetMonotonicNs() + timeout_ms * 1000000LL;
+}
+
+}  // anonymous namespace
+
 BufferHubClient::BufferHubClient()
     : Client(ClientChannelFactory::Create(BufferHubRPC::kClientPath)) {}
 
@@ -215,6 +233,24 @@ int BufferHubBuffer::Poll(int timeout_ms) {
   return poll(&p, 1, timeout_ms);
 }
 
+int BufferHubBuffer::WaitForStateChange(uint64_t state, int64_t deadline_ns) {
+  timespec timeout;
+  if (deadline_ns >= 0) {
+    const int64_t left_ns = deadline_ns - GetMonotonicNs();
+    if (left_ns <= 0)
+      return -ETIMEDOUT;
+    timeout.tv_sec = left_ns / kNanosPerSecond;
+    timeout.tv_nsec = left_ns % kNanosPerSecond;
+  }
+
+  const int error = BufferHubDefs::WaitBufferState(
+      buffer_state_, state, deadline_ns >= 0 ? &timeout : nullptr);
+  // Callers look at the state again either way.
+  if (error == -EAGAIN || error == -EINTR)
+    return 0;
+  return error;
+}
+
 int BufferHubBuffer::Lock(int usage, int x, int y, int width, int height,
                           void** address) {
   return buffer_.Lock(usage, x, y, width, height, address);
@@ -407,6 +443,51 @@ int BufferConsumer::ReleaseAsync(const DvrNativeBufferMetadata* meta,
       SendImpulse(BufferHubRPC::ConsumerRelease::Opcode));
 }
 
+int BufferConsumer::AcquireDirect(DvrNativeBufferMetadata* out_meta,
+                                  LocalHandle* out_fence) {
+  ATRACE_NAME("BufferConsumer::AcquireDirect");
+
+  // Consumers that joined after the post are not waited for, so they must not
+  // touch the buffer this cycle.
+  const uint64_t pending_state =
+      metadata_header_->pending_consumer_state.load();
+  if (!(pending_state & buffer_state_bit())) {
+    ALOGE("BufferConsumer::AcquireDirect: not pending, id=%d pending=%" PRIx64
+          " buffer_state_bit=%" PRIx64 ".",
+          id(), pending_state, buffer_state_bit());
+    return -EBUSY;
+  }
+
+  return LocalAcquire(out_meta, out_fence);
+}
+
+int BufferConsumer::ReleaseDirect(const DvrNativeBufferMetadata* meta,
+                                  const LocalHandle& release_fence) {
+  ATRACE_NAME("BufferConsumer::ReleaseDirect");
+
+  if (const int error = LocalRelease(meta, release_fence))
+    return error;
+
+  // Without bufferhubd, the last consumer to release flips the producer bit.
+  BufferHubDefs::ReleasePendingConsumers(metadata_header_, buffer_state_bit());
+  return 0;
+}
+
+int BufferConsumer::WaitForPost(int timeout_ms) {
+  ATRACE_NAME("BufferConsumer::WaitForPost");
+  const int64_t deadline_ns = GetDeadlineNs(timeout_ms);
+  for (;;) {
+    const uint64_t buffer_state = buffer_state_->load();
+    if (BufferHubDefs::IsBufferPosted(buffer_state, buffer_state_bit()) &&
+        (metadata_header_->pending_consumer_state.load() &
+         buffer_state_bit())) {
+      return 0;
+    }
+    if (const int error = WaitForStateChange(buffer_state, deadline_ns))
+      return error;
+  }
+}
+
 int BufferConsumer::Discard() { return Release(LocalHandle()); }
 
 int BufferConsumer::SetIgnore(bool ignore) {
@@ -540,6 +621,21 @@ int BufferProducer::PostAsync(const DvrNativeBufferMetadata* meta,
   return ReturnStatusOrError(SendImpulse(BufferHubRPC::ProducerPost::Opcode));
 }
 
+int BufferProducer::PostDirect(const DvrNativeBufferMetadata* meta,
+                               const LocalHandle& ready_fence) {
+  ATRACE_NAME("BufferProducer::PostDirect");
+
+  if (const int error = LocalPost(meta, ready_fence))
+    return error;
+
+  // Consumers can't acquire until they find themselves pending, so they never
+  // release before the set of consumers to wait for is in place.
+  metadata_header_->pending_consumer_state.store(
+      metadata_header_->active_consumer_state.load());
+  BufferHubDefs::WakeBufferState(buffer_state_);
+  return 0;
+}
+
 int BufferProducer::LocalGain(DvrNativeBufferMetadata* out_meta,
                               LocalHandle* out_fence) {
   uint64_t buffer_state = buffer_state_->load();
@@ -610,6 +706,24 @@ int BufferProducer::GainAsync(DvrNativeBufferMetadata* out_meta,
   return ReturnStatusOrError(SendImpulse(BufferHubRPC::ProducerGain::Opcode));
 }
 
+int BufferProducer::GainDirect(DvrNativeBufferMetadata* out_meta,
+                               LocalHandle* release_fence) {
+  ATRACE_NAME("BufferProducer::GainDirect");
+  return LocalGain(out_meta, release_fence);
+}
+
+int BufferProducer::WaitForRelease(int timeout_ms) {
+  ATRACE_NAME("BufferProducer::WaitForRelease");
+  const int64_t deadline_ns = GetDeadlineNs(timeout_ms);
+  for (;;) {
+    const uint64_t buffer_state = buffer_state_->load();
+    if (!(buffer_state & BufferHubDefs::kProducerStateBit))
+      return 0;
+    if (const int error = WaitForStateChange(buffer_state, deadline_ns))
+      return error;
+  }
+}
+
 int BufferProducer::GainAsync() {
   DvrNativeBufferMetadata meta;
   LocalHandle fence;
@@ -147,6 +147,11 @@ class BufferHubBuffer : public pdx::Client {
   int UpdateSharedFence(const LocalHandle& new_fence,
                         const LocalHandle& shared_fence);
 
+  // Blocks until the producer bit of the buffer state may have moved on from
+  // |state|, or until |deadline_ns| on CLOCK_MONOTONIC passes (-1 for no
+  // deadline). Returns zero, -ETIMEDOUT or another negative errno code.
+  int WaitForStateChange(uint64_t state, int64_t deadline_ns);
+
   // IonBuffer that is shared between bufferhubd, producer, and consumers.
   size_t metadata_buf_size_{0};
   size_t user_metadata_size_{0};
@@ -232,6 +237,20 @@ class BufferProducer : public pdx::ClientBase<BufferProducer, BufferHubBuffer> {
   // succeeded, or a negative errno code if local error check fails.
   int GainAsync(DvrNativeBufferMetadata* out_meta, LocalHandle* out_fence);
 
+  // Posts and gains the buffer through the shared buffer state alone, without
+  // telling bufferhubd. Consumers learn about the post through WaitForPost()
+  // rather than their event fd, and the last of them to call ReleaseDirect()
+  // hands the buffer back. Every client of a buffer cycled this way has to use
+  // the direct methods. Return zero or a negative errno code.
+  int PostDirect(const DvrNativeBufferMetadata* meta,
+                 const LocalHandle& ready_fence);
+  int GainDirect(DvrNativeBufferMetadata* out_meta, LocalHandle* out_fence);
+
+  // Blocks until the consumers have released a buffer posted with
+  // PostDirect(), or for |timeout_ms| milliseconds (-1 for infinity). Returns
+  // zero, -ETIMEDOUT or another negative errno code.
+  int WaitForRelease(int timeout_ms);
+
   // Detaches a ProducerBuffer from an existing producer/consumer set. Can only
   // be called when a producer buffer has exclusive access to the buffer (i.e.
   // in the gain'ed state). On the successful return of the IPC call, a new
@@ -304,6 +323,20 @@ class BufferConsumer : public pdx::ClientBase<BufferConsumer, BufferHubBuffer> {
   // Asynchronously acquires a bufer.
   int AcquireAsync(DvrNativeBufferMetadata* out_meta, LocalHandle* out_fence);
 
+  // Acquires and releases a buffer posted with BufferProducer::PostDirect()
+  // without telling bufferhubd. Acquiring fails for consumers created after
+  // the post, which wait for the next one instead. Return zero or a negative
+  // errno code.
+  int AcquireDirect(DvrNativeBufferMetadata* out_meta, LocalHandle* out_fence);
+  int ReleaseDirect(const DvrNativeBufferMetadata* meta,
+                    const LocalHandle& release_fence);
+
+  // Blocks until a buffer posted with BufferProducer::PostDirect() can be
+  // acquired, or for |timeout_ms| milliseconds (-1 for infinity). Producer
+  // hangups are only reported through the event fd. Returns zero, -ETIMEDOUT
+  // or another negative errno code.
+  int WaitForPost(int timeout_ms);
+
   // This should be called after a successful Acquire call. If the fence is
   // valid the fence determines the buffer usage, otherwise the buffer is
   // released immediately.
@@ -2,8 +2,16 @@
 #define ANDROID_DVR_BUFFERHUB_RPC_H_
 
 #include <cutils/native_handle.h>
+#include <errno.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
 #include <sys/types.h>
+#include <time.h>
 #include <ui/BufferQueueDefs.h>
+#include <unistd.h>
+
+#include <atomic>
 
 #include <dvr/dvr_api.h>
 #include <pdx/channel_handle.h>
@@ -70,14 +78,68 @@ struct __attribute__((packed, aligned(8))) MetadataHeader {
   std::atomic<uint64_t> fence_state;
   uint64_t queue_index;
 
+  // State for posting and releasing without bufferhubd, see the *Direct
+  // methods of BufferProducer and BufferConsumer. active_consumer_state holds
+  // the consumers that take part in a cycle; it is kept by bufferhubd as
+  // consumers are created, ignored and closed. pending_consumer_state holds
+  // the consumers that have yet to release the posted buffer.
+  std::atomic<uint64_t> active_consumer_state;
+  std::atomic<uint64_t> pending_consumer_state;
+
   // Public data format, which should be updated with caution. See more details
   // in dvr_api.h
   DvrNativeBufferMetadata metadata;
 };
 
-static_assert(sizeof(MetadataHeader) == 128, "Unexpected MetadataHeader size");
+static_assert(sizeof(MetadataHeader) == 144, "Unexpected MetadataHeader size");
 static constexpr size_t kMetadataHeaderSize = sizeof(MetadataHeader);
 
+// Futexes are 32 bits wide, so waiters watch the half of the buffer state that
+// holds the producer bit. It changes on every post and on the last release.
+static inline uint32_t* GetBufferStateFutex(
+    std::atomic<uint64_t>* buffer_state) {
+  return reinterpret_cast<uint32_t*>(buffer_state) +
+         (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__ ? 1 : 0);
+}
+
+// Wakes up every client blocked in WaitBufferState(). The buffer state lives
+// in memory shared between processes, so this is not a private futex.
+static inline void WakeBufferState(std::atomic<uint64_t>* buffer_state) {
+  syscall(SYS_futex, GetBufferStateFutex(buffer_state), FUTEX_WAKE, INT_MAX,
+          nullptr, nullptr, 0);
+}
+
+// Blocks until the producer half of the buffer state differs from |state|,
+// the relative |timeout| passes or a signal arrives. Returns zero or a
+// negative errno code; -EAGAIN means the state had already changed.
+static inline int WaitBufferState(std::atomic<uint64_t>* buffer_state,
+                                  uint64_t state, const timespec* timeout) {
+  // Whatever the byte order, the half holding the producer bit is the upper
+  // 32 bits of the value.
+  const uint32_t expected = static_cast<uint32_t>(state >> 32);
+  if (syscall(SYS_futex, GetBufferStateFutex(buffer_state), FUTEX_WAIT,
+              expected, timeout, nullptr, 0) < 0) {
+    return -errno;
+  }
+  return 0;
+}
+
+// Takes |consumer_bits| off the consumers that have yet to release a buffer
+// posted without bufferhubd. Whoever takes off the last one moves the buffer
+// into released state and wakes up the producer. Returns true if this call
+// released the buffer.
+static inline bool ReleasePendingConsumers(MetadataHeader* header,
+                                           uint64_t consumer_bits) {
+  const uint64_t pending =
+      header->pending_consumer_state.fetch_and(~consumer_bits);
+  if (!(pending & consumer_bits) || (pending & ~consumer_bits))
+    return false;
+
+  ModifyBufferState(&header->buffer_state, kProducerStateBit, 0ULL);
+  WakeBufferState(&header->buffer_state);
+  return true;
+}
+
 }  // namespace BufferHubDefs
 
 template <typename FileHandleType>
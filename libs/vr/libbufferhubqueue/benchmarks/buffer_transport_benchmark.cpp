@@ -7,19 +7,25 @@
 #include <gui/BufferItem.h>
 #include <gui/BufferItemConsumer.h>
 #include <gui/Surface.h>
+#include <private/dvr/buffer_hub_queue_client.h>
 #include <private/dvr/epoll_file_descriptor.h>
+#include <utils/Timers.h>
 #include <utils/Trace.h>
 
+#include <algorithm>
 #include <chrono>
 #include <functional>
 #include <iostream>
+#include <mutex>
 #include <thread>
 #include <vector>
 
 #include <dlfcn.h>
 #include <poll.h>
+#include <sched.h>
 #include <sys/epoll.h>
 #include <sys/wait.h>
+#include <unistd.h>
 
 // Use ALWAYS at the tag level. Control is performed manually during command
 // line processing.
@@ -45,12 +51,136 @@ static const int kInvalidFence = -1;
 
 enum BufferTransportServiceCode {
   CREATE_BUFFER_QUEUE = IBinder::FIRST_CALL_TRANSACTION,
+  GET_CONSUMER_LATENCY,
+};
+
+enum CpuAffinity {
+  // Leave the producer and the consumers to the scheduler.
+  kAffinityNone,
+  // Pin the producer and the consumers to the same CPU.
+  kAffinitySameCpu,
+  // Pin the producer and the consumers to two different CPUs.
+  kAffinitySplitCpus,
+};
+
+// How a benchmark run sets up its transport, from the benchmark arguments.
+struct TransportOptions {
+  int buffer_count = kQueueDepth;
+  int consumer_count = 1;
+  // Whether the consumers wait for acquire fences, and the raw BufferHubQueue
+  // producer for release fences, before using a buffer.
+  bool wait_for_fences = false;
+  int affinity = kAffinityNone;
+};
+
+// The producer runs on the last CPU, which is a big core on most big.LITTLE
+// parts. The consumers share it or take the one before.
+static int GetProducerCpu(int affinity) {
+  if (affinity == kAffinityNone)
+    return -1;
+  return static_cast<int>(sysconf(_SC_NPROCESSORS_CONF)) - 1;
+}
+
+static int GetConsumerCpu(int affinity) {
+  const int cpu = GetProducerCpu(affinity);
+  return affinity == kAffinitySplitCpus && cpu > 0 ? cpu - 1 : cpu;
+}
+
+// Pins the calling thread to |cpu|, unless it is negative.
+static void SetCpuAffinity(int cpu) {
+  if (cpu < 0)
+    return;
+
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  CPU_SET(cpu, &cpu_set);
+  if (sched_setaffinity(0, sizeof(cpu_set), &cpu_set) < 0) {
+    LOG(WARNING) << "Failed to pin thread to cpu " << cpu << ": "
+                 << strerror(errno);
+  }
+}
+
+// Pins the calling thread for as long as it lives, as benchmark threads are
+// reused across runs.
+class ScopedCpuAffinity {
+ public:
+  explicit ScopedCpuAffinity(int cpu) {
+    CPU_ZERO(&saved_cpu_set_);
+    restore_ = cpu >= 0 && sched_getaffinity(0, sizeof(saved_cpu_set_),
+                                             &saved_cpu_set_) == 0;
+    SetCpuAffinity(cpu);
+  }
+
+  ~ScopedCpuAffinity() {
+    if (restore_)
+      sched_setaffinity(0, sizeof(saved_cpu_set_), &saved_cpu_set_);
+  }
+
+ private:
+  cpu_set_t saved_cpu_set_;
+  bool restore_;
+};
+
+// Blocks until |fence_fd| signals, if it is a valid fence.
+static void WaitForFence(int fence_fd) {
+  if (fence_fd < 0)
+    return;
+
+  ATRACE_NAME("WaitForFence");
+  pollfd pfd = {fence_fd, POLLIN, 0};
+  while (poll(&pfd, 1, /*timeout=*/-1) < 0 && errno == EINTR) {
+  }
+}
+
+// Microseconds from the monotonic |timestamp_ns| a buffer was posted at until
+// now.
+static double GetLatencyUs(int64_t timestamp_ns) {
+  return (systemTime(SYSTEM_TIME_MONOTONIC) - timestamp_ns) / 1000.0;
+}
+
+// Collects latency samples in microseconds, from any thread.
+class LatencyRecorder {
+ public:
+  void Add(double latency_us) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    samples_.push_back(latency_us);
+  }
+
+  // Returns the median and the 99th percentile of the samples so far, or zero
+  // when there are none, and forgets the samples.
+  void TakePercentiles(double* p50_us, double* p99_us) {
+    std::vector<double> samples;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      samples.swap(samples_);
+    }
+    *p50_us = GetPercentile(&samples, 50);
+    *p99_us = GetPercentile(&samples, 99);
+  }
+
+  // Returns the |percentile|th percentile of |samples|, reordering them.
+  static double GetPercentile(std::vector<double>* samples,
+                              double percentile) {
+    if (samples->empty())
+      return 0;
+    const size_t index = std::min(
+        samples->size() - 1,
+        static_cast<size_t>(samples->size() * percentile / 100));
+    std::nth_element(samples->begin(), samples->begin() + index,
+                     samples->end());
+    return (*samples)[index];
+  }
+
+ private:
+  std::mutex mutex_;
+  std::vector<double> samples_;
 };
 
 // A binder services that minics a compositor that consumes buffers. It provides
 // one Binder interface to create a new Surface for buffer producer to write
 // into; while itself will carry out no-op buffer consuming by acquiring then
-// releasing the buffer immediately.
+// releasing the buffer immediately. Another interface reports how long buffers
+// took from being queued to being acquired.
 class BufferTransportService : public BBinder {
  public:
   BufferTransportService() = default;
@@ -59,15 +189,24 @@ class BufferTransportService : public BBinder {
   virtual status_t onTransact(uint32_t code, const Parcel& data, Parcel* reply,
                               uint32_t flags = 0) {
     (void)flags;
-    (void)data;
     switch (code) {
       case CREATE_BUFFER_QUEUE: {
-        auto new_queue = std::make_shared<BufferQueueHolder>(this);
+        const int consumer_cpu = data.readInt32();
+        const bool wait_for_fences = data.readInt32() != 0;
+        auto new_queue = std::make_shared<BufferQueueHolder>(
+            &latency_, consumer_cpu, wait_for_fences);
         reply->writeStrongBinder(
             IGraphicBufferProducer::asBinder(new_queue->producer));
         buffer_queues_.push_back(new_queue);
         return NO_ERROR;
       }
+      case GET_CONSUMER_LATENCY: {
+        double p50_us, p99_us;
+        latency_.TakePercentiles(&p50_us, &p99_us);
+        reply->writeDouble(p50_us);
+        reply->writeDouble(p99_us);
+        return NO_ERROR;
+      }
       default:
         return UNKNOWN_TRANSACTION;
     };
@@ -76,23 +215,36 @@ class BufferTransportService : public BBinder {
  private:
   struct FrameListener : public ConsumerBase::FrameAvailableListener {
    public:
-    FrameListener(BufferTransportService* /*service*/,
-                  sp<BufferItemConsumer> buffer_item_consumer)
-        : buffer_item_consumer_(buffer_item_consumer) {}
+    FrameListener(sp<BufferItemConsumer> buffer_item_consumer,
+                  LatencyRecorder* latency, int consumer_cpu,
+                  bool wait_for_fences)
+        : buffer_item_consumer_(buffer_item_consumer),
+          latency_(latency),
+          consumer_cpu_(consumer_cpu),
+          wait_for_fences_(wait_for_fences) {}
 
     void onFrameAvailable(const BufferItem& /*item*/) override {
+      // Frames arrive on whichever binder thread is free, so each of them pins
+      // itself on its first frame.
+      static thread_local bool pinned = false;
+      if (!pinned) {
+        SetCpuAffinity(consumer_cpu_);
+        pinned = true;
+      }
+
       BufferItem buffer;
       status_t ret = 0;
       {
         ATRACE_NAME("AcquireBuffer");
         ret = buffer_item_consumer_->acquireBuffer(&buffer, /*presentWhen=*/0,
-                                                   /*waitForFence=*/false);
+                                                   wait_for_fences_);
       }
 
       if (ret != NO_ERROR) {
         LOG(ERROR) << "Failed to acquire next buffer.";
         return;
       }
+      latency_->Add(GetLatencyUs(buffer.mTimestamp));
 
       {
         ATRACE_NAME("ReleaseBuffer");
@@ -107,17 +259,22 @@ class BufferTransportService : public BBinder {
 
    private:
     sp<BufferItemConsumer> buffer_item_consumer_;
+    LatencyRecorder* latency_;
+    const int consumer_cpu_;
+    const bool wait_for_fences_;
   };
 
   struct BufferQueueHolder {
-    explicit BufferQueueHolder(BufferTransportService* service) {
+    BufferQueueHolder(LatencyRecorder* latency, int consumer_cpu,
+                      bool wait_for_fences) {
       BufferQueue::createBufferQueue(&producer, &consumer);
 
       sp<BufferItemConsumer> buffer_item_consumer =
           new BufferItemConsumer(consumer, kBufferUsage, kMaxAcquiredImages,
                                  /*controlledByApp=*/true);
       buffer_item_consumer->setName(String8("BinderBufferTransport"));
-      frame_listener_ = new FrameListener(service, buffer_item_consumer);
+      frame_listener_ = new FrameListener(buffer_item_consumer, latency,
+                                          consumer_cpu, wait_for_fences);
       buffer_item_consumer->setFrameAvailableListener(frame_listener_);
     }
 
@@ -128,9 +285,51 @@ class BufferTransportService : public BBinder {
     sp<FrameListener> frame_listener_;
   };
 
+  LatencyRecorder latency_;
   std::vector<std::shared_ptr<BufferQueueHolder>> buffer_queues_;
 };
 
+// The producer end of a transport, which the test suite drives.
+class TransportProducer {
+ public:
+  virtual ~TransportProducer() {}
+
+  // Gains a buffer to write into, blocking until one is free.
+  virtual int Gain() = 0;
+
+  // Posts the buffer gained last to the consumers.
+  virtual int Post() = 0;
+};
+
+// Drives a Surface through the ANativeWindow API, the way apps do.
+class SurfaceProducer : public TransportProducer {
+ public:
+  SurfaceProducer(sp<Surface> surface, int buffer_count)
+      : surface_(std::move(surface)) {
+    // Set buffer dimension and count.
+    ANativeWindow_setBuffersGeometry(GetWindow(), kBufferWidth, kBufferHeight,
+                                     kBufferFormat);
+    const int ret = native_window_set_buffer_count(GetWindow(), buffer_count);
+    if (ret < 0)
+      LOG(WARNING) << "Failed to set buffer count " << buffer_count;
+  }
+
+  int Gain() override {
+    return ANativeWindow_lock(GetWindow(), &buffer_,
+                              /*inOutDirtyBounds=*/nullptr);
+  }
+
+  int Post() override { return ANativeWindow_unlockAndPost(GetWindow()); }
+
+ private:
+  ANativeWindow* GetWindow() {
+    return static_cast<ANativeWindow*>(surface_.get());
+  }
+
+  sp<Surface> surface_;
+  ANativeWindow_Buffer buffer_;
+};
+
 // A virtual interfaces that abstracts the common BufferQueue operations, so
 // that the test suite can use the same test case to drive different types of
 // transport backends.
@@ -138,24 +337,35 @@ class BufferTransport {
  public:
   virtual ~BufferTransport() {}
 
-  virtual int Start() = 0;
-  virtual sp<Surface> CreateSurface() = 0;
+  virtual int Start(const TransportOptions& options) = 0;
+  virtual std::unique_ptr<TransportProducer> CreateProducer() = 0;
+
+  // Reports, then forgets, how long the consumers took from a buffer being
+  // posted to acquiring it.
+  virtual void TakeConsumerLatency(double* p50_us, double* p99_us) = 0;
 };
 
 // Binder-based buffer transport backend.
 //
 // On Start() a new process will be swapned to run a Binder server that
 // actually consumes the buffer.
-// On CreateSurface() a new Binder BufferQueue will be created, which the
+// On CreateProducer() a new Binder BufferQueue will be created, which the
 // service holds the concrete binder node of the IGraphicBufferProducer while
 // sending the binder proxy to the client. In another word, the producer side
 // operations are carried out process while the consumer side operations are
-// carried out within the BufferTransportService's own process.
+// carried out within the BufferTransportService's own process. A BufferQueue
+// has a single consumer.
 class BinderBufferTransport : public BufferTransport {
  public:
   BinderBufferTransport() {}
 
-  int Start() override {
+  int Start(const TransportOptions& options) override {
+    if (options.consumer_count != 1) {
+      LOG(ERROR) << "BufferQueue only supports a single consumer.";
+      return -EINVAL;
+    }
+    options_ = options;
+
     sp<IServiceManager> sm = defaultServiceManager();
     service_ = sm->getService(kBinderService);
     if (service_ == nullptr) {
@@ -167,9 +377,11 @@ class BinderBufferTransport : public BufferTransport {
     return 0;
   }
 
-  sp<Surface> CreateSurface() override {
+  std::unique_ptr<TransportProducer> CreateProducer() override {
     Parcel data;
     Parcel reply;
+    data.writeInt32(GetConsumerCpu(options_.affinity));
+    data.writeInt32(options_.wait_for_fences);
     int error = service_->transact(CREATE_BUFFER_QUEUE, data, &reply);
     if (error != NO_ERROR) {
       LOG(ERROR) << "Failed to get buffer queue over binder.";
@@ -190,17 +402,24 @@ class BinderBufferTransport : public BufferTransport {
     }
 
     sp<Surface> surface = new Surface(producer, /*controlledByApp=*/true);
+    return std::make_unique<SurfaceProducer>(surface, options_.buffer_count);
+  }
 
-    // Set buffer dimension.
-    ANativeWindow* window = static_cast<ANativeWindow*>(surface.get());
-    ANativeWindow_setBuffersGeometry(window, kBufferWidth, kBufferHeight,
-                                     kBufferFormat);
-
-    return surface;
+  void TakeConsumerLatency(double* p50_us, double* p99_us) override {
+    Parcel data;
+    Parcel reply;
+    *p50_us = *p99_us = 0;
+    if (service_->transact(GET_CONSUMER_LATENCY, data, &reply) != NO_ERROR) {
+      LOG(ERROR) << "Failed to get consumer latency over binder.";
+      return;
+    }
+    *p50_us = reply.readDouble();
+    *p99_us = reply.readDouble();
   }
 
  private:
   sp<IBinder> service_;
+  TransportOptions options_;
 };
 
 class DvrApi {
@@ -225,41 +444,39 @@ class DvrApi {
   DvrApi_v1 api_;
 };
 
-// BufferHub/PDX-based buffer transport.
+// Base of the BufferHub/PDX-based transports.
 //
 // On Start() a new thread will be swapned to run an epoll polling thread which
 // minics the behavior of a compositor. Similar to Binder-based backend, the
 // buffer available handler is also a no-op: Buffer gets acquired and released
 // immediately.
-// On CreateSurface() a pair of dvr::ProducerQueue and dvr::ConsumerQueue will
-// be created. The epoll thread holds on the consumer queue and dequeues buffer
-// from it; while the producer queue will be wrapped in a Surface and returned
-// to test suite.
-class BufferHubTransport : public BufferTransport {
+class EpollReaderTransport : public BufferTransport {
  public:
-  virtual ~BufferHubTransport() {
+  ~EpollReaderTransport() override {
     stopped_.store(true);
     if (reader_thread_.joinable()) {
       reader_thread_.join();
     }
   }
 
-  int Start() override {
+  int Start(const TransportOptions& options) override {
+    options_ = options;
     int ret = epoll_fd_.Create();
     if (ret < 0) {
-      LOG(ERROR) << "Failed to create epoll fd: %s", strerror(-ret);
+      LOG(ERROR) << "Failed to create epoll fd: " << strerror(-ret);
       return -1;
     }
 
     // Create the reader thread.
+    stopped_.store(false);
     reader_thread_ = std::thread([this]() {
       int ret = dvr_.Api().PerformanceSetSchedulerPolicy(0, "graphics");
       if (ret < 0) {
         LOG(ERROR) << "Failed to set scheduler policy, ret=" << ret;
         return;
       }
+      SetCpuAffinity(GetConsumerCpu(options_.affinity));
 
-      stopped_.store(false);
       LOG(INFO) << "Reader Thread Running...";
 
       while (!stopped_.load()) {
@@ -277,10 +494,9 @@ class BufferHubTransport : public BufferTransport {
         }
 
         const int num_events = ret;
+        std::lock_guard<std::mutex> lock(handlers_mutex_);
         for (int i = 0; i < num_events; i++) {
-          uint32_t index = events[i].data.u32;
-          dvr_.Api().ReadBufferQueueHandleEvents(
-              buffer_queues_[index]->GetReadQueue());
+          handlers_[events[i].data.u32]();
         }
       }
 
@@ -290,82 +506,103 @@ class BufferHubTransport : public BufferTransport {
     return 0;
   }
 
-  sp<Surface> CreateSurface() override {
-    auto new_queue = std::make_shared<BufferQueueHolder>();
-    if (!new_queue->IsReady()) {
-      LOG(ERROR) << "Failed to create BufferHub-based BufferQueue.";
-      return nullptr;
-    }
-
-    // Set buffer dimension.
-    ANativeWindow_setBuffersGeometry(new_queue->GetSurface(), kBufferWidth,
-                                     kBufferHeight, kBufferFormat);
+  void TakeConsumerLatency(double* p50_us, double* p99_us) override {
+    latency_.TakePercentiles(p50_us, p99_us);
+  }
 
-    // Use the next position as buffer_queue index.
-    uint32_t index = buffer_queues_.size();
+ protected:
+  // Calls |handler| on the reader thread whenever the consumer queue behind
+  // |queue_fd| has events. Returns zero or a negative errno code.
+  int WatchQueue(int queue_fd, std::function<void()> handler) {
+    std::lock_guard<std::mutex> lock(handlers_mutex_);
+    // Use the next position as handler index.
+    uint32_t index = handlers_.size();
     epoll_event event = {.events = EPOLLIN | EPOLLET, .data = {.u32 = index}};
-    int queue_fd =
-        dvr_.Api().ReadBufferQueueGetEventFd(new_queue->GetReadQueue());
     const int ret = epoll_fd_.Control(EPOLL_CTL_ADD, queue_fd, &event);
     if (ret < 0) {
       LOG(ERROR) << "Failed to track consumer queue: " << strerror(-ret)
                  << ", consumer queue fd: " << queue_fd;
+      return ret;
+    }
+    handlers_.push_back(std::move(handler));
+    return 0;
+  }
+
+  static DvrApi dvr_;
+  TransportOptions options_;
+  LatencyRecorder latency_;
+
+ private:
+  std::atomic<bool> stopped_;
+  std::thread reader_thread_;
+
+  dvr::EpollFileDescriptor epoll_fd_;
+  std::mutex handlers_mutex_;
+  std::vector<std::function<void()>> handlers_;
+};
+
+DvrApi EpollReaderTransport::dvr_ = {};
+
+// BufferHub/PDX-based buffer transport, through BufferHubProducer.
+//
+// On CreateProducer() a DvrWriteBufferQueue and a DvrReadBufferQueue per
+// consumer will be created. The epoll thread holds on the read queues and
+// acquires buffers from them; while the write queue's ANativeWindow, which
+// wraps a BufferHubProducer, is returned to test suite.
+class BufferHubTransport : public EpollReaderTransport {
+ public:
+  std::unique_ptr<TransportProducer> CreateProducer() override {
+    auto new_queue = std::make_shared<BufferQueueHolder>(
+        options_.buffer_count, &latency_, options_.wait_for_fences);
+    if (!new_queue->IsReady() ||
+        !new_queue->CreateReadQueues(options_.consumer_count)) {
+      LOG(ERROR) << "Failed to create BufferHub-based BufferQueue.";
       return nullptr;
     }
 
+    for (auto& read_queue : new_queue->GetReadQueues()) {
+      int queue_fd = dvr_.Api().ReadBufferQueueGetEventFd(read_queue->Get());
+      DvrReadBufferQueue* queue = read_queue->Get();
+      if (WatchQueue(queue_fd, [queue] {
+            dvr_.Api().ReadBufferQueueHandleEvents(queue);
+          }) < 0) {
+        return nullptr;
+      }
+    }
+
     buffer_queues_.push_back(new_queue);
     ANativeWindow_acquire(new_queue->GetSurface());
-    return static_cast<Surface*>(new_queue->GetSurface());
+    return std::make_unique<SurfaceProducer>(
+        static_cast<Surface*>(new_queue->GetSurface()), options_.buffer_count);
   }
 
  private:
-  struct BufferQueueHolder {
-    BufferQueueHolder() {
-      int ret = 0;
-      ret = dvr_.Api().WriteBufferQueueCreate(
-          kBufferWidth, kBufferHeight, kBufferFormat, kBufferLayer,
-          kBufferUsage, 0, sizeof(DvrNativeBufferMetadata), &write_queue_);
-      if (ret < 0) {
-        LOG(ERROR) << "Failed to create write buffer queue, ret=" << ret;
-        return;
-      }
-
-      ret = dvr_.Api().WriteBufferQueueCreateReadQueue(write_queue_,
-                                                       &read_queue_);
-      if (ret < 0) {
-        LOG(ERROR) << "Failed to create read buffer queue, ret=" << ret;
-        return;
-      }
-
-      ret = dvr_.Api().ReadBufferQueueSetBufferAvailableCallback(
+  class ReadQueue {
+   public:
+    ReadQueue(DvrReadBufferQueue* read_queue, LatencyRecorder* latency,
+              bool wait_for_fences)
+        : read_queue_(read_queue),
+          latency_(latency),
+          wait_for_fences_(wait_for_fences) {}
+
+    bool Init() {
+      int ret = dvr_.Api().ReadBufferQueueSetBufferAvailableCallback(
           read_queue_, BufferAvailableCallback, this);
       if (ret < 0) {
         LOG(ERROR) << "Failed to create buffer available callback, ret=" << ret;
-        return;
-      }
-
-      ret =
-          dvr_.Api().WriteBufferQueueGetANativeWindow(write_queue_, &surface_);
-      if (ret < 0) {
-        LOG(ERROR) << "Failed to create surface, ret=" << ret;
-        return;
+        return false;
       }
+      return true;
     }
 
+    DvrReadBufferQueue* Get() { return read_queue_; }
+
+   private:
     static void BufferAvailableCallback(void* context) {
-      BufferQueueHolder* thiz = static_cast<BufferQueueHolder*>(context);
+      ReadQueue* thiz = static_cast<ReadQueue*>(context);
       thiz->HandleBufferAvailable();
     }
 
-    DvrReadBufferQueue* GetReadQueue() { return read_queue_; }
-
-    ANativeWindow* GetSurface() { return surface_; }
-
-    bool IsReady() {
-      return write_queue_ != nullptr && read_queue_ != nullptr &&
-             surface_ != nullptr;
-    }
-
     void HandleBufferAvailable() {
       int ret = 0;
       DvrNativeBufferMetadata meta;
@@ -384,39 +621,210 @@ class BufferHubTransport : public BufferTransport {
       }
 
       if (buffer != nullptr) {
+        latency_->Add(GetLatencyUs(metadata.timestamp));
+        if (wait_for_fences_)
+          WaitForFence(acquire_fence);
+
         ATRACE_NAME("ReleaseBuffer");
         ret = dvr_.Api().ReadBufferQueueReleaseBuffer(read_queue_, buffer,
                                                       &meta, kInvalidFence);
       }
+      if (acquire_fence >= 0)
+        close(acquire_fence);
       if (ret < 0) {
         LOG(ERROR) << "Failed to release consumer buffer, error: " << ret;
       }
     }
 
+    DvrReadBufferQueue* read_queue_;
+    LatencyRecorder* latency_;
+    const bool wait_for_fences_;
+  };
+
+  struct BufferQueueHolder {
+    BufferQueueHolder(int buffer_count, LatencyRecorder* latency,
+                      bool wait_for_fences)
+        : latency_(latency), wait_for_fences_(wait_for_fences) {
+      int ret = 0;
+      ret = dvr_.Api().WriteBufferQueueCreate(
+          kBufferWidth, kBufferHeight, kBufferFormat, kBufferLayer,
+          kBufferUsage, buffer_count, sizeof(DvrNativeBufferMetadata),
+          &write_queue_);
+      if (ret < 0) {
+        LOG(ERROR) << "Failed to create write buffer queue, ret=" << ret;
+        return;
+      }
+
+      ret =
+          dvr_.Api().WriteBufferQueueGetANativeWindow(write_queue_, &surface_);
+      if (ret < 0) {
+        LOG(ERROR) << "Failed to create surface, ret=" << ret;
+        return;
+      }
+    }
+
+    bool CreateReadQueues(int consumer_count) {
+      for (int i = 0; i < consumer_count; i++) {
+        DvrReadBufferQueue* read_queue = nullptr;
+        int ret = dvr_.Api().WriteBufferQueueCreateReadQueue(write_queue_,
+                                                             &read_queue);
+        if (ret < 0) {
+          LOG(ERROR) << "Failed to create read buffer queue, ret=" << ret;
+          return false;
+        }
+
+        read_queues_.push_back(std::make_unique<ReadQueue>(
+            read_queue, latency_, wait_for_fences_));
+        if (!read_queues_.back()->Init())
+          return false;
+      }
+      return true;
+    }
+
+    std::vector<std::unique_ptr<ReadQueue>>& GetReadQueues() {
+      return read_queues_;
+    }
+
+    ANativeWindow* GetSurface() { return surface_; }
+
+    bool IsReady() { return write_queue_ != nullptr && surface_ != nullptr; }
+
    private:
     DvrWriteBufferQueue* write_queue_ = nullptr;
-    DvrReadBufferQueue* read_queue_ = nullptr;
+    std::vector<std::unique_ptr<ReadQueue>> read_queues_;
     ANativeWindow* surface_ = nullptr;
+    LatencyRecorder* latency_;
+    const bool wait_for_fences_;
   };
 
-  static DvrApi dvr_;
-  std::atomic<bool> stopped_;
-  std::thread reader_thread_;
-
-  dvr::EpollFileDescriptor epoll_fd_;
   std::vector<std::shared_ptr<BufferQueueHolder>> buffer_queues_;
 };
 
-DvrApi BufferHubTransport::dvr_ = {};
+// Posts buffers straight into a dvr::ProducerQueue, skipping the
+// IGraphicBufferProducer and ANativeWindow layers.
+class QueueProducer : public TransportProducer {
+ public:
+  QueueProducer(std::shared_ptr<dvr::ProducerQueue> queue,
+                bool wait_for_fences)
+      : queue_(std::move(queue)), wait_for_fences_(wait_for_fences) {}
+
+  int Gain() override {
+    size_t slot;
+    pdx::LocalHandle release_fence;
+    auto status = queue_->Dequeue(/*timeout=*/-1, &slot, &meta_,
+                                  &release_fence);
+    if (!status)
+      return -status.error();
+
+    if (wait_for_fences_)
+      WaitForFence(release_fence.Get());
+    buffer_ = status.take();
+    return 0;
+  }
+
+  int Post() override {
+    meta_.timestamp = systemTime(SYSTEM_TIME_MONOTONIC);
+    const int ret = buffer_->PostAsync(&meta_, pdx::LocalHandle());
+    buffer_ = nullptr;
+    return ret;
+  }
+
+ private:
+  std::shared_ptr<dvr::ProducerQueue> queue_;
+  const bool wait_for_fences_;
+  std::shared_ptr<dvr::BufferProducer> buffer_;
+  DvrNativeBufferMetadata meta_;
+};
+
+// Raw BufferHubQueue-based buffer transport.
+//
+// On CreateProducer() a dvr::ProducerQueue with a dvr::ConsumerQueue per
+// consumer will be created. The epoll thread dequeues buffers from the
+// consumer queues; while the producer queue is driven directly by the test
+// suite.
+class BufferHubQueueTransport : public EpollReaderTransport {
+ public:
+  std::unique_ptr<TransportProducer> CreateProducer() override {
+    std::shared_ptr<dvr::ProducerQueue> producer_queue =
+        dvr::ProducerQueue::Create(dvr::ProducerQueueConfigBuilder().Build(),
+                                   dvr::UsagePolicy{});
+    if (producer_queue == nullptr) {
+      LOG(ERROR) << "Failed to create producer queue.";
+      return nullptr;
+    }
+
+    auto status = producer_queue->AllocateBuffers(
+        kBufferWidth, kBufferHeight, kBufferLayer, kBufferFormat, kBufferUsage,
+        options_.buffer_count);
+    if (!status) {
+      LOG(ERROR) << "Failed to allocate buffers: " << status.GetErrorMessage();
+      return nullptr;
+    }
+
+    for (int i = 0; i < options_.consumer_count; i++) {
+      std::shared_ptr<dvr::ConsumerQueue> consumer_queue =
+          producer_queue->CreateConsumerQueue();
+      if (consumer_queue == nullptr) {
+        LOG(ERROR) << "Failed to create consumer queue.";
+        return nullptr;
+      }
+
+      consumer_queues_.push_back(consumer_queue);
+      dvr::ConsumerQueue* queue = consumer_queue.get();
+      if (WatchQueue(queue->queue_fd(),
+                     [this, queue] { HandleQueueEvents(queue); }) < 0) {
+        return nullptr;
+      }
+    }
+
+    return std::make_unique<QueueProducer>(producer_queue,
+                                           options_.wait_for_fences);
+  }
+
+ private:
+  void HandleQueueEvents(dvr::ConsumerQueue* queue) {
+    for (;;) {
+      size_t slot;
+      DvrNativeBufferMetadata meta;
+      pdx::LocalHandle acquire_fence;
+      std::shared_ptr<dvr::BufferConsumer> buffer;
+      {
+        ATRACE_NAME("AcquireBuffer");
+        auto status = queue->Dequeue(/*timeout=*/0, &slot, &meta,
+                                     &acquire_fence);
+        if (!status)
+          return;
+        buffer = status.take();
+      }
+
+      latency_.Add(GetLatencyUs(meta.timestamp));
+      if (options_.wait_for_fences)
+        WaitForFence(acquire_fence.Get());
+
+      ATRACE_NAME("ReleaseBuffer");
+      const int ret = buffer->ReleaseAsync(&meta, pdx::LocalHandle());
+      if (ret < 0) {
+        LOG(ERROR) << "Failed to release consumer buffer, error: " << ret;
+      }
+    }
+  }
+
+  std::vector<std::shared_ptr<dvr::ConsumerQueue>> consumer_queues_;
+};
 
 enum TransportType {
   kBinderBufferTransport,
   kBufferHubTransport,
+  kBufferHubQueueTransport,
 };
 
-// Main test suite, which supports two transport backend: 1) BinderBufferQueue,
-// 2) BufferHubQueue. The test case drives the producer end of both transport
-// backend by queuing buffers into the buffer queue by using ANativeWindow API.
+// Main test suite, which supports three transport backends: 1)
+// BinderBufferQueue, 2) BufferHubProducer and 3) raw BufferHubQueue. The test
+// case drives the producer end of the transport backend by queuing buffers into
+// the buffer queue, using the ANativeWindow API for the first two.
+//
+// Arguments are the transport, the buffer count, the consumer count, whether
+// fences are waited for and the CpuAffinity.
 class BufferTransportBenchmark : public ::benchmark::Fixture {
  public:
   void SetUp(State& state) override {
@@ -429,32 +837,51 @@ class BufferTransportBenchmark : public ::benchmark::Fixture {
         case kBufferHubTransport:
           transport_.reset(new BufferHubTransport);
           break;
+        case kBufferHubQueueTransport:
+          transport_.reset(new BufferHubQueueTransport);
+          break;
         default:
           CHECK(false) << "Unknown test case.";
           break;
       }
 
+      options_.buffer_count = state.range(1);
+      options_.consumer_count = state.range(2);
+      options_.wait_for_fences = state.range(3) != 0;
+      options_.affinity = state.range(4);
+
       CHECK(transport_);
-      const int ret = transport_->Start();
+      const int ret = transport_->Start(options_);
       CHECK_EQ(ret, 0);
 
       LOG(INFO) << "Transport backend running, transport=" << transport << ".";
 
-      // Create surfaces for each thread.
-      surfaces_.resize(state.threads);
+      // Create producers for each thread.
+      producers_.resize(state.threads);
       for (int i = 0; i < state.threads; i++) {
         // Common setup every thread needs.
-        surfaces_[i] = transport_->CreateSurface();
-        CHECK(surfaces_[i]);
+        producers_[i] = transport_->CreateProducer();
+        CHECK(producers_[i]);
+
+        // Cycle buffers a couple time through the queue, so that we have the
+        // buffers allocated.
+        for (int j = 0; j < options_.buffer_count; j++) {
+          CHECK_EQ(producers_[i]->Gain(), 0);
+          CHECK_EQ(producers_[i]->Post(), 0);
+        }
 
-        LOG(INFO) << "Surface initialized on thread " << i << ".";
+        LOG(INFO) << "Producer initialized on thread " << i << ".";
       }
+
+      // Leave the warm up out of the consumer latency.
+      double p50_us, p99_us;
+      transport_->TakeConsumerLatency(&p50_us, &p99_us);
     }
   }
 
   void TearDown(State& state) override {
     if (state.thread_index == 0) {
-      surfaces_.clear();
+      producers_.clear();
       transport_.reset();
       LOG(INFO) << "Tear down benchmark.";
     }
@@ -462,51 +889,40 @@ class BufferTransportBenchmark : public ::benchmark::Fixture {
 
  protected:
   std::unique_ptr<BufferTransport> transport_;
-  std::vector<sp<Surface>> surfaces_;
+  std::vector<std::unique_ptr<TransportProducer>> producers_;
+  TransportOptions options_;
 };
 
 BENCHMARK_DEFINE_F(BufferTransportBenchmark, Producers)(State& state) {
-  ANativeWindow* window = nullptr;
-  ANativeWindow_Buffer buffer;
+  ScopedCpuAffinity affinity(GetProducerCpu(options_.affinity));
+  TransportProducer* producer = producers_[state.thread_index].get();
   int32_t error = 0;
   double total_gain_buffer_us = 0;
   double total_post_buffer_us = 0;
+  std::vector<double> gain_buffer_us;
+  std::vector<double> post_buffer_us;
   int iterations = 0;
 
   while (state.KeepRunning()) {
-    if (window == nullptr) {
-      CHECK(surfaces_[state.thread_index]);
-      window = static_cast<ANativeWindow*>(surfaces_[state.thread_index].get());
-
-      // Lock buffers a couple time from the queue, so that we have the buffer
-      // allocated.
-      for (int i = 0; i < kQueueDepth; i++) {
-        error = ANativeWindow_lock(window, &buffer,
-                                   /*inOutDirtyBounds=*/nullptr);
-        CHECK_EQ(error, 0);
-        error = ANativeWindow_unlockAndPost(window);
-        CHECK_EQ(error, 0);
-      }
-    }
-
     {
       ATRACE_NAME("GainBuffer");
       auto t1 = std::chrono::high_resolution_clock::now();
-      error = ANativeWindow_lock(window, &buffer,
-                                 /*inOutDirtyBounds=*/nullptr);
+      error = producer->Gain();
       auto t2 = std::chrono::high_resolution_clock::now();
       std::chrono::duration<double, std::micro> delta_us = t2 - t1;
       total_gain_buffer_us += delta_us.count();
+      gain_buffer_us.push_back(delta_us.count());
     }
     CHECK_EQ(error, 0);
 
     {
       ATRACE_NAME("PostBuffer");
       auto t1 = std::chrono::high_resolution_clock::now();
-      error = ANativeWindow_unlockAndPost(window);
+      error = producer->Post();
       auto t2 = std::chrono::high_resolution_clock::now();
       std::chrono::duration<double, std::micro> delta_us = t2 - t1;
       total_post_buffer_us += delta_us.count();
+      post_buffer_us.push_back(delta_us.count());
     }
     CHECK_EQ(error, 0);
 
@@ -520,13 +936,60 @@ BENCHMARK_DEFINE_F(BufferTransportBenchmark, Producers)(State& state) {
   state.counters["producer_us"] = ::benchmark::Counter(
       (total_gain_buffer_us + total_post_buffer_us) / iterations,
       ::benchmark::Counter::kAvgThreads);
+  state.counters["gain_p50_us"] = ::benchmark::Counter(
+      LatencyRecorder::GetPercentile(&gain_buffer_us, 50),
+      ::benchmark::Counter::kAvgThreads);
+  state.counters["gain_p99_us"] = ::benchmark::Counter(
+      LatencyRecorder::GetPercentile(&gain_buffer_us, 99),
+      ::benchmark::Counter::kAvgThreads);
+  state.counters["post_p50_us"] = ::benchmark::Counter(
+      LatencyRecorder::GetPercentile(&post_buffer_us, 50),
+      ::benchmark::Counter::kAvgThreads);
+  state.counters["post_p99_us"] = ::benchmark::Counter(
+      LatencyRecorder::GetPercentile(&post_buffer_us, 99),
+      ::benchmark::Counter::kAvgThreads);
+
+  // The consumers are shared by all threads, so one of them reports for all.
+  if (state.thread_index == 0) {
+    double p50_us, p99_us;
+    transport_->TakeConsumerLatency(&p50_us, &p99_us);
+    state.counters["latency_p50_us"] = p50_us;
+    state.counters["latency_p99_us"] = p99_us;
+  }
 }
 
+// Many producers, each with a single consumer and the default queue depth.
 BENCHMARK_REGISTER_F(BufferTransportBenchmark, Producers)
     ->Unit(::benchmark::kMicrosecond)
-    ->Ranges({{kBinderBufferTransport, kBufferHubTransport}})
+    ->Args({kBinderBufferTransport, kQueueDepth, 1, 0, kAffinityNone})
+    ->Args({kBufferHubTransport, kQueueDepth, 1, 0, kAffinityNone})
+    ->Args({kBufferHubQueueTransport, kQueueDepth, 1, 0, kAffinityNone})
     ->ThreadRange(1, 32);
 
+// A single producer, across the transport settings.
+static void TransportSettings(::benchmark::internal::Benchmark* b) {
+  for (int transport : {kBinderBufferTransport, kBufferHubTransport,
+                        kBufferHubQueueTransport}) {
+    for (int buffer_count : {2, 3, 4}) {
+      for (int consumer_count : {1, 2, 3}) {
+        if (transport == kBinderBufferTransport && consumer_count != 1)
+          continue;
+        for (int wait_for_fences : {0, 1}) {
+          for (int affinity :
+               {kAffinityNone, kAffinitySameCpu, kAffinitySplitCpus}) {
+            b->Args({transport, buffer_count, consumer_count, wait_for_fences,
+                     affinity});
+          }
+        }
+      }
+    }
+  }
+}
+
+BENCHMARK_REGISTER_F(BufferTransportBenchmark, Producers)
+    ->Unit(::benchmark::kMicrosecond)
+    ->Apply(TransportSettings);
+
 static void runBinderServer() {
   ProcessState::self()->setThreadPoolMaxThreadCount(0);
   ProcessState::self()->startThreadPool();
@@ -548,13 +1011,22 @@ static void runBinderServer() {
   LOG(INFO) << "Service Exiting...";
 }
 
+// Benchmark names end in the arguments: transport (0 for Binder BufferQueue, 1
+// for BufferHubProducer, 2 for raw BufferHubQueue), buffer count, consumer
+// count, fence waiting (0 or 1) and CPU affinity (0 for none, 1 for the same
+// CPU, 2 for two CPUs).
+//
 // To run binder-based benchmark, use:
 // adb shell buffer_transport_benchmark \
-//   --benchmark_filter="BufferTransportBenchmark/ContinuousLoad/0/"
+//   --benchmark_filter="BufferTransportBenchmark/Producers/0/"
 //
 // To run bufferhub-based benchmark, use:
 // adb shell buffer_transport_benchmark \
-//   --benchmark_filter="BufferTransportBenchmark/ContinuousLoad/1/"
+//   --benchmark_filter="BufferTransportBenchmark/Producers/1/"
+//
+// To compare the transports with two buffers and a pinned consumer, use:
+// adb shell buffer_transport_benchmark \
+//   --benchmark_filter="BufferTransportBenchmark/Producers/./2/1/0/2/"
 int main(int argc, char** argv) {
   bool tracing_enabled = false;
 
@@ -528,6 +528,34 @@ TEST_F(BufferHubQueueTest, TestAllocateBuffer) {
   ASSERT_EQ(cs2, ps2);
 }
 
+TEST_F(BufferHubQueueTest, TestAllocateBuffersAfterRecreate) {
+  const size_t kBufferCount = 2;
+  DvrNativeBufferMetadata mi, mo;
+  LocalHandle fence;
+  for (int round = 0; round < 2; ++round) {
+    ASSERT_TRUE(CreateQueues(config_builder_.Build(), UsagePolicy{}));
+    auto status = producer_queue_->AllocateBuffers(
+        kBufferWidth, kBufferHeight, kBufferLayerCount, kBufferFormat,
+        kBufferUsage, kBufferCount);
+    ASSERT_TRUE(status.ok());
+    ASSERT_EQ(kBufferCount, status.get().size());
+
+    // Buffers reused from the last round start out gained, like new ones.
+    for (size_t i = 0; i < kBufferCount; ++i) {
+      size_t slot;
+      auto p_status = producer_queue_->Dequeue(kTimeoutMs, &slot, &mo, &fence);
+      ASSERT_TRUE(p_status.ok());
+      auto p = p_status.take();
+      EXPECT_EQ(0U, p->buffer_state());
+      // Leave the buffer posted when the queue goes away.
+      ASSERT_EQ(0, p->PostAsync(&mi, {}));
+    }
+
+    consumer_queue_ = nullptr;
+    producer_queue_ = nullptr;
+  }
+}
+
 TEST_F(BufferHubQueueTest, TestUsageSetMask) {
   const uint32_t set_mask = GRALLOC_USAGE_SW_WRITE_OFTEN;
   ASSERT_TRUE(
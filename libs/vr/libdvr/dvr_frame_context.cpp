@@ -0,0 +1,48 @@
+#include "include/dvr/dvr_frame_context.h"
+
+#include <errno.h>
+
+#include <memory>
+
+#include <dvr/dvr_shared_buffers.h>
+#include <private/dvr/shared_buffer_helpers.h>
+
+using android::dvr::CPUMappedBroadcastRing;
+using android::dvr::CPUUsageMode;
+using android::dvr::DvrFrameContextRing;
+using android::dvr::DvrGlobalBuffers;
+
+extern "C" {
+
+struct DvrFrameContextReader {
+  // Maps the buffer lazily: until vrflinger has created it, each read tries
+  // again, rate limited by CPUMappedBuffer.
+  std::unique_ptr<CPUMappedBroadcastRing<DvrFrameContextRing>> ring;
+};
+
+int dvrFrameContextReaderCreate(DvrFrameContextReader** reader_out) {
+  if (!reader_out)
+    return -EINVAL;
+
+  *reader_out = new DvrFrameContextReader{
+      std::make_unique<CPUMappedBroadcastRing<DvrFrameContextRing>>(
+          DvrGlobalBuffers::kVrFlingerFrameContextBufferKey,
+          CPUUsageMode::READ_OFTEN)};
+  return 0;
+}
+
+void dvrFrameContextReaderDestroy(DvrFrameContextReader* reader) {
+  delete reader;
+}
+
+int dvrFrameContextReaderGet(DvrFrameContextReader* reader,
+                             DvrFrameContext* context_out) {
+  if (!reader || !context_out)
+    return -EINVAL;
+
+  if (!reader->ring->GetNewest(context_out))
+    return -EAGAIN;
+  return 0;
+}
+
+}  // extern "C"
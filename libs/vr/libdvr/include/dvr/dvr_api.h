@@ -31,6 +31,8 @@ typedef struct DvrSurfaceState DvrSurfaceState;
 typedef struct DvrPoseClient DvrPoseClient;
 typedef struct DvrPoseDataCaptureRequest DvrPoseDataCaptureRequest;
 typedef struct DvrVSyncClient DvrVSyncClient;
+typedef struct DvrFrameContext DvrFrameContext;
+typedef struct DvrFrameContextReader DvrFrameContextReader;
 typedef struct DvrVirtualTouchpad DvrVirtualTouchpad;
 
 typedef struct DvrBuffer DvrBuffer;
@@ -256,6 +258,13 @@ typedef int (*DvrVSyncClientGetSchedInfoPtr)(DvrVSyncClient* client,
                                              int64_t* next_timestamp_ns,
                                              uint32_t* next_vsync_count);
 
+// dvr_frame_context.h
+typedef int (*DvrFrameContextReaderCreatePtr)(
+    DvrFrameContextReader** reader_out);
+typedef void (*DvrFrameContextReaderDestroyPtr)(DvrFrameContextReader* reader);
+typedef int (*DvrFrameContextReaderGetPtr)(DvrFrameContextReader* reader,
+                                           DvrFrameContext* context_out);
+
 // libs/vr/libvrsensor/include/dvr/pose_client.h
 typedef DvrPoseClient* (*DvrPoseClientCreatePtr)();
 typedef void (*DvrPoseClientDestroyPtr)(DvrPoseClient* client);
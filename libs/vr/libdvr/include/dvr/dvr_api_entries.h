@@ -181,3 +181,8 @@ DVR_V1_API_ENTRY(ReadBufferQueueReleaseBuffer);
 DVR_V1_API_ENTRY(PoseClientGetDataReader);
 DVR_V1_API_ENTRY(PoseClientDataCapture);
 DVR_V1_API_ENTRY(PoseClientDataReaderDestroy);
+
+// Frame context
+DVR_V1_API_ENTRY(FrameContextReaderCreate);
+DVR_V1_API_ENTRY(FrameContextReaderDestroy);
+DVR_V1_API_ENTRY(FrameContextReaderGet);
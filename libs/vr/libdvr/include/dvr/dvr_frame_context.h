@@ -0,0 +1,64 @@
+#ifndef ANDROID_DVR_FRAME_CONTEXT_H_
+#define ANDROID_DVR_FRAME_CONTEXT_H_
+
+// This header is shared by VrCore and Android and must be kept in sync.
+
+#include <stdint.h>
+#include <sys/cdefs.h>
+
+#include <dvr/dvr_pose.h>
+
+__BEGIN_DECLS
+
+typedef struct DvrFrameContextReader DvrFrameContextReader;
+
+// Everything a render thread needs to start a frame, published by vrflinger at
+// every vsync. The size of this struct is 192 bytes.
+typedef struct __attribute__((packed, aligned(16))) DvrFrameContext {
+  // The timestamp of the last vsync in nanoseconds.
+  int64_t vsync_timestamp_ns;
+
+  // The estimated timestamp of the upcoming vsync in nanoseconds.
+  int64_t next_vsync_timestamp_ns;
+
+  // The index of the last vsync. The upcoming vsync is vsync_count + 1.
+  uint32_t vsync_count;
+
+  // The period of a vsync in nanoseconds.
+  uint32_t vsync_period_ns;
+
+  // Scan out for the left and right eyes relative to a vsync timestamp.
+  int32_t vsync_left_eye_offset_ns;
+  int32_t vsync_right_eye_offset_ns;
+
+  // How long before vsync vrflinger submits frames to hardware composer.
+  int32_t frame_post_offset_ns;
+
+  // The size of the display in pixels.
+  uint32_t display_width;
+  uint32_t display_height;
+
+  // Reserved padding so |predicted_pose| starts at 64 bytes.
+  uint8_t pad[20];
+
+  // The pose predicted for the upcoming vsync. DVR_POSE_FLAG_INVALID is set
+  // when no pose is being predicted.
+  DvrPoseAsync predicted_pose;
+} DvrFrameContext;
+
+// Creates a reader of the frame context. The first call maps the shared
+// memory; reads after that do not leave the calling process.
+int dvrFrameContextReaderCreate(DvrFrameContextReader** reader_out);
+
+// Destroys the reader.
+void dvrFrameContextReaderDestroy(DvrFrameContextReader* reader);
+
+// Copies the latest frame context into |context_out|. Returns 0 on success,
+// -EAGAIN if vrflinger has not published one yet, or another negative errno
+// error code on error.
+int dvrFrameContextReaderGet(DvrFrameContextReader* reader,
+                             DvrFrameContext* context_out);
+
+__END_DECLS
+
+#endif  // ANDROID_DVR_FRAME_CONTEXT_H_
@@ -2,7 +2,9 @@
 #define ANDROID_DVR_SHARED_BUFFERS_H_
 
 #include <dvr/dvr_config.h>
+#include <dvr/dvr_frame_context.h>
 #include <dvr/dvr_pose.h>
+#include <dvr/dvr_telemetry.h>
 #include <dvr/dvr_vsync.h>
 #include <libbroadcastring/broadcast_ring.h>
 
@@ -27,6 +29,9 @@ static_assert(sizeof(DvrPoseAsync) == 128, "Unexpected size for DvrPoseAsync");
 static_assert(sizeof(DvrPose) == 112, "Unexpected size for DvrPose");
 static_assert(sizeof(DvrVsync) == 32, "Unexpected size for DvrVsync");
 static_assert(sizeof(DvrConfig) == 16, "Unexpected size for DvrConfig");
+static_assert(sizeof(DvrTelemetry) == 32, "Unexpected size for DvrTelemetry");
+static_assert(sizeof(DvrFrameContext) == 192,
+              "Unexpected size for DvrFrameContext");
 
 // A helper class that provides compile time sized traits for the BroadcastRing.
 template <class DvrType, size_t StaticCount>
@@ -43,11 +48,17 @@ class DvrRingBufferTraits {
 using DvrPoseTraits = DvrRingBufferTraits<DvrPose, 0>;
 using DvrVsyncTraits = DvrRingBufferTraits<DvrVsync, 2>;
 using DvrConfigTraits = DvrRingBufferTraits<DvrConfig, 2>;
+// Telemetry is read by walking the ring, so it keeps a few seconds of records.
+using DvrTelemetryTraits = DvrRingBufferTraits<DvrTelemetry, 256>;
+using DvrFrameContextTraits = DvrRingBufferTraits<DvrFrameContext, 4>;
 
 // The broadcast ring classes that will expose the data.
 using DvrPoseRing = BroadcastRing<DvrPose, DvrPoseTraits>;
 using DvrVsyncRing = BroadcastRing<DvrVsync, DvrVsyncTraits>;
 using DvrConfigRing = BroadcastRing<DvrConfig, DvrConfigTraits>;
+using DvrTelemetryRing = BroadcastRing<DvrTelemetry, DvrTelemetryTraits>;
+using DvrFrameContextRing =
+    BroadcastRing<DvrFrameContext, DvrFrameContextTraits>;
 
 // This is a shared memory buffer for passing pose data estimated at vsyncs.
 //
@@ -93,7 +104,11 @@ enum DvrGlobalBuffers : int32_t {
   kVsyncPoseBuffer = 1,
   kVsyncBuffer = 2,
   kSensorPoseBuffer = 3,
-  kVrFlingerConfigBufferKey = 4
+  kVrFlingerConfigBufferKey = 4,
+  // Created by vrflinger itself, which publishes DvrTelemetry records into it.
+  kVrFlingerTelemetryBufferKey = 5,
+  // Created by vrflinger itself, which publishes a DvrFrameContext per vsync.
+  kVrFlingerFrameContextBufferKey = 6
 };
 
 }  // namespace dvr
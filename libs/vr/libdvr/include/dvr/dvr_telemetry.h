@@ -0,0 +1,44 @@
+#ifndef ANDROID_DVR_TELEMETRY_H_
+#define ANDROID_DVR_TELEMETRY_H_
+
+// This header is shared by VrCore and Android and must be kept in sync.
+
+#include <stdint.h>
+#include <sys/cdefs.h>
+
+__BEGIN_DECLS
+
+// The kinds of telemetry records.
+enum {
+  // A frame was handed to hardware composer. |value[0]| is how long before the
+  // display time the post thread woke up and |value[1]| how long posting took,
+  // both in nanoseconds.
+  DVR_TELEMETRY_TYPE_FRAME = 1,
+  // The post thread did not see vsync advance. |value[0]| is the number of
+  // vsyncs predicted since the last real one and |value[1]| the number of
+  // frames dropped in a row to catch up with the display.
+  DVR_TELEMETRY_TYPE_VSYNC_MISS = 2,
+  // A thermal zone was sampled. |value[0]| is the zone index and |value[1]|
+  // its temperature in millidegrees Celsius.
+  DVR_TELEMETRY_TYPE_THERMAL = 3,
+};
+
+// A telemetry sample published by a system service for any number of readers.
+// The size of this struct is 32 bytes.
+typedef struct __attribute__((packed, aligned(16))) DvrTelemetry {
+  // When the sample was taken, in CLOCK_MONOTONIC nanoseconds.
+  int64_t timestamp_ns;
+
+  // One of DVR_TELEMETRY_TYPE_*.
+  uint32_t type;
+
+  // The vsync count when the sample was taken, or zero when not known.
+  uint32_t vsync_count;
+
+  // Meaning depends on |type|.
+  int64_t value[2];
+} DvrTelemetry;
+
+__END_DECLS
+
+#endif  // ANDROID_DVR_TELEMETRY_H_
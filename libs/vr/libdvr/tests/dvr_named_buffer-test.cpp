@@ -1,9 +1,11 @@
 #include <android/hardware_buffer.h>
 #include <dvr/dvr_buffer.h>
 #include <dvr/dvr_config.h>
+#include <dvr/dvr_frame_context.h>
 #include <dvr/dvr_shared_buffers.h>
 #include <dvr/dvr_surface.h>
 #include <system/graphics.h>
+#include <unistd.h>
 
 #include <gtest/gtest.h>
 
@@ -278,6 +280,36 @@ TEST(DvrGlobalBufferTest, TestVrflingerConfigBuffer) {
   dvrBufferDestroy(setup_buffer);
 }
 
+TEST(DvrGlobalBufferTest, TestVrflingerFrameContext) {
+  // vrflinger owns the frame context buffer.
+  ASSERT_GT(0, dvrDeleteGlobalBuffer(
+                   DvrGlobalBuffers::kVrFlingerFrameContextBufferKey));
+
+  DvrFrameContextReader* reader = nullptr;
+  ASSERT_EQ(0, dvrFrameContextReaderCreate(&reader));
+  ASSERT_NE(nullptr, reader);
+
+  // Frame contexts are only published while the display is on, so give the
+  // post thread a few vsyncs to publish one.
+  DvrFrameContext context;
+  int ret = -EAGAIN;
+  for (int i = 0; i < 10 && ret == -EAGAIN; i++) {
+    ret = dvrFrameContextReaderGet(reader, &context);
+    if (ret == -EAGAIN)
+      usleep(20000);
+  }
+  ASSERT_TRUE(ret == 0 || ret == -EAGAIN);
+  if (ret == 0) {
+    EXPECT_LT(0U, context.vsync_period_ns);
+    EXPECT_EQ(context.vsync_timestamp_ns + context.vsync_period_ns,
+              context.next_vsync_timestamp_ns);
+    EXPECT_LT(0U, context.display_width);
+    EXPECT_LT(0U, context.display_height);
+  }
+
+  dvrFrameContextReaderDestroy(reader);
+}
+
 }  // namespace
 
 }  // namespace dvr
@@ -112,6 +112,7 @@ typedef std::uint8_t EncodingType;
 enum EncodingExtType : int8_t {
   ENCODING_EXT_TYPE_FILE_DESCRIPTOR,
   ENCODING_EXT_TYPE_CHANNEL_HANDLE,
+  ENCODING_EXT_TYPE_RAW_DATA,
 };
 
 // Encoding predicates. Determines whether the given encoding is of a specific
@@ -271,6 +272,22 @@ inline constexpr bool IsFixextEncoding(EncodingType encoding) {
   }
 }
 
+inline constexpr bool IsExtEncoding(EncodingType encoding) {
+  switch (encoding) {
+    case ENCODING_TYPE_FIXEXT1:
+    case ENCODING_TYPE_FIXEXT2:
+    case ENCODING_TYPE_FIXEXT4:
+    case ENCODING_TYPE_FIXEXT8:
+    case ENCODING_TYPE_FIXEXT16:
+    case ENCODING_TYPE_EXT8:
+    case ENCODING_TYPE_EXT16:
+    case ENCODING_TYPE_EXT32:
+      return true;
+    default:
+      return false;
+  }
+}
+
 inline constexpr bool IsFloat32Encoding(EncodingType encoding) {
   switch (encoding) {
     case ENCODING_TYPE_FLOAT32:
@@ -514,6 +531,28 @@ inline constexpr EncodingType EncodeType(
   return ENCODING_TYPE_FIXEXT4;
 }
 
+// Objects that can be copied as they are in memory are encoded as an extension
+// type of ENCODING_EXT_TYPE_RAW_DATA with their bytes as the payload, using a
+// FIXEXT encoding when the size allows for one.
+inline constexpr EncodingType EncodeRawDataType(std::size_t size) {
+  if (size == 1)
+    return ENCODING_TYPE_FIXEXT1;
+  else if (size == 2)
+    return ENCODING_TYPE_FIXEXT2;
+  else if (size == 4)
+    return ENCODING_TYPE_FIXEXT4;
+  else if (size == 8)
+    return ENCODING_TYPE_FIXEXT8;
+  else if (size == 16)
+    return ENCODING_TYPE_FIXEXT16;
+  else if (size < (1U << 8))
+    return ENCODING_TYPE_EXT8;
+  else if (size < (1U << 16))
+    return ENCODING_TYPE_EXT16;
+  else
+    return ENCODING_TYPE_EXT32;
+}
+
 inline constexpr EncodingType EncodeType(const bool& value) {
   return value ? ENCODING_TYPE_TRUE : ENCODING_TYPE_FALSE;
 }
@@ -4,6 +4,7 @@
 #include <cstddef>
 #include <string>
 #include <tuple>
+#include <type_traits>
 
 #include <pdx/message_reader.h>
 #include <pdx/message_writer.h>
@@ -35,6 +36,9 @@ struct MemberPointer<Type Class::*, Pointer> {
   // Type of the member pointer this type represents.
   using PointerType = Type Class::*;
 
+  // Type of the member this type points to.
+  using MemberType = Type;
+
   // Resolves a pointer to member with the given instance, yielding a
   // reference to the member in that instance.
   static Type& Resolve(Class& instance) { return (instance.*Pointer); }
@@ -61,6 +65,28 @@ struct SerializableMembersType {
   using At = typename std::tuple_element<Index, Members>::type;
 };
 
+// Determines whether the members described by the parameter pack
+// MemberPointers are all raw serializable, and how many bytes they take up.
+template <typename... MemberPointers>
+struct RawMembers {
+  enum : bool { IsRaw = true };
+  enum : std::size_t { Size = 0 };
+};
+template <typename MemberPointer, typename... MemberPointers>
+struct RawMembers<MemberPointer, MemberPointers...> {
+  using MemberType = typename MemberPointer::MemberType;
+  enum : bool {
+    IsRaw = IsRawSerializable<MemberType>::value &&
+            RawMembers<MemberPointers...>::IsRaw
+  };
+  enum : std::size_t {
+    Size = sizeof(MemberType) + RawMembers<MemberPointers...>::Size
+  };
+};
+template <typename T, typename... MemberPointers>
+struct RawMembers<SerializableMembersType<T, MemberPointers...>>
+    : RawMembers<MemberPointers...> {};
+
 // Classes must do the following to correctly define a serializable type:
 //     1. Define a type called "SerializableMembers" as a template instantiation
 //        of SerializableMembersType, describing the members of the class to
@@ -87,26 +113,66 @@ struct SerializableMembersType {
 //
 // Note that const and static member serialization is not supported.
 
+//
+// Types whose serializable members are all arithmetic types (other than bool),
+// std::arrays of them, or other such types, and which have no padding or
+// members left out, are copied as one block of raw data instead of member by
+// member. Deserialization accepts either form.
+
 template <typename T>
 class SerializableTraits {
  public:
+  // Whether type T is serialized as raw data.
+  static constexpr bool IsRaw() {
+    return std::is_trivially_copyable<T>::value &&
+           RawMembers<SerializableMembers>::IsRaw &&
+           RawMembers<SerializableMembers>::Size == sizeof(T);
+  }
+
   // Gets the serialized size of type T.
   static std::size_t GetSerializedSize(const T& value) {
-    return GetEncodingSize(EncodeArrayType(SerializableMembers::MemberCount)) +
-           GetMembersSize<SerializableMembers>(value);
+    return GetSerializedSize(value, std::integral_constant<bool, IsRaw()>{});
   }
 
   // Serializes type T.
   static void SerializeObject(const T& value, MessageWriter* writer,
                               void*& buffer) {
+    SerializeObject(value, writer, buffer,
+                    std::integral_constant<bool, IsRaw()>{});
+  }
+
+  // Deserializes type T.
+  static ErrorType DeserializeObject(T* value, MessageReader* reader,
+                                     const void*& start, const void* end) {
+    return DeserializeObject(value, reader, start, end,
+                             std::integral_constant<bool, IsRaw()>{});
+  }
+
+ private:
+  using SerializableMembers = typename T::SerializableMembers;
+
+  static std::size_t GetSerializedSize(const T& value, std::false_type) {
+    return GetEncodingSize(EncodeArrayType(SerializableMembers::MemberCount)) +
+           GetMembersSize<SerializableMembers>(value);
+  }
+  static std::size_t GetSerializedSize(const T& /*value*/, std::true_type) {
+    return GetRawDataSize(sizeof(T));
+  }
+
+  static void SerializeObject(const T& value, MessageWriter* writer,
+                              void*& buffer, std::false_type) {
     SerializeArrayEncoding(EncodeArrayType(SerializableMembers::MemberCount),
                            SerializableMembers::MemberCount, buffer);
     SerializeMembers<SerializableMembers>(value, writer, buffer);
   }
+  static void SerializeObject(const T& value, MessageWriter* /*writer*/,
+                              void*& buffer, std::true_type) {
+    SerializeRawData(&value, 1, buffer);
+  }
 
-  // Deserializes type T.
   static ErrorType DeserializeObject(T* value, MessageReader* reader,
-                                     const void*& start, const void* end) {
+                                     const void*& start, const void* end,
+                                     std::false_type) {
     EncodingType encoding;
     std::size_t size;
 
@@ -119,9 +185,26 @@ class SerializableTraits {
       return DeserializeMembers<SerializableMembers>(value, reader, start, end);
     }
   }
+  static ErrorType DeserializeObject(T* value, MessageReader* reader,
+                                     const void*& start, const void* end,
+                                     std::true_type) {
+    EncodingType encoding;
+    std::size_t size;
+    bool raw;
 
- private:
-  using SerializableMembers = typename T::SerializableMembers;
+    if (const auto error = DeserializeRawOrArrayType<T>(&encoding, &size, &raw,
+                                                        reader, start, end)) {
+      return error;
+    } else if (raw) {
+      if (size != 1)
+        return ErrorCode::UNEXPECTED_TYPE_SIZE;
+      return ReadRawData(value, reader, start, end, sizeof(T));
+    } else if (size != SerializableMembers::MemberCount) {
+      return ErrorCode::UNEXPECTED_TYPE_SIZE;
+    } else {
+      return DeserializeMembers<SerializableMembers>(value, reader, start, end);
+    }
+  }
 };
 
 // Utility macro to define a MemberPointer type for a member name.
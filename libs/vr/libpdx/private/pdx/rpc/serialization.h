@@ -1,6 +1,7 @@
 #ifndef ANDROID_PDX_RPC_SERIALIZATION_H_
 #define ANDROID_PDX_RPC_SERIALIZATION_H_
 
+#include <array>
 #include <cstdint>
 #include <cstring>
 #include <iterator>
@@ -60,6 +61,10 @@ namespace rpc {
 //   * StringWrapper of any supported char type.
 //   * User types with correctly defined SerializableMembers member type.
 //
+// Arrays of arithmetic types wider than a byte, and user types made of nothing
+// but such members and arrays of them, are copied as they are in memory
+// instead of element by element. See IsRawSerializable below.
+//
 // Planned support for:
 //   * std::basic_string with all supported char types.
 
@@ -111,6 +116,31 @@ template <typename T, typename ReturnType = void>
 using EnableIfEnum =
     typename std::enable_if<std::is_enum<T>::value, ReturnType>::type;
 
+// Determines whether objects of type T can be serialized by copying their
+// memory: arithmetic types other than bool, std::array of those types, and
+// user types whose serializable members are all raw serializable and make up
+// the whole object, with no padding or members left out.
+template <typename T, typename Enabled = void>
+struct IsRawSerializable
+    : std::integral_constant<bool, std::is_arithmetic<T>::value &&
+                                       !std::is_same<T, bool>::value> {};
+template <typename T, std::size_t Size>
+struct IsRawSerializable<std::array<T, Size>>
+    : std::integral_constant<bool, IsRawSerializable<T>::value &&
+                                       sizeof(std::array<T, Size>) ==
+                                           Size * sizeof(T)> {};
+template <typename T>
+struct IsRawSerializable<T, EnableIfHasSerializableMembers<T>>
+    : std::integral_constant<bool, SerializableTraits<T>::IsRaw()> {};
+
+// Determines whether arrays of T are serialized as a single block of raw data.
+// Arrays of bytes keep the array encoding, where most elements take no more
+// room than they do in memory.
+template <typename T>
+using IsRawArrayElement =
+    std::integral_constant<bool,
+                           IsRawSerializable<T>::value && (sizeof(T) > 1)>;
+
 ///////////////////////////////////////////////////////////////////////////////
 // Error Reporting //
 ///////////////////////////////////////////////////////////////////////////////
@@ -341,14 +371,34 @@ inline constexpr std::size_t GetSerializedSize(
   return GetEncodingSize(EncodeType(channel_handle)) + sizeof(std::int32_t);
 }
 
-// Overload for standard vector types.
-template <typename T, typename Allocator>
-inline std::size_t GetSerializedSize(const std::vector<T, Allocator>& v) {
+// Gets the size of raw data of the given size, including the extension type
+// that GetEncodingSize() only counts for FIXEXT encodings.
+inline constexpr std::size_t GetRawDataSize(std::size_t size) {
+  return GetEncodingSize(EncodeRawDataType(size)) +
+         (IsFixextEncoding(EncodeRawDataType(size)) ? 0
+                                                    : sizeof(EncodingExtType)) +
+         size;
+}
+
+// Gets the size of array types, element by element or as raw data.
+template <typename ArrayType>
+inline std::size_t GetArraySize(const ArrayType& v, std::false_type) {
+  using T = typename ArrayType::value_type;
   return std::accumulate(v.begin(), v.end(), GetEncodingSize(EncodeType(v)),
                          [](const std::size_t& sum, const T& object) {
                            return sum + GetSerializedSize(object);
                          });
 }
+template <typename ArrayType>
+inline std::size_t GetArraySize(const ArrayType& v, std::true_type) {
+  return GetRawDataSize(v.size() * sizeof(typename ArrayType::value_type));
+}
+
+// Overload for standard vector types.
+template <typename T, typename Allocator>
+inline std::size_t GetSerializedSize(const std::vector<T, Allocator>& v) {
+  return GetArraySize(v, IsRawArrayElement<T>{});
+}
 
 // Overload for standard map types.
 template <typename Key, typename T, typename Compare, typename Allocator>
@@ -378,19 +428,13 @@ inline std::size_t GetSerializedSize(
 // Overload for ArrayWrapper types.
 template <typename T>
 inline std::size_t GetSerializedSize(const ArrayWrapper<T>& v) {
-  return std::accumulate(v.begin(), v.end(), GetEncodingSize(EncodeType(v)),
-                         [](const std::size_t& sum, const T& object) {
-                           return sum + GetSerializedSize(object);
-                         });
+  return GetArraySize(v, IsRawArrayElement<T>{});
 }
 
 // Overload for std::array types.
 template <typename T, std::size_t Size>
 inline std::size_t GetSerializedSize(const std::array<T, Size>& v) {
-  return std::accumulate(v.begin(), v.end(), GetEncodingSize(EncodeType(v)),
-                         [](const std::size_t& sum, const T& object) {
-                           return sum + GetSerializedSize(object);
-                         });
+  return GetArraySize(v, IsRawArrayElement<T>{});
 }
 
 // Overload for std::pair.
@@ -495,6 +539,15 @@ inline void SerializeExtEncoding(EncodingType encoding,
   SerializeRaw(ext_type, buffer);
 }
 
+// Serializes objects as raw data, copying their memory as it is.
+template <typename T>
+inline void SerializeRawData(const T* data, std::size_t count, void*& buffer) {
+  const std::size_t size = count * sizeof(T);
+  SerializeExtEncoding(EncodeRawDataType(size), ENCODING_EXT_TYPE_RAW_DATA,
+                       size, buffer);
+  WriteRawData(buffer, data, size);
+}
+
 // Serializes the type code for file descriptor types.
 template <FileHandleMode Mode>
 inline void SerializeType(const FileHandle<Mode>& value, void*& buffer) {
@@ -959,14 +1012,26 @@ inline void SerializeObject(const StringWrapper<T>& s,
   SerializeString(s, buffer);
 }
 
-// Serializes the payload of array types.
+// Serializes the payload of array types, element by element or as raw data.
 template <typename ArrayType>
 inline void SerializeArray(const ArrayType& v, MessageWriter* writer,
-                           void*& buffer) {
+                           void*& buffer, std::false_type) {
   SerializeType(v, buffer);
   for (const auto& element : v)
     SerializeObject(element, writer, buffer);
 }
+template <typename ArrayType>
+inline void SerializeArray(const ArrayType& v, MessageWriter* /*writer*/,
+                           void*& buffer, std::true_type) {
+  SerializeRawData(v.data(), v.size(), buffer);
+}
+template <typename ArrayType>
+inline void SerializeArray(const ArrayType& v, MessageWriter* writer,
+                           void*& buffer) {
+  SerializeArray(
+      v, writer, buffer,
+      IsRawArrayElement<typename ArrayType::value_type>{});
+}
 
 // Serializes the payload for map types.
 template <typename MapType>
@@ -1452,36 +1517,46 @@ inline ErrorType DeserializeObject(PointerWrapper<T>* pointer,
   return DeserializeObject(&pointer->Dereference(), reader, start, end);
 }
 
-// Deserializes the type code and size for extension types.
-inline ErrorType DeserializeExtType(EncodingType* encoding,
+// Deserializes the size and type code for extension types, given their
+// encoding.
+inline ErrorType DeserializeExtSize(EncodingType encoding,
                                     EncodingExtType* type, std::size_t* size,
                                     MessageReader* reader, const void*& start,
                                     const void*& end) {
-  if (const auto error = DeserializeEncoding(encoding, reader, start, end)) {
-    return error;
-  } else if (IsFixextEncoding(*encoding)) {
-    *size = GetFixextSize(*encoding);
-  } else if (*encoding == ENCODING_TYPE_EXT8) {
+  if (IsFixextEncoding(encoding)) {
+    *size = GetFixextSize(encoding);
+  } else if (encoding == ENCODING_TYPE_EXT8) {
     if (const auto error =
             DeserializeValue<std::uint8_t>(size, reader, start, end))
       return error;
-  } else if (*encoding == ENCODING_TYPE_EXT16) {
+  } else if (encoding == ENCODING_TYPE_EXT16) {
     if (const auto error =
             DeserializeValue<std::uint16_t>(size, reader, start, end))
       return error;
-  } else if (*encoding == ENCODING_TYPE_EXT32) {
+  } else if (encoding == ENCODING_TYPE_EXT32) {
     if (const auto error =
             DeserializeValue<std::uint32_t>(size, reader, start, end))
       return error;
   } else {
     return ErrorType(ErrorCode::UNEXPECTED_ENCODING, ENCODING_CLASS_EXTENSION,
-                     *encoding);
+                     encoding);
   }
 
   // The extension type code follows the encoding and size.
   return DeserializeRaw(type, reader, start, end);
 }
 
+// Deserializes the type code and size for extension types.
+inline ErrorType DeserializeExtType(EncodingType* encoding,
+                                    EncodingExtType* type, std::size_t* size,
+                                    MessageReader* reader, const void*& start,
+                                    const void*& end) {
+  if (const auto error = DeserializeEncoding(encoding, reader, start, end))
+    return error;
+  else
+    return DeserializeExtSize(*encoding, type, size, reader, start, end);
+}
+
 // Deserializes a file handle and performs handle space translation, if
 // required.
 inline ErrorType DeserializeObject(LocalHandle* value, MessageReader* reader,
@@ -1672,22 +1747,66 @@ inline ErrorType DeserializeObject(StringWrapper<T>* value,
   }
 }
 
-// Deserializes the type code and size of array types.
-inline ErrorType DeserializeArrayType(EncodingType* encoding, std::size_t* size,
+// Deserializes the size of array types, given their encoding.
+inline ErrorType DeserializeArraySize(EncodingType encoding, std::size_t* size,
                                       MessageReader* reader, const void*& start,
                                       const void*& end) {
-  if (const auto error = DeserializeEncoding(encoding, reader, start, end)) {
-    return error;
-  } else if (IsFixarrayEncoding(*encoding)) {
-    *size = GetFixarraySize(*encoding);
+  if (IsFixarrayEncoding(encoding)) {
+    *size = GetFixarraySize(encoding);
     return ErrorCode::NO_ERROR;
-  } else if (*encoding == ENCODING_TYPE_ARRAY16) {
+  } else if (encoding == ENCODING_TYPE_ARRAY16) {
     return DeserializeValue<std::uint16_t>(size, reader, start, end);
-  } else if (*encoding == ENCODING_TYPE_ARRAY32) {
+  } else if (encoding == ENCODING_TYPE_ARRAY32) {
     return DeserializeValue<std::uint32_t>(size, reader, start, end);
   } else {
     return ErrorType(ErrorCode::UNEXPECTED_ENCODING, ENCODING_CLASS_ARRAY,
+                     encoding);
+  }
+}
+
+// Deserializes the type code and size of array types.
+inline ErrorType DeserializeArrayType(EncodingType* encoding, std::size_t* size,
+                                      MessageReader* reader, const void*& start,
+                                      const void*& end) {
+  if (const auto error = DeserializeEncoding(encoding, reader, start, end))
+    return error;
+  else
+    return DeserializeArraySize(*encoding, size, reader, start, end);
+}
+
+// Deserializes the type code and size of types that are either raw data of
+// objects of type T, or an array. Raw data sets |raw| and yields the number of
+// objects of type T in |size|; an array yields its number of elements.
+template <typename T>
+inline ErrorType DeserializeRawOrArrayType(EncodingType* encoding,
+                                           std::size_t* size, bool* raw,
+                                           MessageReader* reader,
+                                           const void*& start,
+                                           const void*& end) {
+  if (const auto error = DeserializeEncoding(encoding, reader, start, end))
+    return error;
+
+  *raw = IsExtEncoding(*encoding);
+  if (!*raw)
+    return DeserializeArraySize(*encoding, size, reader, start, end);
+
+  EncodingExtType type;
+  std::size_t raw_size;
+  if (const auto error =
+          DeserializeExtSize(*encoding, &type, &raw_size, reader, start, end)) {
+    return error;
+  } else if (type != ENCODING_EXT_TYPE_RAW_DATA) {
+    return ErrorType(ErrorCode::UNEXPECTED_ENCODING, ENCODING_CLASS_EXTENSION,
+                     *encoding);
+  } else if (raw_size % sizeof(T) != 0) {
+    return ErrorType(ErrorCode::UNEXPECTED_TYPE_SIZE, ENCODING_CLASS_EXTENSION,
                      *encoding);
+  } else if (PDX_UNLIKELY(AdvancePointer(start, raw_size) > end)) {
+    // Don't let a bogus size grow the destination.
+    return ErrorCode::INSUFFICIENT_BUFFER;
+  } else {
+    *size = raw_size / sizeof(T);
+    return ErrorCode::NO_ERROR;
   }
 }
 
@@ -1710,11 +1829,42 @@ inline ErrorType DeserializeMapType(EncodingType* encoding, std::size_t* size,
   }
 }
 
-// Overload for std::vector types.
+// Deserializes std::vector types whose elements may be raw data.
 template <typename T, typename Allocator>
-inline ErrorType DeserializeObject(std::vector<T, Allocator>* value,
+inline ErrorType DeserializeVector(std::vector<T, Allocator>* value,
                                    MessageReader* reader, const void*& start,
-                                   const void*& end) {
+                                   const void*& end, std::true_type) {
+  EncodingType encoding;
+  std::size_t size;
+  bool raw;
+
+  if (const auto error = DeserializeRawOrArrayType<T>(&encoding, &size, &raw,
+                                                      reader, start, end))
+    return error;
+
+  std::vector<T, Allocator> result(size);
+  if (raw) {
+    if (size > 0) {
+      if (const auto error = ReadRawData(result.data(), reader, start, end,
+                                         size * sizeof(T)))
+        return error;
+    }
+  } else {
+    for (std::size_t i = 0; i < size; i++) {
+      if (const auto error = DeserializeObject(&result[i], reader, start, end))
+        return error;
+    }
+  }
+
+  *value = std::move(result);
+  return ErrorCode::NO_ERROR;
+}
+
+// Deserializes std::vector types element by element.
+template <typename T, typename Allocator>
+inline ErrorType DeserializeVector(std::vector<T, Allocator>* value,
+                                   MessageReader* reader, const void*& start,
+                                   const void*& end, std::false_type) {
   EncodingType encoding;
   std::size_t size;
 
@@ -1742,6 +1892,14 @@ inline ErrorType DeserializeObject(std::vector<T, Allocator>* value,
 #endif
 }
 
+// Overload for std::vector types.
+template <typename T, typename Allocator>
+inline ErrorType DeserializeObject(std::vector<T, Allocator>* value,
+                                   MessageReader* reader, const void*& start,
+                                   const void*& end) {
+  return DeserializeVector(value, reader, start, end, IsRawArrayElement<T>{});
+}
+
 // Deserializes an EmptyVariant value.
 inline ErrorType DeserializeObject(EmptyVariant* /*empty*/,
                                    MessageReader* reader, const void*& start,
@@ -1834,6 +1992,50 @@ inline ErrorType DeserializeObject(
   return DeserializeMap(value, reader, start, end);
 }
 
+// Deserializes the type code and size of fixed storage array types,
+// reading array types element by element.
+template <typename T>
+inline ErrorType DeserializeArrayStorageType(EncodingType* encoding,
+                                             std::size_t* size, bool* raw,
+                                             MessageReader* reader,
+                                             const void*& start,
+                                             const void*& end,
+                                             std::false_type) {
+  *raw = false;
+  return DeserializeArrayType(encoding, size, reader, start, end);
+}
+
+// Deserializes the type code and size of fixed storage array types, whose
+// elements may be raw data.
+template <typename T>
+inline ErrorType DeserializeArrayStorageType(EncodingType* encoding,
+                                             std::size_t* size, bool* raw,
+                                             MessageReader* reader,
+                                             const void*& start,
+                                             const void*& end, std::true_type) {
+  return DeserializeRawOrArrayType<T>(encoding, size, raw, reader, start, end);
+}
+
+// Deserializes the elements of fixed storage array types, once their storage
+// has been sized.
+template <typename T>
+inline ErrorType DeserializeArrayStorage(T* data, std::size_t size, bool raw,
+                                         MessageReader* reader,
+                                         const void*& start, const void*& end) {
+  if (raw) {
+    if (size == 0)
+      return ErrorCode::NO_ERROR;
+    return ReadRawData(data, reader, start, end, size * sizeof(T));
+  }
+
+  for (std::size_t i = 0; i < size; i++) {
+    if (const auto error = DeserializeObject(&data[i], reader, start, end))
+      return error;
+  }
+
+  return ErrorCode::NO_ERROR;
+}
+
 // Overload for ArrayWrapper types.
 template <typename T>
 inline ErrorType DeserializeObject(ArrayWrapper<T>* value,
@@ -1841,9 +2043,10 @@ inline ErrorType DeserializeObject(ArrayWrapper<T>* value,
                                    const void*& end) {
   EncodingType encoding;
   std::size_t size;
+  bool raw;
 
-  if (const auto error =
-          DeserializeArrayType(&encoding, &size, reader, start, end)) {
+  if (const auto error = DeserializeArrayStorageType<T>(
+          &encoding, &size, &raw, reader, start, end, IsRawArrayElement<T>{})) {
     return error;
   }
 
@@ -1855,12 +2058,7 @@ inline ErrorType DeserializeObject(ArrayWrapper<T>* value,
   if (size > value->capacity())
     return ErrorCode::INSUFFICIENT_DESTINATION_SIZE;
 
-  for (std::size_t i = 0; i < size; i++) {
-    if (const auto error = DeserializeObject(&(*value)[i], reader, start, end))
-      return error;
-  }
-
-  return ErrorCode::NO_ERROR;
+  return DeserializeArrayStorage(value->data(), size, raw, reader, start, end);
 }
 
 // Overload for std::array types.
@@ -1870,21 +2068,17 @@ inline ErrorType DeserializeObject(std::array<T, Size>* value,
                                    const void*& end) {
   EncodingType encoding;
   std::size_t size;
+  bool raw;
 
-  if (const auto error =
-          DeserializeArrayType(&encoding, &size, reader, start, end)) {
+  if (const auto error = DeserializeArrayStorageType<T>(
+          &encoding, &size, &raw, reader, start, end, IsRawArrayElement<T>{})) {
     return error;
   }
 
   if (size != Size)
     return ErrorCode::INSUFFICIENT_DESTINATION_SIZE;
 
-  for (std::size_t i = 0; i < size; i++) {
-    if (const auto error = DeserializeObject(&(*value)[i], reader, start, end))
-      return error;
-  }
-
-  return ErrorCode::NO_ERROR;
+  return DeserializeArrayStorage(value->data(), size, raw, reader, start, end);
 }
 
 // Deserializes std::pair types.
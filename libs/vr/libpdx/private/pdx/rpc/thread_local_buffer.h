@@ -1,6 +1,8 @@
 #ifndef ANDROID_PDX_RPC_THREAD_LOCAL_BUFFER_H_
 #define ANDROID_PDX_RPC_THREAD_LOCAL_BUFFER_H_
 
+#include <algorithm>
+#include <atomic>
 #include <cstdint>
 #include <memory>
 #include <vector>
@@ -35,9 +37,113 @@ using SendBuffer = ThreadLocalIndexSlot<0>;
 using ReceiveBuffer = ThreadLocalIndexSlot<1>;
 using ReplyBuffer = ThreadLocalIndexSlot<2>;
 
+// Number of messages after which a buffer that grew past its initial capacity
+// is trimmed to the size class of the largest of those messages.
+constexpr std::size_t BufferTrimInterval = 64;
+
+// Process-wide accounting of the memory held by thread local buffers. Buffers
+// are accounted at message boundaries, when they are handed out empty for the
+// next message, since they grow freely while a message is built.
+class ThreadLocalBufferStats {
+ public:
+  struct Snapshot {
+    // Bytes held by all the thread local buffers, now and at most.
+    std::size_t retained_bytes;
+    std::size_t peak_retained_bytes;
+    // Sizes of the messages that went through the buffers.
+    std::size_t peak_message_bytes;
+    std::size_t average_message_bytes;
+    std::size_t message_count;
+    // Number of times a buffer was trimmed back after growing.
+    std::size_t trim_count;
+  };
+
+  static Snapshot GetSnapshot() {
+    const Counters& counters = GetCounters();
+    Snapshot snapshot;
+    snapshot.retained_bytes = counters.retained_bytes.load();
+    snapshot.peak_retained_bytes = counters.peak_retained_bytes.load();
+    snapshot.peak_message_bytes = counters.peak_message_bytes.load();
+    snapshot.message_count = counters.message_count.load();
+    snapshot.average_message_bytes =
+        snapshot.message_count
+            ? counters.total_message_bytes.load() / snapshot.message_count
+            : 0;
+    snapshot.trim_count = counters.trim_count.load();
+    return snapshot;
+  }
+
+  // Sets how many bytes the thread local buffers of this process may hold
+  // before any buffer that grew is trimmed back to its initial capacity as soon
+  // as it is reused. Zero, the default, sets no budget.
+  static void SetBudget(std::size_t bytes) { GetCounters().budget = bytes; }
+  static std::size_t GetBudget() { return GetCounters().budget.load(); }
+
+  static bool IsOverBudget() {
+    const Counters& counters = GetCounters();
+    const std::size_t budget = counters.budget.load(std::memory_order_relaxed);
+    return budget != 0 &&
+           counters.retained_bytes.load(std::memory_order_relaxed) > budget;
+  }
+
+  static void UpdateRetained(std::size_t old_bytes, std::size_t new_bytes) {
+    Counters& counters = GetCounters();
+    if (new_bytes >= old_bytes) {
+      const std::size_t retained =
+          counters.retained_bytes.fetch_add(new_bytes - old_bytes,
+                                            std::memory_order_relaxed) +
+          new_bytes - old_bytes;
+      UpdateMax(&counters.peak_retained_bytes, retained);
+    } else {
+      counters.retained_bytes.fetch_sub(old_bytes - new_bytes,
+                                        std::memory_order_relaxed);
+    }
+  }
+
+  static void RecordMessage(std::size_t bytes) {
+    Counters& counters = GetCounters();
+    counters.total_message_bytes.fetch_add(bytes, std::memory_order_relaxed);
+    counters.message_count.fetch_add(1, std::memory_order_relaxed);
+    UpdateMax(&counters.peak_message_bytes, bytes);
+  }
+
+  static void RecordTrim() {
+    GetCounters().trim_count.fetch_add(1, std::memory_order_relaxed);
+  }
+
+ private:
+  struct Counters {
+    std::atomic<std::size_t> budget{0};
+    std::atomic<std::size_t> retained_bytes{0};
+    std::atomic<std::size_t> peak_retained_bytes{0};
+    std::atomic<std::size_t> total_message_bytes{0};
+    std::atomic<std::size_t> message_count{0};
+    std::atomic<std::size_t> peak_message_bytes{0};
+    std::atomic<std::size_t> trim_count{0};
+  };
+
+  static Counters& GetCounters() {
+    static Counters counters;
+    return counters;
+  }
+
+  static void UpdateMax(std::atomic<std::size_t>* max, std::size_t value) {
+    std::size_t current = max->load(std::memory_order_relaxed);
+    while (value > current &&
+           !max->compare_exchange_weak(current, value,
+                                       std::memory_order_relaxed)) {
+    }
+  }
+};
+
 // Provides a simple interface to thread local buffers for large IPC messages.
 // Slot provides multiple thread local slots for a given T, Allocator, Capacity
 // combination.
+//
+// Buffers grow in power of two size classes past Capacity. A buffer that grew
+// for a large message is trimmed back when the messages that follow no longer
+// need the room, or right away when the process is over its budget (see
+// ThreadLocalBufferStats).
 template <typename T, typename Allocator = DefaultInitializationAllocator<T>,
           std::size_t Capacity = InitialBufferCapacity,
           typename Slot = ThreadLocalSlot<void, 0>>
@@ -51,7 +157,8 @@ class ThreadLocalBuffer {
   static void Reserve(std::size_t capacity) {
     PDX_TRACE_NAME("ThreadLocalBuffer::Reserve");
     InitializeBuffer(capacity);
-    buffer_->reserve(capacity);
+    if (capacity > buffer_->capacity())
+      buffer_->reserve(GetSizeClass(capacity));
   }
 
   // Resizes the buffer to |size| elements.
@@ -75,6 +182,8 @@ class ThreadLocalBuffer {
   // reference is valid until FreeBuffer() is called.
   static BufferType& GetEmptyBuffer() {
     PDX_TRACE_NAME("ThreadLocalBuffer::GetEmptyBuffer");
+    if (buffer_)
+      Recycle();
     Reserve(Capacity);
     buffer_->clear();
     return *buffer_;
@@ -102,9 +211,64 @@ class ThreadLocalBuffer {
   static void InitializeBuffer(std::size_t capacity) {
     if (!buffer_) {
       GetBufferGuard().reset(buffer_ = new BufferType(capacity));
+      Account();
     }
   }
 
+  // Rounds |capacity| up to the size class it falls in.
+  static std::size_t GetSizeClass(std::size_t capacity) {
+    std::size_t size_class = std::max<std::size_t>(Capacity, 1);
+    while (size_class < capacity && size_class <= SIZE_MAX / 2)
+      size_class *= 2;
+    return std::max(size_class, capacity);
+  }
+
+  // Updates the process-wide accounting with the current capacity.
+  static void Account() {
+    const std::size_t capacity = buffer_->capacity();
+    ThreadLocalBufferStats::UpdateRetained(accounted_capacity_ * sizeof(T),
+                                           capacity * sizeof(T));
+    accounted_capacity_ = capacity;
+  }
+
+  // Records the message the buffer held and trims the buffer if it holds more
+  // than recent messages need.
+  static void Recycle() {
+    const std::size_t size = buffer_->size();
+    ThreadLocalBufferStats::RecordMessage(size * sizeof(T));
+    recent_peak_ = std::max(recent_peak_, size);
+
+    const std::size_t capacity = buffer_->capacity();
+    if (capacity > Capacity) {
+      const bool over_budget = ThreadLocalBufferStats::IsOverBudget();
+      if (over_budget || ++recent_count_ >= BufferTrimInterval) {
+        const std::size_t target =
+            over_budget ? Capacity : GetSizeClass(recent_peak_);
+        if (target < capacity) {
+          BufferType trimmed;
+          trimmed.reserve(target);
+          buffer_->swap(trimmed);
+          ThreadLocalBufferStats::RecordTrim();
+        }
+        recent_count_ = 0;
+        recent_peak_ = 0;
+      }
+    }
+    Account();
+  }
+
+  // Deletes buffers, including at thread exit, taking them off the accounting.
+  struct BufferDeleter {
+    void operator()(BufferType* buffer) const {
+      ThreadLocalBufferStats::UpdateRetained(accounted_capacity_ * sizeof(T),
+                                             0);
+      accounted_capacity_ = 0;
+      recent_count_ = 0;
+      recent_peak_ = 0;
+      delete buffer;
+    }
+  };
+
   // Work around performance issues with thread-local dynamic initialization
   // semantics by using a normal pointer in parallel with a std::unique_ptr. The
   // std::unique_ptr is never dereferenced, only assigned, to avoid the high
@@ -114,9 +278,15 @@ class ThreadLocalBuffer {
   // by slow implementations of TLS dynamic initialization.
   static thread_local BufferType* buffer_;
 
-  static std::unique_ptr<BufferType>& GetBufferGuard() {
+  // Capacity last accounted for, and the number and largest size of the
+  // messages since the buffer was last considered for trimming.
+  static thread_local std::size_t accounted_capacity_;
+  static thread_local std::size_t recent_count_;
+  static thread_local std::size_t recent_peak_;
+
+  static std::unique_ptr<BufferType, BufferDeleter>& GetBufferGuard() {
     PDX_TRACE_NAME("ThreadLocalBuffer::GetBufferGuard");
-    static thread_local std::unique_ptr<BufferType> buffer_guard;
+    static thread_local std::unique_ptr<BufferType, BufferDeleter> buffer_guard;
     return buffer_guard;
   }
 };
@@ -127,6 +297,16 @@ thread_local
     typename ThreadLocalBuffer<T, Allocator, Capacity, Slot>::BufferType*
         ThreadLocalBuffer<T, Allocator, Capacity, Slot>::buffer_;
 
+template <typename T, typename Allocator, std::size_t Capacity, typename Slot>
+thread_local std::size_t
+    ThreadLocalBuffer<T, Allocator, Capacity, Slot>::accounted_capacity_;
+template <typename T, typename Allocator, std::size_t Capacity, typename Slot>
+thread_local std::size_t
+    ThreadLocalBuffer<T, Allocator, Capacity, Slot>::recent_count_;
+template <typename T, typename Allocator, std::size_t Capacity, typename Slot>
+thread_local std::size_t
+    ThreadLocalBuffer<T, Allocator, Capacity, Slot>::recent_peak_;
+
 }  // namespace rpc
 }  // namespace pdx
 }  // namespace android
@@ -615,6 +615,13 @@ class Service : public std::enable_shared_from_this<Service> {
    */
   Status<void> ReceiveAndDispatch();
 
+  /*
+   * Dispatches a message received on this Service instance's endpoint to the
+   * service it is addressed to. ReceiveAndDispatch() calls this on the message
+   * it received; ServiceDispatcher calls it from its worker threads.
+   */
+  Status<void> DispatchMessage(Message& message);
+
  private:
   friend class Message;
 
@@ -1,8 +1,11 @@
 #ifndef ANDROID_PDX_SERVICE_DISPATCHER_H_
 #define ANDROID_PDX_SERVICE_DISPATCHER_H_
 
+#include <atomic>
+#include <condition_variable>
 #include <memory>
 #include <mutex>
+#include <thread>
 #include <unordered_map>
 #include <vector>
 
@@ -17,12 +20,33 @@ class Service;
  * ServiceDispatcher manages a list of Service instances and handles message
  * reception and dispatch to the services. This makes repetitive dispatch tasks
  * easier to implement.
+ *
+ * By default messages are handled on the threads that receive them. A
+ * dispatcher created with worker threads instead hands each message it
+ * receives to a worker, so that a slow handler only holds up the channel it
+ * is handling: messages from one channel are handled in the order they were
+ * received, one at a time, while different channels are handled in parallel.
  */
 class ServiceDispatcher {
  public:
+  // Statistics of the worker queue of a dispatcher.
+  struct QueueStats {
+    // Messages waiting for a worker, now and at most.
+    size_t queued_messages;
+    size_t peak_queued_messages;
+    // Channels with messages waiting or being handled.
+    size_t active_channels;
+    // Messages handed to the workers so far.
+    size_t dispatched_messages;
+  };
+
   // Get a new instance of ServiceDispatcher, or return nullptr if init failed.
   static std::unique_ptr<ServiceDispatcher> Create();
 
+  // Same as above, handling messages on |worker_count| worker threads. Zero
+  // worker threads handle messages on the receiving threads.
+  static std::unique_ptr<ServiceDispatcher> Create(size_t worker_count);
+
   ~ServiceDispatcher();
 
   /*
@@ -80,13 +104,28 @@ class ServiceDispatcher {
    */
   bool IsCanceled() const;
 
+  /*
+   * Gets the statistics of the worker queue. These are all zero when the
+   * dispatcher has no worker threads.
+   */
+  QueueStats GetQueueStats() const;
+
  private:
-  ServiceDispatcher();
+  struct WorkQueue;
+
+  explicit ServiceDispatcher(size_t worker_count);
 
   // Internal thread accounting.
   int ThreadEnter();
   void ThreadExit();
 
+  // Receives a message for |service| and handles it, or queues it for the
+  // workers.
+  void Dispatch(Service* service);
+
+  // Handles queued messages until the work queue is shut down.
+  void WorkerLoop();
+
   std::mutex mutex_;
   std::condition_variable condition_;
   std::atomic<bool> canceled_{false};
@@ -97,6 +136,9 @@ class ServiceDispatcher {
   LocalHandle event_fd_;
   LocalHandle epoll_fd_;
 
+  std::unique_ptr<WorkQueue> work_queue_;
+  std::vector<std::thread> workers_;
+
   ServiceDispatcher(const ServiceDispatcher&) = delete;
   void operator=(const ServiceDispatcher&) = delete;
 };
@@ -65,6 +65,27 @@ struct TestType {
   PDX_SERIALIZABLE_MEMBERS(TestType, a, b, c, d);
 };
 
+struct TestRawType {
+  std::int32_t a;
+  float b;
+  std::array<std::int16_t, 2> c;
+
+  bool operator==(const TestRawType& other) const {
+    return a == other.a && b == other.b && c == other.c;
+  }
+
+ private:
+  PDX_SERIALIZABLE_MEMBERS(TestRawType, a, b, c);
+};
+
+// Appends the bytes of an object as it is laid out in memory.
+template <typename T>
+void AppendBytes(Payload* payload, const T& value) {
+  const auto bytes = reinterpret_cast<const std::uint8_t*>(&value);
+  for (std::size_t i = 0; i < sizeof(T); i++)
+    payload->Append(1, bytes[i]);
+}
+
 template <typename FileHandleType>
 struct TestTemplateType {
   FileHandleType fd;
@@ -1233,6 +1254,49 @@ TEST(SerializationTest, Serializable) {
   EXPECT_EQ(expected, result);
 }
 
+TEST(SerializationTest, RawData) {
+  Payload result;
+  Payload expected;
+
+  // Arrays of wider types are copied as they are.
+  std::vector<std::int32_t> v1{1, -2};
+  Serialize(v1, &result);
+  expected = {ENCODING_TYPE_FIXEXT8, ENCODING_EXT_TYPE_RAW_DATA};
+  AppendBytes(&expected, v1[0]);
+  AppendBytes(&expected, v1[1]);
+  EXPECT_EQ(expected, result);
+  EXPECT_EQ(expected.Size(), GetSerializedSize(v1));
+  result.Clear();
+
+  std::array<float, 3> a1{{1.f, 0.f, 1.f}};
+  Serialize(a1, &result);
+  expected = {ENCODING_TYPE_EXT8, 12, ENCODING_EXT_TYPE_RAW_DATA};
+  for (const auto& element : a1)
+    AppendBytes(&expected, element);
+  EXPECT_EQ(expected, result);
+  EXPECT_EQ(expected.Size(), GetSerializedSize(a1));
+  result.Clear();
+
+  // So are types made only of such members.
+  TestRawType t1{10, 1.f, {{-1, 2}}};
+  Serialize(t1, &result);
+  expected = {ENCODING_TYPE_EXT8, sizeof(TestRawType),
+              ENCODING_EXT_TYPE_RAW_DATA};
+  AppendBytes(&expected, t1);
+  EXPECT_EQ(expected, result);
+  EXPECT_EQ(expected.Size(), GetSerializedSize(t1));
+  result.Clear();
+
+  std::vector<TestRawType> v2{t1, t1};
+  Serialize(v2, &result);
+  expected = {ENCODING_TYPE_EXT8, 2 * sizeof(TestRawType),
+              ENCODING_EXT_TYPE_RAW_DATA};
+  AppendBytes(&expected, t1);
+  AppendBytes(&expected, t1);
+  EXPECT_EQ(expected, result);
+  EXPECT_EQ(expected.Size(), GetSerializedSize(v2));
+}
+
 TEST(SerializationTest, Variant) {
   Payload result;
   Payload expected;
@@ -2365,6 +2429,62 @@ TEST(DeserializationTest, Serializable) {
   EXPECT_EQ(TestTemplateType<LocalHandle>(LocalHandle(-1)), tt);
 }
 
+TEST(DeserializationTest, RawData) {
+  Payload buffer;
+  ErrorType error;
+
+  std::vector<std::int32_t> v1;
+  buffer = {ENCODING_TYPE_FIXEXT8, ENCODING_EXT_TYPE_RAW_DATA};
+  AppendBytes(&buffer, std::int32_t{1});
+  AppendBytes(&buffer, std::int32_t{-2});
+  error = Deserialize(&v1, &buffer);
+  EXPECT_EQ(ErrorCode::NO_ERROR, error);
+  EXPECT_EQ((std::vector<std::int32_t>{1, -2}), v1);
+
+  // The array form is still accepted.
+  buffer = {ENCODING_TYPE_FIXARRAY_MIN + 2, 1,
+            ENCODING_TYPE_NEGATIVE_FIXINT_MAX - 1};
+  error = Deserialize(&v1, &buffer);
+  EXPECT_EQ(ErrorCode::NO_ERROR, error);
+  EXPECT_EQ((std::vector<std::int32_t>{1, -2}), v1);
+
+  // Raw data must hold a whole number of elements.
+  buffer = {ENCODING_TYPE_FIXEXT2, ENCODING_EXT_TYPE_RAW_DATA, 0, 0};
+  error = Deserialize(&v1, &buffer);
+  EXPECT_EQ(ErrorCode::UNEXPECTED_TYPE_SIZE, error);
+
+  std::array<std::int32_t, 3> a1;
+  buffer = {ENCODING_TYPE_FIXEXT8, ENCODING_EXT_TYPE_RAW_DATA};
+  AppendBytes(&buffer, std::int32_t{1});
+  AppendBytes(&buffer, std::int32_t{-2});
+  error = Deserialize(&a1, &buffer);
+  EXPECT_EQ(ErrorCode::INSUFFICIENT_DESTINATION_SIZE, error);
+
+  const TestRawType expected{10, 1.f, {{-1, 2}}};
+  TestRawType t1;
+  buffer = {ENCODING_TYPE_EXT8, sizeof(TestRawType),
+            ENCODING_EXT_TYPE_RAW_DATA};
+  AppendBytes(&buffer, expected);
+  error = Deserialize(&t1, &buffer);
+  EXPECT_EQ(ErrorCode::NO_ERROR, error);
+  EXPECT_EQ(expected, t1);
+
+  TestRawType t2;
+  buffer = {ENCODING_TYPE_FIXARRAY_MIN + 3,
+            10,
+            ENCODING_TYPE_FLOAT32,
+            kOneFloatBytes[0],
+            kOneFloatBytes[1],
+            kOneFloatBytes[2],
+            kOneFloatBytes[3],
+            ENCODING_TYPE_FIXARRAY_MIN + 2,
+            ENCODING_TYPE_NEGATIVE_FIXINT_MAX,
+            2};
+  error = Deserialize(&t2, &buffer);
+  EXPECT_EQ(ErrorCode::NO_ERROR, error);
+  EXPECT_EQ(expected, t2);
+}
+
 TEST(DeserializationTest, Variant) {
   Payload buffer;
   ErrorType error;
@@ -5,6 +5,11 @@
 #include <sys/epoll.h>
 #include <sys/eventfd.h>
 
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <utility>
+
 #include <pdx/service.h>
 #include <pdx/service_endpoint.h>
 
@@ -13,8 +18,103 @@ static const int kMaxEventsPerLoop = 128;
 namespace android {
 namespace pdx {
 
+// Messages waiting for the worker threads, queued per channel. A channel stays
+// scheduled, either in |ready| or with one of its messages being handled, until
+// its last message has been handled, so that no two workers ever handle
+// messages from the same channel at once.
+struct ServiceDispatcher::WorkQueue {
+  using ChannelKey = std::pair<Service*, int>;
+
+  struct Channel {
+    std::deque<Message> messages;
+    bool scheduled = false;
+  };
+
+  // Queues |message|, received on the endpoint of |service|.
+  void Push(Service* service, Message&& message) {
+    std::lock_guard<std::mutex> autolock(mutex);
+    const ChannelKey key{service, message.GetChannelId()};
+    Channel& channel = channels[key];
+    channel.messages.push_back(std::move(message));
+    queued_messages++;
+    peak_queued_messages = std::max(peak_queued_messages, queued_messages);
+    if (!channel.scheduled) {
+      channel.scheduled = true;
+      ready.push_back(key);
+      condition.notify_one();
+    }
+  }
+
+  // Takes the next message of the next ready channel. Returns false when the
+  // queue is shut down.
+  bool Pop(ChannelKey* key, Message* message) {
+    std::unique_lock<std::mutex> lock(mutex);
+    condition.wait(lock, [this] { return exiting || !ready.empty(); });
+    if (exiting)
+      return false;
+
+    *key = ready.front();
+    ready.pop_front();
+    Channel& channel = channels[*key];
+    *message = std::move(channel.messages.front());
+    channel.messages.pop_front();
+    queued_messages--;
+    return true;
+  }
+
+  // Marks the message taken from the channel |key| as handled, scheduling the
+  // channel again if more messages arrived meanwhile.
+  void Done(const ChannelKey& key) {
+    std::lock_guard<std::mutex> autolock(mutex);
+    dispatched_messages++;
+    auto search = channels.find(key);
+    if (search == channels.end()) {
+      // The queue was shut down meanwhile.
+      return;
+    } else if (search->second.messages.empty()) {
+      channels.erase(search);
+    } else {
+      ready.push_back(key);
+      condition.notify_one();
+    }
+  }
+
+  // Wakes the workers up to exit, and returns the messages still queued.
+  std::vector<Message> Shutdown() {
+    std::lock_guard<std::mutex> autolock(mutex);
+    exiting = true;
+    condition.notify_all();
+
+    std::vector<Message> pending;
+    for (auto& entry : channels) {
+      for (auto& message : entry.second.messages)
+        pending.push_back(std::move(message));
+    }
+    channels.clear();
+    ready.clear();
+    queued_messages = 0;
+    return pending;
+  }
+
+  mutable std::mutex mutex;
+  std::condition_variable condition;
+  std::map<ChannelKey, Channel> channels;
+  std::deque<ChannelKey> ready;
+  bool exiting = false;
+
+  size_t queued_messages = 0;
+  size_t peak_queued_messages = 0;
+  size_t dispatched_messages = 0;
+};
+
 std::unique_ptr<ServiceDispatcher> ServiceDispatcher::Create() {
-  std::unique_ptr<ServiceDispatcher> dispatcher{new ServiceDispatcher()};
+  return Create(0);
+}
+
+std::unique_ptr<ServiceDispatcher> ServiceDispatcher::Create(
+    size_t worker_count) {
+  std::unique_ptr<ServiceDispatcher> dispatcher{
+      new ServiceDispatcher(worker_count)};
   if (!dispatcher->epoll_fd_ || !dispatcher->event_fd_) {
     dispatcher.reset();
   }
@@ -22,7 +122,7 @@ std::unique_ptr<ServiceDispatcher> ServiceDispatcher::Create() {
   return dispatcher;
 }
 
-ServiceDispatcher::ServiceDispatcher() {
+ServiceDispatcher::ServiceDispatcher(size_t worker_count) {
   event_fd_.Reset(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK));
   if (!event_fd_) {
     ALOGE("Failed to create event fd because: %s\n", strerror(errno));
@@ -47,10 +147,27 @@ ServiceDispatcher::ServiceDispatcher() {
     // Close the fds here and signal failure to the factory method.
     event_fd_.Close();
     epoll_fd_.Close();
+    return;
+  }
+
+  if (worker_count > 0) {
+    work_queue_.reset(new WorkQueue());
+    for (size_t i = 0; i < worker_count; i++)
+      workers_.emplace_back(&ServiceDispatcher::WorkerLoop, this);
   }
 }
 
-ServiceDispatcher::~ServiceDispatcher() { SetCanceled(true); }
+ServiceDispatcher::~ServiceDispatcher() {
+  SetCanceled(true);
+
+  if (work_queue_) {
+    // Don't leave the senders of the messages nobody got to blocked.
+    for (auto& message : work_queue_->Shutdown())
+      message.ReplyError(ESHUTDOWN);
+    for (auto& worker : workers_)
+      worker.join();
+  }
+}
 
 int ServiceDispatcher::ThreadEnter() {
   std::lock_guard<std::mutex> autolock(mutex_);
@@ -127,11 +244,7 @@ int ServiceDispatcher::ReceiveAndDispatch(int timeout) {
       ThreadExit();
       return -EBUSY;
     } else {
-      Service* service = static_cast<Service*>(events[i].data.ptr);
-
-      ALOGI_IF(TRACE, "Dispatching message: fd=%d\n",
-               service->endpoint()->epoll_fd());
-      service->ReceiveAndDispatch();
+      Dispatch(static_cast<Service*>(events[i].data.ptr));
     }
   }
 
@@ -159,11 +272,7 @@ int ServiceDispatcher::EnterDispatchLoop() {
         ThreadExit();
         return -EBUSY;
       } else {
-        Service* service = static_cast<Service*>(events[i].data.ptr);
-
-        ALOGI_IF(TRACE, "Dispatching message: fd=%d\n",
-                 service->endpoint()->epoll_fd());
-        service->ReceiveAndDispatch();
+        Dispatch(static_cast<Service*>(events[i].data.ptr));
       }
     }
   }
@@ -188,5 +297,52 @@ void ServiceDispatcher::SetCanceled(bool cancel) {
 
 bool ServiceDispatcher::IsCanceled() const { return canceled_; }
 
+ServiceDispatcher::QueueStats ServiceDispatcher::GetQueueStats() const {
+  QueueStats stats{};
+  if (work_queue_) {
+    std::lock_guard<std::mutex> autolock(work_queue_->mutex);
+    stats.queued_messages = work_queue_->queued_messages;
+    stats.peak_queued_messages = work_queue_->peak_queued_messages;
+    stats.active_channels = work_queue_->channels.size();
+    stats.dispatched_messages = work_queue_->dispatched_messages;
+  }
+  return stats;
+}
+
+void ServiceDispatcher::Dispatch(Service* service) {
+  ALOGI_IF(TRACE, "Dispatching message: fd=%d\n",
+           service->endpoint()->epoll_fd());
+
+  if (!work_queue_) {
+    service->ReceiveAndDispatch();
+    return;
+  }
+
+  Message message;
+  const auto status = service->endpoint()->MessageReceive(&message);
+  if (!status) {
+    ALOGE("Failed to receive message: %s\n", status.GetErrorMessage().c_str());
+    return;
+  }
+  work_queue_->Push(service, std::move(message));
+}
+
+void ServiceDispatcher::WorkerLoop() {
+  WorkQueue::ChannelKey key;
+  for (;;) {
+    {
+      Message message;
+      if (!work_queue_->Pop(&key, &message))
+        return;
+
+      // The message is replied to, or destroyed, before the channel is handed
+      // to the next worker.
+      if (auto service = message.GetService())
+        service->DispatchMessage(message);
+    }
+    work_queue_->Done(key);
+  }
+}
+
 }  // namespace pdx
 }  // namespace android
@@ -115,3 +115,50 @@ TEST(ThreadLocalBufferTest, BackingBuffer) {
   EXPECT_NE(buffer1.data(), buffer3.data());
   EXPECT_NE(buffer2.data(), buffer4.data());
 }
+
+// Tests that a buffer that grew for a large message is trimmed back once the
+// messages that follow no longer need the room.
+TEST(ThreadLocalBufferTest, TrimsAfterLargeMessage) {
+  struct TypeTagT;
+  using SendSlotT = ThreadLocalSlot<TypeTagT, kSendBufferIndex>;
+  using Buffer = MessageBuffer<SendSlotT>;
+
+  Buffer::GetEmptyBuffer().resize(1 << 20);
+  EXPECT_GE(Buffer::GetEmptyBuffer().capacity(), 1U << 20);
+  EXPECT_GE(ThreadLocalBufferStats::GetSnapshot().peak_message_bytes,
+            1U << 20);
+
+  // The room is kept while the large message is among the recent ones, then
+  // trimmed to the size class of the messages that followed.
+  for (std::size_t i = 0; i < BufferTrimInterval - 1; i++) {
+    Buffer::GetEmptyBuffer().resize(5000);
+    EXPECT_GE(Buffer::GetBuffer().capacity(), 1U << 20);
+  }
+  for (std::size_t i = 0; i < BufferTrimInterval; i++)
+    Buffer::GetEmptyBuffer().resize(5000);
+  Buffer::GetEmptyBuffer();
+  EXPECT_EQ(8192U, Buffer::GetBuffer().capacity());
+  Buffer::FreeBuffer();
+}
+
+// Tests that buffers are trimmed back to their initial capacity as soon as they
+// are reused when the process holds more than its budget.
+TEST(ThreadLocalBufferTest, TrimsOverBudget) {
+  struct TypeTagU;
+  using SendSlotU = ThreadLocalSlot<TypeTagU, kSendBufferIndex>;
+  using Buffer = MessageBuffer<SendSlotU>;
+
+  const auto before = ThreadLocalBufferStats::GetSnapshot();
+  ThreadLocalBufferStats::SetBudget(1);
+  Buffer::GetEmptyBuffer().resize(1 << 16);
+  EXPECT_EQ(4096U, Buffer::GetEmptyBuffer().capacity());
+  ThreadLocalBufferStats::SetBudget(0);
+
+  const auto after = ThreadLocalBufferStats::GetSnapshot();
+  EXPECT_EQ(before.trim_count + 1, after.trim_count);
+  EXPECT_GE(after.peak_retained_bytes, 1U << 16);
+
+  Buffer::FreeBuffer();
+  EXPECT_EQ(after.retained_bytes - 4096,
+            ThreadLocalBufferStats::GetSnapshot().retained_bytes);
+}
@@ -3,9 +3,12 @@
 
 #include <errno.h>
 #include <log/log.h>
+#include <string.h>
 #include <sys/epoll.h>
 #include <sys/socket.h>
 
+#include <algorithm>
+
 #include <pdx/client.h>
 #include <pdx/service_endpoint.h>
 #include <uds/ipc_helper.h>
@@ -16,6 +19,12 @@ namespace uds {
 
 namespace {
 
+// How much to read past a response header in the hope of getting the response
+// data along with it: room for the header itself, then for the data the caller
+// expects, up to a limit.
+constexpr size_t kResponseHeaderReadAhead = 256;
+constexpr size_t kMaxResponseReadAhead = 16384;
+
 struct TransactionState {
   bool GetLocalFileHandle(int index, LocalHandle* handle) {
     if (index < 0) {
@@ -105,32 +114,51 @@ Status<void> ReceiveResponse(const BorrowedHandle& socket_fd,
                              TransactionState* transaction_state,
                              const iovec* receive_vector, size_t receive_count,
                              size_t max_recv_len) {
-  auto status = ReceiveData(socket_fd, &transaction_state->response);
+  // Nothing but the response data follows the response header, so whatever of
+  // the data arrived with the header is read along with it.
+  ReceivePayload payload;
+  auto status = payload.Receive(
+      socket_fd, nullptr,
+      std::min(kResponseHeaderReadAhead + max_recv_len, kMaxResponseReadAhead));
+  if (status && rpc::Deserialize(&transaction_state->response, &payload) !=
+                    rpc::ErrorCode::NO_ERROR) {
+    status.SetError(EIO);
+  }
   if (!status)
     return status;
 
-  if (transaction_state->response.recv_len > 0) {
-    std::vector<iovec> read_buffers;
-    size_t size_remaining = 0;
-    if (transaction_state->response.recv_len != max_recv_len) {
-      // If the receive buffer not exactly the size of data available, recreate
-      // the vector list to consume the data exactly since ReceiveDataVector()
-      // validates that the number of bytes received equals the number of bytes
-      // requested.
-      size_remaining = transaction_state->response.recv_len;
-      for (size_t i = 0; i < receive_count && size_remaining > 0; i++) {
-        read_buffers.push_back(receive_vector[i]);
-        iovec& last_vec = read_buffers.back();
-        if (last_vec.iov_len > size_remaining)
-          last_vec.iov_len = size_remaining;
-        size_remaining -= last_vec.iov_len;
-      }
-      receive_vector = read_buffers.data();
-      receive_count = read_buffers.size();
-    }
-    status = ReceiveDataVector(socket_fd, receive_vector, receive_count);
-    if (status && size_remaining > 0)
-      status = ReadAndDiscardData(socket_fd, size_remaining);
+  size_t size_remaining = transaction_state->response.recv_len;
+  const uint8_t* read_ahead = payload.GetReadAheadData();
+  size_t read_ahead_size = payload.GetReadAheadSize();
+  if (read_ahead_size > size_remaining)
+    return ErrorStatus(EIO);
+
+  // Fill the receive buffers with the data read ahead first, then read the
+  // rest of what fits in them from the socket. ReceiveDataVector() validates
+  // that the number of bytes received equals the number of bytes requested.
+  std::vector<iovec> read_buffers;
+  for (size_t i = 0; i < receive_count && size_remaining > 0; i++) {
+    uint8_t* base = static_cast<uint8_t*>(receive_vector[i].iov_base);
+    const size_t size = std::min(receive_vector[i].iov_len, size_remaining);
+    const size_t copied = std::min(size, read_ahead_size);
+    memcpy(base, read_ahead, copied);
+    read_ahead += copied;
+    read_ahead_size -= copied;
+    size_remaining -= size;
+    if (copied < size)
+      read_buffers.push_back({base + copied, size - copied});
+  }
+  if (!read_buffers.empty())
+    status = ReceiveDataVector(socket_fd, read_buffers.data(),
+                               read_buffers.size());
+
+  // If there is more data than the caller provided buffers for, discard it
+  // and report EIO.
+  if (status && size_remaining > 0) {
+    if (size_remaining > read_ahead_size)
+      status = ReadAndDiscardData(socket_fd, size_remaining - read_ahead_size);
+    else
+      status = ErrorStatus(EIO);
   }
   return status;
 }
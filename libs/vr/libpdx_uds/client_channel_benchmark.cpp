@@ -0,0 +1,142 @@
+#include <uds/client_channel.h>
+
+#include <sys/socket.h>
+
+#include <functional>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <pdx/client.h>
+#include <pdx/rpc/remote_method.h>
+#include <pdx/service.h>
+#include <pdx/service_dispatcher.h>
+
+#include <uds/client_channel_factory.h>
+#include <uds/service_endpoint.h>
+
+using android::pdx::ClientBase;
+using android::pdx::LocalHandle;
+using android::pdx::Message;
+using android::pdx::ServiceBase;
+using android::pdx::ServiceDispatcher;
+using android::pdx::Status;
+using android::pdx::rpc::DispatchRemoteMethod;
+using android::pdx::uds::ClientChannelFactory;
+using android::pdx::uds::Endpoint;
+
+namespace {
+
+// Measures the round trips per second of RPCs over a channel, for the framing
+// of requests and responses in ClientChannel and Endpoint.
+struct BenchmarkProtocol {
+  enum {
+    kOpEcho = 0,
+  };
+  PDX_REMOTE_METHOD(Echo, kOpEcho,
+                    std::vector<uint8_t>(const std::vector<uint8_t>&));
+};
+
+class BenchmarkService : public ServiceBase<BenchmarkService> {
+ public:
+  BenchmarkService(std::unique_ptr<Endpoint> endpoint)
+      : ServiceBase{"BenchmarkService", std::move(endpoint)} {}
+
+  Status<void> HandleMessage(Message& message) override {
+    switch (message.GetOp()) {
+      case BenchmarkProtocol::kOpEcho:
+        DispatchRemoteMethod<BenchmarkProtocol::Echo>(
+            *this, &BenchmarkService::OnEcho, message);
+        return {};
+
+      default:
+        return Service::HandleMessage(message);
+    }
+  }
+
+  std::vector<uint8_t> OnEcho(Message& /*message*/,
+                              const std::vector<uint8_t>& data) {
+    return data;
+  }
+};
+
+class BenchmarkClient : public ClientBase<BenchmarkClient> {
+ public:
+  using ClientBase::ClientBase;
+
+  bool Echo(const std::vector<uint8_t>& data) {
+    auto status = InvokeRemoteMethod<BenchmarkProtocol::Echo>(data);
+    return status && status.get().size() == data.size();
+  }
+};
+
+// Runs a service on one end of a socket pair and connects a client to the
+// other.
+class ChannelPair {
+ public:
+  ChannelPair() {
+    int channel_sockets[2] = {};
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, channel_sockets) <
+        0) {
+      return;
+    }
+    LocalHandle service_channel{channel_sockets[0]};
+    LocalHandle client_channel{channel_sockets[1]};
+
+    auto endpoint = Endpoint::CreateFromSocketFd(LocalHandle{});
+    endpoint->RegisterNewChannelForTests(std::move(service_channel));
+    service_ = BenchmarkService::Create(std::move(endpoint));
+    dispatcher_ = ServiceDispatcher::Create();
+    dispatcher_->AddService(service_);
+    dispatch_thread_ = std::thread(
+        std::bind(&ServiceDispatcher::EnterDispatchLoop, dispatcher_.get()));
+
+    auto factory = ClientChannelFactory::Create(std::move(client_channel));
+    auto status = factory->Connect(android::pdx::Client::kInfiniteTimeout);
+    if (status)
+      client_ = BenchmarkClient::Create(status.take());
+  }
+
+  ~ChannelPair() {
+    client_.reset();
+    if (dispatcher_) {
+      dispatcher_->SetCanceled(true);
+      dispatch_thread_.join();
+      dispatcher_->RemoveService(service_);
+    }
+  }
+
+  BenchmarkClient* client() const { return client_.get(); }
+
+ private:
+  std::shared_ptr<BenchmarkService> service_;
+  std::unique_ptr<ServiceDispatcher> dispatcher_;
+  std::thread dispatch_thread_;
+  std::unique_ptr<BenchmarkClient> client_;
+};
+
+void BM_EchoRoundTrip(benchmark::State& state) {
+  ChannelPair channels;
+  if (!channels.client()) {
+    state.SkipWithError("Failed to connect to the service");
+    return;
+  }
+
+  std::vector<uint8_t> data(state.range(0));
+  std::iota(data.begin(), data.end(), 0);
+  while (state.KeepRunning()) {
+    if (!channels.client()->Echo(data)) {
+      state.SkipWithError("Echo failed");
+      break;
+    }
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.SetBytesProcessed(state.iterations() * state.range(0) * 2);
+}
+BENCHMARK(BM_EchoRoundTrip)->Arg(0)->Arg(64)->Arg(1024)->Arg(16384);
+
+}  // anonymous namespace
+
+BENCHMARK_MAIN();
@@ -282,17 +282,48 @@ Status<void> ReceivePayload::Receive(const BorrowedHandle& socket_fd) {
 
 Status<void> ReceivePayload::Receive(const BorrowedHandle& socket_fd,
                                      ucred* cred) {
+  return Receive(socket_fd, cred, 0);
+}
+
+Status<void> ReceivePayload::Receive(const BorrowedHandle& socket_fd,
+                                     ucred* cred, size_t read_ahead) {
   RecvInterface* receiver = receiver_ ? receiver_ : &g_socket_receiver;
   MessagePreamble preamble;
   msghdr msg = {};
-  iovec recv_vect = {&preamble, sizeof(preamble)};
-  msg.msg_iov = &recv_vect;
+  iovec recv_vect[2] = {{&preamble, sizeof(preamble)}, {}};
+  msg.msg_iov = recv_vect;
   msg.msg_iovlen = 1;
   const size_t receive_fd_bytes = kMaxFdCount * sizeof(int);
   msg.msg_controllen = CMSG_SPACE(sizeof(ucred)) + CMSG_SPACE(receive_fd_bytes);
   msg.msg_control = alloca(msg.msg_controllen);
 
-  Status<void> ret = RecvMsgAll(receiver, socket_fd, &msg);
+  Status<void> ret;
+  size_t received = 0;
+  if (read_ahead == 0) {
+    ret = RecvMsgAll(receiver, socket_fd, &msg);
+  } else {
+    // Take whatever arrived along with the preamble, without waiting for more
+    // than the preamble itself.
+    buffer_.resize(read_ahead);
+    recv_vect[1] = {buffer_.data(), buffer_.size()};
+    msg.msg_iovlen = 2;
+    ssize_t size_read = RETRY_EINTR(
+        receiver->ReceiveMessage(socket_fd.Get(), &msg, MSG_CMSG_CLOEXEC));
+    if (size_read < 0) {
+      ret.SetError(errno);
+      ALOGE("ReceivePayload::Receive: Failed to receive data from socket: %s",
+            ret.GetErrorMessage().c_str());
+    } else if (size_read == 0) {
+      ret.SetError(ESHUTDOWN);
+      ALOGW("ReceivePayload::Receive: Socket has been shut down");
+    } else if (static_cast<size_t>(size_read) < sizeof(preamble)) {
+      ret = RecvAll(receiver, socket_fd,
+                    reinterpret_cast<uint8_t*>(&preamble) + size_read,
+                    sizeof(preamble) - size_read);
+    } else {
+      received = size_read - sizeof(preamble);
+    }
+  }
   if (!ret)
     return ret;
 
@@ -302,7 +333,10 @@ Status<void> ReceivePayload::Receive(const BorrowedHandle& socket_fd,
     return ret;
   }
 
+  // Bytes read past the payload stay in the buffer, right after its end.
   buffer_.resize(preamble.data_size);
+  read_ahead_size_ = received > buffer_.size() ? received - buffer_.size() : 0;
+  received = std::min(received, buffer_.size());
   file_handles_.clear();
   read_pos_ = 0;
 
@@ -325,7 +359,8 @@ Status<void> ReceivePayload::Receive(const BorrowedHandle& socket_fd,
     cmsg = CMSG_NXTHDR(&msg, cmsg);
   }
 
-  ret = RecvAll(receiver, socket_fd, buffer_.data(), buffer_.size());
+  ret = RecvAll(receiver, socket_fd, buffer_.data() + received,
+                buffer_.size() - received);
   if (!ret)
     return ret;
 
@@ -1,5 +1,7 @@
 #include "uds/ipc_helper.h"
 
+#include <sys/socket.h>
+
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
@@ -8,12 +10,16 @@ using testing::SetErrnoAndReturn;
 using testing::_;
 
 using android::pdx::BorrowedHandle;
+using android::pdx::LocalHandle;
+using android::pdx::uds::ReceivePayload;
+using android::pdx::uds::SendData;
 using android::pdx::uds::SendInterface;
 using android::pdx::uds::RecvInterface;
 using android::pdx::uds::SendAll;
 using android::pdx::uds::SendMsgAll;
 using android::pdx::uds::RecvAll;
 using android::pdx::uds::RecvMsgAll;
+using android::pdx::rpc::Deserialize;
 
 namespace {
 
@@ -362,4 +368,37 @@ TEST_F(RecvMessageTest, Error2) {
   EXPECT_EQ(EBADF, status.error());
 }
 
+TEST(ReceivePayloadTest, ReadAhead) {
+  int sockets[2] = {};
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sockets));
+  LocalHandle send_socket{sockets[0]};
+  LocalHandle recv_socket{sockets[1]};
+
+  const char data[] = "0123456789";
+  iovec data_vec = {const_cast<char*>(data), sizeof(data)};
+
+  // The data that follows the payload is taken along with it.
+  ASSERT_TRUE(SendData(send_socket.Borrow(), 42, &data_vec, 1));
+  ReceivePayload payload;
+  ASSERT_TRUE(payload.Receive(recv_socket.Borrow(), nullptr, 256));
+  int value = 0;
+  EXPECT_EQ(android::pdx::rpc::ErrorCode::NO_ERROR,
+            Deserialize(&value, &payload));
+  EXPECT_EQ(42, value);
+  ASSERT_EQ(sizeof(data), payload.GetReadAheadSize());
+  EXPECT_EQ(0, memcmp(data, payload.GetReadAheadData(), sizeof(data)));
+
+  // Reading ahead less than the payload still gets all of it, and no more.
+  ASSERT_TRUE(SendData(send_socket.Borrow(), 1000000, &data_vec, 1));
+  ASSERT_TRUE(payload.Receive(recv_socket.Borrow(), nullptr, 2));
+  EXPECT_EQ(android::pdx::rpc::ErrorCode::NO_ERROR,
+            Deserialize(&value, &payload));
+  EXPECT_EQ(1000000, value);
+  EXPECT_EQ(0U, payload.GetReadAheadSize());
+  char received[sizeof(data)] = {};
+  ASSERT_TRUE(android::pdx::uds::ReceiveData(recv_socket.Borrow(), received,
+                                             sizeof(received)));
+  EXPECT_STREQ(data, received);
+}
+
 }  // namespace
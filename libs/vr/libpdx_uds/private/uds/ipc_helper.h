@@ -89,6 +89,17 @@ class ReceivePayload : public MessageReader, public InputResourceMapper {
   Status<void> Receive(const BorrowedHandle& socket_fd);
   Status<void> Receive(const BorrowedHandle& socket_fd, ucred* cred);
 
+  // Same as above, also taking up to |read_ahead| bytes that follow the payload
+  // on the socket if they arrived with it, saving separate reads for them.
+  // Only use this when nothing but data belonging with the payload can follow
+  // it, as with a response that the client waits for.
+  Status<void> Receive(const BorrowedHandle& socket_fd, ucred* cred,
+                       size_t read_ahead);
+
+  // The bytes read past the payload by the call above.
+  const uint8_t* GetReadAheadData() const { return buffer_.end(); }
+  size_t GetReadAheadSize() const { return read_ahead_size_; }
+
   // MessageReader
   BufferSection GetNextReadBufferSection() override;
   void ConsumeReadBufferSectionData(const void* new_start) override;
@@ -104,6 +115,7 @@ class ReceivePayload : public MessageReader, public InputResourceMapper {
   ByteBuffer buffer_;
   std::vector<LocalHandle> file_handles_;
   size_t read_pos_{0};
+  size_t read_ahead_size_{0};
 };
 
 template <typename FileHandleType>
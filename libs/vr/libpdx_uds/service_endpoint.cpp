@@ -642,11 +642,14 @@ Status<void> Endpoint::MessageReply(Message* message, int return_code) {
 
   state->response.ret_code = return_code;
   state->response.recv_len = state->response_data.size();
-  auto status = SendData(channel_socket, state->response);
-  if (status && !state->response_data.empty()) {
-    status = SendData(channel_socket, state->response_data.data(),
-                      state->response_data.size());
-  }
+  // Send the header and the data in one go, for the client to read them in one
+  // go as well.
+  iovec response_vec = {state->response_data.data(),
+                        state->response_data.size()};
+  auto status =
+      state->response_data.empty()
+          ? SendData(channel_socket, state->response)
+          : SendData(channel_socket, state->response, &response_vec, 1);
 
   if (status)
     status = ReenableEpollEvent(channel_socket);
@@ -424,9 +424,11 @@ class ServiceFrameworkTest : public ::testing::Test {
   std::unique_ptr<ServiceDispatcher> dispatcher_;
   std::thread dispatch_thread_;
 
-  void SetUp() override {
+  void SetUp() override { StartDispatcher(0); }
+
+  void StartDispatcher(size_t worker_count) {
     // Create a dispatcher to handle messages to services.
-    dispatcher_ = android::pdx::ServiceDispatcher::Create();
+    dispatcher_ = android::pdx::ServiceDispatcher::Create(worker_count);
     ASSERT_NE(nullptr, dispatcher_);
 
     // Start the message dispatch loop in a separate thread.
@@ -445,6 +447,12 @@ class ServiceFrameworkTest : public ::testing::Test {
   }
 };
 
+// Same as above, with the dispatcher handing messages to worker threads.
+class ServiceFrameworkWorkerTest : public ServiceFrameworkTest {
+ protected:
+  void SetUp() override { StartDispatcher(2); }
+};
+
 // Test basic operation of TestService/TestClient classes.
 TEST_F(ServiceFrameworkTest, BasicClientService) {
   // Create a test service and add it to the dispatcher.
@@ -538,6 +546,29 @@ TEST_F(ServiceFrameworkTest, ImpulseHangup) {
   }
 }
 
+// Test that worker threads handle the messages of a channel in order, so that
+// an impulse is handled before the message that follows it on its channel.
+TEST_F(ServiceFrameworkWorkerTest, ImpulsesInOrder) {
+  auto service = TestService::Create(kTestService1);
+  ASSERT_NE(nullptr, service);
+  ASSERT_EQ(0, dispatcher_->AddService(service));
+
+  auto client = TestClient::Create(kTestService1);
+  ASSERT_NE(nullptr, client);
+
+  const int kMaxIterations = 100;
+  for (int i = 0; i < kMaxIterations; i++) {
+    ImpulsePayload expected_payload = {{static_cast<uint8_t>(i)}};
+    EXPECT_EQ(0, client->SendAsync(expected_payload.data(), 1));
+    client->GetThisChannelId();
+    EXPECT_EQ(expected_payload, service->GetImpulsePayload());
+  }
+
+  const auto stats = dispatcher_->GetQueueStats();
+  EXPECT_EQ(0U, stats.queued_messages);
+  EXPECT_LE(2U * kMaxIterations, stats.dispatched_messages);
+}
+
 // Test Message::PushChannel/Service::PushChannel API.
 TEST_F(ServiceFrameworkTest, PushChannel) {
   // Create a test service and add it to the dispatcher.
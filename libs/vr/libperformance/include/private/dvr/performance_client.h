@@ -17,6 +17,10 @@ class PerformanceClient : public pdx::ClientBase<PerformanceClient> {
   int SetSchedulerPolicy(pid_t task_id, const std::string& scheduler_policy);
   int SetSchedulerPolicy(pid_t task_id, const char* scheduler_policy);
 
+  // Keeps the task on idle big cores while it is runnable, boosting it to
+  // |boost_policy| if that is not enough. An empty policy ends this.
+  int SetLatencyCritical(pid_t task_id, const std::string& boost_policy);
+
   // TODO(eieio): Consider deprecating this API.
   int SetCpuPartition(pid_t task_id, const std::string& partition);
   int SetCpuPartition(pid_t task_id, const char* partition);
@@ -25,6 +29,10 @@ class PerformanceClient : public pdx::ClientBase<PerformanceClient> {
   int GetCpuPartition(pid_t task_id, std::string* partition_out);
   int GetCpuPartition(pid_t task_id, char* partition_out, std::size_t size);
 
+  // Gets the shared memory performanced publishes thermal telemetry into. Map
+  // it read-only and import it as a DvrTelemetryRing.
+  int GetTelemetryBuffer(pdx::LocalHandle* memory_fd_out);
+
  private:
   friend BASE;
 
@@ -5,6 +5,7 @@
 
 #include <string>
 
+#include <pdx/file_handle.h>
 #include <pdx/rpc/remote_method_type.h>
 
 namespace android {
@@ -13,6 +14,9 @@ namespace dvr {
 // Performance Service RPC interface. Defines the endpoint paths, op codes, and
 // method type signatures supported by performanced.
 struct PerformanceRPC {
+  using LocalHandle = pdx::LocalHandle;
+  using Void = pdx::rpc::Void;
+
   // Service path.
   static constexpr char kClientPath[] = "system/performance/client";
 
@@ -22,6 +26,8 @@ struct PerformanceRPC {
     kOpSetSchedulerClass,
     kOpGetCpuPartition,
     kOpSetSchedulerPolicy,
+    kOpGetTelemetryBuffer,
+    kOpSetLatencyCritical,
   };
 
   // Methods.
@@ -32,6 +38,13 @@ struct PerformanceRPC {
   PDX_REMOTE_METHOD(GetCpuPartition, kOpGetCpuPartition, std::string(pid_t));
   PDX_REMOTE_METHOD(SetSchedulerPolicy, kOpSetSchedulerPolicy,
                     void(pid_t, const std::string&));
+  // Returns the shared memory of a DvrTelemetryRing, to be mapped read-only.
+  PDX_REMOTE_METHOD(GetTelemetryBuffer, kOpGetTelemetryBuffer,
+                    LocalHandle(Void));
+  // Registers a task with the placement controller, which boosts it to the
+  // given policy if needed. An empty policy unregisters the task.
+  PDX_REMOTE_METHOD(SetLatencyCritical, kOpSetLatencyCritical,
+                    void(pid_t, const std::string&));
 };
 
 }  // namespace dvr
@@ -57,6 +57,16 @@ int PerformanceClient::SetSchedulerPolicy(pid_t task_id,
           task_id, WrapString(scheduler_policy)));
 }
 
+int PerformanceClient::SetLatencyCritical(pid_t task_id,
+                                          const std::string& boost_policy) {
+  if (task_id == 0)
+    task_id = gettid();
+
+  return ReturnStatusOrError(
+      InvokeRemoteMethod<PerformanceRPC::SetLatencyCritical>(task_id,
+                                                             boost_policy));
+}
+
 int PerformanceClient::SetSchedulerClass(pid_t task_id,
                                          const std::string& scheduler_class) {
   if (task_id == 0)
@@ -110,6 +120,18 @@ int PerformanceClient::GetCpuPartition(pid_t task_id, char* partition_out,
   return 0;
 }
 
+int PerformanceClient::GetTelemetryBuffer(pdx::LocalHandle* memory_fd_out) {
+  if (memory_fd_out == nullptr)
+    return -EINVAL;
+
+  auto status = InvokeRemoteMethod<PerformanceRPC::GetTelemetryBuffer>();
+  if (!status)
+    return -status.error();
+
+  *memory_fd_out = status.take();
+  return 0;
+}
+
 }  // namespace dvr
 }  // namespace android
 
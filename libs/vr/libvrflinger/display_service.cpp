@@ -44,6 +44,26 @@ DisplayService::DisplayService(Hwc2::Composer* hidl,
            Endpoint::Create(display::DisplayProtocol::kClientPath)) {
     hardware_composer_.Initialize(
         hidl, primary_display_id, request_display_callback);
+
+    // Readers map the telemetry buffer like any other global buffer, so
+    // publishing never waits on them.
+    auto status = SetupGlobalBuffer(
+        DvrGlobalBuffers::kVrFlingerTelemetryBufferKey,
+        DvrTelemetryRing::MemorySize(),
+        GRALLOC_USAGE_SW_READ_OFTEN | GRALLOC_USAGE_SW_WRITE_OFTEN);
+    ALOGE_IF(!status,
+             "DisplayService::DisplayService: Failed to set up telemetry "
+             "buffer: %s",
+             status.GetErrorMessage().c_str());
+
+    status = SetupGlobalBuffer(
+        DvrGlobalBuffers::kVrFlingerFrameContextBufferKey,
+        DvrFrameContextRing::MemorySize(),
+        GRALLOC_USAGE_SW_READ_OFTEN | GRALLOC_USAGE_SW_WRITE_OFTEN);
+    ALOGE_IF(!status,
+             "DisplayService::DisplayService: Failed to set up frame context "
+             "buffer: %s",
+             status.GetErrorMessage().c_str());
 }
 
 bool DisplayService::IsInitialized() const {
@@ -291,11 +311,13 @@ pdx::Status<void> DisplayService::OnDeleteGlobalBuffer(pdx::Message& message,
   const int user_id = message.GetEffectiveUserId();
   const bool trusted = (user_id == AID_ROOT) || IsTrustedUid(user_id);
 
-  if (!trusted) {
+  // The post thread writes into these buffers for as long as it runs.
+  if (!trusted || key == DvrGlobalBuffers::kVrFlingerTelemetryBufferKey ||
+      key == DvrGlobalBuffers::kVrFlingerFrameContextBufferKey) {
     ALOGE(
         "DisplayService::OnDeleteGlobalBuffer: Permission denied for "
-        "user_id=%d",
-        user_id);
+        "user_id=%d key=%d",
+        user_id, key);
     return ErrorStatus(EPERM);
   }
   return DeleteGlobalBuffer(key);
@@ -1,6 +1,7 @@
 #include "display_surface.h"
 
 #include <private/android_filesystem_config.h>
+#include <unistd.h>
 #include <utils/Trace.h>
 
 #include <private/dvr/trusted_uids.h>
@@ -447,6 +448,15 @@ bool DirectDisplaySurface::IsBufferPosted() {
   return !acquired_buffers_.IsEmpty();
 }
 
+LocalHandle DirectDisplaySurface::GetPendingAcquireFence() {
+  std::lock_guard<std::mutex> autolock(lock_);
+  DequeueBuffersLocked();
+
+  if (acquired_buffers_.IsEmpty() || acquired_buffers_.Front().IsAvailable())
+    return {};
+  return LocalHandle(dup(acquired_buffers_.Front().acquire_fence()));
+}
+
 Status<std::shared_ptr<DisplaySurface>> DisplaySurface::Create(
     DisplayService* service, int surface_id, int process_id, int user_id,
     const display::SurfaceAttributes& attributes) {
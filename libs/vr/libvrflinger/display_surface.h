@@ -148,6 +148,10 @@ class DirectDisplaySurface : public DisplaySurface {
   bool IsBufferPosted();
   AcquiredBuffer AcquireCurrentBuffer();
 
+  // Returns a duplicate of the acquire fence of the next buffer to acquire, as
+  // long as it hasn't signaled, or an empty handle otherwise.
+  pdx::LocalHandle GetPendingAcquireFence();
+
   // Get the newest buffer. Up to one buffer will be skipped. If a buffer is
   // skipped, it will be stored in skipped_buffer if non null.
   AcquiredBuffer AcquireNewestAvailableBuffer(AcquiredBuffer* skipped_buffer);
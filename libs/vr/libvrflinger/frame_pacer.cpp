@@ -0,0 +1,198 @@
+#include "frame_pacer.h"
+
+#include <cutils/properties.h>
+#include <utils/Trace.h>
+
+#include <algorithm>
+#include <sstream>
+
+namespace android {
+namespace dvr {
+
+namespace {
+
+// Set to false to always wake up at the configured post offset.
+const char kFramePacingProperty[] = "dvr.frame_pacing";
+
+// The share of frames a surface may miss before the wake-up is delayed.
+constexpr double kTargetMissRate = 0.05;
+
+// Samples a surface needs before it can delay the wake-up.
+constexpr size_t kMinSampleCount = 16;
+
+// Slack left on top of the time composition has recently needed.
+constexpr int64_t kPostMarginNs = 1000000;
+
+// Frames whose fences are followed before giving them up as late.
+constexpr size_t kMaxPendingFrames = 4;
+
+// Frames a surface may go without a new buffer before its stats are dropped.
+constexpr uint32_t kStaleFrameCount = 256;
+
+}  // anonymous namespace
+
+void FramePacer::SampleWindow::Add(int64_t sample) {
+  samples[next] = sample;
+  next = (next + 1) % samples.size();
+  count = std::min(count + 1, samples.size());
+}
+
+int64_t FramePacer::SampleWindow::GetQuantile(double quantile) const {
+  if (count == 0)
+    return 0;
+
+  std::array<int64_t, kSampleCount> sorted;
+  std::copy(samples.begin(), samples.begin() + count, sorted.begin());
+  const size_t index =
+      std::min(count - 1, static_cast<size_t>(count * quantile));
+  std::nth_element(sorted.begin(), sorted.begin() + index,
+                   sorted.begin() + count);
+  return sorted[index];
+}
+
+void FramePacer::Reset() {
+  current_fences_.clear();
+  pending_frames_.clear();
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  enabled_ = property_get_bool(kFramePacingProperty, true);
+  surfaces_.clear();
+  post_durations_ = SampleWindow();
+  frame_count_ = 0;
+  post_offset_ns_ = 0;
+}
+
+int64_t FramePacer::GetWakeupTime(int64_t display_time_ns,
+                                  int64_t max_post_offset_ns) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  max_post_offset_ns_ = max_post_offset_ns;
+  post_offset_ns_ = max_post_offset_ns;
+  if (!enabled_)
+    return display_time_ns - max_post_offset_ns;
+
+  // Wake up once the slowest surface is usually ready, as seen relative to the
+  // display time, but never give up the time composition needs.
+  const int64_t budget_ns = GetPostBudget();
+  if (budget_ns == 0 || budget_ns >= max_post_offset_ns)
+    return display_time_ns - max_post_offset_ns;
+
+  int64_t ready_offset_ns = -max_post_offset_ns;
+  for (const auto& entry : surfaces_) {
+    const SampleWindow& window = entry.second.ready_offsets;
+    if (window.count >= kMinSampleCount) {
+      ready_offset_ns = std::max(
+          ready_offset_ns, window.GetQuantile(1.0 - kTargetMissRate));
+    }
+  }
+
+  post_offset_ns_ = std::max(budget_ns, -ready_offset_ns);
+  ATRACE_INT64("frame_post_offset_ns", post_offset_ns_);
+  return display_time_ns - post_offset_ns_;
+}
+
+int64_t FramePacer::GetPostDeadline(int64_t display_time_ns) const {
+  // Only read here, and changed on this thread, so no need to lock.
+  const int64_t budget_ns = enabled_ ? GetPostBudget() : 0;
+  return budget_ns == 0 ? 0 : display_time_ns - budget_ns;
+}
+
+void FramePacer::AddAcquireFence(int surface_id,
+                                 const pdx::LocalHandle& acquire_fence) {
+  if (!enabled_ || surface_id < 0 || !acquire_fence)
+    return;
+
+  pdx::LocalHandle fence = acquire_fence.Duplicate();
+  if (fence)
+    current_fences_.emplace_back(surface_id, new Fence(fence.Release()));
+}
+
+void FramePacer::OnFramePosted(int64_t display_time_ns, int64_t wakeup_time_ns,
+                               int64_t post_start_ns, int64_t post_done_ns) {
+  if (!enabled_)
+    return;
+
+  pending_frames_.push_back(
+      {display_time_ns, wakeup_time_ns, std::move(current_fences_)});
+  current_fences_.clear();
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  frame_count_++;
+  post_durations_.Add(post_done_ns - post_start_ns);
+  ResolvePendingFrames(post_done_ns);
+
+  for (auto it = surfaces_.begin(); it != surfaces_.end();) {
+    if (frame_count_ - it->second.last_frame > kStaleFrameCount)
+      it = surfaces_.erase(it);
+    else
+      ++it;
+  }
+}
+
+void FramePacer::ResolvePendingFrames(int64_t now_ns) {
+  for (auto& frame : pending_frames_) {
+    // Give up on fences of frames long gone, counting them as ready now.
+    const bool give_up = pending_frames_.size() > kMaxPendingFrames &&
+                         &frame == &pending_frames_.front();
+
+    auto& fences = frame.fences;
+    for (auto it = fences.begin(); it != fences.end();) {
+      nsecs_t signal_time = it->second->getSignalTime();
+      if (signal_time == Fence::SIGNAL_TIME_INVALID) {
+        it = fences.erase(it);
+        continue;
+      }
+      if (signal_time == Fence::SIGNAL_TIME_PENDING) {
+        if (!give_up) {
+          ++it;
+          continue;
+        }
+        signal_time = now_ns;
+      }
+
+      SurfaceStats& stats = surfaces_[it->first];
+      stats.ready_offsets.Add(signal_time - frame.display_time_ns);
+      stats.frame_count++;
+      if (signal_time > frame.wakeup_time_ns)
+        stats.late_count++;
+      stats.last_frame = frame_count_;
+      it = fences.erase(it);
+    }
+  }
+
+  while (!pending_frames_.empty() && pending_frames_.front().fences.empty())
+    pending_frames_.pop_front();
+}
+
+int64_t FramePacer::GetPostBudget() const {
+  if (post_durations_.count < kMinSampleCount)
+    return 0;
+  return post_durations_.GetQuantile(0.99) + kPostMarginNs;
+}
+
+std::string FramePacer::Dump() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::ostringstream stream;
+
+  stream << "Frame pacing:        " << (enabled_ ? "enabled" : "disabled")
+         << std::endl;
+  // Ready times are relative to the display time, so negative when earlier.
+  stream << "Post offset:         " << post_offset_ns_ / 1000 << " us (max "
+         << max_post_offset_ns_ / 1000 << " us, post budget "
+         << GetPostBudget() / 1000 << " us)" << std::endl;
+  for (const auto& entry : surfaces_) {
+    const SurfaceStats& stats = entry.second;
+    stream << "Surface " << entry.first << ":";
+    stream << " frames=" << stats.frame_count;
+    stream << " late=" << stats.late_count;
+    stream << " ready_p50_us="
+           << stats.ready_offsets.GetQuantile(0.5) / 1000;
+    stream << " ready_p95_us="
+           << stats.ready_offsets.GetQuantile(1.0 - kTargetMissRate) / 1000;
+    stream << std::endl;
+  }
+
+  return stream.str();
+}
+
+}  // namespace dvr
+}  // namespace android
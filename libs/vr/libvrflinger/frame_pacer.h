@@ -0,0 +1,110 @@
+#ifndef ANDROID_DVR_SERVICES_DISPLAYD_FRAME_PACER_H_
+#define ANDROID_DVR_SERVICES_DISPLAYD_FRAME_PACER_H_
+
+#include <ui/Fence.h>
+
+#include <array>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <pdx/file_handle.h>
+
+namespace android {
+namespace dvr {
+
+// Picks when the post thread wakes up ahead of each display time. It learns,
+// per surface, when the GPU work behind posted buffers completes, from their
+// acquire fences, and delays the wake-up just enough for the slowest surface to
+// be ready at the target miss rate. The wake-up never moves earlier than the
+// configured post offset, nor later than the time composition has recently
+// needed to make it to the display.
+//
+// All methods but Dump() are called on the post thread.
+class FramePacer {
+ public:
+  FramePacer() = default;
+
+  // Forgets everything learned, e.g. when the target display changes.
+  void Reset();
+
+  // Returns when to wake up to post the frame shown at |display_time_ns|,
+  // given the offset before it that the config asks for.
+  int64_t GetWakeupTime(int64_t display_time_ns, int64_t max_post_offset_ns);
+
+  // Returns the latest time posting the frame shown at |display_time_ns| can
+  // start and still make it, or zero until enough frames have been posted to
+  // know.
+  int64_t GetPostDeadline(int64_t display_time_ns) const;
+
+  // Called for each layer with a new buffer in the frame being posted.
+  void AddAcquireFence(int surface_id, const pdx::LocalHandle& acquire_fence);
+
+  // Called once the frame for |display_time_ns|, which woke up at
+  // |wakeup_time_ns| and started posting at |post_start_ns|, is handed to
+  // hardware composer at |post_done_ns|.
+  void OnFramePosted(int64_t display_time_ns, int64_t wakeup_time_ns,
+                     int64_t post_start_ns, int64_t post_done_ns);
+
+  std::string Dump();
+
+ private:
+  static constexpr size_t kSampleCount = 64;
+
+  // A window of the most recent samples.
+  struct SampleWindow {
+    std::array<int64_t, kSampleCount> samples;
+    size_t count = 0;
+    size_t next = 0;
+
+    void Add(int64_t sample);
+    // Returns the given quantile, in [0, 1], of the samples in the window.
+    int64_t GetQuantile(double quantile) const;
+  };
+
+  struct SurfaceStats {
+    // When the acquire fences signaled, relative to the display time.
+    SampleWindow ready_offsets;
+    uint32_t frame_count = 0;
+    // Frames whose acquire fence had not signaled by the wake-up.
+    uint32_t late_count = 0;
+    uint32_t last_frame = 0;
+  };
+
+  struct PendingFrame {
+    int64_t display_time_ns;
+    int64_t wakeup_time_ns;
+    std::vector<std::pair<int, sp<Fence>>> fences;
+  };
+
+  // Records the fences of posted frames that have signaled since.
+  void ResolvePendingFrames(int64_t now_ns);
+  // The time composition needs ahead of the display time, or zero until
+  // enough frames have been posted.
+  int64_t GetPostBudget() const;
+
+  std::vector<std::pair<int, sp<Fence>>> current_fences_;
+  std::deque<PendingFrame> pending_frames_;
+
+  std::mutex mutex_;
+  // Everything below is protected by |mutex_|, for Dump(), and only changed on
+  // the post thread.
+  bool enabled_ = true;
+  std::map<int, SurfaceStats> surfaces_;
+  // How long posting took, not counting any wait for acquire fences.
+  SampleWindow post_durations_;
+  uint32_t frame_count_ = 0;
+  int64_t post_offset_ns_ = 0;
+  int64_t max_post_offset_ns_ = 0;
+
+  FramePacer(const FramePacer&) = delete;
+  void operator=(const FramePacer&) = delete;
+};
+
+}  // namespace dvr
+}  // namespace android
+
+#endif  // ANDROID_DVR_SERVICES_DISPLAYD_FRAME_PACER_H_
@@ -449,6 +449,9 @@ std::string HardwareComposer::Dump() {
   stream << "Active layers:       " << layers_.size() << std::endl;
   stream << std::endl;
 
+  stream << frame_pacer_.Dump();
+  stream << std::endl;
+
   for (size_t i = 0; i < layers_.size(); i++) {
     stream << "Layer " << i << ":";
     stream << " type=" << layers_[i].GetCompositionType().to_string();
@@ -506,6 +509,11 @@ void HardwareComposer::PostLayers(hwc2_display_t display) {
     ATRACE_INT("frame_skip_count", 0);
   }
 
+  for (const auto& layer : layers_) {
+    frame_pacer_.AddAcquireFence(layer.GetSurfaceId(),
+                                 layer.GetAcquireFence());
+  }
+
 #if TRACE > 1
   for (size_t i = 0; i < layers_.size(); i++) {
     ALOGI("HardwareComposer::PostLayers: layer=%zu buffer_id=%d composition=%s",
@@ -576,6 +584,52 @@ int HardwareComposer::OnNewGlobalBuffer(DvrGlobalBufferKey key,
     }
   }
 
+  if (key == DvrGlobalBuffers::kVrFlingerTelemetryBufferKey) {
+    if (ion_buffer.width() < DvrTelemetryRing::MemorySize()) {
+      ALOGE("HardwareComposer::OnNewGlobalBuffer: invalid telemetry size.");
+      return -EINVAL;
+    }
+
+    telemetry_ring_ =
+        std::make_unique<CPUMappedBroadcastRing<DvrTelemetryRing>>(
+            &ion_buffer, CPUUsageMode::WRITE_OFTEN);
+
+    if (telemetry_ring_->IsMapped() == false) {
+      return -EPERM;
+    }
+  }
+
+  if (key == DvrGlobalBuffers::kVrFlingerFrameContextBufferKey) {
+    if (ion_buffer.width() < DvrFrameContextRing::MemorySize()) {
+      ALOGE("HardwareComposer::OnNewGlobalBuffer: invalid frame context size.");
+      return -EINVAL;
+    }
+
+    frame_context_ring_ =
+        std::make_unique<CPUMappedBroadcastRing<DvrFrameContextRing>>(
+            &ion_buffer, CPUUsageMode::WRITE_OFTEN);
+
+    if (frame_context_ring_->IsMapped() == false) {
+      return -EPERM;
+    }
+  }
+
+  if (key == DvrGlobalBuffers::kVsyncPoseBuffer) {
+    if (ion_buffer.width() < sizeof(DvrVsyncPoseBuffer)) {
+      ALOGE("HardwareComposer::OnNewGlobalBuffer: invalid vsync pose size.");
+      return -EINVAL;
+    }
+
+    auto buffer =
+        std::make_unique<CPUMappedBuffer>(&ion_buffer, CPUUsageMode::READ_OFTEN);
+    if (buffer->IsMapped() == false) {
+      return -EPERM;
+    }
+
+    std::lock_guard<std::mutex> lock(vsync_pose_buffer_mutex_);
+    vsync_pose_buffer_ = std::move(buffer);
+  }
+
   if (key == DvrGlobalBuffers::kVrFlingerConfigBufferKey) {
     return MapConfigBuffer(ion_buffer);
   }
@@ -587,6 +641,11 @@ void HardwareComposer::OnDeletedGlobalBuffer(DvrGlobalBufferKey key) {
   if (key == DvrGlobalBuffers::kVrFlingerConfigBufferKey) {
     ConfigBufferDeleted();
   }
+
+  if (key == DvrGlobalBuffers::kVsyncPoseBuffer) {
+    std::lock_guard<std::mutex> lock(vsync_pose_buffer_mutex_);
+    vsync_pose_buffer_.reset();
+  }
 }
 
 int HardwareComposer::MapConfigBuffer(IonBuffer& ion_buffer) {
@@ -633,6 +692,53 @@ void HardwareComposer::UpdateConfigBuffer() {
   }
 }
 
+void HardwareComposer::PublishTelemetry(uint32_t type, int64_t value0,
+                                        int64_t value1) {
+  if (!telemetry_ring_)
+    return;
+
+  DvrTelemetry telemetry;
+  telemetry.timestamp_ns = GetSystemClockNs();
+  telemetry.type = type;
+  telemetry.vsync_count = vsync_count_;
+  telemetry.value[0] = value0;
+  telemetry.value[1] = value1;
+  telemetry_ring_->Publish(telemetry);
+}
+
+void HardwareComposer::PublishFrameContext(const DvrVsync& vsync) {
+  if (!frame_context_ring_)
+    return;
+
+  DvrFrameContext context = {};
+  context.vsync_timestamp_ns = vsync.vsync_timestamp_ns;
+  context.next_vsync_timestamp_ns =
+      vsync.vsync_timestamp_ns + vsync.vsync_period_ns;
+  context.vsync_count = vsync.vsync_count;
+  context.vsync_period_ns = vsync.vsync_period_ns;
+  context.vsync_left_eye_offset_ns = vsync.vsync_left_eye_offset_ns;
+  context.vsync_right_eye_offset_ns = vsync.vsync_right_eye_offset_ns;
+  context.frame_post_offset_ns = post_thread_config_.frame_post_offset_ns;
+  context.display_width = target_display_->width;
+  context.display_height = target_display_->height;
+  context.predicted_pose.flags = DVR_POSE_FLAG_INVALID;
+
+  {
+    std::lock_guard<std::mutex> lock(vsync_pose_buffer_mutex_);
+    if (vsync_pose_buffer_) {
+      // The pose service may be updating this prediction as it is copied, the
+      // same torn read any reader of the vsync pose buffer can get.
+      const auto* poses =
+          static_cast<const DvrVsyncPoseBuffer*>(vsync_pose_buffer_->Address());
+      context.predicted_pose =
+          poses->vsync_poses[(vsync.vsync_count + 1) &
+                             DvrVsyncPoseBuffer::kIndexMask];
+    }
+  }
+
+  frame_context_ring_->Publish(context);
+}
+
 int HardwareComposer::PostThreadPollInterruptible(
     const pdx::LocalHandle& event_fd, int requested_events, int timeout_ms) {
   pollfd pfd[2] = {
@@ -704,6 +810,67 @@ int HardwareComposer::SleepUntil(int64_t wakeup_timestamp) {
                                      /*timeout_ms*/ -1);
 }
 
+void HardwareComposer::WaitForLayerFences(int64_t deadline_ns) {
+  // The fences in front, then the timer for the deadline and the interrupt.
+  std::vector<pdx::LocalHandle> fences;
+  std::vector<pollfd> pfds;
+  for (const auto& layer : layers_) {
+    pdx::LocalHandle fence = layer.GetPendingAcquireFence();
+    if (fence) {
+      pfds.push_back({.fd = fence.Get(), .events = POLLIN, .revents = 0});
+      fences.push_back(std::move(fence));
+    }
+  }
+  if (fences.empty())
+    return;
+
+  ATRACE_NAME("WaitForLayerFences");
+  const int timer_fd = vsync_sleep_timer_fd_.Get();
+  const itimerspec deadline_itimerspec = {
+      .it_interval = {.tv_sec = 0, .tv_nsec = 0},
+      .it_value = NsToTimespec(deadline_ns),
+  };
+  if (timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &deadline_itimerspec,
+                      nullptr) < 0) {
+    ALOGE("HardwareComposer::WaitForLayerFences: Failed to set timerfd: %s",
+          strerror(errno));
+    return;
+  }
+  pfds.push_back({.fd = timer_fd, .events = POLLIN, .revents = 0});
+  pfds.push_back(
+      {.fd = post_thread_event_fd_.Get(), .events = POLLPRI | POLLIN,
+       .revents = 0});
+
+  size_t pending = fences.size();
+  while (pending > 0) {
+    const int ret = poll(pfds.data(), pfds.size(), /*timeout_ms*/ -1);
+    if (ret < 0) {
+      if (errno == EINTR)
+        continue;
+      ALOGW("HardwareComposer::WaitForLayerFences: Error during poll(): %s",
+            strerror(errno));
+      return;
+    }
+    if (pfds[pfds.size() - 2].revents != 0 ||
+        pfds[pfds.size() - 1].revents != 0) {
+      ATRACE_INT("pending_layer_fences", pending);
+      return;
+    }
+
+    // Stop polling the fences that signaled, or failed, and keep waiting on
+    // the others.
+    for (size_t i = 0; i < pending;) {
+      if (pfds[i].revents != 0) {
+        pending--;
+        std::swap(pfds[i], pfds[pending]);
+        pfds.erase(pfds.begin() + pending);
+      } else {
+        i++;
+      }
+    }
+  }
+}
+
 void HardwareComposer::PostThread() {
   // NOLINTNEXTLINE(runtime/int)
   prctl(PR_SET_NAME, reinterpret_cast<unsigned long>("VrHwcPost"), 0, 0, 0);
@@ -823,6 +990,7 @@ void HardwareComposer::PostThread() {
       last_vsync_timestamp_ = GetSystemClockNs();
       vsync_prediction_interval_ = 1;
       retire_fence_fds_.clear();
+      frame_pacer_.Reset();
     }
 
     int64_t vsync_timestamp = 0;
@@ -856,7 +1024,7 @@ void HardwareComposer::PostThread() {
     UpdateLayerConfig();
 
     // Publish the vsync event.
-    if (vsync_ring_) {
+    if (vsync_ring_ || frame_context_ring_) {
       DvrVsync vsync;
       vsync.vsync_count = vsync_count_;
       vsync.vsync_timestamp_ns = vsync_timestamp;
@@ -864,7 +1032,9 @@ void HardwareComposer::PostThread() {
       vsync.vsync_right_eye_offset_ns = vsync_eye_offsets.right_ns;
       vsync.vsync_period_ns = target_display_->vsync_period_ns;
 
-      vsync_ring_->Publish(vsync);
+      if (vsync_ring_)
+        vsync_ring_->Publish(vsync);
+      PublishFrameContext(vsync);
     }
 
     // Signal all of the vsync clients. Because absolute time is used for the
@@ -872,17 +1042,17 @@ void HardwareComposer::PostThread() {
     if (vsync_callback_)
       vsync_callback_(vsync_timestamp, /*frame_time_estimate*/ 0, vsync_count_);
 
+    // Sleep until shortly before vsync, no earlier than the config asks for
+    // but late enough for the layers' GPU work to usually be done.
+    const int64_t display_time_est_ns =
+        vsync_timestamp + target_display_->vsync_period_ns;
+    const int64_t wakeup_time_ns = frame_pacer_.GetWakeupTime(
+        display_time_est_ns, post_thread_config_.frame_post_offset_ns);
     {
-      // Sleep until shortly before vsync.
       ATRACE_NAME("sleep");
 
-      const int64_t display_time_est_ns =
-          vsync_timestamp + target_display_->vsync_period_ns;
       const int64_t now_ns = GetSystemClockNs();
-      const int64_t sleep_time_ns = display_time_est_ns - now_ns -
-                                    post_thread_config_.frame_post_offset_ns;
-      const int64_t wakeup_time_ns =
-          display_time_est_ns - post_thread_config_.frame_post_offset_ns;
+      const int64_t sleep_time_ns = wakeup_time_ns - now_ns;
 
       ATRACE_INT64("sleep_time_ns", sleep_time_ns);
       if (sleep_time_ns > 0) {
@@ -918,6 +1088,8 @@ void HardwareComposer::PostThread() {
             "since last frame: timestamp=%" PRId64 " prediction_interval=%d",
             current_vsync_timestamp, vsync_prediction_interval_);
         vsync_prediction_interval_++;
+        PublishTelemetry(DVR_TELEMETRY_TYPE_VSYNC_MISS,
+                         vsync_prediction_interval_, frame_skip_count_);
       } else {
         // We have an updated vsync timestamp, reset the prediction interval.
         last_vsync_timestamp_ = current_vsync_timestamp;
@@ -925,7 +1097,21 @@ void HardwareComposer::PostThread() {
       }
     }
 
+    // Give the layers whose buffers are not ready yet until the latest time
+    // posting can start, rather than leaving them for the next frame.
+    const int64_t post_deadline_ns =
+        frame_pacer_.GetPostDeadline(display_time_est_ns);
+    if (post_deadline_ns > GetSystemClockNs())
+      WaitForLayerFences(post_deadline_ns);
+
+    const int64_t post_start_ns = GetSystemClockNs();
     PostLayers(target_display_->id);
+    const int64_t post_done_ns = GetSystemClockNs();
+    frame_pacer_.OnFramePosted(display_time_est_ns, wakeup_time_ns,
+                               post_start_ns, post_done_ns);
+    PublishTelemetry(DVR_TELEMETRY_TYPE_FRAME,
+                     display_time_est_ns - wakeup_time_ns,
+                     post_done_ns - wakeup_time_ns);
   }
 }
 
@@ -27,6 +27,7 @@
 
 #include "acquired_buffer.h"
 #include "display_surface.h"
+#include "frame_pacer.h"
 
 // Hardware composer HAL doesn't define HWC_TRANSFORM_NONE as of this writing.
 #ifndef HWC_TRANSFORM_NONE
@@ -125,6 +126,9 @@ class Layer {
 
   HWC::Composition GetCompositionType() const { return composition_type_; }
   HWC::Layer GetLayerHandle() const { return hardware_composer_layer_; }
+  // The acquire fence of the buffer taken by the last Prepare(), which is
+  // empty unless a new buffer was taken.
+  const pdx::LocalHandle& GetAcquireFence() const { return acquire_fence_; }
   bool IsLayerSetup() const { return !source_.empty(); }
 
   int GetSurfaceId() const {
@@ -145,6 +149,17 @@ class Layer {
     return buffer_id;
   }
 
+  // Returns the acquire fence of the buffer the surface will provide next, if
+  // it has yet to signal, or an empty handle.
+  pdx::LocalHandle GetPendingAcquireFence() const {
+    pdx::LocalHandle fence;
+    pdx::rpc::IfAnyOf<SourceSurface>::Call(
+        &source_, [&fence](const SourceSurface& surface_source) {
+          fence = surface_source.surface->GetPendingAcquireFence();
+        });
+    return fence;
+  }
+
   // Compares Layers by surface id.
   bool operator<(const Layer& other) const {
     return GetSurfaceId() < other.GetSurfaceId();
@@ -393,6 +408,12 @@ class HardwareComposer {
   void PostLayers(hwc2_display_t display);
   void PostThread();
 
+  // Waits in a single poll() for the acquire fences of the buffers the layers
+  // will take next, until they have all signaled or |deadline_ns| passes, so
+  // that buffers finishing shortly after the wake-up still make this frame.
+  // Returns early if the post thread is interrupted.
+  void WaitForLayerFences(int64_t deadline_ns);
+
   // The post thread has two controlling states:
   // 1. Idle: no work to do (no visible surfaces).
   // 2. Suspended: explicitly halted (system is not in VR mode).
@@ -459,6 +480,14 @@ class HardwareComposer {
   // Poll for config udpates.
   void UpdateConfigBuffer();
 
+  // Publishes a DvrTelemetry record of |type|, if anything maps the telemetry
+  // buffer.
+  void PublishTelemetry(uint32_t type, int64_t value0, int64_t value1);
+
+  // Publishes the DvrFrameContext for the vsync that just happened, if
+  // anything maps the frame context buffer.
+  void PublishFrameContext(const DvrVsync& vsync);
+
   bool initialized_;
   bool is_standalone_device_;
 
@@ -520,6 +549,9 @@ class HardwareComposer {
   // Counter tracking the number of skipped frames.
   int frame_skip_count_ = 0;
 
+  // Picks when to wake up before each vsync.
+  FramePacer frame_pacer_;
+
   // Fd array for tracking retire fences that are returned by hwc. This allows
   // us to detect when the display driver begins queuing frames.
   std::vector<pdx::LocalHandle> retire_fence_fds_;
@@ -527,6 +559,16 @@ class HardwareComposer {
   // If we are publishing vsync data, we will put it here.
   std::unique_ptr<CPUMappedBroadcastRing<DvrVsyncRing>> vsync_ring_;
 
+  // Frame timing and vsync misses for any number of readers.
+  std::unique_ptr<CPUMappedBroadcastRing<DvrTelemetryRing>> telemetry_ring_;
+
+  // The frame context published at every vsync, and the vsync pose buffer its
+  // predicted pose is copied from, when a pose service set one up.
+  std::unique_ptr<CPUMappedBroadcastRing<DvrFrameContextRing>>
+      frame_context_ring_;
+  std::unique_ptr<CPUMappedBuffer> vsync_pose_buffer_;
+  std::mutex vsync_pose_buffer_mutex_;
+
   // Broadcast ring for receiving config data from the DisplayManager.
   DvrConfigRing shared_config_ring_;
   uint32_t shared_config_ring_sequence_{0};
@@ -15,11 +15,13 @@ LOCAL_SRC_FILES:= \
     TextureObjectManager.cpp    \
     BufferObjectManager.cpp     \
 	array.cpp.arm		        \
+	decodecache.cpp.arm	        \
 	fp.cpp.arm		            \
 	light.cpp.arm		        \
 	matrix.cpp.arm		        \
 	mipmap.cpp.arm		        \
 	primitives.cpp.arm	        \
+	scanline.cpp.arm	        \
 	vertex.cpp.arm
 
 LOCAL_CFLAGS += -DLOG_TAG=\"libagl\"
@@ -0,0 +1,215 @@
+/* libs/opengles/decodecache.cpp
+**
+** Copyright 2018, The Android Open Source Project
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <cutils/properties.h>
+
+#include "decodecache.h"
+
+namespace android {
+
+// ----------------------------------------------------------------------------
+
+// Entries hold a copy of the compressed data, which is compared with the
+// data uploaded so that a hash collision never hands out wrong pixels.
+// Compressed formats are a fraction of the size of their decoded pixels,
+// so the copy costs little next to them.
+struct decode_entry_t {
+    decode_entry_t* prev;   // more recently used
+    decode_entry_t* next;   // less recently used
+    uint64_t hash;
+    GLenum internalformat;
+    GLint level;
+    GLsizei width;
+    GLsizei height;
+    size_t dataSize;
+    size_t rowSize;
+    size_t size;            // of the whole allocation
+    // followed by dataSize bytes of compressed data, then the pixels
+    uint8_t* data() {
+        return reinterpret_cast<uint8_t*>(this + 1);
+    }
+    uint8_t* pixels() {
+        return data() + dataSize;
+    }
+};
+
+// The default holds a few screen-sized RGB888 levels.
+static const size_t DEFAULT_BUDGET_KB = 8192;
+
+static pthread_once_t gDecodeCacheOnce = PTHREAD_ONCE_INIT;
+static pthread_mutex_t gDecodeCacheLock = PTHREAD_MUTEX_INITIALIZER;
+static size_t gBudget = 0;
+static size_t gUsed = 0;
+static decode_entry_t* gHead = 0;   // most recently used
+static decode_entry_t* gTail = 0;
+
+static void initDecodeCache()
+{
+    char value[PROPERTY_VALUE_MAX];
+    property_get("debug.egl.agl.decode_cache_kb", value, "");
+    long kb = value[0] ? atol(value) : long(DEFAULT_BUDGET_KB);
+    gBudget = kb > 0 ? size_t(kb) * 1024 : 0;
+}
+
+// Reads 8 bytes at a time, mixing each word in with a multiply; the tail
+// is padded with zeroes, and the size is mixed in last.
+static uint64_t hashData(const void* data, size_t size)
+{
+    const uint64_t m = 0xc6a4a7935bd1e995ULL;
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    uint64_t h = 0x9e3779b97f4a7c15ULL;
+    size_t i = 0;
+    for ( ; i+8 <= size ; i += 8) {
+        uint64_t k;
+        memcpy(&k, p+i, 8);
+        k *= m;
+        k ^= k >> 47;
+        h = (h ^ (k * m)) * m;
+    }
+    if (i < size) {
+        uint64_t k = 0;
+        memcpy(&k, p+i, size-i);
+        h = (h ^ (k * m)) * m;
+    }
+    h ^= size;
+    h ^= h >> 47;
+    h *= m;
+    h ^= h >> 47;
+    return h;
+}
+
+static void unlinkEntry(decode_entry_t* e)
+{
+    if (e->prev)    e->prev->next = e->next;
+    else            gHead = e->next;
+    if (e->next)    e->next->prev = e->prev;
+    else            gTail = e->prev;
+}
+
+static void pushEntry(decode_entry_t* e)
+{
+    e->prev = 0;
+    e->next = gHead;
+    if (gHead)      gHead->prev = e;
+    else            gTail = e;
+    gHead = e;
+}
+
+static decode_entry_t* findEntry(uint64_t hash, GLenum internalformat,
+        GLint level, GLsizei width, GLsizei height,
+        const void* data, size_t dataSize, size_t rowSize)
+{
+    for (decode_entry_t* e = gHead ; e ; e = e->next) {
+        if (e->hash == hash && e->internalformat == internalformat &&
+                e->level == level && e->width == width &&
+                e->height == height && e->dataSize == dataSize &&
+                e->rowSize == rowSize &&
+                !memcmp(e->data(), data, dataSize)) {
+            return e;
+        }
+    }
+    return 0;
+}
+
+// ----------------------------------------------------------------------------
+
+bool ogles_decode_cache_fetch(GLenum internalformat, GLint level,
+        GLsizei width, GLsizei height, const void* data, size_t dataSize,
+        void* pixels, size_t bpr, size_t rowSize)
+{
+    pthread_once(&gDecodeCacheOnce, initDecodeCache);
+    if (!gBudget)
+        return false;
+
+    const uint64_t hash = hashData(data, dataSize);
+    pthread_mutex_lock(&gDecodeCacheLock);
+    decode_entry_t* e = findEntry(hash, internalformat, level,
+            width, height, data, dataSize, rowSize);
+    if (e) {
+        unlinkEntry(e);
+        pushEntry(e);
+        const uint8_t* src = e->pixels();
+        uint8_t* dst = static_cast<uint8_t*>(pixels);
+        if (bpr == rowSize) {
+            memcpy(dst, src, rowSize * height);
+        } else {
+            for (GLsizei y=0 ; y<height ; y++) {
+                memcpy(dst, src, rowSize);
+                src += rowSize;
+                dst += bpr;
+            }
+        }
+    }
+    pthread_mutex_unlock(&gDecodeCacheLock);
+    return e != 0;
+}
+
+void ogles_decode_cache_store(GLenum internalformat, GLint level,
+        GLsizei width, GLsizei height, const void* data, size_t dataSize,
+        const void* pixels, size_t bpr, size_t rowSize)
+{
+    pthread_once(&gDecodeCacheOnce, initDecodeCache);
+    const size_t size = sizeof(decode_entry_t) + dataSize + rowSize * height;
+    // a level that would take most of the budget would only evict the others
+    if (size > gBudget / 2)
+        return;
+
+    decode_entry_t* e = static_cast<decode_entry_t*>(malloc(size));
+    if (!e)
+        return;
+    e->hash = hashData(data, dataSize);
+    e->internalformat = internalformat;
+    e->level = level;
+    e->width = width;
+    e->height = height;
+    e->dataSize = dataSize;
+    e->rowSize = rowSize;
+    e->size = size;
+    memcpy(e->data(), data, dataSize);
+    const uint8_t* src = static_cast<const uint8_t*>(pixels);
+    uint8_t* dst = e->pixels();
+    for (GLsizei y=0 ; y<height ; y++) {
+        memcpy(dst, src, rowSize);
+        src += bpr;
+        dst += rowSize;
+    }
+
+    pthread_mutex_lock(&gDecodeCacheLock);
+    decode_entry_t* old = findEntry(e->hash, internalformat, level,
+            width, height, data, dataSize, rowSize);
+    if (old) {
+        unlinkEntry(old);
+        gUsed -= old->size;
+        free(old);
+    }
+    pushEntry(e);
+    gUsed += size;
+    while (gUsed > gBudget) {
+        decode_entry_t* lru = gTail;
+        unlinkEntry(lru);
+        gUsed -= lru->size;
+        free(lru);
+    }
+    pthread_mutex_unlock(&gDecodeCacheLock);
+}
+
+// ----------------------------------------------------------------------------
+}; // namespace android
@@ -0,0 +1,51 @@
+/* libs/opengles/decodecache.h
+**
+** Copyright 2018, The Android Open Source Project
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+#ifndef ANDROID_OPENGLES_DECODECACHE_H
+#define ANDROID_OPENGLES_DECODECACHE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#include <GLES/gl.h>
+
+namespace android {
+
+// Process-wide cache of the mip levels glCompressedTexImage2D decoded, so
+// that uploading the same compressed image again, after the context was
+// lost or into another texture, copies the pixels instead of decoding them.
+// Entries are keyed on the format, the level, the size and the contents of
+// the compressed data, and the least recently used ones are dropped beyond
+// the budget set by debug.egl.agl.decode_cache_kb (0 disables the cache).
+
+// Copies the level cached for this compressed data into |pixels|, height
+// rows of |rowSize| bytes, one every |bpr| bytes. Returns false, having
+// written nothing, when it isn't cached.
+bool ogles_decode_cache_fetch(GLenum internalformat, GLint level,
+        GLsizei width, GLsizei height, const void* data, size_t dataSize,
+        void* pixels, size_t bpr, size_t rowSize);
+
+// Caches the level decoded from this compressed data into |pixels|, laid
+// out as for ogles_decode_cache_fetch().
+void ogles_decode_cache_store(GLenum internalformat, GLint level,
+        GLsizei width, GLsizei height, const void* data, size_t dataSize,
+        const void* pixels, size_t bpr, size_t rowSize);
+
+}; // namespace android
+
+#endif // ANDROID_OPENGLES_DECODECACHE_H
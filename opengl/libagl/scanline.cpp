@@ -0,0 +1,479 @@
+/* libs/opengles/scanline.cpp
+**
+** Copyright 2018, The Android Open Source Project
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <cutils/properties.h>
+#include <log/log.h>
+
+#include "context.h"
+#include "scanline.h"
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#define SCANLINE_NEON 1
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#define SCANLINE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace android {
+
+// ----------------------------------------------------------------------------
+
+// The kernels cover what recovery UIs and emulator compositors draw with
+// glDrawTexiOES: copying a texture in the format of the color buffer,
+// tinting an RGBA texture, and blending a premultiplied RGBA texture.
+// Everything else goes through the scanlines pixelflinger generates.
+
+// Draws one row. |params| holds the modulate color, 0..256 per component.
+typedef void (*scanline_kernel_t)(void* dst, const void* src, size_t count,
+        const uint16_t* params);
+
+static void copy32(void* dst, const void* src, size_t count, const uint16_t*)
+{
+    memcpy(dst, src, count * 4);
+}
+
+static void copy16(void* dst, const void* src, size_t count, const uint16_t*)
+{
+    memcpy(dst, src, count * 2);
+}
+
+// (t * c) >> 8 for each component, with c in 0..256
+
+static inline void modulate8888_pixel(uint8_t* d, const uint8_t* s,
+        const uint16_t* c)
+{
+    d[0] = uint8_t((s[0] * c[0]) >> 8);
+    d[1] = uint8_t((s[1] * c[1]) >> 8);
+    d[2] = uint8_t((s[2] * c[2]) >> 8);
+    d[3] = uint8_t((s[3] * c[3]) >> 8);
+}
+
+static void modulate8888(void* dst, const void* src, size_t count,
+        const uint16_t* params)
+{
+    uint8_t* d = static_cast<uint8_t*>(dst);
+    const uint8_t* s = static_cast<const uint8_t*>(src);
+#if SCANLINE_NEON
+    const uint16x8_t cr = vdupq_n_u16(params[0]);
+    const uint16x8_t cg = vdupq_n_u16(params[1]);
+    const uint16x8_t cb = vdupq_n_u16(params[2]);
+    const uint16x8_t ca = vdupq_n_u16(params[3]);
+    for ( ; count >= 8 ; count -= 8, s += 32, d += 32) {
+        uint8x8x4_t p = vld4_u8(s);
+        p.val[0] = vshrn_n_u16(vmulq_u16(vmovl_u8(p.val[0]), cr), 8);
+        p.val[1] = vshrn_n_u16(vmulq_u16(vmovl_u8(p.val[1]), cg), 8);
+        p.val[2] = vshrn_n_u16(vmulq_u16(vmovl_u8(p.val[2]), cb), 8);
+        p.val[3] = vshrn_n_u16(vmulq_u16(vmovl_u8(p.val[3]), ca), 8);
+        vst4_u8(d, p);
+    }
+#elif SCANLINE_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i c = _mm_setr_epi16(params[0], params[1], params[2], params[3],
+            params[0], params[1], params[2], params[3]);
+    for ( ; count >= 4 ; count -= 4, s += 16, d += 16) {
+        const __m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s));
+        const __m128i lo = _mm_srli_epi16(
+                _mm_mullo_epi16(_mm_unpacklo_epi8(p, zero), c), 8);
+        const __m128i hi = _mm_srli_epi16(
+                _mm_mullo_epi16(_mm_unpackhi_epi8(p, zero), c), 8);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(d), _mm_packus_epi16(lo, hi));
+    }
+#endif
+    for ( ; count ; count--, s += 4, d += 4) {
+        modulate8888_pixel(d, s, params);
+    }
+}
+
+// Premultiplied source over: d = s + (d * (256 - a)) >> 8, with a in 0..256
+
+static inline uint32_t inverseAlpha(uint32_t a)
+{
+    return 256 - (a + (a >> 7));
+}
+
+static inline uint8_t blendComponent(uint32_t s, uint32_t d, uint32_t f)
+{
+    const uint32_t v = s + ((d * f) >> 8);
+    return uint8_t(v > 0xFF ? 0xFF : v);
+}
+
+static void blend8888(void* dst, const void* src, size_t count, const uint16_t*)
+{
+    uint8_t* d = static_cast<uint8_t*>(dst);
+    const uint8_t* s = static_cast<const uint8_t*>(src);
+#if SCANLINE_NEON
+    const uint16x8_t one = vdupq_n_u16(256);
+    for ( ; count >= 8 ; count -= 8, s += 32, d += 32) {
+        const uint8x8x4_t p = vld4_u8(s);
+        uint8x8x4_t q = vld4_u8(d);
+        const uint16x8_t a = vmovl_u8(p.val[3]);
+        const uint16x8_t f = vsubq_u16(one, vsraq_n_u16(a, a, 7));
+        for (int i = 0 ; i < 4 ; i++) {
+            q.val[i] = vqadd_u8(p.val[i],
+                    vshrn_n_u16(vmulq_u16(vmovl_u8(q.val[i]), f), 8));
+        }
+        vst4_u8(d, q);
+    }
+#elif SCANLINE_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi16(256);
+    for ( ; count >= 4 ; count -= 4, s += 16, d += 16) {
+        const __m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s));
+        const __m128i q = _mm_loadu_si128(reinterpret_cast<const __m128i*>(d));
+        __m128i plo = _mm_unpacklo_epi8(p, zero);
+        __m128i phi = _mm_unpackhi_epi8(p, zero);
+        // broadcast the alpha of each pixel to its four components
+        plo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(plo, 0xFF), 0xFF);
+        phi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(phi, 0xFF), 0xFF);
+        const __m128i flo = _mm_sub_epi16(one, _mm_add_epi16(plo, _mm_srli_epi16(plo, 7)));
+        const __m128i fhi = _mm_sub_epi16(one, _mm_add_epi16(phi, _mm_srli_epi16(phi, 7)));
+        const __m128i lo = _mm_srli_epi16(
+                _mm_mullo_epi16(_mm_unpacklo_epi8(q, zero), flo), 8);
+        const __m128i hi = _mm_srli_epi16(
+                _mm_mullo_epi16(_mm_unpackhi_epi8(q, zero), fhi), 8);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(d),
+                _mm_adds_epu8(p, _mm_packus_epi16(lo, hi)));
+    }
+#endif
+    for ( ; count ; count--, s += 4, d += 4) {
+        const uint32_t f = inverseAlpha(s[3]);
+        d[0] = blendComponent(s[0], d[0], f);
+        d[1] = blendComponent(s[1], d[1], f);
+        d[2] = blendComponent(s[2], d[2], f);
+        d[3] = blendComponent(s[3], d[3], f);
+    }
+}
+
+static void blend8888to565(void* dst, const void* src, size_t count, const uint16_t*)
+{
+    uint16_t* d = static_cast<uint16_t*>(dst);
+    const uint8_t* s = static_cast<const uint8_t*>(src);
+    for ( ; count ; count--, s += 4, d++) {
+        const uint32_t f = inverseAlpha(s[3]);
+        if (f == 256) {
+            continue;
+        }
+        const uint32_t p = *d;
+        // expand to 8 bits per component, replicating the high bits
+        const uint32_t r = ((p >> 8) & 0xF8) | (p >> 13);
+        const uint32_t g = ((p >> 3) & 0xFC) | ((p >> 9) & 0x3);
+        const uint32_t b = ((p << 3) & 0xF8) | ((p >> 2) & 0x7);
+        *d = uint16_t(((blendComponent(s[0], r, f) & 0xF8) << 8) |
+                      ((blendComponent(s[1], g, f) & 0xFC) << 3) |
+                       (blendComponent(s[2], b, f) >> 3));
+    }
+}
+
+// ----------------------------------------------------------------------------
+
+// Tiled mode: with debug.egl.agl.threads set above 1, large rectangles are
+// split into bands of rows which a pool of worker threads and the calling
+// thread draw in parallel. A draw returns once all its bands are drawn, so
+// draws stay in order.
+
+struct band_t {
+    scanline_kernel_t   kernel;
+    const uint8_t*      src;
+    uint8_t*            dst;
+    size_t              count;
+    size_t              rows;
+    size_t              srcStride;
+    size_t              dstStride;
+    const uint16_t*     params;
+};
+
+static void drawBand(const band_t& band)
+{
+    const uint8_t* src = band.src;
+    uint8_t* dst = band.dst;
+    for (size_t i=0 ; i<band.rows ; i++) {
+        band.kernel(dst, src, band.count, band.params);
+        src += band.srcStride;
+        dst += band.dstStride;
+    }
+}
+
+class BandPool
+{
+public:
+    static const size_t MAX_THREADS = 8;
+    // below this many pixels, waking the workers costs more than it saves
+    static const size_t MIN_PIXELS = 128 * 1024;
+
+    // returns NULL when tiled mode is off
+    static BandPool* get();
+
+    size_t getThreadCount() const { return mThreadCount; }
+    void draw(const band_t* bands, size_t count);
+
+private:
+    explicit BandPool(size_t threadCount);
+    static void init();
+    static void* workerMain(void* arg);
+    // draws the bands left, with mLock held but released while drawing
+    void drawBandsLocked();
+
+    static pthread_once_t sOnce;
+    static BandPool* sPool;
+
+    const size_t mThreadCount;
+    pthread_mutex_t mDrawLock;
+    pthread_mutex_t mLock;
+    pthread_cond_t mWork;
+    pthread_cond_t mDone;
+    const band_t* mBands;
+    size_t mBandCount;
+    size_t mNextBand;
+    size_t mPendingBands;
+};
+
+pthread_once_t BandPool::sOnce = PTHREAD_ONCE_INIT;
+BandPool* BandPool::sPool = 0;
+
+BandPool* BandPool::get()
+{
+    pthread_once(&sOnce, init);
+    return sPool;
+}
+
+void BandPool::init()
+{
+    char value[PROPERTY_VALUE_MAX];
+    property_get("debug.egl.agl.threads", value, "0");
+    long threads = atol(value);
+    const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads > cpus) threads = cpus;
+    if (threads > long(MAX_THREADS)) threads = MAX_THREADS;
+    if (threads < 2) {
+        return;
+    }
+
+    BandPool* pool = new BandPool(size_t(threads));
+    // the calling thread draws a band too
+    for (long i=1 ; i<threads ; i++) {
+        pthread_t thread;
+        if (pthread_create(&thread, 0, workerMain, pool) != 0) {
+            ALOGE("can't create scanline worker %ld, drawing on one thread", i);
+            // workers already created only ever wait for bands
+            return;
+        }
+        pthread_detach(thread);
+    }
+    ALOGI("drawing on %ld threads", threads);
+    sPool = pool;
+}
+
+BandPool::BandPool(size_t threadCount)
+    : mThreadCount(threadCount), mBands(0), mBandCount(0),
+      mNextBand(0), mPendingBands(0)
+{
+    pthread_mutex_init(&mDrawLock, 0);
+    pthread_mutex_init(&mLock, 0);
+    pthread_cond_init(&mWork, 0);
+    pthread_cond_init(&mDone, 0);
+}
+
+void* BandPool::workerMain(void* arg)
+{
+    BandPool* pool = static_cast<BandPool*>(arg);
+    pthread_mutex_lock(&pool->mLock);
+    for (;;) {
+        while (pool->mNextBand >= pool->mBandCount) {
+            pthread_cond_wait(&pool->mWork, &pool->mLock);
+        }
+        pool->drawBandsLocked();
+    }
+    return 0;
+}
+
+void BandPool::drawBandsLocked()
+{
+    while (mNextBand < mBandCount) {
+        const band_t& band(mBands[mNextBand++]);
+        pthread_mutex_unlock(&mLock);
+        drawBand(band);
+        pthread_mutex_lock(&mLock);
+        if (--mPendingBands == 0) {
+            pthread_cond_signal(&mDone);
+        }
+    }
+}
+
+void BandPool::draw(const band_t* bands, size_t count)
+{
+    // contexts current on other threads share the pool
+    pthread_mutex_lock(&mDrawLock);
+    pthread_mutex_lock(&mLock);
+    mBands = bands;
+    mBandCount = count;
+    mNextBand = 0;
+    mPendingBands = count;
+    pthread_cond_broadcast(&mWork);
+    drawBandsLocked();
+    while (mPendingBands) {
+        pthread_cond_wait(&mDone, &mLock);
+    }
+    mBands = 0;
+    mBandCount = 0;
+    mNextBand = 0;
+    pthread_mutex_unlock(&mLock);
+    pthread_mutex_unlock(&mDrawLock);
+}
+
+// ----------------------------------------------------------------------------
+
+static size_t bytesPerPixel(int format)
+{
+    switch (format) {
+    case GGL_PIXEL_FORMAT_RGBA_8888:
+    case GGL_PIXEL_FORMAT_RGBX_8888:
+    case GGL_PIXEL_FORMAT_BGRA_8888:
+        return 4;
+    case GGL_PIXEL_FORMAT_RGB_565:
+        return 2;
+    }
+    return 0;
+}
+
+static scanline_kernel_t pickKernel(ogles_context_t* c,
+        const GGLSurface& txSurface, const GGLSurface& cbSurface,
+        uint16_t* params)
+{
+    const state_t& state(c->rasterizer.state);
+    const uint32_t enables = state.enables;
+
+    // dithering is a no-op for the formats below, except when blending onto
+    // RGB 565, where the result only differs in the lowest bits
+    const uint32_t supported = GGL_ENABLE_TMUS | GGL_ENABLE_BLENDING | GGL_ENABLE_DITHER;
+    if ((enables & ~supported) || state.mask.color != 0xF) {
+        return 0;
+    }
+
+    // the current color is clamped to [0, 1]
+    bool white = true;
+    for (int i=0 ; i<4 ; i++) {
+        params[i] = uint16_t((c->currentColorClamped.v[i] + 0x80) >> 8);
+        white = white && params[i] == 256;
+    }
+
+    const int env = state.texture[0].env;
+    const bool replace = (env == GGL_REPLACE) || (env == GGL_MODULATE && white);
+    const int txFormat = txSurface.format;
+    const int cbFormat = cbSurface.format;
+
+    if (!(enables & GGL_ENABLE_BLENDING)) {
+        if (replace && txFormat == cbFormat) {
+            switch (bytesPerPixel(txFormat)) {
+            case 4: return copy32;
+            case 2: return copy16;
+            }
+            return 0;
+        }
+        if (env == GGL_MODULATE && txFormat == GGL_PIXEL_FORMAT_RGBA_8888 &&
+                cbFormat == GGL_PIXEL_FORMAT_RGBA_8888) {
+            return modulate8888;
+        }
+        return 0;
+    }
+
+    const blend_state_t& blend(state.blend);
+    if (!replace || blend.src != GGL_ONE || blend.dst != GGL_ONE_MINUS_SRC_ALPHA ||
+            blend.src_alpha != blend.src || blend.dst_alpha != blend.dst ||
+            txFormat != GGL_PIXEL_FORMAT_RGBA_8888) {
+        return 0;
+    }
+    switch (cbFormat) {
+    case GGL_PIXEL_FORMAT_RGBA_8888:
+    case GGL_PIXEL_FORMAT_RGBX_8888:
+        return blend8888;
+    case GGL_PIXEL_FORMAT_RGB_565:
+        return blend8888to565;
+    }
+    return 0;
+}
+
+bool ogles_scanline_drawTex(ogles_context_t* c,
+        GLint x, GLint y, GLint w, GLint h, GLint s0, GLint t0)
+{
+    const GGLSurface& txSurface(c->textures.tmu[0].texture->surface);
+    const GGLSurface& cbSurface(c->rasterizer.state.buffers.color.s);
+
+    uint16_t params[4];
+    const scanline_kernel_t kernel = pickKernel(c, txSurface, cbSurface, params);
+    if (!kernel) {
+        return false;
+    }
+
+    // texels outside of the texture are left to pixelflinger, pixels outside
+    // of the color buffer are clipped
+    if (s0 + x < 0 || t0 + y < 0 ||
+            uint32_t(s0 + x + w) > txSurface.width ||
+            uint32_t(t0 + y + h) > txSurface.height) {
+        return false;
+    }
+    GLint l = x > 0 ? x : 0;
+    GLint t = y > 0 ? y : 0;
+    GLint r = x + w < GLint(cbSurface.width) ? x + w : GLint(cbSurface.width);
+    GLint b = y + h < GLint(cbSurface.height) ? y + h : GLint(cbSurface.height);
+    if (l >= r || t >= b) {
+        return true;
+    }
+
+    const size_t txBpp = bytesPerPixel(txSurface.format);
+    const size_t cbBpp = bytesPerPixel(cbSurface.format);
+    const uint8_t* src = txSurface.data +
+            (size_t(t0 + t) * txSurface.stride + size_t(s0 + l)) * txBpp;
+    uint8_t* dst = cbSurface.data + (size_t(t) * cbSurface.stride + size_t(l)) * cbBpp;
+    band_t band;
+    band.kernel = kernel;
+    band.src = src;
+    band.dst = dst;
+    band.count = size_t(r - l);
+    band.rows = size_t(b - t);
+    band.srcStride = size_t(txSurface.stride) * txBpp;
+    band.dstStride = size_t(cbSurface.stride) * cbBpp;
+    band.params = params;
+
+    BandPool* pool = BandPool::get();
+    if (!pool || band.count * band.rows < BandPool::MIN_PIXELS) {
+        drawBand(band);
+        return true;
+    }
+
+    band_t bands[BandPool::MAX_THREADS];
+    const size_t bandCount = pool->getThreadCount();
+    size_t row = 0;
+    for (size_t i=0 ; i<bandCount ; i++) {
+        const size_t next = (band.rows * (i + 1)) / bandCount;
+        bands[i] = band;
+        bands[i].src = band.src + row * band.srcStride;
+        bands[i].dst = band.dst + row * band.dstStride;
+        bands[i].rows = next - row;
+        row = next;
+    }
+    pool->draw(bands, bandCount);
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+}; // namespace android
@@ -0,0 +1,44 @@
+/* libs/opengles/scanline.h
+**
+** Copyright 2018, The Android Open Source Project
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+#ifndef ANDROID_OPENGLES_SCANLINE_H
+#define ANDROID_OPENGLES_SCANLINE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#include <GLES/gl.h>
+
+namespace android {
+
+namespace gl {
+struct ogles_context_t;
+};
+
+// Draws the texture of unit 0 one texel per pixel onto the rectangle
+// [x, x+w[ x [y, y+h[ of the color buffer, texel (s0+x, t0+y) going to
+// pixel (x, y), with a kernel specialized for the texture and color buffer
+// formats, the texture environment and the blending function.
+// Returns false, having drawn nothing, when no kernel handles the current
+// state; the caller then leaves the rectangle to pixelflinger.
+bool ogles_scanline_drawTex(ogles_context_t* c,
+        GLint x, GLint y, GLint w, GLint h, GLint s0, GLint t0);
+
+}; // namespace android
+
+#endif // ANDROID_OPENGLES_SCANLINE_H
@@ -18,7 +18,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include "context.h"
+#include "decodecache.h"
 #include "fp.h"
+#include "scanline.h"
 #include "state.h"
 #include "texture.h"
 #include "TextureObjectManager.h"
@@ -804,6 +806,11 @@ static void drawTexiOES(GLint x, GLint y, GLint z, GLint w, GLint h, ogles_conte
 
             ogles_lock_textures(c);
 
+            if (ogles_scanline_drawTex(c, x, y, w, h, s0, t0)) {
+                ogles_unlock_textures(c);
+                return;
+            }
+
             c->rasterizer.procs.texCoord2i(c, s0, t0);
             const uint32_t enables = c->rasterizer.state.enables;
             if (ggl_unlikely(enables & (GGL_ENABLE_DEPTH_TEST|GGL_ENABLE_FOG)))
@@ -1119,12 +1126,20 @@ void glCompressedTexImage2D(
             ogles_error(c, error);
             return;
         }
+        const size_t bpr = surface->stride*3;
+        if (ogles_decode_cache_fetch(internalformat, level, width, height,
+                data, compressedSize, surface->data, bpr, width*3)) {
+            return;
+        }
         if (etc1_decode_image(
                 (const etc1_byte*)data,
                 (etc1_byte*)surface->data,
-                width, height, 3, surface->stride*3) != 0) {
+                width, height, 3, bpr) != 0) {
             ogles_error(c, GL_INVALID_OPERATION);
+            return;
         }
+        ogles_decode_cache_store(internalformat, level, width, height,
+                data, compressedSize, surface->data, bpr, width*3);
         return;
     }
 #endif
@@ -1137,6 +1152,10 @@ void glCompressedTexImage2D(
         return;
     }
 
+    // the palette and every level are what the decoded levels depend on
+    const GLsizei dataSize = min(imageSize,
+            dataSizePalette4(numLevels, width, height, internalformat));
+
     for (int i=0 ; i<numLevels ; i++) {
         int lod_w = (width  >> i) ? : 1;
         int lod_h = (height >> i) ? : 1;
@@ -1146,8 +1165,16 @@ void glCompressedTexImage2D(
             ogles_error(c, error);
             return;
         }
+        const size_t pixelSize = c->rasterizer.formats[surface->format].size;
+        const size_t bpr = surface->stride * pixelSize;
+        if (ogles_decode_cache_fetch(internalformat, i, lod_w, lod_h,
+                data, dataSize, surface->data, bpr, lod_w * pixelSize)) {
+            continue;
+        }
         decodePalette4(data, i, width, height,
                 surface->data, surface->stride, internalformat);
+        ogles_decode_cache_store(internalformat, i, lod_w, lod_h,
+                data, dataSize, surface->data, bpr, lod_w * pixelSize);
     }
 }
 
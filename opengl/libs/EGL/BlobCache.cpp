@@ -20,10 +20,11 @@
 
 #include <errno.h>
 #include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include <cutils/properties.h>
 #include <log/log.h>
-#include <chrono>
 
 namespace android {
 
@@ -40,20 +41,24 @@ BlobCache::BlobCache(size_t maxKeySize, size_t maxValueSize, size_t maxTotalSize
         mMaxTotalSize(maxTotalSize),
         mMaxKeySize(maxKeySize),
         mMaxValueSize(maxValueSize),
-        mTotalSize(0) {
-    int64_t now = std::chrono::steady_clock::now().time_since_epoch().count();
-#ifdef _WIN32
-    srand(now);
-#else
-    mRandState[0] = (now >> 0) & 0xFFFF;
-    mRandState[1] = (now >> 16) & 0xFFFF;
-    mRandState[2] = (now >> 32) & 0xFFFF;
-#endif
-    ALOGV("initializing random seed using %lld", (unsigned long long)now);
+        mTotalSize(0),
+        mHits(0),
+        mMisses(0),
+        mEvictions(0) {
 }
 
 void BlobCache::set(const void* key, size_t keySize, const void* value,
         size_t valueSize) {
+    setInternal(key, keySize, value, valueSize, true);
+}
+
+void BlobCache::setNoCopy(const void* key, size_t keySize, const void* value,
+        size_t valueSize) {
+    setInternal(key, keySize, value, valueSize, false);
+}
+
+void BlobCache::setInternal(const void* key, size_t keySize, const void* value,
+        size_t valueSize, bool copyData) {
     if (mMaxKeySize < keySize) {
         ALOGV("set: not caching because the key is too large: %zu (limit: %zu)",
                 keySize, mMaxKeySize);
@@ -78,15 +83,14 @@ void BlobCache::set(const void* key, size_t keySize, const void* value,
         return;
     }
 
-    std::shared_ptr<Blob> dummyKey(new Blob(key, keySize, false));
-    CacheEntry dummyEntry(dummyKey, NULL);
+    Blob dummyKey(key, keySize, false);
 
     while (true) {
-        auto index = std::lower_bound(mCacheEntries.begin(), mCacheEntries.end(), dummyEntry);
-        if (index == mCacheEntries.end() || dummyEntry < *index) {
+        auto index = mCacheIndex.find(&dummyKey);
+        if (index == mCacheIndex.end()) {
             // Create a new cache entry.
-            std::shared_ptr<Blob> keyBlob(new Blob(key, keySize, true));
-            std::shared_ptr<Blob> valueBlob(new Blob(value, valueSize, true));
+            std::shared_ptr<Blob> keyBlob(new Blob(key, keySize, copyData));
+            std::shared_ptr<Blob> valueBlob(new Blob(value, valueSize, copyData));
             size_t newTotalSize = mTotalSize + keySize + valueSize;
             if (mMaxTotalSize < newTotalSize) {
                 if (isCleanable()) {
@@ -101,14 +105,16 @@ void BlobCache::set(const void* key, size_t keySize, const void* value,
                     break;
                 }
             }
-            mCacheEntries.insert(index, CacheEntry(keyBlob, valueBlob));
+            mCacheEntries.push_front(CacheEntry(keyBlob, valueBlob));
+            mCacheIndex.emplace(keyBlob.get(), mCacheEntries.begin());
             mTotalSize = newTotalSize;
             ALOGV("set: created new cache entry with %zu byte key and %zu byte value",
                     keySize, valueSize);
         } else {
             // Update the existing cache entry.
-            std::shared_ptr<Blob> valueBlob(new Blob(value, valueSize, true));
-            std::shared_ptr<Blob> oldValueBlob(index->getValue());
+            auto entry = index->second;
+            std::shared_ptr<Blob> valueBlob(new Blob(value, valueSize, copyData));
+            std::shared_ptr<Blob> oldValueBlob(entry->getValue());
             size_t newTotalSize = mTotalSize + valueSize - oldValueBlob->getSize();
             if (mMaxTotalSize < newTotalSize) {
                 if (isCleanable()) {
@@ -122,7 +128,8 @@ void BlobCache::set(const void* key, size_t keySize, const void* value,
                     break;
                 }
             }
-            index->setValue(valueBlob);
+            entry->setValue(valueBlob);
+            mCacheEntries.splice(mCacheEntries.begin(), mCacheEntries, entry);
             mTotalSize = newTotalSize;
             ALOGV("set: updated existing cache entry with %zu byte key and %zu byte "
                     "value", keySize, valueSize);
@@ -138,17 +145,20 @@ size_t BlobCache::get(const void* key, size_t keySize, void* value,
                 keySize, mMaxKeySize);
         return 0;
     }
-    std::shared_ptr<Blob> dummyKey(new Blob(key, keySize, false));
-    CacheEntry dummyEntry(dummyKey, NULL);
-    auto index = std::lower_bound(mCacheEntries.begin(), mCacheEntries.end(), dummyEntry);
-    if (index == mCacheEntries.end() || dummyEntry < *index) {
+    Blob dummyKey(key, keySize, false);
+    auto index = mCacheIndex.find(&dummyKey);
+    if (index == mCacheIndex.end()) {
         ALOGV("get: no cache entry found for key of size %zu", keySize);
+        mMisses++;
         return 0;
     }
+    mHits++;
 
-    // The key was found. Return the value if the caller's buffer is large
-    // enough.
-    std::shared_ptr<Blob> valueBlob(index->getValue());
+    // The key was found, making it the most recently used. Return the value if
+    // the caller's buffer is large enough.
+    auto entry = index->second;
+    mCacheEntries.splice(mCacheEntries.begin(), mCacheEntries, entry);
+    std::shared_ptr<Blob> valueBlob(entry->getValue());
     size_t valueBlobSize = valueBlob->getSize();
     if (valueBlobSize <= valueSize) {
         ALOGV("get: copying %zu bytes to caller's buffer", valueBlobSize);
@@ -189,10 +199,12 @@ int BlobCache::flatten(void* buffer, size_t size) const {
     header->mBuildIdLength = property_get("ro.build.id", buildId, "");
     memcpy(header->mBuildId, buildId, header->mBuildIdLength);
 
-    // Write cache entries
+    // Write cache entries least recently used first, so that unflatten
+    // restores their order.
     uint8_t* byteBuffer = reinterpret_cast<uint8_t*>(buffer);
     off_t byteOffset = align4(sizeof(Header) + header->mBuildIdLength);
-    for (const CacheEntry& e :  mCacheEntries) {
+    for (auto it = mCacheEntries.rbegin(); it != mCacheEntries.rend(); ++it) {
+        const CacheEntry& e = *it;
         std::shared_ptr<Blob> const& keyBlob = e.getKey();
         std::shared_ptr<Blob> const& valueBlob = e.getValue();
         size_t keySize = keyBlob->getSize();
@@ -225,8 +237,33 @@ int BlobCache::flatten(void* buffer, size_t size) const {
 }
 
 int BlobCache::unflatten(void const* buffer, size_t size) {
+    return unflattenInternal(buffer, size, true);
+}
+
+int BlobCache::unflattenNoCopy(void const* buffer, size_t size) {
+    return unflattenInternal(buffer, size, false);
+}
+
+bool BlobCache::isFlattenedCompatible(void const* buffer, size_t size) const {
+    if (size < sizeof(Header)) {
+        return false;
+    }
+    const Header* header = reinterpret_cast<const Header*>(buffer);
+    if (header->mMagicNumber != blobCacheMagic) {
+        return false;
+    }
+    char buildId[PROPERTY_VALUE_MAX];
+    int len = property_get("ro.build.id", buildId, "");
+    return header->mBlobCacheVersion == blobCacheVersion &&
+            header->mDeviceVersion == blobCacheDeviceVersion &&
+            len == header->mBuildIdLength &&
+            sizeof(Header) + len <= size &&
+            !strncmp(buildId, header->mBuildId, len);
+}
+
+int BlobCache::unflattenInternal(void const* buffer, size_t size, bool copyData) {
     // All errors should result in the BlobCache being in an empty state.
-    mCacheEntries.clear();
+    clear();
 
     // Read the cache header
     if (size < sizeof(Header)) {
@@ -238,12 +275,7 @@ int BlobCache::unflatten(void const* buffer, size_t size) {
         ALOGE("unflatten: bad magic number: %" PRIu32, header->mMagicNumber);
         return -EINVAL;
     }
-    char buildId[PROPERTY_VALUE_MAX];
-    int len = property_get("ro.build.id", buildId, "");
-    if (header->mBlobCacheVersion != blobCacheVersion ||
-            header->mDeviceVersion != blobCacheDeviceVersion ||
-            len != header->mBuildIdLength ||
-            strncmp(buildId, header->mBuildId, len)) {
+    if (!isFlattenedCompatible(buffer, size)) {
         // We treat version mismatches as an empty cache.
         return 0;
     }
@@ -254,7 +286,7 @@ int BlobCache::unflatten(void const* buffer, size_t size) {
     size_t numEntries = header->mNumEntries;
     for (size_t i = 0; i < numEntries; i++) {
         if (byteOffset + sizeof(EntryHeader) > size) {
-            mCacheEntries.clear();
+            clear();
             ALOGE("unflatten: not enough room for cache entry headers");
             return -EINVAL;
         }
@@ -267,13 +299,13 @@ int BlobCache::unflatten(void const* buffer, size_t size) {
 
         size_t totalSize = align4(entrySize);
         if (byteOffset + totalSize > size) {
-            mCacheEntries.clear();
+            clear();
             ALOGE("unflatten: not enough room for cache entry headers");
             return -EINVAL;
         }
 
         const uint8_t* data = eheader->mData;
-        set(data, keySize, data + keySize, valueSize);
+        setInternal(data, keySize, data + keySize, valueSize, copyData);
 
         byteOffset += totalSize;
     }
@@ -281,25 +313,34 @@ int BlobCache::unflatten(void const* buffer, size_t size) {
     return 0;
 }
 
-long int BlobCache::blob_random() {
-#ifdef _WIN32
-    return rand();
-#else
-    return nrand48(mRandState);
-#endif
+BlobCache::Stats BlobCache::getStats() const {
+    Stats stats;
+    stats.hits = mHits;
+    stats.misses = mMisses;
+    stats.evictions = mEvictions;
+    stats.entries = mCacheEntries.size();
+    stats.totalSize = mTotalSize;
+    return stats;
 }
 
 void BlobCache::clean() {
-    // Remove a random cache entry until the total cache size gets below half
-    // the maximum total cache size.
+    // Remove the least recently used cache entry until the total cache size
+    // gets below half the maximum total cache size.
     while (mTotalSize > mMaxTotalSize / 2) {
-        size_t i = size_t(blob_random() % (mCacheEntries.size()));
-        const CacheEntry& entry(mCacheEntries[i]);
+        const CacheEntry& entry(mCacheEntries.back());
         mTotalSize -= entry.getKey()->getSize() + entry.getValue()->getSize();
-        mCacheEntries.erase(mCacheEntries.begin() + i);
+        mCacheIndex.erase(entry.getKey().get());
+        mCacheEntries.pop_back();
+        mEvictions++;
     }
 }
 
+void BlobCache::clear() {
+    mCacheIndex.clear();
+    mCacheEntries.clear();
+    mTotalSize = 0;
+}
+
 bool BlobCache::isCleanable() const {
     return mTotalSize > mMaxTotalSize / 2;
 }
@@ -319,12 +360,18 @@ BlobCache::Blob::~Blob() {
     }
 }
 
-bool BlobCache::Blob::operator<(const Blob& rhs) const {
-    if (mSize == rhs.mSize) {
-        return memcmp(mData, rhs.mData, mSize) < 0;
-    } else {
-        return mSize < rhs.mSize;
+bool BlobCache::Blob::operator==(const Blob& rhs) const {
+    return mSize == rhs.mSize && memcmp(mData, rhs.mData, mSize) == 0;
+}
+
+size_t BlobCache::Blob::hash() const {
+    // 32-bit FNV-1a over the whole blob.
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(mData);
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < mSize; i++) {
+        hash = (hash ^ data[i]) * 16777619u;
     }
+    return hash;
 }
 
 const void* BlobCache::Blob::getData() const {
@@ -349,10 +396,6 @@ BlobCache::CacheEntry::CacheEntry(const CacheEntry& ce):
         mValue(ce.mValue) {
 }
 
-bool BlobCache::CacheEntry::operator<(const CacheEntry& rhs) const {
-    return *mKey < *rhs.mKey;
-}
-
 const BlobCache::CacheEntry& BlobCache::CacheEntry::operator=(const CacheEntry& rhs) {
     mKey = rhs.mKey;
     mValue = rhs.mValue;
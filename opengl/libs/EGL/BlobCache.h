@@ -18,9 +18,11 @@
 #define ANDROID_BLOB_CACHE_H
 
 #include <stddef.h>
+#include <stdint.h>
 
+#include <list>
 #include <memory>
-#include <vector>
+#include <unordered_map>
 
 namespace android {
 
@@ -31,8 +33,29 @@ namespace android {
 // and then reloaded in a subsequent execution of the program.  This
 // serialization is non-portable and the data should only be used by the device
 // that generated it.
+//
+// When the cache is full, the least recently used entries are evicted first.
 class BlobCache {
 public:
+    // Stats counts the cache operations since the BlobCache was created.
+    struct Stats {
+        // hits is the number of get calls that found their key.
+        uint64_t hits;
+
+        // misses is the number of get calls that did not find their key.
+        uint64_t misses;
+
+        // evictions is the number of entries evicted to make room for others.
+        uint64_t evictions;
+
+        // entries is the number of entries currently in the cache.
+        size_t entries;
+
+        // totalSize is the combined size of the keys and values currently in
+        // the cache.
+        size_t totalSize;
+    };
+
     // Create an empty blob cache. The blob cache will cache key/value pairs
     // with key and value sizes less than or equal to maxKeySize and
     // maxValueSize, respectively. The total combined size of ALL cache entries
@@ -97,7 +120,26 @@ public:
     //
     int unflatten(void const* buffer, size_t size);
 
+    // getStats returns the hit, miss and eviction counts and the current
+    // occupancy of the cache.
+    Stats getStats() const;
+
 protected:
+    // setNoCopy is like set, but the cache refers to the key and value memory
+    // instead of copying it.  The memory must outlive the BlobCache.
+    void setNoCopy(const void* key, size_t keySize, const void* value,
+            size_t valueSize);
+
+    // unflattenNoCopy is like unflatten, but the loaded entries refer to the
+    // memory pointed to by 'buffer', which must outlive the BlobCache.
+    int unflattenNoCopy(void const* buffer, size_t size);
+
+    // isFlattenedCompatible returns true if the serialized cache contents in
+    // the memory pointed to by 'buffer' were written by this version of the
+    // cache on this build, so that unflatten would load rather than ignore
+    // them.
+    bool isFlattenedCompatible(void const* buffer, size_t size) const;
+
     // mMaxTotalSize is the maximum size that all cache entries can occupy. This
     // includes space for both keys and values. When a call to BlobCache::set
     // would otherwise cause this limit to be exceeded, either the key/value
@@ -110,13 +152,19 @@ private:
     BlobCache(const BlobCache&);
     void operator=(const BlobCache&);
 
-    // A random function helper to get around MinGW not having nrand48()
-    long int blob_random();
-
-    // clean evicts a randomly chosen set of entries from the cache such that
+    // clean evicts the least recently used entries from the cache such that
     // the total size of all remaining entries is less than mMaxTotalSize/2.
     void clean();
 
+    // clear removes all entries from the cache.
+    void clear();
+
+    // setInternal and unflattenInternal implement both the copying and the
+    // non-copying variants of set and unflatten.
+    void setInternal(const void* key, size_t keySize, const void* value,
+            size_t valueSize, bool copyData);
+    int unflattenInternal(void const* buffer, size_t size, bool copyData);
+
     // isCleanable returns true if the cache is full enough for the clean method
     // to have some effect, and false otherwise.
     bool isCleanable() const;
@@ -127,7 +175,10 @@ private:
         Blob(const void* data, size_t size, bool copyData);
         ~Blob();
 
-        bool operator<(const Blob& rhs) const;
+        bool operator==(const Blob& rhs) const;
+
+        // hash returns a hash of the blob data.
+        size_t hash() const;
 
         const void* getData() const;
         size_t getSize() const;
@@ -155,7 +206,6 @@ private:
         CacheEntry(const std::shared_ptr<Blob>& key, const std::shared_ptr<Blob>& value);
         CacheEntry(const CacheEntry& ce);
 
-        bool operator<(const CacheEntry& rhs) const;
         const CacheEntry& operator=(const CacheEntry&);
 
         std::shared_ptr<Blob> getKey() const;
@@ -218,6 +268,18 @@ private:
         uint8_t mData[];
     };
 
+    // BlobHash and BlobEqual let mCacheIndex look blobs up by their data.
+    struct BlobHash {
+        size_t operator()(const Blob* blob) const { return blob->hash(); }
+    };
+    struct BlobEqual {
+        bool operator()(const Blob* lhs, const Blob* rhs) const {
+            return *lhs == *rhs;
+        }
+    };
+
+    typedef std::list<CacheEntry> CacheEntryList;
+
     // mMaxKeySize is the maximum key size that will be cached. Calls to
     // BlobCache::set with a keySize parameter larger than mMaxKeySize will
     // simply not add the key/value pair to the cache.
@@ -232,13 +294,20 @@ private:
     // the cache.
     size_t mTotalSize;
 
-    // mRandState is the pseudo-random number generator state. It is passed to
-    // nrand48 to generate random numbers when needed.
-    unsigned short mRandState[3];
+    // mCacheEntries stores all the cache entries that are resident in memory,
+    // most recently used first.  Cache entries are added to it by the 'set'
+    // method and moved to the front by both 'set' and 'get'.
+    CacheEntryList mCacheEntries;
+
+    // mCacheIndex maps the key of each entry in mCacheEntries to the entry.
+    // The keys point at the key blobs owned by the entries.
+    std::unordered_map<const Blob*, CacheEntryList::iterator, BlobHash, BlobEqual>
+            mCacheIndex;
 
-    // mCacheEntries stores all the cache entries that are resident in memory.
-    // Cache entries are added to it by the 'set' method.
-    std::vector<CacheEntry> mCacheEntries;
+    // mHits, mMisses and mEvictions are the counters reported by getStats.
+    uint64_t mHits;
+    uint64_t mMisses;
+    uint64_t mEvictions;
 };
 
 }
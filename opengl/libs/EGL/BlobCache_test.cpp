@@ -267,6 +267,51 @@ TEST_F(BlobCacheTest, ExceedingTotalLimitHalvesCacheSize) {
     ASSERT_EQ(maxEntries/2 + 1, numCached);
 }
 
+TEST_F(BlobCacheTest, ExceedingTotalLimitEvictsLeastRecentlyUsed) {
+    // Fill up the entire cache with 1 char key/value pairs.
+    const int maxEntries = MAX_TOTAL_SIZE / 2;
+    for (int i = 0; i < maxEntries; i++) {
+        uint8_t k = i;
+        mBC->set(&k, 1, "x", 1);
+    }
+    // Use the oldest entry again, so that the next oldest ones go first.
+    {
+        uint8_t k = 0;
+        ASSERT_EQ(size_t(1), mBC->get(&k, 1, NULL, 0));
+    }
+    // Insert one more entry, causing a cache overflow.
+    {
+        uint8_t k = maxEntries;
+        mBC->set(&k, 1, "x", 1);
+    }
+    // The three least recently used entries were evicted.
+    for (int i = 0; i < maxEntries+1; i++) {
+        uint8_t k = i;
+        bool evicted = i >= 1 && i <= 3;
+        ASSERT_EQ(evicted ? size_t(0) : size_t(1), mBC->get(&k, 1, NULL, 0))
+                << "key " << i;
+    }
+}
+
+TEST_F(BlobCacheTest, StatsCountHitsMissesAndEvictions) {
+    const int maxEntries = MAX_TOTAL_SIZE / 2;
+    for (int i = 0; i < maxEntries+1; i++) {
+        uint8_t k = i;
+        mBC->set(&k, 1, "x", 1);
+    }
+    uint8_t k = maxEntries;
+    ASSERT_EQ(size_t(1), mBC->get(&k, 1, NULL, 0));
+    k = 0;
+    ASSERT_EQ(size_t(0), mBC->get(&k, 1, NULL, 0));
+
+    BlobCache::Stats stats = mBC->getStats();
+    ASSERT_EQ(uint64_t(1), stats.hits);
+    ASSERT_EQ(uint64_t(1), stats.misses);
+    ASSERT_EQ(uint64_t(maxEntries/2), stats.evictions);
+    ASSERT_EQ(size_t(maxEntries/2 + 1), stats.entries);
+    ASSERT_EQ(size_t(2 * (maxEntries/2 + 1)), stats.totalSize);
+}
+
 class BlobCacheFlattenTest : public BlobCacheTest {
 protected:
     virtual void SetUp() {
@@ -342,6 +387,34 @@ TEST_F(BlobCacheFlattenTest, FlattenDoesntChangeCache) {
     }
 }
 
+TEST_F(BlobCacheFlattenTest, FlattenKeepsRecencyOrder) {
+    // Fill up the entire cache with 1 char key/value pairs.
+    const int maxEntries = MAX_TOTAL_SIZE / 2;
+    for (int i = 0; i < maxEntries; i++) {
+        uint8_t k = i;
+        mBC->set(&k, 1, &k, 1);
+    }
+    // Use the oldest entry again, so that the next oldest ones go first.
+    {
+        uint8_t k = 0;
+        ASSERT_EQ(size_t(1), mBC->get(&k, 1, NULL, 0));
+    }
+
+    roundTrip();
+
+    // Insert one more entry, causing a cache overflow in the new cache.
+    {
+        uint8_t k = maxEntries;
+        mBC2->set(&k, 1, &k, 1);
+    }
+    for (int i = 0; i < maxEntries+1; i++) {
+        uint8_t k = i;
+        bool evicted = i >= 1 && i <= 3;
+        ASSERT_EQ(evicted ? size_t(0) : size_t(1), mBC2->get(&k, 1, NULL, 0))
+                << "key " << i;
+    }
+}
+
 TEST_F(BlobCacheFlattenTest, FlattenCatchesBufferTooSmall) {
     // Fill up the entire cache with 1 char key/value pairs.
     const int maxEntries = MAX_TOTAL_SIZE / 2;
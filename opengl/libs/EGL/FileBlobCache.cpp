@@ -17,21 +17,57 @@
 #include "FileBlobCache.h"
 
 #include <errno.h>
+#include <fcntl.h>
 #include <inttypes.h>
 #include <log/log.h>
+#include <string.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
+#include <unistd.h>
 
 
 // Cache file header
-static const char* cacheFileMagic = "EGL$";
-static const size_t cacheFileHeaderSize = 8;
+static const char* cacheFileMagic = "EGL%";
 
 namespace android {
 
-static uint32_t crc32c(const uint8_t* buf, size_t len) {
+// The cache file starts with a CacheFileHeader and a snapshot of the cache in
+// the BlobCache serialization format, which is followed by a journal of the
+// entries set since the snapshot was taken, one CacheFileRecord each.
+struct CacheFileHeader {
+    // mMagic is always cacheFileMagic.
+    char mMagic[4];
+
+    // mSnapshotCrc is the CRC of the snapshot.
+    uint32_t mSnapshotCrc;
+
+    // mSnapshotSize is the size of the snapshot in bytes, a multiple of 4.
+    uint32_t mSnapshotSize;
+
+    uint32_t mReserved;
+};
+
+// A CacheFileRecord is followed by the key data and then the value data,
+// padded to a multiple of 4 bytes.  A record that is torn by a crash fails its
+// CRC, so it and anything after it are dropped when the file is loaded.
+struct CacheFileRecord {
+    uint32_t mKeySize;
+    uint32_t mValueSize;
+
+    // mCrc is the CRC of mKeySize, mValueSize and the data.
+    uint32_t mCrc;
+};
+
+// When the journal would grow past the maximum total cache size divided by
+// this, the next save writes a new snapshot instead of appending.
+static const size_t journalCompactionDivisor = 2;
+
+static inline size_t align4(size_t size) {
+    return (size + 3) & ~3;
+}
+
+static uint32_t crc32c(const uint8_t* buf, size_t len, uint32_t r = 0) {
     const uint32_t polyBits = 0x82F63B78;
-    uint32_t r = 0;
     for (size_t i = 0; i < len; i++) {
         r ^= buf[i];
         for (int j = 0; j < 8; j++) {
@@ -45,13 +81,21 @@ static uint32_t crc32c(const uint8_t* buf, size_t len) {
     return r;
 }
 
+static uint32_t recordCrc(const CacheFileRecord* record, const uint8_t* data) {
+    uint32_t r = crc32c(reinterpret_cast<const uint8_t*>(record),
+            offsetof(CacheFileRecord, mCrc));
+    return crc32c(data, record->mKeySize + record->mValueSize, r);
+}
+
 FileBlobCache::FileBlobCache(size_t maxKeySize, size_t maxValueSize, size_t maxTotalSize,
         const std::string& filename)
         : BlobCache(maxKeySize, maxValueSize, maxTotalSize)
-        , mFilename(filename) {
+        , mFilename(filename)
+        , mMappedFile(nullptr)
+        , mMappedSize(0)
+        , mFileSize(0)
+        , mJournalSize(0) {
     if (mFilename.length() > 0) {
-        size_t headerSize = cacheFileHeaderSize;
-
         int fd = open(mFilename.c_str(), O_RDONLY, 0);
         if (fd == -1) {
             if (errno != ENOENT) {
@@ -68,119 +112,223 @@ FileBlobCache::FileBlobCache(size_t maxKeySize, size_t maxValueSize, size_t maxT
             return;
         }
 
-        // Sanity check the size before trying to mmap it.
+        // Sanity check the size before trying to mmap it.  A snapshot of a full
+        // cache plus a journal that is due for compaction fit in three times
+        // the maximum total size.
         size_t fileSize = statBuf.st_size;
-        if (fileSize > mMaxTotalSize * 2) {
+        if (fileSize > mMaxTotalSize * 3) {
             ALOGE("cache file is too large: %#" PRIx64,
                   static_cast<off64_t>(statBuf.st_size));
             close(fd);
             return;
         }
+        if (fileSize < sizeof(CacheFileHeader)) {
+            ALOGE("cache file is too small for its header");
+            close(fd);
+            return;
+        }
 
+        // The loaded entries point into the mapping, so it stays mapped for
+        // the lifetime of the cache and only the pages that are used get read.
         uint8_t* buf = reinterpret_cast<uint8_t*>(mmap(NULL, fileSize,
                 PROT_READ, MAP_PRIVATE, fd, 0));
+        close(fd);
         if (buf == MAP_FAILED) {
             ALOGE("error mmaping cache file: %s (%d)", strerror(errno),
                     errno);
-            close(fd);
             return;
         }
 
-        // Check the file magic and CRC
-        size_t cacheSize = fileSize - headerSize;
-        if (memcmp(buf, cacheFileMagic, 4) != 0) {
+        // Check the file magic and the snapshot CRC
+        const CacheFileHeader* header = reinterpret_cast<const CacheFileHeader*>(buf);
+        size_t snapshotEnd = sizeof(CacheFileHeader) + header->mSnapshotSize;
+        if (memcmp(header->mMagic, cacheFileMagic, 4) != 0) {
             ALOGE("cache file has bad mojo");
-            close(fd);
+            munmap(buf, fileSize);
             return;
         }
-        uint32_t* crc = reinterpret_cast<uint32_t*>(buf + 4);
-        if (crc32c(buf + headerSize, cacheSize) != *crc) {
+        if (snapshotEnd > fileSize ||
+                crc32c(buf + sizeof(CacheFileHeader), header->mSnapshotSize) !=
+                        header->mSnapshotCrc) {
             ALOGE("cache file failed CRC check");
-            close(fd);
+            munmap(buf, fileSize);
+            return;
+        }
+        if (!isFlattenedCompatible(buf + sizeof(CacheFileHeader),
+                header->mSnapshotSize)) {
+            // The journal belongs to the same stale build, so drop it all.
+            munmap(buf, fileSize);
             return;
         }
 
-        int err = unflatten(buf + headerSize, cacheSize);
+        int err = unflattenNoCopy(buf + sizeof(CacheFileHeader), header->mSnapshotSize);
         if (err < 0) {
             ALOGE("error reading cache contents: %s (%d)", strerror(-err),
                     -err);
             munmap(buf, fileSize);
-            close(fd);
             return;
         }
+        mMappedFile = buf;
+        mMappedSize = fileSize;
 
-        munmap(buf, fileSize);
-        close(fd);
+        // Replay the journal up to the first torn record.
+        size_t offset = snapshotEnd;
+        while (offset + sizeof(CacheFileRecord) <= fileSize) {
+            const CacheFileRecord* record =
+                    reinterpret_cast<const CacheFileRecord*>(buf + offset);
+            const uint8_t* data = buf + offset + sizeof(CacheFileRecord);
+            size_t recordSize = align4(sizeof(CacheFileRecord) +
+                    size_t(record->mKeySize) + size_t(record->mValueSize));
+            if (recordSize > fileSize - offset || recordCrc(record, data) != record->mCrc) {
+                ALOGW("dropping %zu bytes of torn cache file journal", fileSize - offset);
+                break;
+            }
+            setNoCopy(data, record->mKeySize, data + record->mKeySize, record->mValueSize);
+            offset += recordSize;
+        }
+        mFileSize = offset;
+        mJournalSize = offset - snapshotEnd;
     }
 }
 
+FileBlobCache::~FileBlobCache() {
+    // The entries pointing into the mapping do not touch it when destroyed.
+    if (mMappedFile) {
+        munmap(mMappedFile, mMappedSize);
+    }
+}
+
+void FileBlobCache::set(const void* key, size_t keySize, const void* value,
+        size_t valueSize) {
+    BlobCache::set(key, keySize, value, valueSize);
+
+    // Entries that can never be cached are not worth journaling.
+    if (mFilename.length() == 0 || keySize == 0 || valueSize == 0 ||
+            keySize + valueSize > mMaxTotalSize) {
+        return;
+    }
+
+    size_t offset = mPendingRecords.size();
+    size_t recordSize = align4(sizeof(CacheFileRecord) + keySize + valueSize);
+    mPendingRecords.resize(offset + recordSize, 0);
+
+    CacheFileRecord* record = reinterpret_cast<CacheFileRecord*>(&mPendingRecords[offset]);
+    uint8_t* data = &mPendingRecords[offset + sizeof(CacheFileRecord)];
+    record->mKeySize = keySize;
+    record->mValueSize = valueSize;
+    memcpy(data, key, keySize);
+    memcpy(data + keySize, value, valueSize);
+    record->mCrc = recordCrc(record, data);
+}
+
 void FileBlobCache::writeToFile() {
-    if (mFilename.length() > 0) {
-        size_t cacheSize = getFlattenedSize();
-        size_t headerSize = cacheFileHeaderSize;
-        const char* fname = mFilename.c_str();
+    if (mFilename.length() == 0) {
+        return;
+    }
 
-        // Try to create the file with no permissions so we can write it
-        // without anyone trying to read it.
-        int fd = open(fname, O_CREAT | O_EXCL | O_RDWR, 0);
-        if (fd == -1) {
-            if (errno == EEXIST) {
-                // The file exists, delete it and try again.
-                if (unlink(fname) == -1) {
-                    // No point in retrying if the unlink failed.
-                    ALOGE("error unlinking cache file %s: %s (%d)", fname,
-                            strerror(errno), errno);
-                    return;
-                }
-                // Retry now that we've unlinked the file.
-                fd = open(fname, O_CREAT | O_EXCL | O_RDWR, 0);
-            }
-            if (fd == -1) {
-                ALOGE("error creating cache file %s: %s (%d)", fname,
-                        strerror(errno), errno);
-                return;
-            }
-        }
+    if (mFileSize == 0 ||
+            mJournalSize + mPendingRecords.size() > mMaxTotalSize / journalCompactionDivisor) {
+        writeSnapshot();
+        return;
+    }
+    if (mPendingRecords.empty()) {
+        return;
+    }
 
-        size_t fileSize = headerSize + cacheSize;
+    const char* fname = mFilename.c_str();
+    int fd = open(fname, O_WRONLY, 0);
+    if (fd == -1) {
+        ALOGE("error opening cache file %s for append: %s (%d)", fname,
+                strerror(errno), errno);
+        writeSnapshot();
+        return;
+    }
 
-        uint8_t* buf = new uint8_t [fileSize];
-        if (!buf) {
-            ALOGE("error allocating buffer for cache contents: %s (%d)",
-                    strerror(errno), errno);
-            close(fd);
-            unlink(fname);
-            return;
-        }
+    // Drop any torn journal tail before appending after the valid records.
+    if (ftruncate(fd, mFileSize) == -1 || lseek(fd, mFileSize, SEEK_SET) == -1 ||
+            write(fd, mPendingRecords.data(), mPendingRecords.size()) !=
+                    ssize_t(mPendingRecords.size())) {
+        ALOGE("error appending to cache file: %s (%d)", strerror(errno),
+                errno);
+        // Keep the records and whatever partly made it out is dropped as a
+        // torn tail, by the next append or the next load.
+        close(fd);
+        return;
+    }
+    fdatasync(fd);
+    close(fd);
 
-        int err = flatten(buf + headerSize, cacheSize);
-        if (err < 0) {
-            ALOGE("error writing cache contents: %s (%d)", strerror(-err),
-                    -err);
-            delete [] buf;
-            close(fd);
-            unlink(fname);
-            return;
-        }
+    mFileSize += mPendingRecords.size();
+    mJournalSize += mPendingRecords.size();
+    mPendingRecords.clear();
+}
 
-        // Write the file magic and CRC
-        memcpy(buf, cacheFileMagic, 4);
-        uint32_t* crc = reinterpret_cast<uint32_t*>(buf + 4);
-        *crc = crc32c(buf + headerSize, cacheSize);
+void FileBlobCache::writeSnapshot() {
+    size_t cacheSize = getFlattenedSize();
+    size_t headerSize = sizeof(CacheFileHeader);
+    std::string tempName = mFilename + ".tmp";
+    const char* fname = tempName.c_str();
 
-        if (write(fd, buf, fileSize) == -1) {
-            ALOGE("error writing cache file: %s (%d)", strerror(errno),
-                    errno);
-            delete [] buf;
-            close(fd);
-            unlink(fname);
-            return;
-        }
+    // Write the snapshot to a temporary file and rename it over the cache
+    // file, so that a crash leaves either the old or the new file in place.
+    int fd = open(fname, O_CREAT | O_TRUNC | O_WRONLY, S_IRUSR | S_IWUSR);
+    if (fd == -1) {
+        ALOGE("error creating cache file %s: %s (%d)", fname,
+                strerror(errno), errno);
+        return;
+    }
+
+    size_t fileSize = headerSize + cacheSize;
+
+    uint8_t* buf = new uint8_t [fileSize];
+    if (!buf) {
+        ALOGE("error allocating buffer for cache contents: %s (%d)",
+                strerror(errno), errno);
+        close(fd);
+        unlink(fname);
+        return;
+    }
 
+    int err = flatten(buf + headerSize, cacheSize);
+    if (err < 0) {
+        ALOGE("error writing cache contents: %s (%d)", strerror(-err),
+                -err);
         delete [] buf;
-        fchmod(fd, S_IRUSR);
         close(fd);
+        unlink(fname);
+        return;
     }
+
+    // Write the file magic and CRC
+    CacheFileHeader* header = reinterpret_cast<CacheFileHeader*>(buf);
+    memcpy(header->mMagic, cacheFileMagic, 4);
+    header->mSnapshotCrc = crc32c(buf + headerSize, cacheSize);
+    header->mSnapshotSize = cacheSize;
+    header->mReserved = 0;
+
+    if (write(fd, buf, fileSize) != ssize_t(fileSize) || fdatasync(fd) == -1) {
+        ALOGE("error writing cache file: %s (%d)", strerror(errno),
+                errno);
+        delete [] buf;
+        close(fd);
+        unlink(fname);
+        return;
+    }
+
+    delete [] buf;
+    close(fd);
+
+    if (rename(fname, mFilename.c_str()) == -1) {
+        ALOGE("error renaming cache file %s: %s (%d)", fname,
+                strerror(errno), errno);
+        unlink(fname);
+        return;
+    }
+
+    // The snapshot holds everything that was pending.
+    mFileSize = fileSize;
+    mJournalSize = 0;
+    mPendingRecords.clear();
 }
 
 }
@@ -18,24 +18,54 @@
 #define ANDROID_FILE_BLOB_CACHE_H
 
 #include "BlobCache.h"
+#include <stdint.h>
 #include <string>
+#include <vector>
 
 namespace android {
 
+// A FileBlobCache is a BlobCache saved to a file as a snapshot of the cache
+// followed by a journal of the entries set since.  Saving appends the new
+// entries to the journal, and only rewrites the snapshot once the journal has
+// grown large.
 class FileBlobCache : public BlobCache {
 public:
     // FileBlobCache attempts to load the saved cache contents from disk into
-    // BlobCache.
+    // BlobCache.  The file stays mapped and the loaded entries refer to it.
     FileBlobCache(size_t maxKeySize, size_t maxValueSize, size_t maxTotalSize,
             const std::string& filename);
+    ~FileBlobCache();
 
-    // writeToFile attempts to save the current contents of BlobCache to
-    // disk.
+    // set is BlobCache::set, also queueing the key/value pair to be appended
+    // to the file by the next writeToFile.
+    void set(const void* key, size_t keySize, const void* value,
+            size_t valueSize);
+
+    // writeToFile attempts to save the key/value pairs set since the last call
+    // to disk.
     void writeToFile();
 
 private:
+    // writeSnapshot replaces the file with a snapshot of the current contents
+    // of BlobCache and an empty journal.
+    void writeSnapshot();
+
     // mFilename is the name of the file for storing cache contents.
     std::string mFilename;
+
+    // mMappedFile is the mapping of the file loaded at construction, or NULL.
+    void* mMappedFile;
+    size_t mMappedSize;
+
+    // mFileSize is the size of the valid part of the file, where the next
+    // records get appended.  It is 0 if there is no usable file.
+    size_t mFileSize;
+
+    // mJournalSize is the size of the journal part of the file.
+    size_t mJournalSize;
+
+    // mPendingRecords holds the serialized records not yet appended.
+    std::vector<uint8_t> mPendingRecords;
 };
 
 } // namespace android
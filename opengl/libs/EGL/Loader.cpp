@@ -126,6 +126,7 @@ static void* do_android_load_sphal_library(const char* path, int mode) {
 // ----------------------------------------------------------------------------
 
 Loader::driver_t::driver_t(void* gles)
+    : gles1_separate(false), gles1_loaded(false)
 {
     dso[0] = gles;
     for (size_t i=1 ; i<NELEM(dso) ; i++)
@@ -225,16 +226,20 @@ void* Loader::open(egl_connection_t* cnx)
 
     setEmulatorGlesValue();
 
-    dso = load_driver("GLES", cnx, EGL | GLESv1_CM | GLESv2);
+    dso = load_driver("GLES", cnx, EGL | GLESv2);
     if (dso) {
         hnd = new driver_t(dso);
+        // A single library resolves every entry point the same way for both
+        // APIs, so there is no need to look them all up twice.
+        cnx->hooks[egl_connection_t::GLESv1_INDEX]->gl =
+                cnx->hooks[egl_connection_t::GLESv2_INDEX]->gl;
     } else {
         // Always load EGL first
         dso = load_driver("EGL", cnx, EGL);
         if (dso) {
             hnd = new driver_t(dso);
-            hnd->set( load_driver("GLESv1_CM", cnx, GLESv1_CM), GLESv1_CM );
             hnd->set( load_driver("GLESv2",    cnx, GLESv2),    GLESv2 );
+            hnd->gles1_separate = true;
         }
     }
 
@@ -242,17 +247,36 @@ void* Loader::open(egl_connection_t* cnx)
 
     cnx->libEgl   = load_wrapper(EGL_WRAPPER_DIR "/libEGL.so");
     cnx->libGles2 = load_wrapper(EGL_WRAPPER_DIR "/libGLESv2.so");
-    cnx->libGles1 = load_wrapper(EGL_WRAPPER_DIR "/libGLESv1_CM.so");
+    cnx->libGles1 = NULL;
 
     LOG_ALWAYS_FATAL_IF(!cnx->libEgl,
             "couldn't load system EGL wrapper libraries");
 
-    LOG_ALWAYS_FATAL_IF(!cnx->libGles2 || !cnx->libGles1,
+    LOG_ALWAYS_FATAL_IF(!cnx->libGles2,
             "couldn't load system OpenGL ES wrapper libraries");
 
     return (void*)hnd;
 }
 
+void Loader::load_gles1(egl_connection_t* cnx)
+{
+    std::lock_guard<std::mutex> lock(gles1_lock);
+    driver_t* hnd = (driver_t*)cnx->dso;
+    if (!hnd || hnd->gles1_loaded) {
+        return;
+    }
+
+    ATRACE_CALL();
+
+    if (hnd->gles1_separate) {
+        hnd->set( load_driver("GLESv1_CM", cnx, GLESv1_CM), GLESv1_CM );
+    }
+
+    cnx->libGles1 = load_wrapper(EGL_WRAPPER_DIR "/libGLESv1_CM.so");
+    ALOGE_IF(!cnx->libGles1, "couldn't load system OpenGL ES 1 wrapper library");
+    hnd->gles1_loaded = true;
+}
+
 void Loader::close(void* driver)
 {
     driver_t* hnd = (driver_t*)driver;
@@ -19,6 +19,8 @@
 
 #include <stdint.h>
 
+#include <mutex>
+
 #include <EGL/egl.h>
 
 // ----------------------------------------------------------------------------
@@ -41,9 +43,14 @@ class Loader {
         // returns -errno
         int set(void* hnd, int32_t api);
         void* dso[3];
+        // true if GLESv1_CM comes from its own driver library
+        bool gles1_separate;
+        // true once load_gles1() has run
+        bool gles1_loaded;
     };
     
     getProcAddressType getProcAddress;
+    std::mutex gles1_lock;
 
 public:
     static Loader& getInstance();
@@ -51,6 +58,11 @@ public:
     
     void* open(egl_connection_t* cnx);
     void close(void* driver);
+
+    // Loads the GLESv1_CM driver and wrapper, which open() leaves out since
+    // most processes never create a GLESv1 context. Must be called before
+    // creating one; returns immediately once they are loaded.
+    void load_gles1(egl_connection_t* cnx);
     
 private:
     Loader();
@@ -30,6 +30,7 @@
 #include "egl_tls.h"
 #include "egl_display.h"
 #include "egl_object.h"
+#include "egl_call_counts.h"
 #include "CallStack.h"
 #include "Loader.h"
 
@@ -47,6 +48,9 @@ pthread_key_t gGLWrapperKey = -1;
 // ----------------------------------------------------------------------------
 
 void setGLHooksThreadSpecific(gl_hooks_t const *value) {
+    if (egl_call_counts_t::isEnabled()) {
+        value = egl_call_counts_t::wrapHooks(value);
+    }
     setGlThreadSpecific(value);
 }
 
@@ -190,6 +194,9 @@ static EGLBoolean egl_init_drivers_locked() {
         cnx->hooks[egl_connection_t::GLESv2_INDEX] =
                 &gHooks[egl_connection_t::GLESv2_INDEX];
         cnx->dso = loader.open(cnx);
+        if (cnx->dso) {
+            egl_call_counts_t::initialize();
+        }
     }
 
     return cnx->dso ? EGL_TRUE : EGL_FALSE;
@@ -42,6 +42,8 @@
 
 #include "../egl_impl.h"
 
+#include "Loader.h"
+#include "egl_call_counts.h"
 #include "egl_display.h"
 #include "egl_object.h"
 #include "egl_tls.h"
@@ -281,6 +283,7 @@ static inline EGLContext getContext() { return egl_tls_t::getContext(); }
 EGLDisplay eglGetDisplay(EGLNativeDisplayType display)
 {
     ATRACE_CALL();
+    EGL_COUNT_CALL();
     clearError();
 
     uintptr_t index = reinterpret_cast<uintptr_t>(display);
@@ -302,6 +305,7 @@ EGLDisplay eglGetDisplay(EGLNativeDisplayType display)
 
 EGLBoolean eglInitialize(EGLDisplay dpy, EGLint *major, EGLint *minor)
 {
+    EGL_COUNT_CALL();
     clearError();
 
     egl_display_ptr dp = get_display(dpy);
@@ -318,6 +322,7 @@ EGLBoolean eglTerminate(EGLDisplay dpy)
     // after eglTerminate() has been called. eglTerminate() only
     // terminates an EGLDisplay, not a EGL itself.
 
+    EGL_COUNT_CALL();
     clearError();
 
     egl_display_ptr dp = get_display(dpy);
@@ -336,6 +341,7 @@ EGLBoolean eglGetConfigs(   EGLDisplay dpy,
                             EGLConfig *configs,
                             EGLint config_size, EGLint *num_config)
 {
+    EGL_COUNT_CALL();
     clearError();
 
     const egl_display_ptr dp = validate_display(dpy);
@@ -361,6 +367,7 @@ EGLBoolean eglChooseConfig( EGLDisplay dpy, const EGLint *attrib_list,
                             EGLConfig *configs, EGLint config_size,
                             EGLint *num_config)
 {
+    EGL_COUNT_CALL();
     clearError();
 
     const egl_display_ptr dp = validate_display(dpy);
@@ -439,6 +446,7 @@ EGLBoolean eglChooseConfig( EGLDisplay dpy, const EGLint *attrib_list,
 EGLBoolean eglGetConfigAttrib(EGLDisplay dpy, EGLConfig config,
         EGLint attribute, EGLint *value)
 {
+    EGL_COUNT_CALL();
     clearError();
 
     egl_connection_t* cnx = NULL;
@@ -697,6 +705,7 @@ EGLSurface eglCreateWindowSurface(  EGLDisplay dpy, EGLConfig config,
                                     const EGLint *attrib_list)
 {
     const EGLint *origAttribList = attrib_list;
+    EGL_COUNT_CALL();
     clearError();
 
     egl_connection_t* cnx = NULL;
@@ -780,6 +789,7 @@ EGLSurface eglCreatePixmapSurface(  EGLDisplay dpy, EGLConfig config,
                                     NativePixmapType pixmap,
                                     const EGLint *attrib_list)
 {
+    EGL_COUNT_CALL();
     clearError();
 
     egl_connection_t* cnx = NULL;
@@ -814,6 +824,7 @@ EGLSurface eglCreatePixmapSurface(  EGLDisplay dpy, EGLConfig config,
 EGLSurface eglCreatePbufferSurface( EGLDisplay dpy, EGLConfig config,
                                     const EGLint *attrib_list)
 {
+    EGL_COUNT_CALL();
     clearError();
 
     egl_connection_t* cnx = NULL;
@@ -847,6 +858,7 @@ EGLSurface eglCreatePbufferSurface( EGLDisplay dpy, EGLConfig config,
 
 EGLBoolean eglDestroySurface(EGLDisplay dpy, EGLSurface surface)
 {
+    EGL_COUNT_CALL();
     clearError();
 
     const egl_display_ptr dp = validate_display(dpy);
@@ -867,6 +879,7 @@ EGLBoolean eglDestroySurface(EGLDisplay dpy, EGLSurface surface)
 EGLBoolean eglQuerySurface( EGLDisplay dpy, EGLSurface surface,
                             EGLint attribute, EGLint *value)
 {
+    EGL_COUNT_CALL();
     clearError();
 
     const egl_display_ptr dp = validate_display(dpy);
@@ -889,6 +902,7 @@ EGLBoolean eglQuerySurface( EGLDisplay dpy, EGLSurface surface,
 
 void EGLAPI eglBeginFrame(EGLDisplay dpy, EGLSurface surface) {
     ATRACE_CALL();
+    EGL_COUNT_CALL();
     clearError();
 
     const egl_display_ptr dp = validate_display(dpy);
@@ -909,6 +923,7 @@ void EGLAPI eglBeginFrame(EGLDisplay dpy, EGLSurface surface) {
 EGLContext eglCreateContext(EGLDisplay dpy, EGLConfig config,
                             EGLContext share_list, const EGLint *attrib_list)
 {
+    EGL_COUNT_CALL();
     clearError();
 
     egl_connection_t* cnx = NULL;
@@ -921,24 +936,29 @@ EGLContext eglCreateContext(EGLDisplay dpy, EGLConfig config,
             egl_context_t* const c = get_context(share_list);
             share_list = c->context;
         }
+        // figure out if it's a GLESv1 or GLESv2
+        int version = 0;
+        if (attrib_list) {
+            const EGLint* attrib = attrib_list;
+            while (*attrib != EGL_NONE) {
+                GLint attr = *attrib++;
+                GLint value = *attrib++;
+                if (attr == EGL_CONTEXT_CLIENT_VERSION) {
+                    if (value == 1) {
+                        version = egl_connection_t::GLESv1_INDEX;
+                    } else if (value == 2 || value == 3) {
+                        version = egl_connection_t::GLESv2_INDEX;
+                    }
+                }
+            };
+        }
+        // GLESv1 is only loaded once a context needs it.
+        if (version == egl_connection_t::GLESv1_INDEX) {
+            Loader::getInstance().load_gles1(cnx);
+        }
         EGLContext context = cnx->egl.eglCreateContext(
                 dp->disp.dpy, config, share_list, attrib_list);
         if (context != EGL_NO_CONTEXT) {
-            // figure out if it's a GLESv1 or GLESv2
-            int version = 0;
-            if (attrib_list) {
-                while (*attrib_list != EGL_NONE) {
-                    GLint attr = *attrib_list++;
-                    GLint value = *attrib_list++;
-                    if (attr == EGL_CONTEXT_CLIENT_VERSION) {
-                        if (value == 1) {
-                            version = egl_connection_t::GLESv1_INDEX;
-                        } else if (value == 2 || value == 3) {
-                            version = egl_connection_t::GLESv2_INDEX;
-                        }
-                    }
-                };
-            }
             egl_context_t* c = new egl_context_t(dpy, context, config, cnx,
                     version);
             return c;
@@ -949,6 +969,7 @@ EGLContext eglCreateContext(EGLDisplay dpy, EGLConfig config,
 
 EGLBoolean eglDestroyContext(EGLDisplay dpy, EGLContext ctx)
 {
+    EGL_COUNT_CALL();
     clearError();
 
     const egl_display_ptr dp = validate_display(dpy);
@@ -970,6 +991,7 @@ EGLBoolean eglDestroyContext(EGLDisplay dpy, EGLContext ctx)
 EGLBoolean eglMakeCurrent(  EGLDisplay dpy, EGLSurface draw,
                             EGLSurface read, EGLContext ctx)
 {
+    EGL_COUNT_CALL();
     clearError();
 
     egl_display_ptr dp = validate_display(dpy);
@@ -1065,6 +1087,7 @@ EGLBoolean eglMakeCurrent(  EGLDisplay dpy, EGLSurface draw,
 EGLBoolean eglQueryContext( EGLDisplay dpy, EGLContext ctx,
                             EGLint attribute, EGLint *value)
 {
+    EGL_COUNT_CALL();
     clearError();
 
     const egl_display_ptr dp = validate_display(dpy);
@@ -1084,6 +1107,7 @@ EGLContext eglGetCurrentContext(void)
     // could be called before eglInitialize(), but we wouldn't have a context
     // then, and this function would correctly return EGL_NO_CONTEXT.
 
+    EGL_COUNT_CALL();
     clearError();
 
     EGLContext ctx = getContext();
@@ -1095,6 +1119,7 @@ EGLSurface eglGetCurrentSurface(EGLint readdraw)
     // could be called before eglInitialize(), but we wouldn't have a context
     // then, and this function would correctly return EGL_NO_SURFACE.
 
+    EGL_COUNT_CALL();
     clearError();
 
     EGLContext ctx = getContext();
@@ -1115,6 +1140,7 @@ EGLDisplay eglGetCurrentDisplay(void)
     // could be called before eglInitialize(), but we wouldn't have a context
     // then, and this function would correctly return EGL_NO_DISPLAY.
 
+    EGL_COUNT_CALL();
     clearError();
 
     EGLContext ctx = getContext();
@@ -1128,6 +1154,7 @@ EGLDisplay eglGetCurrentDisplay(void)
 
 EGLBoolean eglWaitGL(void)
 {
+    EGL_COUNT_CALL();
     clearError();
 
     egl_connection_t* const cnx = &gEGLImpl;
@@ -1139,6 +1166,7 @@ EGLBoolean eglWaitGL(void)
 
 EGLBoolean eglWaitNative(EGLint engine)
 {
+    EGL_COUNT_CALL();
     clearError();
 
     egl_connection_t* const cnx = &gEGLImpl;
@@ -1172,8 +1200,11 @@ static __eglMustCastToProperFunctionPointerType findBuiltinWrapper(
     proc = dlsym(cnx->libGles2, procname);
     if (proc) return (__eglMustCastToProperFunctionPointerType)proc;
 
-    proc = dlsym(cnx->libGles1, procname);
-    if (proc) return (__eglMustCastToProperFunctionPointerType)proc;
+    // The GLESv1 wrapper is only loaded once a GLESv1 context was created.
+    if (cnx->libGles1) {
+        proc = dlsym(cnx->libGles1, procname);
+        if (proc) return (__eglMustCastToProperFunctionPointerType)proc;
+    }
 
     return NULL;
 }
@@ -1184,6 +1215,7 @@ __eglMustCastToProperFunctionPointerType eglGetProcAddress(const char *procname)
     // in which case we must make sure we've initialized ourselves, this
     // happens the first time egl_get_display() is called.
 
+    EGL_COUNT_CALL();
     clearError();
 
     if (egl_init_drivers() == EGL_FALSE) {
@@ -1243,6 +1275,7 @@ __eglMustCastToProperFunctionPointerType eglGetProcAddress(const char *procname)
                 cnx->hooks[egl_connection_t::GLESv1_INDEX]->ext.extensions[slot] =
                 cnx->hooks[egl_connection_t::GLESv2_INDEX]->ext.extensions[slot] =
                         cnx->egl.eglGetProcAddress(procname);
+                egl_call_counts_t::setExtension(slot, addr);
                 if (addr) found = true;
             }
 
@@ -1335,7 +1368,9 @@ EGLBoolean eglSwapBuffersWithDamageKHR(EGLDisplay dpy, EGLSurface draw,
         EGLint *rects, EGLint n_rects)
 {
     ATRACE_CALL();
+    EGL_COUNT_CALL();
     clearError();
+    egl_call_counts_t::dumpIfRequested();
 
     const egl_display_ptr dp = validate_display(dpy);
     if (!dp) return EGL_FALSE;
@@ -1398,12 +1433,14 @@ EGLBoolean eglSwapBuffersWithDamageKHR(EGLDisplay dpy, EGLSurface draw,
 
 EGLBoolean eglSwapBuffers(EGLDisplay dpy, EGLSurface surface)
 {
+    // counted as eglSwapBuffersWithDamageKHR
     return eglSwapBuffersWithDamageKHR(dpy, surface, NULL, 0);
 }
 
 EGLBoolean eglCopyBuffers(  EGLDisplay dpy, EGLSurface surface,
                             NativePixmapType target)
 {
+    EGL_COUNT_CALL();
     clearError();
 
     const egl_display_ptr dp = validate_display(dpy);
@@ -1419,6 +1456,7 @@ EGLBoolean eglCopyBuffers(  EGLDisplay dpy, EGLSurface surface,
 
 const char* eglQueryString(EGLDisplay dpy, EGLint name)
 {
+    EGL_COUNT_CALL();
     clearError();
 
     // Generate an error quietly when client extensions (as defined by
@@ -1451,6 +1489,7 @@ const char* eglQueryString(EGLDisplay dpy, EGLint name)
 
 extern "C" EGLAPI const char* eglQueryStringImplementationANDROID(EGLDisplay dpy, EGLint name)
 {
+    EGL_COUNT_CALL();
     clearError();
 
     const egl_display_ptr dp = validate_display(dpy);
@@ -1478,6 +1517,7 @@ extern "C" EGLAPI const char* eglQueryStringImplementationANDROID(EGLDisplay dpy
 EGLBoolean eglSurfaceAttrib(
         EGLDisplay dpy, EGLSurface surface, EGLint attribute, EGLint value)
 {
+    EGL_COUNT_CALL();
     clearError();
 
     const egl_display_ptr dp = validate_display(dpy);
@@ -1519,6 +1559,7 @@ EGLBoolean eglSurfaceAttrib(
 EGLBoolean eglBindTexImage(
         EGLDisplay dpy, EGLSurface surface, EGLint buffer)
 {
+    EGL_COUNT_CALL();
     clearError();
 
     const egl_display_ptr dp = validate_display(dpy);
@@ -1539,6 +1580,7 @@ EGLBoolean eglBindTexImage(
 EGLBoolean eglReleaseTexImage(
         EGLDisplay dpy, EGLSurface surface, EGLint buffer)
 {
+    EGL_COUNT_CALL();
     clearError();
 
     const egl_display_ptr dp = validate_display(dpy);
@@ -1558,6 +1600,7 @@ EGLBoolean eglReleaseTexImage(
 
 EGLBoolean eglSwapInterval(EGLDisplay dpy, EGLint interval)
 {
+    EGL_COUNT_CALL();
     clearError();
 
     const egl_display_ptr dp = validate_display(dpy);
@@ -1579,6 +1622,7 @@ EGLBoolean eglSwapInterval(EGLDisplay dpy, EGLint interval)
 
 EGLBoolean eglWaitClient(void)
 {
+    EGL_COUNT_CALL();
     clearError();
 
     egl_connection_t* const cnx = &gEGLImpl;
@@ -1596,6 +1640,7 @@ EGLBoolean eglWaitClient(void)
 
 EGLBoolean eglBindAPI(EGLenum api)
 {
+    EGL_COUNT_CALL();
     clearError();
 
     if (egl_init_drivers() == EGL_FALSE) {
@@ -1613,6 +1658,7 @@ EGLBoolean eglBindAPI(EGLenum api)
 
 EGLenum eglQueryAPI(void)
 {
+    EGL_COUNT_CALL();
     clearError();
 
     if (egl_init_drivers() == EGL_FALSE) {
@@ -1630,6 +1676,7 @@ EGLenum eglQueryAPI(void)
 
 EGLBoolean eglReleaseThread(void)
 {
+    EGL_COUNT_CALL();
     clearError();
 
     egl_connection_t* const cnx = &gEGLImpl;
@@ -1648,6 +1695,7 @@ EGLSurface eglCreatePbufferFromClientBuffer(
           EGLDisplay dpy, EGLenum buftype, EGLClientBuffer buffer,
           EGLConfig config, const EGLint *attrib_list)
 {
+    EGL_COUNT_CALL();
     clearError();
 
     egl_connection_t* cnx = NULL;
@@ -1667,6 +1715,7 @@ EGLSurface eglCreatePbufferFromClientBuffer(
 EGLBoolean eglLockSurfaceKHR(EGLDisplay dpy, EGLSurface surface,
         const EGLint *attrib_list)
 {
+    EGL_COUNT_CALL();
     clearError();
 
     const egl_display_ptr dp = validate_display(dpy);
@@ -1686,6 +1735,7 @@ EGLBoolean eglLockSurfaceKHR(EGLDisplay dpy, EGLSurface surface,
 
 EGLBoolean eglUnlockSurfaceKHR(EGLDisplay dpy, EGLSurface surface)
 {
+    EGL_COUNT_CALL();
     clearError();
 
     const egl_display_ptr dp = validate_display(dpy);
@@ -1705,6 +1755,7 @@ EGLBoolean eglUnlockSurfaceKHR(EGLDisplay dpy, EGLSurface surface)
 EGLImageKHR eglCreateImageKHR(EGLDisplay dpy, EGLContext ctx, EGLenum target,
         EGLClientBuffer buffer, const EGLint *attrib_list)
 {
+    EGL_COUNT_CALL();
     clearError();
 
     const egl_display_ptr dp = validate_display(dpy);
@@ -1744,6 +1795,7 @@ EGLImageKHR eglCreateImageKHR(EGLDisplay dpy, EGLContext ctx, EGLenum target,
 
 EGLBoolean eglDestroyImageKHR(EGLDisplay dpy, EGLImageKHR img)
 {
+    EGL_COUNT_CALL();
     clearError();
 
     const egl_display_ptr dp = validate_display(dpy);
@@ -1764,6 +1816,7 @@ EGLBoolean eglDestroyImageKHR(EGLDisplay dpy, EGLImageKHR img)
 
 EGLSyncKHR eglCreateSyncKHR(EGLDisplay dpy, EGLenum type, const EGLint *attrib_list)
 {
+    EGL_COUNT_CALL();
     clearError();
 
     const egl_display_ptr dp = validate_display(dpy);
@@ -1779,6 +1832,7 @@ EGLSyncKHR eglCreateSyncKHR(EGLDisplay dpy, EGLenum type, const EGLint *attrib_l
 
 EGLBoolean eglDestroySyncKHR(EGLDisplay dpy, EGLSyncKHR sync)
 {
+    EGL_COUNT_CALL();
     clearError();
 
     const egl_display_ptr dp = validate_display(dpy);
@@ -1793,6 +1847,7 @@ EGLBoolean eglDestroySyncKHR(EGLDisplay dpy, EGLSyncKHR sync)
 }
 
 EGLBoolean eglSignalSyncKHR(EGLDisplay dpy, EGLSyncKHR sync, EGLenum mode) {
+    EGL_COUNT_CALL();
     clearError();
 
     const egl_display_ptr dp = validate_display(dpy);
@@ -1810,6 +1865,7 @@ EGLBoolean eglSignalSyncKHR(EGLDisplay dpy, EGLSyncKHR sync, EGLenum mode) {
 EGLint eglClientWaitSyncKHR(EGLDisplay dpy, EGLSyncKHR sync,
         EGLint flags, EGLTimeKHR timeout)
 {
+    EGL_COUNT_CALL();
     clearError();
 
     const egl_display_ptr dp = validate_display(dpy);
@@ -1827,6 +1883,7 @@ EGLint eglClientWaitSyncKHR(EGLDisplay dpy, EGLSyncKHR sync,
 EGLBoolean eglGetSyncAttribKHR(EGLDisplay dpy, EGLSyncKHR sync,
         EGLint attribute, EGLint *value)
 {
+    EGL_COUNT_CALL();
     clearError();
 
     const egl_display_ptr dp = validate_display(dpy);
@@ -1843,6 +1900,7 @@ EGLBoolean eglGetSyncAttribKHR(EGLDisplay dpy, EGLSyncKHR sync,
 
 EGLStreamKHR eglCreateStreamKHR(EGLDisplay dpy, const EGLint *attrib_list)
 {
+    EGL_COUNT_CALL();
     clearError();
 
     const egl_display_ptr dp = validate_display(dpy);
@@ -1859,6 +1917,7 @@ EGLStreamKHR eglCreateStreamKHR(EGLDisplay dpy, const EGLint *attrib_list)
 
 EGLBoolean eglDestroyStreamKHR(EGLDisplay dpy, EGLStreamKHR stream)
 {
+    EGL_COUNT_CALL();
     clearError();
 
     const egl_display_ptr dp = validate_display(dpy);
@@ -1876,6 +1935,7 @@ EGLBoolean eglDestroyStreamKHR(EGLDisplay dpy, EGLStreamKHR stream)
 EGLBoolean eglStreamAttribKHR(EGLDisplay dpy, EGLStreamKHR stream,
         EGLenum attribute, EGLint value)
 {
+    EGL_COUNT_CALL();
     clearError();
 
     const egl_display_ptr dp = validate_display(dpy);
@@ -1893,6 +1953,7 @@ EGLBoolean eglStreamAttribKHR(EGLDisplay dpy, EGLStreamKHR stream,
 EGLBoolean eglQueryStreamKHR(EGLDisplay dpy, EGLStreamKHR stream,
         EGLenum attribute, EGLint *value)
 {
+    EGL_COUNT_CALL();
     clearError();
 
     const egl_display_ptr dp = validate_display(dpy);
@@ -1910,6 +1971,7 @@ EGLBoolean eglQueryStreamKHR(EGLDisplay dpy, EGLStreamKHR stream,
 EGLBoolean eglQueryStreamu64KHR(EGLDisplay dpy, EGLStreamKHR stream,
         EGLenum attribute, EGLuint64KHR *value)
 {
+    EGL_COUNT_CALL();
     clearError();
 
     const egl_display_ptr dp = validate_display(dpy);
@@ -1927,6 +1989,7 @@ EGLBoolean eglQueryStreamu64KHR(EGLDisplay dpy, EGLStreamKHR stream,
 EGLBoolean eglQueryStreamTimeKHR(EGLDisplay dpy, EGLStreamKHR stream,
         EGLenum attribute, EGLTimeKHR *value)
 {
+    EGL_COUNT_CALL();
     clearError();
 
     const egl_display_ptr dp = validate_display(dpy);
@@ -1944,6 +2007,7 @@ EGLBoolean eglQueryStreamTimeKHR(EGLDisplay dpy, EGLStreamKHR stream,
 EGLSurface eglCreateStreamProducerSurfaceKHR(EGLDisplay dpy, EGLConfig config,
         EGLStreamKHR stream, const EGLint *attrib_list)
 {
+    EGL_COUNT_CALL();
     clearError();
 
     egl_display_ptr dp = validate_display(dpy);
@@ -1965,6 +2029,7 @@ EGLSurface eglCreateStreamProducerSurfaceKHR(EGLDisplay dpy, EGLConfig config,
 EGLBoolean eglStreamConsumerGLTextureExternalKHR(EGLDisplay dpy,
         EGLStreamKHR stream)
 {
+    EGL_COUNT_CALL();
     clearError();
 
     const egl_display_ptr dp = validate_display(dpy);
@@ -1982,6 +2047,7 @@ EGLBoolean eglStreamConsumerGLTextureExternalKHR(EGLDisplay dpy,
 EGLBoolean eglStreamConsumerAcquireKHR(EGLDisplay dpy,
         EGLStreamKHR stream)
 {
+    EGL_COUNT_CALL();
     clearError();
 
     const egl_display_ptr dp = validate_display(dpy);
@@ -1999,6 +2065,7 @@ EGLBoolean eglStreamConsumerAcquireKHR(EGLDisplay dpy,
 EGLBoolean eglStreamConsumerReleaseKHR(EGLDisplay dpy,
         EGLStreamKHR stream)
 {
+    EGL_COUNT_CALL();
     clearError();
 
     const egl_display_ptr dp = validate_display(dpy);
@@ -2016,6 +2083,7 @@ EGLBoolean eglStreamConsumerReleaseKHR(EGLDisplay dpy,
 EGLNativeFileDescriptorKHR eglGetStreamFileDescriptorKHR(
         EGLDisplay dpy, EGLStreamKHR stream)
 {
+    EGL_COUNT_CALL();
     clearError();
 
     const egl_display_ptr dp = validate_display(dpy);
@@ -2033,6 +2101,7 @@ EGLNativeFileDescriptorKHR eglGetStreamFileDescriptorKHR(
 EGLStreamKHR eglCreateStreamFromFileDescriptorKHR(
         EGLDisplay dpy, EGLNativeFileDescriptorKHR file_descriptor)
 {
+    EGL_COUNT_CALL();
     clearError();
 
     const egl_display_ptr dp = validate_display(dpy);
@@ -2052,6 +2121,7 @@ EGLStreamKHR eglCreateStreamFromFileDescriptorKHR(
 // ----------------------------------------------------------------------------
 
 EGLint eglWaitSyncKHR(EGLDisplay dpy, EGLSyncKHR sync, EGLint flags) {
+    EGL_COUNT_CALL();
     clearError();
     const egl_display_ptr dp = validate_display(dpy);
     if (!dp) return EGL_FALSE;
@@ -2069,6 +2139,7 @@ EGLint eglWaitSyncKHR(EGLDisplay dpy, EGLSyncKHR sync, EGLint flags) {
 
 EGLint eglDupNativeFenceFDANDROID(EGLDisplay dpy, EGLSyncKHR sync)
 {
+    EGL_COUNT_CALL();
     clearError();
 
     const egl_display_ptr dp = validate_display(dpy);
@@ -2085,6 +2156,7 @@ EGLint eglDupNativeFenceFDANDROID(EGLDisplay dpy, EGLSyncKHR sync)
 EGLBoolean eglPresentationTimeANDROID(EGLDisplay dpy, EGLSurface surface,
         EGLnsecsANDROID time)
 {
+    EGL_COUNT_CALL();
     clearError();
 
     const egl_display_ptr dp = validate_display(dpy);
@@ -2105,6 +2177,7 @@ EGLBoolean eglPresentationTimeANDROID(EGLDisplay dpy, EGLSurface surface,
 }
 
 EGLClientBuffer eglGetNativeClientBufferANDROID(const AHardwareBuffer *buffer) {
+    EGL_COUNT_CALL();
     clearError();
     // AHardwareBuffer_to_ANativeWindowBuffer is a platform-only symbol and thus
     // this function cannot be implemented when this libEGL is built for
@@ -2122,6 +2195,7 @@ EGLClientBuffer eglGetNativeClientBufferANDROID(const AHardwareBuffer *buffer) {
 // ----------------------------------------------------------------------------
 EGLuint64NV eglGetSystemTimeFrequencyNV()
 {
+    EGL_COUNT_CALL();
     clearError();
 
     if (egl_init_drivers() == EGL_FALSE) {
@@ -2140,6 +2214,7 @@ EGLuint64NV eglGetSystemTimeFrequencyNV()
 
 EGLuint64NV eglGetSystemTimeNV()
 {
+    EGL_COUNT_CALL();
     clearError();
 
     if (egl_init_drivers() == EGL_FALSE) {
@@ -2162,6 +2237,7 @@ EGLuint64NV eglGetSystemTimeNV()
 EGLBoolean eglSetDamageRegionKHR(EGLDisplay dpy, EGLSurface surface,
         EGLint *rects, EGLint n_rects)
 {
+    EGL_COUNT_CALL();
     clearError();
 
     const egl_display_ptr dp = validate_display(dpy);
@@ -2187,6 +2263,7 @@ EGLBoolean eglSetDamageRegionKHR(EGLDisplay dpy, EGLSurface surface,
 
 EGLBoolean eglGetNextFrameIdANDROID(EGLDisplay dpy, EGLSurface surface,
             EGLuint64KHR *frameId) {
+    EGL_COUNT_CALL();
     clearError();
 
     const egl_display_ptr dp = validate_display(dpy);
@@ -2222,6 +2299,7 @@ EGLBoolean eglGetNextFrameIdANDROID(EGLDisplay dpy, EGLSurface surface,
 EGLBoolean eglGetCompositorTimingANDROID(EGLDisplay dpy, EGLSurface surface,
         EGLint numTimestamps, const EGLint *names, EGLnsecsANDROID *values)
 {
+    EGL_COUNT_CALL();
     clearError();
 
     const egl_display_ptr dp = validate_display(dpy);
@@ -2279,6 +2357,7 @@ EGLBoolean eglGetCompositorTimingANDROID(EGLDisplay dpy, EGLSurface surface,
 EGLBoolean eglGetCompositorTimingSupportedANDROID(
         EGLDisplay dpy, EGLSurface surface, EGLint name)
 {
+    EGL_COUNT_CALL();
     clearError();
 
     const egl_display_ptr dp = validate_display(dpy);
@@ -2312,6 +2391,7 @@ EGLBoolean eglGetFrameTimestampsANDROID(EGLDisplay dpy, EGLSurface surface,
         EGLuint64KHR frameId, EGLint numTimestamps, const EGLint *timestamps,
         EGLnsecsANDROID *values)
 {
+    EGL_COUNT_CALL();
     clearError();
 
     const egl_display_ptr dp = validate_display(dpy);
@@ -2399,6 +2479,7 @@ EGLBoolean eglGetFrameTimestampsANDROID(EGLDisplay dpy, EGLSurface surface,
 EGLBoolean eglGetFrameTimestampSupportedANDROID(
         EGLDisplay dpy, EGLSurface surface, EGLint timestamp)
 {
+    EGL_COUNT_CALL();
     clearError();
 
     const egl_display_ptr dp = validate_display(dpy);
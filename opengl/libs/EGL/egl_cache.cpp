@@ -47,6 +47,13 @@ void egl_set_cache_filename(const char* filename) {
     egl_cache_t::get()->setCacheFilename(filename);
 }
 
+void egl_get_cache_stats(uint64_t* hits, uint64_t* misses, uint64_t* evictions) {
+    BlobCache::Stats stats = egl_cache_t::get()->getStats();
+    *hits = stats.hits;
+    *misses = stats.misses;
+    *evictions = stats.evictions;
+}
+
 //
 // Callback functions passed to EGL.
 //
@@ -132,7 +139,7 @@ void egl_cache_t::setBlob(const void* key, EGLsizeiANDROID keySize,
     }
 
     if (mInitialized) {
-        BlobCache* bc = getBlobCacheLocked();
+        FileBlobCache* bc = getBlobCacheLocked();
         bc->set(key, keySize, value, valueSize);
 
         if (!mSavePending) {
@@ -171,7 +178,15 @@ void egl_cache_t::setCacheFilename(const char* filename) {
     mFilename = filename;
 }
 
-BlobCache* egl_cache_t::getBlobCacheLocked() {
+BlobCache::Stats egl_cache_t::getStats() const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mBlobCache) {
+        return mBlobCache->getStats();
+    }
+    return BlobCache::Stats();
+}
+
+FileBlobCache* egl_cache_t::getBlobCacheLocked() {
     if (mBlobCache == nullptr) {
         mBlobCache.reset(new FileBlobCache(maxKeySize, maxValueSize, maxTotalSize, mFilename));
     }
@@ -67,6 +67,11 @@ public:
     // cache contents from one program invocation to another.
     void setCacheFilename(const char* filename);
 
+    // getStats returns the hit, miss and eviction counts of the cache since it
+    // was last loaded, and its current occupancy.  All counts are zero while
+    // the cache is not loaded.
+    BlobCache::Stats getStats() const;
+
 private:
     // Creation and (the lack of) destruction is handled internally.
     egl_cache_t();
@@ -80,7 +85,7 @@ private:
     // key/value blob pairs.  If the BlobCache object has not yet been created,
     // this will do so, loading the serialized cache contents from disk if
     // possible.
-    BlobCache* getBlobCacheLocked();
+    FileBlobCache* getBlobCacheLocked();
 
     // mInitialized indicates whether the egl_cache_t is in the initialized
     // state.  It is initialized to false at construction time, and gets set to
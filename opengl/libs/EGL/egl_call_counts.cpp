@@ -0,0 +1,333 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "egl_call_counts.h"
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/system_properties.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <cutils/properties.h>
+#include <log/log.h>
+
+#include <algorithm>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "egldefs.h"
+
+typedef __eglMustCastToProperFunctionPointerType EGLFuncPointer;
+
+// ----------------------------------------------------------------------------
+namespace android {
+// ----------------------------------------------------------------------------
+
+// The counters of the GL entry points come first, in the order of gl_t, then
+// those of the EGL functions, in the order they were first called.
+#undef GL_ENTRY
+#define GL_ENTRY(_r, _api, ...) GL_CALL_INDEX_##_api,
+enum {
+    #include "../entries.in"
+    GL_CALL_COUNT
+};
+#undef GL_ENTRY
+
+static constexpr size_t MAX_EGL_CALL_SITES = 128;
+static constexpr size_t MAX_COUNTERS = GL_CALL_COUNT + MAX_EGL_CALL_SITES;
+
+static constexpr char const* PERIOD_PROPERTY = "debug.egl.callcounts";
+static constexpr char const* DUMP_PROPERTY = "debug.egl.callcounts.dump";
+
+struct egl_call_counts_t::thread_counts_t {
+    struct counter_t {
+        std::atomic<uint64_t> calls{0};
+        std::atomic<uint64_t> sampledCalls{0};
+        std::atomic<uint64_t> sampledNs{0};
+    };
+
+    pid_t tid = 0;
+    // The hooks of the current context, that the counting hooks forward to.
+    gl_hooks_t const* hooks = nullptr;
+    // Only ever changed by the thread itself, or under sThreadsMutex once it
+    // exited, so the atomics are just so that dumps can read them.
+    counter_t counters[MAX_COUNTERS];
+};
+
+std::atomic<uint32_t> egl_call_counts_t::sPeriod(0);
+
+static std::atomic<size_t> sEglCallSiteCount(0);
+static std::atomic<char const*> sEglCallSiteNames[MAX_EGL_CALL_SITES];
+
+static gl_hooks_t sCountingHooks[2];
+
+static pthread_key_t sThreadKey;
+static std::mutex sThreadsMutex;
+// Protected by sThreadsMutex. Never destroyed, as threads may outlive statics.
+static std::vector<egl_call_counts_t::thread_counts_t*>* sThreads;
+static egl_call_counts_t::thread_counts_t* sExitedThreads;
+
+static std::atomic<prop_info const*> sDumpProperty(nullptr);
+static std::atomic<uint32_t> sDumpSerial(0);
+
+static inline void increment(std::atomic<uint64_t>& counter, uint64_t value) {
+    counter.store(counter.load(std::memory_order_relaxed) + value,
+            std::memory_order_relaxed);
+}
+
+static int64_t threadCpuTimeNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return int64_t(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+// ----------------------------------------------------------------------------
+// GL counting wrappers
+// ----------------------------------------------------------------------------
+
+template <size_t Index, typename Entry>
+struct gl_counting_entry_t;
+
+template <size_t Index, typename R, typename... Args>
+struct gl_counting_entry_t<Index, R (*)(Args...)> {
+    static R call(Args... args) {
+        egl_call_counts_t::thread_counts_t* const thread =
+                egl_call_counts_t::getThread();
+        egl_call_count_scope_t scope(thread, Index);
+        EGLFuncPointer const* entries =
+                reinterpret_cast<EGLFuncPointer const*>(&thread->hooks->gl);
+        return reinterpret_cast<R (*)(Args...)>(entries[Index])(args...);
+    }
+};
+
+#define GL_ENTRY(_r, _api, ...)                                             \
+    reinterpret_cast<EGLFuncPointer>(&gl_counting_entry_t<                  \
+            GL_CALL_INDEX_##_api, decltype(gl_hooks_t::gl_t::_api)>::call),
+static EGLFuncPointer const sCountingEntries[] = {
+    #include "../entries.in"
+};
+#undef GL_ENTRY
+
+static_assert(sizeof(sCountingEntries) == sizeof(gl_hooks_t::gl_t),
+        "the counting wrappers must match gl_t");
+
+// ----------------------------------------------------------------------------
+
+static void onThreadExit(void* value) {
+    egl_call_counts_t::thread_counts_t* thread =
+            static_cast<egl_call_counts_t::thread_counts_t*>(value);
+    std::lock_guard<std::mutex> lock(sThreadsMutex);
+    for (size_t i = 0; i < MAX_COUNTERS; i++) {
+        auto& from = thread->counters[i];
+        auto& to = sExitedThreads->counters[i];
+        increment(to.calls, from.calls.load(std::memory_order_relaxed));
+        increment(to.sampledCalls,
+                from.sampledCalls.load(std::memory_order_relaxed));
+        increment(to.sampledNs, from.sampledNs.load(std::memory_order_relaxed));
+    }
+    sThreads->erase(std::remove(sThreads->begin(), sThreads->end(), thread),
+            sThreads->end());
+    delete thread;
+}
+
+void egl_call_counts_t::initialize() {
+    if (isEnabled()) {
+        return;
+    }
+
+    char value[PROPERTY_VALUE_MAX];
+    property_get(PERIOD_PROPERTY, value, "0");
+    const int period = atoi(value);
+    if (period <= 0) {
+        return;
+    }
+
+    if (pthread_key_create(&sThreadKey, onThreadExit) != 0) {
+        ALOGE("failed to create the key of the EGL call counters");
+        return;
+    }
+    sThreads = new std::vector<thread_counts_t*>();
+    sExitedThreads = new thread_counts_t();
+
+    for (size_t i = 0; i < NELEM(sCountingHooks); i++) {
+        memcpy(&sCountingHooks[i].gl, sCountingEntries,
+                sizeof(sCountingEntries));
+        sCountingHooks[i].ext = gHooks[i].ext;
+    }
+
+    prop_info const* dumpProperty = __system_property_find(DUMP_PROPERTY);
+    if (dumpProperty) {
+        sDumpSerial.store(__system_property_serial(dumpProperty));
+        sDumpProperty.store(dumpProperty);
+    }
+
+    ALOGI("counting EGL and GL calls, timing one in %d", period);
+    sPeriod.store(period);
+}
+
+gl_hooks_t const* egl_call_counts_t::wrapHooks(gl_hooks_t const* hooks) {
+    for (size_t i = 0; i < NELEM(sCountingHooks); i++) {
+        if (hooks == &gHooks[i]) {
+            getThread()->hooks = hooks;
+            return &sCountingHooks[i];
+        }
+    }
+    // there is nothing to count without a context
+    return hooks;
+}
+
+void egl_call_counts_t::setExtension(int slot, EGLFuncPointer addr) {
+    if (!isEnabled()) {
+        return;
+    }
+    for (size_t i = 0; i < NELEM(sCountingHooks); i++) {
+        sCountingHooks[i].ext.extensions[slot] = addr;
+    }
+}
+
+size_t egl_call_counts_t::registerEglCallSite(const char* name) {
+    const size_t site = sEglCallSiteCount.fetch_add(1);
+    if (site >= MAX_EGL_CALL_SITES) {
+        ALOGW("no more EGL call counters for %s", name);
+        return MAX_COUNTERS;
+    }
+    sEglCallSiteNames[site].store(name);
+    return GL_CALL_COUNT + site;
+}
+
+egl_call_counts_t::thread_counts_t* egl_call_counts_t::getThread() {
+    thread_counts_t* thread =
+            static_cast<thread_counts_t*>(pthread_getspecific(sThreadKey));
+    if (!thread) {
+        thread = new thread_counts_t();
+        thread->tid = gettid();
+        pthread_setspecific(sThreadKey, thread);
+        std::lock_guard<std::mutex> lock(sThreadsMutex);
+        sThreads->push_back(thread);
+    }
+    return thread;
+}
+
+int64_t egl_call_counts_t::begin(thread_counts_t* thread, size_t index) {
+    if (index >= MAX_COUNTERS) {
+        return -1;
+    }
+    auto& counter = thread->counters[index];
+    const uint64_t calls = counter.calls.load(std::memory_order_relaxed);
+    counter.calls.store(calls + 1, std::memory_order_relaxed);
+    if (calls % sPeriod.load(std::memory_order_relaxed)) {
+        return -1;
+    }
+    return threadCpuTimeNs();
+}
+
+void egl_call_counts_t::end(thread_counts_t* thread, size_t index,
+        int64_t start) {
+    if (start < 0) {
+        return;
+    }
+    auto& counter = thread->counters[index];
+    increment(counter.sampledCalls, 1);
+    increment(counter.sampledNs, threadCpuTimeNs() - start);
+}
+
+static char const* getCounterName(size_t index) {
+    if (index < GL_CALL_COUNT) {
+        return gl_names[index];
+    }
+    return sEglCallSiteNames[index - GL_CALL_COUNT].load();
+}
+
+// Logs the entry points called, by decreasing CPU time estimated from the
+// sampled calls.
+static void dumpThread(char const* label,
+        const egl_call_counts_t::thread_counts_t& thread) {
+    std::vector<std::pair<uint64_t, size_t>> order;
+    for (size_t i = 0; i < MAX_COUNTERS; i++) {
+        const auto& counter = thread.counters[i];
+        const uint64_t calls = counter.calls.load(std::memory_order_relaxed);
+        if (calls == 0) {
+            continue;
+        }
+        const uint64_t sampledCalls =
+                counter.sampledCalls.load(std::memory_order_relaxed);
+        const uint64_t sampledNs =
+                counter.sampledNs.load(std::memory_order_relaxed);
+        order.emplace_back(
+                sampledCalls ? sampledNs / sampledCalls * calls : 0, i);
+    }
+    if (order.empty()) {
+        return;
+    }
+    std::sort(order.begin(), order.end(),
+            [](const std::pair<uint64_t, size_t>& a,
+                    const std::pair<uint64_t, size_t>& b) {
+                return a.first > b.first;
+            });
+
+    ALOGI("%s:", label);
+    for (const auto& entry : order) {
+        const auto& counter = thread.counters[entry.second];
+        const uint64_t calls = counter.calls.load(std::memory_order_relaxed);
+        const uint64_t sampledCalls =
+                counter.sampledCalls.load(std::memory_order_relaxed);
+        const uint64_t sampledNs =
+                counter.sampledNs.load(std::memory_order_relaxed);
+        ALOGI("  %s: calls=%" PRIu64 " avg_us=%.2f total_us=%" PRIu64,
+                getCounterName(entry.second), calls,
+                sampledCalls ? sampledNs / 1000.0 / sampledCalls : 0.0,
+                entry.first / 1000);
+    }
+}
+
+void egl_call_counts_t::dumpIfRequested() {
+    if (!isEnabled()) {
+        return;
+    }
+    prop_info const* dumpProperty = sDumpProperty.load();
+    if (!dumpProperty) {
+        dumpProperty = __system_property_find(DUMP_PROPERTY);
+        if (!dumpProperty) {
+            return;
+        }
+        sDumpProperty.store(dumpProperty);
+    }
+    uint32_t lastSerial = sDumpSerial.load();
+    const uint32_t serial = __system_property_serial(dumpProperty);
+    if (serial == lastSerial ||
+            !sDumpSerial.compare_exchange_strong(lastSerial, serial)) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(sThreadsMutex);
+    ALOGI("EGL call counts, CPU time sampled once every %u calls",
+            sPeriod.load());
+    char label[32];
+    for (const thread_counts_t* thread : *sThreads) {
+        snprintf(label, sizeof(label), "thread %d", thread->tid);
+        dumpThread(label, *thread);
+    }
+    dumpThread("exited threads", *sExitedThreads);
+}
+
+// ----------------------------------------------------------------------------
+}; // namespace android
+// ----------------------------------------------------------------------------
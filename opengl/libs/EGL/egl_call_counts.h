@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_EGL_CALL_COUNTS_H
+#define ANDROID_EGL_CALL_COUNTS_H
+
+#include <EGL/egl.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+
+// ----------------------------------------------------------------------------
+namespace android {
+// ----------------------------------------------------------------------------
+
+struct gl_hooks_t;
+
+// Counts, per thread, the calls made to each GL and EGL entry point, and the
+// thread CPU time spent in one call out of every N to each of them, when the
+// debug.egl.callcounts property is set to N when EGL is initialized. GL calls
+// go through a table of counting wrappers in front of the hooks of the current
+// context, so nothing changes for them when counting is off, and EGL calls
+// count themselves with EGL_COUNT_CALL().
+//
+// The counts so far are written to the log each time debug.egl.callcounts.dump
+// changes, e.g. with "adb shell setprop debug.egl.callcounts.dump $RANDOM".
+class egl_call_counts_t {
+public:
+    struct thread_counts_t;
+
+    // initialize reads the properties, and when counting is on sets up the
+    // counting hooks. This should be called when the drivers are loaded,
+    // before any context is made current.
+    static void initialize();
+
+    static bool isEnabled() {
+        return sPeriod.load(std::memory_order_relaxed) != 0;
+    }
+
+    // wrapHooks returns the hooks to make current on this thread in place of
+    // the given ones, which the counting wrappers forward to.
+    static gl_hooks_t const* wrapHooks(gl_hooks_t const* hooks);
+
+    // setExtension mirrors an extension eglGetProcAddress resolved into the
+    // counting hooks, so that its forwarder works with them current.
+    static void setExtension(int slot,
+            __eglMustCastToProperFunctionPointerType addr);
+
+    // dumpIfRequested logs the counts if debug.egl.callcounts.dump changed
+    // since the last time.
+    static void dumpIfRequested();
+
+    // registerEglCallSite returns the counter index of a function counting
+    // itself with EGL_COUNT_CALL().
+    static size_t registerEglCallSite(const char* name);
+
+    // begin counts a call on this thread, and returns the thread CPU time
+    // if the call is sampled, or -1.
+    static int64_t begin(thread_counts_t* thread, size_t index);
+    static void end(thread_counts_t* thread, size_t index, int64_t start);
+
+    // getThread returns the counters of the calling thread, creating them.
+    static thread_counts_t* getThread();
+
+private:
+    static std::atomic<uint32_t> sPeriod;
+};
+
+class egl_call_count_scope_t {
+public:
+    inline explicit egl_call_count_scope_t(size_t index)
+            : mThread(nullptr), mIndex(index), mStart(-1) {
+        if (egl_call_counts_t::isEnabled()) {
+            mThread = egl_call_counts_t::getThread();
+            mStart = egl_call_counts_t::begin(mThread, mIndex);
+        }
+    }
+
+    inline egl_call_count_scope_t(egl_call_counts_t::thread_counts_t* thread,
+            size_t index)
+            : mThread(thread), mIndex(index),
+              mStart(egl_call_counts_t::begin(thread, index)) {
+    }
+
+    inline ~egl_call_count_scope_t() {
+        if (mThread) {
+            egl_call_counts_t::end(mThread, mIndex, mStart);
+        }
+    }
+
+private:
+    egl_call_counts_t::thread_counts_t* mThread;
+    size_t mIndex;
+    int64_t mStart;
+};
+
+// EGL_COUNT_CALL counts a call to the current function, until the end of its
+// enclosing scope.
+#define EGL_COUNT_CALL()                                                     \
+    static const size_t __egl_call_site =                                    \
+            android::egl_call_counts_t::registerEglCallSite(__FUNCTION__);   \
+    android::egl_call_count_scope_t __egl_call_count(__egl_call_site)
+
+// ----------------------------------------------------------------------------
+}; // namespace android
+// ----------------------------------------------------------------------------
+
+#endif // ANDROID_EGL_CALL_COUNTS_H
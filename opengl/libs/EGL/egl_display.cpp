@@ -30,6 +30,8 @@
 #include "Loader.h"
 #include <cutils/properties.h>
 
+#include <thread>
+
 #include <android/hardware/configstore/1.0/ISurfaceFlingerConfigs.h>
 #include <configstore/Utils.h>
 
@@ -73,7 +75,12 @@ int egl_get_init_count(EGLDisplay dpy) {
 egl_display_t egl_display_t::sDisplay[NUM_DISPLAYS];
 
 egl_display_t::egl_display_t() :
-    magic('_dpy'), finishOnSwap(false), traceGpuCompletion(false), refs(0), eglIsInitialized(false) {
+    magic('_dpy'), finishOnSwap(false), traceGpuCompletion(false), refs(0), eglIsInitialized(false),
+    overflowCount(0) {
+    for (ObjectSlot& slot : objectSlots) {
+        slot.object.store(nullptr, std::memory_order_relaxed);
+        slot.pins.store(0, std::memory_order_relaxed);
+    }
 }
 
 egl_display_t::~egl_display_t() {
@@ -93,17 +100,73 @@ egl_display_t* egl_display_t::get(EGLDisplay dpy) {
     return &sDisplay[index];
 }
 
+size_t egl_display_t::objectSlotIndex(egl_object_t const* object) {
+    // objects are heap allocated, so the low bits of their address carry nothing
+    uint32_t hash = uint32_t(uintptr_t(object) >> 4);
+    hash ^= hash >> 16;
+    hash *= 0x45d9f3bU;
+    hash ^= hash >> 16;
+    return hash % kObjectSlotCount;
+}
+
+void egl_display_t::clearObjectSlot(ObjectSlot& slot) {
+    slot.object.store(nullptr);
+    // a lookup that pinned the slot before it was cleared may still be taking
+    // a reference; the caller is about to drop one, so wait for it.
+    while (slot.pins.load() != 0) {
+        std::this_thread::yield();
+    }
+}
+
 void egl_display_t::addObject(egl_object_t* object) {
     std::lock_guard<std::mutex> _l(lock);
+    const size_t start = objectSlotIndex(object);
+    for (size_t i = 0; i < kObjectProbeCount; i++) {
+        ObjectSlot& slot = objectSlots[(start + i) % kObjectSlotCount];
+        if (slot.object.load(std::memory_order_relaxed) == nullptr) {
+            slot.object.store(object, std::memory_order_release);
+            return;
+        }
+    }
     objects.insert(object);
+    overflowCount.store(objects.size(), std::memory_order_release);
 }
 
 void egl_display_t::removeObject(egl_object_t* object) {
     std::lock_guard<std::mutex> _l(lock);
+    const size_t start = objectSlotIndex(object);
+    for (size_t i = 0; i < kObjectProbeCount; i++) {
+        ObjectSlot& slot = objectSlots[(start + i) % kObjectSlotCount];
+        if (slot.object.load(std::memory_order_relaxed) == object) {
+            clearObjectSlot(slot);
+            return;
+        }
+    }
     objects.erase(object);
+    overflowCount.store(objects.size(), std::memory_order_release);
 }
 
 bool egl_display_t::getObject(egl_object_t* object) const {
+    const size_t start = objectSlotIndex(object);
+    for (size_t i = 0; i < kObjectProbeCount; i++) {
+        const ObjectSlot& slot = objectSlots[(start + i) % kObjectSlotCount];
+        if (slot.object.load(std::memory_order_relaxed) != object) {
+            continue;
+        }
+        // the object can't be deleted while the slot is pinned, as long as
+        // it is still in the slot once pinned.
+        slot.pins.fetch_add(1);
+        bool valid = slot.object.load() == object && object->getDisplay() == this;
+        if (valid) {
+            object->incRef();
+        }
+        slot.pins.fetch_sub(1, std::memory_order_release);
+        return valid;
+    }
+
+    if (overflowCount.load(std::memory_order_acquire) == 0) {
+        return false;
+    }
     std::lock_guard<std::mutex> _l(lock);
     if (objects.find(object) != objects.end()) {
         if (object->getDisplay() == this) {
@@ -328,6 +391,15 @@ EGLBoolean egl_display_t::terminate() {
         // there are no reference to them, it which case, we're free to
         // delete them.
         size_t count = objects.size();
+        for (ObjectSlot& slot : objectSlots) {
+            egl_object_t* o = slot.object.load(std::memory_order_relaxed);
+            if (o) {
+                // this marks the object handle as "terminated"
+                clearObjectSlot(slot);
+                o->destroy();
+                count++;
+            }
+        }
         ALOGW_IF(count, "eglTerminate() called w/ %zu objects remaining", count);
         for (auto o : objects) {
             o->destroy();
@@ -335,6 +407,7 @@ EGLBoolean egl_display_t::terminate() {
 
         // this marks all object handles are "terminated"
         objects.clear();
+        overflowCount.store(0, std::memory_order_release);
     }
 
     { // scope for refLock
@@ -21,6 +21,7 @@
 #include <stdint.h>
 #include <stddef.h>
 
+#include <atomic>
 #include <condition_variable>
 #include <mutex>
 #include <string>
@@ -118,11 +119,29 @@ public:
 private:
     friend class egl_display_ptr;
 
+    // Objects are validated without taking |lock|: each one lives in one of a
+    // few slots picked by its address, and a lookup pins the slot it finds
+    // the object in while taking a reference. Removing an object clears its
+    // slot and waits for the pins to go away, so a reference is never taken
+    // on a deleted object. The rare object that finds no free slot goes to
+    // |objects|, which is only looked at while |overflowCount| is non-zero.
+    struct ObjectSlot {
+                std::atomic<egl_object_t*>  object;
+        mutable std::atomic<uint32_t>       pins;
+    };
+    static constexpr size_t kObjectSlotCount = 1024;
+    static constexpr size_t kObjectProbeCount = 8;
+    static size_t objectSlotIndex(egl_object_t const* object);
+    // clears |slot| and waits for the lookups of its object to finish.
+    static void clearObjectSlot(ObjectSlot& slot);
+
             uint32_t                    refs;
             bool                        eglIsInitialized;
     mutable std::mutex                  lock;
     mutable std::mutex                  refLock;
     mutable std::condition_variable     refCond;
+            ObjectSlot                  objectSlots[kObjectSlotCount];
+            std::atomic<size_t>         overflowCount;
             std::unordered_set<egl_object_t*> objects;
             std::string mVendorString;
             std::string mVersionString;
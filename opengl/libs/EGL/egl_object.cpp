@@ -49,7 +49,8 @@ void egl_object_t::destroy() {
 
 bool egl_object_t::get(egl_display_t const* display, egl_object_t* object) {
     // used by LocalRef, this does an incRef() atomically with
-    // checking that the object is valid.
+    // checking that the object is valid. This doesn't take the display's
+    // lock, it's called by every EGL call that takes a surface or context.
     return display->getObject(object);
 }
 
@@ -18,8 +18,13 @@
 
 #include <cutils/compiler.h>
 
+#include <stdint.h>
+
 namespace android {
 
 ANDROID_API void egl_set_cache_filename(const char* filename);
 
+// Reads the hit, miss and eviction counts of the shader blob cache.
+ANDROID_API void egl_get_cache_stats(uint64_t* hits, uint64_t* misses, uint64_t* evictions);
+
 } // namespace android
@@ -163,41 +163,14 @@ inline int convertDiff(int base, int diff) {
     return convert5To8((0x1f & base) + kLookup[0x7 & diff]);
 }
 
-static
-void decode_subblock(etc1_byte* pOut, int r, int g, int b, const int* table,
-        etc1_uint32 low, bool second, bool flipped) {
-    int baseX = 0;
-    int baseY = 0;
-    if (second) {
-        if (flipped) {
-            baseY = 2;
-        } else {
-            baseX = 2;
-        }
-    }
-    for (int i = 0; i < 8; i++) {
-        int x, y;
-        if (flipped) {
-            x = baseX + (i >> 1);
-            y = baseY + (i & 1);
-        } else {
-            x = baseX + (i >> 2);
-            y = baseY + (i & 3);
-        }
-        int k = y + (x * 4);
-        int offset = ((low >> k) & 1) | ((low >> (k + 15)) & 2);
-        int delta = table[offset];
-        etc1_byte* q = pOut + 3 * (x + 4 * y);
-        *q++ = clamp(r + delta);
-        *q++ = clamp(g + delta);
-        *q++ = clamp(b + delta);
-    }
-}
-
-// Input is an ETC1 compressed version of the data.
-// Output is a 4 x 4 square of 3-byte pixels in form R, G, B
-
-void etc1_decode_block(const etc1_byte* pIn, etc1_byte* pOut) {
+// Decodes the block at pIn into the pixels of the image at pOut, one row every stride bytes,
+// writing xEnd x yEnd pixels of pixelSize bytes: R, G, B or RGB565.
+// Each subblock can only take four colors, so they are computed once and the pixels just
+// look theirs up.
+
+static inline
+void decode_block(const etc1_byte* pIn, etc1_byte* pOut, etc1_uint32 pixelSize,
+        etc1_uint32 stride, etc1_uint32 xEnd, etc1_uint32 yEnd) {
     etc1_uint32 high = (pIn[0] << 24) | (pIn[1] << 16) | (pIn[2] << 8) | pIn[3];
     etc1_uint32 low = (pIn[4] << 24) | (pIn[5] << 16) | (pIn[6] << 8) | pIn[7];
     int r1, r2, g1, g2, b1, b2;
@@ -221,13 +194,54 @@ void etc1_decode_block(const etc1_byte* pIn, etc1_byte* pOut) {
         b1 = convert4To8(high >> 12);
         b2 = convert4To8(high >> 8);
     }
-    int tableIndexA = 7 & (high >> 5);
-    int tableIndexB = 7 & (high >> 2);
-    const int* tableA = kModifierTable + tableIndexA * 4;
-    const int* tableB = kModifierTable + tableIndexB * 4;
+    const int* tableA = kModifierTable + (7 & (high >> 5)) * 4;
+    const int* tableB = kModifierTable + (7 & (high >> 2)) * 4;
     bool flipped = (high & 1) != 0;
-    decode_subblock(pOut, r1, g1, b1, tableA, low, false, flipped);
-    decode_subblock(pOut, r2, g2, b2, tableB, low, true, flipped);
+
+    etc1_byte colors[2][4][3];
+    etc1_uint32 colors565[2][4];
+    for (int i = 0; i < 4; i++) {
+        colors[0][i][0] = clamp(r1 + tableA[i]);
+        colors[0][i][1] = clamp(g1 + tableA[i]);
+        colors[0][i][2] = clamp(b1 + tableA[i]);
+        colors[1][i][0] = clamp(r2 + tableB[i]);
+        colors[1][i][1] = clamp(g2 + tableB[i]);
+        colors[1][i][2] = clamp(b2 + tableB[i]);
+    }
+    if (pixelSize == 2) {
+        for (int s = 0; s < 2; s++) {
+            for (int i = 0; i < 4; i++) {
+                const etc1_byte* q = colors[s][i];
+                colors565[s][i] = ((q[0] >> 3) << 11) | ((q[1] >> 2) << 5) | (q[2] >> 3);
+            }
+        }
+    }
+
+    for (etc1_uint32 y = 0; y < yEnd; y++) {
+        etc1_byte* p = pOut + stride * y;
+        for (etc1_uint32 x = 0; x < xEnd; x++) {
+            int k = y + (x * 4);
+            int offset = ((low >> k) & 1) | ((low >> (k + 15)) & 2);
+            int subblock = flipped ? (y >> 1) : (x >> 1);
+            if (pixelSize == 3) {
+                const etc1_byte* q = colors[subblock][offset];
+                *p++ = q[0];
+                *p++ = q[1];
+                *p++ = q[2];
+            } else {
+                etc1_uint32 pixel = colors565[subblock][offset];
+                *p++ = (etc1_byte) pixel;
+                *p++ = (etc1_byte) (pixel >> 8);
+            }
+        }
+    }
+}
+
+// Input is an ETC1 compressed version of the data.
+// Output is a 4 x 4 square of 3-byte pixels in form R, G, B
+
+void etc1_decode_block(const etc1_byte* pIn, etc1_byte* pOut) {
+    decode_block(pIn, pOut, 3, 4 * 3, 4, 4);
 }
 
 typedef struct {
@@ -571,8 +585,6 @@ int etc1_decode_image(const etc1_byte* pIn, etc1_byte* pOut,
     if (pixelSize < 2 || pixelSize > 3) {
         return -1;
     }
-    etc1_byte block[ETC1_DECODED_BLOCK_SIZE];
-
     etc1_uint32 encodedWidth = (width + 3) & ~3;
     etc1_uint32 encodedHeight = (height + 3) & ~3;
 
@@ -586,24 +598,18 @@ int etc1_decode_image(const etc1_byte* pIn, etc1_byte* pOut,
             if (xEnd > 4) {
                 xEnd = 4;
             }
-            etc1_decode_block(pIn, block);
-            pIn += ETC1_ENCODED_BLOCK_SIZE;
-            for (etc1_uint32 cy = 0; cy < yEnd; cy++) {
-                const etc1_byte* q = block + (cy * 4) * 3;
-                etc1_byte* p = pOut + pixelSize * x + stride * (y + cy);
+            etc1_byte* p = pOut + pixelSize * x + stride * y;
+            // Constant arguments let the compiler unroll the common case.
+            if (xEnd == 4 && yEnd == 4) {
                 if (pixelSize == 3) {
-                    memcpy(p, q, xEnd * 3);
+                    decode_block(pIn, p, 3, stride, 4, 4);
                 } else {
-                    for (etc1_uint32 cx = 0; cx < xEnd; cx++) {
-                        etc1_byte r = *q++;
-                        etc1_byte g = *q++;
-                        etc1_byte b = *q++;
-                        etc1_uint32 pixel = ((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3);
-                        *p++ = (etc1_byte) pixel;
-                        *p++ = (etc1_byte) (pixel >> 8);
-                    }
+                    decode_block(pIn, p, 2, stride, 4, 4);
                 }
+            } else {
+                decode_block(pIn, p, pixelSize, stride, xEnd, yEnd);
             }
+            pIn += ETC1_ENCODED_BLOCK_SIZE;
         }
     }
     return 0;
@@ -16,6 +16,8 @@
 
 #include <gtest/gtest.h>
 
+#include <vector>
+
 #include <android/hardware/configstore/1.0/ISurfaceFlingerConfigs.h>
 
 #include <configstore/Utils.h>
@@ -162,6 +164,42 @@ TEST_F(EGLTest, EGLTerminateSucceedsWithRemainingObjects) {
     // eglTerminate is called in the tear down and should destroy it for us
 }
 
+TEST_F(EGLTest, EGLSurfacesStayValidUntilDestroyed) {
+    EGLint numConfigs;
+    EGLConfig config;
+    EGLint attrs[] = {
+        EGL_SURFACE_TYPE,       EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE,    EGL_OPENGL_ES2_BIT,
+        EGL_NONE
+    };
+    ASSERT_TRUE(eglChooseConfig(mEglDisplay, attrs, &config, 1, &numConfigs));
+    ASSERT_GE(numConfigs, 1);
+
+    // More surfaces than the display has slots for, so some of them are
+    // looked up the slow way.
+    const EGLint pbufferAttrs[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+    std::vector<EGLSurface> surfaces;
+    for (int i = 0; i < 1500; i++) {
+        EGLSurface surface = eglCreatePbufferSurface(mEglDisplay, config, pbufferAttrs);
+        ASSERT_NE(EGL_NO_SURFACE, surface);
+        surfaces.push_back(surface);
+    }
+
+    EGLint value;
+    for (EGLSurface surface : surfaces) {
+        EXPECT_TRUE(eglQuerySurface(mEglDisplay, surface, EGL_WIDTH, &value));
+        EXPECT_EQ(1, value);
+    }
+
+    for (EGLSurface surface : surfaces) {
+        EXPECT_TRUE(eglDestroySurface(mEglDisplay, surface));
+    }
+    for (EGLSurface surface : surfaces) {
+        EXPECT_FALSE(eglQuerySurface(mEglDisplay, surface, EGL_WIDTH, &value));
+        EXPECT_EQ(EGL_BAD_SURFACE, eglGetError());
+    }
+}
+
 TEST_F(EGLTest, EGLConfigRGBA8888First) {
 
     EGLint numConfigs;
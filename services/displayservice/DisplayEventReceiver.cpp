@@ -89,11 +89,12 @@ int DisplayEventReceiver::AttachedEvent::handleEvent(int fd, int events, void* /
         return 1; // keep the callback
     }
 
-    constexpr size_t SIZE = 1;
+    constexpr size_t SIZE = 8;
 
+    // Only the newest of the vsyncs queued up is worth a callback.
     ssize_t n;
     FwkReceiver::Event buf[SIZE];
-    while ((n = mFwkReceiver.getEvents(buf, SIZE)) > 0) {
+    while ((n = mFwkReceiver.getLatestVsync(buf, SIZE, nullptr)) > 0) {
         for (size_t i = 0; i < static_cast<size_t>(n); ++i) {
             const FwkReceiver::Event &event = buf[i];
 
@@ -49,6 +49,7 @@
 
 #include <input/KeyLayoutMap.h>
 #include <input/KeyCharacterMap.h>
+#include <input/KeyMapCache.h>
 #include <input/VirtualKeyMap.h>
 
 /* this macro is used to tell if "bit" is set in "array"
@@ -191,6 +192,22 @@ bool EventHub::Device::hasValidFd() {
     return !isVirtual && enabled;
 }
 
+// --- EventHub::DeviceLoaderThread ---
+
+class EventHub::DeviceLoaderThread : public Thread {
+public:
+    explicit DeviceLoaderThread(EventHub* eventHub) :
+            Thread(/*canCallJava*/ false), mEventHub(eventHub) {
+    }
+
+private:
+    EventHub* mEventHub;
+
+    virtual bool threadLoop() {
+        return mEventHub->loadNextDevice();
+    }
+};
+
 // --- EventHub ---
 
 const uint32_t EventHub::EPOLL_ID_INOTIFY;
@@ -203,9 +220,16 @@ EventHub::EventHub(void) :
         mOpeningDevices(0), mClosingDevices(0),
         mNeedToSendFinishedDeviceScan(false),
         mNeedToReopenDevices(false), mNeedToScanDevices(true),
-        mPendingEventCount(0), mPendingEventIndex(0), mPendingINotify(false) {
+        mPendingEventCount(0), mPendingEventIndex(0), mPendingINotify(false),
+        mPollWakeups(0), mFullPolls(0), mEventsRead(0), mEventsSinceWakeup(0),
+        mMaxEventsPerWakeup(0), mLoaderExiting(false) {
     acquire_wake_lock(PARTIAL_WAKE_LOCK, WAKE_LOCK_ID);
 
+    // Keep compiled key maps so that devices do not reparse them every time they connect.
+    char keyMapCacheDir[PROPERTY_VALUE_MAX];
+    property_get("debug.input.keymap_cache_dir", keyMapCacheDir, "");
+    KeyMapCache::setDirectory(String8(keyMapCacheDir));
+
     mEpollFd = epoll_create(EPOLL_SIZE_HINT);
     LOG_ALWAYS_FATAL_IF(mEpollFd < 0, "Could not create epoll instance.  errno=%d", errno);
 
@@ -248,6 +272,7 @@ EventHub::EventHub(void) :
 }
 
 EventHub::~EventHub(void) {
+    stopDeviceLoader();
     closeAllDevicesLocked();
 
     while (mClosingDevices) {
@@ -782,6 +807,8 @@ size_t EventHub::getEvents(int timeoutMillis, RawEvent* buffer, size_t bufferSiz
             mNeedToSendFinishedDeviceScan = true;
         }
 
+        registerLoadedDevicesLocked();
+
         while (mOpeningDevices != NULL) {
             Device* device = mOpeningDevices;
             ALOGV("Reporting device opened: id=%d, name=%s\n",
@@ -864,6 +891,11 @@ size_t EventHub::getEvents(int timeoutMillis, RawEvent* buffer, size_t bufferSiz
                     int32_t deviceId = device->id == mBuiltInKeyboardId ? 0 : device->id;
 
                     size_t count = size_t(readSize) / sizeof(struct input_event);
+                    mEventsRead += count;
+                    mEventsSinceWakeup += count;
+                    if (mEventsSinceWakeup > mMaxEventsPerWakeup) {
+                        mMaxEventsPerWakeup = mEventsSinceWakeup;
+                    }
                     for (size_t i = 0; i < count; i++) {
                         struct input_event& iev = readBuffer[i];
                         ALOGV("%s got: time=%d.%06d, type=%d, code=%d, value=%d",
@@ -1006,7 +1038,11 @@ size_t EventHub::getEvents(int timeoutMillis, RawEvent* buffer, size_t bufferSiz
         mLock.unlock(); // release lock before poll, must be before release_wake_lock
         release_wake_lock(WAKE_LOCK_ID);
 
-        int pollResult = epoll_wait(mEpollFd, mPendingEventItems, EPOLL_MAX_EVENTS, timeoutMillis);
+        int maxEvents = EPOLL_MAX_EVENTS;
+        if (mDevices.size() + 2 < size_t(maxEvents)) {
+            maxEvents = int(mDevices.size() + 2);
+        }
+        int pollResult = epoll_wait(mEpollFd, mPendingEventItems, maxEvents, timeoutMillis);
 
         acquire_wake_lock(PARTIAL_WAKE_LOCK, WAKE_LOCK_ID);
         mLock.lock(); // reacquire lock after poll, must be after acquire_wake_lock
@@ -1030,6 +1066,11 @@ size_t EventHub::getEvents(int timeoutMillis, RawEvent* buffer, size_t bufferSiz
         } else {
             // Some events occurred.
             mPendingEventCount = size_t(pollResult);
+            mPollWakeups += 1;
+            mEventsSinceWakeup = 0;
+            if (pollResult == maxEvents) {
+                mFullPolls += 1;
+            }
         }
     }
 
@@ -1108,6 +1149,14 @@ status_t EventHub::unregisterDeviceFromEpollLocked(Device* device) {
 }
 
 status_t EventHub::openDeviceLocked(const char *devicePath) {
+    Device* device = loadDevice(mNextDeviceId++, devicePath);
+    if (device == NULL) {
+        return -1;
+    }
+    return registerDeviceLocked(device);
+}
+
+EventHub::Device* EventHub::loadDevice(int32_t deviceId, const char *devicePath) {
     char buffer[80];
 
     ALOGV("Opening device: %s", devicePath);
@@ -1115,7 +1164,7 @@ status_t EventHub::openDeviceLocked(const char *devicePath) {
     int fd = open(devicePath, O_RDWR | O_CLOEXEC | O_NONBLOCK);
     if(fd < 0) {
         ALOGE("could not open %s, %s\n", devicePath, strerror(errno));
-        return -1;
+        return NULL;
     }
 
     InputDeviceIdentifier identifier;
@@ -1128,22 +1177,12 @@ status_t EventHub::openDeviceLocked(const char *devicePath) {
         identifier.name.setTo(buffer);
     }
 
-    // Check to see if the device is on our excluded list
-    for (size_t i = 0; i < mExcludedDevices.size(); i++) {
-        const String8& item = mExcludedDevices.itemAt(i);
-        if (identifier.name == item) {
-            ALOGI("ignoring event id %s driver %s\n", devicePath, item.string());
-            close(fd);
-            return -1;
-        }
-    }
-
     // Get device driver version.
     int driverVersion;
     if(ioctl(fd, EVIOCGVERSION, &driverVersion)) {
         ALOGE("could not get driver version for %s, %s\n", devicePath, strerror(errno));
         close(fd);
-        return -1;
+        return NULL;
     }
 
     // Get device identifier.
@@ -1151,7 +1190,7 @@ status_t EventHub::openDeviceLocked(const char *devicePath) {
     if(ioctl(fd, EVIOCGID, &inputId)) {
         ALOGE("could not get device input id for %s, %s\n", devicePath, strerror(errno));
         close(fd);
-        return -1;
+        return NULL;
     }
     identifier.bus = inputId.bustype;
     identifier.product = inputId.product;
@@ -1174,11 +1213,7 @@ status_t EventHub::openDeviceLocked(const char *devicePath) {
         identifier.uniqueId.setTo(buffer);
     }
 
-    // Fill in the descriptor.
-    assignDescriptorLocked(identifier);
-
     // Allocate device.  (The device object takes ownership of the fd at this point.)
-    int32_t deviceId = mNextDeviceId++;
     Device* device = new Device(fd, deviceId, String8(devicePath), identifier);
 
     ALOGV("add device %d: %s\n", deviceId, devicePath);
@@ -1190,7 +1225,6 @@ status_t EventHub::openDeviceLocked(const char *devicePath) {
     ALOGV("  name:       \"%s\"\n", identifier.name.string());
     ALOGV("  location:   \"%s\"\n", identifier.location.string());
     ALOGV("  unique id:  \"%s\"\n", identifier.uniqueId.string());
-    ALOGV("  descriptor: \"%s\"\n", identifier.descriptor.string());
     ALOGV("  driver:     v%d.%d.%d\n",
         driverVersion >> 16, (driverVersion >> 8) & 0xff, driverVersion & 0xff);
 
@@ -1301,22 +1335,13 @@ status_t EventHub::openDeviceLocked(const char *devicePath) {
 
     // Load the key map.
     // We need to do this for joysticks too because the key layout may specify axes.
-    status_t keyMapStatus = NAME_NOT_FOUND;
     if (device->classes & (INPUT_DEVICE_CLASS_KEYBOARD | INPUT_DEVICE_CLASS_JOYSTICK)) {
         // Load the keymap for the device.
-        keyMapStatus = loadKeyMapLocked(device);
+        loadKeyMapLocked(device);
     }
 
     // Configure the keyboard, gamepad or virtual keyboard.
     if (device->classes & INPUT_DEVICE_CLASS_KEYBOARD) {
-        // Register the keyboard as a built-in keyboard if it is eligible.
-        if (!keyMapStatus
-                && mBuiltInKeyboardId == NO_BUILT_IN_KEYBOARD
-                && isEligibleBuiltInKeyboard(device->identifier,
-                        device->configuration, &device->keyMap)) {
-            mBuiltInKeyboardId = device->id;
-        }
-
         // 'Q' key support = cheap test of whether this is an alpha-capable kbd
         if (hasKeycodeLocked(device, AKEYCODE_Q)) {
             device->classes |= INPUT_DEVICE_CLASS_ALPHAKEY;
@@ -1345,7 +1370,7 @@ status_t EventHub::openDeviceLocked(const char *devicePath) {
         ALOGV("Dropping device: id=%d, path='%s', name='%s'",
                 deviceId, devicePath, device->identifier.name.string());
         delete device;
-        return -1;
+        return NULL;
     }
 
     // Determine whether the device has a mic.
@@ -1357,6 +1382,32 @@ status_t EventHub::openDeviceLocked(const char *devicePath) {
     if (isExternalDeviceLocked(device)) {
         device->classes |= INPUT_DEVICE_CLASS_EXTERNAL;
     }
+    return device;
+}
+
+status_t EventHub::registerDeviceLocked(Device* device) {
+    // Check to see if the device is on our excluded list
+    for (size_t i = 0; i < mExcludedDevices.size(); i++) {
+        const String8& item = mExcludedDevices.itemAt(i);
+        if (device->identifier.name == item) {
+            ALOGI("ignoring event id %s driver %s\n", device->path.string(), item.string());
+            delete device;
+            return -1;
+        }
+    }
+
+    // Fill in the descriptor, now that it can be checked against the other devices.
+    assignDescriptorLocked(device->identifier);
+    ALOGV("  descriptor: \"%s\"\n", device->identifier.descriptor.string());
+
+    // Register the keyboard as a built-in keyboard if it is eligible.
+    if ((device->classes & INPUT_DEVICE_CLASS_KEYBOARD)
+            && device->keyMap.isComplete()
+            && mBuiltInKeyboardId == NO_BUILT_IN_KEYBOARD
+            && isEligibleBuiltInKeyboard(device->identifier,
+                    device->configuration, &device->keyMap)) {
+        mBuiltInKeyboardId = device->id;
+    }
 
     if (device->classes & (INPUT_DEVICE_CLASS_JOYSTICK | INPUT_DEVICE_CLASS_DPAD)
             && device->classes & INPUT_DEVICE_CLASS_GAMEPAD) {
@@ -1374,17 +1425,109 @@ status_t EventHub::openDeviceLocked(const char *devicePath) {
 
     ALOGI("New device: id=%d, fd=%d, path='%s', name='%s', classes=0x%x, "
             "configuration='%s', keyLayout='%s', keyCharacterMap='%s', builtinKeyboard=%s, ",
-         deviceId, fd, devicePath, device->identifier.name.string(),
+         device->id, device->fd, device->path.string(), device->identifier.name.string(),
          device->classes,
          device->configurationFile.string(),
          device->keyMap.keyLayoutFile.string(),
          device->keyMap.keyCharacterMapFile.string(),
-         toString(mBuiltInKeyboardId == deviceId));
+         toString(mBuiltInKeyboardId == device->id));
 
     addDeviceLocked(device);
     return OK;
 }
 
+void EventHub::queueDeviceLoadLocked(const char *devicePath) {
+    DeviceLoad load;
+    load.id = mNextDeviceId++;
+    load.path.setTo(devicePath);
+    mLoadingDevicePaths.add(load.path, load.id);
+
+    { // acquire loader lock
+        AutoMutex _l(mLoaderLock);
+        mDevicesToLoad.push(load);
+        mLoaderCondition.signal();
+    } // release loader lock
+
+    if (mDeviceLoader == NULL) {
+        mDeviceLoader = new DeviceLoaderThread(this);
+        mDeviceLoader->run("InputDeviceLoader");
+    }
+}
+
+bool EventHub::loadNextDevice() {
+    DeviceLoad load;
+    { // acquire loader lock
+        AutoMutex _l(mLoaderLock);
+        while (mDevicesToLoad.isEmpty() && !mLoaderExiting) {
+            mLoaderCondition.wait(mLoaderLock);
+        }
+        if (mLoaderExiting) {
+            return false;
+        }
+        load = mDevicesToLoad.itemAt(0);
+        mDevicesToLoad.removeAt(0);
+    } // release loader lock
+
+    load.device = loadDevice(load.id, load.path.string());
+
+    { // acquire loader lock
+        AutoMutex _l(mLoaderLock);
+        if (mLoaderExiting) {
+            delete load.device;
+            return false;
+        }
+        mLoadedDevices.push(load);
+    } // release loader lock
+
+    // Have the reader thread pick it up.
+    wake();
+    return true;
+}
+
+void EventHub::registerLoadedDevicesLocked() {
+    Vector<DeviceLoad> loadedDevices;
+    { // acquire loader lock
+        AutoMutex _l(mLoaderLock);
+        if (mLoadedDevices.isEmpty()) {
+            return;
+        }
+        loadedDevices = mLoadedDevices;
+        mLoadedDevices.clear();
+    } // release loader lock
+
+    for (size_t i = 0; i < loadedDevices.size(); i++) {
+        const DeviceLoad& load = loadedDevices.itemAt(i);
+        ssize_t index = mLoadingDevicePaths.indexOfKey(load.path);
+        if (index < 0 || mLoadingDevicePaths.valueAt(index) != load.id) {
+            ALOGI("Device %s was removed while it was being loaded.", load.path.string());
+            delete load.device;
+            continue;
+        }
+        mLoadingDevicePaths.removeItemsAt(index);
+        if (load.device) {
+            registerDeviceLocked(load.device);
+        }
+    }
+}
+
+void EventHub::stopDeviceLoader() {
+    if (mDeviceLoader == NULL) {
+        return;
+    }
+
+    { // acquire loader lock
+        AutoMutex _l(mLoaderLock);
+        mLoaderExiting = true;
+        mLoaderCondition.signal();
+    } // release loader lock
+    mDeviceLoader->requestExitAndWait();
+
+    for (size_t i = 0; i < mLoadedDevices.size(); i++) {
+        delete mLoadedDevices.itemAt(i).device;
+    }
+    mLoadedDevices.clear();
+}
+
 void EventHub::configureFd(Device* device) {
     // Set fd parameters with ioctl, such as key repeat, suspend block, and clock type
     if (device->classes & INPUT_DEVICE_CLASS_KEYBOARD) {
@@ -1600,6 +1743,13 @@ status_t EventHub::mapLed(Device* device, int32_t led, int32_t* outScanCode) con
 }
 
 status_t EventHub::closeDeviceByPathLocked(const char *devicePath) {
+    ssize_t loadingIndex = mLoadingDevicePaths.indexOfKey(String8(devicePath));
+    if (loadingIndex >= 0) {
+        // The loader is not done with it yet.  Forget it so it is dropped once it is.
+        mLoadingDevicePaths.removeItemsAt(loadingIndex);
+        return 0;
+    }
+
     Device* device = getDeviceByPathLocked(devicePath);
     if (device) {
         closeDeviceLocked(device);
@@ -1610,6 +1760,7 @@ status_t EventHub::closeDeviceByPathLocked(const char *devicePath) {
 }
 
 void EventHub::closeAllDevicesLocked() {
+    mLoadingDevicePaths.clear();
     while (mDevices.size() > 0) {
         closeDeviceLocked(mDevices.valueAt(mDevices.size() - 1));
     }
@@ -1692,7 +1843,7 @@ status_t EventHub::readNotifyLocked() {
         if(event->len) {
             strcpy(filename, event->name);
             if(event->mask & IN_CREATE) {
-                openDeviceLocked(devname);
+                queueDeviceLoadLocked(devname);
             } else {
                 ALOGI("Removing device '%s' due to inotify event\n", devname);
                 closeDeviceByPathLocked(devname);
@@ -1743,6 +1894,11 @@ void EventHub::dump(std::string& dump) {
         AutoMutex _l(mLock);
 
         dump += StringPrintf(INDENT "BuiltInKeyboardId: %d\n", mBuiltInKeyboardId);
+        dump += StringPrintf(INDENT "LoadingDevices: %zu\n", mLoadingDevicePaths.size());
+        dump += StringPrintf(INDENT "Wakeups: %u, full polls: %u, events read: %" PRIu64
+                ", events per wakeup: %0.1f average, %zu max\n",
+                mPollWakeups, mFullPolls, mEventsRead,
+                mPollWakeups ? double(mEventsRead) / mPollWakeups : 0.0, mMaxEventsPerWakeup);
 
         dump += INDENT "Devices:\n";
 
@@ -24,6 +24,7 @@
 #include <input/KeyLayoutMap.h>
 #include <input/KeyCharacterMap.h>
 #include <input/VirtualKeyMap.h>
+#include <utils/Condition.h>
 #include <utils/Mutex.h>
 #include <utils/Log.h>
 #include <utils/List.h>
@@ -32,6 +33,7 @@
 #include <utils/Vector.h>
 #include <utils/KeyedVector.h>
 #include <utils/BitSet.h>
+#include <utils/Thread.h>
 
 #include <linux/input.h>
 #include <sys/epoll.h>
@@ -345,7 +347,7 @@ private:
         int fd; // may be -1 if device is closed
         const int32_t id;
         const String8 path;
-        const InputDeviceIdentifier identifier;
+        InputDeviceIdentifier identifier; // descriptor assigned when the device is registered
 
         uint32_t classes;
 
@@ -393,6 +395,12 @@ private:
     };
 
     status_t openDeviceLocked(const char *devicePath);
+    Device* loadDevice(int32_t deviceId, const char *devicePath);
+    status_t registerDeviceLocked(Device* device);
+    void queueDeviceLoadLocked(const char *devicePath);
+    void registerLoadedDevicesLocked();
+    bool loadNextDevice();
+    void stopDeviceLoader();
     void createVirtualKeyboardLocked();
     void addDeviceLocked(Device* device);
     void assignDescriptorLocked(InputDeviceIdentifier& identifier);
@@ -417,6 +425,7 @@ private:
     Device* getDeviceLocked(int32_t deviceId) const;
     Device* getDeviceByPathLocked(const char* devicePath) const;
 
+    // These only look at the device itself, so the device loader calls them without mLock.
     bool hasKeycodeLocked(Device* device, int keycode) const;
 
     void loadConfigurationLocked(Device* device);
@@ -471,8 +480,9 @@ private:
     // Epoll FD list size hint.
     static const int EPOLL_SIZE_HINT = 8;
 
-    // Maximum number of signalled FDs to handle at a time.
-    static const int EPOLL_MAX_EVENTS = 16;
+    // Maximum number of signalled FDs to handle at a time.  Each poll asks for as many
+    // as there are open devices, plus inotify and the wake pipe, up to this limit.
+    static const int EPOLL_MAX_EVENTS = 64;
 
     // The array of pending epoll events and the index of the next event to be handled.
     struct epoll_event mPendingEventItems[EPOLL_MAX_EVENTS];
@@ -480,7 +490,36 @@ private:
     size_t mPendingEventIndex;
     bool mPendingINotify;
 
+    // Counters for dump() about the polls that returned something.
+    uint32_t mPollWakeups;
+    uint32_t mFullPolls; // polls that returned as many fds as were asked for
+    uint64_t mEventsRead;
+    size_t mEventsSinceWakeup;
+    size_t mMaxEventsPerWakeup;
+
     bool mUsingEpollWakeup;
+
+    // Hotplugged devices are opened and their configuration files parsed on a loader
+    // thread, so that the reader keeps delivering input from the other devices meanwhile.
+    // A device is only added to mDevices, and reported, once it is fully loaded.
+    class DeviceLoaderThread;
+    sp<DeviceLoaderThread> mDeviceLoader;
+
+    // The id reserved for each device path being loaded.  A path whose device is
+    // removed, or reopened, before it finishes loading no longer matches.
+    KeyedVector<String8, int32_t> mLoadingDevicePaths;
+
+    // Guards the loader's queues.  Never acquire mLock while holding it.
+    Mutex mLoaderLock;
+    Condition mLoaderCondition;
+    struct DeviceLoad {
+        int32_t id = 0;
+        String8 path;
+        Device* device = NULL; // NULL until loaded, or if the device is not usable
+    };
+    Vector<DeviceLoad> mDevicesToLoad;
+    Vector<DeviceLoad> mLoadedDevices;
+    bool mLoaderExiting;
 };
 
 }; // namespace android
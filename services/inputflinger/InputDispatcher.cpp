@@ -51,9 +51,11 @@
 #include <stddef.h>
 #include <time.h>
 #include <unistd.h>
+#include <vector>
 
 #include <android-base/chrono_utils.h>
 #include <android-base/stringprintf.h>
+#include <cutils/properties.h>
 #include <log/log.h>
 #include <utils/Trace.h>
 #include <powermanager/PowerManager.h>
@@ -96,6 +98,9 @@ constexpr std::chrono::milliseconds SLOW_INTERCEPTION_THRESHOLD = 50ms;
 // Number of recent events to keep for debugging purposes.
 constexpr size_t RECENT_QUEUE_MAX_SIZE = 10;
 
+// Maximum number of earlier samples a move waiting in the inbound queue may collect.
+constexpr size_t MAX_COALESCED_MOTION_SAMPLES = 16;
+
 
 static inline nsecs_t now() {
     return systemTime(SYSTEM_TIME_MONOTONIC);
@@ -215,6 +220,58 @@ static bool isMainDisplay(int32_t displayId) {
     return displayId == ADISPLAY_ID_DEFAULT || displayId == ADISPLAY_ID_NONE;
 }
 
+// Keeps freed entries of one size around for the next one, so that a stream of
+// events doesn't go through the allocator for every entry.
+class EntryPool {
+public:
+    explicit EntryPool(size_t size) : mSize(size) {
+        mFree.reserve(MAX_POOLED_ENTRIES);
+    }
+
+    void* allocate(size_t size) {
+        if (size == mSize) {
+            AutoMutex _l(mLock);
+            if (!mFree.empty()) {
+                void* ptr = mFree.back();
+                mFree.pop_back();
+                return ptr;
+            }
+        }
+        return ::operator new(size);
+    }
+
+    void deallocate(void* ptr, size_t size) {
+        if (size == mSize) {
+            AutoMutex _l(mLock);
+            if (mFree.size() < MAX_POOLED_ENTRIES) {
+                mFree.push_back(ptr);
+                return;
+            }
+        }
+        ::operator delete(ptr);
+    }
+
+private:
+    static const size_t MAX_POOLED_ENTRIES = 64;
+
+    const size_t mSize;
+    Mutex mLock;
+    std::vector<void*> mFree;
+};
+
+// Entries of the same size share a pool.  Never destroyed, since entries can
+// outlive static destructors.
+template <size_t Size>
+static EntryPool& entryPool() {
+    static EntryPool* sPool = new EntryPool(Size);
+    return *sPool;
+}
+
+// Whether events go to the windows through shared memory rings rather than the sockets.
+static bool isSharedMemoryTransportEnabled() {
+    return property_get_bool("ro.input.shared_memory_channels", false);
+}
+
 static void dumpRegion(std::string& dump, const Region& region) {
     if (region.isEmpty()) {
         dump += "<empty>";
@@ -244,7 +301,8 @@ InputDispatcher::InputDispatcher(const sp<InputDispatcherPolicyInterface>& polic
     mAppSwitchSawKeyDown(false), mAppSwitchDueTime(LONG_LONG_MAX),
     mNextUnblockedEvent(NULL),
     mDispatchEnabled(false), mDispatchFrozen(false), mInputFilterEnabled(false),
-    mInputTargetWaitCause(INPUT_TARGET_WAIT_CAUSE_NONE) {
+    mInputTargetWaitCause(INPUT_TARGET_WAIT_CAUSE_NONE),
+    mStagingMotion(false), mStagedWakePending(false), mInputFilterEnabledForStaging(false) {
     mLooper = new Looper(false);
 
     mKeyRepeatState.lastKeyEntry = NULL;
@@ -271,6 +329,7 @@ void InputDispatcher::dispatchOnce() {
     { // acquire lock
         AutoMutex _l(mLock);
         mDispatcherIsAliveCondition.broadcast();
+        drainStagedMotionsLocked();
 
         // Run a dispatch loop if there are no pending commands.
         // The dispatch loop might enqueue commands to run afterwards.
@@ -283,8 +342,21 @@ void InputDispatcher::dispatchOnce() {
         if (runCommandsLockedInterruptible()) {
             nextWakeupTime = LONG_LONG_MIN;
         }
+
+        preparePublishesLocked(now());
     } // release lock
 
+    // Write the events out to the connections without holding the lock.
+    if (!mPublishRequests.empty()) {
+        publishPendingEvents();
+
+        AutoMutex _l(mLock);
+        finishPublishesLocked(now());
+        if (haveCommandsLocked() || !mConnectionsToPublish.isEmpty()) {
+            nextWakeupTime = LONG_LONG_MIN;
+        }
+    }
+
     // Wait for callback or timeout or wake.  (make sure we round up, not down)
     nsecs_t currentTime = now();
     int timeoutMillis = toMillisecondTimeoutDelay(currentTime, nextWakeupTime);
@@ -445,6 +517,47 @@ void InputDispatcher::dispatchOnceInnerLocked(nsecs_t* nextWakeupTime) {
 }
 
 bool InputDispatcher::enqueueInboundEventLocked(EventEntry* entry) {
+    // Motions staged before this event have to be queued ahead of it.
+    bool needWake = drainStagedMotionsLocked();
+    return insertInboundEventLocked(entry) || needWake;
+}
+
+bool InputDispatcher::stageMotion(MotionEntry* entry) {
+    // Only one producer may push at a time; whoever loses takes the lock instead.
+    if (mStagingMotion.exchange(true, std::memory_order_acquire)) {
+        return false;
+    }
+    const bool staged = mStagedMotions.push(entry);
+    mStagingMotion.store(false, std::memory_order_release);
+
+    if (staged && !mStagedWakePending.exchange(true)) {
+        mLooper->wake();
+    }
+    return staged;
+}
+
+bool InputDispatcher::drainStagedMotionsLocked() {
+    // Cleared first: a motion staged after this will wake the looper again.
+    mStagedWakePending.store(false);
+
+    bool needWake = false;
+    while (MotionEntry* entry = mStagedMotions.pop()) {
+        if (mInputFilterEnabled && isMainDisplay(entry->displayId)) {
+            // Staged while the filter was being enabled, which drops everything queued.
+            releaseInboundEventLocked(entry);
+            continue;
+        }
+        needWake |= insertInboundEventLocked(entry);
+    }
+    return needWake;
+}
+
+bool InputDispatcher::insertInboundEventLocked(EventEntry* entry) {
+    if (entry->type == EventEntry::TYPE_MOTION
+            && coalesceMotionLocked(static_cast<MotionEntry*>(entry))) {
+        return false; // the queue already holds an event the dispatcher has yet to see
+    }
+
     bool needWake = mInboundQueue.isEmpty();
     mInboundQueue.enqueueAtTail(entry);
     traceInboundQueueLengthLocked();
@@ -504,6 +617,51 @@ bool InputDispatcher::enqueueInboundEventLocked(EventEntry* entry) {
     return needWake;
 }
 
+bool InputDispatcher::coalesceMotionLocked(MotionEntry* entry) {
+    // The tail is still waiting, so the dispatcher is behind.  Folding the new sample
+    // into it saves a whole dispatch cycle, and the consumer sees the same samples.
+    if (!mInboundQueue.tail || mInboundQueue.tail->type != EventEntry::TYPE_MOTION) {
+        return false;
+    }
+    MotionEntry* lastEntry = static_cast<MotionEntry*>(mInboundQueue.tail);
+    if (entry->action != AMOTION_EVENT_ACTION_MOVE
+            || lastEntry->action != AMOTION_EVENT_ACTION_MOVE
+            || entry->injectionState || lastEntry->injectionState
+            || lastEntry->historicalSamples.size() >= MAX_COALESCED_MOTION_SAMPLES
+            || entry->eventTime < lastEntry->eventTime
+            || entry->deviceId != lastEntry->deviceId
+            || entry->source != lastEntry->source
+            || entry->displayId != lastEntry->displayId
+            || entry->policyFlags != lastEntry->policyFlags
+            || entry->flags != lastEntry->flags
+            || entry->metaState != lastEntry->metaState
+            || entry->buttonState != lastEntry->buttonState
+            || entry->edgeFlags != lastEntry->edgeFlags
+            || entry->xPrecision != lastEntry->xPrecision
+            || entry->yPrecision != lastEntry->yPrecision
+            || entry->downTime != lastEntry->downTime
+            || entry->pointerCount != lastEntry->pointerCount) {
+        return false;
+    }
+    for (uint32_t i = 0; i < entry->pointerCount; i++) {
+        if (!(entry->pointerProperties[i] == lastEntry->pointerProperties[i])) {
+            return false;
+        }
+    }
+
+    lastEntry->historicalSamples.push();
+    MotionEntry::Sample& sample = lastEntry->historicalSamples.editTop();
+    sample.eventTime = lastEntry->eventTime;
+    for (uint32_t i = 0; i < lastEntry->pointerCount; i++) {
+        sample.pointerCoords[i].copyFrom(lastEntry->pointerCoords[i]);
+        lastEntry->pointerCoords[i].copyFrom(entry->pointerCoords[i]);
+    }
+    lastEntry->eventTime = entry->eventTime;
+    lastEntry->EventEntry::eventTime = entry->eventTime;
+    entry->release();
+    return true;
+}
+
 void InputDispatcher::addRecentEventLocked(EventEntry* entry) {
     entry->refCount += 1;
     mRecentQueue.enqueueAtTail(entry);
@@ -514,27 +672,7 @@ void InputDispatcher::addRecentEventLocked(EventEntry* entry) {
 
 sp<InputWindowHandle> InputDispatcher::findTouchedWindowAtLocked(int32_t displayId,
         int32_t x, int32_t y) {
-    // Traverse windows from front to back to find touched window.
-    size_t numWindows = mWindowHandles.size();
-    for (size_t i = 0; i < numWindows; i++) {
-        sp<InputWindowHandle> windowHandle = mWindowHandles.itemAt(i);
-        const InputWindowInfo* windowInfo = windowHandle->getInfo();
-        if (windowInfo->displayId == displayId) {
-            int32_t flags = windowInfo->layoutParamsFlags;
-
-            if (windowInfo->visible) {
-                if (!(flags & InputWindowInfo::FLAG_NOT_TOUCHABLE)) {
-                    bool isTouchModal = (flags & (InputWindowInfo::FLAG_NOT_FOCUSABLE
-                            | InputWindowInfo::FLAG_NOT_TOUCH_MODAL)) == 0;
-                    if (isTouchModal || windowInfo->touchableRegionContainsPoint(x, y)) {
-                        // Found window.
-                        return windowHandle;
-                    }
-                }
-            }
-        }
-    }
-    return NULL;
+    return mWindowIndex.findTouchedWindowAt(displayId, x, y);
 }
 
 void InputDispatcher::dropInboundEventLocked(EventEntry* entry, DropReason dropReason) {
@@ -652,6 +790,7 @@ InputDispatcher::CommandEntry* InputDispatcher::postCommandLocked(Command comman
 }
 
 void InputDispatcher::drainInboundQueueLocked() {
+    drainStagedMotionsLocked();
     while (! mInboundQueue.isEmpty()) {
         EventEntry* entry = mInboundQueue.dequeueAtHead();
         releaseInboundEventLocked(entry);
@@ -968,9 +1107,8 @@ void InputDispatcher::dispatchEventLocked(nsecs_t currentTime,
     for (size_t i = 0; i < inputTargets.size(); i++) {
         const InputTarget& inputTarget = inputTargets.itemAt(i);
 
-        ssize_t connectionIndex = getConnectionIndexLocked(inputTarget.inputChannel);
-        if (connectionIndex >= 0) {
-            sp<Connection> connection = mConnectionsByFd.valueAt(connectionIndex);
+        sp<Connection> connection = getConnectionLocked(inputTarget.inputChannel);
+        if (connection != NULL) {
             prepareDispatchCycleLocked(currentTime, connection, eventEntry, &inputTarget);
         } else {
 #if DEBUG_FOCUS
@@ -1062,9 +1200,8 @@ void InputDispatcher::resumeAfterTargetsNotReadyTimeoutLocked(nsecs_t newTimeout
 
         // Input state will not be realistic.  Mark it out of sync.
         if (inputChannel.get()) {
-            ssize_t connectionIndex = getConnectionIndexLocked(inputChannel);
-            if (connectionIndex >= 0) {
-                sp<Connection> connection = mConnectionsByFd.valueAt(connectionIndex);
+            sp<Connection> connection = getConnectionLocked(inputChannel);
+            if (connection != NULL) {
                 sp<InputWindowHandle> windowHandle = connection->inputWindowHandle;
 
                 if (windowHandle != NULL) {
@@ -1242,34 +1379,17 @@ int32_t InputDispatcher::findTouchedWindowTargetsLocked(nsecs_t currentTime,
                 getAxisValue(AMOTION_EVENT_AXIS_X));
         int32_t y = int32_t(entry->pointerCoords[pointerIndex].
                 getAxisValue(AMOTION_EVENT_AXIS_Y));
-        sp<InputWindowHandle> newTouchedWindowHandle;
-        bool isTouchModal = false;
-
-        // Traverse windows from front to back to find touched window and outside targets.
-        size_t numWindows = mWindowHandles.size();
-        for (size_t i = 0; i < numWindows; i++) {
-            sp<InputWindowHandle> windowHandle = mWindowHandles.itemAt(i);
-            const InputWindowInfo* windowInfo = windowHandle->getInfo();
-            if (windowInfo->displayId != displayId) {
-                continue; // wrong display
-            }
-
-            int32_t flags = windowInfo->layoutParamsFlags;
-            if (windowInfo->visible) {
-                if (! (flags & InputWindowInfo::FLAG_NOT_TOUCHABLE)) {
-                    isTouchModal = (flags & (InputWindowInfo::FLAG_NOT_FOCUSABLE
-                            | InputWindowInfo::FLAG_NOT_TOUCH_MODAL)) == 0;
-                    if (isTouchModal || windowInfo->touchableRegionContainsPoint(x, y)) {
-                        newTouchedWindowHandle = windowHandle;
-                        break; // found touched window, exit window loop
-                    }
-                }
-
-                if (maskedAction == AMOTION_EVENT_ACTION_DOWN
-                        && (flags & InputWindowInfo::FLAG_WATCH_OUTSIDE_TOUCH)) {
-                    mTempTouchState.addOrUpdateWindow(
-                            windowHandle, InputTarget::FLAG_DISPATCH_AS_OUTSIDE, BitSet32(0));
-                }
+        // Find the front-most window taking the touch, and the windows in front of it
+        // that want to know about touches outside of them.
+        sp<InputWindowHandle> newTouchedWindowHandle =
+                findTouchedWindowAtLocked(displayId, x, y);
+        if (maskedAction == AMOTION_EVENT_ACTION_DOWN) {
+            Vector<sp<InputWindowHandle> > outsideTargets;
+            mWindowIndex.getOutsideTouchWatchers(displayId, newTouchedWindowHandle,
+                    &outsideTargets);
+            for (size_t i = 0; i < outsideTargets.size(); i++) {
+                mTempTouchState.addOrUpdateWindow(outsideTargets.itemAt(i),
+                        InputTarget::FLAG_DISPATCH_AS_OUTSIDE, BitSet32(0));
             }
         }
 
@@ -1656,43 +1776,11 @@ bool InputDispatcher::checkInjectionPermission(const sp<InputWindowHandle>& wind
 
 bool InputDispatcher::isWindowObscuredAtPointLocked(
         const sp<InputWindowHandle>& windowHandle, int32_t x, int32_t y) const {
-    int32_t displayId = windowHandle->getInfo()->displayId;
-    size_t numWindows = mWindowHandles.size();
-    for (size_t i = 0; i < numWindows; i++) {
-        sp<InputWindowHandle> otherHandle = mWindowHandles.itemAt(i);
-        if (otherHandle == windowHandle) {
-            break;
-        }
-
-        const InputWindowInfo* otherInfo = otherHandle->getInfo();
-        if (otherInfo->displayId == displayId
-                && otherInfo->visible && !otherInfo->isTrustedOverlay()
-                && otherInfo->frameContainsPoint(x, y)) {
-            return true;
-        }
-    }
-    return false;
+    return mWindowIndex.isWindowObscuredAtPoint(windowHandle, x, y);
 }
 
-
 bool InputDispatcher::isWindowObscuredLocked(const sp<InputWindowHandle>& windowHandle) const {
-    int32_t displayId = windowHandle->getInfo()->displayId;
-    const InputWindowInfo* windowInfo = windowHandle->getInfo();
-    size_t numWindows = mWindowHandles.size();
-    for (size_t i = 0; i < numWindows; i++) {
-        sp<InputWindowHandle> otherHandle = mWindowHandles.itemAt(i);
-        if (otherHandle == windowHandle) {
-            break;
-        }
-
-        const InputWindowInfo* otherInfo = otherHandle->getInfo();
-        if (otherInfo->displayId == displayId
-                && otherInfo->visible && !otherInfo->isTrustedOverlay()
-                && otherInfo->overlaps(windowInfo)) {
-            return true;
-        }
-    }
-    return false;
+    return mWindowIndex.isWindowObscured(windowHandle);
 }
 
 std::string InputDispatcher::checkWindowReadyForMoreInputLocked(nsecs_t currentTime,
@@ -1704,15 +1792,14 @@ std::string InputDispatcher::checkWindowReadyForMoreInputLocked(nsecs_t currentT
     }
 
     // If the window's connection is not registered then keep waiting.
-    ssize_t connectionIndex = getConnectionIndexLocked(windowHandle->getInputChannel());
-    if (connectionIndex < 0) {
+    sp<Connection> connection = getConnectionLocked(windowHandle->getInputChannel());
+    if (connection == NULL) {
         return StringPrintf("Waiting because the %s window's input channel is not "
                 "registered with the input dispatcher.  The window may be in the process "
                 "of being removed.", targetType);
     }
 
     // If the connection is dead then keep waiting.
-    sp<Connection> connection = mConnectionsByFd.valueAt(connectionIndex);
     if (connection->status != Connection::STATUS_NORMAL) {
         return StringPrintf("Waiting because the %s window's input connection is %s."
                 "The window may be in the process of being removed.", targetType,
@@ -2003,112 +2090,225 @@ void InputDispatcher::startDispatchCycleLocked(nsecs_t currentTime,
             connection->getInputChannelName().c_str());
 #endif
 
-    while (connection->status == Connection::STATUS_NORMAL
-            && !connection->outboundQueue.isEmpty()) {
-        DispatchEntry* dispatchEntry = connection->outboundQueue.head;
-        dispatchEntry->deliveryTime = currentTime;
-
-        // Publish the event.
-        status_t status;
-        EventEntry* eventEntry = dispatchEntry->eventEntry;
-        switch (eventEntry->type) {
-        case EventEntry::TYPE_KEY: {
-            KeyEntry* keyEntry = static_cast<KeyEntry*>(eventEntry);
-
-            // Publish the key event.
-            status = connection->inputPublisher.publishKeyEvent(dispatchEntry->seq,
-                    keyEntry->deviceId, keyEntry->source,
-                    dispatchEntry->resolvedAction, dispatchEntry->resolvedFlags,
-                    keyEntry->keyCode, keyEntry->scanCode,
-                    keyEntry->metaState, keyEntry->repeatCount, keyEntry->downTime,
-                    keyEntry->eventTime);
-            break;
+    // The dispatcher thread publishes the outbound queue once it has released the lock.
+    if (!connection->publishPending) {
+        connection->publishPending = true;
+        if (mConnectionsToPublish.isEmpty()) {
+            mLooper->wake();
+        }
+        mConnectionsToPublish.push(connection);
+    }
+}
+
+void InputDispatcher::preparePublishesLocked(nsecs_t currentTime) {
+    for (size_t i = 0; i < mConnectionsToPublish.size(); i++) {
+        const sp<Connection>& connection = mConnectionsToPublish.itemAt(i);
+        connection->publishPending = false;
+        if (connection->status != Connection::STATUS_NORMAL
+                || connection->inputPublisherBlocked) {
+            continue;
+        }
+
+        // Entries go on the wait queue now and come back if they can't be published.
+        while (!connection->outboundQueue.isEmpty()) {
+            DispatchEntry* dispatchEntry = connection->outboundQueue.dequeueAtHead();
+            dispatchEntry->deliveryTime = currentTime;
+            connection->waitQueue.enqueueAtTail(dispatchEntry);
+
+            PublishRequest request;
+            request.connection = connection;
+            request.eventEntry = dispatchEntry->eventEntry;
+            request.eventEntry->refCount += 1;
+            request.seq = dispatchEntry->seq;
+            request.targetFlags = dispatchEntry->targetFlags;
+            request.xOffset = dispatchEntry->xOffset;
+            request.yOffset = dispatchEntry->yOffset;
+            request.scaleFactor = dispatchEntry->scaleFactor;
+            request.resolvedAction = dispatchEntry->resolvedAction;
+            request.resolvedFlags = dispatchEntry->resolvedFlags;
+            request.publishedSamples = dispatchEntry->publishedSamples;
+            request.status = OK;
+            mPublishRequests.push_back(request);
         }
+        traceOutboundQueueLengthLocked(connection);
+        traceWaitQueueLengthLocked(connection);
+    }
+    mConnectionsToPublish.clear();
+}
 
-        case EventEntry::TYPE_MOTION: {
-            MotionEntry* motionEntry = static_cast<MotionEntry*>(eventEntry);
+void InputDispatcher::publishPendingEvents() {
+    // Requests for a connection are contiguous.  Publishing never blocks, so a
+    // connection with a full socket doesn't hold up the others.
+    const Connection* failedConnection = NULL;
+    status_t failedStatus = OK;
+    for (PublishRequest& request : mPublishRequests) {
+        if (request.connection.get() == failedConnection) {
+            request.status = failedStatus;
+            continue;
+        }
+        request.status = publishEvent(request);
+        if (request.status) {
+            failedConnection = request.connection.get();
+            failedStatus = request.status;
+        }
+    }
+}
 
-            PointerCoords scaledCoords[MAX_POINTERS];
-            const PointerCoords* usingCoords = motionEntry->pointerCoords;
+status_t InputDispatcher::publishEvent(PublishRequest& request) {
+    InputPublisher& inputPublisher = request.connection->inputPublisher;
+    EventEntry* eventEntry = request.eventEntry;
+    switch (eventEntry->type) {
+    case EventEntry::TYPE_KEY: {
+        KeyEntry* keyEntry = static_cast<KeyEntry*>(eventEntry);
 
-            // Set the X and Y offset depending on the input source.
-            float xOffset, yOffset;
-            if ((motionEntry->source & AINPUT_SOURCE_CLASS_POINTER)
-                    && !(dispatchEntry->targetFlags & InputTarget::FLAG_ZERO_COORDS)) {
-                float scaleFactor = dispatchEntry->scaleFactor;
-                xOffset = dispatchEntry->xOffset * scaleFactor;
-                yOffset = dispatchEntry->yOffset * scaleFactor;
-                if (scaleFactor != 1.0f) {
-                    for (uint32_t i = 0; i < motionEntry->pointerCount; i++) {
-                        scaledCoords[i] = motionEntry->pointerCoords[i];
-                        scaledCoords[i].scale(scaleFactor);
-                    }
-                    usingCoords = scaledCoords;
-                }
-            } else {
-                xOffset = 0.0f;
-                yOffset = 0.0f;
+        // Publish the key event.
+        return inputPublisher.publishKeyEvent(request.seq,
+                keyEntry->deviceId, keyEntry->source,
+                request.resolvedAction, request.resolvedFlags,
+                keyEntry->keyCode, keyEntry->scanCode,
+                keyEntry->metaState, keyEntry->repeatCount, keyEntry->downTime,
+                keyEntry->eventTime);
+    }
 
-                // We don't want the dispatch target to know.
-                if (dispatchEntry->targetFlags & InputTarget::FLAG_ZERO_COORDS) {
-                    for (uint32_t i = 0; i < motionEntry->pointerCount; i++) {
-                        scaledCoords[i].clear();
-                    }
-                    usingCoords = scaledCoords;
-                }
+    case EventEntry::TYPE_MOTION: {
+        MotionEntry* motionEntry = static_cast<MotionEntry*>(eventEntry);
+
+        // Coalesced samples go out oldest first as separate messages with the same
+        // sequence number, for the consumer to batch again.  A retry after the socket
+        // filled up carries on from the first sample that was not written.  Actions
+        // synthesized for this target, like ACTION_OUTSIDE, only take the latest sample.
+        const size_t historySize = motionEntry->historicalSamples.size();
+        if (request.resolvedAction != AMOTION_EVENT_ACTION_MOVE) {
+            return publishMotionSample(request, motionEntry, historySize);
+        }
+        const size_t sampleCount = historySize + 1;
+        while (request.publishedSamples < sampleCount) {
+            status_t status = publishMotionSample(request, motionEntry,
+                    request.publishedSamples);
+            if (status) {
+                return status;
             }
+            request.publishedSamples += 1;
+        }
+        return OK;
+    }
 
-            // Publish the motion event.
-            status = connection->inputPublisher.publishMotionEvent(dispatchEntry->seq,
-                    motionEntry->deviceId, motionEntry->source, motionEntry->displayId,
-                    dispatchEntry->resolvedAction, motionEntry->actionButton,
-                    dispatchEntry->resolvedFlags, motionEntry->edgeFlags,
-                    motionEntry->metaState, motionEntry->buttonState,
-                    xOffset, yOffset, motionEntry->xPrecision, motionEntry->yPrecision,
-                    motionEntry->downTime, motionEntry->eventTime,
-                    motionEntry->pointerCount, motionEntry->pointerProperties,
-                    usingCoords);
-            break;
+    default:
+        ALOG_ASSERT(false);
+        return BAD_VALUE;
+    }
+}
+
+status_t InputDispatcher::publishMotionSample(const PublishRequest& request,
+        const MotionEntry* motionEntry, size_t sampleIndex) {
+    InputPublisher& inputPublisher = request.connection->inputPublisher;
+
+    PointerCoords scaledCoords[MAX_POINTERS];
+    const bool isHistorical = sampleIndex < motionEntry->historicalSamples.size();
+    const PointerCoords* coords = isHistorical
+            ? motionEntry->historicalSamples[sampleIndex].pointerCoords
+            : motionEntry->pointerCoords;
+    const nsecs_t eventTime = isHistorical
+            ? motionEntry->historicalSamples[sampleIndex].eventTime : motionEntry->eventTime;
+    const PointerCoords* usingCoords = coords;
+
+    // Set the X and Y offset depending on the input source.
+    float xOffset, yOffset;
+    if ((motionEntry->source & AINPUT_SOURCE_CLASS_POINTER)
+            && !(request.targetFlags & InputTarget::FLAG_ZERO_COORDS)) {
+        float scaleFactor = request.scaleFactor;
+        xOffset = request.xOffset * scaleFactor;
+        yOffset = request.yOffset * scaleFactor;
+        if (scaleFactor != 1.0f) {
+            for (uint32_t i = 0; i < motionEntry->pointerCount; i++) {
+                scaledCoords[i] = coords[i];
+                scaledCoords[i].scale(scaleFactor);
+            }
+            usingCoords = scaledCoords;
         }
+    } else {
+        xOffset = 0.0f;
+        yOffset = 0.0f;
 
-        default:
-            ALOG_ASSERT(false);
-            return;
+        // We don't want the dispatch target to know.
+        if (request.targetFlags & InputTarget::FLAG_ZERO_COORDS) {
+            for (uint32_t i = 0; i < motionEntry->pointerCount; i++) {
+                scaledCoords[i].clear();
+            }
+            usingCoords = scaledCoords;
+        }
+    }
+
+    // Publish the motion event.
+    return inputPublisher.publishMotionEvent(request.seq,
+            motionEntry->deviceId, motionEntry->source, motionEntry->displayId,
+            request.resolvedAction, motionEntry->actionButton,
+            request.resolvedFlags, motionEntry->edgeFlags,
+            motionEntry->metaState, motionEntry->buttonState,
+            xOffset, yOffset, motionEntry->xPrecision, motionEntry->yPrecision,
+            motionEntry->downTime, eventTime,
+            motionEntry->pointerCount, motionEntry->pointerProperties,
+            usingCoords);
+}
+
+void InputDispatcher::finishPublishesLocked(nsecs_t currentTime) {
+    for (size_t i = 0; i < mPublishRequests.size(); i++) {
+        PublishRequest& request = mPublishRequests[i];
+        const sp<Connection>& connection = request.connection;
+        const bool firstFailure = request.status
+                && (i == 0 || mPublishRequests[i - 1].connection != connection
+                        || !mPublishRequests[i - 1].status);
+        // The connection may have been broken or reset while the lock was released,
+        // in which case its entries are gone already.
+        if (firstFailure && connection->status == Connection::STATUS_NORMAL) {
+            DispatchEntry* dispatchEntry = connection->findWaitQueueEntry(request.seq);
+            if (dispatchEntry) {
+                dispatchEntry->publishedSamples = request.publishedSamples;
+                handlePublishFailureLocked(currentTime, connection, dispatchEntry,
+                        request.status);
+            }
         }
+        request.eventEntry->release();
+    }
+    mPublishRequests.clear();
+}
 
-        // Check the result.
-        if (status) {
-            if (status == WOULD_BLOCK) {
-                if (connection->waitQueue.isEmpty()) {
-                    ALOGE("channel '%s' ~ Could not publish event because the pipe is full. "
-                            "This is unexpected because the wait queue is empty, so the pipe "
-                            "should be empty and we shouldn't have any problems writing an "
-                            "event to it, status=%d", connection->getInputChannelName().c_str(),
-                            status);
-                    abortBrokenDispatchCycleLocked(currentTime, connection, true /*notify*/);
-                } else {
-                    // Pipe is full and we are waiting for the app to finish process some events
-                    // before sending more events to it.
+void InputDispatcher::handlePublishFailureLocked(nsecs_t currentTime,
+        const sp<Connection>& connection, DispatchEntry* dispatchEntry, status_t status) {
+    // Put the entry and everything published after it back on the outbound queue.
+    for (;;) {
+        DispatchEntry* entry = connection->waitQueue.tail;
+        connection->waitQueue.dequeue(entry);
+        connection->outboundQueue.enqueueAtHead(entry);
+        if (entry == dispatchEntry) {
+            break;
+        }
+    }
+    traceOutboundQueueLengthLocked(connection);
+    traceWaitQueueLengthLocked(connection);
+
+    if (status == WOULD_BLOCK) {
+        if (connection->waitQueue.isEmpty()) {
+            ALOGE("channel '%s' ~ Could not publish event because the pipe is full. "
+                    "This is unexpected because the wait queue is empty, so the pipe "
+                    "should be empty and we shouldn't have any problems writing an "
+                    "event to it, status=%d", connection->getInputChannelName().c_str(),
+                    status);
+            abortBrokenDispatchCycleLocked(currentTime, connection, true /*notify*/);
+        } else {
+            // Pipe is full and we are waiting for the app to finish process some events
+            // before sending more events to it.
 #if DEBUG_DISPATCH_CYCLE
-                    ALOGD("channel '%s' ~ Could not publish event because the pipe is full, "
-                            "waiting for the application to catch up",
-                            connection->getInputChannelName().c_str());
+            ALOGD("channel '%s' ~ Could not publish event because the pipe is full, "
+                    "waiting for the application to catch up",
+                    connection->getInputChannelName().c_str());
 #endif
-                    connection->inputPublisherBlocked = true;
-                }
-            } else {
-                ALOGE("channel '%s' ~ Could not publish event due to an unexpected error, "
-                        "status=%d", connection->getInputChannelName().c_str(), status);
-                abortBrokenDispatchCycleLocked(currentTime, connection, true /*notify*/);
-            }
-            return;
+            connection->inputPublisherBlocked = true;
         }
-
-        // Re-enqueue the event on the wait queue.
-        connection->outboundQueue.dequeue(dispatchEntry);
-        traceOutboundQueueLengthLocked(connection);
-        connection->waitQueue.enqueueAtTail(dispatchEntry);
-        traceWaitQueueLengthLocked(connection);
+    } else {
+        ALOGE("channel '%s' ~ Could not publish event due to an unexpected error, "
+                "status=%d", connection->getInputChannelName().c_str(), status);
+        abortBrokenDispatchCycleLocked(currentTime, connection, true /*notify*/);
     }
 }
 
@@ -2250,10 +2450,9 @@ void InputDispatcher::synthesizeCancelationEventsForMonitorsLocked(
 
 void InputDispatcher::synthesizeCancelationEventsForInputChannelLocked(
         const sp<InputChannel>& channel, const CancelationOptions& options) {
-    ssize_t index = getConnectionIndexLocked(channel);
-    if (index >= 0) {
-        synthesizeCancelationEventsForConnectionLocked(
-                mConnectionsByFd.valueAt(index), options);
+    sp<Connection> connection = getConnectionLocked(channel);
+    if (connection != NULL) {
+        synthesizeCancelationEventsForConnectionLocked(connection, options);
     }
 }
 
@@ -2397,6 +2596,18 @@ InputDispatcher::splitMotionEvent(const MotionEntry* originalMotionEntry, BitSet
             originalMotionEntry->displayId,
             splitPointerCount, splitPointerProperties, splitPointerCoords, 0, 0);
 
+    const Vector<MotionEntry::Sample>& samples = originalMotionEntry->historicalSamples;
+    splitMotionEntry->historicalSamples.setCapacity(samples.size());
+    for (size_t i = 0; i < samples.size(); i++) {
+        splitMotionEntry->historicalSamples.push();
+        MotionEntry::Sample& sample = splitMotionEntry->historicalSamples.editTop();
+        sample.eventTime = samples[i].eventTime;
+        for (uint32_t j = 0; j < splitPointerCount; j++) {
+            sample.pointerCoords[j].copyFrom(samples[i].pointerCoords[splitPointerIndexMap[j]]);
+        }
+    }
+
+    splitMotionEntry->receiveTime = originalMotionEntry->receiveTime;
     if (originalMotionEntry->injectionState) {
         splitMotionEntry->injectionState = originalMotionEntry->injectionState;
         splitMotionEntry->injectionState->refCount += 1;
@@ -2565,6 +2776,33 @@ void InputDispatcher::notifyMotion(const NotifyMotionArgs* args) {
                 std::to_string(t.duration().count()).c_str());
     }
 
+    if (!(mInputFilterEnabledForStaging.load(std::memory_order_acquire)
+            && isMainDisplay(args->displayId))) {
+        // Nothing to filter, so hand the entry over without taking the lock.
+        MotionEntry* newEntry = new MotionEntry(args->eventTime,
+                args->deviceId, args->source, policyFlags,
+                args->action, args->actionButton, args->flags,
+                args->metaState, args->buttonState,
+                args->edgeFlags, args->xPrecision, args->yPrecision, args->downTime,
+                args->displayId,
+                args->pointerCount, args->pointerProperties, args->pointerCoords, 0, 0);
+        if (stageMotion(newEntry)) {
+            return;
+        }
+
+        // The staging queue is full or busy.
+        bool needWake;
+        { // acquire lock
+            AutoMutex _l(mLock);
+            needWake = enqueueInboundEventLocked(newEntry);
+        } // release lock
+
+        if (needWake) {
+            mLooper->wake();
+        }
+        return;
+    }
+
     bool needWake;
     { // acquire lock
         mLock.lock();
@@ -2888,25 +3126,13 @@ void InputDispatcher::decrementPendingForegroundDispatchesLocked(EventEntry* ent
 
 sp<InputWindowHandle> InputDispatcher::getWindowHandleLocked(
         const sp<InputChannel>& inputChannel) const {
-    size_t numWindows = mWindowHandles.size();
-    for (size_t i = 0; i < numWindows; i++) {
-        const sp<InputWindowHandle>& windowHandle = mWindowHandles.itemAt(i);
-        if (windowHandle->getInputChannel() == inputChannel) {
-            return windowHandle;
-        }
-    }
-    return NULL;
+    auto it = mWindowHandlesByChannel.find(inputChannel.get());
+    return it != mWindowHandlesByChannel.end() ? it->second : NULL;
 }
 
 bool InputDispatcher::hasWindowHandleLocked(
         const sp<InputWindowHandle>& windowHandle) const {
-    size_t numWindows = mWindowHandles.size();
-    for (size_t i = 0; i < numWindows; i++) {
-        if (mWindowHandles.itemAt(i) == windowHandle) {
-            return true;
-        }
-    }
-    return false;
+    return mWindowHandleSet.count(windowHandle.get()) != 0;
 }
 
 void InputDispatcher::setInputWindows(const Vector<sp<InputWindowHandle> >& inputWindowHandles) {
@@ -2935,6 +3161,16 @@ void InputDispatcher::setInputWindows(const Vector<sp<InputWindowHandle> >& inpu
             }
         }
 
+        mWindowIndex.setWindows(mWindowHandles);
+        mWindowHandlesByChannel.clear();
+        mWindowHandleSet.clear();
+        for (size_t i = 0; i < mWindowHandles.size(); i++) {
+            const sp<InputWindowHandle>& windowHandle = mWindowHandles.itemAt(i);
+            // the front-most window wins, as a walk of the list would find it
+            mWindowHandlesByChannel.emplace(windowHandle->getInputChannel().get(), windowHandle);
+            mWindowHandleSet.insert(windowHandle.get());
+        }
+
         if (!foundHoveredWindow) {
             mLastHoverWindowHandle = NULL;
         }
@@ -3085,6 +3321,7 @@ void InputDispatcher::setInputFilterEnabled(bool enabled) {
         }
 
         mInputFilterEnabled = enabled;
+        mInputFilterEnabledForStaging.store(enabled, std::memory_order_release);
         resetAndDropEverythingLocked("input filter is being enabled or disabled");
     } // release lock
 
@@ -3152,11 +3389,9 @@ Found:
             return false;
         }
 
-        ssize_t fromConnectionIndex = getConnectionIndexLocked(fromChannel);
-        ssize_t toConnectionIndex = getConnectionIndexLocked(toChannel);
-        if (fromConnectionIndex >= 0 && toConnectionIndex >= 0) {
-            sp<Connection> fromConnection = mConnectionsByFd.valueAt(fromConnectionIndex);
-            sp<Connection> toConnection = mConnectionsByFd.valueAt(toConnectionIndex);
+        sp<Connection> fromConnection = getConnectionLocked(fromChannel);
+        sp<Connection> toConnection = getConnectionLocked(toChannel);
+        if (fromConnection != NULL && toConnection != NULL) {
 
             fromConnection->inputState.copyPointerStateTo(toConnection->inputState);
             CancelationOptions options(CancelationOptions::CANCEL_POINTER_EVENTS,
@@ -3341,11 +3576,12 @@ void InputDispatcher::dumpDispatchStateLocked(std::string& dump) {
         for (size_t i = 0; i < mConnectionsByFd.size(); i++) {
             const sp<Connection>& connection = mConnectionsByFd.valueAt(i);
             dump += StringPrintf(INDENT2 "%zu: channelName='%s', windowName='%s', "
-                    "status=%s, monitor=%s, inputPublisherBlocked=%s\n",
+                    "status=%s, monitor=%s, inputPublisherBlocked=%s, sharedMemory=%s\n",
                     i, connection->getInputChannelName().c_str(),
                     connection->getWindowName().c_str(),
                     connection->getStatusLabel(), toString(connection->monitor),
-                    toString(connection->inputPublisherBlocked));
+                    toString(connection->inputPublisherBlocked),
+                    toString(connection->inputChannel->isUsingSharedMemoryTransport()));
 
             if (!connection->outboundQueue.isEmpty()) {
                 dump += StringPrintf(INDENT3 "OutboundQueue: length=%u\n",
@@ -3390,6 +3626,8 @@ void InputDispatcher::dumpDispatchStateLocked(std::string& dump) {
         dump += INDENT "AppSwitch: not pending\n";
     }
 
+    mLatencyTracker.dump(dump, INDENT);
+
     dump += INDENT "Configuration:\n";
     dump += StringPrintf(INDENT2 "KeyRepeatDelay: %0.1fms\n",
             mConfig.keyRepeatDelay * 0.000001f);
@@ -3407,16 +3645,22 @@ status_t InputDispatcher::registerInputChannel(const sp<InputChannel>& inputChan
     { // acquire lock
         AutoMutex _l(mLock);
 
-        if (getConnectionIndexLocked(inputChannel) >= 0) {
+        if (getConnectionLocked(inputChannel) != NULL) {
             ALOGW("Attempted to register already registered input channel '%s'",
                     inputChannel->getName().c_str());
             return BAD_VALUE;
         }
 
+        if (isSharedMemoryTransportEnabled()
+                && inputChannel->enableSharedMemoryTransport() != OK) {
+            ALOGW("channel '%s' ~ Falling back to the socket", inputChannel->getName().c_str());
+        }
+
         sp<Connection> connection = new Connection(inputChannel, inputWindowHandle, monitor);
 
         int fd = inputChannel->getFd();
         mConnectionsByFd.add(fd, connection);
+        mConnectionsByChannel[inputChannel.get()] = connection;
 
         if (monitor) {
             mMonitoringChannels.push(inputChannel);
@@ -3452,15 +3696,15 @@ status_t InputDispatcher::unregisterInputChannel(const sp<InputChannel>& inputCh
 
 status_t InputDispatcher::unregisterInputChannelLocked(const sp<InputChannel>& inputChannel,
         bool notify) {
-    ssize_t connectionIndex = getConnectionIndexLocked(inputChannel);
-    if (connectionIndex < 0) {
+    sp<Connection> connection = getConnectionLocked(inputChannel);
+    if (connection == NULL) {
         ALOGW("Attempted to unregister already unregistered input channel '%s'",
                 inputChannel->getName().c_str());
         return BAD_VALUE;
     }
 
-    sp<Connection> connection = mConnectionsByFd.valueAt(connectionIndex);
-    mConnectionsByFd.removeItemsAt(connectionIndex);
+    mConnectionsByFd.removeItem(inputChannel->getFd());
+    mConnectionsByChannel.erase(inputChannel.get());
 
     if (connection->monitor) {
         removeMonitorChannelLocked(inputChannel);
@@ -3484,16 +3728,10 @@ void InputDispatcher::removeMonitorChannelLocked(const sp<InputChannel>& inputCh
     }
 }
 
-ssize_t InputDispatcher::getConnectionIndexLocked(const sp<InputChannel>& inputChannel) {
-    ssize_t connectionIndex = mConnectionsByFd.indexOfKey(inputChannel->getFd());
-    if (connectionIndex >= 0) {
-        sp<Connection> connection = mConnectionsByFd.valueAt(connectionIndex);
-        if (connection->inputChannel.get() == inputChannel.get()) {
-            return connectionIndex;
-        }
-    }
-
-    return -1;
+sp<InputDispatcher::Connection> InputDispatcher::getConnectionLocked(
+        const sp<InputChannel>& inputChannel) const {
+    auto it = mConnectionsByChannel.find(inputChannel.get());
+    return it != mConnectionsByChannel.end() ? it->second : NULL;
 }
 
 void InputDispatcher::onDispatchCycleFinishedLocked(
@@ -3635,6 +3873,7 @@ void InputDispatcher::doDispatchCycleFinishedLockedInterruptible(
             dispatchEntry->eventEntry->appendDescription(msg);
             ALOGI("%s", msg.c_str());
         }
+        recordLatencyLocked(connection, dispatchEntry, finishTime);
 
         bool restartEvent;
         if (dispatchEntry->eventEntry->type == EventEntry::TYPE_KEY) {
@@ -3860,6 +4099,24 @@ void InputDispatcher::initializeKeyEvent(KeyEvent* event, const KeyEntry* entry)
             entry->downTime, entry->eventTime);
 }
 
+void InputDispatcher::recordLatencyLocked(const sp<Connection>& connection,
+        const DispatchEntry* dispatchEntry, nsecs_t finishTime) {
+    // Injected events don't come with a kernel timestamp.
+    const EventEntry* eventEntry = dispatchEntry->eventEntry;
+    if (eventEntry->isInjected()) {
+        return;
+    }
+
+    const std::string windowName = connection->getWindowName();
+    mLatencyTracker.addSample(windowName, eventEntry->eventTime, eventEntry->receiveTime,
+            dispatchEntry->deliveryTime, finishTime);
+    if (ATRACE_ENABLED()) {
+        char counterName[40];
+        snprintf(counterName, sizeof(counterName), "lat:%s", windowName.c_str());
+        ATRACE_INT(counterName, int32_t((finishTime - eventEntry->eventTime) / 1000));
+    }
+}
+
 void InputDispatcher::updateDispatchStatisticsLocked(nsecs_t currentTime, const EventEntry* entry,
         int32_t injectionResult, nsecs_t timeSpentWaitingForApplication) {
     // TODO Write some statistics about how long we spend waiting.
@@ -3933,8 +4190,8 @@ void InputDispatcher::InjectionState::release() {
 // --- InputDispatcher::EventEntry ---
 
 InputDispatcher::EventEntry::EventEntry(int32_t type, nsecs_t eventTime, uint32_t policyFlags) :
-        refCount(1), type(type), eventTime(eventTime), policyFlags(policyFlags),
-        injectionState(NULL), dispatchInProgress(false) {
+        refCount(1), type(type), eventTime(eventTime), receiveTime(now()),
+        policyFlags(policyFlags), injectionState(NULL), dispatchInProgress(false) {
 }
 
 InputDispatcher::EventEntry::~EventEntry() {
@@ -4005,6 +4262,14 @@ InputDispatcher::KeyEntry::KeyEntry(nsecs_t eventTime,
 InputDispatcher::KeyEntry::~KeyEntry() {
 }
 
+void* InputDispatcher::KeyEntry::operator new(size_t size) {
+    return entryPool<sizeof(KeyEntry)>().allocate(size);
+}
+
+void InputDispatcher::KeyEntry::operator delete(void* ptr, size_t size) {
+    entryPool<sizeof(KeyEntry)>().deallocate(ptr, size);
+}
+
 void InputDispatcher::KeyEntry::appendDescription(std::string& msg) const {
     msg += StringPrintf("KeyEvent(deviceId=%d, source=0x%08x, action=%s, "
             "flags=0x%08x, keyCode=%d, scanCode=%d, metaState=0x%08x, "
@@ -4050,6 +4315,14 @@ InputDispatcher::MotionEntry::MotionEntry(nsecs_t eventTime, int32_t deviceId,
 InputDispatcher::MotionEntry::~MotionEntry() {
 }
 
+void* InputDispatcher::MotionEntry::operator new(size_t size) {
+    return entryPool<sizeof(MotionEntry)>().allocate(size);
+}
+
+void InputDispatcher::MotionEntry::operator delete(void* ptr, size_t size) {
+    entryPool<sizeof(MotionEntry)>().deallocate(ptr, size);
+}
+
 void InputDispatcher::MotionEntry::appendDescription(std::string& msg) const {
     msg += StringPrintf("MotionEvent(deviceId=%d, source=0x%08x, action=%s, actionButton=0x%08x, "
             "flags=0x%08x, metaState=0x%08x, buttonState=0x%08x, "
@@ -4064,6 +4337,9 @@ void InputDispatcher::MotionEntry::appendDescription(std::string& msg) const {
                 pointerCoords[i].getX(), pointerCoords[i].getY());
     }
     msg += StringPrintf("]), policyFlags=0x%08x", policyFlags);
+    if (!historicalSamples.isEmpty()) {
+        msg += StringPrintf(", historySize=%zu", historicalSamples.size());
+    }
 }
 
 
@@ -4076,7 +4352,7 @@ InputDispatcher::DispatchEntry::DispatchEntry(EventEntry* eventEntry,
         seq(nextSeq()),
         eventEntry(eventEntry), targetFlags(targetFlags),
         xOffset(xOffset), yOffset(yOffset), scaleFactor(scaleFactor),
-        deliveryTime(0), resolvedAction(0), resolvedFlags(0) {
+        deliveryTime(0), publishedSamples(0), resolvedAction(0), resolvedFlags(0) {
     eventEntry->refCount += 1;
 }
 
@@ -4084,6 +4360,14 @@ InputDispatcher::DispatchEntry::~DispatchEntry() {
     eventEntry->release();
 }
 
+void* InputDispatcher::DispatchEntry::operator new(size_t size) {
+    return entryPool<sizeof(DispatchEntry)>().allocate(size);
+}
+
+void InputDispatcher::DispatchEntry::operator delete(void* ptr, size_t size) {
+    entryPool<sizeof(DispatchEntry)>().deallocate(ptr, size);
+}
+
 uint32_t InputDispatcher::DispatchEntry::nextSeq() {
     // Sequence number 0 is reserved and will never be returned.
     uint32_t seq;
@@ -4094,6 +4378,33 @@ uint32_t InputDispatcher::DispatchEntry::nextSeq() {
 }
 
 
+// --- InputDispatcher::StagedMotionQueue ---
+
+InputDispatcher::StagedMotionQueue::StagedMotionQueue() :
+        mHead(0), mTail(0) {
+}
+
+bool InputDispatcher::StagedMotionQueue::push(MotionEntry* entry) {
+    const size_t tail = mTail.load(std::memory_order_relaxed);
+    if (tail - mHead.load(std::memory_order_acquire) == CAPACITY) {
+        return false;
+    }
+    mEntries[tail % CAPACITY] = entry;
+    mTail.store(tail + 1);
+    return true;
+}
+
+InputDispatcher::MotionEntry* InputDispatcher::StagedMotionQueue::pop() {
+    const size_t head = mHead.load(std::memory_order_relaxed);
+    if (head == mTail.load()) {
+        return NULL;
+    }
+    MotionEntry* entry = mEntries[head % CAPACITY];
+    mHead.store(head + 1, std::memory_order_release);
+    return entry;
+}
+
+
 // --- InputDispatcher::InputState ---
 
 InputDispatcher::InputState::InputState() {
@@ -4454,7 +4765,7 @@ InputDispatcher::Connection::Connection(const sp<InputChannel>& inputChannel,
         const sp<InputWindowHandle>& inputWindowHandle, bool monitor) :
         status(STATUS_NORMAL), inputChannel(inputChannel), inputWindowHandle(inputWindowHandle),
         monitor(monitor),
-        inputPublisher(inputChannel), inputPublisherBlocked(false) {
+        inputPublisher(inputChannel), inputPublisherBlocked(false), publishPending(false) {
 }
 
 InputDispatcher::Connection::~Connection() {
@@ -32,7 +32,14 @@
 #include <unistd.h>
 #include <limits.h>
 
+#include <atomic>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
 #include "InputWindow.h"
+#include "InputWindowIndex.h"
+#include "InputLatencyTracker.h"
 #include "InputApplication.h"
 #include "InputListener.h"
 
@@ -436,6 +443,7 @@ private:
         mutable int32_t refCount;
         int32_t type;
         nsecs_t eventTime;
+        nsecs_t receiveTime; // when the dispatcher was notified of the event
         uint32_t policyFlags;
         InjectionState* injectionState;
 
@@ -502,6 +510,11 @@ private:
 
     protected:
         virtual ~KeyEntry();
+
+    public:
+        // key, motion and dispatch entries recycle their storage
+        static void* operator new(size_t size);
+        static void operator delete(void* ptr, size_t size);
     };
 
     struct MotionEntry : EventEntry {
@@ -522,6 +535,14 @@ private:
         PointerProperties pointerProperties[MAX_POINTERS];
         PointerCoords pointerCoords[MAX_POINTERS];
 
+        // The earlier samples of a move that was coalesced in the inbound queue, oldest
+        // first.  eventTime and pointerCoords above always hold the latest sample.
+        struct Sample {
+            nsecs_t eventTime;
+            PointerCoords pointerCoords[MAX_POINTERS];
+        };
+        Vector<Sample> historicalSamples;
+
         MotionEntry(nsecs_t eventTime,
                 int32_t deviceId, uint32_t source, uint32_t policyFlags,
                 int32_t action, int32_t actionButton, int32_t flags,
@@ -534,6 +555,10 @@ private:
 
     protected:
         virtual ~MotionEntry();
+
+    public:
+        static void* operator new(size_t size);
+        static void operator delete(void* ptr, size_t size);
     };
 
     // Tracks the progress of dispatching a particular event to a particular connection.
@@ -546,6 +571,7 @@ private:
         float yOffset;
         float scaleFactor;
         nsecs_t deliveryTime; // time when the event was actually delivered
+        size_t publishedSamples; // samples of a coalesced motion that are already published
 
         // Set to the resolved action and flags when the event is enqueued.
         int32_t resolvedAction;
@@ -555,6 +581,9 @@ private:
                 int32_t targetFlags, float xOffset, float yOffset, float scaleFactor);
         ~DispatchEntry();
 
+        static void* operator new(size_t size);
+        static void operator delete(void* ptr, size_t size);
+
         inline bool hasForegroundTarget() const {
             return targetFlags & InputTarget::FLAG_FOREGROUND;
         }
@@ -821,6 +850,9 @@ private:
         // the application consumes some of the input.
         bool inputPublisherBlocked;
 
+        // True if the connection is in mConnectionsToPublish.
+        bool publishPending;
+
         // Queue of events that need to be published to the connection.
         Queue<DispatchEntry> outboundQueue;
 
@@ -848,6 +880,22 @@ private:
         DROP_REASON_STALE = 5,
     };
 
+    // Hands motion entries from notifyMotion() to whoever holds mLock next, without
+    // taking it. There is one producer at a time, and consumers hold mLock.
+    class StagedMotionQueue {
+    public:
+        StagedMotionQueue();
+
+        bool push(MotionEntry* entry); // false if full
+        MotionEntry* pop(); // NULL if empty
+
+    private:
+        enum { CAPACITY = 256 };
+        std::atomic<size_t> mHead;
+        std::atomic<size_t> mTail;
+        MotionEntry* mEntries[CAPACITY];
+    };
+
     sp<InputDispatcherPolicyInterface> mPolicy;
     InputDispatcherConfiguration mConfig;
 
@@ -868,6 +916,20 @@ private:
 
     // Enqueues an inbound event.  Returns true if mLooper->wake() should be called.
     bool enqueueInboundEventLocked(EventEntry* entry);
+    bool insertInboundEventLocked(EventEntry* entry);
+    // Appends a move to the move at the tail of the inbound queue when they are samples
+    // of the same gesture.  Returns true if the entry was consumed.
+    bool coalesceMotionLocked(MotionEntry* entry);
+
+    // Motion events notifyMotion() queued without taking mLock, to be moved into
+    // mInboundQueue, in order, before anything else goes there.
+    StagedMotionQueue mStagedMotions;
+    std::atomic<bool> mStagingMotion; // a producer is pushing
+    std::atomic<bool> mStagedWakePending; // the looper was woken for staged motions
+    std::atomic<bool> mInputFilterEnabledForStaging; // mInputFilterEnabled, readable unlocked
+    bool stageMotion(MotionEntry* entry);
+    // Returns true if mLooper->wake() should be called.
+    bool drainStagedMotionsLocked();
 
     // Cleans up input state when dropping an inbound event.
     void dropInboundEventLocked(EventEntry* entry, DropReason dropReason);
@@ -895,8 +957,10 @@ private:
 
     // All registered connections mapped by channel file descriptor.
     KeyedVector<int, sp<Connection> > mConnectionsByFd;
+    // the same connections, by their input channel
+    std::unordered_map<const InputChannel*, sp<Connection> > mConnectionsByChannel;
 
-    ssize_t getConnectionIndexLocked(const sp<InputChannel>& inputChannel);
+    sp<Connection> getConnectionLocked(const sp<InputChannel>& inputChannel) const;
 
     // Input channels that will receive a copy of all input events.
     Vector<sp<InputChannel> > mMonitoringChannels;
@@ -953,6 +1017,10 @@ private:
     bool mInputFilterEnabled;
 
     Vector<sp<InputWindowHandle> > mWindowHandles;
+    InputWindowIndex mWindowIndex;
+    // rebuilt with mWindowIndex
+    std::unordered_map<const InputChannel*, sp<InputWindowHandle> > mWindowHandlesByChannel;
+    std::unordered_set<const InputWindowHandle*> mWindowHandleSet;
 
     sp<InputWindowHandle> getWindowHandleLocked(const sp<InputChannel>& inputChannel) const;
     bool hasWindowHandleLocked(const sp<InputWindowHandle>& windowHandle) const;
@@ -1072,6 +1140,8 @@ private:
     void enqueueDispatchEntryLocked(const sp<Connection>& connection,
             EventEntry* eventEntry, const InputTarget* inputTarget, int32_t dispatchMode);
     void startDispatchCycleLocked(nsecs_t currentTime, const sp<Connection>& connection);
+    void handlePublishFailureLocked(nsecs_t currentTime, const sp<Connection>& connection,
+            DispatchEntry* dispatchEntry, status_t status);
     void finishDispatchCycleLocked(nsecs_t currentTime, const sp<Connection>& connection,
             uint32_t seq, bool handled);
     void abortBrokenDispatchCycleLocked(nsecs_t currentTime, const sp<Connection>& connection,
@@ -1080,6 +1150,34 @@ private:
     void releaseDispatchEntryLocked(DispatchEntry* dispatchEntry);
     static int handleReceiveCallback(int fd, int events, void* data);
 
+    // Events are written to the connections outside of mLock, on the dispatcher thread.
+    // startDispatchCycleLocked() only marks the connection; preparePublishesLocked() then
+    // moves the outbound queues to the wait queues, publishPendingEvents() writes them out
+    // without the lock and finishPublishesLocked() puts back whatever didn't fit.
+    struct PublishRequest {
+        sp<Connection> connection;
+        EventEntry* eventEntry; // holds a reference, released under the lock
+        uint32_t seq;
+        int32_t targetFlags;
+        float xOffset;
+        float yOffset;
+        float scaleFactor;
+        int32_t resolvedAction;
+        int32_t resolvedFlags;
+        size_t publishedSamples;
+        status_t status;
+    };
+
+    Vector<sp<Connection> > mConnectionsToPublish;
+    std::vector<PublishRequest> mPublishRequests; // only used by the dispatcher thread
+
+    void preparePublishesLocked(nsecs_t currentTime);
+    void publishPendingEvents();
+    void finishPublishesLocked(nsecs_t currentTime);
+    static status_t publishEvent(PublishRequest& request);
+    static status_t publishMotionSample(const PublishRequest& request,
+            const MotionEntry* motionEntry, size_t sampleIndex);
+
     void synthesizeCancelationEventsForAllConnectionsLocked(
             const CancelationOptions& options);
     void synthesizeCancelationEventsForMonitorsLocked(const CancelationOptions& options);
@@ -1130,6 +1228,11 @@ private:
     void initializeKeyEvent(KeyEvent* event, const KeyEntry* entry);
 
     // Statistics gathering.
+    // Latency of finished events, per window.
+    InputLatencyTracker mLatencyTracker;
+    void recordLatencyLocked(const sp<Connection>& connection,
+            const DispatchEntry* dispatchEntry, nsecs_t finishTime);
+
     void updateDispatchStatisticsLocked(nsecs_t currentTime, const EventEntry* entry,
             int32_t injectionResult, nsecs_t timeSpentWaitingForApplication);
     void traceInboundQueueLengthLocked();
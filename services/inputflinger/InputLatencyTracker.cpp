@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "InputLatencyTracker.h"
+
+#include <android-base/stringprintf.h>
+
+#define INDENT "  "
+
+using android::base::StringPrintf;
+
+namespace android {
+
+constexpr nsecs_t BUCKET_BASE = 500 * 1000LL; // 0.5ms
+
+static const char* const STAGE_LABELS[] = {
+    "read", "dispatch", "app", "total",
+};
+
+// --- InputLatencyTracker::Histogram ---
+
+void InputLatencyTracker::Histogram::add(nsecs_t latency) {
+    size_t bucket = 0;
+    while (bucket < BUCKET_COUNT - 1 && latency >= (BUCKET_BASE << bucket)) {
+        bucket++;
+    }
+    buckets[bucket]++;
+    if (latency > max) {
+        max = latency;
+    }
+}
+
+nsecs_t InputLatencyTracker::Histogram::percentile(size_t count, float fraction) const {
+    // The upper bound of the bucket the sample falls in, but never past the worst one seen.
+    const size_t rank = size_t(fraction * count + 0.5f);
+    size_t seen = 0;
+    for (size_t bucket = 0; bucket < BUCKET_COUNT - 1; bucket++) {
+        seen += buckets[bucket];
+        if (seen >= rank) {
+            const nsecs_t bound = BUCKET_BASE << bucket;
+            return bound < max ? bound : max;
+        }
+    }
+    return max;
+}
+
+// --- InputLatencyTracker ---
+
+void InputLatencyTracker::addSample(const std::string& windowName, nsecs_t eventTime,
+        nsecs_t receiveTime, nsecs_t deliveryTime, nsecs_t finishTime) {
+    auto it = mWindows.find(windowName);
+    if (it == mWindows.end()) {
+        if (mWindows.size() >= MAX_WINDOWS) {
+            // Make room by forgetting the window that was heard from least recently.
+            auto oldest = mWindows.begin();
+            for (auto jt = mWindows.begin(); jt != mWindows.end(); ++jt) {
+                if (jt->second.lastFinishTime < oldest->second.lastFinishTime) {
+                    oldest = jt;
+                }
+            }
+            mWindows.erase(oldest);
+        }
+        it = mWindows.emplace(windowName, WindowLatency()).first;
+    }
+
+    WindowLatency& window = it->second;
+    window.count++;
+    window.lastFinishTime = finishTime;
+    window.stages[STAGE_READ].add(receiveTime - eventTime);
+    window.stages[STAGE_DISPATCH].add(deliveryTime - receiveTime);
+    window.stages[STAGE_APP].add(finishTime - deliveryTime);
+    window.stages[STAGE_TOTAL].add(finishTime - eventTime);
+}
+
+void InputLatencyTracker::reset() {
+    mWindows.clear();
+}
+
+size_t InputLatencyTracker::getSampleCount(const std::string& windowName) const {
+    auto it = mWindows.find(windowName);
+    return it != mWindows.end() ? it->second.count : 0;
+}
+
+nsecs_t InputLatencyTracker::getPercentile(const std::string& windowName, Stage stage,
+        float fraction) const {
+    auto it = mWindows.find(windowName);
+    if (it == mWindows.end()) {
+        return -1;
+    }
+    return it->second.stages[stage].percentile(it->second.count, fraction);
+}
+
+void InputLatencyTracker::dump(std::string& dump, const char* prefix) const {
+    if (mWindows.empty()) {
+        dump += StringPrintf("%sInputLatency: <none>\n", prefix);
+        return;
+    }
+
+    dump += StringPrintf("%sInputLatency (p50/p95/p99/max ms):\n", prefix);
+    for (const auto& entry : mWindows) {
+        const WindowLatency& window = entry.second;
+        dump += StringPrintf("%s" INDENT "'%s': samples=%zu", prefix, entry.first.c_str(),
+                window.count);
+        for (size_t stage = 0; stage < STAGE_COUNT; stage++) {
+            const Histogram& histogram = window.stages[stage];
+            dump += StringPrintf(", %s=%0.1f/%0.1f/%0.1f/%0.1f", STAGE_LABELS[stage],
+                    histogram.percentile(window.count, 0.5f) * 0.000001f,
+                    histogram.percentile(window.count, 0.95f) * 0.000001f,
+                    histogram.percentile(window.count, 0.99f) * 0.000001f,
+                    histogram.max * 0.000001f);
+        }
+        dump += "\n";
+    }
+}
+
+} // namespace android
@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _UI_INPUT_LATENCY_TRACKER_H
+#define _UI_INPUT_LATENCY_TRACKER_H
+
+#include <utils/Timers.h>
+
+#include <string>
+#include <unordered_map>
+
+namespace android {
+
+/*
+ * Per-window histograms of how long input events take to get from the kernel
+ * to the application and through it.
+ *
+ * Each finished event is split into stages: reading and cooking (kernel
+ * timestamp until the dispatcher is notified), dispatching (until the event
+ * is published to the window) and the application (until it finishes the
+ * event).  Only the most recently active windows are kept.
+ *
+ * Not thread safe; the dispatcher uses it with its lock held.
+ */
+class InputLatencyTracker {
+public:
+    enum Stage {
+        STAGE_READ,
+        STAGE_DISPATCH,
+        STAGE_APP,
+        STAGE_TOTAL,
+
+        STAGE_COUNT
+    };
+
+    // Times are all SYSTEM_TIME_MONOTONIC; eventTime is the kernel's timestamp.
+    void addSample(const std::string& windowName, nsecs_t eventTime, nsecs_t receiveTime,
+            nsecs_t deliveryTime, nsecs_t finishTime);
+    void reset();
+
+    // getPercentile() bounds the latency that the given fraction of the window's
+    // samples stayed under in a stage, and is -1 for a window with no samples.
+    size_t getSampleCount(const std::string& windowName) const;
+    nsecs_t getPercentile(const std::string& windowName, Stage stage, float fraction) const;
+
+    void dump(std::string& dump, const char* prefix) const;
+
+private:
+    enum {
+        // bucket i holds latencies below 2^i * 0.5ms, the last one everything else
+        BUCKET_COUNT = 16,
+        MAX_WINDOWS = 32,
+    };
+
+    struct Histogram {
+        uint32_t buckets[BUCKET_COUNT] = {};
+        nsecs_t max = 0;
+
+        void add(nsecs_t latency);
+        nsecs_t percentile(size_t count, float fraction) const;
+    };
+
+    struct WindowLatency {
+        size_t count = 0;
+        nsecs_t lastFinishTime = 0;
+        Histogram stages[STAGE_COUNT];
+    };
+
+    std::unordered_map<std::string, WindowLatency> mWindows;
+};
+
+} // namespace android
+
+#endif // _UI_INPUT_LATENCY_TRACKER_H
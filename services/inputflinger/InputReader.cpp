@@ -335,7 +335,7 @@ InputReader::InputReader(const sp<EventHubInterface>& eventHub,
         const sp<InputReaderPolicyInterface>& policy,
         const sp<InputListenerInterface>& listener) :
         mContext(this), mEventHub(eventHub), mPolicy(policy),
-        mGlobalMetaState(0), mGeneration(1),
+        mEventBuffer(MIN_EVENT_BUFFER_SIZE), mGlobalMetaState(0), mGeneration(1),
         mDisableVirtualKeysTimeout(LLONG_MIN), mNextTimeout(LLONG_MAX),
         mConfigurationChangesToRefresh(0) {
     mQueuedListener = new QueuedInputListener(listener);
@@ -376,14 +376,14 @@ void InputReader::loopOnce() {
         }
     } // release lock
 
-    size_t count = mEventHub->getEvents(timeoutMillis, mEventBuffer, EVENT_BUFFER_SIZE);
+    size_t count = mEventHub->getEvents(timeoutMillis, mEventBuffer.data(), mEventBuffer.size());
 
     { // acquire lock
         AutoMutex _l(mLock);
         mReaderIsAliveCondition.broadcast();
 
         if (count) {
-            processEventsLocked(mEventBuffer, count);
+            processEventsLocked(mEventBuffer.data(), count);
         }
 
         if (mNextTimeout != LLONG_MAX) {
@@ -403,6 +403,11 @@ void InputReader::loopOnce() {
         }
     } // release lock
 
+    // More events are probably waiting; read them in bigger batches.
+    if (count == mEventBuffer.size() && count < MAX_EVENT_BUFFER_SIZE) {
+        mEventBuffer.resize(count * 2);
+    }
+
     // Send out a message that the describes the changed input devices.
     if (inputDevicesChanged) {
         mPolicy->notifyInputDevicesChanged(inputDevices);
@@ -3907,6 +3912,33 @@ void TouchInputMapper::configureSurface(nsecs_t when, bool* outResetNeeded) {
         *outResetNeeded = true;
         bumpGeneration();
     }
+
+    // Compute the surface transform.  The raw axis ranges are read again here
+    // because they can be reconfigured without the viewport changing.
+    const float rawXMin = mRawPointerAxes.x.minValue, rawXMax = mRawPointerAxes.x.maxValue;
+    const float rawYMin = mRawPointerAxes.y.minValue, rawYMax = mRawPointerAxes.y.maxValue;
+    switch (mSurfaceOrientation) {
+    case DISPLAY_ORIENTATION_90:
+        mSurfaceXTransform = { true, rawYMin, mYScale, mYTranslate };
+        mSurfaceYTransform = { false, rawXMax, -mXScale, mXTranslate };
+        mSurfaceOrientationOffset = -M_PI_2;
+        break;
+    case DISPLAY_ORIENTATION_180:
+        mSurfaceXTransform = { false, rawXMax, -mXScale, 0 };
+        mSurfaceYTransform = { true, rawYMax, -mYScale, mYTranslate };
+        mSurfaceOrientationOffset = -M_PI;
+        break;
+    case DISPLAY_ORIENTATION_270:
+        mSurfaceXTransform = { true, rawYMax, -mYScale, 0 };
+        mSurfaceYTransform = { false, rawXMin, mXScale, mXTranslate };
+        mSurfaceOrientationOffset = M_PI_2;
+        break;
+    default:
+        mSurfaceXTransform = { false, rawXMin, mXScale, mXTranslate };
+        mSurfaceYTransform = { true, rawYMin, mYScale, mYTranslate };
+        mSurfaceOrientationOffset = 0;
+        break;
+    }
 }
 
 void TouchInputMapper::dumpSurface(std::string& dump) {
@@ -4955,249 +4987,264 @@ void TouchInputMapper::cookPointerData() {
         mCurrentCookedState.buttonState = mCurrentRawState.buttonState;
     }
 
-    // Walk through the the active pointers and map device coordinates onto
-    // surface coordinates and adjust for display orientation.
-    for (uint32_t i = 0; i < currentPointerCount; i++) {
-        const RawPointerData::Pointer& in = mCurrentRawState.rawPointerData.pointers[i];
-
-        // Size
-        float touchMajor, touchMinor, toolMajor, toolMinor, size;
-        switch (mCalibration.sizeCalibration) {
-        case Calibration::SIZE_CALIBRATION_GEOMETRIC:
-        case Calibration::SIZE_CALIBRATION_DIAMETER:
-        case Calibration::SIZE_CALIBRATION_BOX:
-        case Calibration::SIZE_CALIBRATION_AREA:
-            if (mRawPointerAxes.touchMajor.valid && mRawPointerAxes.toolMajor.valid) {
-                touchMajor = in.touchMajor;
-                touchMinor = mRawPointerAxes.touchMinor.valid ? in.touchMinor : in.touchMajor;
-                toolMajor = in.toolMajor;
-                toolMinor = mRawPointerAxes.toolMinor.valid ? in.toolMinor : in.toolMajor;
-                size = mRawPointerAxes.touchMinor.valid
+    // Cook the pointers one property at a time, so that each calibration setting is
+    // looked at once per sync rather than once per pointer.  Every pointer still goes
+    // through exactly the same arithmetic.
+    const RawPointerData::Pointer* pointers = mCurrentRawState.rawPointerData.pointers;
+
+    // Size
+    float touchMajor[MAX_POINTERS], touchMinor[MAX_POINTERS];
+    float toolMajor[MAX_POINTERS], toolMinor[MAX_POINTERS];
+    float size[MAX_POINTERS];
+    switch (mCalibration.sizeCalibration) {
+    case Calibration::SIZE_CALIBRATION_GEOMETRIC:
+    case Calibration::SIZE_CALIBRATION_DIAMETER:
+    case Calibration::SIZE_CALIBRATION_BOX:
+    case Calibration::SIZE_CALIBRATION_AREA: {
+        if (mRawPointerAxes.touchMajor.valid && mRawPointerAxes.toolMajor.valid) {
+            for (uint32_t i = 0; i < currentPointerCount; i++) {
+                const RawPointerData::Pointer& in = pointers[i];
+                touchMajor[i] = in.touchMajor;
+                touchMinor[i] = mRawPointerAxes.touchMinor.valid ? in.touchMinor : in.touchMajor;
+                toolMajor[i] = in.toolMajor;
+                toolMinor[i] = mRawPointerAxes.toolMinor.valid ? in.toolMinor : in.toolMajor;
+                size[i] = mRawPointerAxes.touchMinor.valid
                         ? avg(in.touchMajor, in.touchMinor) : in.touchMajor;
-            } else if (mRawPointerAxes.touchMajor.valid) {
-                toolMajor = touchMajor = in.touchMajor;
-                toolMinor = touchMinor = mRawPointerAxes.touchMinor.valid
+            }
+        } else if (mRawPointerAxes.touchMajor.valid) {
+            for (uint32_t i = 0; i < currentPointerCount; i++) {
+                const RawPointerData::Pointer& in = pointers[i];
+                toolMajor[i] = touchMajor[i] = in.touchMajor;
+                toolMinor[i] = touchMinor[i] = mRawPointerAxes.touchMinor.valid
                         ? in.touchMinor : in.touchMajor;
-                size = mRawPointerAxes.touchMinor.valid
+                size[i] = mRawPointerAxes.touchMinor.valid
                         ? avg(in.touchMajor, in.touchMinor) : in.touchMajor;
-            } else if (mRawPointerAxes.toolMajor.valid) {
-                touchMajor = toolMajor = in.toolMajor;
-                touchMinor = toolMinor = mRawPointerAxes.toolMinor.valid
+            }
+        } else if (mRawPointerAxes.toolMajor.valid) {
+            for (uint32_t i = 0; i < currentPointerCount; i++) {
+                const RawPointerData::Pointer& in = pointers[i];
+                touchMajor[i] = toolMajor[i] = in.toolMajor;
+                touchMinor[i] = toolMinor[i] = mRawPointerAxes.toolMinor.valid
                         ? in.toolMinor : in.toolMajor;
-                size = mRawPointerAxes.toolMinor.valid
+                size[i] = mRawPointerAxes.toolMinor.valid
                         ? avg(in.toolMajor, in.toolMinor) : in.toolMajor;
-            } else {
-                ALOG_ASSERT(false, "No touch or tool axes.  "
-                        "Size calibration should have been resolved to NONE.");
-                touchMajor = 0;
-                touchMinor = 0;
-                toolMajor = 0;
-                toolMinor = 0;
-                size = 0;
             }
+        } else {
+            ALOG_ASSERT(false, "No touch or tool axes.  "
+                    "Size calibration should have been resolved to NONE.");
+            for (uint32_t i = 0; i < currentPointerCount; i++) {
+                touchMajor[i] = touchMinor[i] = toolMajor[i] = toolMinor[i] = size[i] = 0;
+            }
+        }
 
-            if (mCalibration.haveSizeIsSummed && mCalibration.sizeIsSummed) {
-                uint32_t touchingCount =
-                        mCurrentRawState.rawPointerData.touchingIdBits.count();
-                if (touchingCount > 1) {
-                    touchMajor /= touchingCount;
-                    touchMinor /= touchingCount;
-                    toolMajor /= touchingCount;
-                    toolMinor /= touchingCount;
-                    size /= touchingCount;
+        if (mCalibration.haveSizeIsSummed && mCalibration.sizeIsSummed) {
+            uint32_t touchingCount = mCurrentRawState.rawPointerData.touchingIdBits.count();
+            if (touchingCount > 1) {
+                for (uint32_t i = 0; i < currentPointerCount; i++) {
+                    touchMajor[i] /= touchingCount;
+                    touchMinor[i] /= touchingCount;
+                    toolMajor[i] /= touchingCount;
+                    toolMinor[i] /= touchingCount;
+                    size[i] /= touchingCount;
                 }
             }
+        }
 
-            if (mCalibration.sizeCalibration == Calibration::SIZE_CALIBRATION_GEOMETRIC) {
-                touchMajor *= mGeometricScale;
-                touchMinor *= mGeometricScale;
-                toolMajor *= mGeometricScale;
-                toolMinor *= mGeometricScale;
-            } else if (mCalibration.sizeCalibration == Calibration::SIZE_CALIBRATION_AREA) {
-                touchMajor = touchMajor > 0 ? sqrtf(touchMajor) : 0;
-                touchMinor = touchMajor;
-                toolMajor = toolMajor > 0 ? sqrtf(toolMajor) : 0;
-                toolMinor = toolMajor;
-            } else if (mCalibration.sizeCalibration == Calibration::SIZE_CALIBRATION_DIAMETER) {
-                touchMinor = touchMajor;
-                toolMinor = toolMajor;
+        if (mCalibration.sizeCalibration == Calibration::SIZE_CALIBRATION_GEOMETRIC) {
+            for (uint32_t i = 0; i < currentPointerCount; i++) {
+                touchMajor[i] *= mGeometricScale;
+                touchMinor[i] *= mGeometricScale;
+                toolMajor[i] *= mGeometricScale;
+                toolMinor[i] *= mGeometricScale;
+            }
+        } else if (mCalibration.sizeCalibration == Calibration::SIZE_CALIBRATION_AREA) {
+            for (uint32_t i = 0; i < currentPointerCount; i++) {
+                touchMajor[i] = touchMajor[i] > 0 ? sqrtf(touchMajor[i]) : 0;
+                touchMinor[i] = touchMajor[i];
+                toolMajor[i] = toolMajor[i] > 0 ? sqrtf(toolMajor[i]) : 0;
+                toolMinor[i] = toolMajor[i];
+            }
+        } else if (mCalibration.sizeCalibration == Calibration::SIZE_CALIBRATION_DIAMETER) {
+            for (uint32_t i = 0; i < currentPointerCount; i++) {
+                touchMinor[i] = touchMajor[i];
+                toolMinor[i] = toolMajor[i];
             }
-
-            mCalibration.applySizeScaleAndBias(&touchMajor);
-            mCalibration.applySizeScaleAndBias(&touchMinor);
-            mCalibration.applySizeScaleAndBias(&toolMajor);
-            mCalibration.applySizeScaleAndBias(&toolMinor);
-            size *= mSizeScale;
-            break;
-        default:
-            touchMajor = 0;
-            touchMinor = 0;
-            toolMajor = 0;
-            toolMinor = 0;
-            size = 0;
-            break;
         }
 
-        // Pressure
-        float pressure;
-        switch (mCalibration.pressureCalibration) {
-        case Calibration::PRESSURE_CALIBRATION_PHYSICAL:
-        case Calibration::PRESSURE_CALIBRATION_AMPLITUDE:
-            pressure = in.pressure * mPressureScale;
-            break;
-        default:
-            pressure = in.isHovering ? 0 : 1;
-            break;
+        for (uint32_t i = 0; i < currentPointerCount; i++) {
+            mCalibration.applySizeScaleAndBias(&touchMajor[i]);
+            mCalibration.applySizeScaleAndBias(&touchMinor[i]);
+            mCalibration.applySizeScaleAndBias(&toolMajor[i]);
+            mCalibration.applySizeScaleAndBias(&toolMinor[i]);
+            size[i] *= mSizeScale;
         }
+        break;
+    }
+    default:
+        for (uint32_t i = 0; i < currentPointerCount; i++) {
+            touchMajor[i] = touchMinor[i] = toolMajor[i] = toolMinor[i] = size[i] = 0;
+        }
+        break;
+    }
 
-        // Tilt and Orientation
-        float tilt;
-        float orientation;
-        if (mHaveTilt) {
-            float tiltXAngle = (in.tiltX - mTiltXCenter) * mTiltXScale;
-            float tiltYAngle = (in.tiltY - mTiltYCenter) * mTiltYScale;
-            orientation = atan2f(-sinf(tiltXAngle), sinf(tiltYAngle));
-            tilt = acosf(cosf(tiltXAngle) * cosf(tiltYAngle));
-        } else {
-            tilt = 0;
+    // Pressure
+    float pressure[MAX_POINTERS];
+    switch (mCalibration.pressureCalibration) {
+    case Calibration::PRESSURE_CALIBRATION_PHYSICAL:
+    case Calibration::PRESSURE_CALIBRATION_AMPLITUDE:
+        for (uint32_t i = 0; i < currentPointerCount; i++) {
+            pressure[i] = pointers[i].pressure * mPressureScale;
+        }
+        break;
+    default:
+        for (uint32_t i = 0; i < currentPointerCount; i++) {
+            pressure[i] = pointers[i].isHovering ? 0 : 1;
+        }
+        break;
+    }
 
-            switch (mCalibration.orientationCalibration) {
-            case Calibration::ORIENTATION_CALIBRATION_INTERPOLATED:
-                orientation = in.orientation * mOrientationScale;
-                break;
-            case Calibration::ORIENTATION_CALIBRATION_VECTOR: {
-                int32_t c1 = signExtendNybble((in.orientation & 0xf0) >> 4);
-                int32_t c2 = signExtendNybble(in.orientation & 0x0f);
+    // Tilt and Orientation
+    float tilt[MAX_POINTERS];
+    float orientation[MAX_POINTERS];
+    if (mHaveTilt) {
+        for (uint32_t i = 0; i < currentPointerCount; i++) {
+            float tiltXAngle = (pointers[i].tiltX - mTiltXCenter) * mTiltXScale;
+            float tiltYAngle = (pointers[i].tiltY - mTiltYCenter) * mTiltYScale;
+            orientation[i] = atan2f(-sinf(tiltXAngle), sinf(tiltYAngle));
+            tilt[i] = acosf(cosf(tiltXAngle) * cosf(tiltYAngle));
+        }
+    } else {
+        switch (mCalibration.orientationCalibration) {
+        case Calibration::ORIENTATION_CALIBRATION_INTERPOLATED:
+            for (uint32_t i = 0; i < currentPointerCount; i++) {
+                orientation[i] = pointers[i].orientation * mOrientationScale;
+            }
+            break;
+        case Calibration::ORIENTATION_CALIBRATION_VECTOR:
+            for (uint32_t i = 0; i < currentPointerCount; i++) {
+                int32_t c1 = signExtendNybble((pointers[i].orientation & 0xf0) >> 4);
+                int32_t c2 = signExtendNybble(pointers[i].orientation & 0x0f);
                 if (c1 != 0 || c2 != 0) {
-                    orientation = atan2f(c1, c2) * 0.5f;
+                    orientation[i] = atan2f(c1, c2) * 0.5f;
                     float confidence = hypotf(c1, c2);
                     float scale = 1.0f + confidence / 16.0f;
-                    touchMajor *= scale;
-                    touchMinor /= scale;
-                    toolMajor *= scale;
-                    toolMinor /= scale;
+                    touchMajor[i] *= scale;
+                    touchMinor[i] /= scale;
+                    toolMajor[i] *= scale;
+                    toolMinor[i] /= scale;
                 } else {
-                    orientation = 0;
+                    orientation[i] = 0;
                 }
-                break;
             }
-            default:
-                orientation = 0;
+            break;
+        default:
+            for (uint32_t i = 0; i < currentPointerCount; i++) {
+                orientation[i] = 0;
             }
+            break;
+        }
+        for (uint32_t i = 0; i < currentPointerCount; i++) {
+            tilt[i] = 0;
         }
+    }
 
-        // Distance
-        float distance;
-        switch (mCalibration.distanceCalibration) {
-        case Calibration::DISTANCE_CALIBRATION_SCALED:
-            distance = in.distance * mDistanceScale;
-            break;
-        default:
-            distance = 0;
+    // Adjust the orientation for the surface orientation.
+    if (mSurfaceOrientationOffset != 0) {
+        const bool wrap = mOrientedRanges.haveOrientation;
+        const float minOrientation = mOrientedRanges.orientation.min;
+        const float maxOrientation = mOrientedRanges.orientation.max;
+        for (uint32_t i = 0; i < currentPointerCount; i++) {
+            orientation[i] += mSurfaceOrientationOffset;
+            if (wrap) {
+                if (mSurfaceOrientationOffset < 0 && orientation[i] < minOrientation) {
+                    orientation[i] += (maxOrientation - minOrientation);
+                } else if (mSurfaceOrientationOffset > 0 && orientation[i] > maxOrientation) {
+                    orientation[i] -= (maxOrientation - minOrientation);
+                }
+            }
         }
+    }
 
-        // Coverage
-        int32_t rawLeft, rawTop, rawRight, rawBottom;
-        switch (mCalibration.coverageCalibration) {
-        case Calibration::COVERAGE_CALIBRATION_BOX:
-            rawLeft = (in.toolMinor & 0xffff0000) >> 16;
-            rawRight = in.toolMinor & 0x0000ffff;
-            rawBottom = in.toolMajor & 0x0000ffff;
-            rawTop = (in.toolMajor & 0xffff0000) >> 16;
-            break;
-        default:
-            rawLeft = rawTop = rawRight = rawBottom = 0;
-            break;
+    // Distance
+    float distance[MAX_POINTERS];
+    switch (mCalibration.distanceCalibration) {
+    case Calibration::DISTANCE_CALIBRATION_SCALED:
+        for (uint32_t i = 0; i < currentPointerCount; i++) {
+            distance[i] = pointers[i].distance * mDistanceScale;
         }
+        break;
+    default:
+        for (uint32_t i = 0; i < currentPointerCount; i++) {
+            distance[i] = 0;
+        }
+        break;
+    }
 
-        // Adjust X,Y coords for device calibration
-        // TODO: Adjust coverage coords?
-        float xTransformed = in.x, yTransformed = in.y;
+    // Adjust X,Y coords for device calibration, then map them onto the surface.
+    float x[MAX_POINTERS], y[MAX_POINTERS];
+    for (uint32_t i = 0; i < currentPointerCount; i++) {
+        float xTransformed = pointers[i].x, yTransformed = pointers[i].y;
         mAffineTransform.applyTo(xTransformed, yTransformed);
+        x[i] = mSurfaceXTransform.apply(xTransformed, yTransformed);
+        y[i] = mSurfaceYTransform.apply(xTransformed, yTransformed);
+    }
 
-        // Adjust X, Y, and coverage coords for surface orientation.
-        float x, y;
-        float left, top, right, bottom;
-
-        switch (mSurfaceOrientation) {
-        case DISPLAY_ORIENTATION_90:
-            x = float(yTransformed - mRawPointerAxes.y.minValue) * mYScale + mYTranslate;
-            y = float(mRawPointerAxes.x.maxValue - xTransformed) * mXScale + mXTranslate;
-            left = float(rawTop - mRawPointerAxes.y.minValue) * mYScale + mYTranslate;
-            right = float(rawBottom- mRawPointerAxes.y.minValue) * mYScale + mYTranslate;
-            bottom = float(mRawPointerAxes.x.maxValue - rawLeft) * mXScale + mXTranslate;
-            top = float(mRawPointerAxes.x.maxValue - rawRight) * mXScale + mXTranslate;
-            orientation -= M_PI_2;
-            if (mOrientedRanges.haveOrientation && orientation < mOrientedRanges.orientation.min) {
-                orientation += (mOrientedRanges.orientation.max - mOrientedRanges.orientation.min);
-            }
-            break;
-        case DISPLAY_ORIENTATION_180:
-            x = float(mRawPointerAxes.x.maxValue - xTransformed) * mXScale;
-            y = float(mRawPointerAxes.y.maxValue - yTransformed) * mYScale + mYTranslate;
-            left = float(mRawPointerAxes.x.maxValue - rawRight) * mXScale;
-            right = float(mRawPointerAxes.x.maxValue - rawLeft) * mXScale;
-            bottom = float(mRawPointerAxes.y.maxValue - rawTop) * mYScale + mYTranslate;
-            top = float(mRawPointerAxes.y.maxValue - rawBottom) * mYScale + mYTranslate;
-            orientation -= M_PI;
-            if (mOrientedRanges.haveOrientation && orientation < mOrientedRanges.orientation.min) {
-                orientation += (mOrientedRanges.orientation.max - mOrientedRanges.orientation.min);
-            }
-            break;
-        case DISPLAY_ORIENTATION_270:
-            x = float(mRawPointerAxes.y.maxValue - yTransformed) * mYScale;
-            y = float(xTransformed - mRawPointerAxes.x.minValue) * mXScale + mXTranslate;
-            left = float(mRawPointerAxes.y.maxValue - rawBottom) * mYScale;
-            right = float(mRawPointerAxes.y.maxValue - rawTop) * mYScale;
-            bottom = float(rawRight - mRawPointerAxes.x.minValue) * mXScale + mXTranslate;
-            top = float(rawLeft - mRawPointerAxes.x.minValue) * mXScale + mXTranslate;
-            orientation += M_PI_2;
-            if (mOrientedRanges.haveOrientation && orientation > mOrientedRanges.orientation.max) {
-                orientation -= (mOrientedRanges.orientation.max - mOrientedRanges.orientation.min);
-            }
-            break;
-        default:
-            x = float(xTransformed - mRawPointerAxes.x.minValue) * mXScale + mXTranslate;
-            y = float(yTransformed - mRawPointerAxes.y.minValue) * mYScale + mYTranslate;
-            left = float(rawLeft - mRawPointerAxes.x.minValue) * mXScale + mXTranslate;
-            right = float(rawRight - mRawPointerAxes.x.minValue) * mXScale + mXTranslate;
-            bottom = float(rawBottom - mRawPointerAxes.y.minValue) * mYScale + mYTranslate;
-            top = float(rawTop - mRawPointerAxes.y.minValue) * mYScale + mYTranslate;
-            break;
-        }
-
-        // Write output coords.
-        PointerCoords& out = mCurrentCookedState.cookedPointerData.pointerCoords[i];
+    // Coverage, mapped onto the surface the same way.
+    // TODO: Adjust coverage coords for device calibration?
+    const bool haveCoverage =
+            mCalibration.coverageCalibration == Calibration::COVERAGE_CALIBRATION_BOX;
+    float left[MAX_POINTERS], top[MAX_POINTERS], right[MAX_POINTERS], bottom[MAX_POINTERS];
+    if (haveCoverage) {
+        for (uint32_t i = 0; i < currentPointerCount; i++) {
+            const RawPointerData::Pointer& in = pointers[i];
+            const float rawLeft = (in.toolMinor & 0xffff0000) >> 16;
+            const float rawRight = in.toolMinor & 0x0000ffff;
+            const float rawBottom = in.toolMajor & 0x0000ffff;
+            const float rawTop = (in.toolMajor & 0xffff0000) >> 16;
+            // The corners of the box go wherever the transforms take them.
+            const float x1 = mSurfaceXTransform.apply(rawLeft, rawTop);
+            const float x2 = mSurfaceXTransform.apply(rawRight, rawBottom);
+            const float y1 = mSurfaceYTransform.apply(rawLeft, rawTop);
+            const float y2 = mSurfaceYTransform.apply(rawRight, rawBottom);
+            left[i] = mSurfaceXTransform.scale < 0 ? x2 : x1;
+            right[i] = mSurfaceXTransform.scale < 0 ? x1 : x2;
+            top[i] = mSurfaceYTransform.scale < 0 ? y2 : y1;
+            bottom[i] = mSurfaceYTransform.scale < 0 ? y1 : y2;
+        }
+    }
+
+    // Write output coords and properties.
+    CookedPointerData& cookedPointerData = mCurrentCookedState.cookedPointerData;
+    for (uint32_t i = 0; i < currentPointerCount; i++) {
+        PointerCoords& out = cookedPointerData.pointerCoords[i];
         out.clear();
-        out.setAxisValue(AMOTION_EVENT_AXIS_X, x);
-        out.setAxisValue(AMOTION_EVENT_AXIS_Y, y);
-        out.setAxisValue(AMOTION_EVENT_AXIS_PRESSURE, pressure);
-        out.setAxisValue(AMOTION_EVENT_AXIS_SIZE, size);
-        out.setAxisValue(AMOTION_EVENT_AXIS_TOUCH_MAJOR, touchMajor);
-        out.setAxisValue(AMOTION_EVENT_AXIS_TOUCH_MINOR, touchMinor);
-        out.setAxisValue(AMOTION_EVENT_AXIS_ORIENTATION, orientation);
-        out.setAxisValue(AMOTION_EVENT_AXIS_TILT, tilt);
-        out.setAxisValue(AMOTION_EVENT_AXIS_DISTANCE, distance);
-        if (mCalibration.coverageCalibration == Calibration::COVERAGE_CALIBRATION_BOX) {
-            out.setAxisValue(AMOTION_EVENT_AXIS_GENERIC_1, left);
-            out.setAxisValue(AMOTION_EVENT_AXIS_GENERIC_2, top);
-            out.setAxisValue(AMOTION_EVENT_AXIS_GENERIC_3, right);
-            out.setAxisValue(AMOTION_EVENT_AXIS_GENERIC_4, bottom);
+        out.setAxisValue(AMOTION_EVENT_AXIS_X, x[i]);
+        out.setAxisValue(AMOTION_EVENT_AXIS_Y, y[i]);
+        out.setAxisValue(AMOTION_EVENT_AXIS_PRESSURE, pressure[i]);
+        out.setAxisValue(AMOTION_EVENT_AXIS_SIZE, size[i]);
+        out.setAxisValue(AMOTION_EVENT_AXIS_TOUCH_MAJOR, touchMajor[i]);
+        out.setAxisValue(AMOTION_EVENT_AXIS_TOUCH_MINOR, touchMinor[i]);
+        out.setAxisValue(AMOTION_EVENT_AXIS_ORIENTATION, orientation[i]);
+        out.setAxisValue(AMOTION_EVENT_AXIS_TILT, tilt[i]);
+        out.setAxisValue(AMOTION_EVENT_AXIS_DISTANCE, distance[i]);
+        if (haveCoverage) {
+            out.setAxisValue(AMOTION_EVENT_AXIS_GENERIC_1, left[i]);
+            out.setAxisValue(AMOTION_EVENT_AXIS_GENERIC_2, top[i]);
+            out.setAxisValue(AMOTION_EVENT_AXIS_GENERIC_3, right[i]);
+            out.setAxisValue(AMOTION_EVENT_AXIS_GENERIC_4, bottom[i]);
         } else {
-            out.setAxisValue(AMOTION_EVENT_AXIS_TOOL_MAJOR, toolMajor);
-            out.setAxisValue(AMOTION_EVENT_AXIS_TOOL_MINOR, toolMinor);
+            out.setAxisValue(AMOTION_EVENT_AXIS_TOOL_MAJOR, toolMajor[i]);
+            out.setAxisValue(AMOTION_EVENT_AXIS_TOOL_MINOR, toolMinor[i]);
         }
 
-        // Write output properties.
-        PointerProperties& properties =
-                mCurrentCookedState.cookedPointerData.pointerProperties[i];
-        uint32_t id = in.id;
+        PointerProperties& properties = cookedPointerData.pointerProperties[i];
+        uint32_t id = pointers[i].id;
         properties.clear();
         properties.id = id;
-        properties.toolType = in.toolType;
+        properties.toolType = pointers[i].toolType;
 
         // Write id index.
-        mCurrentCookedState.cookedPointerData.idToIndex[id] = i;
+        cookedPointerData.idToIndex[id] = i;
     }
 }
 
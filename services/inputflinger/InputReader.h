@@ -38,6 +38,8 @@
 #include <stddef.h>
 #include <unistd.h>
 
+#include <vector>
+
 // Maximum supported size of a vibration pattern.
 // Must be at least 2.
 #define MAX_VIBRATE_PATTERN_SIZE 100
@@ -477,9 +479,11 @@ private:
 
     InputReaderConfiguration mConfig;
 
-    // The event queue.
-    static const int EVENT_BUFFER_SIZE = 256;
-    RawEvent mEventBuffer[EVENT_BUFFER_SIZE];
+    // The event queue.  It grows whenever a read fills it, so that a backlog of
+    // events takes fewer trips through the loop.
+    static const size_t MIN_EVENT_BUFFER_SIZE = 256;
+    static const size_t MAX_EVENT_BUFFER_SIZE = 2048;
+    std::vector<RawEvent> mEventBuffer;
 
     KeyedVector<int32_t, InputDevice*> mDevices;
 
@@ -1543,6 +1547,24 @@ private:
     float mYScale;
     float mYPrecision;
 
+    // The mapping from calibrated raw coordinates to surface coordinates for the current
+    // surface orientation, so that cookPointerData() can apply it to every pointer without
+    // switching on the orientation.  Each surface axis is (raw - origin) * scale + translate
+    // of one raw axis, with a negative scale when the two run in opposite directions.
+    struct SurfaceAxisTransform {
+        bool fromRawY;
+        float origin;
+        float scale;
+        float translate;
+
+        inline float apply(float rawX, float rawY) const {
+            return ((fromRawY ? rawY : rawX) - origin) * scale + translate;
+        }
+    };
+    SurfaceAxisTransform mSurfaceXTransform;
+    SurfaceAxisTransform mSurfaceYTransform;
+    double mSurfaceOrientationOffset; // added to the orientation of each pointer
+
     float mGeometricScale;
 
     float mPressureScale;
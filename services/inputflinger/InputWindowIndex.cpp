@@ -0,0 +1,240 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "InputWindowIndex.h"
+
+#include <algorithm>
+
+namespace android {
+
+namespace {
+
+// A closed span of a rectangle, so that degenerate and inverted frames, which
+// InputWindowInfo::overlaps() can still match, are indexed too.
+struct Span {
+    int32_t left, top, right, bottom;
+
+    Span(int32_t l, int32_t t, int32_t r, int32_t b)
+        : left(std::min(l, r)), top(std::min(t, b)),
+          right(std::max(l, r)), bottom(std::max(t, b)) {}
+};
+
+Span frameSpan(const InputWindowInfo* info) {
+    return Span(info->frameLeft, info->frameTop, info->frameRight, info->frameBottom);
+}
+
+bool isTouchable(const InputWindowInfo* info) {
+    return info->visible && !(info->layoutParamsFlags & InputWindowInfo::FLAG_NOT_TOUCHABLE);
+}
+
+bool isTouchModal(const InputWindowInfo* info) {
+    return (info->layoutParamsFlags & (InputWindowInfo::FLAG_NOT_FOCUSABLE
+            | InputWindowInfo::FLAG_NOT_TOUCH_MODAL)) == 0;
+}
+
+bool canObscure(const InputWindowInfo* info) {
+    return info->visible && !info->isTrustedOverlay();
+}
+
+} // namespace
+
+// --- InputWindowIndex::DisplayGrid ---
+
+bool InputWindowIndex::DisplayGrid::contains(int32_t x, int32_t y) const {
+    return x >= left && x <= right && y >= top && y <= bottom;
+}
+
+size_t InputWindowIndex::DisplayGrid::column(int32_t x) const {
+    const int64_t column = (int64_t(x) - left) / cellWidth;
+    return size_t(std::min(std::max(column, int64_t(0)), int64_t(GRID_SIZE - 1)));
+}
+
+size_t InputWindowIndex::DisplayGrid::row(int32_t y) const {
+    const int64_t row = (int64_t(y) - top) / cellHeight;
+    return size_t(std::min(std::max(row, int64_t(0)), int64_t(GRID_SIZE - 1)));
+}
+
+// --- InputWindowIndex ---
+
+void InputWindowIndex::clear() {
+    mWindowHandles.clear();
+    mPositions.clear();
+    mDisplays.clear();
+}
+
+void InputWindowIndex::setWindows(const Vector<sp<InputWindowHandle> >& windowHandles) {
+    clear();
+    mWindowHandles = windowHandles;
+
+    // First find out what each display's grid has to cover.
+    std::unordered_map<int32_t, Span> bounds;
+    for (size_t i = 0; i < mWindowHandles.size(); i++) {
+        const sp<InputWindowHandle>& windowHandle = mWindowHandles.itemAt(i);
+        mPositions.emplace(windowHandle.get(), uint32_t(i));
+
+        const InputWindowInfo* info = windowHandle->getInfo();
+        Span span = frameSpan(info);
+        if (!info->touchableRegion.isEmpty()) {
+            const Rect touchable = info->touchableRegion.getBounds();
+            span = Span(std::min(span.left, touchable.left), std::min(span.top, touchable.top),
+                    std::max(span.right, touchable.right),
+                    std::max(span.bottom, touchable.bottom));
+        }
+        auto it = bounds.find(info->displayId);
+        if (it == bounds.end()) {
+            bounds.emplace(info->displayId, span);
+        } else {
+            Span& b = it->second;
+            b = Span(std::min(b.left, span.left), std::min(b.top, span.top),
+                    std::max(b.right, span.right), std::max(b.bottom, span.bottom));
+        }
+    }
+    for (const auto& entry : bounds) {
+        DisplayGrid& grid = mDisplays[entry.first];
+        const Span& b = entry.second;
+        grid.left = b.left;
+        grid.top = b.top;
+        grid.right = b.right;
+        grid.bottom = b.bottom;
+        grid.cellWidth = (int64_t(b.right) - b.left) / GRID_SIZE + 1;
+        grid.cellHeight = (int64_t(b.bottom) - b.top) / GRID_SIZE + 1;
+    }
+
+    // Then add the windows front to back, which keeps every list sorted.
+    for (size_t i = 0; i < mWindowHandles.size(); i++) {
+        const InputWindowInfo* info = mWindowHandles.itemAt(i)->getInfo();
+        DisplayGrid& grid = mDisplays[info->displayId];
+        const uint32_t position = uint32_t(i);
+
+        if (info->visible && (info->layoutParamsFlags & InputWindowInfo::FLAG_WATCH_OUTSIDE_TOUCH)) {
+            grid.outsideTouchWatchers.push_back(position);
+        }
+        if (isTouchable(info)) {
+            if (isTouchModal(info)) {
+                grid.touchModalWindows.push_back(position);
+            } else if (!info->touchableRegion.isEmpty()) {
+                const Rect touchable = info->touchableRegion.getBounds();
+                const Span span(touchable.left, touchable.top, touchable.right, touchable.bottom);
+                for (size_t r = grid.row(span.top); r <= grid.row(span.bottom); r++) {
+                    for (size_t c = grid.column(span.left); c <= grid.column(span.right); c++) {
+                        grid.touchCells[r * GRID_SIZE + c].push_back(position);
+                    }
+                }
+            }
+        }
+        if (canObscure(info)) {
+            const Span span = frameSpan(info);
+            for (size_t r = grid.row(span.top); r <= grid.row(span.bottom); r++) {
+                for (size_t c = grid.column(span.left); c <= grid.column(span.right); c++) {
+                    grid.obscuringCells[r * GRID_SIZE + c].push_back(position);
+                }
+            }
+        }
+    }
+}
+
+uint32_t InputWindowIndex::positionOf(const sp<InputWindowHandle>& windowHandle) const {
+    auto it = mPositions.find(windowHandle.get());
+    return it != mPositions.end() ? it->second : uint32_t(mWindowHandles.size());
+}
+
+sp<InputWindowHandle> InputWindowIndex::findTouchedWindowAt(int32_t displayId,
+        int32_t x, int32_t y) const {
+    auto it = mDisplays.find(displayId);
+    if (it == mDisplays.end()) {
+        return NULL;
+    }
+    const DisplayGrid& grid = it->second;
+
+    uint32_t found = uint32_t(mWindowHandles.size());
+    if (!grid.touchModalWindows.empty()) {
+        found = grid.touchModalWindows.front();
+    }
+    if (grid.contains(x, y)) {
+        for (uint32_t position : grid.touchCells[grid.row(y) * GRID_SIZE + grid.column(x)]) {
+            if (position >= found) {
+                break;
+            }
+            if (mWindowHandles.itemAt(position)->getInfo()->touchableRegionContainsPoint(x, y)) {
+                found = position;
+                break;
+            }
+        }
+    }
+    return found < mWindowHandles.size() ? mWindowHandles.itemAt(found) : NULL;
+}
+
+void InputWindowIndex::getOutsideTouchWatchers(int32_t displayId,
+        const sp<InputWindowHandle>& windowHandle,
+        Vector<sp<InputWindowHandle> >* outWindowHandles) const {
+    auto it = mDisplays.find(displayId);
+    if (it == mDisplays.end()) {
+        return;
+    }
+    const uint32_t limit = windowHandle != NULL ? positionOf(windowHandle)
+            : uint32_t(mWindowHandles.size());
+    for (uint32_t position : it->second.outsideTouchWatchers) {
+        if (position >= limit) {
+            break;
+        }
+        outWindowHandles->push(mWindowHandles.itemAt(position));
+    }
+}
+
+bool InputWindowIndex::isWindowObscuredAtPoint(const sp<InputWindowHandle>& windowHandle,
+        int32_t x, int32_t y) const {
+    auto it = mDisplays.find(windowHandle->getInfo()->displayId);
+    if (it == mDisplays.end() || !it->second.contains(x, y)) {
+        return false;
+    }
+    const DisplayGrid& grid = it->second;
+    const uint32_t limit = positionOf(windowHandle);
+    for (uint32_t position : grid.obscuringCells[grid.row(y) * GRID_SIZE + grid.column(x)]) {
+        if (position >= limit) {
+            break;
+        }
+        if (mWindowHandles.itemAt(position)->getInfo()->frameContainsPoint(x, y)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool InputWindowIndex::isWindowObscured(const sp<InputWindowHandle>& windowHandle) const {
+    const InputWindowInfo* windowInfo = windowHandle->getInfo();
+    auto it = mDisplays.find(windowInfo->displayId);
+    if (it == mDisplays.end()) {
+        return false;
+    }
+    const DisplayGrid& grid = it->second;
+    const uint32_t limit = positionOf(windowHandle);
+    const Span span = frameSpan(windowInfo);
+    for (size_t r = grid.row(span.top); r <= grid.row(span.bottom); r++) {
+        for (size_t c = grid.column(span.left); c <= grid.column(span.right); c++) {
+            for (uint32_t position : grid.obscuringCells[r * GRID_SIZE + c]) {
+                if (position >= limit) {
+                    break;
+                }
+                if (mWindowHandles.itemAt(position)->getInfo()->overlaps(windowInfo)) {
+                    return true;
+                }
+            }
+        }
+    }
+    return false;
+}
+
+} // namespace android
@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _UI_INPUT_WINDOW_INDEX_H
+#define _UI_INPUT_WINDOW_INDEX_H
+
+#include <utils/RefBase.h>
+#include <utils/Vector.h>
+
+#include <unordered_map>
+#include <vector>
+
+#include "InputWindow.h"
+
+namespace android {
+
+/*
+ * Spatial index over the input windows, answering the dispatcher's hit
+ * tests without walking every window.
+ *
+ * Each display is covered by a grid whose cells list, front to back, the
+ * windows that can be touched in them and the windows that can obscure
+ * others in them. Every query returns exactly what a front to back walk of
+ * the windows would have.
+ *
+ * The index only looks at window info when it is built, so it has to be
+ * rebuilt whenever the windows or their info change.
+ */
+class InputWindowIndex {
+public:
+    // windowHandles are ordered front to back.
+    void setWindows(const Vector<sp<InputWindowHandle> >& windowHandles);
+    void clear();
+
+    // The front-most window on the display that takes a touch at (x, y):
+    // a visible, touchable window that is touch modal or whose touchable
+    // region contains the point.
+    sp<InputWindowHandle> findTouchedWindowAt(int32_t displayId, int32_t x, int32_t y) const;
+
+    // Visible windows watching for outside touches on the display, front to
+    // back, that are in front of windowHandle (all of them if it is NULL).
+    void getOutsideTouchWatchers(int32_t displayId, const sp<InputWindowHandle>& windowHandle,
+            Vector<sp<InputWindowHandle> >* outWindowHandles) const;
+
+    // Whether a visible, untrusted window in front of windowHandle covers
+    // (x, y), or overlaps its frame at all.
+    bool isWindowObscuredAtPoint(const sp<InputWindowHandle>& windowHandle,
+            int32_t x, int32_t y) const;
+    bool isWindowObscured(const sp<InputWindowHandle>& windowHandle) const;
+
+private:
+    enum { GRID_SIZE = 16 };
+
+    struct DisplayGrid {
+        int32_t left, top, right, bottom;   // inclusive bounds of everything indexed
+        int64_t cellWidth, cellHeight;
+        std::vector<uint32_t> touchCells[GRID_SIZE * GRID_SIZE];
+        std::vector<uint32_t> obscuringCells[GRID_SIZE * GRID_SIZE];
+        // touch modal windows take touches anywhere on the display
+        std::vector<uint32_t> touchModalWindows;
+        std::vector<uint32_t> outsideTouchWatchers;
+
+        bool contains(int32_t x, int32_t y) const;
+        size_t column(int32_t x) const;
+        size_t row(int32_t y) const;
+    };
+
+    // position of windowHandle from the front, or the number of windows if
+    // it isn't one of them
+    uint32_t positionOf(const sp<InputWindowHandle>& windowHandle) const;
+
+    Vector<sp<InputWindowHandle> > mWindowHandles;
+    std::unordered_map<const InputWindowHandle*, uint32_t> mPositions;
+    std::unordered_map<int32_t, DisplayGrid> mDisplays;
+};
+
+} // namespace android
+
+#endif // _UI_INPUT_WINDOW_INDEX_H
@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _INPUTFLINGER_TESTS_INPUT_DISPATCHER_FAKES_H
+#define _INPUTFLINGER_TESTS_INPUT_DISPATCHER_FAKES_H
+
+// Fakes of what InputDispatcher talks to, shared by its tests and the input
+// pipeline benchmark.
+
+#include "../InputDispatcher.h"
+
+namespace android {
+
+// --- FakeInputDispatcherPolicy ---
+
+class FakeInputDispatcherPolicy : public InputDispatcherPolicyInterface {
+    InputDispatcherConfiguration mConfig;
+
+protected:
+    virtual ~FakeInputDispatcherPolicy() {
+    }
+
+public:
+    FakeInputDispatcherPolicy() {
+    }
+
+private:
+    virtual void notifyConfigurationChanged(nsecs_t) {
+    }
+
+    virtual nsecs_t notifyANR(const sp<InputApplicationHandle>&,
+            const sp<InputWindowHandle>&,
+            const std::string&) {
+        return 0;
+    }
+
+    virtual void notifyInputChannelBroken(const sp<InputWindowHandle>&) {
+    }
+
+    virtual void getDispatcherConfiguration(InputDispatcherConfiguration* outConfig) {
+        *outConfig = mConfig;
+    }
+
+    virtual bool filterInputEvent(const InputEvent*, uint32_t) {
+        return true;
+    }
+
+    virtual void interceptKeyBeforeQueueing(const KeyEvent*, uint32_t&) {
+    }
+
+    virtual void interceptMotionBeforeQueueing(nsecs_t, uint32_t&) {
+    }
+
+    virtual nsecs_t interceptKeyBeforeDispatching(const sp<InputWindowHandle>&,
+            const KeyEvent*, uint32_t) {
+        return 0;
+    }
+
+    virtual bool dispatchUnhandledKey(const sp<InputWindowHandle>&,
+            const KeyEvent*, uint32_t, KeyEvent*) {
+        return false;
+    }
+
+    virtual void notifySwitch(nsecs_t, uint32_t, uint32_t, uint32_t) {
+    }
+
+    virtual void pokeUserActivity(nsecs_t, int32_t) {
+    }
+
+    virtual bool checkInjectEventsPermissionNonReentrant(int32_t, int32_t) {
+        return false;
+    }
+};
+
+
+// --- FakeWindowHandle ---
+
+class FakeWindowHandle : public InputWindowHandle {
+public:
+    FakeWindowHandle(int32_t displayId, const Rect& frame, int32_t flags)
+          : InputWindowHandle(NULL) {
+        mInfo = new InputWindowInfo();
+        mInfo->name = "fake";
+        mInfo->layoutParamsFlags = flags;
+        mInfo->layoutParamsType = InputWindowInfo::TYPE_APPLICATION;
+        mInfo->frameLeft = frame.left;
+        mInfo->frameTop = frame.top;
+        mInfo->frameRight = frame.right;
+        mInfo->frameBottom = frame.bottom;
+        if (frame.isValid()) {
+            mInfo->touchableRegion = Region(frame);
+        }
+        mInfo->visible = true;
+        mInfo->displayId = displayId;
+    }
+
+    virtual bool updateInfo() {
+        return true;
+    }
+
+    InputWindowInfo* editInfo() {
+        return mInfo;
+    }
+};
+
+} // namespace android
+
+#endif // _INPUTFLINGER_TESTS_INPUT_DISPATCHER_FAKES_H
@@ -14,7 +14,7 @@
  * limitations under the License.
  */
 
-#include "../InputDispatcher.h"
+#include "InputDispatcherFakes.h"
 
 #include <gtest/gtest.h>
 #include <linux/input.h>
@@ -35,68 +35,6 @@ static const int32_t INJECTOR_PID = 999;
 static const int32_t INJECTOR_UID = 1001;
 
 
-// --- FakeInputDispatcherPolicy ---
-
-class FakeInputDispatcherPolicy : public InputDispatcherPolicyInterface {
-    InputDispatcherConfiguration mConfig;
-
-protected:
-    virtual ~FakeInputDispatcherPolicy() {
-    }
-
-public:
-    FakeInputDispatcherPolicy() {
-    }
-
-private:
-    virtual void notifyConfigurationChanged(nsecs_t) {
-    }
-
-    virtual nsecs_t notifyANR(const sp<InputApplicationHandle>&,
-            const sp<InputWindowHandle>&,
-            const std::string&) {
-        return 0;
-    }
-
-    virtual void notifyInputChannelBroken(const sp<InputWindowHandle>&) {
-    }
-
-    virtual void getDispatcherConfiguration(InputDispatcherConfiguration* outConfig) {
-        *outConfig = mConfig;
-    }
-
-    virtual bool filterInputEvent(const InputEvent*, uint32_t) {
-        return true;
-    }
-
-    virtual void interceptKeyBeforeQueueing(const KeyEvent*, uint32_t&) {
-    }
-
-    virtual void interceptMotionBeforeQueueing(nsecs_t, uint32_t&) {
-    }
-
-    virtual nsecs_t interceptKeyBeforeDispatching(const sp<InputWindowHandle>&,
-            const KeyEvent*, uint32_t) {
-        return 0;
-    }
-
-    virtual bool dispatchUnhandledKey(const sp<InputWindowHandle>&,
-            const KeyEvent*, uint32_t, KeyEvent*) {
-        return false;
-    }
-
-    virtual void notifySwitch(nsecs_t, uint32_t, uint32_t, uint32_t) {
-    }
-
-    virtual void pokeUserActivity(nsecs_t, int32_t) {
-    }
-
-    virtual bool checkInjectEventsPermissionNonReentrant(int32_t, int32_t) {
-        return false;
-    }
-};
-
-
 // --- InputDispatcherTest ---
 
 class InputDispatcherTest : public testing::Test {
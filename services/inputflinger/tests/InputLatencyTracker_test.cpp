@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "../InputLatencyTracker.h"
+
+#include <gtest/gtest.h>
+
+namespace android {
+
+static const nsecs_t MS = 1000000LL;
+
+TEST(InputLatencyTrackerTest, SplitsSamplesIntoStages) {
+    InputLatencyTracker tracker;
+    EXPECT_EQ(-1, tracker.getPercentile("window", InputLatencyTracker::STAGE_TOTAL, 0.5f));
+
+    // 1ms to read, 2ms to dispatch, 10ms in the app
+    for (int i = 0; i < 100; i++) {
+        const nsecs_t eventTime = i * 100 * MS;
+        tracker.addSample("window", eventTime, eventTime + 1 * MS, eventTime + 3 * MS,
+                eventTime + 13 * MS);
+    }
+    ASSERT_EQ(100U, tracker.getSampleCount("window"));
+    EXPECT_EQ(0U, tracker.getSampleCount("other"));
+
+    EXPECT_EQ(1 * MS, tracker.getPercentile("window", InputLatencyTracker::STAGE_READ, 0.5f));
+    EXPECT_EQ(2 * MS,
+            tracker.getPercentile("window", InputLatencyTracker::STAGE_DISPATCH, 0.99f));
+    EXPECT_EQ(10 * MS, tracker.getPercentile("window", InputLatencyTracker::STAGE_APP, 0.5f));
+    EXPECT_EQ(13 * MS, tracker.getPercentile("window", InputLatencyTracker::STAGE_TOTAL, 1.0f));
+
+    tracker.reset();
+    EXPECT_EQ(0U, tracker.getSampleCount("window"));
+}
+
+TEST(InputLatencyTrackerTest, PercentilesBoundTheSlowSamples) {
+    InputLatencyTracker tracker;
+    for (int i = 0; i < 90; i++) {
+        tracker.addSample("window", 0, 0, 0, 1 * MS);
+    }
+    for (int i = 0; i < 10; i++) {
+        tracker.addSample("window", 0, 0, 0, 50 * MS);
+    }
+
+    EXPECT_LE(tracker.getPercentile("window", InputLatencyTracker::STAGE_APP, 0.5f), 2 * MS);
+    const nsecs_t p95 = tracker.getPercentile("window", InputLatencyTracker::STAGE_APP, 0.95f);
+    EXPECT_GE(p95, 50 * MS);
+    EXPECT_LE(p95, 64 * MS);
+}
+
+TEST(InputLatencyTrackerTest, ForgetsTheLeastRecentWindow) {
+    InputLatencyTracker tracker;
+    for (int i = 0; i < 32; i++) {
+        tracker.addSample(std::to_string(i), 0, 0, 0, i * MS);
+    }
+    tracker.addSample("new", 0, 0, 0, 100 * MS);
+
+    EXPECT_EQ(0U, tracker.getSampleCount("0"));
+    EXPECT_EQ(1U, tracker.getSampleCount("1"));
+    EXPECT_EQ(1U, tracker.getSampleCount("new"));
+
+    std::string dump;
+    tracker.dump(dump, "");
+    EXPECT_NE(std::string::npos, dump.find("'new': samples=1"));
+}
+
+} // namespace android
@@ -0,0 +1,260 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "InputDispatcherFakes.h"
+#include "InputReaderFakes.h"
+
+#include <benchmark/benchmark.h>
+#include <input/InputTransport.h>
+#include <linux/input.h>
+#include <poll.h>
+
+namespace android {
+
+// Synthetic multi-touch streams are fed to a FakeEventHub, and go through
+// InputReader, InputDispatcher running on its own thread as it does in
+// InputManager, and an InputPublisher to the InputConsumer of a window
+// covering the display. For each frame of touches, the time InputReader
+// takes to turn the raw events into motions and the time from there until
+// the consumer has read all of them are reported separately.
+
+static const int32_t DEVICE_ID = 1;
+static const int32_t DISPLAY_ID = 0;
+static const int32_t DISPLAY_WIDTH = 1080;
+static const int32_t DISPLAY_HEIGHT = 1920;
+
+// Frames in a gesture: all the fingers go down in the first one, move in the
+// ones in between and go up in the last one.
+static const int32_t GESTURE_FRAMES = 60;
+
+// How long the consumer waits for the dispatcher before giving up.
+static const int CONSUME_TIMEOUT_MILLIS = 1000;
+
+
+// --- PassToUserDispatcherPolicy ---
+
+// The fake policy drops everything, as no event is passed to the user.
+class PassToUserDispatcherPolicy : public FakeInputDispatcherPolicy {
+    virtual void interceptMotionBeforeQueueing(nsecs_t, uint32_t& policyFlags) {
+        policyFlags |= POLICY_FLAG_PASS_TO_USER;
+    }
+};
+
+
+// --- CountingInputListener ---
+
+// Forwards to the dispatcher, counting the motions InputReader produced.
+class CountingInputListener : public InputListenerInterface {
+    sp<InputListenerInterface> mListener;
+
+protected:
+    virtual ~CountingInputListener() { }
+
+public:
+    size_t motionCount;
+
+    explicit CountingInputListener(const sp<InputListenerInterface>& listener) :
+            mListener(listener), motionCount(0) {
+    }
+
+    virtual void notifyConfigurationChanged(const NotifyConfigurationChangedArgs* args) {
+        mListener->notifyConfigurationChanged(args);
+    }
+
+    virtual void notifyKey(const NotifyKeyArgs* args) {
+        mListener->notifyKey(args);
+    }
+
+    virtual void notifyMotion(const NotifyMotionArgs* args) {
+        motionCount++;
+        mListener->notifyMotion(args);
+    }
+
+    virtual void notifySwitch(const NotifySwitchArgs* args) {
+        mListener->notifySwitch(args);
+    }
+
+    virtual void notifyDeviceReset(const NotifyDeviceResetArgs* args) {
+        mListener->notifyDeviceReset(args);
+    }
+};
+
+
+// --- InputPipeline ---
+
+class InputPipeline {
+public:
+    sp<FakeEventHub> eventHub;
+    sp<FakeInputReaderPolicy> readerPolicy;
+    sp<PassToUserDispatcherPolicy> dispatcherPolicy;
+    sp<InputDispatcher> dispatcher;
+    sp<InputDispatcherThread> dispatcherThread;
+    sp<CountingInputListener> listener;
+    sp<InputReader> reader;
+    sp<FakeWindowHandle> window;
+    sp<InputChannel> serverChannel;
+    sp<InputChannel> clientChannel;
+    InputConsumer* consumer;
+    PreallocatedInputEventFactory eventFactory;
+    size_t consumedSamples;
+
+    InputPipeline() : consumer(NULL), consumedSamples(0) {
+        eventHub = new FakeEventHub();
+        readerPolicy = new FakeInputReaderPolicy();
+        readerPolicy->setDisplayViewport(DISPLAY_ID, DISPLAY_WIDTH, DISPLAY_HEIGHT,
+                DISPLAY_ORIENTATION_0, String8::empty());
+        dispatcherPolicy = new PassToUserDispatcherPolicy();
+        dispatcher = new InputDispatcher(dispatcherPolicy);
+        listener = new CountingInputListener(dispatcher);
+        reader = new InputReader(eventHub, readerPolicy, listener);
+
+        InputChannel::openInputChannelPair("benchmark", serverChannel, clientChannel);
+        consumer = new InputConsumer(clientChannel);
+        window = new FakeWindowHandle(DISPLAY_ID, Rect(0, 0, DISPLAY_WIDTH, DISPLAY_HEIGHT),
+                InputWindowInfo::FLAG_SPLIT_TOUCH);
+        window->editInfo()->inputChannel = serverChannel;
+        window->editInfo()->dispatchingTimeout = s2ns(5);
+        window->editInfo()->scaleFactor = 1.0f;
+        dispatcher->registerInputChannel(serverChannel, window, false);
+        Vector<sp<InputWindowHandle> > windows;
+        windows.push(window);
+        dispatcher->setInputWindows(windows);
+        dispatcher->setInputDispatchMode(true, false);
+
+        dispatcherThread = new InputDispatcherThread(dispatcher);
+        dispatcherThread->run("InputDispatcher", PRIORITY_URGENT_DISPLAY);
+
+        addTouchScreen();
+    }
+
+    ~InputPipeline() {
+        dispatcherThread->requestExit();
+        // wakes the dispatcher up, so that it notices
+        dispatcher->setInputDispatchMode(false, false);
+        dispatcherThread->requestExitAndWait();
+        dispatcher->unregisterInputChannel(serverChannel);
+        delete consumer;
+    }
+
+    // Queues the raw events of one frame of the gesture, and returns how many.
+    size_t enqueueFrame(nsecs_t when, int32_t frame, int32_t fingers) {
+        const int32_t gestureFrame = frame % GESTURE_FRAMES;
+        size_t count = 0;
+        for (int32_t i = 0; i < fingers; i++) {
+            eventHub->enqueueEvent(when, DEVICE_ID, EV_ABS, ABS_MT_SLOT, i);
+            count++;
+            if (gestureFrame == 0) {
+                eventHub->enqueueEvent(when, DEVICE_ID, EV_ABS, ABS_MT_TRACKING_ID, i);
+                count++;
+            } else if (gestureFrame == GESTURE_FRAMES - 1) {
+                eventHub->enqueueEvent(when, DEVICE_ID, EV_ABS, ABS_MT_TRACKING_ID, -1);
+                count++;
+                continue;
+            }
+            // the fingers spread along a diagonal, each at its own pace
+            const int32_t x = (DISPLAY_WIDTH / (fingers + 1) * (i + 1)
+                    + gestureFrame * (i + 2)) % DISPLAY_WIDTH;
+            const int32_t y = (DISPLAY_HEIGHT / (fingers + 1) * (i + 1)
+                    + gestureFrame * (i + 3)) % DISPLAY_HEIGHT;
+            eventHub->enqueueEvent(when, DEVICE_ID, EV_ABS, ABS_MT_POSITION_X, x);
+            eventHub->enqueueEvent(when, DEVICE_ID, EV_ABS, ABS_MT_POSITION_Y, y);
+            count += 2;
+        }
+        eventHub->enqueueEvent(when, DEVICE_ID, EV_SYN, SYN_REPORT, 0);
+        return count + 1;
+    }
+
+    // Consumes until all the motions InputReader produced have been read, and
+    // returns false if the dispatcher didn't deliver them in time.
+    bool consumeAll() {
+        while (consumedSamples < listener->motionCount) {
+            uint32_t seq;
+            InputEvent* event;
+            int32_t displayId;
+            status_t status = consumer->consume(&eventFactory, true /*consumeBatches*/, -1,
+                    &seq, &event, &displayId);
+            if (status == WOULD_BLOCK) {
+                struct pollfd pfd = { clientChannel->getFd(), POLLIN, 0 };
+                if (poll(&pfd, 1, CONSUME_TIMEOUT_MILLIS) <= 0) {
+                    return false;
+                }
+                continue;
+            }
+            if (status != OK) {
+                return false;
+            }
+            if (event->getType() == AINPUT_EVENT_TYPE_MOTION) {
+                consumedSamples += static_cast<MotionEvent*>(event)->getHistorySize() + 1;
+            }
+            consumer->sendFinishedSignal(seq, true);
+        }
+        return true;
+    }
+
+private:
+    void addTouchScreen() {
+        eventHub->addDevice(DEVICE_ID, String8("touchscreen"),
+                INPUT_DEVICE_CLASS_TOUCH | INPUT_DEVICE_CLASS_TOUCH_MT);
+        eventHub->addConfigurationProperty(DEVICE_ID, String8("touch.deviceType"),
+                String8("touchScreen"));
+        eventHub->addAbsoluteAxis(DEVICE_ID, ABS_MT_POSITION_X, 0, DISPLAY_WIDTH - 1, 0, 0);
+        eventHub->addAbsoluteAxis(DEVICE_ID, ABS_MT_POSITION_Y, 0, DISPLAY_HEIGHT - 1, 0, 0);
+        eventHub->addAbsoluteAxis(DEVICE_ID, ABS_MT_TRACKING_ID, 0, 255, 0, 0);
+        eventHub->addAbsoluteAxis(DEVICE_ID, ABS_MT_SLOT, 0, 15, 0, 0);
+        eventHub->setAbsoluteAxisValue(DEVICE_ID, ABS_MT_SLOT, 0);
+        eventHub->finishDeviceScan();
+        reader->loopOnce();
+        reader->loopOnce();
+    }
+};
+
+
+// --- Benchmarks ---
+
+// Each iteration is one frame of a multi-touch gesture with range(0) fingers.
+static void BM_MultiTouchPipeline(benchmark::State& state) {
+    const int32_t fingers = state.range(0);
+    InputPipeline pipeline;
+    nsecs_t readerTime = 0;
+    nsecs_t deliveryTime = 0;
+    int32_t frame = 0;
+
+    for (auto _ : state) {
+        const nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+        const size_t rawEvents = pipeline.enqueueFrame(start, frame++, fingers);
+        for (size_t i = 0; i < rawEvents; i++) {
+            pipeline.reader->loopOnce();
+        }
+        const nsecs_t read = systemTime(SYSTEM_TIME_MONOTONIC);
+        if (!pipeline.consumeAll()) {
+            state.SkipWithError("The dispatcher did not deliver the motions");
+            break;
+        }
+        const nsecs_t consumed = systemTime(SYSTEM_TIME_MONOTONIC);
+        readerTime += read - start;
+        deliveryTime += consumed - read;
+    }
+
+    const double frames = frame > 0 ? frame : 1;
+    state.counters["reader_us"] = benchmark::Counter(readerTime / frames / 1000.0);
+    state.counters["delivery_us"] = benchmark::Counter(deliveryTime / frames / 1000.0);
+    state.SetItemsProcessed(pipeline.consumedSamples);
+}
+BENCHMARK(BM_MultiTouchPipeline)->Arg(1)->Arg(2)->Arg(5)->Arg(10);
+
+} // namespace android
+
+BENCHMARK_MAIN();
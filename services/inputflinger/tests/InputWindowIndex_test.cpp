@@ -0,0 +1,162 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "../InputWindowIndex.h"
+#include "InputDispatcherFakes.h"
+
+#include <gtest/gtest.h>
+#include <stdlib.h>
+
+namespace android {
+
+// --- InputWindowIndexTest ---
+
+// The front to back walks InputDispatcher used to do.
+class InputWindowIndexTest : public testing::Test {
+protected:
+    Vector<sp<InputWindowHandle> > mWindows;
+    InputWindowIndex mIndex;
+
+    sp<FakeWindowHandle> addWindow(int32_t displayId, const Rect& frame, int32_t flags) {
+        sp<FakeWindowHandle> window = new FakeWindowHandle(displayId, frame, flags);
+        mWindows.push(window);
+        return window;
+    }
+
+    sp<InputWindowHandle> touchedWindowAt(int32_t displayId, int32_t x, int32_t y) const {
+        for (size_t i = 0; i < mWindows.size(); i++) {
+            const InputWindowInfo* info = mWindows[i]->getInfo();
+            const int32_t flags = info->layoutParamsFlags;
+            if (info->displayId == displayId && info->visible
+                    && !(flags & InputWindowInfo::FLAG_NOT_TOUCHABLE)) {
+                bool isTouchModal = (flags & (InputWindowInfo::FLAG_NOT_FOCUSABLE
+                        | InputWindowInfo::FLAG_NOT_TOUCH_MODAL)) == 0;
+                if (isTouchModal || info->touchableRegionContainsPoint(x, y)) {
+                    return mWindows[i];
+                }
+            }
+        }
+        return NULL;
+    }
+
+    bool obscuredAtPoint(const sp<InputWindowHandle>& window, int32_t x, int32_t y) const {
+        for (size_t i = 0; i < mWindows.size() && mWindows[i] != window; i++) {
+            const InputWindowInfo* info = mWindows[i]->getInfo();
+            if (info->displayId == window->getInfo()->displayId && info->visible
+                    && !info->isTrustedOverlay() && info->frameContainsPoint(x, y)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool obscured(const sp<InputWindowHandle>& window) const {
+        for (size_t i = 0; i < mWindows.size() && mWindows[i] != window; i++) {
+            const InputWindowInfo* info = mWindows[i]->getInfo();
+            if (info->displayId == window->getInfo()->displayId && info->visible
+                    && !info->isTrustedOverlay() && info->overlaps(window->getInfo())) {
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+TEST_F(InputWindowIndexTest, FindsFrontMostTouchableWindow) {
+    const int32_t notModal = InputWindowInfo::FLAG_NOT_TOUCH_MODAL;
+    sp<FakeWindowHandle> top = addWindow(0, Rect(100, 100, 200, 200), notModal);
+    sp<FakeWindowHandle> untouchable = addWindow(0, Rect(0, 0, 1000, 1000),
+            notModal | InputWindowInfo::FLAG_NOT_TOUCHABLE);
+    sp<FakeWindowHandle> bottom = addWindow(0, Rect(0, 0, 1000, 1000), notModal);
+    sp<FakeWindowHandle> otherDisplay = addWindow(1, Rect(0, 0, 1000, 1000), notModal);
+    mIndex.setWindows(mWindows);
+
+    EXPECT_EQ(top, mIndex.findTouchedWindowAt(0, 150, 150));
+    EXPECT_EQ(bottom, mIndex.findTouchedWindowAt(0, 50, 50));
+    EXPECT_EQ(otherDisplay, mIndex.findTouchedWindowAt(1, 150, 150));
+    EXPECT_EQ(NULL, mIndex.findTouchedWindowAt(0, 2000, 2000).get());
+    EXPECT_EQ(NULL, mIndex.findTouchedWindowAt(2, 150, 150).get());
+
+    EXPECT_TRUE(mIndex.isWindowObscuredAtPoint(bottom, 150, 150));
+    EXPECT_TRUE(mIndex.isWindowObscured(bottom));
+    EXPECT_FALSE(mIndex.isWindowObscured(top));
+    EXPECT_FALSE(mIndex.isWindowObscured(otherDisplay));
+}
+
+TEST_F(InputWindowIndexTest, TouchModalWindowsTakeEveryTouch) {
+    addWindow(0, Rect(100, 100, 200, 200), InputWindowInfo::FLAG_NOT_TOUCH_MODAL);
+    sp<FakeWindowHandle> modal = addWindow(0, Rect(300, 300, 400, 400), 0);
+    mIndex.setWindows(mWindows);
+
+    EXPECT_EQ(modal, mIndex.findTouchedWindowAt(0, 50, 50));
+    EXPECT_EQ(modal, mIndex.findTouchedWindowAt(0, -5000, 5000));
+    EXPECT_NE(modal, mIndex.findTouchedWindowAt(0, 150, 150));
+}
+
+TEST_F(InputWindowIndexTest, ReportsOutsideTouchWatchersInFront) {
+    const int32_t watcherFlags = InputWindowInfo::FLAG_NOT_TOUCH_MODAL
+            | InputWindowInfo::FLAG_WATCH_OUTSIDE_TOUCH;
+    sp<FakeWindowHandle> front = addWindow(0, Rect(0, 0, 10, 10), watcherFlags);
+    sp<FakeWindowHandle> touched = addWindow(0, Rect(0, 0, 1000, 1000),
+            InputWindowInfo::FLAG_NOT_TOUCH_MODAL);
+    addWindow(0, Rect(0, 0, 10, 10), watcherFlags);
+    mIndex.setWindows(mWindows);
+
+    Vector<sp<InputWindowHandle> > watchers;
+    mIndex.getOutsideTouchWatchers(0, touched, &watchers);
+    ASSERT_EQ(1U, watchers.size());
+    EXPECT_EQ(front, watchers[0]);
+
+    watchers.clear();
+    mIndex.getOutsideTouchWatchers(0, NULL, &watchers);
+    EXPECT_EQ(2U, watchers.size());
+}
+
+TEST_F(InputWindowIndexTest, MatchesLinearSearch) {
+    srand(1);
+    for (int windows = 0; windows < 60; windows++) {
+        const int32_t left = rand() % 1400 - 200;
+        const int32_t top = rand() % 2400 - 200;
+        // some frames are empty or inverted on purpose
+        const Rect frame(left, top, left + rand() % 800 - 20, top + rand() % 800 - 20);
+        int32_t flags = 0;
+        if (rand() % 8) flags |= InputWindowInfo::FLAG_NOT_TOUCH_MODAL;
+        if (rand() % 6 == 0) flags |= InputWindowInfo::FLAG_NOT_TOUCHABLE;
+        sp<FakeWindowHandle> window = addWindow(rand() % 2, frame, flags);
+        InputWindowInfo* info = window->editInfo();
+        info->visible = rand() % 5 != 0;
+        if (rand() % 5 == 0) info->layoutParamsType = InputWindowInfo::TYPE_STATUS_BAR;
+        if (rand() % 3 == 0) {
+            info->touchableRegion = Region(Rect(left, top, left + 50, top + 50));
+            info->touchableRegion.orSelf(Rect(left + 100, top + 100, left + 300, top + 120));
+        }
+    }
+    mIndex.setWindows(mWindows);
+
+    for (int i = 0; i < 2000; i++) {
+        const int32_t displayId = rand() % 2;
+        const int32_t x = rand() % 1800 - 300;
+        const int32_t y = rand() % 2800 - 300;
+        EXPECT_EQ(touchedWindowAt(displayId, x, y), mIndex.findTouchedWindowAt(displayId, x, y));
+        const sp<InputWindowHandle>& window = mWindows[rand() % mWindows.size()];
+        EXPECT_EQ(obscuredAtPoint(window, x, y), mIndex.isWindowObscuredAtPoint(window, x, y));
+    }
+    for (size_t i = 0; i < mWindows.size(); i++) {
+        EXPECT_EQ(obscured(mWindows[i]), mIndex.isWindowObscured(mWindows[i])) << "window " << i;
+    }
+}
+
+} // namespace android
@@ -36,19 +36,32 @@ bool SchedulingPolicyService::isAllowed() {
 }
 
 Return<bool> SchedulingPolicyService::requestPriority(int32_t pid, int32_t tid, int32_t priority) {
+    return requestPriorities(pid, hidl_vec<int32_t>{tid}, priority) == 1;
+}
+
+size_t SchedulingPolicyService::requestPriorities(int32_t pid, const hidl_vec<int32_t>& tids,
+        int32_t priority) {
     if (priority < static_cast<int32_t>(Priority::MIN) ||
             priority > static_cast<int32_t>(Priority::MAX)) {
-        return false;
+        return 0;
     }
 
     if (!isAllowed()) {
-        return false;
+        return 0;
     }
 
-    // TODO(b/37226359): decouple from and remove AIDL service
-    // this should always be allowed since we are in system_server.
-    int value = ::android::requestPriority(pid, tid, priority, false /* isForApp */);
-    return value == 0 /* success */;
+    size_t granted = 0;
+    for (int32_t tid : tids) {
+        // TODO(b/37226359): decouple from and remove AIDL service
+        // this should always be allowed since we are in system_server.
+        int value = ::android::requestPriority(pid, tid, priority, false /* isForApp */);
+        if (value != 0 /* success */) {
+            ALOGW("requestPriority(%d, %d, %d) failed: %d", pid, tid, priority, value);
+            break;
+        }
+        granted++;
+    }
+    return granted;
 }
 
 Return<int32_t> SchedulingPolicyService::getMaxAllowedPriority() {
@@ -39,6 +39,11 @@ using ::android::sp;
 struct SchedulingPolicyService : public ISchedulingPolicyService {
     Return<bool> requestPriority(int32_t pid, int32_t tid, int32_t priority) override;
     Return<int32_t> getMaxAllowedPriority() override;
+
+    // Like requestPriority() for each of tids, checking the priority and the
+    // caller once for the whole batch. Returns how many of the threads were
+    // granted the priority, stopping at the first failure.
+    size_t requestPriorities(int32_t pid, const hidl_vec<int32_t>& tids, int32_t priority);
 private:
     bool isAllowed();
 };
@@ -25,15 +25,20 @@
 #include <binder/BinderService.h>
 #include <binder/Parcel.h>
 
+#include <chrono>
+#include <thread>
+#include <vector>
+
 #include "BatteryService.h"
 
 namespace android {
 // ---------------------------------------------------------------------------
 
-BatteryService::BatteryService() : mBatteryStatService(nullptr) {
+BatteryService::BatteryService() : mBatteryStatService(nullptr), mFlushPending(false) {
+    std::thread(&BatteryService::flushLoop, this).detach();
 }
 
-bool BatteryService::addSensor(uid_t uid, int handle) {
+void BatteryService::addSensor(uid_t uid, int handle) {
     Mutex::Autolock _l(mActivationsLock);
     Info key(uid, handle);
     ssize_t index = mActivations.indexOf(key);
@@ -42,52 +47,98 @@ bool BatteryService::addSensor(uid_t uid, int handle) {
     }
     Info& info(mActivations.editItemAt(index));
     info.count++;
-    return info.count == 1;
+    if (info.count == 1) {
+        scheduleFlushLocked();
+    }
 }
 
-bool BatteryService::removeSensor(uid_t uid, int handle) {
+void BatteryService::removeSensor(uid_t uid, int handle) {
     Mutex::Autolock _l(mActivationsLock);
     ssize_t index = mActivations.indexOf(Info(uid, handle));
-    if (index < 0) return false;
+    if (index < 0) return;
     Info& info(mActivations.editItemAt(index));
+    // cleanup() may have stopped it already
+    if (info.count == 0) return;
     info.count--;
-    return info.count == 0;
+    if (info.count == 0) {
+        scheduleFlushLocked();
+    }
 }
 
+void BatteryService::scheduleFlushLocked() {
+    if (!mFlushPending) {
+        mFlushPending = true;
+        mFlushCondition.signal();
+    }
+}
 
-void BatteryService::enableSensorImpl(uid_t uid, int handle) {
-    if (checkService()) {
-        if (addSensor(uid, handle)) {
-            int64_t identity = IPCThreadState::self()->clearCallingIdentity();
-            mBatteryStatService->noteStartSensor(uid, handle);
-            IPCThreadState::self()->restoreCallingIdentity(identity);
+void BatteryService::flushLoop() {
+    struct Note {
+        uid_t uid;
+        int handle;
+        bool start;
+    };
+    std::vector<Note> notes;
+    for (;;) {
+        {
+            Mutex::Autolock _l(mActivationsLock);
+            while (!mFlushPending) {
+                mFlushCondition.wait(mActivationsLock);
+            }
+        }
+        std::this_thread::sleep_for(std::chrono::nanoseconds(nsecs_t(FLUSH_DELAY)));
+        if (!checkService()) {
+            // nothing is reported until batterystats shows up
+            Mutex::Autolock _l(mActivationsLock);
+            mFlushPending = false;
+            continue;
+        }
+
+        {
+            Mutex::Autolock _l(mActivationsLock);
+            mFlushPending = false;
+            for (size_t i=0 ; i<mActivations.size() ; ) {
+                Info& info(mActivations.editItemAt(i));
+                const bool active = info.count > 0;
+                if (active != info.reported) {
+                    notes.push_back({info.uid, info.handle, active});
+                    info.reported = active;
+                }
+                if (info.count <= 0 && !info.reported) {
+                    mActivations.removeAt(i);
+                } else {
+                    i++;
+                }
+            }
+        }
+
+        for (const Note& note : notes) {
+            if (note.start) {
+                mBatteryStatService->noteStartSensor(note.uid, note.handle);
+            } else {
+                mBatteryStatService->noteStopSensor(note.uid, note.handle);
+            }
         }
+        notes.clear();
     }
 }
+
+void BatteryService::enableSensorImpl(uid_t uid, int handle) {
+    addSensor(uid, handle);
+}
+
 void BatteryService::disableSensorImpl(uid_t uid, int handle) {
-    if (checkService()) {
-        if (removeSensor(uid, handle)) {
-            int64_t identity = IPCThreadState::self()->clearCallingIdentity();
-            mBatteryStatService->noteStopSensor(uid, handle);
-            IPCThreadState::self()->restoreCallingIdentity(identity);
-        }
-    }
+    removeSensor(uid, handle);
 }
 
 void BatteryService::cleanupImpl(uid_t uid) {
-    if (checkService()) {
-        Mutex::Autolock _l(mActivationsLock);
-        int64_t identity = IPCThreadState::self()->clearCallingIdentity();
-        for (size_t i=0 ; i<mActivations.size() ; ) {
-            const Info& info(mActivations[i]);
-            if (info.uid == uid) {
-                mBatteryStatService->noteStopSensor(info.uid, info.handle);
-                mActivations.removeAt(i);
-            } else {
-              i++;
-            }
+    Mutex::Autolock _l(mActivationsLock);
+    for (size_t i=0 ; i<mActivations.size() ; i++) {
+        Info& info(mActivations.editItemAt(i));
+        if (info.uid == uid && info.count > 0) {
+            info.count = 0;
+            scheduleFlushLocked();
         }
-        IPCThreadState::self()->restoreCallingIdentity(identity);
     }
 }
 
@@ -18,7 +18,9 @@
 #include <sys/types.h>
 
 #include <binder/IBatteryStats.h>
+#include <utils/Condition.h>
 #include <utils/Singleton.h>
+#include <utils/Timers.h>
 
 namespace android {
 // ---------------------------------------------------------------------------
@@ -38,17 +40,29 @@ class BatteryService : public Singleton<BatteryService> {
         uid_t uid;
         int handle;
         int32_t count;
-        Info()  : uid(0), handle(0), count(0) { }
-        Info(uid_t uid, int handle) : uid(uid), handle(handle), count(0) { }
+        // whether batterystats was last told the sensor started
+        bool reported;
+        Info()  : uid(0), handle(0), count(0), reported(false) { }
+        Info(uid_t uid, int handle) : uid(uid), handle(handle), count(0), reported(false) { }
         bool operator < (const Info& rhs) const {
             return (uid == rhs.uid) ? (handle < rhs.handle) :  (uid < rhs.uid);
         }
     };
 
+    // The batterystats calls are made on a thread of their own, a little
+    // after the activations change, so enabling and disabling a sensor never
+    // waits on system_server and a sensor that is enabled and disabled again
+    // in between isn't reported at all.
+    static constexpr nsecs_t FLUSH_DELAY = ms2ns(50);
+
     Mutex mActivationsLock;
+    Condition mFlushCondition;
+    bool mFlushPending;
     SortedVector<Info> mActivations;
-    bool addSensor(uid_t uid, int handle);
-    bool removeSensor(uid_t uid, int handle);
+    void addSensor(uid_t uid, int handle);
+    void removeSensor(uid_t uid, int handle);
+    void scheduleFlushLocked();
+    void flushLoop();
     bool checkService();
 
 public:
@@ -128,6 +128,31 @@ static mat<TYPE, R, R> scaleCovariance(
     return APAt;
 }
 
+/*
+ * Phi*P*transpose(Phi), for the Phi of predict():
+ *
+ *  Phi = | Phi00 Phi10 |    P = | P00  P10 |
+ *        |   0    I33  |        | P10t P11 |
+ *
+ *  P00 = Phi00*P00*Phi00t + Phi00*P10*Phi10t + (Phi00*P10*Phi10t)t + Phi10*P11*Phi10t
+ *  P10 = Phi00*P10 + Phi10*P11
+ *  P11 = P11
+ *
+ * which takes 6 products of 3x3 matrices, where the generic product of the 6x6 matrices takes 16.
+ */
+static void propagateCovariance(const mat<mat33_t, 2, 2>& Phi, mat<mat33_t, 2, 2>* P) {
+    const mat33_t& Phi00(Phi[0][0]);
+    const mat33_t& Phi10(Phi[1][0]);
+    const mat33_t Phi00P10(Phi00*(*P)[1][0]);
+    const mat33_t Phi10P11(Phi10*(*P)[1][1]);
+    const mat33_t cross(Phi00P10*transpose(Phi10));
+
+    (*P)[0][0] = Phi00*(*P)[0][0]*transpose(Phi00) + cross + transpose(cross) +
+            Phi10P11*transpose(Phi10);
+    (*P)[1][0] = Phi00P10 + Phi10P11;
+    (*P)[0][1] = transpose((*P)[1][0]);
+}
+
 template <typename TYPE, typename OTHER_TYPE>
 static mat<TYPE, 3, 3> crossMatrix(const vec<TYPE, 3>& p, OTHER_TYPE diag) {
     mat<TYPE, 3, 3> r;
@@ -491,7 +516,8 @@ void Fusion::predict(const vec3_t& w, float dT) {
     if (x0.w < 0)
         x0 = -x0;
 
-    P = Phi*P*transpose(Phi) + GQGt;
+    propagateCovariance(Phi, &P);
+    P += GQGt;
 
     checkState();
 }
@@ -20,52 +20,262 @@
 #include <utils/Timers.h>
 
 #include <inttypes.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+#include <cmath>
 
 namespace android {
 namespace SensorServiceUtil {
 
 namespace {
-    constexpr size_t LOG_SIZE = 10;
-    constexpr size_t LOG_SIZE_LARGE = 50;  // larger samples for debugging
+    // in blocks of BLOCK_BYTES
+    constexpr size_t LOG_SIZE = 8;
+    constexpr size_t LOG_SIZE_LARGE = 32;  // larger samples for debugging
+
+    constexpr double VALUE_SCALE = 1000;
+    constexpr double MAX_QUANTIZED_VALUE = 9e18;
+
+    size_t putVarint(uint64_t value, uint8_t* out) {
+        size_t n = 0;
+        while (value >= 0x80) {
+            out[n++] = static_cast<uint8_t>(value | 0x80);
+            value >>= 7;
+        }
+        out[n++] = static_cast<uint8_t>(value);
+        return n;
+    }
+
+    // Returns false if the varint runs past end.
+    bool getVarint(const uint8_t** in, const uint8_t* end, uint64_t* value) {
+        uint64_t result = 0;
+        for (int shift = 0; *in < end && shift < 64; shift += 7) {
+            const uint8_t byte = *(*in)++;
+            result |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) {
+                *value = result;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Deltas are taken modulo 2^64, so that they can't overflow, and zigzagged so that small
+    // negative ones stay short.
+    uint64_t zigzag(int64_t to, int64_t from) {
+        const uint64_t delta = static_cast<uint64_t>(to) - static_cast<uint64_t>(from);
+        return (delta << 1) ^ (static_cast<int64_t>(delta) < 0 ? ~uint64_t(0) : 0);
+    }
+
+    int64_t unzigzag(uint64_t value, int64_t from) {
+        const uint64_t delta = (value >> 1) ^ (~(value & 1) + 1);
+        return static_cast<int64_t>(static_cast<uint64_t>(from) + delta);
+    }
+
+    int64_t wallTimeNs() {
+        timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+        return static_cast<int64_t>(now.tv_sec) * 1000000000LL + now.tv_nsec;
+    }
 }// unnamed namespace
 
+constexpr size_t RecentEventLogger::BLOCK_BYTES;
+constexpr size_t RecentEventLogger::MAX_VALUES;
+constexpr size_t RecentEventLogger::EVENT_WORDS;
+constexpr size_t RecentEventLogger::MAX_RECORD_BYTES;
+
 RecentEventLogger::RecentEventLogger(int sensorType) :
-        mSensorType(sensorType), mEventSize(eventSizeBySensorType(mSensorType)),
-        mRecentEvents(logSizeBySensorType(sensorType)), mMaskData(false) {
-    // blank
+        mSensorType(sensorType),
+        mEventSize(std::min(eventSizeBySensorType(mSensorType), MAX_VALUES)),
+        mNumBlocks(logSizeBySensorType(sensorType)), mBlocks(new Block[mNumBlocks]),
+        mLastEventSequence(0), mGeneration(0), mUsedBytes(0), mLastTimestamp(0),
+        mMaskData(false) {
+    for (size_t i = 0; i < mNumBlocks; ++i) {
+        mBlocks[i].mSequence.store(0, std::memory_order_relaxed);
+        mBlocks[i].mGeneration.store(0, std::memory_order_relaxed);
+        mBlocks[i].mUsedBytes.store(0, std::memory_order_relaxed);
+    }
 }
 
 void RecentEventLogger::addEvent(const sensors_event_t& event) {
-    std::lock_guard<std::mutex> lk(mLock);
-    mRecentEvents.emplace(event);
+    uint32_t words[EVENT_WORDS];
+    memcpy(words, &event, sizeof(words));
+    const uint32_t sequence = mLastEventSequence.load(std::memory_order_relaxed);
+    mLastEventSequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (size_t i = 0; i < EVENT_WORDS; ++i) {
+        mLastEvent[i].store(words[i], std::memory_order_relaxed);
+    }
+    mLastEventSequence.store(sequence + 2, std::memory_order_release);
+
+    int64_t values[MAX_VALUES];
+    quantize(event, values);
+    uint8_t record[MAX_RECORD_BYTES];
+    size_t size = mGeneration == 0 ? 0 : encode(values, event.timestamp, false, record);
+    if (mGeneration == 0 || mUsedBytes + size > BLOCK_BYTES) {
+        startBlock();
+        size = encode(values, event.timestamp, true, record);
+    }
+
+    Block& block = mBlocks[(mGeneration - 1) % mNumBlocks];
+    const size_t firstWord = mUsedBytes / sizeof(uint32_t);
+    memcpy(mBytes + mUsedBytes, record, size);
+    mUsedBytes += size;
+    const size_t endWord = (mUsedBytes + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+
+    const uint32_t blockSequence = block.mSequence.load(std::memory_order_relaxed);
+    block.mSequence.store(blockSequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (size_t i = firstWord; i < endWord; ++i) {
+        uint32_t word;
+        memcpy(&word, mBytes + i * sizeof(uint32_t), sizeof(word));
+        block.mWords[i].store(word, std::memory_order_relaxed);
+    }
+    block.mGeneration.store(mGeneration, std::memory_order_relaxed);
+    block.mUsedBytes.store(mUsedBytes, std::memory_order_relaxed);
+    block.mSequence.store(blockSequence + 2, std::memory_order_release);
+
+    mLastTimestamp = event.timestamp;
+    memcpy(mLastValues, values, sizeof(mLastValues));
+}
+
+void RecentEventLogger::quantize(const sensors_event_t& event, int64_t* values) const {
+    memset(values, 0, MAX_VALUES * sizeof(*values));
+    if (mSensorType == SENSOR_TYPE_STEP_COUNTER) {
+        values[0] = static_cast<int64_t>(event.u64.step_counter);
+        return;
+    }
+    for (size_t k = 0; k < mEventSize; ++k) {
+        double value = std::round(event.data[k] * VALUE_SCALE);
+        if (std::isnan(value)) {
+            value = 0;
+        }
+        value = std::min(std::max(value, -MAX_QUANTIZED_VALUE), MAX_QUANTIZED_VALUE);
+        values[k] = static_cast<int64_t>(value);
+    }
+}
+
+size_t RecentEventLogger::encode(const int64_t* values, int64_t timestamp, bool first,
+        uint8_t* out) const {
+    size_t n = 0;
+    if (first) {
+        n += putVarint(zigzag(timestamp, 0), out + n);
+        n += putVarint(static_cast<uint64_t>(wallTimeNs()), out + n);
+    } else {
+        n += putVarint(zigzag(timestamp, mLastTimestamp), out + n);
+    }
+    for (size_t k = 0; k < mEventSize; ++k) {
+        n += putVarint(zigzag(values[k], first ? 0 : mLastValues[k]), out + n);
+    }
+    return n;
+}
+
+void RecentEventLogger::startBlock() {
+    ++mGeneration;
+    if (mGeneration == 0) {
+        // Wrapped around after 2^32 blocks; 0 means never written.
+        mGeneration = 1;
+    }
+    mUsedBytes = 0;
+}
+
+bool RecentEventLogger::readBlock(const Block& block, uint32_t* generation, uint8_t* bytes,
+        size_t* used) const {
+    // The writer only holds a block for a few stores; give up on it if it keeps moving.
+    for (int attempt = 0; attempt < 16; ++attempt) {
+        const uint32_t sequence = block.mSequence.load(std::memory_order_acquire);
+        if (sequence & 1) {
+            continue;
+        }
+        *generation = block.mGeneration.load(std::memory_order_relaxed);
+        *used = std::min<size_t>(block.mUsedBytes.load(std::memory_order_relaxed), BLOCK_BYTES);
+        const size_t words = (*used + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+        for (size_t i = 0; i < words; ++i) {
+            const uint32_t word = block.mWords[i].load(std::memory_order_relaxed);
+            memcpy(bytes + i * sizeof(uint32_t), &word, sizeof(word));
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (block.mSequence.load(std::memory_order_relaxed) == sequence) {
+            return *generation != 0;
+        }
+    }
+    return false;
+}
+
+void RecentEventLogger::decodeBlock(const uint8_t* bytes, size_t used,
+        std::vector<DecodedEvent>* events) const {
+    const uint8_t* in = bytes;
+    const uint8_t* end = bytes + used;
+    DecodedEvent event = {};
+    int64_t firstTimestamp = 0;
+    int64_t firstWallTime = 0;
+    bool first = true;
+    while (in < end) {
+        uint64_t value;
+        if (!getVarint(&in, end, &value)) {
+            return;
+        }
+        event.mTimestamp = unzigzag(value, first ? 0 : event.mTimestamp);
+        if (first) {
+            if (!getVarint(&in, end, &value)) {
+                return;
+            }
+            firstTimestamp = event.mTimestamp;
+            firstWallTime = static_cast<int64_t>(value);
+        }
+        event.mWallTimeNs = firstWallTime + (event.mTimestamp - firstTimestamp);
+        for (size_t k = 0; k < mEventSize; ++k) {
+            if (!getVarint(&in, end, &value)) {
+                return;
+            }
+            event.mValues[k] = unzigzag(value, first ? 0 : event.mValues[k]);
+        }
+        events->push_back(event);
+        first = false;
+    }
 }
 
 bool RecentEventLogger::isEmpty() const {
-    return mRecentEvents.size() == 0;
+    return mLastEventSequence.load(std::memory_order_relaxed) == 0;
 }
 
 std::string RecentEventLogger::dump() const {
-    std::lock_guard<std::mutex> lk(mLock);
+    // Oldest block first.
+    std::vector<std::pair<uint32_t, size_t>> order;
+    std::vector<std::vector<uint8_t>> blocks(mNumBlocks, std::vector<uint8_t>(BLOCK_BYTES));
+    std::vector<size_t> used(mNumBlocks);
+    for (size_t i = 0; i < mNumBlocks; ++i) {
+        uint32_t generation;
+        if (readBlock(mBlocks[i], &generation, blocks[i].data(), &used[i])) {
+            order.emplace_back(generation, i);
+        }
+    }
+    std::sort(order.begin(), order.end());
+    std::vector<DecodedEvent> events;
+    for (const auto& entry : order) {
+        decodeBlock(blocks[entry.second].data(), used[entry.second], &events);
+    }
 
     //TODO: replace String8 with std::string completely in this function
     String8 buffer;
 
-    buffer.appendFormat("last %zu events\n", mRecentEvents.size());
+    buffer.appendFormat("last %zu events\n", events.size());
     int j = 0;
-    for (int i = mRecentEvents.size() - 1; i >= 0; --i) {
-        const auto& ev = mRecentEvents[i];
-        struct tm * timeinfo = localtime(&(ev.mWallTime.tv_sec));
+    for (auto ev = events.rbegin(); ev != events.rend(); ++ev) {
+        const time_t wallSec = static_cast<time_t>(ev->mWallTimeNs / 1000000000LL);
+        struct tm * timeinfo = localtime(&wallSec);
         buffer.appendFormat("\t%2d (ts=%.9f, wall=%02d:%02d:%02d.%03d) ",
-                ++j, ev.mEvent.timestamp/1e9, timeinfo->tm_hour, timeinfo->tm_min, timeinfo->tm_sec,
-                (int) ns2ms(ev.mWallTime.tv_nsec));
+                ++j, ev->mTimestamp/1e9, timeinfo->tm_hour, timeinfo->tm_min, timeinfo->tm_sec,
+                (int) ns2ms(ev->mWallTimeNs % 1000000000LL));
 
         // data
         if (!mMaskData) {
             if (mSensorType == SENSOR_TYPE_STEP_COUNTER) {
-                buffer.appendFormat("%" PRIu64 ", ", ev.mEvent.u64.step_counter);
+                buffer.appendFormat("%" PRIu64 ", ", static_cast<uint64_t>(ev->mValues[0]));
             } else {
                 for (size_t k = 0; k < mEventSize; ++k) {
-                    buffer.appendFormat("%.2f, ", ev.mEvent.data[k]);
+                    buffer.appendFormat("%.2f, ", ev->mValues[k] / VALUE_SCALE);
                 }
             }
         } else {
@@ -85,15 +295,25 @@ void RecentEventLogger::setFormat(std::string format) {
 }
 
 bool RecentEventLogger::populateLastEvent(sensors_event_t *event) const {
-    std::lock_guard<std::mutex> lk(mLock);
-
-    if (mRecentEvents.size()) {
-        // Index 0 contains the latest event emplace()'ed
-        *event = mRecentEvents[0].mEvent;
-        return true;
-    } else {
-        return false;
+    uint32_t words[EVENT_WORDS];
+    for (;;) {
+        const uint32_t sequence = mLastEventSequence.load(std::memory_order_acquire);
+        if (sequence == 0) {
+            return false;
+        }
+        if (sequence & 1) {
+            continue;
+        }
+        for (size_t i = 0; i < EVENT_WORDS; ++i) {
+            words[i] = mLastEvent[i].load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (mLastEventSequence.load(std::memory_order_relaxed) == sequence) {
+            break;
+        }
     }
+    memcpy(event, words, sizeof(words));
+    return true;
 }
 
 
@@ -104,9 +324,5 @@ size_t RecentEventLogger::logSizeBySensorType(int sensorType) {
             sensorType == SENSOR_TYPE_LIGHT) ? LOG_SIZE_LARGE : LOG_SIZE;
 }
 
-RecentEventLogger::SensorEventLog::SensorEventLog(const sensors_event_t& e) : mEvent(e) {
-    clock_gettime(CLOCK_REALTIME, &mWallTime);
-}
-
 } // namespace SensorServiceUtil
 } // namespace android
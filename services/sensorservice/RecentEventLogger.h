@@ -17,25 +17,32 @@
 #ifndef ANDROID_SENSOR_SERVICE_UTIL_RECENT_EVENT_LOGGER_H
 #define ANDROID_SENSOR_SERVICE_UTIL_RECENT_EVENT_LOGGER_H
 
-#include "RingBuffer.h"
 #include "SensorServiceUtils.h"
 
 #include <hardware/sensors.h>
 #include <utils/String8.h>
 
-#include <mutex>
+#include <atomic>
+#include <memory>
+#include <vector>
 
 namespace android {
 namespace SensorServiceUtil {
 
-// A circular buffer that record the last N events of a sensor type for debugging. The size of this
-// buffer depends on sensor type and is controlled by logSizeBySensorType(). The last N events
-// generated from the sensor are stored in this buffer.  The buffer is NOT cleared when the sensor
+// A circular buffer that record the last events of a sensor type for debugging. The size of this
+// buffer depends on sensor type and is controlled by logSizeBySensorType(), in blocks of events
+// that each hold as many as their encoding fits.  The buffer is NOT cleared when the sensor
 // unregisters and as a result very old data in the dumpsys output can be seen, which is an intended
 // behavior.
+//
+// Events are only written by one thread, the one polling the sensors, and are read without ever
+// waiting for it: every block of events, and the last event, is guarded by a sequence number that
+// is odd while the writer changes it, and a reader copies it and tries again if the number moved
+// meanwhile.
 class RecentEventLogger : public Dumpable {
 public:
     explicit RecentEventLogger(int sensorType);
+    // Must only be called from one thread.
     void addEvent(const sensors_event_t& event);
     bool populateLastEvent(sensors_event_t *event) const;
     bool isEmpty() const;
@@ -46,17 +53,56 @@ public:
     virtual void setFormat(std::string format) override;
 
 protected:
-    struct SensorEventLog {
-        explicit SensorEventLog(const sensors_event_t& e);
-        timespec mWallTime;
-        sensors_event_t mEvent;
+    static constexpr size_t BLOCK_BYTES = 256;
+    static constexpr size_t MAX_VALUES = 16;
+    static constexpr size_t EVENT_WORDS = sizeof(sensors_event_t) / sizeof(uint32_t);
+    static_assert(sizeof(sensors_event_t) % sizeof(uint32_t) == 0, "sensors_event_t isn't words");
+    // A record never takes more than this: a timestamp, a wall clock time and the values, each as
+    // a 64-bit varint.
+    static constexpr size_t MAX_RECORD_BYTES = 10 * (2 + MAX_VALUES);
+    static_assert(MAX_RECORD_BYTES <= BLOCK_BYTES, "a record must fit a block");
+
+    // A self-contained run of events, so that the oldest one can be overwritten once the newest
+    // is full. Its first event has its timestamp, the wall clock time and its values stored in
+    // full, and every later one is encoded as varint deltas from the one before it, with values
+    // quantized to a thousandth. The wall clock time of the later events is derived from their
+    // timestamp.
+    struct Block {
+        std::atomic<uint32_t> mSequence;
+        // 1 for the first block written, 0 for one never written.
+        std::atomic<uint32_t> mGeneration;
+        std::atomic<uint32_t> mUsedBytes;
+        std::atomic<uint32_t> mWords[BLOCK_BYTES / sizeof(uint32_t)];
+    };
+
+    struct DecodedEvent {
+        int64_t mTimestamp;
+        int64_t mWallTimeNs;
+        int64_t mValues[MAX_VALUES];
     };
 
+    void quantize(const sensors_event_t& event, int64_t* values) const;
+    size_t encode(const int64_t* values, int64_t timestamp, bool first, uint8_t* out) const;
+    void startBlock();
+    bool readBlock(const Block& block, uint32_t* generation, uint8_t* bytes, size_t* used) const;
+    void decodeBlock(const uint8_t* bytes, size_t used, std::vector<DecodedEvent>* events) const;
+
     const int mSensorType;
     const size_t mEventSize;
 
-    mutable std::mutex mLock;
-    RingBuffer<SensorEventLog> mRecentEvents;
+    const size_t mNumBlocks;
+    std::unique_ptr<Block[]> mBlocks;
+
+    std::atomic<uint32_t> mLastEventSequence;
+    std::atomic<uint32_t> mLastEvent[EVENT_WORDS];
+
+    // Only used by the writer: a copy of the block being filled, and what its last event was
+    // encoded against.
+    uint32_t mGeneration;
+    size_t mUsedBytes;
+    uint8_t mBytes[BLOCK_BYTES];
+    int64_t mLastTimestamp;
+    int64_t mLastValues[MAX_VALUES];
 
     bool mMaskData;
 
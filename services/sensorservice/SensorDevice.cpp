@@ -21,6 +21,7 @@
 #include <cutils/atomic.h>
 #include <utils/Errors.h>
 #include <utils/Singleton.h>
+#include <utils/Timers.h>
 
 #include <chrono>
 #include <cinttypes>
@@ -52,7 +53,8 @@ static status_t StatusFromResult(Result result) {
 }
 
 SensorDevice::SensorDevice()
-        : mHidlTransportErrors(20), mRestartWaiter(new HidlServiceRegistrationWaiter()) {
+        : mHidlTransportErrors(20), mPollHoldNs(0),
+          mRestartWaiter(new HidlServiceRegistrationWaiter()) {
     if (!connectHidlService()) {
         return;
     }
@@ -156,6 +158,8 @@ std::string SensorDevice::dump() const {
         }
         result.appendFormat("}, selected = %.2f ms\n", info.bestBatchParams.mTBatch / 1e6f);
     }
+    result.appendFormat("poll hold = %.2f ms\n",
+            mPollHoldNs.load(std::memory_order_relaxed) / 1e6f);
 
     return result.string();
 }
@@ -173,6 +177,43 @@ status_t SensorDevice::initCheck() const {
 ssize_t SensorDevice::poll(sensors_event_t* buffer, size_t count) {
     if (mSensors == nullptr) return NO_INIT;
 
+    ssize_t err = pollHal(buffer, count);
+    const nsecs_t holdNs = mPollHoldNs.load(std::memory_order_relaxed);
+    if (err <= 0 || holdNs == 0 || !canHoldEvents(buffer, err)) {
+        return err;
+    }
+
+    // Nobody needs these events for a while, so keep collecting the ones that follow and hand
+    // them on together, sparing the service and its clients a wakeup for each HAL return.
+    const nsecs_t deadline = systemTime(SYSTEM_TIME_BOOTTIME) + holdNs;
+    size_t total = err;
+    while (total < count && systemTime(SYSTEM_TIME_BOOTTIME) < deadline) {
+        ssize_t n = pollHal(buffer + total, count - total);
+        if (n < 0) {
+            // Hand on what was collected; the error shows up again on the next poll.
+            break;
+        }
+        const bool canHold = canHoldEvents(buffer + total, n);
+        total += n;
+        if (!canHold || mPollHoldNs.load(std::memory_order_relaxed) == 0) {
+            break;
+        }
+    }
+    return total;
+}
+
+bool SensorDevice::canHoldEvents(const sensors_event_t* buffer, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        // Flush completions and dynamic sensor connections are waited for.
+        if (buffer[i].type == SENSOR_TYPE_META_DATA ||
+                buffer[i].type == SENSOR_TYPE_DYNAMIC_SENSOR_META) {
+            return false;
+        }
+    }
+    return true;
+}
+
+ssize_t SensorDevice::pollHal(sensors_event_t* buffer, size_t count) {
     ssize_t err;
     int numHidlTransportErrors = 0;
     bool hidlTransportError = false;
@@ -225,6 +266,7 @@ void SensorDevice::autoDisable(void *ident, int handle) {
     }
     Info& info(mActivationCount.editValueAt(activationIndex));
     info.removeBatchParamsForIdent(ident);
+    updatePollHoldLocked();
 }
 
 status_t SensorDevice::activate(void* ident, int handle, int enabled) {
@@ -291,6 +333,7 @@ status_t SensorDevice::activate(void* ident, int handle, int enabled) {
         } else {
             // sensor wasn't enabled for this ident
         }
+        updatePollHoldLocked();
 
         if (isClientDisabledLocked(ident)) {
             return NO_ERROR;
@@ -309,6 +352,9 @@ status_t SensorDevice::activate(void* ident, int handle, int enabled) {
             info.removeBatchParamsForIdent(ident);
         }
     }
+    if (enabled) {
+        updatePollHoldLocked();
+    }
 
     return err;
 }
@@ -373,9 +419,46 @@ status_t SensorDevice::batch(
             info.removeBatchParamsForIdent(ident);
         }
     }
+    updatePollHoldLocked();
     return err;
 }
 
+void SensorDevice::updatePollHoldLocked() {
+    nsecs_t latency = INT64_MAX;
+    nsecs_t samplingPeriod = 0;
+    for (size_t i = 0; i < mActivationCount.size(); ++i) {
+        Info& info = mActivationCount.editValueAt(i);
+        if (info.numActiveClients() == 0) {
+            continue;
+        }
+        // On-change sensors may not report again in time to end the hold, and wake-up events
+        // must not sit here while the AP could suspend.
+        const sensor_t* sensor = getSensorLocked(mActivationCount.keyAt(i));
+        if (sensor == nullptr || info.bestBatchParams.mTBatch == 0
+                || (sensor->flags & SENSOR_FLAG_WAKE_UP)
+                || (sensor->flags & SENSOR_FLAG_MASK_REPORTING_MODE)
+                        != SENSOR_FLAG_CONTINUOUS_MODE) {
+            mPollHoldNs.store(0, std::memory_order_relaxed);
+            return;
+        }
+        latency = std::min(latency, info.bestBatchParams.mTBatch);
+        samplingPeriod = std::max(samplingPeriod, info.bestBatchParams.mTSample);
+    }
+    // The hold only ends once an event arrives after it, up to a sampling period later.
+    mPollHoldNs.store(latency != INT64_MAX && latency > samplingPeriod ? latency - samplingPeriod : 0,
+            std::memory_order_relaxed);
+}
+
+const sensor_t* SensorDevice::getSensorLocked(int handle) const {
+    for (const auto& sensor : mSensorList) {
+        if (sensor.handle == handle) {
+            return &sensor;
+        }
+    }
+    auto it = mConnectedDynamicSensors.find(handle);
+    return it != mConnectedDynamicSensors.end() ? it->second : nullptr;
+}
+
 status_t SensorDevice::setDelay(void* ident, int handle, int64_t samplingPeriodNs) {
     return batch(ident, handle, 0, samplingPeriodNs, 0);
 }
@@ -426,6 +509,7 @@ void SensorDevice::enableAllSensors() {
             ALOGE_IF(err, "Error activating sensor %d (%s)", sensor_handle, strerror(-err));
         }
     }
+    updatePollHoldLocked();
 }
 
 void SensorDevice::disableAllSensors() {
@@ -448,6 +532,7 @@ void SensorDevice::disableAllSensors() {
            }
         }
     }
+    updatePollHoldLocked();
 }
 
 status_t SensorDevice::injectSensorData(
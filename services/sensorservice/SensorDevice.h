@@ -27,6 +27,7 @@
 #include <utils/Singleton.h>
 #include <utils/String8.h>
 
+#include <atomic>
 #include <string>
 #include <unordered_map>
 #include <algorithm> //std::max std::min
@@ -161,9 +162,20 @@ private:
 
     // Use this vector to determine which client is activated or deactivated.
     SortedVector<void *> mDisabledClients;
+
+    // How long poll() may keep collecting events before returning them. Only non-zero while every
+    // active sensor is a continuous, non-wake-up one batched by all of its clients, so that
+    // nobody waits for the events sooner than that. Written under mLock, read by poll().
+    std::atomic<nsecs_t> mPollHoldNs;
+
     SensorDevice();
     bool connectHidlService();
 
+    ssize_t pollHal(sensors_event_t* buffer, size_t count);
+    void updatePollHoldLocked();
+    const sensor_t* getSensorLocked(int handle) const;
+    static bool canHoldEvents(const sensors_event_t* buffer, size_t count);
+
     static void handleHidlDeath(const std::string &detail);
     template<typename T>
     static Return<T> checkReturn(Return<T> &&ret) {
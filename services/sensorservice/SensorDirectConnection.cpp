@@ -68,6 +68,10 @@ sp<BitTube> SensorService::SensorDirectConnection::getSensorChannel() const {
     return nullptr;
 }
 
+sp<SensorEventRing> SensorService::SensorDirectConnection::getSensorEventRing() {
+    return nullptr;
+}
+
 status_t SensorService::SensorDirectConnection::enableDisable(
         int handle, bool enabled, nsecs_t samplingPeriodNs, nsecs_t maxBatchReportLatencyNs,
         int reservedFlags) {
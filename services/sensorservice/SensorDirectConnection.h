@@ -63,6 +63,7 @@ protected:
     virtual status_t setEventRate(int handle, nsecs_t samplingPeriodNs);
     virtual status_t flush();
     virtual int32_t configureChannel(int handle, int rateLevel);
+    virtual sp<SensorEventRing> getSensorEventRing();
     virtual void destroy();
 private:
     const sp<SensorService> mService;
@@ -15,6 +15,7 @@
  */
 
 #include <sys/socket.h>
+#include <utils/SystemClock.h>
 #include <utils/threads.h>
 
 #include <sensor/SensorEventQueue.h>
@@ -31,7 +32,8 @@ SensorService::SensorEventConnection::SensorEventConnection(
         const sp<SensorService>& service, uid_t uid, String8 packageName, bool isDataInjectionMode,
         const String16& opPackageName, bool hasSensorAccess)
     : mService(service), mUid(uid), mWakeLockRefCount(0), mHasLooperCallbacks(false),
-      mDead(false), mDataInjectionMode(isDataInjectionMode), mEventCache(NULL),
+      mHasRingLooperCallback(false), mDead(false), mDataInjectionMode(isDataInjectionMode),
+      mRingDeadline(0), mLastRingWriteTime(0), mRingWriteInterval(0), mEventCache(NULL),
       mCacheSize(0), mMaxCacheSize(0), mPackageName(packageName), mOpPackageName(opPackageName),
       mDestroyed(false), mHasSensorAccess(hasSensorAccess) {
     mChannel = new BitTube(mService->mSocketBufferSize);
@@ -81,6 +83,10 @@ void SensorService::SensorEventConnection::dump(String8& result) {
     result.appendFormat("\t %s | WakeLockRefCount %d | uid %d | cache size %d | "
             "max cache size %d\n", mPackageName.string(), mWakeLockRefCount, mUid, mCacheSize,
             mMaxCacheSize);
+    if (mEventRing != NULL) {
+        result.appendFormat("\t event ring capacity %zu | pending %zu\n",
+                mEventRing->getCapacity(), mEventRing->getPendingCount());
+    }
     for (size_t i = 0; i < mSensorInfo.size(); ++i) {
         const FlushInfo& flushInfo = mSensorInfo.valueAt(i);
         result.appendFormat("\t %s 0x%08x | status: %s | pending flush events %d \n",
@@ -117,6 +123,10 @@ bool SensorService::SensorEventConnection::addSensor(int32_t handle) {
 bool SensorService::SensorEventConnection::removeSensor(int32_t handle) {
     Mutex::Autolock _l(mConnectionLock);
     if (mSensorInfo.removeItem(handle) >= 0) {
+        // Events of the sensor still in the ring would otherwise wait for another sensor's.
+        if (mRingDeadline != 0) {
+            signalRingLocked();
+        }
         return true;
     }
     return false;
@@ -158,6 +168,16 @@ void SensorService::SensorEventConnection::setFirstFlushPending(int32_t handle,
     }
 }
 
+void SensorService::SensorEventConnection::setMaxReportLatency(int32_t handle,
+                                nsecs_t maxReportLatencyNs) {
+    Mutex::Autolock _l(mConnectionLock);
+    ssize_t index = mSensorInfo.indexOfKey(handle);
+    if (index >= 0) {
+        FlushInfo& flushInfo = mSensorInfo.editValueAt(index);
+        flushInfo.mMaxReportLatencyNs = maxReportLatencyNs;
+    }
+}
+
 void SensorService::SensorEventConnection::updateLooperRegistration(const sp<Looper>& looper) {
     Mutex::Autolock _l(mConnectionLock);
     updateLooperRegistrationLocked(looper);
@@ -167,6 +187,21 @@ void SensorService::SensorEventConnection::updateLooperRegistrationLocked(
         const sp<Looper>& looper) {
     bool isConnectionActive = (mSensorInfo.size() > 0 && !mDataInjectionMode) ||
                               mDataInjectionMode;
+    // With a ring, the app making room for the cached events is signalled on the space fd of the
+    // ring rather than by the socket becoming writable.
+    const bool waitForRingSpace = mEventRing != NULL && isConnectionActive && !mDead &&
+                                  mCacheSize > 0;
+    if (waitForRingSpace && !mHasRingLooperCallback) {
+        int ret = looper->addFd(mEventRing->getSpaceFd(), 0, ALOOPER_EVENT_INPUT, this, NULL);
+        if (ret == 1) {
+            mHasRingLooperCallback = true;
+        } else {
+            ALOGE("Looper::addFd failed ret=%d fd=%d", ret, mEventRing->getSpaceFd());
+        }
+    } else if (!waitForRingSpace && mHasRingLooperCallback) {
+        looper->removeFd(mEventRing->getSpaceFd());
+        mHasRingLooperCallback = false;
+    }
     // If all sensors are unregistered OR Looper has encountered an error, we can remove the Fd from
     // the Looper if it has been previously added.
     if (!isConnectionActive || mDead) { if (mHasLooperCallbacks) {
@@ -176,7 +211,7 @@ void SensorService::SensorEventConnection::updateLooperRegistrationLocked(
     return; }
 
     int looper_flags = 0;
-    if (mCacheSize > 0) looper_flags |= ALOOPER_EVENT_OUTPUT;
+    if (mCacheSize > 0 && mEventRing == NULL) looper_flags |= ALOOPER_EVENT_OUTPUT;
     if (mDataInjectionMode) looper_flags |= ALOOPER_EVENT_INPUT;
     for (size_t i = 0; i < mSensorInfo.size(); ++i) {
         const int handle = mSensorInfo.keyAt(i);
@@ -358,9 +393,7 @@ status_t SensorService::SensorEventConnection::sendEvents(
         }
     }
 
-    // NOTE: ASensorEvent and sensors_event_t are the same type.
-    ssize_t size = SensorEventQueue::write(mChannel,
-                                    reinterpret_cast<ASensorEvent const*>(scratch), count);
+    ssize_t size = writeEventsLocked(scratch, count, false);
     if (size < 0) {
         // Write error, copy events to local cache.
         if (index_wake_up_event >= 0) {
@@ -422,7 +455,7 @@ void SensorService::SensorEventConnection::reAllocateCacheLocked(sensors_event_t
 }
 
 void SensorService::SensorEventConnection::sendPendingFlushEventsLocked() {
-    ASensorEvent flushCompleteEvent;
+    sensors_event_t flushCompleteEvent;
     memset(&flushCompleteEvent, 0, sizeof(flushCompleteEvent));
     flushCompleteEvent.type = SENSOR_TYPE_META_DATA;
     // Loop through all the sensors for this connection and check if there are any pending
@@ -442,7 +475,7 @@ void SensorService::SensorEventConnection::sendPendingFlushEventsLocked() {
                ++mWakeLockRefCount;
                flushCompleteEvent.flags |= WAKE_UP_SENSOR_EVENT_NEEDS_ACK;
             }
-            ssize_t size = SensorEventQueue::write(mChannel, &flushCompleteEvent, 1);
+            ssize_t size = writeEventsLocked(&flushCompleteEvent, 1, true);
             if (size < 0) {
                 if (wakeUpSensor) --mWakeLockRefCount;
                 return;
@@ -478,9 +511,8 @@ void SensorService::SensorEventConnection::writeToSocketFromCache() {
             }
         }
 
-        ssize_t size = SensorEventQueue::write(mChannel,
-                          reinterpret_cast<ASensorEvent const*>(mEventCache + numEventsSent),
-                          numEventsToWrite);
+        // The app has been waiting for these, so it is woken up right away.
+        ssize_t size = writeEventsLocked(mEventCache + numEventsSent, numEventsToWrite, true);
         if (size < 0) {
             if (index_wake_up_event >= 0) {
                 // If there was a wake_up sensor_event, reset the flag.
@@ -513,6 +545,58 @@ void SensorService::SensorEventConnection::writeToSocketFromCache() {
     updateLooperRegistrationLocked(mService->getLooper());
 }
 
+ssize_t SensorService::SensorEventConnection::writeEventsLocked(
+        sensors_event_t const* events, size_t count, bool signalNow) {
+    // NOTE: ASensorEvent and sensors_event_t are the same type.
+    if (mEventRing == NULL) {
+        return SensorEventQueue::write(mChannel, reinterpret_cast<ASensorEvent const*>(events),
+                                       count);
+    }
+    ssize_t size = mEventRing->write(reinterpret_cast<ASensorEvent const*>(events), count);
+    if (size < 0 || signalNow || shouldSignalRingLocked(events, count)) {
+        // A full ring needs the app to drain it as well.
+        signalRingLocked();
+    }
+    return size;
+}
+
+bool SensorService::SensorEventConnection::shouldSignalRingLocked(
+        sensors_event_t const* events, size_t count) {
+    const nsecs_t now = elapsedRealtimeNano();
+    if (mLastRingWriteTime != 0) {
+        mRingWriteInterval = now - mLastRingWriteTime;
+    }
+    mLastRingWriteTime = now;
+
+    // Leave room for the events that arrive before the app gets to run.
+    if (mEventRing->getPendingCount() * 2 >= mEventRing->getCapacity()) {
+        return true;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        if (events[i].type == SENSOR_TYPE_META_DATA || mService->isWakeUpSensorEvent(events[i])) {
+            return true;
+        }
+        ssize_t index = mSensorInfo.indexOfKey(events[i].sensor);
+        if (index < 0 || mSensorInfo.valueAt(index).mMaxReportLatencyNs <= 0) {
+            return true;
+        }
+        // Timestamps from the future can't push the deadline back.
+        const nsecs_t deadline = helpers::min(events[i].timestamp, now) +
+                mSensorInfo.valueAt(index).mMaxReportLatencyNs;
+        if (mRingDeadline == 0 || deadline < mRingDeadline) {
+            mRingDeadline = deadline;
+        }
+    }
+    // Writes are expected to keep coming at the rate they have so far. If the next one would be
+    // too late, this one has to wake the app up.
+    return now + mRingWriteInterval >= mRingDeadline;
+}
+
+void SensorService::SensorEventConnection::signalRingLocked() {
+    mEventRing->signalData();
+    mRingDeadline = 0;
+}
+
 void SensorService::SensorEventConnection::countFlushCompleteEventsLocked(
                 sensors_event_t const* scratch, const int numEventsDropped) {
     ALOGD_IF(DEBUG_CONNECTIONS, "dropping %d events ", numEventsDropped);
@@ -551,6 +635,22 @@ sp<BitTube> SensorService::SensorEventConnection::getSensorChannel() const
     return mChannel;
 }
 
+sp<SensorEventRing> SensorService::SensorEventConnection::getSensorEventRing()
+{
+    Mutex::Autolock _l(mConnectionLock);
+    // Injected events come in through the socket, so it stays the only channel in that mode.
+    if (mEventRing == NULL && !mDataInjectionMode) {
+        const size_t capacity = helpers::max(
+                mService->mSocketBufferSize / sizeof(sensors_event_t),
+                size_t(SensorEventQueue::MAX_RECEIVE_BUFFER_EVENT_COUNT));
+        sp<SensorEventRing> ring(new SensorEventRing(capacity));
+        if (ring->initCheck() == NO_ERROR) {
+            mEventRing = ring;
+        }
+    }
+    return mEventRing;
+}
+
 status_t SensorService::SensorEventConnection::enableDisable(
         int handle, bool enabled, nsecs_t samplingPeriodNs, nsecs_t maxBatchReportLatencyNs,
         int reservedFlags)
@@ -559,6 +659,14 @@ status_t SensorService::SensorEventConnection::enableDisable(
     if (enabled) {
         err = mService->enable(this, handle, samplingPeriodNs, maxBatchReportLatencyNs,
                                reservedFlags, mOpPackageName);
+        if (err == NO_ERROR) {
+            // Only continuous sensors are batched; events of the others are sent right away.
+            sp<SensorInterface> si = mService->getSensorInterfaceFromHandle(handle);
+            if (si != nullptr &&
+                    si->getSensor().getReportingMode() == AREPORTING_MODE_CONTINUOUS) {
+                setMaxReportLatency(handle, maxBatchReportLatencyNs);
+            }
+        }
 
     } else {
         err = mService->disable(this, handle);
@@ -584,6 +692,13 @@ int32_t SensorService::SensorEventConnection::configureChannel(int handle, int r
 }
 
 int SensorService::SensorEventConnection::handleEvent(int fd, int events, void* /*data*/) {
+    if (mEventRing != NULL && fd == mEventRing->getSpaceFd()) {
+        // The app has made room in the ring for the events in mEventCache.
+        mEventRing->clearSpace();
+        mService->sendEventsFromCache(this);
+        return 1;
+    }
+
     if (events & ALOOPER_EVENT_HANGUP || events & ALOOPER_EVENT_ERROR) {
         {
             // If the Looper encounters some error, set the flag mDead, reset mWakeLockRefCount,
@@ -33,6 +33,7 @@
 
 #include <sensor/Sensor.h>
 #include <sensor/BitTube.h>
+#include <sensor/SensorEventRing.h>
 #include <sensor/ISensorServer.h>
 #include <sensor/ISensorEventConnection.h>
 
@@ -78,8 +79,23 @@ private:
     virtual status_t setEventRate(int handle, nsecs_t samplingPeriodNs);
     virtual status_t flush();
     virtual int32_t configureChannel(int handle, int rateLevel);
+    virtual sp<SensorEventRing> getSensorEventRing();
     virtual void destroy();
 
+    // Records how late events of the given sensor may reach the app when they are written to
+    // mEventRing.
+    void setMaxReportLatency(int32_t handle, nsecs_t maxReportLatencyNs);
+
+    // Writes events to mEventRing if the app reads from it, or to the socket otherwise. Events
+    // written to the ring only wake the app up if signalNow is set or shouldSignalRingLocked()
+    // decides they can't wait for the next write.
+    ssize_t writeEventsLocked(sensors_event_t const* events, size_t count, bool signalNow);
+
+    // Whether the events just written to mEventRing, or any written before them, would reach the
+    // app later than their sensors allow if the app was only woken up by the next write.
+    bool shouldSignalRingLocked(sensors_event_t const* events, size_t count);
+    void signalRingLocked();
+
     // Count the number of flush complete events which are about to be dropped in the buffer.
     // Increment mPendingFlushEventsToSend in mSensorInfo. These flush complete events will be sent
     // separately before the next batch of events.
@@ -96,7 +112,7 @@ private:
     // emulates the behavior of flush().
     void sendPendingFlushEventsLocked();
 
-    // Writes events from mEventCache to the socket.
+    // Writes events from mEventCache to the socket or to mEventRing.
     void writeToSocketFromCache();
 
     // Compute the approximate cache size from the FIFO sizes of various sensors registered for this
@@ -128,6 +144,9 @@ private:
 
     sp<SensorService> const mService;
     sp<BitTube> mChannel;
+    // Created when the app asks for it. Events are then written here instead of to mChannel,
+    // which is still used for acknowledgements.
+    sp<SensorEventRing> mEventRing;
     uid_t mUid;
     mutable Mutex mConnectionLock;
     // Number of events from wake up sensors which are still pending and haven't been delivered to
@@ -139,6 +158,9 @@ private:
     // connection has wake-up sensors associated with it or when write has failed on this connection
     // and we're storing some events in the cache.
     bool mHasLooperCallbacks;
+    // Set when the space fd of mEventRing has been added to the Looper, to send the events in the
+    // cache once the app has made room for them.
+    bool mHasRingLooperCallback;
     // If there are any errors associated with the Looper this flag is set to true and
     // mWakeLockRefCount is reset to zero. needsWakeLock method will always return false, if this
     // flag is set.
@@ -154,11 +176,21 @@ private:
         // the events for the sensor are sent on that *connection*.
         bool mFirstFlushPending;
 
-        FlushInfo() : mPendingFlushEventsToSend(0), mFirstFlushPending(false) {}
+        // How late events may reach the app when they are written to mEventRing. Zero for
+        // sensors whose events are sent right away.
+        nsecs_t mMaxReportLatencyNs;
+
+        FlushInfo() : mPendingFlushEventsToSend(0), mFirstFlushPending(false),
+                mMaxReportLatencyNs(0) {}
     };
     // protected by SensorService::mLock. Key for this vector is the sensor handle.
     KeyedVector<int, FlushInfo> mSensorInfo;
 
+    // The time by which the events in mEventRing must have woken the app up, zero while it has
+    // nothing to be woken up for, and how long it was between the last two writes to the ring.
+    nsecs_t mRingDeadline;
+    nsecs_t mLastRingWriteTime, mRingWriteInterval;
+
     sensors_event_t *mEventCache;
     int mCacheSize, mMaxCacheSize;
     String8 mPackageName;
@@ -0,0 +1,140 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <sensor/SensorEventQueue.h>
+
+#include "SensorEventConnection.h"
+#include "SensorEventSender.h"
+
+namespace android {
+
+class SensorService::SensorEventSender::Worker : public Thread {
+public:
+    explicit Worker(SensorEventSender* sender)
+            : Thread(false), mSender(sender), mGeneration(0),
+              mScratch(new sensors_event_t[SensorEventQueue::MAX_RECEIVE_BUFFER_EVENT_COUNT]) {
+    }
+
+    virtual ~Worker() {
+        delete [] mScratch;
+    }
+
+private:
+    virtual bool threadLoop();
+
+    SensorEventSender* const mSender;
+    // The last batch this worker has seen.
+    uint32_t mGeneration;
+    sensors_event_t* const mScratch;
+};
+
+bool SensorService::SensorEventSender::Worker::threadLoop() {
+    {
+        std::unique_lock<std::mutex> lk(mSender->mLock);
+        mSender->mWorkAvailable.wait(lk, [this] {
+            return mSender->mExitPending || mSender->mGeneration != mGeneration;
+        });
+        if (mSender->mExitPending) {
+            return false;
+        }
+        mGeneration = mSender->mGeneration;
+        if (mSender->mConnections == NULL) {
+            // Woke up too late, the others have sent the whole batch already.
+            return true;
+        }
+        mSender->mActiveWorkers++;
+    }
+
+    while (mSender->sendToNextConnection(mScratch)) {
+    }
+
+    std::lock_guard<std::mutex> lk(mSender->mLock);
+    if (--mSender->mActiveWorkers == 0) {
+        mSender->mWorkDone.notify_all();
+    }
+    return true;
+}
+
+SensorService::SensorEventSender::SensorEventSender(size_t numWorkers)
+        : mGeneration(0), mActiveWorkers(0), mExitPending(false), mConnections(NULL),
+          mBuffer(NULL), mCount(0), mMapFlushEventsToConnections(NULL), mNextConnection(0) {
+    for (size_t i = 0; i < numWorkers; i++) {
+        sp<Worker> worker(new Worker(this));
+        if (worker->run("SensorEventSender", PRIORITY_URGENT_DISPLAY) == NO_ERROR) {
+            mWorkers.add(worker);
+        }
+    }
+}
+
+SensorService::SensorEventSender::~SensorEventSender() {
+    {
+        std::lock_guard<std::mutex> lk(mLock);
+        mExitPending = true;
+        mWorkAvailable.notify_all();
+    }
+    for (size_t i = 0; i < mWorkers.size(); i++) {
+        mWorkers[i]->requestExitAndWait();
+    }
+}
+
+Vector<pid_t> SensorService::SensorEventSender::getWorkerTids() const {
+    Vector<pid_t> tids;
+    for (size_t i = 0; i < mWorkers.size(); i++) {
+        tids.add(mWorkers[i]->getTid());
+    }
+    return tids;
+}
+
+void SensorService::SensorEventSender::sendEvents(
+        const SortedVector< sp<SensorEventConnection> >& connections,
+        sensors_event_t const* buffer, size_t count,
+        wp<const SensorEventConnection> const* mapFlushEventsToConnections,
+        sensors_event_t* scratch) {
+    {
+        std::lock_guard<std::mutex> lk(mLock);
+        mConnections = &connections;
+        mBuffer = buffer;
+        mCount = count;
+        mMapFlushEventsToConnections = mapFlushEventsToConnections;
+        mNextConnection = 0;
+        if (!mWorkers.isEmpty() && connections.size() >= MIN_CONNECTIONS_TO_SHARE) {
+            mGeneration++;
+            mWorkAvailable.notify_all();
+        }
+    }
+
+    while (sendToNextConnection(scratch)) {
+    }
+
+    // The workers that joined may still be sending to the last connections they took.
+    std::unique_lock<std::mutex> lk(mLock);
+    mWorkDone.wait(lk, [this] { return mActiveWorkers == 0; });
+    mConnections = NULL;
+}
+
+bool SensorService::SensorEventSender::sendToNextConnection(sensors_event_t* scratch) {
+    const size_t index = mNextConnection++;
+    if (index >= mConnections->size()) {
+        return false;
+    }
+    const sp<SensorEventConnection>& connection = mConnections->itemAt(index);
+    if (connection != 0) {
+        connection->sendEvents(mBuffer, mCount, scratch, mMapFlushEventsToConnections);
+    }
+    return true;
+}
+
+} // namespace android
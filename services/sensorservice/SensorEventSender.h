@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_SENSOR_EVENT_SENDER_H
+#define ANDROID_SENSOR_EVENT_SENDER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+
+#include "SensorService.h"
+
+namespace android {
+
+class SensorService;
+
+// Sends the events of one poll to the active connections. The connections are handed out one at
+// a time to the calling thread and to a few worker threads, each of which filters events into its
+// own scratch buffer, so that apps are served in parallel rather than one after the other. None
+// of this takes SensorService::mLock.
+class SensorService::SensorEventSender : public RefBase {
+public:
+    explicit SensorEventSender(size_t numWorkers);
+    virtual ~SensorEventSender();
+
+    // Calls sendEvents() on each of the connections, returning once all of them are done.
+    // scratch is used by the calling thread.
+    void sendEvents(const SortedVector< sp<SensorEventConnection> >& connections,
+                    sensors_event_t const* buffer, size_t count,
+                    wp<const SensorEventConnection> const* mapFlushEventsToConnections,
+                    sensors_event_t* scratch);
+
+    // The thread ids of the workers, so that they can be scheduled like the SensorService thread.
+    Vector<pid_t> getWorkerTids() const;
+
+private:
+    class Worker;
+
+    // Sends the events to the next connection nobody has taken yet. Returns false if there was
+    // none left.
+    bool sendToNextConnection(sensors_event_t* scratch);
+
+    // Below this many connections, waking the workers up costs more than it saves.
+    static const size_t MIN_CONNECTIONS_TO_SHARE = 4;
+
+    Vector< sp<Worker> > mWorkers;
+
+    std::mutex mLock;
+    std::condition_variable mWorkAvailable;
+    std::condition_variable mWorkDone;
+    // protected by mLock. mGeneration is incremented for each batch handed to the workers, and
+    // mActiveWorkers counts the workers that have joined the current one.
+    uint32_t mGeneration;
+    size_t mActiveWorkers;
+    bool mExitPending;
+
+    // The batch being sent. Set under mLock, and only read by workers that joined it.
+    const SortedVector< sp<SensorEventConnection> >* mConnections;
+    sensors_event_t const* mBuffer;
+    size_t mCount;
+    wp<const SensorEventConnection> const* mMapFlushEventsToConnections;
+    std::atomic<size_t> mNextConnection;
+};
+
+} // namespace android
+
+#endif // ANDROID_SENSOR_EVENT_SENDER_H
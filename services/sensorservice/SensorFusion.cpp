@@ -23,10 +23,21 @@ namespace android {
 
 ANDROID_SINGLETON_STATIC_INSTANCE(SensorFusion)
 
+// The rate at which the magnetometer is asked for in setDelay().
+static const nsecs_t MAG_DELAY_NS = ms2ns(10);
+
+// Whether an event at 'time' is due for something last done at 'lastTime' and meant to be done
+// every 'period', given events that come every 'interval'. Half an interval of slack keeps jitter
+// from skipping every other due event.
+static bool isDue(nsecs_t time, nsecs_t lastTime, nsecs_t period, nsecs_t interval) {
+    return time - lastTime + interval / 2 >= period;
+}
+
 SensorFusion::SensorFusion()
     : mSensorDevice(SensorDevice::getInstance()),
       mAttitude(mAttitudes[FUSION_9AXIS]),
-      mGyroTime(0), mAccTime(0)
+      mPendingGyroDt(0),
+      mGyroTime(0), mAccTime(0), mMagTime(0), mMagUpdateTime(0)
 {
     sensor_t const* list;
     Sensor uncalibratedGyro;
@@ -36,6 +47,13 @@ SensorFusion::SensorFusion()
     mEnabled[FUSION_NOMAG] = false;
     mEnabled[FUSION_NOGYRO] = false;
 
+    for (int i = 0; i<NUM_FUSION_MODE; ++i) {
+        mAccPeriodNs[i] = 0;
+        mAccUpdateTime[i] = 0;
+        mPendingAccDt[i] = 0;
+    }
+    mPendingGyroAngle = 0;
+
     if (count > 0) {
         for (size_t i=0 ; i<size_t(count) ; i++) {
             if (list[i].type == SENSOR_TYPE_ACCELEROMETER) {
@@ -83,20 +101,34 @@ void SensorFusion::process(const sensors_event_t& event) {
                 mEstimatedGyroRate = freq + (mEstimatedGyroRate - freq)*alpha;
             }
 
-            const vec3_t gyro(event.data);
-            for (int i = 0; i<NUM_FUSION_MODE; ++i) {
-                if (mEnabled[i]) {
-                    // fusion in no gyro mode will ignore
-                    mFusions[i].handleGyro(gyro, dT);
+            // The gyro may run faster than fusion asked for because of other clients, in which
+            // case its events are integrated and predicted from at the rate asked for.
+            mPendingGyroAngle += vec3_t(event.data) * dT;
+            mPendingGyroDt += dT;
+            if (mPendingGyroDt + dT * 0.5f >= mTargetDelayNs / 1000000000.0f) {
+                const vec3_t gyro(mPendingGyroAngle * (1 / mPendingGyroDt));
+                for (int i = 0; i<NUM_FUSION_MODE; ++i) {
+                    if (mEnabled[i]) {
+                        // fusion in no gyro mode will ignore
+                        mFusions[i].handleGyro(gyro, mPendingGyroDt);
+                    }
                 }
+                mPendingGyroAngle = 0;
+                mPendingGyroDt = 0;
             }
         }
         mGyroTime = event.timestamp;
     } else if (event.type == SENSOR_TYPE_MAGNETIC_FIELD) {
-        const vec3_t mag(event.data);
-        for (int i = 0; i<NUM_FUSION_MODE; ++i) {
-            if (mEnabled[i]) {
-                mFusions[i].handleMag(mag);// fusion in no mag mode will ignore
+        // Likewise, a magnetometer faster than asked for doesn't need to correct every event.
+        const nsecs_t interval = event.timestamp - mMagTime;
+        mMagTime = event.timestamp;
+        if (isDue(event.timestamp, mMagUpdateTime, MAG_DELAY_NS, interval)) {
+            mMagUpdateTime = event.timestamp;
+            const vec3_t mag(event.data);
+            for (int i = 0; i<NUM_FUSION_MODE; ++i) {
+                if (mEnabled[i]) {
+                    mFusions[i].handleMag(mag);// fusion in no mag mode will ignore
+                }
             }
         }
     } else if (event.type == SENSOR_TYPE_ACCELEROMETER) {
@@ -108,7 +140,15 @@ void SensorFusion::process(const sensors_event_t& event) {
             const vec3_t acc(event.data);
             for (int i = 0; i<NUM_FUSION_MODE; ++i) {
                 if (mEnabled[i]) {
-                    mFusions[i].handleAcc(acc, dT);
+                    // Only correct as often as the clients of this mode want its output.
+                    mPendingAccDt[i] += dT;
+                    if (isDue(event.timestamp, mAccUpdateTime[i], mAccPeriodNs[i],
+                            event.timestamp - mAccTime)) {
+                        mFusions[i].handleAcc(acc, mPendingAccDt[i]);
+                        mAccUpdateTime[i] = event.timestamp;
+                        mPendingAccDt[i] = 0;
+                    }
+                    // The gyro may have moved the attitude since the last correction.
                     mAttitudes[i] = mFusions[i].getAttitude();
                 }
             }
@@ -135,6 +175,8 @@ status_t SensorFusion::activate(int mode, void* ident, bool enabled) {
         if (idx >= 0) {
             mClients[mode].removeItemsAt(idx);
         }
+        mClientPeriods[mode].removeItem(ident);
+        updateAccPeriod(mode);
     }
 
     const bool newState = mClients[mode].size() != 0;
@@ -142,6 +184,8 @@ status_t SensorFusion::activate(int mode, void* ident, bool enabled) {
         mEnabled[mode] = newState;
         if (newState) {
             mFusions[mode].init(mode);
+            mAccUpdateTime[mode] = 0;
+            mPendingAccDt[mode] = 0;
         }
     }
 
@@ -161,9 +205,11 @@ status_t SensorFusion::setDelay(int mode, void* ident, int64_t ns) {
     if (ns > (int64_t)5e7) {
         ns = (int64_t)(5e7);
     }
+    mClientPeriods[mode].add(ident, ns);
+    updateAccPeriod(mode);
     mSensorDevice.batch(ident, mAcc.getHandle(), 0, ns, 0);
     if (mode != FUSION_NOMAG) {
-        mSensorDevice.batch(ident, mMag.getHandle(), 0, ms2ns(10), 0);
+        mSensorDevice.batch(ident, mMag.getHandle(), 0, MAG_DELAY_NS, 0);
     }
     if (mode != FUSION_NOGYRO) {
         mSensorDevice.batch(ident, mGyro.getHandle(), 0, mTargetDelayNs, 0);
@@ -171,6 +217,16 @@ status_t SensorFusion::setDelay(int mode, void* ident, int64_t ns) {
     return NO_ERROR;
 }
 
+void SensorFusion::updateAccPeriod(int mode) {
+    nsecs_t period = 0;
+    for (size_t i = 0; i < mClientPeriods[mode].size(); i++) {
+        const nsecs_t clientPeriod = mClientPeriods[mode].valueAt(i);
+        if (i == 0 || clientPeriod < period) {
+            period = clientPeriod;
+        }
+    }
+    mAccPeriodNs[mode] = period;
+}
 
 float SensorFusion::getPowerUsage(int mode) const {
     float power =   mAcc.getPowerUsage() +
@@ -20,6 +20,7 @@
 #include <stdint.h>
 #include <sys/types.h>
 
+#include <utils/KeyedVector.h>
 #include <utils/SortedVector.h>
 #include <utils/Singleton.h>
 #include <utils/String8.h>
@@ -52,14 +53,30 @@ class SensorFusion : public Singleton<SensorFusion> {
 
     SortedVector<void*> mClients[3];
 
+    // The sampling period each client of a mode asked for. A mode is only corrected by
+    // accelerometer events as often as the fastest of its clients needs it.
+    KeyedVector<void*, nsecs_t> mClientPeriods[NUM_FUSION_MODE];
+    nsecs_t mAccPeriodNs[NUM_FUSION_MODE];
+    nsecs_t mAccUpdateTime[NUM_FUSION_MODE];
+    float mPendingAccDt[NUM_FUSION_MODE];
+
     float mEstimatedGyroRate;
     nsecs_t mTargetDelayNs;
 
+    // Gyro events that came faster than mTargetDelayNs, integrated until there is enough of them
+    // for one prediction.
+    vec3_t mPendingGyroAngle;
+    float mPendingGyroDt;
+
     nsecs_t mGyroTime;
     nsecs_t mAccTime;
+    nsecs_t mMagTime;
+    nsecs_t mMagUpdateTime;
 
     SensorFusion();
 
+    void updateAccPeriod(int mode);
+
 public:
     void process(const sensors_event_t& event);
 
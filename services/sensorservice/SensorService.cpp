@@ -44,6 +44,7 @@
 #include "SensorDirectConnection.h"
 #include "SensorEventAckReceiver.h"
 #include "SensorEventConnection.h"
+#include "SensorEventSender.h"
 #include "SensorRecord.h"
 #include "SensorRegistrationInfo.h"
 
@@ -77,6 +78,8 @@ bool SensorService::sHmacGlobalKeyIsValid = false;
 #define SENSOR_SERVICE_DIR "/data/system/sensor_service"
 #define SENSOR_SERVICE_HMAC_KEY_FILE  SENSOR_SERVICE_DIR "/hmac_key"
 #define SENSOR_SERVICE_SCHED_FIFO_PRIORITY 10
+// The threads that help threadLoop() send events, besides threadLoop() itself.
+#define SENSOR_SERVICE_MAX_EVENT_SENDER_WORKERS 3
 
 // Permissions.
 static const String16 sDumpPermission("android.permission.DUMP");
@@ -133,6 +136,13 @@ void SensorService::enableSchedFifoMode() {
     if (sched_setscheduler(getTid(), SCHED_FIFO | SCHED_RESET_ON_FORK, &param) != 0) {
         ALOGE("Couldn't set SCHED_FIFO for SensorService thread");
     }
+    // The event sender workers take part in every poll of threadLoop().
+    const Vector<pid_t> tids = mEventSender->getWorkerTids();
+    for (size_t i = 0; i < tids.size(); i++) {
+        if (sched_setscheduler(tids[i], SCHED_FIFO | SCHED_RESET_ON_FORK, &param) != 0) {
+            ALOGE("Couldn't set SCHED_FIFO for SensorEventSender thread");
+        }
+    }
 }
 
 void SensorService::onFirstRef() {
@@ -264,6 +274,7 @@ void SensorService::onFirstRef() {
             }
 
             mWakeLockAcquired = false;
+            mSendingEvents = false;
             mLooper = new Looper(false);
             const size_t minBufferSize = SensorEventQueue::MAX_RECEIVE_BUFFER_EVENT_COUNT;
             mSensorEventBuffer = new sensors_event_t[minBufferSize];
@@ -277,6 +288,13 @@ void SensorService::onFirstRef() {
             }
 
             mInitCheck = NO_ERROR;
+            // threadLoop() sends events as well, so it takes one of the CPUs.
+            const long numCpus = sysconf(_SC_NPROCESSORS_CONF);
+            size_t numEventSenderWorkers = numCpus > 1 ? size_t(numCpus - 1) : 0;
+            if (numEventSenderWorkers > SENSOR_SERVICE_MAX_EVENT_SENDER_WORKERS) {
+                numEventSenderWorkers = SENSOR_SERVICE_MAX_EVENT_SENDER_WORKERS;
+            }
+            mEventSender = new SensorEventSender(numEventSenderWorkers);
             mAckReceiver = new SensorEventAckReceiver(this);
             mAckReceiver->run("SensorEventAckReceiver", PRIORITY_URGENT_DISPLAY);
             run("SensorService", PRIORITY_URGENT_DISPLAY);
@@ -646,12 +664,12 @@ bool SensorService::threadLoop() {
         SortedVector< sp<SensorEventConnection> > activeConnections;
         populateActiveConnections(&activeConnections);
 
-        Mutex::Autolock _l(mLock);
+        mLock.lock();
         // Poll has returned. Hold a wakelock if one of the events is from a wake up sensor. The
-        // rest of this loop is under a critical section protected by mLock. Acquiring a wakeLock,
-        // sending events to clients (incrementing SensorEventConnection::mWakeLockRefCount) should
-        // not be interleaved with decrementing SensorEventConnection::mWakeLockRefCount and
-        // releasing the wakelock.
+        // rest of this loop, except for sending the events, is under a critical section protected
+        // by mLock. Sending events to clients (incrementing
+        // SensorEventConnection::mWakeLockRefCount) must not be interleaved with releasing the
+        // wakelock, which mSendingEvents prevents while mLock is not held.
         bool bufferHasWakeUpEvent = false;
         for (int i = 0; i < count; i++) {
             if (isWakeUpSensorEvent(mSensorEventBuffer[i])) {
@@ -779,27 +797,29 @@ bool SensorService::threadLoop() {
             }
         }
 
-        // Send our events to clients. Check the state of wake lock for each client and release the
-        // lock if none of the clients need it.
-        bool needsWakeLock = false;
+        // Send our events to clients without mLock, so that apps registering, unregistering or
+        // acknowledging events don't hold each other up, nor the next poll. The wake lock is kept
+        // until all connections have counted the wake-up events they were sent.
+        mSendingEvents = true;
+        mLock.unlock();
+        mEventSender->sendEvents(activeConnections, mSensorEventBuffer, count,
+                mMapFlushEventsToConnections, mSensorEventScratch);
+
+        Mutex::Autolock _l(mLock);
+        mSendingEvents = false;
+
         size_t numConnections = activeConnections.size();
         for (size_t i=0 ; i < numConnections; ++i) {
-            if (activeConnections[i] != 0) {
-                activeConnections[i]->sendEvents(mSensorEventBuffer, count, mSensorEventScratch,
-                        mMapFlushEventsToConnections);
-                needsWakeLock |= activeConnections[i]->needsWakeLock();
-                // If the connection has one-shot sensors, it may be cleaned up after first trigger.
-                // Early check for one-shot sensors.
-                if (activeConnections[i]->hasOneShotSensors()) {
-                    cleanupAutoDisabledSensorLocked(activeConnections[i], mSensorEventBuffer,
-                            count);
-                }
+            // If the connection has one-shot sensors, it may be cleaned up after first trigger.
+            // Early check for one-shot sensors.
+            if (activeConnections[i] != 0 && activeConnections[i]->hasOneShotSensors()) {
+                cleanupAutoDisabledSensorLocked(activeConnections[i], mSensorEventBuffer, count);
             }
         }
 
-        if (mWakeLockAcquired && !needsWakeLock) {
-            setWakeLockAcquiredLocked(false);
-        }
+        // Check the state of wake lock for each client and release the lock if none of the
+        // clients need it. This also covers the checks skipped while the events were sent.
+        checkWakeLockStateLocked();
     } while (!Thread::exitPending());
 
     ALOGW("Exiting SensorService::threadLoop => aborting...");
@@ -1046,6 +1066,7 @@ sp<ISensorEventConnection> SensorService::createSensorEventConnection(const Stri
     if (requestedMode == DATA_INJECTION) {
         if (mActiveConnections.indexOf(result) < 0) {
             mActiveConnections.add(result);
+            publishActiveConnectionsLocked();
         }
         // Add the associated file descriptor to the Looper for polling whenever there is data to
         // be injected.
@@ -1286,6 +1307,7 @@ void SensorService::cleanupConnection(SensorEventConnection* c) {
     }
     c->updateLooperRegistration(mLooper);
     mActiveConnections.remove(connection);
+    publishActiveConnectionsLocked();
     BatteryService::cleanup(c->getUid());
     if (c->needsWakeLock()) {
         checkWakeLockStateLocked();
@@ -1370,6 +1392,7 @@ status_t SensorService::enable(const sp<SensorEventConnection>& connection,
         // so, see if this connection becomes active
         if (mActiveConnections.indexOf(connection) < 0) {
             mActiveConnections.add(connection);
+            publishActiveConnectionsLocked();
         }
     } else {
         ALOGW("sensor %08x already enabled in connection %p (ignoring)",
@@ -1470,6 +1493,7 @@ status_t SensorService::cleanupWithoutDisableLocked(
         if (connection->hasAnySensor() == false) {
             connection->updateLooperRegistration(mLooper);
             mActiveConnections.remove(connection);
+            publishActiveConnectionsLocked();
         }
         // see if this sensor becomes inactive
         if (rec->removeConnection(connection)) {
@@ -1587,7 +1611,8 @@ void SensorService::checkWakeLockState() {
 }
 
 void SensorService::checkWakeLockStateLocked() {
-    if (!mWakeLockAcquired) {
+    // threadLoop() checks once it is done sending events.
+    if (!mWakeLockAcquired || mSendingEvents) {
         return;
     }
     bool releaseLock = true;
@@ -1615,15 +1640,25 @@ void SensorService::sendEventsFromCache(const sp<SensorEventConnection>& connect
 
 void SensorService::populateActiveConnections(
         SortedVector< sp<SensorEventConnection> >* activeConnections) {
-    Mutex::Autolock _l(mLock);
-    for (size_t i=0 ; i < mActiveConnections.size(); ++i) {
-        sp<SensorEventConnection> connection(mActiveConnections[i].promote());
+    std::shared_ptr<const SortedVector< wp<SensorEventConnection> > > connections =
+            std::atomic_load(&mPublishedConnections);
+    if (connections == nullptr) {
+        return;
+    }
+    for (size_t i=0 ; i < connections->size(); ++i) {
+        sp<SensorEventConnection> connection((*connections)[i].promote());
         if (connection != 0) {
             activeConnections->add(connection);
         }
     }
 }
 
+void SensorService::publishActiveConnectionsLocked() {
+    std::atomic_store(&mPublishedConnections,
+            std::shared_ptr<const SortedVector< wp<SensorEventConnection> > >(
+                    new SortedVector< wp<SensorEventConnection> >(mActiveConnections)));
+}
+
 bool SensorService::isWhiteListedPackage(const String8& packageName) {
     return (packageName.contains(mWhiteListedPackage.string()));
 }
@@ -37,6 +37,7 @@
 
 #include <stdint.h>
 #include <sys/types.h>
+#include <memory>
 #include <unordered_map>
 #include <unordered_set>
 
@@ -95,6 +96,7 @@ private:
     // nested class/struct for internal use
     class SensorRecord;
     class SensorEventAckReceiver;
+    class SensorEventSender;
     class SensorRegistrationInfo;
 
     // If accessing a sensor we need to make sure the UID has access to it. If
@@ -239,9 +241,12 @@ private:
     void sendEventsFromCache(const sp<SensorEventConnection>& connection);
 
     // Promote all weak referecences in mActiveConnections vector to strong references and add them
-    // to the output vector.
+    // to the output vector. Reads the published copy of mActiveConnections, so mLock is not needed.
     void populateActiveConnections( SortedVector< sp<SensorEventConnection> >* activeConnections);
 
+    // Publishes a new copy of mActiveConnections. Must be called whenever it changes.
+    void publishActiveConnectionsLocked();
+
     // If SensorService is operating in RESTRICTED mode, only select whitelisted packages are
     // allowed to register for or call flush on sensors. Typically only cts test packages are
     // allowed.
@@ -285,6 +290,11 @@ private:
     uint32_t mSocketBufferSize;
     sp<Looper> mLooper;
     sp<SensorEventAckReceiver> mAckReceiver;
+    sp<SensorEventSender> mEventSender;
+
+    // A copy of mActiveConnections that is replaced, never modified, so that threadLoop() can
+    // read it without mLock. Accessed with std::atomic_load and std::atomic_store.
+    std::shared_ptr<const SortedVector< wp<SensorEventConnection> > > mPublishedConnections;
 
     // protected by mLock
     mutable Mutex mLock;
@@ -292,6 +302,8 @@ private:
     std::unordered_set<int> mActiveVirtualSensors;
     SortedVector< wp<SensorEventConnection> > mActiveConnections;
     bool mWakeLockAcquired;
+    // Set while threadLoop() sends events without mLock, during which the wake lock is kept.
+    bool mSendingEvents;
     sensors_event_t *mSensorEventBuffer, *mSensorEventScratch;
     wp<const SensorEventConnection> * mMapFlushEventsToConnections;
     std::unordered_map<int, RecentEventLogger*> mRecentEvent;
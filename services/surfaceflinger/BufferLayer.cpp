@@ -294,6 +294,9 @@ bool BufferLayer::onPreComposition(nsecs_t refreshStartTime) {
         mFrameEventHistory.addPreComposition(mCurrentFrameNumber,
                                              refreshStartTime);
     }
+    if (mFrameLatencyNeeded) {
+        mFrameTracker.setCompositionStartTime(refreshStartTime);
+    }
     mRefreshPending = false;
     return mQueuedFrames > 0 || mSidebandStreamChanged ||
             mAutoRefresh;
@@ -328,6 +331,10 @@ bool BufferLayer::onPostComposition(const std::shared_ptr<FenceTime>& glDoneFenc
         mFrameTracker.setFrameReadyTime(desiredPresentTime);
     }
 
+    if (glDoneFence->isValid()) {
+        mFrameTracker.setGpuCompositionDoneFence(std::shared_ptr<FenceTime>(glDoneFence));
+    }
+
     if (presentFence->isValid()) {
         mTimeStats.setPresentFence(layerName, mCurrentFrameNumber, presentFence);
         mFrameTracker.setActualPresentFence(std::shared_ptr<FenceTime>(presentFence));
@@ -366,8 +373,7 @@ void BufferLayer::releasePendingBuffer(nsecs_t dequeueReadyTime) {
 
     auto releaseFenceTime =
             std::make_shared<FenceTime>(mConsumer->getPrevFinalReleaseFence());
-    mReleaseTimeline.updateSignalTimes();
-    mReleaseTimeline.push(releaseFenceTime);
+    mFlinger->getReleaseTimeline().push(releaseFenceTime);
 
     Mutex::Autolock lock(mFrameEventHistoryMutex);
     if (mPreviousFrameNumber != 0) {
@@ -378,6 +384,8 @@ void BufferLayer::releasePendingBuffer(nsecs_t dequeueReadyTime) {
 
 Region BufferLayer::latchBuffer(bool& recomputeVisibleRegions, nsecs_t latchTime) {
     ATRACE_CALL();
+    mTracingDirty = true;
+    mProtoGeneration++;
 
     if (android_atomic_acquire_cas(true, false, &mSidebandStreamChanged) == 0) {
         // mSidebandStreamChanged was true
@@ -522,6 +530,7 @@ Region BufferLayer::latchBuffer(bool& recomputeVisibleRegions, nsecs_t latchTime
 
     mRefreshPending = true;
     mFrameLatencyNeeded = true;
+    mFrameTracker.setLatchTime(latchTime);
     if (oldBuffer == nullptr) {
         // the first time we receive a buffer, we need to trigger a
         // geometry invalidation.
@@ -553,6 +562,9 @@ Region BufferLayer::latchBuffer(bool& recomputeVisibleRegions, nsecs_t latchTime
         default:
             break;
     }
+    if (dataSpace != mCurrentDataSpace) {
+        mFlinger->mLayerDataspaceGeneration++;
+    }
     mCurrentDataSpace = dataSpace;
 
     Rect crop(mConsumer->getCurrentCrop());
@@ -707,6 +719,12 @@ void BufferLayer::onFirstRef() {
     sp<IGraphicBufferProducer> producer;
     sp<IGraphicBufferConsumer> consumer;
     BufferQueue::createBufferQueue(&producer, &consumer, true);
+    if (mFlinger->isLayerAdaptiveBufferCountEnabled()) {
+        consumer->setAdaptiveBufferCount(true);
+    }
+    if (mFlinger->isLayerBufferPreallocationEnabled()) {
+        consumer->setBufferPreallocation(true);
+    }
     mProducer = new MonitoredProducer(producer, mFlinger, this);
     {
         // Grab the SF state lock during this since it's the only safe way to access RenderEngine
@@ -717,6 +735,9 @@ void BufferLayer::onFirstRef() {
     mConsumer->setConsumerUsageBits(getEffectiveUsage(0));
     mConsumer->setContentsChangedListener(this);
     mConsumer->setName(mName);
+    if (mFlinger->isCadenceAwareLatchingEnabled()) {
+        mConsumer->setCadenceAwareLatching(true);
+    }
 
     if (mFlinger->isLayerTripleBufferingDisabled()) {
         mProducer->setMaxDequeuedBufferCount(2);
@@ -28,12 +28,18 @@
 
 #include <inttypes.h>
 
+#include <algorithm>
+#include <cstdlib>
+#include <iterator>
+
 #include <cutils/compiler.h>
 
 #include <hardware/hardware.h>
 
 #include <math/mat4.h>
 
+#include <ui/PixelFormat.h>
+
 #include <gui/BufferItem.h>
 #include <gui/GLConsumer.h>
 #include <gui/ISurfaceComposer.h>
@@ -145,9 +151,94 @@ nsecs_t BufferLayerConsumer::computeExpectedPresent(const DispSync& dispSync) {
         extraPadding = 1000000; // 1ms (6% of 60Hz)
     }
 
+    if (mCadenceAwareLatching) {
+        const nsecs_t period = dispSync.computeNextRefresh(hwcLatency + 1) - nextRefresh;
+        return nextRefresh + extraPadding + computeCadenceShift(nextRefresh + extraPadding, period);
+    }
     return nextRefresh + extraPadding;
 }
 
+void BufferLayerConsumer::setCadenceAwareLatching(bool enabled) {
+    mCadenceAwareLatching = enabled;
+    mCadenceTimestampCount = 0;
+    mNextCadenceTimestamp = 0;
+    mHasCadenceShift = false;
+}
+
+// A buffer is latched for the first refresh after its desired present time.
+// Content at 24fps on a 60Hz display has desired present times on two phases
+// of the refresh period, and when one of them sits right on the boundary,
+// timing noise sends its frames to either refresh. Moving the boundary to the
+// middle of the largest gap between the phases of recent frames keeps each
+// frame within half a period of its desired time, in a regular pattern.
+nsecs_t BufferLayerConsumer::computeCadenceShift(nsecs_t refresh, nsecs_t period) {
+    if (mCadenceTimestampCount < CADENCE_HISTORY_SIZE || period <= 0) {
+        mHasCadenceShift = false;
+        return 0;
+    }
+
+    // Only regular content slower than the display has a cadence to keep.
+    nsecs_t minInterval = INT64_MAX;
+    nsecs_t maxInterval = 0;
+    nsecs_t phases[CADENCE_HISTORY_SIZE];
+    for (size_t i = 0; i < CADENCE_HISTORY_SIZE; i++) {
+        const nsecs_t timestamp =
+                mCadenceTimestamps[(mNextCadenceTimestamp + i) % CADENCE_HISTORY_SIZE];
+        if (i > 0) {
+            const nsecs_t previous =
+                    mCadenceTimestamps[(mNextCadenceTimestamp + i - 1) % CADENCE_HISTORY_SIZE];
+            minInterval = std::min(minInterval, timestamp - previous);
+            maxInterval = std::max(maxInterval, timestamp - previous);
+        }
+        phases[i] = ((timestamp - refresh) % period + period) % period;
+    }
+    if (minInterval <= period || maxInterval - minInterval > period / 2) {
+        mHasCadenceShift = false;
+        return 0;
+    }
+
+    std::sort(std::begin(phases), std::end(phases));
+    nsecs_t gapStart = phases[CADENCE_HISTORY_SIZE - 1];
+    nsecs_t gap = phases[0] + period - gapStart;
+    for (size_t i = 1; i < CADENCE_HISTORY_SIZE; i++) {
+        if (phases[i] - phases[i - 1] > gap) {
+            gapStart = phases[i - 1];
+            gap = phases[i] - phases[i - 1];
+        }
+    }
+
+    // Moving the boundary from one gap to another changes the pattern, so
+    // keep it where it is while it stays half as clear as it could be.
+    if (mHasCadenceShift) {
+        const nsecs_t boundary = (mCadenceShift % period + period) % period;
+        nsecs_t clearance = period;
+        for (nsecs_t phase : phases) {
+            const nsecs_t distance = std::abs(phase - boundary);
+            clearance = std::min(clearance, std::min(distance, period - distance));
+        }
+        if (clearance >= gap / 4) {
+            return mCadenceShift;
+        }
+    }
+
+    mCadenceShift = (gapStart + gap / 2) % period;
+    if (mCadenceShift > period / 2) {
+        mCadenceShift -= period;
+    }
+    mHasCadenceShift = true;
+    return mCadenceShift;
+}
+
+void BufferLayerConsumer::addCadenceTimestamp(const BufferItem& item) {
+    if (item.mIsAutoTimestamp) {
+        mCadenceTimestampCount = 0;
+        return;
+    }
+    mCadenceTimestamps[mNextCadenceTimestamp] = item.mTimestamp;
+    mNextCadenceTimestamp = (mNextCadenceTimestamp + 1) % CADENCE_HISTORY_SIZE;
+    mCadenceTimestampCount = std::min(mCadenceTimestampCount + 1, CADENCE_HISTORY_SIZE);
+}
+
 status_t BufferLayerConsumer::updateTexImage(BufferRejecter* rejecter, const DispSync& dispSync,
                                              bool* autoRefresh, bool* queuedBuffer,
                                              uint64_t maxFrameNumber) {
@@ -200,6 +291,10 @@ status_t BufferLayerConsumer::updateTexImage(BufferRejecter* rejecter, const Dis
         return BUFFER_REJECTED;
     }
 
+    if (mCadenceAwareLatching) {
+        addCadenceTimestamp(item);
+    }
+
     // Release the previous buffer.
     err = updateAndReleaseLocked(item, &mPendingRelease);
     if (err != NO_ERROR) {
@@ -274,7 +369,7 @@ status_t BufferLayerConsumer::acquireBufferLocked(BufferItem* item, nsecs_t pres
     // before, so any prior EglImage created is using a stale buffer. This
     // replaces any old EglImage with a new one (using the new buffer).
     if (item->mGraphicBuffer != nullptr) {
-        mImages[item->mSlot] = new Image(item->mGraphicBuffer, mRE);
+        mImages[item->mSlot] = sImageCache.acquire(item->mGraphicBuffer, mRE, this);
     }
 
     return NO_ERROR;
@@ -590,6 +685,7 @@ void BufferLayerConsumer::abandonLocked() {
     BLC_LOGV("abandonLocked");
     mCurrentTextureImage.clear();
     ConsumerBase::abandonLocked();
+    sImageCache.releaseUnused(this);
 }
 
 status_t BufferLayerConsumer::setConsumerUsageBits(uint64_t usage) {
@@ -641,4 +737,55 @@ status_t BufferLayerConsumer::Image::createIfNeeded(const Rect& imageCrop) {
     return mCreated ? OK : UNKNOWN_ERROR;
 }
 
+BufferLayerConsumer::ImageCache BufferLayerConsumer::sImageCache;
+
+sp<BufferLayerConsumer::Image> BufferLayerConsumer::ImageCache::acquire(
+        const sp<GraphicBuffer>& graphicBuffer, RE::RenderEngine& engine,
+        const BufferLayerConsumer* owner) {
+    // budget for the buffers kept alive by the cache
+    constexpr size_t kMaxSize = 32 * 1024 * 1024;
+
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    const uint64_t bufferId = graphicBuffer->getId();
+    auto found = mEntriesById.find(bufferId);
+    if (found != mEntriesById.end()) {
+        auto entry = found->second;
+        entry->owner = owner;
+        mEntries.splice(mEntries.begin(), mEntries, entry);
+        return entry->image;
+    }
+
+    // YUV formats report 0 bytes per pixel, count them as 2
+    const size_t size = static_cast<size_t>(graphicBuffer->getStride()) *
+            graphicBuffer->getHeight() *
+            std::max<ssize_t>(bytesPerPixel(graphicBuffer->getPixelFormat()), 2);
+    sp<Image> image = new Image(graphicBuffer, engine);
+    mEntries.push_front({bufferId, size, image, owner});
+    mEntriesById[bufferId] = mEntries.begin();
+    mSize += size;
+
+    while (mSize > kMaxSize && mEntries.size() > 1) {
+        eraseLocked(std::prev(mEntries.end()));
+    }
+    return image;
+}
+
+void BufferLayerConsumer::ImageCache::releaseUnused(const BufferLayerConsumer* owner) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    for (auto entry = mEntries.begin(); entry != mEntries.end();) {
+        auto next = std::next(entry);
+        if (entry->owner == owner && entry->image->getStrongCount() == 1) {
+            eraseLocked(entry);
+        }
+        entry = next;
+    }
+}
+
+void BufferLayerConsumer::ImageCache::eraseLocked(std::list<Entry>::iterator entry) {
+    mSize -= entry->size;
+    mEntriesById.erase(entry->bufferId);
+    mEntries.erase(entry);
+}
+
 }; // namespace android
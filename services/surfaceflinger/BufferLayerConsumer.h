@@ -30,6 +30,10 @@
 #include <utils/Vector.h>
 #include <utils/threads.h>
 
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
 namespace android {
 // ----------------------------------------------------------------------------
 
@@ -82,6 +86,12 @@ public:
 
     nsecs_t computeExpectedPresent(const DispSync& dispSync);
 
+    // Makes computeExpectedPresent() move the refresh boundary away from the
+    // desired present times of regular content slower than the display, so
+    // that each buffer lands on the refresh nearest to it in a steady
+    // pulldown pattern instead of jittering between two refreshes.
+    void setCadenceAwareLatching(bool enabled);
+
     // updateTexImage acquires the most recently queued buffer, and sets the
     // image contents of the target texture to it.
     //
@@ -254,6 +264,39 @@ private:
         int32_t mCropHeight;
     };
 
+    // ImageCache keeps the Images of recently acquired buffers alive, keyed by
+    // GraphicBuffer::getId() and shared by all consumers. A buffer acquired
+    // again after its slot was freed, e.g. because the producer detaches and
+    // attaches its buffers, then reuses its RE::Image instead of creating a
+    // new one. The least recently acquired images are dropped once the
+    // buffers they hold exceed a fixed budget.
+    class ImageCache {
+    public:
+        sp<Image> acquire(const sp<GraphicBuffer>& graphicBuffer, RE::RenderEngine& engine,
+                          const BufferLayerConsumer* owner);
+
+        // drops the images last acquired by owner that nothing else uses
+        void releaseUnused(const BufferLayerConsumer* owner);
+
+    private:
+        struct Entry {
+            uint64_t bufferId;
+            size_t size;
+            sp<Image> image;
+            const BufferLayerConsumer* owner;
+        };
+
+        void eraseLocked(std::list<Entry>::iterator entry);
+
+        std::mutex mMutex;
+        // most recently acquired first
+        std::list<Entry> mEntries;
+        std::unordered_map<uint64_t, std::list<Entry>::iterator> mEntriesById;
+        size_t mSize = 0;
+    };
+
+    static ImageCache sImageCache;
+
     // freeBufferLocked frees up the given buffer slot. If the slot has been
     // initialized this will release the reference to the GraphicBuffer in
     // that slot and destroy the RE::Image in that slot.  Otherwise it has no
@@ -384,6 +427,19 @@ private:
     // A release that is pending on the receipt of a new release fence from
     // presentDisplay
     PendingRelease mPendingRelease;
+
+    // Desired present times of the last buffers latched, oldest first once
+    // full. Only used on the main thread, with cadence-aware latching.
+    static constexpr size_t CADENCE_HISTORY_SIZE = 8;
+    nsecs_t computeCadenceShift(nsecs_t refresh, nsecs_t period);
+    void addCadenceTimestamp(const BufferItem& item);
+    bool mCadenceAwareLatching = false;
+    nsecs_t mCadenceTimestamps[CADENCE_HISTORY_SIZE] = {};
+    size_t mCadenceTimestampCount = 0;
+    size_t mNextCadenceTimestamp = 0;
+    // how far the refresh boundary is moved, while the cadence holds
+    bool mHasCadenceShift = false;
+    nsecs_t mCadenceShift = 0;
 };
 
 // ----------------------------------------------------------------------------
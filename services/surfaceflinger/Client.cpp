@@ -17,10 +17,18 @@
 #include <stdint.h>
 #include <sys/types.h>
 
+#include <binder/Parcel.h>
 #include <binder/PermissionCache.h>
 #include <binder/IPCThreadState.h>
 
+#include <cutils/native_handle.h>
+
+#include <gui/LayerState.h>
+
 #include <private/android_filesystem_config.h>
+#include <private/gui/TransactionChannel.h>
+
+#include <utils/NativeHandle.h>
 
 #include "Client.h"
 #include "Layer.h"
@@ -32,6 +40,9 @@ namespace android {
 
 const String16 sAccessSurfaceFlinger("android.permission.ACCESS_SURFACE_FLINGER");
 
+// Room for a few hundred small transactions
+static const size_t TRANSACTION_CHANNEL_CAPACITY = 32 * 1024;
+
 // ---------------------------------------------------------------------------
 
 Client::Client(const sp<SurfaceFlinger>& flinger)
@@ -41,6 +52,7 @@ Client::Client(const sp<SurfaceFlinger>& flinger)
 
 Client::Client(const sp<SurfaceFlinger>& flinger, const sp<Layer>& parentLayer)
     : mFlinger(flinger),
+      mPid(IPCThreadState::self()->getCallingPid()),
       mParentLayer(parentLayer)
 {
 }
@@ -63,6 +75,10 @@ Client::~Client()
             flinger->removeLayer(l);
         }));
     }
+
+    if (mTransactionChannel != nullptr) {
+        mFlinger->unregisterTransactionChannel(mTransactionChannel->getEventFd());
+    }
 }
 
 void Client::updateParent(const sp<Layer>& parentLayer) {
@@ -101,7 +117,13 @@ void Client::detachLayer(const Layer* layer)
     const size_t count = mLayers.size();
     for (size_t i=0 ; i<count ; i++) {
         if (mLayers.valueAt(i) == layer) {
+            const wp<IBinder> handle = mLayers.keyAt(i);
             mLayers.removeItemsAt(i, 1);
+            for (size_t j = mChannelLayers.size(); j > 0; j--) {
+                if (mChannelLayers.valueAt(j - 1) == handle) {
+                    mChannelLayers.removeItemsAt(j - 1, 1);
+                }
+            }
             break;
         }
     }
@@ -196,5 +218,84 @@ status_t Client::getLayerFrameStats(const sp<IBinder>& handle, FrameStats* outSt
     return NO_ERROR;
 }
 
+status_t Client::createTransactionChannel(sp<NativeHandle>* outHandle) {
+    // the reply always carries a handle, so a refusal is one without file descriptors
+    *outHandle = NativeHandle::create(native_handle_create(0, 0), true);
+    if (!mFlinger->mTransactionChannelsEnabled) {
+        return INVALID_OPERATION;
+    }
+
+    sp<NativeHandle> handle;
+    {
+        Mutex::Autolock _l(mLock);
+        // a channel only has room for one writer
+        if (mTransactionChannel != nullptr) {
+            return ALREADY_EXISTS;
+        }
+        sp<TransactionChannel> channel = TransactionChannel::create(TRANSACTION_CHANNEL_CAPACITY);
+        handle = channel != nullptr ? channel->getHandle() : nullptr;
+        if (handle == nullptr) {
+            return NO_MEMORY;
+        }
+        mTransactionChannel = channel;
+    }
+
+    mFlinger->registerTransactionChannel(this, mTransactionChannel->getEventFd());
+    *outHandle = handle;
+    return NO_ERROR;
+}
+
+status_t Client::getLayerChannelId(const sp<IBinder>& handle, int32_t* outId) const {
+    Mutex::Autolock _l(mLock);
+    if (mLayers.indexOfKey(handle) < 0) {
+        return NAME_NOT_FOUND;
+    }
+    *outId = mNextChannelLayerId++;
+    mChannelLayers.add(*outId, handle);
+    return NO_ERROR;
+}
+
+void Client::readChannelTransactions(std::vector<Vector<ComposerState>>& outTransactions) {
+    sp<TransactionChannel> channel;
+    {
+        Mutex::Autolock _l(mLock);
+        channel = mTransactionChannel;
+    }
+    if (channel == nullptr) {
+        return;
+    }
+
+    channel->clearSignal();
+    while (channel->read(&mChannelRecord) == NO_ERROR) {
+        Parcel record;
+        record.setData(mChannelRecord.data(), mChannelRecord.size());
+
+        Vector<ComposerState> states;
+        const uint32_t count = record.readUint32();
+        for (uint32_t i = 0; i < count && record.dataAvail() > 0; i++) {
+            const int32_t id = record.readInt32();
+            ComposerState state;
+            if (state.state.read(record) != NO_ERROR) {
+                break;
+            }
+            if (state.state.what & TransactionChannel::BINDER_CHANGES) {
+                ALOGE("Transaction channel record refers to binders");
+                continue;
+            }
+
+            Mutex::Autolock _l(mLock);
+            state.state.surface = mChannelLayers.valueFor(id).promote();
+            if (state.state.surface == nullptr) {
+                continue;
+            }
+            state.client = this;
+            states.add(state);
+        }
+        if (!states.isEmpty()) {
+            outTransactions.push_back(states);
+        }
+    }
+}
+
 // ---------------------------------------------------------------------------
 }; // namespace android
@@ -20,9 +20,12 @@
 #include <stdint.h>
 #include <sys/types.h>
 
+#include <vector>
+
 #include <utils/Errors.h>
 #include <utils/KeyedVector.h>
 #include <utils/Mutex.h>
+#include <utils/Vector.h>
 
 #include <gui/ISurfaceComposerClient.h>
 
@@ -32,6 +35,8 @@ namespace android {
 
 class Layer;
 class SurfaceFlinger;
+class TransactionChannel;
+struct ComposerState;
 
 // ---------------------------------------------------------------------------
 
@@ -51,8 +56,16 @@ public:
 
     sp<Layer> getLayerUser(const sp<IBinder>& handle) const;
 
+    // The process that connected
+    pid_t getPid() const { return mPid; }
+
     void updateParent(const sp<Layer>& parentLayer);
 
+    // Appends the transactions written to the transaction channel since the last call to
+    // outTransactions, leaving out the states of layers that are gone.
+    // protected by SurfaceFlinger::mTransactionQueueMutex
+    void readChannelTransactions(std::vector<Vector<ComposerState>>& outTransactions);
+
 private:
     // ISurfaceComposerClient interface
     virtual status_t createSurface(
@@ -68,6 +81,10 @@ private:
 
     virtual status_t getLayerFrameStats(const sp<IBinder>& handle, FrameStats* outStats) const;
 
+    virtual status_t createTransactionChannel(sp<NativeHandle>* outHandle);
+
+    virtual status_t getLayerChannelId(const sp<IBinder>& handle, int32_t* outId) const;
+
     virtual status_t onTransact(
         uint32_t code, const Parcel& data, Parcel* reply, uint32_t flags);
 
@@ -75,10 +92,17 @@ private:
 
     // constant
     sp<SurfaceFlinger> mFlinger;
+    const pid_t mPid;
 
     // protected by mLock
     DefaultKeyedVector< wp<IBinder>, wp<Layer> > mLayers;
     wp<Layer> mParentLayer;
+    mutable DefaultKeyedVector< int32_t, wp<IBinder> > mChannelLayers;
+    mutable int32_t mNextChannelLayerId = 0;
+    sp<TransactionChannel> mTransactionChannel;
+
+    // protected by SurfaceFlinger::mTransactionQueueMutex
+    std::vector<uint8_t> mChannelRecord;
 
     // thread-safe
     mutable Mutex mLock;
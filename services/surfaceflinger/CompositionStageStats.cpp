@@ -0,0 +1,86 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#undef LOG_TAG
+#define LOG_TAG "CompositionStageStats"
+
+#include "CompositionStageStats.h"
+
+#include <inttypes.h>
+
+#include <utils/String8.h>
+
+namespace android {
+
+static const char* stageName(size_t stage) {
+    switch (static_cast<CompositionStageStats::Stage>(stage)) {
+        case CompositionStageStats::Stage::HandleMessageTransaction:
+            return "handleMessageTransaction";
+        case CompositionStageStats::Stage::RebuildLayerStacks:
+            return "rebuildLayerStacks";
+        case CompositionStageStats::Stage::SetUpHWComposer:
+            return "setUpHWComposer";
+        case CompositionStageStats::Stage::DoComposition:
+            return "doComposition";
+        case CompositionStageStats::Stage::PostComposition:
+            return "postComposition";
+        default:
+            return "unknown";
+    }
+}
+
+void CompositionStageStats::enable() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mEnabled) return;
+    mStageTimes.fill(StageTime());
+    mEnabled = true;
+}
+
+void CompositionStageStats::disable() {
+    mEnabled = false;
+}
+
+void CompositionStageStats::clear() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mStageTimes.fill(StageTime());
+}
+
+nsecs_t CompositionStageStats::begin() const {
+    return isEnabled() ? systemTime(SYSTEM_TIME_THREAD) : 0;
+}
+
+nsecs_t CompositionStageStats::end(Stage stage, nsecs_t start) {
+    // a stage begun before the stats were enabled isn't accounted
+    if (!start || !isEnabled()) return 0;
+    const nsecs_t now = systemTime(SYSTEM_TIME_THREAD);
+    const nsecs_t duration = now - start;
+    std::lock_guard<std::mutex> lock(mMutex);
+    StageTime& time = mStageTimes[static_cast<size_t>(stage)];
+    time.count++;
+    time.total += duration;
+    if (duration > time.max) time.max = duration;
+    return now;
+}
+
+void CompositionStageStats::dump(String8& result) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    for (size_t i = 0; i < mStageTimes.size(); i++) {
+        const StageTime& time = mStageTimes[i];
+        result.appendFormat("%s: count=%" PRIu64 " total=%" PRId64 " max=%" PRId64 "\n",
+                            stageName(i), time.count, time.total, time.max);
+    }
+}
+
+}  // namespace android
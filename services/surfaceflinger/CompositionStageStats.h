@@ -0,0 +1,65 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <utils/Timers.h>
+#include <array>
+#include <atomic>
+#include <mutex>
+
+namespace android {
+class String8;
+
+// Thread CPU time the main thread spends in each stage of composing a frame,
+// accumulated while enabled with dumpsys SurfaceFlinger --enable-composition-stages
+class CompositionStageStats {
+public:
+    enum class Stage {
+        HandleMessageTransaction,
+        RebuildLayerStacks,
+        SetUpHWComposer,
+        DoComposition,
+        PostComposition,
+        Count,
+    };
+
+    void enable();
+    void disable();
+    void clear();
+    bool isEnabled() const { return mEnabled.load(std::memory_order_relaxed); }
+    // Returns the time to pass to end() when the stage is over, 0 if disabled
+    nsecs_t begin() const;
+    // Accounts the stage begun at |start|, and returns the time that the
+    // next stage would begin at
+    nsecs_t end(Stage stage, nsecs_t start);
+    // One line per stage: "<stage>: count=<n> total=<ns> max=<ns>"
+    void dump(String8& result);
+
+private:
+    struct StageTime {
+        uint64_t count = 0;
+        nsecs_t total = 0;
+        nsecs_t max = 0;
+    };
+
+    std::atomic<bool> mEnabled{false};
+    // Protect mStageTimes, which end() updates from the main thread
+    std::mutex mMutex;
+    std::array<StageTime, static_cast<size_t>(Stage::Count)> mStageTimes;
+};
+
+}  // namespace android
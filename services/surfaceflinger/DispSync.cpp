@@ -56,6 +56,12 @@ static const bool kEnableZeroPhaseTracer = false;
 // present time and the nearest software-predicted vsync.
 static const nsecs_t kErrorThreshold = 160000000000; // 400 usec squared
 
+// Resync samples further than this from the fitted vsync timeline are always
+// kept; beyond it, a sample is dropped as an outlier if it is also several
+// times further off than the typical sample.
+static const nsecs_t kMinOutlierResidual = 100000; // 100 usec
+static const double kOutlierResidualScale = 5.0;
+
 #undef LOG_TAG
 #define LOG_TAG "DispSyncThread"
 class DispSyncThread : public Thread {
@@ -433,6 +439,8 @@ void DispSync::reset() {
     mNumResyncSamples = 0;
     mFirstResyncSample = 0;
     mNumResyncSamplesSincePresent = 0;
+    mModelResidual = 0;
+    mNumResyncOutliers = 0;
     resetErrorLocked();
 }
 
@@ -531,6 +539,23 @@ void DispSync::setPeriod(nsecs_t period) {
     mThread->updateModel(mPeriod, mPhase, mReferenceTime);
 }
 
+void DispSync::changePeriod(nsecs_t period) {
+    Mutex::Autolock lock(mMutex);
+    if (mPeriod > 0) {
+        nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+        nsecs_t phase = mReferenceTime + mPhase;
+        mReferenceTime = ((now - phase) / mPeriod + 1) * mPeriod + phase;
+    }
+    mPeriod = period;
+    mPhase = 0;
+    mModelUpdated = false;
+    mNumResyncSamples = 0;
+    mFirstResyncSample = 0;
+    mNumResyncSamplesSincePresent = 0;
+    resetErrorLocked();
+    mThread->updateModel(mPeriod, mPhase, mReferenceTime);
+}
+
 nsecs_t DispSync::getPeriod() {
     // lock mutex as mPeriod changes multiple times in updateModelLocked
     Mutex::Autolock lock(mMutex);
@@ -541,51 +566,108 @@ void DispSync::updateModelLocked() {
     ALOGV("[%s] updateModelLocked %zu", mName, mNumResyncSamples);
     if (mNumResyncSamples >= MIN_RESYNC_SAMPLES_FOR_UPDATE) {
         ALOGV("[%s] Computing...", mName);
-        nsecs_t durationSum = 0;
-        nsecs_t minDuration = INT64_MAX;
-        nsecs_t maxDuration = 0;
+        const nsecs_t first = mResyncSamples[mFirstResyncSample];
+
+        // Start from the median duration between samples, which a few bad
+        // timestamps cannot skew.
+        nsecs_t durations[MAX_RESYNC_SAMPLES];
+        size_t numDurations = 0;
         for (size_t i = 1; i < mNumResyncSamples; i++) {
             size_t idx = (mFirstResyncSample + i) % MAX_RESYNC_SAMPLES;
             size_t prev = (idx + MAX_RESYNC_SAMPLES - 1) % MAX_RESYNC_SAMPLES;
-            nsecs_t duration = mResyncSamples[idx] - mResyncSamples[prev];
-            durationSum += duration;
-            minDuration = min(minDuration, duration);
-            maxDuration = max(maxDuration, duration);
+            durations[numDurations++] = mResyncSamples[idx] - mResyncSamples[prev];
+        }
+        std::nth_element(durations, durations + numDurations / 2, durations + numDurations);
+        const nsecs_t estimate = durations[numDurations / 2];
+        if (estimate <= 0) {
+            return;
         }
 
-        // Exclude the min and max from the average
-        durationSum -= minDuration + maxDuration;
-        mPeriod = durationSum / (mNumResyncSamples - 3);
+        // Number each sample by the vsync it belongs to, so a missed vsync does
+        // not read as a long period, and fit a line through them. Samples far
+        // off that line are dropped and the line is fit again without them.
+        double vsyncs[MAX_RESYNC_SAMPLES];
+        double times[MAX_RESYNC_SAMPLES];
+        bool inliers[MAX_RESYNC_SAMPLES];
+        for (size_t i = 0; i < mNumResyncSamples; i++) {
+            size_t idx = (mFirstResyncSample + i) % MAX_RESYNC_SAMPLES;
+            times[i] = double(mResyncSamples[idx] - first);
+            vsyncs[i] = round(times[i] / double(estimate));
+            inliers[i] = true;
+        }
 
-        ALOGV("[%s] mPeriod = %" PRId64, mName, ns2us(mPeriod));
+        double slope = 0;
+        double intercept = 0;
+        double residualSum = 0;
+        size_t numInliers = 0;
+        for (int pass = 0; pass < 2; pass++) {
+            double sumX = 0, sumY = 0, sumXX = 0, sumXY = 0;
+            numInliers = 0;
+            for (size_t i = 0; i < mNumResyncSamples; i++) {
+                if (!inliers[i]) {
+                    continue;
+                }
+                sumX += vsyncs[i];
+                sumY += times[i];
+                sumXX += vsyncs[i] * vsyncs[i];
+                sumXY += vsyncs[i] * times[i];
+                numInliers++;
+            }
+            double denominator = numInliers * sumXX - sumX * sumX;
+            if (numInliers < MIN_RESYNC_SAMPLES_FOR_UPDATE / 2 || denominator <= 0) {
+                ALOGV("[%s] Too few consistent samples to update the model", mName);
+                return;
+            }
+            slope = (numInliers * sumXY - sumX * sumY) / denominator;
+            intercept = (sumY - slope * sumX) / numInliers;
+
+            double residuals[MAX_RESYNC_SAMPLES];
+            residualSum = 0;
+            for (size_t i = 0; i < mNumResyncSamples; i++) {
+                residuals[i] = fabs(times[i] - (intercept + slope * vsyncs[i]));
+                if (inliers[i]) {
+                    residualSum += residuals[i] * residuals[i];
+                }
+            }
+            if (pass > 0) {
+                break;
+            }
 
-        double sampleAvgX = 0;
-        double sampleAvgY = 0;
-        double scale = 2.0 * M_PI / double(mPeriod);
-        // Intentionally skip the first sample
-        for (size_t i = 1; i < mNumResyncSamples; i++) {
-            size_t idx = (mFirstResyncSample + i) % MAX_RESYNC_SAMPLES;
-            nsecs_t sample = mResyncSamples[idx] - mReferenceTime;
-            double samplePhase = double(sample % mPeriod) * scale;
-            sampleAvgX += cos(samplePhase);
-            sampleAvgY += sin(samplePhase);
+            double sorted[MAX_RESYNC_SAMPLES];
+            std::copy(residuals, residuals + mNumResyncSamples, sorted);
+            std::nth_element(sorted, sorted + mNumResyncSamples / 2, sorted + mNumResyncSamples);
+            double limit = max(double(kMinOutlierResidual),
+                               kOutlierResidualScale * sorted[mNumResyncSamples / 2]);
+            for (size_t i = 0; i < mNumResyncSamples; i++) {
+                inliers[i] = residuals[i] <= limit;
+            }
         }
 
-        sampleAvgX /= double(mNumResyncSamples - 1);
-        sampleAvgY /= double(mNumResyncSamples - 1);
+        if (slope < 1.0) {
+            return;
+        }
 
-        mPhase = nsecs_t(atan2(sampleAvgY, sampleAvgX) / scale);
+        mPeriod = nsecs_t(slope);
+        mModelResidual = nsecs_t(sqrt(residualSum / numInliers));
+        mNumResyncOutliers = mNumResyncSamples - numInliers;
 
-        ALOGV("[%s] mPhase = %" PRId64, mName, ns2us(mPhase));
+        ALOGV("[%s] mPeriod = %" PRId64 " (residual %" PRId64 ", %zu outliers)", mName,
+              ns2us(mPeriod), ns2us(mModelResidual), mNumResyncOutliers);
 
-        if (mPhase < -(mPeriod / 2)) {
+        mPhase = (first + nsecs_t(intercept) - mReferenceTime) % mPeriod;
+        if (mPhase < 0) {
             mPhase += mPeriod;
-            ALOGV("[%s] Adjusting mPhase -> %" PRId64, mName, ns2us(mPhase));
+        }
+        if (mPhase > mPeriod / 2) {
+            mPhase -= mPeriod;
         }
 
+        ALOGV("[%s] mPhase = %" PRId64, mName, ns2us(mPhase));
+
         if (kTraceDetailedInfo) {
             ATRACE_INT64("DispSync:Period", mPeriod);
             ATRACE_INT64("DispSync:Phase", mPhase + mPeriod / 2);
+            ATRACE_INT64("DispSync:Residual", mModelResidual);
         }
 
         // Artificially inflate the period if requested.
@@ -607,6 +689,7 @@ void DispSync::updateErrorLocked() {
 
     int numErrSamples = 0;
     nsecs_t sqErrSum = 0;
+    nsecs_t maxSqErr = 0;
 
     for (size_t i = 0; i < NUM_PRESENT_SAMPLES; i++) {
         // Only check for the cached value of signal time to avoid unecessary
@@ -628,9 +711,17 @@ void DispSync::updateErrorLocked() {
             sampleErr -= period;
         }
         sqErrSum += sampleErr * sampleErr;
+        maxSqErr = max(maxSqErr, sampleErr * sampleErr);
         numErrSamples++;
     }
 
+    // A single late present, e.g. from a missed frame, says little about the
+    // model, so drop the worst sample once there are enough to compare.
+    if (numErrSamples >= MIN_PRESENT_SAMPLES_FOR_TRIMMING) {
+        sqErrSum -= maxSqErr;
+        numErrSamples--;
+    }
+
     if (numErrSamples > 0) {
         mError = sqErrSum / numErrSamples;
         mZeroErrSamplesCount = 0;
@@ -670,6 +761,8 @@ void DispSync::dump(String8& result) const {
                         1000000000.0 / mPeriod, mRefreshSkipCount);
     result.appendFormat("mPhase: %" PRId64 " ns\n", mPhase);
     result.appendFormat("mError: %" PRId64 " ns (sqrt=%.1f)\n", mError, sqrt(mError));
+    result.appendFormat("mModelResidual: %" PRId64 " ns rms (%zu of %zu resync samples rejected)\n",
+                        mModelResidual, mNumResyncOutliers, mNumResyncSamples);
     result.appendFormat("mNumResyncSamplesSincePresent: %d (limit %d)\n",
                         mNumResyncSamplesSincePresent, MAX_RESYNC_SAMPLES_WITHOUT_PRESENT);
     result.appendFormat("mNumResyncSamples: %zd (max %d)\n", mNumResyncSamples, MAX_RESYNC_SAMPLES);
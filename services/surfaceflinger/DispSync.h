@@ -93,6 +93,13 @@ public:
     // turned on.  It should NOT be used after that.
     void setPeriod(nsecs_t period);
 
+    // changePeriod moves a running model to a new period, e.g. after the
+    // display switched refresh rates.  The software vsync timeline continues
+    // from the next predicted vsync instead of restarting at phase zero, and
+    // the samples taken at the old period are dropped, so the next resync
+    // only has to correct the phase.
+    void changePeriod(nsecs_t period);
+
     // The getPeriod method returns the current vsync period.
     nsecs_t getPeriod();
 
@@ -135,6 +142,7 @@ private:
     enum { MAX_RESYNC_SAMPLES = 32 };
     enum { MIN_RESYNC_SAMPLES_FOR_UPDATE = 6 };
     enum { NUM_PRESENT_SAMPLES = 8 };
+    enum { MIN_PRESENT_SAMPLES_FOR_TRIMMING = 4 };
     enum { MAX_RESYNC_SAMPLES_WITHOUT_PRESENT = 4 };
     enum { ACCEPTABLE_ZERO_ERR_SAMPLES_COUNT = 64 };
 
@@ -157,6 +165,12 @@ private:
     // mPresentFences array.
     nsecs_t mError;
 
+    // mModelResidual is the RMS distance, in nanoseconds, of the resync
+    // samples used for the model from the vsync times it predicts, and
+    // mNumResyncOutliers is the number of resync samples the model ignored.
+    nsecs_t mModelResidual;
+    size_t mNumResyncOutliers;
+
     // mZeroErrSamplesCount keeps track of how many times in a row there were
     // zero timestamps available in the mPresentFences array.
     // Used to sanity check that we are able to calculate the model error.
@@ -302,6 +302,7 @@ DisplayDevice::~DisplayDevice() = default;
 
 void DisplayDevice::disconnect(HWComposer& hwc) {
     if (mHwcDisplayId >= 0) {
+        clearFlattenedLayers(hwc);
         hwc.disconnectDisplay(mHwcDisplayId);
         mHwcDisplayId = -1;
     }
@@ -402,12 +403,31 @@ const sp<Fence>& DisplayDevice::getClientTargetAcquireFence() const {
 
 void DisplayDevice::setVisibleLayersSortedByZ(const Vector< sp<Layer> >& layers) {
     mVisibleLayersSortedByZ = layers;
+    mHasBestDataspace = false;
 }
 
 const Vector< sp<Layer> >& DisplayDevice::getVisibleLayersSortedByZ() const {
     return mVisibleLayersSortedByZ;
 }
 
+bool DisplayDevice::getBestDataspace(uint32_t layerDataspaceGeneration,
+                                     Dataspace* outDataspace, Dataspace* outHdrDataspace) const {
+    if (!mHasBestDataspace || mBestDataspaceGeneration != layerDataspaceGeneration) {
+        return false;
+    }
+    *outDataspace = mBestDataspace;
+    *outHdrDataspace = mBestHdrDataspace;
+    return true;
+}
+
+void DisplayDevice::setBestDataspace(uint32_t layerDataspaceGeneration, Dataspace dataspace,
+                                     Dataspace hdrDataspace) {
+    mHasBestDataspace = true;
+    mBestDataspaceGeneration = layerDataspaceGeneration;
+    mBestDataspace = dataspace;
+    mBestHdrDataspace = hdrDataspace;
+}
+
 void DisplayDevice::setLayersNeedingFences(const Vector< sp<Layer> >& layers) {
     mLayersNeedingFences = layers;
 }
@@ -428,6 +448,144 @@ Region DisplayDevice::getDirtyRegion(bool repaintEverything) const {
     return dirty;
 }
 
+bool DisplayDevice::updateCompositionSignature(CompositionSignature&& signature) const {
+    const bool changed = signature.layers != mCompositionSignature.layers ||
+            memcmp(signature.colorMatrix.asArray(), mCompositionSignature.colorMatrix.asArray(),
+                   sizeof(mat4)) != 0 ||
+            signature.dataspace != mCompositionSignature.dataspace ||
+            signature.renderIntent != mCompositionSignature.renderIntent;
+    mCompositionSignature = std::move(signature);
+    return changed;
+}
+
+Region DisplayDevice::getClientTargetRedrawRegion(const Region& damage,
+                                                  bool reuseContents) const {
+    // deeper buffer queues than this are not worth tracking
+    constexpr size_t kMaxClientTargetAge = 4;
+
+    const Region bounds(getBounds());
+    const int32_t age = reuseContents ? mSurface->queryBufferAge() : 0;
+    Region redraw(bounds);
+    if (age > 0 && static_cast<size_t>(age) <= mClientTargetDamage.size() + 1) {
+        // the back buffer holds the frame from |age| swaps ago, bring it up
+        // to date with the damage of every frame since
+        redraw = damage;
+        for (int32_t i = 0; i < age - 1; i++) {
+            redraw.orSelf(mClientTargetDamage[i]);
+        }
+        redraw.andSelf(bounds);
+    }
+
+    mClientTargetDamage.push_front(reuseContents ? damage : bounds);
+    if (mClientTargetDamage.size() > kMaxClientTargetAge) {
+        mClientTargetDamage.pop_back();
+    }
+    return redraw;
+}
+
+DisplayDevice::OffscreenBuffer::~OffscreenBuffer() {
+    if (texName != 0) {
+        engine.deleteTextures(1, &texName);
+    }
+}
+
+std::unique_ptr<DisplayDevice::OffscreenBuffer> DisplayDevice::createOffscreenBuffer(
+        const char* name) const {
+    auto& engine(mFlinger->getRenderEngine());
+    auto offscreen = std::make_unique<OffscreenBuffer>(engine);
+    offscreen->buffer = new GraphicBuffer(static_cast<uint32_t>(mDisplayWidth),
+                                          static_cast<uint32_t>(mDisplayHeight),
+                                          HAL_PIXEL_FORMAT_RGBA_8888, 1,
+                                          GRALLOC_USAGE_HW_RENDER | GRALLOC_USAGE_HW_TEXTURE |
+                                                  GRALLOC_USAGE_HW_COMPOSER,
+                                          name);
+    if (offscreen->buffer->initCheck() != NO_ERROR) {
+        ALOGE("Failed to allocate %s for display %s", name, mDisplayName.string());
+        return nullptr;
+    }
+    offscreen->image = engine.createImage();
+    if (!offscreen->image->setNativeWindowBuffer(offscreen->buffer->getNativeBuffer(), false, 0,
+                                                 0)) {
+        ALOGE("Failed to create an image of %s for display %s", name, mDisplayName.string());
+        return nullptr;
+    }
+    engine.genTextures(1, &offscreen->texName);
+    engine.bindExternalTextureImage(offscreen->texName, *offscreen->image);
+    return offscreen;
+}
+
+const DisplayDevice::OffscreenBuffer* DisplayDevice::getColorMatrixTarget(
+        bool* outAllocated) const {
+    *outAllocated = false;
+    if (mColorMatrixTarget != nullptr &&
+        mColorMatrixTarget->buffer->getWidth() == static_cast<uint32_t>(mDisplayWidth) &&
+        mColorMatrixTarget->buffer->getHeight() == static_cast<uint32_t>(mDisplayHeight)) {
+        return mColorMatrixTarget.get();
+    }
+    mColorMatrixTarget.reset();
+    mColorMatrixTarget = createOffscreenBuffer("ColorMatrixTarget");
+    *outAllocated = mColorMatrixTarget != nullptr;
+    return mColorMatrixTarget.get();
+}
+
+void DisplayDevice::releaseColorMatrixTarget() const {
+    mColorMatrixTarget.reset();
+}
+
+const DisplayDevice::OffscreenBuffer* DisplayDevice::getMirrorSource() const {
+    const sp<GraphicBuffer> buffer = mDisplaySurface->getClientTargetBuffer();
+    if (buffer == nullptr) {
+        mMirrorSources.clear();
+        return nullptr;
+    }
+    for (const auto& source : mMirrorSources) {
+        if (source->buffer == buffer) {
+            return source.get();
+        }
+    }
+
+    auto& engine(mFlinger->getRenderEngine());
+    auto source = std::make_unique<OffscreenBuffer>(engine);
+    source->buffer = buffer;
+    source->image = engine.createImage();
+    if (!source->image->setNativeWindowBuffer(buffer->getNativeBuffer(), false, 0, 0)) {
+        ALOGE("Failed to create an image of the client target of display %s",
+              mDisplayName.string());
+        return nullptr;
+    }
+    engine.genTextures(1, &source->texName);
+    engine.bindExternalTextureImage(source->texName, *source->image);
+
+    // the display surface cycles through a few buffers, and replaces them
+    // all when the display is resized
+    constexpr size_t kMaxMirrorSources = 3;
+    mMirrorSources.push_front(std::move(source));
+    if (mMirrorSources.size() > kMaxMirrorSources) {
+        mMirrorSources.pop_back();
+    }
+    return mMirrorSources.front().get();
+}
+
+void DisplayDevice::setFlattenedLayers(std::unique_ptr<FlattenedLayers> flattened) {
+    mFlattenedLayers = std::move(flattened);
+    mFlattenedLayers->hwcLayer->setLayerDestroyedListener([this](HWC2::Layer* /*layer*/) {
+        if (mFlattenedLayers != nullptr) {
+            mFlattenedLayers->hwcLayer = nullptr;
+        }
+    });
+}
+
+void DisplayDevice::clearFlattenedLayers(HWComposer& hwc) {
+    if (mFlattenedLayers == nullptr) {
+        return;
+    }
+    if (mFlattenedLayers->hwcLayer != nullptr) {
+        hwc.destroyLayer(mHwcDisplayId, mFlattenedLayers->hwcLayer);
+    }
+    mFlattenedLayers.reset();
+    mLayerStableFrames.clear();
+}
+
 // ----------------------------------------------------------------------------
 void DisplayDevice::setPowerMode(int mode) {
     mPowerMode = mode;
@@ -682,6 +840,15 @@ void DisplayDevice::dump(String8& result) const {
                         decodeColorMode(mActiveColorMode).c_str(),
                         dataspaceDetails(static_cast<android_dataspace>(dataspace)).c_str(), dataspace);
 
+    if (mFlattenedLayers != nullptr) {
+        const Rect& frame(mFlattenedLayers->frame);
+        result.appendFormat("   flattened layers: %zu-%zu, f:[%d,%d,%d,%d], composition=%s\n",
+                            mFlattenedLayers->first,
+                            mFlattenedLayers->first + mFlattenedLayers->count - 1, frame.left,
+                            frame.top, frame.right, frame.bottom,
+                            to_string(mFlattenedLayers->compositionType).c_str());
+    }
+
     String8 surfaceDump;
     mDisplaySurface->dumpAsString(surfaceDump);
     result.append(surfaceDump);
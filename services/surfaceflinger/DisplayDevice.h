@@ -20,13 +20,17 @@
 #include "Transform.h"
 
 #include <stdlib.h>
+#include <deque>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include <math/mat4.h>
 
 #include <binder/IBinder.h>
 #include <gui/ISurfaceComposer.h>
 #include <hardware/hwcomposer_defs.h>
+#include <ui/GraphicBuffer.h>
 #include <ui/GraphicTypes.h>
 #include <ui/HdrCapabilities.h>
 #include <ui/Region.h>
@@ -35,7 +39,9 @@
 #include <utils/String8.h>
 #include <utils/Timers.h>
 
+#include "DisplayHardware/HWC2.h"
 #include "RenderArea.h"
+#include "RenderEngine/Image.h"
 #include "RenderEngine/Surface.h"
 
 #include <memory>
@@ -52,6 +58,10 @@ class Layer;
 class SurfaceFlinger;
 class HWComposer;
 
+namespace RE {
+class RenderEngine;
+} // namespace RE
+
 class DisplayDevice : public LightRefBase<DisplayDevice>
 {
 public:
@@ -118,6 +128,104 @@ public:
     const Vector< sp<Layer> >& getLayersNeedingFences() const;
     Region                  getDirtyRegion(bool repaintEverything) const;
 
+    // Accumulated regions of the layers above (and including) a given layer
+    // in the last visible-region pass, in reverse Z order. Used by
+    // SurfaceFlinger to resume computeVisibleRegions() below the topmost
+    // layer that changed instead of starting over from the top.
+    struct VisibleRegionSnapshot {
+        int32_t layerSequence;
+        Region aboveOpaqueLayers;
+        Region aboveCoveredLayers;
+    };
+    std::vector<VisibleRegionSnapshot>& editVisibleRegionSnapshots() {
+        return mVisibleRegionSnapshots;
+    }
+
+    // The best dataspaces SurfaceFlinger found among the visible layers, kept
+    // until the visible layers change or the layer dataspace generation moves
+    // on. Returns false when they have to be found again.
+    bool getBestDataspace(uint32_t layerDataspaceGeneration, ui::Dataspace* outDataspace,
+                          ui::Dataspace* outHdrDataspace) const;
+    void setBestDataspace(uint32_t layerDataspaceGeneration, ui::Dataspace dataspace,
+                          ui::Dataspace hdrDataspace);
+
+    // How the visible layers were composed in a frame. The client target of
+    // earlier frames can only be partially redrawn while this stays the same.
+    struct CompositionSignature {
+        // layer sequence and HWC2 composition type, in Z order
+        std::vector<std::pair<int32_t, int32_t>> layers;
+        mat4 colorMatrix;
+        ui::Dataspace dataspace = ui::Dataspace::UNKNOWN;
+        ui::RenderIntent renderIntent = ui::RenderIntent::COLORIMETRIC;
+    };
+    // Saves the signature of this frame, returns whether it differs from the
+    // one of the previous frame
+    bool updateCompositionSignature(CompositionSignature&& signature) const;
+
+    // Region of the client target to redraw this frame, given the display
+    // space damage of the frame and what the back buffer still holds from
+    // earlier frames. This is the whole display when the buffer age is
+    // unknown or the contents can't be reused.
+    Region getClientTargetRedrawRegion(const Region& damage, bool reuseContents) const;
+
+    // Display-sized buffer RenderEngine composes into, and the external
+    // texture it is sampled through
+    struct OffscreenBuffer {
+        explicit OffscreenBuffer(RE::RenderEngine& engine) : engine(engine) {}
+        ~OffscreenBuffer();
+
+        RE::RenderEngine& engine;
+        sp<GraphicBuffer> buffer;
+        std::unique_ptr<RE::Image> image;
+        uint32_t texName = 0;
+    };
+    // Returns nullptr when the buffer can't be allocated
+    std::unique_ptr<OffscreenBuffer> createOffscreenBuffer(const char* name) const;
+
+    // Buffer the client layers are composed into when the color matrix is
+    // applied in a single pass over the whole client target. It is allocated
+    // on first use or when the display is resized, in which case
+    // |outAllocated| is set as its contents are undefined.
+    const OffscreenBuffer* getColorMatrixTarget(bool* outAllocated) const;
+    void releaseColorMatrixTarget() const;
+
+    // The client target GLES composed the current frame of this display
+    // into, wrapped so other displays can sample it. Returns nullptr when
+    // the display surface doesn't expose its client target.
+    const OffscreenBuffer* getMirrorSource() const;
+
+    // A run of visible layers, adjacent in Z order, that HWC shows as a
+    // single layer holding their pre-blended contents while none of them
+    // changes. The layers themselves have no HWC layer in the meantime.
+    struct FlattenedLayers {
+        // index of the bottommost layer in the visible layers
+        size_t first = 0;
+        size_t count = 0;
+        // display space bounds of the layers
+        Rect frame;
+        std::unique_ptr<OffscreenBuffer> buffer;
+        // signals once the layers have been drawn into |buffer|
+        sp<Fence> renderFence;
+        // nullptr once HWC has destroyed it
+        HWC2::Layer* hwcLayer = nullptr;
+        HWC2::Composition compositionType = HWC2::Composition::Device;
+        // whether HWC was given the damage of the first frame only
+        bool fullDamage = true;
+    };
+    FlattenedLayers* getFlattenedLayers() const { return mFlattenedLayers.get(); }
+    bool isLayerFlattened(size_t index) const {
+        return mFlattenedLayers != nullptr && index >= mFlattenedLayers->first &&
+                index - mFlattenedLayers->first < mFlattenedLayers->count;
+    }
+    void setFlattenedLayers(std::unique_ptr<FlattenedLayers> flattened);
+    // Destroys the HWC layer of the flattened layers. Their own HWC layers
+    // have to be created again by the caller.
+    void clearFlattenedLayers(HWComposer& hwc);
+
+    // Number of consecutive frames each visible layer has been client
+    // composited without changing, in Z order
+    std::vector<uint32_t>& editLayerStableFrames() { return mLayerStableFrames; }
+
     void                    setLayerStack(uint32_t stack);
     void                    setDisplaySize(const int newWidth, const int newHeight);
     void                    setProjection(int orientation, const Rect& viewport, const Rect& frame);
@@ -247,6 +355,21 @@ private:
     Vector< sp<Layer> > mVisibleLayersSortedByZ;
     // list of layers needing fences
     Vector< sp<Layer> > mLayersNeedingFences;
+    // per-layer state saved by the last visible-region pass
+    std::vector<VisibleRegionSnapshot> mVisibleRegionSnapshots;
+    // what getBestDataspace() returns, for mBestDataspaceGeneration
+    bool mHasBestDataspace = false;
+    uint32_t mBestDataspaceGeneration = 0;
+    ui::Dataspace mBestDataspace = ui::Dataspace::UNKNOWN;
+    ui::Dataspace mBestHdrDataspace = ui::Dataspace::UNKNOWN;
+    mutable CompositionSignature mCompositionSignature;
+    // damage of the last client-composed frames, newest first
+    mutable std::deque<Region> mClientTargetDamage;
+    mutable std::unique_ptr<OffscreenBuffer> mColorMatrixTarget;
+    // client target buffers wrapped by getMirrorSource(), newest first
+    mutable std::deque<std::unique_ptr<OffscreenBuffer>> mMirrorSources;
+    std::unique_ptr<FlattenedLayers> mFlattenedLayers;
+    std::vector<uint32_t> mLayerStableFrames;
 
     /*
      * Transaction state
@@ -26,6 +26,7 @@ namespace android {
 // ---------------------------------------------------------------------------
 
 class Fence;
+class GraphicBuffer;
 class IGraphicBufferProducer;
 class String8;
 
@@ -71,6 +72,10 @@ public:
 
     virtual const sp<Fence>& getClientTargetAcquireFence() const = 0;
 
+    // Returns the buffer GLES composed the current frame into, if it can be
+    // sampled as a texture, so other displays can show the same frame.
+    virtual sp<GraphicBuffer> getClientTargetBuffer() const { return nullptr; }
+
 protected:
     DisplaySurface() {}
     virtual ~DisplaySurface() {}
@@ -20,6 +20,7 @@
 #define LOG_TAG "FramebufferSurface"
 
 #include <errno.h>
+#include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -53,16 +54,21 @@ using ui::Dataspace;
  */
 
 FramebufferSurface::FramebufferSurface(HWComposer& hwc, int disp,
-        const sp<IGraphicBufferConsumer>& consumer) :
+        const sp<IGraphicBufferConsumer>& consumer, bool textureUsage,
+        bool adaptiveBufferCount) :
     ConsumerBase(consumer),
     mDisplayType(disp),
+    mTextureUsage(textureUsage),
     mCurrentBufferSlot(-1),
     mCurrentBuffer(),
     mCurrentFence(Fence::NO_FENCE),
     mHwc(hwc),
     mHasPendingRelease(false),
     mPreviousBufferSlot(BufferQueue::INVALID_BUFFER_SLOT),
-    mPreviousBuffer()
+    mPreviousBuffer(),
+    mMaxAcquiredBufferCount(
+            static_cast<int>(SurfaceFlinger::maxFrameBufferAcquiredBuffers) - 1),
+    mAdaptiveBufferCount(adaptiveBufferCount && mMaxAcquiredBufferCount > 1)
 {
     ALOGV("Creating for display %d", disp);
 
@@ -70,12 +76,12 @@ FramebufferSurface::FramebufferSurface(HWComposer& hwc, int disp,
     mConsumer->setConsumerName(mName);
     mConsumer->setConsumerUsageBits(GRALLOC_USAGE_HW_FB |
                                        GRALLOC_USAGE_HW_RENDER |
-                                       GRALLOC_USAGE_HW_COMPOSER);
+                                       GRALLOC_USAGE_HW_COMPOSER |
+                                       (textureUsage ? GRALLOC_USAGE_HW_TEXTURE : 0));
     const auto& activeConfig = mHwc.getActiveConfig(disp);
     mConsumer->setDefaultBufferSize(activeConfig->getWidth(),
             activeConfig->getHeight());
-    mConsumer->setMaxAcquiredBufferCount(
-            SurfaceFlinger::maxFrameBufferAcquiredBuffers - 1);
+    mConsumer->setMaxAcquiredBufferCount(mMaxAcquiredBufferCount);
 }
 
 void FramebufferSurface::resizeBuffers(const uint32_t width, const uint32_t height) {
@@ -86,7 +92,21 @@ status_t FramebufferSurface::beginFrame(bool /*mustRecompose*/) {
     return NO_ERROR;
 }
 
-status_t FramebufferSurface::prepareFrame(CompositionType /*compositionType*/) {
+status_t FramebufferSurface::prepareFrame(CompositionType compositionType) {
+    mHasClientComposition = (compositionType & COMPOSITION_GLES) != 0;
+    mAcquiredThisFrame = false;
+    if (mHasClientComposition) {
+        mFramesWithoutClientComposition = 0;
+        if (mReducedBufferCount) {
+            // let GLES get ahead of HWC again before it dequeues this frame
+            status_t result = mConsumer->setMaxAcquiredBufferCount(mMaxAcquiredBufferCount);
+            ALOGE_IF(result != NO_ERROR, "prepareFrame: failed to restore the buffer count: %s (%d)",
+                    strerror(-result), result);
+            mReducedBufferCount = result != NO_ERROR;
+        }
+    } else if (mFramesWithoutClientComposition < kRareClientCompositionFrames) {
+        mFramesWithoutClientComposition++;
+    }
     return NO_ERROR;
 }
 
@@ -137,6 +157,7 @@ status_t FramebufferSurface::nextBuffer(uint32_t& outSlot,
     mCurrentBufferSlot = item.mSlot;
     mCurrentBuffer = mSlots[mCurrentBufferSlot].mGraphicBuffer;
     mCurrentFence = item.mFence;
+    mAcquiredThisFrame = true;
 
     outFence = item.mFence;
     mHwcBufferCache.getHwcBuffer(mCurrentBufferSlot, mCurrentBuffer,
@@ -175,6 +196,32 @@ void FramebufferSurface::onFrameCommitted() {
         mPreviousBuffer.clear();
         mHasPendingRelease = false;
     }
+
+    if (!mHasClientComposition && !mAcquiredThisFrame &&
+        mCurrentBufferSlot != BufferQueue::INVALID_BUFFER_SLOT) {
+        // The next GLES frame sets a new client target before HWC reads one
+        sp<Fence> fence = mHwc.getPresentFence(mDisplayType);
+        if (fence->isValid()) {
+            status_t result = addReleaseFence(mCurrentBufferSlot, mCurrentBuffer, fence);
+            ALOGE_IF(result != NO_ERROR, "onFrameCommitted: failed to add the"
+                    " fence: %s (%d)", strerror(-result), result);
+        }
+        status_t result = releaseBufferLocked(mCurrentBufferSlot, mCurrentBuffer);
+        ALOGE_IF(result != NO_ERROR, "onFrameCommitted: error releasing buffer:"
+                " %s (%d)", strerror(-result), result);
+
+        mCurrentBufferSlot = BufferQueue::INVALID_BUFFER_SLOT;
+        mCurrentBuffer.clear();
+    }
+
+    if (mAdaptiveBufferCount && !mReducedBufferCount &&
+        mFramesWithoutClientComposition >= kRareClientCompositionFrames) {
+        // frees the buffer GLES no longer gets to dequeue
+        status_t result = mConsumer->setMaxAcquiredBufferCount(1);
+        ALOGE_IF(result != NO_ERROR, "onFrameCommitted: failed to reduce the buffer count:"
+                " %s (%d)", strerror(-result), result);
+        mReducedBufferCount = result == NO_ERROR;
+    }
 }
 
 void FramebufferSurface::dumpAsString(String8& result) const {
@@ -182,6 +229,12 @@ void FramebufferSurface::dumpAsString(String8& result) const {
     result.appendFormat("  FramebufferSurface: dataspace: %s(%d)\n",
                         dataspaceDetails(static_cast<android_dataspace>(mDataSpace)).c_str(),
                         mDataSpace);
+    result.appendFormat("  HWC buffer cache: %" PRIu64 " hits, %" PRIu64 " misses\n",
+                        mHwcBufferCache.getHitCount(), mHwcBufferCache.getMissCount());
+    if (mAdaptiveBufferCount) {
+        result.appendFormat("  Adaptive buffer count: %s buffered\n",
+                            mReducedBufferCount ? "double" : "triple or more");
+    }
     ConsumerBase::dumpLocked(result, "   ");
 }
 
@@ -194,6 +247,10 @@ const sp<Fence>& FramebufferSurface::getClientTargetAcquireFence() const {
     return mCurrentFence;
 }
 
+sp<GraphicBuffer> FramebufferSurface::getClientTargetBuffer() const {
+    return mTextureUsage ? mCurrentBuffer : nullptr;
+}
+
 // ----------------------------------------------------------------------------
 }; // namespace android
 // ----------------------------------------------------------------------------
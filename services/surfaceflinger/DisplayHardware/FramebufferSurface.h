@@ -38,7 +38,11 @@ class HWComposer;
 class FramebufferSurface : public ConsumerBase,
                            public DisplaySurface {
 public:
-    FramebufferSurface(HWComposer& hwc, int disp, const sp<IGraphicBufferConsumer>& consumer);
+    // textureUsage lets the client target buffers be sampled by GLES, which
+    // getClientTargetBuffer() needs. adaptiveBufferCount lets a triple
+    // buffered surface drop to two buffers while GLES composition is rare.
+    FramebufferSurface(HWComposer& hwc, int disp, const sp<IGraphicBufferConsumer>& consumer,
+                       bool textureUsage = false, bool adaptiveBufferCount = false);
 
     virtual status_t beginFrame(bool mustRecompose);
     virtual status_t prepareFrame(CompositionType compositionType);
@@ -50,6 +54,8 @@ public:
 
     virtual const sp<Fence>& getClientTargetAcquireFence() const override;
 
+    virtual sp<GraphicBuffer> getClientTargetBuffer() const override;
+
 private:
     virtual ~FramebufferSurface() { }; // this class cannot be overloaded
 
@@ -66,6 +72,9 @@ private:
     // mDisplayType must match one of the HWC display types
     int mDisplayType;
 
+    // whether the buffers can be sampled as textures
+    const bool mTextureUsage;
+
     // mCurrentBufferIndex is the slot index of the current buffer or
     // INVALID_BUFFER_SLOT to indicate that either there is no current buffer
     // or the buffer is not associated with a slot.
@@ -94,6 +103,22 @@ private:
     bool mHasPendingRelease;
     int mPreviousBufferSlot;
     sp<GraphicBuffer> mPreviousBuffer;
+
+    // Whether the current frame has GLES composition, or was given a new
+    // client target anyway. When neither is the case HWC doesn't read the
+    // client target, which is then released once the frame is presented
+    // instead of when the next GLES frame replaces it.
+    bool mHasClientComposition = false;
+    bool mAcquiredThisFrame = false;
+
+    // Number of buffers the consumer may hold when triple buffered, and how
+    // many frames without GLES composition have passed, to drop to double
+    // buffering after kRareClientCompositionFrames of them
+    static constexpr uint32_t kRareClientCompositionFrames = 120;
+    const int mMaxAcquiredBufferCount;
+    const bool mAdaptiveBufferCount;
+    bool mReducedBufferCount = false;
+    uint32_t mFramesWithoutClientComposition = 0;
 };
 
 // ---------------------------------------------------------------------------
@@ -616,6 +616,11 @@ Error Display::setColorMode(ColorMode mode, RenderIntent renderIntent)
     return static_cast<Error>(intError);
 }
 
+void Display::setClientCompositionLoad(const android::Hwc2::ClientCompositionLoad& load)
+{
+    mPowerAdvisor.setClientCompositionLoad(mId, load);
+}
+
 Error Display::setColorTransform(const android::mat4& matrix,
         android_color_transform_t hint)
 {
@@ -797,6 +802,16 @@ Error Layer::setCursorPosition(int32_t x, int32_t y)
 Error Layer::setBuffer(uint32_t slot, const sp<GraphicBuffer>& buffer,
         const sp<Fence>& acquireFence)
 {
+    // A null buffer stands for the one already cached in the slot. Each
+    // queued frame comes with its own fence, so the same one means nothing
+    // was latched since, unless there is no fence to tell frames apart.
+    if (buffer == nullptr && mBufferSlot == slot && acquireFence == mBufferAcquireFence &&
+        acquireFence != Fence::NO_FENCE) {
+        return Error::None;
+    }
+    mBufferSlot = slot;
+    mBufferAcquireFence = acquireFence;
+
     int32_t fenceFd = acquireFence->dup();
     auto intError = mComposer.setLayerBuffer(mDisplayId, mId, slot, buffer,
                                              fenceFd);
@@ -829,6 +844,10 @@ Error Layer::setSurfaceDamage(const Region& damage)
 
 Error Layer::setBlendMode(BlendMode mode)
 {
+    if (mBlendMode == mode) {
+        return Error::None;
+    }
+    mBlendMode = mode;
     auto intMode = static_cast<Hwc2::IComposerClient::BlendMode>(mode);
     auto intError = mComposer.setLayerBlendMode(mDisplayId, mId, intMode);
     return static_cast<Error>(intError);
@@ -836,6 +855,11 @@ Error Layer::setBlendMode(BlendMode mode)
 
 Error Layer::setColor(hwc_color_t color)
 {
+    if (mColor && mColor->r == color.r && mColor->g == color.g && mColor->b == color.b &&
+        mColor->a == color.a) {
+        return Error::None;
+    }
+    mColor = color;
     Hwc2::IComposerClient::Color hwcColor{color.r, color.g, color.b, color.a};
     auto intError = mComposer.setLayerColor(mDisplayId, mId, hwcColor);
     return static_cast<Error>(intError);
@@ -907,6 +931,10 @@ Error Layer::setPerFrameMetadata(const int32_t supportedPerFrameMetadata,
 
 Error Layer::setDisplayFrame(const Rect& frame)
 {
+    if (mDisplayFrame == frame) {
+        return Error::None;
+    }
+    mDisplayFrame = frame;
     Hwc2::IComposerClient::Rect hwcRect{frame.left, frame.top,
         frame.right, frame.bottom};
     auto intError = mComposer.setLayerDisplayFrame(mDisplayId, mId, hwcRect);
@@ -915,6 +943,10 @@ Error Layer::setDisplayFrame(const Rect& frame)
 
 Error Layer::setPlaneAlpha(float alpha)
 {
+    if (mPlaneAlpha == alpha) {
+        return Error::None;
+    }
+    mPlaneAlpha = alpha;
     auto intError = mComposer.setLayerPlaneAlpha(mDisplayId, mId, alpha);
     return static_cast<Error>(intError);
 }
@@ -932,6 +964,10 @@ Error Layer::setSidebandStream(const native_handle_t* stream)
 
 Error Layer::setSourceCrop(const FloatRect& crop)
 {
+    if (mSourceCrop == crop) {
+        return Error::None;
+    }
+    mSourceCrop = crop;
     Hwc2::IComposerClient::FRect hwcRect{
         crop.left, crop.top, crop.right, crop.bottom};
     auto intError = mComposer.setLayerSourceCrop(mDisplayId, mId, hwcRect);
@@ -940,6 +976,10 @@ Error Layer::setSourceCrop(const FloatRect& crop)
 
 Error Layer::setTransform(Transform transform)
 {
+    if (mTransform == transform) {
+        return Error::None;
+    }
+    mTransform = transform;
     auto intTransform = static_cast<Hwc2::Transform>(transform);
     auto intError = mComposer.setLayerTransform(mDisplayId, mId, intTransform);
     return static_cast<Error>(intError);
@@ -949,6 +989,11 @@ Error Layer::setVisibleRegion(const Region& region)
 {
     size_t rectCount = 0;
     auto rectArray = region.getArray(&rectCount);
+    if (mVisibleRegion && mVisibleRegion->size() == rectCount &&
+        std::equal(rectArray, rectArray + rectCount, mVisibleRegion->begin())) {
+        return Error::None;
+    }
+    mVisibleRegion.emplace(rectArray, rectArray + rectCount);
 
     std::vector<Hwc2::IComposerClient::Rect> hwcRects;
     for (size_t rect = 0; rect < rectCount; ++rect) {
@@ -962,6 +1007,10 @@ Error Layer::setVisibleRegion(const Region& region)
 
 Error Layer::setZOrder(uint32_t z)
 {
+    if (mZOrder == z) {
+        return Error::None;
+    }
+    mZOrder = z;
     auto intError = mComposer.setLayerZOrder(mDisplayId, mId, z);
     return static_cast<Error>(intError);
 }
@@ -25,13 +25,16 @@
 
 #include <gui/HdrMetadata.h>
 #include <math/mat4.h>
+#include <ui/FloatRect.h>
 #include <ui/GraphicTypes.h>
 #include <ui/HdrCapabilities.h>
+#include <ui/Rect.h>
 #include <utils/Log.h>
 #include <utils/StrongPointer.h>
 #include <utils/Timers.h>
 
 #include <functional>
+#include <optional>
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
@@ -267,6 +270,7 @@ public:
 
     hwc2_display_t getId() const { return mId; }
     bool isConnected() const { return mIsConnected; }
+    void setClientCompositionLoad(const android::Hwc2::ClientCompositionLoad& load);
     void setConnected(bool connected);  // For use by Device only
 
 private:
@@ -351,6 +355,19 @@ private:
     hwc2_layer_t mId;
     android::ui::Dataspace mDataSpace = android::ui::Dataspace::UNKNOWN;
     android::HdrMetadata mHdrMetadata;
+    // Last state sent to the composer, so that unchanged properties aren't
+    // serialized again every frame. The composition type isn't cached as
+    // HWC changes it when display changes are accepted.
+    std::optional<uint32_t> mBufferSlot;
+    android::sp<android::Fence> mBufferAcquireFence;
+    std::optional<BlendMode> mBlendMode;
+    std::optional<hwc_color_t> mColor;
+    std::optional<android::Rect> mDisplayFrame;
+    std::optional<float> mPlaneAlpha;
+    std::optional<android::FloatRect> mSourceCrop;
+    std::optional<Transform> mTransform;
+    std::optional<std::vector<android::Rect>> mVisibleRegion;
+    std::optional<uint32_t> mZOrder;
     std::function<void(Layer*)> mLayerDestroyedListener;
 };
 
@@ -431,11 +431,24 @@ status_t HWComposer::prepare(DisplayDevice& displayDevice) {
     // rendered to the client target yet, we should not attempt to skip
     // validate.
     //
-    // displayData.hasClientComposition hasn't been updated for this frame.
-    // The check below is incorrect.  We actually rely on HWC here to fall
-    // back to validate when there is any client layer.
+    // What HWC decided for the previous frame doesn't tell whether this one
+    // needs the client target, the composition types requested for this
+    // frame do: a layer we already compose ourselves makes presenting
+    // pointless, otherwise HWC either presents right away or falls back to
+    // validate in the same round trip.
+    bool requestsClientComposition = false;
+    if (auto flattened = displayDevice.getFlattenedLayers()) {
+        requestsClientComposition = flattened->compositionType == HWC2::Composition::Client;
+    }
+    const Vector<sp<Layer>>& layers(displayDevice.getVisibleLayersSortedByZ());
+    for (size_t i = 0; !requestsClientComposition && i < layers.size(); i++) {
+        requestsClientComposition = !displayDevice.isLayerFlattened(i) &&
+                layers[i]->getCompositionType(displayId) == HWC2::Composition::Client;
+    }
+    ATRACE_INT("RequestsClientComposition", requestsClientComposition);
+
     displayData.validateWasSkipped = false;
-    if (!displayData.hasClientComposition) {
+    if (!requestsClientComposition) {
         sp<android::Fence> outPresentFence;
         uint32_t state = UINT32_MAX;
         error = hwcDisplay->presentOrValidate(&numTypes, &numRequests, &outPresentFence , &state);
@@ -474,7 +487,23 @@ status_t HWComposer::prepare(DisplayDevice& displayDevice) {
 
     displayData.hasClientComposition = false;
     displayData.hasDeviceComposition = false;
-    for (auto& layer : displayDevice.getVisibleLayersSortedByZ()) {
+    if (auto flattened = displayDevice.getFlattenedLayers()) {
+        if (changedTypes.count(flattened->hwcLayer) != 0) {
+            validateChange(flattened->compositionType, changedTypes[flattened->hwcLayer]);
+            flattened->compositionType = changedTypes[flattened->hwcLayer];
+        }
+        if (flattened->compositionType == HWC2::Composition::Client) {
+            displayData.hasClientComposition = true;
+        } else {
+            displayData.hasDeviceComposition = true;
+        }
+    }
+    for (size_t i = 0; i < layers.size(); i++) {
+        const auto& layer = layers[i];
+        if (displayDevice.isLayerFlattened(i)) {
+            // shown by the HWC layer of the flattened layers
+            continue;
+        }
         auto hwcLayer = layer->getHwcLayer(displayId);
 
         if (changedTypes.count(hwcLayer) != 0) {
@@ -553,6 +582,15 @@ bool HWComposer::hasClientComposition(int32_t displayId) const {
     return mDisplayData[displayId].hasClientComposition;
 }
 
+bool HWComposer::wasValidateSkipped(int32_t displayId) const {
+    if (displayId == DisplayDevice::DISPLAY_ID_INVALID) {
+        return false;
+    }
+
+    RETURN_IF_INVALID_DISPLAY(displayId, false);
+    return mDisplayData[displayId].validateWasSkipped;
+}
+
 sp<Fence> HWComposer::getPresentFence(int32_t displayId) const {
     RETURN_IF_INVALID_DISPLAY(displayId, Fence::NO_FENCE);
     return mDisplayData[displayId].lastPresentFence;
@@ -680,6 +718,12 @@ status_t HWComposer::setColorTransform(int32_t displayId,
     return NO_ERROR;
 }
 
+void HWComposer::setClientCompositionLoad(int32_t displayId,
+                                          const Hwc2::ClientCompositionLoad& load) {
+    RETURN_IF_INVALID_DISPLAY(displayId);
+    mDisplayData[displayId].hwcDisplay->setClientCompositionLoad(load);
+}
+
 void HWComposer::disconnectDisplay(int displayId) {
     LOG_ALWAYS_FATAL_IF(displayId < 0);
     auto& displayData = mDisplayData[displayId];
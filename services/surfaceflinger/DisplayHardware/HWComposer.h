@@ -105,6 +105,10 @@ public:
     // Sets a color transform to be applied to the result of composition
     status_t setColorTransform(int32_t displayId, const mat4& transform);
 
+    // Passes the expected cost of the client composition of the next frame
+    // on to the power HAL
+    void setClientCompositionLoad(int32_t displayId, const Hwc2::ClientCompositionLoad& load);
+
     // reset state when an external, non-virtual display is disconnected
     void disconnectDisplay(int32_t displayId);
 
@@ -117,6 +121,9 @@ public:
     // does this display have layers handled by GLES
     bool hasClientComposition(int32_t displayId) const;
 
+    // was this frame presented by prepare() already, without a validate
+    bool wasValidateSkipped(int32_t displayId) const;
+
     // get the present fence received from the last call to present.
     sp<Fence> getPresentFence(int32_t displayId) const;
 
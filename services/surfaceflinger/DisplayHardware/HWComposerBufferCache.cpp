@@ -17,12 +17,13 @@
 #include "HWComposerBufferCache.h"
 
 #include <gui/BufferQueue.h>
+#include <ui/GraphicBuffer.h>
 
 namespace android {
 
 HWComposerBufferCache::HWComposerBufferCache()
 {
-    mBuffers.reserve(BufferQueue::NUM_BUFFER_SLOTS);
+    mEntries.reserve(BufferQueue::NUM_BUFFER_SLOTS);
 }
 
 void HWComposerBufferCache::getHwcBuffer(int slot,
@@ -34,21 +35,49 @@ void HWComposerBufferCache::getHwcBuffer(int slot,
         slot = 0;
     }
 
-    if (static_cast<size_t>(slot) >= mBuffers.size()) {
-        mBuffers.resize(slot + 1);
+    if (buffer == nullptr) {
+        *outSlot = 0;
+        *outBuffer = nullptr;
+        return;
     }
 
-    *outSlot = slot;
+    const uint64_t id = buffer->getId();
+    size_t hit = mEntries.size();
+    size_t sameSlot = mEntries.size();
+    size_t unused = mEntries.size();
+    for (size_t i = 0; i < mEntries.size(); i++) {
+        const Entry& entry = mEntries[i];
+        if (entry.buffer != nullptr && entry.buffer->getId() == id) {
+            hit = i;
+        } else if (entry.slot == slot) {
+            sameSlot = i;
+        } else if (entry.slot < 0 && unused == mEntries.size()) {
+            unused = i;
+        }
+    }
 
-    if (mBuffers[slot] == buffer) {
+    if (hit < mEntries.size()) {
         // already cached in HWC, skip sending the buffer
+        mHitCount++;
+        if (sameSlot < mEntries.size()) {
+            // whatever else was in this slot is gone
+            mEntries[sameSlot].slot = -1;
+        }
+        mEntries[hit].slot = slot;
+        *outSlot = hit;
         *outBuffer = nullptr;
-    } else {
-        *outBuffer = buffer;
+        return;
+    }
 
-        // update cache
-        mBuffers[slot] = buffer;
+    mMissCount++;
+    size_t victim = sameSlot < mEntries.size() ? sameSlot : unused;
+    if (victim == mEntries.size()) {
+        mEntries.emplace_back();
     }
+    mEntries[victim].buffer = buffer;
+    mEntries[victim].slot = slot;
+    *outSlot = victim;
+    *outBuffer = buffer;
 }
 
 } // namespace android
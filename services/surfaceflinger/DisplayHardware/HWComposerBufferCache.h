@@ -37,6 +37,13 @@ class GraphicBuffer;
 //
 // To be able to find out whether a buffer is already in the HAL's cache, we
 // use HWComposerBufferCache to mirror the cache in SF.
+//
+// Buffers are looked up by GraphicBuffer::getId() rather than by buffer queue
+// slot, so a buffer that moves to another slot (e.g. after the queue is
+// resized or a slot is freed and reattached) is still a cache hit.  A miss
+// takes over the HWC slot of the buffer that last came from the same buffer
+// queue slot, as that buffer can no longer be queued, which keeps the cache
+// within BufferQueue::NUM_BUFFER_SLOTS entries.
 class HWComposerBufferCache {
 public:
     HWComposerBufferCache();
@@ -49,10 +56,23 @@ public:
     void getHwcBuffer(int slot, const sp<GraphicBuffer>& buffer,
             uint32_t* outSlot, sp<GraphicBuffer>* outBuffer);
 
+    uint64_t getHitCount() const { return mHitCount; }
+    uint64_t getMissCount() const { return mMissCount; }
+
 private:
-    // a vector as we expect "slot" to be in the range of [0, 63] (that is,
-    // less than BufferQueue::NUM_BUFFER_SLOTS).
-    std::vector<sp<GraphicBuffer>> mBuffers;
+    struct Entry {
+        sp<GraphicBuffer> buffer;
+        // buffer queue slot the buffer was last seen in, or -1 once no slot
+        // refers to it anymore
+        int slot = -1;
+    };
+
+    // indexed by HWC cache slot; there are only a handful of buffers per
+    // layer, so scanning this is cheaper than maintaining a map by id
+    std::vector<Entry> mEntries;
+
+    uint64_t mHitCount = 0;
+    uint64_t mMissCount = 0;
 };
 
 // ---------------------------------------------------------------------------
@@ -44,8 +44,34 @@ void PowerAdvisor::setExpensiveRenderingExpected(hwc2_display_t displayId, bool
     } else {
         mExpensiveDisplays.erase(displayId);
     }
+    notifyExpensiveRendering();
+}
+
+void PowerAdvisor::setClientCompositionLoad(hwc2_display_t displayId,
+                                            const ClientCompositionLoad& load) {
+    // A frame is heavy when its GPU time would eat most of the frame budget
+    // at the current frequency. The boost is requested as soon as such a
+    // frame is coming, but only relaxed once the display has had light
+    // frames for a while, so a hint is sent at most every kRelaxDelay when
+    // the load alternates.
+    constexpr nsecs_t kRelaxDelay = ms2ns(500);
+    const bool heavy = load.predictedGpuTime > 0 && load.frameBudget > 0 &&
+            load.predictedGpuTime * 4 > load.frameBudget * 3;
+
+    const nsecs_t now = systemTime();
+    const auto loaded = mLoadedDisplays.find(displayId);
+    if (heavy) {
+        mLoadedDisplays[displayId] = now;
+    } else if (loaded != mLoadedDisplays.end() && now - loaded->second >= kRelaxDelay) {
+        mLoadedDisplays.erase(loaded);
+    } else {
+        return;
+    }
+    notifyExpensiveRendering();
+}
 
-    const bool expectsExpensiveRendering = !mExpensiveDisplays.empty();
+void PowerAdvisor::notifyExpensiveRendering() {
+    const bool expectsExpensiveRendering = !mExpensiveDisplays.empty() || !mLoadedDisplays.empty();
     if (mNotifiedExpensiveRendering != expectsExpensiveRendering) {
         const sp<V1_3::IPower> powerHal = getPowerHal();
         if (powerHal == nullptr) {
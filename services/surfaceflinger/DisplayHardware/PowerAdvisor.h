@@ -24,17 +24,36 @@
 
 #include <android/hardware/power/1.3/IPower.h>
 #include <utils/StrongPointer.h>
+#include <utils/Timers.h>
 
+#include <unordered_map>
 #include <unordered_set>
 
 namespace android {
 namespace Hwc2 {
 
+// What the client composition of the next frame of a display is expected to
+// cost, as estimated by SurfaceFlinger once HWC has picked composition types
+struct ClientCompositionLoad {
+    size_t layerCount = 0;
+    uint64_t pixelCount = 0;
+    // 0 until there is GPU time history to predict from
+    nsecs_t predictedGpuTime = 0;
+    // time between two frames of the display
+    nsecs_t frameBudget = 0;
+};
+
 class PowerAdvisor {
 public:
     virtual ~PowerAdvisor();
 
     virtual void setExpensiveRenderingExpected(hwc2_display_t displayId, bool expected) = 0;
+
+    // Called before the client composition of every frame of a display, so
+    // the GPU can be boosted before a heavy frame rather than after it
+    // missed its deadline
+    virtual void setClientCompositionLoad(hwc2_display_t displayId,
+                                          const ClientCompositionLoad& load) = 0;
 };
 
 namespace impl {
@@ -49,11 +68,17 @@ public:
     ~PowerAdvisor() override;
 
     void setExpensiveRenderingExpected(hwc2_display_t displayId, bool expected) override;
+    void setClientCompositionLoad(hwc2_display_t displayId,
+                                  const ClientCompositionLoad& load) override;
 
 private:
     sp<V1_3::IPower> getPowerHal();
+    void notifyExpensiveRendering();
 
     std::unordered_set<hwc2_display_t> mExpensiveDisplays;
+    // displays whose client composition was heavy recently, and when it
+    // last was
+    std::unordered_map<hwc2_display_t, nsecs_t> mLoadedDisplays;
     bool mNotifiedExpensiveRendering = false;
     bool mReconnectPowerHal = false;
 };
@@ -19,7 +19,9 @@
 #include <pthread.h>
 #include <sched.h>
 #include <sys/types.h>
+#include <algorithm>
 #include <chrono>
+#include <cinttypes>
 #include <cstdint>
 
 #include <bfqio/bfqio.h>
@@ -131,6 +133,17 @@ void EventThread::requestNextVsync(const sp<EventThread::Connection>& connection
     }
 }
 
+void EventThread::setVsyncSchedule(nsecs_t interval, nsecs_t phase,
+                                   const sp<EventThread::Connection>& connection) {
+    if (interval >= 0) { // server must protect against bad params
+        std::lock_guard<std::mutex> lock(mMutex);
+        connection->vsyncInterval = interval;
+        connection->vsyncPhase = phase;
+        connection->nextVsyncTime = 0;
+        mCondition.notify_all();
+    }
+}
+
 void EventThread::onScreenReleased() {
     std::lock_guard<std::mutex> lock(mMutex);
     if (!mUseSoftwareVSync) {
@@ -158,6 +171,14 @@ void EventThread::onVSyncEvent(nsecs_t timestamp) {
     mCondition.notify_all();
 }
 
+void EventThread::setIdle(bool idle) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mIdle != idle) {
+        mIdle = idle;
+        mCondition.notify_all();
+    }
+}
+
 void EventThread::onHotplugReceived(int type, bool connected) {
     ALOGE_IF(type >= DisplayDevice::NUM_BUILTIN_DISPLAY_TYPES,
              "received hotplug event for an invalid display (id=%d)", type);
@@ -181,25 +202,49 @@ void EventThread::threadMain() NO_THREAD_SAFETY_ANALYSIS {
         Vector<sp<EventThread::Connection> > signalConnections;
         signalConnections = waitForEventLocked(&lock, &event);
 
-        // dispatch events to listeners...
+        // dispatch events to listeners without holding the lock, so a client
+        // that is slow to drain its channel doesn't hold up new connections,
+        // vsync requests or the vsync source.
         const size_t count = signalConnections.size();
+        mPostResults.resize(count);
+        lock.unlock();
+        for (size_t i = 0; i < count; i++) {
+            status_t err = signalConnections[i]->postEvent(event);
+            mPostResults[i] = {err, systemTime(SYSTEM_TIME_MONOTONIC)};
+        }
+        lock.lock();
+
+        const bool isVSync = event.header.type == DisplayEventReceiver::DISPLAY_EVENT_VSYNC;
         for (size_t i = 0; i < count; i++) {
             const sp<Connection>& conn(signalConnections[i]);
-            // now see if we still need to report this event
-            status_t err = conn->postEvent(event);
+            const auto [err, postTime] = mPostResults[i];
+            const bool firedOneShot = conn->firedOneShot;
+            conn->firedOneShot = false;
             if (err == -EAGAIN || err == -EWOULDBLOCK) {
                 // The destination doesn't accept events anymore, it's probably
-                // full. For now, we just drop the events on the floor.
+                // full. Vsync requests are kept for the next vsync; other
+                // events are dropped on the floor.
                 // FIXME: Note that some events cannot be dropped and would have
                 // to be re-sent later.
                 // Right-now we don't have the ability to do this.
-                ALOGW("EventThread: dropping event (%08x) for connection %p", event.header.type,
-                      conn.get());
+                conn->eventsDropped++;
+                if (isVSync && firedOneShot && conn->count < 0) {
+                    conn->count = 0;
+                } else {
+                    ALOGW("EventThread: dropping event (%08x) for connection %p",
+                          event.header.type, conn.get());
+                }
             } else if (err < 0) {
                 // handle any other error on the pipe as fatal. the only
                 // reasonable thing to do is to clean-up this connection.
                 // The most common error we'll get here is -EPIPE.
                 removeDisplayEventConnectionLocked(signalConnections[i]);
+            } else if (isVSync) {
+                const nsecs_t latency = postTime - event.header.timestamp;
+                conn->eventsPosted++;
+                conn->lastLatency = latency;
+                conn->maxLatency = std::max(conn->maxLatency, latency);
+                conn->totalLatency += latency;
             }
         }
     }
@@ -247,16 +292,27 @@ Vector<sp<EventThread::Connection> > EventThread::waitForEventLocked(
             sp<Connection> connection(mDisplayEventConnections[i].promote());
             if (connection != nullptr) {
                 bool added = false;
-                if (connection->count >= 0) {
+                if (connection->count == 0 || (connection->count > 0 && !mIdle)) {
                     // we need vsync events because at least
                     // one connection is waiting for it
                     waitForVSync = true;
                     if (timestamp) {
                         // we consume the event only if it's time
                         // (ie: we received a vsync event)
-                        if (connection->count == 0) {
+                        if (connection->vsyncInterval > 0) {
+                            // the connection's own schedule replaces the rate
+                            if (connection->consumeScheduledVsync(timestamp)) {
+                                if (connection->count == 0) {
+                                    connection->count = -1;
+                                    connection->firedOneShot = true;
+                                }
+                                signalConnections.add(connection);
+                                added = true;
+                            }
+                        } else if (connection->count == 0) {
                             // fired this time around
                             connection->count = -1;
+                            connection->firedOneShot = true;
                             signalConnections.add(connection);
                             added = true;
                         } else if (connection->count == 1 ||
@@ -366,13 +422,28 @@ void EventThread::dump(String8& result) const {
     std::lock_guard<std::mutex> lock(mMutex);
     result.appendFormat("VSYNC state: %s\n", mDebugVsyncEnabled ? "enabled" : "disabled");
     result.appendFormat("  soft-vsync: %s\n", mUseSoftwareVSync ? "enabled" : "disabled");
+    result.appendFormat("  idle: %s\n", mIdle ? "yes" : "no");
     result.appendFormat("  numListeners=%zu,\n  events-delivered: %u\n",
                         mDisplayEventConnections.size(),
                         mVSyncEvent[DisplayDevice::DISPLAY_PRIMARY].vsync.count);
     for (size_t i = 0; i < mDisplayEventConnections.size(); i++) {
         sp<Connection> connection = mDisplayEventConnections.itemAt(i).promote();
-        result.appendFormat("    %p: count=%d\n", connection.get(),
-                            connection != nullptr ? connection->count : 0);
+        if (connection == nullptr) {
+            result.appendFormat("    %p: count=0\n", connection.get());
+            continue;
+        }
+        result.appendFormat("    %p: count=%d", connection.get(), connection->count);
+        if (connection->vsyncInterval > 0) {
+            result.appendFormat(" interval=%" PRId64 " phase=%" PRId64, connection->vsyncInterval,
+                                connection->vsyncPhase);
+        }
+        const nsecs_t averageLatency = connection->eventsPosted > 0
+                ? connection->totalLatency / connection->eventsPosted
+                : 0;
+        result.appendFormat(" posted=%u dropped=%u latency(last/avg/max)=%.3f/%.3f/%.3f ms\n",
+                            connection->eventsPosted, connection->eventsDropped,
+                            connection->lastLatency / 1e6, averageLatency / 1e6,
+                            connection->maxLatency / 1e6);
     }
 }
 
@@ -391,6 +462,19 @@ void EventThread::Connection::onFirstRef() {
     mEventThread->registerDisplayEventConnection(this);
 }
 
+bool EventThread::Connection::consumeScheduledVsync(nsecs_t timestamp) {
+    // Vsyncs land up to half a refresh period off the schedule when the
+    // interval isn't a multiple of the period, so accept any within a quarter
+    // of the interval, which covers the common 1/2 and 1/3 rate cases.
+    const nsecs_t tolerance = vsyncInterval / 4;
+    if (timestamp + tolerance < nextVsyncTime) {
+        return false;
+    }
+    const nsecs_t elapsed = timestamp + tolerance - vsyncPhase;
+    nextVsyncTime = vsyncPhase + (elapsed / vsyncInterval + 1) * vsyncInterval;
+    return true;
+}
+
 status_t EventThread::Connection::stealReceiveChannel(gui::BitTube* outChannel) {
     outChannel->setReceiveFd(mChannel.moveReceiveFd());
     return NO_ERROR;
@@ -401,6 +485,11 @@ status_t EventThread::Connection::setVsyncRate(uint32_t count) {
     return NO_ERROR;
 }
 
+status_t EventThread::Connection::setVsyncSchedule(nsecs_t interval, nsecs_t phase) {
+    mEventThread->setVsyncSchedule(interval, phase, this);
+    return NO_ERROR;
+}
+
 void EventThread::Connection::requestNextVsync() {
     mEventThread->requestNextVsync(this);
 }
@@ -21,6 +21,7 @@
 #include <condition_variable>
 #include <mutex>
 #include <thread>
+#include <vector>
 
 #include <android-base/thread_annotations.h>
 
@@ -75,6 +76,10 @@ public:
     virtual void dump(String8& result) const = 0;
 
     virtual void setPhaseOffset(nsecs_t phaseOffset) = 0;
+
+    // while idle, continuous connections get no vsync events, so the thread
+    // only wakes up for one-shot requests and other events
+    virtual void setIdle(bool idle) = 0;
 };
 
 namespace impl {
@@ -92,11 +97,34 @@ class EventThread : public android::EventThread, private VSyncSource::Callback {
         // count ==-1 : one-shot event that fired this round / disabled
         int32_t count;
 
+        // if vsyncInterval > 0, only the vsyncs nearest to
+        // vsyncPhase + k * vsyncInterval are reported, the next one being
+        // nextVsyncTime
+        nsecs_t vsyncInterval = 0;
+        nsecs_t vsyncPhase = 0;
+        nsecs_t nextVsyncTime = 0;
+
+        // returns whether the vsync at timestamp is on the schedule, and if
+        // so moves nextVsyncTime past it
+        bool consumeScheduledVsync(nsecs_t timestamp);
+
+        // set when a one-shot request was consumed by the vsync being
+        // posted, so it can be requested again if the post fails
+        bool firedOneShot = false;
+
+        // delivery stats, in nanoseconds from the vsync to the end of the post
+        uint32_t eventsPosted = 0;
+        uint32_t eventsDropped = 0;
+        nsecs_t lastLatency = 0;
+        nsecs_t maxLatency = 0;
+        nsecs_t totalLatency = 0;
+
     private:
         virtual void onFirstRef();
         status_t stealReceiveChannel(gui::BitTube* outChannel) override;
         status_t setVsyncRate(uint32_t count) override;
         void requestNextVsync() override; // asynchronous
+        status_t setVsyncSchedule(nsecs_t interval, nsecs_t phase) override;
         EventThread* const mEventThread;
         gui::BitTube mChannel;
     };
@@ -114,6 +142,7 @@ public:
 
     void setVsyncRate(uint32_t count, const sp<Connection>& connection);
     void requestNextVsync(const sp<Connection>& connection);
+    void setVsyncSchedule(nsecs_t interval, nsecs_t phase, const sp<Connection>& connection);
 
     // called before the screen is turned off from main thread
     void onScreenReleased() override;
@@ -128,6 +157,8 @@ public:
 
     void setPhaseOffset(nsecs_t phaseOffset) override;
 
+    void setIdle(bool idle) override;
+
 private:
     friend EventThreadTest;
 
@@ -148,6 +179,10 @@ private:
     const ResyncWithRateLimitCallback mResyncWithRateLimitCallback;
     const InterceptVSyncsCallback mInterceptVSyncsCallback;
 
+    // the outcome and end time of each post of the current event, only used
+    // by the thread main loop
+    std::vector<std::pair<status_t, nsecs_t>> mPostResults;
+
     std::thread mThread;
     mutable std::mutex mMutex;
     mutable std::condition_variable mCondition;
@@ -158,6 +193,7 @@ private:
     DisplayEventReceiver::Event mVSyncEvent[DisplayDevice::NUM_BUILTIN_DISPLAY_TYPES] GUARDED_BY(
             mMutex);
     bool mUseSoftwareVSync GUARDED_BY(mMutex) = false;
+    bool mIdle GUARDED_BY(mMutex) = false;
     bool mVsyncEnabled GUARDED_BY(mMutex) = false;
     bool mKeepRunning GUARDED_BY(mMutex) = true;
 
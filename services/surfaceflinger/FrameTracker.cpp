@@ -19,6 +19,9 @@
 
 #include <inttypes.h>
 
+#include <algorithm>
+#include <vector>
+
 #include <android/log.h>
 #include <utils/String8.h>
 
@@ -65,6 +68,23 @@ void FrameTracker::setActualPresentFence(
     mNumFences++;
 }
 
+void FrameTracker::setLatchTime(nsecs_t latchTime) {
+    Mutex::Autolock lock(mMutex);
+    mFrameRecords[mOffset].latchTime = latchTime;
+}
+
+void FrameTracker::setCompositionStartTime(nsecs_t compositionStartTime) {
+    Mutex::Autolock lock(mMutex);
+    mFrameRecords[mOffset].compositionStartTime = compositionStartTime;
+}
+
+void FrameTracker::setGpuCompositionDoneFence(
+        std::shared_ptr<FenceTime>&& fence) {
+    Mutex::Autolock lock(mMutex);
+    mFrameRecords[mOffset].gpuCompositionDoneFence = std::move(fence);
+    mNumFences++;
+}
+
 void FrameTracker::setDisplayRefreshPeriod(nsecs_t displayPeriod) {
     Mutex::Autolock lock(mMutex);
     mDisplayPeriod = displayPeriod;
@@ -81,6 +101,9 @@ void FrameTracker::advanceFrame() {
     mFrameRecords[mOffset].desiredPresentTime = INT64_MAX;
     mFrameRecords[mOffset].frameReadyTime = INT64_MAX;
     mFrameRecords[mOffset].actualPresentTime = INT64_MAX;
+    mFrameRecords[mOffset].latchTime = 0;
+    mFrameRecords[mOffset].compositionStartTime = 0;
+    mFrameRecords[mOffset].gpuCompositionDoneTime = 0;
 
     if (mFrameRecords[mOffset].frameReadyFence != nullptr) {
         // We're clobbering an unsignaled fence, so we need to decrement the
@@ -95,6 +118,13 @@ void FrameTracker::advanceFrame() {
         mFrameRecords[mOffset].actualPresentFence = nullptr;
         mNumFences--;
     }
+
+    if (mFrameRecords[mOffset].gpuCompositionDoneFence != nullptr) {
+        // We're clobbering an unsignaled fence, so we need to decrement the
+        // fence count.
+        mFrameRecords[mOffset].gpuCompositionDoneFence = nullptr;
+        mNumFences--;
+    }
 }
 
 void FrameTracker::clearStats() {
@@ -103,8 +133,12 @@ void FrameTracker::clearStats() {
         mFrameRecords[i].desiredPresentTime = 0;
         mFrameRecords[i].frameReadyTime = 0;
         mFrameRecords[i].actualPresentTime = 0;
+        mFrameRecords[i].latchTime = 0;
+        mFrameRecords[i].compositionStartTime = 0;
+        mFrameRecords[i].gpuCompositionDoneTime = 0;
         mFrameRecords[i].frameReadyFence.reset();
         mFrameRecords[i].actualPresentFence.reset();
+        mFrameRecords[i].gpuCompositionDoneFence.reset();
     }
     mNumFences = 0;
     mFrameRecords[mOffset].desiredPresentTime = INT64_MAX;
@@ -173,6 +207,18 @@ void FrameTracker::processFencesLocked() const {
             }
         }
 
+        const std::shared_ptr<FenceTime>& gfence =
+                records[idx].gpuCompositionDoneFence;
+        if (gfence != nullptr) {
+            const nsecs_t gpuDoneTime = gfence->getSignalTime();
+            if (gpuDoneTime < INT64_MAX) {
+                // An invalid fence leaves the stage unrecorded.
+                records[idx].gpuCompositionDoneTime = gpuDoneTime > 0 ? gpuDoneTime : 0;
+                records[idx].gpuCompositionDoneFence = nullptr;
+                numFences--;
+            }
+        }
+
         if (updated) {
             updateStatsLocked(idx);
         }
@@ -245,4 +291,102 @@ void FrameTracker::dumpStats(String8& result) const {
     result.append("\n");
 }
 
+bool FrameTracker::getStageDurationsLocked(size_t idx,
+        nsecs_t durations[NUM_STAGES]) const {
+    const FrameRecord& record = mFrameRecords[idx];
+    if (!isFrameValidLocked(idx) || record.desiredPresentTime <= 0 ||
+            record.frameReadyTime <= 0 || record.frameReadyTime == INT64_MAX ||
+            record.gpuCompositionDoneFence != nullptr) {
+        return false;
+    }
+
+    // Stages that were not recorded take no time, and each stage starts
+    // when the previous one ended.
+    nsecs_t stageStart = record.desiredPresentTime;
+    const nsecs_t stageEnds[NUM_STAGES] = {
+        record.frameReadyTime,
+        record.compositionStartTime,
+        record.gpuCompositionDoneTime,
+        record.actualPresentTime,
+    };
+    for (int i = 0; i < NUM_STAGES; i++) {
+        const nsecs_t stageEnd = stageEnds[i] > stageStart ? stageEnds[i] : stageStart;
+        durations[i] = stageEnd - stageStart;
+        stageStart = stageEnd;
+    }
+    return true;
+}
+
+void FrameTracker::dumpStageStats(String8& result) const {
+    Mutex::Autolock lock(mMutex);
+    processFencesLocked();
+
+    static const char* const kStageNames[NUM_STAGES] = {
+        "app", "compositor", "gpu", "display",
+    };
+
+    nsecs_t durations[NUM_FRAME_RECORDS][NUM_STAGES];
+    bool complete[NUM_FRAME_RECORDS];
+    std::vector<nsecs_t> stageDurations[NUM_STAGES];
+
+    result.append("desired\tapp\tcompositor\tgpu\tdisplay\n");
+    const size_t o = mOffset;
+    for (size_t i = 1; i < NUM_FRAME_RECORDS; i++) {
+        const size_t index = (o+i) % NUM_FRAME_RECORDS;
+        complete[index] = getStageDurationsLocked(index, durations[index]);
+        if (!complete[index]) {
+            continue;
+        }
+        result.appendFormat("%" PRId64 "\t%" PRId64 "\t%" PRId64 "\t%" PRId64 "\t%" PRId64 "\n",
+            mFrameRecords[index].desiredPresentTime,
+            durations[index][STAGE_APP], durations[index][STAGE_COMPOSITOR],
+            durations[index][STAGE_GPU], durations[index][STAGE_DISPLAY]);
+        for (int stage = 0; stage < NUM_STAGES; stage++) {
+            stageDurations[stage].push_back(durations[index][stage]);
+        }
+    }
+
+    // Every frame spends some time in each stage (the display stage includes
+    // waiting for the next refresh), so a missed refresh is blamed on the
+    // stage that ran furthest over its median.
+    nsecs_t medians[NUM_STAGES] = {};
+    for (int stage = 0; stage < NUM_STAGES; stage++) {
+        std::vector<nsecs_t>& values = stageDurations[stage];
+        if (!values.empty()) {
+            std::nth_element(values.begin(), values.begin() + values.size() / 2, values.end());
+            medians[stage] = values[values.size() / 2];
+        }
+    }
+
+    size_t numMissedFrames[NUM_STAGES] = {};
+    for (size_t i = 2; i < NUM_FRAME_RECORDS && mDisplayPeriod > 0; i++) {
+        const size_t index = (o+i) % NUM_FRAME_RECORDS;
+        const size_t prevIndex = (index+NUM_FRAME_RECORDS-1) % NUM_FRAME_RECORDS;
+        if (!complete[index] || !isFrameValidLocked(prevIndex)) {
+            continue;
+        }
+        // A frame missed a refresh if it was presented more than one period
+        // after the previous one.
+        const nsecs_t duration = mFrameRecords[index].actualPresentTime -
+                mFrameRecords[prevIndex].actualPresentTime;
+        if (duration <= mDisplayPeriod + mDisplayPeriod / 2) {
+            continue;
+        }
+        int culprit = 0;
+        for (int stage = 1; stage < NUM_STAGES; stage++) {
+            if (durations[index][stage] - medians[stage] >
+                    durations[index][culprit] - medians[culprit]) {
+                culprit = stage;
+            }
+        }
+        numMissedFrames[culprit]++;
+    }
+
+    result.append("\nmissed frames:");
+    for (int stage = 0; stage < NUM_STAGES; stage++) {
+        result.appendFormat(" %s=%zu", kStageNames[stage], numMissedFrames[stage]);
+    }
+    result.append("\n");
+}
+
 } // namespace android
@@ -71,6 +71,19 @@ public:
     // at which the current frame became visible to the user.
     void setActualPresentFence(std::shared_ptr<FenceTime>&& fence);
 
+    // setLatchTime sets the time at which the compositor latched the current
+    // frame.
+    void setLatchTime(nsecs_t latchTime);
+
+    // setCompositionStartTime sets the time at which the compositor started
+    // the composition that includes the current frame.
+    void setCompositionStartTime(nsecs_t compositionStartTime);
+
+    // setGpuCompositionDoneFence sets the fence that is used to get the time
+    // at which GPU composition of the current frame finished.  It is only set
+    // when the frame went through GPU composition.
+    void setGpuCompositionDoneFence(std::shared_ptr<FenceTime>&& fence);
+
     // setDisplayRefreshPeriod sets the display refresh period in nanoseconds.
     // This is used to compute frame presentation duration statistics relative
     // to this period.
@@ -92,19 +105,40 @@ public:
     // dumpStats dump appends the current frame display time history to the result string.
     void dumpStats(String8& result) const;
 
+    // dumpStageStats appends the time each frame spent in the app, the
+    // compositor, GPU composition and the display, followed by the number of
+    // frames that missed a refresh attributed to the slowest of those stages.
+    void dumpStageStats(String8& result) const;
+
 private:
     struct FrameRecord {
         FrameRecord() :
             desiredPresentTime(0),
             frameReadyTime(0),
-            actualPresentTime(0) {}
+            actualPresentTime(0),
+            latchTime(0),
+            compositionStartTime(0),
+            gpuCompositionDoneTime(0) {}
         nsecs_t desiredPresentTime;
         nsecs_t frameReadyTime;
         nsecs_t actualPresentTime;
+        // The stage times are 0 when they were not recorded for a frame.
+        nsecs_t latchTime;
+        nsecs_t compositionStartTime;
+        nsecs_t gpuCompositionDoneTime;
         std::shared_ptr<FenceTime> frameReadyFence;
         std::shared_ptr<FenceTime> actualPresentFence;
+        std::shared_ptr<FenceTime> gpuCompositionDoneFence;
     };
 
+    // The stages a frame goes through between being queued and being
+    // presented, in order.
+    enum Stage { STAGE_APP, STAGE_COMPOSITOR, STAGE_GPU, STAGE_DISPLAY, NUM_STAGES };
+
+    // getStageDurationsLocked fills in how long the frame at the given index
+    // spent in each stage.  It returns false if the frame is not complete.
+    bool getStageDurationsLocked(size_t idx, nsecs_t durations[NUM_STAGES]) const;
+
     // processFences iterates over all the frame records that have a fence set
     // and replaces that fence with a timestamp if the fence has signaled.  If
     // the fence is not signaled the record's displayTime is set to INT64_MAX.
@@ -16,19 +16,46 @@
 
 #include "GpuService.h"
 
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <binder/IPCThreadState.h>
 #include <binder/IResultReceiver.h>
 #include <binder/Parcel.h>
+#include <binder/PermissionCache.h>
+#include <cutils/ashmem.h>
+#include <private/android_filesystem_config.h>
 #include <utils/String8.h>
 #include <vkjson.h>
 
+#include "SurfaceFlinger.h"
+
 namespace android {
 
 // ----------------------------------------------------------------------------
 
+enum {
+    GET_VULKAN_SNAPSHOT = IBinder::FIRST_CALL_TRANSACTION,
+};
+
 class BpGpuService : public BpInterface<IGpuService>
 {
 public:
     explicit BpGpuService(const sp<IBinder>& impl) : BpInterface<IGpuService>(impl) {}
+
+    virtual status_t getVulkanSnapshot(base::unique_fd* snapshotFd) {
+        Parcel data, reply;
+        data.writeInterfaceToken(IGpuService::getInterfaceDescriptor());
+        status_t status = remote()->transact(GET_VULKAN_SNAPSHOT, data, &reply);
+        if (status != NO_ERROR) {
+            return status;
+        }
+        status = reply.readInt32();
+        if (status != NO_ERROR) {
+            return status;
+        }
+        return reply.readUniqueFileDescriptor(snapshotFd);
+    }
 };
 
 IMPLEMENT_META_INTERFACE(GpuService, "android.ui.IGpuService");
@@ -59,6 +86,17 @@ status_t BnGpuService::onTransact(uint32_t code, const Parcel& data,
         return OK;
     }
 
+    case GET_VULKAN_SNAPSHOT: {
+        CHECK_INTERFACE(IGpuService, data, reply);
+        base::unique_fd snapshotFd;
+        status = getVulkanSnapshot(&snapshotFd);
+        reply->writeInt32(status);
+        if (status == NO_ERROR) {
+            reply->writeUniqueFileDescriptor(snapshotFd);
+        }
+        return NO_ERROR;
+    }
+
     default:
         return BBinder::onTransact(code, data, reply, flags);
     }
@@ -69,11 +107,60 @@ status_t BnGpuService::onTransact(uint32_t code, const Parcel& data,
 namespace {
     status_t cmd_help(int out);
     status_t cmd_vkjson(int out, int err);
+    status_t cmd_vkjson_snapshot(GpuService* service, int out);
 }
 
 const char* const GpuService::SERVICE_NAME = "gpu";
 
-GpuService::GpuService() {}
+GpuService::GpuService(const sp<SurfaceFlinger>& flinger) : mFlinger(flinger) {}
+
+status_t GpuService::getVulkanSnapshot(base::unique_fd* snapshotFd) {
+    std::lock_guard<std::mutex> lock(mSnapshotLock);
+    if (mSnapshotFd < 0) {
+        // Vulkan properties don't change while the device is up, so the first
+        // request pays for loading the driver and every later one is a dup().
+        const std::string json = VkJsonInstanceToJson(VkJsonGetInstance());
+        base::unique_fd fd(ashmem_create_region("vkjson snapshot", json.size()));
+        if (fd < 0) {
+            ALOGE("getVulkanSnapshot: failed to create region: %s", strerror(errno));
+            return NO_MEMORY;
+        }
+        void* addr = mmap(nullptr, json.size(), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (addr == MAP_FAILED) {
+            ALOGE("getVulkanSnapshot: failed to map region: %s", strerror(errno));
+            return NO_MEMORY;
+        }
+        memcpy(addr, json.data(), json.size());
+        munmap(addr, json.size());
+
+        // Only readable from now on, including through this fd.
+        if (ashmem_set_prot_region(fd, PROT_READ) < 0) {
+            ALOGE("getVulkanSnapshot: failed to protect region: %s", strerror(errno));
+            return UNKNOWN_ERROR;
+        }
+        mSnapshotFd = std::move(fd);
+    }
+
+    snapshotFd->reset(dup(mSnapshotFd));
+    return (*snapshotFd < 0) ? -errno : NO_ERROR;
+}
+
+status_t GpuService::dump(int fd, const Vector<String16>& args) {
+    static const String16 sDump("android.permission.DUMP");
+    String8 result;
+
+    IPCThreadState* ipc = IPCThreadState::self();
+    const int pid = ipc->getCallingPid();
+    const int uid = ipc->getCallingUid();
+    if ((uid != AID_SHELL) && !PermissionCache::checkPermission(sDump, pid, uid)) {
+        result.appendFormat("Permission Denial: can't dump gpu from pid=%d, uid=%d\n", pid, uid);
+    } else {
+        mFlinger->dumpGpuStats(args, result);
+    }
+
+    write(fd, result.string(), result.size());
+    return NO_ERROR;
+}
 
 status_t GpuService::shellCommand(int /*in*/, int out, int err,
         Vector<String16>& args)
@@ -85,6 +172,8 @@ status_t GpuService::shellCommand(int /*in*/, int out, int err,
     if (args.size() >= 1) {
         if (args[0] == String16("vkjson"))
             return cmd_vkjson(out, err);
+        if (args[0] == String16("vkjson-snapshot"))
+            return cmd_vkjson_snapshot(this, out);
         if (args[0] == String16("help"))
             return cmd_help(out);
     }
@@ -106,7 +195,8 @@ status_t cmd_help(int out) {
     }
     fprintf(outs,
         "GPU Service commands:\n"
-        "  vkjson   dump Vulkan properties as JSON\n");
+        "  vkjson            dump Vulkan properties as JSON\n"
+        "  vkjson-snapshot   dump the cached Vulkan properties snapshot\n");
     fclose(outs);
     return NO_ERROR;
 }
@@ -129,6 +219,34 @@ status_t cmd_vkjson(int out, int /*err*/) {
     return NO_ERROR;
 }
 
+status_t cmd_vkjson_snapshot(GpuService* service, int out) {
+    base::unique_fd snapshotFd;
+    status_t status = service->getVulkanSnapshot(&snapshotFd);
+    if (status != NO_ERROR) {
+        return status;
+    }
+    int size = ashmem_get_size_region(snapshotFd);
+    if (size < 0) {
+        return -errno;
+    }
+    void* addr = mmap(nullptr, size_t(size), PROT_READ, MAP_SHARED, snapshotFd, 0);
+    if (addr == MAP_FAILED) {
+        return -errno;
+    }
+    FILE* outs = fdopen(out, "w");
+    if (!outs) {
+        int errnum = errno;
+        ALOGE("vkjson: failed to create output stream: %s", strerror(errnum));
+        munmap(addr, size_t(size));
+        return -errnum;
+    }
+    fwrite(addr, 1, size_t(size), outs);
+    fputc('\n', outs);
+    fclose(outs);
+    munmap(addr, size_t(size));
+    return NO_ERROR;
+}
+
 } // anonymous namespace
 
 } // namespace android
@@ -17,11 +17,16 @@
 #ifndef ANDROID_GPUSERVICE_H
 #define ANDROID_GPUSERVICE_H
 
+#include <mutex>
+
+#include <android-base/unique_fd.h>
 #include <binder/IInterface.h>
 #include <cutils/compiler.h>
 
 namespace android {
 
+class SurfaceFlinger;
+
 /*
  * This class defines the Binder IPC interface for GPU-related queries and
  * control.
@@ -29,6 +34,12 @@ namespace android {
 class IGpuService : public IInterface {
 public:
     DECLARE_META_INTERFACE(GpuService);
+
+    // Returns a read-only shared memory region holding the VkJsonInstance of
+    // this device as JSON, taken once per boot. Reading it lets a process pick
+    // a render path without creating a Vulkan instance; map it with PROT_READ
+    // and parse it with VkJsonInstanceFromJson().
+    virtual status_t getVulkanSnapshot(base::unique_fd* snapshotFd) = 0;
 };
 
 class BnGpuService: public BnInterface<IGpuService> {
@@ -45,11 +56,24 @@ class GpuService : public BnGpuService
 public:
     static const char* const SERVICE_NAME ANDROID_API;
 
-    GpuService() ANDROID_API;
+    explicit GpuService(const sp<SurfaceFlinger>& flinger) ANDROID_API;
+
+    virtual status_t getVulkanSnapshot(base::unique_fd* snapshotFd) override;
+
+    // dumpsys gpu: GPU time of client composition per layer, the layer buffers
+    // held for each process, and SurfaceFlinger's own gralloc allocations.
+    // Everything but the layer GPU times is collected when dumped.
+    virtual status_t dump(int fd, const Vector<String16>& args) override;
 
 protected:
     virtual status_t shellCommand(int in, int out, int err,
         Vector<String16>& args) override;
+
+private:
+    const sp<SurfaceFlinger> mFlinger;
+
+    std::mutex mSnapshotLock;
+    base::unique_fd mSnapshotFd;
 };
 
 } // namespace android
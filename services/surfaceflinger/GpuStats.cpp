@@ -0,0 +1,71 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#undef LOG_TAG
+#define LOG_TAG "GpuStats"
+
+#include "GpuStats.h"
+
+#include <inttypes.h>
+
+#include <utils/String8.h>
+
+namespace android {
+
+void GpuStats::enable() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mEnabled) return;
+    mLayerTimes.clear();
+    mEnabled = true;
+}
+
+void GpuStats::disable() {
+    mEnabled = false;
+}
+
+void GpuStats::clear() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mLayerTimes.clear();
+}
+
+void GpuStats::addClientComposition(nsecs_t gpuTime, const std::vector<LayerPixels>& layers) {
+    if (!isEnabled()) return;
+    uint64_t pixelCount = 0;
+    for (const auto& layer : layers) {
+        pixelCount += layer.pixelCount;
+    }
+    if (pixelCount == 0) return;
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    for (const auto& layer : layers) {
+        const nsecs_t share = static_cast<nsecs_t>(
+                static_cast<double>(gpuTime) * layer.pixelCount / pixelCount);
+        LayerTime& time = mLayerTimes[layer.name];
+        time.frames++;
+        time.total += share;
+        if (share > time.max) time.max = share;
+    }
+}
+
+void GpuStats::dump(String8& result) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    for (const auto& entry : mLayerTimes) {
+        const LayerTime& time = entry.second;
+        result.appendFormat("%s: frames=%" PRIu64 " total=%" PRId64 " max=%" PRId64 "\n",
+                            entry.first.c_str(), time.frames, time.total, time.max);
+    }
+}
+
+}  // namespace android
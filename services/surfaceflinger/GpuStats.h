@@ -0,0 +1,63 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <utils/Timers.h>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace android {
+class String8;
+
+// GPU time of the client compositions of the primary display, from their start
+// until the RenderEngine fence signals, shared among the layers composed in
+// proportion to the pixels each covered. Accumulated while enabled with
+// dumpsys gpu --enable-layer-gpu-times, as it keeps the layer names of every
+// client composition until its fence signals.
+class GpuStats {
+public:
+    struct LayerPixels {
+        std::string name;
+        uint64_t pixelCount;
+    };
+
+    void enable();
+    void disable();
+    void clear();
+    bool isEnabled() const { return mEnabled.load(std::memory_order_relaxed); }
+    // Accounts a client composition that took |gpuTime| for |layers|
+    void addClientComposition(nsecs_t gpuTime, const std::vector<LayerPixels>& layers);
+    // One line per layer: "<layer>: frames=<n> total=<ns> max=<ns>"
+    void dump(String8& result);
+
+private:
+    struct LayerTime {
+        uint64_t frames = 0;
+        nsecs_t total = 0;
+        nsecs_t max = 0;
+    };
+
+    std::atomic<bool> mEnabled{false};
+    // Protect mLayerTimes, which addClientComposition() updates from the main thread
+    std::mutex mMutex;
+    std::map<std::string, LayerTime> mLayerTimes;
+};
+
+}  // namespace android
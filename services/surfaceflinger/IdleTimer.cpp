@@ -0,0 +1,65 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <pthread.h>
+
+#include "IdleTimer.h"
+
+namespace android {
+
+IdleTimer::IdleTimer(std::chrono::milliseconds interval, ExpiredFunction function)
+      : mInterval(interval), mExpired(function) {
+    pthread_setname_np(mThread.native_handle(), "IdleTimer");
+}
+
+IdleTimer::~IdleTimer() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mKeepRunning = false;
+        mCondition.notify_all();
+    }
+    mThread.join();
+}
+
+void IdleTimer::reset() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mResetPending = true;
+    mCondition.notify_all();
+}
+
+// Unfortunately std::unique_lock gives warnings with -Wthread-safety
+void IdleTimer::threadMain() NO_THREAD_SAFETY_ANALYSIS {
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (mKeepRunning) {
+        mResetPending = false;
+        bool woken = mCondition.wait_for(lock, mInterval, [this]() NO_THREAD_SAFETY_ANALYSIS {
+            return mResetPending || !mKeepRunning;
+        });
+        if (woken) {
+            continue;
+        }
+
+        lock.unlock();
+        mExpired();
+        lock.lock();
+
+        mCondition.wait(lock, [this]() NO_THREAD_SAFETY_ANALYSIS {
+            return mResetPending || !mKeepRunning;
+        });
+    }
+}
+
+} // namespace android
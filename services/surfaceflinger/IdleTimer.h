@@ -0,0 +1,58 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include <android-base/thread_annotations.h>
+
+namespace android {
+
+/*
+ * Calls a function once reset() has not been called for a given interval.
+ * It then waits for the next reset() before it starts counting again, so the
+ * function is called once per idle period.
+ */
+class IdleTimer final {
+public:
+    using ExpiredFunction = std::function<void()>;
+
+    IdleTimer(std::chrono::milliseconds interval, ExpiredFunction function);
+    ~IdleTimer();
+
+    void reset();
+
+private:
+    void threadMain();
+
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+
+    const std::chrono::milliseconds mInterval;
+    const ExpiredFunction mExpired;
+    bool mResetPending GUARDED_BY(mMutex) = false;
+    bool mKeepRunning GUARDED_BY(mMutex) = true;
+
+    // Must be last so that everything is initialized before the thread starts.
+    std::thread mThread{&IdleTimer::threadMain, this};
+};
+
+} // namespace android
@@ -73,6 +73,7 @@ int32_t Layer::sSequence = 1;
 Layer::Layer(SurfaceFlinger* flinger, const sp<Client>& client, const String8& name, uint32_t w,
              uint32_t h, uint32_t flags)
       : contentDirty(false),
+        visibleRegionsDirtyGeneration(0),
         sequence(uint32_t(android_atomic_inc(&sSequence))),
         mFlinger(flinger),
         mPremultipliedAlpha(true),
@@ -215,6 +216,11 @@ const String8& Layer::getName() const {
     return mName;
 }
 
+pid_t Layer::getOwnerPid() const {
+    sp<Client> client(mClientRef.promote());
+    return client != nullptr ? client->getPid() : -1;
+}
+
 bool Layer::getPremultipledAlpha() const {
     return mPremultipliedAlpha;
 }
@@ -596,6 +602,7 @@ void Layer::setGeometry(const sp<const DisplayDevice>& displayDevice, uint32_t z
     error = hwcLayer->setZOrder(z);
     ALOGE_IF(error != HWC2::Error::None, "[%s] Failed to set Z %u: %s (%d)", mName.string(), z,
              to_string(error).c_str(), static_cast<int32_t>(error));
+    hwcInfo.z = z;
 
     int type = s.type;
     int appId = s.appId;
@@ -660,6 +667,11 @@ void Layer::setGeometry(const sp<const DisplayDevice>& displayDevice, uint32_t z
     }
 }
 
+bool Layer::hasHwcZOrder(int32_t hwcId, uint32_t z) const {
+    auto it = getBE().mHwcLayers.find(hwcId);
+    return it != getBE().mHwcLayers.end() && it->second.z == z;
+}
+
 void Layer::forceClientComposition(int32_t hwcId) {
     if (getBE().mHwcLayers.count(hwcId) == 0) {
         ALOGE("forceClientComposition: no HWC layer found (%d)", hwcId);
@@ -877,6 +889,8 @@ bool Layer::isSecure() const {
 void Layer::setVisibleRegion(const Region& visibleRegion) {
     // always called from main thread
     this->visibleRegion = visibleRegion;
+    mTracingDirty = true;
+    mProtoGeneration++;
 }
 
 void Layer::setCoveredRegion(const Region& coveredRegion) {
@@ -895,6 +909,22 @@ void Layer::clearVisibilityRegions() {
     coveredRegion.clear();
 }
 
+void Layer::setVisibleRegionsDirty(LayerVector::StateSet stateSet, uint64_t generation) {
+    if (visibleRegionsDirtyGeneration == generation) {
+        // already marked, along with the rest of our tree
+        return;
+    }
+    visibleRegionsDirtyGeneration = generation;
+
+    // children are clipped to and positioned by their parent, so their
+    // visible regions move along with ours
+    const bool useDrawing = stateSet == LayerVector::StateSet::Drawing;
+    const LayerVector& children = useDrawing ? mDrawingChildren : mCurrentChildren;
+    for (const sp<Layer>& child : children) {
+        child->setVisibleRegionsDirty(stateSet, generation);
+    }
+}
+
 // ----------------------------------------------------------------------------
 // transaction
 // ----------------------------------------------------------------------------
@@ -934,9 +964,9 @@ void Layer::pushPendingState() {
 }
 
 void Layer::popPendingState(State* stateToCommit) {
-    *stateToCommit = mPendingStates[0];
+    *stateToCommit = mPendingStates.front();
 
-    mPendingStates.removeAt(0);
+    mPendingStates.pop_front();
     ATRACE_INT(mTransactionName.string(), mPendingStates.size());
 }
 
@@ -993,6 +1023,8 @@ bool Layer::applyPendingStates(State* stateToCommit) {
 
 uint32_t Layer::doTransaction(uint32_t flags) {
     ATRACE_CALL();
+    mTracingDirty = true;
+    mProtoGeneration++;
 
     pushPendingState();
     Layer::State c = getCurrentState();
@@ -1116,6 +1148,8 @@ uint32_t Layer::getTransactionFlags(uint32_t flags) {
 }
 
 uint32_t Layer::setTransactionFlags(uint32_t flags) {
+    // every change to the current state is followed by this
+    mProtoGeneration++;
     return android_atomic_or(flags, &mTransactionFlags);
 }
 
@@ -1150,6 +1184,7 @@ bool Layer::setChildLayer(const sp<Layer>& childLayer, int32_t z) {
     if (childLayer->setLayer(z)) {
         mCurrentChildren.removeAt(idx);
         mCurrentChildren.add(childLayer);
+        mProtoGeneration++;
         return true;
     }
     return false;
@@ -1164,6 +1199,7 @@ bool Layer::setChildRelativeLayer(const sp<Layer>& childLayer,
     if (childLayer->setRelativeLayer(relativeToHandle, relativeZ)) {
         mCurrentChildren.removeAt(idx);
         mCurrentChildren.add(childLayer);
+        mProtoGeneration++;
         return true;
     }
     return false;
@@ -1514,6 +1550,10 @@ void Layer::dumpFrameStats(String8& result) const {
     mFrameTracker.dumpStats(result);
 }
 
+void Layer::dumpFrameStageStats(String8& result) const {
+    mFrameTracker.dumpStageStats(result);
+}
+
 void Layer::clearFrameStats() {
     mFrameTracker.clearStats();
 }
@@ -1573,11 +1613,13 @@ size_t Layer::getChildrenCount() const {
 
 void Layer::addChild(const sp<Layer>& layer) {
     mCurrentChildren.add(layer);
+    mProtoGeneration++;
     layer->setParent(this);
 }
 
 ssize_t Layer::removeChild(const sp<Layer>& layer) {
     layer->setParent(nullptr);
+    mProtoGeneration++;
     return mCurrentChildren.remove(layer);
 }
 
@@ -1603,6 +1645,7 @@ bool Layer::reparentChildren(const sp<IBinder>& newParentHandle) {
         }
     }
     mCurrentChildren.clear();
+    mProtoGeneration++;
 
     return true;
 }
@@ -1662,6 +1705,7 @@ bool Layer::isLegacyDataSpace() const {
 
 void Layer::setParent(const sp<Layer>& layer) {
     mCurrentParent = layer;
+    mProtoGeneration++;
 }
 
 void Layer::clearSyncPoints() {
@@ -1998,7 +2042,8 @@ void Layer::writeToProto(LayerProto* layerInfo, LayerVector::StateSet stateSet)
     layerInfo->set_app_id(state.appId);
     layerInfo->set_curr_frame(mCurrentFrameNumber);
 
-    for (const auto& pendingState : mPendingStates) {
+    for (size_t i = 0; i < mPendingStates.size(); i++) {
+        const auto& pendingState = mPendingStates[i];
         auto barrierLayer = pendingState.barrierLayer.promote();
         if (barrierLayer != nullptr) {
             BarrierLayerProto* barrierLayerProto = layerInfo->add_barrier_layer();
@@ -2008,6 +2053,39 @@ void Layer::writeToProto(LayerProto* layerInfo, LayerVector::StateSet stateSet)
     }
 }
 
+uint64_t Layer::getProtoGeneration() const {
+    // mixed rather than summed, so that moving to a parent with a lower
+    // generation can't give back an earlier value
+    uint64_t generation = mProtoGeneration;
+    for (sp<Layer> parent = mCurrentParent.promote(); parent != nullptr;
+         parent = parent->mCurrentParent.promote()) {
+        generation = generation * 0x9e3779b97f4a7c15ULL + parent->mProtoGeneration;
+    }
+    return generation;
+}
+
+void Layer::appendCurrentStateToProto(std::string* layersProto) {
+    ProtoCacheKey key;
+    key.generation = getProtoGeneration();
+    key.frameNumber = mCurrentFrameNumber;
+    key.queuedFrames = getQueuedFrameCount();
+    key.bufferLatched = isBufferLatched();
+    key.pendingStates = mPendingStates.size();
+    key.buffer = getBE().compositionInfo.mBuffer.get();
+
+    Mutex::Autolock lock(mProtoCacheLock);
+    if (!mProtoCacheValid || !(key == mProtoCacheKey)) {
+        // A LayersProto holding only this layer serializes to the bytes of one
+        // entry of its layers field, which concatenate into the full message.
+        LayersProto entry;
+        writeToProto(entry.add_layers(), LayerVector::StateSet::Current);
+        mProtoCache = entry.SerializeAsString();
+        mProtoCacheKey = key;
+        mProtoCacheValid = true;
+    }
+    layersProto->append(mProtoCache);
+}
+
 void Layer::writeToProto(LayerProto* layerInfo, int32_t hwcId) {
     writeToProto(layerInfo, LayerVector::StateSet::Drawing);
 
@@ -35,11 +35,13 @@
 
 #include <list>
 #include <cstdint>
+#include <utility>
 
 #include "Client.h"
 #include "FrameTracker.h"
 #include "LayerVector.h"
 #include "MonitoredProducer.h"
+#include "RecyclingQueue.h"
 #include "SurfaceFlinger.h"
 #include "TimeStats/TimeStats.h"
 #include "Transform.h"
@@ -116,7 +118,8 @@ public:
                 forceClientComposition(false),
                 compositionType(HWC2::Composition::Invalid),
                 clearClientTarget(false),
-                transform(HWC2::Transform::None) {}
+                transform(HWC2::Transform::None),
+                z(0) {}
 
         HWComposer* hwc;
         HWC2::Layer* layer;
@@ -127,6 +130,8 @@ public:
         FloatRect sourceCrop;
         HWComposerBufferCache bufferCache;
         HWC2::Transform transform;
+        // Z order last sent by setGeometry()
+        uint32_t z;
     };
 
     // A layer can be attached to multiple displays when operating in mirror mode
@@ -151,6 +156,11 @@ public:
     Region visibleNonTransparentRegion;
     Region surfaceDamageRegion;
 
+    // Generation of the visible-region pass in which this layer's visible
+    // regions must be recomputed. Compared against SurfaceFlinger's current
+    // generation by the incremental computeVisibleRegions().
+    uint64_t visibleRegionsDirtyGeneration;
+
     // Layer serial number.  This gives layers an explicit ordering, so we
     // have a stable sort order when their layer stack and Z-order are
     // the same.
@@ -226,6 +236,7 @@ public:
     virtual ~Layer();
 
     void setPrimaryDisplayOnly() { mPrimaryDisplayOnly = true; }
+    bool isPrimaryDisplayOnly() const { return mPrimaryDisplayOnly; }
 
     // ------------------------------------------------------------------------
     // Geometry setting functions.
@@ -373,6 +384,15 @@ public:
 
     void writeToProto(LayerProto* layerInfo, int32_t hwcId);
 
+    // Returns whether the layer may have changed since it was last written to
+    // a delta trace, and clears that.
+    bool takeTracingDirty() { return std::exchange(mTracingDirty, false); }
+
+    // Appends the current state to layersProto as a serialized entry of
+    // LayersProto.layers, serializing it again only if something it depends on
+    // may have changed since the last call.
+    void appendCurrentStateToProto(std::string* layersProto);
+
 protected:
     /*
      * onDraw - draws the surface.
@@ -386,6 +406,8 @@ public:
     virtual bool isHdrY410() const { return false; }
 
     void setGeometry(const sp<const DisplayDevice>& displayDevice, uint32_t z);
+    // Whether setGeometry() was last called with this z on the given display.
+    bool hasHwcZOrder(int32_t hwcId, uint32_t z) const;
     void forceClientComposition(int32_t hwcId);
     bool getForceClientComposition(int32_t hwcId);
     virtual void setPerFrameData(const sp<const DisplayDevice>& displayDevice) = 0;
@@ -466,6 +488,12 @@ public:
      */
     void clearVisibilityRegions();
 
+    /*
+     * Mark this layer and all of its descendants in the given state set as
+     * needing their visible regions recomputed in the given generation.
+     */
+    void setVisibleRegionsDirty(LayerVector::StateSet stateSet, uint64_t generation);
+
     /*
      * latchBuffer - called each time the screen is redrawn and returns whether
      * the visible regions need to be recomputed (this is a fairly heavy
@@ -509,6 +537,7 @@ public:
     }
 
     int32_t getQueuedFrameCount() const { return mQueuedFrames; }
+    uint64_t getCurrentFrameNumber() const { return mCurrentFrameNumber; }
 
     // -----------------------------------------------------------------------
 
@@ -544,6 +573,7 @@ public:
     static void miniDumpHeader(String8& result);
     void miniDump(String8& result, int32_t hwcId) const;
     void dumpFrameStats(String8& result) const;
+    void dumpFrameStageStats(String8& result) const;
     void dumpFrameEvents(String8& result);
     void clearFrameStats();
     void logFrameStats();
@@ -706,6 +736,10 @@ public:
 
     sp<IBinder> getHandle();
     const String8& getName() const;
+    // The buffer last latched, if any
+    sp<GraphicBuffer> getActiveBuffer() const { return mActiveBuffer; }
+    // The process of the client that created the layer, or -1 once it is gone
+    pid_t getOwnerPid() const;
     virtual void notifyAvailableFrames() {}
     virtual PixelFormat getPixelFormat() const { return PIXEL_FORMAT_NONE; }
     bool getPremultipledAlpha() const;
@@ -727,7 +761,9 @@ protected:
 
     // Accessed from main thread and binder threads
     Mutex mPendingStateMutex;
-    Vector<State> mPendingStates;
+    // Deferred transactions can make this queue long; its slots are reused
+    // so that it doesn't allocate on the composition thread.
+    RecyclingQueue<State> mPendingStates;
 
     // thread-safe
     volatile int32_t mQueuedFrames;
@@ -741,7 +777,6 @@ protected:
     Mutex mFrameEventHistoryMutex;
     ConsumerFrameEventHistory mFrameEventHistory;
     FenceTimeline mAcquireTimeline;
-    FenceTimeline mReleaseTimeline;
 
     TimeStats& mTimeStats = TimeStats::getInstance();
 
@@ -764,6 +799,34 @@ protected:
 
     bool mPendingRemoval = false;
 
+    // set whenever the traced state may have changed, see takeTracingDirty()
+    bool mTracingDirty = true;
+
+    // Bumped whenever the state writeToProto() reads from this layer may have
+    // changed, apart from what ProtoCacheKey reads directly.
+    std::atomic<uint64_t> mProtoGeneration{0};
+    // combines the parents', whose state the transform and color derive from
+    uint64_t getProtoGeneration() const;
+
+    struct ProtoCacheKey {
+        uint64_t generation = 0;
+        uint64_t frameNumber = 0;
+        int32_t queuedFrames = 0;
+        bool bufferLatched = false;
+        size_t pendingStates = 0;
+        const GraphicBuffer* buffer = nullptr;
+
+        bool operator==(const ProtoCacheKey& other) const {
+            return generation == other.generation && frameNumber == other.frameNumber &&
+                    queuedFrames == other.queuedFrames && bufferLatched == other.bufferLatched &&
+                    pendingStates == other.pendingStates && buffer == other.buffer;
+        }
+    };
+    Mutex mProtoCacheLock;
+    bool mProtoCacheValid = false;
+    ProtoCacheKey mProtoCacheKey;
+    std::string mProtoCache;
+
     // page-flip thread (currently main thread)
     bool mProtectedByApp; // application requires protected path to external sink
 
@@ -21,8 +21,11 @@
 #include "DisplayHardware/HWComposer.h"
 #include "ui/DebugUtils.h"
 
+#include <inttypes.h>
+
 #include <android-base/stringprintf.h>
 #include <log/log.h>
+#include <ui/Region.h>
 #include <utils/String8.h>
 #include <utils/Trace.h>
 
@@ -33,6 +36,7 @@ void LayerStats::enable() {
     std::lock_guard<std::mutex> lock(mMutex);
     if (mEnabled) return;
     mLayerShapeStatsMap.clear();
+    mLayerCostStatsMap.clear();
     mEnabled = true;
     ALOGD("Logging enabled");
 }
@@ -49,6 +53,7 @@ void LayerStats::clear() {
     ATRACE_CALL();
     std::lock_guard<std::mutex> lock(mMutex);
     mLayerShapeStatsMap.clear();
+    mLayerCostStatsMap.clear();
     ALOGD("Cleared current layer stats");
 }
 
@@ -126,6 +131,49 @@ void LayerStats::dump(String8& result) {
     }
 }
 
+void LayerStats::logLayerCpuCost(const std::string& name, CpuCost cost, nsecs_t duration) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (!mEnabled) return;
+    LayerCostStats& stats = mLayerCostStatsMap[name];
+    switch (cost) {
+        case CpuCost::Draw:
+            stats.drawTime += duration;
+            break;
+        case CpuCost::SetGeometry:
+            stats.setGeometryTime += duration;
+            break;
+        case CpuCost::LatchBuffer:
+            stats.latchBufferTime += duration;
+            break;
+    }
+}
+
+void LayerStats::logLayerClientComposition(const std::string& name, const Region& clip) {
+    uint64_t pixels = 0;
+    for (const Rect& rect : clip) {
+        pixels += static_cast<uint64_t>(rect.getWidth()) * rect.getHeight();
+    }
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (!mEnabled) return;
+    LayerCostStats& stats = mLayerCostStatsMap[name];
+    stats.clientCompositionFrames++;
+    stats.clientCompositionPixels += pixels;
+}
+
+void LayerStats::dumpLayerCost(String8& result) {
+    ATRACE_CALL();
+    std::lock_guard<std::mutex> lock(mMutex);
+    result.append("Layer,DrawUs,SetGeometryUs,LatchBufferUs,ClientFrames,ClientPixels\n");
+    for (auto& u : mLayerCostStatsMap) {
+        const LayerCostStats& stats = u.second;
+        result.appendFormat("%s,%" PRId64 ",%" PRId64 ",%" PRId64 ",%u,%" PRIu64 "\n",
+                            u.first.c_str(), ns2us(stats.drawTime),
+                            ns2us(stats.setGeometryTime), ns2us(stats.latchBufferTime),
+                            stats.clientCompositionFrames, stats.clientCompositionPixels);
+    }
+}
+
 const char* LayerStats::destinationLocation(int32_t location, int32_t range, bool isHorizontal) {
     static const char* locationArray[8] = {"0", "1/8", "1/4", "3/8", "1/2", "5/8", "3/4", "7/8"};
     int32_t ratio = location * 8 / range;
@@ -18,22 +18,32 @@
 
 #include <layerproto/LayerProtoHeader.h>
 #include <layerproto/LayerProtoParser.h>
+#include <utils/Timers.h>
 #include <mutex>
 #include <unordered_map>
 
 using namespace android::surfaceflinger;
 
 namespace android {
+class Region;
 class String8;
 
 class LayerStats {
 public:
+    // Layer operations whose CPU time is accounted per layer
+    enum class CpuCost { Draw, SetGeometry, LatchBuffer };
+
     void enable();
     void disable();
     void clear();
     bool isEnabled();
     void logLayerStats(const LayersProto& layersProto);
     void dump(String8& result);
+    // Account CPU time spent by the named layer in the given operation
+    void logLayerCpuCost(const std::string& name, CpuCost cost, nsecs_t duration);
+    // Account the pixels of the named layer drawn with client composition
+    void logLayerClientComposition(const std::string& name, const Region& clip);
+    void dumpLayerCost(String8& result);
 
 private:
     // Traverse layer tree to get all visible layers' stats
@@ -64,13 +74,23 @@ private:
     // Return whether the original buffer is H-flipped in final composition
     static bool isHFlipped(int32_t transform);
 
+    struct LayerCostStats {
+        nsecs_t drawTime = 0;
+        nsecs_t setGeometryTime = 0;
+        nsecs_t latchBufferTime = 0;
+        uint32_t clientCompositionFrames = 0;
+        uint64_t clientCompositionPixels = 0;
+    };
+
     bool mEnabled = false;
-    // Protect mLayersStatsMap
+    // Protect mLayersStatsMap and mLayerCostStatsMap
     std::mutex mMutex;
     // Hashmap for tracking the frame(layer shape) stats
     // KEY is a concatenation of all layers' properties within a frame
     // VALUE is the number of times this particular set has been scanned out
     std::unordered_map<std::string, uint32_t> mLayerShapeStatsMap;
+    // Hashmap for tracking the composition cost of each layer, keyed by layer name
+    std::unordered_map<std::string, LayerCostStats> mLayerCostStatsMap;
 };
 
 }  // namespace android
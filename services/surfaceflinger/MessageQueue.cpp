@@ -64,8 +64,27 @@ void MessageQueue::Handler::dispatchInvalidate() {
     }
 }
 
+void MessageQueue::Handler::dispatchMessages() {
+    if ((android_atomic_or(eventMaskMessages, &mEventMask) & eventMaskMessages) == 0) {
+        mQueue.mLooper->sendMessage(this, Message(MESSAGES));
+    }
+}
+
 void MessageQueue::Handler::handleMessage(const Message& message) {
     switch (message.what) {
+        case MESSAGES:
+            // Sending the message again queues it after the frame that is due.
+            if ((android_atomic_acquire_load(&mEventMask) &
+                 (eventMaskInvalidate | eventMaskRefresh)) != 0 &&
+                mDeferrals < kMaxDeferrals) {
+                mDeferrals++;
+                mQueue.mLooper->sendMessage(this, Message(MESSAGES));
+                break;
+            }
+            mDeferrals = 0;
+            android_atomic_and(~eventMaskMessages, &mEventMask);
+            mQueue.processMessages();
+            break;
         case INVALIDATE:
             android_atomic_and(~eventMaskInvalidate, &mEventMask);
             mQueue.mFlinger->onMessageReceived(message.what);
@@ -124,15 +143,32 @@ void MessageQueue::waitMessage() {
 }
 
 status_t MessageQueue::postMessage(const sp<MessageBase>& messageHandler, nsecs_t relTime) {
-    const Message dummyMessage;
     if (relTime > 0) {
+        const Message dummyMessage;
         mLooper->sendMessageDelayed(relTime, messageHandler, dummyMessage);
     } else {
-        mLooper->sendMessage(messageHandler, dummyMessage);
+        {
+            std::lock_guard<std::mutex> lock(mMessagesLock);
+            mMessages.push_back(messageHandler);
+        }
+        mHandler->dispatchMessages();
     }
     return NO_ERROR;
 }
 
+void MessageQueue::processMessages() {
+    {
+        std::lock_guard<std::mutex> lock(mMessagesLock);
+        mMessages.swap(mProcessingMessages);
+    }
+    // Messages posted by these handlers are run by the next dispatch.
+    const Message dummyMessage;
+    for (const auto& message : mProcessingMessages) {
+        message->handleMessage(dummyMessage);
+    }
+    mProcessingMessages.clear();
+}
+
 void MessageQueue::invalidate() {
     mEvents->requestNextVsync();
 }
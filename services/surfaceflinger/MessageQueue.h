@@ -31,6 +31,8 @@
 #include "Barrier.h"
 
 #include <functional>
+#include <mutex>
+#include <vector>
 
 namespace android {
 
@@ -96,17 +98,30 @@ public:
 
 namespace impl {
 
+// Messages posted without a delay are queued here rather than each going through the Looper,
+// and run together once INVALIDATE and REFRESH, if either is due, have been handled.
 class MessageQueue final : public android::MessageQueue {
     class Handler : public MessageHandler {
-        enum { eventMaskInvalidate = 0x1, eventMaskRefresh = 0x2, eventMaskTransaction = 0x4 };
+        enum {
+            eventMaskInvalidate = 0x1,
+            eventMaskRefresh = 0x2,
+            eventMaskTransaction = 0x4,
+            eventMaskMessages = 0x8
+        };
+        // what of the Looper message that runs the queued messages
+        enum { MESSAGES = 2 };
+        // bounds how long a frame after another can hold back the messages
+        static constexpr int kMaxDeferrals = 2;
         MessageQueue& mQueue;
         int32_t mEventMask;
+        int mDeferrals = 0;
 
     public:
         explicit Handler(MessageQueue& queue) : mQueue(queue), mEventMask(0) {}
         virtual void handleMessage(const Message& message);
         void dispatchRefresh();
         void dispatchInvalidate();
+        void dispatchMessages();
     };
 
     friend class Handler;
@@ -118,8 +133,14 @@ class MessageQueue final : public android::MessageQueue {
     gui::BitTube mEventTube;
     sp<Handler> mHandler;
 
+    std::mutex mMessagesLock;
+    std::vector<sp<MessageHandler>> mMessages;
+    // only accessed from the main thread, kept to reuse its storage
+    std::vector<sp<MessageHandler>> mProcessingMessages;
+
     static int cb_eventReceiver(int fd, int events, void* data);
     int eventReceiver(int fd, int events);
+    void processMessages();
 
 public:
     ~MessageQueue() override = default;
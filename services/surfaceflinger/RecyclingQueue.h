@@ -0,0 +1,83 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stddef.h>
+
+#include <utility>
+#include <vector>
+
+namespace android {
+
+/*
+ * A FIFO queue backed by a ring of slots that are reused instead of being
+ * destroyed when elements are popped. Pushing copy-assigns into an existing
+ * slot, so a queue that has reached its working size no longer allocates, and
+ * popping never shifts the remaining elements.
+ *
+ * Popped slots keep their last value until they are overwritten, so T should
+ * not own anything whose lifetime matters.
+ */
+template <typename T>
+class RecyclingQueue {
+public:
+    bool empty() const { return mSize == 0; }
+    size_t size() const { return mSize; }
+
+    // i-th element from the front
+    const T& operator[](size_t i) const { return mSlots[(mHead + i) % mSlots.size()]; }
+    T& operator[](size_t i) { return mSlots[(mHead + i) % mSlots.size()]; }
+
+    const T& front() const { return (*this)[0]; }
+    T& front() { return (*this)[0]; }
+
+    void push_back(const T& value) {
+        if (mSize == mSlots.size()) {
+            grow();
+        }
+        mSlots[(mHead + mSize) % mSlots.size()] = value;
+        mSize++;
+    }
+
+    void pop_front() {
+        mHead = (mHead + 1) % mSlots.size();
+        mSize--;
+    }
+
+private:
+    void grow() {
+        if (mSlots.empty()) {
+            mSlots.resize(1);
+            return;
+        }
+        // rotate the used slots to the start so the new ones follow them
+        std::vector<T> slots;
+        slots.reserve(mSlots.size() * 2);
+        for (size_t i = 0; i < mSize; i++) {
+            slots.push_back(std::move((*this)[i]));
+        }
+        slots.resize(mSlots.size() * 2);
+        mSlots.swap(slots);
+        mHead = 0;
+    }
+
+    std::vector<T> mSlots;
+    size_t mHead = 0;
+    size_t mSize = 0;
+};
+
+}; // namespace android
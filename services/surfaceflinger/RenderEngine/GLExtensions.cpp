@@ -109,6 +109,9 @@ void GLExtensions::initWithEGLStrings(char const* eglVersion, char const* eglExt
     if (hasEGLExtension("EGL_IMG_context_priority")) {
         mHasContextPriority = true;
     }
+    if (hasEGLExtension("EGL_EXT_buffer_age")) {
+        mHasBufferAge = true;
+    }
 }
 
 char const* GLExtensions::getEGLVersion() const {
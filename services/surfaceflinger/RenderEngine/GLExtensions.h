@@ -42,6 +42,7 @@ class GLExtensions : public Singleton<GLExtensions> {
     bool mHasImageCrop = false;
     bool mHasProtectedContent = false;
     bool mHasContextPriority = false;
+    bool mHasBufferAge = false;
 
     String8 mVendor;
     String8 mRenderer;
@@ -69,6 +70,7 @@ public:
     bool hasImageCrop() const { return mHasImageCrop; }
     bool hasProtectedContent() const { return mHasProtectedContent; }
     bool hasContextPriority() const { return mHasContextPriority; }
+    bool hasBufferAge() const { return mHasBufferAge; }
 
     void initWithGLStrings(GLubyte const* vendor, GLubyte const* renderer, GLubyte const* version,
                            GLubyte const* extensions);
@@ -123,33 +123,45 @@ String8& Program::dumpShader(String8& result, GLenum /*type*/) {
 }
 
 void Program::setUniforms(const Description& desc) {
-    // TODO: we should have a mechanism here to not always reset uniforms that
-    // didn't change for this program.
-
+    // Only upload the uniforms that changed since this program was last used.
     if (mSamplerLoc >= 0) {
-        glUniform1i(mSamplerLoc, 0);
-        glUniformMatrix4fv(mTextureMatrixLoc, 1, GL_FALSE, desc.mTexture.getMatrix().asArray());
+        if (!mSamplerSet) {
+            glUniform1i(mSamplerLoc, 0);
+            mSamplerSet = true;
+        }
+        if (mTextureMatrix.update(desc.mTexture.getMatrix())) {
+            glUniformMatrix4fv(mTextureMatrixLoc, 1, GL_FALSE, mTextureMatrix.value.asArray());
+        }
     }
     if (mColorLoc >= 0) {
-        const float color[4] = {desc.mColor.r, desc.mColor.g, desc.mColor.b, desc.mColor.a};
-        glUniform4fv(mColorLoc, 1, color);
+        const vec4 color(desc.mColor.r, desc.mColor.g, desc.mColor.b, desc.mColor.a);
+        if (mColor.update(color)) {
+            glUniform4fv(mColorLoc, 1, &mColor.value[0]);
+        }
     }
     if (mInputTransformMatrixLoc >= 0) {
-        mat4 inputTransformMatrix = mat4(desc.mInputTransformMatrix);
-        glUniformMatrix4fv(mInputTransformMatrixLoc, 1, GL_FALSE, inputTransformMatrix.asArray());
+        if (mInputTransformMatrix.update(mat4(desc.mInputTransformMatrix))) {
+            glUniformMatrix4fv(mInputTransformMatrixLoc, 1, GL_FALSE,
+                               mInputTransformMatrix.value.asArray());
+        }
     }
     if (mOutputTransformMatrixLoc >= 0) {
         // The output transform matrix and color matrix can be combined as one matrix
         // that is applied right before applying OETF.
-        mat4 outputTransformMatrix = desc.mColorMatrix * desc.mOutputTransformMatrix;
-        glUniformMatrix4fv(mOutputTransformMatrixLoc, 1, GL_FALSE,
-                           outputTransformMatrix.asArray());
+        if (mOutputTransformMatrix.update(desc.mColorMatrix * desc.mOutputTransformMatrix)) {
+            glUniformMatrix4fv(mOutputTransformMatrixLoc, 1, GL_FALSE,
+                               mOutputTransformMatrix.value.asArray());
+        }
     }
     if (mDisplayMaxLuminanceLoc >= 0) {
-        glUniform1f(mDisplayMaxLuminanceLoc, desc.mDisplayMaxLuminance);
+        if (mDisplayMaxLuminance.update(desc.mDisplayMaxLuminance)) {
+            glUniform1f(mDisplayMaxLuminanceLoc, desc.mDisplayMaxLuminance);
+        }
     }
     // these uniforms are always present
-    glUniformMatrix4fv(mProjectionMatrixLoc, 1, GL_FALSE, desc.mProjectionMatrix.asArray());
+    if (mProjectionMatrix.update(desc.mProjectionMatrix)) {
+        glUniformMatrix4fv(mProjectionMatrixLoc, 1, GL_FALSE, mProjectionMatrix.value.asArray());
+    }
 }
 
 } /* namespace android */
@@ -18,8 +18,11 @@
 #define SF_RENDER_ENGINE_PROGRAM_H
 
 #include <stdint.h>
+#include <string.h>
 
 #include <GLES2/gl2.h>
+#include <math/mat4.h>
+#include <math/vec4.h>
 
 #include "Description.h"
 #include "ProgramCache.h"
@@ -55,6 +58,23 @@ public:
     void setUniforms(const Description& desc);
 
 private:
+    // value last uploaded to a uniform; uniforms keep their values while
+    // other programs are in use, so matching uploads can be skipped
+    template <typename T>
+    struct UniformValue {
+        bool set = false;
+        T value;
+
+        bool update(const T& newValue) {
+            if (set && memcmp(&value, &newValue, sizeof(T)) == 0) {
+                return false;
+            }
+            set = true;
+            value = newValue;
+            return true;
+        }
+    };
+
     GLuint buildShader(const char* source, GLenum type);
     String8& dumpShader(String8& result, GLenum type);
 
@@ -84,6 +104,14 @@ private:
     /* location of transform matrix */
     GLint mInputTransformMatrixLoc;
     GLint mOutputTransformMatrixLoc;
+
+    UniformValue<mat4> mProjectionMatrix;
+    UniformValue<mat4> mTextureMatrix;
+    UniformValue<vec4> mColor;
+    UniformValue<float> mDisplayMaxLuminance;
+    UniformValue<mat4> mInputTransformMatrix;
+    UniformValue<mat4> mOutputTransformMatrix;
+    bool mSamplerSet = false;
 };
 
 } /* namespace android */
@@ -19,6 +19,12 @@
 #include <GLES2/gl2.h>
 #include <GLES2/gl2ext.h>
 
+#include <stdlib.h>
+
+#include <android-base/file.h>
+#include <android-base/stringprintf.h>
+#include <android-base/strings.h>
+#include <log/log.h>
 #include <utils/String8.h>
 #include <utils/Trace.h>
 
@@ -82,7 +88,9 @@ ProgramCache::ProgramCache() {}
 
 ProgramCache::~ProgramCache() {}
 
-void ProgramCache::primeCache(bool hasWideColor) {
+void ProgramCache::primeCache(bool hasWideColor, const std::string& keysFile) {
+    mKeysFile = keysFile;
+
     uint32_t shaderCount = 0;
     uint32_t keyMask = Key::BLEND_MASK | Key::OPACITY_MASK | Key::ALPHA_MASK | Key::TEXTURE_MASK;
     // Prime the cache for all combinations of the above masks,
@@ -124,11 +132,54 @@ void ProgramCache::primeCache(bool hasWideColor) {
         }
     }
 
+    shaderCount += primeSavedKeys();
+    // generating a program binds it
+    mCurrentProgram = nullptr;
+
     nsecs_t timeAfter = systemTime();
     float compileTimeMs = static_cast<float>(timeAfter - timeBefore) / 1.0E6;
     ALOGD("shader cache generated - %u shaders in %f ms\n", shaderCount, compileTimeMs);
 }
 
+uint32_t ProgramCache::primeSavedKeys() {
+    std::string keys;
+    if (mKeysFile.empty() || !base::ReadFileToString(mKeysFile, &keys)) {
+        return 0;
+    }
+
+    uint32_t shaderCount = 0;
+    for (const auto& line : base::Split(keys, "\n")) {
+        char* end = nullptr;
+        const unsigned long keyVal = strtoul(line.c_str(), &end, 16);
+        if (line.empty() || *end != '\0' || (keyVal & ~Key::VALID_MASK) != 0) {
+            continue;
+        }
+        Key shaderKey;
+        shaderKey.set(Key::VALID_MASK, static_cast<Key::key_t>(keyVal));
+        uint32_t tex = shaderKey.getTextureTarget();
+        if (tex != Key::TEXTURE_OFF && tex != Key::TEXTURE_EXT && tex != Key::TEXTURE_2D) {
+            continue;
+        }
+        if (mCache.valueFor(shaderKey) == nullptr) {
+            mCache.add(shaderKey, generateProgram(shaderKey));
+            shaderCount++;
+        }
+    }
+    return shaderCount;
+}
+
+void ProgramCache::saveKeys() const {
+    ATRACE_CALL();
+
+    std::string keys;
+    for (size_t i = 0; i < mCache.size(); i++) {
+        base::StringAppendF(&keys, "%08x\n", mCache.keyAt(i).mKey);
+    }
+    if (!base::WriteStringToFile(keys, mKeysFile)) {
+        ALOGW("failed to save program keys to %s", mKeysFile.c_str());
+    }
+}
+
 ProgramCache::Key ProgramCache::computeKey(const Description& description) {
     Key needs;
     needs.set(Key::TEXTURE_MASK,
@@ -673,15 +724,23 @@ void ProgramCache::useProgram(const Description& description) {
         nsecs_t time = -systemTime();
         program = generateProgram(needs);
         mCache.add(needs, program);
+        mCurrentProgram = nullptr;
         time += systemTime();
 
         ALOGV(">>> generated new program: needs=%08X, time=%u ms (%zu programs)", needs.mKey,
               uint32_t(ns2ms(time)), mCache.size());
+
+        if (!mKeysFile.empty()) {
+            saveKeys();
+        }
     }
 
     // here we have a suitable program for this description
     if (program->isValid()) {
-        program->use();
+        if (program != mCurrentProgram) {
+            program->use();
+            mCurrentProgram = program;
+        }
         program->setUniforms(description);
     }
 }
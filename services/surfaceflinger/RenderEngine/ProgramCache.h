@@ -19,6 +19,8 @@
 
 #include <GLES2/gl2.h>
 
+#include <string>
+
 #include <utils/KeyedVector.h>
 #include <utils/Singleton.h>
 #include <utils/TypeHelpers.h>
@@ -100,6 +102,9 @@ public:
             Y410_BT2020_MASK = 1 << Y410_BT2020_SHIFT,
             Y410_BT2020_OFF = 0 << Y410_BT2020_SHIFT,
             Y410_BT2020_ON = 1 << Y410_BT2020_SHIFT,
+
+            // all bits used above
+            VALID_MASK = (1 << (Y410_BT2020_SHIFT + 1)) - 1,
         };
 
         inline Key() : mKey(0) {}
@@ -160,14 +165,19 @@ public:
     ProgramCache();
     ~ProgramCache();
 
-    // Generate shaders to populate the cache
-    void primeCache(bool hasWideColor);
+    // Generate shaders to populate the cache, including the ones whose keys
+    // were saved to keysFile. Keys generated afterwards are added to it.
+    void primeCache(bool hasWideColor, const std::string& keysFile);
 
     // useProgram lookup a suitable program in the cache or generates one
     // if none can be found.
     void useProgram(const Description& description);
 
 private:
+    // generates the programs for the keys saved in mKeysFile
+    uint32_t primeSavedKeys();
+    // saves the keys of all the cached programs to mKeysFile
+    void saveKeys() const;
     // compute a cache Key from a Description
     static Key computeKey(const Description& description);
     // Generate EOTF based from Key.
@@ -188,6 +198,11 @@ private:
     // Key/Value map used for caching Programs. Currently the cache
     // is never shrunk.
     DefaultKeyedVector<Key, Program*> mCache;
+
+    std::string mKeysFile;
+
+    // program last bound by useProgram(), nullptr if unknown
+    Program* mCurrentProgram = nullptr;
 };
 
 ANDROID_BASIC_TYPES_TRAITS(ProgramCache::Key)
@@ -590,8 +590,8 @@ EGLConfig RenderEngine::chooseEglConfig(EGLDisplay display, int format, bool log
     return config;
 }
 
-void RenderEngine::primeCache() const {
-    ProgramCache::getInstance().primeCache(mFeatureFlags & WIDE_COLOR_SUPPORT);
+void RenderEngine::primeCache(const std::string& keysFile) const {
+    ProgramCache::getInstance().primeCache(mFeatureFlags & WIDE_COLOR_SUPPORT, keysFile);
 }
 
 // ---------------------------------------------------------------------------
@@ -18,6 +18,7 @@
 #define SF_RENDERENGINE_H_
 
 #include <memory>
+#include <string>
 
 #include <stdint.h>
 #include <sys/types.h>
@@ -64,7 +65,10 @@ public:
     virtual std::unique_ptr<RE::Surface> createSurface() = 0;
     virtual std::unique_ptr<RE::Image> createImage() = 0;
 
-    virtual void primeCache() const = 0;
+    // Generates the programs used for common compositions, plus the ones
+    // recorded in keysFile when it isn't empty. Programs generated later on
+    // are recorded there for the next boot.
+    virtual void primeCache(const std::string& keysFile) const = 0;
 
     // dump the extension strings. always call the base class.
     virtual void dump(String8& result) = 0;
@@ -187,7 +191,7 @@ public:
     std::unique_ptr<RE::Surface> createSurface() override;
     std::unique_ptr<RE::Image> createImage() override;
 
-    void primeCache() const override;
+    void primeCache(const std::string& keysFile) const override;
 
     // dump the extension strings. always call the base class.
     void dump(String8& result) override;
@@ -16,6 +16,7 @@
 
 #include "Surface.h"
 
+#include "GLExtensions.h"
 #include "RenderEngine.h"
 
 #include <log/log.h>
@@ -106,6 +107,13 @@ int32_t Surface::queryHeight() const {
     return querySurface(EGL_HEIGHT);
 }
 
+int32_t Surface::queryBufferAge() const {
+    if (!GLExtensions::getInstance().hasBufferAge()) {
+        return 0;
+    }
+    return querySurface(EGL_BUFFER_AGE_EXT);
+}
+
 } // namespace impl
 } // namespace RE
 } // namespace android
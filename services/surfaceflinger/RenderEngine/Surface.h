@@ -42,6 +42,10 @@ public:
 
     virtual int32_t queryWidth() const = 0;
     virtual int32_t queryHeight() const = 0;
+
+    // Number of frames since the contents of the current back buffer were
+    // drawn, or 0 if they are undefined
+    virtual int32_t queryBufferAge() const = 0;
 };
 
 namespace impl {
@@ -71,6 +75,8 @@ public:
     int32_t queryWidth() const override;
     int32_t queryHeight() const override;
 
+    int32_t queryBufferAge() const override;
+
 private:
     EGLint queryConfig(EGLint attrib) const;
     EGLint querySurface(EGLint attrib) const;
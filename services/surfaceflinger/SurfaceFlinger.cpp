@@ -17,16 +17,20 @@
 // #define LOG_NDEBUG 0
 #define ATRACE_TAG ATRACE_TAG_GRAPHICS
 
+#include <pthread.h>
 #include <stdint.h>
+#include <sys/eventfd.h>
 #include <sys/types.h>
 #include <algorithm>
 #include <errno.h>
+#include <future>
 #include <math.h>
 #include <mutex>
 #include <dlfcn.h>
 #include <inttypes.h>
 #include <stdatomic.h>
 #include <optional>
+#include <unordered_set>
 
 #include <cutils/properties.h>
 #include <log/log.h>
@@ -95,6 +99,9 @@
 
 #include <layerproto/LayerProtoParser.h>
 
+#include <android/os/BnThermalEventListener.h>
+#include <android/os/IThermalService.h>
+
 #define DISPLAY_COUNT       1
 
 /*
@@ -324,10 +331,74 @@ SurfaceFlinger::SurfaceFlinger() : SurfaceFlinger(SkipInitialization) {
     mUseHwcVirtualDisplays = atoi(value);
     ALOGI_IF(!mUseHwcVirtualDisplays, "Enabling HWC virtual displays");
 
+    property_get("debug.sf.program_cache_file", value, "");
+    mProgramCacheFile = value;
+    ALOGI_IF(!mProgramCacheFile.empty(), "Persisting shader program keys to %s",
+             mProgramCacheFile.c_str());
+
+    property_get("debug.sf.partial_client_composition", value, "0");
+    mPartialClientComposition = atoi(value);
+    ALOGI_IF(mPartialClientComposition, "Redrawing only the damaged part of the client target");
+
+    property_get("debug.sf.color_matrix_post_pass", value, "0");
+    mColorMatrixPostPass = atoi(value);
+    ALOGI_IF(mColorMatrixPostPass, "Applying the color matrix after client composition");
+
+    property_get("debug.sf.layer_flattening_frames", value, "0");
+    mLayerFlatteningFrames = static_cast<uint32_t>(std::max(atoi(value), 0));
+    ALOGI_IF(mLayerFlatteningFrames, "Flattening layers unchanged for %u frames",
+             mLayerFlatteningFrames);
+
+    property_get("debug.sf.late_latch", value, "0");
+    mLateLatch = atoi(value);
+    ALOGI_IF(mLateLatch, "Enabling late latching for device-composited layers");
+
+    property_get("debug.sf.layer_trace_ring_buffer", value, "0");
+    if (atoi(value)) {
+        ALOGI("Keeping a ring buffer of layer changes");
+        mTracing.enableRingBuffer();
+    }
+
+    property_get("debug.sf.queue_async_transactions", value, "0");
+    mQueueAsyncTransactions = atoi(value);
+    ALOGI_IF(mQueueAsyncTransactions, "Queueing asynchronous transactions");
+
+    property_get("debug.sf.transaction_channels", value, "0");
+    mTransactionChannelsEnabled = atoi(value);
+    ALOGI_IF(mTransactionChannelsEnabled, "Accepting transactions through shared memory");
+
+    property_get("debug.sf.present_virtual_displays_last", value, "0");
+    mPresentVirtualDisplaysLast = atoi(value);
+    ALOGI_IF(mPresentVirtualDisplaysLast, "Presenting virtual displays last");
+
+    property_get("debug.sf.mirror_virtual_displays", value, "0");
+    mMirrorVirtualDisplays = atoi(value);
+    ALOGI_IF(mMirrorVirtualDisplays, "Mirroring the primary display to virtual displays");
+
+    property_get("debug.sf.adaptive_client_target_buffers", value, "0");
+    mAdaptiveClientTargetBuffers = atoi(value);
+    ALOGI_IF(mAdaptiveClientTargetBuffers, "Reducing client target buffers when GLES is idle");
+
+    property_get("debug.sf.incremental_visible_regions", value, "0");
+    mIncrementalVisibleRegions = atoi(value);
+    ALOGI_IF(mIncrementalVisibleRegions, "Enabling incremental visible region updates");
+
     property_get("ro.sf.disable_triple_buffer", value, "1");
     mLayerTripleBufferingDisabled = atoi(value);
     ALOGI_IF(mLayerTripleBufferingDisabled, "Disabling Triple Buffering");
 
+    property_get("debug.sf.adaptive_buffer_count", value, "0");
+    mLayerAdaptiveBufferCountEnabled = atoi(value);
+    ALOGI_IF(mLayerAdaptiveBufferCountEnabled, "Enabling adaptive layer buffer counts");
+
+    property_get("debug.sf.buffer_preallocation", value, "0");
+    mLayerBufferPreallocationEnabled = atoi(value);
+    ALOGI_IF(mLayerBufferPreallocationEnabled, "Enabling layer buffer preallocation on resize");
+
+    property_get("debug.sf.cadence_aware_latching", value, "0");
+    mCadenceAwareLatchingEnabled = atoi(value);
+    ALOGI_IF(mCadenceAwareLatchingEnabled, "Enabling cadence-aware buffer latching");
+
     const size_t defaultListSize = MAX_LAYERS;
     auto listSize = property_get_int32("debug.sf.max_igbp_list_size", int32_t(defaultListSize));
     mMaxGraphicBufferProducerListSize = (listSize > 0) ? size_t(listSize) : defaultListSize;
@@ -353,6 +424,71 @@ SurfaceFlinger::SurfaceFlinger() : SurfaceFlinger(SkipInitialization) {
     mVsyncModulator.setPhaseOffsets(earlyOffsets, earlyGlOffsets,
             {sfVsyncPhaseOffsetNs, vsyncPhaseOffsetNs});
 
+    // Offsets for refresh rates above 75Hz. The late ones default to the ones
+    // above, and the early ones to the late ones, as for the default rate.
+    property_get("debug.sf.high_refresh_rate_phase_offset_ns", value, "-1");
+    const int highRefreshRateSfOffsetNs = atoi(value);
+
+    property_get("debug.sf.high_refresh_rate_app_phase_offset_ns", value, "-1");
+    const int highRefreshRateAppOffsetNs = atoi(value);
+
+    property_get("debug.sf.high_refresh_rate_early_phase_offset_ns", value, "-1");
+    const int highRefreshRateEarlySfOffsetNs = atoi(value);
+
+    property_get("debug.sf.high_refresh_rate_early_gl_phase_offset_ns", value, "-1");
+    const int highRefreshRateEarlyGlSfOffsetNs = atoi(value);
+
+    property_get("debug.sf.high_refresh_rate_early_app_phase_offset_ns", value, "-1");
+    const int highRefreshRateEarlyAppOffsetNs = atoi(value);
+
+    property_get("debug.sf.high_refresh_rate_early_gl_app_phase_offset_ns", value, "-1");
+    const int highRefreshRateEarlyGlAppOffsetNs = atoi(value);
+
+    if (highRefreshRateSfOffsetNs != -1 || highRefreshRateAppOffsetNs != -1 ||
+        highRefreshRateEarlySfOffsetNs != -1 || highRefreshRateEarlyGlSfOffsetNs != -1 ||
+        highRefreshRateEarlyAppOffsetNs != -1 || highRefreshRateEarlyGlAppOffsetNs != -1) {
+        const VSyncModulator::Offsets lateOffsets =
+                {highRefreshRateSfOffsetNs != -1 ? highRefreshRateSfOffsetNs
+                                                 : sfVsyncPhaseOffsetNs,
+                highRefreshRateAppOffsetNs != -1 ? highRefreshRateAppOffsetNs
+                                                 : vsyncPhaseOffsetNs};
+        const VSyncModulator::Offsets highEarlyOffsets =
+                {highRefreshRateEarlySfOffsetNs != -1 ? highRefreshRateEarlySfOffsetNs
+                                                      : lateOffsets.sf,
+                highRefreshRateEarlyAppOffsetNs != -1 ? highRefreshRateEarlyAppOffsetNs
+                                                      : lateOffsets.app};
+        const VSyncModulator::Offsets highEarlyGlOffsets =
+                {highRefreshRateEarlyGlSfOffsetNs != -1 ? highRefreshRateEarlyGlSfOffsetNs
+                                                        : lateOffsets.sf,
+                highRefreshRateEarlyGlAppOffsetNs != -1 ? highRefreshRateEarlyGlAppOffsetNs
+                                                        : lateOffsets.app};
+        mVsyncModulator.setHighRefreshRatePhaseOffsets(highEarlyOffsets, highEarlyGlOffsets,
+                                                       lateOffsets);
+    }
+
+    property_get("debug.sf.idle_refresh_rate_timeout_ms", value, "0");
+    mIdleRefreshRateTimeoutMs = std::max(atoi(value), 0);
+    ALOGI_IF(mIdleRefreshRateTimeoutMs, "Lowering the refresh rate after %d ms idle",
+             mIdleRefreshRateTimeoutMs);
+
+    property_get("debug.sf.thermal_lower_refresh_rate", value, "0");
+    mThermalLowerRefreshRate = atoi(value);
+
+    property_get("debug.sf.vsync_idle_timeout_ms", value, "0");
+    mVsyncIdleTimeoutMs = std::max(atoi(value), 0);
+    ALOGI_IF(mVsyncIdleTimeoutMs, "Stopping vsync after %d ms idle", mVsyncIdleTimeoutMs);
+
+    property_get("debug.sf.buffer_recycle_pool_kb", value, "0");
+    const int recyclePoolKb = std::max(atoi(value), 0);
+    if (recyclePoolKb) {
+        property_get("debug.sf.buffer_recycle_pool_age_ms", value, "1000");
+        const int recyclePoolAgeMs = std::max(atoi(value), 0);
+        GraphicBufferAllocator::get().setRecyclePool(size_t(recyclePoolKb) * 1024,
+                                                     ms2ns(recyclePoolAgeMs));
+        ALOGI("Recycling up to %d KiB of freed buffers for %d ms", recyclePoolKb,
+              recyclePoolAgeMs);
+    }
+
     // We should be reading 'persist.sys.sf.color_saturation' here
     // but since /data may be encrypted, we need to wait until after vold
     // comes online to attempt to read the property. The property is
@@ -375,6 +511,11 @@ void SurfaceFlinger::onFirstRef()
 
 SurfaceFlinger::~SurfaceFlinger()
 {
+    if (mTransactionChannelThread.joinable()) {
+        mTransactionChannelThreadExit = true;
+        mTransactionChannelLooper->wake();
+        mTransactionChannelThread.join();
+    }
 }
 
 void SurfaceFlinger::binderDied(const wp<IBinder>& /* who */)
@@ -501,6 +642,53 @@ void SurfaceFlinger::bootFinished()
         mBootStage = BootStage::FINISHED;
     });
     postMessageAsync(readProperties);
+
+    registerThermalEventListener();
+}
+
+namespace {
+
+class ThermalEventListener : public os::BnThermalEventListener {
+public:
+    explicit ThermalEventListener(std::function<void(bool)> callback)
+          : mCallback(std::move(callback)) {}
+
+    binder::Status notifyThrottling(bool isThrottling,
+                                    const os::Temperature& /* temperature */) override {
+        mCallback(isThrottling);
+        return binder::Status::ok();
+    }
+
+private:
+    const std::function<void(bool)> mCallback;
+};
+
+} // namespace
+
+void SurfaceFlinger::registerThermalEventListener() {
+    // thermalservice is optional, and may not have started yet
+    sp<os::IThermalService> thermalService = interface_cast<os::IThermalService>(
+            defaultServiceManager()->checkService(String16("thermalservice")));
+    if (thermalService == nullptr) {
+        ALOGI("thermalservice is not running, not adapting to thermal throttling");
+        return;
+    }
+
+    sp<os::IThermalEventListener> listener = new ThermalEventListener([this](bool throttling) {
+        postMessageAsync(
+                new LambdaMessage([this, throttling]() { setThermalThrottling(throttling); }));
+    });
+    if (!thermalService->registerThermalEventListener(listener).isOk()) {
+        ALOGW("Failed to register for thermal events");
+        return;
+    }
+    mThermalEventListener = listener;
+
+    // events from before registering are lost, so start from the current state
+    bool throttling = false;
+    if (thermalService->isThrottling(&throttling).isOk() && throttling) {
+        postMessageAsync(new LambdaMessage([this]() { setThermalThrottling(true); }));
+    }
 }
 
 uint32_t SurfaceFlinger::getNewTexture() {
@@ -680,6 +868,22 @@ void SurfaceFlinger::init() {
 
     Mutex::Autolock _l(mStateLock);
 
+    const nsecs_t initStart = systemTime();
+    nsecs_t stepStart = initStart;
+    auto stepTime = [&stepStart]() {
+        const nsecs_t now = systemTime();
+        const float ms = ns2us(now - stepStart) / 1000.0f;
+        stepStart = now;
+        return ms;
+    };
+
+    // Connecting to the composer waits for its HAL service to come up, which
+    // needs nothing from the EventThreads or RenderEngine set up meanwhile.
+    const std::string hwcServiceName = getBE().mHwcServiceName;
+    std::future<HWComposer*> hwcFuture = std::async(std::launch::async, [hwcServiceName]() {
+        return new HWComposer(std::make_unique<Hwc2::impl::Composer>(hwcServiceName));
+    });
+
     // start the EventThread
     mEventThreadSource =
             std::make_unique<DispSyncSource>(&mPrimaryDispSync, SurfaceFlinger::vsyncPhaseOffsetNs,
@@ -702,6 +906,20 @@ void SurfaceFlinger::init() {
     mEventQueue->setEventThread(mSFEventThread.get());
     mVsyncModulator.setEventThreads(mSFEventThread.get(), mEventThread.get());
 
+    if (mIdleRefreshRateTimeoutMs > 0) {
+        mIdleTimer = std::make_unique<IdleTimer>(
+                std::chrono::milliseconds(mIdleRefreshRateTimeoutMs), [this]() {
+                    postMessageAsync(new LambdaMessage([this]() { setIdleRefreshRate(true); }));
+                });
+    }
+    if (mVsyncIdleTimeoutMs > 0) {
+        mVsyncIdleTimer = std::make_unique<IdleTimer>(
+                std::chrono::milliseconds(mVsyncIdleTimeoutMs), [this]() {
+                    postMessageAsync(new LambdaMessage([this]() { setVsyncIdle(true); }));
+                });
+    }
+    const float eventThreadsMs = stepTime();
+
     // Get a RenderEngine for the given display / config (can't fail)
     getBE().mRenderEngine =
             RE::impl::RenderEngine::create(HAL_PIXEL_FORMAT_RGBA_8888,
@@ -709,11 +927,12 @@ void SurfaceFlinger::init() {
                                                    ? RE::RenderEngine::WIDE_COLOR_SUPPORT
                                                    : 0);
     LOG_ALWAYS_FATAL_IF(getBE().mRenderEngine == nullptr, "couldn't create RenderEngine");
+    const float renderEngineMs = stepTime();
 
     LOG_ALWAYS_FATAL_IF(mVrFlingerRequestsDisplay,
             "Starting with vr flinger active is not currently supported.");
-    getBE().mHwc.reset(
-            new HWComposer(std::make_unique<Hwc2::impl::Composer>(getBE().mHwcServiceName)));
+    getBE().mHwc.reset(hwcFuture.get());
+    const float hwcWaitMs = stepTime();
     getBE().mHwc->registerCallback(this, getBE().mComposerSequenceId);
     // Process any initial hotplug and resulting display changes.
     processDisplayHotplugEventsLocked();
@@ -755,8 +974,10 @@ void SurfaceFlinger::init() {
 
     // set initial conditions (e.g. unblank default device)
     initializeDisplays();
+    const float displaysMs = stepTime();
 
-    getBE().mRenderEngine->primeCache();
+    getBE().mRenderEngine->primeCache(mProgramCacheFile);
+    const float programCacheMs = stepTime();
 
     // Inform native graphics APIs whether the present timestamp is supported:
     if (getHwComposer().hasCapability(
@@ -788,6 +1009,11 @@ void SurfaceFlinger::init() {
         mEnhancedSaturationMatrix = srgbToP3 * mEnhancedSaturationMatrix * p3ToSrgb;
     }
 
+    ALOGI("Initialized in %.1fms: EventThreads %.1fms, RenderEngine %.1fms, "
+          "waiting for HWComposer %.1fms, displays %.1fms, program cache %.1fms, "
+          "other %.1fms",
+          ns2us(systemTime() - initStart) / 1000.0f, eventThreadsMs, renderEngineMs, hwcWaitMs,
+          displaysMs, programCacheMs, stepTime());
     ALOGV("Done initializing");
 }
 
@@ -937,7 +1163,8 @@ status_t SurfaceFlinger::getDisplayConfigs(const sp<IBinder>& display,
         info.xdpi = xdpi;
         info.ydpi = ydpi;
         info.fps = 1e9 / hwConfig->getVsyncPeriod();
-        info.appVsyncOffset = vsyncPhaseOffsetNs;
+        const auto lateOffsets = mVsyncModulator.getLateOffsets(hwConfig->getVsyncPeriod());
+        info.appVsyncOffset = lateOffsets.app;
 
         // This is how far in advance a buffer must be queued for
         // presentation at a given time.  If you want a buffer to appear
@@ -952,7 +1179,7 @@ status_t SurfaceFlinger::getDisplayConfigs(const sp<IBinder>& display,
         // We add an additional 1ms to allow for processing time and
         // differences between the ideal and actual refresh rate.
         info.presentationDeadline = hwConfig->getVsyncPeriod() -
-                sfVsyncPhaseOffsetNs + 1000000;
+                lateOffsets.sf + 1000000;
 
         // All non-virtual displays are currently considered secure.
         info.secure = true;
@@ -1028,6 +1255,110 @@ void SurfaceFlinger::setActiveConfigInternal(const sp<DisplayDevice>& hw, int mo
 
     hw->setActiveConfig(mode);
     getHwComposer().setActiveConfig(type, mode);
+
+    if (type == DisplayDevice::DISPLAY_PRIMARY) {
+        // Move the vsync model to the new rate right away, keeping its
+        // timeline, and let a single resync line it up with the hardware.
+        const nsecs_t period = getHwComposer().getActiveConfig(type)->getVsyncPeriod();
+        mPrimaryDispSync.changePeriod(period);
+        mVsyncModulator.setRefreshPeriod(period);
+        mAnimFrameTracker.setDisplayRefreshPeriod(period);
+        enableHardwareVsync();
+    }
+}
+
+void SurfaceFlinger::setIdleRefreshRate(bool idle) {
+    if (idle == mIdleRefreshRate) {
+        return;
+    }
+    mIdleRefreshRate = idle;
+    updateReducedRefreshRate();
+}
+
+void SurfaceFlinger::setThermalThrottling(bool throttling) {
+    if (throttling == mThermalThrottling) {
+        return;
+    }
+    ALOGI("Thermal throttling %s", throttling ? "started" : "stopped");
+    ATRACE_INT("ThermalThrottling", throttling);
+    mThermalThrottling = throttling;
+    updateReducedRefreshRate();
+}
+
+void SurfaceFlinger::updateReducedRefreshRate() {
+    const bool reduce = mIdleRefreshRate || (mThermalThrottling && mThermalLowerRefreshRate);
+    if (reduce == mReducedRefreshRate) {
+        return;
+    }
+
+    sp<DisplayDevice> hw(getDisplayDeviceLocked(mBuiltinDisplays[DisplayDevice::DISPLAY_PRIMARY]));
+    if (hw == nullptr || (reduce && hw->getPowerMode() != HWC_POWER_MODE_NORMAL)) {
+        return;
+    }
+
+    if (!reduce) {
+        mReducedRefreshRate = false;
+        setActiveConfigInternal(hw, mConfigBeforeReducedRefreshRate);
+        return;
+    }
+
+    // Only consider configs that differ from the active one in refresh rate.
+    const auto configs = getHwComposer().getConfigs(HWC_DISPLAY_PRIMARY);
+    const int activeConfig = hw->getActiveConfig();
+    if (activeConfig < 0 || activeConfig >= static_cast<int>(configs.size())) {
+        return;
+    }
+    const auto& active = configs[activeConfig];
+    int idleConfig = activeConfig;
+    for (size_t i = 0; i < configs.size(); i++) {
+        if (configs[i]->getWidth() == active->getWidth() &&
+            configs[i]->getHeight() == active->getHeight() &&
+            configs[i]->getVsyncPeriod() > configs[idleConfig]->getVsyncPeriod()) {
+            idleConfig = static_cast<int>(i);
+        }
+    }
+    if (idleConfig == activeConfig) {
+        return;
+    }
+
+    ATRACE_NAME(mIdleRefreshRate ? "IdleRefreshRate" : "ThermalRefreshRate");
+    mReducedRefreshRate = true;
+    mConfigBeforeReducedRefreshRate = activeConfig;
+    setActiveConfigInternal(hw, idleConfig);
+}
+
+void SurfaceFlinger::setVsyncIdle(bool idle) {
+    if (idle == mVsyncIdle) {
+        return;
+    }
+
+    // Hardware vsync is not used in these modes anyway, see setPowerModeInternal.
+    sp<DisplayDevice> hw(getDisplayDeviceLocked(mBuiltinDisplays[DisplayDevice::DISPLAY_PRIMARY]));
+    const bool hwVsyncUsable = hw != nullptr && hw->getPowerMode() != HWC_POWER_MODE_OFF &&
+            hw->getPowerMode() != HWC_POWER_MODE_DOZE_SUSPEND;
+    if (idle && !hwVsyncUsable) {
+        return;
+    }
+
+    ATRACE_INT("VsyncIdle", idle);
+    mVsyncIdle = idle;
+    mEventThread->setIdle(idle);
+    mSFEventThread->setIdle(idle);
+    if (idle) {
+        disableHardwareVsync(true);
+        return;
+    }
+
+    if (hwVsyncUsable) {
+        // Unlike resyncToHardwareVsync, this keeps the DispSync model, so
+        // vsync events resume on the predicted phase while the model is
+        // corrected.
+        {
+            Mutex::Autolock _l(mHWVsyncLock);
+            mHWVsyncAvailable = true;
+        }
+        enableHardwareVsync();
+    }
 }
 
 status_t SurfaceFlinger::setActiveConfig(const sp<IBinder>& display, int mode) {
@@ -1055,6 +1386,12 @@ status_t SurfaceFlinger::setActiveConfig(const sp<IBinder>& display, int mode) {
                 ALOGW("Attempt to set active config = %d for virtual display",
                         mMode);
             } else {
+                // an explicit request replaces whatever the idle or thermal
+                // policy chose
+                if (hw->getDisplayType() == DisplayDevice::DISPLAY_PRIMARY) {
+                    mFlinger.mIdleRefreshRate = false;
+                    mFlinger.mReducedRefreshRate = false;
+                }
                 mFlinger.setActiveConfigInternal(hw, mMode);
             }
             return true;
@@ -1530,6 +1867,7 @@ void SurfaceFlinger::updateVrFlinger() {
     const auto& activeConfig = getBE().mHwc->getActiveConfig(HWC_DISPLAY_PRIMARY);
     const nsecs_t period = activeConfig->getVsyncPeriod();
     mAnimFrameTracker.setDisplayRefreshPeriod(period);
+    mVsyncModulator.setRefreshPeriod(period);
 
     // Use phase of 0 since phase is not known.
     // Use latency of 0, which will snap to the ideal latency.
@@ -1543,6 +1881,14 @@ void SurfaceFlinger::onMessageReceived(int32_t what) {
     ATRACE_CALL();
     switch (what) {
         case MessageQueue::INVALIDATE: {
+            if (mIdleTimer) {
+                mIdleTimer->reset();
+                setIdleRefreshRate(false);
+            }
+            if (mVsyncIdleTimer) {
+                mVsyncIdleTimer->reset();
+                setVsyncIdle(false);
+            }
             bool frameMissed = !mHadClientComposition &&
                     mPreviousPresentFence != Fence::NO_FENCE &&
                     (mPreviousPresentFence->getSignalTime() ==
@@ -1550,6 +1896,7 @@ void SurfaceFlinger::onMessageReceived(int32_t what) {
             ATRACE_INT("FrameMissed", static_cast<int>(frameMissed));
             if (frameMissed) {
                 mTimeStats.incrementMissedFrames();
+                mTracing.onFrameMissed();
                 if (mPropagateBackpressure) {
                     signalLayerUpdate();
                     break;
@@ -1561,9 +1908,15 @@ void SurfaceFlinger::onMessageReceived(int32_t what) {
             // potentially trigger a display handoff.
             updateVrFlinger();
 
+            const nsecs_t transactionStart = mCompositionStageStats.begin();
             bool refreshNeeded = handleMessageTransaction();
+            mCompositionStageStats.end(CompositionStageStats::Stage::HandleMessageTransaction,
+                                       transactionStart);
             refreshNeeded |= handleMessageInvalidate();
             refreshNeeded |= mRepaintEverything;
+            // e.g. a buffer latched late in the previous frame changed its
+            // layer's geometry
+            refreshNeeded |= mHasLayersWithDirtyVisibleRegions;
             if (refreshNeeded && CC_LIKELY(mBootStage != BootStage::BOOTLOADER)) {
                 // Signal a refresh if a transaction modified the window state,
                 // a new buffer was latched, or if HWC has requested a full
@@ -1580,6 +1933,7 @@ void SurfaceFlinger::onMessageReceived(int32_t what) {
 }
 
 bool SurfaceFlinger::handleMessageTransaction() {
+    applyQueuedTransactions();
     uint32_t transactionFlags = peekTransactionFlags();
     if (transactionFlags) {
         handleTransaction(transactionFlags);
@@ -1600,14 +1954,25 @@ void SurfaceFlinger::handleMessageRefresh() {
 
     nsecs_t refreshStartTime = systemTime(SYSTEM_TIME_MONOTONIC);
 
+    using Stage = CompositionStageStats::Stage;
+
     preComposition(refreshStartTime);
+    nsecs_t stageStart = mCompositionStageStats.begin();
     rebuildLayerStacks();
+    stageStart = mCompositionStageStats.end(Stage::RebuildLayerStacks, stageStart);
     setUpHWComposer();
+    mCompositionStageStats.end(Stage::SetUpHWComposer, stageStart);
+    if (CC_UNLIKELY(mLateLatch)) {
+        lateLatchBuffers();
+    }
     doDebugFlashRegions();
     doTracing("handleRefresh");
     logLayerStats();
+    stageStart = mCompositionStageStats.begin();
     doComposition();
+    stageStart = mCompositionStageStats.end(Stage::DoComposition, stageStart);
     postComposition(refreshStartTime);
+    mCompositionStageStats.end(Stage::PostComposition, stageStart);
 
     mPreviousPresentFence = getBE().mHwc->getPresentFence(HWC_DISPLAY_PRIMARY);
 
@@ -1620,6 +1985,23 @@ void SurfaceFlinger::handleMessageRefresh() {
     mVsyncModulator.onRefreshed(mHadClientComposition);
 
     mLayersWithQueuedFrames.clear();
+
+    runDeferredCaptures();
+}
+
+void SurfaceFlinger::runDeferredCaptures() {
+    if (CC_LIKELY(mDeferredCaptures.empty())) {
+        return;
+    }
+    ATRACE_CALL();
+
+    // the frame has been handed to HWC, so the rest of the vsync period is
+    // free for the screenshots that were waiting on it
+    std::vector<std::function<void()>> captures;
+    std::swap(captures, mDeferredCaptures);
+    for (auto& capture : captures) {
+        capture();
+    }
 }
 
 void SurfaceFlinger::doDebugFlashRegions()
@@ -1636,7 +2018,7 @@ void SurfaceFlinger::doDebugFlashRegions()
             const Region dirtyRegion(hw->getDirtyRegion(repaintEverything));
             if (!dirtyRegion.isEmpty()) {
                 // redraw the whole screen
-                doComposeSurfaces(hw);
+                doComposeSurfaces(hw, dirtyRegion);
 
                 // and draw the dirty region
                 const int32_t height = hw->getHeight();
@@ -1671,9 +2053,25 @@ void SurfaceFlinger::doDebugFlashRegions()
 void SurfaceFlinger::doTracing(const char* where) {
     ATRACE_CALL();
     ATRACE_NAME(where);
-    if (CC_UNLIKELY(mTracing.isEnabled())) {
+    if (CC_LIKELY(!mTracing.isEnabled())) {
+        return;
+    }
+    if (!mTracing.isRingBufferEnabled()) {
         mTracing.traceLayers(where, dumpProtoInfo(LayerVector::StateSet::Drawing));
+        return;
     }
+
+    // Only serialize the layers that may have changed since the last entry.
+    const bool full = mTracing.needsFullEntry();
+    LayersProto changedLayers;
+    std::unordered_set<int32_t> layerIds;
+    mDrawingState.traverseInZOrder([&](Layer* layer) {
+        layerIds.insert(layer->sequence);
+        if (layer->takeTracingDirty() || full) {
+            layer->writeToProto(changedLayers.add_layers(), LayerVector::StateSet::Drawing);
+        }
+    });
+    mTracing.traceLayerChanges(where, std::move(changedLayers), std::move(layerIds), full);
 }
 
 void SurfaceFlinger::logLayerStats() {
@@ -1778,6 +2176,7 @@ void SurfaceFlinger::postComposition(nsecs_t refreshStartTime)
 
     // Release any buffers which were replaced this frame
     nsecs_t dequeueReadyTime = systemTime();
+    getBE().mReleaseTimeline.updateSignalTimes();
     for (auto& layer : mLayersWithQueuedFrames) {
         layer->releasePendingBuffer(dequeueReadyTime);
     }
@@ -1794,6 +2193,7 @@ void SurfaceFlinger::postComposition(nsecs_t refreshStartTime)
     } else {
         glCompositionDoneFenceTime = FenceTime::NO_FENCE;
     }
+    sampleClientCompositionTime(glCompositionDoneFenceTime);
 
     getBE().mDisplayTimeline.updateSignalTimes();
     sp<Fence> presentFence = getBE().mHwc->getPresentFence(HWC_DISPLAY_PRIMARY);
@@ -1895,10 +2295,18 @@ void SurfaceFlinger::rebuildLayerStacks() {
     ALOGV("rebuildLayerStacks");
 
     // rebuild the visible layer list per screen
-    if (CC_UNLIKELY(mVisibleRegionsDirty)) {
+    if (CC_UNLIKELY(mVisibleRegionsDirty || mHasLayersWithDirtyVisibleRegions)) {
         ATRACE_NAME("rebuildLayerStacks VR Dirty");
+        const bool fullRecompute = mVisibleRegionsDirty || !mIncrementalVisibleRegions;
+        if (mVisibleRegionsDirty) {
+            invalidateHwcGeometry();
+        } else {
+            // only the marked layers, and the layers whose z order shifted
+            // because of them, need their HWC geometry updated
+            mLayerGeometryInvalid = true;
+        }
         mVisibleRegionsDirty = false;
-        invalidateHwcGeometry();
+        mHasLayersWithDirtyVisibleRegions = false;
 
         for (size_t dpy=0 ; dpy<mDisplays.size() ; dpy++) {
             Region opaqueRegion;
@@ -1909,7 +2317,7 @@ void SurfaceFlinger::rebuildLayerStacks() {
             const Transform& tr(displayDevice->getTransform());
             const Rect bounds(displayDevice->getBounds());
             if (displayDevice->isDisplayOn()) {
-                computeVisibleRegions(displayDevice, dirtyRegion, opaqueRegion);
+                computeVisibleRegions(displayDevice, dirtyRegion, opaqueRegion, fullRecompute);
 
                 mDrawingState.traverseInZOrder([&](Layer* layer) {
                     bool hwcLayerDestroyed = false;
@@ -1954,6 +2362,9 @@ void SurfaceFlinger::rebuildLayerStacks() {
                     tr.transform(opaqueRegion));
             displayDevice->dirtyRegion.orSelf(dirtyRegion);
         }
+
+        // anything marked from now on belongs to the next pass
+        mGeometryGeneration = mVisibleRegionsGeneration++;
     }
 }
 
@@ -2008,8 +2419,14 @@ void SurfaceFlinger::pickColorMode(const sp<DisplayDevice>& displayDevice,
         return;
     }
 
+    // The visible layers and their dataspaces rarely change from frame to frame.
     Dataspace hdrDataSpace;
-    Dataspace bestDataSpace = getBestDataspace(displayDevice, &hdrDataSpace);
+    Dataspace bestDataSpace;
+    if (!displayDevice->getBestDataspace(mLayerDataspaceGeneration, &bestDataSpace,
+                                         &hdrDataSpace)) {
+        bestDataSpace = getBestDataspace(displayDevice, &hdrDataSpace);
+        displayDevice->setBestDataspace(mLayerDataspaceGeneration, bestDataSpace, hdrDataSpace);
+    }
 
     // respect hdrDataSpace only when there is no legacy HDR support
     const bool isHdr = hdrDataSpace != Dataspace::UNKNOWN &&
@@ -2068,9 +2485,16 @@ void SurfaceFlinger::setUpHWComposer() {
         }
     }
 
+    if (CC_UNLIKELY(mLayerFlatteningFrames > 0)) {
+        unflattenChangedLayers();
+    }
+    const bool layersChanged = mGeometryInvalid || mLayerGeometryInvalid;
+
     // build the h/w work list
-    if (CC_UNLIKELY(mGeometryInvalid)) {
+    if (CC_UNLIKELY(mGeometryInvalid || mLayerGeometryInvalid)) {
+        const bool allLayers = mGeometryInvalid;
         mGeometryInvalid = false;
+        mLayerGeometryInvalid = false;
         for (size_t dpy=0 ; dpy<mDisplays.size() ; dpy++) {
             sp<const DisplayDevice> displayDevice(mDisplays[dpy]);
             const auto hwcId = displayDevice->getHwcDisplayId();
@@ -2079,14 +2503,34 @@ void SurfaceFlinger::setUpHWComposer() {
                         displayDevice->getVisibleLayersSortedByZ());
                 for (size_t i = 0; i < currentLayers.size(); i++) {
                     const auto& layer = currentLayers[i];
+                    if (displayDevice->isLayerFlattened(i)) {
+                        continue;
+                    }
+                    bool geometryChanged = allLayers;
                     if (!layer->hasHwcLayer(hwcId)) {
                         if (!layer->createHwcLayer(getBE().mHwc.get(), hwcId)) {
                             layer->forceClientComposition(hwcId);
                             continue;
                         }
+                        geometryChanged = true;
+                    }
+
+                    if (!geometryChanged &&
+                        layer->visibleRegionsDirtyGeneration != mGeometryGeneration &&
+                        layer->hasHwcZOrder(hwcId, i)) {
+                        // nothing HWC needs to know about changed for this layer
+                        continue;
                     }
 
-                    layer->setGeometry(displayDevice, i);
+                    if (CC_UNLIKELY(mLayerStats.isEnabled())) {
+                        const nsecs_t start = systemTime();
+                        layer->setGeometry(displayDevice, i);
+                        mLayerStats.logLayerCpuCost(layer->getName().string(),
+                                                    LayerStats::CpuCost::SetGeometry,
+                                                    systemTime() - start);
+                    } else {
+                        layer->setGeometry(displayDevice, i);
+                    }
                     if (mDebugDisableHWC || mDebugRegion) {
                         layer->forceClientComposition(hwcId);
                     }
@@ -2095,6 +2539,10 @@ void SurfaceFlinger::setUpHWComposer() {
         }
     }
 
+    if (CC_UNLIKELY(mLayerFlatteningFrames > 0)) {
+        updateLayerStableFrames(layersChanged);
+    }
+
     // Set the per-frame data
     for (size_t displayId = 0; displayId < mDisplays.size(); ++displayId) {
         auto& displayDevice = mDisplays[displayId];
@@ -2109,7 +2557,12 @@ void SurfaceFlinger::setUpHWComposer() {
             ALOGE_IF(result != NO_ERROR, "Failed to set color transform on "
                     "display %zd: %d", displayId, result);
         }
-        for (auto& layer : displayDevice->getVisibleLayersSortedByZ()) {
+        const Vector<sp<Layer>>& layers(displayDevice->getVisibleLayersSortedByZ());
+        for (size_t i = 0; i < layers.size(); i++) {
+            const auto& layer = layers[i];
+            if (displayDevice->isLayerFlattened(i)) {
+                continue;
+            }
             if (layer->isHdrY410()) {
                 layer->forceClientComposition(hwcId);
             } else if ((layer->getDataSpace() == Dataspace::BT2020_PQ ||
@@ -2130,6 +2583,9 @@ void SurfaceFlinger::setUpHWComposer() {
 
             layer->setPerFrameData(displayDevice);
         }
+        if (auto flattened = displayDevice->getFlattenedLayers()) {
+            setFlattenedLayersPerFrameData(displayDevice, *flattened);
+        }
 
         if (hasWideColorDisplay) {
             ColorMode colorMode;
@@ -2138,6 +2594,11 @@ void SurfaceFlinger::setUpHWComposer() {
             pickColorMode(displayDevice, &colorMode, &dataSpace, &renderIntent);
             setActiveColorModeInternal(displayDevice, colorMode, dataSpace, renderIntent);
         }
+
+        if (CC_UNLIKELY(mLayerFlatteningFrames > 0) &&
+            displayDevice->getFlattenedLayers() == nullptr) {
+            flattenStableLayers(displayDevice);
+        }
     }
 
     mDrawingState.colorMatrixChanged = false;
@@ -2152,16 +2613,357 @@ void SurfaceFlinger::setUpHWComposer() {
         ALOGE_IF(result != NO_ERROR, "prepareFrame for display %zd failed:"
                 " %d (%s)", displayId, result, strerror(-result));
     }
+
+    updateClientCompositionLoad();
+}
+
+void SurfaceFlinger::updateClientCompositionLoad() {
+    ATRACE_CALL();
+    mPrimaryClientCompositionPixels = 0;
+    mPrimaryClientCompositionLayers.clear();
+    const bool trackLayers = mGpuStats.isEnabled();
+    for (size_t displayId = 0; displayId < mDisplays.size(); ++displayId) {
+        const auto& displayDevice = mDisplays[displayId];
+        const auto hwcId = displayDevice->getHwcDisplayId();
+        if (!displayDevice->isDisplayOn() || hwcId < 0) {
+            continue;
+        }
+
+        Hwc2::ClientCompositionLoad load;
+        if (getBE().mHwc->hasClientComposition(hwcId)) {
+            const Transform& tr = displayDevice->getTransform();
+            const Region bounds(displayDevice->bounds());
+            const Vector<sp<Layer>>& layers(displayDevice->getVisibleLayersSortedByZ());
+            for (size_t i = 0; i < layers.size(); i++) {
+                const auto& layer = layers[i];
+                if (displayDevice->isLayerFlattened(i) || !layer->hasHwcLayer(hwcId) ||
+                    layer->getCompositionType(hwcId) != HWC2::Composition::Client) {
+                    continue;
+                }
+                load.layerCount++;
+                const Region visible(bounds.intersect(tr.transform(layer->visibleRegion)));
+                uint64_t layerPixels = 0;
+                for (const Rect& rect : visible) {
+                    layerPixels += static_cast<uint64_t>(rect.getWidth()) *
+                            static_cast<uint64_t>(rect.getHeight());
+                }
+                load.pixelCount += layerPixels;
+                if (trackLayers && hwcId == HWC_DISPLAY_PRIMARY) {
+                    mPrimaryClientCompositionLayers.push_back(
+                            {layer->getName().string(), layerPixels});
+                }
+            }
+        }
+        // Raising clocks the SoC is throttling would only make the frame rate
+        // swing between boosted and throttled, so report no load meanwhile.
+        if (mThermalThrottling) {
+            load = Hwc2::ClientCompositionLoad();
+        }
+        load.predictedGpuTime =
+                static_cast<nsecs_t>(mClientCompositionNsPerPixel * load.pixelCount);
+        // virtual displays have no configs, and are composed at the pace of
+        // the primary display
+        const auto config = hwcId < DisplayDevice::DISPLAY_VIRTUAL
+                ? getBE().mHwc->getActiveConfig(hwcId)
+                : nullptr;
+        load.frameBudget = config ? config->getVsyncPeriod() : mPrimaryDispSync.getPeriod();
+        if (hwcId == HWC_DISPLAY_PRIMARY) {
+            mPrimaryClientCompositionPixels = load.pixelCount;
+            ATRACE_INT64("predictedGpuTime", load.predictedGpuTime);
+        }
+        getBE().mHwc->setClientCompositionLoad(hwcId, load);
+    }
+}
+
+void SurfaceFlinger::sampleClientCompositionTime(std::shared_ptr<FenceTime> doneFence) {
+    constexpr size_t kMaxPendingSamples = 8;
+    constexpr double kSampleWeight = 0.2;
+    if (doneFence->isValid() && mPrimaryClientCompositionPixels > 0) {
+        mClientCompositionSamples.push_back({mCompositionStartTime, mPrimaryClientCompositionPixels,
+                                             std::move(doneFence),
+                                             std::move(mPrimaryClientCompositionLayers)});
+        mPrimaryClientCompositionLayers.clear();
+        if (mClientCompositionSamples.size() > kMaxPendingSamples) {
+            mClientCompositionSamples.pop_front();
+        }
+    }
+
+    // fences signal in order, so only the oldest ones can have signaled
+    while (!mClientCompositionSamples.empty()) {
+        const auto& sample = mClientCompositionSamples.front();
+        const nsecs_t doneTime = sample.doneFence->getCachedSignalTime();
+        if (doneTime == Fence::SIGNAL_TIME_PENDING) {
+            break;
+        }
+        if (doneTime != Fence::SIGNAL_TIME_INVALID && doneTime > sample.startTime) {
+            const double nsPerPixel =
+                    static_cast<double>(doneTime - sample.startTime) / sample.pixelCount;
+            mClientCompositionNsPerPixel = mClientCompositionNsPerPixel == 0
+                    ? nsPerPixel
+                    : mClientCompositionNsPerPixel * (1 - kSampleWeight) +
+                            nsPerPixel * kSampleWeight;
+            mGpuStats.addClientComposition(doneTime - sample.startTime, sample.layers);
+        }
+        mClientCompositionSamples.pop_front();
+    }
+}
+
+bool SurfaceFlinger::canFlattenLayers() const {
+    // a client color matrix is applied by RenderEngine and HWC to each layer
+    return mDrawingState.colorMatrix == mat4() && !mDebugRegion && !mDebugDisableHWC;
+}
+
+bool SurfaceFlinger::isLayerFlattenable(const sp<Layer>& layer, int32_t hwcId) const {
+    if (!layer->hasHwcLayer(hwcId) ||
+        layer->getCompositionType(hwcId) != HWC2::Composition::Client || layer->isSecure() ||
+        layer->isHdrY410()) {
+        return false;
+    }
+    // HWC tone maps HDR contents, RenderEngine into the display dataspace
+    switch (layer->getDataSpace()) {
+        case Dataspace::BT2020_PQ:
+        case Dataspace::BT2020_ITU_PQ:
+        case Dataspace::BT2020_HLG:
+        case Dataspace::BT2020_ITU_HLG:
+            return false;
+        default:
+            return true;
+    }
+}
+
+void SurfaceFlinger::unflattenChangedLayers() {
+    const bool layersChanged = mGeometryInvalid || mLayerGeometryInvalid;
+    const bool canFlatten = canFlattenLayers();
+    for (size_t dpy = 0; dpy < mDisplays.size(); dpy++) {
+        const sp<DisplayDevice>& displayDevice(mDisplays[dpy]);
+        const auto flattened = displayDevice->getFlattenedLayers();
+        if (flattened == nullptr) {
+            continue;
+        }
+
+        bool changed = layersChanged || !canFlatten || flattened->hwcLayer == nullptr;
+        const Vector<sp<Layer>>& layers(displayDevice->getVisibleLayersSortedByZ());
+        for (size_t i = flattened->first; !changed && i < flattened->first + flattened->count;
+             i++) {
+            changed = std::find(mLayersWithQueuedFrames.cbegin(), mLayersWithQueuedFrames.cend(),
+                                layers[i]) != mLayersWithQueuedFrames.cend();
+        }
+        if (changed) {
+            ATRACE_NAME("unflattenLayers");
+            displayDevice->clearFlattenedLayers(*getBE().mHwc);
+            // the layers get their own HWC layer back with the geometry
+            mLayerGeometryInvalid = true;
+        }
+    }
+}
+
+void SurfaceFlinger::updateLayerStableFrames(bool layersChanged) {
+    const bool canFlatten = canFlattenLayers();
+    for (size_t dpy = 0; dpy < mDisplays.size(); dpy++) {
+        const sp<DisplayDevice>& displayDevice(mDisplays[dpy]);
+        const auto hwcId = displayDevice->getHwcDisplayId();
+        if (hwcId < 0) {
+            continue;
+        }
+
+        const Vector<sp<Layer>>& layers(displayDevice->getVisibleLayersSortedByZ());
+        std::vector<uint32_t>& stableFrames(displayDevice->editLayerStableFrames());
+        if (layersChanged || stableFrames.size() != layers.size()) {
+            stableFrames.assign(layers.size(), 0);
+        }
+        for (size_t i = 0; i < layers.size(); i++) {
+            const bool stable = displayDevice->isLayerFlattened(i) ||
+                    (canFlatten && isLayerFlattenable(layers[i], hwcId) &&
+                     std::find(mLayersWithQueuedFrames.cbegin(), mLayersWithQueuedFrames.cend(),
+                               layers[i]) == mLayersWithQueuedFrames.cend());
+            stableFrames[i] = stable ? std::min(stableFrames[i] + 1, mLayerFlatteningFrames) : 0;
+        }
+    }
+}
+
+void SurfaceFlinger::flattenStableLayers(const sp<DisplayDevice>& displayDevice) {
+    const auto hwcId = displayDevice->getHwcDisplayId();
+    const Vector<sp<Layer>>& layers(displayDevice->getVisibleLayersSortedByZ());
+    const std::vector<uint32_t>& stableFrames(displayDevice->editLayerStableFrames());
+    if (hwcId < 0 || !displayDevice->isDisplayOn() || stableFrames.size() != layers.size()) {
+        return;
+    }
+
+    // pick the longest run of layers that have been stable long enough
+    size_t first = 0;
+    size_t count = 0;
+    for (size_t i = 0; i < layers.size(); i++) {
+        size_t end = i;
+        while (end < layers.size() && stableFrames[end] >= mLayerFlatteningFrames) {
+            end++;
+        }
+        if (end - i > count) {
+            first = i;
+            count = end - i;
+        }
+        i = end;
+    }
+    if (count < 2) {
+        return;
+    }
+
+    const Region bounds(displayDevice->bounds());
+    const Transform& displayTransform = displayDevice->getTransform();
+    Region visibleRegion;
+    for (size_t i = first; i < first + count; i++) {
+        visibleRegion.orSelf(bounds.intersect(displayTransform.transform(layers[i]->visibleRegion)));
+    }
+    if (visibleRegion.isEmpty()) {
+        return;
+    }
+
+    ATRACE_CALL();
+    auto flattened = std::make_unique<DisplayDevice::FlattenedLayers>();
+    flattened->first = first;
+    flattened->count = count;
+    flattened->frame = visibleRegion.getBounds();
+    flattened->buffer = displayDevice->createOffscreenBuffer("FlattenedLayers");
+    if (flattened->buffer == nullptr || !displayDevice->makeCurrent()) {
+        return;
+    }
+
+    auto& engine(getRenderEngine());
+    Dataspace outputDataspace = Dataspace::UNKNOWN;
+    if (displayDevice->hasWideColorGamut()) {
+        outputDataspace = displayDevice->getCompositionDataSpace();
+    }
+    {
+        RE::BindNativeBufferAsFramebuffer bufferBond(
+                engine, flattened->buffer->buffer->getNativeBuffer());
+        if (bufferBond.getStatus() != NO_ERROR) {
+            ALOGE("Failed to bind the flattened layers buffer of display %s",
+                  displayDevice->getDisplayName().string());
+            return;
+        }
+        engine.setOutputDataSpace(outputDataspace);
+        engine.setDisplayMaxLuminance(
+                displayDevice->getHdrCapabilities().getDesiredMaxLuminance());
+        engine.setupColorTransform(mat4());
+        engine.clearWithColor(0, 0, 0, 0);
+
+        const DisplayRenderArea renderArea(displayDevice);
+        for (size_t i = first; i < first + count; i++) {
+            const Region clip(bounds.intersect(displayTransform.transform(layers[i]->visibleRegion)));
+            if (!clip.isEmpty()) {
+                layers[i]->draw(renderArea, clip);
+            }
+        }
+    }
+    base::unique_fd syncFd = engine.flush();
+    if (syncFd < 0) {
+        engine.finish();
+        flattened->renderFence = Fence::NO_FENCE;
+    } else {
+        flattened->renderFence = new Fence(syncFd.release());
+    }
+
+    HWC2::Layer* hwcLayer = getBE().mHwc->createLayer(hwcId);
+    if (hwcLayer == nullptr) {
+        return;
+    }
+    flattened->hwcLayer = hwcLayer;
+    auto logError = [](HWC2::Error error, const char* what) {
+        ALOGE_IF(error != HWC2::Error::None, "Failed to set the %s of flattened layers: %s (%d)",
+                 what, to_string(error).c_str(), static_cast<int32_t>(error));
+    };
+    const Rect& frame(flattened->frame);
+    logError(hwcLayer->setCompositionType(HWC2::Composition::Device), "composition type");
+    logError(hwcLayer->setBlendMode(HWC2::BlendMode::Premultiplied), "blend mode");
+    logError(hwcLayer->setPlaneAlpha(1.0f), "plane alpha");
+    logError(hwcLayer->setTransform(HWC2::Transform::None), "transform");
+    logError(hwcLayer->setDisplayFrame(frame), "display frame");
+    logError(hwcLayer->setSourceCrop(frame.toFloatRect()), "source crop");
+    logError(hwcLayer->setVisibleRegion(visibleRegion), "visible region");
+    logError(hwcLayer->setZOrder(first), "Z order");
+    logError(hwcLayer->setDataspace(outputDataspace), "dataspace");
+    logError(hwcLayer->setSurfaceDamage(Region::INVALID_REGION), "surface damage");
+    logError(hwcLayer->setBuffer(0, flattened->buffer->buffer, flattened->renderFence),
+             "buffer");
+
+    // HWC now shows the buffer in place of the layers
+    for (size_t i = first; i < first + count; i++) {
+        layers[i]->destroyHwcLayer(hwcId);
+    }
+    ALOGV("Flattened layers %zu-%zu of display %s", first, first + count - 1,
+          displayDevice->getDisplayName().string());
+    displayDevice->setFlattenedLayers(std::move(flattened));
+}
+
+void SurfaceFlinger::setFlattenedLayersPerFrameData(
+        const sp<const DisplayDevice>& displayDevice,
+        DisplayDevice::FlattenedLayers& flattened) const {
+    if (flattened.hwcLayer == nullptr) {
+        return;
+    }
+    if (flattened.fullDamage) {
+        // the buffer never changes after the first frame
+        flattened.fullDamage = false;
+        auto error = flattened.hwcLayer->setSurfaceDamage(Region());
+        ALOGE_IF(error != HWC2::Error::None,
+                 "Failed to clear the damage of flattened layers on display %s: %s (%d)",
+                 displayDevice->getDisplayName().string(), to_string(error).c_str(),
+                 static_cast<int32_t>(error));
+    }
+    if (flattened.compositionType != HWC2::Composition::Device) {
+        // give HWC another go at showing the buffer
+        flattened.compositionType = HWC2::Composition::Device;
+        auto error = flattened.hwcLayer->setCompositionType(HWC2::Composition::Device);
+        ALOGE_IF(error != HWC2::Error::None,
+                 "Failed to set the composition type of flattened layers on display %s: %s (%d)",
+                 displayDevice->getDisplayName().string(), to_string(error).c_str(),
+                 static_cast<int32_t>(error));
+    }
 }
 
 void SurfaceFlinger::doComposition() {
     ATRACE_CALL();
     ALOGV("doComposition");
 
+    mCompositionStartTime = systemTime();
     const bool repaintEverything = android_atomic_and(0, &mRepaintEverything);
+    if (CC_UNLIKELY(mPresentVirtualDisplaysLast)) {
+        // Composing a virtual display can cost as much as the primary
+        // display itself. Present the physical displays before touching the
+        // virtual ones so that screen recording or casting doesn't add to
+        // their latency.
+        doCompositionForDisplays(DisplaySubset::Physical, repaintEverything);
+        postFramebuffer(DisplaySubset::Physical);
+        doCompositionForDisplays(DisplaySubset::Virtual, repaintEverything);
+        postFramebuffer(DisplaySubset::Virtual);
+    } else if (CC_UNLIKELY(mMirrorVirtualDisplays)) {
+        // virtual displays can only mirror client targets composed before them
+        doCompositionForDisplays(DisplaySubset::Physical, repaintEverything);
+        doCompositionForDisplays(DisplaySubset::Virtual, repaintEverything);
+        postFramebuffer(DisplaySubset::All);
+    } else {
+        doCompositionForDisplays(DisplaySubset::All, repaintEverything);
+        postFramebuffer(DisplaySubset::All);
+    }
+}
+
+bool SurfaceFlinger::isInDisplaySubset(const sp<const DisplayDevice>& displayDevice,
+                                       DisplaySubset subset) {
+    const bool isVirtual = displayDevice->getDisplayType() >= DisplayDevice::DISPLAY_VIRTUAL;
+    switch (subset) {
+        case DisplaySubset::Physical:
+            return !isVirtual;
+        case DisplaySubset::Virtual:
+            return isVirtual;
+        case DisplaySubset::All:
+        default:
+            return true;
+    }
+}
+
+void SurfaceFlinger::doCompositionForDisplays(DisplaySubset subset, bool repaintEverything) {
     for (size_t dpy=0 ; dpy<mDisplays.size() ; dpy++) {
         const sp<DisplayDevice>& hw(mDisplays[dpy]);
-        if (hw->isDisplayOn()) {
+        if (hw->isDisplayOn() && isInDisplaySubset(hw, subset)) {
             // transform the dirty region into this screen's coordinate space
             const Region dirtyRegion(hw->getDirtyRegion(repaintEverything));
 
@@ -2172,10 +2974,9 @@ void SurfaceFlinger::doComposition() {
             hw->flip();
         }
     }
-    postFramebuffer();
 }
 
-void SurfaceFlinger::postFramebuffer()
+void SurfaceFlinger::postFramebuffer(DisplaySubset subset)
 {
     ATRACE_CALL();
     ALOGV("postFramebuffer");
@@ -2185,7 +2986,7 @@ void SurfaceFlinger::postFramebuffer()
 
     for (size_t displayId = 0; displayId < mDisplays.size(); ++displayId) {
         auto& displayDevice = mDisplays[displayId];
-        if (!displayDevice->isDisplayOn()) {
+        if (!displayDevice->isDisplayOn() || !isInDisplaySubset(displayDevice, subset)) {
             continue;
         }
         const auto hwcId = displayDevice->getHwcDisplayId();
@@ -2194,7 +2995,15 @@ void SurfaceFlinger::postFramebuffer()
         }
         displayDevice->onSwapBuffersCompleted();
         displayDevice->makeCurrent();
-        for (auto& layer : displayDevice->getVisibleLayersSortedByZ()) {
+        const auto flattened = displayDevice->getFlattenedLayers();
+        const Vector<sp<Layer>>& layers(displayDevice->getVisibleLayersSortedByZ());
+        for (size_t i = 0; i < layers.size(); i++) {
+            const auto& layer = layers[i];
+            if (displayDevice->isLayerFlattened(i)) {
+                // only read when they were drawn into the flattened buffer
+                layer->onLayerDisplayed(flattened->renderFence);
+                continue;
+            }
             sp<Fence> releaseFence = Fence::NO_FENCE;
 
             // The layer buffer from the previous frame (if any) is released
@@ -2211,8 +3020,8 @@ void SurfaceFlinger::postFramebuffer()
             // client target acquire fence when it is available, even though
             // this is suboptimal.
             if (layer->getCompositionType(hwcId) == HWC2::Composition::Client) {
-                releaseFence = Fence::merge("LayerRelease", releaseFence,
-                        displayDevice->getClientTargetAcquireFence());
+                releaseFence = Fence::mergeAll("LayerRelease",
+                        {releaseFence, displayDevice->getClientTargetAcquireFence()});
             }
 
             layer->onLayerDisplayed(releaseFence);
@@ -2237,7 +3046,7 @@ void SurfaceFlinger::postFramebuffer()
     mDebugInSwapBuffers = 0;
 
     // |mStateLock| not needed as we are on the main thread
-    if (getBE().mHwc->isConnected(HWC_DISPLAY_PRIMARY)) {
+    if (subset != DisplaySubset::Virtual && getBE().mHwc->isConnected(HWC_DISPLAY_PRIMARY)) {
         uint32_t flipCount = getDefaultDisplayDeviceLocked()->getPageFlipCount();
         if (flipCount % LOG_FRAME_STATS_PERIOD == 0) {
             logFrameStats();
@@ -2411,7 +3220,7 @@ sp<DisplayDevice> SurfaceFlinger::setupNewDisplayDeviceInternal(
                               hasWideColorGamut, hdrCapabilities,
                               supportedPerFrameMetadata, hwcColorModes, initialPowerMode);
 
-    if (maxFrameBufferAcquiredBuffers >= 3) {
+    if (maxFrameBufferAcquiredBuffers >= 3 && !mAdaptiveClientTargetBuffers) {
         nativeWindowSurface->preallocateBuffers();
     }
 
@@ -2550,7 +3359,9 @@ void SurfaceFlinger::processDisplayChangesLocked() {
                              state.surface.get());
 
                     hwcId = state.type;
-                    dispSurface = new FramebufferSurface(*getBE().mHwc, hwcId, bqConsumer);
+                    dispSurface = new FramebufferSurface(*getBE().mHwc, hwcId, bqConsumer,
+                                                         mMirrorVirtualDisplays,
+                                                         mAdaptiveClientTargetBuffers);
                     producer = bqProducer;
                 }
 
@@ -2589,7 +3400,7 @@ void SurfaceFlinger::handleTransactionLocked(uint32_t transactionFlags)
 
             const uint32_t flags = layer->doTransaction(0);
             if (flags & Layer::eVisibleRegion)
-                mVisibleRegionsDirty = true;
+                invalidateLayerVisibleRegions(layer, LayerVector::StateSet::Current);
         });
     }
 
@@ -2740,13 +3551,20 @@ void SurfaceFlinger::commitTransaction()
     mDrawingState.traverseInZOrder([](Layer* layer) {
         layer->commitChildList();
     });
+    // flatten the new layer tree once for all the traversals of this frame
+    mDrawingState.cacheLayersInZOrder();
     mTransactionPending = false;
     mAnimTransactionPending = false;
     mTransactionCV.broadcast();
 }
 
-void SurfaceFlinger::computeVisibleRegions(const sp<const DisplayDevice>& displayDevice,
-        Region& outDirtyRegion, Region& outOpaqueRegion)
+void SurfaceFlinger::invalidateLayerVisibleRegions(Layer* layer, LayerVector::StateSet stateSet) {
+    layer->setVisibleRegionsDirty(stateSet, mVisibleRegionsGeneration);
+    mHasLayersWithDirtyVisibleRegions = true;
+}
+
+void SurfaceFlinger::computeVisibleRegions(const sp<DisplayDevice>& displayDevice,
+        Region& outDirtyRegion, Region& outOpaqueRegion, bool fullRecompute)
 {
     ATRACE_CALL();
     ALOGV("computeVisibleRegions");
@@ -2757,6 +3575,15 @@ void SurfaceFlinger::computeVisibleRegions(const sp<const DisplayDevice>& displa
 
     outDirtyRegion.clear();
 
+    // Snapshots of the accumulated regions after each layer of this display,
+    // from the top down. While the layers match the previous pass and are
+    // not marked dirty, nothing above them changed and their own results can
+    // be kept as they are.
+    std::vector<DisplayDevice::VisibleRegionSnapshot>& snapshots =
+            displayDevice->editVisibleRegionSnapshots();
+    bool reusing = !fullRecompute;
+    size_t index = 0;
+
     mDrawingState.traverseInReverseZOrder([&](Layer* layer) {
         // start with the whole surface at its current location
         const Layer::State& s(layer->getDrawingState());
@@ -2765,6 +3592,38 @@ void SurfaceFlinger::computeVisibleRegions(const sp<const DisplayDevice>& displa
         if (!layer->belongsToDisplay(displayDevice->getLayerStack(), displayDevice->isPrimary()))
             return;
 
+        if (reusing) {
+            if (index < snapshots.size() && snapshots[index].layerSequence == layer->sequence &&
+                layer->visibleRegionsDirtyGeneration != mVisibleRegionsGeneration) {
+                if (layer->contentDirty) {
+                    // visibleRegion is unchanged and already excludes the
+                    // opaque layers above us
+                    outDirtyRegion.orSelf(layer->visibleRegion);
+                    layer->contentDirty = false;
+                }
+                index++;
+                return;
+            }
+            // first layer that changed: resume from the state above it
+            reusing = false;
+            if (index > 0) {
+                aboveOpaqueLayers = snapshots[index - 1].aboveOpaqueLayers;
+                aboveCoveredLayers = snapshots[index - 1].aboveCoveredLayers;
+            }
+        }
+
+        auto saveSnapshot = [&]() {
+            if (!mIncrementalVisibleRegions) {
+                return;
+            }
+            if (index < snapshots.size()) {
+                snapshots[index] = {layer->sequence, aboveOpaqueLayers, aboveCoveredLayers};
+            } else {
+                snapshots.push_back({layer->sequence, aboveOpaqueLayers, aboveCoveredLayers});
+            }
+            index++;
+        };
+
         /*
          * opaqueRegion: area of a surface that is fully opaque.
          */
@@ -2826,6 +3685,7 @@ void SurfaceFlinger::computeVisibleRegions(const sp<const DisplayDevice>& displa
 
         if (visibleRegion.isEmpty()) {
             layer->clearVisibilityRegions();
+            saveSnapshot();
             return;
         }
 
@@ -2877,10 +3737,26 @@ void SurfaceFlinger::computeVisibleRegions(const sp<const DisplayDevice>& displa
         layer->setCoveredRegion(coveredRegion);
         layer->setVisibleNonTransparentRegion(
                 visibleRegion.subtract(transparentRegion));
+        saveSnapshot();
     });
 
-    outOpaqueRegion = aboveOpaqueLayers;
-}
+    if (reusing) {
+        if (index != snapshots.size()) {
+            // a layer left this display without anything else changing,
+            // the area it exposed can only be found by starting over
+            const Region contentDirtyRegion(outDirtyRegion);
+            computeVisibleRegions(displayDevice, outDirtyRegion, outOpaqueRegion, true);
+            outDirtyRegion.orSelf(contentDirtyRegion);
+            return;
+        }
+        if (index > 0) {
+            aboveOpaqueLayers = snapshots[index - 1].aboveOpaqueLayers;
+        }
+    }
+    snapshots.resize(index);
+
+    outOpaqueRegion = aboveOpaqueLayers;
+}
 
 void SurfaceFlinger::invalidateLayerStack(const sp<const Layer>& layer, const Region& dirty) {
     for (size_t dpy=0 ; dpy<mDisplays.size() ; dpy++) {
@@ -2897,7 +3773,6 @@ bool SurfaceFlinger::handlePageFlip()
 
     nsecs_t latchTime = systemTime();
 
-    bool visibleRegions = false;
     bool frameQueued = false;
     bool newDataLatched = false;
 
@@ -2923,17 +3798,26 @@ bool SurfaceFlinger::handlePageFlip()
         }
     });
 
+    const bool logLayerCost = mLayerStats.isEnabled();
     for (auto& layer : mLayersWithQueuedFrames) {
+        bool visibleRegions = false;
+        const nsecs_t start = logLayerCost ? systemTime() : 0;
         const Region dirty(layer->latchBuffer(visibleRegions, latchTime));
+        if (CC_UNLIKELY(logLayerCost)) {
+            mLayerStats.logLayerCpuCost(layer->getName().string(),
+                                        LayerStats::CpuCost::LatchBuffer,
+                                        systemTime() - start);
+        }
         layer->useSurfaceDamage();
         invalidateLayerStack(layer, dirty);
+        if (visibleRegions) {
+            invalidateLayerVisibleRegions(layer.get(), LayerVector::StateSet::Drawing);
+        }
         if (layer->isBufferLatched()) {
             newDataLatched = true;
         }
     }
 
-    mVisibleRegionsDirty |= visibleRegions;
-
     // If we will need to wake up at some time in the future to deal with a
     // queued frame that shouldn't be displayed during this vsync period, wake
     // up during the next vsync period to check again.
@@ -2951,6 +3835,92 @@ bool SurfaceFlinger::handlePageFlip()
     return !mLayersWithQueuedFrames.empty() && newDataLatched;
 }
 
+void SurfaceFlinger::lateLatchBuffers() {
+    ATRACE_CALL();
+
+    // Buffers that became due while we were preparing this frame would
+    // otherwise wait a full vsync for the next handlePageFlip(). For layers
+    // HWC composes on its own we can still swap the buffer in now: only the
+    // per-frame data changes, and the display is validated again before we
+    // compose it.
+    const nsecs_t latchTime = systemTime();
+    std::vector<sp<Layer>> latchedLayers;
+    for (size_t dpy = 0; dpy < mDisplays.size(); dpy++) {
+        const sp<DisplayDevice>& displayDevice(mDisplays[dpy]);
+        const auto hwcId = displayDevice->getHwcDisplayId();
+        if (hwcId < 0 || !displayDevice->isDisplayOn() ||
+            getBE().mHwc->wasValidateSkipped(hwcId)) {
+            // HWC presented this frame already, there is nothing left to update
+            continue;
+        }
+        for (const auto& layer : displayDevice->getVisibleLayersSortedByZ()) {
+            if (layer->getCompositionType(hwcId) != HWC2::Composition::Device ||
+                !layer->hasQueuedFrame() || !layer->shouldPresentNow(mPrimaryDispSync)) {
+                continue;
+            }
+            if (std::find(mLayersWithQueuedFrames.cbegin(), mLayersWithQueuedFrames.cend(),
+                          layer) != mLayersWithQueuedFrames.cend()) {
+                // already latched for this frame
+                continue;
+            }
+
+            const uint64_t frameNumber = layer->getCurrentFrameNumber();
+            bool visibleRegions = false;
+            const Region dirty(layer->latchBuffer(visibleRegions, latchTime));
+            invalidateLayerStack(layer, dirty);
+            if (visibleRegions) {
+                // The layer's geometry changed. Let HWC know about it for this
+                // frame and fix the visible regions on the next one.
+                invalidateLayerVisibleRegions(layer.get(), LayerVector::StateSet::Drawing);
+                signalLayerUpdate();
+            }
+            if (layer->getCurrentFrameNumber() == frameNumber) {
+                // not accepted (yet), handlePageFlip() will try again
+                continue;
+            }
+            layer->useSurfaceDamage();
+            // released along with the buffers latched by handlePageFlip()
+            mLayersWithQueuedFrames.push_back(layer);
+            latchedLayers.push_back(layer);
+        }
+    }
+
+    if (latchedLayers.empty()) {
+        return;
+    }
+    ATRACE_INT("LateLatchedLayers", latchedLayers.size());
+
+    for (size_t dpy = 0; dpy < mDisplays.size(); dpy++) {
+        const sp<DisplayDevice>& displayDevice(mDisplays[dpy]);
+        const auto hwcId = displayDevice->getHwcDisplayId();
+        if (hwcId < 0 || !displayDevice->isDisplayOn()) {
+            continue;
+        }
+        bool updated = false;
+        const Vector<sp<Layer>>& layers(displayDevice->getVisibleLayersSortedByZ());
+        for (size_t i = 0; i < layers.size(); i++) {
+            const auto& layer = layers[i];
+            if (!layer->hasHwcLayer(hwcId) ||
+                std::find(latchedLayers.cbegin(), latchedLayers.cend(), layer) ==
+                        latchedLayers.cend()) {
+                continue;
+            }
+            if (layer->visibleRegionsDirtyGeneration == mVisibleRegionsGeneration) {
+                layer->setGeometry(displayDevice, i);
+            }
+            layer->setPerFrameData(displayDevice);
+            updated = true;
+        }
+        if (!updated) {
+            continue;
+        }
+
+        status_t result = displayDevice->prepareFrame(*getBE().mHwc);
+        ALOGE_IF(result != NO_ERROR, "late latch prepareFrame for display %zd failed: %d (%s)",
+                 dpy, result, strerror(-result));
+    }
+}
+
 void SurfaceFlinger::invalidateHwcGeometry()
 {
     mGeometryInvalid = true;
@@ -2972,13 +3942,19 @@ void SurfaceFlinger::doDisplayComposition(
     }
 
     ALOGV("doDisplayComposition");
-    if (!doComposeSurfaces(displayDevice)) return;
+    const sp<const DisplayDevice> mirrored =
+            mMirrorVirtualDisplays ? getMirroredDisplay(displayDevice) : nullptr;
+    ATRACE_INT("mirroredComposition", mirrored != nullptr);
+    if (mirrored == nullptr || !doComposeMirroredDisplay(displayDevice, mirrored)) {
+        if (!doComposeSurfaces(displayDevice, inDirtyRegion)) return;
+    }
 
     // swap buffers (presentation)
     displayDevice->swapBuffers(getHwComposer());
 }
 
-bool SurfaceFlinger::doComposeSurfaces(const sp<const DisplayDevice>& displayDevice)
+bool SurfaceFlinger::doComposeSurfaces(const sp<const DisplayDevice>& displayDevice,
+                                       const Region& dirtyRegion)
 {
     ALOGV("doComposeSurfaces");
 
@@ -2988,8 +3964,38 @@ bool SurfaceFlinger::doComposeSurfaces(const sp<const DisplayDevice>& displayDev
     const bool hasClientComposition = getBE().mHwc->hasClientComposition(hwcId);
     ATRACE_INT("hasClientComposition", hasClientComposition);
 
+    // The client target can only be partially redrawn if every frame it
+    // skips was composed the same way.
+    const bool partialClientComposition = mPartialClientComposition && !mDebugRegion;
+    bool compositionChanged = true;
+    if (partialClientComposition) {
+        DisplayDevice::CompositionSignature signature;
+        const auto flattened = displayDevice->getFlattenedLayers();
+        const Vector<sp<Layer>>& layers(displayDevice->getVisibleLayersSortedByZ());
+        for (size_t i = 0; i < layers.size(); i++) {
+            // flattened layers are told apart from the ones composed the
+            // same way on their own
+            const int32_t type = displayDevice->isLayerFlattened(i)
+                    ? -1 - static_cast<int32_t>(flattened->compositionType)
+                    : static_cast<int32_t>(layers[i]->getCompositionType(hwcId));
+            signature.layers.emplace_back(layers[i]->sequence, type);
+        }
+        signature.colorMatrix = mDrawingState.colorMatrix;
+        signature.dataspace = displayDevice->getCompositionDataSpace();
+        signature.renderIntent = displayDevice->getActiveRenderIntent();
+        compositionChanged = displayDevice->updateCompositionSignature(std::move(signature));
+        if (!hasClientComposition && getBE().mHwc->hasFlipClientTargetRequest(hwcId)) {
+            // the client target is flipped without being drawn
+            displayDevice->getClientTargetRedrawRegion(bounds, false);
+        }
+    }
+
     bool applyColorMatrix = false;
     bool needsEnhancedColorMatrix = false;
+    mat4 colorMatrix;
+    const DisplayDevice::OffscreenBuffer* colorMatrixTarget = nullptr;
+    std::unique_ptr<RE::BindNativeBufferAsFramebuffer> colorMatrixFramebuffer;
+    Rect redrawBounds(displayDevice->getBounds());
 
     if (hasClientComposition) {
         ALOGV("hasClientComposition");
@@ -3006,7 +4012,6 @@ bool SurfaceFlinger::doComposeSurfaces(const sp<const DisplayDevice>& displayDev
         const bool skipClientColorTransform = getBE().mHwc->hasCapability(
             HWC2::Capability::SkipClientColorTransform);
 
-        mat4 colorMatrix;
         applyColorMatrix = !hasDeviceComposition && !skipClientColorTransform;
         if (applyColorMatrix) {
             colorMatrix = mDrawingState.colorMatrix;
@@ -3022,7 +4027,14 @@ bool SurfaceFlinger::doComposeSurfaces(const sp<const DisplayDevice>& displayDev
             colorMatrix *= mEnhancedSaturationMatrix;
         }
 
-        getRenderEngine().setupColorTransform(colorMatrix);
+        // Rather than converting every layer to linear space and back to
+        // apply the matrix, compose them untransformed and apply it once
+        // while copying the result to the client target.
+        const bool colorMatrixPostPass = mColorMatrixPostPass && colorMatrix != mat4();
+        if (!colorMatrixPostPass) {
+            displayDevice->releaseColorMatrixTarget();
+        }
+        getRenderEngine().setupColorTransform(colorMatrixPostPass ? mat4() : colorMatrix);
 
         if (!displayDevice->makeCurrent()) {
             ALOGW("DisplayDevice::makeCurrent failed. Aborting surface composition for display %s",
@@ -3036,6 +4048,42 @@ bool SurfaceFlinger::doComposeSurfaces(const sp<const DisplayDevice>& displayDev
             return false;
         }
 
+        bool colorMatrixTargetAllocated = false;
+        if (colorMatrixPostPass) {
+            colorMatrixTarget = displayDevice->getColorMatrixTarget(&colorMatrixTargetAllocated);
+        }
+        if (colorMatrixTarget != nullptr) {
+            colorMatrixFramebuffer = std::make_unique<RE::BindNativeBufferAsFramebuffer>(
+                    getRenderEngine(), colorMatrixTarget->buffer->getNativeBuffer());
+            if (colorMatrixFramebuffer->getStatus() != NO_ERROR) {
+                ALOGW("Failed to bind the color matrix target of display %s",
+                      displayDevice->getDisplayName().string());
+                colorMatrixFramebuffer.reset();
+                colorMatrixTarget = nullptr;
+                displayDevice->releaseColorMatrixTarget();
+            }
+        }
+        if (colorMatrixPostPass && colorMatrixTarget == nullptr) {
+            // fall back to applying the matrix to every layer
+            getRenderEngine().setupColorTransform(colorMatrix);
+        }
+
+        // restrict everything below to the part of the client target that
+        // is out of date
+        if (partialClientComposition) {
+            const Region redraw(displayDevice->getClientTargetRedrawRegion(
+                    dirtyRegion, !compositionChanged && !colorMatrixTargetAllocated));
+            redrawBounds = redraw.getBounds();
+        }
+        const bool partialRedraw = redrawBounds != displayDevice->getBounds();
+        ATRACE_INT("partialClientRedraw", partialRedraw);
+        if (partialRedraw) {
+            const uint32_t height = displayDevice->getHeight();
+            getBE().mRenderEngine->setScissor(redrawBounds.left, height - redrawBounds.bottom,
+                                              redrawBounds.getWidth(),
+                                              redrawBounds.getHeight());
+        }
+
         // Never touch the framebuffer if we don't have any framebuffer layers
         if (hasDeviceComposition) {
             // when using overlays, we assume a fully transparent framebuffer
@@ -3061,7 +4109,10 @@ bool SurfaceFlinger::doComposeSurfaces(const sp<const DisplayDevice>& displayDev
         }
 
         const Rect& bounds(displayDevice->getBounds());
-        const Rect& scissor(displayDevice->getScissor());
+        Rect scissor(displayDevice->getScissor());
+        if (partialRedraw && !scissor.intersect(redrawBounds, &scissor)) {
+            scissor.clear();
+        }
         if (scissor != bounds) {
             // scissor doesn't match the screen's dimensions, so we
             // need to clear everything outside of it and enable
@@ -3080,8 +4131,21 @@ bool SurfaceFlinger::doComposeSurfaces(const sp<const DisplayDevice>& displayDev
 
     ALOGV("Rendering client layers");
     const Transform& displayTransform = displayDevice->getTransform();
+    const auto flattened = displayDevice->getFlattenedLayers();
+    const Vector<sp<Layer>>& layers(displayDevice->getVisibleLayersSortedByZ());
     bool firstLayer = true;
-    for (auto& layer : displayDevice->getVisibleLayersSortedByZ()) {
+    for (size_t i = 0; i < layers.size(); i++) {
+        const auto& layer = layers[i];
+        if (displayDevice->isLayerFlattened(i)) {
+            if (i == flattened->first && hasClientComposition &&
+                flattened->compositionType == HWC2::Composition::Client) {
+                // HWC can't show the flattened buffer, still cheaper to draw
+                // than the layers
+                drawOffscreenBuffer(displayDevice, *flattened->buffer, flattened->frame, false);
+            }
+            firstLayer = false;
+            continue;
+        }
         const Region clip(bounds.intersect(
                 displayTransform.transform(layer->visibleRegion)));
         ALOGV("Layer: %s", layer->getName().string());
@@ -3104,7 +4168,16 @@ bool SurfaceFlinger::doComposeSurfaces(const sp<const DisplayDevice>& displayDev
                     break;
                 }
                 case HWC2::Composition::Client: {
-                    layer->draw(renderArea, clip);
+                    if (CC_UNLIKELY(mLayerStats.isEnabled())) {
+                        const nsecs_t start = systemTime();
+                        layer->draw(renderArea, clip);
+                        const std::string name(layer->getName().string());
+                        mLayerStats.logLayerCpuCost(name, LayerStats::CpuCost::Draw,
+                                                    systemTime() - start);
+                        mLayerStats.logLayerClientComposition(name, clip);
+                    } else {
+                        layer->draw(renderArea, clip);
+                    }
                     break;
                 }
                 default:
@@ -3116,6 +4189,21 @@ bool SurfaceFlinger::doComposeSurfaces(const sp<const DisplayDevice>& displayDev
         firstLayer = false;
     }
 
+    if (colorMatrixTarget != nullptr) {
+        // back to the client target
+        colorMatrixFramebuffer.reset();
+        ATRACE_NAME("drawColorMatrixTarget");
+        // unbinding the framebuffer leaves the scissor disabled
+        if (redrawBounds != displayDevice->getBounds()) {
+            const uint32_t height = displayDevice->getHeight();
+            getBE().mRenderEngine->setScissor(redrawBounds.left, height - redrawBounds.bottom,
+                                              redrawBounds.getWidth(),
+                                              redrawBounds.getHeight());
+        }
+        getRenderEngine().setupColorTransform(colorMatrix);
+        drawOffscreenBuffer(displayDevice, *colorMatrixTarget, displayDevice->getBounds(), true);
+    }
+
     if (applyColorMatrix || needsEnhancedColorMatrix) {
         getRenderEngine().setupColorTransform(mat4());
     }
@@ -3131,6 +4219,163 @@ void SurfaceFlinger::drawWormhole(const sp<const DisplayDevice>& displayDevice,
     engine.fillRegionWithColor(region, height, 0, 0, 0, 0);
 }
 
+void SurfaceFlinger::drawOffscreenBuffer(const sp<const DisplayDevice>& displayDevice,
+                                         const DisplayDevice::OffscreenBuffer& offscreen,
+                                         const Rect& frame, bool opaque) const {
+    const float width = static_cast<float>(displayDevice->getWidth());
+    const float height = static_cast<float>(displayDevice->getHeight());
+    const float left = frame.left;
+    const float top = frame.top;
+    const float right = frame.right;
+    const float bottom = frame.bottom;
+
+    // positions are in GL window space, like in Layer::computeGeometry(),
+    // and the buffer was rendered with the same projection as the client
+    // target, so both have their origin at the bottom of the display
+    Mesh mesh(Mesh::TRIANGLE_FAN, 4, 2, 2);
+    Mesh::VertexArray<vec2> position(mesh.getPositionArray<vec2>());
+    position[0] = vec2(left, height - top);
+    position[1] = vec2(left, height - bottom);
+    position[2] = vec2(right, height - bottom);
+    position[3] = vec2(right, height - top);
+    Mesh::VertexArray<vec2> texCoords(mesh.getTexCoordArray<vec2>());
+    texCoords[0] = vec2(left / width, 1.0f - top / height);
+    texCoords[1] = vec2(left / width, 1.0f - bottom / height);
+    texCoords[2] = vec2(right / width, 1.0f - bottom / height);
+    texCoords[3] = vec2(right / width, 1.0f - top / height);
+
+    auto& engine(getRenderEngine());
+    Texture texture(Texture::TEXTURE_EXTERNAL, offscreen.texName);
+    texture.setDimensions(offscreen.buffer->getWidth(), offscreen.buffer->getHeight());
+    texture.setFiltering(false);
+    engine.setupLayerTexturing(texture);
+    engine.setupLayerBlending(true, opaque, false /* disableTexture */, half4(1.0f));
+    // the buffer is already in the output dataspace
+    Dataspace outputDataspace = Dataspace::UNKNOWN;
+    if (displayDevice->hasWideColorGamut()) {
+        outputDataspace = displayDevice->getCompositionDataSpace();
+    }
+    engine.setSourceDataSpace(outputDataspace);
+    engine.drawMesh(mesh);
+    engine.disableBlending();
+    engine.disableTexturing();
+}
+
+sp<const DisplayDevice> SurfaceFlinger::getMirroredDisplay(
+        const sp<const DisplayDevice>& displayDevice) const {
+    if (displayDevice->getDisplayType() < DisplayDevice::DISPLAY_VIRTUAL) {
+        return nullptr;
+    }
+    // |mStateLock| not needed as we are on the main thread
+    const sp<const DisplayDevice> primary = getDefaultDisplayDeviceLocked();
+    if (primary == nullptr || !primary->isDisplayOn() ||
+        primary->getLayerStack() != displayDevice->getLayerStack()) {
+        return nullptr;
+    }
+
+    // the client target of the primary display has to hold the whole frame,
+    // and nothing else may be composed on top of it
+    const auto& hwc = getBE().mHwc;
+    const auto primaryHwcId = primary->getHwcDisplayId();
+    if (!hwc->hasClientComposition(primaryHwcId) || hwc->hasDeviceComposition(primaryHwcId) ||
+        hwc->hasDeviceComposition(displayDevice->getHwcDisplayId())) {
+        return nullptr;
+    }
+
+    // both displays must get the same colors
+    const auto outputDataspace = [](const sp<const DisplayDevice>& display) {
+        return display->hasWideColorGamut() ? display->getCompositionDataSpace()
+                                            : Dataspace::UNKNOWN;
+    };
+    if (outputDataspace(primary) != outputDataspace(displayDevice) ||
+        primary->getActiveRenderIntent() != displayDevice->getActiveRenderIntent()) {
+        return nullptr;
+    }
+
+    // the virtual display must show the primary display scaled and offset,
+    // not rotated
+    const Transform mapping(displayDevice->getTransform() * primary->getTransform().inverse());
+    if (mapping.getType() & ~(Transform::TRANSLATE | Transform::SCALE)) {
+        return nullptr;
+    }
+
+    // and show the same layers the same way
+    const bool sameSecurity = primary->isSecure() == displayDevice->isSecure();
+    for (const auto& layer : primary->getVisibleLayersSortedByZ()) {
+        if (layer->isPrimaryDisplayOnly() || (!sameSecurity && layer->isSecure())) {
+            return nullptr;
+        }
+    }
+    return primary;
+}
+
+bool SurfaceFlinger::doComposeMirroredDisplay(const sp<const DisplayDevice>& displayDevice,
+                                              const sp<const DisplayDevice>& mirrored) {
+    ATRACE_CALL();
+
+    const DisplayDevice::OffscreenBuffer* clientTarget = mirrored->getMirrorSource();
+    if (clientTarget == nullptr) {
+        return false;
+    }
+
+    Dataspace outputDataspace = Dataspace::UNKNOWN;
+    if (displayDevice->hasWideColorGamut()) {
+        outputDataspace = displayDevice->getCompositionDataSpace();
+    }
+    auto& engine(getRenderEngine());
+    engine.setOutputDataSpace(outputDataspace);
+    // the client target already has the color matrix applied
+    engine.setupColorTransform(mat4());
+    if (!displayDevice->makeCurrent()) {
+        ALOGW("DisplayDevice::makeCurrent failed. Aborting mirrored composition for display %s",
+              displayDevice->getDisplayName().string());
+        engine.resetCurrentSurface();
+        return false;
+    }
+
+    // draw the part of the client target that shows layers, and clear the
+    // rest like a letterbox
+    const Rect crop(mirrored->getScissor());
+    const Transform mapping(displayDevice->getTransform() * mirrored->getTransform().inverse());
+    const Rect frame(mapping.transform(crop));
+    engine.clearWithColor(0, 0, 0, 0);
+
+    const float height = static_cast<float>(displayDevice->getHeight());
+    const float bufferWidth = static_cast<float>(clientTarget->buffer->getWidth());
+    const float bufferHeight = static_cast<float>(clientTarget->buffer->getHeight());
+    Mesh mesh(Mesh::TRIANGLE_FAN, 4, 2, 2);
+    Mesh::VertexArray<vec2> position(mesh.getPositionArray<vec2>());
+    position[0] = vec2(frame.left, height - frame.top);
+    position[1] = vec2(frame.left, height - frame.bottom);
+    position[2] = vec2(frame.right, height - frame.bottom);
+    position[3] = vec2(frame.right, height - frame.top);
+    // unlike the buffers of drawOffscreenBuffer(), the client target is a
+    // window buffer and is stored top down
+    Mesh::VertexArray<vec2> texCoords(mesh.getTexCoordArray<vec2>());
+    texCoords[0] = vec2(crop.left / bufferWidth, crop.top / bufferHeight);
+    texCoords[1] = vec2(crop.left / bufferWidth, crop.bottom / bufferHeight);
+    texCoords[2] = vec2(crop.right / bufferWidth, crop.bottom / bufferHeight);
+    texCoords[3] = vec2(crop.right / bufferWidth, crop.top / bufferHeight);
+
+    Texture texture(Texture::TEXTURE_EXTERNAL, clientTarget->texName);
+    texture.setDimensions(clientTarget->buffer->getWidth(), clientTarget->buffer->getHeight());
+    texture.setFiltering(frame.getWidth() != crop.getWidth() ||
+                         frame.getHeight() != crop.getHeight());
+    engine.setupLayerTexturing(texture);
+    engine.setupLayerBlending(true, true, false /* disableTexture */, half4(1.0f));
+    engine.setSourceDataSpace(outputDataspace);
+    engine.drawMesh(mesh);
+    engine.disableBlending();
+    engine.disableTexturing();
+
+    if (mPartialClientComposition) {
+        // the next client composition of this display can't reuse anything
+        displayDevice->updateCompositionSignature({});
+        displayDevice->getClientTargetRedrawRegion(displayDevice->bounds(), false);
+    }
+    return true;
+}
+
 status_t SurfaceFlinger::addClientLayer(const sp<Client>& client,
         const sp<IBinder>& handle,
         const sp<IGraphicBufferProducer>& gbc,
@@ -3277,13 +4522,35 @@ void SurfaceFlinger::setTransactionState(
         uint32_t flags)
 {
     ATRACE_CALL();
-    Mutex::Autolock _l(mStateLock);
-    uint32_t transactionFlags = 0;
 
     if (containsAnyInvalidClientState(states)) {
         return;
     }
 
+    // Plain asynchronous transactions don't need to observe their result,
+    // so don't make the binder thread wait for mStateLock, which the main
+    // thread can hold for a long time.
+    if (mQueueAsyncTransactions && !(flags & (eSynchronous | eAnimation | eEarlyWakeup))) {
+        // declared before the lock so the clients are released after it
+        std::vector<sp<Client>> channelClients;
+        {
+            std::lock_guard<std::mutex> lock(mTransactionQueueMutex);
+            // transactions written to the channels were issued first
+            drainTransactionChannelsLocked(channelClients);
+            mTransactionQueue.push_back({states, displays, flags});
+        }
+        signalTransaction();
+        return;
+    }
+
+    // declared before the lock so the queued states are released after it
+    std::vector<QueuedTransaction> queuedTransactions;
+    std::vector<sp<Client>> channelClients;
+    Mutex::Autolock _l(mStateLock);
+
+    // queued transactions were issued first and must be applied first
+    applyQueuedTransactionsLocked(queuedTransactions, channelClients);
+
     if (flags & eAnimation) {
         // For window updates that are part of an animation we must wait for
         // previous animation "frames" to be handled.
@@ -3300,21 +4567,7 @@ void SurfaceFlinger::setTransactionState(
         }
     }
 
-    for (const DisplayState& display : displays) {
-        transactionFlags |= setDisplayStateLocked(display);
-    }
-
-    for (const ComposerState& state : states) {
-        transactionFlags |= setClientStateLocked(state);
-    }
-
-    // Iterate through all layers again to determine if any need to be destroyed. Marking layers
-    // as destroyed should only occur after setting all other states. This is to allow for a
-    // child re-parent to happen before marking its original parent as destroyed (which would
-    // then mark the child as destroyed).
-    for (const ComposerState& state : states) {
-        setDestroyStateLocked(state);
-    }
+    uint32_t transactionFlags = applyTransactionStateLocked(states, displays);
 
     // If a synchronous transaction is explicitly requested without any changes, force a transaction
     // anyway. This can be used as a flush mechanism for previous async transactions.
@@ -3357,6 +4610,127 @@ void SurfaceFlinger::setTransactionState(
     }
 }
 
+uint32_t SurfaceFlinger::applyTransactionStateLocked(const Vector<ComposerState>& states,
+                                                     const Vector<DisplayState>& displays) {
+    uint32_t transactionFlags = 0;
+
+    for (const DisplayState& display : displays) {
+        transactionFlags |= setDisplayStateLocked(display);
+    }
+
+    for (const ComposerState& state : states) {
+        transactionFlags |= setClientStateLocked(state);
+    }
+
+    // Iterate through all layers again to determine if any need to be destroyed. Marking layers
+    // as destroyed should only occur after setting all other states. This is to allow for a
+    // child re-parent to happen before marking its original parent as destroyed (which would
+    // then mark the child as destroyed).
+    for (const ComposerState& state : states) {
+        setDestroyStateLocked(state);
+    }
+
+    return transactionFlags;
+}
+
+void SurfaceFlinger::applyQueuedTransactionsLocked(
+        std::vector<QueuedTransaction>& outTransactions, std::vector<sp<Client>>& outClients) {
+    {
+        std::lock_guard<std::mutex> lock(mTransactionQueueMutex);
+        drainTransactionChannelsLocked(outClients);
+        if (mTransactionQueue.empty()) {
+            return;
+        }
+        outTransactions.swap(mTransactionQueue);
+    }
+
+    ATRACE_INT("QueuedTransactions", outTransactions.size());
+    for (const QueuedTransaction& transaction : outTransactions) {
+        const uint32_t transactionFlags =
+                applyTransactionStateLocked(transaction.states, transaction.displays);
+        if (transactionFlags) {
+            if (mInterceptor->isEnabled()) {
+                mInterceptor->saveTransaction(transaction.states, mCurrentState.displays,
+                                              transaction.displays, transaction.flags);
+            }
+            // the main thread was already woken up when this transaction was
+            // queued or written to a channel, so don't signal another transaction
+            android_atomic_or(transactionFlags, &mTransactionFlags);
+        }
+    }
+}
+
+void SurfaceFlinger::applyQueuedTransactions() {
+    if (!mQueueAsyncTransactions && !mTransactionChannelsEnabled) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mTransactionQueueMutex);
+        if (mTransactionQueue.empty() && mTransactionChannelClients.empty()) {
+            return;
+        }
+    }
+
+    std::vector<QueuedTransaction> queuedTransactions;
+    std::vector<sp<Client>> channelClients;
+    Mutex::Autolock _l(mStateLock);
+    applyQueuedTransactionsLocked(queuedTransactions, channelClients);
+}
+
+void SurfaceFlinger::registerTransactionChannel(const sp<Client>& client, int eventFd) {
+    std::lock_guard<std::mutex> lock(mTransactionQueueMutex);
+    mTransactionChannelClients.push_back(client);
+
+    if (mTransactionChannelLooper == nullptr) {
+        mTransactionChannelLooper = new Looper(false);
+        mTransactionChannelThread = std::thread([this]() {
+            while (!mTransactionChannelThreadExit) {
+                mTransactionChannelLooper->pollOnce(-1);
+            }
+        });
+        pthread_setname_np(mTransactionChannelThread.native_handle(), "TransactionChan");
+    }
+    mTransactionChannelLooper->addFd(eventFd, 0, Looper::EVENT_INPUT,
+                                     SurfaceFlinger::onTransactionChannelSignaled, this);
+}
+
+void SurfaceFlinger::unregisterTransactionChannel(int eventFd) {
+    // the looper exists once a channel was registered, and is never replaced
+    sp<Looper> looper;
+    {
+        std::lock_guard<std::mutex> lock(mTransactionQueueMutex);
+        looper = mTransactionChannelLooper;
+    }
+    if (looper != nullptr) {
+        looper->removeFd(eventFd);
+    }
+}
+
+void SurfaceFlinger::drainTransactionChannelsLocked(std::vector<sp<Client>>& outClients) {
+    std::vector<Vector<ComposerState>> transactions;
+    for (auto it = mTransactionChannelClients.begin(); it != mTransactionChannelClients.end();) {
+        sp<Client> client = it->promote();
+        if (client == nullptr) {
+            it = mTransactionChannelClients.erase(it);
+            continue;
+        }
+        client->readChannelTransactions(transactions);
+        outClients.push_back(client);
+        ++it;
+    }
+
+    for (const Vector<ComposerState>& states : transactions) {
+        mTransactionQueue.push_back({states, Vector<DisplayState>(), 0});
+    }
+}
+
+int SurfaceFlinger::onTransactionChannelSignaled(int fd, int /*events*/, void* data) {
+    eventfd_t value;
+    eventfd_read(fd, &value);
+    static_cast<SurfaceFlinger*>(data)->signalTransaction();
+    return 1;
+}
+
 uint32_t SurfaceFlinger::setDisplayStateLocked(const DisplayState& s)
 {
     ssize_t dpyIdx = mCurrentState.displays.indexOfKey(s.token);
@@ -3787,6 +5161,7 @@ void SurfaceFlinger::onInitializeDisplays() {
     const auto& activeConfig = getBE().mHwc->getActiveConfig(HWC_DISPLAY_PRIMARY);
     const nsecs_t period = activeConfig->getVsyncPeriod();
     mAnimFrameTracker.setDisplayRefreshPeriod(period);
+    mVsyncModulator.setRefreshPeriod(period);
 
     // Use phase of 0 since phase is not known.
     // Use latency of 0, which will snap to the ideal latency.
@@ -3893,6 +5268,11 @@ void SurfaceFlinger::setPowerModeInternal(const sp<DisplayDevice>& hw,
         ALOGE("Attempting to set unknown power mode: %d\n", mode);
         getHwComposer().setPowerMode(type, mode);
     }
+
+    // the display may have been off when throttling started
+    if (type == DisplayDevice::DISPLAY_PRIMARY && mode == HWC_POWER_MODE_NORMAL) {
+        updateReducedRefreshRate();
+    }
     ALOGD("Finished set power mode=%d, type=%d", mode, hw->getDisplayType());
 }
 
@@ -3926,6 +5306,74 @@ void SurfaceFlinger::setPowerMode(const sp<IBinder>& display, int mode) {
 
 // ---------------------------------------------------------------------------
 
+void SurfaceFlinger::dumpGpuStats(const Vector<String16>& args, String8& result) {
+    bool dumpAll = true;
+    size_t index = 0;
+    const size_t numArgs = args.size();
+
+    if ((index < numArgs) && (args[index] == String16("--enable-layer-gpu-times"))) {
+        index++;
+        mGpuStats.enable();
+        dumpAll = false;
+    }
+
+    if ((index < numArgs) && (args[index] == String16("--disable-layer-gpu-times"))) {
+        index++;
+        mGpuStats.disable();
+        dumpAll = false;
+    }
+
+    if ((index < numArgs) && (args[index] == String16("--clear-layer-gpu-times"))) {
+        index++;
+        mGpuStats.clear();
+        dumpAll = false;
+    }
+
+    if (!dumpAll) {
+        return;
+    }
+
+    result.appendFormat("Client composition GPU time per layer (%s):\n",
+                        mGpuStats.isEnabled() ? "enabled" : "disabled, see --enable-layer-gpu-times");
+    mGpuStats.dump(result);
+
+    // Only what SurfaceFlinger holds on to, computed like gralloc allocations
+    // are in GraphicBufferAllocator, so buffers of YUV formats count as 0
+    struct ProcessBuffers {
+        size_t layerCount = 0;
+        size_t bufferCount = 0;
+        uint64_t size = 0;
+    };
+    std::map<pid_t, ProcessBuffers> processes;
+    {
+        Mutex::Autolock _l(mStateLock);
+        std::unordered_set<uint64_t> bufferIds;
+        mCurrentState.traverseInZOrder([&](Layer* layer) {
+            const sp<GraphicBuffer> buffer = layer->getActiveBuffer();
+            if (buffer == nullptr) {
+                return;
+            }
+            ProcessBuffers& process = processes[layer->getOwnerPid()];
+            process.layerCount++;
+            if (!bufferIds.insert(buffer->getId()).second) {
+                return;
+            }
+            process.bufferCount++;
+            process.size += static_cast<uint64_t>(buffer->getHeight()) * buffer->getStride() *
+                    bytesPerPixel(buffer->getPixelFormat());
+        });
+    }
+    result.append("\nLatched layer buffers per process (pid -1: client gone):\n");
+    for (const auto& entry : processes) {
+        const ProcessBuffers& process = entry.second;
+        result.appendFormat("  pid %d: layers=%zu buffers=%zu size=%.2f KiB\n", entry.first,
+                            process.layerCount, process.bufferCount, process.size / 1024.0);
+    }
+
+    result.append("\n");
+    GraphicBufferAllocator::get().dump(result);
+}
+
 status_t SurfaceFlinger::doDump(int fd, const Vector<String16>& args, bool asProto)
         NO_THREAD_SAFETY_ANALYSIS {
     String8 result;
@@ -3965,7 +5413,14 @@ status_t SurfaceFlinger::doDump(int fd, const Vector<String16>& args, bool asPro
             if ((index < numArgs) &&
                     (args[index] == String16("--latency"))) {
                 index++;
-                dumpStatsLocked(args, index, result);
+                dumpStatsLocked(args, index, result, false);
+                dumpAll = false;
+            }
+
+            if ((index < numArgs) &&
+                    (args[index] == String16("--latency-stages"))) {
+                index++;
+                dumpStatsLocked(args, index, result, true);
                 dumpAll = false;
             }
 
@@ -4031,6 +5486,40 @@ status_t SurfaceFlinger::doDump(int fd, const Vector<String16>& args, bool asPro
                 dumpAll = false;
             }
 
+            if ((index < numArgs) &&
+                (args[index] == String16("--enable-composition-stages"))) {
+                index++;
+                mCompositionStageStats.enable();
+                dumpAll = false;
+            }
+
+            if ((index < numArgs) &&
+                (args[index] == String16("--disable-composition-stages"))) {
+                index++;
+                mCompositionStageStats.disable();
+                dumpAll = false;
+            }
+
+            if ((index < numArgs) &&
+                (args[index] == String16("--clear-composition-stages"))) {
+                index++;
+                mCompositionStageStats.clear();
+                dumpAll = false;
+            }
+
+            if ((index < numArgs) &&
+                (args[index] == String16("--dump-composition-stages"))) {
+                index++;
+                mCompositionStageStats.dump(result);
+                dumpAll = false;
+            }
+
+            if ((index < numArgs) && (args[index] == String16("--latency-cost"))) {
+                index++;
+                mLayerStats.dumpLayerCost(result);
+                dumpAll = false;
+            }
+
             if ((index < numArgs) && (args[index] == String16("--timestats"))) {
                 index++;
                 mTimeStats.parseArgs(asProto, args, index, result);
@@ -4040,8 +5529,13 @@ status_t SurfaceFlinger::doDump(int fd, const Vector<String16>& args, bool asPro
 
         if (dumpAll) {
             if (asProto) {
-                LayersProto layersProto = dumpProtoInfo(LayerVector::StateSet::Current);
-                result.append(layersProto.SerializeAsString().c_str(), layersProto.ByteSize());
+                // the same bytes as dumpProtoInfo(Current) serialized, but
+                // reusing the layers unchanged since the last dump
+                std::string layersProto;
+                mCurrentState.traverseInZOrder([&](Layer* layer) {
+                    layer->appendCurrentStateToProto(&layersProto);
+                });
+                result.append(layersProto.c_str(), layersProto.size());
             } else {
                 dumpAllLocked(args, index, result);
             }
@@ -4064,7 +5558,7 @@ void SurfaceFlinger::listLayersLocked(const Vector<String16>& /* args */,
 }
 
 void SurfaceFlinger::dumpStatsLocked(const Vector<String16>& args, size_t& index,
-        String8& result) const
+        String8& result, bool stages) const
 {
     String8 name;
     if (index < args.size()) {
@@ -4077,11 +5571,19 @@ void SurfaceFlinger::dumpStatsLocked(const Vector<String16>& args, size_t& index
     result.appendFormat("%" PRId64 "\n", period);
 
     if (name.isEmpty()) {
-        mAnimFrameTracker.dumpStats(result);
+        if (stages) {
+            mAnimFrameTracker.dumpStageStats(result);
+        } else {
+            mAnimFrameTracker.dumpStats(result);
+        }
     } else {
         mCurrentState.traverseInZOrder([&](Layer* layer) {
             if (name == layer->getName()) {
-                layer->dumpFrameStats(result);
+                if (stages) {
+                    layer->dumpFrameStageStats(result);
+                } else {
+                    layer->dumpFrameStats(result);
+                }
             }
         });
     }
@@ -4317,6 +5819,8 @@ void SurfaceFlinger::dumpAllLocked(const Vector<String16>& args, size_t& index,
     colorizer.bold(result);
     result.append("DispSync configuration: ");
     colorizer.reset(result);
+    const auto [sfLateOffset, appLateOffset] =
+            mVsyncModulator.getLateOffsets(activeConfig->getVsyncPeriod());
     const auto [sfEarlyOffset, appEarlyOffset] = mVsyncModulator.getEarlyOffsets();
     const auto [sfEarlyGlOffset, appEarlyGlOffset] = mVsyncModulator.getEarlyGlOffsets();
     result.appendFormat(
@@ -4327,14 +5831,27 @@ void SurfaceFlinger::dumpAllLocked(const Vector<String16>& args, size_t& index,
         "early app gl phase %" PRId64 " ns, "
         "early sf gl phase %" PRId64 " ns, "
         "present offset %" PRId64 " ns (refresh %" PRId64 " ns)",
-        vsyncPhaseOffsetNs,
-        sfVsyncPhaseOffsetNs,
+        appLateOffset,
+        sfLateOffset,
         appEarlyOffset,
         sfEarlyOffset,
         appEarlyGlOffset,
         sfEarlyOffset,
         dispSyncPresentTimeOffset, activeConfig->getVsyncPeriod());
     result.append("\n");
+    if (mIdleTimer) {
+        result.appendFormat("Idle refresh rate: %s (after %d ms idle)\n",
+                            mIdleRefreshRate ? "active" : "inactive", mIdleRefreshRateTimeoutMs);
+    }
+    if (mThermalEventListener != nullptr) {
+        result.appendFormat("Thermal throttling: %s (%s the refresh rate)\n",
+                            mThermalThrottling ? "active" : "inactive",
+                            mThermalLowerRefreshRate ? "lowers" : "keeps");
+    }
+    if (mVsyncIdleTimer) {
+        result.appendFormat("Vsync idle: %s (after %d ms idle)\n",
+                            mVsyncIdle ? "active" : "inactive", mVsyncIdleTimeoutMs);
+    }
 
     // Dump static screen stats
     result.append("\n");
@@ -4429,9 +5946,18 @@ void SurfaceFlinger::dumpAllLocked(const Vector<String16>& args, size_t& index,
 
         result.appendFormat("Display %d HWC layers:\n", hwcId);
         Layer::miniDumpHeader(result);
+        uint64_t cacheHits = 0;
+        uint64_t cacheMisses = 0;
         mCurrentState.traverseInZOrder([&](Layer* layer) {
             layer->miniDump(result, hwcId);
+            auto hwcInfo = layer->getBE().mHwcLayers.find(hwcId);
+            if (hwcInfo != layer->getBE().mHwcLayers.end()) {
+                cacheHits += hwcInfo->second.bufferCache.getHitCount();
+                cacheMisses += hwcInfo->second.bufferCache.getMissCount();
+            }
         });
+        result.appendFormat("  buffer cache: %" PRIu64 " hits, %" PRIu64 " misses\n",
+                            cacheHits, cacheMisses);
         result.append("\n");
     }
 
@@ -4761,9 +6287,13 @@ status_t SurfaceFlinger::onTransact(
                 reply->writeBool(hasWideColorDisplay);
                 return NO_ERROR;
             }
-            case 1025: { // Set layer tracing
+            case 1025: { // Set layer tracing, 2 to keep a ring buffer of changes
                 n = data.readInt32();
-                if (n) {
+                if (n == 2) {
+                    ALOGV("LayerTracing ring buffer enabled");
+                    mTracing.enableRingBuffer();
+                    reply->writeInt32(NO_ERROR);
+                } else if (n) {
                     ALOGV("LayerTracing enabled");
                     mTracing.enable();
                     doTracing("tracing.enable");
@@ -4779,6 +6309,11 @@ status_t SurfaceFlinger::onTransact(
                 reply->writeBool(mTracing.isEnabled());
                 return NO_ERROR;
             }
+            case 1029: { // Write the layer tracing ring buffer out
+                reply->writeInt32(mTracing.isRingBufferEnabled() ? mTracing.flushRingBuffer()
+                                                                 : INVALID_OPERATION);
+                return NO_ERROR;
+            }
             // Is a DisplayColorSetting supported?
             case 1027: {
                 sp<const DisplayDevice> hw(getDefaultDisplayDevice());
@@ -4803,6 +6338,23 @@ status_t SurfaceFlinger::onTransact(
                 }
                 return NO_ERROR;
             }
+            // Get frame time percentiles from TimeStats. Takes a layer name,
+            // empty for all layers, and replies with the number of deltas,
+            // then the name, sample count and 50th, 90th and 99th percentile
+            // in ms of each.
+            case 1028: {
+                const std::string layerName(String8(data.readString16()).string());
+                const auto percentiles = mTimeStats.getPercentiles(layerName);
+                reply->writeInt32(static_cast<int32_t>(percentiles.size()));
+                for (const auto& delta : percentiles) {
+                    reply->writeString16(String16(delta.deltaName.c_str()));
+                    reply->writeInt64(delta.count);
+                    reply->writeInt32(delta.p50);
+                    reply->writeInt32(delta.p90);
+                    reply->writeInt32(delta.p99);
+                }
+                return NO_ERROR;
+            }
         }
     }
     return err;
@@ -4977,10 +6529,19 @@ status_t SurfaceFlinger::captureScreenCommon(RenderArea& renderArea,
 
     renderArea.updateDimensions(mPrimaryDisplayOrientation);
 
-    const uint32_t usage = GRALLOC_USAGE_SW_READ_OFTEN | GRALLOC_USAGE_SW_WRITE_OFTEN |
-            GRALLOC_USAGE_HW_RENDER | GRALLOC_USAGE_HW_TEXTURE;
-    *outBuffer = new GraphicBuffer(renderArea.getReqWidth(), renderArea.getReqHeight(),
-                                   HAL_PIXEL_FORMAT_RGBA_8888, 1, usage, "screenshot");
+    // render into the caller's buffer when it fits the request, so repeated
+    // captures don't allocate a new one each time
+    const sp<GraphicBuffer>& buffer = *outBuffer;
+    if (buffer == nullptr ||
+        buffer->getWidth() != static_cast<uint32_t>(renderArea.getReqWidth()) ||
+        buffer->getHeight() != static_cast<uint32_t>(renderArea.getReqHeight()) ||
+        buffer->getPixelFormat() != HAL_PIXEL_FORMAT_RGBA_8888 ||
+        (buffer->getUsage() & GRALLOC_USAGE_HW_RENDER) == 0) {
+        const uint32_t usage = GRALLOC_USAGE_SW_READ_OFTEN | GRALLOC_USAGE_SW_WRITE_OFTEN |
+                GRALLOC_USAGE_HW_RENDER | GRALLOC_USAGE_HW_TEXTURE;
+        *outBuffer = new GraphicBuffer(renderArea.getReqWidth(), renderArea.getReqHeight(),
+                                       HAL_PIXEL_FORMAT_RGBA_8888, 1, usage, "screenshot");
+    }
 
     // This mutex protects syncFd and captureResult for communication of the return values from the
     // main thread back to this Binder thread
@@ -4993,17 +6554,7 @@ status_t SurfaceFlinger::captureScreenCommon(RenderArea& renderArea,
     const int uid = IPCThreadState::self()->getCallingUid();
     const bool forSystem = uid == AID_GRAPHICS || uid == AID_SYSTEM;
 
-    sp<LambdaMessage> message = new LambdaMessage([&]() {
-        // If there is a refresh pending, bug out early and tell the binder thread to try again
-        // after the refresh.
-        if (mRefreshPending) {
-            ATRACE_NAME("Skipping screenshot for now");
-            std::unique_lock<std::mutex> captureLock(captureMutex);
-            captureResult = std::make_optional<status_t>(EAGAIN);
-            captureCondition.notify_one();
-            return;
-        }
-
+    auto capture = [&]() {
         status_t result = NO_ERROR;
         int fd = -1;
         {
@@ -5020,19 +6571,22 @@ status_t SurfaceFlinger::captureScreenCommon(RenderArea& renderArea,
             captureResult = std::make_optional<status_t>(result);
             captureCondition.notify_one();
         }
+    };
+
+    sp<LambdaMessage> message = new LambdaMessage([&]() {
+        // If there is a refresh pending, render right after it instead of in
+        // front of it, so the screenshot doesn't delay the frame.
+        if (mRefreshPending) {
+            ATRACE_NAME("Deferring screenshot");
+            mDeferredCaptures.push_back(capture);
+            return;
+        }
+        capture();
     });
 
     status_t result = postMessageAsync(message);
     if (result == NO_ERROR) {
         captureCondition.wait(captureLock, [&]() { return captureResult; });
-        while (*captureResult == EAGAIN) {
-            captureResult.reset();
-            result = postMessageAsync(message);
-            if (result != NO_ERROR) {
-                return result;
-            }
-            captureCondition.wait(captureLock, [&]() { return captureResult; });
-        }
         result = *captureResult;
     }
 
@@ -5241,17 +6795,65 @@ void SurfaceFlinger::checkScreenshot(size_t w, size_t s, size_t h, void const* v
 
 // ---------------------------------------------------------------------------
 
+void SurfaceFlinger::State::cacheLayersInZOrder() {
+    layersInZOrder.clear();
+    for (const auto& root : layersSortedByZ) {
+        const Layer::State& state = (stateSet == LayerVector::StateSet::Current)
+                ? root->getCurrentState()
+                : root->getDrawingState();
+        // relative layers are traversed in Layer::traverseInZOrder
+        if (state.zOrderRelativeOf != nullptr) {
+            continue;
+        }
+        root->traverseInZOrder(stateSet, [&](Layer* layer) {
+            layersInZOrder.push_back({layer, root.get()});
+        });
+    }
+}
+
 void SurfaceFlinger::State::traverseInZOrder(const LayerVector::Visitor& visitor) const {
+    if (!layersInZOrder.empty()) {
+        for (const TraversalEntry& entry : layersInZOrder) {
+            visitor(entry.layer);
+        }
+        return;
+    }
     layersSortedByZ.traverseInZOrder(stateSet, visitor);
 }
 
 void SurfaceFlinger::State::traverseInReverseZOrder(const LayerVector::Visitor& visitor) const {
+    if (!layersInZOrder.empty()) {
+        for (auto it = layersInZOrder.rbegin(); it != layersInZOrder.rend(); ++it) {
+            visitor(it->layer);
+        }
+        return;
+    }
     layersSortedByZ.traverseInReverseZOrder(stateSet, visitor);
 }
 
 void SurfaceFlinger::traverseLayersInDisplay(const sp<const DisplayDevice>& hw, int32_t minLayerZ,
                                              int32_t maxLayerZ,
                                              const LayerVector::Visitor& visitor) {
+    if (!mDrawingState.layersInZOrder.empty()) {
+        // min/max layer Z are interpreted in the top level Z space
+        for (const State::TraversalEntry& entry : mDrawingState.layersInZOrder) {
+            const Layer::State& rootState(entry.root->getDrawingState());
+            if (rootState.z < minLayerZ || rootState.z > maxLayerZ ||
+                !entry.root->belongsToDisplay(hw->getLayerStack(), false)) {
+                continue;
+            }
+            Layer* layer = entry.layer;
+            if (!layer->belongsToDisplay(hw->getLayerStack(), false)) {
+                continue;
+            }
+            if (!layer->isVisible()) {
+                continue;
+            }
+            visitor(layer);
+        }
+        return;
+    }
+
     // We loop through the first level of layers without traversing,
     // as we need to interpret min/max layer Z in the top level Z space.
     for (const auto& layer : mDrawingState.layersSortedByZ) {
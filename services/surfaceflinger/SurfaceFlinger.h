@@ -30,6 +30,7 @@
 
 #include <utils/Errors.h>
 #include <utils/KeyedVector.h>
+#include <utils/Looper.h>
 #include <utils/RefBase.h>
 #include <utils/SortedVector.h>
 #include <utils/threads.h>
@@ -57,6 +58,9 @@
 #include "DispSync.h"
 #include "EventThread.h"
 #include "FrameTracker.h"
+#include "IdleTimer.h"
+#include "CompositionStageStats.h"
+#include "GpuStats.h"
 #include "LayerStats.h"
 #include "LayerVector.h"
 #include "MessageQueue.h"
@@ -71,8 +75,10 @@
 
 #include "Effects/Daltonizer.h"
 
+#include <atomic>
 #include <map>
 #include <mutex>
+#include <deque>
 #include <queue>
 #include <string>
 #include <thread>
@@ -114,6 +120,10 @@ namespace dvr {
 class VrFlinger;
 } // namespace dvr
 
+namespace os {
+class IThermalEventListener;
+} // namespace os
+
 // ---------------------------------------------------------------------------
 
 enum {
@@ -179,6 +189,9 @@ public:
 
     FenceTimeline mGlCompositionDoneTimeline;
     FenceTimeline mDisplayTimeline;
+    // The release fences of all layers come from the display's timeline, so
+    // they share one FenceTimeline and only its oldest pending fence is polled.
+    FenceTimeline mReleaseTimeline{FenceTimeline::MAX_ENTRIES * 4};
 
     // protected by mCompositorTimingLock;
     mutable std::mutex mCompositorTimingLock;
@@ -327,6 +340,9 @@ public:
     // utility function to delete a texture on the main thread
     void deleteTextureAsync(uint32_t texture);
 
+    // Appends what dumpsys gpu prints with |args|, for GpuService
+    void dumpGpuStats(const Vector<String16>& args, String8& result);
+
     // enable/disable h/w composer event
     // TODO: this should be made accessible only to EventThread
     void setVsyncEnabled(int disp, int enabled);
@@ -383,6 +399,8 @@ private:
             if (colorMatrixChanged) {
                 colorMatrix = other.colorMatrix;
             }
+            // the layer tree changed, the flattened order is stale
+            layersInZOrder.clear();
             return *this;
         }
 
@@ -393,6 +411,20 @@ private:
         bool colorMatrixChanged = true;
         mat4 colorMatrix;
 
+        // A layer in the flattened draw order, along with the top-level layer
+        // whose traversal reaches it.
+        struct TraversalEntry {
+            Layer* layer;
+            Layer* root;
+        };
+        // layersSortedByZ and all their descendants in Z order, as built by
+        // cacheLayersInZOrder(). The traversals below iterate it linearly
+        // instead of walking the layer tree when it isn't empty. Only valid as
+        // long as the layer tree is unchanged, which holds for the drawing
+        // state between two commitTransaction() calls.
+        std::vector<TraversalEntry> layersInZOrder;
+        void cacheLayersInZOrder();
+
         void traverseInZOrder(const LayerVector::Visitor& visitor) const;
         void traverseInReverseZOrder(const LayerVector::Visitor& visitor) const;
     };
@@ -481,6 +513,20 @@ private:
     void onInitializeDisplays();
     // called on the main thread in response to setActiveConfig()
     void setActiveConfigInternal(const sp<DisplayDevice>& hw, int mode);
+    // called on the main thread to move the primary display to or from its
+    // lowest refresh rate when composition goes idle or resumes
+    void setIdleRefreshRate(bool idle);
+    // called on the main thread when thermalservice reports that throttling
+    // started or stopped
+    void setThermalThrottling(bool throttling);
+    // moves the primary display to its lowest refresh rate while idle or,
+    // if debug.sf.thermal_lower_refresh_rate is set, thermal throttling, and
+    // back to the config it had once neither holds
+    void updateReducedRefreshRate();
+    void registerThermalEventListener();
+    // Stops continuous vsync delivery and hardware vsync while nothing is
+    // drawn, and brings them back on the DispSync model's phase.
+    void setVsyncIdle(bool idle);
     // called on the main thread in response to setPowerMode()
     void setPowerModeInternal(const sp<DisplayDevice>& hw, int mode,
                               bool stateLockHeld);
@@ -523,6 +569,38 @@ private:
     uint32_t setClientStateLocked(const ComposerState& composerState);
     uint32_t setDisplayStateLocked(const DisplayState& s);
     void setDestroyStateLocked(const ComposerState& composerState);
+    // Applies the display and layer states of one transaction to
+    // mCurrentState and returns the transaction flags it requires.
+    uint32_t applyTransactionStateLocked(const Vector<ComposerState>& states,
+                                         const Vector<DisplayState>& displays);
+
+    // Asynchronous transactions waiting to be applied by the main thread,
+    // see debug.sf.queue_async_transactions.
+    struct QueuedTransaction {
+        Vector<ComposerState> states;
+        Vector<DisplayState> displays;
+        uint32_t flags;
+    };
+    // Moves the queued transactions into outTransactions, which the caller
+    // should destroy without mStateLock held, and applies them in order.
+    // outClients holds the clients whose transaction channel was drained,
+    // and must be destroyed the same way.
+    void applyQueuedTransactionsLocked(std::vector<QueuedTransaction>& outTransactions,
+                                       std::vector<sp<Client>>& outClients);
+    // Can only be called from the main thread
+    void applyQueuedTransactions();
+
+    // Transaction channels let clients write asynchronous transactions to
+    // shared memory instead of calling setTransactionState, see
+    // debug.sf.transaction_channels.
+    void registerTransactionChannel(const sp<Client>& client, int eventFd);
+    // Must not be called with mTransactionQueueMutex held
+    void unregisterTransactionChannel(int eventFd);
+    // Queues the transactions written to the channels, in the order each
+    // client wrote them. The caller should destroy outClients without
+    // mTransactionQueueMutex held.
+    void drainTransactionChannelsLocked(std::vector<sp<Client>>& outClients);
+    static int onTransactionChannelSignaled(int fd, int events, void* data);
 
     /* ------------------------------------------------------------------------
      * Layer management
@@ -644,12 +722,21 @@ private:
 
     HWComposer& getHwComposer() const { return *getBE().mHwc; }
 
+    FenceTimeline& getReleaseTimeline() { return getBE().mReleaseTimeline; }
+
     /* ------------------------------------------------------------------------
      * Compositing
      */
     void invalidateHwcGeometry();
-    void computeVisibleRegions(const sp<const DisplayDevice>& displayDevice,
-            Region& dirtyRegion, Region& opaqueRegion);
+    // When fullRecompute is false, the visible regions of the layers above
+    // the topmost layer marked by invalidateLayerVisibleRegions() are reused
+    // from the previous pass on this display.
+    void computeVisibleRegions(const sp<DisplayDevice>& displayDevice,
+            Region& dirtyRegion, Region& opaqueRegion, bool fullRecompute);
+    // Schedule a visible region and HWC geometry update for a layer and its
+    // children only. Visible regions are still recomputed for every layer
+    // when incremental mode is disabled.
+    void invalidateLayerVisibleRegions(Layer* layer, LayerVector::StateSet stateSet);
 
     void preComposition(nsecs_t refreshStartTime);
     void postComposition(nsecs_t refreshStartTime);
@@ -673,18 +760,61 @@ private:
                        ui::RenderIntent* outRenderIntent) const;
 
     void setUpHWComposer();
+    // Estimates what the client composition of each display will cost this
+    // frame, from its layers and the GPU time of recent frames, and passes
+    // it on to the power HAL before composition starts
+    void updateClientCompositionLoad();
+    void sampleClientCompositionTime(std::shared_ptr<FenceTime> doneFence);
+    // Latches buffers that became due after handlePageFlip() for layers
+    // using device composition, and revalidates their displays.
+    void lateLatchBuffers();
     void doComposition();
+
+    // Groups of displays that doComposition() can compose and present
+    // separately from each other.
+    enum class DisplaySubset { All, Physical, Virtual };
+    static bool isInDisplaySubset(const sp<const DisplayDevice>& displayDevice,
+                                  DisplaySubset subset);
+    void doCompositionForDisplays(DisplaySubset subset, bool repaintEverything);
     void doDebugFlashRegions();
     void doTracing(const char* where);
     void logLayerStats();
+    // Renders the screenshots that were waiting for the current frame
+    void runDeferredCaptures();
     void doDisplayComposition(const sp<const DisplayDevice>& displayDevice, const Region& dirtyRegion);
 
     // compose surfaces for display hw. this fails if using GL and the surface
     // has been destroyed and is no longer valid.
-    bool doComposeSurfaces(const sp<const DisplayDevice>& displayDevice);
+    bool doComposeSurfaces(const sp<const DisplayDevice>& displayDevice,
+                           const Region& dirtyRegion);
 
-    void postFramebuffer();
+    void postFramebuffer(DisplaySubset subset = DisplaySubset::All);
     void drawWormhole(const sp<const DisplayDevice>& displayDevice, const Region& region) const;
+    // Layer flattening: adjacent layers that stay unchanged and client
+    // composited for mLayerFlatteningFrames are drawn once into a buffer HWC
+    // shows in their place, see DisplayDevice::FlattenedLayers
+    bool canFlattenLayers() const;
+    bool isLayerFlattenable(const sp<Layer>& layer, int32_t hwcId) const;
+    void unflattenChangedLayers();
+    void updateLayerStableFrames(bool layersChanged);
+    void flattenStableLayers(const sp<DisplayDevice>& displayDevice);
+    void setFlattenedLayersPerFrameData(const sp<const DisplayDevice>& displayDevice,
+                                        DisplayDevice::FlattenedLayers& flattened) const;
+
+    // Draws the display space |frame| of |offscreen| to the same place of the
+    // current surface
+    void drawOffscreenBuffer(const sp<const DisplayDevice>& displayDevice,
+                             const DisplayDevice::OffscreenBuffer& offscreen, const Rect& frame,
+                             bool opaque) const;
+
+    // Virtual display mirroring: a virtual display showing the same layers
+    // as the primary display through a scale and offset draws the client
+    // target the primary display was just composed into, instead of
+    // composing the layers again. Returns the display to mirror, or nullptr
+    // if the virtual display has to be composed itself this frame.
+    sp<const DisplayDevice> getMirroredDisplay(const sp<const DisplayDevice>& displayDevice) const;
+    bool doComposeMirroredDisplay(const sp<const DisplayDevice>& displayDevice,
+                                  const sp<const DisplayDevice>& mirrored);
 
     /* ------------------------------------------------------------------------
      * Display management
@@ -724,7 +854,8 @@ public:
 
 private:
     void listLayersLocked(const Vector<String16>& args, size_t& index, String8& result) const;
-    void dumpStatsLocked(const Vector<String16>& args, size_t& index, String8& result) const;
+    void dumpStatsLocked(const Vector<String16>& args, size_t& index, String8& result,
+                         bool stages) const;
     void clearStatsLocked(const Vector<String16>& args, size_t& index, String8& result);
     void dumpAllLocked(const Vector<String16>& args, size_t& index, String8& result) const;
     bool startDdmConnection();
@@ -748,6 +879,15 @@ private:
     bool isLayerTripleBufferingDisabled() const {
         return this->mLayerTripleBufferingDisabled;
     }
+    bool isLayerAdaptiveBufferCountEnabled() const {
+        return this->mLayerAdaptiveBufferCountEnabled;
+    }
+    bool isLayerBufferPreallocationEnabled() const {
+        return this->mLayerBufferPreallocationEnabled;
+    }
+    bool isCadenceAwareLatchingEnabled() const {
+        return this->mCadenceAwareLatchingEnabled;
+    }
     status_t doDump(int fd, const Vector<String16>& args, bool asProto);
 
     /* ------------------------------------------------------------------------
@@ -773,6 +913,20 @@ private:
     bool mAnimTransactionPending;
     SortedVector< sp<Layer> > mLayersPendingRemoval;
 
+    // Binder threads only take this short-lived lock, instead of mStateLock,
+    // to queue an asynchronous transaction.
+    bool mQueueAsyncTransactions = false;
+    std::mutex mTransactionQueueMutex;
+    std::vector<QueuedTransaction> mTransactionQueue;
+
+    bool mTransactionChannelsEnabled = false;
+    // protected by mTransactionQueueMutex
+    std::vector<wp<Client>> mTransactionChannelClients;
+    // Wakes the main thread when a client signals its transaction channel
+    sp<Looper> mTransactionChannelLooper;
+    std::thread mTransactionChannelThread;
+    std::atomic<bool> mTransactionChannelThreadExit{false};
+
     // global color transform states
     Daltonizer mDaltonizer;
     float mGlobalSaturationFactor = 1.0f;
@@ -803,16 +957,67 @@ private:
 
     VSyncModulator mVsyncModulator;
 
+    // drops the primary display to its lowest refresh rate after
+    // mIdleRefreshRateTimeoutMs without a frame, null if that is 0
+    std::unique_ptr<IdleTimer> mIdleTimer;
+    int mIdleRefreshRateTimeoutMs = 0;
+    // only accessed from the main thread
+    bool mIdleRefreshRate = false;
+    bool mThermalThrottling = false;
+    bool mReducedRefreshRate = false;
+    int mConfigBeforeReducedRefreshRate = 0;
+    // whether thermal throttling lowers the refresh rate like idle does,
+    // rather than only holding back the expensive rendering hint
+    bool mThermalLowerRefreshRate = false;
+    sp<os::IThermalEventListener> mThermalEventListener;
+
+    // enters vsync idle after mVsyncIdleTimeoutMs without a frame, null if
+    // that is 0
+    std::unique_ptr<IdleTimer> mVsyncIdleTimer;
+    int mVsyncIdleTimeoutMs = 0;
+    // only accessed from the main thread
+    bool mVsyncIdle = false;
+
     // Can only accessed from the main thread, these members
     // don't need synchronization
     State mDrawingState{LayerVector::StateSet::Drawing};
     bool mVisibleRegionsDirty;
+    // Layers marked with the current generation have dirty visible regions,
+    // see invalidateLayerVisibleRegions(). Only used in incremental mode.
+    bool mIncrementalVisibleRegions = false;
+    bool mHasLayersWithDirtyVisibleRegions = false;
+    uint64_t mVisibleRegionsGeneration = 1;
+    // Set when every layer needs its HWC geometry updated.
     bool mGeometryInvalid;
+    // Set when only the layers marked with mGeometryGeneration (or whose
+    // z order changed) need their HWC geometry updated.
+    bool mLayerGeometryInvalid = false;
+    uint64_t mGeometryGeneration = 0;
+    // Bumped when a layer latches a buffer of another dataspace, so that the
+    // displays know to pick their color mode again.
+    uint32_t mLayerDataspaceGeneration = 0;
     bool mAnimCompositionPending;
     std::vector<sp<Layer>> mLayersWithQueuedFrames;
     sp<Fence> mPreviousPresentFence = Fence::NO_FENCE;
     bool mHadClientComposition = false;
 
+    // Client compositions of the primary display whose GPU time isn't known
+    // yet, oldest first
+    struct ClientCompositionSample {
+        nsecs_t startTime;
+        uint64_t pixelCount;
+        std::shared_ptr<FenceTime> doneFence;
+        // only while mGpuStats is enabled
+        std::vector<GpuStats::LayerPixels> layers;
+    };
+    std::deque<ClientCompositionSample> mClientCompositionSamples;
+    // moving average of the GPU time per client composed pixel, 0 until the
+    // first sample
+    double mClientCompositionNsPerPixel = 0;
+    uint64_t mPrimaryClientCompositionPixels = 0;
+    std::vector<GpuStats::LayerPixels> mPrimaryClientCompositionLayers;
+    nsecs_t mCompositionStartTime = 0;
+
     enum class BootStage {
         BOOTLOADER,
         BOOTANIMATION,
@@ -842,16 +1047,35 @@ private:
     nsecs_t mLastTransactionTime;
     bool mForceFullDamage;
     bool mPropagateBackpressure = true;
+    bool mPresentVirtualDisplaysLast = false;
+    bool mMirrorVirtualDisplays = false;
+    bool mAdaptiveClientTargetBuffers = false;
+    bool mLateLatch = false;
+    bool mPartialClientComposition = false;
+    bool mColorMatrixPostPass = false;
+    // frames a layer has to stay unchanged before it is flattened, 0 if never
+    uint32_t mLayerFlatteningFrames = 0;
+    // where RenderEngine keeps the program keys it has needed, empty if it doesn't
+    std::string mProgramCacheFile;
     std::unique_ptr<SurfaceInterceptor> mInterceptor =
             std::make_unique<impl::SurfaceInterceptor>(this);
     SurfaceTracing mTracing;
     LayerStats mLayerStats;
+    CompositionStageStats mCompositionStageStats;
+    GpuStats mGpuStats;
     TimeStats& mTimeStats = TimeStats::getInstance();
     bool mUseHwcVirtualDisplays = false;
 
     // Restrict layers to use two buffers in their bufferqueues.
     bool mLayerTripleBufferingDisabled = false;
 
+    // Let layer bufferqueues size themselves from their occupancy.
+    bool mLayerAdaptiveBufferCountEnabled = false;
+
+    // Allocate layer buffers of the new size in the background on resize.
+    bool mLayerBufferPreallocationEnabled = false;
+    bool mCadenceAwareLatchingEnabled = false;
+
     // these are thread safe
     mutable std::unique_ptr<MessageQueue> mEventQueue{std::make_unique<impl::MessageQueue>()};
     FrameTracker mAnimFrameTracker;
@@ -869,6 +1093,10 @@ private:
 
     std::atomic<bool> mRefreshPending{false};
 
+    // Screenshots requested while a refresh was pending. Only accessed from
+    // the main thread; the requesting binder threads wait for them.
+    std::vector<std::function<void()>> mDeferredCaptures;
+
     // We maintain a pool of pre-generated texture names to hand out to avoid
     // layer creation needing to run on the main thread (which it would
     // otherwise need to do to access RenderEngine).
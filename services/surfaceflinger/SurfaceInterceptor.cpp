@@ -21,9 +21,8 @@
 #include "SurfaceFlinger.h"
 #include "SurfaceInterceptor.h"
 
-#include <fstream>
+#include <chrono>
 
-#include <android-base/file.h>
 #include <log/log.h>
 #include <utils/Trace.h>
 
@@ -35,117 +34,222 @@ SurfaceInterceptor::~SurfaceInterceptor() = default;
 
 namespace impl {
 
+// How often the worker drains the staged records into the trace file
+constexpr std::chrono::milliseconds kWriteInterval{100};
+
 SurfaceInterceptor::SurfaceInterceptor(SurfaceFlinger* flinger)
     :   mFlinger(flinger)
 {
 }
 
+SurfaceInterceptor::~SurfaceInterceptor() {
+    disable();
+    deleteRecords(takeRecords());
+}
+
 void SurfaceInterceptor::enable(const SortedVector<sp<Layer>>& layers,
         const DefaultKeyedVector< wp<IBinder>, DisplayDeviceState>& displays)
 {
+    std::lock_guard<std::mutex> protoGuard(mTraceMutex);
     if (mEnabled) {
         return;
     }
     ATRACE_CALL();
+    // Records saved while the previous session was being stopped are dropped
+    deleteRecords(takeRecords());
+
+    mOutput.open(mOutputFileName, std::ios::out | std::ios::trunc | std::ios::binary);
+    if (!mOutput.is_open()) {
+        ALOGE("Could not save the proto file! Permission denied");
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mWorkerMutex);
+        mStopWorker = false;
+    }
+    mCompactor = TraceCompactor();
+    mWorker = std::thread(&SurfaceInterceptor::threadMain, this);
+
+    saveExistingDisplays(displays);
+    saveExistingSurfaces(layers);
     mEnabled = true;
-    std::lock_guard<std::mutex> protoGuard(mTraceMutex);
-    saveExistingDisplaysLocked(displays);
-    saveExistingSurfacesLocked(layers);
 }
 
 void SurfaceInterceptor::disable() {
+    std::lock_guard<std::mutex> protoGuard(mTraceMutex);
     if (!mEnabled) {
         return;
     }
     ATRACE_CALL();
-    std::lock_guard<std::mutex> protoGuard(mTraceMutex);
     mEnabled = false;
-    status_t err(writeProtoFileLocked());
-    ALOGE_IF(err == PERMISSION_DENIED, "Could not save the proto file! Permission denied");
-    ALOGE_IF(err == NOT_ENOUGH_DATA, "Could not save the proto file! There are missing fields");
-    mTrace.Clear();
+    {
+        std::lock_guard<std::mutex> lock(mWorkerMutex);
+        mStopWorker = true;
+        mWorkerCondition.notify_all();
+    }
+    // The worker writes out everything staged so far before it exits
+    mWorker.join();
+    mOutput.close();
 }
 
 bool SurfaceInterceptor::isEnabled() {
     return mEnabled;
 }
 
-void SurfaceInterceptor::saveExistingDisplaysLocked(
-        const DefaultKeyedVector< wp<IBinder>, DisplayDeviceState>& displays)
-{
-    // Caveat: The initial snapshot does not capture the power mode of the existing displays
-    ATRACE_CALL();
-    for (size_t i = 0 ; i < displays.size() ; i++) {
-        addDisplayCreationLocked(createTraceIncrementLocked(), displays[i]);
-        addInitialDisplayStateLocked(createTraceIncrementLocked(), displays[i]);
+void SurfaceInterceptor::pushRecord(Record* record) {
+    record->next = mRecords.load(std::memory_order_relaxed);
+    while (!mRecords.compare_exchange_weak(record->next, record, std::memory_order_release,
+                                           std::memory_order_relaxed)) {
     }
 }
 
-void SurfaceInterceptor::saveExistingSurfacesLocked(const SortedVector<sp<Layer>>& layers) {
-    ATRACE_CALL();
-    for (const auto& l : layers) {
-        l->traverseInZOrder(LayerVector::StateSet::Drawing, [this](Layer* layer) {
-            addSurfaceCreationLocked(createTraceIncrementLocked(), layer);
-            addInitialSurfaceStateLocked(createTraceIncrementLocked(), layer);
-        });
+SurfaceInterceptor::Record* SurfaceInterceptor::takeRecords() {
+    Record* stack = mRecords.exchange(nullptr, std::memory_order_acquire);
+    Record* records = nullptr;
+    while (stack != nullptr) {
+        Record* next = stack->next;
+        stack->next = records;
+        records = stack;
+        stack = next;
     }
+    return records;
 }
 
-void SurfaceInterceptor::addInitialSurfaceStateLocked(Increment* increment,
-        const sp<const Layer>& layer)
-{
-    Transaction* transaction(increment->mutable_transaction());
-    transaction->set_synchronous(layer->mTransactionFlags & BnSurfaceComposer::eSynchronous);
-    transaction->set_animation(layer->mTransactionFlags & BnSurfaceComposer::eAnimation);
-
-    const int32_t layerId(getLayerId(layer));
-    addPositionLocked(transaction, layerId, layer->mCurrentState.active.transform.tx(),
-            layer->mCurrentState.active.transform.ty());
-    addDepthLocked(transaction, layerId, layer->mCurrentState.z);
-    addAlphaLocked(transaction, layerId, layer->mCurrentState.color.a);
-    addTransparentRegionLocked(transaction, layerId, layer->mCurrentState.activeTransparentRegion);
-    addLayerStackLocked(transaction, layerId, layer->mCurrentState.layerStack);
-    addCropLocked(transaction, layerId, layer->mCurrentState.crop);
-    if (layer->mCurrentState.barrierLayer != nullptr) {
-        addDeferTransactionLocked(transaction, layerId, layer->mCurrentState.barrierLayer.promote(),
-                layer->mCurrentState.frameNumber);
-    }
-    addFinalCropLocked(transaction, layerId, layer->mCurrentState.finalCrop);
-    addOverrideScalingModeLocked(transaction, layerId, layer->getEffectiveScalingMode());
-    addFlagsLocked(transaction, layerId, layer->mCurrentState.flags);
-}
-
-void SurfaceInterceptor::addInitialDisplayStateLocked(Increment* increment,
-        const DisplayDeviceState& display)
-{
-    Transaction* transaction(increment->mutable_transaction());
-    transaction->set_synchronous(false);
-    transaction->set_animation(false);
+void SurfaceInterceptor::deleteRecords(Record* records) {
+    while (records != nullptr) {
+        Record* next = records->next;
+        delete records;
+        records = next;
+    }
+}
+
+void SurfaceInterceptor::threadMain() NO_THREAD_SAFETY_ANALYSIS {
+    bool stop = false;
+    while (!stop) {
+        {
+            std::unique_lock<std::mutex> lock(mWorkerMutex);
+            mWorkerCondition.wait_for(lock, kWriteInterval, [this]() NO_THREAD_SAFETY_ANALYSIS {
+                return mStopWorker;
+            });
+            stop = mStopWorker;
+        }
 
-    addDisplaySurfaceLocked(transaction, display.displayId, display.surface);
-    addDisplayLayerStackLocked(transaction, display.displayId, display.layerStack);
-    addDisplaySizeLocked(transaction, display.displayId, display.width, display.height);
-    addDisplayProjectionLocked(transaction, display.displayId, display.orientation,
-            display.viewport, display.frame);
+        status_t err(writeRecords(takeRecords()));
+        ALOGE_IF(err == PERMISSION_DENIED, "Could not save the proto file! Permission denied");
+        ALOGE_IF(err == NOT_ENOUGH_DATA, "Could not save the proto file! There are missing fields");
+    }
 }
 
-status_t SurfaceInterceptor::writeProtoFileLocked() {
+status_t SurfaceInterceptor::writeRecords(Record* records) {
+    if (records == nullptr) {
+        return NO_ERROR;
+    }
     ATRACE_CALL();
-    std::string output;
+    Trace trace;
+    for (const Record* record = records; record != nullptr; record = record->next) {
+        addIncrement(trace.add_increment(), *record);
+    }
+    deleteRecords(records);
+    mCompactor.compact(&trace);
 
-    if (!mTrace.IsInitialized()) {
+    // Serialized Traces concatenate into a single Trace holding all of their increments and names,
+    // so each batch is simply appended to the file
+    std::string output;
+    if (!trace.IsInitialized()) {
         return NOT_ENOUGH_DATA;
     }
-    if (!mTrace.SerializeToString(&output)) {
+    if (!trace.SerializeToString(&output)) {
         return PERMISSION_DENIED;
     }
-    if (!android::base::WriteStringToFile(output, mOutputFileName, true)) {
+    mOutput.write(output.data(), output.size());
+    mOutput.flush();
+    if (!mOutput.good()) {
+        mOutput.clear();
         return PERMISSION_DENIED;
     }
 
     return NO_ERROR;
 }
 
+void SurfaceInterceptor::saveExistingDisplays(
+        const DefaultKeyedVector< wp<IBinder>, DisplayDeviceState>& displays)
+{
+    // Caveat: The initial snapshot does not capture the power mode of the existing displays
+    ATRACE_CALL();
+    for (size_t i = 0 ; i < displays.size() ; i++) {
+        pushRecord(createDisplayCreationRecord(displays[i]));
+        pushRecord(createInitialDisplayStateRecord(displays[i]));
+    }
+}
+
+void SurfaceInterceptor::saveExistingSurfaces(const SortedVector<sp<Layer>>& layers) {
+    ATRACE_CALL();
+    for (const auto& l : layers) {
+        l->traverseInZOrder(LayerVector::StateSet::Drawing, [this](Layer* layer) {
+            pushRecord(createSurfaceCreationRecord(layer));
+            pushRecord(createInitialSurfaceStateRecord(layer));
+        });
+    }
+}
+
+SurfaceInterceptor::Record* SurfaceInterceptor::createInitialSurfaceStateRecord(
+        const sp<const Layer>& layer)
+{
+    Record* record(new Record(Record::Type::TRANSACTION));
+    record->synchronous = layer->mTransactionFlags & BnSurfaceComposer::eSynchronous;
+    record->animation = layer->mTransactionFlags & BnSurfaceComposer::eAnimation;
+
+    const Layer::State& state(layer->mCurrentState);
+    SurfaceChangeRecord change;
+    change.layerId = getLayerId(layer);
+    change.what = layer_state_t::ePositionChanged | layer_state_t::eLayerChanged |
+            layer_state_t::eAlphaChanged | layer_state_t::eTransparentRegionChanged |
+            layer_state_t::eLayerStackChanged | layer_state_t::eCropChanged |
+            layer_state_t::eFinalCropChanged | layer_state_t::eOverrideScalingModeChanged |
+            layer_state_t::eFlagsChanged;
+    change.x = state.active.transform.tx();
+    change.y = state.active.transform.ty();
+    change.z = state.z;
+    change.alpha = state.color.a;
+    change.transparentRegion = state.activeTransparentRegion;
+    change.layerStack = state.layerStack;
+    change.crop = state.crop;
+    if (state.barrierLayer != nullptr) {
+        const sp<const Layer> barrierLayer(state.barrierLayer.promote());
+        change.what |= layer_state_t::eDeferTransaction;
+        change.hasBarrierLayer = barrierLayer != nullptr;
+        change.barrierLayerId = barrierLayer != nullptr ? getLayerId(barrierLayer) : -1;
+        change.frameNumber = state.frameNumber;
+    }
+    change.finalCrop = state.finalCrop;
+    change.overrideScalingMode = layer->getEffectiveScalingMode();
+    change.flags = state.flags;
+    record->surfaceChanges.push_back(std::move(change));
+    return record;
+}
+
+SurfaceInterceptor::Record* SurfaceInterceptor::createInitialDisplayStateRecord(
+        const DisplayDeviceState& display)
+{
+    Record* record(new Record(Record::Type::TRANSACTION));
+    record->synchronous = false;
+    record->animation = false;
+
+    DisplayChangeRecord change;
+    change.displayId = display.displayId;
+    change.what = DisplayState::eSurfaceChanged | DisplayState::eLayerStackChanged |
+            DisplayState::eDisplaySizeChanged | DisplayState::eDisplayProjectionChanged;
+    change.surface = display.surface;
+    change.layerStack = display.layerStack;
+    change.w = display.width;
+    change.h = display.height;
+    change.orientation = display.orientation;
+    change.viewport = display.viewport;
+    change.frame = display.frame;
+    record->displayChanges.push_back(std::move(change));
+    return record;
+}
+
 const sp<const Layer> SurfaceInterceptor::getLayer(const wp<const IBinder>& weakHandle) {
     const sp<const IBinder>& handle(weakHandle.promote());
     const auto layerHandle(static_cast<const Layer::Handle*>(handle.get()));
@@ -162,13 +266,139 @@ int32_t SurfaceInterceptor::getLayerId(const sp<const Layer>& layer) {
     return layer->sequence;
 }
 
-Increment* SurfaceInterceptor::createTraceIncrementLocked() {
-    Increment* increment(mTrace.add_increment());
-    increment->set_time_stamp(systemTime());
-    return increment;
+SurfaceInterceptor::Record* SurfaceInterceptor::createSurfaceCreationRecord(
+        const sp<const Layer>& layer)
+{
+    Record* record(new Record(Record::Type::SURFACE_CREATION));
+    record->id = getLayerId(layer);
+    record->name = getLayerName(layer);
+    record->w = layer->mCurrentState.active.w;
+    record->h = layer->mCurrentState.active.h;
+    return record;
+}
+
+SurfaceInterceptor::Record* SurfaceInterceptor::createDisplayCreationRecord(
+        const DisplayDeviceState& info)
+{
+    Record* record(new Record(Record::Type::DISPLAY_CREATION));
+    record->id = info.displayId;
+    record->name = info.displayName.string();
+    record->mode = info.type;
+    record->isSecure = info.isSecure;
+    return record;
+}
+
+bool SurfaceInterceptor::addSurfaceChangeRecord(Record* record, const layer_state_t& state) {
+    const sp<const Layer> layer(getLayer(state.surface));
+    if (layer == nullptr) {
+        ALOGE("An existing layer could not be retrieved with the surface "
+                "from the layer_state_t surface in the update transaction");
+        return false;
+    }
+
+    SurfaceChangeRecord change;
+    change.layerId = getLayerId(layer);
+    change.what = state.what;
+    change.x = state.x;
+    change.y = state.y;
+    change.z = state.z;
+    change.w = state.w;
+    change.h = state.h;
+    change.alpha = state.alpha;
+    change.matrix = state.matrix;
+    if (state.what & layer_state_t::eTransparentRegionChanged) {
+        change.transparentRegion = state.transparentRegion;
+    }
+    change.flags = state.flags;
+    change.layerStack = state.layerStack;
+    change.crop = state.crop;
+    change.finalCrop = state.finalCrop;
+    change.overrideScalingMode = state.overrideScalingMode;
+    if (state.what & layer_state_t::eDeferTransaction) {
+        // The barrier is resolved here since it needs SurfaceFlinger's state
+        sp<Layer> otherLayer = nullptr;
+        if (state.barrierHandle != nullptr) {
+            otherLayer = static_cast<Layer::Handle*>(state.barrierHandle.get())->owner.promote();
+        } else if (state.barrierGbp != nullptr) {
+            auto const& gbp = state.barrierGbp;
+            if (mFlinger->authenticateSurfaceTextureLocked(gbp)) {
+                otherLayer = (static_cast<MonitoredProducer*>(gbp.get()))->getLayer();
+            } else {
+                ALOGE("Attempt to defer transaction to to an unrecognized GraphicBufferProducer");
+            }
+        }
+        change.hasBarrierLayer = otherLayer != nullptr;
+        change.barrierLayerId = otherLayer != nullptr ? getLayerId(otherLayer) : -1;
+        change.frameNumber = state.frameNumber;
+    }
+    record->surfaceChanges.push_back(std::move(change));
+    return true;
+}
+
+void SurfaceInterceptor::addIncrement(Increment* increment, const Record& record) {
+    increment->set_time_stamp(record.timestamp);
+    switch (record.type) {
+        case Record::Type::TRANSACTION: {
+            Transaction* transaction(increment->mutable_transaction());
+            transaction->set_synchronous(record.synchronous);
+            transaction->set_animation(record.animation);
+            for (const auto& change : record.surfaceChanges) {
+                addSurfaceChanges(transaction, change);
+            }
+            for (const auto& change : record.displayChanges) {
+                addDisplayChanges(transaction, change);
+            }
+            break;
+        }
+        case Record::Type::SURFACE_CREATION: {
+            SurfaceCreation* creation(increment->mutable_surface_creation());
+            creation->set_id(record.id);
+            creation->set_name(record.name);
+            creation->set_w(record.w);
+            creation->set_h(record.h);
+            break;
+        }
+        case Record::Type::SURFACE_DELETION: {
+            SurfaceDeletion* deletion(increment->mutable_surface_deletion());
+            deletion->set_id(record.id);
+            break;
+        }
+        case Record::Type::BUFFER_UPDATE: {
+            BufferUpdate* update(increment->mutable_buffer_update());
+            update->set_id(record.id);
+            update->set_w(record.w);
+            update->set_h(record.h);
+            update->set_frame_number(record.frameNumber);
+            break;
+        }
+        case Record::Type::VSYNC_EVENT: {
+            VSyncEvent* event(increment->mutable_vsync_event());
+            event->set_when(record.vsyncTimestamp);
+            break;
+        }
+        case Record::Type::DISPLAY_CREATION: {
+            DisplayCreation* creation(increment->mutable_display_creation());
+            creation->set_id(record.id);
+            creation->set_name(record.name);
+            creation->set_type(record.mode);
+            creation->set_is_secure(record.isSecure);
+            break;
+        }
+        case Record::Type::DISPLAY_DELETION: {
+            DisplayDeletion* deletion(increment->mutable_display_deletion());
+            deletion->set_id(record.id);
+            break;
+        }
+        case Record::Type::POWER_MODE_UPDATE: {
+            PowerModeUpdate* powerModeUpdate(increment->mutable_power_mode_update());
+            powerModeUpdate->set_id(record.id);
+            powerModeUpdate->set_mode(record.mode);
+            break;
+        }
+    }
 }
 
-SurfaceChange* SurfaceInterceptor::createSurfaceChangeLocked(Transaction* transaction,
+SurfaceChange* SurfaceInterceptor::createSurfaceChange(Transaction* transaction,
         int32_t layerId)
 {
     SurfaceChange* change(transaction->add_surface_change());
@@ -176,7 +406,7 @@ SurfaceChange* SurfaceInterceptor::createSurfaceChangeLocked(Transaction* transa
     return change;
 }
 
-DisplayChange* SurfaceInterceptor::createDisplayChangeLocked(Transaction* transaction,
+DisplayChange* SurfaceInterceptor::createDisplayChange(Transaction* transaction,
         int32_t displayId)
 {
     DisplayChange* dispChange(transaction->add_display_change());
@@ -184,51 +414,51 @@ DisplayChange* SurfaceInterceptor::createDisplayChangeLocked(Transaction* transa
     return dispChange;
 }
 
-void SurfaceInterceptor::setProtoRectLocked(Rectangle* protoRect, const Rect& rect) {
+void SurfaceInterceptor::setProtoRect(Rectangle* protoRect, const Rect& rect) {
     protoRect->set_left(rect.left);
     protoRect->set_top(rect.top);
     protoRect->set_right(rect.right);
     protoRect->set_bottom(rect.bottom);
 }
 
-void SurfaceInterceptor::addPositionLocked(Transaction* transaction, int32_t layerId,
+void SurfaceInterceptor::addPosition(Transaction* transaction, int32_t layerId,
         float x, float y)
 {
-    SurfaceChange* change(createSurfaceChangeLocked(transaction, layerId));
+    SurfaceChange* change(createSurfaceChange(transaction, layerId));
     PositionChange* posChange(change->mutable_position());
     posChange->set_x(x);
     posChange->set_y(y);
 }
 
-void SurfaceInterceptor::addDepthLocked(Transaction* transaction, int32_t layerId,
+void SurfaceInterceptor::addDepth(Transaction* transaction, int32_t layerId,
         uint32_t z)
 {
-    SurfaceChange* change(createSurfaceChangeLocked(transaction, layerId));
+    SurfaceChange* change(createSurfaceChange(transaction, layerId));
     LayerChange* depthChange(change->mutable_layer());
     depthChange->set_layer(z);
 }
 
-void SurfaceInterceptor::addSizeLocked(Transaction* transaction, int32_t layerId, uint32_t w,
+void SurfaceInterceptor::addSize(Transaction* transaction, int32_t layerId, uint32_t w,
         uint32_t h)
 {
-    SurfaceChange* change(createSurfaceChangeLocked(transaction, layerId));
+    SurfaceChange* change(createSurfaceChange(transaction, layerId));
     SizeChange* sizeChange(change->mutable_size());
     sizeChange->set_w(w);
     sizeChange->set_h(h);
 }
 
-void SurfaceInterceptor::addAlphaLocked(Transaction* transaction, int32_t layerId,
+void SurfaceInterceptor::addAlpha(Transaction* transaction, int32_t layerId,
         float alpha)
 {
-    SurfaceChange* change(createSurfaceChangeLocked(transaction, layerId));
+    SurfaceChange* change(createSurfaceChange(transaction, layerId));
     AlphaChange* alphaChange(change->mutable_alpha());
     alphaChange->set_alpha(alpha);
 }
 
-void SurfaceInterceptor::addMatrixLocked(Transaction* transaction, int32_t layerId,
+void SurfaceInterceptor::addMatrix(Transaction* transaction, int32_t layerId,
         const layer_state_t::matrix22_t& matrix)
 {
-    SurfaceChange* change(createSurfaceChangeLocked(transaction, layerId));
+    SurfaceChange* change(createSurfaceChange(transaction, layerId));
     MatrixChange* matrixChange(change->mutable_matrix());
     matrixChange->set_dsdx(matrix.dsdx);
     matrixChange->set_dtdx(matrix.dtdx);
@@ -236,219 +466,151 @@ void SurfaceInterceptor::addMatrixLocked(Transaction* transaction, int32_t layer
     matrixChange->set_dtdy(matrix.dtdy);
 }
 
-void SurfaceInterceptor::addTransparentRegionLocked(Transaction* transaction,
+void SurfaceInterceptor::addTransparentRegion(Transaction* transaction,
         int32_t layerId, const Region& transRegion)
 {
-    SurfaceChange* change(createSurfaceChangeLocked(transaction, layerId));
+    SurfaceChange* change(createSurfaceChange(transaction, layerId));
     TransparentRegionHintChange* transparentChange(change->mutable_transparent_region_hint());
 
     for (const auto& rect : transRegion) {
         Rectangle* protoRect(transparentChange->add_region());
-        setProtoRectLocked(protoRect, rect);
+        setProtoRect(protoRect, rect);
     }
 }
 
-void SurfaceInterceptor::addFlagsLocked(Transaction* transaction, int32_t layerId,
+void SurfaceInterceptor::addFlags(Transaction* transaction, int32_t layerId,
         uint8_t flags)
 {
     // There can be multiple flags changed
     if (flags & layer_state_t::eLayerHidden) {
-        SurfaceChange* change(createSurfaceChangeLocked(transaction, layerId));
+        SurfaceChange* change(createSurfaceChange(transaction, layerId));
         HiddenFlagChange* flagChange(change->mutable_hidden_flag());
         flagChange->set_hidden_flag(true);
     }
     if (flags & layer_state_t::eLayerOpaque) {
-        SurfaceChange* change(createSurfaceChangeLocked(transaction, layerId));
+        SurfaceChange* change(createSurfaceChange(transaction, layerId));
         OpaqueFlagChange* flagChange(change->mutable_opaque_flag());
         flagChange->set_opaque_flag(true);
     }
     if (flags & layer_state_t::eLayerSecure) {
-        SurfaceChange* change(createSurfaceChangeLocked(transaction, layerId));
+        SurfaceChange* change(createSurfaceChange(transaction, layerId));
         SecureFlagChange* flagChange(change->mutable_secure_flag());
         flagChange->set_secure_flag(true);
     }
 }
 
-void SurfaceInterceptor::addLayerStackLocked(Transaction* transaction, int32_t layerId,
+void SurfaceInterceptor::addLayerStack(Transaction* transaction, int32_t layerId,
         uint32_t layerStack)
 {
-    SurfaceChange* change(createSurfaceChangeLocked(transaction, layerId));
+    SurfaceChange* change(createSurfaceChange(transaction, layerId));
     LayerStackChange* layerStackChange(change->mutable_layer_stack());
     layerStackChange->set_layer_stack(layerStack);
 }
 
-void SurfaceInterceptor::addCropLocked(Transaction* transaction, int32_t layerId,
+void SurfaceInterceptor::addCrop(Transaction* transaction, int32_t layerId,
         const Rect& rect)
 {
-    SurfaceChange* change(createSurfaceChangeLocked(transaction, layerId));
+    SurfaceChange* change(createSurfaceChange(transaction, layerId));
     CropChange* cropChange(change->mutable_crop());
     Rectangle* protoRect(cropChange->mutable_rectangle());
-    setProtoRectLocked(protoRect, rect);
+    setProtoRect(protoRect, rect);
 }
 
-void SurfaceInterceptor::addFinalCropLocked(Transaction* transaction, int32_t layerId,
+void SurfaceInterceptor::addFinalCrop(Transaction* transaction, int32_t layerId,
         const Rect& rect)
 {
-    SurfaceChange* change(createSurfaceChangeLocked(transaction, layerId));
+    SurfaceChange* change(createSurfaceChange(transaction, layerId));
     FinalCropChange* finalCropChange(change->mutable_final_crop());
     Rectangle* protoRect(finalCropChange->mutable_rectangle());
-    setProtoRectLocked(protoRect, rect);
+    setProtoRect(protoRect, rect);
 }
 
-void SurfaceInterceptor::addDeferTransactionLocked(Transaction* transaction, int32_t layerId,
-        const sp<const Layer>& layer, uint64_t frameNumber)
+void SurfaceInterceptor::addDeferTransaction(Transaction* transaction, int32_t layerId,
+        const SurfaceChangeRecord& record)
 {
-    SurfaceChange* change(createSurfaceChangeLocked(transaction, layerId));
-    if (layer == nullptr) {
+    SurfaceChange* change(createSurfaceChange(transaction, layerId));
+    if (!record.hasBarrierLayer) {
         ALOGE("An existing layer could not be retrieved with the handle"
                 " for the deferred transaction");
         return;
     }
     DeferredTransactionChange* deferTransaction(change->mutable_deferred_transaction());
-    deferTransaction->set_layer_id(getLayerId(layer));
-    deferTransaction->set_frame_number(frameNumber);
+    deferTransaction->set_layer_id(record.barrierLayerId);
+    deferTransaction->set_frame_number(record.frameNumber);
 }
 
-void SurfaceInterceptor::addOverrideScalingModeLocked(Transaction* transaction,
+void SurfaceInterceptor::addOverrideScalingMode(Transaction* transaction,
         int32_t layerId, int32_t overrideScalingMode)
 {
-    SurfaceChange* change(createSurfaceChangeLocked(transaction, layerId));
+    SurfaceChange* change(createSurfaceChange(transaction, layerId));
     OverrideScalingModeChange* overrideChange(change->mutable_override_scaling_mode());
     overrideChange->set_override_scaling_mode(overrideScalingMode);
 }
 
-void SurfaceInterceptor::addSurfaceChangesLocked(Transaction* transaction,
-        const layer_state_t& state)
+void SurfaceInterceptor::addSurfaceChanges(Transaction* transaction,
+        const SurfaceChangeRecord& change)
 {
-    const sp<const Layer> layer(getLayer(state.surface));
-    if (layer == nullptr) {
-        ALOGE("An existing layer could not be retrieved with the surface "
-                "from the layer_state_t surface in the update transaction");
-        return;
-    }
-
-    const int32_t layerId(getLayerId(layer));
+    const int32_t layerId(change.layerId);
 
-    if (state.what & layer_state_t::ePositionChanged) {
-        addPositionLocked(transaction, layerId, state.x, state.y);
+    if (change.what & layer_state_t::ePositionChanged) {
+        addPosition(transaction, layerId, change.x, change.y);
     }
-    if (state.what & layer_state_t::eLayerChanged) {
-        addDepthLocked(transaction, layerId, state.z);
+    if (change.what & layer_state_t::eLayerChanged) {
+        addDepth(transaction, layerId, change.z);
     }
-    if (state.what & layer_state_t::eSizeChanged) {
-        addSizeLocked(transaction, layerId, state.w, state.h);
+    if (change.what & layer_state_t::eSizeChanged) {
+        addSize(transaction, layerId, change.w, change.h);
     }
-    if (state.what & layer_state_t::eAlphaChanged) {
-        addAlphaLocked(transaction, layerId, state.alpha);
+    if (change.what & layer_state_t::eAlphaChanged) {
+        addAlpha(transaction, layerId, change.alpha);
     }
-    if (state.what & layer_state_t::eMatrixChanged) {
-        addMatrixLocked(transaction, layerId, state.matrix);
+    if (change.what & layer_state_t::eMatrixChanged) {
+        addMatrix(transaction, layerId, change.matrix);
     }
-    if (state.what & layer_state_t::eTransparentRegionChanged) {
-        addTransparentRegionLocked(transaction, layerId, state.transparentRegion);
+    if (change.what & layer_state_t::eTransparentRegionChanged) {
+        addTransparentRegion(transaction, layerId, change.transparentRegion);
     }
-    if (state.what & layer_state_t::eFlagsChanged) {
-        addFlagsLocked(transaction, layerId, state.flags);
+    if (change.what & layer_state_t::eFlagsChanged) {
+        addFlags(transaction, layerId, change.flags);
     }
-    if (state.what & layer_state_t::eLayerStackChanged) {
-        addLayerStackLocked(transaction, layerId, state.layerStack);
+    if (change.what & layer_state_t::eLayerStackChanged) {
+        addLayerStack(transaction, layerId, change.layerStack);
     }
-    if (state.what & layer_state_t::eCropChanged) {
-        addCropLocked(transaction, layerId, state.crop);
+    if (change.what & layer_state_t::eCropChanged) {
+        addCrop(transaction, layerId, change.crop);
     }
-    if (state.what & layer_state_t::eDeferTransaction) {
-        sp<Layer> otherLayer = nullptr;
-        if (state.barrierHandle != nullptr) {
-            otherLayer = static_cast<Layer::Handle*>(state.barrierHandle.get())->owner.promote();
-        } else if (state.barrierGbp != nullptr) {
-            auto const& gbp = state.barrierGbp;
-            if (mFlinger->authenticateSurfaceTextureLocked(gbp)) {
-                otherLayer = (static_cast<MonitoredProducer*>(gbp.get()))->getLayer();
-            } else {
-                ALOGE("Attempt to defer transaction to to an unrecognized GraphicBufferProducer");
-            }
-        }
-        addDeferTransactionLocked(transaction, layerId, otherLayer, state.frameNumber);
+    if (change.what & layer_state_t::eDeferTransaction) {
+        addDeferTransaction(transaction, layerId, change);
     }
-    if (state.what & layer_state_t::eFinalCropChanged) {
-        addFinalCropLocked(transaction, layerId, state.finalCrop);
+    if (change.what & layer_state_t::eFinalCropChanged) {
+        addFinalCrop(transaction, layerId, change.finalCrop);
     }
-    if (state.what & layer_state_t::eOverrideScalingModeChanged) {
-        addOverrideScalingModeLocked(transaction, layerId, state.overrideScalingMode);
+    if (change.what & layer_state_t::eOverrideScalingModeChanged) {
+        addOverrideScalingMode(transaction, layerId, change.overrideScalingMode);
     }
 }
 
-void SurfaceInterceptor::addDisplayChangesLocked(Transaction* transaction,
-        const DisplayState& state, int32_t displayId)
+void SurfaceInterceptor::addDisplayChanges(Transaction* transaction,
+        const DisplayChangeRecord& change)
 {
-    if (state.what & DisplayState::eSurfaceChanged) {
-        addDisplaySurfaceLocked(transaction, displayId, state.surface);
-    }
-    if (state.what & DisplayState::eLayerStackChanged) {
-        addDisplayLayerStackLocked(transaction, displayId, state.layerStack);
-    }
-    if (state.what & DisplayState::eDisplaySizeChanged) {
-        addDisplaySizeLocked(transaction, displayId, state.width, state.height);
+    const int32_t displayId(change.displayId);
+
+    if (change.what & DisplayState::eSurfaceChanged) {
+        addDisplaySurface(transaction, displayId, change.surface);
     }
-    if (state.what & DisplayState::eDisplayProjectionChanged) {
-        addDisplayProjectionLocked(transaction, displayId, state.orientation, state.viewport,
-                state.frame);
+    if (change.what & DisplayState::eLayerStackChanged) {
+        addDisplayLayerStack(transaction, displayId, change.layerStack);
     }
-}
-
-void SurfaceInterceptor::addTransactionLocked(Increment* increment,
-        const Vector<ComposerState>& stateUpdates,
-        const DefaultKeyedVector< wp<IBinder>, DisplayDeviceState>& displays,
-        const Vector<DisplayState>& changedDisplays, uint32_t transactionFlags)
-{
-    Transaction* transaction(increment->mutable_transaction());
-    transaction->set_synchronous(transactionFlags & BnSurfaceComposer::eSynchronous);
-    transaction->set_animation(transactionFlags & BnSurfaceComposer::eAnimation);
-    for (const auto& compState: stateUpdates) {
-        addSurfaceChangesLocked(transaction, compState.state);
+    if (change.what & DisplayState::eDisplaySizeChanged) {
+        addDisplaySize(transaction, displayId, change.w, change.h);
     }
-    for (const auto& disp: changedDisplays) {
-        ssize_t dpyIdx = displays.indexOfKey(disp.token);
-        if (dpyIdx >= 0) {
-            const DisplayDeviceState& dispState(displays.valueAt(dpyIdx));
-            addDisplayChangesLocked(transaction, disp, dispState.displayId);
-        }
+    if (change.what & DisplayState::eDisplayProjectionChanged) {
+        addDisplayProjection(transaction, displayId, change.orientation, change.viewport,
+                change.frame);
     }
 }
 
-void SurfaceInterceptor::addSurfaceCreationLocked(Increment* increment,
-        const sp<const Layer>& layer)
-{
-    SurfaceCreation* creation(increment->mutable_surface_creation());
-    creation->set_id(getLayerId(layer));
-    creation->set_name(getLayerName(layer));
-    creation->set_w(layer->mCurrentState.active.w);
-    creation->set_h(layer->mCurrentState.active.h);
-}
-
-void SurfaceInterceptor::addSurfaceDeletionLocked(Increment* increment,
-        const sp<const Layer>& layer)
-{
-    SurfaceDeletion* deletion(increment->mutable_surface_deletion());
-    deletion->set_id(getLayerId(layer));
-}
-
-void SurfaceInterceptor::addBufferUpdateLocked(Increment* increment, const sp<const Layer>& layer,
-        uint32_t width, uint32_t height, uint64_t frameNumber)
-{
-    BufferUpdate* update(increment->mutable_buffer_update());
-    update->set_id(getLayerId(layer));
-    update->set_w(width);
-    update->set_h(height);
-    update->set_frame_number(frameNumber);
-}
-
-void SurfaceInterceptor::addVSyncUpdateLocked(Increment* increment, nsecs_t timestamp) {
-    VSyncEvent* event(increment->mutable_vsync_event());
-    event->set_when(timestamp);
-}
-
-void SurfaceInterceptor::addDisplaySurfaceLocked(Transaction* transaction, int32_t displayId,
+void SurfaceInterceptor::addDisplaySurface(Transaction* transaction, int32_t displayId,
         const sp<const IGraphicBufferProducer>& surface)
 {
     if (surface == nullptr) {
@@ -457,7 +619,7 @@ void SurfaceInterceptor::addDisplaySurfaceLocked(Transaction* transaction, int32
     uint64_t bufferQueueId = 0;
     status_t err(surface->getUniqueId(&bufferQueueId));
     if (err == NO_ERROR) {
-        DisplayChange* dispChange(createDisplayChangeLocked(transaction, displayId));
+        DisplayChange* dispChange(createDisplayChange(transaction, displayId));
         DispSurfaceChange* surfaceChange(dispChange->mutable_surface());
         surfaceChange->set_buffer_queue_id(bufferQueueId);
         surfaceChange->set_buffer_queue_name(surface->getConsumerName().string());
@@ -468,56 +630,33 @@ void SurfaceInterceptor::addDisplaySurfaceLocked(Transaction* transaction, int32
     }
 }
 
-void SurfaceInterceptor::addDisplayLayerStackLocked(Transaction* transaction,
+void SurfaceInterceptor::addDisplayLayerStack(Transaction* transaction,
         int32_t displayId, uint32_t layerStack)
 {
-    DisplayChange* dispChange(createDisplayChangeLocked(transaction, displayId));
+    DisplayChange* dispChange(createDisplayChange(transaction, displayId));
     LayerStackChange* layerStackChange(dispChange->mutable_layer_stack());
     layerStackChange->set_layer_stack(layerStack);
 }
 
-void SurfaceInterceptor::addDisplaySizeLocked(Transaction* transaction, int32_t displayId,
+void SurfaceInterceptor::addDisplaySize(Transaction* transaction, int32_t displayId,
         uint32_t w, uint32_t h)
 {
-    DisplayChange* dispChange(createDisplayChangeLocked(transaction, displayId));
+    DisplayChange* dispChange(createDisplayChange(transaction, displayId));
     SizeChange* sizeChange(dispChange->mutable_size());
     sizeChange->set_w(w);
     sizeChange->set_h(h);
 }
 
-void SurfaceInterceptor::addDisplayProjectionLocked(Transaction* transaction,
+void SurfaceInterceptor::addDisplayProjection(Transaction* transaction,
         int32_t displayId, int32_t orientation, const Rect& viewport, const Rect& frame)
 {
-    DisplayChange* dispChange(createDisplayChangeLocked(transaction, displayId));
+    DisplayChange* dispChange(createDisplayChange(transaction, displayId));
     ProjectionChange* projectionChange(dispChange->mutable_projection());
     projectionChange->set_orientation(orientation);
     Rectangle* viewportRect(projectionChange->mutable_viewport());
-    setProtoRectLocked(viewportRect, viewport);
+    setProtoRect(viewportRect, viewport);
     Rectangle* frameRect(projectionChange->mutable_frame());
-    setProtoRectLocked(frameRect, frame);
-}
-
-void SurfaceInterceptor::addDisplayCreationLocked(Increment* increment,
-        const DisplayDeviceState& info)
-{
-    DisplayCreation* creation(increment->mutable_display_creation());
-    creation->set_id(info.displayId);
-    creation->set_name(info.displayName);
-    creation->set_type(info.type);
-    creation->set_is_secure(info.isSecure);
-}
-
-void SurfaceInterceptor::addDisplayDeletionLocked(Increment* increment, int32_t displayId) {
-    DisplayDeletion* deletion(increment->mutable_display_deletion());
-    deletion->set_id(displayId);
-}
-
-void SurfaceInterceptor::addPowerModeUpdateLocked(Increment* increment, int32_t displayId,
-        int32_t mode)
-{
-    PowerModeUpdate* powerModeUpdate(increment->mutable_power_mode_update());
-    powerModeUpdate->set_id(displayId);
-    powerModeUpdate->set_mode(mode);
+    setProtoRect(frameRect, frame);
 }
 
 void SurfaceInterceptor::saveTransaction(const Vector<ComposerState>& stateUpdates,
@@ -528,9 +667,31 @@ void SurfaceInterceptor::saveTransaction(const Vector<ComposerState>& stateUpdat
         return;
     }
     ATRACE_CALL();
-    std::lock_guard<std::mutex> protoGuard(mTraceMutex);
-    addTransactionLocked(createTraceIncrementLocked(), stateUpdates, displays, changedDisplays,
-            flags);
+    Record* record(new Record(Record::Type::TRANSACTION));
+    record->synchronous = flags & BnSurfaceComposer::eSynchronous;
+    record->animation = flags & BnSurfaceComposer::eAnimation;
+    record->surfaceChanges.reserve(stateUpdates.size());
+    for (const auto& compState : stateUpdates) {
+        addSurfaceChangeRecord(record, compState.state);
+    }
+    for (const auto& disp : changedDisplays) {
+        ssize_t dpyIdx = displays.indexOfKey(disp.token);
+        if (dpyIdx < 0) {
+            continue;
+        }
+        DisplayChangeRecord change;
+        change.displayId = displays.valueAt(dpyIdx).displayId;
+        change.what = disp.what;
+        change.surface = disp.surface;
+        change.layerStack = disp.layerStack;
+        change.w = disp.width;
+        change.h = disp.height;
+        change.orientation = disp.orientation;
+        change.viewport = disp.viewport;
+        change.frame = disp.frame;
+        record->displayChanges.push_back(std::move(change));
+    }
+    pushRecord(record);
 }
 
 void SurfaceInterceptor::saveSurfaceCreation(const sp<const Layer>& layer) {
@@ -538,8 +699,7 @@ void SurfaceInterceptor::saveSurfaceCreation(const sp<const Layer>& layer) {
         return;
     }
     ATRACE_CALL();
-    std::lock_guard<std::mutex> protoGuard(mTraceMutex);
-    addSurfaceCreationLocked(createTraceIncrementLocked(), layer);
+    pushRecord(createSurfaceCreationRecord(layer));
 }
 
 void SurfaceInterceptor::saveSurfaceDeletion(const sp<const Layer>& layer) {
@@ -547,8 +707,9 @@ void SurfaceInterceptor::saveSurfaceDeletion(const sp<const Layer>& layer) {
         return;
     }
     ATRACE_CALL();
-    std::lock_guard<std::mutex> protoGuard(mTraceMutex);
-    addSurfaceDeletionLocked(createTraceIncrementLocked(), layer);
+    Record* record(new Record(Record::Type::SURFACE_DELETION));
+    record->id = getLayerId(layer);
+    pushRecord(record);
 }
 
 void SurfaceInterceptor::saveBufferUpdate(const sp<const Layer>& layer, uint32_t width,
@@ -558,16 +719,21 @@ void SurfaceInterceptor::saveBufferUpdate(const sp<const Layer>& layer, uint32_t
         return;
     }
     ATRACE_CALL();
-    std::lock_guard<std::mutex> protoGuard(mTraceMutex);
-    addBufferUpdateLocked(createTraceIncrementLocked(), layer, width, height, frameNumber);
+    Record* record(new Record(Record::Type::BUFFER_UPDATE));
+    record->id = getLayerId(layer);
+    record->w = width;
+    record->h = height;
+    record->frameNumber = frameNumber;
+    pushRecord(record);
 }
 
 void SurfaceInterceptor::saveVSyncEvent(nsecs_t timestamp) {
     if (!mEnabled) {
         return;
     }
-    std::lock_guard<std::mutex> protoGuard(mTraceMutex);
-    addVSyncUpdateLocked(createTraceIncrementLocked(), timestamp);
+    Record* record(new Record(Record::Type::VSYNC_EVENT));
+    record->vsyncTimestamp = timestamp;
+    pushRecord(record);
 }
 
 void SurfaceInterceptor::saveDisplayCreation(const DisplayDeviceState& info) {
@@ -575,8 +741,7 @@ void SurfaceInterceptor::saveDisplayCreation(const DisplayDeviceState& info) {
         return;
     }
     ATRACE_CALL();
-    std::lock_guard<std::mutex> protoGuard(mTraceMutex);
-    addDisplayCreationLocked(createTraceIncrementLocked(), info);
+    pushRecord(createDisplayCreationRecord(info));
 }
 
 void SurfaceInterceptor::saveDisplayDeletion(int32_t displayId) {
@@ -584,8 +749,9 @@ void SurfaceInterceptor::saveDisplayDeletion(int32_t displayId) {
         return;
     }
     ATRACE_CALL();
-    std::lock_guard<std::mutex> protoGuard(mTraceMutex);
-    addDisplayDeletionLocked(createTraceIncrementLocked(), displayId);
+    Record* record(new Record(Record::Type::DISPLAY_DELETION));
+    record->id = displayId;
+    pushRecord(record);
 }
 
 void SurfaceInterceptor::savePowerModeUpdate(int32_t displayId, int32_t mode) {
@@ -593,8 +759,10 @@ void SurfaceInterceptor::savePowerModeUpdate(int32_t displayId, int32_t mode) {
         return;
     }
     ATRACE_CALL();
-    std::lock_guard<std::mutex> protoGuard(mTraceMutex);
-    addPowerModeUpdateLocked(createTraceIncrementLocked(), displayId, mode);
+    Record* record(new Record(Record::Type::POWER_MODE_UPDATE));
+    record->id = displayId;
+    record->mode = mode;
+    pushRecord(record);
 }
 
 } // namespace impl
@@ -18,8 +18,17 @@
 #define ANDROID_SURFACEINTERCEPTOR_H
 
 #include <frameworks/native/cmds/surfacereplayer/proto/src/trace.pb.h>
+#include <surfacereplayer/TraceCompaction.h>
 
+#include <atomic>
+#include <condition_variable>
+#include <fstream>
 #include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <android-base/thread_annotations.h>
 
 #include <gui/LayerState.h>
 
@@ -76,11 +85,16 @@ namespace impl {
 /*
  * SurfaceInterceptor intercepts and stores incoming streams of window
  * properties on SurfaceFlinger.
+ *
+ * The save* calls only stage a compact record; a worker thread converts the
+ * staged records to Increments and appends them to the trace file while the
+ * interceptor is enabled. The trace is written in the compact form, see
+ * TraceCompaction.h.
  */
 class SurfaceInterceptor final : public android::SurfaceInterceptor {
 public:
     explicit SurfaceInterceptor(SurfaceFlinger* const flinger);
-    ~SurfaceInterceptor() override = default;
+    ~SurfaceInterceptor() override;
 
     // Both vectors are used to capture the current state of SF as the initial snapshot in the trace
     void enable(const SortedVector<sp<Layer>>& layers,
@@ -106,73 +120,148 @@ public:
     void saveVSyncEvent(nsecs_t timestamp) override;
 
 private:
+    // Compact copies of the traced state. They are filled in on the calling thread, which only has
+    // to resolve layer handles, and turned into Increments by the worker thread.
+    struct SurfaceChangeRecord {
+        int32_t layerId = -1;
+        uint32_t what = 0;
+        float x = 0;
+        float y = 0;
+        uint32_t z = 0;
+        uint32_t w = 0;
+        uint32_t h = 0;
+        float alpha = 0;
+        layer_state_t::matrix22_t matrix;
+        Region transparentRegion;
+        uint8_t flags = 0;
+        uint32_t layerStack = 0;
+        Rect crop;
+        Rect finalCrop;
+        bool hasBarrierLayer = false;
+        int32_t barrierLayerId = -1;
+        uint64_t frameNumber = 0;
+        int32_t overrideScalingMode = -1;
+    };
+
+    struct DisplayChangeRecord {
+        int32_t displayId = -1;
+        uint32_t what = 0;
+        // Querying the surface may be an IPC, so it is only done on the worker thread
+        sp<IGraphicBufferProducer> surface;
+        uint32_t layerStack = 0;
+        uint32_t w = 0;
+        uint32_t h = 0;
+        int32_t orientation = 0;
+        Rect viewport;
+        Rect frame;
+    };
+
+    struct Record {
+        enum class Type {
+            TRANSACTION,
+            SURFACE_CREATION,
+            SURFACE_DELETION,
+            BUFFER_UPDATE,
+            VSYNC_EVENT,
+            DISPLAY_CREATION,
+            DISPLAY_DELETION,
+            POWER_MODE_UPDATE,
+        };
+
+        explicit Record(Type type) : type(type), timestamp(systemTime()) {}
+
+        Type type;
+        nsecs_t timestamp;
+        // Layer or display id
+        int32_t id = -1;
+        std::string name;
+        uint32_t w = 0;
+        uint32_t h = 0;
+        uint64_t frameNumber = 0;
+        nsecs_t vsyncTimestamp = 0;
+        // Display type for creations, power mode for updates
+        int32_t mode = 0;
+        bool isSecure = false;
+        bool synchronous = false;
+        bool animation = false;
+        std::vector<SurfaceChangeRecord> surfaceChanges;
+        std::vector<DisplayChangeRecord> displayChanges;
+
+        // Link in the staging list
+        Record* next = nullptr;
+    };
+
+    // The staging list is a lock-free stack, so saving a record never blocks the caller. The
+    // worker takes the whole list at once and reverses it back into arrival order.
+    void pushRecord(Record* record);
+    Record* takeRecords();
+    void deleteRecords(Record* records);
+
+    void threadMain();
+    status_t writeRecords(Record* records);
+
     // The creation increments of Surfaces and Displays do not contain enough information to capture
     // the initial state of each object, so a transaction with all of the missing properties is
     // performed at the initial snapshot for each display and surface.
-    void saveExistingDisplaysLocked(
-            const DefaultKeyedVector< wp<IBinder>, DisplayDeviceState>& displays);
-    void saveExistingSurfacesLocked(const SortedVector<sp<Layer>>& layers);
-    void addInitialSurfaceStateLocked(Increment* increment, const sp<const Layer>& layer);
-    void addInitialDisplayStateLocked(Increment* increment, const DisplayDeviceState& display);
+    void saveExistingDisplays(const DefaultKeyedVector<wp<IBinder>, DisplayDeviceState>& displays);
+    void saveExistingSurfaces(const SortedVector<sp<Layer>>& layers);
+    Record* createInitialSurfaceStateRecord(const sp<const Layer>& layer);
+    Record* createInitialDisplayStateRecord(const DisplayDeviceState& display);
 
-    status_t writeProtoFileLocked();
     const sp<const Layer> getLayer(const wp<const IBinder>& weakHandle);
     const std::string getLayerName(const sp<const Layer>& layer);
     int32_t getLayerId(const sp<const Layer>& layer);
 
-    Increment* createTraceIncrementLocked();
-    void addSurfaceCreationLocked(Increment* increment, const sp<const Layer>& layer);
-    void addSurfaceDeletionLocked(Increment* increment, const sp<const Layer>& layer);
-    void addBufferUpdateLocked(Increment* increment, const sp<const Layer>& layer, uint32_t width,
-            uint32_t height, uint64_t frameNumber);
-    void addVSyncUpdateLocked(Increment* increment, nsecs_t timestamp);
-    void addDisplayCreationLocked(Increment* increment, const DisplayDeviceState& info);
-    void addDisplayDeletionLocked(Increment* increment, int32_t displayId);
-    void addPowerModeUpdateLocked(Increment* increment, int32_t displayId, int32_t mode);
+    Record* createSurfaceCreationRecord(const sp<const Layer>& layer);
+    Record* createDisplayCreationRecord(const DisplayDeviceState& info);
+    bool addSurfaceChangeRecord(Record* record, const layer_state_t& state);
+    void addIncrement(Increment* increment, const Record& record);
 
     // Add surface transactions to the trace
-    SurfaceChange* createSurfaceChangeLocked(Transaction* transaction, int32_t layerId);
-    void setProtoRectLocked(Rectangle* protoRect, const Rect& rect);
-    void addPositionLocked(Transaction* transaction, int32_t layerId, float x, float y);
-    void addDepthLocked(Transaction* transaction, int32_t layerId, uint32_t z);
-    void addSizeLocked(Transaction* transaction, int32_t layerId, uint32_t w, uint32_t h);
-    void addAlphaLocked(Transaction* transaction, int32_t layerId, float alpha);
-    void addMatrixLocked(Transaction* transaction, int32_t layerId,
+    SurfaceChange* createSurfaceChange(Transaction* transaction, int32_t layerId);
+    void setProtoRect(Rectangle* protoRect, const Rect& rect);
+    void addPosition(Transaction* transaction, int32_t layerId, float x, float y);
+    void addDepth(Transaction* transaction, int32_t layerId, uint32_t z);
+    void addSize(Transaction* transaction, int32_t layerId, uint32_t w, uint32_t h);
+    void addAlpha(Transaction* transaction, int32_t layerId, float alpha);
+    void addMatrix(Transaction* transaction, int32_t layerId,
             const layer_state_t::matrix22_t& matrix);
-    void addTransparentRegionLocked(Transaction* transaction, int32_t layerId,
+    void addTransparentRegion(Transaction* transaction, int32_t layerId,
             const Region& transRegion);
-    void addFlagsLocked(Transaction* transaction, int32_t layerId, uint8_t flags);
-    void addLayerStackLocked(Transaction* transaction, int32_t layerId, uint32_t layerStack);
-    void addCropLocked(Transaction* transaction, int32_t layerId, const Rect& rect);
-    void addDeferTransactionLocked(Transaction* transaction, int32_t layerId,
-            const sp<const Layer>& layer, uint64_t frameNumber);
-    void addFinalCropLocked(Transaction* transaction, int32_t layerId, const Rect& rect);
-    void addOverrideScalingModeLocked(Transaction* transaction, int32_t layerId,
+    void addFlags(Transaction* transaction, int32_t layerId, uint8_t flags);
+    void addLayerStack(Transaction* transaction, int32_t layerId, uint32_t layerStack);
+    void addCrop(Transaction* transaction, int32_t layerId, const Rect& rect);
+    void addDeferTransaction(Transaction* transaction, int32_t layerId,
+            const SurfaceChangeRecord& change);
+    void addFinalCrop(Transaction* transaction, int32_t layerId, const Rect& rect);
+    void addOverrideScalingMode(Transaction* transaction, int32_t layerId,
             int32_t overrideScalingMode);
-    void addSurfaceChangesLocked(Transaction* transaction, const layer_state_t& state);
-    void addTransactionLocked(Increment* increment, const Vector<ComposerState>& stateUpdates,
-            const DefaultKeyedVector< wp<IBinder>, DisplayDeviceState>& displays,
-            const Vector<DisplayState>& changedDisplays, uint32_t transactionFlags);
+    void addSurfaceChanges(Transaction* transaction, const SurfaceChangeRecord& change);
 
     // Add display transactions to the trace
-    DisplayChange* createDisplayChangeLocked(Transaction* transaction, int32_t displayId);
-    void addDisplaySurfaceLocked(Transaction* transaction, int32_t displayId,
+    DisplayChange* createDisplayChange(Transaction* transaction, int32_t displayId);
+    void addDisplaySurface(Transaction* transaction, int32_t displayId,
             const sp<const IGraphicBufferProducer>& surface);
-    void addDisplayLayerStackLocked(Transaction* transaction, int32_t displayId,
-            uint32_t layerStack);
-    void addDisplaySizeLocked(Transaction* transaction, int32_t displayId, uint32_t w,
-            uint32_t h);
-    void addDisplayProjectionLocked(Transaction* transaction, int32_t displayId,
+    void addDisplayLayerStack(Transaction* transaction, int32_t displayId, uint32_t layerStack);
+    void addDisplaySize(Transaction* transaction, int32_t displayId, uint32_t w, uint32_t h);
+    void addDisplayProjection(Transaction* transaction, int32_t displayId,
             int32_t orientation, const Rect& viewport, const Rect& frame);
-    void addDisplayChangesLocked(Transaction* transaction,
-            const DisplayState& state, int32_t displayId);
-
+    void addDisplayChanges(Transaction* transaction, const DisplayChangeRecord& change);
 
-    bool mEnabled {false};
+    std::atomic<bool> mEnabled {false};
     std::string mOutputFileName {DEFAULT_FILENAME};
+    // Serializes enable() and disable(), which own the worker and the output file
     std::mutex mTraceMutex {};
-    Trace mTrace {};
+    std::ofstream mOutput;
+    // Only used by the worker
+    TraceCompactor mCompactor;
+    std::atomic<Record*> mRecords {nullptr};
     SurfaceFlinger* const mFlinger;
+
+    std::mutex mWorkerMutex;
+    std::condition_variable mWorkerCondition;
+    bool mStopWorker GUARDED_BY(mWorkerMutex) = false;
+    std::thread mWorker;
 };
 
 } // namespace impl
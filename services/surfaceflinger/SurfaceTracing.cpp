@@ -24,6 +24,8 @@
 #include <utils/SystemClock.h>
 #include <utils/Trace.h>
 
+#include <thread>
+
 namespace android {
 
 void SurfaceTracing::enable() {
@@ -38,11 +40,28 @@ void SurfaceTracing::enable() {
                             LayersTraceFileProto_MagicNumber_MAGIC_NUMBER_L);
 }
 
+void SurfaceTracing::enableRingBuffer() {
+    if (mEnabled) {
+        return;
+    }
+    ATRACE_CALL();
+    std::lock_guard<std::mutex> protoGuard(mTraceMutex);
+    mRingBuffer = true;
+    mEnabled = true;
+}
+
 status_t SurfaceTracing::disable() {
     if (!mEnabled) {
         return NO_ERROR;
     }
     ATRACE_CALL();
+    if (mRingBuffer) {
+        status_t err = flushRingBuffer();
+        std::lock_guard<std::mutex> protoGuard(mTraceMutex);
+        mEnabled = false;
+        mRingBuffer = false;
+        return err;
+    }
     std::lock_guard<std::mutex> protoGuard(mTraceMutex);
     mEnabled = false;
     status_t err(writeProtoFileLocked());
@@ -56,6 +75,106 @@ bool SurfaceTracing::isEnabled() {
     return mEnabled;
 }
 
+bool SurfaceTracing::isRingBufferEnabled() {
+    return mEnabled && mRingBuffer;
+}
+
+bool SurfaceTracing::needsFullEntry() {
+    std::lock_guard<std::mutex> protoGuard(mTraceMutex);
+    return mEntries.empty() || mEntriesSinceFull >= FULL_ENTRY_INTERVAL;
+}
+
+void SurfaceTracing::traceLayerChanges(const char* where, LayersProto changedLayers,
+                                       std::unordered_set<int32_t> layerIds, bool full) {
+    ATRACE_CALL();
+    std::lock_guard<std::mutex> protoGuard(mTraceMutex);
+
+    LayersTraceProto entry;
+    entry.set_elapsed_realtime_nanos(elapsedRealtimeNano());
+    entry.set_where(where);
+    entry.mutable_layers()->Swap(&changedLayers);
+    if (!full) {
+        entry.set_is_delta(true);
+        for (int32_t id : mTracedLayerIds) {
+            if (layerIds.count(id) == 0) {
+                entry.add_removed_layer_ids(id);
+            }
+        }
+        if (entry.layers().layers_size() == 0 && entry.removed_layer_ids_size() == 0) {
+            // nothing changed, nothing to record
+            return;
+        }
+    }
+    mTracedLayerIds = std::move(layerIds);
+    mEntriesSinceFull = full ? 0 : mEntriesSinceFull + 1;
+    addToRingBufferLocked(std::move(entry));
+}
+
+void SurfaceTracing::addToRingBufferLocked(LayersTraceProto&& entry) {
+    mEntriesSize += entry.ByteSize();
+    mEntries.push_back(std::move(entry));
+    while (mEntriesSize > RING_BUFFER_SIZE && mEntries.size() > 1) {
+        mEntriesSize -= mEntries.front().ByteSize();
+        mEntries.pop_front();
+    }
+}
+
+status_t SurfaceTracing::flushRingBuffer() {
+    ATRACE_CALL();
+    std::deque<LayersTraceProto> entries;
+    {
+        std::lock_guard<std::mutex> protoGuard(mTraceMutex);
+        entries.swap(mEntries);
+        mEntriesSize = 0;
+    }
+    status_t err = writeEntries(std::move(entries), mOutputFileName.c_str());
+    ALOGE_IF(err != NO_ERROR, "Could not save the layer trace ring buffer: %d", err);
+    return err;
+}
+
+void SurfaceTracing::onFrameMissed() {
+    std::deque<LayersTraceProto> entries;
+    {
+        std::lock_guard<std::mutex> protoGuard(mTraceMutex);
+        const nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+        if (!mRingBuffer || mEntries.empty() ||
+            (mLastJankFlushTime != 0 && now - mLastJankFlushTime < MIN_JANK_FLUSH_INTERVAL)) {
+            return;
+        }
+        ATRACE_CALL();
+        mLastJankFlushTime = now;
+        entries.swap(mEntries);
+        mEntriesSize = 0;
+    }
+    std::thread([entries = std::move(entries)]() mutable {
+        status_t err = writeEntries(std::move(entries), JANK_FILENAME);
+        ALOGE_IF(err != NO_ERROR, "Could not save the layer trace after a missed frame: %d", err);
+    }).detach();
+}
+
+status_t SurfaceTracing::writeEntries(std::deque<LayersTraceProto> entries, const char* fileName) {
+    // entries from before the first full one can't be interpreted
+    while (!entries.empty() && entries.front().is_delta()) {
+        entries.pop_front();
+    }
+
+    LayersTraceFileProto trace;
+    trace.set_magic_number(uint64_t(LayersTraceFileProto_MagicNumber_MAGIC_NUMBER_H) << 32 |
+                           LayersTraceFileProto_MagicNumber_MAGIC_NUMBER_L);
+    for (auto& entry : entries) {
+        trace.add_entry()->Swap(&entry);
+    }
+
+    std::string output;
+    if (!trace.SerializeToString(&output)) {
+        return PERMISSION_DENIED;
+    }
+    if (!android::base::WriteStringToFile(output, fileName, true)) {
+        return PERMISSION_DENIED;
+    }
+    return NO_ERROR;
+}
+
 void SurfaceTracing::traceLayers(const char* where, LayersProto layers) {
     std::lock_guard<std::mutex> protoGuard(mTraceMutex);
 
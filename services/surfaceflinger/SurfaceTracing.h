@@ -18,8 +18,12 @@
 
 #include <layerproto/LayerProtoHeader.h>
 #include <utils/Errors.h>
+#include <utils/Timers.h>
 
+#include <deque>
 #include <mutex>
+#include <string>
+#include <unordered_set>
 
 using namespace android::surfaceflinger;
 
@@ -27,24 +31,59 @@ namespace android {
 
 /*
  * SurfaceTracing records layer states during surface flinging.
+ *
+ * In the default mode every entry holds all layers, and the trace is written
+ * out when tracing is disabled. In ring buffer mode, entries only hold the
+ * layers that changed since the previous one and are kept in a fixed amount
+ * of memory, dropping the oldest, so tracing can be left on. The buffer is
+ * written out on request or when a frame is missed.
  */
 class SurfaceTracing {
 public:
     void enable();
+    void enableRingBuffer();
     status_t disable();
     bool isEnabled();
+    bool isRingBufferEnabled();
 
     void traceLayers(const char* where, LayersProto);
 
+    // Ring buffer mode: whether the next entry has to hold all layers rather
+    // than only the changed ones, so the buffer always starts with one.
+    bool needsFullEntry();
+    // Ring buffer mode: records the layers that changed, out of the layers
+    // with the given ids, or all of them if full is set.
+    void traceLayerChanges(const char* where, LayersProto changedLayers,
+                           std::unordered_set<int32_t> layerIds, bool full);
+    // Ring buffer mode: writes the buffer to the trace file and starts over.
+    status_t flushRingBuffer();
+    // Ring buffer mode: writes the buffer on a background thread, at most
+    // every MIN_JANK_FLUSH_INTERVAL, so the frames leading to it are kept.
+    void onFrameMissed();
+
 private:
     static constexpr auto DEFAULT_FILENAME = "/data/misc/wmtrace/layers_trace.pb";
+    static constexpr auto JANK_FILENAME = "/data/misc/wmtrace/layers_trace_jank.pb";
+    static constexpr size_t RING_BUFFER_SIZE = 4 * 1024 * 1024;
+    // entries between two full ones, so dropping old entries costs at most this many
+    static constexpr size_t FULL_ENTRY_INTERVAL = 256;
+    static constexpr nsecs_t MIN_JANK_FLUSH_INTERVAL = 10000000000; // 10 s
 
     status_t writeProtoFileLocked();
+    void addToRingBufferLocked(LayersTraceProto&& entry);
+    static status_t writeEntries(std::deque<LayersTraceProto> entries, const char* fileName);
 
     bool mEnabled = false;
+    bool mRingBuffer = false;
     std::string mOutputFileName = DEFAULT_FILENAME;
     std::mutex mTraceMutex;
     LayersTraceFileProto mTrace;
+
+    std::deque<LayersTraceProto> mEntries;
+    size_t mEntriesSize = 0;
+    size_t mEntriesSinceFull = 0;
+    std::unordered_set<int32_t> mTracedLayerIds;
+    nsecs_t mLastJankFlushTime = 0;
 };
 
 } // namespace android
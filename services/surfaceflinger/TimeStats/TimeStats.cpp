@@ -188,30 +188,35 @@ void TimeStats::flushAvailableRecordsToStatsLocked(const std::string& layerName)
             ALOGV("[%s]-[%" PRIu64 "]-post2present[%d]", layerName.c_str(),
                   timeRecords[0].frameNumber, postToPresentMs);
             timeStatsLayer.deltas["post2present"].insert(postToPresentMs);
+            timeStats.deltas["post2present"].insert(postToPresentMs);
 
             const int32_t acquireToPresentMs =
                     msBetween(timeRecords[0].acquireTime, timeRecords[0].presentTime);
             ALOGV("[%s]-[%" PRIu64 "]-acquire2present[%d]", layerName.c_str(),
                   timeRecords[0].frameNumber, acquireToPresentMs);
             timeStatsLayer.deltas["acquire2present"].insert(acquireToPresentMs);
+            timeStats.deltas["acquire2present"].insert(acquireToPresentMs);
 
             const int32_t latchToPresentMs =
                     msBetween(timeRecords[0].latchTime, timeRecords[0].presentTime);
             ALOGV("[%s]-[%" PRIu64 "]-latch2present[%d]", layerName.c_str(),
                   timeRecords[0].frameNumber, latchToPresentMs);
             timeStatsLayer.deltas["latch2present"].insert(latchToPresentMs);
+            timeStats.deltas["latch2present"].insert(latchToPresentMs);
 
             const int32_t desiredToPresentMs =
                     msBetween(timeRecords[0].desiredTime, timeRecords[0].presentTime);
             ALOGV("[%s]-[%" PRIu64 "]-desired2present[%d]", layerName.c_str(),
                   timeRecords[0].frameNumber, desiredToPresentMs);
             timeStatsLayer.deltas["desired2present"].insert(desiredToPresentMs);
+            timeStats.deltas["desired2present"].insert(desiredToPresentMs);
 
             const int32_t presentToPresentMs =
                     msBetween(prevTimeRecord.presentTime, timeRecords[0].presentTime);
             ALOGV("[%s]-[%" PRIu64 "]-present2present[%d]", layerName.c_str(),
                   timeRecords[0].frameNumber, presentToPresentMs);
             timeStatsLayer.deltas["present2present"].insert(presentToPresentMs);
+            timeStats.deltas["present2present"].insert(presentToPresentMs);
 
             timeStats.stats[layerName].statsEnd = static_cast<int64_t>(std::time(0));
         }
@@ -451,6 +456,7 @@ void TimeStats::clear() {
     std::lock_guard<std::mutex> lock(mMutex);
     ALOGD("Cleared");
     timeStats.stats.clear();
+    timeStats.deltas.clear();
     timeStats.statsStart = (mEnabled.load() ? static_cast<int64_t>(std::time(0)) : 0);
     timeStats.statsEnd = 0;
     timeStats.totalFrames = 0;
@@ -458,6 +464,32 @@ void TimeStats::clear() {
     timeStats.clientCompositionFrames = 0;
 }
 
+std::vector<TimeStats::Percentiles> TimeStats::getPercentiles(const std::string& layerName) {
+    ATRACE_CALL();
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    const std::unordered_map<std::string, TimeStatsHelper::Histogram>* deltas = &timeStats.deltas;
+    if (!layerName.empty()) {
+        auto iter = timeStats.stats.find(layerName);
+        if (iter == timeStats.stats.end()) {
+            return {};
+        }
+        deltas = &iter->second.deltas;
+    }
+
+    std::vector<Percentiles> percentiles;
+    for (auto& ele : *deltas) {
+        Percentiles delta;
+        delta.deltaName = ele.first;
+        delta.count = ele.second.totalCount();
+        delta.p50 = ele.second.percentile(0.5f);
+        delta.p90 = ele.second.percentile(0.9f);
+        delta.p99 = ele.second.percentile(0.99f);
+        percentiles.push_back(delta);
+    }
+    return percentiles;
+}
+
 bool TimeStats::isEnabled() {
     return mEnabled.load();
 }
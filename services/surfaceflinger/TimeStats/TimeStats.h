@@ -29,6 +29,7 @@
 #include <mutex>
 #include <optional>
 #include <unordered_map>
+#include <vector>
 
 using namespace android::surfaceflinger;
 
@@ -81,6 +82,17 @@ public:
     void clearLayerRecord(const std::string& layerName);
     void removeTimeRecord(const std::string& layerName, uint64_t frameNumber);
 
+    struct Percentiles {
+        std::string deltaName;
+        int64_t count = 0;
+        int32_t p50 = -1;
+        int32_t p90 = -1;
+        int32_t p99 = -1;
+    };
+    // Returns the frame time percentiles, in ms, of each delta recorded for
+    // layerName, or over all layers if layerName is empty.
+    std::vector<Percentiles> getPercentiles(const std::string& layerName);
+
 private:
     TimeStats() = default;
 
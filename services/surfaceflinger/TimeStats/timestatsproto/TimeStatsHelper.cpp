@@ -16,7 +16,9 @@
 #include <android-base/stringprintf.h>
 #include <timestatsproto/TimeStatsHelper.h>
 
+#include <algorithm>
 #include <array>
+#include <cmath>
 
 #define HISTOGRAM_SIZE 85
 
@@ -56,6 +58,33 @@ float TimeStatsHelper::Histogram::averageTime() const {
     return static_cast<float>(ret) / count;
 }
 
+int64_t TimeStatsHelper::Histogram::totalCount() const {
+    int64_t count = 0;
+    for (auto& ele : hist) {
+        count += ele.second;
+    }
+    return count;
+}
+
+int32_t TimeStatsHelper::Histogram::percentile(float fraction) const {
+    const int64_t count = totalCount();
+    if (count == 0) return -1;
+    const int64_t target = std::max(static_cast<int64_t>(std::ceil(fraction * count)), int64_t(1));
+    int64_t seen = 0;
+    for (int32_t i = 0; i < HISTOGRAM_SIZE; ++i) {
+        auto iter = hist.find(histogramConfig[i]);
+        if (iter == hist.end()) continue;
+        seen += iter->second;
+        if (seen >= target) return histogramConfig[i];
+    }
+    return histogramConfig[HISTOGRAM_SIZE - 1];
+}
+
+std::string TimeStatsHelper::Histogram::percentilesToString() const {
+    return StringPrintf("p50 = %dms, p90 = %dms, p99 = %dms\n", percentile(0.5f),
+                        percentile(0.9f), percentile(0.99f));
+}
+
 std::string TimeStatsHelper::Histogram::toString() const {
     std::string result;
     for (int32_t i = 0; i < HISTOGRAM_SIZE; ++i) {
@@ -79,6 +108,8 @@ std::string TimeStatsHelper::TimeStatsLayer::toString() const {
         StringAppendF(&result, "averageFPS = %.3f\n", 1000.0 / iter->second.averageTime());
     }
     for (auto& ele : deltas) {
+        StringAppendF(&result, "%s percentiles: %s", ele.first.c_str(),
+                      ele.second.percentilesToString().c_str());
         StringAppendF(&result, "%s histogram is as below:\n", ele.first.c_str());
         StringAppendF(&result, "%s", ele.second.toString().c_str());
     }
@@ -93,6 +124,10 @@ std::string TimeStatsHelper::TimeStatsGlobal::toString(std::optional<uint32_t> m
     StringAppendF(&result, "totalFrames= %d\n", totalFrames);
     StringAppendF(&result, "missedFrames= %d\n", missedFrames);
     StringAppendF(&result, "clientCompositionFrames= %d\n", clientCompositionFrames);
+    for (auto& ele : deltas) {
+        StringAppendF(&result, "%s percentiles: %s", ele.first.c_str(),
+                      ele.second.percentilesToString().c_str());
+    }
     StringAppendF(&result, "TimeStats for each layer is as below:\n");
     const auto dumpStats = generateDumpStats(maxLayers);
     for (auto& ele : dumpStats) {
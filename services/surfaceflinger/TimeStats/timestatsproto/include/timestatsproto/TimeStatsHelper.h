@@ -35,7 +35,12 @@ public:
 
         void insert(int32_t delta);
         float averageTime() const;
+        int64_t totalCount() const;
+        // Returns the smallest bucket that, with the buckets below it, holds
+        // at least the given fraction of the samples, or -1 if it is empty.
+        int32_t percentile(float fraction) const;
         std::string toString() const;
+        std::string percentilesToString() const;
     };
 
     class TimeStatsLayer {
@@ -59,6 +64,8 @@ public:
         int32_t missedFrames = 0;
         int32_t clientCompositionFrames = 0;
         std::unordered_map<std::string, TimeStatsLayer> stats;
+        // The same deltas as in each layer, over all layers.
+        std::unordered_map<std::string, Histogram> deltas;
 
         std::string toString(std::optional<uint32_t> maxLayers) const;
         SFTimeStatsGlobalProto toProto(std::optional<uint32_t> maxLayers) const;
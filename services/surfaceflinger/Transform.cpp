@@ -16,6 +16,8 @@
 
 #include <math.h>
 
+#include <vector>
+
 #include <cutils/compiler.h>
 #include <utils/String8.h>
 #include <ui/Region.h>
@@ -34,7 +36,7 @@ Transform::Transform() {
 }
 
 Transform::Transform(const Transform&  other)
-    : mMatrix(other.mMatrix), mType(other.mType) {
+    : mMatrix(other.mMatrix), mType(other.mType), mIntegral(other.mIntegral) {
 }
 
 Transform::Transform(uint32_t orientation) {
@@ -54,6 +56,19 @@ bool Transform::absIsOne(float f) {
     return isZero(fabs(f) - 1.0f);
 }
 
+// Integer coordinates up to this magnitude (and halfway points between them)
+// are exact in a float, so transforming them with integer math gives the same
+// result as the float math and its rounding.
+static const int64_t MAX_INTEGRAL_COORDINATE = 1 << 22;
+
+static bool isIntegral(float f) {
+    return floorf(f) == f && fabsf(f) < MAX_INTEGRAL_COORDINATE;
+}
+
+static bool isIntegral(int64_t v) {
+    return v > -MAX_INTEGRAL_COORDINATE && v < MAX_INTEGRAL_COORDINATE;
+}
+
 Transform Transform::operator * (const Transform& rhs) const
 {
     if (CC_LIKELY(mType == IDENTITY))
@@ -63,7 +78,12 @@ Transform Transform::operator * (const Transform& rhs) const
     if (rhs.mType == IDENTITY)
         return r;
 
-    // TODO: we could use mType to optimize the matrix multiply
+    if (mType <= TRANSLATE && rhs.mType <= TRANSLATE) {
+        // only the offsets add up
+        r.set(tx() + rhs.tx(), ty() + rhs.ty());
+        return r;
+    }
+
     const mat33& A(mMatrix);
     const mat33& B(rhs.mMatrix);
           mat33& D(r.mMatrix);
@@ -75,11 +95,7 @@ Transform Transform::operator * (const Transform& rhs) const
         D[1][i] = v0*B[1][0] + v1*B[1][1] + v2*B[1][2];
         D[2][i] = v0*B[2][0] + v1*B[2][1] + v2*B[2][2];
     }
-    r.mType |= rhs.mType;
-
-    // TODO: we could recompute this value from r and rhs
-    r.mType &= 0xFF;
-    r.mType |= UNKNOWN_TYPE;
+    r.updateType();
     return r;
 }
 
@@ -97,6 +113,7 @@ float Transform::ty() const {
 
 void Transform::reset() {
     mType = IDENTITY;
+    mIntegral = true;
     for(int i=0 ; i<3 ; i++) {
         vec3& v(mMatrix[i]);
         for (int j=0 ; j<3 ; j++)
@@ -109,12 +126,7 @@ void Transform::set(float tx, float ty)
     mMatrix[2][0] = tx;
     mMatrix[2][1] = ty;
     mMatrix[2][2] = 1.0f;
-
-    if (isZero(tx) && isZero(ty)) {
-        mType &= ~TRANSLATE;
-    } else {
-        mType |= TRANSLATE;
-    }
+    updateType();
 }
 
 void Transform::set(float a, float b, float c, float d)
@@ -123,7 +135,7 @@ void Transform::set(float a, float b, float c, float d)
     M[0][0] = a;    M[1][0] = b;
     M[0][1] = c;    M[1][1] = d;
     M[0][2] = 0;    M[1][2] = 0;
-    mType = UNKNOWN_TYPE;
+    updateType();
 }
 
 status_t Transform::set(uint32_t flags, float w, float h)
@@ -141,28 +153,25 @@ status_t Transform::set(uint32_t flags, float w, float h)
     }
 
     if (flags & FLIP_H) {
-        H.mType = (FLIP_H << 8) | SCALE;
-        H.mType |= isZero(w) ? IDENTITY : TRANSLATE;
         mat33& M(H.mMatrix);
         M[0][0] = -1;
         M[2][0] = w;
+        H.updateType();
     }
 
     if (flags & FLIP_V) {
-        V.mType = (FLIP_V << 8) | SCALE;
-        V.mType |= isZero(h) ? IDENTITY : TRANSLATE;
         mat33& M(V.mMatrix);
         M[1][1] = -1;
         M[2][1] = h;
+        V.updateType();
     }
 
     if (flags & ROT_90) {
         const float original_w = h;
-        R.mType = (ROT_90 << 8) | ROTATE;
-        R.mType |= isZero(original_w) ? IDENTITY : TRANSLATE;
         mat33& M(R.mMatrix);
         M[0][0] = 0;    M[1][0] =-1;    M[2][0] = original_w;
         M[0][1] = 1;    M[1][1] = 0;
+        R.updateType();
     }
 
     *this = (R*(H*V));
@@ -196,9 +205,47 @@ Rect Transform::makeBounds(int w, int h) const
     return transform( Rect(w, h) );
 }
 
+bool Transform::transformIntegral(const Rect& bounds, Rect* out) const
+{
+    if (!mIntegral) {
+        return false;
+    }
+
+    // the 2x2 part is a rotation by a multiple of 90 degrees and/or flips, so
+    // x only depends on one of left/right or top/bottom (and y on the other),
+    // and two opposite corners are enough to find the transformed bounds
+    const mat33& M(mMatrix);
+    const int64_t a = int64_t(M[0][0]);
+    const int64_t b = int64_t(M[1][0]);
+    const int64_t c = int64_t(M[0][1]);
+    const int64_t d = int64_t(M[1][1]);
+    const int64_t x = int64_t(M[2][0]);
+    const int64_t y = int64_t(M[2][1]);
+
+    const int64_t x0 = a * bounds.left + b * bounds.top + x;
+    const int64_t x1 = a * bounds.right + b * bounds.bottom + x;
+    const int64_t y0 = c * bounds.left + d * bounds.top + y;
+    const int64_t y1 = c * bounds.right + d * bounds.bottom + y;
+    if (!isIntegral(int64_t(bounds.left)) || !isIntegral(int64_t(bounds.top)) ||
+            !isIntegral(int64_t(bounds.right)) || !isIntegral(int64_t(bounds.bottom)) ||
+            !isIntegral(x0) || !isIntegral(x1) || !isIntegral(y0) || !isIntegral(y1)) {
+        return false;
+    }
+
+    out->left   = int32_t(x0 < x1 ? x0 : x1);
+    out->top    = int32_t(y0 < y1 ? y0 : y1);
+    out->right  = int32_t(x0 < x1 ? x1 : x0);
+    out->bottom = int32_t(y0 < y1 ? y1 : y0);
+    return true;
+}
+
 Rect Transform::transform(const Rect& bounds, bool roundOutwards) const
 {
     Rect r;
+    if (transformIntegral(bounds, &r)) {
+        return r;
+    }
+
     vec2 lt( bounds.left,  bounds.top    );
     vec2 rt( bounds.right, bounds.top    );
     vec2 lb( bounds.left,  bounds.bottom );
@@ -245,15 +292,60 @@ FloatRect Transform::transform(const FloatRect& bounds) const
     return r;
 }
 
+// Unions rects[0, count) by merging halves, so that every rect isn't merged
+// into an ever growing region one after the other.
+static Region mergeRects(const Rect* rects, size_t count)
+{
+    if (count == 1) {
+        return Region(rects[0]);
+    }
+    const size_t half = count / 2;
+    return mergeRects(rects, half).merge(mergeRects(rects + half, count - half));
+}
+
 Region Transform::transform(const Region& reg) const
 {
     Region out;
     if (CC_UNLIKELY(type() > TRANSLATE)) {
         if (CC_LIKELY(preserveRects())) {
-            Region::const_iterator it = reg.begin();
-            Region::const_iterator const end = reg.end();
-            while (it != end) {
-                out.orSelf(transform(*it++));
+            size_t count;
+            const Rect* rects = reg.getArray(&count);
+            Rect bounds;
+            if (count == 1) {
+                out.orSelf(transform(rects[0]));
+            } else if (!(getOrientation() & ROT_90) && transformIntegral(reg.bounds(), &bounds)) {
+                // flips keep the bands, they only reverse their order and/or
+                // the order of the spans in each of them
+                const uint32_t orientation = getOrientation();
+                out.set(bounds);
+                for (size_t i = 0; i < count; ) {
+                    const size_t band = (orientation & FLIP_V) ? count - 1 - i : i;
+                    size_t first = band;
+                    size_t last = band;
+                    if (orientation & FLIP_V) {
+                        while (first > 0 && rects[first - 1].top == rects[band].top) first--;
+                    } else {
+                        while (last + 1 < count && rects[last + 1].top == rects[band].top) last++;
+                    }
+                    for (size_t j = 0; j <= last - first; j++) {
+                        Rect r;
+                        transformIntegral(rects[(orientation & FLIP_H) ? last - j : first + j], &r);
+                        out.addRectUnchecked(r.left, r.top, r.right, r.bottom);
+                    }
+                    i += last - first + 1;
+                }
+            } else {
+                std::vector<Rect> transformed;
+                transformed.reserve(count);
+                for (size_t i = 0; i < count; i++) {
+                    const Rect r(transform(rects[i]));
+                    if (!r.isEmpty()) {
+                        transformed.push_back(r);
+                    }
+                }
+                if (!transformed.empty()) {
+                    out = mergeRects(transformed.data(), transformed.size());
+                }
             }
         } else {
             out.set(transform(reg.bounds()));
@@ -268,55 +360,59 @@ Region Transform::transform(const Region& reg) const
 
 uint32_t Transform::type() const
 {
-    if (mType & UNKNOWN_TYPE) {
-        // recompute what this transform is
+    return mType;
+}
 
-        const mat33& M(mMatrix);
-        const float a = M[0][0];
-        const float b = M[1][0];
-        const float c = M[0][1];
-        const float d = M[1][1];
-        const float x = M[2][0];
-        const float y = M[2][1];
+void Transform::updateType()
+{
+    // recompute what this transform is
 
-        bool scale = false;
-        uint32_t flags = ROT_0;
-        if (isZero(b) && isZero(c)) {
-            if (a<0)    flags |= FLIP_H;
-            if (d<0)    flags |= FLIP_V;
-            if (!absIsOne(a) || !absIsOne(d)) {
-                scale = true;
-            }
-        } else if (isZero(a) && isZero(d)) {
-            flags |= ROT_90;
-            if (b>0)    flags |= FLIP_V;
-            if (c<0)    flags |= FLIP_H;
-            if (!absIsOne(b) || !absIsOne(c)) {
-                scale = true;
-            }
-        } else {
-            // there is a skew component and/or a non 90 degrees rotation
-            flags = ROT_INVALID;
+    const mat33& M(mMatrix);
+    const float a = M[0][0];
+    const float b = M[1][0];
+    const float c = M[0][1];
+    const float d = M[1][1];
+    const float x = M[2][0];
+    const float y = M[2][1];
+
+    bool scale = false;
+    uint32_t flags = ROT_0;
+    if (isZero(b) && isZero(c)) {
+        if (a<0)    flags |= FLIP_H;
+        if (d<0)    flags |= FLIP_V;
+        if (!absIsOne(a) || !absIsOne(d)) {
+            scale = true;
         }
-
-        mType = flags << 8;
-        if (flags & ROT_INVALID) {
-            mType |= UNKNOWN;
-        } else {
-            if ((flags & ROT_90) || ((flags & ROT_180) == ROT_180))
-                mType |= ROTATE;
-            if (flags & FLIP_H)
-                mType ^= SCALE;
-            if (flags & FLIP_V)
-                mType ^= SCALE;
-            if (scale)
-                mType |= SCALE;
+    } else if (isZero(a) && isZero(d)) {
+        flags |= ROT_90;
+        if (b>0)    flags |= FLIP_V;
+        if (c<0)    flags |= FLIP_H;
+        if (!absIsOne(b) || !absIsOne(c)) {
+            scale = true;
         }
+    } else {
+        // there is a skew component and/or a non 90 degrees rotation
+        flags = ROT_INVALID;
+    }
 
-        if (!isZero(x) || !isZero(y))
-            mType |= TRANSLATE;
+    mType = flags << 8;
+    if (flags & ROT_INVALID) {
+        mType |= UNKNOWN;
+    } else {
+        if ((flags & ROT_90) || ((flags & ROT_180) == ROT_180))
+            mType |= ROTATE;
+        if (flags & FLIP_H)
+            mType ^= SCALE;
+        if (flags & FLIP_V)
+            mType ^= SCALE;
+        if (scale)
+            mType |= SCALE;
     }
-    return mType;
+
+    if (!isZero(x) || !isZero(y))
+        mType |= TRANSLATE;
+
+    mIntegral = !(flags & ROT_INVALID) && !scale && isIntegral(x) && isIntegral(y);
 }
 
 Transform Transform::inverse() const {
@@ -349,6 +445,7 @@ Transform Transform::inverse() const {
         result.mMatrix[1][0] = -b*idet;
         result.mMatrix[1][1] =  a*idet;
         result.mType = mType;
+        result.mIntegral = mIntegral;
 
         vec2 T(-x, -y);
         T = result.transform(T);
@@ -374,8 +471,6 @@ bool Transform::preserveRects() const
 
 void Transform::dump(const char* name) const
 {
-    type(); // updates the type
-
     String8 flags, type;
     const mat33& m(mMatrix);
     uint32_t orient = mType >> 8;
@@ -102,14 +102,17 @@ private:
         inline vec3& operator [] (int i) { return v[i]; }
     };
 
-    enum { UNKNOWN_TYPE = 0x80000000 };
-
     uint32_t type() const;
+    void updateType();
+    bool transformIntegral(const Rect& bounds, Rect* out) const;
     static bool absIsOne(float f);
     static bool isZero(float f);
 
     mat33               mMatrix;
-    mutable uint32_t    mType;
+    uint32_t            mType;
+    // true if the 2x2 part only holds 0, 1 and -1 and the translation is
+    // integral, so integer coordinates map to integer coordinates exactly
+    bool                mIntegral;
 };
 
 // ---------------------------------------------------------------------------
@@ -34,6 +34,9 @@ private:
     // low-pass filter in case the client isn't quick enough in sending new transactions.
     const int MIN_EARLY_FRAME_COUNT = 2;
 
+    // Refresh periods shorter than this use the high refresh rate offsets, if any were set.
+    static constexpr nsecs_t MAX_HIGH_REFRESH_RATE_PERIOD = 1000000000 / 75;
+
 public:
 
     struct Offsets {
@@ -57,20 +60,50 @@ public:
     // appEarlyGl: Like sfEarlyGl, but for the app-vsync.
     // appLate: The regular app vsync phase offset.
     void setPhaseOffsets(Offsets early, Offsets earlyGl, Offsets late) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mDefaultOffsets = {early, earlyGl, late};
         mEarlyOffsets = early;
         mEarlyGlOffsets = earlyGl;
         mLateOffsets = late;
         mOffsets = late;
     }
 
+    // Like setPhaseOffsets, but for refresh rates with a period shorter than
+    // MAX_HIGH_REFRESH_RATE_PERIOD, where one period leaves less room for SF and the apps.
+    void setHighRefreshRatePhaseOffsets(Offsets early, Offsets earlyGl, Offsets late) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mHighRefreshRateOffsets = {early, earlyGl, late};
+        mHasHighRefreshRateOffsets = true;
+    }
+
+    // Switches to the offsets for the given refresh period.
+    void setRefreshPeriod(nsecs_t period) {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            const OffsetSet& offsets = getOffsetSetLocked(period);
+            mEarlyOffsets = offsets.early;
+            mEarlyGlOffsets = offsets.earlyGl;
+            mLateOffsets = offsets.late;
+        }
+        updateOffsets();
+    }
+
     Offsets getEarlyOffsets() const {
+        std::lock_guard<std::mutex> lock(mMutex);
         return mEarlyOffsets;
     }
 
     Offsets getEarlyGlOffsets() const {
+        std::lock_guard<std::mutex> lock(mMutex);
         return mEarlyGlOffsets;
     }
 
+    // The regular offsets used at the given refresh period.
+    Offsets getLateOffsets(nsecs_t period) const {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return getOffsetSetLocked(period).late;
+    }
+
     void setEventThreads(EventThread* sfEventThread, EventThread* appEventThread) {
         mSfEventThread = sfEventThread;
         mAppEventThread = appEventThread;
@@ -132,7 +165,21 @@ private:
         }
     }
 
+    struct OffsetSet {
+        Offsets early;
+        Offsets earlyGl;
+        Offsets late;
+    };
+
+    const OffsetSet& getOffsetSetLocked(nsecs_t period) const {
+        if (mHasHighRefreshRateOffsets && period < MAX_HIGH_REFRESH_RATE_PERIOD) {
+            return mHighRefreshRateOffsets;
+        }
+        return mDefaultOffsets;
+    }
+
     Offsets getOffsets() {
+        std::lock_guard<std::mutex> lock(mMutex);
         if (mTransactionStart == TransactionStart::EARLY || mRemainingEarlyFrameCount > 0) {
             return mEarlyOffsets;
         } else if (mLastFrameUsedRenderEngine) {
@@ -142,6 +189,15 @@ private:
         }
     }
 
+    // Protects the offsets below, which change with the refresh rate while transactions are
+    // being started from binder threads.
+    mutable std::mutex mMutex;
+
+    OffsetSet mDefaultOffsets;
+    OffsetSet mHighRefreshRateOffsets;
+    bool mHasHighRefreshRateOffsets = false;
+
+    // The offsets for the current refresh rate.
     Offsets mLateOffsets;
     Offsets mEarlyOffsets;
     Offsets mEarlyGlOffsets;
@@ -17,10 +17,12 @@
 #include <sys/resource.h>
 
 #include <sched.h>
+#include <stdlib.h>
 
 #include <android/frameworks/displayservice/1.0/IDisplayService.h>
 #include <android/hardware/configstore/1.0/ISurfaceFlingerConfigs.h>
 #include <android/hardware/graphics/allocator/2.0/IAllocator.h>
+#include <cutils/properties.h>
 #include <cutils/sched_policy.h>
 #include <binder/IServiceManager.h>
 #include <binder/IPCThreadState.h>
@@ -80,6 +82,16 @@ int main(int, char**) {
     // binder threads to 4.
     ProcessState::self()->setThreadPoolMaxThreadCount(4);
 
+    // Optionally let the pool grow during bursts of binder calls and shrink
+    // back to its 4 threads when they are over.
+    char value[PROPERTY_VALUE_MAX];
+    property_get("debug.sf.adaptive_binder_threads", value, "0");
+    const int adaptiveMaxThreads = atoi(value);
+    if (adaptiveMaxThreads > 4) {
+        ProcessState::self()->setAdaptiveThreadPool(adaptiveMaxThreads, 4,
+                /* growAfterMs */ 20, /* idleTimeoutMs */ 10000);
+    }
+
     // start the thread pool
     sp<ProcessState> ps(ProcessState::self());
     ps->startThreadPool();
@@ -105,7 +117,7 @@ int main(int, char**) {
                    IServiceManager::DUMP_FLAG_PRIORITY_CRITICAL | IServiceManager::DUMP_FLAG_PROTO);
 
     // publish GpuService
-    sp<GpuService> gpuservice = new GpuService();
+    sp<GpuService> gpuservice = new GpuService(flinger);
     sm->addService(String16(GpuService::SERVICE_NAME), gpuservice, false);
 
     startDisplayService(); // dependency on SF getting registered above
@@ -16,6 +16,7 @@
 
 #include <frameworks/native/cmds/surfacereplayer/proto/src/trace.pb.h>
 #include <google/protobuf/io/zero_copy_stream_impl.h>
+#include <surfacereplayer/TraceCompaction.h>
 
 #include <gtest/gtest.h>
 
@@ -83,6 +84,10 @@ static status_t readProtoFile(Trace* trace) {
     }
     close(fd);
 
+    if (err == NO_ERROR && !expandTrace(trace)) {
+        err = BAD_VALUE;
+    }
+
     return err;
 }
 
@@ -2628,6 +2628,36 @@ TEST_F(ScreenCaptureTest, CaptureSize) {
     mCapture->checkPixel(30, 30, 0, 0, 0);
 }
 
+TEST_F(ScreenCaptureTest, CaptureCropIntoProvidedBuffer) {
+    sp<SurfaceControl> redLayer = mComposerClient->createSurface(String8("Red surface"), 60, 60,
+                                                                 PIXEL_FORMAT_RGBA_8888, 0);
+
+    ASSERT_NO_FATAL_FAILURE(fillLayerColor(redLayer, Color::RED));
+
+    SurfaceComposerClient::Transaction().setLayer(redLayer, INT32_MAX - 1).show(redLayer).apply(
+            true);
+
+    auto redLayerHandle = redLayer->getHandle();
+
+    // A 40x40 crop at half scale fits the 20x20 buffer, so it's rendered in place.
+    const uint32_t usage = GRALLOC_USAGE_SW_READ_OFTEN | GRALLOC_USAGE_HW_RENDER;
+    sp<GraphicBuffer> buffer = new GraphicBuffer(20, 20, PIXEL_FORMAT_RGBA_8888, 1, usage,
+                                                 "CaptureCropIntoProvidedBuffer");
+    sp<GraphicBuffer> outBuffer = buffer;
+    sp<ISurfaceComposer> sf(ComposerService::getComposerService());
+    ASSERT_EQ(NO_ERROR, sf->captureLayers(redLayerHandle, &outBuffer, Rect(10, 10, 50, 50), 0.5));
+    ASSERT_EQ(buffer, outBuffer);
+    mCapture = std::make_unique<ScreenCapture>(outBuffer);
+    mCapture->expectColor(Rect(0, 0, 20, 20), Color::RED);
+    mCapture.reset();
+
+    // A buffer of the wrong size is replaced.
+    ASSERT_EQ(NO_ERROR, sf->captureLayers(redLayerHandle, &outBuffer, Rect::EMPTY_RECT, 0.5));
+    ASSERT_NE(buffer, outBuffer);
+    ASSERT_EQ(30u, outBuffer->getWidth());
+    ASSERT_EQ(30u, outBuffer->getHeight());
+}
+
 TEST_F(ScreenCaptureTest, CaptureInvalidLayer) {
     sp<SurfaceControl> redLayer = mComposerClient->createSurface(String8("Red surface"), 60, 60,
                                                                  PIXEL_FORMAT_RGBA_8888, 0);
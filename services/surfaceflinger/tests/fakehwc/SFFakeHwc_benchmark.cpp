@@ -0,0 +1,229 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#undef LOG_TAG
+#define LOG_TAG "FakeHwcBenchmark"
+
+#include "FakeComposerClient.h"
+#include "FakeComposerService.h"
+#include "FakeComposerUtils.h"
+
+#include "SurfaceFlinger.h" // Get the name of the service...
+
+#include <gui/ISurfaceComposer.h>
+#include <gui/Surface.h>
+#include <gui/SurfaceComposerClient.h>
+
+#include <android/native_window.h>
+#include <binder/IServiceManager.h>
+#include <binder/ProcessState.h>
+#include <hwbinder/ProcessState.h>
+#include <log/log.h>
+#include <ui/DisplayInfo.h>
+
+#include <benchmark/benchmark.h>
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+using namespace android;
+using namespace android::hardware;
+
+using namespace sftest;
+
+namespace {
+
+// Composes frames of scripted layer churn against the fake HWC, and reports
+// the thread CPU time SurfaceFlinger spent per frame in each stage of the
+// composition, as accounted by dumpsys SurfaceFlinger --dump-composition-stages.
+// Only the stages' times are meaningful: the wall time of an iteration is
+// mostly the fake composer waiting to inject the vsync.
+
+FakeComposerClient* sFakeComposer;
+
+constexpr uint32_t LAYER_SIZE = 64;
+
+// Fill an RGBA_8888 formatted surface with a single color, and queue it.
+void fillSurfaceRGBA8(const sp<SurfaceControl>& sc, uint8_t r, uint8_t g, uint8_t b) {
+    ANativeWindow_Buffer outBuffer;
+    sp<Surface> s = sc->getSurface();
+    LOG_ALWAYS_FATAL_IF(s == nullptr || s->lock(&outBuffer, nullptr) != NO_ERROR,
+                        "Failed to lock the surface");
+    uint8_t* img = reinterpret_cast<uint8_t*>(outBuffer.bits);
+    for (int y = 0; y < outBuffer.height; y++) {
+        for (int x = 0; x < outBuffer.width; x++) {
+            uint8_t* pixel = img + (4 * (y * outBuffer.stride + x));
+            pixel[0] = r;
+            pixel[1] = g;
+            pixel[2] = b;
+            pixel[3] = 255;
+        }
+    }
+    LOG_ALWAYS_FATAL_IF(s->unlockAndPost() != NO_ERROR, "Failed to post the surface");
+}
+
+// Returns what dumpsys SurfaceFlinger would print with the given argument.
+std::string dumpSurfaceFlinger(const char* arg) {
+    sp<IBinder> sf = defaultServiceManager()->checkService(
+            String16(SurfaceFlinger::getServiceName()));
+    LOG_ALWAYS_FATAL_IF(sf == nullptr, "SurfaceFlinger is not running");
+    int fds[2];
+    LOG_ALWAYS_FATAL_IF(pipe(fds) != 0, "pipe failed: %s", strerror(errno));
+    Vector<String16> args;
+    args.add(String16(arg));
+    // the stage times are a few lines, well within what the pipe buffers
+    sf->dump(fds[1], args);
+    close(fds[1]);
+    std::string result;
+    char buffer[1024];
+    ssize_t size;
+    while ((size = read(fds[0], buffer, sizeof(buffer))) > 0) {
+        result.append(buffer, size);
+    }
+    close(fds[0]);
+    return result;
+}
+
+// Reports the mean time per frame of each stage, in microseconds.
+void reportCompositionStages(benchmark::State& state) {
+    const std::string stages = dumpSurfaceFlinger("--dump-composition-stages");
+    char name[64];
+    uint64_t count;
+    int64_t total;
+    int64_t max;
+    for (const char* line = stages.c_str(); *line;) {
+        if (sscanf(line, "%63[^:]: count=%" SCNu64 " total=%" SCNd64 " max=%" SCNd64, name, &count,
+                   &total, &max) == 4 &&
+            count) {
+            state.counters[std::string(name) + "_us"] =
+                    benchmark::Counter(total / 1000.0 / count);
+            state.counters[std::string(name) + "_max_us"] = benchmark::Counter(max / 1000.0);
+        }
+        const char* next = strchr(line, '\n');
+        if (!next) break;
+        line = next + 1;
+    }
+}
+
+// Each frame moves every layer, and on a fixed schedule also changes the
+// alpha of a quarter of them, restacks them, hides or shows one and posts
+// new buffers to some, so the transaction, visible region and HWC paths
+// all see work.
+void BM_LayerChurn(benchmark::State& state) {
+    const int numLayers = state.range(0);
+    sp<SurfaceComposerClient> client = new SurfaceComposerClient;
+    LOG_ALWAYS_FATAL_IF(client->initCheck() != NO_ERROR, "Failed to connect to SurfaceFlinger");
+
+    sp<IBinder> display(
+            SurfaceComposerClient::getBuiltInDisplay(ISurfaceComposer::eDisplayIdMain));
+    DisplayInfo info;
+    SurfaceComposerClient::getDisplayInfo(display, &info);
+    const int32_t xRange = info.w > LAYER_SIZE ? info.w - LAYER_SIZE : 1;
+    const int32_t yRange = info.h > LAYER_SIZE ? info.h - LAYER_SIZE : 1;
+
+    std::vector<sp<SurfaceControl>> layers;
+    {
+        TransactionScope ts(*sFakeComposer);
+        ts.setDisplayLayerStack(display, 0);
+        for (int i = 0; i < numLayers; i++) {
+            sp<SurfaceControl> layer =
+                    client->createSurface(String8::format("Churn Surface %d", i), LAYER_SIZE,
+                                          LAYER_SIZE, PIXEL_FORMAT_RGBA_8888, 0);
+            LOG_ALWAYS_FATAL_IF(layer == nullptr || !layer->isValid(), "Failed to create layer");
+            fillSurfaceRGBA8(layer, 63, 63, 195);
+            ts.setLayer(layer, INT32_MAX - 1 - numLayers + i);
+            ts.show(layer);
+            layers.push_back(layer);
+        }
+    }
+
+    dumpSurfaceFlinger("--enable-composition-stages");
+    dumpSurfaceFlinger("--clear-composition-stages");
+
+    uint32_t frame = 0;
+    for (auto _ : state) {
+        frame++;
+        TransactionScope ts(*sFakeComposer);
+        for (int i = 0; i < numLayers; i++) {
+            const sp<SurfaceControl>& layer = layers[i];
+            ts.setPosition(layer, (frame * 7 + i * 97) % xRange, (frame * 5 + i * 61) % yRange);
+            if ((frame + i) % 4 == 0) {
+                ts.setAlpha(layer, ((frame + i) % 8) ? 0.5f : 1.0f);
+            }
+            if (frame % 8 == 0) {
+                // reverse the stacking order every eighth frame
+                const int z = (frame % 16) ? numLayers - 1 - i : i;
+                ts.setLayer(layer, INT32_MAX - 1 - numLayers + z);
+            }
+            if ((frame + i) % 3 == 0) {
+                fillSurfaceRGBA8(layer, frame & 0xff, 63, 195);
+            }
+        }
+        const sp<SurfaceControl>& toggled = layers[frame % numLayers];
+        if ((frame / numLayers) % 2) {
+            ts.hide(toggled);
+        } else {
+            ts.show(toggled);
+        }
+    }
+
+    reportCompositionStages(state);
+    dumpSurfaceFlinger("--disable-composition-stages");
+
+    client->dispose();
+    sFakeComposer->clearFrames();
+}
+BENCHMARK(BM_LayerChurn)->Arg(4)->Arg(16)->Arg(64)->Iterations(2000);
+
+} // namespace
+
+int main(int argc, char** argv) {
+    benchmark::Initialize(&argc, argv);
+
+    sftest::FakeHwcEnvironment fakeEnvironment;
+    fakeEnvironment.SetUp();
+
+    // TODO: See TODO comment at DisplayTest::SetUp in SFFakeHwc_test.cpp for
+    // background on the lifetime of the FakeComposerClient.
+    sFakeComposer = new FakeComposerClient;
+    sp<ComposerClient> client = new ComposerClient(sFakeComposer);
+    sp<IComposer> fakeService = new FakeComposerService(client);
+    (void)fakeService->registerAsService("mock");
+
+    android::hardware::ProcessState::self()->startThreadPool();
+    android::ProcessState::self()->startThreadPool();
+
+    startSurfaceFlinger();
+
+    // Fake composer wants to enable VSync injection
+    sFakeComposer->onSurfaceFlingerStart();
+
+    benchmark::RunSpecifiedBenchmarks();
+
+    // Fake composer needs to release SurfaceComposerClient before the stop.
+    sFakeComposer->onSurfaceFlingerStop();
+    stopSurfaceFlinger();
+    sFakeComposer = nullptr;
+
+    fakeEnvironment.TearDown();
+    return 0;
+}
@@ -313,6 +313,95 @@ TEST_F(EventThreadTest, setVsyncRateTwoPostsEveryOtherEventToThatConnection) {
     expectVsyncEventReceivedByConnection(101112, 4u);
 }
 
+TEST_F(EventThreadTest, setIdleStopsContinuousEventsUntilResumed) {
+    mThread->setVsyncRate(1, mConnection);
+
+    expectVSyncSetEnabledCallReceived(true);
+    auto callback = expectVSyncSetCallbackCallReceived();
+    ASSERT_TRUE(callback);
+
+    // While idle, the event is not posted and vsync gets disabled.
+    mThread->setIdle(true);
+    callback->onVSyncEvent(123);
+    expectInterceptCallReceived(123);
+    expectVSyncSetEnabledCallReceived(false);
+    EXPECT_FALSE(mConnectionEventCallRecorder.waitForUnexpectedCall().has_value());
+
+    // Leaving idle enables vsync again and posts the next event.
+    mThread->setIdle(false);
+    expectVSyncSetEnabledCallReceived(true);
+    callback->onVSyncEvent(456);
+    expectInterceptCallReceived(456);
+    expectVsyncEventReceivedByConnection(456, 2u);
+}
+
+TEST_F(EventThreadTest, setIdleStillPostsOneShotEvents) {
+    mThread->setIdle(true);
+    mThread->requestNextVsync(mConnection);
+
+    EXPECT_TRUE(mResyncCallRecorder.waitForCall().has_value());
+    expectVSyncSetEnabledCallReceived(true);
+    auto callback = expectVSyncSetCallbackCallReceived();
+    ASSERT_TRUE(callback);
+
+    callback->onVSyncEvent(123);
+    expectInterceptCallReceived(123);
+    expectVsyncEventReceivedByConnection(123, 1u);
+}
+
+TEST_F(EventThreadTest, setVsyncScheduleSkipsVsyncsThatAreNotDue) {
+    mThread->setVsyncSchedule(1000, 0, mConnection);
+    mThread->setVsyncRate(1, mConnection);
+
+    // EventThread should enable vsync callbacks, and set a callback interface
+    // pointer to use them with the VSync source.
+    expectVSyncSetEnabledCallReceived(true);
+    auto callback = expectVSyncSetCallbackCallReceived();
+    ASSERT_TRUE(callback);
+
+    // The first event is delivered right away.
+    callback->onVSyncEvent(1000);
+    expectInterceptCallReceived(1000);
+    expectVsyncEventReceivedByConnection(1000, 1u);
+
+    // The next one is halfway to the next scheduled time, and is skipped.
+    callback->onVSyncEvent(1500);
+    expectInterceptCallReceived(1500);
+    EXPECT_FALSE(mConnectionEventCallRecorder.waitForUnexpectedCall().has_value());
+
+    // A slightly early event is still close enough to the scheduled time.
+    callback->onVSyncEvent(1990);
+    expectInterceptCallReceived(1990);
+    expectVsyncEventReceivedByConnection(1990, 3u);
+
+    callback->onVSyncEvent(2500);
+    expectInterceptCallReceived(2500);
+    EXPECT_FALSE(mConnectionEventCallRecorder.waitForUnexpectedCall().has_value());
+}
+
+TEST_F(EventThreadTest, requestNextVsyncWaitsForScheduledVsync) {
+    mThread->setVsyncSchedule(1000, 0, mConnection);
+    mThread->requestNextVsync(mConnection);
+
+    expectVSyncSetEnabledCallReceived(true);
+    auto callback = expectVSyncSetCallbackCallReceived();
+    ASSERT_TRUE(callback);
+
+    callback->onVSyncEvent(1000);
+    expectInterceptCallReceived(1000);
+    expectVsyncEventReceivedByConnection(1000, 1u);
+
+    // A request made before the next scheduled time is held until then.
+    mThread->requestNextVsync(mConnection);
+    callback->onVSyncEvent(1500);
+    expectInterceptCallReceived(1500);
+    EXPECT_FALSE(mConnectionEventCallRecorder.waitForUnexpectedCall().has_value());
+
+    callback->onVSyncEvent(2000);
+    expectInterceptCallReceived(2000);
+    expectVsyncEventReceivedByConnection(2000, 3u);
+}
+
 TEST_F(EventThreadTest, connectionsRemovedIfInstanceDestroyed) {
     mThread->setVsyncRate(1, mConnection);
 
@@ -388,6 +477,26 @@ TEST_F(EventThreadTest, eventsDroppedIfNonfatalEventDeliveryError) {
     EXPECT_FALSE(mVSyncSetEnabledCallRecorder.waitForUnexpectedCall().has_value());
 }
 
+TEST_F(EventThreadTest, requestNextVsyncRetriedIfNonfatalEventDeliveryError) {
+    ConnectionEventRecorder errorConnectionEventRecorder{WOULD_BLOCK};
+    sp<MockEventThreadConnection> errorConnection = createConnection(errorConnectionEventRecorder);
+    mThread->requestNextVsync(errorConnection);
+
+    expectVSyncSetEnabledCallReceived(true);
+    auto callback = expectVSyncSetCallbackCallReceived();
+    ASSERT_TRUE(callback);
+
+    // The connection can't take the event it asked for...
+    callback->onVSyncEvent(123);
+    expectInterceptCallReceived(123);
+    expectVsyncEventReceivedByConnection("errorConnection", errorConnectionEventRecorder, 123, 1u);
+
+    // ...so it is offered the next one as well, without asking again.
+    callback->onVSyncEvent(456);
+    expectInterceptCallReceived(456);
+    expectVsyncEventReceivedByConnection("errorConnection", errorConnectionEventRecorder, 456, 2u);
+}
+
 TEST_F(EventThreadTest, setPhaseOffsetForwardsToVSyncSource) {
     mThread->setPhaseOffset(321);
     expectVSyncSetPhaseOffsetCallReceived(321);
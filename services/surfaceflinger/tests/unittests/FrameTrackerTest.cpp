@@ -0,0 +1,76 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#undef LOG_TAG
+#define LOG_TAG "LibSurfaceFlingerUnittests"
+
+#include <gtest/gtest.h>
+
+#include <utils/String8.h>
+
+#include "FrameTracker.h"
+
+namespace android {
+namespace {
+
+constexpr nsecs_t kPeriod = 16000;
+
+void addFrame(FrameTracker& tracker, nsecs_t desired, nsecs_t ready, nsecs_t compositionStart,
+              nsecs_t present) {
+    tracker.setDesiredPresentTime(desired);
+    tracker.setFrameReadyTime(ready);
+    if (compositionStart > 0) {
+        tracker.setCompositionStartTime(compositionStart);
+    }
+    tracker.setActualPresentTime(present);
+    tracker.advanceFrame();
+}
+
+TEST(FrameTrackerTest, dumpsStageDurations) {
+    FrameTracker tracker;
+    tracker.setDisplayRefreshPeriod(kPeriod);
+    addFrame(tracker, 1000, 2000, 3000, 5000);
+
+    String8 result;
+    tracker.dumpStageStats(result);
+    EXPECT_NE(-1, result.find("1000\t1000\t1000\t0\t2000\n"));
+}
+
+TEST(FrameTrackerTest, unrecordedStagesTakeNoTime) {
+    FrameTracker tracker;
+    tracker.setDisplayRefreshPeriod(kPeriod);
+    addFrame(tracker, 1000, 2000, 0, 5000);
+
+    String8 result;
+    tracker.dumpStageStats(result);
+    EXPECT_NE(-1, result.find("1000\t1000\t0\t0\t3000\n"));
+}
+
+TEST(FrameTrackerTest, attributesMissedFrameToSlowestStage) {
+    FrameTracker tracker;
+    tracker.setDisplayRefreshPeriod(kPeriod);
+    addFrame(tracker, 1000, 2000, 3000, 5000);
+    addFrame(tracker, 17000, 18000, 19000, 21000);
+    // the app finishes late, so this frame is presented two periods later
+    addFrame(tracker, 33000, 60000, 61000, 63000);
+
+    String8 result;
+    tracker.dumpStageStats(result);
+    EXPECT_NE(-1, result.find("missed frames: app=1 compositor=0 gpu=0 display=0\n"));
+}
+
+} // namespace
+} // namespace android
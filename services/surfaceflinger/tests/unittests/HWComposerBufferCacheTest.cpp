@@ -0,0 +1,82 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#undef LOG_TAG
+#define LOG_TAG "LibSurfaceFlingerUnittests"
+
+#include <gtest/gtest.h>
+
+#include <ui/GraphicBuffer.h>
+
+#include "DisplayHardware/HWComposerBufferCache.h"
+
+namespace android {
+namespace {
+
+TEST(HWComposerBufferCacheTest, sendsBufferOnlyOnFirstUse) {
+    HWComposerBufferCache cache;
+    sp<GraphicBuffer> buffer = new GraphicBuffer();
+    uint32_t hwcSlot;
+    sp<GraphicBuffer> hwcBuffer;
+
+    cache.getHwcBuffer(3, buffer, &hwcSlot, &hwcBuffer);
+    EXPECT_EQ(buffer, hwcBuffer);
+    const uint32_t firstSlot = hwcSlot;
+
+    cache.getHwcBuffer(3, buffer, &hwcSlot, &hwcBuffer);
+    EXPECT_EQ(nullptr, hwcBuffer);
+    EXPECT_EQ(firstSlot, hwcSlot);
+    EXPECT_EQ(1u, cache.getHitCount());
+    EXPECT_EQ(1u, cache.getMissCount());
+}
+
+TEST(HWComposerBufferCacheTest, hitsWhenBufferMovesToAnotherSlot) {
+    HWComposerBufferCache cache;
+    sp<GraphicBuffer> buffer = new GraphicBuffer();
+    uint32_t hwcSlot;
+    sp<GraphicBuffer> hwcBuffer;
+
+    cache.getHwcBuffer(0, buffer, &hwcSlot, &hwcBuffer);
+    const uint32_t firstSlot = hwcSlot;
+
+    cache.getHwcBuffer(5, buffer, &hwcSlot, &hwcBuffer);
+    EXPECT_EQ(nullptr, hwcBuffer);
+    EXPECT_EQ(firstSlot, hwcSlot);
+}
+
+TEST(HWComposerBufferCacheTest, reusesHwcSlotOfReplacedBuffer) {
+    HWComposerBufferCache cache;
+    sp<GraphicBuffer> a = new GraphicBuffer();
+    sp<GraphicBuffer> b = new GraphicBuffer();
+    sp<GraphicBuffer> c = new GraphicBuffer();
+    uint32_t slotA, slotB, slotC;
+    sp<GraphicBuffer> hwcBuffer;
+
+    cache.getHwcBuffer(0, a, &slotA, &hwcBuffer);
+    cache.getHwcBuffer(1, b, &slotB, &hwcBuffer);
+    EXPECT_NE(slotA, slotB);
+
+    // c was reallocated in a's slot, so a will never come back
+    cache.getHwcBuffer(0, c, &slotC, &hwcBuffer);
+    EXPECT_EQ(c, hwcBuffer);
+    EXPECT_EQ(slotA, slotC);
+
+    cache.getHwcBuffer(1, b, &slotB, &hwcBuffer);
+    EXPECT_EQ(nullptr, hwcBuffer);
+}
+
+} // namespace
+} // namespace android
@@ -0,0 +1,80 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#undef LOG_TAG
+#define LOG_TAG "LibSurfaceFlingerUnittests"
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "RecyclingQueue.h"
+
+namespace android {
+namespace {
+
+TEST(RecyclingQueueTest, startsEmpty) {
+    RecyclingQueue<int> queue;
+    EXPECT_TRUE(queue.empty());
+    EXPECT_EQ(0u, queue.size());
+}
+
+TEST(RecyclingQueueTest, popsInPushOrder) {
+    RecyclingQueue<std::string> queue;
+    queue.push_back("a");
+    queue.push_back("b");
+    queue.push_back("c");
+    ASSERT_EQ(3u, queue.size());
+    EXPECT_EQ("a", queue.front());
+    queue.pop_front();
+    EXPECT_EQ("b", queue.front());
+    queue.pop_front();
+    EXPECT_EQ("c", queue.front());
+    queue.pop_front();
+    EXPECT_TRUE(queue.empty());
+}
+
+TEST(RecyclingQueueTest, keepsOrderWhenGrowingAfterWrapping) {
+    RecyclingQueue<int> queue;
+    for (int i = 0; i < 4; i++) {
+        queue.push_back(i);
+    }
+    // move the head so the next pushes wrap around the ring
+    queue.pop_front();
+    queue.pop_front();
+    for (int i = 4; i < 10; i++) {
+        queue.push_back(i);
+    }
+
+    ASSERT_EQ(8u, queue.size());
+    for (size_t i = 0; i < queue.size(); i++) {
+        EXPECT_EQ(static_cast<int>(i) + 2, queue[i]);
+    }
+}
+
+TEST(RecyclingQueueTest, indexesFromFront) {
+    RecyclingQueue<int> queue;
+    queue.push_back(1);
+    queue.push_back(2);
+    queue.pop_front();
+    queue.push_back(3);
+    queue[1] = 5;
+    EXPECT_EQ(2, queue[0]);
+    EXPECT_EQ(5, queue[1]);
+}
+
+} // namespace
+} // namespace android
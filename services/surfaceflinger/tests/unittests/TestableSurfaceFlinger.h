@@ -154,6 +154,8 @@ public:
         FakePowerAdvisor() = default;
         ~FakePowerAdvisor() override = default;
         void setExpensiveRenderingExpected(hwc2_display_t, bool) override { }
+        void setClientCompositionLoad(hwc2_display_t,
+                                      const Hwc2::ClientCompositionLoad&) override { }
     };
 
     struct HWC2Display : public HWC2::Display {
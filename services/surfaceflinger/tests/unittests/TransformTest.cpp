@@ -0,0 +1,158 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#undef LOG_TAG
+#define LOG_TAG "LibSurfaceFlingerUnittests"
+
+#include <math.h>
+#include <stdlib.h>
+
+#include <algorithm>
+
+#include <gtest/gtest.h>
+
+#include <ui/Region.h>
+
+#include "Transform.h"
+
+namespace android {
+namespace {
+
+const uint32_t kOrientations[] = {
+        Transform::ROT_0,  Transform::FLIP_H,  Transform::FLIP_V,  Transform::ROT_180,
+        Transform::ROT_90, Transform::ROT_90 | Transform::FLIP_H,
+        Transform::ROT_90 | Transform::FLIP_V, Transform::ROT_270,
+};
+
+// Transform::transform(Rect) the way it always computes it: through the
+// matrix, in float
+Rect referenceTransform(const Transform& t, const Rect& bounds, bool roundOutwards) {
+    float xs[4];
+    float ys[4];
+    const int32_t corners[4][2] = {
+            {bounds.left, bounds.top},
+            {bounds.right, bounds.top},
+            {bounds.left, bounds.bottom},
+            {bounds.right, bounds.bottom},
+    };
+    for (size_t i = 0; i < 4; i++) {
+        const float x = corners[i][0];
+        const float y = corners[i][1];
+        xs[i] = t[0][0] * x + t[1][0] * y + t[2][0];
+        ys[i] = t[0][1] * x + t[1][1] * y + t[2][1];
+    }
+    const float left = *std::min_element(xs, xs + 4);
+    const float top = *std::min_element(ys, ys + 4);
+    const float right = *std::max_element(xs, xs + 4);
+    const float bottom = *std::max_element(ys, ys + 4);
+    if (roundOutwards) {
+        return Rect(floorf(left), floorf(top), ceilf(right), ceilf(bottom));
+    }
+    return Rect(floorf(left + 0.5f), floorf(top + 0.5f), floorf(right + 0.5f),
+                floorf(bottom + 0.5f));
+}
+
+Region referenceTransform(const Transform& t, const Region& region) {
+    Region out;
+    for (const Rect& r : region) {
+        out.orSelf(referenceTransform(t, r, false));
+    }
+    return out;
+}
+
+void expectSameRects(const Region& expected, const Region& actual) {
+    size_t expectedCount;
+    size_t actualCount;
+    const Rect* expectedRects = expected.getArray(&expectedCount);
+    const Rect* actualRects = actual.getArray(&actualCount);
+    ASSERT_EQ(expectedCount, actualCount);
+    for (size_t i = 0; i < expectedCount; i++) {
+        EXPECT_EQ(expectedRects[i], actualRects[i]) << "rect " << i;
+    }
+    EXPECT_EQ(expected.getBounds(), actual.getBounds());
+}
+
+Rect randomRect() {
+    const int32_t left = rand() % 1000 - 200;
+    const int32_t top = rand() % 1000 - 200;
+    return Rect(left, top, left + 1 + rand() % 300, top + 1 + rand() % 300);
+}
+
+TEST(TransformTest, classifiesWhenSet) {
+    Transform t;
+    EXPECT_EQ(Transform::IDENTITY, t.getType());
+
+    t.set(Transform::ROT_90, 100, 200);
+    EXPECT_EQ(Transform::ROT_90, t.getOrientation());
+    EXPECT_EQ(uint32_t(Transform::ROTATE | Transform::TRANSLATE), t.getType());
+
+    t.set(0, 2, 2, 0);
+    EXPECT_EQ(Transform::ROT_90 | Transform::FLIP_V, t.getOrientation());
+    EXPECT_TRUE(t.getType() & Transform::SCALE);
+
+    Transform a;
+    a.set(5, 3);
+    Transform b;
+    b.set(-5, -3);
+    EXPECT_EQ(Transform::TRANSLATE, a.getType());
+    EXPECT_EQ(Transform::IDENTITY, (a * b).getType());
+}
+
+TEST(TransformTest, rectsMatchMatrixMath) {
+    const float offsets[][2] = {{0, 0}, {100, -50}, {10.25f, 3.5f}, {-7.5f, 0.75f}};
+    srand(1);
+    for (uint32_t orientation : kOrientations) {
+        for (const auto& offset : offsets) {
+            Transform translate;
+            translate.set(offset[0], offset[1]);
+            const Transform t = translate * Transform(orientation);
+            for (size_t i = 0; i < 100; i++) {
+                const Rect r = randomRect();
+                EXPECT_EQ(referenceTransform(t, r, false), t.transform(r));
+                EXPECT_EQ(referenceTransform(t, r, true), t.transform(r, true));
+            }
+        }
+    }
+}
+
+TEST(TransformTest, hugeRectsMatchMatrixMath) {
+    Transform t(Transform::ROT_90);
+    const Rect r(0, 0, 1 << 24, 100);
+    EXPECT_EQ(referenceTransform(t, r, false), t.transform(r));
+}
+
+TEST(TransformTest, regionsMatchMatrixMath) {
+    srand(2);
+    for (size_t i = 0; i < 20; i++) {
+        Region region;
+        for (size_t j = 0; j < 10; j++) {
+            region.orSelf(randomRect());
+        }
+        for (uint32_t orientation : kOrientations) {
+            Transform translate;
+            translate.set(37, -12);
+            const Transform t = translate * Transform(orientation);
+            expectSameRects(referenceTransform(t, region), t.transform(region));
+
+            Transform scaled;
+            scaled.set(0, 1.5f, 0.5f, 0);
+            expectSameRects(referenceTransform(scaled, region), scaled.transform(region));
+        }
+    }
+}
+
+} // namespace
+} // namespace android
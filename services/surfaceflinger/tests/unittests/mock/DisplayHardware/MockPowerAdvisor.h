@@ -30,6 +30,8 @@ public:
     ~PowerAdvisor() override;
 
     MOCK_METHOD2(setExpensiveRenderingExpected, void(hwc2_display_t displayId, bool expected));
+    MOCK_METHOD2(setClientCompositionLoad,
+                 void(hwc2_display_t displayId, const ClientCompositionLoad& load));
 };
 
 } // namespace mock
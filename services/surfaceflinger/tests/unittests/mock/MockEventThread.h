@@ -34,6 +34,7 @@ public:
     MOCK_METHOD2(onHotplugReceived, void(int, bool));
     MOCK_CONST_METHOD1(dump, void(String8&));
     MOCK_METHOD1(setPhaseOffset, void(nsecs_t phaseOffset));
+    MOCK_METHOD1(setIdle, void(bool));
 };
 
 } // namespace mock
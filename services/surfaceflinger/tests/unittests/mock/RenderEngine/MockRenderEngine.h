@@ -35,7 +35,7 @@ public:
 
     MOCK_METHOD0(createSurface, std::unique_ptr<RE::Surface>());
     MOCK_METHOD0(createImage, std::unique_ptr<RE::Image>());
-    MOCK_CONST_METHOD0(primeCache, void());
+    MOCK_CONST_METHOD1(primeCache, void(const std::string&));
     MOCK_METHOD1(dump, void(String8&));
     MOCK_CONST_METHOD0(supportsImageCrop, bool());
     MOCK_CONST_METHOD0(isCurrent, bool());
@@ -91,6 +91,7 @@ public:
     MOCK_CONST_METHOD0(queryAlphaSize, int32_t());
     MOCK_CONST_METHOD0(queryWidth, int32_t());
     MOCK_CONST_METHOD0(queryHeight, int32_t());
+    MOCK_CONST_METHOD0(queryBufferAge, int32_t());
 };
 
 class Image : public RE::Image {
@@ -48,7 +48,10 @@ public:
     MOCK_METHOD1(setTransformHint, status_t(uint32_t));
     MOCK_CONST_METHOD1(getSidebandStream, status_t(sp<NativeHandle>*));
     MOCK_METHOD2(getOccupancyHistory, status_t(bool, std::vector<OccupancyTracker::Segment>*));
+    MOCK_METHOD2(getLatencyStats, status_t(bool, LatencyTracker::Stats*));
     MOCK_METHOD0(discardFreeBuffers, status_t());
+    MOCK_METHOD1(setAdaptiveBufferCount, status_t(bool));
+    MOCK_METHOD1(setBufferPreallocation, status_t(bool));
     MOCK_CONST_METHOD2(dumpState, status_t(const String8&, String8*));
 };
 
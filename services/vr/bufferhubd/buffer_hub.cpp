@@ -6,6 +6,7 @@
 #include <utils/Trace.h>
 
 #include <iomanip>
+#include <iterator>
 #include <memory>
 #include <sstream>
 #include <string>
@@ -35,6 +36,30 @@ BufferHubService::~BufferHubService() {}
 
 bool BufferHubService::IsInitialized() const { return BASE::IsInitialized(); }
 
+bool BufferHubService::TakePooledBuffer(const BufferPoolKey& key,
+                                        IonBuffer* buffer,
+                                        IonBuffer* metadata_buffer) {
+  // Prefer the most recently pooled buffer, which is the likeliest to still be
+  // warm in the caches.
+  for (auto it = buffer_pool_.rbegin(); it != buffer_pool_.rend(); ++it) {
+    if (it->key == key) {
+      *buffer = std::move(it->buffer);
+      *metadata_buffer = std::move(it->metadata_buffer);
+      buffer_pool_.erase(std::next(it).base());
+      return true;
+    }
+  }
+  return false;
+}
+
+void BufferHubService::ReturnPooledBuffer(const BufferPoolKey& key,
+                                          IonBuffer buffer,
+                                          IonBuffer metadata_buffer) {
+  if (buffer_pool_.size() >= kMaxPooledBuffers)
+    buffer_pool_.pop_front();
+  buffer_pool_.push_back({key, std::move(buffer), std::move(metadata_buffer)});
+}
+
 std::string BufferHubService::DumpState(size_t /*max_length*/) {
   std::ostringstream stream;
   auto channels = GetChannels<BufferHubChannel>();
@@ -218,6 +243,9 @@ std::string BufferHubService::DumpState(size_t /*max_length*/) {
     }
   }
 
+  stream << std::endl;
+  stream << "Pooled Buffers: " << buffer_pool_.size() << std::endl;
+
   return stream.str();
 }
 
@@ -1,8 +1,10 @@
 #ifndef ANDROID_DVR_BUFFERHUBD_BUFFER_HUB_H_
 #define ANDROID_DVR_BUFFERHUBD_BUFFER_HUB_H_
 
+#include <deque>
 #include <memory>
 #include <string>
+#include <tuple>
 #include <unordered_map>
 
 #include <hardware/gralloc.h>
@@ -141,9 +143,49 @@ class BufferHubService : public pdx::ServiceBase<BufferHubService> {
   bool IsInitialized() const override;
   std::string DumpState(size_t max_length) override;
 
+  // Identifies the buffers a closed queue buffer may be reused for. Buffers are
+  // only handed back to the process that allocated them, as its clients may
+  // still have the memory mapped.
+  struct BufferPoolKey {
+    pid_t process_id;
+    uint32_t width;
+    uint32_t height;
+    uint32_t layer_count;
+    uint32_t format;
+    uint64_t usage;
+    size_t user_metadata_size;
+
+    bool operator==(const BufferPoolKey& other) const {
+      return std::tie(process_id, width, height, layer_count, format, usage,
+                      user_metadata_size) ==
+             std::tie(other.process_id, other.width, other.height,
+                      other.layer_count, other.format, other.usage,
+                      other.user_metadata_size);
+    }
+  };
+
+  // Moves a pooled buffer matching |key| into |buffer| and |metadata_buffer|.
+  // Returns false if there is none.
+  bool TakePooledBuffer(const BufferPoolKey& key, IonBuffer* buffer,
+                        IonBuffer* metadata_buffer);
+
+  // Keeps the unlocked buffers of a closed queue buffer for reuse, dropping
+  // the oldest pooled buffer once there are kMaxPooledBuffers.
+  void ReturnPooledBuffer(const BufferPoolKey& key, IonBuffer buffer,
+                          IonBuffer metadata_buffer);
+
  private:
   friend BASE;
 
+  // Enough for a couple of eye buffer queues to be recreated.
+  static constexpr size_t kMaxPooledBuffers = 16;
+
+  struct PooledBuffer {
+    BufferPoolKey key;
+    IonBuffer buffer;
+    IonBuffer metadata_buffer;
+  };
+
   pdx::Status<void> OnCreateBuffer(pdx::Message& message, uint32_t width,
                                    uint32_t height, uint32_t format,
                                    uint64_t usage, size_t meta_size_bytes);
@@ -156,6 +198,9 @@ class BufferHubService : public pdx::ServiceBase<BufferHubService> {
       pdx::Message& message, const ProducerQueueConfig& producer_config,
       const UsagePolicy& usage_policy);
 
+  // Oldest first.
+  std::deque<PooledBuffer> buffer_pool_;
+
   BufferHubService(const BufferHubService&) = delete;
   void operator=(const BufferHubService&) = delete;
 };
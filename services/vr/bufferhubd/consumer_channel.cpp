@@ -169,6 +169,7 @@ Status<void> ConsumerChannel::OnConsumerSetIgnore(Message&, bool ignored) {
     return ErrorStatus(EPIPE);
 
   ignored_ = ignored;
+  producer->UpdateActiveConsumer(consumer_state_bit_, !ignored_);
   if (ignored_ && acquired_) {
     // Update the producer if ignore is set after the consumer acquires the
     // buffer.
@@ -65,8 +65,6 @@ ProducerChannel::ProducerChannel(BufferHubService* service, int channel_id,
                                  uint64_t usage, size_t user_metadata_size,
                                  int* error)
     : BufferHubChannel(service, channel_id, channel_id, kProducerType),
-      pending_consumers_(0),
-      producer_owns_(true),
       user_metadata_size_(user_metadata_size),
       metadata_buf_size_(BufferHubDefs::kMetadataHeaderSize +
                          user_metadata_size) {
@@ -107,6 +105,8 @@ int ProducerChannel::InitializeBuffer() {
       new (&metadata_header_->buffer_state) std::atomic<uint64_t>(0);
   fence_state_ =
       new (&metadata_header_->fence_state) std::atomic<uint64_t>(0);
+  new (&metadata_header_->active_consumer_state) std::atomic<uint64_t>(0);
+  new (&metadata_header_->pending_consumer_state) std::atomic<uint64_t>(0);
 
   acquire_fence_fd_.Reset(epoll_create1(EPOLL_CLOEXEC));
   release_fence_fd_.Reset(epoll_create1(EPOLL_CLOEXEC));
@@ -174,6 +174,16 @@ ProducerChannel::~ProducerChannel() {
     consumer->OnProducerClosed();
   }
   Hangup();
+
+  if (pool_key_ && buffer_.IsValid()) {
+    if (int ret = metadata_buffer_.Unlock()) {
+      ALOGE("ProducerChannel::~ProducerChannel: Failed to unlock metadata: %s",
+            strerror(-ret));
+      return;
+    }
+    service()->ReturnPooledBuffer(*pool_key_, std::move(buffer_),
+                                  std::move(metadata_buffer_));
+  }
 }
 
 BufferHubChannel::BufferInfo ProducerChannel::GetBufferInfo() const {
@@ -296,6 +306,7 @@ Status<RemoteChannelHandle> ProducerChannel::CreateConsumer(Message& message) {
   }
 
   active_consumer_bit_mask_ |= consumer_state_bit;
+  UpdateActiveConsumer(consumer_state_bit, true);
   return {status.take()};
 }
 
@@ -550,6 +561,31 @@ void ProducerChannel::OnConsumerOrphaned(ConsumerChannel* channel) {
       buffer_state_->load(), fence_state_->load());
 }
 
+void ProducerChannel::UpdateActiveConsumer(uint64_t consumer_state_bit,
+                                           bool active) {
+  if (active) {
+    const uint64_t active_state =
+        metadata_header_->active_consumer_state.fetch_or(consumer_state_bit);
+    // A buffer posted with PostDirect() still looks owned by the producer from
+    // here. Consumers joining it are waited for, the same way new consumers
+    // are signalled on a buffer posted through bufferhubd.
+    if (!(active_state & consumer_state_bit) && producer_owns_ &&
+        (buffer_state_->load() & BufferHubDefs::kProducerStateBit)) {
+      metadata_header_->pending_consumer_state.fetch_or(consumer_state_bit);
+    }
+  } else {
+    metadata_header_->active_consumer_state.fetch_and(~consumer_state_bit);
+    // Consumers that stop listening or go away count as released.
+    if (BufferHubDefs::ReleasePendingConsumers(metadata_header_,
+                                               consumer_state_bit)) {
+      ALOGD_IF(TRACE,
+               "ProducerChannel::UpdateActiveConsumer: released buffer_id=%d "
+               "for consumer_state_bit=%" PRIx64 ".",
+               buffer_id(), consumer_state_bit);
+    }
+  }
+}
+
 void ProducerChannel::AddConsumer(ConsumerChannel* channel) {
   consumer_channels_.push_back(channel);
 }
@@ -567,6 +603,7 @@ void ProducerChannel::RemoveConsumer(ConsumerChannel* channel) {
     // orphaned before remove it from producer.
     OnConsumerOrphaned(channel);
   }
+  UpdateActiveConsumer(channel->consumer_state_bit(), false);
 
   if (BufferHubDefs::IsBufferReleased(buffer_state) ||
       BufferHubDefs::IsBufferGained(buffer_state)) {
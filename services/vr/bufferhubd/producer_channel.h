@@ -60,6 +60,10 @@ class ProducerChannel : public BufferHubChannel {
   void OnConsumerIgnored();
   void OnConsumerOrphaned(ConsumerChannel* channel);
 
+  // Adds a consumer to or removes it from the consumers that take part in
+  // buffer cycles driven by the clients alone.
+  void UpdateActiveConsumer(uint64_t consumer_state_bit, bool active);
+
   void AddConsumer(ConsumerChannel* channel);
   void RemoveConsumer(ConsumerChannel* channel);
 
@@ -67,11 +71,17 @@ class ProducerChannel : public BufferHubChannel {
                        uint32_t format, uint64_t usage,
                        size_t user_metadata_size);
 
+  // Hands the buffers back to the service's pool under |key| once this channel
+  // is closed, unless they were detached by then.
+  void SetPoolKey(const BufferHubService::BufferPoolKey& key) {
+    pool_key_.reset(new BufferHubService::BufferPoolKey(key));
+  }
+
  private:
   std::vector<ConsumerChannel*> consumer_channels_;
   // This counts the number of consumers left to process this buffer. If this is
   // zero then the producer can re-acquire ownership.
-  int pending_consumers_;
+  int pending_consumers_{0};
 
   IonBuffer buffer_;
 
@@ -88,7 +98,7 @@ class ProducerChannel : public BufferHubChannel {
   // highest bit is reserved for the producer and should not be set.
   uint64_t orphaned_consumer_bit_mask_{0ULL};
 
-  bool producer_owns_;
+  bool producer_owns_{true};
   LocalFence post_fence_;
   LocalFence returned_fence_;
   size_t user_metadata_size_;  // size of user requested buffer buffer size.
@@ -98,6 +108,8 @@ class ProducerChannel : public BufferHubChannel {
   pdx::LocalHandle release_fence_fd_;
   pdx::LocalHandle dummy_fence_fd_;
 
+  std::unique_ptr<BufferHubService::BufferPoolKey> pool_key_;
+
   ProducerChannel(BufferHubService* service, int buffer_id, int channel_id,
                   IonBuffer buffer, IonBuffer metadata_buffer,
                   size_t user_metadata_size, int* error);
@@ -222,17 +222,39 @@ ProducerQueueChannel::AllocateBuffer(Message& message, uint32_t width,
            buffer_id, width, height, layer_count, format, usage);
   auto buffer_handle = status.take();
 
-  auto producer_channel_status =
-      ProducerChannel::Create(service(), buffer_id, width, height, layer_count,
-                              format, usage, config_.user_metadata_size);
-  if (!producer_channel_status) {
-    ALOGE(
-        "ProducerQueueChannel::AllocateBuffer: Failed to create producer "
-        "buffer: %s",
-        producer_channel_status.GetErrorMessage().c_str());
-    return ErrorStatus(ENOMEM);
+  // Reuse the buffers of a queue buffer closed earlier if there are any, which
+  // saves the allocation when a queue gets recreated.
+  const BufferHubService::BufferPoolKey pool_key{
+      message.GetProcessId(), width, height, layer_count, format, usage,
+      config_.user_metadata_size};
+  std::shared_ptr<ProducerChannel> producer_channel;
+  IonBuffer pooled_buffer;
+  IonBuffer pooled_metadata_buffer;
+  if (service()->TakePooledBuffer(pool_key, &pooled_buffer,
+                                  &pooled_metadata_buffer)) {
+    ALOGD_IF(TRACE,
+             "ProducerQueueChannel::AllocateBuffer: reusing a pooled buffer "
+             "for buffer_id=%d",
+             buffer_id);
+    producer_channel = ProducerChannel::Create(
+        service(), buffer_id, buffer_id, std::move(pooled_buffer),
+        std::move(pooled_metadata_buffer), config_.user_metadata_size);
+  }
+
+  if (!producer_channel) {
+    auto producer_channel_status = ProducerChannel::Create(
+        service(), buffer_id, width, height, layer_count, format, usage,
+        config_.user_metadata_size);
+    if (!producer_channel_status) {
+      ALOGE(
+          "ProducerQueueChannel::AllocateBuffer: Failed to create producer "
+          "buffer: %s",
+          producer_channel_status.GetErrorMessage().c_str());
+      return ErrorStatus(ENOMEM);
+    }
+    producer_channel = producer_channel_status.take();
   }
-  auto producer_channel = producer_channel_status.take();
+  producer_channel->SetPoolKey(pool_key);
 
   ALOGD_IF(
       TRACE,
@@ -1,11 +1,36 @@
 #include "aidl/android/dvr/parcelable_composer_frame.h"
 
 #include <binder/Parcel.h>
+#include <inttypes.h>
+#include <log/log.h>
+
+#include <mutex>
 
 #include "aidl/android/dvr/parcelable_composer_layer.h"
 
 namespace android {
 namespace dvr {
+namespace {
+
+// The buffers this process received from the frames of each display, for
+// the following frames to reference by ID.
+struct ReceivedBuffers {
+  std::mutex mutex;
+  std::unordered_map<Display,
+                     std::unordered_map<uint64_t, sp<GraphicBuffer>>> buffers;
+};
+
+ReceivedBuffers& GetReceivedBuffers() {
+  static ReceivedBuffers* received_buffers = new ReceivedBuffers();
+  return *received_buffers;
+}
+
+}  // namespace
+
+void ComposerFrameBufferCache::Reset() {
+  reset_ = true;
+  sent_buffers_.clear();
+}
 
 ParcelableComposerFrame::ParcelableComposerFrame() {}
 
@@ -13,6 +38,10 @@ ParcelableComposerFrame::ParcelableComposerFrame(
     const ComposerView::Frame& frame)
     : frame_(frame) {}
 
+ParcelableComposerFrame::ParcelableComposerFrame(
+    const ComposerView::Frame& frame, ComposerFrameBufferCache* buffer_cache)
+    : frame_(frame), buffer_cache_(buffer_cache) {}
+
 ParcelableComposerFrame::~ParcelableComposerFrame() {}
 
 status_t ParcelableComposerFrame::writeToParcel(Parcel* parcel) const {
@@ -48,13 +77,55 @@ status_t ParcelableComposerFrame::writeToParcel(Parcel* parcel) const {
     if (ret != OK) return ret;
   }
 
-  std::vector<ParcelableComposerLayer> layers;
-  for (size_t i = 0; i < frame_.layers.size(); ++i)
-    layers.push_back(ParcelableComposerLayer(frame_.layers[i]));
+  // Without a cache every buffer is sent, and the receiver keeps none.
+  const bool cache_buffers = buffer_cache_ != nullptr;
+  ret = parcel->writeBool(cache_buffers);
+  if (ret != OK) return ret;
+
+  ret = parcel->writeBool(cache_buffers && buffer_cache_->reset_);
+  if (ret != OK) return ret;
+
+  std::unordered_set<uint64_t>* sent_buffers = nullptr;
+  if (cache_buffers) {
+    buffer_cache_->reset_ = false;
+    sent_buffers = &buffer_cache_->sent_buffers_[frame_.display_id];
+  }
+
+  ret = parcel->writeUint32(static_cast<uint32_t>(frame_.layers.size()));
+  if (ret != OK) return ret;
+
+  std::unordered_set<uint64_t> used_buffers;
+  for (const auto& layer : frame_.layers) {
+    const uint64_t buffer_id = layer.buffer->getId();
+    const bool with_buffer =
+        !sent_buffers || sent_buffers->find(buffer_id) == sent_buffers->end();
+    ret = ParcelableComposerLayer::WriteLayer(layer, with_buffer, parcel);
+    if (ret != OK) return ret;
+    used_buffers.insert(buffer_id);
+  }
+
+  // The buffers this frame no longer uses are gone for good, since VR HWC
+  // wraps each buffer a layer is given anew.
+  std::vector<uint64_t> dropped_buffers;
+  if (sent_buffers) {
+    for (uint64_t buffer_id : *sent_buffers) {
+      if (used_buffers.find(buffer_id) == used_buffers.end())
+        dropped_buffers.push_back(buffer_id);
+    }
+    sent_buffers->swap(used_buffers);
+    if (sent_buffers->empty())
+      buffer_cache_->sent_buffers_.erase(frame_.display_id);
+  }
 
-  ret = parcel->writeParcelableVector(layers);
+  ret = parcel->writeUint32(static_cast<uint32_t>(dropped_buffers.size()));
+  if (ret != OK) return ret;
 
-  return ret;
+  for (uint64_t buffer_id : dropped_buffers) {
+    ret = parcel->writeUint64(buffer_id);
+    if (ret != OK) return ret;
+  }
+
+  return OK;
 }
 
 status_t ParcelableComposerFrame::readFromParcel(const Parcel* parcel) {
@@ -95,15 +166,61 @@ status_t ParcelableComposerFrame::readFromParcel(const Parcel* parcel) {
     if (ret != OK) return ret;
   }
 
-  std::vector<ParcelableComposerLayer> layers;
-  ret = parcel->readParcelableVector(&layers);
+  bool cache_buffers = false;
+  ret = parcel->readBool(&cache_buffers);
+  if (ret != OK) return ret;
+
+  bool reset_buffers = false;
+  ret = parcel->readBool(&reset_buffers);
   if (ret != OK) return ret;
 
-  frame_.layers.clear();
-  for (size_t i = 0; i < layers.size(); ++i)
-    frame_.layers.push_back(layers[i].layer());
+  ReceivedBuffers& received = GetReceivedBuffers();
+  std::lock_guard<std::mutex> guard(received.mutex);
+  if (reset_buffers)
+    received.buffers.clear();
+
+  auto& buffers = received.buffers[frame_.display_id];
+
+  uint32_t size;
+  ret = parcel->readUint32(&size);
+  if (ret != OK) return ret;
+
+  frame_.layers.resize(size);
+  for (auto& layer : frame_.layers) {
+    uint64_t buffer_id;
+    ret = ParcelableComposerLayer::ReadLayer(parcel, &layer, &buffer_id);
+    if (ret != OK) return ret;
+
+    if (layer.buffer.get()) {
+      if (cache_buffers)
+        buffers[buffer_id] = layer.buffer;
+      continue;
+    }
+
+    auto buffer = buffers.find(buffer_id);
+    if (buffer == buffers.end()) {
+      ALOGE("Frame references buffer %" PRIu64 " which was never received",
+            buffer_id);
+      return BAD_VALUE;
+    }
+    layer.buffer = buffer->second;
+  }
+
+  ret = parcel->readUint32(&size);
+  if (ret != OK) return ret;
+
+  for (size_t i = 0; i < size; i++) {
+    uint64_t buffer_id;
+    ret = parcel->readUint64(&buffer_id);
+    if (ret != OK) return ret;
+
+    buffers.erase(buffer_id);
+  }
+
+  if (buffers.empty())
+    received.buffers.erase(frame_.display_id);
 
-  return ret;
+  return OK;
 }
 
 }  // namespace dvr
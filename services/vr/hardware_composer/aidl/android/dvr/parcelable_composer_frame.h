@@ -4,22 +4,48 @@
 #include <binder/Parcelable.h>
 #include <impl/vr_hwc.h>
 
+#include <unordered_map>
+#include <unordered_set>
+
 namespace android {
 namespace dvr {
 
+// The buffers the receiver of the frames has imported, by display. A buffer
+// is sent with the first frame using it, and only referenced by its ID in
+// the following ones, until a frame of its display no longer uses it and
+// the receiver drops it.
+class ComposerFrameBufferCache {
+ public:
+  // Sends every buffer again with the next frame, which also tells the
+  // receiver to drop all it has. Needed when the receiver changes, or may
+  // have missed a frame.
+  void Reset();
+
+ private:
+  friend class ParcelableComposerFrame;
+
+  bool reset_ = true;
+  std::unordered_map<Display, std::unordered_set<uint64_t>> sent_buffers_;
+};
+
 class ParcelableComposerFrame : public Parcelable {
  public:
   ParcelableComposerFrame();
   ParcelableComposerFrame(const ComposerView::Frame& frame);
+  // Sends the buffers the receiver doesn't have yet only, as tracked by
+  // |buffer_cache|.
+  ParcelableComposerFrame(const ComposerView::Frame& frame,
+                          ComposerFrameBufferCache* buffer_cache);
   ~ParcelableComposerFrame() override;
 
-  ComposerView::Frame frame() const { return frame_; }
+  const ComposerView::Frame& frame() const { return frame_; }
 
   status_t writeToParcel(Parcel* parcel) const override;
   status_t readFromParcel(const Parcel* parcel) override;
 
  private:
   ComposerView::Frame frame_;
+  ComposerFrameBufferCache* buffer_cache_ = nullptr;  // Not owned.
 };
 
 }  // namespace dvr
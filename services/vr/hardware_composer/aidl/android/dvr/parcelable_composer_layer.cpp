@@ -16,82 +16,105 @@ ParcelableComposerLayer::ParcelableComposerLayer(
 ParcelableComposerLayer::~ParcelableComposerLayer() {}
 
 status_t ParcelableComposerLayer::writeToParcel(Parcel* parcel) const {
-  status_t ret = parcel->writeUint64(layer_.id);
+  return WriteLayer(layer_, true, parcel);
+}
+
+status_t ParcelableComposerLayer::readFromParcel(const Parcel* parcel) {
+  uint64_t buffer_id;
+  status_t ret = ReadLayer(parcel, &layer_, &buffer_id);
   if (ret != OK) return ret;
 
-  ret = parcel->write(*layer_.buffer);
+  // Without the frame, there is nothing to look a referenced buffer up in.
+  return layer_.buffer.get() ? OK : BAD_VALUE;
+}
+
+status_t ParcelableComposerLayer::WriteLayer(
+    const ComposerView::ComposerLayer& layer, bool with_buffer,
+    Parcel* parcel) {
+  status_t ret = parcel->writeUint64(layer.id);
   if (ret != OK) return ret;
 
-  ret = parcel->writeBool(layer_.fence->isValid());
+  ret = parcel->writeUint64(layer.buffer->getId());
   if (ret != OK) return ret;
 
-  if (layer_.fence->isValid()) {
-    ret = parcel->writeFileDescriptor(layer_.fence->dup(), true);
+  ret = parcel->writeBool(with_buffer);
+  if (ret != OK) return ret;
+
+  if (with_buffer) {
+    ret = parcel->write(*layer.buffer);
     if (ret != OK) return ret;
   }
 
-  ret = parcel->writeInt32(layer_.display_frame.left);
+  ret = parcel->writeBool(layer.fence->isValid());
   if (ret != OK) return ret;
 
-  ret = parcel->writeInt32(layer_.display_frame.top);
+  if (layer.fence->isValid()) {
+    ret = parcel->writeFileDescriptor(layer.fence->dup(), true);
+    if (ret != OK) return ret;
+  }
+
+  ret = parcel->writeInt32(layer.display_frame.left);
+  if (ret != OK) return ret;
+
+  ret = parcel->writeInt32(layer.display_frame.top);
   if (ret != OK) return ret;
 
-  ret = parcel->writeInt32(layer_.display_frame.right);
+  ret = parcel->writeInt32(layer.display_frame.right);
   if (ret != OK) return ret;
 
-  ret = parcel->writeInt32(layer_.display_frame.bottom);
+  ret = parcel->writeInt32(layer.display_frame.bottom);
   if (ret != OK) return ret;
 
-  ret = parcel->writeFloat(layer_.crop.left);
+  ret = parcel->writeFloat(layer.crop.left);
   if (ret != OK) return ret;
 
-  ret = parcel->writeFloat(layer_.crop.top);
+  ret = parcel->writeFloat(layer.crop.top);
   if (ret != OK) return ret;
 
-  ret = parcel->writeFloat(layer_.crop.right);
+  ret = parcel->writeFloat(layer.crop.right);
   if (ret != OK) return ret;
 
-  ret = parcel->writeFloat(layer_.crop.bottom);
+  ret = parcel->writeFloat(layer.crop.bottom);
   if (ret != OK) return ret;
 
-  ret = parcel->writeInt32(static_cast<int32_t>(layer_.blend_mode));
+  ret = parcel->writeInt32(static_cast<int32_t>(layer.blend_mode));
   if (ret != OK) return ret;
 
-  ret = parcel->writeFloat(layer_.alpha);
+  ret = parcel->writeFloat(layer.alpha);
   if (ret != OK) return ret;
 
-  ret = parcel->writeUint32(layer_.type);
+  ret = parcel->writeUint32(layer.type);
   if (ret != OK) return ret;
 
-  ret = parcel->writeUint32(layer_.app_id);
+  ret = parcel->writeUint32(layer.app_id);
   if (ret != OK) return ret;
 
-  ret = parcel->writeUint32(layer_.z_order);
+  ret = parcel->writeUint32(layer.z_order);
   if (ret != OK) return ret;
 
-  ret = parcel->writeInt32(layer_.cursor_x);
+  ret = parcel->writeInt32(layer.cursor_x);
   if (ret != OK) return ret;
 
-  ret = parcel->writeInt32(layer_.cursor_y);
+  ret = parcel->writeInt32(layer.cursor_y);
   if (ret != OK) return ret;
 
-  uint32_t color = layer_.color.r |
-      (static_cast<uint32_t>(layer_.color.g) << 8) |
-      (static_cast<uint32_t>(layer_.color.b) << 16) |
-      (static_cast<uint32_t>(layer_.color.a) << 24);
+  uint32_t color = layer.color.r |
+      (static_cast<uint32_t>(layer.color.g) << 8) |
+      (static_cast<uint32_t>(layer.color.b) << 16) |
+      (static_cast<uint32_t>(layer.color.a) << 24);
   ret = parcel->writeUint32(color);
   if (ret != OK) return ret;
 
-  ret = parcel->writeInt32(layer_.dataspace);
+  ret = parcel->writeInt32(layer.dataspace);
   if (ret != OK) return ret;
 
-  ret = parcel->writeInt32(layer_.transform);
+  ret = parcel->writeInt32(layer.transform);
   if (ret != OK) return ret;
 
-  ret = parcel->writeUint32(static_cast<uint32_t>(layer_.visible_regions.size()));
+  ret = parcel->writeUint32(static_cast<uint32_t>(layer.visible_regions.size()));
   if (ret != OK) return ret;
 
-  for (auto& rect: layer_.visible_regions) {
+  for (auto& rect: layer.visible_regions) {
     ret = parcel->writeInt32(rect.left);
     ret = parcel->writeInt32(rect.top);
     ret = parcel->writeInt32(rect.right);
@@ -99,10 +122,10 @@ status_t ParcelableComposerLayer::writeToParcel(Parcel* parcel) const {
     if (ret != OK) return ret;
   }
 
-  ret = parcel->writeUint32(static_cast<uint32_t>(layer_.damaged_regions.size()));
+  ret = parcel->writeUint32(static_cast<uint32_t>(layer.damaged_regions.size()));
   if (ret != OK) return ret;
 
-  for (auto& rect: layer_.damaged_regions) {
+  for (auto& rect: layer.damaged_regions) {
     ret = parcel->writeInt32(rect.left);
     ret = parcel->writeInt32(rect.top);
     ret = parcel->writeInt32(rect.right);
@@ -113,15 +136,27 @@ status_t ParcelableComposerLayer::writeToParcel(Parcel* parcel) const {
   return OK;
 }
 
-status_t ParcelableComposerLayer::readFromParcel(const Parcel* parcel) {
-  status_t ret = parcel->readUint64(&layer_.id);
+status_t ParcelableComposerLayer::ReadLayer(
+    const Parcel* parcel, ComposerView::ComposerLayer* layer,
+    uint64_t* buffer_id) {
+  status_t ret = parcel->readUint64(&layer->id);
+  if (ret != OK) return ret;
+
+  ret = parcel->readUint64(buffer_id);
+  if (ret != OK) return ret;
+
+  bool has_buffer = false;
+  ret = parcel->readBool(&has_buffer);
   if (ret != OK) return ret;
 
-  layer_.buffer = new GraphicBuffer();
-  ret = parcel->read(*layer_.buffer);
-  if (ret != OK) {
-    layer_.buffer.clear();
-    return ret;
+  layer->buffer.clear();
+  if (has_buffer) {
+    layer->buffer = new GraphicBuffer();
+    ret = parcel->read(*layer->buffer);
+    if (ret != OK) {
+      layer->buffer.clear();
+      return ret;
+    }
   }
 
   bool has_fence = 0;
@@ -129,73 +164,74 @@ status_t ParcelableComposerLayer::readFromParcel(const Parcel* parcel) {
   if (ret != OK) return ret;
 
   if (has_fence)
-    layer_.fence = new Fence(dup(parcel->readFileDescriptor()));
+    layer->fence = new Fence(dup(parcel->readFileDescriptor()));
   else
-    layer_.fence = new Fence();
+    layer->fence = new Fence();
 
-  ret = parcel->readInt32(&layer_.display_frame.left);
+  ret = parcel->readInt32(&layer->display_frame.left);
   if (ret != OK) return ret;
 
-  ret = parcel->readInt32(&layer_.display_frame.top);
+  ret = parcel->readInt32(&layer->display_frame.top);
   if (ret != OK) return ret;
 
-  ret = parcel->readInt32(&layer_.display_frame.right);
+  ret = parcel->readInt32(&layer->display_frame.right);
   if (ret != OK) return ret;
 
-  ret = parcel->readInt32(&layer_.display_frame.bottom);
+  ret = parcel->readInt32(&layer->display_frame.bottom);
   if (ret != OK) return ret;
 
-  ret = parcel->readFloat(&layer_.crop.left);
+  ret = parcel->readFloat(&layer->crop.left);
   if (ret != OK) return ret;
 
-  ret = parcel->readFloat(&layer_.crop.top);
+  ret = parcel->readFloat(&layer->crop.top);
   if (ret != OK) return ret;
 
-  ret = parcel->readFloat(&layer_.crop.right);
+  ret = parcel->readFloat(&layer->crop.right);
   if (ret != OK) return ret;
 
-  ret = parcel->readFloat(&layer_.crop.bottom);
+  ret = parcel->readFloat(&layer->crop.bottom);
   if (ret != OK) return ret;
 
-  ret = parcel->readInt32(reinterpret_cast<int32_t*>(&layer_.blend_mode));
+  ret = parcel->readInt32(reinterpret_cast<int32_t*>(&layer->blend_mode));
   if (ret != OK) return ret;
 
-  ret = parcel->readFloat(&layer_.alpha);
+  ret = parcel->readFloat(&layer->alpha);
   if (ret != OK) return ret;
 
-  ret = parcel->readUint32(&layer_.type);
+  ret = parcel->readUint32(&layer->type);
   if (ret != OK) return ret;
 
-  ret = parcel->readUint32(&layer_.app_id);
+  ret = parcel->readUint32(&layer->app_id);
   if (ret != OK) return ret;
 
-  ret = parcel->readUint32(&layer_.z_order);
+  ret = parcel->readUint32(&layer->z_order);
   if (ret != OK) return ret;
 
-  ret = parcel->readInt32(&layer_.cursor_x);
+  ret = parcel->readInt32(&layer->cursor_x);
   if (ret != OK) return ret;
 
-  ret = parcel->readInt32(&layer_.cursor_y);
+  ret = parcel->readInt32(&layer->cursor_y);
   if (ret != OK) return ret;
 
   uint32_t color;
   ret = parcel->readUint32(&color);
   if (ret != OK) return ret;
-  layer_.color.r = color & 0xFF;
-  layer_.color.g = (color >> 8) & 0xFF;
-  layer_.color.b = (color >> 16) & 0xFF;
-  layer_.color.a = (color >> 24) & 0xFF;
+  layer->color.r = color & 0xFF;
+  layer->color.g = (color >> 8) & 0xFF;
+  layer->color.b = (color >> 16) & 0xFF;
+  layer->color.a = (color >> 24) & 0xFF;
 
-  ret = parcel->readInt32(&layer_.dataspace);
+  ret = parcel->readInt32(&layer->dataspace);
   if (ret != OK) return ret;
 
-  ret = parcel->readInt32(&layer_.transform);
+  ret = parcel->readInt32(&layer->transform);
   if (ret != OK) return ret;
 
   uint32_t size;
   ret = parcel->readUint32(&size);
   if (ret != OK) return ret;
 
+  layer->visible_regions.clear();
   for(size_t i = 0; i < size; i++) {
     hwc_rect_t rect;
     ret = parcel->readInt32(&rect.left);
@@ -210,12 +246,13 @@ status_t ParcelableComposerLayer::readFromParcel(const Parcel* parcel) {
     ret = parcel->readInt32(&rect.bottom);
     if (ret != OK) return ret;
 
-    layer_.visible_regions.push_back(rect);
+    layer->visible_regions.push_back(rect);
   }
 
   ret = parcel->readUint32(&size);
   if (ret != OK) return ret;
 
+  layer->damaged_regions.clear();
   for(size_t i = 0; i < size; i++) {
     hwc_rect_t rect;
     ret = parcel->readInt32(&rect.left);
@@ -230,7 +267,7 @@ status_t ParcelableComposerLayer::readFromParcel(const Parcel* parcel) {
     ret = parcel->readInt32(&rect.bottom);
     if (ret != OK) return ret;
 
-    layer_.damaged_regions.push_back(rect);
+    layer->damaged_regions.push_back(rect);
   }
 
   return OK;
@@ -15,11 +15,21 @@ class ParcelableComposerLayer : public Parcelable {
   ParcelableComposerLayer(const ComposerView::ComposerLayer& layer);
   ~ParcelableComposerLayer() override;
 
-  ComposerView::ComposerLayer layer() const { return layer_; }
+  const ComposerView::ComposerLayer& layer() const { return layer_; }
 
   status_t writeToParcel(Parcel* parcel) const override;
   status_t readFromParcel(const Parcel* parcel) override;
 
+  // Writes |layer| with the ID of its buffer, and the buffer itself only if
+  // |with_buffer|, for a receiver that may already have imported it.
+  static status_t WriteLayer(const ComposerView::ComposerLayer& layer,
+                             bool with_buffer, Parcel* parcel);
+  // Reads what WriteLayer() wrote, leaving |layer->buffer| null when the
+  // buffer was only referenced by |buffer_id|.
+  static status_t ReadLayer(const Parcel* parcel,
+                            ComposerView::ComposerLayer* layer,
+                            uint64_t* buffer_id);
+
  private:
   ComposerView::ComposerLayer layer_;
 };
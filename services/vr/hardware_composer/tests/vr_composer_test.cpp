@@ -1,5 +1,6 @@
 #include <android/dvr/BnVrComposerCallback.h>
 #include <binder/IServiceManager.h>
+#include <binder/Parcel.h>
 #include <gtest/gtest.h>
 #include <sys/eventfd.h>
 #include <vr_composer.h>
@@ -168,5 +169,65 @@ TEST_F(VrComposerTest, TestWithOneLayer) {
   ASSERT_EQ(frame.layers[0].app_id, received_frame.layers[0].app_id);
 }
 
+TEST_F(VrComposerTest, TestBufferSentOnce) {
+  ComposerFrameBufferCache buffer_cache;
+  ComposerView::Frame frame;
+  frame.display_id = 1;
+  frame.layers.push_back(ComposerView::ComposerLayer{
+    .id = 1,
+    .buffer = CreateBuffer(),
+    .fence = new Fence(),
+  });
+
+  Parcel first_parcel;
+  ASSERT_EQ(OK, ParcelableComposerFrame(frame, &buffer_cache)
+                    .writeToParcel(&first_parcel));
+  first_parcel.setDataPosition(0);
+  ParcelableComposerFrame first_frame;
+  ASSERT_EQ(OK, first_frame.readFromParcel(&first_parcel));
+  ASSERT_EQ(1u, first_frame.frame().layers.size());
+  sp<GraphicBuffer> received_buffer = first_frame.frame().layers[0].buffer;
+  ASSERT_NE(nullptr, received_buffer.get());
+
+  // The same buffer again is only referenced.
+  Parcel second_parcel;
+  ASSERT_EQ(OK, ParcelableComposerFrame(frame, &buffer_cache)
+                    .writeToParcel(&second_parcel));
+  ASSERT_EQ(0u, second_parcel.objectsCount());
+  second_parcel.setDataPosition(0);
+  ParcelableComposerFrame second_frame;
+  ASSERT_EQ(OK, second_frame.readFromParcel(&second_parcel));
+  ASSERT_EQ(1u, second_frame.frame().layers.size());
+  ASSERT_EQ(received_buffer.get(),
+            second_frame.frame().layers[0].buffer.get());
+
+  // A new buffer is sent, and the one it replaces dropped.
+  frame.layers[0].buffer = CreateBuffer();
+  Parcel third_parcel;
+  ASSERT_EQ(OK, ParcelableComposerFrame(frame, &buffer_cache)
+                    .writeToParcel(&third_parcel));
+  ASSERT_LT(0u, third_parcel.objectsCount());
+  third_parcel.setDataPosition(0);
+  ParcelableComposerFrame third_frame;
+  ASSERT_EQ(OK, third_frame.readFromParcel(&third_parcel));
+  ASSERT_NE(received_buffer.get(),
+            third_frame.frame().layers[0].buffer.get());
+
+  // After a reset, the buffer is sent again.
+  buffer_cache.Reset();
+  Parcel reset_parcel;
+  ASSERT_EQ(OK, ParcelableComposerFrame(frame, &buffer_cache)
+                    .writeToParcel(&reset_parcel));
+  ASSERT_LT(0u, reset_parcel.objectsCount());
+  reset_parcel.setDataPosition(0);
+  ParcelableComposerFrame reset_frame;
+  ASSERT_EQ(OK, reset_frame.readFromParcel(&reset_parcel));
+
+  // A frame referencing a buffer that was dropped is rejected.
+  second_parcel.setDataPosition(0);
+  ParcelableComposerFrame stale_frame;
+  ASSERT_EQ(BAD_VALUE, stale_frame.readFromParcel(&second_parcel));
+}
+
 }  // namespace dvr
 }  // namespace android
@@ -44,6 +44,7 @@ binder::Status VrComposer::registerObserver(
     }
 
     callback_ = callback;
+    buffer_cache_.Reset();
     IInterface::asBinder(callback_)->linkToDeath(this);
   }
 
@@ -66,11 +67,14 @@ base::unique_fd VrComposer::OnNewFrame(const ComposerView::Frame& frame) {
   if (!callback_.get())
     return base::unique_fd();
 
-  ParcelableComposerFrame parcelable_frame(frame);
+  ParcelableComposerFrame parcelable_frame(frame, &buffer_cache_);
   ParcelableUniqueFd fence;
   binder::Status ret = callback_->onNewFrame(parcelable_frame, &fence);
-  if (!ret.isOk())
+  if (!ret.isOk()) {
     ALOGE("Failed to send new frame: %s", ret.toString8().string());
+    // The callback may not have seen the buffers of this frame.
+    buffer_cache_.Reset();
+  }
 
   return fence.fence();
 }
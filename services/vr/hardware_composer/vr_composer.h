@@ -40,6 +40,9 @@ class VrComposer
 
   sp<IVrComposerCallback> callback_;
 
+  // Buffers |callback_| has been sent already.
+  ComposerFrameBufferCache buffer_cache_;
+
   ComposerView* composer_view_;  // Not owned.
 
   VrComposer(const VrComposer&) = delete;
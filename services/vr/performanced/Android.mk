@@ -18,12 +18,18 @@ sourceFiles := \
 	cpu_set.cpp \
 	main.cpp \
 	performance_service.cpp \
-	task.cpp
+	placement_controller.cpp \
+	task.cpp \
+	thermal_telemetry.cpp
 
 staticLibraries := \
+	libbroadcastring \
 	libperformance \
 	libvr_manager
 
+headerLibraries := \
+	libdvr_headers
+
 sharedLibraries := \
 	libbinder \
 	libbase \
@@ -39,6 +45,7 @@ LOCAL_CFLAGS += -DTRACE=0
 LOCAL_CFLAGS += -Wall -Werror
 LOCAL_STATIC_LIBRARIES := $(staticLibraries)
 LOCAL_SHARED_LIBRARIES := $(sharedLibraries)
+LOCAL_HEADER_LIBRARIES := $(headerLibraries)
 LOCAL_MODULE := performanced
 LOCAL_INIT_RC := performanced.rc
 include $(BUILD_EXECUTABLE)
@@ -47,6 +54,7 @@ include $(CLEAR_VARS)
 LOCAL_SRC_FILES := performance_service_tests.cpp
 LOCAL_STATIC_LIBRARIES := $(staticLibraries) libgtest_main
 LOCAL_SHARED_LIBRARIES := $(sharedLibraries)
+LOCAL_HEADER_LIBRARIES := $(headerLibraries)
 LOCAL_MODULE := performance_service_tests
 LOCAL_MODULE_TAGS := optional
 include $(BUILD_NATIVE_TEST)
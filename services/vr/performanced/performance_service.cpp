@@ -20,6 +20,7 @@
 using android::dvr::IsTrustedUid;
 using android::dvr::Task;
 using android::pdx::ErrorStatus;
+using android::pdx::LocalHandle;
 using android::pdx::Message;
 using android::pdx::Status;
 using android::pdx::default_transport::Endpoint;
@@ -106,6 +107,9 @@ PerformanceService::PerformanceService()
            Endpoint::Create(PerformanceRPC::kClientPath)) {
   cpuset_.Load(kCpuSetBasePath);
 
+  // Telemetry is optional; OnGetTelemetryBuffer() reports when it is missing.
+  thermal_telemetry_ = ThermalTelemetry::Create();
+
   Task task(getpid());
   ALOGI("Running in cpuset=%s uid=%d gid=%d", task.GetCpuSetPath().c_str(),
         task.user_id()[Task::kUidReal], task.group_id()[Task::kUidReal]);
@@ -210,6 +214,17 @@ PerformanceService::PerformanceService()
         .scheduler_policy = SCHED_BATCH,
         .priority = 0}},
   };
+
+  placement_controller_ = std::make_unique<PlacementController>(
+      [this](pid_t task_id, const std::string& scheduler_policy) {
+        return ApplySchedulerPolicy(task_id, scheduler_policy);
+      },
+      [this](pid_t task_id, const std::string& path) -> Status<void> {
+        auto target_set = cpuset_.Lookup(path);
+        if (!target_set)
+          return ErrorStatus(ENOENT);
+        return target_set->AttachTask(task_id);
+      });
 }
 
 bool PerformanceService::IsInitialized() const {
@@ -218,7 +233,7 @@ bool PerformanceService::IsInitialized() const {
 }
 
 std::string PerformanceService::DumpState(size_t /*max_length*/) {
-  return cpuset_.DumpState();
+  return cpuset_.DumpState() + placement_controller_->DumpState();
 }
 
 Status<void> PerformanceService::OnSetSchedulerPolicy(
@@ -365,6 +380,74 @@ Status<std::string> PerformanceService::OnGetCpuPartition(Message& message,
   return task.GetCpuSetPath();
 }
 
+Status<void> PerformanceService::OnSetLatencyCritical(
+    Message& message, pid_t task_id, const std::string& boost_policy) {
+  Task task(task_id);
+  if (!task)
+    return ErrorStatus(EINVAL);
+
+  if (boost_policy.empty()) {
+    if (!CheckOr<SameProcess, Trusted>::Check(message, task))
+      return ErrorStatus(EINVAL);
+    placement_controller_->Unregister(task_id);
+    return {};
+  }
+
+  // The task will be boosted to the policy, so the sender must be allowed to
+  // apply it.
+  auto search = scheduler_policies_.find(boost_policy);
+  if (search == scheduler_policies_.end() ||
+      !search->second.IsAllowed(message, task)) {
+    ALOGE(
+        "PerformanceService::OnSetLatencyCritical: Invalid boost_policy=%s "
+        "requested for task=%d.",
+        boost_policy.c_str(), task_id);
+    return ErrorStatus(EINVAL);
+  }
+
+  return placement_controller_->Register(task_id, boost_policy);
+}
+
+Status<void> PerformanceService::ApplySchedulerPolicy(
+    pid_t task_id, const std::string& scheduler_policy) {
+  auto search = scheduler_policies_.find(scheduler_policy);
+  if (search == scheduler_policies_.end())
+    return ErrorStatus(EINVAL);
+  const SchedulerPolicyConfig& config = search->second;
+
+  if (!config.cpuset.empty()) {
+    auto target_set = cpuset_.Lookup(config.cpuset);
+    if (target_set) {
+      auto attach_status = target_set->AttachTask(task_id);
+      ALOGW_IF(!attach_status,
+               "PerformanceService::ApplySchedulerPolicy: Failed to attach "
+               "task=%d to cpuset=%s: %s",
+               task_id, config.cpuset.c_str(),
+               attach_status.GetErrorMessage().c_str());
+    }
+  }
+
+  struct sched_param param;
+  param.sched_priority = config.priority;
+
+  if (sched_setscheduler(task_id, config.scheduler_policy, &param) < 0)
+    return ErrorStatus(errno);
+  prctl(PR_SET_TIMERSLACK_PID, config.timer_slack, task_id);
+  return {};
+}
+
+Status<LocalHandle> PerformanceService::OnGetTelemetryBuffer(
+    Message& /*message*/) {
+  if (!thermal_telemetry_)
+    return ErrorStatus(ENODEV);
+
+  LocalHandle memory_fd =
+      LocalHandle::AsDuplicate(thermal_telemetry_->memory_fd());
+  if (!memory_fd)
+    return ErrorStatus(errno);
+  return {std::move(memory_fd)};
+}
+
 Status<void> PerformanceService::HandleMessage(Message& message) {
   ALOGD_IF(TRACE, "PerformanceService::HandleMessage: op=%d", message.GetOp());
   switch (message.GetOp()) {
@@ -388,6 +471,16 @@ Status<void> PerformanceService::HandleMessage(Message& message) {
           *this, &PerformanceService::OnGetCpuPartition, message);
       return {};
 
+    case PerformanceRPC::SetLatencyCritical::Opcode:
+      DispatchRemoteMethod<PerformanceRPC::SetLatencyCritical>(
+          *this, &PerformanceService::OnSetLatencyCritical, message);
+      return {};
+
+    case PerformanceRPC::GetTelemetryBuffer::Opcode:
+      DispatchRemoteMethod<PerformanceRPC::GetTelemetryBuffer>(
+          *this, &PerformanceService::OnGetTelemetryBuffer, message);
+      return {};
+
     default:
       return Service::HandleMessage(message);
   }
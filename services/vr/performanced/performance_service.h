@@ -8,7 +8,9 @@
 #include <pdx/service.h>
 
 #include "cpu_set.h"
+#include "placement_controller.h"
 #include "task.h"
+#include "thermal_telemetry.h"
 
 namespace android {
 namespace dvr {
@@ -38,8 +40,17 @@ class PerformanceService : public pdx::ServiceBase<PerformanceService> {
                                         const std::string& scheduler_class);
   pdx::Status<std::string> OnGetCpuPartition(pdx::Message& message,
                                              pid_t task_id);
+  pdx::Status<pdx::LocalHandle> OnGetTelemetryBuffer(pdx::Message& message);
+  pdx::Status<void> OnSetLatencyCritical(pdx::Message& message, pid_t task_id,
+                                         const std::string& boost_policy);
+
+  // Applies a scheduler policy, including its cpuset, without permission
+  // checks.
+  pdx::Status<void> ApplySchedulerPolicy(pid_t task_id,
+                                         const std::string& scheduler_policy);
 
   CpuSetManager cpuset_;
+  std::unique_ptr<ThermalTelemetry> thermal_telemetry_;
 
   int sched_fifo_min_priority_;
   int sched_fifo_max_priority_;
@@ -70,6 +81,9 @@ class PerformanceService : public pdx::ServiceBase<PerformanceService> {
   std::function<bool(const pdx::Message& message, const Task& task)>
       partition_permission_check_;
 
+  // Declared last so that its thread stops before anything it calls into.
+  std::unique_ptr<PlacementController> placement_controller_;
+
   PerformanceService(const PerformanceService&) = delete;
   void operator=(const PerformanceService&) = delete;
 };
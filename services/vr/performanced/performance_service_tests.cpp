@@ -1,6 +1,8 @@
 #include <errno.h>
 #include <sched.h>
 #include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
 
@@ -10,12 +12,15 @@
 #include <mutex>
 #include <sstream>
 #include <thread>
+#include <tuple>
 #include <utility>
 
 #include <android-base/unique_fd.h>
+#include <dvr/dvr_shared_buffers.h>
 #include <dvr/performance_client_api.h>
 #include <gtest/gtest.h>
 #include <private/android_filesystem_config.h>
+#include <private/dvr/performance_client.h>
 
 #include "stdio_filebuf.h"
 #include "string_trim.h"
@@ -527,3 +532,58 @@ TEST(PerformanceTest, Permissions) {
   ASSERT_EQ(0, setresuid(original_uid, original_uid, -1))
       << "Failed to restore uid: " << strerror(errno);
 }
+
+TEST(PerformanceTest, TelemetryBuffer) {
+  int error;
+  auto client = android::dvr::PerformanceClient::Create(&error);
+  ASSERT_NE(nullptr, client) << "Failed to connect: " << strerror(-error);
+
+  android::pdx::LocalHandle memory_fd;
+  ASSERT_EQ(0, client->GetTelemetryBuffer(&memory_fd));
+  ASSERT_TRUE(memory_fd.IsValid());
+
+  struct stat st;
+  ASSERT_EQ(0, fstat(memory_fd.Get(), &st));
+  const size_t mmap_size = st.st_size;
+
+  // Readers may not write into the ring.
+  EXPECT_EQ(MAP_FAILED, mmap(nullptr, mmap_size, PROT_READ | PROT_WRITE,
+                             MAP_SHARED, memory_fd.Get(), 0));
+
+  void* base =
+      mmap(nullptr, mmap_size, PROT_READ, MAP_SHARED, memory_fd.Get(), 0);
+  ASSERT_NE(MAP_FAILED, base);
+
+  android::dvr::DvrTelemetryRing ring;
+  bool import_ok;
+  std::tie(ring, import_ok) =
+      android::dvr::DvrTelemetryRing::Import(base, mmap_size);
+  EXPECT_TRUE(import_ok);
+
+  // Zones are sampled once a second, so wait a little longer for a record.
+  if (import_ok && access("/sys/class/thermal/thermal_zone0/temp", R_OK) == 0) {
+    uint32_t sequence = ring.GetOldestSequence();
+    DvrTelemetry record;
+    bool found = false;
+    for (int i = 0; i < 30 && !found; i++) {
+      found = ring.Get(&sequence, &record);
+      if (!found)
+        usleep(100000);
+    }
+    ASSERT_TRUE(found);
+    EXPECT_EQ(static_cast<uint32_t>(DVR_TELEMETRY_TYPE_THERMAL), record.type);
+    EXPECT_GE(record.value[0], 0);
+  }
+
+  munmap(base, mmap_size);
+}
+
+TEST(PerformanceTest, LatencyCritical) {
+  int error;
+  auto client = android::dvr::PerformanceClient::Create(&error);
+  ASSERT_NE(nullptr, client) << "Failed to connect: " << strerror(-error);
+
+  EXPECT_EQ(0, client->SetLatencyCritical(0, "normal"));
+  EXPECT_EQ(-EINVAL, client->SetLatencyCritical(0, "does-not-exist"));
+  EXPECT_EQ(0, client->SetLatencyCritical(0, ""));
+}
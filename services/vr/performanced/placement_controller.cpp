@@ -0,0 +1,352 @@
+#include "placement_controller.h"
+
+#include <errno.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <sstream>
+
+#include <android-base/file.h>
+#include <android-base/stringprintf.h>
+#include <log/log.h>
+
+#include "stdio_filebuf.h"
+#include "unique_file.h"
+
+using android::base::ReadFileToString;
+using android::base::StringPrintf;
+using android::pdx::ErrorStatus;
+using android::pdx::Status;
+
+namespace {
+
+const char kProcStatPath[] = "/proc/stat";
+const char kCpuMaxFreqPath[] =
+    "/sys/devices/system/cpu/cpu%d/cpufreq/cpuinfo_max_freq";
+
+constexpr std::chrono::milliseconds kControlPeriod{100};
+
+// A task waiting to run for more than this share of a period is contended.
+constexpr double kMaxWaitShare = 0.1;
+
+// A CPU idle for at least this share of a period takes latency-critical work.
+constexpr double kMinIdleShare = 0.5;
+
+// Contended periods in a row before a task is boosted; it is moved after one.
+constexpr int kBoostPeriods = 3;
+
+// Uncontended periods in a row before a task is released.
+constexpr int kReleasePeriods = 50;
+
+int64_t GetMonotonicNs() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+std::string CpuSetToString(const cpu_set_t& set) {
+  std::ostringstream stream;
+  bool first = true;
+  for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+    if (CPU_ISSET(cpu, &set)) {
+      stream << (first ? "" : ",") << cpu;
+      first = false;
+    }
+  }
+  return stream.str();
+}
+
+}  // anonymous namespace
+
+namespace android {
+namespace dvr {
+
+PlacementController::PlacementController(ApplyPolicyFunction apply_policy,
+                                         AttachCpuSetFunction attach_cpuset)
+    : apply_policy_(std::move(apply_policy)),
+      attach_cpuset_(std::move(attach_cpuset)) {
+  // Big cores are the ones that clock highest. Without cpufreq every CPU
+  // counts as big.
+  const long cpu_count = sysconf(_SC_NPROCESSORS_CONF);
+  std::vector<long> max_freqs;
+  long highest_freq = 0;
+  for (int cpu = 0; cpu < cpu_count; cpu++) {
+    std::string value;
+    long freq = 0;
+    if (ReadFileToString(StringPrintf(kCpuMaxFreqPath, cpu), &value))
+      freq = std::strtol(value.c_str(), nullptr, 10);
+    max_freqs.push_back(freq);
+    highest_freq = std::max(highest_freq, freq);
+  }
+  for (int cpu = 0; cpu < cpu_count; cpu++) {
+    if (max_freqs[cpu] == highest_freq)
+      big_cores_.push_back(cpu);
+  }
+  ALOGI("PlacementController: %zu of %ld cpus are big cores.",
+        big_cores_.size(), cpu_count);
+
+  control_thread_ = std::thread(&PlacementController::ControlThread, this);
+}
+
+PlacementController::~PlacementController() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_requested_ = true;
+  }
+  stop_condition_.notify_all();
+  if (control_thread_.joinable())
+    control_thread_.join();
+}
+
+Status<void> PlacementController::Register(pid_t task_id,
+                                           const std::string& boost_policy) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto search = tasks_.find(task_id);
+  if (search != tasks_.end()) {
+    search->second.boost_policy = boost_policy;
+    return {};
+  }
+
+  ManagedTask managed;
+  managed.task = std::make_unique<Task>(task_id);
+  if (!*managed.task)
+    return ErrorStatus(EINVAL);
+
+  sched_param param;
+  managed.original_policy = sched_getscheduler(task_id);
+  if (managed.original_policy < 0 || sched_getparam(task_id, &param) < 0 ||
+      sched_getaffinity(task_id, sizeof(managed.original_affinity),
+                        &managed.original_affinity) < 0) {
+    const int error = errno;
+    ALOGE("PlacementController::Register: Failed to read task_id=%d: %s",
+          task_id, strerror(error));
+    return ErrorStatus(error);
+  }
+  managed.original_priority = param.sched_priority;
+  managed.original_cpuset = managed.task->GetCpuSetPath();
+  managed.boost_policy = boost_policy;
+
+  tasks_.emplace(task_id, std::move(managed));
+  return {};
+}
+
+void PlacementController::Unregister(pid_t task_id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto search = tasks_.find(task_id);
+  if (search != tasks_.end()) {
+    ReleaseTask(task_id, &search->second);
+    tasks_.erase(search);
+  }
+}
+
+void PlacementController::ControlThread() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  int64_t last_time_ns = GetMonotonicNs();
+  while (!stop_requested_) {
+    stop_condition_.wait_for(lock, kControlPeriod,
+                             [this] { return stop_requested_; });
+    if (stop_requested_)
+      break;
+
+    const int64_t now_ns = GetMonotonicNs();
+    const int64_t period_ns = now_ns - last_time_ns;
+    last_time_ns = now_ns;
+    period_count_++;
+
+    SampleCpuLoad();
+    for (auto it = tasks_.begin(); it != tasks_.end();) {
+      if (UpdateTask(it->first, &it->second, period_ns)) {
+        ++it;
+      } else {
+        ALOGI("PlacementController: task_id=%d is gone.", it->first);
+        it = tasks_.erase(it);
+      }
+    }
+  }
+}
+
+void PlacementController::SampleCpuLoad() {
+  UniqueFile file{fopen(kProcStatPath, "r")};
+  if (!file)
+    return;
+
+  stdio_filebuf<char> filebuf(file.get());
+  std::istream file_stream(&filebuf);
+
+  // The per-cpu lines read "cpu<N> user nice system idle iowait irq ...".
+  for (std::string line; std::getline(file_stream, line);) {
+    if (line.compare(0, 3, "cpu") != 0 || line.size() < 4 ||
+        !isdigit(line[3])) {
+      continue;
+    }
+
+    char* end;
+    const size_t cpu = std::strtoul(line.c_str() + 3, &end, 10);
+    CpuSample sample;
+    for (int field = 0; *end != '\0'; field++) {
+      const char* start = end;
+      const uint64_t value = std::strtoull(start, &end, 10);
+      if (end == start)
+        break;
+      sample.total += value;
+      // idle and iowait.
+      if (field == 3 || field == 4)
+        sample.idle += value;
+    }
+
+    if (cpu >= cpu_samples_.size()) {
+      cpu_samples_.resize(cpu + 1);
+      cpu_idle_shares_.resize(cpu + 1, 0);
+    }
+
+    const CpuSample& last = cpu_samples_[cpu];
+    if (sample.total > last.total) {
+      cpu_idle_shares_[cpu] = static_cast<double>(sample.idle - last.idle) /
+                              (sample.total - last.total);
+    }
+    cpu_samples_[cpu] = sample;
+  }
+}
+
+cpu_set_t PlacementController::GetIdleBigCores() const {
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (int cpu : big_cores_) {
+    if (static_cast<size_t>(cpu) < cpu_idle_shares_.size() &&
+        cpu_idle_shares_[cpu] >= kMinIdleShare) {
+      CPU_SET(cpu, &set);
+    }
+  }
+
+  if (CPU_COUNT(&set) == 0) {
+    for (int cpu : big_cores_)
+      CPU_SET(cpu, &set);
+  }
+  return set;
+}
+
+bool PlacementController::UpdateTask(pid_t task_id, ManagedTask* managed,
+                                     int64_t period_ns) {
+  uint64_t runtime_ns, run_delay_ns;
+  if (!managed->task->GetSchedStat(&runtime_ns, &run_delay_ns))
+    return false;
+
+  const bool sampled = managed->sampled;
+  const uint64_t last_runtime_ns = managed->last_runtime_ns;
+  const uint64_t last_run_delay_ns = managed->last_run_delay_ns;
+  managed->last_runtime_ns = runtime_ns;
+  managed->last_run_delay_ns = run_delay_ns;
+  managed->sampled = true;
+  managed->last_cpu = managed->task->GetLastCpu();
+  if (!sampled || period_ns <= 0)
+    return true;
+
+  managed->run_share =
+      static_cast<double>(runtime_ns - last_runtime_ns) / period_ns;
+  managed->wait_share =
+      static_cast<double>(run_delay_ns - last_run_delay_ns) / period_ns;
+
+  if (managed->wait_share > kMaxWaitShare) {
+    managed->contended_periods++;
+    managed->relaxed_periods = 0;
+  } else {
+    managed->relaxed_periods++;
+    managed->contended_periods = 0;
+  }
+
+  if (managed->contended_periods > 0) {
+    // Move the task to where it will not wait, within what its cpuset allows;
+    // the kernel rejects a mask entirely outside of it.
+    cpu_set_t target = GetIdleBigCores();
+    cpu_set_t current;
+    if (sched_getaffinity(task_id, sizeof(current), &current) == 0 &&
+        !CPU_EQUAL(&target, &current)) {
+      if (sched_setaffinity(task_id, sizeof(target), &target) == 0) {
+        managed->placed = true;
+        managed->move_count++;
+      } else {
+        ALOGW("PlacementController: Failed to move task_id=%d to cpus %s: %s",
+              task_id, CpuSetToString(target).c_str(), strerror(errno));
+      }
+    }
+  }
+
+  if (managed->contended_periods >= kBoostPeriods && !managed->boosted &&
+      !managed->boost_policy.empty()) {
+    auto status = apply_policy_(task_id, managed->boost_policy);
+    if (status) {
+      managed->boosted = true;
+      managed->boost_count++;
+    } else {
+      ALOGW("PlacementController: Failed to boost task_id=%d to %s: %s",
+            task_id, managed->boost_policy.c_str(),
+            status.GetErrorMessage().c_str());
+    }
+  }
+
+  if (managed->relaxed_periods >= kReleasePeriods)
+    ReleaseTask(task_id, managed);
+
+  return true;
+}
+
+void PlacementController::ReleaseTask(pid_t task_id, ManagedTask* managed) {
+  if (managed->placed) {
+    sched_setaffinity(task_id, sizeof(managed->original_affinity),
+                      &managed->original_affinity);
+    managed->placed = false;
+  }
+  if (managed->boosted) {
+    if (!managed->original_cpuset.empty()) {
+      auto status = attach_cpuset_(task_id, managed->original_cpuset);
+      ALOGW_IF(!status,
+               "PlacementController: Failed to return task_id=%d to cpuset=%s: "
+               "%s",
+               task_id, managed->original_cpuset.c_str(),
+               status.GetErrorMessage().c_str());
+    }
+
+    sched_param param;
+    param.sched_priority = managed->original_priority;
+    sched_setscheduler(task_id, managed->original_policy, &param);
+    managed->boosted = false;
+  }
+}
+
+std::string PlacementController::DumpState() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::ostringstream stream;
+
+  stream << "Latency-critical tasks: " << tasks_.size() << " (" << period_count_
+         << " periods)" << std::endl;
+  stream << "Cpu idle shares:";
+  for (size_t cpu = 0; cpu < cpu_idle_shares_.size(); cpu++) {
+    stream << " " << cpu << "="
+           << static_cast<int>(cpu_idle_shares_[cpu] * 100) << "%";
+  }
+  stream << std::endl;
+
+  for (const auto& entry : tasks_) {
+    const ManagedTask& managed = entry.second;
+    stream << "  task_id=" << entry.first << " name=" << managed.task->name()
+           << " cpu=" << managed.last_cpu
+           << " run=" << static_cast<int>(managed.run_share * 100) << "%"
+           << " wait=" << static_cast<int>(managed.wait_share * 100) << "%"
+           << " placed=" << managed.placed << " boosted=" << managed.boosted
+           << " (" << managed.boost_policy << ")"
+           << " moves=" << managed.move_count
+           << " boosts=" << managed.boost_count << std::endl;
+  }
+
+  return stream.str();
+}
+
+}  // namespace dvr
+}  // namespace android
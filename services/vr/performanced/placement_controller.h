@@ -0,0 +1,124 @@
+#ifndef ANDROID_DVR_PERFORMANCED_PLACEMENT_CONTROLLER_H_
+#define ANDROID_DVR_PERFORMANCED_PLACEMENT_CONTROLLER_H_
+
+#include <sched.h>
+#include <sys/types.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <pdx/status.h>
+
+#include "task.h"
+
+namespace android {
+namespace dvr {
+
+// PlacementController keeps registered latency-critical tasks on idle big
+// cores. Every period it samples the load of each CPU from /proc/stat, and how
+// long each task ran and waited to run from its schedstat. A task that keeps
+// waiting is moved to the idle big cores its cpuset allows, and if it keeps
+// waiting there it is boosted to the scheduler policy it registered with,
+// which may also move it to the policy's cpuset. Tasks that stop waiting are
+// released back to their own affinity, cpuset and policy.
+class PlacementController {
+ public:
+  // Applies the named scheduler policy, including its cpuset, to a task.
+  using ApplyPolicyFunction =
+      std::function<pdx::Status<void>(pid_t task_id, const std::string&)>;
+  // Attaches a task to the cpuset at the given path.
+  using AttachCpuSetFunction =
+      std::function<pdx::Status<void>(pid_t task_id, const std::string&)>;
+
+  PlacementController(ApplyPolicyFunction apply_policy,
+                      AttachCpuSetFunction attach_cpuset);
+  ~PlacementController();
+
+  // Starts managing |task_id|, which is boosted to |boost_policy| when moving
+  // it is not enough. Registering again replaces the boost policy.
+  pdx::Status<void> Register(pid_t task_id, const std::string& boost_policy);
+
+  // Stops managing |task_id|, restoring its affinity and scheduler policy.
+  void Unregister(pid_t task_id);
+
+  std::string DumpState() const;
+
+ private:
+  struct CpuSample {
+    uint64_t idle = 0;
+    uint64_t total = 0;
+  };
+
+  struct ManagedTask {
+    std::unique_ptr<Task> task;
+    std::string boost_policy;
+
+    // The affinity, cpuset and policy to restore.
+    cpu_set_t original_affinity;
+    std::string original_cpuset;
+    int original_policy;
+    int original_priority;
+
+    uint64_t last_runtime_ns = 0;
+    uint64_t last_run_delay_ns = 0;
+    bool sampled = false;
+
+    // The shares of the last period spent running and waiting to run.
+    double run_share = 0;
+    double wait_share = 0;
+
+    int contended_periods = 0;
+    int relaxed_periods = 0;
+    bool placed = false;
+    bool boosted = false;
+
+    // Stats for DumpState().
+    uint64_t move_count = 0;
+    uint64_t boost_count = 0;
+    int last_cpu = -1;
+  };
+
+  void ControlThread();
+
+  // Updates |cpu_idle_shares_| from /proc/stat.
+  void SampleCpuLoad();
+  // Samples one task and moves or boosts it as needed. Returns false if the
+  // task is gone.
+  bool UpdateTask(pid_t task_id, ManagedTask* managed, int64_t period_ns);
+  // Restores the affinity and policy the task had before it was managed.
+  void ReleaseTask(pid_t task_id, ManagedTask* managed);
+  // The big cores that are mostly idle, or all of them if none are.
+  cpu_set_t GetIdleBigCores() const;
+
+  ApplyPolicyFunction apply_policy_;
+  AttachCpuSetFunction attach_cpuset_;
+
+  // The CPUs with the highest maximum frequency.
+  std::vector<int> big_cores_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable stop_condition_;
+  bool stop_requested_ = false;
+  // Everything below is protected by |mutex_|.
+  std::unordered_map<pid_t, ManagedTask> tasks_;
+  std::vector<CpuSample> cpu_samples_;
+  std::vector<double> cpu_idle_shares_;
+  uint64_t period_count_ = 0;
+
+  std::thread control_thread_;
+
+  PlacementController(const PlacementController&) = delete;
+  void operator=(const PlacementController&) = delete;
+};
+
+}  // namespace dvr
+}  // namespace android
+
+#endif  // ANDROID_DVR_PERFORMANCED_PLACEMENT_CONTROLLER_H_
@@ -4,6 +4,8 @@
 #include <fcntl.h>
 #include <log/log.h>
 #include <stdio.h>
+#include <string.h>
+#include <unistd.h>
 
 #include <cctype>
 #include <cstdlib>
@@ -162,5 +164,53 @@ std::string Task::GetCpuSetPath() const {
   }
 }
 
+bool Task::GetSchedStat(uint64_t* runtime_ns, uint64_t* run_delay_ns) const {
+  base::unique_fd fd = OpenTaskFile("schedstat");
+  if (fd.get() < 0)
+    return false;
+
+  char buffer[128];
+  const ssize_t size = read(fd.get(), buffer, sizeof(buffer) - 1);
+  if (size <= 0)
+    return false;
+  buffer[size] = '\0';
+
+  // The file holds "<runtime> <run delay> <timeslices>".
+  char* end;
+  *runtime_ns = std::strtoull(buffer, &end, 10);
+  if (end == buffer)
+    return false;
+  const char* start = end;
+  *run_delay_ns = std::strtoull(start, &end, 10);
+  return end != start;
+}
+
+int Task::GetLastCpu() const {
+  base::unique_fd fd = OpenTaskFile("stat");
+  if (fd.get() < 0)
+    return -1;
+
+  char buffer[1024];
+  const ssize_t size = read(fd.get(), buffer, sizeof(buffer) - 1);
+  if (size <= 0)
+    return -1;
+  buffer[size] = '\0';
+
+  // The name may hold spaces and parentheses, so count fields from the last
+  // closing parenthesis, which is followed by the third field.
+  const char* field = strrchr(buffer, ')');
+  if (field == nullptr)
+    return -1;
+
+  // The CPU is the 39th field.
+  const int kCpuField = 39;
+  for (int index = 2; index < kCpuField && field != nullptr; index++)
+    field = strchr(field + 1, ' ');
+  if (field == nullptr)
+    return -1;
+
+  return std::strtol(field + 1, nullptr, 10);
+}
+
 }  // namespace dvr
 }  // namespace android
@@ -46,6 +46,15 @@ class Task {
 
   std::string GetCpuSetPath() const;
 
+  // Reads how long the task has spent running and waiting to run, in
+  // nanoseconds, from /proc/<task_id_>/schedstat. Returns false if the task is
+  // gone or schedstats are not available.
+  bool GetSchedStat(uint64_t* runtime_ns, uint64_t* run_delay_ns) const;
+
+  // Returns the CPU the task last ran on, from /proc/<task_id_>/stat, or -1 if
+  // it could not be read.
+  int GetLastCpu() const;
+
  private:
   pid_t task_id_;
   base::unique_fd task_fd_;
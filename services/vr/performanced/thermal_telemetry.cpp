@@ -0,0 +1,128 @@
+#include "thermal_telemetry.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <string>
+
+#include <android-base/stringprintf.h>
+#include <cutils/ashmem.h>
+#include <log/log.h>
+
+using android::base::StringPrintf;
+using android::base::unique_fd;
+
+namespace {
+
+const char kThermalZoneTempPath[] = "/sys/class/thermal/thermal_zone%zu/temp";
+
+// Zones are numbered from zero without gaps; stop looking after this many.
+constexpr size_t kMaxThermalZones = 64;
+
+constexpr std::chrono::seconds kSamplePeriod{1};
+
+int64_t GetMonotonicNs() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+}  // anonymous namespace
+
+namespace android {
+namespace dvr {
+
+std::unique_ptr<ThermalTelemetry> ThermalTelemetry::Create() {
+  std::unique_ptr<ThermalTelemetry> telemetry(new ThermalTelemetry);
+
+  const size_t page_size = sysconf(_SC_PAGESIZE);
+  telemetry->mmap_size_ =
+      (DvrTelemetryRing::MemorySize() + page_size - 1) & ~(page_size - 1);
+  telemetry->memory_fd_.reset(
+      ashmem_create_region("ThermalTelemetry", telemetry->mmap_size_));
+  if (telemetry->memory_fd_ < 0) {
+    ALOGE("ThermalTelemetry::Create: Failed to create shared memory: %s",
+          strerror(errno));
+    return nullptr;
+  }
+
+  void* base = mmap(nullptr, telemetry->mmap_size_, PROT_READ | PROT_WRITE,
+                    MAP_SHARED, telemetry->memory_fd_.get(), 0);
+  if (base == MAP_FAILED) {
+    ALOGE("ThermalTelemetry::Create: Failed to map shared memory: %s",
+          strerror(errno));
+    return nullptr;
+  }
+  telemetry->mmap_base_ = base;
+  telemetry->ring_ = DvrTelemetryRing::Create(base, telemetry->mmap_size_);
+
+  // Only this mapping may write; readers get what is left.
+  if (ashmem_set_prot_region(telemetry->memory_fd_.get(), PROT_READ) < 0) {
+    ALOGE("ThermalTelemetry::Create: Failed to protect shared memory: %s",
+          strerror(errno));
+    return nullptr;
+  }
+
+  for (size_t zone = 0; zone < kMaxThermalZones; zone++) {
+    const std::string path = StringPrintf(kThermalZoneTempPath, zone);
+    unique_fd fd(open(path.c_str(), O_RDONLY | O_CLOEXEC));
+    if (fd < 0)
+      break;
+    telemetry->zone_fds_.push_back(std::move(fd));
+  }
+  ALOGI("ThermalTelemetry::Create: Sampling %zu thermal zones.",
+        telemetry->zone_fds_.size());
+
+  if (!telemetry->zone_fds_.empty()) {
+    telemetry->sample_thread_ =
+        std::thread(&ThermalTelemetry::SampleThread, telemetry.get());
+  }
+  return telemetry;
+}
+
+ThermalTelemetry::~ThermalTelemetry() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_requested_ = true;
+  }
+  stop_condition_.notify_all();
+  if (sample_thread_.joinable())
+    sample_thread_.join();
+
+  if (mmap_base_)
+    munmap(mmap_base_, mmap_size_);
+}
+
+void ThermalTelemetry::SampleThread() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!stop_requested_) {
+    for (size_t zone = 0; zone < zone_fds_.size(); zone++) {
+      char buffer[32];
+      const ssize_t size =
+          pread(zone_fds_[zone].get(), buffer, sizeof(buffer) - 1, 0);
+      if (size <= 0)
+        continue;
+      buffer[size] = '\0';
+
+      DvrTelemetry telemetry;
+      telemetry.timestamp_ns = GetMonotonicNs();
+      telemetry.type = DVR_TELEMETRY_TYPE_THERMAL;
+      telemetry.vsync_count = 0;
+      telemetry.value[0] = zone;
+      telemetry.value[1] = strtoll(buffer, nullptr, 10);
+      ring_.Put(telemetry);
+    }
+
+    stop_condition_.wait_for(lock, kSamplePeriod,
+                             [this] { return stop_requested_; });
+  }
+}
+
+}  // namespace dvr
+}  // namespace android
@@ -0,0 +1,55 @@
+#ifndef ANDROID_DVR_PERFORMANCED_THERMAL_TELEMETRY_H_
+#define ANDROID_DVR_PERFORMANCED_THERMAL_TELEMETRY_H_
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <android-base/unique_fd.h>
+#include <dvr/dvr_shared_buffers.h>
+
+namespace android {
+namespace dvr {
+
+// ThermalTelemetry samples the thermal zones once a second and publishes each
+// reading as a DvrTelemetry record into a broadcast ring in shared memory.
+// Readers map the ring read-only and follow it on their own, so a reader never
+// costs the writer an IPC or blocks it.
+class ThermalTelemetry {
+ public:
+  // Returns nullptr if the shared memory could not be set up.
+  static std::unique_ptr<ThermalTelemetry> Create();
+  ~ThermalTelemetry();
+
+  // The shared memory holding the ring, which may only be mapped read-only.
+  int memory_fd() const { return memory_fd_.get(); }
+
+ private:
+  ThermalTelemetry() = default;
+
+  // Publishes a record per zone until asked to stop.
+  void SampleThread();
+
+  android::base::unique_fd memory_fd_;
+  void* mmap_base_ = nullptr;
+  size_t mmap_size_ = 0;
+  DvrTelemetryRing ring_;
+
+  // The temp files of the thermal zones, indexed by zone.
+  std::vector<android::base::unique_fd> zone_fds_;
+
+  std::mutex mutex_;
+  std::condition_variable stop_condition_;
+  bool stop_requested_ = false;
+  std::thread sample_thread_;
+
+  ThermalTelemetry(const ThermalTelemetry&) = delete;
+  void operator=(const ThermalTelemetry&) = delete;
+};
+
+}  // namespace dvr
+}  // namespace android
+
+#endif  // ANDROID_DVR_PERFORMANCED_THERMAL_TELEMETRY_H_
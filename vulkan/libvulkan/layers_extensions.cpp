@@ -98,7 +98,7 @@ class LayerLibrary {
                  const char* gpa_name,
                  size_t gpa_name_len) const;
 
-    const std::string GetFilename() { return filename_; }
+    const std::string& GetFilename() const { return filename_; }
 
    private:
     const std::string path_;
@@ -311,22 +311,30 @@ void* LayerLibrary::GetGPA(const Layer& layer,
 
 // ----------------------------------------------------------------------------
 
+// Layer libraries are only found by DiscoverLayers(). Loading them to
+// enumerate their layers waits until the layers are first asked for, since
+// most apps enable none and the search path includes the app's own library
+// directory.
 std::vector<LayerLibrary> g_layer_libraries;
 std::vector<Layer> g_instance_layers;
+std::once_flag g_enumerate_layers_once;
 
 void AddLayerLibrary(const std::string& path, const std::string& filename) {
-    LayerLibrary library(path + "/" + filename, filename);
-    if (!library.Open())
-        return;
+    g_layer_libraries.emplace_back(path + "/" + filename, filename);
+}
 
-    if (!library.EnumerateLayers(g_layer_libraries.size(), g_instance_layers)) {
-        library.Close();
+void EnumerateLibraryLayers(LayerLibrary& library, size_t library_idx) {
+    if (!library.Open())
         return;
-    }
-
+    library.EnumerateLayers(library_idx, g_instance_layers);
     library.Close();
+}
 
-    g_layer_libraries.emplace_back(std::move(library));
+void EnsureLayersEnumerated() {
+    std::call_once(g_enumerate_layers_once, []() {
+        for (size_t i = 0; i < g_layer_libraries.size(); i++)
+            EnumerateLibraryLayers(g_layer_libraries[i], i);
+    });
 }
 
 template <typename Functor>
@@ -460,14 +468,17 @@ void DiscoverLayers() {
 }
 
 uint32_t GetLayerCount() {
+    EnsureLayersEnumerated();
     return static_cast<uint32_t>(g_instance_layers.size());
 }
 
 const Layer& GetLayer(uint32_t index) {
+    EnsureLayersEnumerated();
     return g_instance_layers[index];
 }
 
 const Layer* FindLayer(const char* name) {
+    EnsureLayersEnumerated();
     auto layer =
         std::find_if(g_instance_layers.cbegin(), g_instance_layers.cend(),
                      [=](const Layer& entry) {
@@ -16,11 +16,13 @@
 
 #include <algorithm>
 
+#include <cutils/properties.h>
 #include <grallocusage/GrallocUsageConversion.h>
 #include <log/log.h>
 #include <ui/BufferQueueDefs.h>
 #include <sync/sync.h>
 #include <utils/StrongPointer.h>
+#include <utils/Timers.h>
 #include <utils/Vector.h>
 #include <system/window.h>
 #include <android/hardware/graphics/common/1.0/types.h>
@@ -201,25 +203,67 @@ enum { MAX_TIMING_INFOS = 10 };
 // Minimum number of frames to look for in the past (so we don't cause
 // syncronous requests to Surface Flinger):
 enum { MIN_NUM_FRAMES_AGO = 5 };
+// Number of recent frame durations that pick the pacing interval:
+enum { NUM_PACING_DURATIONS = 8 };
+// Maximum number of refresh cycles a paced frame is shown for:
+enum { MAX_PACING_INTERVAL = 4 };
+
+// Present pacing, for apps that don't pace themselves with
+// VK_GOOGLE_display_timing.  Each frame is shown for the same whole number
+// of refresh cycles, the fewest that fit the app's recent frame durations,
+// so a game that can't keep up with 60 fps runs at an even 30 fps instead of
+// alternating between the two.  Frames are held back with a desired present
+// time on a vsync grid anchored to the actual present times of earlier
+// frames.  Enabled per swapchain with the debug.vulkan.swapchain_pacing
+// property, for FIFO swapchains only.
+struct PacingInfo {
+    bool enabled { false };
+    // Number of refresh cycles each frame is shown for:
+    int64_t interval { 1 };
+    // The latest actual present time seen, which is on a vsync:
+    int64_t vsync_time { 0 };
+    // The vsync the last paced frame was targeted at:
+    int64_t target_time { 0 };
+    int64_t last_queue_time { 0 };
+    int64_t durations[NUM_PACING_DURATIONS] {};
+    // Frames whose actual present time is looked up MIN_NUM_FRAMES_AGO
+    // presents later:
+    uint64_t native_frame_ids[MIN_NUM_FRAMES_AGO] {};
+    uint32_t num_frames { 0 };
+};
 
 struct Swapchain {
     Swapchain(Surface& surface_,
               uint32_t num_images_,
-              VkPresentModeKHR present_mode)
+              VkPresentModeKHR present_mode_)
         : surface(surface_),
           num_images(num_images_),
-          mailbox_mode(present_mode == VK_PRESENT_MODE_MAILBOX_KHR),
+          present_mode(present_mode_),
+          mailbox_mode(present_mode_ == VK_PRESENT_MODE_MAILBOX_KHR),
           frame_timestamps_enabled(false),
-          shared(present_mode == VK_PRESENT_MODE_SHARED_DEMAND_REFRESH_KHR ||
-                 present_mode == VK_PRESENT_MODE_SHARED_CONTINUOUS_REFRESH_KHR) {
+          shared(present_mode_ == VK_PRESENT_MODE_SHARED_DEMAND_REFRESH_KHR ||
+                 present_mode_ == VK_PRESENT_MODE_SHARED_CONTINUOUS_REFRESH_KHR) {
         ANativeWindow* window = surface.window.get();
         native_window_get_refresh_cycle_duration(
             window,
             &refresh_duration);
+        pacing.enabled =
+            present_mode == VK_PRESENT_MODE_FIFO_KHR && refresh_duration > 0 &&
+            property_get_bool("debug.vulkan.swapchain_pacing", false);
     }
 
     Surface& surface;
     uint32_t num_images;
+    // The parameters the images were created with, to decide whether a
+    // swapchain that replaces this one can take them over:
+    VkFormat image_format;
+    VkColorSpaceKHR image_color_space;
+    VkExtent2D image_extent;
+    VkImageUsageFlags image_usage;
+    VkSwapchainCreateFlagsKHR image_flags;
+    VkSharingMode image_sharing_mode;
+    uint32_t min_image_count;
+    VkPresentModeKHR present_mode;
     bool mailbox_mode;
     bool frame_timestamps_enabled;
     int64_t refresh_duration;
@@ -238,6 +282,7 @@ struct Swapchain {
     } images[android::BufferQueueDefs::NUM_BUFFER_SLOTS];
 
     android::Vector<TimingInfo> timing;
+    PacingInfo pacing;
 };
 
 VkSwapchainKHR HandleFromSwapchain(Swapchain* swapchain) {
@@ -297,6 +342,35 @@ void ReleaseSwapchainImage(VkDevice device,
     image.buffer.clear();
 }
 
+// A swapchain created with the same image parameters as the active one it
+// replaces can take over its images, and the native buffers behind them,
+// instead of reconnecting the window and allocating new ones. Only changes
+// that don't affect the buffers, like preTransform, are allowed.
+bool CanRecycleImages(const Swapchain& old_swapchain,
+                      const VkSwapchainCreateInfoKHR* create_info) {
+    if (old_swapchain.surface.swapchain_handle !=
+            HandleFromSwapchain(const_cast<Swapchain*>(&old_swapchain)) ||
+        old_swapchain.shared || old_swapchain.image_format != create_info->imageFormat ||
+        old_swapchain.image_color_space != create_info->imageColorSpace ||
+        old_swapchain.image_extent.width != create_info->imageExtent.width ||
+        old_swapchain.image_extent.height != create_info->imageExtent.height ||
+        old_swapchain.image_usage != create_info->imageUsage ||
+        old_swapchain.image_flags != create_info->flags ||
+        old_swapchain.image_sharing_mode != VK_SHARING_MODE_EXCLUSIVE ||
+        create_info->imageSharingMode != VK_SHARING_MODE_EXCLUSIVE ||
+        old_swapchain.min_image_count != create_info->minImageCount ||
+        old_swapchain.present_mode != create_info->presentMode) {
+        return false;
+    }
+    // The app may still present images it acquired from the old swapchain,
+    // so those can't change hands.
+    for (uint32_t i = 0; i < old_swapchain.num_images; i++) {
+        if (old_swapchain.images[i].dequeued)
+            return false;
+    }
+    return true;
+}
+
 void OrphanSwapchain(VkDevice device, Swapchain* swapchain) {
     if (swapchain->surface.swapchain_handle != HandleFromSwapchain(swapchain))
         return;
@@ -403,6 +477,65 @@ void copy_ready_timings(Swapchain& swapchain,
     *count = num_copied;
 }
 
+// Returns the desired present time for the frame about to be queued, or
+// NATIVE_WINDOW_TIMESTAMP_AUTO if it shouldn't be held back.
+int64_t pace_present(Swapchain& swapchain, uint64_t nativeFrameId) {
+    PacingInfo& pacing = swapchain.pacing;
+    const int64_t rdur = swapchain.refresh_duration;
+    const int64_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+
+    // Re-anchor the vsync grid to the frame presented MIN_NUM_FRAMES_AGO,
+    // which by now has its present fence timestamp.
+    const uint32_t slot = pacing.num_frames % MIN_NUM_FRAMES_AGO;
+    if (pacing.num_frames >= MIN_NUM_FRAMES_AGO) {
+        int64_t actual_present_time = 0;
+        int ret = native_window_get_frame_timestamps(
+            swapchain.surface.window.get(), pacing.native_frame_ids[slot],
+            NULL, NULL, NULL, NULL, NULL, NULL, &actual_present_time, NULL,
+            NULL);
+        if (ret == android::NO_ERROR && actual_present_time > 0) {
+            pacing.vsync_time = std::max(pacing.vsync_time, actual_present_time);
+        }
+    }
+    pacing.native_frame_ids[slot] = nativeFrameId;
+
+    // A frame longer than the longest interval is a stall, not a frame rate.
+    const int64_t duration = now - pacing.last_queue_time;
+    if (pacing.last_queue_time && duration <= MAX_PACING_INTERVAL * rdur) {
+        pacing.durations[pacing.num_frames % NUM_PACING_DURATIONS] = duration;
+    }
+    pacing.last_queue_time = now;
+    pacing.num_frames++;
+
+    if (!pacing.vsync_time) {
+        return NATIVE_WINDOW_TIMESTAMP_AUTO;
+    }
+
+    // Show each frame for as many refresh cycles as the slowest recent frame
+    // needed.  A quarter of a cycle of slack keeps a frame that is only just
+    // late from doubling the interval.
+    int64_t longest = 0;
+    for (int64_t duration : pacing.durations) {
+        longest = std::max(longest, duration);
+    }
+    pacing.interval = std::min<int64_t>(
+        std::max<int64_t>((longest - rdur / 4 + rdur - 1) / rdur, 1),
+        MAX_PACING_INTERVAL);
+
+    // The next vsync on the grid that is an interval after the last paced
+    // frame, and not in the past.
+    int64_t target = std::max(pacing.target_time + pacing.interval * rdur, now);
+    if (target > pacing.vsync_time) {
+        target = pacing.vsync_time +
+                 (target - pacing.vsync_time + rdur - 1) / rdur * rdur;
+    }
+    pacing.target_time = target;
+
+    // SurfaceFlinger shows a buffer at the first vsync at or after its
+    // desired present time; half a cycle early keeps it off the boundary.
+    return target - rdur / 2;
+}
+
 android_pixel_format GetNativePixelFormat(VkFormat format) {
     android_pixel_format native_format = HAL_PIXEL_FORMAT_RGBA_8888;
     switch (format) {
@@ -976,8 +1109,16 @@ VkResult CreateSwapchainKHR(VkDevice device,
               reinterpret_cast<uint64_t>(create_info->oldSwapchain));
         return VK_ERROR_NATIVE_WINDOW_IN_USE_KHR;
     }
-    if (create_info->oldSwapchain != VK_NULL_HANDLE)
-        OrphanSwapchain(device, SwapchainFromHandle(create_info->oldSwapchain));
+    Swapchain* old_swapchain = SwapchainFromHandle(create_info->oldSwapchain);
+    const bool recycle_images =
+        old_swapchain && CanRecycleImages(*old_swapchain, create_info);
+    if (recycle_images) {
+        // Retire the old swapchain but keep its images, so that if creation
+        // fails they are still released when it is destroyed.
+        surface.swapchain_handle = VK_NULL_HANDLE;
+    } else if (old_swapchain) {
+        OrphanSwapchain(device, old_swapchain);
+    }
 
     // -- Reset the native window --
     // The native window might have been used previously, and had its properties
@@ -990,20 +1131,25 @@ VkResult CreateSwapchainKHR(VkDevice device,
     // non-FREE state at any given time. Disconnecting and re-connecting
     // orphans the previous buffers, getting us back to the state where we can
     // dequeue all buffers.
-    err = native_window_api_disconnect(surface.window.get(),
-                                       NATIVE_WINDOW_API_EGL);
-    ALOGW_IF(err != 0, "native_window_api_disconnect failed: %s (%d)",
-             strerror(-err), err);
-    err =
-        native_window_api_connect(surface.window.get(), NATIVE_WINDOW_API_EGL);
-    ALOGW_IF(err != 0, "native_window_api_connect failed: %s (%d)",
-             strerror(-err), err);
-
-    err = native_window_set_buffer_count(surface.window.get(), 0);
-    if (err != 0) {
-        ALOGE("native_window_set_buffer_count(0) failed: %s (%d)",
-              strerror(-err), err);
-        return VK_ERROR_SURFACE_LOST_KHR;
+    //
+    // When the old swapchain's images are taken over, its buffers must stay
+    // in the queue and the window already has the right buffer count.
+    if (!recycle_images) {
+        err = native_window_api_disconnect(surface.window.get(),
+                                           NATIVE_WINDOW_API_EGL);
+        ALOGW_IF(err != 0, "native_window_api_disconnect failed: %s (%d)",
+                 strerror(-err), err);
+        err = native_window_api_connect(surface.window.get(),
+                                        NATIVE_WINDOW_API_EGL);
+        ALOGW_IF(err != 0, "native_window_api_connect failed: %s (%d)",
+                 strerror(-err), err);
+
+        err = native_window_set_buffer_count(surface.window.get(), 0);
+        if (err != 0) {
+            ALOGE("native_window_set_buffer_count(0) failed: %s (%d)",
+                  strerror(-err), err);
+            return VK_ERROR_SURFACE_LOST_KHR;
+        }
     }
 
     int swap_interval =
@@ -1115,33 +1261,38 @@ VkResult CreateSwapchainKHR(VkDevice device,
         }
     }
 
-    int query_value;
-    err = surface.window->query(surface.window.get(),
-                                NATIVE_WINDOW_MIN_UNDEQUEUED_BUFFERS,
-                                &query_value);
-    if (err != 0 || query_value < 0) {
-        // TODO(jessehall): Improve error reporting. Can we enumerate possible
-        // errors and translate them to valid Vulkan result codes?
-        ALOGE("window->query failed: %s (%d) value=%d", strerror(-err), err,
-              query_value);
-        return VK_ERROR_SURFACE_LOST_KHR;
-    }
-    uint32_t min_undequeued_buffers = static_cast<uint32_t>(query_value);
-    uint32_t num_images =
-        (create_info->minImageCount - 1) + min_undequeued_buffers;
-
-    // Lower layer insists that we have at least two buffers. This is wasteful
-    // and we'd like to relax it in the shared case, but not all the pieces are
-    // in place for that to work yet. Note we only lie to the lower layer-- we
-    // don't want to give the app back a swapchain with extra images (which they
-    // can't actually use!).
-    err = native_window_set_buffer_count(surface.window.get(), std::max(2u, num_images));
-    if (err != 0) {
-        // TODO(jessehall): Improve error reporting. Can we enumerate possible
-        // errors and translate them to valid Vulkan result codes?
-        ALOGE("native_window_set_buffer_count(%d) failed: %s (%d)", num_images,
-              strerror(-err), err);
-        return VK_ERROR_SURFACE_LOST_KHR;
+    uint32_t num_images;
+    if (recycle_images) {
+        num_images = old_swapchain->num_images;
+    } else {
+        int query_value;
+        err = surface.window->query(surface.window.get(),
+                                    NATIVE_WINDOW_MIN_UNDEQUEUED_BUFFERS,
+                                    &query_value);
+        if (err != 0 || query_value < 0) {
+            // TODO(jessehall): Improve error reporting. Can we enumerate
+            // possible errors and translate them to valid Vulkan result codes?
+            ALOGE("window->query failed: %s (%d) value=%d", strerror(-err), err,
+                  query_value);
+            return VK_ERROR_SURFACE_LOST_KHR;
+        }
+        uint32_t min_undequeued_buffers = static_cast<uint32_t>(query_value);
+        num_images = (create_info->minImageCount - 1) + min_undequeued_buffers;
+
+        // Lower layer insists that we have at least two buffers. This is
+        // wasteful and we'd like to relax it in the shared case, but not all
+        // the pieces are in place for that to work yet. Note we only lie to the
+        // lower layer-- we don't want to give the app back a swapchain with
+        // extra images (which they can't actually use!).
+        err = native_window_set_buffer_count(surface.window.get(),
+                                             std::max(2u, num_images));
+        if (err != 0) {
+            // TODO(jessehall): Improve error reporting. Can we enumerate
+            // possible errors and translate them to valid Vulkan result codes?
+            ALOGE("native_window_set_buffer_count(%d) failed: %s (%d)",
+                  num_images, strerror(-err), err);
+            return VK_ERROR_SURFACE_LOST_KHR;
+        }
     }
 
     int32_t legacy_usage = 0;
@@ -1190,6 +1341,32 @@ VkResult CreateSwapchainKHR(VkDevice device,
         return VK_ERROR_OUT_OF_HOST_MEMORY;
     Swapchain* swapchain =
         new (mem) Swapchain(surface, num_images, create_info->presentMode);
+    swapchain->image_format = create_info->imageFormat;
+    swapchain->image_color_space = create_info->imageColorSpace;
+    swapchain->image_extent = create_info->imageExtent;
+    swapchain->image_usage = create_info->imageUsage;
+    swapchain->image_flags = create_info->flags;
+    swapchain->image_sharing_mode = create_info->imageSharingMode;
+    swapchain->min_image_count = create_info->minImageCount;
+
+    // -- Take over the old swapchain's images --
+    // The buffers are still in the window's queue, so the VkImages bound to
+    // them are handed over as they are, leaving the old swapchain nothing to
+    // destroy.
+    if (recycle_images) {
+        for (uint32_t i = 0; i < num_images; i++) {
+            Swapchain::Image& old_img = old_swapchain->images[i];
+            Swapchain::Image& img = swapchain->images[i];
+            img.image = old_img.image;
+            img.buffer = old_img.buffer;
+            old_img.image = VK_NULL_HANDLE;
+            old_img.buffer.clear();
+        }
+
+        surface.swapchain_handle = HandleFromSwapchain(swapchain);
+        *swapchain_handle = surface.swapchain_handle;
+        return VK_SUCCESS;
+    }
 
     // -- Dequeue all buffers and create a VkImage for each --
     // Any failures during or after this must cancel the dequeued buffers.
@@ -1570,7 +1747,7 @@ VkResult QueuePresentKHR(VkQueue queue, const VkPresentInfoKHR* present_info) {
                     }
                     native_window_set_surface_damage(window, rects, rcount);
                 }
-                if (time) {
+                if (time || swapchain.pacing.enabled) {
                     if (!swapchain.frame_timestamps_enabled) {
                         ALOGV(
                             "Calling "
@@ -1588,13 +1765,20 @@ VkResult QueuePresentKHR(VkQueue queue, const VkPresentInfoKHR* present_info) {
                         ALOGE("Failed to get next native frame ID.");
                     }
 
-                    // Add a new timing record with the user's presentID and
-                    // the nativeFrameId.
-                    swapchain.timing.push_back(TimingInfo(time, nativeFrameId));
-                    while (swapchain.timing.size() > MAX_TIMING_INFOS) {
-                        swapchain.timing.removeAt(0);
+                    if (time) {
+                        // Add a new timing record with the user's presentID
+                        // and the nativeFrameId.
+                        swapchain.timing.push_back(
+                            TimingInfo(time, nativeFrameId));
+                        while (swapchain.timing.size() > MAX_TIMING_INFOS) {
+                            swapchain.timing.removeAt(0);
+                        }
                     }
-                    if (time->desiredPresentTime) {
+                    if (swapchain.pacing.enabled &&
+                        !(time && time->desiredPresentTime)) {
+                        native_window_set_buffers_timestamp(
+                            window, pace_present(swapchain, nativeFrameId));
+                    } else if (time->desiredPresentTime) {
                         // Set the desiredPresentTime:
                         ALOGV(
                             "Calling "